@@ -56,6 +56,7 @@
 #    "C:/xilinxdesigns/Saturn/FPGA/sources/verilogmodules/iambic.v"
 #    "C:/xilinxdesigns/Saturn/FPGA/sources/verilogmodules/byteswap_64bit.v"
 #    "C:/xilinxdesigns/Saturn/FPGA/sources/verilogmodules/wideband_collect.v"
+#    "C:/xilinxdesigns/Saturn/FPGA/sources/verilogmodules/axil_icap_reconfig.v"
 #    "C:/xilinxdesigns/Saturn/FPGA/sources/verilogmodules/axis_adder.v"
 #    "C:/xilinxdesigns/Saturn/FPGA/sources/verilogmodules/i2s_clk_lrclk_gen.v"
 #    "C:/xilinxdesigns/Saturn/FPGA/sources/verilogmodules/I2S_xmit.v"
@@ -122,6 +123,7 @@ proc checkRequiredFiles { origin_dir} {
  "[file normalize "$origin_dir/sources/verilogmodules/iambic.v"]"\
  "[file normalize "$origin_dir/sources/verilogmodules/byteswap_64bit.v"]"\
  "[file normalize "$origin_dir/sources/verilogmodules/wideband_collect.v"]"\
+ "[file normalize "$origin_dir/sources/verilogmodules/axil_icap_reconfig.v"]"\
  "[file normalize "$origin_dir/sources/verilogmodules/axis_adder.v"]"\
  "[file normalize "$origin_dir/sources/verilogmodules/i2s_clk_lrclk_gen.v"]"\
  "[file normalize "$origin_dir/sources/verilogmodules/I2S_xmit.v"]"\
@@ -312,6 +314,7 @@ set files [list \
  [file normalize "${origin_dir}/sources/verilogmodules/iambic.v"] \
  [file normalize "${origin_dir}/sources/verilogmodules/byteswap_64bit.v"] \
  [file normalize "${origin_dir}/sources/verilogmodules/wideband_collect.v"] \
+ [file normalize "${origin_dir}/sources/verilogmodules/axil_icap_reconfig.v"] \
  [file normalize "${origin_dir}/sources/verilogmodules/axis_adder.v"] \
  [file normalize "${origin_dir}/sources/verilogmodules/i2s_clk_lrclk_gen.v"] \
  [file normalize "${origin_dir}/sources/verilogmodules/I2S_xmit.v"] \
@@ -2857,6 +2860,9 @@ if { [get_files byteswap_64bit.v] == "" } {
 if { [get_files wideband_collect.v] == "" } {
   import_files -quiet -fileset sources_1 C:/xilinxdesigns/Saturn/FPGA/sources/verilogmodules/wideband_collect.v
 }
+if { [get_files axil_icap_reconfig.v] == "" } {
+  import_files -quiet -fileset sources_1 C:/xilinxdesigns/Saturn/FPGA/sources/verilogmodules/axil_icap_reconfig.v
+}
 
 
 # Proc to create BD saturn_top
@@ -6916,7 +6922,7 @@ proc create_hier_cell_PCIe { parentCell nameHier } {
   set axi_interconnect_122 [ create_bd_cell -type ip -vlnv xilinx.com:ip:axi_interconnect:2.1 axi_interconnect_122 ]
   set_property -dict [list \
     CONFIG.ENABLE_ADVANCED_OPTIONS {0} \
-    CONFIG.NUM_MI {12} \
+    CONFIG.NUM_MI {13} \
   ] $axi_interconnect_122
 
 
@@ -7138,6 +7144,17 @@ proc create_hier_cell_PCIe { parentCell nameHier } {
    }
     set_property CONFIG.SPI_CLOCK_DIVIDE {3} $AXIL_SPIWriter_0
 
+  # Create instance: AXIL_ICAP_Reconfig_0, and set properties
+  set block_name AXIL_ICAP_Reconfig
+  set block_cell_name AXIL_ICAP_Reconfig_0
+  if { [catch {set AXIL_ICAP_Reconfig_0 [create_bd_cell -type module -reference $block_name $block_cell_name] } errmsg] } {
+     catch {common::send_gid_msg -ssname BD::TCL -id 2095 -severity "ERROR" "Unable to add referenced block <$block_name>. Please add the files for ${block_name}'s definition into the project."}
+     return 1
+   } elseif { $AXIL_ICAP_Reconfig_0 eq "" } {
+     catch {common::send_gid_msg -ssname BD::TCL -id 2096 -severity "ERROR" "Unable to referenced block <$block_name>. Please add the files for ${block_name}'s definition into the project."}
+     return 1
+   }
+
 
   # Create interface connections
   connect_bd_intf_net -intf_net Conn1 [get_bd_intf_pins M00_AXI_0] [get_bd_intf_pins axi_interconnect_122/M00_AXI]
@@ -7157,6 +7174,7 @@ proc create_hier_cell_PCIe { parentCell nameHier } {
   connect_bd_intf_net -intf_net axi_interconnect_122_M09_AXI [get_bd_intf_pins M09_AXI] [get_bd_intf_pins axi_interconnect_122/M09_AXI]
   connect_bd_intf_net -intf_net axi_interconnect_122_M10_AXI [get_bd_intf_pins AXIL_ConfigReg_64_1/s_axi] [get_bd_intf_pins axi_interconnect_122/M10_AXI]
   connect_bd_intf_net -intf_net axi_interconnect_122_M11_AXI [get_bd_intf_pins M12_AXI_WB] [get_bd_intf_pins axi_interconnect_122/M11_AXI]
+  connect_bd_intf_net -intf_net axi_interconnect_122_M12_AXI [get_bd_intf_pins AXIL_ICAP_Reconfig_0/s_axi] [get_bd_intf_pins axi_interconnect_122/M12_AXI]
   connect_bd_intf_net -intf_net axi_interconnect_lite_125_M00_AXI [get_bd_intf_pins axi_interconnect_lite_125/M00_AXI] [get_bd_intf_pins axi_quad_spi_0/AXI_LITE]
   connect_bd_intf_net -intf_net axi_interconnect_lite_125_M01_AXI [get_bd_intf_pins axi_interconnect_lite_125/M01_AXI] [get_bd_intf_pins xadc_wiz_0/s_axi_lite]
   connect_bd_intf_net -intf_net axi_interconnect_lite_125_M02_AXI [get_bd_intf_pins AXIL_ConfigReg_64_0/s_axi] [get_bd_intf_pins axi_interconnect_lite_125/M02_AXI]
@@ -7202,7 +7220,7 @@ proc create_hier_cell_PCIe { parentCell nameHier } {
   connect_bd_net -net Watchdog_TXEN_1 [get_bd_pins Watchdog_TXEN] [get_bd_pins xlconcat_0/In4]
   connect_bd_net -net c_addsub_0_S [get_bd_pins c_addsub_0/S] [get_bd_pins xlconcat_1/In0]
   connect_bd_net -net clk12_1 [get_bd_pins clk12] [get_bd_pins Double_D_register_syncareset1/aclk]
-  connect_bd_net -net clk_122_1 [get_bd_pins clk_122] [get_bd_pins AXIL_ReadReg_64_0/aclk] [get_bd_pins Double_D_register_syncareset/aclk] [get_bd_pins AXIL_ConfigReg_256_2/aclk] [get_bd_pins AXI_SPI_ADC_0/aclk] [get_bd_pins AXI_FIFO_overflow_re_0/aclk] [get_bd_pins AXIL_ConfigReg_64_1/aclk] [get_bd_pins axi_interconnect_122/ACLK] [get_bd_pins axi_interconnect_122/S00_ACLK] [get_bd_pins axi_interconnect_122/M00_ACLK] [get_bd_pins axi_interconnect_122/M01_ACLK] [get_bd_pins axi_interconnect_122/M02_ACLK] [get_bd_pins axi_interconnect_122/M03_ACLK] [get_bd_pins axi_interconnect_122/M04_ACLK] [get_bd_pins axi_interconnect_122/M05_ACLK] [get_bd_pins axi_interconnect_122/M06_ACLK] [get_bd_pins axi_interconnect_122/M07_ACLK] [get_bd_pins axi_interconnect_122/M08_ACLK] [get_bd_pins axi_interconnect_122/M09_ACLK] [get_bd_pins axi_interconnect_122/M10_ACLK] [get_bd_pins axi_interconnect_lite/M01_ACLK] [get_bd_pins axi_interconnect_122/M11_ACLK] [get_bd_pins D_register_0/aclk] [get_bd_pins D_register_1/aclk] [get_bd_pins AXIL_SPIWriter_0/aclk]
+  connect_bd_net -net clk_122_1 [get_bd_pins clk_122] [get_bd_pins AXIL_ReadReg_64_0/aclk] [get_bd_pins Double_D_register_syncareset/aclk] [get_bd_pins AXIL_ConfigReg_256_2/aclk] [get_bd_pins AXI_SPI_ADC_0/aclk] [get_bd_pins AXI_FIFO_overflow_re_0/aclk] [get_bd_pins AXIL_ConfigReg_64_1/aclk] [get_bd_pins axi_interconnect_122/ACLK] [get_bd_pins axi_interconnect_122/S00_ACLK] [get_bd_pins axi_interconnect_122/M00_ACLK] [get_bd_pins axi_interconnect_122/M01_ACLK] [get_bd_pins axi_interconnect_122/M02_ACLK] [get_bd_pins axi_interconnect_122/M03_ACLK] [get_bd_pins axi_interconnect_122/M04_ACLK] [get_bd_pins axi_interconnect_122/M05_ACLK] [get_bd_pins axi_interconnect_122/M06_ACLK] [get_bd_pins axi_interconnect_122/M07_ACLK] [get_bd_pins axi_interconnect_122/M08_ACLK] [get_bd_pins axi_interconnect_122/M09_ACLK] [get_bd_pins axi_interconnect_122/M10_ACLK] [get_bd_pins axi_interconnect_lite/M01_ACLK] [get_bd_pins axi_interconnect_122/M11_ACLK] [get_bd_pins D_register_0/aclk] [get_bd_pins D_register_1/aclk] [get_bd_pins AXIL_SPIWriter_0/aclk] [get_bd_pins axi_interconnect_122/M12_ACLK] [get_bd_pins AXIL_ICAP_Reconfig_0/aclk]
   connect_bd_net -net clock_mon_1 [get_bd_pins clock_mon] [get_bd_pins xlconcat_3/In0]
   connect_bd_net -net pcb_version_id_1 [get_bd_pins pcb_version_id] [get_bd_pins util_vector_logic_6/Op1]
   connect_bd_net -net pci_clk_buf_IBUF_OUT [get_bd_pins pci_clk_buf/IBUF_OUT] [get_bd_pins xdma_0/sys_clk]
@@ -7214,7 +7232,7 @@ proc create_hier_cell_PCIe { parentCell nameHier } {
   connect_bd_net -net util_vector_logic_4_Res [get_bd_pins util_vector_logic_4/Res] [get_bd_pins DUCFIFORstn]
   connect_bd_net -net util_vector_logic_5_Res [get_bd_pins util_vector_logic_5/Res] [get_bd_pins DDCFIFORstn]
   connect_bd_net -net util_vector_logic_6_Res [get_bd_pins util_vector_logic_6/Res] [get_bd_pins c_addsub_0/A]
-  connect_bd_net -net xdma_0_axi_aresetn [get_bd_pins D_register_1/dout] [get_bd_pins AXIL_ReadReg_64_0/aresetn] [get_bd_pins AXIL_ConfigReg_256_2/aresetn] [get_bd_pins AXI_SPI_ADC_0/aresetn] [get_bd_pins AXI_FIFO_overflow_re_0/aresetn] [get_bd_pins AXIL_ConfigReg_64_1/aresetn] [get_bd_pins axi_interconnect_122/ARESETN] [get_bd_pins axi_interconnect_122/S00_ARESETN] [get_bd_pins axi_interconnect_122/M00_ARESETN] [get_bd_pins axi_interconnect_122/M01_ARESETN] [get_bd_pins axi_interconnect_122/M02_ARESETN] [get_bd_pins axi_interconnect_122/M03_ARESETN] [get_bd_pins axi_interconnect_122/M04_ARESETN] [get_bd_pins axi_interconnect_122/M05_ARESETN] [get_bd_pins axi_interconnect_122/M06_ARESETN] [get_bd_pins axi_interconnect_122/M07_ARESETN] [get_bd_pins axi_interconnect_122/M08_ARESETN] [get_bd_pins axi_interconnect_122/M09_ARESETN] [get_bd_pins axi_interconnect_122/M10_ARESETN] [get_bd_pins axi_interconnect_lite/M01_ARESETN] [get_bd_pins axi_interconnect_122/M11_ARESETN] [get_bd_pins AXIL_SPIWriter_0/aresetn]
+  connect_bd_net -net xdma_0_axi_aresetn [get_bd_pins D_register_1/dout] [get_bd_pins AXIL_ReadReg_64_0/aresetn] [get_bd_pins AXIL_ConfigReg_256_2/aresetn] [get_bd_pins AXI_SPI_ADC_0/aresetn] [get_bd_pins AXI_FIFO_overflow_re_0/aresetn] [get_bd_pins AXIL_ConfigReg_64_1/aresetn] [get_bd_pins axi_interconnect_122/ARESETN] [get_bd_pins axi_interconnect_122/S00_ARESETN] [get_bd_pins axi_interconnect_122/M00_ARESETN] [get_bd_pins axi_interconnect_122/M01_ARESETN] [get_bd_pins axi_interconnect_122/M02_ARESETN] [get_bd_pins axi_interconnect_122/M03_ARESETN] [get_bd_pins axi_interconnect_122/M04_ARESETN] [get_bd_pins axi_interconnect_122/M05_ARESETN] [get_bd_pins axi_interconnect_122/M06_ARESETN] [get_bd_pins axi_interconnect_122/M07_ARESETN] [get_bd_pins axi_interconnect_122/M08_ARESETN] [get_bd_pins axi_interconnect_122/M09_ARESETN] [get_bd_pins axi_interconnect_122/M10_ARESETN] [get_bd_pins axi_interconnect_lite/M01_ARESETN] [get_bd_pins axi_interconnect_122/M11_ARESETN] [get_bd_pins AXIL_SPIWriter_0/aresetn] [get_bd_pins axi_interconnect_122/M12_ARESETN] [get_bd_pins AXIL_ICAP_Reconfig_0/aresetn]
   connect_bd_net -net xdma_0_user_lnk_up [get_bd_pins xdma_0/user_lnk_up] [get_bd_pins util_vector_logic_0/Op1]
   connect_bd_net -net xlconcat_0_dout [get_bd_pins xlconcat_0/dout] [get_bd_pins AXIL_ReadReg_64_0/readdata0]
   connect_bd_net -net xlconcat_1_dout [get_bd_pins xlconcat_1/dout] [get_bd_pins AXIL_ReadReg_64_ID/readdata1]
@@ -8241,6 +8259,7 @@ proc create_hier_cell_ADC_LVDS_Pins { parentCell nameHier } {
   assign_bd_address -offset 0x0000A000 -range 0x00001000 -target_address_space [get_bd_addr_spaces PCIe/xdma_0/M_AXI_LITE] [get_bd_addr_segs PCIe/AXI_SPI_ADC_0/s_axi/reg0] -force
   assign_bd_address -offset 0x00009000 -range 0x00001000 -target_address_space [get_bd_addr_spaces PCIe/xdma_0/M_AXI_LITE] [get_bd_addr_segs FIFO_Interfaces/FIFO_Monitor_0/s_axi/reg0] -force
   assign_bd_address -offset 0x0000D000 -range 0x00001000 -target_address_space [get_bd_addr_spaces PCIe/xdma_0/M_AXI_LITE] [get_bd_addr_segs Wideband_Collect_0/s_axi/reg0] -force
+  assign_bd_address -offset 0x0000E000 -range 0x00001000 -target_address_space [get_bd_addr_spaces PCIe/xdma_0/M_AXI_LITE] [get_bd_addr_segs PCIe/AXIL_ICAP_Reconfig_0/s_axi/reg0] -force
   assign_bd_address -offset 0x0001C000 -range 0x00004000 -target_address_space [get_bd_addr_spaces PCIe/xdma_0/M_AXI_LITE] [get_bd_addr_segs Transmitter/IQ_Modulation_Select/axi_bram_ctrl_0/S_AXI/Mem0] -force
   assign_bd_address -offset 0x00010000 -range 0x00004000 -target_address_space [get_bd_addr_spaces PCIe/xdma_0/M_AXI_LITE] [get_bd_addr_segs PCIe/axi_quad_spi_0/AXI_LITE/Reg] -force
   assign_bd_address -offset 0x00018000 -range 0x00004000 -target_address_space [get_bd_addr_spaces PCIe/xdma_0/M_AXI_LITE] [get_bd_addr_segs PCIe/xadc_wiz_0/s_axi_lite/Reg] -force
@@ -18,17 +18,22 @@
 //  addr 8         Status register 3 (read only, with side effect)
 //  addr C         Status register 4 (read only, with side effect)
 //     bit(15:0)   Current FIFO Depth
+//     bit 28      1 if the depth has been at or below the low watermark
 //     bit 29      1 id an underflow has occurred, from depth
 //     bit 30      1 if an overflow has occurred, from depth 
 //     bit 31      1 if an overflow has occurred, from FIFO flag. 
-//     bits 29-31 Cleared by read.
+//     bits 28-31 Cleared by read.
 //
 //  addr 10         Control register 1 (read/write, with no read side effect)
 //  addr 14         Control register 1 (read/write, with no read side effect)
 //  addr 18         Control register 1 (read/write, with no read side effect)
 //  addr 1C         Control register 1 (read/write, with no read side effect)
-//     bit(15:0)   Threshold FIFO depth
+//     bit(15:0)   Threshold FIFO depth (high watermark)
+//     bit(30:16)  Low watermark FIFO depth. 0 = off (underflow still detected at 0)
 //     bit 31      Interrupt enable
+// the interrupt is raised by any latched status bit: overflow, over threshold,
+// underflow or at/below low watermark. A write FIFO can set its low watermark
+// so the interrupt wakes the processor when there is space for a DMA.
 //
 // FIFO Interface signals:
 //     FIFOn_Words(31:0)      current FIFO depth (note only 16 bits considered valid)
@@ -39,6 +44,7 @@
 // Revision:
 // Revision 0.01 - File Created
 // Revision 2 - update to latch underflow and overflow. remove "read or write FIFO" 
+// Revision 3 - add programmable low watermark, and its status bit (firmware V26)
 // Additional Comments:
 // 
 //////////////////////////////////////////////////////////////////////////////////
@@ -100,6 +106,8 @@ module FIFO_Monitor #
   reg fifo1_overflowed;                      // set true if FIFO has under/overflowed (from FIFO bit)
   reg fifo1_over_threshold;                  // set if FIFO exceeds threshold
   reg fifo1_underflowed;                     // set if FIFO emptied (from count)
+  reg [14:0] fifo1_low_watermark;            // writable register - low depth to trigger intr; 0 = off
+  reg fifo1_below_low;                       // set if FIFO at or below low watermark
   reg interrupt1_out;                        // interrupt bit out 
 
   reg [15:0] fifo2_threshold; // writable register - threshold to trigger intr
@@ -108,6 +116,8 @@ module FIFO_Monitor #
   reg fifo2_overflowed;                      // set true if FIFO has under/overflowed
   reg fifo2_over_threshold;                  // set if FIFO exceeds threshold
   reg fifo2_underflowed;                     // set if FIFO emptied (from count)
+  reg [14:0] fifo2_low_watermark;            // writable register - low depth to trigger intr; 0 = off
+  reg fifo2_below_low;                       // set if FIFO at or below low watermark
   reg interrupt2_out;                        // interrupt bit out 
 
   reg [15:0] fifo3_threshold; // writable register - threshold to trigger intr
@@ -116,6 +126,8 @@ module FIFO_Monitor #
   reg fifo3_overflowed;                      // set true if FIFO has under/overflowed
   reg fifo3_over_threshold;                  // set if FIFO exceeds threshold
   reg fifo3_underflowed;                     // set if FIFO emptied (from count)
+  reg [14:0] fifo3_low_watermark;            // writable register - low depth to trigger intr; 0 = off
+  reg fifo3_below_low;                       // set if FIFO at or below low watermark
   reg interrupt3_out;                        // interrupt bit out 
 
   reg [15:0] fifo4_threshold; // writable register - threshold to trigger intr
@@ -124,6 +136,8 @@ module FIFO_Monitor #
   reg fifo4_overflowed;                      // set true if FIFO has under/overflowed
   reg fifo4_over_threshold;                  // set if FIFO exceeds threshold
   reg fifo4_underflowed;                     // set if FIFO emptied (from count)
+  reg [14:0] fifo4_low_watermark;            // writable register - low depth to trigger intr; 0 = off
+  reg fifo4_below_low;                       // set if FIFO at or below low watermark
   reg interrupt4_out;                        // interrupt bit out 
 
   reg [AXI_ADDR_WIDTH-1:0] raddrreg;        // AXI read address register
@@ -189,6 +203,8 @@ module FIFO_Monitor #
       interrupt1_out <= 1'b0;
       fifo1_over_threshold <= 1'b0;
       fifo1_underflowed <= 1'b0;
+      fifo1_low_watermark <= 15'b0;
+      fifo1_below_low <= 1'b0;
 
       fifo2_threshold <= {32{1'b0}};                // zero the FIFO threshold
       int2_enable <= 1'b0;
@@ -196,6 +212,8 @@ module FIFO_Monitor #
       interrupt2_out <= 1'b0;
       fifo2_over_threshold <= 1'b0;
       fifo2_underflowed <= 1'b0;
+      fifo2_low_watermark <= 15'b0;
+      fifo2_below_low <= 1'b0;
 
       fifo3_threshold <= {32{1'b0}};                // zero the FIFO threshold
       int3_enable <= 1'b0;
@@ -203,6 +221,8 @@ module FIFO_Monitor #
       interrupt3_out <= 1'b0;
       fifo3_over_threshold <= 1'b0;
       fifo3_underflowed <= 1'b0;
+      fifo3_low_watermark <= 15'b0;
+      fifo3_below_low <= 1'b0;
 
       fifo4_threshold <= {32{1'b0}};                // zero the FIFO threshold
       int4_enable <= 1'b0;
@@ -210,6 +230,8 @@ module FIFO_Monitor #
       interrupt4_out <= 1'b0;
       fifo4_over_threshold <= 1'b0;
       fifo4_underflowed <= 1'b0;
+      fifo4_low_watermark <= 15'b0;
+      fifo4_below_low <= 1'b0;
     end
     else
     begin
@@ -226,7 +248,9 @@ module FIFO_Monitor #
         fifo1_over_threshold <= 1'b1;
       else if(fifo1_count_reg == 0)
         fifo1_underflowed <= 1'b1;
-      interrupt1_out <= (int1_enable & (fifo1_overflowed | fifo1_over_threshold | fifo1_underflowed));
+      if((fifo1_low_watermark != 0) && (fifo1_count_reg <= fifo1_low_watermark))
+        fifo1_below_low <= 1'b1;
+      interrupt1_out <= (int1_enable & (fifo1_overflowed | fifo1_over_threshold | fifo1_underflowed | fifo1_below_low));
 //
 // FIFO 2
 //
@@ -238,7 +262,9 @@ module FIFO_Monitor #
         fifo2_over_threshold <= 1'b1;
       else if(fifo2_count_reg == 0)
         fifo2_underflowed <= 1'b1;
-      interrupt2_out <= (int2_enable & (fifo2_overflowed | fifo2_over_threshold | fifo2_underflowed));
+      if((fifo2_low_watermark != 0) && (fifo2_count_reg <= fifo2_low_watermark))
+        fifo2_below_low <= 1'b1;
+      interrupt2_out <= (int2_enable & (fifo2_overflowed | fifo2_over_threshold | fifo2_underflowed | fifo2_below_low));
 //
 // FIFO 3
 //
@@ -250,7 +276,9 @@ module FIFO_Monitor #
         fifo3_over_threshold <= 1'b1;
       else if(fifo3_count_reg == 0)
         fifo3_underflowed <= 1'b1;
-      interrupt3_out <= (int3_enable & (fifo3_overflowed | fifo3_over_threshold | fifo3_underflowed));
+      if((fifo3_low_watermark != 0) && (fifo3_count_reg <= fifo3_low_watermark))
+        fifo3_below_low <= 1'b1;
+      interrupt3_out <= (int3_enable & (fifo3_overflowed | fifo3_over_threshold | fifo3_underflowed | fifo3_below_low));
 //
 // FIFO 4
 //
@@ -262,7 +290,9 @@ module FIFO_Monitor #
         fifo4_over_threshold <= 1'b1;
       else if(fifo4_count_reg == 0)
         fifo4_underflowed <= 1'b1;
-      interrupt4_out <= (int4_enable & (fifo4_overflowed | fifo4_over_threshold | fifo4_underflowed));
+      if((fifo4_low_watermark != 0) && (fifo4_count_reg <= fifo4_low_watermark))
+        fifo4_below_low <= 1'b1;
+      interrupt4_out <= (int4_enable & (fifo4_overflowed | fifo4_over_threshold | fifo4_underflowed | fifo4_below_low));
 
 //
 // implement read transactions
@@ -277,29 +307,29 @@ module FIFO_Monitor #
       begin
         rvalidreg <= 1'b1;                                  // signal ready to complete data
         case (raddrreg[4:2])
-        0:  rdatareg <= {fifo1_overflowed, fifo1_over_threshold, fifo1_underflowed,
-                    {(AXI_DATA_WIDTH - 19){1'b0}}, 
+        0:  rdatareg <= {fifo1_overflowed, fifo1_over_threshold, fifo1_underflowed, fifo1_below_low,
+                    {(AXI_DATA_WIDTH - 20){1'b0}}, 
                     fifo1_count_reg};                        // concat data
-        1:  rdatareg <= {fifo2_overflowed, fifo2_over_threshold, fifo2_underflowed,
-                    {(AXI_DATA_WIDTH - 19){1'b0}}, 
+        1:  rdatareg <= {fifo2_overflowed, fifo2_over_threshold, fifo2_underflowed, fifo2_below_low,
+                    {(AXI_DATA_WIDTH - 20){1'b0}}, 
                     fifo2_count_reg};                        // concat data
-        2:  rdatareg <= {fifo3_overflowed, fifo3_over_threshold, fifo3_underflowed,
-                    {(AXI_DATA_WIDTH - 19){1'b0}}, 
+        2:  rdatareg <= {fifo3_overflowed, fifo3_over_threshold, fifo3_underflowed, fifo3_below_low,
+                    {(AXI_DATA_WIDTH - 20){1'b0}}, 
                     fifo3_count_reg};                        // concat data
-        3:  rdatareg <= {fifo4_overflowed, fifo4_over_threshold, fifo4_underflowed,
-                    {(AXI_DATA_WIDTH - 19){1'b0}}, 
+        3:  rdatareg <= {fifo4_overflowed, fifo4_over_threshold, fifo4_underflowed, fifo4_below_low,
+                    {(AXI_DATA_WIDTH - 20){1'b0}}, 
                     fifo4_count_reg};                        // concat data
         4: rdatareg <= {int1_enable,  
-                    {(AXI_DATA_WIDTH - 16 - 1){1'b0}}, 
+                    fifo1_low_watermark, 
                     fifo1_threshold};                        //concat 
         5: rdatareg <= {int2_enable,  
-                    {(AXI_DATA_WIDTH - 16 - 1){1'b0}}, 
+                    fifo2_low_watermark, 
                     fifo2_threshold};                        //concat 
         6: rdatareg <= {int3_enable,  
-                    {(AXI_DATA_WIDTH - 16 - 1){1'b0}}, 
+                    fifo3_low_watermark, 
                     fifo3_threshold};                        //concat 
         7: rdatareg <= {int4_enable,  
-                    {(AXI_DATA_WIDTH - 16 - 1){1'b0}}, 
+                    fifo4_low_watermark, 
                     fifo4_threshold};                        //concat 
         endcase
       end
@@ -314,24 +344,28 @@ module FIFO_Monitor #
                 fifo1_overflowed <= 0; 
                 fifo1_over_threshold <= 0; 
                 fifo1_underflowed <= 0; 
+                fifo1_below_low <= 0; 
           end             // clear on data transfer
 
           1: begin 
                 fifo2_overflowed <= 0; 
                 fifo2_over_threshold <= 0; 
                 fifo2_underflowed <= 0; 
+                fifo2_below_low <= 0; 
           end             // clear on data transfer
 
           2: begin 
                 fifo3_overflowed <= 0; 
                 fifo3_over_threshold <= 0; 
                 fifo3_underflowed <= 0; 
+                fifo3_below_low <= 0; 
           end             // clear on data transfer
 
           3: begin 
                 fifo4_overflowed <= 0; 
                 fifo4_over_threshold <= 0; 
                 fifo4_underflowed <= 0; 
+                fifo4_below_low <= 0; 
           end             // clear on data transfer
         endcase
       end
@@ -368,18 +402,22 @@ module FIFO_Monitor #
         case (waddrreg[4:2])
           4: begin
                fifo1_threshold <= ( wdatareg & {16{1'b1}});      // subset
+               fifo1_low_watermark <= (wdatareg >> 16) & {15{1'b1}};
                int1_enable <= (wdatareg >> (AXI_DATA_WIDTH-1)) & 1'b1;
              end
           5: begin
                fifo2_threshold <= ( wdatareg & {16{1'b1}});      // subset
+               fifo2_low_watermark <= (wdatareg >> 16) & {15{1'b1}};
                int2_enable <= (wdatareg >> (AXI_DATA_WIDTH-1)) & 1'b1;
              end
           6: begin
                fifo3_threshold <= ( wdatareg & {16{1'b1}});      // subset
+               fifo3_low_watermark <= (wdatareg >> 16) & {15{1'b1}};
                int3_enable <= (wdatareg >> (AXI_DATA_WIDTH-1)) & 1'b1;
              end
           7: begin
                fifo4_threshold <= ( wdatareg & {16{1'b1}});      // subset
+               fifo4_low_watermark <= (wdatareg >> 16) & {15{1'b1}};
                int4_enable <= (wdatareg >> (AXI_DATA_WIDTH-1)) & 1'b1;
              end
         endcase
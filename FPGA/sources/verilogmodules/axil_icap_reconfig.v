@@ -0,0 +1,287 @@
+//////////////////////////////////////////////////////////////////////////////////
+// Company:        HPSDR
+// Engineer:       Laurence Barker G8NJJ
+//
+// Create Date:    14.10.2026
+// Design Name:    axil_icap_reconfig.v
+// Module Name:    AXIL_ICAP_Reconfig
+// Project Name:   Saturn
+// Target Devices: Artix 7
+// Tool Versions:  Vivado
+// Description:    Warm reconfiguration of the FPGA from flash, by issuing the
+//                 IPROG command through ICAPE2 with the warm boot start
+//                 address (WBSTAR) set by software. Used to load a new primary
+//                 image, or repeat the power up multiboot sequence, without a
+//                 power cycle.
+//
+//                 the reconfiguration is armed with a delay, so that the host
+//                 can remove the PCIe device before the link drops; the host
+//                 then rescans the bus once the new image has configured.
+//
+// Registers:
+//  addr 0         warm boot flash byte address (R/W). bits 7:0 are ignored:
+//                 WBSTAR holds address bits 31:8 in SPI 32 bit address mode
+//  addr 4         control (write):
+//                   bits 31:16 = VKEY to arm, with bits 14:0 the delay in ms
+//                   before IPROG is sent; any other value cancels
+//                 status (read):
+//                   bits 31:16 = VKEY (identifies the module)
+//                   bit 15 = armed
+//                   bits 14:0 = ms remaining until IPROG is sent
+//
+// the ICAP clock is aclk/2, so that aclk can be above the 100MHz ICAPE2 limit.
+// Its data changes as the ICAP clock falls, a half period before it is sampled.
+//
+// Dependencies:   ICAPE2 primitive
+//
+// Revision:
+// Revision 0.01 - File Created
+// Additional Comments:
+//
+//////////////////////////////////////////////////////////////////////////////////
+
+
+`timescale 1 ns / 1 ps
+
+module AXIL_ICAP_Reconfig #
+(
+  parameter integer AXI_DATA_WIDTH = 32,
+  parameter integer AXI_ADDR_WIDTH = 16,
+  parameter integer CLOCKS_PER_MS = 122880      // aclk cycles in 1ms
+)
+(
+  // System signals
+  input  wire                      aclk,
+  input  wire                      aresetn,
+
+  // AXI bus Slave
+  input  wire [AXI_ADDR_WIDTH-1:0] s_axi_awaddr,  // AXI4-Lite slave: Write address
+  input  wire                      s_axi_awvalid, // AXI4-Lite slave: Write address valid
+  output wire                      s_axi_awready, // AXI4-Lite slave: Write address ready
+  input  wire [AXI_DATA_WIDTH-1:0] s_axi_wdata,   // AXI4-Lite slave: Write data
+  input  wire                      s_axi_wvalid,  // AXI4-Lite slave: Write data valid
+  output wire                      s_axi_wready,  // AXI4-Lite slave: Write data ready
+  output wire [1:0]                s_axi_bresp,   // AXI4-Lite slave: Write response
+  output wire                      s_axi_bvalid,  // AXI4-Lite slave: Write response valid
+  input  wire                      s_axi_bready,  // AXI4-Lite slave: Write response ready
+  input  wire [AXI_ADDR_WIDTH-1:0] s_axi_araddr,  // AXI4-Lite slave: Read address
+  input  wire                      s_axi_arvalid, // AXI4-Lite slave: Read address valid
+  output wire                      s_axi_arready, // AXI4-Lite slave: Read address ready
+  output wire [AXI_DATA_WIDTH-1:0] s_axi_rdata,   // AXI4-Lite slave: Read data
+  output wire [1:0]                s_axi_rresp,   // AXI4-Lite slave: Read data response
+  output wire                      s_axi_rvalid,  // AXI4-Lite slave: Read data valid
+  input  wire                      s_axi_rready   // AXI4-Lite slave: Read data ready
+);
+
+  localparam [15:0] VKEY = 16'h1CA9;
+
+  reg [AXI_ADDR_WIDTH-1:0] raddrreg;        // AXI read address register
+  reg [AXI_ADDR_WIDTH-1:0] waddrreg;        // AXI write address register
+  reg [AXI_DATA_WIDTH-1:0] rdatareg;        // AXI read data register
+  reg [AXI_DATA_WIDTH-1:0] wdatareg;        // AXI write data register
+  reg arreadyreg;                           // false when write address has been latched
+  reg rvalidreg;                            // true when read data out is valid
+  reg awreadyreg;                            // false when write address has been latched
+  reg wreadyreg;                             // false when write data has been latched
+  reg bvalidreg;                             // goes true when address and data completed
+
+  reg [31:0] bootaddress;                   // warm boot flash address
+  reg armed;                                // counting down to IPROG
+  reg [14:0] delayms;                       // ms remaining
+  reg [31:0] mscounter;                     // aclk cycles to the next ms
+  reg sending;                              // IPROG sequence being written to ICAP
+  reg [3:0] wordcount;                      // sequence word being written
+  reg icapclk;                              // ICAP clock, aclk/2
+  reg icapcsib;                             // ICAP enable, active low
+  reg [31:0] icapdata;                      // ICAP data, before bit swapping
+  wire [31:0] icapswapped;                  // ICAP data, each byte bit reversed
+
+
+// assign AXI outputs from registered internals, and read/write complete OK
+  assign s_axi_rdata = rdatareg;
+  assign s_axi_arready = arreadyreg;
+  assign s_axi_rvalid = rvalidreg;
+  assign s_axi_awready = awreadyreg;
+  assign s_axi_wready = wreadyreg;
+  assign s_axi_bvalid = bvalidreg;
+  assign s_axi_rresp = 2'd0;
+  assign s_axi_bresp = 2'd0;
+
+
+//
+// the IPROG sequence (UG470 "IPROG using ICAPE2"): dummy, sync, NOOP,
+// write WBSTAR, write CMD IPROG, NOOP
+//
+  function [31:0] iprogword;
+    input [3:0] index;
+    input [31:0] address;
+    begin
+      case(index)
+        4'd0: iprogword = 32'hFFFFFFFF;             // dummy word
+        4'd1: iprogword = 32'hAA995566;             // sync word
+        4'd2: iprogword = 32'h20000000;             // NOOP
+        4'd3: iprogword = 32'h30020001;             // type 1 write 1 word to WBSTAR
+        4'd4: iprogword = {8'h00, address[31:8]};   // warm boot start address
+        4'd5: iprogword = 32'h30008001;             // type 1 write 1 word to CMD
+        4'd6: iprogword = 32'h0000000F;             // IPROG
+        default: iprogword = 32'h20000000;          // NOOP
+      endcase
+    end
+  endfunction
+
+
+//
+// ICAP data bits are reversed within each byte
+//
+  genvar n;
+  generate
+    for (n = 0; n < 8; n = n + 1)
+    begin: swap
+      assign icapswapped[n]      = icapdata[7 - n];
+      assign icapswapped[8 + n]  = icapdata[15 - n];
+      assign icapswapped[16 + n] = icapdata[23 - n];
+      assign icapswapped[24 + n] = icapdata[31 - n];
+    end
+  endgenerate
+
+  ICAPE2 #
+  (
+    .ICAP_WIDTH("X32")
+  )
+  ICAPE2_inst
+  (
+    .O(),
+    .CLK(icapclk),
+    .CSIB(icapcsib),
+    .I(icapswapped),
+    .RDWRB(1'b0)
+  );
+
+
+
+  always @(posedge aclk)
+  begin
+    if(~aresetn)
+    begin
+// reset to start states
+      rdatareg <= {(AXI_DATA_WIDTH){1'b0}};
+      arreadyreg <= 1'b1;                           // ready for address transfer
+      rvalidreg <= 1'b0;                            // not ready to transfer read data
+      awreadyreg  <= 1'b1;              // initialise to write address ready
+      wreadyreg  <= 1'b1;               // initialise to write data ready
+      bvalidreg <= 1'b0;                // initialise to "not ready to complete"
+      bootaddress <= 32'h0;
+      armed <= 1'b0;
+      delayms <= 15'h0;
+      mscounter <= 32'h0;
+      sending <= 1'b0;
+      wordcount <= 4'h0;
+      icapclk <= 1'b0;
+      icapcsib <= 1'b1;
+      icapdata <= 32'hFFFFFFFF;
+    end
+    else
+    begin
+
+// implement read transactions
+// read step 2. read address transaction: latch when arvalid and arready both true
+      if(s_axi_arvalid & arreadyreg)
+      begin
+        arreadyreg <= 1'b0;                  // clear when address transaction happens
+        raddrreg <= s_axi_araddr;            // latch read address
+      end
+// read step 3. assert rvalid & data when address is complete
+      if(!arreadyreg)         // address complete
+      begin
+        rvalidreg <= 1'b1;                                  // signal ready to complete data
+        if(raddrreg[2]==1)
+          rdatareg <= {VKEY, armed, delayms};
+        else
+          rdatareg <= bootaddress;
+      end
+// read step 4. When rvalid and rready, terminate the transaction & clear data.
+      if(rvalidreg & s_axi_rready)
+      begin
+        rvalidreg <= 1'b0;                                  // deassert rvalid
+        arreadyreg <= 1'b1;                                 // ready for new address
+        rdatareg <= {(AXI_DATA_WIDTH){1'b0}};
+      end
+
+
+// write step 2 address transaction: latch when awvalid and awready both true
+      if(s_axi_awvalid & awreadyreg)
+      begin
+        waddrreg <= s_axi_awaddr;            // latch write address
+        awreadyreg <= 1'b0;                  // clear when address transaction happens
+      end
+
+// write step 3 data transaction:   latch when wvalid and wready both true
+      if(s_axi_wvalid & wreadyreg)
+      begin
+        wdatareg <= s_axi_wdata;             // latch write data
+        wreadyreg <= 1'b0;                   // clear when address transaction happens
+      end
+
+// detect data transaction and address transaction completed
+      if (( s_axi_awvalid & awreadyreg & s_axi_wvalid & wreadyreg)      // both address and data complete at same time
+       || (!wreadyreg & s_axi_awvalid & awreadyreg)                     // data completed, and address completes
+       || (!awreadyreg & s_axi_wvalid & wreadyreg))                     // address completed, and data completes
+       begin
+         bvalidreg <= 1'b1;
+       end
+
+// detect cycle complete by bready asserted too; transfer data.
+// arming loads the countdown; once the sequence has started it can't be cancelled
+      if(bvalidreg & s_axi_bready)
+      begin
+        bvalidreg <= 1'b0;                                  // clear valid when done
+        awreadyreg <= 1'b1;                                 // and reassert the readys
+        wreadyreg <= 1'b1;
+        if(waddrreg[2]==0)
+          bootaddress <= wdatareg;
+        else if(!sending)
+        begin
+          armed <= (wdatareg[31:16] == VKEY);
+          delayms <= wdatareg[14:0];
+          mscounter <= CLOCKS_PER_MS;
+        end
+      end
+      else if(armed && !sending)
+      begin
+// count down the delay, then start the sequence
+        if(mscounter != 0)
+          mscounter <= mscounter - 1;
+        else if(delayms != 0)
+        begin
+          delayms <= delayms - 1;
+          mscounter <= CLOCKS_PER_MS;
+        end
+        else
+        begin
+          sending <= 1'b1;
+          wordcount <= 4'h0;
+        end
+      end
+
+// ICAP interface: the clock toggles every aclk; data changes as it falls
+      icapclk <= ~icapclk;
+      if(icapclk)
+      begin
+        if(sending)
+        begin
+          icapcsib <= 1'b0;
+          icapdata <= iprogword(wordcount, bootaddress);
+          if(wordcount != 4'd7)
+            wordcount <= wordcount + 1;
+        end
+        else
+        begin
+          icapcsib <= 1'b1;
+          icapdata <= 32'hFFFFFFFF;
+        end
+      end
+    end         // if(!aresetn)
+  end           // always @
+
+
+endmodule
@@ -1,6 +1,6 @@
 #!/bin/bash
-# create_files.sh - Creates index.html, saturn_update_manager.py, config.json, themes.json, and SaturnUpdateManager.desktop
-# Version: 1.5
+# create_files.sh - Creates index.html, performance.html, saturn_update_manager.py, config.json, themes.json, and SaturnUpdateManager.desktop
+# Version: 1.6
 # Written by: Jerry DeLong KD4YAL
 # Dependencies: bash
 # Usage: Called by setup_saturn_webserver.sh
@@ -15,6 +15,7 @@ DESKTOP_FILE="$SCRIPTS_DIR/SaturnUpdateManager.desktop"
 DESKTOP_DEST="/home/pi/github/Saturn/desktop/SaturnUpdateManager.desktop"
 SATURN_SCRIPT="$SCRIPTS_DIR/saturn_update_manager.py"
 INDEX_HTML="$TEMPLATES_DIR/index.html"
+PERFORMANCE_HTML="$TEMPLATES_DIR/performance.html"
 CONFIG_JSON="$SCRIPTS_DIR/config.json"
 THEMES_JSON="$SCRIPTS_DIR/themes.json"
 LOG_CLEANER_SCRIPT="$SCRIPTS_DIR/log_cleaner.sh"
@@ -258,6 +259,7 @@ cat > "$INDEX_HTML" << 'EOF'
                 <div class="flex justify-center space-x-4">
                     <button type="submit" class="btn-primary text-white px-4 py-2 rounded hover:brightness-90 sm:px-6 sm:py-3">Run</button>
                     <button type="button" id="change-password-btn" class="btn-secondary text-white px-4 py-2 rounded hover:brightness-90 sm:px-6 sm:py-3">Change Password</button>
+                    <a href="/saturn/performance" class="btn-secondary text-white px-4 py-2 rounded hover:brightness-90 sm:px-6 sm:py-3">Performance</a>
                     <button type="button" id="exit-btn" class="btn-primary text-white px-4 py-2 rounded hover:brightness-90 sm:px-6 sm:py-3">Exit</button>
                 </div>
             </form>
@@ -751,14 +753,228 @@ if ! grep -q "Saturn Update Manager" "$INDEX_HTML" || ! grep -q "script-form" "$
 fi
 log_and_echo "${GREEN}Verified index.html content${NC}"
 
+# Create performance.html (overwriting if exists)...
+log_and_echo "${CYAN}Creating performance.html in $TEMPLATES_DIR (overwriting if exists)...${NC}"
+rm -f "$PERFORMANCE_HTML"
+cat > "$PERFORMANCE_HTML" << 'EOF'
+<!DOCTYPE html>
+<html lang="en">
+<head>
+    <meta charset="UTF-8">
+    <meta name="viewport" content="width=device-width, initial-scale=1.0">
+    <title>Saturn Performance</title>
+    <script src="https://cdn.tailwindcss.com"></script>
+    <style>
+        :root {
+            --bg-color: #f3f4f6;
+            --text-color: #333333;
+            --primary-color: #3b82f6;
+            --secondary-color: #10b981;
+        }
+        body {
+            background-color: var(--bg-color);
+            color: var(--text-color);
+            font-family: -apple-system, BlinkMacSystemFont, 'Segoe UI', Roboto, sans-serif;
+        }
+        .btn-primary {
+            background-color: var(--primary-color);
+        }
+        .container { max-width: 1000px; }
+        table { width: 100%; border-collapse: collapse; }
+        th, td { padding: 0.25rem 0.5rem; text-align: right; border-bottom: 1px solid #e5e7eb; }
+        th:first-child, td:first-child { text-align: left; }
+        .alert { color: #dc2626; font-weight: 600; }
+        canvas { width: 100%; height: 80px; background-color: #ffffff; border: 1px solid #e5e7eb; }
+        @media (max-width: 640px) {
+            .container { padding: 1rem; }
+            th, td { padding: 0.25rem; font-size: 0.875rem; }
+        }
+    </style>
+</head>
+<body>
+    <div class="container mx-auto p-4 sm:p-6">
+        <h1 class="text-3xl font-bold text-red-600 text-center mb-2">Saturn Performance</h1>
+        <p id="status" class="text-lg text-gray-600 text-center mb-4">Connecting to p2app...</p>
+
+        <div class="bg-white rounded-lg shadow-md p-4 mb-4">
+            <h2 class="text-xl font-semibold text-gray-700 mb-2">Streams</h2>
+            <table>
+                <thead>
+                    <tr><th>Stream</th><th>Packets/s</th><th>DMA kB/s</th><th>DMA size</th><th>FIFO at DMA (words)</th>
+                        <th>Loop (us)</th><th>Over threshold</th><th>Underflow</th><th>Send errors</th><th>Seq gaps</th><th>Deadline misses</th><th>Buffers kB</th></tr>
+                </thead>
+                <tbody id="stream-table"></tbody>
+            </table>
+            <p class="text-sm text-gray-500 mt-2">Rates and averages are over the last update; event counts are totals, in red if they rose.</p>
+        </div>
+
+        <div class="bg-white rounded-lg shadow-md p-4 mb-4">
+            <h2 class="text-xl font-semibold text-gray-700 mb-2">FIFO Occupancy</h2>
+            <p id="fifo-note" class="text-sm text-gray-500 mb-2"></p>
+            <div id="fifo-charts" class="grid grid-cols-1 sm:grid-cols-2 gap-4"></div>
+        </div>
+
+        <div class="grid grid-cols-1 sm:grid-cols-2 gap-4 mb-4">
+            <div class="bg-white rounded-lg shadow-md p-4">
+                <h2 class="text-xl font-semibold text-gray-700 mb-2">CPU per Thread</h2>
+                <table>
+                    <thead><tr><th>Thread</th><th>CPU</th><th>%</th></tr></thead>
+                    <tbody id="thread-table"></tbody>
+                </table>
+            </div>
+            <div class="bg-white rounded-lg shadow-md p-4">
+                <h2 class="text-xl font-semibold text-gray-700 mb-2">Temperatures</h2>
+                <ul id="temperature-list" class="list-disc pl-5 text-gray-600"></ul>
+            </div>
+        </div>
+
+        <div class="flex justify-center">
+            <a href="/saturn/" class="btn-primary text-white px-4 py-2 rounded hover:brightness-90 sm:px-6 sm:py-3">Back to Update Manager</a>
+        </div>
+    </div>
+
+    <script>
+        const POLL_MS = 2000;
+        let previous = null;
+
+        function delta(now, before, key) {
+            return before ? now[key] - before[key] : 0;
+        }
+
+        function histogramAverage(now, before) {
+            const count = now.count - (before ? before.count : 0);
+            const sum = now.sum - (before ? before.sum : 0);
+            return count > 0 ? (sum / count).toFixed(0) : '-';
+        }
+
+        function eventCell(now, before, key) {
+            const rose = before && now[key] > before[key];
+            return `<td class="${rose ? 'alert' : ''}">${now[key]}</td>`;
+        }
+
+        function showStreams(data) {
+            const seconds = previous ? data.time - previous.time : 0;
+            const rows = [];
+            Object.entries(data.streams).forEach(([name, s]) => {
+                const p = previous ? previous.streams[name] : null;
+                const packets = seconds > 0 ? (delta(s, p, 'packets') / seconds).toFixed(0) : '-';
+                const kbytes = seconds > 0 ? (delta(s, p, 'dma_bytes') / seconds / 1000).toFixed(1) : '-';
+                rows.push(`<tr><td>${name}</td><td>${packets}</td><td>${kbytes}</td>` +
+                    `<td>${histogramAverage(s.dma_size_bytes, p ? p.dma_size_bytes : null)}</td>` +
+                    `<td>${histogramAverage(s.fifo_depth_words, p ? p.fifo_depth_words : null)}</td>` +
+                    `<td>${histogramAverage(s.loop_time_us, p ? p.loop_time_us : null)}</td>` +
+                    eventCell(s, p, 'over_threshold') + eventCell(s, p, 'underflows') +
+                    eventCell(s, p, 'send_errors') + eventCell(s, p, 'sequence_gaps') +
+                    eventCell(s, p, 'deadline_misses') +
+                    `<td>${(s.buffer_bytes / 1024).toFixed(0)}</td></tr>`);
+            });
+            document.getElementById('stream-table').innerHTML = rows.join('');
+        }
+
+        function drawHistogram(canvas, fifo) {
+            const context = canvas.getContext('2d');
+            const width = canvas.width = canvas.clientWidth;
+            const height = canvas.height = canvas.clientHeight;
+            const largest = Math.max(1, ...fifo.buckets);
+            const barWidth = width / fifo.buckets.length;
+            context.clearRect(0, 0, width, height);
+            context.fillStyle = getComputedStyle(document.documentElement).getPropertyValue('--primary-color') || '#3b82f6';
+            fifo.buckets.forEach((count, bucket) => {
+                const barHeight = count > 0 ? Math.max(1, height * count / largest) : 0;
+                context.fillRect(bucket * barWidth, height - barHeight, Math.max(1, barWidth - 1), barHeight);
+            });
+        }
+
+        function showFIFOs(data) {
+            const charts = document.getElementById('fifo-charts');
+            if (!data.fifo_sample_rate) {
+                document.getElementById('fifo-note').textContent =
+                    'FIFO sampling is off: start p2app with -o <rate> (eg -o 1000) as well as -n to see occupancy histograms.';
+                charts.innerHTML = '';
+                return;
+            }
+            document.getElementById('fifo-note').textContent =
+                `Occupancy since p2app started, sampled ${data.fifo_sample_rate} times per second; left is empty, right is full.`;
+            Object.entries(data.fifo).forEach(([name, fifo]) => {
+                let panel = document.getElementById(`fifo-${name}`);
+                if (!panel) {
+                    panel = document.createElement('div');
+                    panel.id = `fifo-${name}`;
+                    panel.innerHTML = `<p class="font-medium text-gray-700"></p><canvas></canvas>`;
+                    charts.appendChild(panel);
+                }
+                const mean = fifo.count > 0 ? (fifo.sum / fifo.count).toFixed(0) : '-';
+                panel.querySelector('p').textContent =
+                    `${name}: min ${fifo.min}, mean ${mean}, max ${fifo.max} of ${fifo.depth} locations`;
+                drawHistogram(panel.querySelector('canvas'), fifo);
+            });
+        }
+
+        function showThreads(data) {
+            const seconds = previous ? data.time - previous.time : 0;
+            const before = {};
+            if (previous) {
+                previous.threads.forEach(t => { before[t.tid] = t.cpu_ticks; });
+            }
+            const rows = data.threads.map(t => {
+                const used = (seconds > 0 && t.tid in before) ? t.cpu_ticks - before[t.tid] : null;
+                const percent = used === null ? null : 100 * used / data.ticks_per_second / seconds;
+                return { name: t.name, processor: t.processor, percent: percent };
+            });
+            rows.sort((a, b) => (b.percent || 0) - (a.percent || 0));
+            document.getElementById('thread-table').innerHTML = rows.map(r =>
+                `<tr><td>${r.name}</td><td>${r.processor}</td><td>${r.percent === null ? '-' : r.percent.toFixed(1)}</td></tr>`).join('');
+        }
+
+        function showTemperatures(data) {
+            const list = document.getElementById('temperature-list');
+            if (!data.temperature) {
+                list.innerHTML = '<li>not read yet</li>';
+                return;
+            }
+            list.innerHTML = `<li>FPGA die: ${data.temperature.fpga.toFixed(1)}&deg;C</li>` +
+                `<li>CPU: ${data.temperature.cpu.toFixed(1)}&deg;C</li>` +
+                `<li>CPU governor: ${data.performance_mode ? 'performance (SDR active)' : 'normal'}</li>`;
+        }
+
+        async function poll() {
+            try {
+                const response = await fetch('/saturn/p2app_metrics', { headers: { 'Cache-Control': 'no-cache' } });
+                const data = await response.json();
+                if (!response.ok) {
+                    throw new Error(data.message || `HTTP ${response.status}`);
+                }
+                showStreams(data);
+                showFIFOs(data);
+                showThreads(data);
+                showTemperatures(data);
+                previous = data;
+                document.getElementById('status').textContent = `Updated ${new Date().toLocaleTimeString()}`;
+            } catch (error) {
+                console.error('Metrics fetch error:', error);
+                previous = null;
+                document.getElementById('status').textContent = `p2app metrics not available: ${error.message}`;
+            }
+            setTimeout(poll, POLL_MS);
+        }
+
+        poll();
+    </script>
+</body>
+</html>
+EOF
+chmod 644 "$PERFORMANCE_HTML"
+chown pi:pi "$PERFORMANCE_HTML"
+log_and_echo "${GREEN}performance.html created${NC}"
+
 # Create saturn_update_manager.py (overwriting if exists)...
 rm -f "$SATURN_SCRIPT"
 cat > "$SATURN_SCRIPT" << 'EOF'
 #!/usr/bin/env python3
 # saturn_update_manager.py - Web-based Update Manager for various scripts via config.json and themes via themes.json
-# Version: 2.22
+# Version: 2.23
 # Written by: Jerry DeLong KD4YAL
-# Dependencies: flask, ansi2html (1.9.2), subprocess, os, threading, logging, re, shutil, select, urllib.error, json
+# Dependencies: flask, ansi2html (1.9.2), subprocess, os, threading, logging, re, shutil, select, urllib.error, urllib.request, json
 # Usage: . ~/venv/bin/activate; gunicorn -w 1 -b 0.0.0.0:5000 -t 600 saturn_update_manager:app
 
 import logging
@@ -775,6 +991,7 @@ import sys
 import time
 import select
 import urllib.error
+import urllib.request
 import json
 from flask import Flask, render_template, request, Response, jsonify
 from ansi2html import Ansi2HTMLConverter
@@ -791,6 +1008,9 @@ logging.basicConfig(
 )
 logging.info("Initializing Saturn Update Manager")
 
+P2APP_METRICS_PORT = os.environ.get('P2APP_METRICS_PORT', '9100')
+P2APP_METRICS_URL = os.environ.get('P2APP_METRICS_URL', f"http://127.0.0.1:{P2APP_METRICS_PORT}/metrics.json")
+
 app = Flask(__name__, template_folder=os.path.join(Path.home(), 'scripts', 'templates'))
 shutdown_event = threading.Event()
 
@@ -805,14 +1025,14 @@ class SaturnUpdateManager:
         self.config = []
         self.themes = []
         self.versions = {
-            "saturn_update_manager.py": "2.22"
+            "saturn_update_manager.py": "2.23"
         }
         self.process = None
         self.backup_response = None
         self.running = False
         self.output_lock = threading.Lock()
         self.converter = Ansi2HTMLConverter(inline=True)
-        logging.info(f"Starting Saturn Update Manager v2.22")
+        logging.info(f"Starting Saturn Update Manager v2.23")
 
         error_message = self.validate_setup()
         if error_message:
@@ -1242,6 +1462,31 @@ def get_versions():
     response.headers['Expires'] = '0'
     return response, 200
 
+@app.route('/saturn/performance')
+def performance():
+    logging.debug(f"Serving performance page for /saturn/performance, client: {request.remote_addr}")
+    try:
+        return render_template('performance.html')
+    except Exception as e:
+        logging.error(f"Error rendering performance.html: {str(e)}")
+        return f"Error rendering performance.html: {str(e)}", 500
+
+@app.route('/saturn/p2app_metrics', methods=['GET'])
+def p2app_metrics():
+    # p2app serves its metrics only when started with -n <port>
+    try:
+        with urllib.request.urlopen(P2APP_METRICS_URL, timeout=2) as reply:
+            response = Response(reply.read(), mimetype='application/json')
+        status = 200
+    except (urllib.error.URLError, OSError) as e:
+        logging.debug(f"p2app metrics not available at {P2APP_METRICS_URL}: {str(e)}")
+        response = jsonify({"status": "error", "message": f"no reply from {P2APP_METRICS_URL} - is p2app running with -n {P2APP_METRICS_PORT}?"})
+        status = 503
+    response.headers['Cache-Control'] = 'no-cache, no-store, must-revalidate'
+    response.headers['Pragma'] = 'no-cache'
+    response.headers['Expires'] = '0'
+    return response, status
+
 @app.route('/saturn/get_flags', methods=['GET'])
 def get_flags():
     filename = request.args.get('script')
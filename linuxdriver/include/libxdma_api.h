@@ -137,6 +137,22 @@ ssize_t xdma_xfer_submit_nowait(void *cb_hndl, void *dev_hndl, int channel, bool
 			struct sg_table *sgt, bool dma_mapped, int timeout_ms);
 
 
+/*
+ * xdma_xfer_submit_vec - blocking AXI-MM transfer of several buffers, each
+ *	to/from its own FPGA address, run as one chained descriptor list
+ * @segs: sg table (not yet dma mapped) and FPGA address for each buffer
+ * @nsegs: number of entries in segs
+ * return # of bytes transfered or < 0 in case of error
+ */
+struct xdma_vec_seg {
+	struct sg_table *sgt;
+	u64 ep_addr;
+};
+
+ssize_t xdma_xfer_submit_vec(void *dev_hndl, int channel, bool write,
+			struct xdma_vec_seg *segs, unsigned int nsegs,
+			int timeout_ms);
+
 ssize_t xdma_xfer_completion(void *cb_hndl, void *dev_hndl, int channel, bool write, u64 ep_addr,
 			struct sg_table *sgt, bool dma_mapped, int timeout_ms);
 
@@ -72,6 +72,7 @@ static ssize_t char_ctrl_write(struct file *file, const char __user *buf,
 	void __iomem *reg;
 	u32 w;
 	int rv;
+	size_t done = 0;
 
 	rv = xcdev_check(__func__, xcdev, 0);
 	if (rv < 0)
@@ -84,16 +85,20 @@ static ssize_t char_ctrl_write(struct file *file, const char __user *buf,
 
 	/* first address is BAR base plus file position offset */
 	reg = xdev->bar[xcdev->bar] + *pos;
-	rv = copy_from_user(&w, buf, 4);
-	if (rv)
-		pr_info("copy from user failed %d/4, but continuing.\n", rv);
+	/* write one word, or consecutive words if a multiple of 4 bytes given (block register writes) */
+	do {
+		rv = copy_from_user(&w, buf + done, 4);
+		if (rv)
+			pr_info("copy from user failed %d/4, but continuing.\n", rv);
 
-	dbg_sg("%s(0x%08x @%p, count=%ld, pos=%d)\n",
-			__func__, w, reg, (long)count, (int)*pos);
-	//write_register(w, reg);
-	iowrite32(w, reg);
-	*pos += 4;
-	return 4;
+		dbg_sg("%s(0x%08x @%p, count=%ld, pos=%d)\n",
+				__func__, w, reg + done, (long)count, (int)*pos);
+		//write_register(w, reg);
+		iowrite32(w, reg + done);
+		done += 4;
+	} while (done + 4 <= count);
+	*pos += done;
+	return done;
 }
 
 static long version_ioctl(struct xdma_cdev *xcdev, void __user *arg)
@@ -200,6 +205,7 @@ int bridge_mmap(struct file *file, struct vm_area_struct *vma)
 	uint64_t phys;				// LVB 21/2/2021: must be 64 bit
 	uint64_t vsize;				// LVB 21/2/2021: must be 64 bit
 	uint64_t psize;				// LVB 21/2/2021: must be 64 bit
+	bool wc = false;
 	int rv;
 
 	rv = xcdev_check(__func__, xcdev, 0);
@@ -208,6 +214,10 @@ int bridge_mmap(struct file *file, struct vm_area_struct *vma)
 	xdev = xcdev->xdev;
 
 	off = vma->vm_pgoff << PAGE_SHIFT;
+	if (off >= XDMA_MMAP_WC_OFFSET) {
+		wc = true;
+		off -= XDMA_MMAP_WC_OFFSET;
+	}
 	/* BAR physical address */
 	phys = pci_resource_start(xdev->pdev, xcdev->bar) + off;
 	vsize = vma->vm_end - vma->vm_start;
@@ -226,13 +236,17 @@ int bridge_mmap(struct file *file, struct vm_area_struct *vma)
 		xcdev->bar));
 	dbg_sg("phys = 0x%lx\n", phys);
 
-	if (vsize > psize)
+	if (off >= pci_resource_len(xdev->pdev, xcdev->bar) || vsize > psize)
 		return -EINVAL;
 	/*
 	 * pages must not be cached as this would result in cache line sized
-	 * accesses to the end point
+	 * accesses to the end point. The write-combined view lets stores be
+	 * merged into bursts; the user must fence before relying on them.
 	 */
-	vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
+	if (wc)
+		vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+	else
+		vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
 	/*
 	 * prevent touching the pages (byte access) for swap-in,
 	 * and prevent the pages from being swapped out
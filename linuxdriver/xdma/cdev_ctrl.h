@@ -22,6 +22,12 @@
 
 #include <linux/ioctl.h>
 
+/*
+ * mmap() offsets from XDMA_MMAP_WC_OFFSET map the same BAR (less that
+ * offset) write-combined, for bulk uploads; normal offsets stay uncached.
+ */
+#define XDMA_MMAP_WC_OFFSET	0x40000000UL
+
 /* Use 'x' as magic number */
 #define XDMA_IOC_MAGIC	'x'
 /* XL OpenCL X->58(ASCII), L->6C(ASCII), O->0 C->C L->6C(ASCII); */
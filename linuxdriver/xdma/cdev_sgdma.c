@@ -46,6 +46,8 @@ MODULE_PARM_DESC(c2h_timeout, "C2H sgdma timeout in seconds, default is 10 sec."
 
 extern struct kmem_cache *cdev_cache;
 static void char_sgdma_unmap_user_buf(struct xdma_io_cb *cb, bool write);
+static bool dma_ring_busy(struct xdma_cdev *xcdev);
+static void poll_irq_consume(struct xdma_cdev *xcdev);
 
 
 static void async_io_handler(unsigned long  cb_hndl, int err)
@@ -386,6 +388,11 @@ static ssize_t char_sgdma_read_write(struct file *file, const char __user *buf,
 		return rv;
 	}
 
+	if (dma_ring_busy(xcdev))
+		return -EBUSY;
+	if (!write)
+		poll_irq_consume(xcdev);
+
 	memset(&cb, 0, sizeof(struct xdma_io_cb));
 	cb.buf = (char __user *)buf;
 	cb.len = count;
@@ -732,6 +739,22 @@ static int ioctl_do_addrmode_get(struct xdma_engine *engine, unsigned long arg)
 	return rv;
 }
 
+/*
+ * per-engine completion: a busy-poll window (us) spent polling for a
+ * transfer to complete before sleeping until its interrupt. Small latency
+ * critical channels (eg mic, speaker) can poll; bulk channels keep 0.
+ */
+static int ioctl_do_poll_set(struct xdma_engine *engine, unsigned long arg)
+{
+	return engine_poll_window_set(engine, arg);
+}
+
+static int ioctl_do_poll_get(struct xdma_engine *engine, unsigned long arg)
+{
+	dbg_perf("IOCTL_XDMA_POLL_GET\n");
+	return put_user(engine->poll_us, (int __user *)arg);
+}
+
 static int ioctl_do_align_get(struct xdma_engine *engine, unsigned long arg)
 {
 	if (!engine) {
@@ -743,6 +766,602 @@ static int ioctl_do_align_get(struct xdma_engine *engine, unsigned long arg)
 	return put_user(engine->addr_align, (int __user *)arg);
 }
 
+/*
+ * Persistent DMA buffer.
+ * A coherent buffer is allocated once and mmap()ed by the application.
+ * IOCTL_XDMA_BUFFER_XFER then transfers a region of it, so unlike
+ * read()/write() there is no get_user_pages() and no sg map/unmap per
+ * transfer: the request is a single, already mapped, sg entry.
+ * For C2H it can instead be a ring (IOCTL_XDMA_RING_START) that the engine
+ * fills continuously, with no per-transfer request at all.
+ * The buffer is reference counted so it outlives a free or close while
+ * a mapping or transfer still uses it.
+ */
+#define XDMA_BUFFER_SIZE_MAX	(4 << 20)
+
+static void dma_buffer_release(struct kref *ref)
+{
+	struct xdma_dma_buffer *dbuf =
+		container_of(ref, struct xdma_dma_buffer, ref);
+
+	hrtimer_cancel(&dbuf->ring_timer);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+	if (dbuf->cached)
+		dma_free_noncoherent(dbuf->dev, dbuf->size, dbuf->virt,
+				     dbuf->bus, dbuf->engine->dir);
+	else
+#endif
+		dma_free_coherent(dbuf->dev, dbuf->size, dbuf->virt,
+				  dbuf->bus);
+	kfree(dbuf);
+}
+
+/* take a reference to the buffer of a cdev, or NULL if it has none */
+static struct xdma_dma_buffer *dma_buffer_get(struct xdma_cdev *xcdev)
+{
+	struct xdma_dma_buffer *dbuf;
+
+	spin_lock(&xcdev->lock);
+	dbuf = xcdev->dma_buffer;
+	if (dbuf)
+		kref_get(&dbuf->ref);
+	spin_unlock(&xcdev->lock);
+	return dbuf;
+}
+
+/* detach the buffer from its cdev; only the file that allocated it can */
+static int dma_buffer_detach(struct xdma_cdev *xcdev, struct file *file)
+{
+	struct xdma_dma_buffer *dbuf;
+
+	spin_lock(&xcdev->lock);
+	dbuf = xcdev->dma_buffer;
+	if (dbuf && dbuf->owner == file)
+		xcdev->dma_buffer = NULL;
+	else
+		dbuf = NULL;
+	spin_unlock(&xcdev->lock);
+
+	if (!dbuf)
+		return -EINVAL;
+	if (dbuf->ring_running) {
+		WRITE_ONCE(dbuf->ring_running, 0);
+		xdma_cyclic_ring_stop(dbuf->engine, &dbuf->ring);
+		hrtimer_cancel(&dbuf->ring_timer);
+		wake_up_interruptible(&xcdev->poll_wq);
+	}
+	kref_put(&dbuf->ref, dma_buffer_release);
+	return 0;
+}
+
+/*
+ * the ring has no completion interrupt, so while poll() waits for it
+ * this timer polls its count, at the rate IOCTL_XDMA_RING_WAIT does
+ */
+#define XDMA_RING_POLL_MIN_US	50
+#define XDMA_RING_POLL_MAX_US	100
+
+static enum hrtimer_restart dma_ring_poll_timer(struct hrtimer *timer)
+{
+	struct xdma_dma_buffer *dbuf =
+		container_of(timer, struct xdma_dma_buffer, ring_timer);
+
+	if (!READ_ONCE(dbuf->ring_running) ||
+	    xdma_cyclic_ring_count(dbuf->engine, &dbuf->ring) >
+	    READ_ONCE(dbuf->ring_seen)) {
+		wake_up_interruptible(dbuf->poll_wq);
+		return HRTIMER_NORESTART;
+	}
+	if (!wq_has_sleeper(dbuf->poll_wq))
+		return HRTIMER_NORESTART;
+	hrtimer_forward_now(timer, us_to_ktime(XDMA_RING_POLL_MIN_US));
+	return HRTIMER_RESTART;
+}
+
+/*
+ * allocate the persistent buffer of a cdev; -EBUSY if it already has one
+ * a cached buffer is cacheable memory, synced by each transfer
+ */
+static struct xdma_dma_buffer *dma_buffer_alloc(struct xdma_cdev *xcdev,
+		struct file *file, size_t size, bool cached)
+{
+	struct xdma_dma_buffer *dbuf;
+
+	size = PAGE_ALIGN(size);
+	dbuf = kzalloc(sizeof(*dbuf), GFP_KERNEL);
+	if (!dbuf)
+		return ERR_PTR(-ENOMEM);
+	dbuf->dev = &xcdev->xdev->pdev->dev;
+	dbuf->owner = file;
+	dbuf->size = size;
+	dbuf->engine = xcdev->engine;
+	dbuf->poll_wq = &xcdev->poll_wq;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+	hrtimer_setup(&dbuf->ring_timer, dma_ring_poll_timer, CLOCK_MONOTONIC,
+		      HRTIMER_MODE_REL);
+#else
+	hrtimer_init(&dbuf->ring_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dbuf->ring_timer.function = dma_ring_poll_timer;
+#endif
+	dbuf->cached = cached;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+	if (cached)
+		dbuf->virt = dma_alloc_noncoherent(dbuf->dev, size, &dbuf->bus,
+						   dbuf->engine->dir,
+						   GFP_KERNEL);
+	else
+#endif
+		dbuf->virt = dma_alloc_coherent(dbuf->dev, size, &dbuf->bus,
+						GFP_KERNEL);
+	if (!dbuf->virt) {
+		pr_err("%s: DMA buffer of %zu bytes OOM.\n",
+			xcdev->engine->name, size);
+		kfree(dbuf);
+		return ERR_PTR(-ENOMEM);
+	}
+	kref_init(&dbuf->ref);
+
+	spin_lock(&xcdev->lock);
+	if (xcdev->dma_buffer) {
+		spin_unlock(&xcdev->lock);
+		kref_put(&dbuf->ref, dma_buffer_release);
+		return ERR_PTR(-EBUSY);
+	}
+	xcdev->dma_buffer = dbuf;
+	spin_unlock(&xcdev->lock);
+
+	dbg_tfr("%s: DMA buffer %zu bytes, bus 0x%llx.\n", xcdev->engine->name,
+		size, (u64)dbuf->bus);
+	return dbuf;
+}
+
+static int ioctl_do_buffer_alloc(struct xdma_cdev *xcdev, struct file *file,
+		unsigned long arg, bool cached)
+{
+	struct xdma_buffer_ioctl buf_ioctl;
+	struct xdma_dma_buffer *dbuf;
+
+	if (copy_from_user(&buf_ioctl, (struct xdma_buffer_ioctl __user *)arg,
+			   sizeof(buf_ioctl)))
+		return -EFAULT;
+
+	if (buf_ioctl.size == 0 || buf_ioctl.size > XDMA_BUFFER_SIZE_MAX) {
+		pr_info("%s: invalid DMA buffer size %llu.\n",
+			xcdev->engine->name, buf_ioctl.size);
+		return -EINVAL;
+	}
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 10, 0)
+	if (cached)
+		return -EOPNOTSUPP;
+#endif
+	dbuf = dma_buffer_alloc(xcdev, file, buf_ioctl.size, cached);
+	return IS_ERR(dbuf) ? PTR_ERR(dbuf) : 0;
+}
+
+/* true if the engine of a cdev is running a ring, so can't take transfers */
+static bool dma_ring_busy(struct xdma_cdev *xcdev)
+{
+	bool busy;
+
+	spin_lock(&xcdev->lock);
+	busy = xcdev->dma_buffer && READ_ONCE(xcdev->dma_buffer->ring_running);
+	spin_unlock(&xcdev->lock);
+	return busy;
+}
+
+static int ioctl_do_ring_start(struct xdma_cdev *xcdev, struct file *file,
+		unsigned long arg)
+{
+	struct xdma_engine *engine = xcdev->engine;
+	struct xdma_ring_ioctl ring_ioctl;
+	struct xdma_dma_buffer *dbuf;
+	u64 size;
+	int rv;
+
+	if (copy_from_user(&ring_ioctl, (struct xdma_ring_ioctl __user *)arg,
+			   sizeof(ring_ioctl)))
+		return -EFAULT;
+
+	size = (u64)ring_ioctl.block_size * ring_ioctl.blocks;
+	if (engine->dir != DMA_FROM_DEVICE || size == 0 ||
+	    size > XDMA_BUFFER_SIZE_MAX ||
+	    (ring_ioctl.block_size & (engine->addr_align - 1)) ||
+	    (ring_ioctl.block_size % engine->len_granularity)) {
+		pr_info("%s: invalid ring, %u blocks of %u bytes.\n",
+			engine->name, ring_ioctl.blocks, ring_ioctl.block_size);
+		return -EINVAL;
+	}
+
+	dbuf = dma_buffer_alloc(xcdev, file, size, false);
+	if (IS_ERR(dbuf))
+		return PTR_ERR(dbuf);
+
+	dbuf->ring.buf_bus = dbuf->bus;
+	dbuf->ring.block_size = ring_ioctl.block_size;
+	dbuf->ring.blocks = ring_ioctl.blocks;
+	dbuf->ring.ep_addr = ring_ioctl.ep_addr;
+	mutex_lock(&engine->desc_lock);
+	rv = xdma_cyclic_ring_start(engine, &dbuf->ring);
+	if (rv == 0)
+		WRITE_ONCE(dbuf->ring_running, 1);
+	mutex_unlock(&engine->desc_lock);
+
+	if (rv < 0)
+		dma_buffer_detach(xcdev, file);
+	return rv;
+}
+
+/*
+ * wait until the ring has filled a given number of blocks, or timeout.
+ * there is no completion interrupt, so the count is polled
+ */
+static int ioctl_do_ring_wait(struct xdma_cdev *xcdev, unsigned long arg)
+{
+	struct xdma_ring_wait_ioctl wait_ioctl;
+	struct xdma_dma_buffer *dbuf;
+	u64 count;
+	ktime_t end;
+	int rv = 0;
+
+	if (copy_from_user(&wait_ioctl,
+			   (struct xdma_ring_wait_ioctl __user *)arg,
+			   sizeof(wait_ioctl)))
+		return -EFAULT;
+
+	dbuf = dma_buffer_get(xcdev);
+	if (!dbuf)
+		return -EINVAL;
+
+	end = ktime_add_us(ktime_get(), wait_ioctl.timeout_us);
+	for (;;) {
+		if (!READ_ONCE(dbuf->ring_running)) {
+			rv = -EINVAL;
+			break;
+		}
+		count = xdma_cyclic_ring_count(dbuf->engine, &dbuf->ring);
+		if (count >= wait_ioctl.count ||
+		    ktime_after(ktime_get(), end))
+			break;
+		if (signal_pending(current)) {
+			rv = -ERESTARTSYS;
+			break;
+		}
+		usleep_range(XDMA_RING_POLL_MIN_US, XDMA_RING_POLL_MAX_US);
+	}
+	if (rv == 0)
+		WRITE_ONCE(dbuf->ring_seen, count);
+	kref_put(&dbuf->ref, dma_buffer_release);
+
+	if (rv < 0)
+		return rv;
+	wait_ioctl.count = count;
+	if (copy_to_user((struct xdma_ring_wait_ioctl __user *)arg,
+			 &wait_ioctl, sizeof(wait_ioctl)))
+		return -EFAULT;
+	return 0;
+}
+
+static ssize_t ioctl_do_buffer_xfer(struct xdma_cdev *xcdev, unsigned long arg)
+{
+	struct xdma_engine *engine = xcdev->engine;
+	struct xdma_buffer_xfer_ioctl xfer_ioctl;
+	struct xdma_dma_buffer *dbuf;
+	struct scatterlist sg[2];
+	struct sg_table sgt;
+	bool write = (engine->dir == DMA_TO_DEVICE);
+	u64 len[2];
+	ssize_t res;
+	int i;
+
+	if (copy_from_user(&xfer_ioctl,
+			   (struct xdma_buffer_xfer_ioctl __user *)arg,
+			   sizeof(xfer_ioctl)))
+		return -EFAULT;
+
+	dbuf = dma_buffer_get(xcdev);
+	if (!dbuf)
+		return -EINVAL;
+
+	res = -EBUSY;
+	if (READ_ONCE(dbuf->ring_running))
+		goto out;
+	res = -EINVAL;
+	if (xfer_ioctl.length == 0 || xfer_ioctl.offset >= dbuf->size ||
+	    xfer_ioctl.length > dbuf->size)
+		goto out;
+
+	/* a region past the end of the buffer wraps to its start */
+	len[0] = min_t(u64, xfer_ioctl.length, dbuf->size - xfer_ioctl.offset);
+	len[1] = xfer_ioctl.length - len[0];
+	sgt.nents = len[1] ? 2 : 1;
+
+	/* the buffer is page aligned, so its offset sets the address lsbs */
+	res = check_transfer_align(engine,
+			(const char __user *)(uintptr_t)xfer_ioctl.offset,
+			len[0], xfer_ioctl.ep_addr, 1);
+	if (res == 0 && len[1])
+		res = check_transfer_align(engine, NULL, len[1],
+				engine->non_incr_addr ? xfer_ioctl.ep_addr :
+				xfer_ioctl.ep_addr + len[0], 1);
+	if (res)
+		goto out;
+
+	if (!write)
+		poll_irq_consume(xcdev);
+	sg_init_table(sg, sgt.nents);
+	for (i = 0; i < sgt.nents; i++) {
+		sg[i].length = len[i];
+		sg_dma_address(&sg[i]) = dbuf->bus + (i ? 0 : xfer_ioctl.offset);
+		sg_dma_len(&sg[i]) = len[i];
+		if (dbuf->cached)
+			dma_sync_single_for_device(dbuf->dev,
+					sg_dma_address(&sg[i]), len[i],
+					engine->dir);
+	}
+	sgt.sgl = sg;
+	sgt.orig_nents = sgt.nents;
+
+	res = xdma_xfer_submit(xcdev->xdev, engine->channel, write,
+			       xfer_ioctl.ep_addr, &sgt, 1,
+			       write ? h2c_timeout * 1000 :
+				       c2h_timeout * 1000);
+	if (dbuf->cached && !write)
+		for (i = 0; i < sgt.nents; i++)
+			dma_sync_single_for_cpu(dbuf->dev,
+					sg_dma_address(&sg[i]), len[i],
+					engine->dir);
+out:
+	kref_put(&dbuf->ref, dma_buffer_release);
+	return res;
+}
+
+static ssize_t ioctl_do_vec_xfer(struct xdma_cdev *xcdev, unsigned long arg)
+{
+	struct xdma_engine *engine = xcdev->engine;
+	struct xdma_vec_ioctl vec_ioctl;
+	struct xdma_vec_entry entries[XDMA_VEC_MAX];
+	struct xdma_vec_seg segs[XDMA_VEC_MAX];
+	struct xdma_io_cb *cb;
+	bool write = (engine->dir == DMA_TO_DEVICE);
+	unsigned int mapped = 0;
+	unsigned int i;
+	ssize_t res;
+
+	if (copy_from_user(&vec_ioctl, (struct xdma_vec_ioctl __user *)arg,
+			   sizeof(vec_ioctl)))
+		return -EFAULT;
+	if (vec_ioctl.count == 0 || vec_ioctl.count > XDMA_VEC_MAX)
+		return -EINVAL;
+	if (copy_from_user(entries,
+			   (void __user *)(uintptr_t)vec_ioctl.entries,
+			   vec_ioctl.count * sizeof(struct xdma_vec_entry)))
+		return -EFAULT;
+
+	if (dma_ring_busy(xcdev))
+		return -EBUSY;
+	if (!write)
+		poll_irq_consume(xcdev);
+
+	cb = kcalloc(vec_ioctl.count, sizeof(*cb), GFP_KERNEL);
+	if (!cb)
+		return -ENOMEM;
+
+	for (mapped = 0; mapped < vec_ioctl.count; mapped++) {
+		struct xdma_vec_entry *e = entries + mapped;
+		const char __user *buf = (const char __user *)(uintptr_t)e->buf;
+
+		res = -EINVAL;
+		if (e->length == 0 || e->length > UINT_MAX)
+			goto unmap;
+		res = check_transfer_align(engine, buf, e->length,
+					   e->ep_addr, 1);
+		if (res)
+			goto unmap;
+
+		cb[mapped].buf = (char __user *)buf;
+		cb[mapped].len = e->length;
+		cb[mapped].ep_addr = e->ep_addr;
+		cb[mapped].write = write;
+		res = char_sgdma_map_user_buf_to_sgl(&cb[mapped], write);
+		if (res < 0)
+			goto unmap;
+		segs[mapped].sgt = &cb[mapped].sgt;
+		segs[mapped].ep_addr = e->ep_addr;
+	}
+
+	res = xdma_xfer_submit_vec(xcdev->xdev, engine->channel, write, segs,
+				   vec_ioctl.count, write ? h2c_timeout * 1000 :
+							    c2h_timeout * 1000);
+unmap:
+	for (i = 0; i < mapped; i++)
+		char_sgdma_unmap_user_buf(&cb[i], write);
+	kfree(cb);
+	return res;
+}
+
+/*
+ * each VMA of the buffer holds a reference. mmap takes the first; a VMA
+ * copied by fork() or split by a partial munmap or mprotect gets .open,
+ * and every one of them is closed, so each takes its own
+ */
+static void dma_buffer_vma_open(struct vm_area_struct *vma)
+{
+	struct xdma_dma_buffer *dbuf = vma->vm_private_data;
+
+	kref_get(&dbuf->ref);
+}
+
+static void dma_buffer_vma_close(struct vm_area_struct *vma)
+{
+	struct xdma_dma_buffer *dbuf = vma->vm_private_data;
+
+	kref_put(&dbuf->ref, dma_buffer_release);
+}
+
+static const struct vm_operations_struct dma_buffer_vm_ops = {
+	.open = dma_buffer_vma_open,
+	.close = dma_buffer_vma_close,
+};
+
+/* maps the persistent DMA buffer into user space */
+static int char_sgdma_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct xdma_cdev *xcdev = (struct xdma_cdev *)file->private_data;
+	struct xdma_dma_buffer *dbuf;
+	unsigned long vsize = vma->vm_end - vma->vm_start;
+	int rv;
+
+	rv = xcdev_check(__func__, xcdev, 1);
+	if (rv < 0)
+		return rv;
+
+	dbuf = dma_buffer_get(xcdev);
+	if (!dbuf)
+		return -EINVAL;
+	if (vma->vm_pgoff != 0 || vsize > dbuf->size) {
+		kref_put(&dbuf->ref, dma_buffer_release);
+		return -EINVAL;
+	}
+
+	/*
+	 * these set VM_DONTEXPAND, which only stops mremap() growing the
+	 * mapping: copies and splits still call vm_ops open
+	 */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+	if (dbuf->cached)
+		rv = dma_mmap_pages(dbuf->dev, vma, vsize,
+				    virt_to_page(dbuf->virt));
+	else
+#endif
+		rv = dma_mmap_coherent(dbuf->dev, vma, dbuf->virt, dbuf->bus,
+				       vsize);
+	if (rv) {
+		kref_put(&dbuf->ref, dma_buffer_release);
+		return rv;
+	}
+	vma->vm_private_data = dbuf;
+	vma->vm_ops = &dma_buffer_vm_ops;
+	return 0;
+}
+
+/*
+ * poll() readiness of a C2H device; see IOCTL_XDMA_POLL_IRQ_SET.
+ * a read counts the mapped interrupt as seen before its transfer starts,
+ * so an interrupt during the transfer makes the device readable again.
+ */
+static void poll_irq_consume(struct xdma_cdev *xcdev)
+{
+	int irq = READ_ONCE(xcdev->poll_irq);
+
+	if (irq >= 0)
+		WRITE_ONCE(xcdev->poll_irq_seen,
+			   READ_ONCE(xcdev->xdev->user_irq[irq].events_count));
+}
+
+static int ioctl_do_poll_irq_set(struct xdma_cdev *xcdev, unsigned long arg)
+{
+	int irq;
+
+	if (get_user(irq, (int __user *)arg))
+		return -EFAULT;
+	if (xcdev->engine->dir != DMA_FROM_DEVICE ||
+	    irq < -1 || irq >= xcdev->xdev->user_max)
+		return -EINVAL;
+
+	WRITE_ONCE(xcdev->poll_irq, -1);
+	if (irq >= 0) {
+		WRITE_ONCE(xcdev->poll_irq_seen,
+			   READ_ONCE(xcdev->xdev->user_irq[irq].events_count));
+		WRITE_ONCE(xcdev->poll_irq, irq);
+	}
+	dbg_sg("%s: poll() user IRQ %d.\n", xcdev->engine->name, irq);
+	return 0;
+}
+
+static int ioctl_do_eop_set(struct xdma_engine *engine, unsigned long arg)
+{
+	int eop;
+
+	if (get_user(eop, (int __user *)arg))
+		return -EFAULT;
+	if (!engine->streaming || engine->dir != DMA_FROM_DEVICE)
+		return -EINVAL;
+	if (engine->running)
+		return -EBUSY;
+
+	engine->eop_flush = eop ? 1 : 0;
+	dbg_sg("%s: EOP terminated reads %s.\n", engine->name,
+	       eop ? "on" : "off");
+	return 0;
+}
+
+static int ioctl_do_timing_get(struct xdma_engine *engine, unsigned long arg)
+{
+	struct xdma_engine_timing timing;
+	struct xdma_timing_ioctl timing_ioctl;
+
+	xdma_engine_timing_get(engine, &timing);
+	memset(&timing_ioctl, 0, sizeof(timing_ioctl));
+	timing_ioctl.submit_ns = ktime_to_ns(timing.submit);
+	timing_ioctl.start_ns = ktime_to_ns(timing.start);
+	timing_ioctl.complete_ns = ktime_to_ns(timing.complete);
+	timing_ioctl.bytes = timing.bytes;
+	timing_ioctl.sequence = timing.sequence;
+	if (copy_to_user((void __user *)arg, &timing_ioctl,
+			 sizeof(timing_ioctl)))
+		return -EFAULT;
+	return 0;
+}
+
+static unsigned int char_sgdma_poll(struct file *file, poll_table *wait)
+{
+	struct xdma_cdev *xcdev = (struct xdma_cdev *)file->private_data;
+	struct xdma_user_irq *user_irq;
+	struct xdma_dma_buffer *dbuf;
+	unsigned int mask = 0;
+	bool waiting = false;
+	int irq;
+
+	if (xcdev_check(__func__, xcdev, 1) < 0)
+		return POLLERR;
+	if (xcdev->engine->dir != DMA_FROM_DEVICE)
+		return POLLOUT | POLLWRNORM;
+
+	poll_wait(file, &xcdev->poll_wq, wait);
+	irq = READ_ONCE(xcdev->poll_irq);
+	if (irq >= 0) {
+		user_irq = &xcdev->xdev->user_irq[irq];
+		poll_wait(file, &user_irq->events_wq, wait);
+		waiting = true;
+		if (READ_ONCE(user_irq->events_count) !=
+		    READ_ONCE(xcdev->poll_irq_seen))
+			mask |= POLLIN | POLLRDNORM;
+	}
+
+	dbuf = dma_buffer_get(xcdev);
+	if (dbuf) {
+		if (READ_ONCE(dbuf->ring_running)) {
+			waiting = true;
+			if (xdma_cyclic_ring_count(dbuf->engine, &dbuf->ring) >
+			    READ_ONCE(dbuf->ring_seen))
+				mask |= POLLIN | POLLRDNORM;
+			else if (!hrtimer_active(&dbuf->ring_timer))
+				hrtimer_start_range_ns(&dbuf->ring_timer,
+					us_to_ktime(XDMA_RING_POLL_MIN_US),
+					(XDMA_RING_POLL_MAX_US -
+					 XDMA_RING_POLL_MIN_US) * NSEC_PER_USEC,
+					HRTIMER_MODE_REL);
+		}
+		kref_put(&dbuf->ref, dma_buffer_release);
+	}
+
+	/* nothing to wait for: a read simply runs a transfer */
+	if (!waiting)
+		mask |= POLLIN | POLLRDNORM;
+	return mask;
+}
+
 static long char_sgdma_ioctl(struct file *file, unsigned int cmd,
 		unsigned long arg)
 {
@@ -778,6 +1397,43 @@ static long char_sgdma_ioctl(struct file *file, unsigned int cmd,
 	case IOCTL_XDMA_ALIGN_GET:
 		rv = ioctl_do_align_get(engine, arg);
 		break;
+	case IOCTL_XDMA_POLL_SET:
+		rv = ioctl_do_poll_set(engine, arg);
+		break;
+	case IOCTL_XDMA_POLL_GET:
+		rv = ioctl_do_poll_get(engine, arg);
+		break;
+	case IOCTL_XDMA_BUFFER_ALLOC:
+		rv = ioctl_do_buffer_alloc(xcdev, file, arg, false);
+		break;
+	case IOCTL_XDMA_BUFFER_ALLOC_CACHED:
+		rv = ioctl_do_buffer_alloc(xcdev, file, arg, true);
+		break;
+	case IOCTL_XDMA_BUFFER_FREE:
+		rv = dma_buffer_detach(xcdev, file);
+		break;
+	case IOCTL_XDMA_BUFFER_XFER:
+		return ioctl_do_buffer_xfer(xcdev, arg);
+	case IOCTL_XDMA_VEC_XFER:
+		return ioctl_do_vec_xfer(xcdev, arg);
+	case IOCTL_XDMA_RING_START:
+		rv = ioctl_do_ring_start(xcdev, file, arg);
+		break;
+	case IOCTL_XDMA_RING_STOP:
+		rv = dma_buffer_detach(xcdev, file);
+		break;
+	case IOCTL_XDMA_RING_WAIT:
+		rv = ioctl_do_ring_wait(xcdev, arg);
+		break;
+	case IOCTL_XDMA_POLL_IRQ_SET:
+		rv = ioctl_do_poll_irq_set(xcdev, arg);
+		break;
+	case IOCTL_XDMA_EOP_SET:
+		rv = ioctl_do_eop_set(engine, arg);
+		break;
+	case IOCTL_XDMA_TIMING_GET:
+		rv = ioctl_do_timing_get(engine, arg);
+		break;
 	default:
 		dbg_perf("Unsupported operation\n");
 		rv = -EINVAL;
@@ -823,6 +1479,10 @@ static int char_sgdma_close(struct inode *inode, struct file *file)
 	if (engine->streaming && engine->dir == DMA_FROM_DEVICE)
 		engine->device_open = 0;
 
+	/* free a persistent DMA buffer allocated through this file */
+	dma_buffer_detach(xcdev, file);
+	WRITE_ONCE(xcdev->poll_irq, -1);
+
 	return 0;
 }
 static const struct file_operations sgdma_fops = {
@@ -842,10 +1502,14 @@ static const struct file_operations sgdma_fops = {
 	.aio_read = cdev_aio_read,
 #endif
 	.unlocked_ioctl = char_sgdma_ioctl,
+	.poll = char_sgdma_poll,
+	.mmap = char_sgdma_mmap,
 	.llseek = char_sgdma_llseek,
 };
 
 void cdev_sgdma_init(struct xdma_cdev *xcdev)
 {
+	init_waitqueue_head(&xcdev->poll_wq);
+	xcdev->poll_irq = -1;
 	cdev_init(&xcdev->cdev, &sgdma_fops);
 }
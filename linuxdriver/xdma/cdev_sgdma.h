@@ -58,6 +58,112 @@ struct xdma_performance_ioctl {
 	uint64_t pending_count;
 };
 
+/*
+ * persistent DMA buffer: allocated once by IOCTL_XDMA_BUFFER_ALLOC and
+ * mmap()ed by the application; transfers then name a region of it, so no
+ * user pages are pinned or mapped per transfer
+ */
+struct xdma_buffer_ioctl {
+	uint64_t size;			/* buffer size in bytes */
+};
+
+/*
+ * the buffer is physically contiguous, so any region of it is a single
+ * descriptor (however long, up to desc_blen_max), not one per page.
+ * IOCTL_XDMA_BUFFER_ALLOC gives coherent memory, which hosts without
+ * coherent PCIe (eg the Raspberry Pi) map uncached: slow for the CPU to
+ * read. IOCTL_XDMA_BUFFER_ALLOC_CACHED gives cacheable memory instead (from
+ * CMA when large), and IOCTL_XDMA_BUFFER_XFER does the cache maintenance.
+ * A region may run past the end of the buffer and wrap to its start, for
+ * an application that maps it twice, end to end, as a mirrored ring; that
+ * transfer takes 2 descriptors.
+ */
+struct xdma_buffer_xfer_ioctl {
+	uint64_t offset;		/* byte offset in the mmap()ed buffer */
+	uint64_t length;		/* bytes to transfer */
+	uint64_t ep_addr;		/* FPGA address, as the pread() position */
+};
+
+/*
+ * C2H ring: IOCTL_XDMA_RING_START allocates the persistent buffer as a
+ * ring of blocks, which the engine fills continuously, block by block.
+ * The application mmap()s it, and IOCTL_XDMA_RING_WAIT returns the number
+ * of blocks filled since the start; block n is at offset
+ * (n % blocks) * block_size. The application must keep up: a block is
+ * overwritten once the engine is a full ring ahead of it.
+ */
+struct xdma_ring_ioctl {
+	uint32_t block_size;		/* bytes per block */
+	uint32_t blocks;		/* blocks in the ring */
+	uint64_t ep_addr;		/* FPGA address read for every block */
+};
+
+struct xdma_ring_wait_ioctl {
+	uint64_t count;			/* in: wait for this many blocks filled */
+					/* out: blocks filled since start */
+	uint32_t timeout_us;		/* 0 = don't wait */
+	uint32_t reserved;
+};
+
+/*
+ * vectored transfer: up to XDMA_VEC_MAX user buffers, each to/from its own
+ * FPGA address, run as one chained descriptor list on an AXI-MM engine.
+ * The ioctl returns the total bytes transferred.
+ */
+#define XDMA_VEC_MAX	8
+
+struct xdma_vec_entry {
+	uint64_t ep_addr;		/* FPGA address, as the pread() position */
+	uint64_t buf;			/* user buffer */
+	uint64_t length;		/* bytes to transfer */
+};
+
+struct xdma_vec_ioctl {
+	uint64_t entries;		/* user pointer to struct xdma_vec_entry[] */
+	uint32_t count;			/* entries in the list */
+	uint32_t reserved;
+};
+
+
+/*
+ * poll()/epoll on a C2H device: POLLIN says there is data to read.
+ * IOCTL_XDMA_POLL_IRQ_SET maps a user interrupt (eg a FIFO monitor
+ * threshold) to the device: it is readable once that interrupt has fired
+ * since the last read or buffer transfer. While a ring runs, the device
+ * is readable when blocks have been filled beyond the count the last
+ * IOCTL_XDMA_RING_WAIT returned. With neither, it is always readable.
+ * The argument is the user interrupt number, or -1 to unmap; closing the
+ * device unmaps it too.
+ */
+
+
+/*
+ * end of packet terminated reads, AXI-ST C2H engines only.
+ * IOCTL_XDMA_EOP_SET (argument 1 or 0) changes the mode chosen by opening
+ * with O_TRUNC: a read then completes when the stream's TLAST arrives,
+ * and returns the bytes of that packet - up to its length, so one read
+ * fetches one frame whose size userspace does not know beforehand.
+ * -EINVAL for other engines; -EBUSY if a transfer is running.
+ */
+
+
+/*
+ * DMA timestamps: IOCTL_XDMA_TIMING_GET returns the times of the last
+ * read, write or buffer transfer completed on the device's engine, in ns
+ * of CLOCK_MONOTONIC_RAW so they compare with clock_gettime() in
+ * userspace: submit -> start is queueing in the driver, start -> complete
+ * the transfer on PCIe, and complete -> the return to userspace is the
+ * wakeup. start is 0 if the request was chained behind a running
+ * transfer. sequence counts the requests timed, so a caller can tell if
+ * another request completed in between.
+ */
+struct xdma_timing_ioctl {
+	uint64_t submit_ns;		/* request entered the driver */
+	uint64_t start_ns;		/* engine started on its 1st transfer */
+	uint64_t complete_ns;		/* its completion was serviced */
+	uint64_t bytes;			/* bytes transferred */
+	uint64_t sequence;		/* requests timed on the engine */
+};
 
 
 /* IOCTL codes */
@@ -68,5 +174,18 @@ struct xdma_performance_ioctl {
 #define IOCTL_XDMA_ADDRMODE_SET _IOW('q', 4, int)
 #define IOCTL_XDMA_ADDRMODE_GET _IOR('q', 5, int)
 #define IOCTL_XDMA_ALIGN_GET    _IOR('q', 6, int)
+#define IOCTL_XDMA_BUFFER_ALLOC _IOW('q', 7, struct xdma_buffer_ioctl *)
+#define IOCTL_XDMA_BUFFER_FREE  _IO('q', 8)
+#define IOCTL_XDMA_BUFFER_XFER  _IOW('q', 9, struct xdma_buffer_xfer_ioctl *)
+#define IOCTL_XDMA_RING_START   _IOW('q', 10, struct xdma_ring_ioctl *)
+#define IOCTL_XDMA_RING_STOP    _IO('q', 11)
+#define IOCTL_XDMA_RING_WAIT    _IOWR('q', 12, struct xdma_ring_wait_ioctl *)
+#define IOCTL_XDMA_POLL_SET     _IOW('q', 13, int)
+#define IOCTL_XDMA_POLL_GET     _IOR('q', 14, int)
+#define IOCTL_XDMA_VEC_XFER     _IOW('q', 15, struct xdma_vec_ioctl *)
+#define IOCTL_XDMA_POLL_IRQ_SET _IOW('q', 16, int)
+#define IOCTL_XDMA_BUFFER_ALLOC_CACHED _IOW('q', 17, struct xdma_buffer_ioctl *)
+#define IOCTL_XDMA_EOP_SET      _IOW('q', 18, int)
+#define IOCTL_XDMA_TIMING_GET   _IOR('q', 19, struct xdma_timing_ioctl *)
 
 #endif /* _XDMA_IOCALLS_POSIX_H_ */
@@ -55,14 +55,20 @@ inline u32 __read_register(const char *fn, void __iomem *base, unsigned int off)
 #endif /* #ifdef __REG_DEBUG__ */
 
 
+/*
+ * shift up to 32 bits. The TMS register holds its value between shifts,
+ * so it is only written if write_tms (when the TMS bits change): in a long
+ * TDI/TDO scan TMS stays 0, and each word is one register write fewer.
+ */
 static int xvc_shift_bits(void __iomem *base, u32 tms_bits, u32 tdi_bits,
-			u32 *tdo_bits)
+			u32 *tdo_bits, bool write_tms)
 {
 	u32 control;
 	int count;
 
 	/* set tms bit */
-	write_register(tms_bits, base, XVC_BAR_TMS_REG);
+	if (write_tms)
+		write_register(tms_bits, base, XVC_BAR_TMS_REG);
 	/* set tdi bits and shift data out */
 	write_register(tdi_bits, base, XVC_BAR_TDI_REG);
 	/* enable shift operation */
@@ -90,82 +96,18 @@ static int xvc_shift_bits(void __iomem *base, u32 tms_bits, u32 tdi_bits,
 	return 0;
 }
 
-static long xvc_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+/*
+ * shift one vector of total_bits, 32 bits at a time. Called with xcdev->lock held.
+ */
+static int xvc_shift_vector(void __iomem *iobase, const unsigned char *tms_buf,
+			const unsigned char *tdi_buf, unsigned char *tdo_buf,
+			unsigned int total_bits)
 {
-	struct xdma_cdev *xcdev = (struct xdma_cdev *)filp->private_data;
-	struct xdma_dev *xdev;
-	struct xvc_ioc xvc_obj;
-	unsigned int opcode;
-	unsigned int total_bits;
-	unsigned int total_bytes;
-	unsigned char *buffer = NULL;
-	unsigned char *tms_buf = NULL;
-	unsigned char *tdi_buf = NULL;
-	unsigned char *tdo_buf = NULL;
 	unsigned int bits, bits_left;
-	void __iomem *iobase;
-	int rv;
-
-	rv = xcdev_check(__func__, xcdev, 0);
-	if (rv < 0)
-		return rv;
-
-	xdev = xcdev->xdev;
-
-	if (cmd != XDMA_IOCXVC) {
-		pr_info("ioctl 0x%x, UNKNOWN cmd.\n", cmd);
-		return -ENOIOCTLCMD;
-	}
+	u32 tms_last = 0;
+	bool tms_valid = false;
+	int rv = 0;
 
-	rv = copy_from_user((void *)&xvc_obj, (void __user *)arg,
-				sizeof(struct xvc_ioc));
-	/* anything not copied ? */
-	if (rv) {
-		pr_info("copy_from_user xvc_obj failed: %d.\n", rv);
-		goto cleanup;
-	}
-
-	opcode = xvc_obj.opcode;
-
-	/* Invalid operation type, no operation performed */
-	if (opcode != 0x01 && opcode != 0x02) {
-		pr_info("UNKNOWN opcode 0x%x.\n", opcode);
-		return -EINVAL;
-	}
-
-	total_bits = xvc_obj.length;
-	total_bytes = (total_bits + 7) >> 3;
-
-	buffer = kmalloc(total_bytes * 3, GFP_KERNEL);
-	if (!buffer) {
-		pr_info("OOM %u, op 0x%x, len %u bits, %u bytes.\n",
-			3 * total_bytes, opcode, total_bits, total_bytes);
-		rv = -ENOMEM;
-		goto cleanup;
-	}
-	tms_buf = buffer;
-	tdi_buf = tms_buf + total_bytes;
-	tdo_buf = tdi_buf + total_bytes;
-
-	rv = copy_from_user((void *)tms_buf,
-			(const char __user *)xvc_obj.tms_buf,
-			total_bytes);
-	if (rv) {
-		pr_info("copy tmfs_buf failed: %d/%u.\n", rv, total_bytes);
-		goto cleanup;
-	}
-	rv = copy_from_user((void *)tdi_buf,
-			(const char __user *)xvc_obj.tdi_buf,
-			total_bytes);
-	if (rv) {
-		pr_info("copy tdi_buf failed: %d/%u.\n", rv, total_bytes);
-		goto cleanup;
-	}
-
-	/* exclusive access */
-	spin_lock(&xcdev->lock);
-
-	iobase = xdev->bar[xcdev->bar] + xcdev->base;
 	/* set length register to 32 initially if more than one
 	 * word-transaction is to be done
 	 */
@@ -190,35 +132,187 @@ static long xvc_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		memcpy(&tdi_store, tdi_buf + bytes, shift_bytes);
 
 		/* Shift data out and copy to output buffer */
-		rv = xvc_shift_bits(iobase, tms_store, tdi_store, &tdo_store);
+		rv = xvc_shift_bits(iobase, tms_store, tdi_store, &tdo_store,
+				!tms_valid || tms_store != tms_last);
 		if (rv < 0)
 			break;
+		tms_last = tms_store;
+		tms_valid = true;
 
 		memcpy(tdo_buf + bytes, &tdo_store, shift_bytes);
 	}
 
-	if (rv < 0)
-		goto unlock;
+	return rv;
+}
 
-	/* if testing bar access swap tdi and tdo bufferes to "loopback" */
-	if (opcode == 0x2) {
-		unsigned char *tmp = tdo_buf;
+/*
+ * do one xvc_ioc operation: copy its TMS and TDI vectors in, shift them,
+ * and copy TDO out. buffer holds at least 3 * the vector's bytes.
+ */
+static int xvc_do_ioc(struct xdma_cdev *xcdev, const struct xvc_ioc *xvc_obj,
+			unsigned char *buffer)
+{
+	struct xdma_dev *xdev = xcdev->xdev;
+	unsigned int total_bits = xvc_obj->length;
+	unsigned int total_bytes = (total_bits + 7) >> 3;
+	unsigned char *tms_buf = buffer;
+	unsigned char *tdi_buf = tms_buf + total_bytes;
+	unsigned char *tdo_buf = tdi_buf + total_bytes;
+	void __iomem *iobase;
+	int rv;
 
-		tdo_buf = tdi_buf;
-		tdi_buf = tmp;
+	rv = copy_from_user((void *)tms_buf,
+			(const char __user *)xvc_obj->tms_buf,
+			total_bytes);
+	if (rv) {
+		pr_info("copy tmfs_buf failed: %d/%u.\n", rv, total_bytes);
+		return -EFAULT;
+	}
+	rv = copy_from_user((void *)tdi_buf,
+			(const char __user *)xvc_obj->tdi_buf,
+			total_bytes);
+	if (rv) {
+		pr_info("copy tdi_buf failed: %d/%u.\n", rv, total_bytes);
+		return -EFAULT;
 	}
 
-	rv = copy_to_user(xvc_obj.tdo_buf, (const void *)tdo_buf, total_bytes);
-	if (rv)
-		pr_info("copy back tdo_buf failed: %d/%u.\n", rv, total_bytes);
+	/* exclusive access */
+	spin_lock(&xcdev->lock);
+
+	iobase = xdev->bar[xcdev->bar] + xcdev->base;
+	rv = xvc_shift_vector(iobase, tms_buf, tdi_buf, tdo_buf, total_bits);
 
-unlock:
 #if HAS_MMIOWB
 	mmiowb();
 #endif
 	spin_unlock(&xcdev->lock);
 
+	if (rv < 0)
+		return rv;
+
+	/* if testing bar access swap tdi and tdo bufferes to "loopback" */
+	if (xvc_obj->opcode == 0x2)
+		tdo_buf = tdi_buf;
+
+	rv = copy_to_user(xvc_obj->tdo_buf, (const void *)tdo_buf, total_bytes);
+	if (rv) {
+		pr_info("copy back tdo_buf failed: %d/%u.\n", rv, total_bytes);
+		return -EFAULT;
+	}
+
+	return 0;
+}
+
+/*
+ * XDMA_IOCXVC_BATCH: shift a list of vectors with one system call.
+ * The lock is taken per vector, as for separate XDMA_IOCXVC calls, so
+ * another user of the cable isn't locked out for a whole batch.
+ */
+static long xvc_ioctl_batch(struct xdma_cdev *xcdev, unsigned long arg)
+{
+	struct xvc_batch_ioc batch;
+	struct xvc_ioc *ops = NULL;
+	unsigned char *buffer = NULL;
+	unsigned int max_bytes = 0;
+	unsigned int i;
+	int rv;
+
+	if (copy_from_user(&batch, (void __user *)arg, sizeof(batch)))
+		return -EFAULT;
+	if (batch.count == 0 || batch.count > XVC_BATCH_MAX)
+		return -EINVAL;
+
+	ops = kmalloc_array(batch.count, sizeof(*ops), GFP_KERNEL);
+	if (!ops)
+		return -ENOMEM;
+	if (copy_from_user(ops, batch.ops, batch.count * sizeof(*ops))) {
+		rv = -EFAULT;
+		goto cleanup;
+	}
+
+	for (i = 0; i < batch.count; i++) {
+		if (ops[i].opcode != 0x01 && ops[i].opcode != 0x02) {
+			pr_info("UNKNOWN opcode 0x%x, vector %u.\n",
+				ops[i].opcode, i);
+			rv = -EINVAL;
+			goto cleanup;
+		}
+		max_bytes = max(max_bytes, (ops[i].length + 7) >> 3);
+	}
+
+	/* one buffer, for the longest vector, used by them all */
+	buffer = kmalloc(max_bytes * 3, GFP_KERNEL);
+	if (!buffer) {
+		pr_info("OOM %u, batch of %u.\n", 3 * max_bytes, batch.count);
+		rv = -ENOMEM;
+		goto cleanup;
+	}
+
+	rv = 0;
+	for (batch.done = 0; batch.done < batch.count; batch.done++) {
+		rv = xvc_do_ioc(xcdev, &ops[batch.done], buffer);
+		if (rv < 0)
+			break;
+	}
+
+	if (copy_to_user((void __user *)arg, &batch, sizeof(batch)) && !rv)
+		rv = -EFAULT;
+
 cleanup:
+	kfree(buffer);
+	kfree(ops);
+
+	return rv;
+}
+
+static long xvc_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+	struct xdma_cdev *xcdev = (struct xdma_cdev *)filp->private_data;
+	struct xvc_ioc xvc_obj;
+	unsigned int opcode;
+	unsigned int total_bytes;
+	unsigned char *buffer = NULL;
+	int rv;
+
+	rv = xcdev_check(__func__, xcdev, 0);
+	if (rv < 0)
+		return rv;
+
+	if (cmd == XDMA_IOCXVC_BATCH)
+		return xvc_ioctl_batch(xcdev, arg);
+
+	if (cmd != XDMA_IOCXVC) {
+		pr_info("ioctl 0x%x, UNKNOWN cmd.\n", cmd);
+		return -ENOIOCTLCMD;
+	}
+
+	rv = copy_from_user((void *)&xvc_obj, (void __user *)arg,
+				sizeof(struct xvc_ioc));
+	/* anything not copied ? */
+	if (rv) {
+		pr_info("copy_from_user xvc_obj failed: %d.\n", rv);
+		return -EFAULT;
+	}
+
+	opcode = xvc_obj.opcode;
+
+	/* Invalid operation type, no operation performed */
+	if (opcode != 0x01 && opcode != 0x02) {
+		pr_info("UNKNOWN opcode 0x%x.\n", opcode);
+		return -EINVAL;
+	}
+
+	total_bytes = (xvc_obj.length + 7) >> 3;
+
+	buffer = kmalloc(total_bytes * 3, GFP_KERNEL);
+	if (!buffer) {
+		pr_info("OOM %u, op 0x%x, len %u bits, %u bytes.\n",
+			3 * total_bytes, opcode, xvc_obj.length, total_bytes);
+		return -ENOMEM;
+	}
+
+	rv = xvc_do_ioc(xcdev, &xvc_obj, buffer);
+
 	kfree(buffer);
 
 	return rv;
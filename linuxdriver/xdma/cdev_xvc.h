@@ -37,6 +37,20 @@ struct xvc_ioc {
 	void __user *tdo_buf;
 };
 
+/*
+ * batched shifts: count xvc_ioc vectors shifted in order by one ioctl,
+ * each as XDMA_IOCXVC would. done is set to the number of vectors
+ * completed, so after an error the caller knows which one failed.
+ */
+#define XVC_BATCH_MAX		1024	/* most vectors in one batch */
+
+struct xvc_batch_ioc {
+	unsigned int count;
+	unsigned int done;
+	const struct xvc_ioc __user *ops;
+};
+
 #define XDMA_IOCXVC	_IOWR(XVC_MAGIC, 1, struct xvc_ioc)
+#define XDMA_IOCXVC_BATCH	_IOWR(XVC_MAGIC, 2, struct xvc_batch_ioc)
 
 #endif /* __XVC_IOCTL_H__ */
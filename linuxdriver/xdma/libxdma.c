@@ -54,6 +54,47 @@ module_param(desc_blen_max, uint, 0644);
 MODULE_PARM_DESC(desc_blen_max,
 		 "per descriptor max. buffer length, default is (1 << 28) - 1");
 
+/*
+ * interrupt steering: a CPU per engine/user IRQ, -1 = leave to irqbalance.
+ * With MSI-X the vector gets an affinity hint; in all modes the engine's
+ * bottom half is queued on that CPU.
+ */
+static int h2c_irq_cpu[XDMA_CHANNEL_NUM_MAX] = {
+	[0 ... XDMA_CHANNEL_NUM_MAX - 1] = -1 };
+module_param_array(h2c_irq_cpu, int, NULL, 0444);
+MODULE_PARM_DESC(h2c_irq_cpu, "CPU for each H2C engine's interrupt, -1 = any");
+
+static int c2h_irq_cpu[XDMA_CHANNEL_NUM_MAX] = {
+	[0 ... XDMA_CHANNEL_NUM_MAX - 1] = -1 };
+module_param_array(c2h_irq_cpu, int, NULL, 0444);
+MODULE_PARM_DESC(c2h_irq_cpu, "CPU for each C2H engine's interrupt, -1 = any");
+
+static int user_irq_cpu[MAX_USER_IRQ] = { [0 ... MAX_USER_IRQ - 1] = -1 };
+module_param_array(user_irq_cpu, int, NULL, 0444);
+MODULE_PARM_DESC(user_irq_cpu, "CPU for each user interrupt, -1 = any");
+
+/*
+ * low latency engines: with MSI-X, service completions in a threaded IRQ
+ * handler (a SCHED_FIFO kernel thread) instead of queueing work
+ */
+static bool h2c_irq_thread[XDMA_CHANNEL_NUM_MAX];
+module_param_array(h2c_irq_thread, bool, NULL, 0444);
+MODULE_PARM_DESC(h2c_irq_thread, "Service each H2C engine's completions in an IRQ thread (MSI-X only), default is 0");
+
+static bool c2h_irq_thread[XDMA_CHANNEL_NUM_MAX];
+module_param_array(c2h_irq_thread, bool, NULL, 0444);
+MODULE_PARM_DESC(c2h_irq_thread, "Service each C2H engine's completions in an IRQ thread (MSI-X only), default is 0");
+
+static unsigned int intr_work_highpri;
+module_param(intr_work_highpri, uint, 0644);
+MODULE_PARM_DESC(intr_work_highpri,
+	"Set 1 to run engine interrupt bottom halves on the high priority workqueue, default is 0");
+
+static unsigned int desc_cache = 1;
+module_param(desc_cache, uint, 0644);
+MODULE_PARM_DESC(desc_cache,
+	"Set 0 to rebuild descriptors for every transfer, default is 1 (reuse cached chains)");
+
 #define XDMA_PERF_NUM_DESC 128
 
 /* Kernel version adaptative code */
@@ -750,6 +791,7 @@ static struct xdma_transfer *engine_start(struct xdma_engine *engine)
 	mmiowb();
 #endif
 
+	transfer->start_time = ktime_get_raw();
 	rv = engine_start_mode_config(engine);
 	if (rv < 0) {
 		pr_err("Failed to start engine mode config\n");
@@ -805,6 +847,8 @@ static struct xdma_transfer *engine_transfer_completion(
 		return NULL;
 	}
 
+	transfer->complete_time = ktime_get_raw();
+
 	/* synchronous I/O? */
 	/* awake task on transfer's wait queue */
 	xlx_wake_up(&transfer->wq);
@@ -1195,28 +1239,43 @@ done:
 	return err_flag ? -1 : 0;
 }
 
-/* engine_service_work */
-static void engine_service_work(struct work_struct *work)
+/*
+ * engine_service_irq() - service an engine after its interrupt, and
+ * re-enable the interrupt.
+ * servicing starts the next queued transfer; if that has already completed
+ * too (the engine has stopped again), it is serviced in the same pass, up to
+ * XDMA_IRQ_BATCH_MAX times, rather than after another interrupt
+ */
+#define XDMA_IRQ_BATCH_MAX	8
+
+static void engine_service_irq(struct xdma_engine *engine)
 {
-	struct xdma_engine *engine;
+	struct xdma_engine_stats *stats = &engine->stats;
 	unsigned long flags;
+	u64 ns;
+	int pass;
 	int rv;
 
-	engine = container_of(work, struct xdma_engine, work);
-	if (engine->magic != MAGIC_ENGINE) {
-		pr_err("%s has invalid magic number %lx\n", engine->name,
-		       engine->magic);
-		return;
-	}
-
 	/* lock the engine */
 	spin_lock_irqsave(&engine->lock, flags);
 
-	dbg_tfr("engine_service() for %s engine %p\n", engine->name, engine);
-	rv = engine_service(engine, 0);
-	if (rv < 0) {
-		pr_err("Failed to service engine\n");
-		goto unlock;
+	ns = ktime_to_ns(ktime_sub(ktime_get(), engine->irq_time));
+	stats->irq_services++;
+	stats->irq_lat_total_ns += ns;
+	if (ns > stats->irq_lat_max_ns)
+		stats->irq_lat_max_ns = ns;
+
+	for (pass = 0; pass < XDMA_IRQ_BATCH_MAX; pass++) {
+		dbg_tfr("engine_service() for %s engine %p\n", engine->name,
+			engine);
+		rv = engine_service(engine, 0);
+		if (rv < 0) {
+			pr_err("Failed to service engine\n");
+			goto unlock;
+		}
+		if (engine->eop_flush || !engine->running ||
+		    (read_register(&engine->regs->status) & XDMA_STAT_BUSY))
+			break;
 	}
 
 	/* re-enable interrupts for this engine */
@@ -1235,6 +1294,20 @@ unlock:
 	spin_unlock_irqrestore(&engine->lock, flags);
 }
 
+/* engine_service_work */
+static void engine_service_work(struct work_struct *work)
+{
+	struct xdma_engine *engine;
+
+	engine = container_of(work, struct xdma_engine, work);
+	if (engine->magic != MAGIC_ENGINE) {
+		pr_err("%s has invalid magic number %lx\n", engine->name,
+		       engine->magic);
+		return;
+	}
+	engine_service_irq(engine);
+}
+
 static u32 engine_service_wb_monitor(struct xdma_engine *engine,
 				     u32 expected_wb)
 {
@@ -1344,15 +1417,54 @@ static irqreturn_t user_irq_service(int irq, struct xdma_user_irq *user_irq)
 		return user_irq->handler(user_irq->user_idx, user_irq->dev);
 
 	spin_lock_irqsave(&(user_irq->events_lock), flags);
-	if (!user_irq->events_irq) {
-		user_irq->events_irq = 1;
-		wake_up_interruptible(&(user_irq->events_wq));
-	}
+	user_irq->events_irq = 1;
+	/* every IRQ wakes: an sgdma poll() waits for a count change */
+	user_irq->events_count++;
+	wake_up_interruptible(&(user_irq->events_wq));
 	spin_unlock_irqrestore(&(user_irq->events_lock), flags);
 
 	return IRQ_HANDLED;
 }
 
+
+/* queue an engine's interrupt bottom half, on its steering CPU if set */
+static void engine_schedule_work(struct xdma_engine *engine)
+{
+	struct workqueue_struct *wq = intr_work_highpri ? system_highpri_wq :
+							  system_wq;
+
+	engine->irq_time = ktime_get();
+
+	if (engine->irq_cpu >= 0 && cpu_online(engine->irq_cpu))
+		queue_work_on(engine->irq_cpu, wq, &engine->work);
+	else
+		queue_work(wq, &engine->work);
+}
+
+/* set (cpu >= 0) or clear (cpu < 0) the affinity hint of an IRQ vector */
+static void irq_affinity_hint(u32 vector, int cpu)
+{
+	const struct cpumask *mask = NULL;
+	int rv;
+
+	if (cpu >= 0) {
+		if (cpu >= nr_cpu_ids || !cpu_online(cpu)) {
+			pr_info("IRQ#%d: cpu %d not online, no affinity hint.\n",
+				vector, cpu);
+			return;
+		}
+		mask = cpumask_of(cpu);
+	}
+#if KERNEL_VERSION(5, 17, 0) <= LINUX_VERSION_CODE
+	rv = irq_set_affinity_and_hint(vector, mask);
+#else
+	rv = irq_set_affinity_hint(vector, mask);
+#endif
+	if (rv)
+		pr_info("IRQ#%d: affinity hint cpu %d failed %d.\n", vector,
+			cpu, rv);
+}
+
 /*
  * xdma_isr() - Interrupt handler
  *
@@ -1424,7 +1536,7 @@ static irqreturn_t xdma_isr(int irq, void *dev_id)
 			    (engine->magic == MAGIC_ENGINE)) {
 				mask &= ~engine->irq_bitmask;
 				dbg_tfr("schedule_work, %s.\n", engine->name);
-				schedule_work(&engine->work);
+				engine_schedule_work(engine);
 			}
 		}
 	}
@@ -1443,7 +1555,7 @@ static irqreturn_t xdma_isr(int irq, void *dev_id)
 			    (engine->magic == MAGIC_ENGINE)) {
 				mask &= ~engine->irq_bitmask;
 				dbg_tfr("schedule_work, %s.\n", engine->name);
-				schedule_work(&engine->work);
+				engine_schedule_work(engine);
 			}
 		}
 	}
@@ -1509,14 +1621,33 @@ static irqreturn_t xdma_channel_irq(int irq, void *dev_id)
 			(unsigned long)(&engine->regs));
 	/* Dummy read to flush the above write */
 	read_register(&irq_regs->channel_int_pending);
-	/* Schedule the bottom half */
-	schedule_work(&engine->work);
 
 	/*
 	 * need to protect access here if multiple MSI-X are used for
 	 * user interrupts
 	 */
 	xdev->irq_count++;
+
+	/* service in the IRQ thread, or schedule the bottom half */
+	if (engine->irq_thread) {
+		engine->irq_time = ktime_get();
+		return IRQ_WAKE_THREAD;
+	}
+	engine_schedule_work(engine);
+	return IRQ_HANDLED;
+}
+
+/*
+ * xdma_channel_irq_thread() - threaded handler for channel interrupts of
+ * low latency engines in MSI-X mode
+ *
+ * @dev_id pointer to xdma_engine
+ */
+static irqreturn_t xdma_channel_irq_thread(int irq, void *dev_id)
+{
+	struct xdma_engine *engine = (struct xdma_engine *)dev_id;
+
+	engine_service_irq(engine);
 	return IRQ_HANDLED;
 }
 
@@ -1970,6 +2101,8 @@ static void irq_msix_channel_teardown(struct xdma_dev *xdev)
 			break;
 		dbg_sg("Release IRQ#%d for engine %p\n", engine->msix_irq_line,
 		       engine);
+		if (engine->irq_cpu >= 0)
+			irq_affinity_hint(engine->msix_irq_line, -1);
 		free_irq(engine->msix_irq_line, engine);
 	}
 
@@ -1979,6 +2112,8 @@ static void irq_msix_channel_teardown(struct xdma_dev *xdev)
 			break;
 		dbg_sg("Release IRQ#%d for engine %p\n", engine->msix_irq_line,
 		       engine);
+		if (engine->irq_cpu >= 0)
+			irq_affinity_hint(engine->msix_irq_line, -1);
 		free_irq(engine->msix_irq_line, engine);
 	}
 }
@@ -2007,15 +2142,20 @@ static int irq_msix_channel_setup(struct xdma_dev *xdev)
 #else
 		vector = xdev->entry[i].vector;
 #endif
-		rv = request_irq(vector, xdma_channel_irq, 0, xdev->mod_name,
-				 engine);
+		rv = request_threaded_irq(vector, xdma_channel_irq,
+				engine->irq_thread ? xdma_channel_irq_thread :
+						     NULL,
+				0, xdev->mod_name, engine);
 		if (rv) {
 			pr_info("requesti irq#%d failed %d, engine %s.\n",
 				vector, rv, engine->name);
 			return rv;
 		}
-		pr_info("engine %s, irq#%d.\n", engine->name, vector);
+		pr_info("engine %s, irq#%d%s.\n", engine->name, vector,
+			engine->irq_thread ? ", IRQ thread" : "");
 		engine->msix_irq_line = vector;
+		if (engine->irq_cpu >= 0)
+			irq_affinity_hint(vector, engine->irq_cpu);
 	}
 
 	engine = xdev->engine_c2h;
@@ -2025,15 +2165,20 @@ static int irq_msix_channel_setup(struct xdma_dev *xdev)
 #else
 		vector = xdev->entry[j].vector;
 #endif
-		rv = request_irq(vector, xdma_channel_irq, 0, xdev->mod_name,
-				 engine);
+		rv = request_threaded_irq(vector, xdma_channel_irq,
+				engine->irq_thread ? xdma_channel_irq_thread :
+						     NULL,
+				0, xdev->mod_name, engine);
 		if (rv) {
 			pr_info("requesti irq#%d failed %d, engine %s.\n",
 				vector, rv, engine->name);
 			return rv;
 		}
-		pr_info("engine %s, irq#%d.\n", engine->name, vector);
+		pr_info("engine %s, irq#%d%s.\n", engine->name, vector,
+			engine->irq_thread ? ", IRQ thread" : "");
 		engine->msix_irq_line = vector;
+		if (engine->irq_cpu >= 0)
+			irq_affinity_hint(vector, engine->irq_cpu);
 	}
 
 	return 0;
@@ -2063,6 +2208,8 @@ static void irq_msix_user_teardown(struct xdma_dev *xdev)
 		u32 vector = xdev->entry[j].vector;
 #endif
 		dbg_init("user %d, releasing IRQ#%d\n", i, vector);
+		if (user_irq_cpu[i] >= 0)
+			irq_affinity_hint(vector, -1);
 		free_irq(vector, &xdev->user_irq[i]);
 	}
 }
@@ -2089,6 +2236,8 @@ static int irq_msix_user_setup(struct xdma_dev *xdev)
 		}
 		pr_info("%d-USR-%d, IRQ#%d with 0x%p\n", xdev->idx, i, vector,
 			&xdev->user_irq[i]);
+		if (user_irq_cpu[i] >= 0)
+			irq_affinity_hint(vector, user_irq_cpu[i]);
 	}
 
 	/* If any errors occur, free IRQs that were successfully requested */
@@ -2099,6 +2248,8 @@ static int irq_msix_user_setup(struct xdma_dev *xdev)
 #else
 			u32 vector = xdev->entry[j].vector;
 #endif
+			if (user_irq_cpu[i] >= 0)
+				irq_affinity_hint(vector, -1);
 			free_irq(vector, &xdev->user_irq[i]);
 		}
 	}
@@ -2552,6 +2703,79 @@ static void engine_alignments(struct xdma_engine *engine)
 	}
 }
 
+static void desc_cache_free(struct xdma_engine *engine)
+{
+	struct xdma_dev *xdev = engine->xdev;
+	unsigned int n = XDMA_DESC_CACHE_ENTRIES * XDMA_DESC_CACHE_DESC;
+
+	if (engine->desc_cache_res) {
+		dma_free_coherent(&xdev->pdev->dev,
+				  n * sizeof(struct xdma_result),
+				  engine->desc_cache_res,
+				  engine->desc_cache_res_bus);
+		engine->desc_cache_res = NULL;
+	}
+	if (engine->desc_cache_virt) {
+		dma_free_coherent(&xdev->pdev->dev,
+				  n * sizeof(struct xdma_desc),
+				  engine->desc_cache_virt, engine->desc_cache_bus);
+		engine->desc_cache_virt = NULL;
+	}
+	kfree(engine->desc_cache);
+	engine->desc_cache = NULL;
+}
+
+static int desc_cache_alloc(struct xdma_engine *engine)
+{
+	struct xdma_dev *xdev = engine->xdev;
+	unsigned int n = XDMA_DESC_CACHE_ENTRIES * XDMA_DESC_CACHE_DESC;
+	int i;
+
+	engine->desc_cache = kcalloc(XDMA_DESC_CACHE_ENTRIES,
+				sizeof(struct xdma_desc_cache_entry),
+				GFP_KERNEL);
+	if (!engine->desc_cache)
+		return -ENOMEM;
+
+	engine->desc_cache_virt = dma_alloc_coherent(&xdev->pdev->dev,
+					n * sizeof(struct xdma_desc),
+					&engine->desc_cache_bus, GFP_KERNEL);
+	if (!engine->desc_cache_virt)
+		goto err_out;
+
+	if (engine->streaming && engine->dir == DMA_FROM_DEVICE) {
+		engine->desc_cache_res = dma_alloc_coherent(&xdev->pdev->dev,
+					n * sizeof(struct xdma_result),
+					&engine->desc_cache_res_bus,
+					GFP_KERNEL);
+		if (!engine->desc_cache_res)
+			goto err_out;
+	}
+
+	/*
+	 * each chain is 1KB of a page aligned block, so no chain crosses a
+	 * 4KB boundary and the adjacent counts behave as in the main ring.
+	 */
+	for (i = 0; i < XDMA_DESC_CACHE_ENTRIES; i++) {
+		struct xdma_desc_cache_entry *entry = engine->desc_cache + i;
+		unsigned int idx = i * XDMA_DESC_CACHE_DESC;
+
+		entry->desc_virt = engine->desc_cache_virt + idx;
+		entry->desc_bus = engine->desc_cache_bus +
+				idx * sizeof(struct xdma_desc);
+		if (engine->desc_cache_res) {
+			entry->res_virt = engine->desc_cache_res + idx;
+			entry->res_bus = engine->desc_cache_res_bus +
+					idx * sizeof(struct xdma_result);
+		}
+	}
+	return 0;
+
+err_out:
+	desc_cache_free(engine);
+	return -ENOMEM;
+}
+
 static void engine_free_resource(struct xdma_engine *engine)
 {
 	struct xdma_dev *xdev = engine->xdev;
@@ -2584,6 +2808,8 @@ static void engine_free_resource(struct xdma_engine *engine)
 			engine->cyclic_result, engine->cyclic_result_bus);
 		engine->cyclic_result = NULL;
 	}
+
+	desc_cache_free(engine);
 }
 
 static int engine_destroy(struct xdma_dev *xdev, struct xdma_engine *engine)
@@ -2824,6 +3050,11 @@ static int engine_alloc_resource(struct xdma_engine *engine)
 		}
 	}
 
+	/* the chain cache is an optimisation; run without it if OOM */
+	if (desc_cache_alloc(engine) < 0)
+		pr_warn("%s, %s desc cache OOM, disabled.\n",
+			dev_name(&xdev->pdev->dev), engine->name);
+
 	return 0;
 
 err_out:
@@ -2861,6 +3092,12 @@ static int engine_init(struct xdma_engine *engine, struct xdma_dev *xdev,
 
 	/* remember SG DMA direction */
 	engine->dir = dir;
+	engine->irq_cpu = (dir == DMA_TO_DEVICE) ? h2c_irq_cpu[channel] :
+						   c2h_irq_cpu[channel];
+	if (engine->irq_cpu >= (int)nr_cpu_ids)
+		engine->irq_cpu = -1;
+	engine->irq_thread = (dir == DMA_TO_DEVICE) ? h2c_irq_thread[channel] :
+						      c2h_irq_thread[channel];
 	snprintf(engine->name, sizeof(engine->name), "%d-%s%d-%s", xdev->idx,
 		(dir == DMA_TO_DEVICE) ? "H2C" : "C2H", channel,
 		engine->streaming ? "ST" : "MM");
@@ -2894,8 +3131,11 @@ static int engine_init(struct xdma_engine *engine, struct xdma_dev *xdev,
 /* transfer_destroy() - free transfer */
 static void transfer_destroy(struct xdma_dev *xdev, struct xdma_transfer *xfer)
 {
-    /* free descriptors */
-	xdma_desc_done(xfer->desc_virt, xfer->desc_num);
+	/* free descriptors; a cached chain is kept intact for reuse */
+	if (xfer->cache)
+		WRITE_ONCE(xfer->cache->busy, 0);
+	else
+		xdma_desc_done(xfer->desc_virt, xfer->desc_num);
 
 	if (xfer->last_in_request && (xfer->flags & XFER_FLAG_NEED_UNMAP)) {
 		struct sg_table *sgt = xfer->sgt;
@@ -2918,6 +3158,10 @@ static int transfer_build(struct xdma_engine *engine,
 	dma_addr_t bus = xfer->res_bus;
 
 	for (; i < desc_max; i++, j++, sdesc++) {
+		/* a vectored request carries an FPGA address per entry */
+		if (req->vectored)
+			req->ep_addr = sdesc->ep_addr;
+
 		dbg_desc("sw desc %d/%u: 0x%llx, 0x%x, ep 0x%llx.\n",
 			 i + req->sw_desc_idx, req->sw_desc_cnt, sdesc->addr,
 			 sdesc->len, req->ep_addr);
@@ -2947,15 +3191,138 @@ static int transfer_build(struct xdma_engine *engine,
 }
 
 
+/* transfer_terminate() - mark the end of a built chain and fill in the
+ * adjacent descriptor counts
+ */
+static void transfer_terminate(struct xdma_engine *engine,
+			struct xdma_transfer *xfer, unsigned int desc_max)
+{
+	int last = desc_max - 1;
+	u32 control;
+	int i;
+
+	/* stop engine, EOP for AXI ST, req IRQ on last descriptor */
+	control = XDMA_DESC_STOPPED;
+	control |= XDMA_DESC_EOP;
+	control |= XDMA_DESC_COMPLETED;
+	xdma_desc_control_set(xfer->desc_virt + last, control);
+
+	if (engine->eop_flush)
+		for (i = 0; i < last; i++)
+			xdma_desc_control_set(xfer->desc_virt + i,
+					XDMA_DESC_COMPLETED);
+
+	/* fill in adjacent numbers */
+	for (i = 0; i < desc_max; i++) {
+		u32 next_adj = xdma_get_next_adj(desc_max - i - 1,
+						(xfer->desc_virt + i)->next_lo);
+
+		dbg_desc("set next adj at index %d to %u\n", i, next_adj);
+		xdma_desc_adjacent(xfer->desc_virt + i, next_adj);
+	}
+}
+
+static int desc_cache_match(struct xdma_desc_cache_entry *entry,
+			struct xdma_request_cb *req, unsigned int desc_max)
+{
+	struct sw_desc *sdesc = &(req->sdesc[req->sw_desc_idx]);
+	int i;
+
+	if (entry->desc_num != desc_max || entry->ep_addr != req->ep_addr)
+		return 0;
+
+	for (i = 0; i < desc_max; i++)
+		if (entry->sdesc[i].addr != sdesc[i].addr ||
+		    entry->sdesc[i].len != sdesc[i].len ||
+		    entry->sdesc[i].ep_addr != sdesc[i].ep_addr)
+			return 0;
+	return 1;
+}
+
+/* transfer_init_cached() - set up a transfer on a cached descriptor chain
+ *
+ * Looks for a chain already built for this part of the request; if none
+ * matches, the least recently used idle chain is rebuilt for it. Called
+ * with engine->lock held.
+ *
+ * @return 1 if the transfer uses a cached chain, 0 to use the main ring
+ */
+static int transfer_init_cached(struct xdma_engine *engine,
+			struct xdma_request_cb *req, struct xdma_transfer *xfer,
+			unsigned int desc_max)
+{
+	struct xdma_desc_cache_entry *entry = NULL;
+	struct xdma_desc_cache_entry *victim = NULL;
+	int i;
+
+	if (!desc_cache || !engine->desc_cache || engine->eop_flush ||
+	    desc_max > XDMA_DESC_CACHE_DESC)
+		return 0;
+
+	for (i = 0; i < XDMA_DESC_CACHE_ENTRIES; i++) {
+		struct xdma_desc_cache_entry *e = engine->desc_cache + i;
+
+		if (READ_ONCE(e->busy))
+			continue;
+		if (desc_cache_match(e, req, desc_max)) {
+			entry = e;
+			break;
+		}
+		if (!victim || e->last_used < victim->last_used)
+			victim = e;
+	}
+
+	if (!entry && !victim)
+		return 0;	/* every cached chain is in flight */
+
+	xfer->desc_virt = entry ? entry->desc_virt : victim->desc_virt;
+	xfer->desc_bus = entry ? entry->desc_bus : victim->desc_bus;
+	xfer->res_virt = entry ? entry->res_virt : victim->res_virt;
+	xfer->res_bus = entry ? entry->res_bus : victim->res_bus;
+
+	if (entry) {
+		engine->desc_cache_hits++;
+		xfer->len = entry->len;
+		if (!engine->non_incr_addr)
+			req->ep_addr += entry->len;
+		req->sw_desc_idx += desc_max;
+		if (xfer->res_virt)
+			memset(xfer->res_virt, 0,
+			       desc_max * sizeof(struct xdma_result));
+	} else {
+		entry = victim;
+		engine->desc_cache_misses++;
+		entry->ep_addr = req->ep_addr;
+		memcpy(entry->sdesc, &(req->sdesc[req->sw_desc_idx]),
+		       desc_max * sizeof(struct sw_desc));
+
+		transfer_desc_init(xfer, desc_max);
+		transfer_build(engine, req, xfer, desc_max);
+		transfer_terminate(engine, xfer, desc_max);
+
+		entry->desc_num = desc_max;
+		entry->len = xfer->len;
+	}
+	dbg_sg("xfer= %p desc cache hits %lu, misses %lu.\n", xfer,
+		engine->desc_cache_hits, engine->desc_cache_misses);
+
+	entry->busy = 1;
+	entry->last_used = ++engine->desc_cache_tick;
+	xfer->cache = entry;
+
+	xfer->desc_adjacent = desc_max;
+	xfer->desc_cmpl_th = desc_max;
+	xfer->desc_num = desc_max;
+	engine->desc_used += desc_max;
+	return 1;
+}
+
 static int transfer_init(struct xdma_engine *engine,
 			struct xdma_request_cb *req, struct xdma_transfer *xfer)
 {
 	unsigned int desc_max = min_t(unsigned int,
 				req->sw_desc_cnt - req->sw_desc_idx,
 				XDMA_TRANSFER_MAX_DESC);
-	int i = 0;
-	int last = 0;
-	u32 control;
 	unsigned long flags;
 
 	memset(xfer, 0, sizeof(*xfer));
@@ -2971,6 +3338,12 @@ static int transfer_init(struct xdma_engine *engine,
 
 	/* remember direction of transfer */
 	xfer->dir = engine->dir;
+
+	if (transfer_init_cached(engine, req, xfer, desc_max)) {
+		spin_unlock_irqrestore(&engine->lock, flags);
+		return 0;
+	}
+
 	xfer->desc_virt = engine->desc + engine->desc_idx;
 	xfer->res_virt = engine->cyclic_result + engine->desc_idx;
 	xfer->desc_bus = engine->desc_bus +
@@ -2989,39 +3362,19 @@ static int transfer_init(struct xdma_engine *engine,
 	dbg_sg("xfer= %p transfer->desc_bus = 0x%llx.\n",
 		xfer, (u64)xfer->desc_bus);
 	transfer_build(engine, req, xfer, desc_max);
+	transfer_terminate(engine, xfer, desc_max);
 
-	xfer->desc_adjacent = desc_max;
-
-	/* terminate last descriptor */
-	last = desc_max - 1;
-	/* stop engine, EOP for AXI ST, req IRQ on last descriptor */
-	control = XDMA_DESC_STOPPED;
-	control |= XDMA_DESC_EOP;
-	control |= XDMA_DESC_COMPLETED;
-	xdma_desc_control_set(xfer->desc_virt + last, control);
-
-	if (engine->eop_flush) {
-		for (i = 0; i < last; i++)
-			xdma_desc_control_set(xfer->desc_virt + i,
-					XDMA_DESC_COMPLETED);
+	if (engine->eop_flush)
 		xfer->desc_cmpl_th = 1;
-	} else
+	else
 		xfer->desc_cmpl_th = desc_max;
 
+	xfer->desc_adjacent = desc_max;
 	xfer->desc_num = desc_max;
 	engine->desc_idx = (engine->desc_idx + desc_max) %
 					XDMA_TRANSFER_MAX_DESC;
 	engine->desc_used += desc_max;
 
-	/* fill in adjacent numbers */
-	for (i = 0; i < xfer->desc_num; i++) {
-		u32 next_adj = xdma_get_next_adj(xfer->desc_num - i - 1,
-						(xfer->desc_virt + i)->next_lo);
-
-		dbg_desc("set next adj at index %d to %u\n", i, next_adj);
-		xdma_desc_adjacent(xfer->desc_virt + i, next_adj);
-	}
-
 	spin_unlock_irqrestore(&engine->lock, flags);
 	return 0;
 }
@@ -3030,8 +3383,11 @@ static int transfer_init(struct xdma_engine *engine,
 static void sgt_dump(struct sg_table *sgt)
 {
 	int i;
-	struct scatterlist *sg = sgt->sgl;
+	struct scatterlist *sg;
 
+	if (!sgt)
+		return;
+	sg = sgt->sgl;
 	pr_info("sgt 0x%p, sgl 0x%p, nents %u/%u.\n", sgt, sgt->sgl, sgt->nents,
 		sgt->orig_nents);
 
@@ -3083,31 +3439,30 @@ static struct xdma_request_cb *xdma_request_alloc(unsigned int sdesc_nr)
 	return req;
 }
 
-static struct xdma_request_cb *xdma_init_request(struct sg_table *sgt,
-						 u64 ep_addr)
+/* number of sw descriptors needed for an sg table */
+static unsigned int sgt_desc_count(struct sg_table *sgt)
 {
-	struct xdma_request_cb *req;
 	struct scatterlist *sg = sgt->sgl;
-	int max = sgt->nents;
-	int extra = 0;
-	int i, j = 0;
+	unsigned int max = sgt->nents;
+	unsigned int extra = 0;
+	int i;
 
-	for (i = 0; i < max; i++, sg = sg_next(sg)) {
+	for (i = 0; i < sgt->nents; i++, sg = sg_next(sg)) {
 		unsigned int len = sg_dma_len(sg);
 
 		if (unlikely(len > desc_blen_max))
 			extra += (len + desc_blen_max - 1) / desc_blen_max;
 	}
+	return max + extra;
+}
 
-	dbg_tfr("ep 0x%llx, desc %u+%u.\n", ep_addr, max, extra);
-
-	max += extra;
-	req = xdma_request_alloc(max);
-	if (!req)
-		return NULL;
-
-	req->sgt = sgt;
-	req->ep_addr = ep_addr;
+/* fill sw descriptors from entry j on, splitting at desc_blen_max */
+static unsigned int xdma_request_fill(struct xdma_request_cb *req,
+			struct sg_table *sgt, unsigned int j, u64 ep_addr,
+			bool incr)
+{
+	struct scatterlist *sg;
+	int i;
 
 	for (i = 0, sg = sgt->sgl; i < sgt->nents; i++, sg = sg_next(sg)) {
 		unsigned int tlen = sg_dma_len(sg);
@@ -3116,6 +3471,7 @@ static struct xdma_request_cb *xdma_init_request(struct sg_table *sgt,
 		req->total_len += tlen;
 		while (tlen) {
 			req->sdesc[j].addr = addr;
+			req->sdesc[j].ep_addr = ep_addr;
 			if (tlen > desc_blen_max) {
 				req->sdesc[j].len = desc_blen_max;
 				addr += desc_blen_max;
@@ -3124,10 +3480,32 @@ static struct xdma_request_cb *xdma_init_request(struct sg_table *sgt,
 				req->sdesc[j].len = tlen;
 				tlen = 0;
 			}
+			if (incr)
+				ep_addr += req->sdesc[j].len;
 			j++;
 		}
 	}
+	return j;
+}
+
+static struct xdma_request_cb *xdma_init_request(struct sg_table *sgt,
+						 u64 ep_addr)
+{
+	struct xdma_request_cb *req;
+	unsigned int max = sgt_desc_count(sgt);
+	unsigned int j;
+
+	dbg_tfr("ep 0x%llx, desc %u+%u.\n", ep_addr, sgt->nents,
+		max - sgt->nents);
+
+	req = xdma_request_alloc(max);
+	if (!req)
+		return NULL;
+
+	req->sgt = sgt;
+	req->ep_addr = ep_addr;
 
+	j = xdma_request_fill(req, sgt, 0, ep_addr, true);
 	if (j > max) {
 		pr_err("Cannot transfer more than supported length %d\n",
 		       desc_blen_max);
@@ -3141,89 +3519,154 @@ static struct xdma_request_cb *xdma_init_request(struct sg_table *sgt,
 	return req;
 }
 
-ssize_t xdma_xfer_submit(void *dev_hndl, int channel, bool write, u64 ep_addr,
-			 struct sg_table *sgt, bool dma_mapped, int timeout_ms)
+/* xdma_init_request_vec() - one request covering several sg tables, each
+ * at its own FPGA address
+ */
+static struct xdma_request_cb *xdma_init_request_vec(
+			struct xdma_engine *engine, struct xdma_vec_seg *segs,
+			unsigned int nsegs)
 {
-	struct xdma_dev *xdev = (struct xdma_dev *)dev_hndl;
-	struct xdma_engine *engine;
-	int rv = 0, tfer_idx = 0, i;
-	ssize_t done = 0;
-	struct scatterlist *sg = sgt->sgl;
-	int nents;
-	enum dma_data_direction dir = write ? DMA_TO_DEVICE : DMA_FROM_DEVICE;
-	struct xdma_request_cb *req = NULL;
+	struct xdma_request_cb *req;
+	unsigned int max = 0;
+	unsigned int i, j = 0;
 
-	if (!dev_hndl)
-		return -EINVAL;
+	for (i = 0; i < nsegs; i++)
+		max += sgt_desc_count(segs[i].sgt);
 
-	if (debug_check_dev_hndl(__func__, xdev->pdev, dev_hndl) < 0)
-		return -EINVAL;
+	req = xdma_request_alloc(max);
+	if (!req)
+		return NULL;
 
-	if (write == 1) {
-		if (channel >= xdev->h2c_channel_max) {
-			pr_err("H2C channel %d >= %d.\n", channel,
-				xdev->h2c_channel_max);
-			return -EINVAL;
-		}
-		engine = &xdev->engine_h2c[channel];
-	} else if (write == 0) {
-		if (channel >= xdev->c2h_channel_max) {
-			pr_err("C2H channel %d >= %d.\n", channel,
-				xdev->c2h_channel_max);
-			return -EINVAL;
+	req->ep_addr = segs[0].ep_addr;
+	req->vectored = 1;
+	for (i = 0; i < nsegs; i++)
+		j = xdma_request_fill(req, segs[i].sgt, j, segs[i].ep_addr,
+				      !engine->non_incr_addr);
+	req->sw_desc_cnt = j;
+
+	dbg_tfr("%u segs, desc %u, len %u.\n", nsegs, j, req->total_len);
+	return req;
+}
+
+/*
+ * engine_busy_poll() - poll for a transfer to complete, before sleeping
+ *
+ * Spins for up to the engine's poll window waiting for the engine to go
+ * idle having completed the transfer's descriptors (any, for EOP flush
+ * streaming, which stops early), then services it here instead of waiting for the interrupt and
+ * the service work it schedules. For short, latency critical transfers
+ * this saves the interrupt to wake up path. If the transfer isn't done in
+ * the window the caller sleeps on it as usual, with the interrupt as the
+ * completion. The interrupt for a transfer completed here still arrives;
+ * it then finds the engine stopped and only clears the status.
+ */
+static void engine_busy_poll(struct xdma_engine *engine,
+			     struct xdma_transfer *xfer)
+{
+	ktime_t end = ktime_add_us(ktime_get(), engine->poll_us);
+	unsigned long flags;
+	u32 status;
+	u32 count;
+
+	while (READ_ONCE(xfer->state) == TRANSFER_STATE_SUBMITTED) {
+		status = read_register(&engine->regs->status);
+		count = read_register(&engine->regs->completed_desc_count) -
+			engine->desc_dequeued;
+		if (!(status & XDMA_STAT_BUSY) &&
+		    (count >= xfer->desc_num ||
+		     (engine->eop_flush && count != 0))) {
+			spin_lock_irqsave(&engine->lock, flags);
+			if (xfer->state == TRANSFER_STATE_SUBMITTED &&
+			    engine->running)
+				engine_service(engine, 0);
+			spin_unlock_irqrestore(&engine->lock, flags);
+			break;
 		}
-		engine = &xdev->engine_c2h[channel];
+		if (ktime_after(ktime_get(), end))
+			break;
+		cpu_relax();
 	}
+}
 
-	if (!engine) {
-		pr_err("dma engine NULL\n");
-		return -EINVAL;
-	}
+/* engine_stats_add() - account one completed request, and keep its times */
+static void engine_stats_add(struct xdma_engine *engine, ssize_t bytes,
+			     struct xdma_request_cb *req)
+{
+	struct xdma_engine_stats *stats = &engine->stats;
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), req->start));
+	unsigned long flags;
 
-	if (engine->magic != MAGIC_ENGINE) {
-		pr_err("%s has invalid magic number %lx\n", engine->name,
-		       engine->magic);
-		return -EINVAL;
-	}
+	spin_lock_irqsave(&engine->lock, flags);
+	engine->timing.submit = req->submit_raw;
+	engine->timing.start = req->start_raw;
+	engine->timing.complete = req->complete_raw;
+	engine->timing.bytes = bytes;
+	engine->timing.sequence++;
+	stats->transfers++;
+	stats->bytes += bytes;
+	stats->lat_total_ns += ns;
+	if (!stats->lat_min_ns || ns < stats->lat_min_ns)
+		stats->lat_min_ns = ns;
+	if (ns > stats->lat_max_ns)
+		stats->lat_max_ns = ns;
+	spin_unlock_irqrestore(&engine->lock, flags);
+}
 
-	xdev = engine->xdev;
-	if (xdma_device_flag_check(xdev, XDEV_FLAG_OFFLINE)) {
-		pr_info("xdev 0x%p, offline.\n", xdev);
-		return -EBUSY;
-	}
+static void engine_stats_timeout(struct xdma_engine *engine)
+{
+	unsigned long flags;
 
-	/* check the direction */
-	if (engine->dir != dir) {
-		pr_info("0x%p, %s, %d, W %d, 0x%x/0x%x mismatch.\n", engine,
-			engine->name, channel, write, engine->dir, dir);
-		return -EINVAL;
-	}
+	spin_lock_irqsave(&engine->lock, flags);
+	engine->stats.timeouts++;
+	spin_unlock_irqrestore(&engine->lock, flags);
+}
 
-	if (!dma_mapped) {
-		nents = dma_map_sg(&xdev->pdev->dev, sg, sgt->orig_nents, dir);
-		if (!nents) {
-			pr_info("map sgl failed, sgt 0x%p.\n", sgt);
-			return -EIO;
-		}
-		sgt->nents = nents;
-	} else {
-		if (!sgt->nents) {
-			pr_err("sg table has invalid number of entries 0x%p.\n",
-			       sgt);
-			return -EIO;
-		}
-	}
+void xdma_engine_timing_get(struct xdma_engine *engine,
+			    struct xdma_engine_timing *timing)
+{
+	unsigned long flags;
 
-	req = xdma_init_request(sgt, ep_addr);
-	if (!req) {
-		rv = -ENOMEM;
-		goto unmap_sgl;
-	}
+	spin_lock_irqsave(&engine->lock, flags);
+	*timing = engine->timing;
+	spin_unlock_irqrestore(&engine->lock, flags);
+}
+
+void xdma_engine_stats_get(struct xdma_engine *engine,
+			   struct xdma_engine_stats *stats)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&engine->lock, flags);
+	*stats = engine->stats;
+	spin_unlock_irqrestore(&engine->lock, flags);
+}
+
+void xdma_engine_stats_reset(struct xdma_engine *engine)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&engine->lock, flags);
+	memset(&engine->stats, 0, sizeof(engine->stats));
+	spin_unlock_irqrestore(&engine->lock, flags);
+}
+
+/* xdma_request_run() - run a built request on an engine, one descriptor
+ * chain at a time, and wait for each to complete
+ *
+ * @return # of bytes transferred, or < 0 if nothing was transferred
+ */
+static ssize_t xdma_request_run(struct xdma_engine *engine,
+			struct xdma_request_cb *req, struct sg_table *sgt,
+			bool dma_mapped, int timeout_ms)
+{
+	struct xdma_dev *xdev = engine->xdev;
+	int rv = 0, tfer_idx = 0, i;
+	ssize_t done = 0;
+	int nents;
 
 	dbg_tfr("%s, len %u sg cnt %u.\n", engine->name, req->total_len,
 		req->sw_desc_cnt);
 
-	sg = sgt->sgl;
 	nents = req->sw_desc_cnt;
 	mutex_lock(&engine->desc_lock);
 
@@ -3233,10 +3676,8 @@ ssize_t xdma_xfer_submit(void *dev_hndl, int channel, bool write, u64 ep_addr,
 
 		/* build transfer */
 		rv = transfer_init(engine, req, &req->tfer[0]);
-		if (rv < 0) {
-			mutex_unlock(&engine->desc_lock);
-			goto unmap_sgl;
-		}
+		if (rv < 0)
+			goto out;
 		xfer = &req->tfer[0];
 
 		if (!dma_mapped)
@@ -3258,13 +3699,14 @@ ssize_t xdma_xfer_submit(void *dev_hndl, int channel, bool write, u64 ep_addr,
 
 		rv = transfer_queue(engine, xfer);
 		if (rv < 0) {
-			mutex_unlock(&engine->desc_lock);
 			pr_info("unable to submit %s, %d.\n", engine->name, rv);
-			goto unmap_sgl;
+			goto out;
 		}
 
 		if (engine->cmplthp)
 			xdma_kthread_wakeup(engine->cmplthp);
+		else if (engine->poll_us)
+			engine_busy_poll(engine, xfer);
 
 		if (timeout_ms > 0)
 			xlx_wait_event_interruptible_timeout(xfer->wq,
@@ -3281,6 +3723,9 @@ ssize_t xdma_xfer_submit(void *dev_hndl, int channel, bool write, u64 ep_addr,
 			spin_unlock_irqrestore(&engine->lock, flags);
 
 			rv = 0;
+			if (tfer_idx == 0)
+				req->start_raw = xfer->start_time;
+			req->complete_raw = xfer->complete_time;
 			dbg_tfr("transfer %p, %u, ep 0x%llx compl, +%lu.\n",
 				xfer, xfer->len, req->ep_addr - xfer->len,
 				done);
@@ -3329,6 +3774,7 @@ ssize_t xdma_xfer_submit(void *dev_hndl, int channel, bool write, u64 ep_addr,
 						pr_err("Failed to stop engine\n");
 				}
 			}
+			engine->stats.timeouts++;
 			spin_unlock_irqrestore(&engine->lock, flags);
 
 #ifdef __LIBXDMA_DEBUG__
@@ -3347,24 +3793,198 @@ ssize_t xdma_xfer_submit(void *dev_hndl, int channel, bool write, u64 ep_addr,
 		 */
 		tfer_idx++;
 
-		if (rv < 0) {
-			mutex_unlock(&engine->desc_lock);
-			goto unmap_sgl;
-		}
+		if (rv < 0)
+			goto out;
 	} /* while (sg) */
+out:
 	mutex_unlock(&engine->desc_lock);
 
+	return done ? done : rv;
+}
+
+ssize_t xdma_xfer_submit(void *dev_hndl, int channel, bool write, u64 ep_addr,
+			 struct sg_table *sgt, bool dma_mapped, int timeout_ms)
+{
+	struct xdma_dev *xdev = (struct xdma_dev *)dev_hndl;
+	struct xdma_engine *engine;
+	ssize_t rv = 0;
+	struct scatterlist *sg = sgt->sgl;
+	int nents;
+	enum dma_data_direction dir = write ? DMA_TO_DEVICE : DMA_FROM_DEVICE;
+	struct xdma_request_cb *req = NULL;
+	ktime_t start = ktime_get();
+	ktime_t submit = ktime_get_raw();
+
+	if (!dev_hndl)
+		return -EINVAL;
+
+	if (debug_check_dev_hndl(__func__, xdev->pdev, dev_hndl) < 0)
+		return -EINVAL;
+
+	if (write == 1) {
+		if (channel >= xdev->h2c_channel_max) {
+			pr_err("H2C channel %d >= %d.\n", channel,
+				xdev->h2c_channel_max);
+			return -EINVAL;
+		}
+		engine = &xdev->engine_h2c[channel];
+	} else if (write == 0) {
+		if (channel >= xdev->c2h_channel_max) {
+			pr_err("C2H channel %d >= %d.\n", channel,
+				xdev->c2h_channel_max);
+			return -EINVAL;
+		}
+		engine = &xdev->engine_c2h[channel];
+	}
+
+	if (!engine) {
+		pr_err("dma engine NULL\n");
+		return -EINVAL;
+	}
+
+	if (engine->magic != MAGIC_ENGINE) {
+		pr_err("%s has invalid magic number %lx\n", engine->name,
+		       engine->magic);
+		return -EINVAL;
+	}
+
+	xdev = engine->xdev;
+	if (xdma_device_flag_check(xdev, XDEV_FLAG_OFFLINE)) {
+		pr_info("xdev 0x%p, offline.\n", xdev);
+		return -EBUSY;
+	}
+
+	/* check the direction */
+	if (engine->dir != dir) {
+		pr_info("0x%p, %s, %d, W %d, 0x%x/0x%x mismatch.\n", engine,
+			engine->name, channel, write, engine->dir, dir);
+		return -EINVAL;
+	}
+
+	if (!dma_mapped) {
+		nents = dma_map_sg(&xdev->pdev->dev, sg, sgt->orig_nents, dir);
+		if (!nents) {
+			pr_info("map sgl failed, sgt 0x%p.\n", sgt);
+			return -EIO;
+		}
+		sgt->nents = nents;
+	} else {
+		if (!sgt->nents) {
+			pr_err("sg table has invalid number of entries 0x%p.\n",
+			       sgt);
+			return -EIO;
+		}
+	}
+
+	req = xdma_init_request(sgt, ep_addr);
+	if (!req) {
+		rv = -ENOMEM;
+		goto unmap_sgl;
+	}
+	req->start = start;
+	req->submit_raw = submit;
+
+	rv = xdma_request_run(engine, req, sgt, dma_mapped, timeout_ms);
+
 unmap_sgl:
 	if (!dma_mapped && sgt->nents) {
 		dma_unmap_sg(&xdev->pdev->dev, sgt->sgl, sgt->orig_nents, dir);
 		sgt->nents = 0;
 	}
 
-	if (req)
+	if (req) {
+		if (rv > 0)
+			engine_stats_add(engine, rv, req);
 		xdma_request_free(req);
+	}
 
 	/* as long as some data is processed, return the count */
-	return done ? done : rv;
+	return rv;
+}
+
+ssize_t xdma_xfer_submit_vec(void *dev_hndl, int channel, bool write,
+			     struct xdma_vec_seg *segs, unsigned int nsegs,
+			     int timeout_ms)
+{
+	struct xdma_dev *xdev = (struct xdma_dev *)dev_hndl;
+	struct xdma_engine *engine;
+	enum dma_data_direction dir = write ? DMA_TO_DEVICE : DMA_FROM_DEVICE;
+	struct xdma_request_cb *req = NULL;
+	ktime_t start = ktime_get();
+	ktime_t submit = ktime_get_raw();
+	unsigned int mapped = 0;
+	ssize_t rv;
+	unsigned int i;
+
+	if (!dev_hndl || !nsegs)
+		return -EINVAL;
+
+	if (debug_check_dev_hndl(__func__, xdev->pdev, dev_hndl) < 0)
+		return -EINVAL;
+
+	if (write) {
+		if (channel >= xdev->h2c_channel_max)
+			return -EINVAL;
+		engine = &xdev->engine_h2c[channel];
+	} else {
+		if (channel >= xdev->c2h_channel_max)
+			return -EINVAL;
+		engine = &xdev->engine_c2h[channel];
+	}
+
+	if (engine->magic != MAGIC_ENGINE) {
+		pr_err("%s has invalid magic number %lx\n", engine->name,
+		       engine->magic);
+		return -EINVAL;
+	}
+
+	if (xdma_device_flag_check(xdev, XDEV_FLAG_OFFLINE)) {
+		pr_info("xdev 0x%p, offline.\n", xdev);
+		return -EBUSY;
+	}
+
+	/* per-entry FPGA addresses only make sense for AXI-MM */
+	if (engine->streaming) {
+		pr_info("%s: vectored transfer needs an AXI-MM engine.\n",
+			engine->name);
+		return -EINVAL;
+	}
+
+	for (mapped = 0; mapped < nsegs; mapped++) {
+		struct sg_table *sgt = segs[mapped].sgt;
+		int nents = dma_map_sg(&xdev->pdev->dev, sgt->sgl,
+				       sgt->orig_nents, dir);
+
+		if (!nents) {
+			pr_info("map sgl failed, sgt 0x%p.\n", sgt);
+			rv = -EIO;
+			goto unmap_sgl;
+		}
+		sgt->nents = nents;
+	}
+
+	req = xdma_init_request_vec(engine, segs, nsegs);
+	if (!req) {
+		rv = -ENOMEM;
+		goto unmap_sgl;
+	}
+	req->start = start;
+	req->submit_raw = submit;
+
+	/* all tables are mapped here, so the run leaves unmapping to us */
+	rv = xdma_request_run(engine, req, NULL, 1, timeout_ms);
+	if (rv > 0)
+		engine_stats_add(engine, rv, req);
+	xdma_request_free(req);
+
+unmap_sgl:
+	for (i = 0; i < mapped; i++) {
+		struct sg_table *sgt = segs[i].sgt;
+
+		dma_unmap_sg(&xdev->pdev->dev, sgt->sgl, sgt->orig_nents, dir);
+		sgt->nents = 0;
+	}
+	return rv;
 }
 
 ssize_t xdma_xfer_completion(void *cb_hndl, void *dev_hndl, int channel,
@@ -3426,6 +4046,9 @@ ssize_t xdma_xfer_completion(void *cb_hndl, void *dev_hndl, int channel,
 			dbg_tfr("transfer %p, %u, ep 0x%llx compl, +%lu.\n",
 				xfer, xfer->len, req->ep_addr - xfer->len,
 				done);
+			if (tfer_idx == 0)
+				req->start_raw = xfer->start_time;
+			req->complete_raw = xfer->complete_time;
 
 			result = xfer->res_virt;
 			/* For C2H streaming use writeback results */
@@ -3457,6 +4080,7 @@ ssize_t xdma_xfer_completion(void *cb_hndl, void *dev_hndl, int channel,
 			transfer_abort(engine, xfer);
 
 			xdma_engine_stop(engine);
+			engine_stats_timeout(engine);
 
 #ifdef __LIBXDMA_DEBUG__
 			transfer_dump(xfer);
@@ -3481,8 +4105,11 @@ unmap_sgl:
 		sgt->nents = 0;
 	}
 
-	if (req)
+	if (req) {
+		if (done)
+			engine_stats_add(engine, done, req);
 		xdma_request_free(req);
+	}
 
 	return done;
 
@@ -3570,6 +4197,8 @@ ssize_t xdma_xfer_submit_nowait(void *cb_hndl, void *dev_hndl, int channel,
 		rv = -ENOMEM;
 		goto unmap_sgl;
 	}
+	req->start = ktime_get();
+	req->submit_raw = ktime_get_raw();
 
 	//used when doing completion.
 	req->cb = cb;
@@ -3781,6 +4410,144 @@ err_engine_transfer:
 	return rv;
 }
 
+/**
+ * xdma_cyclic_ring_start() - start a C2H engine filling a ring buffer
+ *
+ * The caller fills in buf_bus, block_size, blocks and ep_addr. A loop of
+ * descriptors is built once, one per block, and queued as a cyclic
+ * transfer: the engine then fills the blocks in turn, round and round,
+ * until xdma_cyclic_ring_stop(). No descriptor requests an interrupt
+ * (servicing would shut the engine down), so xdma_cyclic_ring_count()
+ * reads progress from the completed descriptor count register.
+ * The FPGA must hold off reads while it has no data: AXI-ST does this,
+ * and so does an AXI-MM FIFO read port that stalls when empty.
+ */
+int xdma_cyclic_ring_start(struct xdma_engine *engine,
+			   struct xdma_cyclic_ring *ring)
+{
+	struct xdma_dev *xdev = engine->xdev;
+	struct xdma_transfer *transfer = &ring->transfer;
+	int i;
+	int rv;
+
+	if (engine->dir != DMA_FROM_DEVICE) {
+		pr_info("%s: cyclic ring is only for C2H engines.\n",
+			engine->name);
+		return -EINVAL;
+	}
+	if (poll_mode) {
+		pr_info("%s: cyclic ring not supported with poll_mode.\n",
+			engine->name);
+		return -EOPNOTSUPP;
+	}
+	if (ring->blocks < 2 || ring->blocks > XDMA_TRANSFER_MAX_DESC ||
+	    ring->block_size == 0 || ring->block_size > desc_blen_max)
+		return -EINVAL;
+	if (engine->running || !list_empty(&engine->transfer_list)) {
+		pr_info("%s: engine busy, cyclic ring not started.\n",
+			engine->name);
+		return -EBUSY;
+	}
+
+	memset(transfer, 0, sizeof(*transfer));
+	transfer->desc_virt = dma_alloc_coherent(&xdev->pdev->dev,
+				ring->blocks * sizeof(struct xdma_desc),
+				&transfer->desc_bus, GFP_KERNEL);
+	if (!transfer->desc_virt) {
+		pr_err("%s: cyclic ring descriptors OOM.\n", engine->name);
+		return -ENOMEM;
+	}
+	transfer->dir = engine->dir;
+	transfer->desc_num = ring->blocks;
+
+	rv = transfer_desc_init(transfer, transfer->desc_num);
+	if (rv < 0)
+		goto err_desc;
+
+	for (i = 0; i < transfer->desc_num; i++)
+		xdma_desc_set(transfer->desc_virt + i,
+			      ring->buf_bus + (dma_addr_t)i * ring->block_size,
+			      ring->ep_addr, ring->block_size, engine->dir);
+
+	/* close the loop */
+	xdma_desc_link(transfer->desc_virt + transfer->desc_num - 1,
+		       transfer->desc_virt, transfer->desc_bus);
+	transfer->cyclic = 1;
+
+#if HAS_SWAKE_UP
+	init_swait_queue_head(&transfer->wq);
+#else
+	init_waitqueue_head(&transfer->wq);
+#endif
+
+	ring->hw_count = 0;
+	ring->count = 0;
+	rv = transfer_queue(engine, transfer);
+	if (rv < 0) {
+		pr_err("%s: failed to queue cyclic ring.\n", engine->name);
+		goto err_desc;
+	}
+	dbg_tfr("%s: cyclic ring %u x %u bytes started.\n", engine->name,
+		ring->blocks, ring->block_size);
+	return 0;
+
+err_desc:
+	dma_free_coherent(&xdev->pdev->dev,
+			  ring->blocks * sizeof(struct xdma_desc),
+			  transfer->desc_virt, transfer->desc_bus);
+	transfer->desc_virt = NULL;
+	return rv;
+}
+
+/**
+ * xdma_cyclic_ring_count() - blocks filled since the ring was started
+ *
+ * extends the 32 bit hardware count to 64 bits; the caller must read it
+ * at least once per 2^32 blocks
+ */
+u64 xdma_cyclic_ring_count(struct xdma_engine *engine,
+			   struct xdma_cyclic_ring *ring)
+{
+	unsigned long flags;
+	u32 w;
+	u64 count;
+
+	spin_lock_irqsave(&engine->lock, flags);
+	w = read_register(&engine->regs->completed_desc_count);
+	ring->count += (u32)(w - ring->hw_count);
+	ring->hw_count = w;
+	count = ring->count;
+	spin_unlock_irqrestore(&engine->lock, flags);
+	return count;
+}
+
+/**
+ * xdma_cyclic_ring_stop() - stop a cyclic ring and free its descriptors
+ */
+void xdma_cyclic_ring_stop(struct xdma_engine *engine,
+			   struct xdma_cyclic_ring *ring)
+{
+	struct xdma_transfer *transfer = &ring->transfer;
+	unsigned long flags;
+
+	if (!transfer->desc_virt)
+		return;
+
+	spin_lock_irqsave(&engine->lock, flags);
+	if (xdma_engine_stop(engine) < 0)
+		pr_err("%s: failed to stop engine\n", engine->name);
+	list_del(&transfer->entry);
+	transfer->state = TRANSFER_STATE_COMPLETED;
+	spin_unlock_irqrestore(&engine->lock, flags);
+
+	dma_free_coherent(&engine->xdev->pdev->dev,
+			  ring->blocks * sizeof(struct xdma_desc),
+			  transfer->desc_virt, transfer->desc_bus);
+	transfer->desc_virt = NULL;
+	dbg_tfr("%s: cyclic ring stopped after %llu blocks.\n", engine->name,
+		ring->count);
+}
+
 static struct xdma_dev *alloc_dev_instance(struct pci_dev *pdev)
 {
 	int i;
@@ -4439,3 +5206,26 @@ int engine_addrmode_set(struct xdma_engine *engine, unsigned long arg)
 
 	return rv;
 }
+
+/* set the busy-poll window of an engine, in us; 0 = sleep at once */
+#define XDMA_POLL_US_MAX	1000
+
+int engine_poll_window_set(struct xdma_engine *engine, unsigned long arg)
+{
+	int rv;
+	int poll_us;
+
+	rv = get_user(poll_us, (int __user *)arg);
+	if (rv)
+		return rv;
+	if (poll_us < 0 || poll_us > XDMA_POLL_US_MAX)
+		return -EINVAL;
+	if (poll_mode && poll_us) {
+		pr_info("%s: poll_mode set, busy-poll window not used.\n",
+			engine->name);
+		return -EINVAL;
+	}
+	engine->poll_us = poll_us;
+	dbg_perf("%s: busy-poll window %dus.\n", engine->name, poll_us);
+	return 0;
+}
@@ -28,6 +28,7 @@
 #include <linux/init.h>
 #include <linux/interrupt.h>
 #include <linux/jiffies.h>
+#include <linux/ktime.h>
 #include <linux/kernel.h>
 #include <linux/pci.h>
 #include <linux/workqueue.h>
@@ -429,6 +430,7 @@ struct xdma_result {
 struct sw_desc {
 	dma_addr_t addr;
 	unsigned int len;
+	u64 ep_addr;		/* used by vectored requests */
 };
 
 /* Describes a (SG DMA) single transfer for the engine */
@@ -459,6 +461,46 @@ struct xdma_transfer {
 	unsigned int len;
 	struct sg_table *sgt;
 	struct xdma_io_cb *cb;
+	struct xdma_desc_cache_entry *cache;	/* cached chain used, or NULL */
+	ktime_t start_time;		/* raw clock: engine started on it; 0 = chained */
+	ktime_t complete_time;		/* raw clock: completion serviced */
+};
+
+/*
+ * descriptor chain cache: a few prebuilt chains per engine, each keyed by
+ * the sg list (bus address, length) and FPGA address it was built for. A
+ * request that repeats a previous one - the usual case for a fixed user
+ * buffer - reuses the chain instead of rewriting it in coherent memory.
+ */
+#define XDMA_DESC_CACHE_ENTRIES	8
+#define XDMA_DESC_CACHE_DESC	32	/* max descriptors in a cached chain */
+
+struct xdma_desc_cache_entry {
+	struct xdma_desc *desc_virt;	/* virt addr of the chain */
+	dma_addr_t desc_bus;		/* bus addr of the chain */
+	struct xdma_result *res_virt;	/* results, c2h streaming */
+	dma_addr_t res_bus;
+	struct sw_desc sdesc[XDMA_DESC_CACHE_DESC];	/* key: sg list */
+	u64 ep_addr;			/* key: FPGA address */
+	unsigned int desc_num;		/* descriptors in chain; 0 = empty */
+	unsigned int len;		/* bytes covered by the chain */
+	unsigned long last_used;	/* LRU stamp */
+	int busy;			/* chain owned by a queued transfer */
+};
+
+/*
+ * cyclic C2H ring: a loop of descriptors, one per block of a ring buffer,
+ * that the engine runs round continuously. Progress is read from the
+ * engine's completed descriptor count rather than interrupts.
+ */
+struct xdma_cyclic_ring {
+	struct xdma_transfer transfer;
+	dma_addr_t buf_bus;		/* bus addr of the ring buffer */
+	u32 block_size;			/* bytes per block (per descriptor) */
+	u32 blocks;			/* blocks in the ring */
+	u64 ep_addr;			/* FPGA address read for every block */
+	u32 hw_count;			/* last completed_desc_count read */
+	u64 count;			/* blocks completed since start */
 };
 
 struct xdma_request_cb {
@@ -471,11 +513,47 @@ struct xdma_request_cb {
 
 	struct xdma_io_cb *cb;
 
+	ktime_t start;			/* submit time, for engine stats */
+	ktime_t submit_raw;		/* submit time, raw clock, for timestamps */
+	ktime_t start_raw;		/* engine started on the 1st transfer */
+	ktime_t complete_raw;		/* last transfer completed */
+	int vectored;			/* ep_addr taken from each sdesc */
+
 	unsigned int sw_desc_idx;
 	unsigned int sw_desc_cnt;
 	struct sw_desc sdesc[0];
 };
 
+/*
+ * always-on per-engine counters: one transfer per completed request,
+ * latency measured from submit to completion. The irq_ counters time each
+ * interrupt to the start of its completion servicing (workqueue or IRQ
+ * thread); transfers / irq_services is the batching achieved.
+ */
+struct xdma_engine_stats {
+	u64 transfers;
+	u64 bytes;
+	u64 lat_min_ns;
+	u64 lat_max_ns;
+	u64 lat_total_ns;
+	u64 timeouts;
+	u64 irq_services;
+	u64 irq_lat_max_ns;
+	u64 irq_lat_total_ns;
+};
+
+/*
+ * timestamps of the last request completed on an engine, from the raw
+ * monotonic clock (CLOCK_MONOTONIC_RAW), for IOCTL_XDMA_TIMING_GET
+ */
+struct xdma_engine_timing {
+	ktime_t submit;		/* request entered the driver */
+	ktime_t start;		/* engine started on its 1st transfer */
+	ktime_t complete;	/* its last transfer's completion serviced */
+	u64 bytes;
+	u64 sequence;		/* requests timed on the engine */
+};
+
 struct xdma_engine {
 	unsigned long magic;	/* structure ID for sanity checks */
 	struct xdma_dev *xdev;	/* parent device */
@@ -502,6 +580,7 @@ struct xdma_engine {
 	u8 filler:1;
 
 	int max_extra_adj;	/* descriptor prefetch capability */
+	unsigned int poll_us;	/* busy-poll window before sleeping; 0 = none */
 	int desc_dequeued;	/* num descriptors of completed transfers */
 	u32 status;		/* last known status of device */
 	/* only used for MSIX mode to store per-engine interrupt mask value */
@@ -529,6 +608,9 @@ struct xdma_engine {
 	spinlock_t lock;		/* protects concurrent access */
 	int prev_cpu;			/* remember CPU# of (last) locker */
 	int msix_irq_line;		/* MSI-X vector for this engine */
+	int irq_cpu;			/* steering CPU for the IRQ, -1 = any */
+	bool irq_thread;		/* completions serviced by an IRQ thread */
+	ktime_t irq_time;		/* when the last IRQ was taken */
 	u32 irq_bitmask;		/* IRQ bit mask for this engine */
 	struct work_struct work;	/* Work queue for interrupt handling */
 
@@ -538,6 +620,19 @@ struct xdma_engine {
 	int desc_idx;			/* current descriptor index */
 	int desc_used;			/* total descriptors used */
 
+	/* descriptor chain cache, protected by lock */
+	struct xdma_desc_cache_entry *desc_cache;
+	struct xdma_desc *desc_cache_virt;
+	dma_addr_t desc_cache_bus;
+	struct xdma_result *desc_cache_res;
+	dma_addr_t desc_cache_res_bus;
+	unsigned long desc_cache_tick;
+	unsigned long desc_cache_hits;
+	unsigned long desc_cache_misses;
+
+	struct xdma_engine_stats stats;	/* protected by lock */
+	struct xdma_engine_timing timing;	/* protected by lock */
+
 	/* for performance test support */
 	struct xdma_performance_ioctl *xdma_perf;	/* perf test control */
 #if	HAS_SWAKE_UP
@@ -558,6 +653,7 @@ struct xdma_user_irq {
 	struct xdma_dev *xdev;		/* parent device */
 	u8 user_idx;			/* 0 ~ 15 */
 	u8 events_irq;			/* accumulated IRQs */
+	u32 events_count;		/* IRQs serviced, for sgdma poll() */
 	spinlock_t events_lock;		/* lock to safely update events_irq */
 	wait_queue_head_t events_wq;	/* wait queue to sync waiting threads */
 	irq_handler_t handler;
@@ -672,9 +768,21 @@ void xdma_device_online(struct pci_dev *pdev, void *dev_handle);
 
 int xdma_performance_submit(struct xdma_dev *xdev, struct xdma_engine *engine);
 struct xdma_transfer *engine_cyclic_stop(struct xdma_engine *engine);
+int xdma_cyclic_ring_start(struct xdma_engine *engine,
+			   struct xdma_cyclic_ring *ring);
+u64 xdma_cyclic_ring_count(struct xdma_engine *engine,
+			   struct xdma_cyclic_ring *ring);
+void xdma_cyclic_ring_stop(struct xdma_engine *engine,
+			   struct xdma_cyclic_ring *ring);
 void enable_perf(struct xdma_engine *engine);
 void get_perf_stats(struct xdma_engine *engine);
 
 int engine_addrmode_set(struct xdma_engine *engine, unsigned long arg);
+int engine_poll_window_set(struct xdma_engine *engine, unsigned long arg);
+void xdma_engine_stats_get(struct xdma_engine *engine,
+			   struct xdma_engine_stats *stats);
+void xdma_engine_stats_reset(struct xdma_engine *engine);
+void xdma_engine_timing_get(struct xdma_engine *engine,
+			    struct xdma_engine_timing *timing);
 int engine_service_poll(struct xdma_engine *engine, u32 expected_desc_count);
 #endif /* XDMA_LIB_H */
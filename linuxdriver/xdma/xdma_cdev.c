@@ -91,6 +91,61 @@ ssize_t xdma_dev_instance_show(struct device *dev,
 static DEVICE_ATTR_RO(xdma_dev_instance);
 #endif
 
+static int engine_stats_print(struct xdma_engine *engine, char *buf, int len)
+{
+	struct xdma_engine_stats stats;
+	u64 avg, irq_avg;
+
+	xdma_engine_stats_get(engine, &stats);
+	avg = stats.transfers ? div64_u64(stats.lat_total_ns,
+					  stats.transfers) : 0;
+
+	irq_avg = stats.irq_services ? div64_u64(stats.irq_lat_total_ns,
+						 stats.irq_services) : 0;
+
+	return scnprintf(buf + len, PAGE_SIZE - len,
+		"%s transfers %llu bytes %llu lat_min_ns %llu lat_avg_ns %llu lat_max_ns %llu timeouts %llu irq_services %llu irq_lat_avg_ns %llu irq_lat_max_ns %llu\n",
+		engine->name, stats.transfers, stats.bytes, stats.lat_min_ns,
+		avg, stats.lat_max_ns, stats.timeouts, stats.irq_services,
+		irq_avg, stats.irq_lat_max_ns);
+}
+
+/* one line of counters per DMA engine; write anything to reset them */
+static ssize_t xdma_engine_stats_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct xdma_pci_dev *xpdev =
+		(struct xdma_pci_dev *)dev_get_drvdata(dev);
+	struct xdma_dev *xdev = xpdev->xdev;
+	int len = 0;
+	int i;
+
+	for (i = 0; i < xpdev->h2c_channel_max; i++)
+		len += engine_stats_print(&xdev->engine_h2c[i], buf, len);
+	for (i = 0; i < xpdev->c2h_channel_max; i++)
+		len += engine_stats_print(&xdev->engine_c2h[i], buf, len);
+
+	return len;
+}
+
+static ssize_t xdma_engine_stats_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct xdma_pci_dev *xpdev =
+		(struct xdma_pci_dev *)dev_get_drvdata(dev);
+	struct xdma_dev *xdev = xpdev->xdev;
+	int i;
+
+	for (i = 0; i < xpdev->h2c_channel_max; i++)
+		xdma_engine_stats_reset(&xdev->engine_h2c[i]);
+	for (i = 0; i < xpdev->c2h_channel_max; i++)
+		xdma_engine_stats_reset(&xdev->engine_c2h[i]);
+
+	return count;
+}
+
+static DEVICE_ATTR_RW(xdma_engine_stats);
+
 static int config_kobject(struct xdma_cdev *xcdev, enum cdev_type type)
 {
 	int rv = -EINVAL;
@@ -391,6 +446,7 @@ void xpdev_destroy_interfaces(struct xdma_pci_dev *xpdev)
 #ifdef __XDMA_SYSFS__
 	device_remove_file(&xpdev->pdev->dev, &dev_attr_xdma_dev_instance);
 #endif
+	device_remove_file(&xpdev->pdev->dev, &dev_attr_xdma_engine_stats);
 
 	if (xpdev_flag_test(xpdev, XDF_CDEV_SG)) {
 		/* iterate over channels */
@@ -595,6 +651,13 @@ int xpdev_create_interfaces(struct xdma_pci_dev *xpdev)
 	}
 #endif
 
+	rv = device_create_file(&xpdev->pdev->dev,
+				&dev_attr_xdma_engine_stats);
+	if (rv) {
+		pr_err("Failed to create engine stats file\n");
+		goto fail;
+	}
+
 	return 0;
 
 fail:
@@ -27,7 +27,9 @@
 #include <linux/delay.h>
 #include <linux/fb.h>
 #include <linux/fs.h>
+#include <linux/hrtimer.h>
 #include <linux/init.h>
+#include <linux/kref.h>
 #include <linux/interrupt.h>
 #include <linux/io.h>
 #include <linux/jiffies.h>
@@ -58,6 +60,23 @@ extern unsigned int desc_blen_max;
 extern unsigned int h2c_timeout;
 extern unsigned int c2h_timeout;
 
+/* persistent DMA buffer of an SGDMA character device */
+struct xdma_dma_buffer {
+	struct kref ref;
+	struct device *dev;
+	struct file *owner;		/* file that allocated it */
+	bool cached;			/* cacheable: synced around transfers */
+	void *virt;
+	dma_addr_t bus;
+	size_t size;
+	struct xdma_engine *engine;
+	struct xdma_cyclic_ring ring;	/* C2H ring filling the buffer */
+	int ring_running;
+	u64 ring_seen;			/* blocks filled at the last RING_WAIT */
+	struct hrtimer ring_timer;	/* polls ring progress for poll() */
+	wait_queue_head_t *poll_wq;	/* of the cdev */
+};
+
 struct xdma_cdev {
 	unsigned long magic;		/* structure ID for sanity checks */
 	struct xdma_pci_dev *xpdev;
@@ -69,7 +88,11 @@ struct xdma_cdev {
 	struct xdma_engine *engine;	/* engine instance, if needed */
 	struct xdma_user_irq *user_irq;	/* IRQ value, if needed */
 	struct device *sys_device;	/* sysfs device */
+	struct xdma_dma_buffer *dma_buffer;	/* persistent buffer, if any */
 	spinlock_t lock;
+	wait_queue_head_t poll_wq;	/* sgdma poll(): ring progress */
+	int poll_irq;			/* user IRQ signalling data, or -1 */
+	u32 poll_irq_seen;		/* its events_count at the last read */
 };
 
 /* XDMA PCIe device specific book-keeping */
@@ -176,6 +176,7 @@ Documentation=https://github.com/laurencebarker/Saturn
 [Service]
 WorkingDirectory=$P2_APP_DIR
 ExecStart=$P2_APP_EXECUTABLE -s -p
+ExecReload=/bin/kill -HUP \$MAINPID
 User=root
 Group=root
 Restart=always
@@ -0,0 +1,229 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 1 
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// InEP2.c:
+//
+// handle the TX I/Q and speaker samples in incoming "EP2" frames
+// each USB frame has 63 sets of 8 bytes: speaker L, R then TX I, Q, 16 bits each.
+//
+// TX I/Q goes into a jitter buffer: a mirrored ring that is DMAd from in whole blocks.
+// a block is 2 Metis frames of samples (252 samples, 189 64 bit words), the smallest
+// whole number of 64 bit FIFO words. After MOX, (or if it runs empty) nothing is
+// written until it has filled to the target depth.
+// speaker samples are already in the codec format, and are DMAd as FIFO space allows.
+//
+//////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include "../common/saturntypes.h"
+#include "InEP2.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include "../common/saturnregisters.h"
+#include "../common/saturndrivers.h"
+#include "../common/hwaccess.h"
+#include "../common/streamcore.h"
+
+
+#define VP1DUCBLOCKSAMPLES 252                      // TX samples per jitter buffer block
+#define VP1DUCBLOCKBYTES (VP1DUCBLOCKSAMPLES * 6)   // 24 bit I + 24 bit Q per sample
+#define VP1DUCBLOCKWORDS (VP1DUCBLOCKBYTES / 8)     // 64 bit FIFO words per block
+#define VP1DUCJITTERBLOCKS 64                       // jitter buffer capacity in blocks (336ms)
+#define VP1DUCDRAINRATE 36000                       // 64 bit words/s the FPGA reads from the DUC FIFO at 48KHz
+#define VP1SPKRINGSIZE 32768                        // speaker ring size
+#define VP1SPKDRAINRATE 24000                       // 64 bit words/s the codec reads: 48KHz / 2 samples per word
+
+
+int DUCWritefile_fd = -1;                           // DUC DMA write device
+int SpkWritefile_fd = -1;                           // speaker DMA write device
+
+struct StreamRing P1DUCJitterRing;                  // TX I/Q jitter buffer
+struct StreamSink P1DUCSink;
+uint32_t P1DUCJitterTarget;                         // target depth in blocks
+bool P1DUCJitterPrefill;                            // true if filling before writes (re)start
+bool P1PrevMOX;                                     // MOX from the previous frame
+uint32_t GP1DUCJitterUnderflows = 0;                // times the buffer ran empty in TX
+uint32_t GP1DUCJitterOverflows = 0;                 // samples discarded because buffer full
+uint32_t GP1DUCJitterMaxDepth = 0;                  // most blocks held
+
+struct StreamRing P1SpkRing;                        // speaker samples waiting to be written
+struct StreamSink P1SpkSink;
+uint32_t GP1SpkOverflows = 0;                       // speaker samples discarded because buffer full
+
+
+//
+// bool InitialiseEP2Ingest(void)
+// allocate the DUC jitter buffer and speaker buffer, and open the DMA devices.
+//
+bool InitialiseEP2Ingest(void)
+{
+    bool Result = true;
+
+    if(!StreamRingCreate(&P1DUCJitterRing, VP1DUCJITTERBLOCKS * VP1DUCBLOCKBYTES, "P1 DUC")
+       || !StreamRingCreate(&P1SpkRing, VP1SPKRINGSIZE, "P1 speaker"))
+    {
+        printf("TX I/Q or speaker buffer allocation failed\n");
+        Result = false;
+    }
+    //
+    // open DMA device drivers
+    // opened write only to accommodate potential use of a different XDMA device driver
+    //
+    DUCWritefile_fd = OpenDMADevice(VDUCDMADEVICE, O_WRONLY);
+    if(DUCWritefile_fd < 0)
+    {
+        printf("XDMA write device open failed for TX I/Q data\n");
+        Result = false;
+    }
+    SpkWritefile_fd = OpenDMADevice(VSPKDMADEVICE, O_WRONLY);
+    if(SpkWritefile_fd < 0)
+    {
+        printf("XDMA write device open failed for speaker data\n");
+        Result = false;
+    }
+
+    StreamSinkInitialise(&P1DUCSink, DUCWritefile_fd, eTXDUCDMA, VADDRDUCSTREAMWRITE, VP1DUCBLOCKBYTES, VP1DUCDRAINRATE);
+    StreamSinkInitialise(&P1SpkSink, SpkWritefile_fd, eSpkCodecDMA, VADDRSPKRSTREAMWRITE, 8, VP1SPKDRAINRATE);
+    P1DUCJitterTarget = (VP1DUCJITTERLATENCY * 48000) / (VP1DUCBLOCKSAMPLES * 1000);
+    if(P1DUCJitterTarget < 2)
+        P1DUCJitterTarget = 2;
+    printf("DUC jitter buffer target = %d blocks (%dms)\n", P1DUCJitterTarget, VP1DUCJITTERLATENCY);
+    ResetEP2Ingest();
+    return Result;
+}
+
+
+//
+// void ResetEP2Ingest(void)
+// discard any buffered samples and reset the DUC and speaker FIFOs.
+//
+void ResetEP2Ingest(void)
+{
+    StreamRingReset(&P1DUCJitterRing);
+    StreamRingReset(&P1SpkRing);
+    P1DUCJitterPrefill = true;
+    P1PrevMOX = false;
+
+    EnableDUCMux(false);                                  // disable temporarily
+    SetTXIQDeinterleaved(false);                          // not interleaved
+    ResetDUCMux();                                        // reset 64 to 48 mux
+    ResetDMAStreamFIFO(eTXDUCDMA);
+    SetupFIFOMonitorChannel(eTXDUCDMA, false);
+    EnableDUCMux(true);                                   // enable operation
+    ResetDMAStreamFIFO(eSpkCodecDMA);
+    SetupFIFOMonitorChannel(eSpkCodecDMA, false);
+}
+
+
+//
+// void AddEP2Samples(uint8_t* USBFrame, bool MOX)
+// copy the samples of one 512 byte USB frame into the DUC jitter buffer and speaker buffer
+// the 16 bit TX samples are extended to 24 bits, and written with I and Q in the
+// same order as the protocol 2 DUC path writes them (see SwapIQSamples())
+//
+void AddEP2Samples(uint8_t* USBFrame, bool MOX)
+{
+    uint8_t* SrcPtr;
+    uint8_t* DestPtr;
+    uint32_t Set;
+
+    //
+    // MOX: prefill the jitter buffer before writing. End of MOX: report it
+    //
+    if(MOX != P1PrevMOX)
+    {
+        if(MOX)
+            P1DUCJitterPrefill = true;
+        else
+        {
+            printf("DUC jitter buffer: depth = %d blocks, max = %d, underflows = %d, overflows = %d\n",
+                   StreamRingUsed(&P1DUCJitterRing) / VP1DUCBLOCKBYTES, GP1DUCJitterMaxDepth, GP1DUCJitterUnderflows, GP1DUCJitterOverflows);
+            GP1DUCJitterUnderflows = 0;
+            GP1DUCJitterOverflows = 0;
+            GP1DUCJitterMaxDepth = 0;
+        }
+        P1PrevMOX = MOX;
+    }
+
+    SrcPtr = USBFrame + 8;                                      // 1st sample after sync and C&C
+    for(Set = 0; Set < VEP2SETSPERUSBFRAME; Set++)
+    {
+        //
+        // speaker L, R: the codec takes them as they are
+        //
+        if(StreamRingSpace(&P1SpkRing) >= 4)
+        {
+            memcpy(StreamRingWritePtr(&P1SpkRing), SrcPtr, 4);
+            StreamRingCommit(&P1SpkRing, 4);
+        }
+        else
+            GP1SpkOverflows++;
+        //
+        // TX I, Q into the jitter buffer, unless it is full
+        //
+        if(StreamRingSpace(&P1DUCJitterRing) >= 6)
+        {
+            DestPtr = StreamRingWritePtr(&P1DUCJitterRing);
+            DestPtr[0] = SrcPtr[6];                             // Q
+            DestPtr[1] = SrcPtr[7];
+            DestPtr[2] = 0;
+            DestPtr[3] = SrcPtr[4];                             // I
+            DestPtr[4] = SrcPtr[5];
+            DestPtr[5] = 0;
+            StreamRingCommit(&P1DUCJitterRing, 6);
+        }
+        else
+            GP1DUCJitterOverflows++;
+        SrcPtr += 8;
+    }
+    if(StreamRingUsed(&P1DUCJitterRing) / VP1DUCBLOCKBYTES > GP1DUCJitterMaxDepth)
+        GP1DUCJitterMaxDepth = StreamRingUsed(&P1DUCJitterRing) / VP1DUCBLOCKBYTES;
+}
+
+
+//
+// write as many blocks from the jitter buffer as the DUC FIFO has space for.
+// if the buffer runs empty during TX, count an underflow and prefill again.
+//
+static void WriteDUCJitterBlocks(void)
+{
+    uint32_t Occupancy;
+
+    Occupancy = StreamRingUsed(&P1DUCJitterRing) / VP1DUCBLOCKBYTES;
+    if(P1DUCJitterPrefill)
+    {
+        if(Occupancy < P1DUCJitterTarget)
+            return;
+        P1DUCJitterPrefill = false;
+    }
+    if(Occupancy == 0)
+    {
+        if(P1PrevMOX)
+            GP1DUCJitterUnderflows++;
+        P1DUCJitterPrefill = true;
+        return;
+    }
+    StreamSinkWrite(&P1DUCSink, &P1DUCJitterRing, 0);
+}
+
+
+//
+// void WriteEP2Samples(void)
+// DMA as much of the buffered TX I/Q and speaker data as the FIFOs have space for.
+//
+void WriteEP2Samples(void)
+{
+    if((DUCWritefile_fd < 0) || (SpkWritefile_fd < 0))
+        return;
+    WriteDUCJitterBlocks();
+    StreamSinkWrite(&P1SpkSink, &P1SpkRing, 0);
+}
@@ -0,0 +1,61 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 1 
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// InEP2.h:
+//
+// header: handle the TX I/Q and speaker samples in incoming "EP2" frames
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __InEP2_h
+#define __InEP2_h
+
+
+#include <stdint.h>
+#include "../common/saturntypes.h"
+
+
+#define VEP2SETSPERUSBFRAME 63              // 8 byte sample sets (L, R, I, Q) per USB frame
+#define VP1DUCJITTERLATENCY 20              // TX jitter buffer target latency (ms)
+
+
+//
+// bool InitialiseEP2Ingest(void)
+// allocate the DUC jitter buffer and speaker buffer, and open the DMA devices.
+// returns false if it failed
+//
+bool InitialiseEP2Ingest(void);
+
+
+//
+// void ResetEP2Ingest(void)
+// discard any buffered samples and reset the DUC and speaker FIFOs.
+// called when the PC client sends a START command
+//
+void ResetEP2Ingest(void);
+
+
+//
+// void AddEP2Samples(uint8_t* USBFrame, bool MOX)
+// copy the samples of one 512 byte USB frame into the DUC jitter buffer and speaker buffer
+//   USBFrame:    start of the USB frame (sync bytes)
+//   MOX:         true if the C&C bytes of the frame set MOX
+//
+void AddEP2Samples(uint8_t* USBFrame, bool MOX);
+
+
+//
+// void WriteEP2Samples(void)
+// DMA as much of the buffered TX I/Q and speaker data as the FIFOs have space for.
+// does not block; call after each batch of EP2 frames, and periodically if there are none
+//
+void WriteEP2Samples(void);
+
+
+#endif
@@ -40,11 +40,15 @@
 #include "../common/saturntypes.h"
 #include "../common/hwaccess.h"                     // access to PCIe read & write
 #include "../common/saturnregisters.h"              // register I/O for Saturn
+#include "../common/saturndrivers.h"                // FIFO monitor and DDC frame plans
+#include "../common/sampleunpack.h"                 // DDC sample unpack
+#include "../common/streamcore.h"                   // ring buffers, DMA sources and sinks
 #include "../common/codecwrite.h"                   // codec register I/O for Saturn
 #include "../common/version.h"                      // version I/O for Saturn
+#include "InEP2.h"                                  // TX I/Q and speaker samples from EP2
 
 
-int receivers = 1;                          // number of requested DDC (1-8)
+int receivers = 1;                          // number of requested DDC (1-VMAXP1DDCS)
 int rate = 0;                               // reqd sample rate (00=48KHz .. 11 = 384KHz)
 
 
@@ -61,6 +65,17 @@ void *SendOutgoingPacketData(void *arg);
 #define SDRBOARDID 1                    // Hermes
 #define SDRSWVERSION 1                  // version of this software
 #define VMETISFRAMESIZE 1032            // each Metis Frame
+#define VEP2MAXBATCH 16                 // most incoming frames received in one recvmmsg() call
+
+
+//
+// the common driver code calls this when the TX amplitude mode changes
+// protocol 1 has no EER mode, so there is nothing to do
+//
+void HandlerSetEERMode(bool EEREnabled)
+{
+  (void)EEREnabled;
+}
 
 //
 // main program. Initialise, then handle incoming data
@@ -69,33 +84,40 @@ void *SendOutgoingPacketData(void *arg);
 //
 int main(void)
 {
-  int i, size;
+  int i, Received, Msg;
   pthread_t thread;
 
 //
 // part written discovery reply packet
 //
   uint8_t reply[11] = {0xef, 0xfe, 2, 0, 0, 0, 0, 0, 0, SDRSWVERSION, SDRBOARDID};
-  uint8_t id[4] = {0xef, 0xfe, 1, 6};                                                   // don't think this is needed here
   uint32_t code;                                                        // command word from PC app
   struct ifreq hwaddr;                                                  // holds this device MAC address
-  struct sockaddr_in addr_ep2, addr_from[10];                           // holds MAC address of source of incoming messages
-  uint8_t UDPInBuffer[VMETISFRAMESIZE];                                   // 8 outgoing buffers
-  struct iovec iovecinst;                                             // iovcnt buffer - 1 for each outgoing buffer
-  struct msghdr datagram;                                           // multiple incoming message header
+  struct sockaddr_in addr_ep2, addr_from[VEP2MAXBATCH];                 // holds MAC address of source of incoming messages
+  uint8_t UDPInBuffer[VEP2MAXBATCH][VMETISFRAMESIZE];                   // incoming message buffers
+  uint8_t* Frame;                                                       // current incoming message
+  struct iovec iovecinst[VEP2MAXBATCH];                                 // iovcnt buffer - 1 for each incoming buffer
+  struct mmsghdr datagrams[VEP2MAXBATCH];                               // multiple incoming message header
   struct timeval tv;
-  struct timespec ts;
   int yes = 1;
 
 
 //
 // setup Orion hardware
 //
-  OpenXDMADriver();
+  OpenXDMADriver(false);
+  PrintVersionInfo();
   CodecInitialise();
-  InitialiseDACAttenROMs();
-  InitialiseCWKeyerRamp();
+  InitialiseCWKeyerRamp(false, 5000);                               // default 5ms ramp, P1
   SetCWSidetoneEnabled(true);
+  SetTXProtocol(false);                                             // set to protocol 1
+  SetTXModulationSource(eIQData);                                   // disable debug options
+  SetByteSwapping(true);                                            // h/w to generate network byte order
+  SetSpkrMute(false);
+  SetP1SampleRate(e48KHz, 1);                                       // 1 receiver at 48KHz until told otherwise
+  InitialiseSampleUnpack();                                         // select DDC unpack kernel
+  if(!InitialiseEP2Ingest())
+    printf("TX I/Q and speaker data will not be sent to the FPGA\n");
   
 
 
@@ -142,91 +164,106 @@ int main(void)
 
   //
   // now main processing loop. Process received Metis packets
+  // wait for one (it times out) then take any more already waiting
   //
+  memset(iovecinst, 0, sizeof(iovecinst));
+  memset(datagrams, 0, sizeof(datagrams));
+  for(Msg = 0; Msg < VEP2MAXBATCH; Msg++)
+  {
+    iovecinst[Msg].iov_base = UDPInBuffer[Msg];         // set buffer for incoming message number Msg
+    iovecinst[Msg].iov_len = VMETISFRAMESIZE;
+    datagrams[Msg].msg_hdr.msg_iov = &iovecinst[Msg];
+    datagrams[Msg].msg_hdr.msg_iovlen = 1;
+    datagrams[Msg].msg_hdr.msg_name = &addr_from[Msg];
+  }
+
   while(1)
   {
-    memset(&iovecinst, 0, sizeof(struct iovec));
-    memset(&datagram, 0, sizeof(datagram));
-
-    memcpy(UDPInBuffer, id, 4);                         // don't know why we do this for incoming messages
-    iovecinst.iov_base = &UDPInBuffer;                  // set buffer for incoming message number i
-    iovecinst.iov_len = 1032;
-    datagram.msg_iov = &iovecinst;
-    datagram.msg_iovlen = 1;
-    datagram.msg_name = &addr_from[i];
-    datagram.msg_namelen = sizeof(addr_from[i]);
-
-    size = recvmsg(sock_ep2, &datagram, 0);         // get a batch of 8 messages
-    if(size < 0 && errno != EAGAIN)
+    for(Msg = 0; Msg < VEP2MAXBATCH; Msg++)
+      datagrams[Msg].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    Received = recvmmsg(sock_ep2, datagrams, VEP2MAXBATCH, MSG_WAITFORONE, NULL);
+    if(Received < 0 && errno != EAGAIN)
     {
       perror("recvfrom");
       return EXIT_FAILURE;
     }
 
-    memcpy(&code, &UDPInBuffer, 4);                          // copy the Metis frame identifier
-    switch(code)
+    for(Msg = 0; Msg < Received; Msg++)
     {
-      // PC to Metis data frame, EP2 data. C&C, TX I/Q, spkr
-      // this is "normal SDR traffic"
-      case 0x0201feef:
-        printf("RX metis frame\n");
-
-
-        break;
-
-
-      // Metis "discover request" from PC
-      // send message back to MAC address and port of originating request message
-      case 0x0002feef:
-        printf("received metis discover request frame\n");
-        reply[2] = 2 + active_thread;                             // response 2 if not active, 3 if running
-        memset(&UDPInBuffer, 0, 60);
-        memcpy(&UDPInBuffer, reply, 11);
-        sendto(sock_ep2, &UDPInBuffer, 60, 0, (struct sockaddr *)&addr_from[i], sizeof(addr_from[i]));
-        break;
-
-
-      // Metis STOP command from PC
-      // terminate outgoing thread
-      case 0x0004feef:
-        enable_thread = 0;                                        // signal thread to terminate
-        while(active_thread) usleep(1000);                        // sleep until thread has terminated
-        break;
-
-
-      // Metis START commands to PC (01=IQ only; 02=wideband only; 03=both)
-      // initialise settings for outgoing data thread and start it
-      case 0x0104feef:
-      case 0x0204feef:
-      case 0x0304feef:
-        printf("received metis START command\n");
-        enable_thread = 0;                                // command outgoing thread to stop
-        while(active_thread) usleep(1000);                // wait until it has stopped
-
-        //
-        // get from MAC address and port; this is where the data goes back to
-        //
-        memset(&addr_ep6, 0, sizeof(addr_ep6));
-        addr_ep6.sin_family = AF_INET;
-        addr_ep6.sin_addr.s_addr = addr_from[i].sin_addr.s_addr;
-        addr_ep6.sin_port = addr_from[i].sin_port;
-        enable_thread = 1;                                // initialise thread to active
-        active_thread = 1;
-        //
-        // create outgoing packet thread
-        //
-        if(pthread_create(&thread, NULL, SendOutgoingPacketData, NULL) < 0)
-        {
-          perror("pthread_create");
-          return EXIT_FAILURE;
-        }
-        pthread_detach(thread);
-        break;
-    }// end switch (packet type)
+      Frame = UDPInBuffer[Msg];
+      memcpy(&code, Frame, 4);                                 // copy the Metis frame identifier
+      switch(code)
+      {
+        // PC to Metis data frame, EP2 data. C&C, TX I/Q, spkr
+        // this is "normal SDR traffic"
+        // each USB frame starts with 3 sync bytes then 5 C&C bytes then 63 sample sets
+        case 0x0201feef:
+          if(datagrams[Msg].msg_len < VMETISFRAMESIZE)
+            break;
+          for(i = 0; i < 2; i++)
+            if((Frame[8 + 512*i] == 0x7F) && (Frame[9 + 512*i] == 0x7F) && (Frame[10 + 512*i] == 0x7F))
+            {
+              process_incoming_CandC(Frame + 11 + 512*i);
+              AddEP2Samples(Frame + 8 + 512*i, (bool)(Frame[11 + 512*i] & 1));
+            }
+          break;
+
+
+        // Metis "discover request" from PC
+        // send message back to MAC address and port of originating request message
+        case 0x0002feef:
+          printf("received metis discover request frame\n");
+          reply[2] = 2 + active_thread;                             // response 2 if not active, 3 if running
+          memset(Frame, 0, 60);
+          memcpy(Frame, reply, 11);
+          sendto(sock_ep2, Frame, 60, 0, (struct sockaddr *)&addr_from[Msg], sizeof(addr_from[Msg]));
+          break;
+
+
+        // Metis STOP command from PC
+        // terminate outgoing thread
+        case 0x0004feef:
+          enable_thread = 0;                                        // signal thread to terminate
+          while(active_thread) usleep(1000);                        // sleep until thread has terminated
+          break;
+
+
+        // Metis START commands to PC (01=IQ only; 02=wideband only; 03=both)
+        // initialise settings for outgoing data thread and start it
+        case 0x0104feef:
+        case 0x0204feef:
+        case 0x0304feef:
+          printf("received metis START command\n");
+          enable_thread = 0;                                // command outgoing thread to stop
+          while(active_thread) usleep(1000);                // wait until it has stopped
+          ResetEP2Ingest();                                 // discard any old TX and speaker samples
+
+          //
+          // get from MAC address and port; this is where the data goes back to
+          //
+          memset(&addr_ep6, 0, sizeof(addr_ep6));
+          addr_ep6.sin_family = AF_INET;
+          addr_ep6.sin_addr.s_addr = addr_from[Msg].sin_addr.s_addr;
+          addr_ep6.sin_port = addr_from[Msg].sin_port;
+          enable_thread = 1;                                // initialise thread to active
+          active_thread = 1;
+          //
+          // create outgoing packet thread
+          //
+          if(pthread_create(&thread, NULL, SendOutgoingPacketData, NULL) < 0)
+          {
+            perror("pthread_create");
+            return EXIT_FAILURE;
+          }
+          pthread_detach(thread);
+          break;
+      }// end switch (packet type)
+    }
 
 //
-// now do any "post packet" processing
+// now do any "post packet" processing: write TX I/Q and speaker samples to the FPGA
 //
+    WriteEP2Samples();
   } //while(1)
   close(sock_ep2);                          // close incoming data socket
 
@@ -269,7 +306,11 @@ void process_incoming_CandC(uint8_t *frame)
     // DDC count; time stamp on / off
         case 0:
         case 1:
-            SetP1SampleRate((ESampleRate)((C1 & 3)+1), ((C4 >> 3) & 7)+1);
+            rate = C1 & 3;
+            receivers = ((C4 >> 3) & 7) + 1;
+            if(receivers > VMAXP1DDCS)
+              receivers = VMAXP1DDCS;
+            SetP1SampleRate((ESampleRate)(rate + 1), receivers);
             // skip Atlas bus controls (10MHz source, clock source, config, mic)
             SetClassEPA((bool)(C2 & 1));
             SetOpenCollectorOutputs(C2 >> 1);
@@ -279,7 +320,6 @@ void process_incoming_CandC(uint8_t *frame)
             SetAlexRXOut((bool)(C3 >> 7));
             SetAlexTXAnt(C4 & 3);
             SetDuplex((bool)((C4 >> 2) & 1));
-            SetNumP1DDC((C4 >> 3) & 7);
             EnablePPSStamp((bool)((C4 >> 6) & 1));
             // skip mercury frequency
             break;
@@ -289,7 +329,7 @@ void process_incoming_CandC(uint8_t *frame)
         // TX frequency (Hz)
         case 2:
         case 3:
-            SetDUCFrequency(0, data32, false);
+            SetDUCFrequency(data32, false);
             break;
 
 
@@ -354,7 +394,7 @@ void process_incoming_CandC(uint8_t *frame)
         // Alex RX1 filters; Alex disable T / R relay; Alex TX filters; set apollo bits
     case 18:
     case 19:
-        SetTXDriveLevel(0, C1);
+        SetTXDriveLevel(C1);
         SetMicBoost((bool)(C2 & 1));
         SetMicLineInput((bool)((C2 >> 1) & 1));
         SetApolloBits((bool)((C2 >> 2) & 1), (bool)((C2 >> 3) & 1), (bool)((C2 >> 4) & 1));
@@ -372,7 +412,7 @@ void process_incoming_CandC(uint8_t *frame)
         SetCodecLineInGain(C2 & 0b00011111);
         // Check P1 code: do I need C2 bits 7-5?
         // check P1 code: do I need C3 bits?
-        SetADCAttenuator(eADC1, C4&0b00011111, (bool)((C4 >> 5) & 1));
+        SetADCAttenuator(eADC1, ((C4 >> 5) & 1) ? (C4 & 0b00011111) : 0, true, false);   // atten if enabled
         break;
 
 
@@ -380,13 +420,12 @@ void process_incoming_CandC(uint8_t *frame)
     // ADC2 atten; ADC3 atten; CW keys reversed; keyer speed, keyer mode, keyer weight, keyer spacing
     case 22:
     case 23:
-        SetADCAttenuator(eADC2, C1 & 0b00011111, (bool)((C1 >> 5) & 1));
+        SetADCAttenuator(eADC2, ((C1 >> 5) & 1) ? (C1 & 0b00011111) : 0, true, false);
         // ignore ADC3 data
-        SetCWKeyerReversed((bool)((C2 >> 6) & 1));
-        SetCWKeyerSpeed(C3 & 0b00111111);
-        SetCWKeyerMode((C3 >> 6) & 3);
-        SetCWKeyerWeight(C4 & 0b01111111);              // what is keyer weight
-        SetCWKeyerSpacing((bool)((C4 >> 7) & 1));
+        // keyer mode: 0=straight, 1=iambic mode A, 2=iambic mode B. P1 has no break-in setting.
+        SetCWIambicKeyer(C3 & 0b00111111, C4 & 0b01111111, (bool)((C2 >> 6) & 1), ((C3 >> 6) & 3) == 2,
+                         (bool)((C4 >> 7) & 1), ((C3 >> 6) & 3) != 0, true);
+        break;
     case 24:
     case 25:
     case 26:
@@ -398,14 +437,14 @@ void process_incoming_CandC(uint8_t *frame)
     // ADC assignment; ADC atten during TX
     case 28:
     case 29:
-        SetDDCADC(0, C1 & 3);
-        SetDDCADC(1, (C1 >> 2) & 3);
-        SetDDCADC(2, (C1 >> 4) & 3);
-        SetDDCADC(3, (C1 >> 6) & 3);
-        SetDDCADC(5, C2 & 3);
-        SetDDCADC(6, (C2 >> 2) & 3);
-        SetDDCADC(7, (C2 >> 4) & 3);
-        SetADCAttenDuringTX(C3&0b00011111);
+        SetDDCADC(0, (EADCSelect)(C1 & 3));
+        SetDDCADC(1, (EADCSelect)((C1 >> 2) & 3));
+        SetDDCADC(2, (EADCSelect)((C1 >> 4) & 3));
+        SetDDCADC(3, (EADCSelect)((C1 >> 6) & 3));
+        SetDDCADC(4, (EADCSelect)(C2 & 3));
+        SetDDCADC(5, (EADCSelect)((C2 >> 2) & 3));
+        SetDDCADC(6, (EADCSelect)((C2 >> 4) & 3));
+        SetADCAttenuator(eADC1, C3&0b00011111, false, true);       // ADC1 atten during TX
       break;
 
 
@@ -413,7 +452,7 @@ void process_incoming_CandC(uint8_t *frame)
     // CW enable; CW sidetone volume; CW PTT delay
     case 30:
     case 31:
-        EnableCW((bool)(C1 & 1));
+        EnableCW((bool)(C1 & 1), true);
         SetCWSidetoneVol(C2);
         SetCWPTTDelay(C3);
         break;
@@ -464,15 +503,16 @@ void process_incoming_CandC(uint8_t *frame)
 // global holding the current step of C&C data. Each new USB frame updates this.
 //
 uint32_t OutgoingCandCStep;                         // 0-1-2-3-4 sequence for C&C data
-#define VDMABUFFERSIZE 32768									      // memory buffer to reserve
-#define VALIGNMENT 4096                             // buffer alignment
-#define VBASE 0x1000									              // DMA start at 4K into buffer
-#define VMETISFRAMESIZE 1032
-#define VBASE 0x1000                                // offset into I/Q buffer for DMA to start
+#define VDDCRINGSIZE 65536                          // DDC ring buffer
 #define VUSBSAMPLESIZE 504                          // useful data per USB Frame
-#define VDMATRANSFERSIZE 4096                       // read 4K at a time
-#define AXIBaseAddress 0x18000									    // address of StreamRead/Writer IP (Litefury only!)
-#define VIQBYTESPERMETISFRAME 228                   // 19 sets of (same) I/Q per USB, 2USB per metis
+#define VDDCDMAWORDS 512                            // smallest DDC DMA: 512 64 bit words = 4K bytes
+#define VDDCMAXDMAWORDS 4096                        // largest DDC DMA: 4096 64 bit words = 32K bytes
+#define VDDCFRAMERATE 48000                         // DDC frames per second (a count of 1 = 48KHz)
+#define VP1STAGEBYTES 32768                         // unpacked I/Q ring per receiver
+#define VMICRINGSIZE 8192                           // mic ring buffer
+#define VMICDMASIZE 128                             // 16 FIFO locations = 64 mic samples
+#define VMICMAXDMA (8 * VMICDMASIZE)                // most mic data read in one DMA
+#define VMICMAXBACKLOG 4096                         // most mic data held before the oldest is dropped
 
   //
   // 5 USB data headers with outgoing C&C data
@@ -487,6 +527,15 @@ uint32_t OutgoingCandCStep;                         // 0-1-2-3-4 sequence for C&
   };
 
 
+//
+// outgoing thread statistics, reported when the thread stops
+//
+uint32_t P1FramesSent;                              // Metis frames sent
+uint32_t P1DDCOverflows;                            // DDC FIFO overflows seen
+uint32_t P1DDCResyncs;                              // times the DDC stream lost its rate word
+uint32_t P1StageOverflows;                          // times receiver staging was discarded
+uint32_t P1MicUnderflows;                           // mic sample needed but none available
+
 
 //
 // AddOutgoingC&CBytes(unsigned char* Ptr, uint32_t CandCSequence);
@@ -519,6 +568,33 @@ void AddOutgoingCandCBytes(uint8_t* Ptr)
 }
 
 
+//
+// test whether a DMA buffer location holds a DDC rate word header
+// the top byte of the 64 bit word is 0x80
+//
+static inline bool IsDDCHeader(uint8_t* Ptr)
+{
+  return (*(Ptr + 7) == 0x80);
+}
+
+
+//
+// DMA any complete blocks of mic samples into the mic ring
+// the FPGA mic samples are already 16 bit big endian, as protocol 1 needs.
+// if more than VMICMAXBACKLOG bytes are waiting, the oldest samples are dropped.
+//
+static void ReadP1MicData(struct StreamSource* MicSource, struct StreamRing* MicRing)
+{
+  uint32_t Used;
+
+  StreamSourceDepth(MicSource);
+  Used = StreamRingUsed(MicRing);
+  if(Used > VMICMAXBACKLOG)
+    StreamRingConsume(MicRing, Used - VMICMAXBACKLOG);
+  StreamSourceRead(MicSource, MicRing);
+}
+
+
 
 //
 // this runs as its own thread to send outgoing data
@@ -526,24 +602,39 @@ void AddOutgoingCandCBytes(uint8_t* Ptr)
 // will be instructed to stop & exit by main loop setting enable_thread to 0
 // this code signals thread terminated by setting active_thread = 0
 //
+// the DDC stream has a rate word then the samples for each enabled DDC in each frame.
+// SetP1SampleRate() enables DDC0 to DDC(receivers-1) at the same rate, so each frame has
+// the same number of samples for every receiver. The samples are unpacked into a staging
+// ring per receiver, then sent interleaved as protocol 1 needs: one sample from each
+// receiver then one mic sample, 504/(6*receivers+2) sets per USB frame.
+// mic samples are at 48KHz: at higher DDC rates each one is repeated to fill the sets.
+//
 void *SendOutgoingPacketData(void *arg)
 {
+  (void)arg;
 //
 // memory buffers
 //
-  uint8_t* IQReadBuffer = NULL;											// data for DMA read from DDC
-	uint32_t IQBufferSize = VDMABUFFERSIZE;
-  uint8_t* MicBuffer = NULL;											    // data for DMA read from Mic
-	uint32_t MicBufferSize = VDMABUFFERSIZE;
+  struct StreamRing DDCRing;                      // data for DMA read from DDC
+  struct StreamRing MicRing;                      // data for DMA read from Mic
+  struct StreamSource DDCSource;
+  struct StreamSource MicSource;
+  struct StreamRing IQStage[VMAXP1DDCS];          // unpacked I/Q, one ring per receiver, read in step
   bool InitError = false;                         // becomes true if we get an initialisation error
-	unsigned char* IQReadPtr;								        // pointer for reading out an I or Q sample
-	unsigned char* IQHeadPtr;								        // ptr to 1st free location in I/Q memory
-	unsigned char* IQBasePtr;								        // ptr to DMA location in I/Q memory
-	uint32_t ResidueBytes;
-	uint32_t Depth = 0;
-	int DMAReadfile_fd = -1;											// DMA read file device
-	uint32_t RegisterValue;
-
+  uint8_t* IQReadPtr;                             // start of undecoded DDC data
+  uint8_t* MicReadPtr;                            // next mic sample to send
+  int DMAReadfile_fd = -1;                        // DDC DMA read file device
+  int MicReadfile_fd = -1;                        // mic DMA read file device
+  int DDCEvent_fd = -1;                           // DDC FIFO monitor events, if available
+  const struct DDCFramePlan* FramePlan = NULL;
+  uint32_t PrevRateWord = 0;
+  uint32_t RateWord;
+  uint32_t FrameBytes;
+  uint32_t WordRate = 0;                          // DDC stream 64 bit words per second
+  uint32_t Entry;
+  uint32_t DDC;
+  uint32_t Samples;
+  uint8_t* SamplePtr;
 
 //
 // variables for outgoing UDP frame
@@ -555,41 +646,49 @@ void *SendOutgoingPacketData(void *arg)
   uint32_t SequenceCounter = 0;                           // UDP sequence count
   uint32_t USBFrame;
   uint8_t *USBFramePtr;                                    // write address into o/p frame buffer
-  uint32_t IQCount;                                       // counter of words to read
+  uint32_t IQCount;                                       // counter of sample sets
+  uint32_t RX;
+  uint32_t NumRX = 0;                                     // receivers in use
+  uint32_t P1Rate = 0;                                    // sample rate in use (0=48KHz .. 3=384KHz)
+  uint32_t SetsPerUSBFrame = 0;                           // sample sets in one USB frame
+  uint32_t PadBytes = 0;                                  // unused bytes at the end of USB frame
+  uint32_t MicPhase = 0;                                  // counts repeats of one mic sample
+  uint8_t MicSample[2] = {0, 0};                          // current mic sample
+
 //
 // initialise. Create memory buffers and open DMA file devices
 //
   OutgoingCandCStep = 0;                                  // initialise C&C output
+  P1FramesSent = 0;
+  P1DDCOverflows = 0;
+  P1DDCResyncs = 0;
+  P1StageOverflows = 0;
+  P1MicUnderflows = 0;
   printf("starting up outgoing thread\n");
-	posix_memalign((void **)&IQReadBuffer, VALIGNMENT, IQBufferSize);
-	if(!IQReadBuffer)
-	{
-		printf("I/Q read buffer allocation failed\n");
-		InitError = true;
-	}
-	IQReadPtr = IQReadBuffer + VBASE;							// offset 4096 bytes into buffer
-	IQHeadPtr = IQReadBuffer + VBASE;
-	IQBasePtr = IQReadBuffer + VBASE;
-  memset(IQReadBuffer, 0, IQBufferSize);
-
-
-	posix_memalign((void **)&MicBuffer, VALIGNMENT, MicBufferSize);
-	if(!MicBuffer)
-	{
-		printf("Mic sample buffer allocation failed\n");
-		InitError = true;
-	}
-  memset(MicBuffer, 0, MicBufferSize);
-
-//
-// open DMA device driver
-//
-	DMAReadfile_fd = open("/dev/xdma0_c2h_0", O_RDONLY);
-	if(DMAReadfile_fd < 0)
-	{
-		printf("XDMA read device open failed\n");
-		InitError = true;
-	}
+  if(!StreamRingCreate(&DDCRing, VDDCRINGSIZE, "P1 DDC"))
+    InitError = true;
+  if(!StreamRingCreate(&MicRing, VMICRINGSIZE, "P1 mic"))
+    InitError = true;
+
+  for(RX = 0; RX < VMAXP1DDCS; RX++)
+    if(!StreamRingCreate(&IQStage[RX], VP1STAGEBYTES, "P1 I/Q stage"))
+      InitError = true;
+
+//
+// open DMA device drivers
+//
+  DMAReadfile_fd = OpenDMADevice(VDDCDMADEVICE, O_RDONLY);
+  if(DMAReadfile_fd < 0)
+  {
+    printf("XDMA read device open failed for DDC data\n");
+    InitError = true;
+  }
+  MicReadfile_fd = OpenDMADevice(VMICDMADEVICE, O_RDONLY);
+  if(MicReadfile_fd < 0)
+  {
+    printf("XDMA read device open failed for mic data\n");
+    InitError = true;
+  }
 
   //
   // initialise outgoing metis frame
@@ -605,38 +704,62 @@ void *SendOutgoingPacketData(void *arg)
   datagram.msg_namelen = sizeof(addr_ep6);
 
 //
-// write 0 to GPIO to clear FIFO; then set 2 to GPIO for normal operation
-// then read depth
-//
-	RegisterWrite(0xA000, 0);				// write to the GPIO register
-	RegisterWrite(0xA000, 2);				// write to the GPIO register
-	printf("GPIO Register written with value=0 then 2 to reset FIFO\n");
-	RegisterValue = RegisterRead(0x9000);				// read the FIFO Depth register
-	printf("FIFO Depth register = %08x (should be 0)\n", RegisterValue);
-	Depth=0;
-
-//
-// write 3 to GPIO to enable FIFO writes
+// stop the DDC stream, then reset the DDC and mic FIFOs
+// if the FIFO monitor events device is available, interrupt when a DMA is ready
 //
-	RegisterWrite(0xA000, 3);				// write to the GPIO register
-	printf("GPIO Register written with value=3, enabling writes\n");
+  SetRXDDCEnabled(false);
+  usleep(1000);                                     // give FIFO time to stop recording
+  DDCEvent_fd = OpenFIFOMonitorEvents(eRXDDCDMA);
+  if(DDCEvent_fd >= 0)
+    SetupFIFOMonitorThreshold(eRXDDCDMA, VDDCDMAWORDS, true);
+  else
+    SetupFIFOMonitorChannel(eRXDDCDMA, false);
+  ResetDMAStreamFIFO(eRXDDCDMA);
+  SetupFIFOMonitorChannel(eMicCodecDMA, false);
+  ResetDMAStreamFIFO(eMicCodecDMA);
+  StreamSourceInitialise(&DDCSource, DMAReadfile_fd, eRXDDCDMA, VADDRDDCSTREAMREAD,
+                         VDDCDMAWORDS * 8, VDDCMAXDMAWORDS * 8, DDCEvent_fd);
+  StreamSourceInitialise(&MicSource, MicReadfile_fd, eMicCodecDMA, VADDRMICSTREAMREAD,
+                         VMICDMASIZE, VMICMAXDMA, -1);
+  SetRXDDCEnabled(true);
 
 
 //
 // thread loop. runs continuously until commanded by main loop to exit
-// for now: add 1 RX data + mic data at 48KHz sample rate. Mic data is constant zero.
-// while there is enough I/Q data, make outgoing packets;
+// while there is enough I/Q data for every receiver, make outgoing packets;
 // when not enough data, read more.
 //
   while(!InitError)
   {
     if(!enable_thread) break;                                     // exit thread if commanded
-		
+
     //
-    // while there is enough I/Q data, make Metis frames
+    // pick up the receiver count and rate. If they have changed, discard the staged samples
+    // so the receivers stay in step
     //
-    while((IQHeadPtr - IQReadPtr)>VIQBYTESPERMETISFRAME)
+    if((NumRX != (uint32_t)receivers) || (P1Rate != (uint32_t)rate))
     {
+      NumRX = (uint32_t)receivers;
+      P1Rate = (uint32_t)rate;
+      SetsPerUSBFrame = VUSBSAMPLESIZE / (6 * NumRX + 2);
+      PadBytes = VUSBSAMPLESIZE - SetsPerUSBFrame * (6 * NumRX + 2);
+      for(RX = 0; RX < VMAXP1DDCS; RX++)
+        StreamRingReset(&IQStage[RX]);
+      MicPhase = 0;
+    }
+
+    //
+    // while there is enough I/Q data for all receivers, make Metis frames
+    //
+    ReadP1MicData(&MicSource, &MicRing);
+    while(true)
+    {
+      for(RX = 0; RX < NumRX; RX++)
+        if(StreamRingUsed(&IQStage[RX]) < 2 * 6 * SetsPerUSBFrame)
+          break;
+      if(RX != NumRX)
+        break;
+
       *(uint32_t *)(UDPBuffer  + 4) = htonl(SequenceCounter++);     // add sequence count
       for(USBFrame=0; USBFrame < 2; USBFrame++)
       {
@@ -644,68 +767,122 @@ void *SendOutgoingPacketData(void *arg)
         AddOutgoingCandCBytes(USBFramePtr);
         USBFramePtr += 8;
         //
-        // now add I/Q and (null) microphone audio data.
-        // the board is pretending to be a Hermes, so need to offer back 4 receivers worth of data
+        // now add I/Q for each receiver then the microphone audio sample
         //
-        for(IQCount = 0; IQCount < 19; IQCount++)
+        for(IQCount = 0; IQCount < SetsPerUSBFrame; IQCount++)
         {
-          memcpy(USBFramePtr, IQReadPtr, 6);                        // copy one set of I/Q samples
-          USBFramePtr+= 6;
-          memcpy(USBFramePtr, IQReadPtr, 6);                        // copy same set of I/Q samples
-          USBFramePtr+= 6;
-          memcpy(USBFramePtr, IQReadPtr, 6);                        // copy same set of I/Q samples
-          USBFramePtr+= 6;
-          memcpy(USBFramePtr, IQReadPtr, 6);                        // copy same set of I/Q samples
-          USBFramePtr+= 6;
-          *USBFramePtr++ = 0;                                       // add 2 zero bytes for mic
-          *USBFramePtr++ = 0;
-          IQReadPtr += 6;
+          for(RX = 0; RX < NumRX; RX++)
+          {
+            memcpy(USBFramePtr, StreamRingReadPtr(&IQStage[RX]), 6);    // copy one I/Q sample
+            StreamRingConsume(&IQStage[RX], 6);
+            USBFramePtr += 6;
+          }
+          if(MicPhase == 0)
+          {
+            if(StreamRingUsed(&MicRing) >= 2)
+            {
+              MicReadPtr = StreamRingReadPtr(&MicRing);
+              MicSample[0] = MicReadPtr[0];
+              MicSample[1] = MicReadPtr[1];
+              StreamRingConsume(&MicRing, 2);
+            }
+            else
+              P1MicUnderflows++;
+          }
+          MicPhase = (MicPhase + 1) & ((1U << P1Rate) - 1);
+          *USBFramePtr++ = MicSample[0];
+          *USBFramePtr++ = MicSample[1];
         }
-        memset(USBFramePtr, 0, 10);                                 // add 10 padding bytes
-        USBFramePtr += 10;
+        memset(USBFramePtr, 0, PadBytes);                           // add padding bytes
       }
       //
       // send outgoing packet
       //
       sendmsg(sock_ep2, &datagram, 0);
+      P1FramesSent++;
     }
+
+    //
+    // now wait until there is data, then DMA as many whole 4K blocks as there are
+    // the ring is mirrored, so a frame that wraps round the end of the ring is still contiguous
+    //
+    StreamSourceWait(&DDCSource, VDDCDMAWORDS, WordRate, &enable_thread);
+    if(!enable_thread)
+      break;
+    StreamSourceRead(&DDCSource, &DDCRing);
+
     //
-    // now bring in more data via DMA
-    // first copy any residue to the start of the buffer (before the DMA point)
-//
-		ResidueBytes = IQHeadPtr- IQReadPtr;
-		printf("Residue = %d bytes\n",ResidueBytes);
-		if(ResidueBytes != 0)					// if there is residue
-		{
-			memcpy(IQBasePtr-ResidueBytes, IQReadPtr, ResidueBytes);
-			IQReadPtr = IQBasePtr-ResidueBytes;
-		}
-		else
-			IQReadPtr = IQBasePtr;
-//
-// now wait until there is data, then DMA it
-//
-		Depth = RegisterRead(0x9000);				// read the user access register
-		printf("read: depth = %d\n", Depth);
-		while(Depth < 512)			// 512 locations = 4K bytes
-		{
-			usleep(1000);								// 1ms wait
-			Depth = RegisterRead(0x9000);				// read the user access register
-			printf("read: depth = %d\n", Depth);
-		}
-
-		printf("DMA read %d bytes from destination to base\n", VDMATRANSFERSIZE);
-		DMAReadFromFPGA(DMAReadfile_fd, IQBasePtr, VDMATRANSFERSIZE, AXIBaseAddress);
-		IQHeadPtr = IQBasePtr + VDMATRANSFERSIZE;
+    // decode whole DDC frames into the receiver staging buffers
+    // if the rate word is not where expected, skip forward to the next one
+    //
+    while(StreamRingUsed(&DDCRing) >= 16)
+    {
+      IQReadPtr = StreamRingReadPtr(&DDCRing);
+      if(!IsDDCHeader(IQReadPtr))
+      {
+        P1DDCResyncs++;
+        while((StreamRingUsed(&DDCRing) >= 8) && !IsDDCHeader(StreamRingReadPtr(&DDCRing)))
+          StreamRingConsume(&DDCRing, 8);
+        continue;
+      }
+      RateWord = *(uint32_t*)IQReadPtr;
+      if((RateWord != PrevRateWord) || (FramePlan == NULL))
+      {
+        FramePlan = GetDDCFramePlan(RateWord);
+        if(FramePlan == NULL)                                     // not a valid rate word: a sample, not a header
+        {
+          P1DDCResyncs++;
+          StreamRingConsume(&DDCRing, 8);
+          continue;
+        }
+        PrevRateWord = RateWord;
+        WordRate = (FramePlan->FrameLength + 1) * VDDCFRAMERATE;
+      }
+      FrameBytes = (FramePlan->FrameLength + 1) * 8;
+      if(StreamRingUsed(&DDCRing) < FrameBytes)
+        break;
+
+      SamplePtr = IQReadPtr + 8;                                  // 1st location past rate word
+      for(Entry = 0; Entry < FramePlan->ActiveDDCs; Entry++)
+      {
+        DDC = FramePlan->DDC[Entry];
+        Samples = FramePlan->Count[Entry];
+        if(DDC >= NumRX)                                          // not a receiver in use
+          continue;
+        if(StreamRingSpace(&IQStage[DDC]) < 6 * Samples)
+        {
+          //
+          // a receiver isn't getting samples (eg just after a receiver count change)
+          // so the others can't be sent: discard them all and start again
+          //
+          P1StageOverflows++;
+          for(RX = 0; RX < VMAXP1DDCS; RX++)
+            StreamRingReset(&IQStage[RX]);
+        }
+        UnpackDDCSamples(StreamRingWritePtr(&IQStage[DDC]), SamplePtr + FramePlan->Offset[Entry], Samples);
+        StreamRingCommit(&IQStage[DDC], 6 * Samples);
+      }
+      StreamRingConsume(&DDCRing, FrameBytes);
+    }
   }     // end of while(!InitError) loop
 
 //
 // tidy shutdown of the thread
 //
+  SetRXDDCEnabled(false);
+  P1DDCOverflows = DDCSource.Overflows;
+  printf("outgoing thread stopped: %u frames sent; DDC overflows=%u resyncs=%u discards=%u; mic underflows=%u\n",
+         P1FramesSent, P1DDCOverflows, P1DDCResyncs, P1StageOverflows, P1MicUnderflows);
   active_thread = 0;        // signal that thread has closed
-	close(DMAReadfile_fd);
-  free(IQReadBuffer);
-  free(MicBuffer);
+  if(DDCEvent_fd >= 0)
+    CloseUserIRQWaiter(DDCEvent_fd);
+  if(DMAReadfile_fd >= 0)
+    close(DMAReadfile_fd);
+  if(MicReadfile_fd >= 0)
+    close(MicReadfile_fd);
+  for(RX = 0; RX < VMAXP1DDCS; RX++)
+    StreamRingDestroy(&IQStage[RX]);
+  StreamRingDestroy(&DDCRing);
+  StreamRingDestroy(&MicRing);
   return NULL;
 }
-
@@ -29,6 +29,7 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <pthread.h>
+#include <time.h>
 #include <syscall.h>
 
 #include "../common/saturnregisters.h"
@@ -39,18 +40,31 @@
 #include "serialport.h"
 #include "g2v2panel.h"
 #include "AriesATU.h"
+#include "housekeeping.h"
 
 
 bool AriesATUActive;                                // true if Aries is operating
 bool AriesDetected;                                 // true if Aries detected from CAT message
 TSerialThreadData AriesData;                        // data for G2V1 adapter read thread
-pthread_t AriesSerialThread;                        // thread for serial read from Aries
-pthread_t AriesTickThread;                          // thread with periodic tick
+int AriesTickTimer = -1;                            // housekeeping timer for the periodic tick
 unsigned int CurrentTXAntenna = 0;                  // 0 if not known.
 unsigned int CurrentRXAntenna = 0;                  // 0 if not known.
 uint32_t CurrentFrequency = 0;                      // 10KHz units. 0 if not known
 bool EnabledForAntenna[4] = {false, false, false, false};  // enabled state for each possible TX antenna 0 entry is "unknown antenna"
 bool TuneSolutionFound = false;                     // true if there is a tune solution for current frequency
+int AriesEnabledSent = -1;                          // enabled state last sent to Aries; -1 if none sent
+
+//
+// TX frequency forwarding: the high priority thread sets a new frequency every time the
+// VFO moves by 10KHz, which during a fast sweep is far faster than the serial link can take.
+// only the latest is kept, and the tick thread sends it at most every VARIESFREQINTERVAL.
+// tune requests and button presses send any pending frequency straight away, ahead of them.
+//
+#define VARIESFREQINTERVAL 100                      // ms between ZZFT messages
+static pthread_mutex_t AriesFrequencyMutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t PendingFrequency_Hz;                // latest TX frequency not yet sent
+static bool FrequencyPending = false;
+static uint64_t FrequencySentTime = 0;              // ms time of last ZZFT
 
 extern bool IsTXMode;                               // true if in TX
 
@@ -85,29 +99,74 @@ void CalculateAriesLEDs(void)
 
 
 
+//
+// helper: CLOCK_MONOTONIC time in ms
+//
+static uint64_t AriesTimeNow(void)
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (uint64_t)Now.tv_sec * 1000 + Now.tv_nsec / 1000000;
+}
+
+
+//
+// send the pending TX frequency to Aries, if there is one
+// unless Immediate, it is only sent if VARIESFREQINTERVAL has passed since the last
+//
+static void SendAriesFrequency(bool Immediate)
+{
+    uint64_t Now;
+    uint32_t Freq_Hz = 0;
+    bool Send = false;
+
+    Now = AriesTimeNow();
+    pthread_mutex_lock(&AriesFrequencyMutex);
+    if(FrequencyPending && (Immediate || ((Now - FrequencySentTime) >= VARIESFREQINTERVAL)))
+    {
+        Freq_Hz = PendingFrequency_Hz;
+        FrequencyPending = false;
+        FrequencySentTime = Now;
+        Send = true;
+    }
+    pthread_mutex_unlock(&AriesFrequencyMutex);
+    if(Send)
+    {
+        printf("Aries get Freq = %d\n", Freq_Hz);
+        MakeCATMessageNumeric(AriesData.DeviceHandle, eZZFT, Freq_Hz);
+    }
+}
+
+
 //
 // Aries periodic timestep
-// this runs as a thread,created at startup if Aries is detected.
+// this runs as a 20ms housekeeping timer, added at startup if Aries is detected.
 //
-void* AriesTick(__attribute__((unused)) void *arg)
+static void AriesTick(__attribute__((unused)) void *arg)
 {
-    bool PreviousTXMode = false;                                    // for detecting TX state change
-    bool PreviousSDRActive = false;                                 // for detecting SDR active state change
+    static bool PreviousTXMode = false;                             // for detecting TX state change
+    static bool PreviousSDRActive = false;                          // for detecting SDR active state change
+    bool Active;                                                    // SDRActive, read once per tick
+    bool TXMode;                                                    // IsTXMode, read once per tick
 
-    printf("opened Aries periodic tick thread, pid=%ld\n", syscall(SYS_gettid));
-    while(AriesATUActive)
+    if(AriesATUActive)
     {
         //
         // look for a change in SDR active
         //
-        if(SDRActive != PreviousSDRActive)                          // state change
+        Active = __atomic_load_n(&SDRActive, __ATOMIC_ACQUIRE);
+        if(Active != PreviousSDRActive)                             // state change
         {
-            PreviousSDRActive = SDRActive;                          // state change recognised
-            if(SDRActive == false)
+            PreviousSDRActive = Active;                             // state change recognised
+            if(Active == false)
             {
                 CurrentTXAntenna = 0;                               // mark ants and freq as "uknown"
                 CurrentRXAntenna = 0;
                 CurrentFrequency = 0;
+                pthread_mutex_lock(&AriesFrequencyMutex);
+                FrequencyPending = false;                           // discard any unsent frequency
+                pthread_mutex_unlock(&AriesFrequencyMutex);
                 TuneSolutionFound = false;                          // no tune solution
                 SetAriesEnabledState(false);                        // disable while SDR not active
             }
@@ -119,16 +178,18 @@ void* AriesTick(__attribute__((unused)) void *arg)
         // look for a change in TX state
         // if we enter TX, send out a TUNE request message to find if this is a TUNE or not. 
         //
-        if(IsTXMode != PreviousTXMode)                              // state change
+        TXMode = __atomic_load_n(&IsTXMode, __ATOMIC_RELAXED);
+        if(TXMode != PreviousTXMode)                                // state change
         {
-            PreviousTXMode = IsTXMode;                          // state change recognised
-            if(IsTXMode)
+            PreviousTXMode = TXMode;                            // state change recognised
+            if(TXMode)
                 MakeCATMessageNoParam(DESTTCPCATPORT, eZZTU);
         }
-        usleep(20000);                                              // 20ms period
+        //
+        // forward the latest TX frequency, rate limited
+        //
+        SendAriesFrequency(false);
     }
-    printf("Closing Aries tick thread\n");
-    return NULL;
 }
 
 
@@ -150,9 +211,8 @@ void InitialiseAriesHandler(void)
     AriesData.Device = eAriesATU;
     AriesData.Baud = B9600;
 
-    if(pthread_create(&AriesSerialThread, NULL, CATSerial, (void *)&AriesData) < 0)
-        perror("pthread_create Aries ATU thread");
-    pthread_detach(AriesSerialThread);
+    if(!AddSerialCATDevice(&AriesData))
+        printf("Aries ATU serial device not opened\n");
 
 
     sleep(2);                               // ID request only goes out after 1s
@@ -165,13 +225,11 @@ void InitialiseAriesHandler(void)
     {
         printf("Aries ATU Selected and Active\n");
         AriesATUActive = true;
-        if(pthread_create(&AriesTickThread, NULL, AriesTick, NULL) < 0)
-            perror("pthread_create Aries tick");
-        pthread_detach(AriesTickThread);
+        AriesTickTimer = AddHousekeepingTimer("Aries tick", 20, AriesTick, NULL);
 
     }
     else
-        AriesData.DeviceActive = false;
+        RemoveSerialCATDevice(&AriesData);
 }
 
 
@@ -180,9 +238,11 @@ void InitialiseAriesHandler(void)
 //
 void ShutdownAriesHandler(void)
 {
-    AriesATUActive = false;                     // shut down tick thread
-    AriesData.DeviceActive = false;             // shut down serial thread
-    sleep(1);                                   // allow time for tick thread to close
+    AriesATUActive = false;                     // shut down tick
+    RemoveHousekeepingTimer(AriesTickTimer);
+    AriesTickTimer = -1;
+    RemoveSerialCATDevice(&AriesData);          // close serial device
+    sleep(1);                                   // allow time for the serial thread to close it
 }
 
 
@@ -237,6 +297,7 @@ void SetAriesTuneState(bool Param)
     if(Param)
     {
         printf("Aries detected TUNE state\n");
+        SendAriesFrequency(true);                                           // Aries must tune for the current frequency
         MakeCATMessageBool(AriesData.DeviceHandle, eZZTU, true);            // tell Aries it is in TUNE
     }
     else
@@ -261,11 +322,15 @@ bool IsAriesSerial(int Handle)
 
 //
 // set ATU Enabled or Disabled
-// send message to ATU, and set LED appropriately
+// send message to ATU if changed, and set LED appropriately
 //
 void SetAriesEnabledState(bool IsEnabled)
 {
-    MakeCATMessageBool(AriesData.DeviceHandle, eZZOV, IsEnabled);            // set enabled state
+    if(AriesEnabledSent != (int)IsEnabled)
+    {
+        AriesEnabledSent = (int)IsEnabled;
+        MakeCATMessageBool(AriesData.DeviceHandle, eZZOV, IsEnabled);        // set enabled state
+    }
     CalculateAriesLEDs();
 }
 
@@ -286,8 +351,10 @@ void SetAriesTXFrequency(uint32_t NewFreq)
         if(Freq_10KHz != CurrentFrequency)
         {
             CurrentFrequency = Freq_10KHz;
-            printf("Aries get Freq = %d\n", Freq_Hz);
-            MakeCATMessageNumeric(AriesData.DeviceHandle, eZZFT, Freq_Hz);            // set enabled state
+            pthread_mutex_lock(&AriesFrequencyMutex);
+            PendingFrequency_Hz = Freq_Hz;                          // sent by the tick thread
+            FrequencyPending = true;
+            pthread_mutex_unlock(&AriesFrequencyMutex);
         }
     }
 }
@@ -314,6 +381,7 @@ void SetAriesAlexTXWord(uint16_t Word)
         {
             CurrentTXAntenna = Antenna;
             printf("Aries detected TX Ant=%d\n", Antenna);
+            AriesEnabledSent = -1;                  // always send the enabled state with an antenna change
             if(EnabledForAntenna[Antenna])
             {
                 MakeCATMessageNumeric(AriesData.DeviceHandle, eZZOC, Antenna);      // set antenna
@@ -365,6 +433,7 @@ void HandleATUButtonPress(uint8_t Event)
     if((AriesATUActive) && (CurrentTXAntenna != 0))
     {   
         printf("Aries ATU Button Press, Event=%d\n", Event);
+        SendAriesFrequency(true);                                   // so it applies to the current frequency
         if(Event == 2)                      // long press: set not enabled, erase for current antenna
         {
             SetAriesEnabledState(false);            // set enabled state
@@ -17,6 +17,8 @@
 #include <stdint.h>
 #include "../common/saturntypes.h"
 #include "InDUCIQ.h"
+#include "radiostate.h"
+#include "threadmanager.h"
 #include <errno.h>
 #include <fcntl.h>
 #include <stdlib.h>
@@ -27,6 +29,11 @@
 #include "../common/saturnregisters.h"
 #include "../common/saturndrivers.h"
 #include "../common/hwaccess.h"
+#include "../common/dmapool.h"
+#include "../common/sampleunpack.h"
+#include "../common/ringlog.h"
+#include "metrics.h"
+#include "packetreorder.h"
 #include <pthread.h>
 #include <syscall.h>
 
@@ -36,11 +43,252 @@
 #define VIQSAMPLESPERFRAME 240                      // samples per UDP frame
 #define VMEMWORDSPERFRAME 180                       // memory writes per UDP frame
 #define VBYTESPERSAMPLE 6							// 24 bit + 24 bit samples
-#define VDMABUFFERSIZE 32768						// memory buffer to reserve
-#define VALIGNMENT 4096                             // buffer alignment
+#define VDMABUFFERSIZE 65536						// memory buffer to reserve
 #define VBASE 0x1000								// DMA start at 4K into buffer
 #define VDMATRANSFERSIZE 1440                       // write 1 message at a time
 #define VSTARTUPDELAY 100                           // 100 messages (~100ms) before reporting under or overflows
+#define VEERTRANSFERSIZE 2880                       // EER mode: an envelope sample after each I/Q sample
+#define VEERMEMWORDSPERFRAME 360
+#define VDUCMAXBATCH 16                             // most packets received and written in one go in batched mode
+                                                    // (16 x 2880 bytes must fit in the DMA buffer above VBASE)
+#define VDUCFRAMESPERSEC 800                        // 192KHz / 240 samples per frame
+#define VDUCJITTERFRAMES 256                        // jitter buffer capacity in frames (320ms); power of 2
+                                                    // (half that in EER mode, as the frames are twice the size)
+
+
+unsigned int DUCStartupCount;                       // used to delay reporting of under & overflows
+int DUCEvent_fd = -1;                               // XDMA user interrupt events device, if used
+uint64_t GDUCPacketsWritten = 0;                    // DUC packets written to the FPGA
+uint64_t GDUCDMAWrites = 0;                         // DMA writes used to write them
+int32_t DUCEERDelay = 0;                            // EER envelope delay, samples; negative delays the phase
+
+//
+// EER mode: set by HandlerSetEERMode(), and applied by the DUC thread when not transmitting.
+// the frames written to the FPGA are then twice the size: each I/Q sample is followed by its envelope.
+//
+static bool DUCEERRequested = false;                // EER mode set by the client
+static bool DUCEERActive = false;                   // EER mode set in the hardware
+static struct EERDelayState DUCEERState;            // envelope and phase delay line
+static uint32_t DUCFrameBytes = VDMATRANSFERSIZE;   // bytes written to the FPGA per frame
+static uint32_t DUCFrameWords = VMEMWORDSPERFRAME;  // FIFO locations per frame
+
+//
+// TX jitter buffer: a ring of frames, already I/Q swapped, that are DMAd straight from the ring.
+// frames are added as they arrive from the client, and written to the FPGA as FIFO space allows.
+// after MOX, (or if it runs empty) nothing is written until it has filled to the target depth.
+//
+uint8_t* DUCJitterRing = NULL;                      // VDUCJITTERFRAMES frames of VDMATRANSFERSIZE bytes (or half as many in EER mode)
+uint32_t DUCJitterFrames = VDUCJITTERFRAMES;        // capacity in frames of DUCFrameBytes
+uint32_t DUCJitterWrite;                            // free running count of frames added
+uint32_t DUCJitterRead;                             // free running count of frames written to FPGA
+uint32_t DUCJitterTarget;                           // target depth in frames
+bool DUCJitterPrefill;                              // true if filling before writes (re)start
+uint32_t GDUCJitterUnderflows = 0;                  // times the buffer ran empty in TX
+uint32_t GDUCJitterOverflows = 0;                   // frames discarded because buffer full
+uint32_t GDUCJitterMaxDepth = 0;                    // most frames held
+static uint32_t DUCFIFOCurrent;                     // FIFO occupied locations at the last read, for metrics
+
+
+//
+// wait until the DUC FIFO has at least MinFree free locations, reporting under and overflows
+// (MinFree = 0 just reads it). The wait is timed from the FIFO drain rate, and ended early
+// by a FIFO monitor interrupt if interrupts are enabled.
+// returns the number of free 64 bit locations
+//
+static uint32_t WaitDUCFIFOSpace(uint32_t MinFree)
+{
+    uint32_t Depth;
+    bool FIFOOverflow, FIFOUnderflow, FIFOOverThreshold;
+    unsigned int Current;                                   // current occupied locations in FIFO
+
+    Depth = WaitFIFOMonitorSpace(eTXDUCDMA, DUCEvent_fd, MinFree, VDUCFRAMESPERSEC * DUCFrameWords,
+                                 &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);           // read the FIFO free locations
+    DUCFIFOCurrent = Current;
+    if((DUCStartupCount == 0) && FIFOOverThreshold)
+    {
+        MetricsCountOverThreshold(eDUCMetrics);
+        if(UseDebug)
+            RINGLOG("TX DUC FIFO Overthreshold, depth now = %d\n", Current);
+    }
+    if((DUCStartupCount == 0) && FIFOUnderflow)
+    {
+        __atomic_fetch_or(&GlobalFIFOOverflows, 0b00000100, __ATOMIC_RELAXED);
+        MetricsCountUnderflow(eDUCMetrics);
+        if(UseDebug)
+            RINGLOG("TX DUC FIFO Underflowed, depth now = %d\n", Current);
+    }
+    return Depth;
+}
+
+
+//
+// DMA write a number of DUC frames from the DMA buffer
+// if the FIFO doesn't have space for all of them, write as many as fit then wait for more space
+// (waiting for space for one frame at a time)
+//
+static void WriteDUCFrames(int DMAWritefile_fd, uint8_t* BasePtr, uint32_t Frames)
+{
+    uint32_t Depth;
+    uint32_t WriteFrames;
+
+    while (Frames != 0)
+    {
+        Depth = WaitDUCFIFOSpace(DUCFrameWords);            // wait till space available
+        WriteFrames = Depth / DUCFrameWords;
+        if (WriteFrames > Frames)
+            WriteFrames = Frames;
+        DMAWriteToFPGA(DMAWritefile_fd, BasePtr, WriteFrames * DUCFrameBytes, VADDRDUCSTREAMWRITE);
+        MetricsRecordDMA(eDUCMetrics, WriteFrames * DUCFrameBytes, DUCFIFOCurrent);
+        GDUCDMAWrites++;
+        GDUCPacketsWritten += WriteFrames;
+        BasePtr += WriteFrames * DUCFrameBytes;
+        Frames -= WriteFrames;
+    }
+}
+
+
+//
+// write as many frames from the jitter buffer as the DUC FIFO has space for.
+// if the buffer runs empty during TX, count an underflow and prefill again.
+//
+static void WriteDUCJitterFrames(int DMAWritefile_fd)
+{
+    uint32_t Depth;
+    uint32_t WriteFrames;
+    uint32_t Occupancy;
+    uint32_t Slot;
+
+    Occupancy = DUCJitterWrite - DUCJitterRead;
+    if(DUCJitterPrefill)
+    {
+        if(Occupancy < DUCJitterTarget)
+            return;
+        DUCJitterPrefill = false;
+    }
+    if(Occupancy == 0)
+    {
+        if(__atomic_load_n(&IsTXMode, __ATOMIC_RELAXED))
+            GDUCJitterUnderflows++;
+        DUCJitterPrefill = true;
+        return;
+    }
+    Depth = WaitDUCFIFOSpace(0);
+    WriteFrames = Depth / DUCFrameWords;
+    if(WriteFrames > Occupancy)
+        WriteFrames = Occupancy;
+    while(WriteFrames != 0)
+    {
+        //
+        // write in up to 2 parts if the frames wrap round the end of the ring
+        //
+        Slot = DUCJitterRead & (DUCJitterFrames - 1);
+        Occupancy = WriteFrames;
+        if(Slot + Occupancy > DUCJitterFrames)
+            Occupancy = DUCJitterFrames - Slot;
+        DMAWriteToFPGA(DMAWritefile_fd, DUCJitterRing + Slot * DUCFrameBytes, Occupancy * DUCFrameBytes, VADDRDUCSTREAMWRITE);
+        MetricsRecordDMA(eDUCMetrics, Occupancy * DUCFrameBytes, DUCFIFOCurrent);
+        GDUCDMAWrites++;
+        GDUCPacketsWritten += Occupancy;
+        DUCJitterRead += Occupancy;
+        WriteFrames -= Occupancy;
+    }
+}
+
+
+//
+// where DUC frames are put, for AddDUCFrame()
+//
+struct DUCFrameContext
+{
+    uint8_t* IQBasePtr;                                     // DMA buffer, if not using the jitter buffer
+    uint32_t Frames;                                        // frames in the DMA buffer
+    int DMAWritefile_fd;
+    void (*SwapKernel)(uint8_t* Dest, const uint8_t* Src, uint32_t Count);
+    void (*EERKernel)(uint8_t* Dest, const uint8_t* Src, uint32_t Count, struct EERDelayState* State);
+};
+
+
+//
+// swap one packet's samples (and widen 16 bit samples) into the jitter buffer or the DMA buffer.
+// called for each packet in sequence order: by the receive loop, or by the reorder buffer.
+// the reorder buffer can release more than a batch at once: a full DMA buffer is written first.
+//
+static void AddDUCFrame(const uint8_t* Payload, void* Context)
+{
+    struct DUCFrameContext* DUC = (struct DUCFrameContext*)Context;
+    uint8_t* DestPtr;                                       // where to put swapped samples
+
+    if(DUCJitterRing)
+    {
+        if((DUCJitterWrite - DUCJitterRead) >= DUCJitterFrames)
+        {
+            GDUCJitterOverflows++;                          // full: discard newest
+            return;
+        }
+        DestPtr = DUCJitterRing + (DUCJitterWrite & (DUCJitterFrames - 1)) * DUCFrameBytes;
+        DUCJitterWrite++;
+        if((DUCJitterWrite - DUCJitterRead) > GDUCJitterMaxDepth)
+            GDUCJitterMaxDepth = DUCJitterWrite - DUCJitterRead;
+    }
+    else
+    {
+        if(DUC->Frames == VDUCMAXBATCH)
+        {
+            WriteDUCFrames(DUC->DMAWritefile_fd, DUC->IQBasePtr, DUC->Frames);
+            DUC->Frames = 0;
+        }
+        DestPtr = DUC->IQBasePtr + (DUC->Frames++) * DUCFrameBytes;
+    }
+    if(DUCEERActive)
+        DUC->EERKernel(DestPtr, Payload, VIQSAMPLESPERFRAME, &DUCEERState);
+    else
+        DUC->SwapKernel(DestPtr, Payload, VIQSAMPLESPERFRAME);
+}
+
+
+//
+// set the jitter buffer target depth from the latency, limited to its capacity
+//
+static void SetDUCJitterTarget(void)
+{
+    DUCJitterTarget = (DUCJitterLatency * VDUCFRAMESPERSEC) / 1000;
+    if(DUCJitterTarget < 1)
+        DUCJitterTarget = 1;
+    else if(DUCJitterTarget > DUCJitterFrames - VDUCMAXBATCH)
+        DUCJitterTarget = DUCJitterFrames - VDUCMAXBATCH;
+}
+
+
+//
+// change between normal and EER mode, between transmissions.
+// the TX FIFO must be empty: stop the multiplexer, set the deinterleave bit, reset, and restart.
+// the jitter buffer is emptied, as its frames are a different size.
+//
+static void SetDUCEERActive(bool Enabled)
+{
+    EnableDUCMux(false);
+    SetTXIQDeinterleaved(Enabled);
+    ResetDUCMux();
+    ResetDMAStreamFIFO(eTXDUCDMA);
+    EnableDUCMux(true);
+    DUCEERActive = Enabled;
+    DUCFrameBytes = Enabled ? VEERTRANSFERSIZE : VDMATRANSFERSIZE;
+    DUCFrameWords = Enabled ? VEERMEMWORDSPERFRAME : VMEMWORDSPERFRAME;
+    DUCJitterFrames = Enabled ? VDUCJITTERFRAMES / 2 : VDUCJITTERFRAMES;
+    InitialiseEERDelay(&DUCEERState, DUCEERDelay);
+    if(DUCJitterRing)
+    {
+        SetDUCJitterTarget();
+        DUCJitterWrite = 0;
+        DUCJitterRead = 0;
+        DUCJitterPrefill = true;
+    }
+    if(Enabled)
+        printf("DUC EER mode: envelope after each I/Q sample, delay = %d samples\n", DUCEERState.Delay);
+    else
+        printf("DUC EER mode off\n");
+}
+
 
 //
 // listener thread for incoming DUC I/Q packets
@@ -48,14 +296,39 @@
 // if sufficient FIFO data available: DMA that data and transfer it out. 
 // if it turns out to be too inefficient, we'll have to try larger DMA.
 //
+// batched mode (UseDUCBatching): recvmmsg() collects all the packets waiting, up to VDUCMAXBATCH.
+// they are swapped into one contiguous buffer, and written with one larger DMA.
+// that way a burst of packets from the client costs one receive & one write.
+//
+// jitter buffer mode (DUCJitterLatency != 0): frames go into the jitter buffer instead,
+// and are written out each time round the loop (the socket read times out after 1ms)
+// so the FIFO is kept topped up from the buffer between bursts from the client.
+//
+// 16 bit mode (DUC sample size 16 in the DUC specific packet): packets hold the same 240 samples
+// in 2 byte values. They are widened to 24 bits as they are swapped, so the frames written to
+// the FPGA, and the FIFO accounting, are the same as for 24 bit packets.
+//
+// EER mode: the swap kernel also computes the envelope of each sample, and writes it after
+// the I/Q sample, in the same pass. The frames written are twice the size, and the FPGA
+// reads them at twice the rate.
+//
+// reorder mode (DUCReorderSettings.Depth != 0): packets go through a reorder buffer, so
+// packets reordered by the network are written in sequence, and lost ones are concealed.
+// everything waiting is received at once, as in batched mode.
+//
 void *IncomingDUCIQ(void *arg)                          // listener thread
 {
     struct ThreadSocketData *ThreadData;                  // socket etc data for this thread
-    struct sockaddr_in addr_from;                         // holds MAC address of source of incoming messages
-    uint8_t UDPInBuffer[VDUCIQSIZE];                      // incoming buffer
-    struct iovec iovecinst;                               // iovcnt buffer - 1 for each outgoing buffer
-    struct msghdr datagram;                               // multiple incoming message header
+    struct sockaddr_in addr_from[VDUCMAXBATCH];           // holds MAC address of source of incoming messages
+    uint8_t UDPInBuffer[VDUCMAXBATCH][VDUCIQSIZE];        // incoming buffers
+    struct iovec iovecinst[VDUCMAXBATCH];                 // iovcnt buffer - 1 for each incoming buffer
+    struct mmsghdr datagrams[VDUCMAXBATCH];               // multiple incoming message headers
     int size;                                             // UDP datagram length
+    int Received;                                         // datagrams received by recvmmsg
+    struct timespec LoopStart;                            // time packet processing started, for metrics
+    int Cntr;
+    struct DUCFrameContext DUC;                           // where frames are put
+    struct PacketReorder Reorder;                         // reorder buffer, if used
 
                                                           //
 // variables for DMA buffer 
@@ -63,121 +336,181 @@ void *IncomingDUCIQ(void *arg)                          // listener thread
     uint8_t* IQWriteBuffer = NULL;							// data for DMA to write to DUC
     uint32_t IQBufferSize = VDMABUFFERSIZE;
     unsigned char* IQBasePtr;								// ptr to DMA location in I/Q memory
-    uint32_t Depth = 0;
     int DMAWritefile_fd = -1;								// DMA read file device
-    bool FIFOOverflow, FIFOUnderflow, FIFOOverThreshold;
-    uint32_t Cntr;                                          // sample counter
-    uint8_t* SrcPtr;                                        // pointer to data from Thetis
-    uint8_t* DestPtr;                                       // pointer to DMA buffer data
-    unsigned int Current;                                   // current occupied locations in FIFO
-    unsigned int StartupCount;                              // used to delay reporting of under & overflows
     bool PrevSDRActive = false;                             // used to detect change of state
+    bool PrevTXMode = false;                                // used to detect MOX
+    struct RadioState State;                                // radio state snapshot, refreshed once per pass
+    uint32_t StateVersion = 0;
+    uint32_t BatchSize;                                     // most packets to receive at once
+    int PacketSize;                                         // expected packet size for the DUC sample size
 
     ThreadData = (struct ThreadSocketData *)arg;
     ThreadData->Active = true;
     printf("spinning up DUC I/Q thread with port %d, pid=%ld\n", ThreadData->Portid, syscall(SYS_gettid));
+    BatchSize = UseDUCBatching ? VDUCMAXBATCH : 1;
+    if(DUCJitterLatency != 0)
+    {
+        DUCJitterRing = AllocateDMABuffer(VDUCJITTERFRAMES * VDMATRANSFERSIZE, "DUC jitter buffer");
+        if(!DUCJitterRing)
+            printf("DUC jitter buffer allocation failed: not used\n");
+        else
+            MetricsAddBufferBytes(eDUCMetrics, VDUCJITTERFRAMES * VDMATRANSFERSIZE);
+        DUCJitterFrames = VDUCJITTERFRAMES;
+        SetDUCJitterTarget();
+        DUCJitterWrite = 0;
+        DUCJitterRead = 0;
+        DUCJitterPrefill = true;
+        BatchSize = VDUCMAXBATCH;                           // take everything waiting
+        printf("DUC jitter buffer target = %d frames (%dms)\n", DUCJitterTarget, DUCJitterLatency);
+    }
   
     //
     // setup DMA buffer
     //
-    posix_memalign((void**)&IQWriteBuffer, VALIGNMENT, IQBufferSize);
+    IQWriteBuffer = AllocateDMABuffer(IQBufferSize, "DUC I/Q");
     if (!IQWriteBuffer)
         printf("I/Q TX write buffer allocation failed\n");
+    else
+        MetricsAddBufferBytes(eDUCMetrics, IQBufferSize);
     IQBasePtr = IQWriteBuffer + VBASE;
-    memset(IQWriteBuffer, 0, IQBufferSize);
 
     //
     // open DMA device driver
     // opened write only to accommodate potential use of a different XDMA device driver
     //
-    DMAWritefile_fd = open(VDUCDMADEVICE, O_WRONLY);
+    DMAWritefile_fd = OpenDMADevice(VDUCDMADEVICE, O_WRONLY);
     if (DMAWritefile_fd < 0)
         printf("XDMA write device open failed for TX I/Q data\n");
+    memset(&DUC, 0, sizeof(DUC));
+    DUC.IQBasePtr = IQBasePtr;
+    DUC.DMAWritefile_fd = DMAWritefile_fd;
+    if(InitialiseReorder(&Reorder, &DUCReorderSettings, VDUCIQSIZE - 4, 1000000 / VDUCFRAMESPERSEC,
+                         eDUCMetrics, AddDUCFrame, &DUC))
+        BatchSize = VDUCMAXBATCH;                           // take everything waiting
         
 //
 // setup hardware
 //
     EnableDUCMux(false);                                  // disable temporarily
-    SetTXIQDeinterleaved(false);                          // not interleaved (at least for now!)
+    SetTXIQDeinterleaved(false);                          // not interleaved until EER mode is set
     ResetDUCMux();                                        // reset 64 to 48 mux
     ResetDMAStreamFIFO(eTXDUCDMA);
-    SetupFIFOMonitorChannel(eTXDUCDMA, false);
+    if(UseFIFOInterrupts)
+        DUCEvent_fd = OpenFIFOMonitorEvents(eTXDUCDMA);
+    SetupFIFOMonitorChannel(eTXDUCDMA, (DUCEvent_fd >= 0));         // interrupt on under/overflow if used
     EnableDUCMux(true);                                   // enable operation
 
+    memset(iovecinst, 0, sizeof(iovecinst));
+    memset(datagrams, 0, sizeof(datagrams));
+    for (Cntr = 0; Cntr < VDUCMAXBATCH; Cntr++)
+    {
+        iovecinst[Cntr].iov_base = UDPInBuffer[Cntr];     // set buffer for incoming message number i
+        iovecinst[Cntr].iov_len = VDUCIQSIZE;
+        datagrams[Cntr].msg_hdr.msg_iov = &iovecinst[Cntr];
+        datagrams[Cntr].msg_hdr.msg_iovlen = 1;
+        datagrams[Cntr].msg_hdr.msg_name = &addr_from[Cntr];
+    }
+
   //
   // main processing loop
   //
-    while(1)
+    while(!ThreadStopRequested())
     {
-        if(SDRActive & !PrevSDRActive)                      // detect SDRActive has been asserted
-            StartupCount = VSTARTUPDELAY;
-        PrevSDRActive = SDRActive;
-
-        memset(&iovecinst, 0, sizeof(struct iovec));
-        memset(&datagram, 0, sizeof(datagram));
-        iovecinst.iov_base = &UDPInBuffer;                  // set buffer for incoming message number i
-        iovecinst.iov_len = VDUCIQSIZE;
-        datagram.msg_iov = &iovecinst;
-        datagram.msg_iovlen = 1;
-        datagram.msg_name = &addr_from;
-        datagram.msg_namelen = sizeof(addr_from);
-        size = recvmsg(ThreadData->Socketid, &datagram, 0);         // get one message. If it times out, ges size=-1
-        if(size < 0 && errno != EAGAIN)
+        RefreshRadioState(&State, &StateVersion);
+        if(State.SDRActive && !PrevSDRActive)                        // detect SDRActive has been asserted
         {
-            perror("recvfrom fail, TX I/Q data");
-            return NULL;
+            DUCStartupCount = VSTARTUPDELAY;
+            if(UseDUCBatching && (GDUCDMAWrites != 0))
+                printf("DUC packets written = %llu, average per DMA write = %.2f\n",
+                       (unsigned long long)GDUCPacketsWritten, (double)GDUCPacketsWritten / GDUCDMAWrites);
+            GDUCPacketsWritten = 0;
+            GDUCDMAWrites = 0;
         }
-        if(size == VDUCIQSIZE)
+        PrevSDRActive = State.SDRActive;
+        if((__atomic_load_n(&DUCEERRequested, __ATOMIC_RELAXED) != DUCEERActive) && !State.TXMode)
+            SetDUCEERActive(!DUCEERActive);
+        //
+        // MOX: prefill the jitter buffer before writing. End of MOX: report it
+        //
+        if(DUCJitterRing && (State.TXMode != PrevTXMode))
         {
-            if(StartupCount != 0)                                   // decrement startup message count
-                StartupCount--;
-            NewMessageReceived = true;
-            Depth = ReadFIFOMonitorChannel(eTXDUCDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);           // read the FIFO free locations
-            if((StartupCount == 0) && FIFOOverThreshold && UseDebug)
-                printf("TX DUC FIFO Overthreshold, depth now = %d\n", Current);
-
-            if((StartupCount == 0) && FIFOUnderflow)
+            if(State.TXMode)
+                DUCJitterPrefill = true;
+            else
             {
-                GlobalFIFOOverflows |= 0b00000100;
-                if(UseDebug)
-                    printf("TX DUC FIFO Underflowed, depth now = %d\n", Current);
+                printf("DUC jitter buffer: depth = %d frames, max = %d, underflows = %d, overflows = %d\n",
+                       DUCJitterWrite - DUCJitterRead, GDUCJitterMaxDepth, GDUCJitterUnderflows, GDUCJitterOverflows);
+                GDUCJitterUnderflows = 0;
+                GDUCJitterOverflows = 0;
+                GDUCJitterMaxDepth = 0;
             }
+            PrevTXMode = State.TXMode;
+        }
 
-            while (Depth < VMEMWORDSPERFRAME)       // loop till space available
-            {
-                usleep(500);								                    // 0.5ms wait
-                Depth = ReadFIFOMonitorChannel(eTXDUCDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);       // read the FIFO free locations
-                if((StartupCount == 0) && FIFOOverThreshold && UseDebug)
-                    printf("TX DUC FIFO Overthreshold, depth now = %d\n", Current);
-                if((StartupCount == 0) && FIFOUnderflow)
-                {
-                    GlobalFIFOOverflows |= 0b00000100;
-                    if(UseDebug)
-                        printf("TX DUC FIFO Underflowed, depth now = %d\n", Current);
-                }
-            }
-            // copy data from UDP Buffer & DMA write it
-//            memcpy(IQBasePtr, UDPInBuffer + 4, VDMATRANSFERSIZE);                // copy out I/Q samples
-            // need to swap I & Q samples on replay
-            SrcPtr = (uint8_t *) (UDPInBuffer + 4);
-            DestPtr = (uint8_t *) IQBasePtr;
-            for (Cntr=0; Cntr < VIQSAMPLESPERFRAME; Cntr++)                     // samplecounter
+        if(__atomic_load_n(&GDUCSampleSize, __ATOMIC_RELAXED) == 16)
+        {
+            PacketSize = VDUCIQ16SIZE;
+            DUC.SwapKernel = WidenSwapIQSamples16;
+            DUC.EERKernel = EERWidenSwapIQSamples16;
+        }
+        else
+        {
+            PacketSize = VDUCIQSIZE;
+            DUC.SwapKernel = SwapIQSamples;
+            DUC.EERKernel = EERSwapIQSamples;
+        }
+        for (Cntr = 0; Cntr < (int)BatchSize; Cntr++)
+            datagrams[Cntr].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        //
+        // get messages: wait for one (it times out) then take any more already waiting
+        //
+        Received = recvmmsg(ThreadData->Socketid, datagrams, BatchSize, MSG_WAITFORONE, NULL);
+        if(Received < 0 && errno != EAGAIN)
+        {
+            perror("recvfrom fail, TX I/Q data");
+            return NULL;
+        }
+        if(Received > 0)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &LoopStart);
+            MetricsCountPackets(eDUCMetrics, Received);
+        }
+        //
+        // copy data from UDP Buffers & DMA write it
+        //
+        DUC.Frames = 0;
+        for (Cntr = 0; Cntr < Received; Cntr++)
+        {
+            size = datagrams[Cntr].msg_len;
+            if(size == PacketSize)
             {
-                *DestPtr++ = *(SrcPtr+3);                           // get I sample (3 bytes)
-                *DestPtr++ = *(SrcPtr+4);
-                *DestPtr++ = *(SrcPtr+5);
-                *DestPtr++ = *(SrcPtr+0);                           // get Q sample (3 bytes)
-                *DestPtr++ = *(SrcPtr+1);
-                *DestPtr++ = *(SrcPtr+2);
-                SrcPtr += 6;                                        // point at next source sample
+                MetricsCheckSequence(eDUCMetrics, ntohl(*(uint32_t*)UDPInBuffer[Cntr]));
+                if(DUCStartupCount != 0)                                // decrement startup message count
+                    DUCStartupCount--;
+                NoteMessageReceived();
+//                memcpy(IQBasePtr, UDPInBuffer + 4, VDMATRANSFERSIZE);                // copy out I/Q samples
+                // need to swap I & Q samples (and widen 16 bit samples) on replay
+                if(Reorder.Depth != 0)
+                    ReorderPacket(&Reorder, ntohl(*(uint32_t*)UDPInBuffer[Cntr]), UDPInBuffer[Cntr] + 4);
+                else
+                    AddDUCFrame(UDPInBuffer[Cntr] + 4, &DUC);
             }
-            DMAWriteToFPGA(DMAWritefile_fd, IQBasePtr, VDMATRANSFERSIZE, VADDRDUCSTREAMWRITE);
         }
+        if(Reorder.Depth != 0)
+            ServiceReorder(&Reorder);
+        if(DUCJitterRing)
+            WriteDUCJitterFrames(DMAWritefile_fd);
+        else if(DUC.Frames != 0)
+            WriteDUCFrames(DMAWritefile_fd, IQBasePtr, DUC.Frames);
+        if(Received > 0)
+            MetricsRecordLoopTime(eDUCMetrics, &LoopStart);
     }
 //
 // close down thread
 //
     close(ThreadData->Socketid);                  // close incoming data socket
+    if(DUCEvent_fd >= 0)
+        CloseUserIRQWaiter(DUCEvent_fd);
     ThreadData->Socketid = 0;
     ThreadData->Active = false;                   // indicate it is closed
     return NULL;
@@ -187,9 +520,30 @@ void *IncomingDUCIQ(void *arg)                          // listener thread
 //
 // HandlerSetEERMode (bool EEREnabled)
 // enables amplitude restoration mode. Generates envelope output alongside I/Q samples.
-// NOTE hardware does not properly support this yet!
-// TX FIFO must be empty. Stop multiplexer; set bit; restart
+// the DUC thread makes the change when not transmitting, as the TX FIFO must be empty
 // 
-void HandlerSetEERMode(__attribute__((unused)) bool EEREnabled)
+void HandlerSetEERMode(bool EEREnabled)
+{
+    __atomic_store_n(&DUCEERRequested, EEREnabled, __ATOMIC_RELAXED);
+}
+
+
+//
+// bool SetDUCEERDelay(const char* Value)
+// set the EER envelope delay, in samples, from a command line or config file string.
+// positive delays the envelope, negative delays the phase; applied when EER mode is next set
+//
+bool SetDUCEERDelay(const char* Value)
 {
+    char* End;
+    long Delay;
+
+    Delay = strtol(Value, &End, 0);
+    if((End == Value) || (*End != 0) || (Delay > VEERMAXDELAY) || (Delay < -VEERMAXDELAY))
+    {
+        printf("EER delay must be %d to %d samples: %s\n", -VEERMAXDELAY, VEERMAXDELAY, Value);
+        return false;
+    }
+    DUCEERDelay = (int32_t)Delay;
+    return true;
 }
\ No newline at end of file
@@ -23,6 +23,7 @@
 
 
 #define VDUCIQSIZE 1444                 // TX DUC I/Q data packet
+#define VDUCIQ16SIZE 964                // TX DUC I/Q data packet, 16 bit samples (same 240 samples)
 
 
 //
@@ -33,9 +34,17 @@ void *IncomingDUCIQ(void *arg);                 // listener thread
 //
 // HandlerSetEERMode (bool EEREnabled)
 // enables amplitude restoration mode. Generates envelope output alongside I/Q samples.
-// NOTE hardware does not properly support this yet!
-// TX FIFO must be empty. Stop multiplexer; set bit; restart
+// the DUC thread makes the change when not transmitting, as the TX FIFO must be empty
 // 
 void HandlerSetEERMode(bool EEREnabled);
 
+
+//
+// bool SetDUCEERDelay(const char* Value)
+// set the EER envelope delay in samples, from a command line or config file string.
+// positive delays the envelope, negative delays the phase; applied when EER mode is next set
+// returns true if successful
+//
+bool SetDUCEERDelay(const char* Value);
+
 #endif
\ No newline at end of file
@@ -24,135 +24,357 @@
 #include <stdio.h>
 #include <string.h>
 #include "../common/saturnregisters.h"
+#include "../common/saturndrivers.h"
 #include "../common/hwaccess.h"                   // low level access
 #include "../common/version.h"
+#include "../common/ringlog.h"
+#include "../common/regtrace.h"
 #include "cathandler.h"
 #include "AriesATU.h"
+#include "metrics.h"
+#include "standby.h"
 #include <pthread.h>
 #include <syscall.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 
 extern bool AriesATUActive;                             // true if Aries is operating
 
 
+//
+// keydown latency measurement: time from high priority packet arrival (kernel
+// receive timestamp) to the MOX bit being written to the GPIO register
+//
+#define VLATENCYSAMPLES 256                             // most recent keydowns kept
+
+static uint32_t KeydownLatency[VLATENCYSAMPLES];        // latency in microseconds
+static uint32_t KeydownCount = 0;                       // keydowns measured
+
+
+//
+// record keydown latency from packet arrival time to the time the MOX bit was written
+// (both CLOCK_REALTIME, the clock of SO_TIMESTAMPNS)
+//
+static void RecordKeydownLatency(const struct timespec* Arrival, const struct timespec* Keyed)
+{
+    int64_t Latency;
+
+    Latency = (int64_t)(Keyed->tv_sec - Arrival->tv_sec) * 1000000 + (Keyed->tv_nsec - Arrival->tv_nsec) / 1000;
+    if (Latency < 0)
+        Latency = 0;
+    KeydownLatency[KeydownCount % VLATENCYSAMPLES] = (uint32_t)Latency;
+    KeydownCount++;
+}
+
+
+static int CompareLatency(const void* A, const void* B)
+{
+    uint32_t X = *(const uint32_t*)A;
+    uint32_t Y = *(const uint32_t*)B;
+    return (X > Y) - (X < Y);
+}
+
+
+//
+// ReportKeydownLatency(void)
+// print p50 and p99 keydown latency over the most recent keydowns
+//
+static void ReportKeydownLatency(void)
+{
+    uint32_t Sorted[VLATENCYSAMPLES];
+    uint32_t Count;
+
+    Count = (KeydownCount < VLATENCYSAMPLES) ? KeydownCount : VLATENCYSAMPLES;
+    if (Count == 0)
+        return;
+    memcpy(Sorted, KeydownLatency, Count * sizeof(uint32_t));
+    qsort(Sorted, Count, sizeof(uint32_t), CompareLatency);
+    printf("keydown to GPIO write latency over %d keydowns: p50 = %dus, p99 = %dus, max = %dus\n",
+           Count, Sorted[Count / 2], Sorted[(Count * 99) / 100], Sorted[Count - 1]);
+}
+
+
+//
+// get the kernel receive timestamp of a packet; use the current time if none
+//
+static void GetArrivalTime(struct msghdr* Datagram, struct timespec* Arrival)
+{
+    struct cmsghdr* Cmsg;
+
+    for (Cmsg = CMSG_FIRSTHDR(Datagram); Cmsg != NULL; Cmsg = CMSG_NXTHDR(Datagram, Cmsg))
+    {
+        if ((Cmsg->cmsg_level == SOL_SOCKET) && (Cmsg->cmsg_type == SCM_TIMESTAMPNS))
+        {
+            memcpy(Arrival, CMSG_DATA(Cmsg), sizeof(struct timespec));
+            return;
+        }
+    }
+    clock_gettime(CLOCK_REALTIME, Arrival);
+}
+
+
+//
+// differential decode: each packet is compared with the previous one in 16 byte
+// chunks, and only the handlers for fields that have changed are called.
+//
+#define VHPCHUNKSIZE 16
+#define VHPCHUNKS ((VHIGHPRIOTIYTOSDRSIZE + VHPCHUNKSIZE - 1) / VHPCHUNKSIZE)
+
+static bool HPChangedChunks[VHPCHUNKS];                 // true if chunk differs from previous packet
+static bool HPDecodeAll;                                // true if every field to be decoded
+
+
+//
+// compare a packet with the previous one and find which chunks differ
+//
+static void FindChangedChunks(const uint8_t* New, const uint8_t* Old)
+{
+    uint32_t Chunk;
+    uint32_t Offset;
+
+    for (Chunk = 0; Chunk < VHIGHPRIOTIYTOSDRSIZE / VHPCHUNKSIZE; Chunk++)
+    {
+        Offset = Chunk * VHPCHUNKSIZE;
+#if defined(__ARM_NEON)
+        uint64x2_t Diff = vreinterpretq_u64_u8(veorq_u8(vld1q_u8(New + Offset), vld1q_u8(Old + Offset)));
+        HPChangedChunks[Chunk] = (vgetq_lane_u64(Diff, 0) | vgetq_lane_u64(Diff, 1)) != 0;
+#else
+        uint64_t A[2], B[2];
+        memcpy(A, New + Offset, VHPCHUNKSIZE);
+        memcpy(B, Old + Offset, VHPCHUNKSIZE);
+        HPChangedChunks[Chunk] = ((A[0] ^ B[0]) | (A[1] ^ B[1])) != 0;
+#endif
+    }
+    if (Chunk < VHPCHUNKS)                              // part chunk at the end
+    {
+        Offset = Chunk * VHPCHUNKSIZE;
+        HPChangedChunks[Chunk] = memcmp(New + Offset, Old + Offset, VHIGHPRIOTIYTOSDRSIZE - Offset) != 0;
+    }
+}
+
+
+//
+// true if a packet field has changed since the previous packet (or all fields to be decoded)
+//
+static bool FieldChanged(const uint8_t* New, const uint8_t* Old, uint32_t Offset, uint32_t Length)
+{
+    uint32_t Chunk;
+
+    if (HPDecodeAll)
+        return true;
+    for (Chunk = Offset / VHPCHUNKSIZE; Chunk <= (Offset + Length - 1) / VHPCHUNKSIZE; Chunk++)
+        if (HPChangedChunks[Chunk])
+            return memcmp(New + Offset, Old + Offset, Length) != 0;
+    return false;
+}
+
+
+//
+// handle the run and MOX bits (byte 4 of the high priority packet)
+// the MOX bit is written to the GPIO register before returning: SetMOX() is never
+// held, and the register queue returns once the write has been made, even if another
+// thread was draining it. The keydown time is taken when SetMOX() returns.
+//
+static void HandleRunAndMOX(uint8_t Byte, const struct timespec* Arrival)
+{
+    bool RunBit;                                        // true if "run" bit set
+    bool WasTXMode;
+    bool TXMode;
+    struct timespec Keyed;
+
+    WasTXMode = __atomic_load_n(&IsTXMode, __ATOMIC_RELAXED);
+    RunBit = (bool)(Byte&1);
+    if(RunBit)
+    {
+      StartBitReceived = true;
+      if(ReplyAddressSet && StartBitReceived)
+      {
+        if(!__atomic_load_n(&SDRActive, __ATOMIC_RELAXED))
+          NoteAttachRequest(Arrival);                           // timed to the 1st DDC packet
+        SetSDRActive(true);                                     // only set active if we have replay address too
+        SetTXEnable(true);
+      }
+    }
+    else
+    {
+      SetSDRActive(false);                                     // set state of whole app
+      SetTXEnable(false);
+      SetTXModeState(false);
+      SetMOX(false);
+      EnableCW(false, false);
+      printf("set to inactive by client app\n");
+      if(UseDebug)
+      {
+        ReportRegisterWriteStats();
+        ReportKeydownLatency();
+        ReportTurnaroundTimes();
+        ReportUserIRQStats();
+      }
+      REGTRACE_DUMP();                                         // register accesses, if compiled in
+      StartBitReceived = false;
+    }
+    //
+    // set TX or not TX
+    //
+    TXMode = (bool)(Byte&2);
+    SetTXModeState(TXMode);
+    SetMOX(TXMode);
+    if(TXMode && !WasTXMode)
+      clock_gettime(CLOCK_REALTIME, &Keyed);          // MOX bit now in the GPIO register
+    FlushRegisterUpdates();                           // don't hold TX/RX change for rest of packet
+    if(TXMode && !WasTXMode)
+      RecordKeydownLatency(Arrival, &Keyed);
+}
+
+
+
+//
+// state kept between high priority packets
+//
+static uint8_t PrevUDPInBuffer[VHIGHPRIOTIYTOSDRSIZE];  // previous packet processed
+static bool PrevPacketValid = false;                    // true if PrevUDPInBuffer holds a packet
+static bool PrevAriesATUActive = false;                 // Aries state when Alex words last set
+static bool HasAlexTXRegister;                          // true if V12+ firmware
+
+
+//
+// set up the high priority port before packets are dispatched to it
+// (the receive timestamps need a control message buffer of VHIGHPRIORITYCONTROLSIZE)
+//
+void InitialiseHighPriority(struct ThreadSocketData *ThreadData)
+{
+  int Enable = 1;
+
+  HasAlexTXRegister = GetFPGACapabilities()->HasAlexTXRegister;
+  if(setsockopt(ThreadData->Socketid, SOL_SOCKET, SO_TIMESTAMPNS, &Enable, sizeof(Enable)) < 0)
+    perror("high priority SO_TIMESTAMPNS");
+}
+
 
 //
-// listener thread for incoming high priority packets
+// handler for incoming high priority packets, called by the inbound dispatcher
 //
-void *IncomingHighPriority(void *arg)                   // listener thread
+void HandleHighPriorityPacket(uint8_t* UDPInBuffer, int size, struct msghdr* Header)
 {
-  struct ThreadSocketData *ThreadData;                  // socket etc data for this thread
-  struct sockaddr_in addr_from;                         // holds MAC address of source of incoming messages
-  uint8_t UDPInBuffer[VHIGHPRIOTIYTOSDRSIZE];           // incoming buffer
-  struct iovec iovecinst;                               // iovcnt buffer - 1 for each outgoing buffer
-  struct msghdr datagram;                               // multiple incoming message header
-  int size;                                             // UDP datagram length
-  bool RunBit;                                          // true if "run" bit set
+  struct timespec Arrival;                              // packet arrival time
   uint8_t Byte, Byte2;                                  // received dat being decoded
   uint32_t LongWord;
+  uint32_t DDCFreqs[VNUMDDC];                           // changed DDC delta phases
+  uint32_t DDCFreqMask;                                 // bit N set = DDC N changed
   uint16_t Word;
   int i;                                                // counter
-  ESoftwareID FPGASWID;                                 // preprod/release etc
-  unsigned int FPGAVersion;                             // firmware version
-
-
-  ThreadData = (struct ThreadSocketData *)arg;
-  ThreadData->Active = true;
-  printf("spinning up high priority incoming thread with port %d, pid=%ld\n", ThreadData->Portid, syscall(SYS_gettid));
-  FPGAVersion = GetFirmwareVersion(&FPGASWID);          // get version of FPGA code
-
-  //
-  // main processing loop
-  //
-  while(1)
-  {
-    memset(&iovecinst, 0, sizeof(struct iovec));
-    memset(&datagram, 0, sizeof(datagram));
-    iovecinst.iov_base = &UDPInBuffer;                  // set buffer for incoming message number i
-    iovecinst.iov_len = VHIGHPRIOTIYTOSDRSIZE;
-    datagram.msg_iov = &iovecinst;
-    datagram.msg_iovlen = 1;
-    datagram.msg_name = &addr_from;
-    datagram.msg_namelen = sizeof(addr_from);
-    size = recvmsg(ThreadData->Socketid, &datagram, 0);         // get one message. If it times out, ges size=-1
-    if(size < 0 && errno != EAGAIN)
-    {
-      perror("recvfrom, high priority");
-      printf("error number = %d\n", errno);
-      EXIT_FAILURE;
-    }
 
     //
     // if correct packet, process it
     //
     if(size == VHIGHPRIOTIYTOSDRSIZE)
     {
-      NewMessageReceived = true;
-      LongWord = ntohl(*(uint32_t *)(UDPInBuffer));
-      printf("high priority packet received\n");
-      Byte = (uint8_t)(UDPInBuffer[4]);
-      RunBit = (bool)(Byte&1);
-      if(RunBit)
-      {
-        StartBitReceived = true;
-        if(ReplyAddressSet && StartBitReceived)
-        {
-          SDRActive = true;                                       // only set active if we have replay address too
-          SetTXEnable(true);
-        }
-      }
-      else
+      NoteMessageReceived();
+      GetArrivalTime(Header, &Arrival);
+      MetricsCountPackets(eHPMetrics, 1);
+      MetricsCheckSequence(eHPMetrics, ntohl(*(uint32_t*)UDPInBuffer));
+      //
+      // CWX fast path: host generated CW timing matters most, so the CWX bits are
+      // written to the keyer before anything else in the packet is looked at.
+      // the previous packet's copy is updated so the decode below sees no change
+      //
+      if(!PrevPacketValid || (UDPInBuffer[5] != PrevUDPInBuffer[5]))
       {
-        SDRActive = false;                                       // set state of whole app
-        SetTXEnable(false);
-        IsTXMode = false;
-        SetMOX(false);
-        EnableCW(false, false);
-        printf("set to inactive by client app\n");
-        StartBitReceived = false;
+        Byte = (uint8_t)(UDPInBuffer[5]);      // CWX
+        SetCWXBits((bool)(Byte & 1), (bool)((Byte>>2) & 1), (bool)((Byte>>1) & 1));    // enabled, dash, dot
+        PrevUDPInBuffer[5] = Byte;
       }
       //
-      // set TX or not TX
+      // find what has changed since the previous packet. Decode everything
+      // for the first packet, and when the run bit changes.
+      //
+      HPDecodeAll = !PrevPacketValid || ((UDPInBuffer[4] ^ PrevUDPInBuffer[4]) & 1);
+      if(!HPDecodeAll)
+        FindChangedChunks(UDPInBuffer, PrevUDPInBuffer);
+      //
+      // fast path: if only the run/MOX byte has changed since the last packet,
+      // (ignoring the sequence number and the CWX byte, already handled) just handle that
       //
-      IsTXMode = (bool)(Byte&2);
-      SetMOX(IsTXMode);
+      if(!HPDecodeAll && (UDPInBuffer[4] != PrevUDPInBuffer[4])
+         && !FieldChanged(UDPInBuffer, PrevUDPInBuffer, 5, VHIGHPRIOTIYTOSDRSIZE-5))
+      {
+        HandleRunAndMOX(UDPInBuffer[4], &Arrival);
+        PrevUDPInBuffer[4] = UDPInBuffer[4];
+        return;
+      }
+
+      LongWord = ntohl(*(uint32_t *)(UDPInBuffer));
+      if(UseDebug)
+        RINGLOG("high priority packet received\n");
+      BeginRegisterUpdates();                           // merge register writes: one bus write per register
+      HandleRunAndMOX(UDPInBuffer[4], &Arrival);
 
 //
 // now properly decode DDC frequencies
+// all changed DDCs are set together, so a coordinated retune changes them within a burst
 //
+      DDCFreqMask = 0;
       for (i=0; i<VNUMDDC; i++)
       {
-        LongWord = ntohl(*(uint32_t *)(UDPInBuffer+i*4+9));
-        SetDDCFrequency(i, LongWord, true);                   // temporarily set above
+        if(FieldChanged(UDPInBuffer, PrevUDPInBuffer, i*4+9, 4))
+        {
+          DDCFreqs[i] = ntohl(*(uint32_t *)(UDPInBuffer+i*4+9));
+          DDCFreqMask |= (1U << i);
+        }
       }
+      if(DDCFreqMask != 0)
+        SetDDCFrequencies(DDCFreqs, DDCFreqMask, true);
       //
       // DUC frequency & drive level
       //
-      LongWord = ntohl(*(uint32_t *)(UDPInBuffer+329));
-      SetDUCFrequency(LongWord, true);
-      SetAriesTXFrequency(LongWord);
-      Byte = (uint8_t)(UDPInBuffer[345]);
-      SetTXDriveLevel(Byte);
+      if(FieldChanged(UDPInBuffer, PrevUDPInBuffer, 329, 4))
+      {
+        LongWord = ntohl(*(uint32_t *)(UDPInBuffer+329));
+        SetDUCFrequency(LongWord, true);
+        SetAriesTXFrequency(LongWord);
+      }
+      if(FieldChanged(UDPInBuffer, PrevUDPInBuffer, 345, 1))
+      {
+        Byte = (uint8_t)(UDPInBuffer[345]);
+        SetTXDriveLevel(Byte);
+      }
       //
       // create CAT port (if set)
       // shut down CAT port if not set and the CAT thread is active
       //
-      Word = ntohs(*(uint16_t *)(UDPInBuffer+1398));
-      if(Word != 0)
-        SetupCATPort(Word);
-      else if (Word == 0 && CATPortAssigned)
-        ShutdownCATHandler();
+      if(FieldChanged(UDPInBuffer, PrevUDPInBuffer, 1398, 2))
+      {
+        Word = ntohs(*(uint16_t *)(UDPInBuffer+1398));
+        if(Word != 0)
+          SetupCATPort(Word);
+        else
+          ShutdownCATHandler();                     // (also stops a handler waiting to reconnect)
+      }
       //
       // transverter, speaker mute, open collector, user outputs
       // open collector data is in bits 7:1; move to 6:0
       //
-      Byte = (uint8_t)(UDPInBuffer[1400]);
-      SetXvtrEnable((bool)(Byte&1));
-      SetSpkrMute((bool)((Byte>>1)&1));
-      Byte = (uint8_t)(UDPInBuffer[1401]);
-      SetOpenCollectorOutputs(Byte >> 1);
-      Byte = (uint8_t)(UDPInBuffer[1402]);
-      SetUserOutputBits(Byte);
+      if(FieldChanged(UDPInBuffer, PrevUDPInBuffer, 1400, 1))
+      {
+        Byte = (uint8_t)(UDPInBuffer[1400]);
+        SetXvtrEnable((bool)(Byte&1));
+        SetSpkrMute((bool)((Byte>>1)&1));
+      }
+      if(FieldChanged(UDPInBuffer, PrevUDPInBuffer, 1401, 1))
+      {
+        Byte = (uint8_t)(UDPInBuffer[1401]);
+        SetOpenCollectorOutputs(Byte >> 1);
+      }
+      if(FieldChanged(UDPInBuffer, PrevUDPInBuffer, 1402, 1))
+      {
+        Byte = (uint8_t)(UDPInBuffer[1402]);
+        SetUserOutputBits(Byte);
+      }
       //
       // Alex
       // behaviour needs to be FPGA version specific: at V12, separate register added for Alex TX antennas
@@ -162,68 +384,65 @@ void *IncomingHighPriority(void *arg)                   // listener thread
       // 1st read bytes and see if a TX ant bit is set
       // Aries will only work with newer FPGA and client app support
       //
-      Word = ntohs(*(uint16_t *)(UDPInBuffer+1428));
-      //printf("Alex 1 TX word = 0x%x\n", Word);
-      Word = (Word >> 8) & 0x0007;                          // new data TX ant bits. if not set, must be legacy client app
-      
-      if((FPGAVersion >= 12) && (Word != 0))                // if new firmware && client app supports it
-      {
-        //printf("new FPGA code, new client data\n");
-        Word = ntohs(*(uint16_t *)(UDPInBuffer+1428));      // copy word with TX ant settings to filt/TXant register
-        SetAriesAlexTXWord(Word);
-        if(AriesATUActive)                                  // if Aries active, set TX antenna to 1
-          Word = (Word & 0xF8FF) | 0x0100;
-        AlexManualTXFilters(Word, true);
-        Word = ntohs(*(uint16_t *)(UDPInBuffer+1432));      // copy word with RX ant settings to filt/RXant register
-        //printf("Alex 0 TX word = 0x%x\n", Word);
-        SetAriesAlexRXWord(Word);
-        if(AriesATUActive)                                  // if Aries active, set RX antenna to 1
-          Word = (Word & 0xF8FF) | 0x0100;
-        AlexManualTXFilters(Word, false);
-      }
-      else if(FPGAVersion >= 12)                            // new hardware but no client app support
+      if(FieldChanged(UDPInBuffer, PrevUDPInBuffer, 1428, 8) || (AriesATUActive != PrevAriesATUActive))
       {
-        //printf("new FPGA code, new client data\n");
-        Word = ntohs(*(uint16_t *)(UDPInBuffer+1432));      // copy word with TX/RX ant settings to both registers
-        AlexManualTXFilters(Word, true);
-        AlexManualTXFilters(Word, false);
-      }
-      else                                                  // old FPGA hardware
-      {
-        //printf("old FPGA code\n");
-        Word = ntohs(*(uint16_t *)(UDPInBuffer+1432));      // copy word with TX/RX ant settings to original register
-        AlexManualTXFilters(Word, false);
-      }
+        PrevAriesATUActive = AriesATUActive;
+        Word = ntohs(*(uint16_t *)(UDPInBuffer+1428));
+        //printf("Alex 1 TX word = 0x%x\n", Word);
+        Word = (Word >> 8) & 0x0007;                          // new data TX ant bits. if not set, must be legacy client app
+
+        if(HasAlexTXRegister && (Word != 0))                // if new firmware && client app supports it
+        {
+          //printf("new FPGA code, new client data\n");
+          Word = ntohs(*(uint16_t *)(UDPInBuffer+1428));      // copy word with TX ant settings to filt/TXant register
+          SetAriesAlexTXWord(Word);
+          if(AriesATUActive)                                  // if Aries active, set TX antenna to 1
+            Word = (Word & 0xF8FF) | 0x0100;
+          AlexManualTXFilters(Word, true);
+          Word = ntohs(*(uint16_t *)(UDPInBuffer+1432));      // copy word with RX ant settings to filt/RXant register
+          //printf("Alex 0 TX word = 0x%x\n", Word);
+          SetAriesAlexRXWord(Word);
+          if(AriesATUActive)                                  // if Aries active, set RX antenna to 1
+            Word = (Word & 0xF8FF) | 0x0100;
+          AlexManualTXFilters(Word, false);
+        }
+        else if(HasAlexTXRegister)                            // new hardware but no client app support
+        {
+          //printf("new FPGA code, new client data\n");
+          Word = ntohs(*(uint16_t *)(UDPInBuffer+1432));      // copy word with TX/RX ant settings to both registers
+          AlexManualTXFilters(Word, true);
+          AlexManualTXFilters(Word, false);
+        }
+        else                                                  // old FPGA hardware
+        {
+          //printf("old FPGA code\n");
+          Word = ntohs(*(uint16_t *)(UDPInBuffer+1432));      // copy word with TX/RX ant settings to original register
+          AlexManualTXFilters(Word, false);
+        }
 
-      // RX filters
-      Word = ntohs(*(uint16_t *)(UDPInBuffer+1430));
-      AlexManualRXFilters(Word, 2);
-      //printf("Alex 1 RX word = 0x%x\n", Word);
-      Word = ntohs(*(uint16_t *)(UDPInBuffer+1434));
-      AlexManualRXFilters(Word, 0);
-      //printf("Alex 0 RX word = 0x%x\n", Word);
+        // RX filters
+        Word = ntohs(*(uint16_t *)(UDPInBuffer+1430));
+        AlexManualRXFilters(Word, 2);
+        //printf("Alex 1 RX word = 0x%x\n", Word);
+        Word = ntohs(*(uint16_t *)(UDPInBuffer+1434));
+        AlexManualRXFilters(Word, 0);
+        //printf("Alex 0 RX word = 0x%x\n", Word);
+      }
       //
       // RX atten during TX and RX
       // this should be just on RX now, because TX settings are in the DUC specific packet bytes 58&59
       //
-      Byte2 = (uint8_t)(UDPInBuffer[1442]);     // RX2 atten
-      Byte = (uint8_t)(UDPInBuffer[1443]);      // RX1 atten
-      SetADCAttenuator(eADC1, Byte, true, false);
-      SetADCAttenuator(eADC2, Byte2, true, false);
-      //
-      // CWX bits
-      //
-      Byte = (uint8_t)(UDPInBuffer[5]);      // CWX
-      SetCWXBits((bool)(Byte & 1), (bool)((Byte>>2) & 1), (bool)((Byte>>1) & 1));    // enabled, dash, dot
+      if(FieldChanged(UDPInBuffer, PrevUDPInBuffer, 1442, 2))
+      {
+        Byte2 = (uint8_t)(UDPInBuffer[1442]);     // RX2 atten
+        Byte = (uint8_t)(UDPInBuffer[1443]);      // RX1 atten
+        SetADCAttenuator(eADC1, Byte, true, false);
+        SetADCAttenuator(eADC2, Byte2, true, false);
+      }
+      EndRegisterUpdates();
+      memcpy(PrevUDPInBuffer, UDPInBuffer, VHIGHPRIOTIYTOSDRSIZE);
+      PrevPacketValid = true;
     }
-  }
-//
-// close down thread
-//
-  close(ThreadData->Socketid);                  // close incoming data socket
-  ThreadData->Socketid = 0;
-  ThreadData->Active = false;                   // indicate it is closed
-  return NULL;
 }
 
 
@@ -20,15 +20,25 @@
 
 #include <stdint.h>
 #include "../common/saturntypes.h"
+#include <sys/socket.h>
+#include <time.h>
+#include "threaddata.h"
 
 
 #define VHIGHPRIOTIYTOSDRSIZE 1444      // high priority packet to SDR
+#define VHIGHPRIORITYCONTROLSIZE CMSG_SPACE(sizeof(struct timespec))    // receive timestamp control message
 
 
+//
+// set up the high priority port, before packets are dispatched to it
+//
+void InitialiseHighPriority(struct ThreadSocketData *ThreadData);
+
 //
 // protocol 2 handler for incoming high priority Packet to SDR
+// called by the inbound dispatcher for each packet received
 //
-void *IncomingHighPriority(void *arg);          // listener thread
+void HandleHighPriorityPacket(uint8_t* UDPInBuffer, int size, struct msghdr* Header);
 
 
 #endif
\ No newline at end of file
@@ -17,6 +17,7 @@
 #include <stdint.h>
 #include "../common/saturntypes.h"
 #include "InSpkrAudio.h"
+#include "threadmanager.h"
 #include <errno.h>
 #include <fcntl.h>
 #include <stdlib.h>
@@ -29,16 +30,134 @@
 #include "../common/saturnregisters.h"
 #include "../common/saturndrivers.h"
 #include "../common/hwaccess.h"
+#include "../common/dmapool.h"
+#include "../common/ringlog.h"
+#include "../common/audioresample.h"
+#include "metrics.h"
+#include "packetreorder.h"
 
 
 #define VSPKSAMPLESPERFRAME 64                      // samples per UDP frame
 #define VMEMWORDSPERFRAME 32                        // 8 byte writes per UDP msg
 #define VSPKSAMPLESPERMEMWORD 2                     // 2 samples (each 4 bytres) per 8 byte word
 #define VDMABUFFERSIZE 32768						// memory buffer to reserve
-#define VALIGNMENT 4096                             // buffer alignment
 #define VBASE 0x1000								// DMA start at 4K into buffer
 #define VDMATRANSFERSIZE 256                        // write 1 message at a time
 #define VSTARTUPDELAY 100                           // 100 messages (~100ms) before reporting under or overflows
+#define VSPKDRAINRATE 24000                         // 64 bit words/s the codec reads: 48KHz / 2 samples per word
+#define VSPKMAXBATCH 16                             // most packets received in one recvmmsg() call
+#define VSPKMAXCOALESCE 32                          // most packets in one DMA (must fit in DMA buffer above VBASE)
+#define VSPKMAXSTAGED ((VDMABUFFERSIZE - VBASE) / 4)    // most resampled samples held in the DMA buffer
+#define VSPKMAXRESAMPLELATENCY 100                  // largest resampler FIFO target, ms
+
+
+uint64_t GSpkPacketsWritten = 0;                    // speaker packets written to the FPGA
+uint64_t GSpkDMAWrites = 0;                         // DMA writes used to write them
+
+
+//
+// DMA write the speaker samples gathered in the DMA buffer
+// wait till space available. The wait is timed from the codec rate,
+// and ended early by a FIFO monitor interrupt if interrupts are enabled
+// returns the FIFO occupied locations before the write; Underflowed set if it had underflowed
+//
+static unsigned int WriteSpkData(int DMAWritefile_fd, int SpkEvent_fd, uint8_t* SpkBasePtr, uint32_t Bytes,
+                                 uint32_t Frames, unsigned int StartupCount, bool* Underflowed)
+{
+    bool FIFOOverflow, FIFOUnderflow, FIFOOverThreshold;
+    unsigned int Current;                                   // current occupied locations in FIFO
+
+    WaitFIFOMonitorSpace(eSpkCodecDMA, SpkEvent_fd, Bytes / 8, VSPKDRAINRATE,
+                         &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);        // read the FIFO free locations
+    if((StartupCount == 0) && FIFOOverThreshold)
+    {
+        MetricsCountOverThreshold(eSpkMetrics);
+        if(UseDebug)
+            RINGLOG("Codec speaker FIFO Overthreshold, depth now = %d\n", Current);
+    }
+    if((StartupCount == 0) && FIFOUnderflow)
+    {
+        __atomic_fetch_or(&GlobalFIFOOverflows, 0b00001000, __ATOMIC_RELAXED);
+        MetricsCountUnderflow(eSpkMetrics);
+        if(UseDebug)
+            RINGLOG("Codec speaker FIFO Underflowed, depth now = %d\n", Current);
+    }
+    *Underflowed = (StartupCount == 0) && FIFOUnderflow;
+//            printf("speaker packet received; depth = %d\n", Current);
+//        if(RegVal == 100)
+//            DumpMemoryBuffer(SpkBasePtr, VDMATRANSFERSIZE);
+    DMAWriteToFPGA(DMAWritefile_fd, SpkBasePtr, Bytes, VADDRSPKRSTREAMWRITE);
+    MetricsRecordDMA(eSpkMetrics, Bytes, Current);
+    GSpkPacketsWritten += Frames;
+    GSpkDMAWrites++;
+    return Current;
+}
+
+
+//
+// DMA write the speaker packets gathered in the DMA buffer
+//
+static void WriteSpkFrames(int DMAWritefile_fd, int SpkEvent_fd, uint8_t* SpkBasePtr, uint32_t Frames, unsigned int StartupCount)
+{
+    bool Underflowed;
+
+    WriteSpkData(DMAWritefile_fd, SpkEvent_fd, SpkBasePtr, Frames * VDMATRANSFERSIZE, Frames, StartupCount, &Underflowed);
+}
+
+
+//
+// the speaker write state, for AddSpkPacket()
+//
+struct SpkPacketContext
+{
+    uint8_t* SpkBasePtr;                                    // ptr to DMA location in spk memory
+    int DMAWritefile_fd;
+    int SpkEvent_fd;
+    unsigned int StartupCount;                              // used to delay reporting of under & overflows
+    uint32_t CoalesceFrames;                                // packets to gather per DMA
+    uint32_t Frames;                                        // packets gathered in the DMA buffer
+    bool Resampling;                                        // true if resampling mode
+    struct AudioResampler Resampler;                        // speaker resampler, if used
+    uint32_t Staged;                                        // resampled samples in the DMA buffer
+};
+
+
+//
+// add one packet's samples to the DMA buffer, and write it if enough are gathered.
+// called for each packet in sequence order: by the receive loop, or by the reorder buffer.
+//
+static void AddSpkPacket(const uint8_t* Samples, void* Context)
+{
+    struct SpkPacketContext* Spk = (struct SpkPacketContext*)Context;
+    bool FIFOOverflow, FIFOUnderflow, FIFOOverThreshold;
+    unsigned int Current;                                   // current occupied locations in FIFO
+
+    if(Spk->Resampling)
+    {
+        if(Spk->Staged + VSPKSAMPLESPERFRAME + 2 <= VSPKMAXSTAGED)
+            Spk->Staged += ResampleAudio(&Spk->Resampler, Spk->SpkBasePtr + Spk->Staged * 4, Samples, VSPKSAMPLESPERFRAME);
+        return;
+    }
+    // copy sata from UDP Buffer into the DMA buffer
+    memcpy(Spk->SpkBasePtr + Spk->Frames * VDMATRANSFERSIZE, Samples, VDMATRANSFERSIZE);              // copy out spk samples
+    Spk->Frames++;
+    //
+    // if enough packets gathered, or the FIFO is running low, DMA write them.
+    //
+    if(Spk->Frames < Spk->CoalesceFrames)
+    {
+        ReadFIFOMonitorChannel(eSpkCodecDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);
+        if((Spk->StartupCount == 0) && FIFOUnderflow)
+        {
+            __atomic_fetch_or(&GlobalFIFOOverflows, 0b00001000, __ATOMIC_RELAXED);
+            MetricsCountUnderflow(eSpkMetrics);
+        }
+        if(Current >= Spk->CoalesceFrames * VMEMWORDSPERFRAME)
+            return;
+    }
+    WriteSpkFrames(Spk->DMAWritefile_fd, Spk->SpkEvent_fd, Spk->SpkBasePtr, Spk->Frames, Spk->StartupCount);
+    Spk->Frames = 0;
+}
 
 
 //
@@ -47,123 +166,224 @@
 // if sufficient FIFO data available: DMA that data and transfer it out. 
 // if it turns out to be too inefficient, we'll have to try larger DMA.
 //
+// packets are received with recvmmsg(): wait for one, then take any others already waiting.
+// coalescing mode (SpkCoalesceTime != 0): packets are gathered in the DMA buffer
+// until there are SpkCoalesceTime ms of them, then written with one DMA.
+// they are written sooner if the codec FIFO holds less than that, so it never runs dry waiting,
+// or if no more packets arrive (so the end of the audio isn't held back).
+//
+// resampling mode (SpkResampleLatency != 0): each packet is resampled into the DMA buffer,
+// and everything received at once is written with one DMA. The resampler is steered by the
+// FIFO level after each write, so the FIFO is held at SpkResampleLatency ms however the
+// client's audio clock drifts from the codec's. Writes start (and restart after an underflow)
+// once that much audio is held.
+//
+// reorder mode (SpkReorderSettings.Depth != 0): packets go through a reorder buffer, so
+// packets reordered by the network are played in sequence, and lost ones are concealed.
+//
 void *IncomingSpkrAudio(void *arg)                      // listener thread
 {
     struct ThreadSocketData *ThreadData;                  // socket etc data for this thread
-    struct sockaddr_in addr_from;                         // holds MAC address of source of incoming messages
-    uint8_t UDPInBuffer[VSPEAKERAUDIOSIZE];               // incoming buffer
-    struct iovec iovecinst;                               // iovcnt buffer - 1 for each outgoing buffer
-    struct msghdr datagram;                               // multiple incoming message header
+    struct sockaddr_in addr_from[VSPKMAXBATCH];           // holds MAC address of source of incoming messages
+    uint8_t UDPInBuffer[VSPKMAXBATCH][VSPEAKERAUDIOSIZE]; // incoming buffers
+    struct iovec iovecinst[VSPKMAXBATCH];                 // iovcnt buffer - 1 for each incoming buffer
+    struct mmsghdr datagrams[VSPKMAXBATCH];               // multiple incoming message headers
     int size;                                             // UDP datagram length
+    int Received;                                         // datagrams received by recvmmsg
+    struct timespec LoopStart;                            // time packet processing started, for metrics
+    int Cntr;
 
 //
 // variables for DMA buffer 
 //
     uint8_t* SpkWriteBuffer = NULL;							// data for DMA to write to spkr
     uint32_t SpkBufferSize = VDMABUFFERSIZE;
-    unsigned char* SpkBasePtr;								// ptr to DMA location in spk memory
-    uint32_t Depth = 0;
-    int DMAWritefile_fd = -1;								// DMA read file device
-    bool FIFOOverflow, FIFOUnderflow, FIFOOverThreshold;
+    struct SpkPacketContext Spk;                            // DMA buffer, device and write state
+    struct PacketReorder Reorder;                           // reorder buffer, if used
     uint32_t RegVal;
     unsigned int Current;                                   // current occupied locations in FIFO
-    unsigned int StartupCount;                              // used to delay reporting of under & overflows
     bool PrevSDRActive = false;                             // used to detect change of state
+    bool Active;                                            // SDRActive, read once per pass
+    uint32_t ResampleTarget = 0;                            // FIFO level to hold, samples
+    uint32_t WriteSamples;                                  // resampled samples to write now
+    bool SpkPrefill = true;                                 // true if holding audio before writes (re)start
+    bool Underflowed;
+    uint32_t ResampleUnderflows = 0;
+    struct timespec LastSteer, Now;                         // time of the last resampler update
+    double Interval;
 
 
+    memset(&Spk, 0, sizeof(Spk));
+    Spk.DMAWritefile_fd = -1;
+    Spk.SpkEvent_fd = -1;
+    Spk.CoalesceFrames = 1;
     ThreadData = (struct ThreadSocketData *)arg;
     ThreadData->Active = true;
     printf("spinning up speaker audio thread with port %d, pid=%ld\n", ThreadData->Portid, syscall(SYS_gettid));
+    if(SpkCoalesceTime != 0)
+    {
+        Spk.CoalesceFrames = (SpkCoalesceTime * 48000) / (1000 * VSPKSAMPLESPERFRAME);
+        if(Spk.CoalesceFrames < 1)
+            Spk.CoalesceFrames = 1;
+        else if(Spk.CoalesceFrames > VSPKMAXCOALESCE)
+            Spk.CoalesceFrames = VSPKMAXCOALESCE;
+        printf("speaker audio: %d packets per DMA\n", Spk.CoalesceFrames);
+    }
+    if(SpkResampleLatency != 0)
+    {
+        if(SpkResampleLatency > VSPKMAXRESAMPLELATENCY)
+            SpkResampleLatency = VSPKMAXRESAMPLELATENCY;
+        Spk.Resampling = true;
+        ResampleTarget = SpkResampleLatency * 48;
+        InitialiseAudioResampler(&Spk.Resampler);
+        printf("speaker audio: resampled to hold the codec FIFO at %dms\n", SpkResampleLatency);
+    }
 
     //
     // setup DMA buffer
     //
-    posix_memalign((void**)&SpkWriteBuffer, VALIGNMENT, SpkBufferSize);
+    SpkWriteBuffer = AllocateDMABuffer(SpkBufferSize, "speaker");
     if (!SpkWriteBuffer)
         printf("spkr write buffer allocation failed\n");
-    SpkBasePtr = SpkWriteBuffer + VBASE;
-    memset(SpkWriteBuffer, 0, SpkBufferSize);
+    else
+        MetricsAddBufferBytes(eSpkMetrics, SpkBufferSize);
+    Spk.SpkBasePtr = SpkWriteBuffer + VBASE;
 
     //
     // open DMA device driver
     // opened write only to accommodate potential use of a different XDMA device driver
     //
-    DMAWritefile_fd = open(VSPKDMADEVICE, O_WRONLY);
-    if (DMAWritefile_fd < 0)
+    Spk.DMAWritefile_fd = OpenDMADevice(VSPKDMADEVICE, O_WRONLY);
+    if (Spk.DMAWritefile_fd < 0)
         printf("XDMA write device open failed for spk data\n");
+    else if(DMAPollWindow != 0)
+        SetDMAPollWindow(Spk.DMAWritefile_fd, DMAPollWindow);
     ResetDMAStreamFIFO(eSpkCodecDMA);
-    SetupFIFOMonitorChannel(eSpkCodecDMA, false);
+    if(UseFIFOInterrupts)
+        Spk.SpkEvent_fd = OpenFIFOMonitorEvents(eSpkCodecDMA);
+    SetupFIFOMonitorChannel(eSpkCodecDMA, (Spk.SpkEvent_fd >= 0));     // interrupt on under/overflow if used
+    InitialiseReorder(&Reorder, &SpkReorderSettings, VDMATRANSFERSIZE, (1000000 * VSPKSAMPLESPERFRAME) / 48000,
+                      eSpkMetrics, AddSpkPacket, &Spk);
+
+    memset(iovecinst, 0, sizeof(iovecinst));                    // clear buffers
+    memset(datagrams, 0, sizeof(datagrams));
+    for (Cntr = 0; Cntr < VSPKMAXBATCH; Cntr++)
+    {
+        iovecinst[Cntr].iov_base = UDPInBuffer[Cntr];           // set buffer for incoming message number i
+        iovecinst[Cntr].iov_len = VSPEAKERAUDIOSIZE;
+        datagrams[Cntr].msg_hdr.msg_iov = &iovecinst[Cntr];
+        datagrams[Cntr].msg_hdr.msg_iovlen = 1;
+        datagrams[Cntr].msg_hdr.msg_name = &addr_from[Cntr];
+    }
 
   //
   // main processing loop
   // modified to have the same structure as outgoing threads; capable of being stopped and started.
   //
-    while(1)
+    while(!ThreadStopRequested())
     {
         //
         // now released to start processing. Setup buffers.
         //
-        if(SDRActive & !PrevSDRActive)                      // detect SDRActive has been asserted
-            StartupCount = VSTARTUPDELAY;
-        PrevSDRActive = SDRActive;
-
-        memset(&iovecinst, 0, sizeof(struct iovec));            // clear buffers
-        memset(&datagram, 0, sizeof(datagram));
-        iovecinst.iov_base = &UDPInBuffer;                      // set buffer for incoming message number i
-        iovecinst.iov_len = VSPEAKERAUDIOSIZE;
-        datagram.msg_iov = &iovecinst;
-        datagram.msg_iovlen = 1;
-        datagram.msg_name = &addr_from;
-        datagram.msg_namelen = sizeof(addr_from);
+        Active = __atomic_load_n(&SDRActive, __ATOMIC_ACQUIRE);
+        if(Active && !PrevSDRActive)                        // detect SDRActive has been asserted
+        {
+            Spk.StartupCount = VSTARTUPDELAY;
+            if((Spk.CoalesceFrames > 1) && (GSpkDMAWrites != 0))
+                printf("speaker packets written = %llu, average per DMA = %.2f\n",
+                       (unsigned long long)GSpkPacketsWritten, (double)GSpkPacketsWritten / GSpkDMAWrites);
+            GSpkPacketsWritten = 0;
+            GSpkDMAWrites = 0;
+            if(Spk.Resampling)
+            {
+                if(UseDebug && Spk.Resampler.LevelValid)
+                    printf("speaker resampler: correction = %.1fppm, FIFO level = %.0f samples (target %d), underflows = %d\n",
+                           GetAudioResampleRatioPPM(&Spk.Resampler), Spk.Resampler.Level, ResampleTarget, ResampleUnderflows);
+                InitialiseAudioResampler(&Spk.Resampler);
+                Spk.Staged = 0;
+                SpkPrefill = true;
+                ResampleUnderflows = 0;
+            }
+        }
+        PrevSDRActive = Active;
+
+        for (Cntr = 0; Cntr < VSPKMAXBATCH; Cntr++)
+            datagrams[Cntr].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
         //
         // receive operation thread
+        // get messages: wait for one (if it times out, Received = -1) then take any more already waiting
         //
-        size = recvmsg(ThreadData->Socketid, &datagram, 0);     // get one message. If it times out, sets size=-1
-        if(size < 0 && errno != EAGAIN)
+        Received = recvmmsg(ThreadData->Socketid, datagrams, VSPKMAXBATCH, MSG_WAITFORONE, NULL);
+        if(Received < 0 && errno != EAGAIN)
         {
             perror("recvfrom fail, Speaker data");
             return NULL;
         }
-        if(size == VSPEAKERAUDIOSIZE)                           // we have received a packet!
+        if(Received > 0)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &LoopStart);
+            MetricsCountPackets(eSpkMetrics, Received);
+        }
+        for (Cntr = 0; Cntr < Received; Cntr++)
         {
-            if(StartupCount != 0)                                   // decrement startup message count
-                StartupCount--;
-            NewMessageReceived = true;
+            size = datagrams[Cntr].msg_len;
+            if(size != VSPEAKERAUDIOSIZE)                           // not a valid packet
+                continue;
+            MetricsCheckSequence(eSpkMetrics, ntohl(*(uint32_t*)UDPInBuffer[Cntr]));
+            if(Spk.StartupCount != 0)                                   // decrement startup message count
+                Spk.StartupCount--;
+            NoteMessageReceived();
             RegVal += 1;            //debug
-            Depth = ReadFIFOMonitorChannel(eSpkCodecDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);        // read the FIFO free locations
-            if((StartupCount == 0) && FIFOOverThreshold && UseDebug)
-                printf("Codec speaker FIFO Overthreshold, depth now = %d\n", Current);
-            if((StartupCount == 0) && FIFOUnderflow)
-            {
-                GlobalFIFOOverflows |= 0b00001000;
-                if(UseDebug)
-                    printf("Codec speaker FIFO Underflowed, depth now = %d\n", Current);
-            }
-    //            printf("speaker packet received; depth = %d\n", Depth);
-            while (Depth < VMEMWORDSPERFRAME)       // loop till space available
+            if(Reorder.Depth != 0)
+                ReorderPacket(&Reorder, ntohl(*(uint32_t*)UDPInBuffer[Cntr]), UDPInBuffer[Cntr] + 4);
+            else
+                AddSpkPacket(UDPInBuffer[Cntr] + 4, &Spk);
+        }
+        if(Reorder.Depth != 0)
+            ServiceReorder(&Reorder);
+        //
+        // resampling: write all the whole FIFO words, then steer from the FIFO level
+        // (an odd sample is kept for the next write)
+        //
+        if(Spk.Resampling && (Received > 0))
+        {
+            if(SpkPrefill && (Spk.Staged >= ResampleTarget))
+                SpkPrefill = false;
+            WriteSamples = Spk.Staged & ~1U;
+            if(!SpkPrefill && (WriteSamples != 0))
             {
-                usleep(1000);								                    // 1ms wait
-                Depth = ReadFIFOMonitorChannel(eSpkCodecDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);    // read the FIFO free locations
-                if((StartupCount == 0) && FIFOOverThreshold && UseDebug)
-                    printf("Codec speaker FIFO Overthreshold, depth now = %d\n", Current);
-                if((StartupCount == 0) && FIFOUnderflow)
+                Current = WriteSpkData(Spk.DMAWritefile_fd, Spk.SpkEvent_fd, Spk.SpkBasePtr, WriteSamples * 4,
+                                       Received, Spk.StartupCount, &Underflowed);
+                clock_gettime(CLOCK_MONOTONIC, &Now);
+                Interval = Spk.Resampler.LevelValid ? (Now.tv_sec - LastSteer.tv_sec) + (Now.tv_nsec - LastSteer.tv_nsec) * 1e-9 : 0.0;
+                LastSteer = Now;
+                SteerAudioResampler(&Spk.Resampler, (double)(Current * VSPKSAMPLESPERMEMWORD + WriteSamples), ResampleTarget, Interval);
+                memmove(Spk.SpkBasePtr, Spk.SpkBasePtr + WriteSamples * 4, (Spk.Staged - WriteSamples) * 4);
+                Spk.Staged -= WriteSamples;
+                if(Underflowed)
                 {
-                    GlobalFIFOOverflows |= 0b00001000;
-                    if(UseDebug)
-                        printf("Codec speaker FIFO Underflowed, depth now = %d\n", Current);
+                    SpkPrefill = true;                              // ran dry: build up the level again
+                    ResampleUnderflows++;
                 }
             }
-                // copy sata from UDP Buffer & DMA write it
-            memcpy(SpkBasePtr, UDPInBuffer + 4, VDMATRANSFERSIZE);              // copy out spk samples
-    //        if(RegVal == 100)
-    //            DumpMemoryBuffer(SpkBasePtr, VDMATRANSFERSIZE);
-            DMAWriteToFPGA(DMAWritefile_fd, SpkBasePtr, VDMATRANSFERSIZE, VADDRSPKRSTREAMWRITE);
         }
+        //
+        // no more packets waiting: write any gathered
+        //
+        if((Received <= 0) && (Spk.Frames != 0))
+        {
+            WriteSpkFrames(Spk.DMAWritefile_fd, Spk.SpkEvent_fd, Spk.SpkBasePtr, Spk.Frames, Spk.StartupCount);
+            Spk.Frames = 0;
+        }
+        if(Received > 0)
+            MetricsRecordLoopTime(eSpkMetrics, &LoopStart);
     }
 //
 // close down thread
 //
     close(ThreadData->Socketid);                  // close incoming data socket
+    if(Spk.SpkEvent_fd >= 0)
+        CloseUserIRQWaiter(Spk.SpkEvent_fd);
     ThreadData->Socketid = 0;
     ThreadData->Active = false;                   // indicate it is closed
     return NULL;
@@ -0,0 +1,215 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// licenced under GNU GPL3
+//
+// InboundDispatcher.c:
+//
+// one thread to receive the low rate inbound protocol 2 ports.
+// each of these ports used to have its own thread, woken every 1ms by the socket
+// receive timeout even with nothing to do. Here a single thread sleeps in epoll_wait()
+// until a packet arrives on any of them.
+//
+//////////////////////////////////////////////////////////////
+
+#include "InboundDispatcher.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <syscall.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+
+//
+// data for each port served
+//
+struct InboundPort
+{
+    struct ThreadSocketData* Port;
+    TInboundHandler Handler;
+    uint32_t PacketSize;
+    uint32_t ControlSize;
+    uint8_t* Packets;                                   // VINBOUNDMAXBATCH packet buffers
+    uint8_t* Control;                                   // VINBOUNDMAXBATCH control message buffers
+    struct sockaddr_in From[VINBOUNDMAXBATCH];
+    struct iovec iovecinst[VINBOUNDMAXBATCH];
+    struct mmsghdr datagrams[VINBOUNDMAXBATCH];
+};
+
+static struct InboundPort InboundPorts[VINBOUNDMAXPORTS];
+static uint32_t InboundPortCount = 0;
+static int InboundEpoll_fd = -1;
+static int InboundStop_fd = -1;                        // eventfd: written to stop the dispatcher
+
+
+//
+// add a bound socket to the dispatcher
+//
+bool AddInboundPort(struct ThreadSocketData* Port, uint32_t PacketSize, uint32_t ControlSize, TInboundHandler Handler)
+{
+    struct InboundPort* Entry;
+    struct epoll_event Event;
+
+    if(InboundPortCount >= VINBOUNDMAXPORTS)
+    {
+        printf("too many inbound ports\n");
+        return false;
+    }
+    if(InboundEpoll_fd < 0)
+    {
+        InboundEpoll_fd = epoll_create1(0);
+        if(InboundEpoll_fd < 0)
+        {
+            perror("inbound epoll_create1");
+            return false;
+        }
+        InboundStop_fd = eventfd(0, EFD_NONBLOCK);
+        if(InboundStop_fd >= 0)
+        {
+            Event.events = EPOLLIN;
+            Event.data.ptr = NULL;                      // NULL marks the stop event
+            epoll_ctl(InboundEpoll_fd, EPOLL_CTL_ADD, InboundStop_fd, &Event);
+        }
+    }
+    Entry = &InboundPorts[InboundPortCount];
+    memset(Entry, 0, sizeof(*Entry));
+    Entry->Port = Port;
+    Entry->Handler = Handler;
+    Entry->PacketSize = PacketSize;
+    Entry->ControlSize = ControlSize;
+    Entry->Packets = malloc(VINBOUNDMAXBATCH * PacketSize);
+    if(ControlSize != 0)
+        Entry->Control = malloc(VINBOUNDMAXBATCH * ControlSize);
+    if(!Entry->Packets || ((ControlSize != 0) && !Entry->Control))
+    {
+        printf("inbound port buffer allocation failed\n");
+        free(Entry->Packets);
+        free(Entry->Control);
+        return false;
+    }
+
+    Event.events = EPOLLIN;
+    Event.data.ptr = Entry;
+    if(epoll_ctl(InboundEpoll_fd, EPOLL_CTL_ADD, Port->Socketid, &Event) < 0)
+    {
+        perror("inbound epoll_ctl");
+        free(Entry->Packets);
+        free(Entry->Control);
+        return false;
+    }
+    Port->Active = true;
+    InboundPortCount++;
+    return true;
+}
+
+
+//
+// set up the message headers for a port, ready for recvmmsg()
+// (the kernel overwrites the name and control lengths on each receive)
+//
+static void PrepareInboundHeaders(struct InboundPort* Entry)
+{
+    uint32_t Cntr;
+    struct msghdr* Header;
+
+    for(Cntr = 0; Cntr < VINBOUNDMAXBATCH; Cntr++)
+    {
+        Entry->iovecinst[Cntr].iov_base = Entry->Packets + Cntr * Entry->PacketSize;
+        Entry->iovecinst[Cntr].iov_len = Entry->PacketSize;
+        Header = &Entry->datagrams[Cntr].msg_hdr;
+        Header->msg_iov = &Entry->iovecinst[Cntr];
+        Header->msg_iovlen = 1;
+        Header->msg_name = &Entry->From[Cntr];
+        Header->msg_namelen = sizeof(struct sockaddr_in);
+        if(Entry->ControlSize != 0)
+        {
+            Header->msg_control = Entry->Control + Cntr * Entry->ControlSize;
+            Header->msg_controllen = Entry->ControlSize;
+        }
+    }
+}
+
+
+//
+// receive all the packets waiting on one port, and call its handler for each
+// returns false if the socket has failed
+//
+static bool DrainInboundPort(struct InboundPort* Entry)
+{
+    int Received;
+    int Cntr;
+
+    do
+    {
+        PrepareInboundHeaders(Entry);
+        Received = recvmmsg(Entry->Port->Socketid, Entry->datagrams, VINBOUNDMAXBATCH, MSG_DONTWAIT, NULL);
+        if(Received < 0)
+        {
+            if((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+                return true;
+            perror("recvmmsg, inbound port");
+            return false;
+        }
+        for(Cntr = 0; Cntr < Received; Cntr++)
+            Entry->Handler((uint8_t*)Entry->iovecinst[Cntr].iov_base, (int)Entry->datagrams[Cntr].msg_len,
+                           &Entry->datagrams[Cntr].msg_hdr);
+    } while(Received == VINBOUNDMAXBATCH);
+    return true;
+}
+
+
+//
+// dispatcher thread
+//
+void *InboundDispatcher(void *arg)
+{
+    struct epoll_event Events[VINBOUNDMAXPORTS + 1];
+    struct InboundPort* Entry;
+    int Ready;
+    int Cntr;
+
+    (void)arg;
+    printf("spinning up inbound dispatcher thread for %d ports, pid=%ld\n", InboundPortCount, syscall(SYS_gettid));
+    while(InboundEpoll_fd >= 0)
+    {
+        Ready = epoll_wait(InboundEpoll_fd, Events, VINBOUNDMAXPORTS + 1, -1);
+        if(Ready < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            perror("inbound epoll_wait");
+            break;
+        }
+        for(Cntr = 0; Cntr < Ready; Cntr++)
+        {
+            Entry = (struct InboundPort*)Events[Cntr].data.ptr;
+            if(Entry == NULL)
+                return NULL;                            // StopInboundDispatcher() called
+            if(!DrainInboundPort(Entry))
+            {
+                epoll_ctl(InboundEpoll_fd, EPOLL_CTL_DEL, Entry->Port->Socketid, NULL);
+                Entry->Port->Active = false;
+            }
+        }
+    }
+    return NULL;
+}
+
+
+//
+// wake the dispatcher thread and make it return
+//
+void StopInboundDispatcher(void)
+{
+    uint64_t Value = 1;
+
+    if(InboundStop_fd >= 0)
+        if(write(InboundStop_fd, &Value, sizeof(Value)) < 0)
+            perror("inbound stop write");
+}
@@ -0,0 +1,58 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// licenced under GNU GPL3
+//
+// InboundDispatcher.h:
+//
+// header: one thread to receive the low rate inbound protocol 2 ports
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __InboundDispatcher_h
+#define __InboundDispatcher_h
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/socket.h>
+#include "threaddata.h"
+
+
+#define VINBOUNDMAXPORTS 8              // most ports the dispatcher can serve
+#define VINBOUNDMAXBATCH 8              // most packets received from one port in one recvmmsg() call
+
+
+//
+// handler for one received packet
+// Header is the message header, for control messages (eg receive timestamps)
+//
+typedef void (*TInboundHandler)(uint8_t* Packet, int Size, struct msghdr* Header);
+
+
+//
+// add a bound socket to the dispatcher. Must be called before the dispatcher thread starts.
+// PacketSize = largest packet to receive; ControlSize = control message buffer size (0 if none)
+// returns true if successful
+//
+bool AddInboundPort(struct ThreadSocketData* Port, uint32_t PacketSize, uint32_t ControlSize, TInboundHandler Handler);
+
+
+//
+// dispatcher thread: waits on all the added sockets in a single epoll_wait(),
+// drains each ready socket with recvmmsg() and calls its handler for each packet.
+// it uses no CPU while no packets arrive.
+//
+void *InboundDispatcher(void *arg);
+
+
+//
+// make the dispatcher thread return, so it can be joined at shutdown
+//
+void StopInboundDispatcher(void);
+
+
+#endif
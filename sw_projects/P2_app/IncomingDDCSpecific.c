@@ -33,16 +33,10 @@
 
 
 //
-// listener thread for incoming DDC specific packets
+// handler for incoming DDC specific packets, called by the inbound dispatcher
 //
-void *IncomingDDCSpecific(void *arg)                    // listener thread
+void HandleDDCSpecificPacket(uint8_t* UDPInBuffer, int size, struct msghdr* Header)
 {
-  struct ThreadSocketData *ThreadData;                  // socket etc data for this thread
-  struct sockaddr_in addr_from;                         // holds MAC address of source of incoming messages
-  uint8_t UDPInBuffer[VDDCSPECIFICSIZE];                // incoming buffer
-  struct iovec iovecinst;                               // iovcnt buffer - 1 for each outgoing buffer
-  struct msghdr datagram;                               // multiple incoming message header
-  int size;                                             // UDP datagram length
   uint8_t Byte1, Byte2;                                 // received data
   bool Dither, Random;                                  // ADC bits
   bool Enabled, Interleaved;                            // DDC settings
@@ -50,31 +44,10 @@ void *IncomingDDCSpecific(void *arg)                    // listener thread
   int i;                                                // counter
   EADCSelect ADC = eADC1;                               // ADC to use for a DDC
 
-  ThreadData = (struct ThreadSocketData *)arg;
-  ThreadData->Active = true;
-  printf("spinning up DDC specific thread with port %d, pid=%ld\n", ThreadData->Portid, syscall(SYS_gettid));
-  //
-  // main processing loop
-  //
-  while(1)
-  {
-    memset(&iovecinst, 0, sizeof(struct iovec));
-    memset(&datagram, 0, sizeof(datagram));
-    iovecinst.iov_base = &UDPInBuffer;                  // set buffer for incoming message number i
-    iovecinst.iov_len = VDDCSPECIFICSIZE;
-    datagram.msg_iov = &iovecinst;
-    datagram.msg_iovlen = 1;
-    datagram.msg_name = &addr_from;
-    datagram.msg_namelen = sizeof(addr_from);
-    size = recvmsg(ThreadData->Socketid, &datagram, 0);         // get one message. If it times out, ges size=-1
-    if(size < 0 && errno != EAGAIN)
-    {
-      perror("recvfrom, DDC Specific");
-      return NULL;
-    }
+  (void)Header;
     if(size == VDDCSPECIFICSIZE)
     {
-      NewMessageReceived = true;
+      NoteMessageReceived();
       printf("DDC specific packet received\n");
       // get ADC details:
       Byte1 = *(uint8_t*)(UDPInBuffer+4);                   // get ADC count
@@ -179,18 +152,14 @@ void *IncomingDDCSpecific(void *arg)                    // listener thread
         Word = Word >> 1;                                 // move onto next DDC enabled bit
       }
       // now set register, and see if any changes made; reuse Dither again
-      Dither = WriteP2DDCRateRegister();
-      if (Dither)
-        HandlerCheckDDCSettings();
+      // while the DDC stream runs, its thread applies the change at a frame boundary
+      if (!RequestDDCRateChange(GetP2DDCRateWord()))
+      {
+        Dither = WriteP2DDCRateRegister();
+        if (Dither)
+          HandlerCheckDDCSettings();
+      }
     }
-  }
-//
-// close down thread
-//
-  close(ThreadData->Socketid);                  // close incoming data socket
-  ThreadData->Socketid = 0;
-  ThreadData->Active = false;                   // indicate it is closed
-  return NULL;
 }
 
 
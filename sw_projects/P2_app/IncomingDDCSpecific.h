@@ -25,10 +25,12 @@
 #define VDDCSPECIFICSIZE 1444           // DDC specific packet size in bytes
 
 
+#include <sys/socket.h>
 //
 // protocol 2 handler for incoming DDC specific Packet to SDR
+// called by the inbound dispatcher for each packet received
 //
-void *IncomingDDCSpecific(void *arg);           // listener thread
+void HandleDDCSpecificPacket(uint8_t* UDPInBuffer, int size, struct msghdr* Header);
 
 
 #endif
\ No newline at end of file
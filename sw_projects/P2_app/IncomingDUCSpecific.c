@@ -32,16 +32,10 @@
 
 
 //
-// listener thread for incoming DUC specific packets
+// handler for incoming DUC specific packets, called by the inbound dispatcher
 //
-void *IncomingDUCSpecific(void *arg)                    // listener thread
+void HandleDUCSpecificPacket(uint8_t* UDPInBuffer, int size, struct msghdr* Header)
 { 
-    struct ThreadSocketData *ThreadData;                  // socket etc data for this thread
-    struct sockaddr_in addr_from;                         // holds MAC address of source of incoming messages
-    uint8_t UDPInBuffer[VDUCSPECIFICSIZE];                // incoming buffer
-    struct iovec iovecinst;                               // iovcnt buffer - 1 for each outgoing buffer
-    struct msghdr datagram;                               // multiple incoming message header
-    int size;                                             // UDP datagram length
     uint8_t Byte;
     uint16_t SidetoneFreq;                                // freq for audio sidetone
     uint8_t IambicSpeed;                                  // WPM
@@ -52,31 +46,10 @@ void *IncomingDUCSpecific(void *arg)                    // listener thread
     uint8_t CWRampTime;
     uint32_t CWRampTime_us;
 
-    ThreadData = (struct ThreadSocketData *)arg;
-    ThreadData->Active = true;
-    printf("spinning up DUC specific thread with port %d, pid=%ld\n", ThreadData->Portid, syscall(SYS_gettid));
-    //
-    // main processing loop
-    //
-    while(1)
-    {
-      memset(&iovecinst, 0, sizeof(struct iovec));
-      memset(&datagram, 0, sizeof(datagram));
-      iovecinst.iov_base = &UDPInBuffer;                  // set buffer for incoming message number i
-      iovecinst.iov_len = VDUCSPECIFICSIZE;
-      datagram.msg_iov = &iovecinst;
-      datagram.msg_iovlen = 1;
-      datagram.msg_name = &addr_from;
-      datagram.msg_namelen = sizeof(addr_from);
-      size = recvmsg(ThreadData->Socketid, &datagram, 0);         // get one message. If it times out, ges size=-1
-      if(size < 0 && errno != EAGAIN)
-      {
-          perror("recvfrom, DUC specific");
-          return NULL;
-      }
+    (void)Header;
       if(size == VDUCSPECIFICSIZE)
       {
-          NewMessageReceived = true;
+          NoteMessageReceived();
           printf("DUC packet received\n");
 // iambic settings
           IambicSpeed = *(uint8_t*)(UDPInBuffer+9);               // keyer speed
@@ -103,6 +76,8 @@ void *IncomingDUCSpecific(void *arg)                    // listener thread
               CWRampTime_us = 1000 * CWRampTime;
               InitialiseCWKeyerRamp(true, CWRampTime_us);         // create required ramp, P2
           }
+          Byte = *(uint8_t*)(UDPInBuffer+16);                     // DUC sample bits (0 from older clients)
+          SetDUCSampleSize(Byte);
 
 // mic and line in options
           Byte = *(uint8_t*)(UDPInBuffer+50);                     // mic/line options
@@ -117,14 +92,6 @@ void *IncomingDUCSpecific(void *arg)                    // listener thread
           Byte = *(uint8_t*)(UDPInBuffer+59);                     // ADC1 att on TX
           SetADCAttenuator(eADC1, Byte, false, true);
       }
-    }
-//
-// close down thread
-//
-    close(ThreadData->Socketid);                  // close incoming data socket
-    ThreadData->Socketid = 0;
-    ThreadData->Active = false;                   // indicate it is closed
-    return NULL;
 }
 
 
@@ -20,6 +20,7 @@
 
 #include <stdint.h>
 #include "../common/saturntypes.h"
+#include <sys/socket.h>
 
 
 #define VDUCSPECIFICSIZE 60             // DUC specific packet
@@ -27,8 +28,9 @@
 
 //
 // protocol 2 handler for incoming DUC specific Packet to SDR
+// called by the inbound dispatcher for each packet received
 //
-void *IncomingDUCSpecific(void *arg);           // listener thread
+void HandleDUCSpecificPacket(uint8_t* UDPInBuffer, int size, struct msghdr* Header);
 
 
 #endif
\ No newline at end of file
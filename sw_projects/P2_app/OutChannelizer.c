@@ -0,0 +1,403 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// OutChannelizer.c:
+//
+// software virtual DDCs: split one DDC into narrow channels, and send
+// each as a protocol 2 DDC I/Q stream
+//
+//////////////////////////////////////////////////////////////
+
+#include "threaddata.h"
+#include <stdint.h>
+#include "../common/saturntypes.h"
+#include "OutChannelizer.h"
+#include "threadmanager.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include <endian.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "../common/saturnregisters.h"
+#include "../common/spscring.h"
+#include "../common/channelizer.h"
+#include "radiostate.h"
+
+
+#define VCHANRINGSLOTS 128                      // DDC packets buffered for a channelizer (power of 2)
+#define VCHANMAXINSAMPLES 238                   // most I/Q samples in a DDC packet
+#define VCHANSAMPLESPERFRAME 238                // I/Q samples in each outgoing channel packet
+#define VCHANPACKETSIZE 1444                    // protocol 2 DDC packet
+#define VCHANHEADERSIZE 16                      // bytes before the I/Q samples
+#define VCHANBATCH 4                            // packets per channel sent in one sendmmsg
+#define VCHANIDLESLEEP 1000                     // us channelizer sleep when no DDC packets waiting
+#define VCHANFULLSCALE 8388607.0f               // largest 24 bit sample
+
+
+//
+// one DDC packet passed from the decode to a channelizer thread
+//
+struct ChannelizerPacket
+{
+    uint32_t SampleRate;                        // Hz
+    uint32_t SampleCount;                       // I/Q samples in Data
+    uint8_t Data[VCHANMAXINSAMPLES * 6];
+};
+
+
+//
+// one channelizer: filter bank, its input ring, and the outgoing packets
+//
+struct ChannelizerStream
+{
+    uint32_t DDC;                               // DDC that feeds it
+    uint32_t Channels;
+    uint16_t BasePort;                          // port of channel 0
+    pthread_t Thread;
+    struct Channelizer Bank;
+    struct SPSCRing Index;                      // packet ring, decode -> channelizer
+    struct ChannelizerPacket* Packets;
+    uint32_t InputRate;                         // DDC sample rate, Hz; 0 until the 1st packet
+    uint32_t InputCount;                        // input samples gathered for the next block
+    float Input[2 * VCHANMAXCHANNELS];
+    float Output[2 * VCHANMAXCHANNELS];
+    int Sockets[VCHANMAXCHANNELS];              // one per channel, bound to BasePort + channel
+    uint8_t* ChannelPackets;                    // [channel][batch] outgoing packets
+    uint32_t OutCount;                          // samples in the packets being filled (same for all channels)
+    uint32_t BatchCount;                        // full packets per channel waiting to be sent
+    uint32_t SequenceCounter;                   // same for every channel
+    uint64_t OutputSamples;                     // samples per channel sent this session (timestamp)
+    bool Running;                               // session in progress
+    uint64_t Dropped;                           // DDC packets dropped with the ring full (decode thread)
+    uint64_t SendDrops;                         // packets dropped with a socket queue full
+    struct RadioState State;                    // radio state snapshot (client address)
+    uint32_t StateVersion;
+};
+
+#define CHANPACKET(Stream, Channel, Batch) ((Stream)->ChannelPackets + ((Channel) * VCHANBATCH + (Batch)) * VCHANPACKETSIZE)
+
+
+uint32_t GChannelizerMask = 0;                  // DDCs feeding a channelizer
+
+static struct ChannelizerStream* Channelizers[VMAXCHANNELIZERS];
+static uint32_t ChannelizerCount = 0;
+
+
+//
+// add a channelizer, from a command line string
+// format: <DDC>:<channels>[:<base port>]
+// returns true if successful
+//
+bool AddChannelizer(const char* Spec)
+{
+    struct ChannelizerStream* Stream;
+    uint32_t DDC, Channels, Port = VCHANDEFAULTBASEPORT;
+    int Fields;
+
+    if(ChannelizerCount >= VMAXCHANNELIZERS)
+    {
+        printf("too many channelizers (max %d)\n", VMAXCHANNELIZERS);
+        return false;
+    }
+    Fields = sscanf(Spec, "%u:%u:%u", &DDC, &Channels, &Port);
+    if((Fields < 2) || (DDC >= VNUMDDC) || (Port == 0) || (Port + Channels > 65535))
+    {
+        printf("bad channelizer %s: use <DDC>:<channels>[:<base port>]\n", Spec);
+        return false;
+    }
+    Stream = calloc(1, sizeof(struct ChannelizerStream));
+    if(Stream == NULL)
+        return false;
+    if(!InitialiseChannelizer(&Stream->Bank, Channels))
+    {
+        printf("channelizer: %u channels not supported (a power of 2 from %d to %d)\n",
+               Channels, VCHANMINCHANNELS, VCHANMAXCHANNELS);
+        free(Stream);
+        return false;
+    }
+    Stream->Packets = malloc(VCHANRINGSLOTS * sizeof(struct ChannelizerPacket));
+    Stream->ChannelPackets = calloc(Channels * VCHANBATCH, VCHANPACKETSIZE);
+    if((Stream->Packets == NULL) || (Stream->ChannelPackets == NULL))
+    {
+        free(Stream->Packets);
+        free(Stream->ChannelPackets);
+        free(Stream);
+        return false;
+    }
+    Stream->DDC = DDC;
+    Stream->Channels = Channels;
+    Stream->BasePort = (uint16_t)Port;
+    SPSCInitialise(&Stream->Index, VCHANRINGSLOTS);
+    Channelizers[ChannelizerCount++] = Stream;
+    printf("channelizer: DDC%u split into %u channels, ports %u-%u\n", DDC, Channels, Port, Port + Channels - 1);
+    return true;
+}
+
+
+//
+// DDC decode thread: copy a packet into the ring of each channelizer fed by DDC
+//
+void QueueChannelizerPacket(uint32_t DDC, const uint8_t* Samples, uint32_t SampleCount, uint32_t SampleRate)
+{
+    struct ChannelizerStream* Stream;
+    struct ChannelizerPacket* Packet;
+    uint32_t Cntr;
+    int32_t Slot;
+
+    if(SampleCount > VCHANMAXINSAMPLES)
+        SampleCount = VCHANMAXINSAMPLES;
+    for(Cntr = 0; Cntr < ChannelizerCount; Cntr++)
+    {
+        Stream = Channelizers[Cntr];
+        if(Stream->DDC != DDC)
+            continue;
+        Slot = SPSCGetWriteSlot(&Stream->Index);
+        if(Slot < 0)
+        {
+            __atomic_fetch_add(&Stream->Dropped, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        Packet = &Stream->Packets[Slot];
+        Packet->SampleRate = SampleRate;
+        Packet->SampleCount = SampleCount;
+        memcpy(Packet->Data, Samples, SampleCount * 6);
+        SPSCPublish(&Stream->Index);
+    }
+}
+
+
+//
+// start a session: clear the filter bank, and the packets being filled
+// all the header fields except sequence number and timestamp are constant
+//
+static void StartChannelizerSession(struct ChannelizerStream* Stream)
+{
+    uint32_t Channel, Batch;
+    uint8_t* Packet;
+
+    ResetChannelizer(&Stream->Bank);
+    for(Channel = 0; Channel < Stream->Channels; Channel++)
+        for(Batch = 0; Batch < VCHANBATCH; Batch++)
+        {
+            Packet = CHANPACKET(Stream, Channel, Batch);
+            memset(Packet, 0, VCHANHEADERSIZE);
+            *(uint16_t*)(Packet + 12) = htons(24);                      // bits per sample
+            *(uint16_t*)(Packet + 14) = htons(VCHANSAMPLESPERFRAME);    // I/Q samples for ths frame
+        }
+    Stream->InputCount = 0;
+    Stream->OutCount = 0;
+    Stream->BatchCount = 0;
+    Stream->SequenceCounter = 0;
+    Stream->OutputSamples = 0;
+    Stream->Running = true;
+}
+
+
+//
+// send the full packets of every channel, one sendmmsg per channel port
+// packets are dropped if there is no client, or its queue is full
+//
+static void SendChannelPackets(struct ChannelizerStream* Stream)
+{
+    struct sockaddr_in DestAddr;
+    struct iovec Iovec[VCHANBATCH];
+    struct mmsghdr Batch[VCHANBATCH];
+    uint32_t Channel, Cntr;
+    int Sent;
+
+    RefreshRadioState(&Stream->State, &Stream->StateVersion);
+    if(!Stream->State.SDRActive || !Stream->State.ReplyAddressSet)
+        return;
+    memcpy(&DestAddr, &Stream->State.ReplyAddr, sizeof(DestAddr));
+    for(Channel = 0; Channel < Stream->Channels; Channel++)
+    {
+        memset(Batch, 0, sizeof(Batch));
+        for(Cntr = 0; Cntr < Stream->BatchCount; Cntr++)
+        {
+            Iovec[Cntr].iov_base = CHANPACKET(Stream, Channel, Cntr);
+            Iovec[Cntr].iov_len = VCHANPACKETSIZE;
+            Batch[Cntr].msg_hdr.msg_iov = &Iovec[Cntr];
+            Batch[Cntr].msg_hdr.msg_iovlen = 1;
+            Batch[Cntr].msg_hdr.msg_name = &DestAddr;
+            Batch[Cntr].msg_hdr.msg_namelen = sizeof(DestAddr);
+        }
+        Sent = sendmmsg(Stream->Sockets[Channel], Batch, Stream->BatchCount, 0);
+        if(Sent < 0)
+        {
+            if(!IsSendBackpressure(errno))
+                perror("sendmmsg, channelizer");
+            Sent = 0;
+        }
+        Stream->SendDrops += Stream->BatchCount - (uint32_t)Sent;
+    }
+}
+
+
+//
+// add one output sample per channel to the packets being filled
+// when they are full, finish the headers; send when a batch is complete
+//
+static void AddChannelSamples(struct ChannelizerStream* Stream)
+{
+    uint32_t Channel;
+    uint8_t* Dest;
+    uint64_t TimeStamp;
+    float Value;
+    int32_t Sample;
+    uint32_t Cntr;
+
+    for(Channel = 0; Channel < Stream->Channels; Channel++)
+    {
+        Dest = CHANPACKET(Stream, Channel, Stream->BatchCount) + VCHANHEADERSIZE + Stream->OutCount * 6;
+        for(Cntr = 0; Cntr < 2; Cntr++)                             // I then Q
+        {
+            Value = Stream->Output[2 * Channel + Cntr];
+            if(Value > VCHANFULLSCALE)
+                Value = VCHANFULLSCALE;
+            else if(Value < -VCHANFULLSCALE)
+                Value = -VCHANFULLSCALE;
+            Sample = (int32_t)(Value + ((Value >= 0.0f) ? 0.5f : -0.5f));
+            *Dest++ = (uint8_t)(Sample >> 16);
+            *Dest++ = (uint8_t)(Sample >> 8);
+            *Dest++ = (uint8_t)Sample;
+        }
+    }
+    if(++Stream->OutCount < VCHANSAMPLESPERFRAME)
+        return;
+
+    //
+    // the packets are full: every channel has the same sequence number and timestamp
+    //
+    TimeStamp = GEnableTimeStamping ? htobe64(Stream->OutputSamples) : 0;
+    for(Channel = 0; Channel < Stream->Channels; Channel++)
+    {
+        Dest = CHANPACKET(Stream, Channel, Stream->BatchCount);
+        *(uint32_t*)Dest = htonl(Stream->SequenceCounter);
+        memcpy(Dest + 4, &TimeStamp, sizeof(TimeStamp));
+    }
+    Stream->SequenceCounter++;
+    Stream->OutputSamples += VCHANSAMPLESPERFRAME;
+    Stream->OutCount = 0;
+    if(++Stream->BatchCount == VCHANBATCH)
+    {
+        SendChannelPackets(Stream);
+        Stream->BatchCount = 0;
+    }
+}
+
+
+//
+// run the filter bank over one DDC packet
+//
+static void ChannelizePacket(struct ChannelizerStream* Stream, const struct ChannelizerPacket* Packet)
+{
+    const uint8_t* Src = Packet->Data;
+    uint32_t Cntr;
+
+    if(Packet->SampleRate != Stream->InputRate)
+    {
+        Stream->InputRate = Packet->SampleRate;
+        printf("channelizer: DDC%u at %uHz, %u channels of %uHz\n", Stream->DDC, Stream->InputRate,
+               Stream->Channels, Stream->InputRate / Stream->Channels);
+        StartChannelizerSession(Stream);
+    }
+    for(Cntr = 0; Cntr < Packet->SampleCount; Cntr++)
+    {
+        Stream->Input[2 * Stream->InputCount] = (float)((int32_t)((Src[0] << 24) | (Src[1] << 16) | (Src[2] << 8)) >> 8);
+        Stream->Input[2 * Stream->InputCount + 1] = (float)((int32_t)((Src[3] << 24) | (Src[4] << 16) | (Src[5] << 8)) >> 8);
+        Src += 6;
+        if(++Stream->InputCount == Stream->Channels)
+        {
+            RunChannelizer(&Stream->Bank, Stream->Input, Stream->Output);
+            AddChannelSamples(Stream);
+            Stream->InputCount = 0;
+        }
+    }
+}
+
+
+//
+// channelizer thread: runs for the life of the program
+// a session ends when the SDR stops; the next starts with the next DDC packet
+//
+static void* ChannelizerThread(void* arg)
+{
+    struct ChannelizerStream* Stream = (struct ChannelizerStream*)arg;
+    int32_t Slot;
+
+    printf("spinning up channelizer thread for DDC%u, pid=%ld\n", Stream->DDC, syscall(SYS_gettid));
+    while(!ThreadStopRequested())
+    {
+        Slot = SPSCGetReadSlot(&Stream->Index);
+        if(Slot < 0)
+        {
+            if(Stream->Running && !__atomic_load_n(&SDRActive, __ATOMIC_ACQUIRE))
+            {
+                Stream->Running = false;
+                Stream->InputRate = 0;
+                if((Stream->SendDrops != 0) || (__atomic_load_n(&Stream->Dropped, __ATOMIC_RELAXED) != 0))
+                    printf("channelizer: DDC%u packets dropped = %llu, channel packets dropped = %llu\n", Stream->DDC,
+                           (unsigned long long)__atomic_load_n(&Stream->Dropped, __ATOMIC_RELAXED),
+                           (unsigned long long)Stream->SendDrops);
+            }
+            usleep(VCHANIDLESLEEP);
+            continue;
+        }
+        ChannelizePacket(Stream, &Stream->Packets[Slot]);
+        SPSCRelease(&Stream->Index);
+    }
+    return NULL;
+}
+
+
+//
+// open the channel ports and start the channelizer threads
+//
+bool StartChannelizers(void)
+{
+    struct ChannelizerStream* Stream;
+    struct sockaddr_in Addr;
+    uint32_t Cntr, Channel;
+    int yes = 1;
+
+    for(Cntr = 0; Cntr < ChannelizerCount; Cntr++)
+    {
+        Stream = Channelizers[Cntr];
+        for(Channel = 0; Channel < Stream->Channels; Channel++)
+        {
+            Stream->Sockets[Channel] = socket(AF_INET, SOCK_DGRAM, 0);
+            if(Stream->Sockets[Channel] < 0)
+            {
+                perror("socket, channelizer");
+                return false;
+            }
+            setsockopt(Stream->Sockets[Channel], SOL_SOCKET, SO_REUSEADDR, (void *)&yes, sizeof(yes));
+            memset(&Addr, 0, sizeof(Addr));
+            Addr.sin_family = AF_INET;
+            Addr.sin_addr.s_addr = htonl(INADDR_ANY);
+            Addr.sin_port = htons(Stream->BasePort + Channel);
+            if(bind(Stream->Sockets[Channel], (struct sockaddr *)&Addr, sizeof(Addr)) < 0)
+            {
+                perror("bind, channelizer");
+                return false;
+            }
+        }
+        if(!CreateManagedThread(&Stream->Thread, "channelizer", eStreamThread, ChannelizerThread, Stream))
+        {
+            perror("pthread_create channelizer");
+            return false;
+        }
+        GChannelizerMask |= 1U << Stream->DDC;
+    }
+    return true;
+}
@@ -0,0 +1,68 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// OutChannelizer.h:
+//
+// header: software "virtual DDCs" from a polyphase channelizer
+// one hardware DDC (eg at 1536KHz) is split by a channelizer thread into
+// M narrow channels (see channelizer.h). Each channel is sent as a
+// normal protocol 2 DDC I/Q stream, from its own port (base port +
+// channel number) to the client's address. The channelizer threads are
+// stream class threads, so they are placed by the thread manager (-A).
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __OutChannelizer_h
+#define __OutChannelizer_h
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../common/saturntypes.h"
+
+
+#define VMAXCHANNELIZERS 4                      // most channelizers; each has its own thread
+#define VCHANDEFAULTBASEPORT 1100               // port of channel 0 if not given
+
+
+//
+// DDCs that feed a channelizer, one bit per DDC. Set once at startup;
+// read by the DDC decode to decide whether to call QueueChannelizerPacket()
+//
+extern uint32_t GChannelizerMask;
+
+
+//
+// bool AddChannelizer(const char* Spec)
+// add a channelizer, from a command line or config file string
+// format: <DDC>:<channels>[:<base port>]   eg 0:32:1100
+// returns true if successful
+//
+bool AddChannelizer(const char* Spec);
+
+
+//
+// bool StartChannelizers(void)
+// open the channel ports and start a thread for each channelizer added
+// returns false if any could not be started
+//
+bool StartChannelizers(void);
+
+
+//
+// void QueueChannelizerPacket(uint32_t DDC, const uint8_t* Samples, uint32_t SampleCount, uint32_t SampleRate)
+// DDC decode thread: pass one packet of DDC samples to the channelizers it feeds
+//   Samples:       24 bit big endian I then Q samples, as in a protocol 2 packet
+//   SampleRate:    DDC sample rate, Hz
+// the packet is dropped (and counted) if a channelizer has fallen behind
+//
+void QueueChannelizerPacket(uint32_t DDC, const uint8_t* Samples, uint32_t SampleCount, uint32_t SampleRate);
+
+
+#endif
@@ -17,6 +17,8 @@
 #include <stdint.h>
 #include "../common/saturntypes.h"
 #include "OutMicAudio.h"
+#include "OutDDCIQ.h"
+#include "threadmanager.h"
 #include <errno.h>
 #include <stdlib.h>
 #include <stddef.h>
@@ -26,10 +28,36 @@
 #include <fcntl.h>
 #include <pthread.h>
 #include <syscall.h>
+#include <semaphore.h>
+#include <time.h>
+#include <sched.h>
+#include <endian.h>
+#include <arpa/inet.h>
 #include "../common/saturnregisters.h"
 #include "../common/saturndrivers.h"
 #include "../common/hwaccess.h"
 #include "../common/debugaids.h"
+#include "../common/sampleunpack.h"
+#include "../common/spscring.h"
+#include "../common/dmapool.h"
+#include "../common/streamcore.h"
+#include "../common/ringlog.h"
+#include "../common/stagetrace.h"
+#include "../common/ddccapture.h"
+#include "../common/ddccompress.h"
+#include "../common/ddcconvert.h"
+#include "../common/decimator.h"
+#include "../common/version.h"
+#include "metrics.h"
+#include "iqrecorder.h"
+#include "OutChannelizer.h"
+#include "ddcshm.h"
+#include "ddcscan.h"
+#include "radiostate.h"
+#include "XDPTransmit.h"
+#include "ddcretransmit.h"
+#include "overload.h"
+#include "standby.h"
 
 
 
@@ -37,215 +65,2172 @@
 //
 // global holding the current step of C&C data. Each new USB frame updates this.
 //
-#define VDMABUFFERSIZE 131072						// memory buffer to reserve (4x DDC FIFO so OK)
-#define VALIGNMENT 4096                             // buffer alignment
 #define VBASE 0x1000									              // DMA start at 4K into buffer
 #define VBASE 0x1000                                // offset into I/Q buffer for DMA to start
 #define VDMATRANSFERSIZE 4096                       // read 4K at a time  initially
+#define VDDCMAXDMASIZE 32768                        // largest DMA transfer
+#define VDDCDMABLOCKS 8                             // DMA blocks in ring between DMA and send threads (power of 2)
+#define VDDCDMARINGSIZE ((VDDCDMABLOCKS + 1) * VDDCMAXDMASIZE)    // DMA data ring: all blocks, plus a residue
+#define VDDCSTALLSLEEP 100                          // us DMA thread sleep if DMA block ring is full
+#define VDDCMAXASYNCDMA 4                           // most asynchronous DMAs in flight (less than VDDCDMABLOCKS)
+#define VDDCASYNCWAIT 500                           // us wait for a DMA in flight to complete, if nothing else to do
+#define VDDCCONSUMERTIMEOUT 10                      // ms send thread wait for a DMA block before checking SDRActive
+#define VDDCSENDERTIMEOUT 10                        // ms sender thread wait for packets before checking for exit
+#define VDDCSLOTSTALLSLEEP 50                       // us decode sleep if a sender thread has let its packet ring fill
+#define VDDCSENDBACKOFF 100                         // us sleep if a send finds the socket queue full (ENOBUFS)
+#define VDDCSENDRETRIES 10                          // backoffs for one batch before its unsent packets are dropped
+#define VDDCXDPDRAINTIME 100                        // ms to wait at session start for AF_XDP packets to complete
+#define VDDCMAXFANOUT 8                             // most extra destinations for DDC data
+#define VDDCMAXDECIMATIONS 4                        // most software decimated streams
+#define VDDCMULTICASTTTL 1                          // multicast hop limit: local subnet only
+#define VDDCDMAPRIORITY 50                          // SCHED_FIFO priority for DMA thread, if enabled
+#define VDDCMINDMASIZE 1024                         // smallest DMA transfer the size controller will ask for
+#define VDDCDMAGRANULE 64                           // DMA sizes are a multiple of this many bytes
+#define VDDCFRAMERATE 48000                         // DDC frames per second (a count of 1 = 48KHz)
+#define VDDCRATEFILTER 8                            // fill rate measurement smoothing (new = old + (meas-old)/N)
+#define VDDCMINRATEPERIOD 200000                    // ns: shortest interval used to measure the fill rate
+#define VDDCSTARTSKIP 16                            // bytes ignored at stream start before looking for a header
+#define VDDCRESYNCBLOCKS 4                          // DMA blocks searched for a header before resetting the FIFO
+#define VDDCRATECHANGEBLOCKS 16                     // DMA blocks to wait for a requested rate word to appear
+#define VDDCPARKSETTLE 1000                         // us from stopping the DDC to resetting its FIFO
 
-#define VDDCPACKETSIZE 1444
-#define VIQSAMPLESPERFRAME 238                      // total I/Q samples in one DDC packet
-#define VIQBYTESPERFRAME 6*VIQSAMPLESPERFRAME       // total bytes in one outgoing frame
 #define VSTARTUPDELAY 100                           // 100 messages (~100ms) before reporting under or overflows
+#define VDDCEVENTTIMEOUT 2                          // ms to wait for FIFO interrupt before re-reading depth anyway
+#define VDDCEVENTBACKOFF 200                        // us sleep if woken without enough data (eg underflow interrupt)
+#define VDDCPACKETRING 32                           // packet slots per DDC (largest DMA fills ~18)
+#define VDDCMAXBATCH VDDCPACKETRING                 // most packets one DDC can have ready to send
+#define VVITAHEADERSIZE 20                          // VITA-49 header: header word, stream ID, integer & fractional timestamp
+#define VVITAPREFIX (VVITAHEADERSIZE - VDDCHEADERSIZE)  // VITA-49 header bytes below the P2 header position
+#define VDDCRINGBYTES(Samples) (VDDCPACKETRING * (VDDCHEADERSIZE + 6 * (Samples) + VVITAPREFIX))  // one DDC's packet ring
+#define VDDCFLOATPACKETSIZE(Samples) (VDDCHEADERSIZE + 8 * (Samples))  // float packet of Samples: a slot is sent as 2
+#define VDDCFLOATRINGBYTES(Samples) (VDDCPACKETRING * 2 * VDDCFLOATPACKETSIZE(Samples))   // one float DDC's packets
+#define VDDCGSOMAXBYTES 65000                       // most bytes in one GSO send (a UDP length is 16 bits)
+#define VDDCMAXSENDS (2 * VDDCMAXBATCH)             // most datagrams one DDC can have ready to send
+#define VDDCRINGGRACE 30                            // s a DDC keeps its packet ring after it was last used
+#define VVITAPACKETTYPE 0x10000000                  // VITA-49 header: IF data packet with stream ID, no trailer
+#define VVITATSIOTHER 0x00C00000                    // integer timestamp "other": seconds from stream start
+#define VVITATSFSAMPLES 0x00100000                  // fractional timestamp: sample count within the second
+#define VVITASTREAMIDBASE 0x00000100                // VITA-49 stream ID of DDC0; DDC n is base + n
+#define VDDCTSTXACTIVE 0x80                         // PureSignal packet timestamp, top byte: TX active at 1st sample
+#define VDDCTSTXCHANGED 0x40                        // PureSignal packet timestamp, top byte: TX changed in the packet
+                                                    // (also below the kernel limit of 64 GSO segments)
 
 //
 // strategy:
-// 1. We have one DMA buffer, big enough for the largest DMA
-// 2. When a DMA occurs, trafer data to separate circular buffers for each DDC
-// 3. retain separate pointers into those buffers for each DDC
-// 4. copy ALL DMA'd data out to the separate buffers
-// 5. then loop through all DDC IQ buffers and send as many messages as possible
-//
-
-
-// use of IQ memory buffers as a "nearly circular" buffer:
-
-//
-// initially: data is added starting at Base pointer
-// 
-//               higher address
-//
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 | <- IQHeadPtr: 1st free location above occupied data
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX | <- IQBasePtr, IQReadPtr
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 | <- start of memory buffer
-//                 low address
-//
-// when there is enough data for a P2 packet, it is copied out from the bottom:
-
-
-//
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 | <- IQHeadPtr: 1st free location above occupied data
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX | <- IQReadPtr: 1st occupied location, ready to read
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |               offset +0x1000    | <- IQBasePtr: data initially transferred here
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 | <- start of memory buffer
-//                 low address
-//
-// then the "residue" is copied just BELOW the IQBasePtr, ready for a 
-// linear DMA to be able to read the next P2 packet without a "wrap" in the middle
-//
-//
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 | 
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 | 
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |<- IQBasePtr, IQHeadPtr: 1st free location above occupied data
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX | <- IQReadPtr: 1st occupied location, ready to read
-//       |                                 | <- start of memory buffer
-//                 low address
-
-
-//
-// then more data gets added at the headptr:
-// 
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 | 
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       |                                 |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |<- IQHeadPtr: 1st free location above occupied data
-//       | XXXXXXXXXX occupied XXXXXXXXXXX | 
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |<- IQBasePtr
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX |
-//       | XXXXXXXXXX occupied XXXXXXXXXXX | <- IQReadPtr: 1st occupied location, ready to read
-//       |                                 | <- start of memory buffer
-//                 low address
-// 
+// 1. a DMA thread reads the FIFO into a ring of DMA blocks, placed end to end in a mirrored data ring
+//    it is linked to the send thread by a lock-free single producer/single consumer ring
+// 2. each DDC has a ring of pre-built packet slots; headers filled in when created
+// 3. When a DMA block is available, unpack the samples straight into the payload of the current slot for each DDC
+// 4. when a slot is full, it advances to the next slot in the ring
+// 5. then loop through all DDCs and send all full slots, setting the sequence number as they go
+// this means each sample is copied once only, and there is no residue to move in the I/Q data.
+//
+// jumbo packets:
+// the client can ask for more samples per packet than the standard VIQSAMPLESPERFRAME, for a
+// link with jumbo frames. The size is fixed for a session: the slot stride and the fill threshold
+// of the decode follow it, and the packet rings are re-allocated if it has changed.
+//
+// VITA-49 packets:
+// the VITA-49 IF data header is 4 bytes longer than the P2 header, so in a VITA-49 session
+// each packet starts VVITAPREFIX bytes below its slot and the slots are that much further apart.
+// The samples are in the same place, so the decode is unchanged; the sender adds the header
+// word, and the slot advance the timestamps, just as they do for P2 packets.
+//
+
+
+// use of the DMA data ring:
+// the DMA blocks are placed one after another in a mirrored StreamRing (see streamcore.h),
+// so a block that runs past the end of the ring is still contiguous in memory.
+// the incomplete frame left at the end of one block (the "residue") is therefore already
+// just below the data of the next block: the decode starts that many bytes below the
+// block, and no copying is needed.
+// the ring holds every block in the block ring plus a residue, so the DMA thread
+// can never overwrite data the send thread has yet to decode.
+//
+
+
+
+
+
+//
+// code to allocate and free dynamic allocated memory
+// first the memory buffers:
+//
+struct StreamRing DDCDMAData;                               // mirrored ring holding the DMA blocks read from DDC
+uint32_t DDCDMABlockOffset[VDDCDMABLOCKS];                  // ring byte count at the start of each block
+uint32_t DDCDMAWriteCount;                                  // ring byte count at the start of the next block
+uint32_t DDCDMABlockLength[VDDCDMABLOCKS];                  // bytes transferred into each block
+uint32_t DDCDMABlockDepth[VDDCDMABLOCKS];                   // FIFO depth each block's DMA was sized from
+struct timespec DDCDMABlockTime[VDDCDMABLOCKS];             // time of each block's DMA
+struct SPSCRing DDCDMARing;                                 // DMA blocks passed from DMA thread to send thread
+sem_t DDCBlockAvailable;                                    // posted by DMA thread for each block published
+uint32_t DDCResidueBytes;                                   // incomplete frame left at end of a DMA block
+unsigned char* DMAReadPtr;							        // pointer for 1st available location in DMA memory
+unsigned char* DMAHeadPtr;							        // ptr to 1st free location in DMA memory
+
+uint8_t* DDCPacketRing[VNUMDDC];                            // ring of outgoing packet slots per DDC
+uint32_t DDCRingBytes[VNUMDDC];                             // bytes allocated for each ring (socket path)
+volatile uint16_t DDCSamplesRequest = VIQSAMPLESPERFRAME;   // I/Q samples per packet asked for by the client
+uint32_t DDCFrameSamples = VIQSAMPLESPERFRAME;              // I/Q samples per packet this session
+uint32_t DDCFrameBytes = VIQBYTESPERFRAME;                  // I/Q bytes per packet slot this session
+uint32_t DDCPacketStride = VDDCPACKETSIZE;                  // bytes from one packet slot to the next
+uint32_t DDCPacketPrefix = 0;                               // bytes of header below a slot (VITA-49 only)
+#define DDCPACKETSLOT(DDC, Slot) (DDCPacketRing[DDC] + (Slot) * DDCPacketStride)
+uint32_t DDCRingsInUse = 0;                                 // DDCs the frame plan or a decimation writes to
+uint32_t DDCRingsAllocated = 0;                             // DDCs with a packet ring allocated (socket path)
+struct timespec DDCRingLastUsed[VNUMDDC];                   // when each DDC stopped being written to
+bool DDCRingError = false;                                  // a packet ring could not be allocated
+struct SPSCRing DDCPacketIndex[VNUMDDC];                    // full slots passed from decode to sender
+uint32_t IQWriteSlot[VNUMDDC];                              // slot being filled with samples
+uint64_t DDCSampleCounter[VNUMDDC];                         // timestamp: DDC samples before the current write slot
+uint32_t IQFillBytes[VNUMDDC];                              // I/Q bytes already in the slot being filled
+uint32_t DDCSampleRate[VNUMDDC];                            // DDC sample rate (Hz) from the rate word
+uint32_t DDCVitaSeconds[VNUMDDC];                           // VITA-49 timestamp of the write slot: seconds
+uint64_t DDCVitaFraction[VNUMDDC];                          // and samples within the second
+uint64_t DDCTimeAnchorNs[VNUMDDC];                          // wall clock timestamps: time of sample DDCTimeAnchorCount
+uint64_t DDCTimeAnchorCount[VNUMDDC];
+uint32_t DDCTimeAnchorRate[VNUMDDC];                        // rate the anchor was set at; 0 = not set this session
+bool GEnableAlignmentTimestamps = false;                    // client asked for mic/DDC alignment timestamps
+static uint64_t DDCDecodeBlockNs;                           // wall clock time the block being decoded entered the FIFO
+
+//
+// PureSignal feedback: a DDC interleaved with the next one, either of them fed with eTXSamples.
+// the FPGA sends the pair's samples alternately in the 1st DDC's stream, so keeping each
+// packet at an even sample count keeps the RX and TX samples of a pair in the same packet.
+// these packets always carry a timestamp, with the TX state in its top 2 bits
+// (sample counts never get that large), so the client doesn't have to line up MOX itself.
+//
+bool DDCInterleaved[VNUMDDC];                               // DDC carries itself and the next DDC
+bool DDCSlotTXState[VNUMDDC];                               // MOX at the 1st sample of the write slot
+uint8_t DDCSlotScanStep[VNUMDDC];                           // scanned DDC: scan step at the 1st sample of the write slot
+uint64_t GDDCPureSignalPads = 0;                            // samples padded to re-align a pair
+
+//
+// variables shared between the DMA thread and the send thread
+// the run and busy flags are a handshake: the send thread clears Run then waits for
+// Busy to clear; the DMA thread sets Busy then checks Run. Those stores and loads are
+// sequentially consistent so one of them always sees the other; the other accesses
+// are acquire/release so the ring contents and setup pass with the flags.
+//
+int IQReadfile_fd = -1;									    // DMA read file device
+int DDCEvent_fd = -1;                                       // XDMA user interrupt events device
+bool DDCProducerRun = false;                                // set by send thread to start DMA thread transfers
+bool DDCProducerBusy = false;                               // set by DMA thread while it is transferring
+bool DDCProducerExit = false;                               // set to make DMA thread exit
+sem_t DDCProducerWake;                                      // posted to wake an idle DMA thread: run or exit
+volatile unsigned int StartupCount;                         // used to delay reporting of under & overflows
+
+//
+// variables for outgoing UDP frames
+//
+struct ThreadSocketData *DDCThreadData;                     // socket etc data for each DDC; points to 1st one
+struct sockaddr_in DestAddr[VNUMDDC];                       // destination address for outgoing data
+bool DDCUseGSO[VNUMDDC];                                    // true if UDP GSO accepted for this DDC socket
+
+//
+// fan-out: extra destinations for DDC data (more clients, or an IP multicast group)
+// each packet is sent to the client, then to each extra destination for its DDC
+//
+struct DDCFanout
+{
+    struct sockaddr_in Addr;                                // port 0 = same port as the client
+    uint32_t DDCMask;                                       // bit N set = send DDC N here
+};
+struct DDCFanout DDCFanouts[VDDCMAXFANOUT];
+uint32_t DDCFanoutCount = 0;
+struct sockaddr_in FanoutDestAddr[VNUMDDC][VDDCMAXFANOUT];  // this session's extra destinations, per DDC
+uint32_t FanoutDestCount[VNUMDDC];
+
+//
+// software decimation: a hardware DDC also feeds a lower rate stream, sent as another DDC.
+// It runs while the source DDC is enabled (and not interleaved) and the target DDC is not:
+// the derived samples go through the target's packet slots, so they are sent from its port.
+//
+struct DDCDecimation
+{
+    uint32_t Source;                                        // hardware DDC
+    uint32_t Target;                                        // DDC the lower rate stream is sent as
+    uint32_t SourceRate;                                    // source rate the filter was last reset at
+    bool Active;
+    struct Decimator Filter;
+};
+struct DDCDecimation DDCDecimations[VDDCMAXDECIMATIONS];
+uint32_t DDCDecimationCount = 0;
+uint32_t DDCDecimationSources = 0;                          // bit N set = DDC N feeds an active decimation
+
+//
+// optional AF_XDP transmit. The packet slots of every DDC are then frames in the XDP UMEM,
+// with the ethernet/IP/UDP header written below each packet, so the NIC sends them
+// from where the decode wrote the samples. A slot is released when its transmit completes.
+//
+struct XDPTransmit DDCXdp;
+bool DDCXdpOpen = false;                                    // true if the packet rings are in the XDP UMEM
+bool DDCUseXDP = false;                                     // true if this session is sent by AF_XDP
+uint32_t DDCXdpInFlight[VNUMDDC];                           // slots queued to the NIC, not yet complete
+pthread_mutex_t DDCXdpMutex = PTHREAD_MUTEX_INITIALIZER;    // sender threads share the one XDP socket
+uint32_t SequenceCounter[VNUMDDC];                          // UDP sequence count
+
+//
+// DDC packet format. The client asks for it in the general packet; it is fixed
+// for a session when the stream starts. Coded packets are smaller than the slots,
+// so they are coded in place by the sender just before sending.
+//
+volatile uint8_t DDCFormatRequest = VDDCFORMAT24BIT;        // format asked for by the client
+uint8_t DDCFormat = VDDCFORMAT24BIT;                        // format of this session's packets
+uint32_t DDCPacketBytes = VDDCPACKETSIZE;                   // bytes sent per DDC packet this session
+
+//
+// DDC sample size. The client asks for it per DDC in the DDC specific packet (GDDCSampleSize);
+// like the format it is fixed for a session, and only applies to the standard 24 bit format.
+// 16 bit samples are converted in place by the sender. A float slot would not fit one
+// datagram, so each slot is converted into 2 packets of half the samples, in a separate ring.
+//
+uint8_t DDCSampleBits[VNUMDDC];                             // this session: 16, 24 or 32 (float)
+uint32_t DDCPacketLength[VNUMDDC];                          // bytes per packet this session
+uint32_t DDCPacketsPerSlot[VNUMDDC];                        // datagrams sent for each slot: 1, or 2 if float
+uint8_t* DDCFloatRing[VNUMDDC];                             // float packets, 2 per slot; allocated on 1st use
+uint32_t DDCFloatRingBytes[VNUMDDC];                        // bytes allocated for each float ring
+uint32_t DDCFloatSamples = VIQSAMPLESPERFRAME / 2;          // I/Q samples in a float packet this session
+uint64_t DDCFloatTimeStamp[VNUMDDC][VDDCPACKETRING];        // float: big endian timestamp of each slot's 2nd packet
+
+//
+// data for each sender. If there are no sender threads, sender 0 is used by the decode thread.
+// with N sender threads, sender thread T sends DDCs T, T+N, T+2N...
+// DDCSendersRun and each Busy flag are a handshake like the DMA thread's run and busy
+// flags: the decode thread clears Run then waits for Busy to clear; a sender sets Busy
+// then checks Run, each with sequentially consistent atomics.
+//
+struct DDCSenderData
+{
+    struct iovec SendIovec[VDDCMAXSENDS];                   // one iovec per batched packet
+    struct mmsghdr SendBatch[VDDCMAXSENDS];                 // batch of packets for one sendmmsg()
+    sem_t PacketsReady;                                     // posted by decode when there are packets to send
+    uint32_t SenderNum;
+    bool Busy;                                              // true while sending
+};
+struct DDCSenderData DDCSenders[VNUMDDC];
+uint32_t DDCSenderCount;                                    // number of sender threads running (0 = none)
+bool DDCSendersRun = false;                                 // set when senders may send
+bool DDCSendError = false;                                  // set by a sender thread if a send fails
+uint64_t GDDCSlotStalls = 0;                                // decode found a DDC packet ring full
+uint64_t GDDCDecodeRuns = 0;                                // runs of frames decoded with one rate word check
+uint64_t GDDCDecodeFrames = 0;                              // frames decoded
+
+//
+// variables for analysing a DDC frame
+//
+const struct DDCFramePlan* FramePlan;                       // plan for the current rate word: active DDCs only
+uint32_t PrevRateWord;                                      // last used rate word
+bool HeaderFound;                                           // true if in sync with the DDC frames
+uint32_t HeaderSearchStart;                                 // offset to start looking for a header from
+uint32_t ResyncBlocks;                                      // DMA blocks searched without finding a header
+uint64_t GDDCResyncs = 0;                                   // times sync lost and a header searched for
+uint64_t GDDCResyncBytes = 0;                               // bytes discarded while searching
+uint64_t GDDCFIFOResets = 0;                                // times the DDC FIFO was reset to regain sync
+
+//
+// DDC rate reconfiguration while the stream runs
+// the DDC specific thread posts the new rate word; the stream thread applies it between
+// DMA blocks, when the decode is at a frame boundary. It plans the new frame layout, then
+// writes the register; the FPGA changes rate at a frame start, and every frame carries its
+// rate word, so the decode re-plans at the 1st new frame and the other DDCs carry on.
+// until the new rate word is seen, a failed header search doesn't count towards a FIFO reset.
+//
+volatile bool DDCStreamActive = false;                      // true while the stream thread applies rate changes
+volatile bool DDCRateRequestPending = false;                // set by the DDC specific thread
+volatile uint32_t DDCRateRequest;                           // rate word requested
+uint32_t DDCRateWordWritten;                                // rate word in the FPGA register
+uint32_t DDCExpectedRateWord;                               // rate word asked for, not yet seen in the stream
+uint32_t DDCRateChangeBlocks = 0;                           // blocks left to wait for it; 0 = no change in progress
+uint64_t GDDCRateChanges = 0;                               // rate changes applied without a stream restart
+
+//
+// warm restart between sessions
+//
+bool DDCParked = false;                                     // DDC stopped at the end of a session
+bool DDCStandbyReady = false;                               // standby: idle DDC made ready to start
+struct timespec DDCParkTime;                                // when it was stopped
+struct timespec DDCSessionStart;                            // when this session started
+bool DDCResumeReported;                                     // time to 1st packet reported this session
+
+//
+// batched transmit statistics; average batch size = packets / calls
+//
+uint64_t GDDCPacketsSent = 0;                               // DDC packets sent
+uint64_t GDDCSendCalls = 0;                                 // sendmmsg() calls made to send them
+uint64_t GDDCSendBackoffs = 0;                              // sends that found the socket queue full
+uint64_t GDDCSendDrops = 0;                                 // packets dropped after repeated full queues
+uint64_t GDDCFanoutSent = 0;                                // packets sent to fan-out destinations
+
+//
+// back pressure statistics for the DMA block ring
+//
+uint64_t GDDCDMABlockCount = 0;                             // DMA blocks transferred
+uint64_t GDDCRingFullStalls = 0;                            // DMA thread found ring full: send side is the bottleneck
+uint64_t GDDCRingEmptyWaits = 0;                            // send thread found ring empty: waiting for FIFO data
+uint32_t GDDCRingMaxOccupancy = 0;                          // most blocks waiting to be sent
+
+//
+// overload shedding (see overload.h): the DDC FIFO depth for the controller, and the
+// packets of shed DDCs not sent, added to the sequence count at the next packet sent
+//
+volatile uint32_t GDDCFIFODepth = 0;                        // last DDC FIFO depth read
+uint64_t GDDCShedPackets = 0;                               // packets not sent because their DDC was shed
+uint32_t DDCShedSequence[VNUMDDC];                          // packets skipped since the last one sent
+
+//
+// adaptive DMA size controller
+// the nominal FIFO fill rate is set by the decode from the rate word; the DMA thread measures it too
+//
+volatile uint32_t DDCNominalWordRate = 0;                   // words/s expected from the rate word; 0 = not known yet
+uint32_t DDCMeasuredWordRate = 0;                           // smoothed words/s measured from FIFO depth reads
+uint64_t GDDCDMABytes = 0;                                  // total bytes transferred, for average DMA size
+
+
+bool CreateDynamicMemory(void)                              // return true if error
+{
+    uint32_t DDC;
+    bool Result = false;
+//
+// first create the ring of DMA blocks
+// in the driver DMA buffer if asked, and DMA is synchronous (AIO needs user pages)
+//
+    if (UseDriverDMABuffer && (DDCAsyncDMADepth == 0) && (IQReadfile_fd >= 0)
+        && StreamRingCreateDMA(&DDCDMAData, VDDCDMARINGSIZE, IQReadfile_fd, "DDC DMA"))
+        printf("DDC DMA ring in the driver DMA buffer\n");
+    else if (!StreamRingCreate(&DDCDMAData, VDDCDMARINGSIZE, "DDC DMA"))
+    {
+        printf("I/Q read buffer allocation failed\n");
+        Result = true;
+    }
+    else
+        MetricsAddBufferBytes(eDDCMetrics, VDDCDMARINGSIZE);
+
+    //
+    // set up per-DDC data structures
+    // for AF_XDP transmit the packet rings are in the XDP UMEM, one frame per slot;
+    // otherwise each DDC gets its ring when it is first enabled (see UseDDCPacketRing())
+    //
+    if ((XDPInterface != NULL) && XDPTransmitOpen(&DDCXdp, XDPInterface, VNUMDDC * VDDCPACKETRING))
+    {
+        DDCXdpOpen = true;
+        DDCPacketStride = VXDPFRAMESIZE;
+        for (DDC = 0; DDC < VNUMDDC; DDC++)
+            DDCPacketRing[DDC] = DDCXdp.Umem + DDC * VDDCPACKETRING * VXDPFRAMESIZE + VXDPHEADROOM;
+        MetricsAddBufferBytes(eDDCMetrics, (int64_t)VNUMDDC * VDDCPACKETRING * VXDPFRAMESIZE);
+        return Result;
+    }
+    else if (XDPInterface != NULL)
+        printf("AF_XDP not available: DDC data sent by UDP sockets\n");
+    for (DDC = 0; DDC < VNUMDDC; DDC++)
+        DDCPacketRing[DDC] = NULL;
+    return Result;
+}
+
+
+//
+// initialise the packet slots for one DDC
+// all the header fields except sequence number are constant, so fill them in now
+// (for VITA-49, all except the header word and timestamps: the stream ID sits where P2 has the sequence number)
+//
+static void InitialiseDDCPacketHeaders(uint32_t DDC)
+{
+    uint32_t Slot;
+    uint8_t* Packet;
+
+    for (Slot = 0; Slot < VDDCPACKETRING; Slot++)
+    {
+        Packet = DDCPACKETSLOT(DDC, Slot);
+        memset(Packet, 0, VDDCHEADERSIZE);                              // clear sequence & timestamp data
+        if (DDCFormat == VDDCFORMATVITA49)
+            *(uint32_t*)Packet = htonl(VVITASTREAMIDBASE + DDC);        // stream ID
+        else
+        {
+            *(uint16_t*)(Packet + 12) = htons((DDCSampleBits[DDC] == 16) ? 16 : 24);  // bits per sample
+            *(uint16_t*)(Packet + 14) = htons(DDCFrameSamples);         // I/Q samples for ths frame
+        }
+    }
+}
+
+
+//
+// initialise one DDC for a new session: its packet headers if it has a ring yet, and its counts
+//
+void InitialiseDDCPacketRing(uint32_t DDC)
+{
+    if (DDCPacketRing[DDC] != NULL)
+        InitialiseDDCPacketHeaders(DDC);
+    SPSCInitialise(&DDCPacketIndex[DDC], VDDCPACKETRING);
+    IQWriteSlot[DDC] = 0;
+    DDCSampleCounter[DDC] = 0;                                          // 1st slot timestamp is 0
+    memset(DDCFloatTimeStamp[DDC], 0, sizeof(DDCFloatTimeStamp[DDC]));
+    DDCVitaSeconds[DDC] = 0;
+    DDCVitaFraction[DDC] = 0;
+    DDCTimeAnchorRate[DDC] = 0;
+    IQFillBytes[DDC] = 0;
+}
+
+
+//
+// a DDC is written to by the decode: give it a packet ring if it hasn't one
+// (decode thread only). DDCs that are never enabled then take no memory.
+// the ring is mapped on its own and locked, so it can be given back later
+//
+static void UseDDCPacketRing(uint32_t DDC)
+{
+    uint8_t* Ring;
+
+    DDCRingsInUse |= (1U << DDC);
+    if (DDCPacketRing[DDC] != NULL)
+        return;
+    Ring = AllocateLockedBuffer(VDDCRINGBYTES(DDCFrameSamples));
+    if (Ring == NULL)
+    {
+        printf("DDC %d packet ring allocation failed\n", DDC);
+        DDCRingError = true;
+        return;
+    }
+    DDCPacketRing[DDC] = Ring + VVITAPREFIX;                            // room below for a VITA-49 header
+    DDCRingBytes[DDC] = VDDCRINGBYTES(DDCFrameSamples);
+    DDCRingsAllocated |= (1U << DDC);
+    InitialiseDDCPacketHeaders(DDC);
+    MetricsAddBufferBytes(eDDCMetrics, DDCRingBytes[DDC]);
+}
+
+
+//
+// give back the packet ring of a DDC (socket path; not while it is being sent from)
+//
+static void ReleaseDDCPacketRing(uint32_t DDC)
+{
+    ReleaseLockedBuffer(DDCPacketRing[DDC] - VVITAPREFIX, DDCRingBytes[DDC]);
+    MetricsAddBufferBytes(eDDCMetrics, -(int64_t)DDCRingBytes[DDC]);
+    DDCPacketRing[DDC] = NULL;
+    DDCRingsAllocated &= ~(1U << DDC);
+    IQFillBytes[DDC] = 0;                                               // part packet went with it
+}
+
+
+//
+// note the DDCs that have stopped being written to, so their rings can be released later
+//
+static void NoteDDCRingsStopped(uint32_t Stopped)
+{
+    struct timespec Now;
+    uint32_t DDC;
+
+    if (Stopped == 0)
+        return;
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    for (DDC = 0; DDC < VNUMDDC; DDC++)
+        if (Stopped & (1U << DDC))
+            DDCRingLastUsed[DDC] = Now;
+}
+
+
+//
+// release the packet rings of DDCs not written to for VDDCRINGGRACE seconds (decode thread only)
+// by then the senders have long since sent every packet in them. Checked once a second.
+//
+static void ReleaseIdleDDCRings(void)
+{
+    static time_t LastCheck = 0;
+    struct timespec Now;
+    uint32_t DDC;
+
+    if (UseStandby || ((DDCRingsAllocated & ~DDCRingsInUse) == 0))
+        return;                                                         // standby keeps them all
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    if (Now.tv_sec == LastCheck)
+        return;
+    LastCheck = Now.tv_sec;
+    for (DDC = 0; DDC < VNUMDDC; DDC++)
+        if ((DDCRingsAllocated & ~DDCRingsInUse & (1U << DDC))
+            && (Now.tv_sec - DDCRingLastUsed[DDC].tv_sec >= VDDCRINGGRACE))
+        {
+            ReleaseDDCPacketRing(DDC);
+            if (UseDebug)
+                printf("DDC %d packet ring released: not used for %ds\n", DDC, VDDCRINGGRACE);
+        }
+}
+
+
+//
+// initialise the batch send data for one sender
+//
+void InitialiseDDCSender(struct DDCSenderData* Sender)
+{
+    uint32_t Cntr;
+
+    memset(Sender->SendIovec, 0, sizeof(Sender->SendIovec));
+    memset(Sender->SendBatch, 0, sizeof(Sender->SendBatch));
+    for (Cntr = 0; Cntr < VDDCMAXSENDS; Cntr++)
+    {
+        Sender->SendIovec[Cntr].iov_len = DDCPacketBytes;
+        Sender->SendBatch[Cntr].msg_hdr.msg_iov = &Sender->SendIovec[Cntr];
+        Sender->SendBatch[Cntr].msg_hdr.msg_iovlen = 1;
+        Sender->SendBatch[Cntr].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    }
+}
+
+
+void FreeDynamicMemory(void)
+{
+    uint32_t DDC;
+
+    StreamRingDestroy(&DDCDMAData);
+    //
+    // free the per-DDC buffers
+    //
+    for (DDC = 0; DDC < VNUMDDC; DDC++)
+        if (DDCFloatRing[DDC] != NULL)
+        {
+            ReleaseLockedBuffer(DDCFloatRing[DDC], DDCFloatRingBytes[DDC]);
+            DDCFloatRing[DDC] = NULL;
+        }
+    if (DDCXdpOpen)
+    {
+        XDPTransmitClose(&DDCXdp);
+        DDCXdpOpen = false;
+        return;
+    }
+    for (DDC = 0; DDC < VNUMDDC; DDC++)
+        if (DDCRingsAllocated & (1U << DDC))
+            ReleaseDDCPacketRing(DDC);
+}
+
+
+//
+// read the DDC FIFO depth, and report overflows
+// if interrupts are in use, the FIFO monitor threshold is set low to signal "data available"
+// so the over threshold bit can't be used to detect overflow: use the overflow bit instead
+//
+static uint32_t ReadDDCFIFODepth(bool UsingEvents)
+{
+    uint32_t Depth;
+    bool FIFOOverflow, FIFOUnderflow, FIFOOverThreshold;
+    unsigned int Current;                                   // current occupied locations in FIFO
+
+    STAGETRACE_START(TraceStart);
+    Depth = ReadFIFOMonitorChannel(eRXDDCDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);				// read the FIFO Depth register
+    STAGETRACE_END(TraceStart, "fifo read", Depth);
+    GDDCFIFODepth = Depth;
+    if(UsingEvents)
+        FIFOOverThreshold = FIFOOverflow;
+    if((StartupCount == 0) && FIFOOverThreshold)
+    {
+        __atomic_fetch_or(&GlobalFIFOOverflows, 0b00000001, __ATOMIC_RELAXED);
+        MetricsCountOverThreshold(eDDCMetrics);
+        if(UseDebug)
+            RINGLOG("RX DDC FIFO Overthreshold, depth now = %d\n", Current);
+    }
+// note this could often generate a message at low sample rate because we deliberately read it down to zero.
+// this isn't a problem as we can send the data on without the code becoming blocked. so not a useful trap.
+//    if((StartupCount == 0) && FIFOUnderflow)
+//         printf("RX DDC FIFO Underflowed, depth now = %d\n", Current);
+    return Depth;
+}
+
+
+//
+// wait until the DDC FIFO has at least MinDepth 64 bit words in it
+// if using interrupts: block on the events device. The poll has a timeout
+// so a missed interrupt just reverts to polled operation.
+// the FIFO monitor also interrupts on underflow, so a wakeup may not have enough data:
+// in that case back off briefly before waiting again.
+// returns the FIFO depth; returns early if the DMA thread is told to stop
+//
+static uint32_t WaitForDDCData(uint32_t MinDepth)
+{
+    uint32_t Depth;
+
+    Depth = ReadDDCFIFODepth(DDCEvent_fd >= 0);
+    //		printf("read: depth = %d\n", Depth);
+    while((Depth < MinDepth) && __atomic_load_n(&DDCProducerRun, __ATOMIC_ACQUIRE))
+    {
+        if(DDCEvent_fd >= 0)
+        {
+            if(WaitFIFOMonitorEvent(DDCEvent_fd, VDDCEVENTTIMEOUT))
+            {
+                Depth = ReadDDCFIFODepth(true);
+                if(Depth >= MinDepth)
+                    break;
+                usleep(VDDCEVENTBACKOFF);
+            }
+        }
+        else
+            usleep(500);								// 0.5ms wait
+        Depth = ReadDDCFIFODepth(DDCEvent_fd >= 0);
+    }
+    return Depth;
+}
+
+
+
+//
+// find the time in ns since a previous time
+//
+static uint64_t DDCElapsedNs(struct timespec* Then, struct timespec* Now)
+{
+    return (uint64_t)(Now->tv_sec - Then->tv_sec) * 1000000000ULL + Now->tv_nsec - Then->tv_nsec;
+}
+
+
+//
+// adaptive DMA size controller: find the FIFO depth (in 64 bit words) to wait for before the next DMA.
+// the fill rate is known two ways: the nominal rate from the rate word (that lags by up to a ring of
+// DMA blocks), and a smoothed rate measured from successive FIFO depth reads.
+// the larger is used, so neither a stale rate word nor a noisy measurement undersizes the DMA.
+// the FIFO depth to DMA at is the data that arrives in the target latency.
+// low rates get fewer, larger DMAs; high rates are capped at the largest DMA block.
+//
+static uint32_t DDCTargetDepth(void)
+{
+    uint64_t Rate;
+    uint64_t Words;
+
+    Rate = DDCNominalWordRate;
+    if(DDCMeasuredWordRate > Rate)
+        Rate = DDCMeasuredWordRate;
+    Words = (Rate * DDCTargetLatency) / 1000000ULL;
+    if(Words < VDDCMINDMASIZE/8U)
+        Words = VDDCMINDMASIZE/8U;
+    else if(Words > VDDCMAXDMASIZE/8U)
+        Words = VDDCMAXDMASIZE/8U;
+    return (uint32_t)Words;
+}
+
+
+//
+// update the measured fill rate.
+// the words that have arrived since the last DMA are the depth now less what was left after that DMA.
+// intervals that are very short are skipped: the depth read is too coarse to be useful.
+//
+static void UpdateDDCFillRate(uint32_t Depth, uint32_t DepthLeft, struct timespec* Then, struct timespec* Now)
+{
+    uint64_t Elapsed;
+    int64_t Measured;
+
+    Elapsed = DDCElapsedNs(Then, Now);
+    if((Elapsed < VDDCMINRATEPERIOD) || (Depth < DepthLeft))
+        return;
+    Measured = (int64_t)(((uint64_t)(Depth - DepthLeft) * 1000000000ULL) / Elapsed);
+    if(DDCMeasuredWordRate == 0)
+        DDCMeasuredWordRate = (uint32_t)Measured;
+    else
+        DDCMeasuredWordRate = (uint32_t)((int64_t)DDCMeasuredWordRate + (Measured - (int64_t)DDCMeasuredWordRate) / VDDCRATEFILTER);
+}
+
+
+//
+// place the next DMA block in the data ring, directly after the previous one
+// returns where to DMA it to
+//
+static uint8_t* ClaimDDCDMABlock(int32_t Slot, uint32_t Length)
+{
+    DDCDMABlockOffset[Slot] = DDCDMAWriteCount;
+    DDCDMAWriteCount += Length;
+    return DDCDMAData.Base + (DDCDMABlockOffset[Slot] & (DDCDMAData.Size - 1));
+}
+
+
+//
+// asynchronous DMA: the completed DMAs reaped so far are marked here, by slot
+//
+static bool DDCDMAComplete[VDDCDMABLOCKS];
+static uint32_t DDCDMAPending;                              // DMAs submitted, not yet published
+static uint32_t DDCDMAWordsInFlight;                        // FIFO words asked for by DMAs not yet reaped
+
+
+//
+// reap completed asynchronous DMAs, then publish the completed blocks in submit order
+//
+static void ReapDDCDMA(struct AsyncDMAQueue* Queue, uint32_t TimeoutUs)
+{
+    struct AsyncDMACompletion Done[VMAXASYNCDMA];
+    uint32_t Count, Cntr;
+    int32_t Slot;
+
+    Count = PollAsyncDMA(Queue, Done, VMAXASYNCDMA, TimeoutUs);
+    for(Cntr = 0; Cntr < Count; Cntr++)
+    {
+        Slot = (int32_t)(intptr_t)Done[Cntr].Tag;
+        if(Done[Cntr].Result < 0)
+            RINGLOG("DDC async DMA failed, %lld\n", (long long)Done[Cntr].Result);
+        DDCDMAWordsInFlight -= DDCDMABlockLength[Slot] / 8U;
+        DDCDMAComplete[Slot] = true;
+    }
+    while((DDCDMAPending != 0) && ((Slot = SPSCGetWriteSlot(&DDCDMARing)) >= 0) && DDCDMAComplete[Slot])
+    {
+        DDCDMAComplete[Slot] = false;
+        DDCDMAPending--;
+        SPSCPublish(&DDCDMARing);
+        sem_post(&DDCBlockAvailable);
+        GDDCDMABlockCount++;
+        GDDCDMABytes += DDCDMABlockLength[Slot];
+        MetricsRecordDMA(eDDCMetrics, DDCDMABlockLength[Slot], DDCDMABlockDepth[Slot]);
+    }
+}
+
+
+//
+// DMA loop using asynchronous DMA: keeps up to Queue->Depth DMAs in flight, so a DMA
+// overlaps the decode and send of the blocks before it.
+// each DMA is sized from the FIFO depth less the words already asked for by DMAs in flight,
+// so between them they never ask for more than the FIFO holds. Returns when told to stop,
+// after the DMAs in flight have completed.
+//
+static void RunAsyncDDCDMA(struct AsyncDMAQueue* Queue, uint32_t* EventDepth)
+{
+    uint32_t DMATransferSize;
+    uint32_t Depth, Available;
+    uint32_t MinDepth;
+    uint32_t UnrequestedLeft = 0;                               // FIFO words not asked for after the last submit
+    bool RateValid = false;
+    struct timespec PrevTime, Now;
+    struct timespec LoopStart;
+    uint32_t Occupancy;
+    int32_t Slot;
+    uint8_t* BlockPtr;
+    struct AsyncDMACompletion Drained[VMAXASYNCDMA];
+
+    memset(DDCDMAComplete, 0, sizeof(DDCDMAComplete));
+    DDCDMAPending = 0;
+    DDCDMAWordsInFlight = 0;
+    while(__atomic_load_n(&DDCProducerRun, __ATOMIC_SEQ_CST))        // (after Busy set: see handshake)
+    {
+        ReapDDCDMA(Queue, 0);
+        Slot = (DDCDMAPending < Queue->Depth) ? SPSCGetWriteSlotAhead(&DDCDMARing, DDCDMAPending) : -1;
+        if(Slot < 0)
+        {
+            if(DDCDMAPending == 0)
+            {
+                GDDCRingFullStalls++;
+                usleep(VDDCSTALLSLEEP);
+            }
+            else
+                ReapDDCDMA(Queue, VDDCASYNCWAIT);
+            continue;
+        }
+        MinDepth = DDCTargetDepth();
+        if((DDCEvent_fd >= 0) && (MinDepth != *EventDepth))
+        {
+            SetupFIFOMonitorThreshold(eRXDDCDMA, MinDepth, true);
+            *EventDepth = MinDepth;
+        }
+        //
+        // with nothing in flight, wait for data as the blocking loop does;
+        // else if there isn't enough yet, wait for the next DMA to complete instead
+        //
+        if(DDCDMAPending == 0)
+            Depth = WaitForDDCData(MinDepth);
+        else
+            Depth = ReadDDCFIFODepth(DDCEvent_fd >= 0);
+        if(!__atomic_load_n(&DDCProducerRun, __ATOMIC_ACQUIRE))
+            break;
+        Available = (Depth > DDCDMAWordsInFlight) ? Depth - DDCDMAWordsInFlight : 0;
+        if(Available < MinDepth)
+        {
+            ReapDDCDMA(Queue, VDDCASYNCWAIT);
+            continue;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &Now);
+        LoopStart = Now;
+        if(RateValid)
+            UpdateDDCFillRate(Available, UnrequestedLeft, &PrevTime, &Now);
+        PrevTime = Now;
+        RateValid = true;
+        DMATransferSize = Available * 8U;
+        if(DMATransferSize > VDDCMAXDMASIZE)
+            DMATransferSize = VDDCMAXDMASIZE;
+        DMATransferSize &= ~(VDDCDMAGRANULE - 1U);
+        UnrequestedLeft = Available - DMATransferSize/8U;
+
+        DDCDMABlockLength[Slot] = DMATransferSize;
+        DDCDMABlockDepth[Slot] = Depth;
+        DDCDMABlockTime[Slot] = Now;
+        STAGETRACE_START(TraceStart);
+        BlockPtr = ClaimDDCDMABlock(Slot, DMATransferSize);
+        if(SubmitAsyncDMARead(Queue, BlockPtr, DMATransferSize,
+                              VADDRDDCSTREAMREAD, (void*)(intptr_t)Slot) == 0)
+            DDCDMAWordsInFlight += DMATransferSize/8U;
+        else
+        {
+            StreamRingDMARead(&DDCDMAData, IQReadfile_fd, BlockPtr, DMATransferSize, VADDRDDCSTREAMREAD);
+            DDCDMAComplete[Slot] = true;
+        }
+        STAGETRACE_END(TraceStart, "dma submit", DMATransferSize);
+        DDCDMAPending++;
+        MetricsRecordLoopTime(eDDCMetrics, &LoopStart);
+        Occupancy = SPSCOccupancy(&DDCDMARing) + DDCDMAPending;
+        if(Occupancy > GDDCRingMaxOccupancy)
+            GDDCRingMaxOccupancy = Occupancy;
+    }
+    //
+    // let the DMAs in flight finish before the ring is reused. they are not published
+    //
+    while(Queue->InFlight != 0)
+        if(PollAsyncDMA(Queue, Drained, VMAXASYNCDMA, VDDCASYNCWAIT * 10) == 0)
+            break;
+}
+
+
+
+//
+// DMA thread: this is the "producer" for DDC data.
+// waits for FIFO data, then DMAs it into the next free block of the DMA block ring.
+// the send thread decodes and sends the block, then releases it back.
+// this way a slow send doesn't delay the next DMA.
+// if the ring is full, the send thread is the bottleneck: count it, and wait.
+// if DDCAsyncDMADepth is set, DMAs are submitted asynchronously, several in flight.
+//
+void *DDCDMAProducer(__attribute__((unused)) void *arg)
+{
+    uint32_t DMATransferSize;
+    uint32_t Depth;
+    uint32_t MinDepth;                                          // FIFO depth needed before DMA
+    uint32_t EventDepth = 0;                                    // FIFO monitor interrupt threshold set
+    uint32_t DepthLeft = 0;                                     // FIFO depth left after the last DMA
+    bool RateValid;                                             // true if a previous depth read to measure from
+    struct timespec PrevTime, Now;
+    struct timespec LoopStart;                                  // time DMA work started, for metrics
+    uint32_t Occupancy;
+    int32_t Slot;
+    struct AsyncDMAQueue AsyncQueue;
+    bool UseAsyncDMA = false;
+
+    struct sched_param SchedParam;
+
+    if(UseRealtimeDMA)
+    {
+        SchedParam.sched_priority = VDDCDMAPRIORITY;
+        if(pthread_setschedparam(pthread_self(), SCHED_FIFO, &SchedParam) != 0)
+            printf("DDC DMA thread: could not set SCHED_FIFO priority (needs root or CAP_SYS_NICE)\n");
+        else
+            printf("DDC DMA thread running SCHED_FIFO, priority %d\n", VDDCDMAPRIORITY);
+    }
+    printf("spinning up DDC DMA thread, pid=%ld\n", syscall(SYS_gettid));
+    if(DDCAsyncDMADepth != 0)
+    {
+        if(DDCAsyncDMADepth > VDDCMAXASYNCDMA)
+            DDCAsyncDMADepth = VDDCMAXASYNCDMA;
+        UseAsyncDMA = !OpenAsyncDMA(&AsyncQueue, IQReadfile_fd, DDCAsyncDMADepth);
+        if(UseAsyncDMA)
+            printf("DDC DMA thread: %d asynchronous DMAs in flight\n", DDCAsyncDMADepth);
+        else
+            printf("DDC DMA thread: asynchronous DMA not available, using blocking DMA\n");
+    }
+    while(!__atomic_load_n(&DDCProducerExit, __ATOMIC_ACQUIRE))
+    {
+        __atomic_store_n(&DDCProducerBusy, false, __ATOMIC_RELEASE);
+        while(!__atomic_load_n(&DDCProducerRun, __ATOMIC_ACQUIRE) && !__atomic_load_n(&DDCProducerExit, __ATOMIC_ACQUIRE))
+            sem_wait(&DDCProducerWake);
+        if(__atomic_load_n(&DDCProducerExit, __ATOMIC_ACQUIRE))
+            break;
+        __atomic_store_n(&DDCProducerBusy, true, __ATOMIC_SEQ_CST);
+        DDCMeasuredWordRate = 0;
+        RateValid = false;
+        if(UseAsyncDMA)
+            RunAsyncDDCDMA(&AsyncQueue, &EventDepth);
+        while(__atomic_load_n(&DDCProducerRun, __ATOMIC_SEQ_CST))     // (after Busy set: see handshake)
+        {
+            Slot = SPSCGetWriteSlot(&DDCDMARing);
+            if(Slot < 0)
+            {
+                GDDCRingFullStalls++;
+                usleep(VDDCSTALLSLEEP);
+                continue;
+            }
+            //
+            // wait for the depth the size controller asks for. If using interrupts,
+            // move the FIFO monitor threshold to match so it interrupts at that depth.
+            // then DMA everything waiting (up to a DMA block) so a backlog is cleared at once
+            //
+            MinDepth = DDCTargetDepth();
+            if((DDCEvent_fd >= 0) && (MinDepth != EventDepth))
+            {
+                SetupFIFOMonitorThreshold(eRXDDCDMA, MinDepth, true);
+                EventDepth = MinDepth;
+            }
+            Depth = WaitForDDCData(MinDepth);
+            if(!__atomic_load_n(&DDCProducerRun, __ATOMIC_ACQUIRE))
+                break;
+            clock_gettime(CLOCK_MONOTONIC, &Now);
+            LoopStart = Now;
+            if(RateValid)
+                UpdateDDCFillRate(Depth, DepthLeft, &PrevTime, &Now);
+            PrevTime = Now;
+            RateValid = true;
+            DMATransferSize = Depth * 8U;                       // 8 bytes per location
+            if(DMATransferSize > VDDCMAXDMASIZE)
+                DMATransferSize = VDDCMAXDMASIZE;
+            DMATransferSize &= ~(VDDCDMAGRANULE - 1U);
+            DepthLeft = Depth - DMATransferSize/8U;
+//            printf("DDC DMA read %d bytes from destination to base\n", DMATransferSize);
+
+            STAGETRACE_START(TraceStart);
+            StreamRingDMARead(&DDCDMAData, IQReadfile_fd, ClaimDDCDMABlock(Slot, DMATransferSize),
+                              DMATransferSize, VADDRDDCSTREAMREAD);
+            STAGETRACE_DMA(IQReadfile_fd);
+            STAGETRACE_END(TraceStart, "dma", DMATransferSize);
+            DDCDMABlockLength[Slot] = DMATransferSize;
+            DDCDMABlockDepth[Slot] = Depth;
+            DDCDMABlockTime[Slot] = Now;
+            SPSCPublish(&DDCDMARing);
+            sem_post(&DDCBlockAvailable);
+            GDDCDMABlockCount++;
+            GDDCDMABytes += DMATransferSize;
+            MetricsRecordDMA(eDDCMetrics, DMATransferSize, Depth);
+            MetricsRecordLoopTime(eDDCMetrics, &LoopStart);
+            Occupancy = SPSCOccupancy(&DDCDMARing);
+            if(Occupancy > GDDCRingMaxOccupancy)
+                GDDCRingMaxOccupancy = Occupancy;
+        }
+    }
+    if(UseAsyncDMA)
+        CloseAsyncDMA(&AsyncQueue);
+    __atomic_store_n(&DDCProducerBusy, false, __ATOMIC_RELEASE);
+    printf("shutting down DDC DMA thread\n");
+    return NULL;
+}
+
+
+static bool SendDDCPackets(struct DDCSenderData* Sender, uint32_t DDC);
+static void ReapDDCXdp(void);
+
+
+//
+// true if a DDC carries a PureSignal feedback pair
+//
+static inline bool IsPureSignalDDC(uint32_t DDC)
+{
+    return DDCInterleaved[DDC] && ((GetDDCADC(DDC) == eTXSamples) || (GetDDCADC(DDC + 1) == eTXSamples));
+}
+
+
+uint32_t GetDDCSheddableMask(void)
+{
+    uint32_t InUse = __atomic_load_n(&DDCRingsInUse, __ATOMIC_RELAXED);
+    uint32_t Mask = 0;
+    uint32_t DDC;
+
+    for (DDC = 0; DDC < VNUMDDC; DDC++)
+        if ((InUse & (1U << DDC)) && !IsPureSignalDDC(DDC))
+            Mask |= (1U << DDC);
+    return Mask;
+}
+
+
+static void AdvanceDDCPacketSlot(uint32_t DDC);
+
+
+//
+// decimate up to a standard packet of samples of a source DDC into the target DDCs it feeds
+// the output is a fraction of a packet, so fill the target slot and advance it when full
+//
+static void RunDDCDecimations(uint32_t DDC, const uint8_t* Samples, uint32_t SampleCount)
+{
+    uint8_t Decimated[VIQBYTESPERFRAME];
+    struct DDCDecimation* Decimation;
+    uint32_t Cntr, Count, Target, SlotSamples;
+    uint8_t* SrcPtr;
+
+    for (Cntr = 0; Cntr < DDCDecimationCount; Cntr++)
+    {
+        Decimation = &DDCDecimations[Cntr];
+        if (!Decimation->Active || (Decimation->Source != DDC))
+            continue;
+        Target = Decimation->Target;
+        Count = RunDecimator(&Decimation->Filter, Samples, SampleCount, Decimated);
+        SrcPtr = Decimated;
+        while (Count != 0)
+        {
+            SlotSamples = (DDCFrameBytes - IQFillBytes[Target]) / 6;
+            if (SlotSamples > Count)
+                SlotSamples = Count;
+            memcpy(DDCPACKETSLOT(Target, IQWriteSlot[Target]) + VDDCHEADERSIZE + IQFillBytes[Target],
+                   SrcPtr, 6 * SlotSamples);
+            SrcPtr += 6 * SlotSamples;
+            IQFillBytes[Target] += 6 * SlotSamples;
+            Count -= SlotSamples;
+            if (IQFillBytes[Target] == DDCFrameBytes)
+                AdvanceDDCPacketSlot(Target);
+        }
+    }
+}
+
+
+//
+// pass a full slot's samples to the recorder, shared memory export, channelizers and
+// decimations that use the DDC. They take at most a standard packet of samples at a
+// time, so a jumbo slot is passed in pieces, each with the stream index of its 1st sample
+//
+static void PassDDCSlotSamples(uint32_t DDC)
+{
+    const uint8_t* Samples = DDCPACKETSLOT(DDC, IQWriteSlot[DDC]) + VDDCHEADERSIZE;
+    uint32_t Offset, Count;
+
+    for (Offset = 0; Offset < DDCFrameSamples; Offset += Count, Samples += 6 * Count)
+    {
+        Count = DDCFrameSamples - Offset;
+        if (Count > VIQSAMPLESPERFRAME)
+            Count = VIQSAMPLESPERFRAME;
+        if (__atomic_load_n(&GIQRecordMask, __ATOMIC_RELAXED) & (1 << DDC))
+            RecordIQPacket(DDC, Samples, Count, DDCSampleCounter[DDC] + Offset, DDCSampleRate[DDC]);
+        if (GDDCShmMask & (1 << DDC))
+            ExportDDCPacket(DDC, Samples, Count, DDCSampleCounter[DDC] + Offset, DDCSampleRate[DDC]);
+        if (GChannelizerMask & (1 << DDC))
+            QueueChannelizerPacket(DDC, Samples, Count, DDCSampleRate[DDC]);
+        if (DDCDecimationSources & (1 << DDC))
+            RunDDCDecimations(DDC, Samples, Count);
+    }
+}
+
+
+//
+// wall clock timestamp for the write slot: the time of its 1st sample, ns since 1970
+// (UseWallClockTimestamps), so the streams of several radios can be lined up by a receiver
+// such as sw_tools/aggregator. The clock is read once, at the 1st packet of the session;
+// after that the time follows the sample count, so it doesn't jitter with the DMA.
+// a rate change re-anchors at the current time of the count. Without a PPS input the
+// times of different radios agree only as well as their clocks (use PTP) and DMA latency.
+// with alignment timestamps (GEnableAlignmentTimestamps, set by the client) the anchor is
+// the time the samples entered the FIFO instead: the DMA time of the block being decoded,
+// less the time its FIFO depth took to fill. The mic stream is anchored the same way, so a
+// client can line up mic and DDC samples to within about one DMA block.
+//
+static uint64_t GetDDCAnchoredTime(uint32_t DDC, uint64_t Count)
+{
+    uint64_t Delta = Count - DDCTimeAnchorCount[DDC];
+    uint32_t Rate = DDCTimeAnchorRate[DDC];
+
+    return DDCTimeAnchorNs[DDC] + (Delta / Rate) * 1000000000ULL + ((Delta % Rate) * 1000000000ULL) / Rate;
+}
+
+
+//
+// wall clock time the 1st word of a DMA block entered the FIFO: the DMA time, moved from
+// the monotonic to the realtime clock, less the FIFO depth at the measured word rate
+// (the depth is not allowed for until the rate has been measured)
+//
+static uint64_t GetDDCBlockEntryTime(uint32_t Slot)
+{
+    struct timespec Mono, Real;
+    int64_t Ns;
+
+    clock_gettime(CLOCK_MONOTONIC, &Mono);
+    clock_gettime(CLOCK_REALTIME, &Real);
+    Ns = (int64_t)Real.tv_sec * 1000000000LL + Real.tv_nsec
+         - ((int64_t)(Mono.tv_sec - DDCDMABlockTime[Slot].tv_sec) * 1000000000LL + (Mono.tv_nsec - DDCDMABlockTime[Slot].tv_nsec));
+    if(DDCMeasuredWordRate != 0)
+        Ns -= ((int64_t)DDCDMABlockDepth[Slot] * 1000000000LL) / DDCMeasuredWordRate;
+    return (uint64_t)Ns;
+}
+
+
+static uint64_t GetDDCWallClockTime(uint32_t DDC)
+{
+    struct timespec Now;
+    uint32_t Rate = DDCSampleRate[DDC];
+
+    if (Rate == 0)
+        return 0;
+    if (Rate != DDCTimeAnchorRate[DDC])
+    {
+        if ((DDCTimeAnchorRate[DDC] == 0) && GEnableAlignmentTimestamps && (DDCDecodeBlockNs != 0))
+            DDCTimeAnchorNs[DDC] = DDCDecodeBlockNs;
+        else if (DDCTimeAnchorRate[DDC] == 0)
+        {
+            clock_gettime(CLOCK_REALTIME, &Now);
+            DDCTimeAnchorNs[DDC] = (uint64_t)Now.tv_sec * 1000000000ULL + (uint64_t)Now.tv_nsec;
+        }
+        else
+            DDCTimeAnchorNs[DDC] = GetDDCAnchoredTime(DDC, DDCSampleCounter[DDC]);
+        DDCTimeAnchorCount[DDC] = DDCSampleCounter[DDC];
+        DDCTimeAnchorRate[DDC] = Rate;
+    }
+    return GetDDCAnchoredTime(DDC, DDCSampleCounter[DDC]);
+}
+
+
+//
+// pass the full packet slot for a DDC to the sender, and get the next one
+// if a sender thread has fallen behind so that the ring is full, wait for it.
+// (without sender threads this can't happen: all slots are sent after every DMA block)
+//
+static void AdvanceDDCPacketSlot(uint32_t DDC)
+{
+    int32_t Slot;
+    uint64_t TimeStamp;                                     // big endian timestamp for packet header
+    uint32_t Seconds;                                       // big endian VITA-49 integer timestamp
+    bool PureSignal;
+    bool TXState;
+    bool Scanned;                                           // DDC retuned by an on-device scan
+    uint8_t ScanStep = 0;
+
+    PureSignal = (DDCFormat != VDDCFORMATVITA49) && IsPureSignalDDC(DDC);
+    TXState = __atomic_load_n(&MOXAsserted, __ATOMIC_RELAXED);
+    if (PureSignal && (TXState != DDCSlotTXState[DDC]))
+        *(DDCPACKETSLOT(DDC, IQWriteSlot[DDC]) + 4) |= VDDCTSTXCHANGED;   // timestamp top byte
+    Scanned = (DDCFormat != VDDCFORMATVITA49) && !PureSignal && (GDDCScanMask & (1 << DDC));
+    if (Scanned)
+    {
+        ScanStep = GetDDCScanStep(DDC);
+        if (ScanStep != DDCSlotScanStep[DDC])
+            *(DDCPACKETSLOT(DDC, IQWriteSlot[DDC]) + 4) |= VDDCTSSCANCHANGED;
+    }
+    if ((__atomic_load_n(&GIQRecordMask, __ATOMIC_RELAXED) | GDDCShmMask | GChannelizerMask | DDCDecimationSources) & (1 << DDC))
+        PassDDCSlotSamples(DDC);
+    //
+    // overload: a shed DDC's slot is not published, so it is filled again. PureSignal
+    // pairs are never shed: the client needs every feedback sample
+    //
+    if ((__atomic_load_n(&GOverloadDDCShedMask, __ATOMIC_RELAXED) & (1 << DDC)) && !IsPureSignalDDC(DDC))
+    {
+        __atomic_add_fetch(&DDCShedSequence[DDC], ((DDCFormat != VDDCFORMATVITA49) && (DDCSampleBits[DDC] == 32)) ? 2 : 1,
+                           __ATOMIC_RELAXED);
+        GDDCShedPackets++;
+    }
+    else
+        SPSCPublish(&DDCPacketIndex[DDC]);
+    IQFillBytes[DDC] = 0;
+    if(StartupCount != 0)                                   // decrement startup message count
+        StartupCount--;
+    Slot = SPSCGetWriteSlot(&DDCPacketIndex[DDC]);
+    while(Slot < 0)
+    {
+        GDDCSlotStalls++;
+        if(DDCSenderCount == 0)
+            SendDDCPackets(&DDCSenders[0], DDC);
+        else if(DDCUseXDP)
+        {
+            ReapDDCXdp();                                   // slots are freed by transmit completion
+            usleep(VDDCSLOTSTALLSLEEP);
+        }
+        else
+            usleep(VDDCSLOTSTALLSLEEP);
+        Slot = SPSCGetWriteSlot(&DDCPacketIndex[DDC]);
+    }
+    IQWriteSlot[DDC] = (uint32_t)Slot;
+    //
+    // timestamp: if enabled by the client, the timestamp field holds the number of samples
+    // this DDC has sent before the 1st sample of the packet. Every packet has the same number
+    // of samples, so it is set once per packet here, not in the sample copy.
+    // there's no FPGA PPS or timestamp input yet, so it counts from stream start;
+    // samples lost in a FIFO reset are not counted.
+    //
+    DDCSampleCounter[DDC] += DDCFrameSamples;
+    if (DDCFormat != VDDCFORMATVITA49)
+    {
+        if ((UseWallClockTimestamps || GEnableAlignmentTimestamps) && !PureSignal && !Scanned)
+            TimeStamp = htobe64(GetDDCWallClockTime(DDC));
+        else
+            TimeStamp = (GEnableTimeStamping || PureSignal || Scanned) ? htobe64(DDCSampleCounter[DDC]) : 0;
+        memcpy(DDCPACKETSLOT(DDC, Slot) + 4, &TimeStamp, sizeof(TimeStamp));
+        DDCSlotTXState[DDC] = TXState;
+        if (PureSignal && TXState)
+            *(DDCPACKETSLOT(DDC, Slot) + 4) |= VDDCTSTXACTIVE;
+        DDCSlotScanStep[DDC] = ScanStep;
+        if (Scanned)
+            *(DDCPACKETSLOT(DDC, Slot) + 4) |= ScanStep;
+        //
+        // float: the 2nd packet of the slot starts DDCFloatSamples later
+        // (a sample count keeps the flags in its top byte)
+        //
+        if ((DDCSampleBits[DDC] == 32) && (TimeStamp != 0))
+        {
+            memcpy(&TimeStamp, DDCPACKETSLOT(DDC, Slot) + 4, sizeof(TimeStamp));
+            if ((UseWallClockTimestamps || GEnableAlignmentTimestamps) && !PureSignal && !Scanned)
+                TimeStamp = htobe64(GetDDCAnchoredTime(DDC, DDCSampleCounter[DDC] + DDCFloatSamples));
+            else
+                TimeStamp = htobe64(be64toh(TimeStamp) + DDCFloatSamples);
+        }
+        DDCFloatTimeStamp[DDC][Slot] = TimeStamp;
+        return;
+    }
+    //
+    // VITA-49 timestamps are always sent: seconds, and the sample count within the second.
+    // kept as a running count so there is no division per packet
+    //
+    DDCVitaFraction[DDC] += DDCFrameSamples;
+    while ((DDCSampleRate[DDC] != 0) && (DDCVitaFraction[DDC] >= DDCSampleRate[DDC]))
+    {
+        DDCVitaFraction[DDC] -= DDCSampleRate[DDC];
+        DDCVitaSeconds[DDC]++;
+    }
+    Seconds = htonl(DDCVitaSeconds[DDC]);
+    TimeStamp = htobe64(DDCVitaFraction[DDC]);
+    memcpy(DDCPACKETSLOT(DDC, Slot) + 4, &Seconds, sizeof(Seconds));
+    memcpy(DDCPACKETSLOT(DDC, Slot) + 8, &TimeStamp, sizeof(TimeStamp));
+}
+
+
+//
+// test whether a DMA buffer location holds a DDC rate word header
+// the top byte of the 64 bit word is 0x80
+//
+static inline bool IsDDCHeader(uint8_t* Ptr)
+{
+    return (*(Ptr + 7) == 0x80);
+}
+
+
+//
+// search for a DDC frame header, from HeaderSearchStart bytes above DMAReadPtr.
+// a candidate is only accepted if the frame after it also starts with a header,
+// or if that frame isn't in the buffer yet. That way a sample that happens to look
+// like a header is not taken as one, nor is a candidate that isn't a valid rate word.
+// returns true if found, with DMAReadPtr pointing to it.
+// the bytes skipped are counted if this is a resync, not the start of the stream.
+//
+static bool FindDDCHeader(bool Resync)
+{
+    uint32_t Offset;
+    uint32_t NextFrame;
+    uint32_t FrameLength;
+    uint32_t Counts[VNUMDDC];
+    uint32_t Length = DMAHeadPtr - DMAReadPtr;
+
+    for (Offset = HeaderSearchStart; Offset + 8 <= Length; Offset += 8)
+    {
+        if (!IsDDCHeader(DMAReadPtr + Offset))
+            continue;
+        FrameLength = AnalyseDDCHeader(*(uint32_t*)(DMAReadPtr + Offset), Counts);
+        if (FrameLength == VDDCHEADERINVALID)
+            continue;
+        NextFrame = Offset + (FrameLength + 1) * 8;
+        if ((NextFrame + 8 <= Length) && !IsDDCHeader(DMAReadPtr + NextFrame))
+            continue;
+        if (Resync)
+        {
+            GDDCResyncBytes += Offset;
+            RINGLOG("DDC stream resynchronised, %d bytes discarded\n", Offset);
+        }
+        DMAReadPtr += Offset;
+        return true;
+    }
+    if (Resync)
+        GDDCResyncBytes += Length;
+    return false;
+}
+
+
+//
+// decode one DDC frame into the packet slots using the current frame plan
+// SamplePtr points to the 1st location past the rate word
+// only the DDCs active in the frame plan are visited
+//
+static inline void DecodeDDCFrame(uint8_t* SamplePtr)
+{
+    uint8_t* SrcPtr;                                            // sample read pointer
+    uint8_t* DestPtr;                                           // write pointer into packet slot
+    uint32_t Samples;                                           // samples for one DDC in one frame
+    uint32_t SlotSamples;                                       // samples that will fit in current packet slot
+    uint32_t Entry;                                             // active DDC entry in frame plan
+    uint32_t DDC;
+
+    for (Entry = 0; Entry < FramePlan->ActiveDDCs; Entry++)
+    {
+        DDC = FramePlan->DDC[Entry];
+        SrcPtr = SamplePtr + FramePlan->Offset[Entry];              // 1st sample for this DDC
+        Samples = FramePlan->Count[Entry];                          // number of words for this DDC
+        //
+        // usual case: all the samples fit in the current slot, so one straight copy
+        // a single sample (48KHz) is copied inline rather than calling the unpack kernel
+        //
+        if (IQFillBytes[DDC] + 6 * Samples < DDCFrameBytes)
+        {
+            DestPtr = DDCPACKETSLOT(DDC, IQWriteSlot[DDC]) + VDDCHEADERSIZE + IQFillBytes[DDC];
+            if (Samples == 1)
+                memcpy(DestPtr, SrcPtr, 6);
+            else
+                UnpackDDCSamples(DestPtr, SrcPtr, Samples);
+            IQFillBytes[DDC] += 6 * Samples;
+            continue;
+        }
+        while (Samples != 0)
+        {
+            //
+            // find how many samples fit in the current slot; they may straddle two packets
+            //
+            SlotSamples = (DDCFrameBytes - IQFillBytes[DDC]) / 6;
+            if (SlotSamples > Samples)
+                SlotSamples = Samples;
+            UnpackDDCSamples(DDCPACKETSLOT(DDC, IQWriteSlot[DDC]) + VDDCHEADERSIZE + IQFillBytes[DDC],
+                             SrcPtr, SlotSamples);
+            SrcPtr += 8 * SlotSamples;                              // 8 bytes per sample in
+            IQFillBytes[DDC] += 6 * SlotSamples;                    // 6 bytes per sample out
+            Samples -= SlotSamples;
+            if (IQFillBytes[DDC] == DDCFrameBytes)                  // slot full: move to next
+                AdvanceDDCPacketSlot(DDC);
+        }
+    }
+}
+
+
+//
+// note which DDCs are interleaved with the next from a new rate word (rate code 7, as AnalyseDDCHeader)
+// a DDC that has just become interleaved may have an odd number of samples in its packet
+// (eg it was at 48KHz, one sample per frame): pad one zero sample so the pairs that follow
+// don't straddle packets, with the RX and TX samples of a PureSignal pair swapped.
+//
+static void UpdateDDCInterleave(uint32_t RateWord)
+{
+    uint32_t DDC;
+    bool Interleaved;
+
+    for (DDC = 0; DDC < VNUMDDC; DDC++)
+    {
+        Interleaved = ((RateWord >> (3 * DDC)) & 7) == eInterleaveWithNext;
+        if (Interleaved && !DDCInterleaved[DDC] && ((IQFillBytes[DDC] / 6) & 1))
+        {
+            memset(DDCPACKETSLOT(DDC, IQWriteSlot[DDC]) + VDDCHEADERSIZE + IQFillBytes[DDC], 0, 6);
+            IQFillBytes[DDC] += 6;
+            GDDCPureSignalPads++;
+            if (IQFillBytes[DDC] == DDCFrameBytes)
+                AdvanceDDCPacketSlot(DDC);
+        }
+        DDCInterleaved[DDC] = Interleaved;
+        if (Interleaved)
+        {
+            DDC++;                                              // next DDC is carried by this one
+            if (DDC < VNUMDDC)
+                DDCInterleaved[DDC] = false;
+        }
+    }
+}
+
+
+//
+// find which software decimations run with a new frame plan, and their output rates
+// a decimation that starts, or whose source rate changes, starts from a clear filter
+//
+static void UpdateDDCDecimations(void)
+{
+    uint32_t Cntr, Entry;
+    uint32_t Enabled = 0;                                       // DDCs in the frame plan
+    struct DDCDecimation* Decimation;
+    bool Active;
+
+    for (Entry = 0; Entry < FramePlan->ActiveDDCs; Entry++)
+        Enabled |= (1U << FramePlan->DDC[Entry]);
+    DDCDecimationSources = 0;
+    for (Cntr = 0; Cntr < DDCDecimationCount; Cntr++)
+    {
+        Decimation = &DDCDecimations[Cntr];
+        Active = (Enabled & (1U << Decimation->Source)) && !(Enabled & (1U << Decimation->Target))
+                 && !DDCInterleaved[Decimation->Source];
+        if (Active && (!Decimation->Active || (Decimation->SourceRate != DDCSampleRate[Decimation->Source])))
+        {
+            ResetDecimator(&Decimation->Filter);
+            Decimation->SourceRate = DDCSampleRate[Decimation->Source];
+            DDCSampleRate[Decimation->Target] = Decimation->SourceRate / Decimation->Filter.Factor;
+            IQFillBytes[Decimation->Target] = 0;                // any part packet was at the old rate
+        }
+        else if (!Active && Decimation->Active)
+            IQFillBytes[Decimation->Target] = 0;                // drop the part packet of derived samples
+        Decimation->Active = Active;
+        if (Active)
+        {
+            DDCDecimationSources |= (1U << Decimation->Source);
+            UseDDCPacketRing(Decimation->Target);
+        }
+    }
+}
+
+
+//
+// set up the decode for a new rate word: frame plan, DMA size controller rate,
+// per-DDC sample rates and interleaving
+// returns false if the rate word isn't valid: the decode is left as it was, except
+// that the next rate word is planned whatever it is
+//
+static bool PlanDDCFrames(uint32_t RateWord)
+{
+    const struct DDCFramePlan* Plan;
+    uint32_t Entry;                                             // frame plan entry
+    uint32_t PrevRingsInUse = DDCRingsInUse;
+
+    Plan = GetDDCFramePlan(RateWord);
+    if (Plan == NULL)
+    {
+        PrevRateWord = 0xFFFFFFFF;                              // not a valid rate word: never matches
+        return false;
+    }
+    FramePlan = Plan;
+//    printf("new framelength = %d\n", FramePlan->FrameLength);
+    PrevRateWord = RateWord;                                    // so so we know its analysed
+    DDCNominalWordRate = (FramePlan->FrameLength + 1) * VDDCFRAMERATE;   // tell DMA size controller
+    DDCRingsInUse = 0;
+    for (Entry = 0; Entry < FramePlan->ActiveDDCs; Entry++)
+    {
+        DDCSampleRate[FramePlan->DDC[Entry]] = FramePlan->Count[Entry] * VDDCFRAMERATE;
+        UseDDCPacketRing(FramePlan->DDC[Entry]);
+    }
+    UpdateDDCInterleave(RateWord);
+    UpdateDDCDecimations();
+    NoteDDCRingsStopped(PrevRingsInUse & ~DDCRingsInUse);
+    return true;
+}
+
+
+//
+// decode DDC frames between DMAReadPtr and DMAHeadPtr into the packet slots
+// according to the embedded DDC rate words
+// the 1st word is pointed by DMAReadPtr and it should point to a DDC rate word
+// (it should always be left in that state).
+// the top half of the 1st 64 bit word should be 0x8000
+// and that is located in the 2nd 32 bit location.
+// leaves DMAReadPtr pointing at the first incomplete frame.
+//
+// fast path: the rate word rarely changes, so find the run of whole frames available.
+// if the last frame of the run has the same rate word as the first, decode the whole
+// run in a tight loop, validating once per run instead of per frame.
+// if not, the rate has changed within the run, so decode one frame at a time until it is found.
+// returns true if a header is not where expected: the stream has lost sync.
+//
+static bool DecodeDDCFrames(void)
+{
+    uint32_t DecodeByteCount;                                   // bytes to decode
+    uint32_t FrameBytes;                                        // bytes in frame including rate word
+    uint32_t RateWord;                                          // DDC rate word from buffer
+    uint32_t Frames;                                            // frames in run to decode
+    uint8_t* LastFramePtr;                                      // start of last frame in run
+
+//            printf("headptr = %x readptr = %x\n", DMAHeadPtr, DMAReadPtr);
+    DecodeByteCount = DMAHeadPtr - DMAReadPtr;
+    while (DecodeByteCount >= 16)                       // minimum size to try!
+    {
+        if(!IsDDCHeader(DMAReadPtr))
+        {
+            RINGLOG("DDC header not found at DMA offset %d\n", (uint32_t)(DMAReadPtr - DDCDMAData.Base));
+            return true;
+        }
+        else                                                                    // analyse word, then process
+        {
+            RateWord = *(uint32_t*)DMAReadPtr;                                  // read rate word
+            if (RateWord != PrevRateWord)
+            {
+                if ((DDCRateChangeBlocks != 0) && (RateWord == DDCExpectedRateWord))
+                {
+                    DDCRateChangeBlocks = 0;                                    // requested change has arrived
+                    GDDCRateChanges++;
+                }
+                if (!PlanDDCFrames(RateWord))                                   // read new settings
+                {
+                    RINGLOG("DDC rate word %08x not valid\n", RateWord);
+                    return true;                                                // a sample taken for a header
+                }
+                if (DDCRingError)
+                    return false;                                               // thread ends: no ring to decode to
+            }
+            FrameBytes = (FramePlan->FrameLength + 1) * 8;
+            if (DecodeByteCount < FrameBytes)                                   // if not enough left, exit loop
+                break;
+            //
+            // find the run of complete frames, and check the rate word at its end
+            //
+            Frames = DecodeByteCount / FrameBytes;
+            if (Frames > 1)
+            {
+                LastFramePtr = DMAReadPtr + (Frames - 1) * FrameBytes;
+                if (!IsDDCHeader(LastFramePtr) || (*(uint32_t*)LastFramePtr != RateWord))
+                    Frames = 1;
+            }
+            GDDCDecodeRuns++;
+            GDDCDecodeFrames += Frames;
+            //THEN COPY DMA DATA STRAIGHT INTO THE PACKET SLOTS
+            DecodeByteCount -= Frames * FrameBytes;
+            while (Frames-- != 0)
+            {
+                DecodeDDCFrame(DMAReadPtr + 8);                                 // 1st location past rate word
+                DMAReadPtr += FrameBytes;                                       // that's how many bytes we read out
+            }
+        }
+    }
+    return false;
+}
+
+
+//
+// apply a DDC rate change posted by RequestDDCRateChange()
+// called by the stream thread between DMA blocks. The frame plan is built now (the plan
+// cache belongs to this thread) so it is ready when the 1st frame at the new rate arrives.
+//
+static void ApplyDDCRateRequest(void)
+{
+    uint32_t RateWord;
+
+    if (!__atomic_exchange_n(&DDCRateRequestPending, false, __ATOMIC_SEQ_CST))
+        return;
+    RateWord = __atomic_load_n(&DDCRateRequest, __ATOMIC_ACQUIRE);
+    if (RateWord == DDCRateWordWritten)
+        return;
+    if (GetDDCFramePlan(RateWord) == NULL)
+    {
+        printf("DDC rate word %08x not valid: not applied\n", RateWord);
+        return;
+    }
+    DDCExpectedRateWord = RateWord;
+    DDCRateChangeBlocks = VDDCRATECHANGEBLOCKS;
+    RegisterWrite(VADDRDDCRATES, RateWord);
+    DDCRateWordWritten = RateWord;
+}
+
+
+//
+// warm restart: when a session ends the DDC is parked (stopped recording) with its FIFO,
+// buffers, sockets and frame plans kept. The next session then only has to reset the FIFO,
+// which has long since stopped, so it starts from a frame header straight away: there is
+// no stale or overflowed data to search through and no FIFO reset to wait for.
+//
+static void ParkDDCStream(void)
+{
+    SetRXDDCEnabled(false);
+    clock_gettime(CLOCK_MONOTONIC, &DDCParkTime);
+    DDCParked = true;
+}
+
+
+static void UnparkDDCStream(void)
+{
+    struct timespec Now;
+    int64_t Elapsed;                                            // us since parked
+
+    if (!DDCParked)
+        return;
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    Elapsed = (Now.tv_sec - DDCParkTime.tv_sec) * 1000000LL + (Now.tv_nsec - DDCParkTime.tv_nsec) / 1000;
+    if (Elapsed < VDDCPARKSETTLE)
+        usleep(VDDCPARKSETTLE - Elapsed);                       // give FIFO time to stop recording
+    ResetDMAStreamFIFO(eRXDDCDMA);
+    DDCParked = false;
+}
+
+
+//
+// standby: make the idle DDC ready to start (decode thread only). The FIFO is reset
+// as soon as it has stopped, and every DDC is given a packet ring, so the session start
+// has neither to do. A ring that can't be allocated now is tried again when it is used.
+//
+static void PrepareDDCStandby(void)
+{
+    bool RingError = DDCRingError;
+    uint32_t DDC;
+
+    if (DDCStandbyReady)
+        return;
+    UnparkDDCStream();
+    for (DDC = 0; DDC < VNUMDDC; DDC++)
+        UseDDCPacketRing(DDC);
+    DDCRingsInUse = 0;
+    DDCRingError = RingError;
+    DDCStandbyReady = true;
+    SetStandbyReady(true);
+}
+
+
+//
+// report the time from session start to the 1st DDC packet sent
+//
+static void ReportDDCResumeTime(void)
+{
+    struct timespec Now;
+    uint32_t MaxRate = 0;
+    uint32_t DDC;
+
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    printf("DDC stream started: 1st packet sent %.1fms after session start\n",
+           (Now.tv_sec - DDCSessionStart.tv_sec) * 1000.0 + (Now.tv_nsec - DDCSessionStart.tv_nsec) / 1.0E6);
+    for (DDC = 0; DDC < VNUMDDC; DDC++)
+        if (DDCSampleRate[DDC] > MaxRate)
+            MaxRate = DDCSampleRate[DDC];
+    NoteAttachStreaming((MaxRate != 0) ? (uint32_t)((uint64_t)DDCFrameSamples * 1000000 / MaxRate) : 0);
+}
+
+
+//
+// last resort if the DDC stream can't be resynchronised:
+// stop the DMA thread, reset the DDC FIFO, discard queued DMA blocks then restart.
+// packet sequence numbers continue so the client sees a gap, not a new stream.
+//
+static void RestartDDCStream(void)
+{
+    printf("DDC stream sync not found: resetting DDC FIFO\n");
+    GDDCFIFOResets++;
+    __atomic_store_n(&DDCProducerRun, false, __ATOMIC_SEQ_CST);
+    while(__atomic_load_n(&DDCProducerBusy, __ATOMIC_SEQ_CST))
+        usleep(100);
+    SetRXDDCEnabled(false);
+    usleep(1000);                           // give FIFO time to stop recording
+    ResetDMAStreamFIFO(eRXDDCDMA);
+    SPSCInitialise(&DDCDMARing, VDDCDMABLOCKS);
+    while(sem_trywait(&DDCBlockAvailable) == 0)
+        ;
+    DDCResidueBytes = 0;
+    DDCDMAWriteCount = 0;
+    HeaderFound = false;
+    HeaderSearchStart = VDDCSTARTSKIP;
+    ResyncBlocks = 0;
+    SetRXDDCEnabled(true);
+    __atomic_store_n(&DDCProducerRun, true, __ATOMIC_RELEASE);
+    sem_post(&DDCProducerWake);
+}
+
+
+//
+// release the packet slots whose AF_XDP transmit has completed. Call with DDCXdpMutex held.
+// the frame address identifies the DDC; one NIC queue completes in order, so for each
+// DDC the oldest slot in flight is the one completed.
+//
+static void ReapDDCXdpLocked(void)
+{
+    uint64_t Addr[VXDPRINGSIZE];
+    uint32_t Count;
+    uint32_t Cntr;
+    uint32_t DDC;
+
+    Count = XDPTransmitReap(&DDCXdp, Addr, VXDPRINGSIZE);
+    for (Cntr = 0; Cntr < Count; Cntr++)
+    {
+        DDC = Addr[Cntr] / (VDDCPACKETRING * VXDPFRAMESIZE);
+        if ((DDC < VNUMDDC) && (DDCXdpInFlight[DDC] != 0))
+        {
+            DDCXdpInFlight[DDC]--;
+            SPSCRelease(&DDCPacketIndex[DDC]);
+        }
+    }
+}
+
+
+static void ReapDDCXdp(void)
+{
+    pthread_mutex_lock(&DDCXdpMutex);
+    ReapDDCXdpLocked();
+    pthread_mutex_unlock(&DDCXdpMutex);
+}
+
+
+//
+// convert a full float DDC slot into its 2 packets in the float ring
+// returns the 1st of them; the 2nd follows it
+//
+static uint8_t* FinishDDCFloatPackets(uint8_t* Packet, uint32_t DDC, uint32_t Slot)
+{
+    uint8_t* FloatPackets = DDCFloatRing[DDC] + Slot * 2 * DDCPacketLength[DDC];
+    uint8_t* Dest = FloatPackets;
+    uint32_t Half;
+
+    for (Half = 0; Half < 2; Half++, Dest += DDCPacketLength[DDC])
+    {
+        *(uint32_t*)Dest = htonl(SequenceCounter[DDC]++);
+        if (Half == 0)
+            memcpy(Dest + 4, Packet + 4, sizeof(uint64_t));
+        else
+            memcpy(Dest + 4, &DDCFloatTimeStamp[DDC][Slot], sizeof(uint64_t));
+        *(uint16_t*)(Dest + 12) = htons(32);                        // bits per sample
+        *(uint16_t*)(Dest + 14) = htons(DDCFloatSamples);
+        ConvertDDCSamplesFloat(Dest + VDDCHEADERSIZE, Packet + VDDCHEADERSIZE + Half * 6 * DDCFloatSamples,
+                               DDCFloatSamples);
+    }
+    return FloatPackets;
+}
+
+
+//
+// finish a full packet slot for sending: add the sequence count, and code the samples
+// in place if this session uses 16 bit block floating point packets, or this DDC 16 bit samples.
+// returns the start of the packet to send (below the slot for VITA-49; in the float ring if float)
+//
+static inline uint8_t* FinishDDCPacket(uint32_t DDC, uint32_t Slot)
+{
+    uint8_t* Packet = DDCPACKETSLOT(DDC, Slot);
+
+    if (__atomic_load_n(&DDCShedSequence[DDC], __ATOMIC_RELAXED) != 0)           // packets shed: leave a gap
+        SequenceCounter[DDC] += __atomic_exchange_n(&DDCShedSequence[DDC], 0, __ATOMIC_RELAXED);
+    if (DDCFormat == VDDCFORMATVITA49)
+    {
+        Packet -= VVITAPREFIX;
+        *(uint32_t*)Packet = htonl(VVITAPACKETTYPE | VVITATSIOTHER | VVITATSFSAMPLES |
+                                   ((SequenceCounter[DDC]++ & 0xF) << 16) | (DDCPacketBytes / 4));
+        return Packet;
+    }
+    if (DDCSampleBits[DDC] == 32)
+        return FinishDDCFloatPackets(Packet, DDC, Slot);
+    *(uint32_t*)Packet = htonl(SequenceCounter[DDC]++);             // add sequence count
+    if (DDCFormat == VDDCFORMATBFP16)
+    {
+        *(uint16_t*)(Packet + 12) = htons(VDDCBFPBITS);             // bits per sample
+        CompressDDCSamplesBFP(Packet + VDDCHEADERSIZE, Packet + VDDCHEADERSIZE, DDCFrameSamples);
+    }
+    else if (DDCSampleBits[DDC] == 16)
+        ConvertDDCSamples16(Packet + VDDCHEADERSIZE, Packet + VDDCHEADERSIZE, DDCFrameSamples);
+    return Packet;
+}
+
+
+//
+// AF_XDP version of SendDDCPackets(): queue the full slots not already in flight
+// the headers below the packets were written at session start; just add the sequence count
+//
+static bool SendDDCPacketsXDP(uint32_t DDC)
+{
+    uint64_t Addr[VDDCMAXBATCH];
+    uint8_t* Packet;
+    int32_t Slot;
+    uint32_t Count = 0;
+    uint32_t Space;
+    uint32_t Occupancy;
+
+    pthread_mutex_lock(&DDCXdpMutex);
+    ReapDDCXdpLocked();
+    Slot = SPSCGetReadSlot(&DDCPacketIndex[DDC]);
+    Occupancy = SPSCOccupancy(&DDCPacketIndex[DDC]);
+    Space = XDPTransmitSpace(&DDCXdp);
+    while ((Slot >= 0) && (DDCXdpInFlight[DDC] + Count < Occupancy) && (Count < Space) && (Count < VDDCMAXBATCH))
+    {
+        Packet = FinishDDCPacket(DDC, (Slot + DDCXdpInFlight[DDC] + Count) % VDDCPACKETRING);
+        Addr[Count++] = (uint64_t)(Packet - VXDPHEADERSIZE - DDCXdp.Umem);
+    }
+    if (Count != 0)
+    {
+        Count = XDPTransmitQueue(&DDCXdp, Addr, VXDPHEADERSIZE + DDCPacketLength[DDC], Count);
+        DDCXdpInFlight[DDC] += Count;
+        __atomic_add_fetch(&GDDCSendCalls, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&GDDCPacketsSent, Count, __ATOMIC_RELAXED);
+        MetricsCountPackets(eDDCMetrics, Count);
+    }
+    pthread_mutex_unlock(&DDCXdpMutex);
+    return false;
+}
+
+
+//
+// add a fan-out destination for DDC data, from a command line string
+// format: <IPv4 address>[:<port>][@<DDC>,<DDC>...]
+// with no port the client's port is used; with no DDC list every DDC is sent.
+// the address can be an IP multicast group: the packets are then sent once for all its members.
+// returns true if successful
+//
+bool AddDDCFanout(const char* Spec)
+{
+    char Text[64];
+    char* DDCList;
+    char* PortText;
+    char* DDCPtr;
+    struct DDCFanout* Fanout;
+    uint32_t DDC;
+
+    if(DDCFanoutCount >= VDDCMAXFANOUT)
+    {
+        printf("too many DDC fan-out destinations (max %d)\n", VDDCMAXFANOUT);
+        return false;
+    }
+    Fanout = &DDCFanouts[DDCFanoutCount];
+    memset(Fanout, 0, sizeof(*Fanout));
+    strncpy(Text, Spec, sizeof(Text) - 1);
+    Text[sizeof(Text) - 1] = 0;
+    DDCList = strchr(Text, '@');
+    if(DDCList != NULL)
+        *DDCList++ = 0;
+    PortText = strchr(Text, ':');
+    if(PortText != NULL)
+        *PortText++ = 0;
+
+    Fanout->Addr.sin_family = AF_INET;
+    if(inet_pton(AF_INET, Text, &Fanout->Addr.sin_addr) != 1)
+    {
+        printf("bad DDC fan-out address %s\n", Text);
+        return false;
+    }
+    if(PortText != NULL)
+        Fanout->Addr.sin_port = htons((uint16_t)atoi(PortText));
+    if(DDCList == NULL)
+        Fanout->DDCMask = (1U << VNUMDDC) - 1;
+    else
+    {
+        DDCPtr = strtok(DDCList, ",");
+        while(DDCPtr != NULL)
+        {
+            DDC = (uint32_t)atoi(DDCPtr);
+            if(DDC >= VNUMDDC)
+            {
+                printf("bad DDC number %s for fan-out destination\n", DDCPtr);
+                return false;
+            }
+            Fanout->DDCMask |= (1U << DDC);
+            DDCPtr = strtok(NULL, ",");
+        }
+    }
+    DDCFanoutCount++;
+    return true;
+}
 
 
+//
+// add a software decimated stream, from a command line or config file string
+// format: <source DDC>:<target DDC>:<factor>    eg 0:2:8
+// a target can't be the source of another decimation, and can only be fed once.
+// returns true if successful
+//
+bool AddDDCDecimation(const char* Spec)
+{
+    struct DDCDecimation* Decimation;
+    uint32_t Source, Target, Factor, Cntr;
 
+    if(DDCDecimationCount >= VDDCMAXDECIMATIONS)
+    {
+        printf("too many DDC decimations (max %d)\n", VDDCMAXDECIMATIONS);
+        return false;
+    }
+    if((sscanf(Spec, "%u:%u:%u", &Source, &Target, &Factor) != 3) || (Source >= VNUMDDC)
+       || (Target >= VNUMDDC) || (Source == Target))
+    {
+        printf("bad DDC decimation %s: use <source DDC>:<target DDC>:<factor>\n", Spec);
+        return false;
+    }
+    for (Cntr = 0; Cntr < DDCDecimationCount; Cntr++)
+        if((DDCDecimations[Cntr].Target == Target) || (DDCDecimations[Cntr].Target == Source)
+           || (DDCDecimations[Cntr].Source == Target))
+        {
+            printf("DDC decimation %s: DDC %d already used by another decimation\n", Spec,
+                   (DDCDecimations[Cntr].Target == Source) ? Source : Target);
+            return false;
+        }
+    Decimation = &DDCDecimations[DDCDecimationCount];
+    if(!InitialiseDecimator(&Decimation->Filter, Factor))
+    {
+        printf("bad DDC decimation factor %d: a power of 2 from %d to %d\n", Factor, VDECMINFACTOR, VDECMAXFACTOR);
+        return false;
+    }
+    Decimation->Source = Source;
+    Decimation->Target = Target;
+    Decimation->Active = false;
+    DDCDecimationCount++;
+    printf("DDC %d decimated by %d is sent as DDC %d when that DDC is disabled\n", Source, Factor, Target);
+    return true;
+}
 
 
 //
-// code to allocate and free dynamic allocated memory
-// first the memory buffers:
+// fix one DDC's sample size for this session, from the size the client asked for.
+// only the standard format has a choice. Float packets are not in the AF_XDP UMEM,
+// so they can't be sent with AF_XDP. A float ring is kept once it has been allocated.
 //
-uint8_t* DMAReadBuffer = NULL;								// data for DMA read from DDC
-uint32_t DMABufferSize = VDMABUFFERSIZE;
-unsigned char* DMAReadPtr;							        // pointer for 1st available location in DMA memory
-unsigned char* DMAHeadPtr;							        // ptr to 1st free location in DMA memory
-unsigned char* DMABasePtr;							        // ptr to target DMA location in DMA memory
+static void SetDDCSampleBits(uint32_t DDC)
+{
+    uint8_t Bits = GDDCSampleSize[DDC];
 
-uint8_t* UDPBuffer[VNUMDDC];                                // DDC frame buffer
-uint8_t* DDCSampleBuffer[VNUMDDC];                          // buffer per DDC
-unsigned char* IQReadPtr[VNUMDDC];							// pointer for reading out an I or Q sample
-unsigned char* IQHeadPtr[VNUMDDC];							// ptr to 1st free location in I/Q memory
-unsigned char* IQBasePtr[VNUMDDC];							// ptr to DMA location in I/Q memory
+    if ((DDCFormat != VDDCFORMAT24BIT) || ((Bits != 16) && (Bits != 32)))
+        Bits = 24;
+    if ((Bits == 32) && DDCXdpOpen)
+    {
+        printf("DDC %d: float samples not available with AF_XDP; sent as 24 bit\n", DDC);
+        Bits = 24;
+    }
+    if ((Bits == 32) && (DDCFloatRing[DDC] != NULL) && (DDCFloatRingBytes[DDC] < VDDCFLOATRINGBYTES(DDCFloatSamples)))
+    {
+        ReleaseLockedBuffer(DDCFloatRing[DDC], DDCFloatRingBytes[DDC]);     // too small for jumbo packets
+        MetricsAddBufferBytes(eDDCMetrics, -(int64_t)DDCFloatRingBytes[DDC]);
+        DDCFloatRing[DDC] = NULL;
+    }
+    if ((Bits == 32) && (DDCFloatRing[DDC] == NULL))
+    {
+        DDCFloatRingBytes[DDC] = VDDCFLOATRINGBYTES(DDCFloatSamples);
+        DDCFloatRing[DDC] = AllocateLockedBuffer(DDCFloatRingBytes[DDC]);
+        if (DDCFloatRing[DDC] == NULL)
+        {
+            printf("DDC %d float packet ring allocation failed; sent as 24 bit\n", DDC);
+            Bits = 24;
+        }
+        else
+            MetricsAddBufferBytes(eDDCMetrics, DDCFloatRingBytes[DDC]);
+    }
+    DDCSampleBits[DDC] = Bits;
+    DDCPacketsPerSlot[DDC] = 1;
+    DDCPacketLength[DDC] = DDCPacketBytes;
+    if (Bits == 16)
+    {
+        DDCPacketLength[DDC] = VDDCHEADERSIZE + 4 * DDCFrameSamples;
+        printf("DDC %d: 16 bit samples, %d byte packets\n", DDC, DDCPacketLength[DDC]);
+    }
+    else if (Bits == 32)
+    {
+        DDCPacketsPerSlot[DDC] = 2;
+        DDCPacketLength[DDC] = VDDCFLOATPACKETSIZE(DDCFloatSamples);
+        printf("DDC %d: float samples, %d byte packets of %d samples\n", DDC, DDCPacketLength[DDC], DDCFloatSamples);
+    }
+}
 
 
-bool CreateDynamicMemory(void)                              // return true if error
+//
+// set up this session's fan-out destinations for each DDC, taking the client's port
+// where none was given. Multicast sockets get a local hop limit, and don't loop back.
+//
+static void StartDDCFanoutSession(void)
 {
     uint32_t DDC;
-    bool Result = false;
+    uint32_t Cntr;
+    struct sockaddr_in* Dest;
+    int OptionValue;
+
+    for (DDC = 0; DDC < VNUMDDC; DDC++)
+    {
+        FanoutDestCount[DDC] = 0;
+        for (Cntr = 0; Cntr < DDCFanoutCount; Cntr++)
+        {
+            if((DDCFanouts[Cntr].DDCMask & (1U << DDC)) == 0)
+                continue;
+            Dest = &FanoutDestAddr[DDC][FanoutDestCount[DDC]++];
+            memcpy(Dest, &DDCFanouts[Cntr].Addr, sizeof(struct sockaddr_in));
+            if(Dest->sin_port == 0)
+                Dest->sin_port = DestAddr[DDC].sin_port;
+            if(IN_MULTICAST(ntohl(Dest->sin_addr.s_addr)))
+            {
+                OptionValue = VDDCMULTICASTTTL;
+                setsockopt((DDCThreadData + DDC)->Socketid, IPPROTO_IP, IP_MULTICAST_TTL, &OptionValue, sizeof(OptionValue));
+                OptionValue = 0;
+                setsockopt((DDCThreadData + DDC)->Socketid, IPPROTO_IP, IP_MULTICAST_LOOP, &OptionValue, sizeof(OptionValue));
+            }
+        }
+    }
+}
+
+
 //
-// first create the buffer for DMA, and initialise its pointers
+// start an AF_XDP session: wait for the last session's packets to complete,
+// then write the headers below every packet slot
+// returns false if the destination can't be reached this way (use the UDP sockets)
 //
-    posix_memalign((void**)&DMAReadBuffer, VALIGNMENT, DMABufferSize);
-    DMAReadPtr = DMAReadBuffer + VBASE;		                    // offset 4096 bytes into buffer
-    DMAHeadPtr = DMAReadBuffer + VBASE;
-    DMABasePtr = DMAReadBuffer + VBASE;
-    if (!DMAReadBuffer)
+static bool StartDDCXdpSession(void)
+{
+    uint8_t Header[VXDPHEADERSIZE];
+    uint32_t DDC;
+    uint32_t Slot;
+    uint32_t Cntr;
+
+    if (DDCFanoutCount != 0)
     {
-        printf("I/Q read buffer allocation failed\n");
-        Result = true;
+        printf("AF_XDP: fan-out destinations set; DDC data sent by UDP sockets\n");
+        return false;
+    }
+    for (Cntr = 0; (Cntr < VDDCXDPDRAINTIME) && (DDCXdp.InFlight != 0); Cntr++)
+    {
+        ReapDDCXdp();
+        usleep(1000);
+    }
+    memset(DDCXdpInFlight, 0, sizeof(DDCXdpInFlight));
+    for (DDC = 0; DDC < VNUMDDC; DDC++)
+    {
+        if (!XDPBuildHeader(&DDCXdp, Header, &DestAddr[DDC], (DDCThreadData + DDC)->Portid, DDCPacketLength[DDC]))
+        {
+            printf("AF_XDP: no neighbour entry for the client; DDC data sent by UDP sockets\n");
+            return false;
+        }
+        for (Slot = 0; Slot < VDDCPACKETRING; Slot++)
+            memcpy(DDCPACKETSLOT(DDC, Slot) - DDCPacketPrefix - VXDPHEADERSIZE, Header, VXDPHEADERSIZE);
+    }
+    return true;
+}
+
+
+//
+// send a batch of packets for one DDC with sendmmsg()
+// sendmmsg() can return having sent only part of the batch, so repeat for the rest.
+// if the socket queue is full (ENOBUFS/EAGAIN) back off and retry; if it stays full
+// drop the rest of the batch: the client sees a sequence gap, but the stream continues.
+// *Sent = packets sent; *Dropped = packets dropped with the queue full
+// returns true if there was a send error
+//
+static bool SendDDCBatch(uint32_t DDC, struct mmsghdr* Batch, uint32_t Count, uint32_t* Sent, uint32_t* Dropped)
+{
+    uint32_t BatchSent = 0;
+    uint32_t Retries = 0;                                       // backoffs so far for this batch
+    int Error;
+
+    *Dropped = 0;
+    while (BatchSent < Count)
+    {
+        STAGETRACE_START(TraceStart);
+        Error = sendmmsg((DDCThreadData+DDC)->Socketid, &Batch[BatchSent], Count - BatchSent, 0);
+        STAGETRACE_END(TraceStart, "sendmmsg", Count - BatchSent);
+        if ((Error == -1) && IsSendBackpressure(errno))
+        {
+            __atomic_add_fetch(&GDDCSendBackoffs, 1, __ATOMIC_RELAXED);
+            if (Retries++ < VDDCSENDRETRIES)
+            {
+                usleep(VDDCSENDBACKOFF);
+                continue;
+            }
+            MetricsCountSendError(eDDCMetrics);
+            *Dropped = Count - BatchSent;                       // drop the rest
+            __atomic_add_fetch(&GDDCSendDrops, *Dropped, __ATOMIC_RELAXED);
+            break;
+        }
+        if (Error == -1)
+        {
+            printf("Send Error, DDC=%d, errno=%d, socket id = %d\n", DDC, errno, (DDCThreadData+DDC)->Socketid);
+            MetricsCountSendError(eDDCMetrics);
+            break;
+        }
+        BatchSent += Error;
+        __atomic_add_fetch(&GDDCSendCalls, 1, __ATOMIC_RELAXED);
     }
-    memset(DMAReadBuffer, 0, DMABufferSize);
+    *Sent = BatchSent;
+    return ((BatchSent + *Dropped) < Count);
+}
+
+
+//
+// send all full packet slots for one DDC
+// queue every full slot; the I/Q data is already in place so just add the sequence count
+// (a float slot is converted into its 2 packets, which are queued one after the other)
+// then send the whole batch with one sendmmsg() call.
+// each DDC has its own socket (the client identifies the DDC by source port)
+// so a batch can only hold packets for one DDC.
+// the batch is then sent again to each fan-out destination for the DDC (by sendmmsg(), not GSO)
+// with retransmission enabled, the batch is also copied to the DDC's retransmit ring
+// returns true if there was a send error
+//
+static bool SendDDCPackets(struct DDCSenderData* Sender, uint32_t DDC)
+{
+    uint8_t* Packet;                                            // packet slot being sent
+    uint32_t SlotCount = 0;                                     // packet slots in batch
+    uint32_t BatchCount = 0;                                    // packets in batch
+    uint32_t BatchSent = 0;                                     // packets sent so far from batch
+    uint32_t GSOCount;                                          // contiguous packets in one GSO send
+    struct iovec GSOIovec;                                      // one iovec covering several packet slots
+    struct msghdr GSOHeader;
+    int32_t Slot;
+    uint32_t Cntr;
+    int Result;
+    bool Error = false;
+    uint32_t Sent;
+    uint32_t Dropped = 0;                                       // packets dropped with the queue full
+    uint32_t FanoutDropped;
+    uint32_t Dest;                                              // fan-out destination
+    struct iovec* SendIovec = Sender->SendIovec;
+    struct mmsghdr* SendBatch = Sender->SendBatch;
+
+    if (DDCUseXDP)
+        return SendDDCPacketsXDP(DDC);
 
     //
-    // set up per-DDC data structures
+    // the slots stay owned by the sender until sent, then all are released together
     //
-    for (DDC = 0; DDC < VNUMDDC; DDC++)
+    Slot = SPSCGetReadSlot(&DDCPacketIndex[DDC]);
+    while ((Slot >= 0) && (SlotCount < SPSCOccupancy(&DDCPacketIndex[DDC])))
     {
-        UDPBuffer[DDC] = malloc(VDDCPACKETSIZE);
-        DDCSampleBuffer[DDC] = malloc(DMABufferSize);
-        IQReadPtr[DDC] = DDCSampleBuffer[DDC] + VBASE;		// offset 4096 bytes into buffer
-        IQHeadPtr[DDC] = DDCSampleBuffer[DDC] + VBASE;
-        IQBasePtr[DDC] = DDCSampleBuffer[DDC] + VBASE;
+//                    printf("enough data for packet: DDC= %d\n", DDC);
+        Packet = FinishDDCPacket(DDC, (Slot + SlotCount) % VDDCPACKETRING);
+        for (Cntr = 0; Cntr < DDCPacketsPerSlot[DDC]; Cntr++)
+        {
+            SendIovec[BatchCount].iov_base = Packet + Cntr * DDCPacketLength[DDC];
+            SendIovec[BatchCount].iov_len = DDCPacketLength[DDC];
+            SendBatch[BatchCount].msg_hdr.msg_name = &DestAddr[DDC];   // MAC addr & port to send to
+            BatchCount++;
+        }
+        SlotCount++;
     }
-    return Result;
+    //
+    // GSO mode: the packet slots are adjacent in memory, so each run of slots up to
+    // the end of the ring can go in one send and the kernel splits them into datagrams.
+    // (jumbo packets: as many as fit the largest UDP datagram)
+    // if the send is rejected (eg NIC has no checksum offload) revert to sendmmsg()
+    //
+    while (DDCUseGSO[DDC] && (BatchSent < BatchCount))
+    {
+        GSOCount = 1;
+        while (((BatchSent + GSOCount) < BatchCount) && ((GSOCount + 1) * DDCPacketLength[DDC] <= VDDCGSOMAXBYTES) &&
+               ((uint8_t*)SendIovec[BatchSent + GSOCount].iov_base ==
+                (uint8_t*)SendIovec[BatchSent].iov_base + GSOCount * DDCPacketLength[DDC]))
+            GSOCount++;
+        memset(&GSOHeader, 0, sizeof(GSOHeader));
+        GSOIovec.iov_base = SendIovec[BatchSent].iov_base;
+        GSOIovec.iov_len = GSOCount * DDCPacketLength[DDC];
+        GSOHeader.msg_iov = &GSOIovec;
+        GSOHeader.msg_iovlen = 1;
+        GSOHeader.msg_name = &DestAddr[DDC];
+        GSOHeader.msg_namelen = sizeof(struct sockaddr_in);
+        STAGETRACE_START(TraceStart);
+        Result = sendmsg((DDCThreadData+DDC)->Socketid, &GSOHeader, 0);
+        STAGETRACE_END(TraceStart, "sendmsg", GSOCount);
+        if ((Result == -1) && IsSendBackpressure(errno))
+            break;                                              // queue full: sendmmsg() below backs off
+        if (Result == -1)
+        {
+            printf("UDP GSO send rejected, DDC=%d, errno=%d; reverting to sendmmsg\n", DDC, errno);
+            MetricsCountSendError(eDDCMetrics);
+            SetSocketGSO(DDCThreadData + DDC, 0);
+            DDCUseGSO[DDC] = false;
+        }
+        else
+        {
+            BatchSent += GSOCount;
+            __atomic_add_fetch(&GDDCSendCalls, 1, __ATOMIC_RELAXED);
+        }
+    }
+    if (SendDDCBatch(DDC, &SendBatch[BatchSent], BatchCount - BatchSent, &Sent, &Dropped))
+        Error = true;
+    BatchSent += Sent;
+    RecordDDCPackets(DDC, SendIovec, BatchCount);               // kept for NACKs, including any dropped
+    //
+    // then the same packets to each fan-out destination for this DDC
+    //
+    for (Dest = 0; Dest < FanoutDestCount[DDC]; Dest++)
+    {
+        for (Cntr = 0; Cntr < BatchCount; Cntr++)
+            SendBatch[Cntr].msg_hdr.msg_name = &FanoutDestAddr[DDC][Dest];
+        if (SendDDCBatch(DDC, SendBatch, BatchCount, &Sent, &FanoutDropped))
+            Error = true;
+        __atomic_add_fetch(&GDDCFanoutSent, Sent, __ATOMIC_RELAXED);
+    }
+    __atomic_add_fetch(&GDDCPacketsSent, BatchSent, __ATOMIC_RELAXED);
+    MetricsCountPackets(eDDCMetrics, BatchSent);
+    for (Cntr = 0; Cntr < SlotCount; Cntr++)
+        SPSCRelease(&DDCPacketIndex[DDC]);
+    return Error;
 }
 
 
-void FreeDynamicMemory(void)
+//
+// sender thread: sends the packets for DDCs SenderNum, SenderNum+N...
+// optionally pinned to a CPU core
+//
+void *DDCSenderThread(void *arg)
 {
+    struct DDCSenderData* Sender = (struct DDCSenderData*)arg;
+    struct timespec WaitTime;
     uint32_t DDC;
+    cpu_set_t CPUSet;
 
-    free(DMAReadBuffer);
-    //
-    // free the per-DDC buffers
-    //
-    for (DDC = 0; DDC < VNUMDDC; DDC++)
+    if(DDCSenderCoreCount != 0)
+    {
+        CPU_ZERO(&CPUSet);
+        CPU_SET(DDCSenderCores[Sender->SenderNum % DDCSenderCoreCount], &CPUSet);
+        if(pthread_setaffinity_np(pthread_self(), sizeof(CPUSet), &CPUSet) != 0)
+            printf("DDC sender %d: could not set CPU affinity\n", Sender->SenderNum);
+    }
+    printf("spinning up DDC sender thread %d, pid=%ld\n", Sender->SenderNum, syscall(SYS_gettid));
+    while(!__atomic_load_n(&DDCProducerExit, __ATOMIC_ACQUIRE))
     {
-        free(UDPBuffer[DDC]);
-        free(DDCSampleBuffer[DDC]);
+        clock_gettime(CLOCK_REALTIME, &WaitTime);
+        WaitTime.tv_nsec += VDDCSENDERTIMEOUT * 1000000L;
+        if(WaitTime.tv_nsec >= 1000000000L)
+        {
+            WaitTime.tv_sec++;
+            WaitTime.tv_nsec -= 1000000000L;
+        }
+        if(sem_timedwait(&Sender->PacketsReady, &WaitTime) != 0)
+            continue;
+        __atomic_store_n(&Sender->Busy, true, __ATOMIC_SEQ_CST);
+        if(__atomic_load_n(&DDCSendersRun, __ATOMIC_SEQ_CST))
+            for (DDC = Sender->SenderNum; DDC < VNUMDDC; DDC += DDCSenderCount)
+                if(SendDDCPackets(Sender, DDC))
+                    __atomic_store_n(&DDCSendError, true, __ATOMIC_RELEASE);
+        __atomic_store_n(&Sender->Busy, false, __ATOMIC_RELEASE);
     }
+    return NULL;
 }
 
 
@@ -255,67 +2240,48 @@ void FreeDynamicMemory(void)
 // thread initiated after a "Start" command
 // will be instructed to stop & exit by main loop setting enable_thread to 0
 // this code signals thread terminated by setting active_thread = 0
+// this is the "consumer" for the DMA block ring: DMA itself is done by DDCDMAProducer()
 //
 void *OutgoingDDCIQ(void *arg)
 {
-//
-// memory buffers
-//
-    uint32_t DMATransferSize;
     bool InitError = false;                                     // becomes true if we get an initialisation error
-    
+    uint32_t StateCount;                                        // thread state changes seen
     uint32_t ResidueBytes;
-    uint32_t Depth = 0;
-    
-    int IQReadfile_fd = -1;									    // DMA read file device
     uint32_t RegisterValue;
     bool FIFOOverflow, FIFOUnderflow, FIFOOverThreshold;
-    int DDC;                                                    // iterator
-
-    struct ThreadSocketData *ThreadData;                        // socket etc data for each thread.
-                                                                // points to 1st one
-//
-// variables for outgoing UDP frame
-//
-    struct sockaddr_in DestAddr[VNUMDDC];                       // destination address for outgoing data
-    struct iovec iovecinst[VNUMDDC];                            // instance of iovec
-    struct msghdr datagram[VNUMDDC];
-    uint32_t SequenceCounter[VNUMDDC];                          // UDP sequence count
-//
-// variables for analysing a DDC frame
-//
-    uint32_t FrameLength;                                       // number of words per frame
-    uint32_t DDCCounts[VNUMDDC];                                // number of samples per DDC in a frame
-    uint32_t RateWord;                                          // DDC rate word from buffer
-    uint32_t HdrWord;                                           // check word read form DMA's data
-    uint16_t* SrcWordPtr, * DestWordPtr;                        // 16 bit read & write pointers
-    uint32_t *LongWordPtr;
-    uint32_t PrevRateWord;                                      // last used rate word
-    uint32_t Cntr;                                              // sample word counter
-    bool HeaderFound;
-    uint32_t DecodeByteCount;                                   // bytes to decode
-    unsigned int Current;                                   // current occupied locations in FIFO
-    unsigned int StartupCount;                              // used to delay reporting of under & overflows
+    unsigned int Current;                                       // current occupied locations in FIFO
+    uint32_t DDC;                                               // iterator
+    uint32_t Cntr;
+    int32_t Slot;
+    uint8_t* Block;
+    bool Resync;                                                // true if searching after sync was lost
+    bool RestartNeeded;
+    ESoftwareID SoftwareID;                                     // firmware ID, for a capture file header
+    struct timespec WaitTime;
+    pthread_t DMAThread;
+    pthread_t SenderThread;
+    struct RadioState State;                                    // radio state snapshot at session start
 
 //
-// initialise. Create memory buffers and open DMA file devices
+// initialise. Open DMA file devices and create memory buffers
+// the device is opened first, as the DMA ring can be its driver buffer
+// opened readonly to accommodate potential use of a different XDMA device driver
 //
-    PrevRateWord = 0xFFFFFFFF;                                  // illegal value to forc re-calculation of rates
-    DMATransferSize = VDMATRANSFERSIZE;                         // initial size, but can be changed
-    InitError = CreateDynamicMemory();
-    //
-    // open DMA device driver
-    // opened readonly to accommodate potential use of a different XDMA device driver
-    //
-    IQReadfile_fd = open(VDDCDMADEVICE, O_RDONLY);
+    IQReadfile_fd = OpenDMADevice(VDDCDMADEVICE, O_RDONLY);
     if (IQReadfile_fd < 0)
     {
         printf("XDMA read device open failed for DDC data\n");
         InitError = true;
     }
+    if (CreateDynamicMemory())
+        InitError = true;
+    SPSCInitialise(&DDCDMARing, VDDCDMABLOCKS);
+    DDCDMAWriteCount = 0;
+    sem_init(&DDCBlockAvailable, 0, 0);
+    sem_init(&DDCProducerWake, 0, 0);
 
-    ThreadData = (struct ThreadSocketData*)arg;
-    printf("spinning up outgoing I/Q thread with port %d, pid=%ld\n", ThreadData->Portid, syscall(SYS_gettid));
+    DDCThreadData = (struct ThreadSocketData*)arg;
+    printf("spinning up outgoing I/Q thread with port %d, pid=%ld\n", DDCThreadData->Portid, syscall(SYS_gettid));
 
     //
     // set up per-DDC data structures
@@ -323,7 +2289,7 @@ void *OutgoingDDCIQ(void *arg)
     for (DDC = 0; DDC < VNUMDDC; DDC++)
     {
         SequenceCounter[DDC] = 0;                           // clear UDP packet counter
-        (ThreadData + DDC)->Active = true;                  // set outgoing socket active
+        (DDCThreadData + DDC)->Active = true;               // set outgoing socket active
     }
 
 
@@ -337,264 +2303,385 @@ void *OutgoingDDCIQ(void *arg)
 //    RegisterWrite(0x1010, 0x0000002A);      // disable DDC data transfer; DDC2=test source
     SetRXDDCEnabled(false);
     usleep(1000);                           // give FIFO time to stop recording 
-    SetupFIFOMonitorChannel(eRXDDCDMA, false);
+    //
+    // if interrupts requested, set the FIFO monitor threshold to the smallest DMA size
+    // so it interrupts when there is data to read. Else set it up for polled use.
+    // (the DMA thread then moves the threshold to the depth its size controller wants)
+    //
+    if(UseFIFOInterrupts)
+        DDCEvent_fd = OpenFIFOMonitorEvents(eRXDDCDMA);
+    if(DDCEvent_fd >= 0)
+        SetupFIFOMonitorThreshold(eRXDDCDMA, VDMATRANSFERSIZE/8U, true);
+    else
+        SetupFIFOMonitorChannel(eRXDDCDMA, false);
     ResetDMAStreamFIFO(eRXDDCDMA);
     RegisterValue = ReadFIFOMonitorChannel(eRXDDCDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);				// read the FIFO Depth register
 	if(UseDebug)
         printf("DDC FIFO Depth register = %08x (should be ~0)\n", RegisterValue);
-	Depth=0;
+
+    //
+    // start the DMA thread. It waits until told to run.
+    // then any sender threads requested
+    //
+    if(!InitError)
+    {
+        if(!CreateManagedThread(&DMAThread, "DDC DMA", eStreamThread, DDCDMAProducer, NULL))
+        {
+            perror("pthread_create DDC DMA");
+            InitError = true;
+        }
+    }
+    DDCSenderCount = DDCSenderThreads;
+    if(DDCSenderCount > VNUMDDC)
+        DDCSenderCount = VNUMDDC;
+    for (Cntr = 0; Cntr < VNUMDDC; Cntr++)
+    {
+        DDCSenders[Cntr].SenderNum = Cntr;
+        __atomic_store_n(&DDCSenders[Cntr].Busy, false, __ATOMIC_RELAXED);     // (before the threads start)
+        sem_init(&DDCSenders[Cntr].PacketsReady, 0, 0);
+    }
+    for (Cntr = 0; (Cntr < DDCSenderCount) && !InitError; Cntr++)
+    {
+        if(!CreateManagedThread(&SenderThread, "DDC sender", eStreamThread, DDCSenderThread, &DDCSenders[Cntr]))
+        {
+            perror("pthread_create DDC sender");
+            InitError = true;
+        }
+    }
 
 
 //
 // thread loop. runs continuously until commanded by main loop to exit
-// for now: add 1 RX data + mic data at 48KHz sample rate. Mic data is constant zero.
-// while there is enough I/Q data, make outgoing packets;
-// when not enough data, read more.
+// while there is a DMA block available, decode it to packets and send them;
+// when not enough data, wait for more.
 //
-    while(!InitError)
+    while(!InitError && !ThreadStopRequested())
     {
-        while(!SDRActive)
+        StateCount = GetThreadStateCount();
+        while(!__atomic_load_n(&SDRActive, __ATOMIC_ACQUIRE) && !ThreadStopRequested())
         {
             for (DDC=0; DDC < VNUMDDC; DDC++)
-                if((ThreadData+DDC) -> Cmdid & VBITCHANGEPORT)
+                if((DDCThreadData+DDC) -> Cmdid & VBITCHANGEPORT)
                 {
-                    close((ThreadData+DDC) -> Socketid);                      // close old socket, open new one
-                    MakeSocket((ThreadData + DDC), 0);                        // this binds to the new port.
-                    (ThreadData + DDC) -> Cmdid &= ~VBITCHANGEPORT;           // clear command bit
+                    close((DDCThreadData+DDC) -> Socketid);                      // close old socket, open new one
+                    MakeSocket((DDCThreadData + DDC), 0);                        // this binds to the new port.
+                    (DDCThreadData + DDC) -> Cmdid &= ~VBITCHANGEPORT;           // clear command bit
                 }
-            usleep(100);
+            if (UseStandby)
+                PrepareDDCStandby();                                             // once per idle period
+            if ((DDCRingsAllocated != 0) && !UseStandby)                         // wake to release idle packet rings
+            {
+                WaitThreadStateChangeTimed(&StateCount, 1000);
+                ReleaseIdleDDCRings();
+            }
+            else
+                WaitThreadStateChange(&StateCount);                              // sleep until the state changes
         }
+        if(ThreadStopRequested())
+            break;
         printf("starting outgoing DDC data\n");
+        clock_gettime(CLOCK_MONOTONIC, &DDCSessionStart);
+        if (DDCStandbyReady)
+        {
+            DDCStandbyReady = false;
+            SetStandbyReady(false);
+        }
+        DDCDecodeBlockNs = 0;
+        DDCResumeReported = false;
         StartupCount = VSTARTUPDELAY;
         //
-        // initialise outgoing DDC packets - 1 per DDC
+        // initialise outgoing DDC packets - a ring of slots per DDC
+        // coded packets are a different size, so GSO is only used for 24 bit packets
+        // VITA-49 (general packet flag) has 24 bit samples, and takes precedence over the coded format
+        // jumbo packets have no room in an AF_XDP frame, so AF_XDP sessions use the standard size
         //
+        DDCFormat = GEnableVITA49 ? VDDCFORMATVITA49 : DDCFormatRequest;
+        DDCFrameSamples = __atomic_load_n(&DDCSamplesRequest, __ATOMIC_RELAXED);
+        if ((DDCFrameSamples != VIQSAMPLESPERFRAME) && DDCXdpOpen)
+        {
+            printf("jumbo DDC packets not available with AF_XDP: %d samples per packet\n", VIQSAMPLESPERFRAME);
+            DDCFrameSamples = VIQSAMPLESPERFRAME;
+        }
+        DDCFrameBytes = 6 * DDCFrameSamples;
+        DDCFloatSamples = DDCFrameSamples / 2;
+        DDCPacketBytes = VDDCHEADERSIZE + DDCFrameBytes;
+        DDCPacketPrefix = 0;
+        if (DDCFormat == VDDCFORMATBFP16)
+        {
+            DDCPacketBytes = VDDCHEADERSIZE + DDCBFPBytes(DDCFrameSamples);
+            printf("DDC packets coded as 16 bit block floating point, %d bytes\n", DDCPacketBytes);
+        }
+        else if (DDCFormat == VDDCFORMATVITA49)
+        {
+            DDCPacketBytes = VVITAHEADERSIZE + DDCFrameBytes;
+            DDCPacketPrefix = VVITAPREFIX;
+            printf("DDC packets sent as VITA-49 IF data, %d bytes\n", DDCPacketBytes);
+        }
+        if (DDCFrameSamples != VIQSAMPLESPERFRAME)
+            printf("jumbo DDC packets: %d samples, %d bytes\n", DDCFrameSamples, DDCPacketBytes);
+        if (!DDCXdpOpen)
+        {
+            DDCPacketStride = VDDCHEADERSIZE + DDCFrameBytes + DDCPacketPrefix;    // VITA-49 packets are adjacent too
+            for (DDC = 0; DDC < VNUMDDC; DDC++)
+                if ((DDCRingsAllocated & (1U << DDC)) && (DDCRingBytes[DDC] != VDDCRINGBYTES(DDCFrameSamples)))
+                    ReleaseDDCPacketRing(DDC);                          // packet size changed: allocated again when used
+        }
+        ReadRadioState(&State);
+        for (DDC = 0; DDC < VNUMDDC; DDC++)
+            SetDDCSampleBits(DDC);
         for (DDC = 0; DDC < VNUMDDC; DDC++)
         {
             SequenceCounter[DDC] = 0;
-            memcpy(&DestAddr[DDC], &reply_addr, sizeof(struct sockaddr_in));           // local copy of PC destination address (reply_addr is global)
-            memset(&iovecinst[DDC], 0, sizeof(struct iovec));
-            memset(&datagram[DDC], 0, sizeof(struct msghdr));
-            iovecinst[DDC].iov_base = UDPBuffer[DDC];
-            iovecinst[DDC].iov_len = VDDCPACKETSIZE;
-            datagram[DDC].msg_iov = &iovecinst[DDC];
-            datagram[DDC].msg_iovlen = 1;
-            datagram[DDC].msg_name = &DestAddr[DDC];                   // MAC addr & port to send to
-            datagram[DDC].msg_namelen = sizeof(DestAddr);
+            DDCShedSequence[DDC] = 0;
+            InitialiseDDCPacketRing(DDC);
+            DDCUseGSO[DDC] = false;
+            if(UseUDPGSO && !DDCXdpOpen && (DDCFormat != VDDCFORMATBFP16) && (DDCSampleBits[DDC] != 16))
+                DDCUseGSO[DDC] = SetSocketGSO(DDCThreadData + DDC, DDCPacketLength[DDC]);
+            memcpy(&DestAddr[DDC], &State.ReplyAddr, sizeof(struct sockaddr_in));      // local copy of PC destination address
         }
+        StartDDCFanoutSession();
+        DDCUseXDP = DDCXdpOpen && StartDDCXdpSession();
+        for (DDC = 0; DDC < VNUMDDC; DDC++)
+            StartDDCRetransmitSession(DDC, (DDCThreadData + DDC)->Socketid, &DestAddr[DDC],
+                                      (DDCFormat != VDDCFORMATVITA49) && !DDCUseXDP
+                                      && (DDCFrameSamples == VIQSAMPLESPERFRAME));     // not kept: jumbo packets
+        for (Cntr = 0; Cntr < VNUMDDC; Cntr++)
+        {
+            InitialiseDDCSender(&DDCSenders[Cntr]);
+            while(sem_trywait(&DDCSenders[Cntr].PacketsReady) == 0)
+                ;
+        }
+        __atomic_store_n(&DDCSendError, false, __ATOMIC_RELAXED);
+        GDDCSlotStalls = 0;
+        GDDCDecodeRuns = 0;
+        GDDCDecodeFrames = 0;
+        GDDCPacketsSent = 0;
+        GDDCSendCalls = 0;
+        GDDCSendBackoffs = 0;
+        GDDCSendDrops = 0;
+        GDDCFanoutSent = 0;
+        GDDCDMABlockCount = 0;
+        GDDCRingFullStalls = 0;
+        GDDCRingEmptyWaits = 0;
+        GDDCRingMaxOccupancy = 0;
+        GDDCShedPackets = 0;
+        GDDCDMABytes = 0;
+        //
+        // empty the DMA block ring (DMA thread is idle)
+        //
+        SPSCInitialise(&DDCDMARing, VDDCDMABLOCKS);
+        while(sem_trywait(&DDCBlockAvailable) == 0)
+            ;
+        DDCResidueBytes = 0;
+        DDCDMAWriteCount = 0;
+        HeaderFound = false;
+        HeaderSearchStart = VDDCSTARTSKIP;
+        ResyncBlocks = 0;
+        Resync = false;
+        GDDCResyncs = 0;
+        GDDCResyncBytes = 0;
+        GDDCFIFOResets = 0;
+        GDDCRateChanges = 0;
+        GDDCPureSignalPads = 0;
+        memset(DDCInterleaved, 0, sizeof(DDCInterleaved));
+        memset(DDCSlotTXState, 0, sizeof(DDCSlotTXState));
+        for (Cntr = 0; Cntr < DDCDecimationCount; Cntr++)
+            DDCDecimations[Cntr].Active = false;                    // filters cleared when planned
+        DDCRateChangeBlocks = 0;
+        DDCRateWordWritten = RegisterRead(VADDRDDCRATES);
+        PlanDDCFrames(DDCRateWordWritten);                          // primed from the register: re-planned if the stream differs
+        if (DDCRingError)
+            InitError = true;
+        __atomic_store_n(&DDCStreamActive, true, __ATOMIC_SEQ_CST);
+        if(DDCCaptureFilename != NULL)
+            OpenDDCCapture(DDCCaptureFilename, RegisterRead(VADDRDDCRATES), GetFirmwareVersion(&SoftwareID));
       //
       // enable Saturn DDC to transfer data
       //
         printf("outDDCIQ: enable data transfer\n");
+        UnparkDDCStream();
         SetRXDDCEnabled(true);
-        HeaderFound = false;
-        while(!InitError && SDRActive)
+        __atomic_store_n(&DDCSendersRun, true, __ATOMIC_RELEASE);
+        __atomic_store_n(&DDCProducerRun, true, __ATOMIC_RELEASE);
+        sem_post(&DDCProducerWake);
+        while(!InitError && __atomic_load_n(&SDRActive, __ATOMIC_ACQUIRE))
         {
-
-        //
-        // loop through all DDC I/Q buffers.
-        // while there is enough I/Q data for this DDC in local (ARM) memory, make DDC Packets
-        // then put any residues at the heads of the buffer, ready for new data to come in
-        //
-            for (DDC = 0; DDC < VNUMDDC; DDC++)
-            {
-                while ((IQHeadPtr[DDC] - IQReadPtr[DDC]) > VIQBYTESPERFRAME)
-                {
-//                    printf("enough data for packet: DDC= %d\n", DDC);
-                    *(uint32_t*)UDPBuffer[DDC] = htonl(SequenceCounter[DDC]++);     // add sequence count
-                    memset(UDPBuffer[DDC] + 4, 0, 8);                               // clear the timestamp data
-                    *(uint16_t*)(UDPBuffer[DDC] + 12) = htons(24);                  // bits per sample
-                    *(uint32_t*)(UDPBuffer[DDC] + 14) = htons(VIQSAMPLESPERFRAME);  // I/Q samples for ths frame
-                    //
-                    // now add I/Q data & send outgoing packet
-                    //
-                    memcpy(UDPBuffer[DDC] + 16, IQReadPtr[DDC], VIQBYTESPERFRAME);
-                    IQReadPtr[DDC] += VIQBYTESPERFRAME;
-
-                    int Error;
-                    Error = sendmsg((ThreadData+DDC)->Socketid, &datagram[DDC], 0);
-                    if(StartupCount != 0)                                   // decrement startup message count
-                        StartupCount--;
-
-                    if (Error == -1)
-                    {
-                        printf("Send Error, DDC=%d, errno=%d, socket id = %d\n", DDC, errno, (ThreadData+DDC)->Socketid);
-                        InitError = true;
-                    }
-                }
-                //
-                // now copy any residue to the start of the buffer (before the data copy in point)
-                // unless the buffer already starts at or below the base
-                // if we do a copy, the 1st free location is always base addr
-                //
-                ResidueBytes = IQHeadPtr[DDC] - IQReadPtr[DDC];
-                //		printf("Residue = %d bytes\n",ResidueBytes);
-                if (IQReadPtr[DDC] > IQBasePtr[DDC])                                // move data down
-                {
-                    if (ResidueBytes != 0) 		// if there is residue to move
-                    {
-                        memcpy(IQBasePtr[DDC] - ResidueBytes, IQReadPtr[DDC], ResidueBytes);
-                        IQReadPtr[DDC] = IQBasePtr[DDC] - ResidueBytes;
-                    }
-                    else
-                        IQReadPtr[DDC] = IQBasePtr[DDC];
-                    IQHeadPtr[DDC] = IQBasePtr[DDC];                            // ready for new data at base
-                }
-            }
+            ApplyDDCRateRequest();                                  // decode is at a frame boundary here
+            ReleaseIdleDDCRings();
             //
-            // P2 packet sending complete.There are no DDC buffers with enough data to send out.
-            // bring in more data by DMA if there is some, else sleep for a while and try again
-            // we have the same issue with DMA: a transfer isn't exactly aligned to the amount we can read out 
-            // according to the DDC settings. So we either need to have the part-used DDC transfer variables
-            // persistent across DMAs, or we need to recognise an incomplete fragment of a frame as such
-            // and copy it like we do with IQ data so the next readout begins at a new frame
-            // the latter approach seems easier!
+            // wait for a DMA block. Timed wait so that SDRActive is checked
             //
-            Depth = ReadFIFOMonitorChannel(eRXDDCDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);				// read the FIFO Depth register
-
-            if((StartupCount == 0) && FIFOOverThreshold)
+            Slot = SPSCGetReadSlot(&DDCDMARing);
+            if(Slot < 0)
+                GDDCRingEmptyWaits++;
+            clock_gettime(CLOCK_REALTIME, &WaitTime);
+            WaitTime.tv_nsec += VDDCCONSUMERTIMEOUT * 1000000L;
+            if(WaitTime.tv_nsec >= 1000000000L)
             {
-                GlobalFIFOOverflows |= 0b00000001;
-                if(UseDebug)
-                    printf("RX DDC FIFO Overthreshold, depth now = %d\n", Current);
+                WaitTime.tv_sec++;
+                WaitTime.tv_nsec -= 1000000000L;
             }
-// note this could often generate a message at low sample rate because we deliberately read it down to zero.
-// this isn't a problem as we can send the data on without the code becoming blocked. so not a useful trap.
-//            if((StartupCount == 0) && FIFOUnderflow)
-//                 printf("RX DDC FIFO Underflowed, depth now = %d\n", Current);
-            //		printf("read: depth = %d\n", Depth);
-            while(Depth < (DMATransferSize/8U))			// 8 bytes per location
-            {
-                usleep(500);								// 1ms wait
-                Depth = ReadFIFOMonitorChannel(eRXDDCDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);				// read the FIFO Depth register
-                if((StartupCount == 0) && FIFOOverThreshold)
-                {
-                    GlobalFIFOOverflows |= 0b00000001;
-                    if(UseDebug)
-                        printf("RX DDC FIFO Overthreshold, depth now = %d\n", Current);
-                }
-//                if((StartupCount == 0) && FIFOUnderflow)
-//                    printf("RX DDC FIFO Underflowed, depth now = %d\n", Current);
-             }
-//            printf("DDC DMA read %d bytes from destination to base\n", DMATransferSize);
-            if(Depth > 4096)
-                DMATransferSize = 32768;
-            else if(Depth > 2048)
-                DMATransferSize = 16384;
-            else if(Depth > 1024)
-                DMATransferSize = 8192;
-            else
-                DMATransferSize = 4096;
-
-            DMAReadFromFPGA(IQReadfile_fd, DMAHeadPtr, DMATransferSize, VADDRDDCSTREAMREAD);
-            DMAHeadPtr += DMATransferSize;
+            if(sem_timedwait(&DDCBlockAvailable, &WaitTime) != 0)
+                continue;
+            Slot = SPSCGetReadSlot(&DDCDMARing);
+            if(Slot < 0)
+                continue;
+            //
+            // the residue from the last block is in the data ring just below this block,
+            // so start the decode there to see whole frames
+            //
+            Block = DDCDMAData.Base + (DDCDMABlockOffset[Slot] & (DDCDMAData.Size - 1));
+            if(DDCCaptureFilename != NULL)
+                WriteDDCCaptureBlock(Block, DDCDMABlockLength[Slot], DDCDMABlockDepth[Slot], &DDCDMABlockTime[Slot]);
+            if(GEnableAlignmentTimestamps)
+                DDCDecodeBlockNs = GetDDCBlockEntryTime(Slot);
+            DMAReadPtr = DDCDMAData.Base + ((DDCDMABlockOffset[Slot] - DDCResidueBytes) & (DDCDMAData.Size - 1));
+            DMAHeadPtr = DMAReadPtr + DDCResidueBytes + DDCDMABlockLength[Slot];
             //
             // find header: may not be the 1st word
+            // then decode. If sync is lost, search the rest of the block for the next header.
+            // if several blocks go by without one, reset the FIFO and restart the stream
             //
 //            DumpMemoryBuffer(DMAReadPtr, DMATransferSize);
-            if(HeaderFound == false)                                                    // 1st time: look for header
-                for(Cntr=16; Cntr < (DMAHeadPtr - DMAReadPtr); Cntr+=8)                  // search for rate word; ignoring 1st
+            STAGETRACE_START(TraceStart);
+            RestartNeeded = false;
+            while(true)
+            {
+                if(HeaderFound == false)
                 {
-                    if(*(DMAReadPtr + Cntr + 7) == 0x80)
+                    HeaderFound = FindDDCHeader(Resync);
+                    if(HeaderFound == false)
                     {
-//                        printf("found header at offset=%x\n", Cntr);
-                        HeaderFound = true;
-                        DMAReadPtr += Cntr;                                             // point read buffer where header is 
+                        DMAReadPtr = DMAHeadPtr;                                // discard the block
+                        HeaderSearchStart = 0;
+                        if(DDCRateChangeBlocks != 0)                            // rate change under way: keep looking
+                            DDCRateChangeBlocks--;
+                        else if(++ResyncBlocks >= VDDCRESYNCBLOCKS)
+                            RestartNeeded = true;
                         break;
                     }
+                    ResyncBlocks = 0;
+                    Resync = false;
                 }
-            if (HeaderFound == false)                                        // if rate flag not set
-            {
-//                printf("Rate word not found when expected. rate= %08x\n", RateWord);
+                if(!DecodeDDCFrames())
+                    break;
+                HeaderFound = false;                                            // lost sync: search from next word
+                HeaderSearchStart = 8;
+                Resync = true;
+                GDDCResyncs++;
+            }
+            //
+            // now note the residue (the end of this block), to decode with the next block
+            // then the block can be given back to the DMA thread
+            //
+            ResidueBytes = DMAHeadPtr - DMAReadPtr;
+            if(ResidueBytes > VBASE)
+                ResidueBytes = VBASE;
+            DDCResidueBytes = ResidueBytes;
+            SPSCRelease(&DDCDMARing);
+            STAGETRACE_END(TraceStart, "demux", DDCDMABlockLength[Slot]);
+            if(DDCRingError)
                 InitError = true;
-                exit(1);
+            if(RestartNeeded)
+            {
+                RestartDDCStream();
+                Resync = true;
             }
-
-
             //
-            // finally copy data to DMA buffers according to the embedded DDC rate words
-            // the 1st word is pointed by DMAReadPtr and it should point to a DDC rate word
-            // search for it if not!
-            // (it should always be left in that state).
-            // the top half of the 1st 64 bit word should be 0x8000
-            // and that is located in the 2nd 32 bit location.
-            // assume that DMA is > 1 frame.
-//            printf("headptr = %x readptr = %x\n", DMAHeadPtr, DMAReadPtr);
-            DecodeByteCount = DMAHeadPtr - DMAReadPtr;
-            while (DecodeByteCount >= 16)                       // minimum size to try!
+            // loop through all DDC packet rings, and send all full slots
+            // or if there are sender threads, wake those with packets to send
+            //
+            if(DDCSenderCount == 0)
             {
-                if(*(DMAReadPtr + 7) != 0x80)
-                {
-                    printf("header not found for rate word at addr %lx\n", (uint64_t)DMAReadPtr);
-                    exit(1);
-                }
-                else                                                                    // analyse word, then process
-                {
-                    LongWordPtr = (uint32_t*)DMAReadPtr;                            // get 32 bit ptr
-                    RateWord = *LongWordPtr;                                      // read rate word
-
-                    if (RateWord != PrevRateWord)
-                    {
-                        FrameLength = AnalyseDDCHeader(RateWord, &DDCCounts[0]);           // read new settings
-//                        printf("new framelength = %d\n", FrameLength);
-                        PrevRateWord = RateWord;                                        // so so we know its analysed
-                    }
-                    if (DecodeByteCount >= ((FrameLength+1) * 8))             // if bytes for header & frame
-                    {
-                        //THEN COPY DMA DATA TO I / Q BUFFERS
-                        DMAReadPtr += 8;                                                // point to 1st location past rate word
-                        SrcWordPtr = (uint16_t*)DMAReadPtr;                             // read sample data in 16 bit chunks
-                        for (DDC = 0; DDC < VNUMDDC; DDC++)
+                for (DDC = 0; DDC < VNUMDDC; DDC++)
+                    if(SendDDCPackets(&DDCSenders[0], DDC))
+                        InitError = true;
+            }
+            else
+            {
+                for (Cntr = 0; Cntr < DDCSenderCount; Cntr++)
+                    for (DDC = Cntr; DDC < VNUMDDC; DDC += DDCSenderCount)
+                        if(SPSCOccupancy(&DDCPacketIndex[DDC]) != 0)
                         {
-                            HdrWord = DDCCounts[DDC];                                   // number of words for this DDC. reuse variable
-                            if (HdrWord != 0)
-                            {
-                                DestWordPtr = (uint16_t *)IQHeadPtr[DDC];
-                                for (Cntr = 0; Cntr < HdrWord; Cntr++)                  // count 64 bit words
-                                {
-                                    *DestWordPtr++ = *SrcWordPtr++;                     // move 48 bits of sample data
-                                    *DestWordPtr++ = *SrcWordPtr++;
-                                    *DestWordPtr++ = *SrcWordPtr++;
-                                    SrcWordPtr++;                                       // and skip 16 bits where theres no data
-                                }
-                                IQHeadPtr[DDC] += 6 * HdrWord;                          // 6 bytes per sample
-                            }
-                            // read N samples; write at head ptr
+                            sem_post(&DDCSenders[Cntr].PacketsReady);
+                            break;
                         }
-                        DMAReadPtr += FrameLength * 8;                                  // that's how many bytes we read out
-                        DecodeByteCount -= (FrameLength+1) * 8;
-                    }
-                    else
-                        break;                                                          // if not enough left, exit loop
-                }
+                if(__atomic_load_n(&DDCSendError, __ATOMIC_ACQUIRE))
+                    InitError = true;
             }
-            //
-            // now copy any residue to the start of the buffer (before the data copy in point)
-            // unless the buffer already starts at or below the base
-            // if we do a copy, the 1st free location is always base addr
-            //
-            ResidueBytes = DMAHeadPtr - DMAReadPtr;
-            //		printf("Residue = %d bytes\n",ResidueBytes);
-            if (DMAReadPtr > DMABasePtr)                                // move data down
+            if(!DDCResumeReported && (__atomic_load_n(&GDDCPacketsSent, __ATOMIC_RELAXED) != 0))
             {
-                if (ResidueBytes != 0) 		// if there is residue to move
-                {
-                    memcpy(DMABasePtr - ResidueBytes, DMAReadPtr, ResidueBytes);
-                    DMAReadPtr = DMABasePtr - ResidueBytes;
-                }
-                else
-                    DMAReadPtr = DMABasePtr;
-                DMAHeadPtr = DMABasePtr;                            // ready for new data at base
+                ReportDDCResumeTime();
+                DDCResumeReported = true;
             }
         }     // end of while(!InitError) loop
+        //
+        // rate changes from now on are written by the DDC specific thread; apply any left posted
+        //
+        __atomic_store_n(&DDCStreamActive, false, __ATOMIC_SEQ_CST);
+        if(__atomic_exchange_n(&DDCRateRequestPending, false, __ATOMIC_SEQ_CST))
+            RegisterWrite(VADDRDDCRATES, __atomic_load_n(&DDCRateRequest, __ATOMIC_ACQUIRE));
+        //
+        // stop the DMA thread and sender threads, and wait until they are idle
+        //
+        __atomic_store_n(&DDCProducerRun, false, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&DDCSendersRun, false, __ATOMIC_SEQ_CST);
+        while(__atomic_load_n(&DDCProducerBusy, __ATOMIC_SEQ_CST))
+            usleep(100);
+        for (Cntr = 0; Cntr < DDCSenderCount; Cntr++)
+            while(__atomic_load_n(&DDCSenders[Cntr].Busy, __ATOMIC_SEQ_CST))
+                usleep(100);
+        ParkDDCStream();                                            // DDC primed for a fast restart
+        StopDDCRetransmitSession();
+        NoteDDCRingsStopped(DDCRingsInUse);                         // rings kept for a while, for the next session
+        DDCRingsInUse = 0;
+        STAGETRACE_DUMP();
+        if(DDCCaptureFilename != NULL)
+            CloseDDCCapture();
+        if(GDDCSendCalls != 0)
+            printf("DDC packets sent = %llu, average sendmmsg batch = %.2f packets\n",
+                   (unsigned long long)GDDCPacketsSent, (double)GDDCPacketsSent / GDDCSendCalls);
+        if(GDDCSendBackoffs != 0)
+            printf("DDC send queue full = %llu times, packets dropped = %llu\n",
+                   (unsigned long long)GDDCSendBackoffs, (unsigned long long)GDDCSendDrops);
+        if(DDCFanoutCount != 0)
+            printf("DDC fan-out packets sent = %llu\n", (unsigned long long)GDDCFanoutSent);
+        printf("DDC DMA blocks = %llu, ring full stalls (send limited) = %llu, ring empty waits (FIFO limited) = %llu, max blocks queued = %d\n",
+               (unsigned long long)GDDCDMABlockCount, (unsigned long long)GDDCRingFullStalls,
+               (unsigned long long)GDDCRingEmptyWaits, GDDCRingMaxOccupancy);
+        if(GDDCResyncs != 0)
+            printf("DDC stream resyncs = %llu, bytes discarded = %llu, FIFO resets = %llu\n",
+                   (unsigned long long)GDDCResyncs, (unsigned long long)GDDCResyncBytes,
+                   (unsigned long long)GDDCFIFOResets);
+        if(GDDCRateChanges != 0)
+            printf("DDC rate changes applied without a restart = %llu\n", (unsigned long long)GDDCRateChanges);
+        if(GDDCShedPackets != 0)
+            printf("DDC packets not sent (overload shedding) = %llu\n", (unsigned long long)GDDCShedPackets);
+        if(GDDCPureSignalPads != 0)
+            printf("DDC interleaved pairs re-aligned = %llu times\n", (unsigned long long)GDDCPureSignalPads);
+        if(GDDCDecodeRuns != 0)
+            printf("DDC frames decoded = %llu, average frames per rate word check = %.1f\n",
+                   (unsigned long long)GDDCDecodeFrames, (double)GDDCDecodeFrames / GDDCDecodeRuns);
+        if(GDDCDMABlockCount != 0)
+            printf("DDC average DMA = %llu bytes, measured FIFO fill rate = %d words/s, target latency = %dus\n",
+                   (unsigned long long)(GDDCDMABytes / GDDCDMABlockCount), DDCMeasuredWordRate, DDCTargetLatency);
+        if(DDCSenderCount != 0)
+            printf("DDC sender threads = %d, packet ring full stalls = %llu\n", DDCSenderCount, (unsigned long long)GDDCSlotStalls);
     }
 
 //
 // tidy shutdown of the thread
 //
     printf("shutting down DDC outgoing thread\n");
-    close(ThreadData->Socketid); 
-    ThreadData->Active = false;                   // signal closed
+    __atomic_store_n(&DDCProducerRun, false, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&DDCProducerExit, true, __ATOMIC_RELEASE);
+    sem_post(&DDCProducerWake);
+    while(__atomic_load_n(&DDCProducerBusy, __ATOMIC_SEQ_CST))
+        usleep(100);
+    if(DDCEvent_fd >= 0)
+        CloseUserIRQWaiter(DDCEvent_fd);
+    close(DDCThreadData->Socketid); 
+    DDCThreadData->Active = false;                   // signal closed
     FreeDynamicMemory();
     return NULL;
 }
@@ -623,3 +2710,60 @@ void HandlerCheckDDCSettings(void)
 {
 
 }
+
+
+//
+// post a new DDC rate word to the running stream thread
+// the request is set before DDCStreamActive is tested, and the stream thread clears
+// DDCStreamActive before taking a last request, so exactly one side writes the register
+//
+bool RequestDDCRateChange(uint32_t RateWord)
+{
+    __atomic_store_n(&DDCRateRequest, RateWord, __ATOMIC_RELEASE);
+    __atomic_store_n(&DDCRateRequestPending, true, __ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&DDCStreamActive, __ATOMIC_SEQ_CST) &&
+        __atomic_exchange_n(&DDCRateRequestPending, false, __ATOMIC_SEQ_CST))
+        return false;                                               // not running: caller writes it
+    return true;
+}
+
+
+//
+// set the DDC packet format asked for by the client (general packet)
+// it takes effect when the DDC stream next starts
+//
+void SetDDCPacketFormat(uint8_t Format)
+{
+    if (Format > VDDCFORMATBFP16)
+        Format = VDDCFORMAT24BIT;                                   // unknown: use the standard format
+    DDCFormatRequest = Format;
+}
+
+
+//
+// set the DDC samples per packet asked for by the client, from the general packet
+// out of range sizes are clamped; an even count keeps PureSignal pairs in one packet
+//
+void SetDDCPacketSamples(uint16_t Samples)
+{
+    if (Samples < VIQSAMPLESPERFRAME)
+        Samples = VIQSAMPLESPERFRAME;                               // 0: the standard size
+    else if (Samples > VDDCMAXFRAMESAMPLES)
+        Samples = VDDCMAXFRAMESAMPLES;
+    Samples &= ~1U;
+    if (Samples != DDCSamplesRequest)
+        printf("DDC packets of %d samples requested\n", Samples);
+    __atomic_store_n(&DDCSamplesRequest, Samples, __ATOMIC_RELAXED);
+}
+
+
+//
+// turn mic/DDC alignment timestamps on or off, from the general packet
+// DDC packets then carry wall clock timestamps anchored to the FIFO entry time
+//
+void SetAlignmentTimestamps(bool Enabled)
+{
+    if (Enabled != GEnableAlignmentTimestamps)
+        printf("mic/DDC alignment timestamps %s\n", Enabled ? "on" : "off");
+    GEnableAlignmentTimestamps = Enabled;
+}
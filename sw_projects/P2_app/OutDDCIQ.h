@@ -19,10 +19,45 @@
 
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "../common/saturntypes.h"
 
 
 #define VDDCPACKETSIZE 1444             // each DDC I/Qpacket
+#define VDDCHEADERSIZE 16               // bytes before the I/Q samples in a DDC packet
+#define VIQSAMPLESPERFRAME 238          // total I/Q samples in one DDC packet
+#define VIQBYTESPERFRAME 6*VIQSAMPLESPERFRAME   // total bytes in one outgoing frame
+#define VDDCMAXFRAMESAMPLES 1490        // most I/Q samples in a jumbo DDC packet (fits a 9000 byte MTU)
+#define VDDCDEFAULTLATENCY 2000         // default target DDC FIFO latency (us) for DMA sizing
+#define VDDCMINLATENCY 100              // smallest target latency allowed (us)
+#define VDDCFORMAT24BIT 0               // DDC packet formats: standard 24 bit samples
+#define VDDCFORMATBFP16 1               // 16 bit block floating point (see ddccompress.h)
+#define VDDCFORMATVITA49 2              // VITA-49 IF data packets: set by the general packet VITA-49 flag
+
+
+//
+// batched transmit statistics. Average batch size = GDDCPacketsSent / GDDCSendCalls
+//
+extern uint64_t GDDCPacketsSent;                // DDC packets sent since stream started
+extern uint64_t GDDCSendCalls;                  // sendmmsg() calls made to send them
+
+
+//
+// DDC back pressure, read by the overload controller (overload.h). The counts are
+// cleared at the start of each session
+//
+extern volatile uint32_t GDDCFIFODepth;         // last DDC FIFO depth read
+extern uint64_t GDDCSendBackoffs;               // sends that found the socket queue full
+extern uint64_t GDDCSendDrops;                  // packets dropped after repeated full queues
+extern uint64_t GDDCRingFullStalls;             // DMA thread found the DMA block ring full
+extern uint64_t GDDCShedPackets;                // packets not sent because their DDC was shed
+
+
+//
+// uint32_t GetDDCSheddableMask(void)
+// the DDCs the stream writes packets for that overload shedding may drop: all but PureSignal pairs
+//
+uint32_t GetDDCSheddableMask(void);
 
 
 //
@@ -31,11 +66,65 @@
 void *OutgoingDDCIQ(void *arg);
 
 
+//
+// add a fan-out destination for DDC data: <IPv4 address>[:<port>][@<DDC>,<DDC>...]
+// (a client address or multicast group). Call before the DDC thread starts.
+// returns true if successful
+//
+bool AddDDCFanout(const char* Spec);
+
+
+//
+// add a software decimated stream: <source DDC>:<target DDC>:<factor> (a power of 2, 2 to 32)
+// while the client enables the source DDC but not the target, the source samples are
+// decimated and sent as the target DDC, at the source rate / factor. Call before the DDC thread starts.
+// returns true if successful
+//
+bool AddDDCDecimation(const char* Spec);
+
+
 //
 // interface calls to get commands from PC settings
 //
 
 
+//
+// RequestDDCRateChange()
+// pass a new DDC rate word (from SetP2SampleRate()) to the DDC stream thread, which writes
+// the register between frames and carries on without a FIFO reset.
+// returns false if the stream isn't running: then the caller writes the register itself
+//
+bool RequestDDCRateChange(uint32_t RateWord);
+
+
+//
+// SetDDCPacketFormat()
+// set the DDC packet format from the general packet: VDDCFORMAT24BIT or VDDCFORMATBFP16
+// takes effect when the DDC stream next starts
+//
+void SetDDCPacketFormat(uint8_t Format);
+
+
+//
+// SetDDCPacketSamples()
+// set the I/Q samples per DDC packet from the general packet (Saturn extension, bytes 41-42):
+// 0 = VIQSAMPLESPERFRAME (standard), else up to VDDCMAXFRAMESAMPLES for jumbo frames,
+// rounded down to an even count. Takes effect when the DDC stream next starts
+//
+void SetDDCPacketSamples(uint16_t Samples);
+
+
+//
+// SetAlignmentTimestamps()
+// set from the general packet (byte 37 bit 4): DDC and mic packets carry timestamps on
+// one clock (wall clock ns, anchored to when samples entered the FIFO) so the client can
+// line the mic samples up with the DDC samples. Mic timestamps take effect when the mic
+// stream next starts.
+//
+extern bool GEnableAlignmentTimestamps;
+void SetAlignmentTimestamps(bool Enabled);
+
+
 //
 // HandlerCheckDDCSettings()
 // called when DDC settings have been changed. Check which DDCs are enabled, and sample rate.
@@ -17,6 +17,9 @@
 #include <stdint.h>
 #include "../common/saturntypes.h"
 #include "OutHighPriority.h"
+#include "radiostate.h"
+#include "overload.h"
+#include "threadmanager.h"
 #include <errno.h>
 #include <stdlib.h>
 #include <stddef.h>
@@ -28,10 +31,101 @@
 #include <syscall.h>
 #include "../common/saturnregisters.h"
 #include "../common/saturndrivers.h"
+#include "../common/hwaccess.h"
 #include "LDGATU.h"
+#include <time.h>
 
 
-uint8_t GlobalFIFOOverflows = 0;             // FIFO overflow words
+#define VHPTXPERIOD 1000                            // us between packets in TX
+#define VHPRXPERIOD 200000                          // us between packets in RX
+#define VHPPOLLTIME 500                             // us between status checks, if polled
+
+
+//
+// wait until the next packet is due, or until a PTT/key input change or ADC overflow
+// which must be sent immediately.
+// with the status change interrupt, the thread sleeps until an interrupt or the period
+// ends. Until an interrupt has been seen, the status is also polled, so this behaves
+// as before if the interrupt isn't wired in the FPGA.
+// returns the ADC overflow bits seen while waiting; WakeTime is when the change was seen
+//
+static uint8_t WaitForStatusChange(int Event_fd, bool* InterruptSeen, uint8_t PTTBits, uint32_t Period,
+                                   struct timespec* WakeTime)
+{
+  struct TelemetrySnapshot Telemetry;
+  struct timespec Now, Deadline;
+  int64_t RemainingUs;
+  uint8_t ADCOverflows = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &Deadline);
+  *WakeTime = Deadline;
+  Deadline.tv_nsec += (long)Period * 1000L;
+  Deadline.tv_sec += Deadline.tv_nsec / 1000000000L;
+  Deadline.tv_nsec %= 1000000000L;
+  while(1)
+  {
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    RemainingUs = (int64_t)(Deadline.tv_sec - Now.tv_sec) * 1000000 + (Deadline.tv_nsec - Now.tv_nsec) / 1000;
+    if(RemainingUs <= 0)
+      break;
+    if((Event_fd >= 0) && *InterruptSeen)
+    {
+      if(WaitFIFOMonitorEvent(Event_fd, (int)((RemainingUs + 999) / 1000)))   // sleep till change or period end
+        *InterruptSeen = true;
+    }
+    else if((Event_fd >= 0) && WaitFIFOMonitorEvent(Event_fd, 0))
+      *InterruptSeen = true;
+    else
+      usleep((RemainingUs < VHPPOLLTIME) ? RemainingUs : VHPPOLLTIME);
+    clock_gettime(CLOCK_MONOTONIC, WakeTime);
+    ReadTelemetrySnapshot(&Telemetry, false);                   // status and ADC overflow only
+    if ((uint8_t)GetP2PTTKeyInputs() != PTTBits)
+      break;
+    ADCOverflows |= (uint8_t)Telemetry.ADCOverflow;
+    if(ADCOverflows != 0)
+      break;
+  }
+  return ADCOverflows;
+}
+
+
+uint8_t GlobalFIFOOverflows __attribute__((aligned(VCACHELINESIZE))) = 0;   // FIFO overflow words, set by the stream threads
+
+
+//
+// PTT/key edge packets: when only the PTT and key bits have changed, the previous packet is
+// sent again at once with just the new status byte, without reading the telemetry and FIFO
+// registers first. The full packet follows 1ms later (the TX period).
+// the time from seeing the edge to the packet being sent is measured.
+//
+static uint32_t EdgeCount = 0;                          // edge packets sent this session
+static uint64_t EdgeTotalNs = 0;                        // for the average
+static uint32_t EdgeMaxNs = 0;                          // longest
+
+
+//
+// send the previous packet with new PTT/key bits, and time it from the edge
+//
+static int SendStatusEdge(int Socketid, struct msghdr* Datagram, uint8_t* UDPBuffer, uint32_t Sequence,
+                          uint8_t PTTBits, const struct timespec* WakeTime)
+{
+  struct timespec Now;
+  uint32_t Elapsed;
+  int Error;
+
+  *(uint32_t *)UDPBuffer = htonl(Sequence);
+  UDPBuffer[4] = PTTBits;
+  UDPBuffer[5] = 0;                                     // overflows already reported
+  UDPBuffer[30] = 0;
+  Error = sendmsg(Socketid, Datagram, 0);
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  Elapsed = (uint32_t)((Now.tv_sec - WakeTime->tv_sec) * 1000000000L + (Now.tv_nsec - WakeTime->tv_nsec));
+  EdgeCount++;
+  EdgeTotalNs += Elapsed;
+  if(Elapsed > EdgeMaxNs)
+    EdgeMaxNs = Elapsed;
+  return Error;
+}
 
 
 
@@ -52,6 +146,7 @@ void *OutgoingHighPriority(void *arg)
 
   struct ThreadSocketData *ThreadData;            // socket etc data for this thread
   struct sockaddr_in DestAddr;                    // destination address for outgoing data
+  struct RadioState State;                        // radio state snapshot at session start
   bool InitError = false;
   int Error;
   uint8_t Byte;                                   // data being encoded
@@ -61,6 +156,14 @@ void *OutgoingHighPriority(void *arg)
   bool FIFOOverflow, FIFOUnderflow, FIFOOverThreshold;      // FIFO flags
   uint8_t FIFOOverflows;
   uint8_t ADCOverflows = 0;                       // set non zero if ADC overflows detected
+  uint32_t StateCount;                            // thread state changes seen
+  struct TelemetrySnapshot Telemetry;             // status, overflow and analogue registers
+  int StatusEvent_fd = -1;                        // status change interrupt events device
+  bool StatusInterruptSeen = false;               // true once a status change interrupt has occurred
+  uint8_t PTTBits = 0;                            // PTT bits - and change means a new message needed
+  uint8_t NewPTTBits;
+  bool EdgeSent = false;                          // true if an edge packet has just been sent
+  struct timespec WakeTime;                       // when the last status change was seen
 
 //
 // initialise. Create memory buffers and open DMA file devices
@@ -68,6 +171,12 @@ void *OutgoingHighPriority(void *arg)
   ThreadData = (struct ThreadSocketData *)arg;
   ThreadData->Active = true;
   printf("spinning up outgoing high priority with port %d, pid=%ld\n", ThreadData->Portid, syscall(SYS_gettid));
+  if(UseStatusInterrupt)
+  {
+    StatusEvent_fd = OpenUserIRQWaiter(VIRQSTATUS);
+    if(StatusEvent_fd < 0)
+      printf("XDMA event device %s not available, polling for status changes\n", VSTATUSEVENTDEVICE);
+  }
 
 //
 // OK, now the main work
@@ -75,9 +184,10 @@ void *OutgoingHighPriority(void *arg)
 // threat may also be commanded to close down and re-open its socket by command byte 
 // VBITCHANGEPORT bit being set (shold only happen when not running)
 //
-  while (!InitError)
+  while (!InitError && !ThreadStopRequested())
   {
-    while(!(SDRActive))
+    StateCount = GetThreadStateCount();
+    while(!__atomic_load_n(&SDRActive, __ATOMIC_ACQUIRE) && !ThreadStopRequested())
     {
       if(ThreadData->Cmdid & VBITCHANGEPORT)
       {
@@ -85,15 +195,22 @@ void *OutgoingHighPriority(void *arg)
         MakeSocket(ThreadData, 0);                        // this binds to the new port.
         ThreadData->Cmdid &= ~VBITCHANGEPORT;             // clear command bit
       }
-      usleep(100);
+      WaitThreadStateChange(&StateCount);                 // sleep until the state changes
     }
+    if(ThreadStopRequested())
+      break;
     //
     // if we get here, run has been initiated
     // initialise outgoing data packet
     //
     SequenceCounter = 0;
+    EdgeSent = false;
+    EdgeCount = 0;
+    EdgeTotalNs = 0;
+    EdgeMaxNs = 0;
     printf("starting outgoing high priority data\n");
-    memcpy(&DestAddr, &reply_addr, sizeof(struct sockaddr_in));           // local copy of PC destination address
+    ReadRadioState(&State);
+    memcpy(&DestAddr, &State.ReplyAddr, sizeof(struct sockaddr_in));      // local copy of PC destination address
     memset(&iovecinst, 0, sizeof(struct iovec));
     memset(&datagram, 0, sizeof(datagram));
     memset(UDPBuffer, 0,sizeof(UDPBuffer));                      // clear the whole packet
@@ -112,30 +229,30 @@ void *OutgoingHighPriority(void *arg)
     // when a DDC becomes enabled, its paired DDC may not know yet and may still be set to interleaved.
     // when a DDC is set to interleaved, the paired DDC may not have been disabled yet.
     //
-    while(SDRActive && !InitError)                               // main loop
+    while(__atomic_load_n(&SDRActive, __ATOMIC_ACQUIRE) && !InitError)                               // main loop
     {
-      uint16_t SleepCount;                                      // counter for sending next message
-      uint8_t PTTBits;                                          // PTT bits - and change means a new message needed
+      if(EdgeSent)                                              // edge packet sent: wait for the next period
+        goto wait;
       // create the packet
       *(uint32_t *)UDPBuffer = htonl(SequenceCounter++);        // add sequence count
-      ReadStatusRegister();
+      ReadTelemetrySnapshot(&Telemetry, true);                  // all the registers, published for other threads
       PTTBits = (uint8_t)GetP2PTTKeyInputs();
       *(uint8_t *)(UDPBuffer+4) = PTTBits;
-      ADCOverflows |= (uint8_t)GetADCOverflow();                // add in any new overflows
+      ADCOverflows |= (uint8_t)Telemetry.ADCOverflow;           // add in any new overflows
       *(uint8_t *)(UDPBuffer+5) = ADCOverflows;
       ADCOverflows = 0;                                         // and clear ready for next test
-      Word = (uint16_t)GetAnalogueIn(4);
+      Word = (uint16_t)Telemetry.Analogue[4];
       *(uint16_t *)(UDPBuffer+6) = htons(Word);                // exciter power
-      Word = (uint16_t)GetAnalogueIn(0);
+      Word = (uint16_t)Telemetry.Analogue[0];
       *(uint16_t *)(UDPBuffer+14) = htons(Word);               // forward power
-      Word = (uint16_t)GetAnalogueIn(1);
+      Word = (uint16_t)Telemetry.Analogue[1];
       *(uint16_t *)(UDPBuffer+22) = htons(Word);               // reverse power
-      Word = (uint16_t)GetAnalogueIn(5);
+      Word = (uint16_t)Telemetry.Analogue[5];
       *(uint16_t *)(UDPBuffer+49) = htons(Word);               // supply voltage
 
-      Word = (uint16_t)GetAnalogueIn(2);
+      Word = (uint16_t)Telemetry.Analogue[2];
       *(uint16_t *)(UDPBuffer+57) = htons(Word);               // AIN3 user_analog1
-      Word = (uint16_t)GetAnalogueIn(3);
+      Word = (uint16_t)Telemetry.Analogue[3];
       *(uint16_t *)(UDPBuffer+55) = htons(Word);               // AIN4 user_analog2
 
       Byte = (uint8_t)GetUserIOBits();                  // user I/O bits
@@ -170,11 +287,22 @@ void *OutgoingHighPriority(void *arg)
       if(FIFOUnderflow)
         FIFOOverflows |= 0b00001000;
 
-      FIFOOverflows |= GlobalFIFOOverflows;                   // copy in any bits set during normal data transfer
+      FIFOOverflows |= __atomic_exchange_n(&GlobalFIFOOverflows, 0, __ATOMIC_RELAXED);  // take and clear any bits set during normal data transfer
       *(uint8_t *)(UDPBuffer+30) = FIFOOverflows;
-      GlobalFIFOOverflows = 0;                                // clear any overflows
       FIFOOverflows = 0;
+
+//
+// Saturn extension: overload shedding state (see overload.h)
+//
+      GetOverloadStatus(&Byte, &Word);
+      *(uint8_t *)(UDPBuffer+39) = Byte;
+      *(uint16_t *)(UDPBuffer+40) = htons(Word);                // DDCs whose packets are dropped
       Error = sendmsg(ThreadData -> Socketid, &datagram, 0);
+      if((Error == -1) && IsSendBackpressure(errno))
+      {
+        __atomic_fetch_or(&GlobalFIFOOverflows, UDPBuffer[30], __ATOMIC_RELAXED);  // queue full: report the overflows in the next packet
+        Error = 0;
+      }
 
 
       //
@@ -193,21 +321,33 @@ void *OutgoingHighPriority(void *arg)
       //
       // now we need to sleep for 1ms (in TX) or 200ms (not in TX)
       // BUT if any of the PTT or key inputs change, or ADC overflow detected, send a message immediately
-      // so break up the 200ms period with smaller sleeps
+      // so break up the 200ms period with smaller sleeps, or wait for the status change interrupt
       // thank you to Rick N1GP for recommending this approach
+      // after an edge packet, the full packet follows at the TX period
+      //
+wait:
+      ADCOverflows = WaitForStatusChange(StatusEvent_fd, &StatusInterruptSeen, PTTBits,
+                                         (MOXAsserted || EdgeSent) ? VHPTXPERIOD : VHPRXPERIOD, &WakeTime);
+      EdgeSent = false;
+      //
+      // if only the PTT/key bits changed, send the edge packet now
       //
-      SleepCount = (MOXAsserted) ? 2 : 400;
-      while (SleepCount-- > 0)
+      NewPTTBits = (uint8_t)GetP2PTTKeyInputs();
+      if((NewPTTBits != PTTBits) && (ADCOverflows == 0) && (SequenceCounter != 0))
       {
-        ReadStatusRegister();
-        if ((uint8_t)GetP2PTTKeyInputs() != PTTBits)
-          break;
-        ADCOverflows |= (uint8_t)GetADCOverflow();
-        if(ADCOverflows != 0)
-          break;
-        usleep(500);
+        Error = SendStatusEdge(ThreadData -> Socketid, &datagram, UDPBuffer, SequenceCounter++, NewPTTBits, &WakeTime);
+        if((Error == -1) && !IsSendBackpressure(errno))
+        {
+          printf("High Priority Send Error, errno=%d\n", errno);
+          InitError = true;
+        }
+        PTTBits = NewPTTBits;
+        EdgeSent = (Error != -1);                                // (if not sent, send the full packet now)
       }
     }
+    if(UseDebug && (EdgeCount != 0))
+      printf("PTT/key edge packets: %u, edge to send average %lluns, longest %uns\n",
+             EdgeCount, (unsigned long long)(EdgeTotalNs / EdgeCount), EdgeMaxNs);
   }
 //
 // tidy shutdown of the thread
@@ -215,6 +355,8 @@ void *OutgoingHighPriority(void *arg)
   if(InitError)                                           // if error, flag it to main program
     ThreadError = true;
   printf("shutting down outgoing high priority thread\n");
+  if(StatusEvent_fd >= 0)
+    CloseUserIRQWaiter(StatusEvent_fd);
   close(ThreadData->Socketid); 
   ThreadData->Active = false;                   // signal closed
   return NULL;
@@ -17,6 +17,8 @@
 #include <stdint.h>
 #include "../common/saturntypes.h"
 #include "OutMicAudio.h"
+#include "radiostate.h"
+#include "threadmanager.h"
 #include <errno.h>
 #include <fcntl.h>
 #include <stdlib.h>
@@ -26,20 +28,74 @@
 #include <string.h>
 #include <pthread.h>
 #include <syscall.h>
+#include <sched.h>
 #include "../common/saturnregisters.h"
 #include "../common/saturndrivers.h"
 #include "../common/hwaccess.h"
+#include "../common/streamcore.h"
+#include "../common/ringlog.h"
+#include "metrics.h"
+#include "OutDDCIQ.h"
 
 
-#define VMICSAMPLESPERFRAME 64
-#define VDMABUFFERSIZE 32768						// memory buffer to reserve
-#define VALIGNMENT 4096                             // buffer alignment
-#define VBASE 0x1000                                // offset into I/Q buffer for DMA to start
-#define VDMATRANSFERSIZE 128                        // read 1 message at a time
+#define VMICSAMPLESPERFRAME 64                      // standard message
+#define VMICSAMPLERATE 48000                        // codec sample rate, for alignment timestamps
+#define VMICRINGSIZE 8192                           // mic ring buffer
+#define VDMATRANSFERSIZE 128                        // size of 1 standard message of mic samples
+#define VMICFIFOLOCATIONS (VMICSAMPLESPERFRAME/4)   // 16 FIFO locations = 64 samples = 1 standard message
+#define VMICMAXBATCH 8                              // most messages read in one DMA and sent by one sendmmsg
 #define VSTARTUPDELAY 100                           // 100 messages (~100ms) before reporting under or overflows
 
 
     int DMAReadfile_fd = -1;								// DMA read file device (global, used also by wideband)
+    static volatile int MicDMARequests = 0;                 // mic claims waiting for or holding the DMA channel
+    static uint8_t MicFrameRequest = 1;                     // mic message size asked for, in standard messages
+
+
+//
+// set the mic message size asked for by the client (general packet)
+// it takes effect when the mic stream next starts
+//
+void SetMicFrameSize(uint8_t Multiple)
+{
+    if ((Multiple != 2) && (Multiple != 4))
+        Multiple = 1;                                       // 0, or unknown: the standard size
+    __atomic_store_n(&MicFrameRequest, Multiple, __ATOMIC_RELAXED);
+}
+
+
+//
+// claim the DMA read channel shared by mic and wideband reads
+// a mic claim is registered before waiting for the mutex; a wideband claim
+// yields while any mic claim is registered, so mic reads jump the queue.
+// a mic claim made just after the wideband check waits for one wideband chunk at most.
+//
+void ClaimMicWBDMA(bool IsMic)
+{
+    if(IsMic)
+    {
+        __atomic_add_fetch(&MicDMARequests, 1, __ATOMIC_SEQ_CST);
+        sem_wait(&MicWBDMAMutex);                       // get protected access
+    }
+    else
+    {
+        while(__atomic_load_n(&MicDMARequests, __ATOMIC_SEQ_CST) != 0)
+            sched_yield();
+        sem_wait(&MicWBDMAMutex);                       // get protected access
+    }
+}
+
+
+//
+// release the DMA read channel
+// (a mic claim is cleared here, not when granted, so wideband stays off the channel till the mic read is done)
+//
+void ReleaseMicWBDMA(bool IsMic)
+{
+    if(IsMic)
+        __atomic_sub_fetch(&MicDMARequests, 1, __ATOMIC_SEQ_CST);
+    sem_post(&MicWBDMAMutex);                           // release protected access
+}
 
 
 
@@ -49,32 +105,36 @@
 // will be instructed to stop & exit by main loop setting enable_thread to 0
 // this code signals thread terminated by setting active_thread = 0
 // for now this code aims to send out packets until it is just ahead of the I/Q packets
+// the client can ask for larger messages (128 or 256 samples) in the general packet: then
+// each DMA and sendmmsg() moves as many samples, with half or a quarter of the packets.
+// with alignment timestamps (general packet) each packet has a 64 bit timestamp after the
+// sequence number, on the same clock as the DDC timestamps: see OutMicAudio.h
 //
 void *OutgoingMicSamples(void *arg)
 {
 //
 // variables for outgoing UDP frame
 //
-    struct iovec iovecinst;                                 // instance of iovec
-    struct msghdr datagram;
-    uint8_t UDPBuffer[VMICPACKETSIZE];                      // DDC frame buffer
-    uint32_t SequenceCounter = 0;                           // UDP sequence count
+    struct StreamPacketiser MicPacketiser;                  // makes and sends the mic packets
+    uint32_t Frames;                                        // mic messages read in this DMA
+    uint32_t FrameMultiple = 1;                             // standard messages per mic message
+    uint32_t FrameBytes = VDMATRANSFERSIZE;                 // size of 1 mic message of samples
 
     struct ThreadSocketData* ThreadData;            // socket etc data for this thread
+    uint32_t StateCount;                            // thread state changes seen
     struct sockaddr_in DestAddr;                    // destination address for outgoing data
+    struct RadioState State;                        // radio state snapshot at session start
     bool InitError = false;
-    int Error;
+    int Sent;
+    struct timespec LoopStart;                      // time DMA and send started, for metrics
+    struct timespec Now;                            // wall clock at the 1st DMA, for alignment timestamps
 
 //
 // variables for DMA buffer 
 //
-    uint8_t* MicReadBuffer = NULL;							// data for DMA read from DDC
-    uint32_t MicBufferSize = VDMABUFFERSIZE;
-    unsigned char* MicBasePtr;								// ptr to DMA location in mic memory
+    struct StreamRing MicRing;                              // data for DMA read from mic
+    struct StreamSource MicSource;                          // mic FIFO
     uint32_t Depth = 0;
-    uint32_t RegisterValue;
-    bool FIFOOverflow, FIFOUnderflow, FIFOOverThreshold;
-    unsigned int Current;                                   // current occupied locations in FIFO
     unsigned int StartupCount;                              // used to delay reporting of under & overflows
 
 
@@ -88,28 +148,31 @@ void *OutgoingMicSamples(void *arg)
     printf("spinning up outgoing mic thread with port %d, pid=%ld\n", ThreadData->Portid, syscall(SYS_gettid));
 
 //
-// setup DMA buffer
+// setup DMA ring and packetiser
 //
-    posix_memalign((void**)&MicReadBuffer, VALIGNMENT, MicBufferSize);
-    if (!MicReadBuffer)
+    if(!StreamRingCreate(&MicRing, VMICRINGSIZE, "mic"))
     {
         printf("mic read buffer allocation failed\n");
         InitError = true;
     }
-    MicBasePtr = MicReadBuffer + VBASE;
-    memset(MicReadBuffer, 0, MicBufferSize);
+    else
+        MetricsAddBufferBytes(eMicMetrics, VMICRINGSIZE);
+    if(!StreamPacketiserCreate(&MicPacketiser, ThreadData->Socketid, &DestAddr, VDMATRANSFERSIZE))
+        InitError = true;
 
 
   //
   // open DMA device driver
   // opened readonly to accommodate potential use of a different XDMA device driver
   //
-    DMAReadfile_fd = open(VMICDMADEVICE, O_RDONLY);
+    DMAReadfile_fd = OpenDMADevice(VMICDMADEVICE, O_RDONLY);
     if (DMAReadfile_fd < 0)
     {
         printf("XDMA read device open failed for mic data\n");
         InitError = true;
     }
+    else if(DMAPollWindow != 0)
+        SetDMAPollWindow(DMAReadfile_fd, DMAPollWindow);
 
   //
   // now initialise Saturn hardware.
@@ -118,9 +181,11 @@ void *OutgoingMicSamples(void *arg)
   //
     SetupFIFOMonitorChannel(eMicCodecDMA, false);
     ResetDMAStreamFIFO(eMicCodecDMA);
-    RegisterValue = ReadFIFOMonitorChannel(eMicCodecDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);				// read the FIFO Depth register
+    StreamSourceInitialise(&MicSource, DMAReadfile_fd, eMicCodecDMA, VADDRMICSTREAMREAD,
+                           VDMATRANSFERSIZE, VMICMAXBATCH * VDMATRANSFERSIZE, -1);
+    Depth = StreamSourceDepth(&MicSource);				// read the FIFO Depth register
     if(UseDebug)
-        printf("mic FIFO Depth register = %08x (should be ~0)\n", RegisterValue);
+        printf("mic FIFO Depth = %d (should be ~0)\n", Depth);
     Depth = 0;
 
 
@@ -129,9 +194,10 @@ void *OutgoingMicSamples(void *arg)
   // if sufficient FIFO data available: DMA that data and transfer it out. 
   // if it turns out to be too inefficient, we'll have to try larger DMA.
   //
-    while (!InitError)
+    while (!InitError && !ThreadStopRequested())
     {
-        while(!(SDRActive))
+        StateCount = GetThreadStateCount();
+        while(!__atomic_load_n(&SDRActive, __ATOMIC_ACQUIRE) && !ThreadStopRequested())
         {
             if(ThreadData->Cmdid & VBITCHANGEPORT)
             {
@@ -140,72 +206,103 @@ void *OutgoingMicSamples(void *arg)
                 MakeSocket(ThreadData, 0);                        // this binds to the new port.
                 ThreadData->Cmdid &= ~VBITCHANGEPORT;             // clear command bit
             }
-            usleep(100);
+            WaitThreadStateChange(&StateCount);                   // sleep until the state changes
         }
+        if(ThreadStopRequested())
+            break;
     //
     // if we get here, run has been initiated
     // initialise outgoing data packet
     //
         printf("starting activity on mic thread\n");
+        ResetDMAStreamFIFO(eMicCodecDMA);                                     // drop samples recorded while idle
         StartupCount = VSTARTUPDELAY;
-        SequenceCounter = 0;
-        memcpy(&DestAddr, &reply_addr, sizeof(struct sockaddr_in));           // create local copy of PC destination address
-        memset(&iovecinst, 0, sizeof(struct iovec));
-        memset(&datagram, 0, sizeof(datagram));
-        iovecinst.iov_base = UDPBuffer;
-        iovecinst.iov_len = VMICPACKETSIZE;
-        datagram.msg_iov = &iovecinst;
-        datagram.msg_iovlen = 1;
-        datagram.msg_name = &DestAddr;                              // MAC addr & port to send to
-        datagram.msg_namelen = sizeof(DestAddr);
-
-        while(SDRActive && !InitError)                              // main loop
+        ReadRadioState(&State);
+        memcpy(&DestAddr, &State.ReplyAddr, sizeof(struct sockaddr_in));      // create local copy of PC destination address
+        FrameMultiple = __atomic_load_n(&MicFrameRequest, __ATOMIC_RELAXED);
+        if(FrameMultiple * VDMATRANSFERSIZE != FrameBytes)                    // message size changed: new packet buffers
+        {
+            FrameBytes = FrameMultiple * VDMATRANSFERSIZE;
+            StreamPacketiserDestroy(&MicPacketiser);
+            if(!StreamPacketiserCreate(&MicPacketiser, ThreadData->Socketid, &DestAddr, FrameBytes))
+                InitError = true;
+            StreamSourceInitialise(&MicSource, DMAReadfile_fd, eMicCodecDMA, VADDRMICSTREAMREAD,
+                                   FrameBytes, VMICMAXBATCH * FrameBytes, -1);
+            printf("mic packets of %d samples\n", FrameMultiple * VMICSAMPLESPERFRAME);
+        }
+        MicPacketiser.Socketid = ThreadData->Socketid;                        // socket may have changed with the port
+        MicPacketiser.SequenceCounter = 0;
+        StreamPacketiserSetTimeStamp(&MicPacketiser, GEnableAlignmentTimestamps,
+                                     VMICSAMPLERATE, FrameMultiple * VMICSAMPLESPERFRAME);
+        StreamRingReset(&MicRing);
+
+        while(__atomic_load_n(&SDRActive, __ATOMIC_ACQUIRE) && !InitError)                              // main loop
         {
             //
             // now wait until there is data, then DMA it
             //
-            Depth = ReadFIFOMonitorChannel(eMicCodecDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);			// read the FIFO Depth register. 4 mic words per 64 bit word.
-            if((StartupCount == 0) && FIFOOverThreshold)
+            Depth = StreamSourceDepth(&MicSource);			// read the FIFO Depth register. 4 mic words per 64 bit word.
+            if((StartupCount == 0) && MicSource.OverThreshold)
             {
-                GlobalFIFOOverflows |= 0b00000010;
+                __atomic_fetch_or(&GlobalFIFOOverflows, 0b00000010, __ATOMIC_RELAXED);
+                MetricsCountOverThreshold(eMicMetrics);
                 if(UseDebug)
-                    printf("Codec Mic FIFO Overthreshold, depth now = %d\n", Current);
+                    RINGLOG("Codec Mic FIFO Overthreshold, depth now = %d\n", Depth);
             }
 
 // note this would often generate a message because we deliberately read it down to zero.
 // this isn't a problem as we can send the data on without the code becoming blocked.
 //            if((StartupCount == 0) && FIFOUnderflow)
 //                printf("Codec Mic FIFO Underflowed, depth now = %d\n", Current);
-            while (Depth < (VMICSAMPLESPERFRAME/4))			        // 16 locations = 64 samples
+            while (Depth < FrameMultiple * VMICFIFOLOCATIONS)      // 16 locations = 64 samples
             {
-                usleep(1000);								        // 1ms wait
-                Depth = ReadFIFOMonitorChannel(eMicCodecDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);				// read the FIFO Depth register
-                if((StartupCount == 0) && FIFOOverThreshold)
+                usleep(1000 * FrameMultiple);                       // 1ms wait per standard message
+                Depth = StreamSourceDepth(&MicSource);				// read the FIFO Depth register
+                if((StartupCount == 0) && MicSource.OverThreshold)
                 {
-                    GlobalFIFOOverflows |= 0b00000010;
+                    __atomic_fetch_or(&GlobalFIFOOverflows, 0b00000010, __ATOMIC_RELAXED);
+                    MetricsCountOverThreshold(eMicMetrics);
                     if(UseDebug)
-                        printf("Codec Mic FIFO Overthreshold, depth now = %d\n", Current);
+                        RINGLOG("Codec Mic FIFO Overthreshold, depth now = %d\n", Depth);
                 }
 //                if((StartupCount == 0) && FIFOUnderflow)
 //                    printf("Codec Mic FIFO Underflowed, depth now = %d\n", Current);
             }
 
+            //
+            // read all complete messages available in one DMA
             // DMA shared with wideband samples, so get semaphore granting access
-            sem_wait(&MicWBDMAMutex);                       // get protected access
-            DMAReadFromFPGA(DMAReadfile_fd, MicBasePtr, VDMATRANSFERSIZE, VADDRMICSTREAMREAD);
-            sem_post(&MicWBDMAMutex);                       // get protected access
-
-            // create the packet into UDPBuffer
-            *(uint32_t*)UDPBuffer = htonl(SequenceCounter++);        // add sequence count
-            memcpy(UDPBuffer+4, MicBasePtr, VDMATRANSFERSIZE);       // copy in mic samples
-            Error = sendmsg(ThreadData -> Socketid, &datagram, 0);
-            if(StartupCount != 0)                                   // decrement startup message count
-                StartupCount--;
-            if(Error == -1)
+            //
+            clock_gettime(CLOCK_MONOTONIC, &LoopStart);
+            if(MicPacketiser.TimeStamped && (MicPacketiser.TimeAnchor == 0))
+            {
+                // 1st DMA of the session: the oldest sample in the FIFO (4 per location) arrived Depth samples ago
+                clock_gettime(CLOCK_REALTIME, &Now);
+                MicPacketiser.TimeAnchor = (uint64_t)Now.tv_sec * 1000000000ULL + (uint64_t)Now.tv_nsec
+                                         - ((uint64_t)Depth * 4 * 1000000000ULL) / VMICSAMPLERATE;
+            }
+            ClaimMicWBDMA(true);                            // get protected access ahead of wideband
+            Frames = StreamSourceRead(&MicSource, &MicRing) / FrameBytes;
+            ReleaseMicWBDMA(true);
+            MetricsRecordDMA(eMicMetrics, Frames * FrameBytes, Depth);
+
+            // create the packets, each with its own sequence count, and send together
+            Sent = StreamPacketiserSend(&MicPacketiser, &MicRing, Frames);
+            if(StartupCount > Frames * FrameMultiple)               // decrement startup message count
+                StartupCount -= Frames * FrameMultiple;
+            else
+                StartupCount = 0;
+            if((Sent == -1) && IsSendBackpressure(errno))
+                MetricsCountSendError(eMicMetrics);             // queue full: these packets are lost, carry on
+            else if(Sent == -1)
             {
-                perror("sendmsg, Mic Audio");
+                perror("sendmmsg, Mic Audio");
+                MetricsCountSendError(eMicMetrics);
                 InitError=true;
             }
+            else
+                MetricsCountPackets(eMicMetrics, Sent);
+            MetricsRecordLoopTime(eMicMetrics, &LoopStart);
         }
     }
 //
@@ -215,6 +312,8 @@ void *OutgoingMicSamples(void *arg)
       ThreadError = true;
 
     printf("shutting down outgoing mic data thread\n");
+    StreamPacketiserDestroy(&MicPacketiser);
+    StreamRingDestroy(&MicRing);
     close(ThreadData->Socketid); 
     ThreadData->Active = false;                   // signal closed
     return NULL;
@@ -23,6 +23,16 @@
 
 
 #define VMICPACKETSIZE 132              // microphone packet
+#define VMICMAXSAMPLESPERFRAME 256      // largest mic packet asked for: 4x the standard 64 samples
+
+
+//
+// mic packet: 32 bit sequence number, then 16 bit samples.
+// with alignment timestamps (general packet byte 37 bit 4, Saturn extension) there is a
+// 64 bit big endian timestamp between them: the time of the packet's 1st sample, ns since
+// 1970, on the same clock as the DDC packet timestamps so the streams can be lined up.
+// it is anchored once per session, when the 1st samples are read, then follows the sample count.
+//
 
 
 //
@@ -31,4 +41,21 @@
 void *OutgoingMicSamples(void *arg);
 
 
+//
+// SetMicFrameSize()
+// set the mic packet size from the general packet (Saturn extension): samples per packet / 64.
+// 0 or 1 = 64 samples (standard), 2 = 128, 4 = 256; takes effect when the mic stream next starts
+//
+void SetMicFrameSize(uint8_t Multiple);
+
+
+//
+// arbitrate access to the DMA read channel shared by mic and wideband reads
+// mic claims take priority: a wideband claim waits while any mic claim is pending,
+// so a mic read waits at most for one (bounded size) wideband chunk read
+//
+void ClaimMicWBDMA(bool IsMic);
+void ReleaseMicWBDMA(bool IsMic);
+
+
 #endif
\ No newline at end of file
@@ -18,6 +18,8 @@
 #include <stdint.h>
 #include "../common/saturntypes.h"
 #include "OutHighPriority.h"
+#include "OutMicAudio.h"
+#include "threadmanager.h"
 #include <errno.h>
 #include <stdlib.h>
 #include <stddef.h>
@@ -27,38 +29,124 @@
 #include <fcntl.h>
 #include <pthread.h>
 #include <syscall.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
 #include "../common/saturnregisters.h"
 #include "../common/hwaccess.h"
+#include "../common/saturndrivers.h"
+#include "../common/wbspectrum.h"
+#include "../common/wbpack.h"
+#include "metrics.h"
+#include "radiostate.h"
+#include "overload.h"
 #include "../common/debugaids.h"
+#include "../common/dmapool.h"
 
 
 //
 // global holding the current step of C&C data. Each new USB frame updates this.
 //
 #define VDMABUFFERSIZE 65536						            // memory buffer to reserve (2x wideband FIFO size)
-#define VALIGNMENT 4096                             // buffer alignment
 
 #define VWBPACKETSIZE 1500                          // packet size is a variable, sp make max for UDP
 #define VWBSAMPLESPERFRAME 512                      // total wideband ADC samples in one WB packet
 #define VWBBYTESPERFRAME 2*VWBSAMPLESPERFRAME       // total bytes in one outgoing frame
 #define VSTARTUPDELAY 100                           // 100 messages (~100ms) before reporting under or overflows
 #define VNUMWBADC 2                                 // number of ADC that WB data can be collected for
+#define VWBDMACHUNK 4096                            // largest single wideband DMA: bounds mic DMA wait
+#define VWBPACKETGAP 200                            // fixed gap between packets (us) if no pacing rate set
+#define VWBPACINGBURST 4                            // token bucket depth, in packets
+#define VWBMAXPACKETS 256                           // most packets in one wideband frame (P2 packet count is 8 bits)
+#define VWBFRAMEINSET 32                            // bytes at start of recording not sent
+#define VWBNUMBUFFERS 2                             // ping-pong DMA buffers: one sent while the next is read
+#define VWBADC1POLL 50                              // poll period (us) waiting for ADC1 capture after ADC0
+#define VWBADC1WAIT 40                              // polls before giving up (next poll cycle picks it up)
+#define VWBPOLLTIME 5                               // poll period (ms) for wideband data ready
+#define VWBEVENTTIMEOUT 100                         // longest sleep (ms) waiting for a data ready interrupt
+#define VWBSPECTRUMBINSPERPKT 512                   // spectrum bins in one spectrum packet
+#define VWBSPECTRUMHEADER 8                         // spectrum packet header bytes
+#define VWBSPECTRUMPKTS (VWBMAXBINS/VWBSPECTRUMBINSPERPKT)
+#define VWBZCTIMEOUT 200                            // longest wait (ms) for the kernel to release a zerocopy frame
 
 
 //
 // define the memory buffers:
 //
-uint8_t* WBDMAReadBuffer = NULL;								// data for DMA read from DDC
+uint8_t* WBDMAReadBuffer[VWBNUMBUFFERS];						// data for DMA read from wideband FIFO
 uint32_t WBDMABufferSize = VDMABUFFERSIZE;
+uint32_t WBNextBuffer = 0;                                      // next buffer to DMA into
+uint32_t WBCaptureWords = 0;                                    // 64 bit words in one ADC capture
+int WBEOP_fd = -1;                                              // AXI-Stream device for EOP terminated reads, if used
 
-uint8_t* WBUDPBuffer[VNUMDDC];                                  // DDC frame buffer
+//
+// a wideband frame read into a DMA buffer, waiting to be sent by the sender thread.
+// buffers are filled and sent in turn: WBFreeBuffers counts buffers free to DMA into,
+// WBFullBuffers counts frames waiting to be sent.
+//
+struct WBFrame
+{
+    uint8_t* Buffer;                                            // DMA buffer holding the frame
+    int Socketid;                                               // socket for the ADC it came from
+    struct sockaddr_in* DestAddr;                               // destination for it
+    uint32_t PacketCount;                                       // packets to send
+    uint32_t SamplesPerPacket;                                  // 16 bit samples per packet
+    uint32_t SampleBits;                                        // sample size to send: 16, 12 or 8 (see wbpack.h)
+    struct WBZeroCopy* ZeroCopy;                                // the socket's zerocopy state, if sent by MSG_ZEROCOPY
+};
+struct WBFrame WBFrames[VWBNUMBUFFERS];
+sem_t WBFreeBuffers;
+sem_t WBFullBuffers;
+bool WBSenderExit = false;                                      // set to stop the sender thread
+struct sockaddr_in WBDestAddr[VNUMWBADC];                       // destination address for outgoing data
+
+//
+// MSG_ZEROCOPY sends (config file "zerocopy"): the kernel sends the samples straight from
+// the DMA buffer instead of copying them into socket buffers, and reports on the socket's
+// error queue when it has finished with them. Each sent datagram takes the next of the
+// socket's notification ids; a frame's buffer (and the packet headers) can't be reused
+// until the kernel has released the frame's last datagram.
+//
+struct WBZeroCopy
+{
+    int Socketid;
+    bool Enabled;                                               // SO_ZEROCOPY set on the socket
+    uint32_t NextId;                                            // id of the next datagram sent
+    uint32_t Released;                                          // datagrams before this id released
+};
+struct WBZeroCopy WBZeroCopies[VNUMWBADC];
+uint64_t GWBZeroCopyFrames = 0;                                 // frames sent by MSG_ZEROCOPY
+uint64_t GWBZeroCopyCopied = 0;                                 // datagrams the kernel copied anyway
+uint64_t GWBZeroCopyTimeouts = 0;                               // frames whose release didn't arrive in time
+
+//
+// outgoing datagrams for one wideband frame. Each is gathered from a header slot
+// (the sequence count) and a pointer straight into the DMA buffer, so no copy is made
+//
+uint32_t WBPacketHeader[VWBMAXPACKETS];                         // sequence count for each packet
+struct iovec WBPacketIovecs[VWBMAXPACKETS][2];                  // header + sample data for each packet
+struct mmsghdr WBDatagrams[VWBMAXPACKETS];
+
+//
+// spectrum packets, sent on the wideband port instead of samples if WBSpectrumBins set.
+// a different length from a sample packet, so the client can tell them apart:
+// bytes 0-3:  sequence count, restarting at 0 for each frame
+// bytes 4-5:  total bins in the spectrum (512 or 1024)
+// bytes 6-7:  first bin in this packet
+// bytes 8-:   512 bins, each 16 bit signed power in 0.01dBFS units; bin 0 = DC. All big endian.
+// if zoomed, bin 0 is the lowest frequency of the sub-band and the centre is bin (total bins / 2)
+//
+uint8_t WBSpectrumPacket[VWBSPECTRUMPKTS][VWBSPECTRUMHEADER + VWBSPECTRUMBINSPERPKT * 2];
+struct iovec WBSpectrumIovecs[VWBSPECTRUMPKTS];
+struct mmsghdr WBSpectrumDatagrams[VWBSPECTRUMPKTS];
+int16_t WBLogPower[VWBMAXBINS];
 extern  int DMAReadfile_fd;								        // DMA read file device (opened by mic samples thread)
 
 //
-// copies of params provided by P2 protocol
-// WBParamsChanged set true if parameters have moved
+// the params provided by P2 protocol are published in the radio state;
+// these are the ones the wideband IP was last set up with (wideband thread only)
 //
-bool WBParamsChanged;
 uint8_t StoredEnables;                                          // enable bits for ADC1 (bit0) & 2 (bit1)
 uint16_t StoredSamplePerPktCount;                               // samples per packet count
 uint8_t StoredSampleSize;                                       // sample resolution in bits (typ 16)
@@ -68,29 +156,28 @@ uint8_t StoredPacketCount;                                      // packets to be
 
 
 //
-// create dynamically allocated memory at startup
+// create dynamically allocated memory
+// called when wideband is first enabled, so a client that never uses it costs no buffers
 //
 bool CreateWBDynamicMemory(void)                              // return true if error
 {
-    uint32_t ADC;
     bool Result = false;
+    uint32_t Buffer;
 //
-// first create the buffer for DMA, and initialise its pointers
+// first create the buffers for DMA, and initialise its pointers
 //
-    posix_memalign((void**)&WBDMAReadBuffer, VALIGNMENT, WBDMABufferSize);
-    if (!WBDMAReadBuffer)
-    {
-        printf("Wideband read buffer allocation failed\n");
-        Result = true;
-    }
-    memset(WBDMAReadBuffer, 0, WBDMABufferSize);
-
-    //
-    // set up per-Wideband ADC data structures
-    //
-    for (ADC = 0; ADC < VNUMWBADC; ADC++)
+    for (Buffer = 0; Buffer < VWBNUMBUFFERS; Buffer++)
     {
-        WBUDPBuffer[ADC] = malloc(VWBPACKETSIZE);
+        if (WBDMAReadBuffer[Buffer] != NULL)
+            continue;
+        WBDMAReadBuffer[Buffer] = AllocateDMABuffer(WBDMABufferSize, "wideband DMA");
+        if (!WBDMAReadBuffer[Buffer])
+        {
+            printf("Wideband read buffer allocation failed\n");
+            Result = true;
+        }
+        else
+            MetricsAddBufferBytes(eWBMetrics, WBDMABufferSize);
     }
     return Result;
 }
@@ -98,16 +185,10 @@ bool CreateWBDynamicMemory(void)                              // return true if
 
 void FreeWBDynamicMemory(void)
 {
-    uint32_t ADC;
+    uint32_t Buffer;
 
-    free(WBDMAReadBuffer);
-    //
-    // free the per-DDC buffers
-    //
-    for (ADC = 0; ADC < VNUMDDC; ADC++)
-    {
-        free(WBUDPBuffer[ADC]);
-    }
+    for (Buffer = 0; Buffer < VWBNUMBUFFERS; Buffer++)
+        FreeDMABuffer(WBDMAReadBuffer[Buffer]);
 }
 
 
@@ -115,19 +196,26 @@ void FreeWBDynamicMemory(void)
 //
 // set parameters from SDR for wideband data collect
 // paramters as transferred in general packet to SDR
-// see if any differences are present, then store for when thread is ready
+// see if any differences are present, then publish them for the wideband thread
 //
 void SetWidebandParams(uint8_t Enables, uint16_t SampleCount, uint8_t SampleSize, uint8_t Rate, uint8_t PacketCount)
 {
-    if((Enables != StoredEnables) || (SampleCount != StoredSamplePerPktCount) || (SampleSize != StoredSampleSize)
-       || (Rate != StoredRate) || (PacketCount != StoredPacketCount))
-        WBParamsChanged = true;
+    struct RadioState* State;
+    bool WBParamsChanged = false;
 
-    StoredEnables = Enables;                            // enable bits for ADC1 (bit0) & 2 (bit1)
-    StoredSamplePerPktCount = SampleCount;                    // samples per packet count
-    StoredSampleSize = SampleSize;                      // sample resolution in bits (typ 16)
-    StoredRate = Rate;                                  // update rate in ms
-    StoredPacketCount = PacketCount;                    // packets to be transferred out
+    State = BeginRadioStateUpdate();
+    if((Enables != State->WBEnables) || (SampleCount != State->WBSamplesPerPacket) || (SampleSize != State->WBSampleSize)
+       || (Rate != State->WBRate) || (PacketCount != State->WBPacketCount))
+    {
+        WBParamsChanged = true;
+        State->WBEnables = Enables;                         // enable bits for ADC1 (bit0) & 2 (bit1)
+        State->WBSamplesPerPacket = SampleCount;            // samples per packet count
+        State->WBSampleSize = SampleSize;                   // sample resolution in bits (typ 16)
+        State->WBRate = Rate;                               // update rate in ms
+        State->WBPacketCount = PacketCount;                 // packets to be transferred out
+        State->WBParamsVersion++;
+    }
+    EndRadioStateUpdate();
 
     if(WBParamsChanged)
         printf("New WB data: Enables=%d, Sample/pkt = %d, Samplesize=%d, Rate=%d, PktCount=%d\n", Enables, SampleCount, SampleSize, Rate, PacketCount);
@@ -137,20 +225,47 @@ void SetWidebandParams(uint8_t Enables, uint16_t SampleCount, uint8_t SampleSize
 //
 // read out the Wideband FIFO
 // returns the number of samples read
-// read available word count, then do DMA to memory buffer
-//
-uint32_t ReadFIFOContent()
+// read available word count, then do DMA to the memory buffer given
+// if MaxWords is not zero, read no more than that (to split captures from two ADCs)
+// the DMA is split into chunks of VWBDMACHUNK bytes, releasing the channel between
+// chunks so a waiting mic read goes next; mic DMA latency is then bounded by one chunk
+// with an EOP device, one read returns one whole capture: no word count read, and
+// no mic arbitration as it is a DMA channel of its own
+//
+uint32_t ReadFIFOContent(uint8_t* Buffer, uint32_t MaxWords)
 {
     uint32_t SampleCount = 0;
     uint32_t WordCount = 0;                             // count of 64 bit words in the FIFO
+    uint32_t Bytes, Offset, Chunk;
+    int32_t Length;
     bool ADC1, ADC2;
 
+    if(WBEOP_fd >= 0)
+    {
+        Length = DMAReadPacketFromFPGA(WBEOP_fd, Buffer, WBDMABufferSize);
+        if(Length > 0)
+        {
+            WordCount = (uint32_t)Length / 8;
+            MetricsRecordDMA(eWBMetrics, (uint32_t)Length, WordCount);
+        }
+        return WordCount * 4;
+    }
     WordCount = GetWidebandStatus(&ADC1, &ADC2);
+    if((MaxWords != 0) && (WordCount > MaxWords))
+        WordCount = MaxWords;
     if(WordCount != 0)
     {
-        sem_wait(&MicWBDMAMutex);                       // get protected access
-        DMAReadFromFPGA(DMAReadfile_fd, WBDMAReadBuffer, WordCount * 8, VADDRWIDEBANDREAD);
-        sem_post(&MicWBDMAMutex);                       // get protected access
+        Bytes = WordCount * 8;
+        for(Offset = 0; Offset < Bytes; Offset += Chunk)
+        {
+            Chunk = Bytes - Offset;
+            if(Chunk > VWBDMACHUNK)
+                Chunk = VWBDMACHUNK;
+            ClaimMicWBDMA(false);                       // get protected access, after any mic read
+            DMAReadFromFPGA(DMAReadfile_fd, Buffer + Offset, Chunk, VADDRWIDEBANDREAD);
+            ReleaseMicWBDMA(false);
+        }
+        MetricsRecordDMA(eWBMetrics, Bytes, WordCount);
         SampleCount = WordCount * 4;
 //        printf("word count in readFIFOContent = %d\n", WordCount);
     }
@@ -158,22 +273,396 @@ uint32_t ReadFIFOContent()
 }
 
 
+//
+// token bucket pacing for outgoing wideband packets
+// tokens are bytes, added at WBPacingRate; the bucket holds at most VWBPACINGBURST packets
+// so a frame goes out at the configured rate with only short bursts.
+// also sets SO_MAX_PACING_RATE on the sockets, which is honoured by the fq qdisc if in use.
+// if not paced (-w not given) a fixed gap is left between packets; if rate = 0, no pacing.
+//
+static uint64_t WBPacingBytesPerSec = 0;                // pacing rate; 0 = fixed gap
+static double WBTokens = 0.0;                           // bytes that can be sent now
+static struct timespec WBTokenTime;                     // time tokens last updated
+
+
+static void InitialiseWBPacing(struct ThreadSocketData* ThreadData)
+{
+    int ADC;
+    uint32_t Rate;
+
+    WBPacingBytesPerSec = UseWBPacing ? (uint64_t)WBPacingRate * 1000000 / 8 : 0;
+    WBTokens = 0.0;
+    clock_gettime(CLOCK_MONOTONIC, &WBTokenTime);
+    if(WBPacingBytesPerSec != 0)
+    {
+        Rate = (WBPacingBytesPerSec > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)WBPacingBytesPerSec;
+        for (ADC = 0; ADC < VNUMWBADC; ADC++)
+            if(setsockopt((ThreadData+ADC)->Socketid, SOL_SOCKET, SO_MAX_PACING_RATE, &Rate, sizeof(Rate)) < 0)
+                if(UseDebug)
+                    perror("setsockopt SO_MAX_PACING_RATE, wideband");
+    }
+}
+
+
+//
+// wait until the next packet(s) of Bytes each can be sent
+// returns the number that can be sent now: between 1 and Count
+//
+static uint32_t PaceWBPackets(uint32_t Bytes, uint32_t Count)
+{
+    struct timespec Now, Wait;
+    double Deficit, Burst;
+    uint64_t WaitNs;
+    uint32_t Packets;
+
+    if(!UseWBPacing)
+    {
+        usleep(VWBPACKETGAP);                           // gap between outgoing messages
+        return 1;
+    }
+    if(WBPacingBytesPerSec == 0)                        // unpaced: send them all
+        return Count;
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    WBTokens += ((double)(Now.tv_sec - WBTokenTime.tv_sec) + (Now.tv_nsec - WBTokenTime.tv_nsec) * 1e-9) * WBPacingBytesPerSec;
+    WBTokenTime = Now;
+    Burst = (double)VWBPACINGBURST * Bytes;
+    if(WBTokens > Burst)
+        WBTokens = Burst;
+    if(WBTokens < Bytes)
+    {
+        Deficit = Bytes - WBTokens;
+        WaitNs = (uint64_t)(Deficit * 1e9 / WBPacingBytesPerSec);
+        Wait.tv_sec = WaitNs / 1000000000;
+        Wait.tv_nsec = WaitNs % 1000000000;
+        nanosleep(&Wait, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &WBTokenTime);
+        WBTokens = Bytes;                               // deficit paid by the wait
+    }
+    Packets = (uint32_t)(WBTokens / Bytes);
+    if(Packets > Count)
+        Packets = Count;
+    WBTokens -= (double)Packets * Bytes;
+    return Packets;
+}
+
+
+//
+// empty the wideband FIFO, discarding the data
+// the DMA goes to the next buffer, once the sender thread has finished with it
+// an EOP read waits for a packet, so only read while the FIFO holds one
+//
+static void DiscardFIFOContent(void)
+{
+    bool ADC1, ADC2;
+
+    sem_wait(&WBFreeBuffers);
+    if(WBEOP_fd < 0)
+        ReadFIFOContent(WBDMAReadBuffer[WBNextBuffer], 0);
+    else
+        while(GetWidebandStatus(&ADC1, &ADC2) != 0)
+            if(ReadFIFOContent(WBDMAReadBuffer[WBNextBuffer], 0) == 0)
+                break;
+    sem_post(&WBFreeBuffers);
+}
+
+
+//
+// read one ADC capture from the FIFO into the next free buffer,
+// and hand it to the sender thread to go out on that ADC's socket
+// MaxWords limits the read (0 = read FIFO till empty)
+//
+static void QueueWBFrame(struct ThreadSocketData* ThreadData, int ADC, uint32_t MaxWords)
+{
+    struct WBFrame* Frame;
+
+    sem_wait(&WBFreeBuffers);                               // wait till the sender is done with the buffer
+    Frame = &WBFrames[WBNextBuffer];
+    Frame->Buffer = WBDMAReadBuffer[WBNextBuffer];
+    ReadFIFOContent(Frame->Buffer, MaxWords);
+    Frame->Socketid = (ThreadData+ADC)->Socketid;
+    Frame->ZeroCopy = WBZeroCopies[ADC].Enabled ? &WBZeroCopies[ADC] : NULL;
+    Frame->DestAddr = &WBDestAddr[ADC];
+    Frame->PacketCount = StoredPacketCount;
+    Frame->SamplesPerPacket = StoredSamplePerPktCount;
+    Frame->SampleBits = GetWBSampleBits(StoredSampleSize, StoredSamplePerPktCount);
+    WBNextBuffer = (WBNextBuffer + 1) % VWBNUMBUFFERS;
+    sem_post(&WBFullBuffers);                               // sender thread sends it (strategy step 7)
+}
+
+
+//
+// send one wideband frame as a power spectrum
+// if zoom is set, the spectrum is of the sub-band; if the capture is too short
+// for that (it needs Bins x decimation samples) the full band is sent
+// the spectrum plans are cached, so nothing is allocated per frame
+// returns false if the frame can't make a spectrum (too short), so raw samples are sent
+//
+static bool SendWBSpectrum(struct WBFrame* Frame)
+{
+    const struct WBSpectrumPlan* Plan = NULL;
+    const struct WBZoomPlan* ZoomPlan = NULL;
+    const int16_t* Samples = (const int16_t*)(Frame->Buffer + VWBFRAMEINSET);
+    uint32_t SampleCount = Frame->SamplesPerPacket * Frame->PacketCount;
+    uint32_t Packet, Packets, Bin, FirstBin, Bins;
+    uint8_t* Ptr;
+    int Sent;
+
+    if(WBZoomDecimation != 0)
+        ZoomPlan = GetWBZoomPlan(SampleCount, WBSpectrumBins, WBZoomCentre, WBZoomDecimation);
+    if(ZoomPlan != NULL)
+    {
+        ComputeWBZoomSpectrum(ZoomPlan, Samples, WBLogPower);
+        Bins = ZoomPlan->Bins;
+    }
+    else
+    {
+        Plan = GetWBSpectrumPlan(SampleCount, WBSpectrumBins);
+        if(Plan == NULL)
+            return false;
+        ComputeWBSpectrum(Plan, Samples, WBLogPower);
+        Bins = Plan->Bins;
+    }
+
+    Packets = Bins / VWBSPECTRUMBINSPERPKT;
+    for(Packet = 0; Packet < Packets; Packet++)
+    {
+        FirstBin = Packet * VWBSPECTRUMBINSPERPKT;
+        Ptr = WBSpectrumPacket[Packet];
+        *(uint32_t*)Ptr = htonl(Packet);                        // sequence count; restart at 0 for each frame
+        *(uint16_t*)(Ptr + 4) = htons((uint16_t)Bins);
+        *(uint16_t*)(Ptr + 6) = htons((uint16_t)FirstBin);
+        Ptr += VWBSPECTRUMHEADER;
+        for(Bin = 0; Bin < VWBSPECTRUMBINSPERPKT; Bin++)
+        {
+            *(uint16_t*)Ptr = htons((uint16_t)WBLogPower[FirstBin + Bin]);
+            Ptr += 2;
+        }
+        WBSpectrumDatagrams[Packet].msg_hdr.msg_name = Frame->DestAddr;      // MAC addr & port to send to
+    }
+    Sent = sendmmsg(Frame->Socketid, WBSpectrumDatagrams, Packets, 0);
+    if(Sent < 0)
+        MetricsCountSendError(eWBMetrics);
+    else
+        MetricsCountPackets(eWBMetrics, Sent);
+    return true;
+}
+
+
+//
+// send one wideband frame to the SDR client
+// if a spectrum is requested, send that instead of samples
+// build the datagrams for the frame: sequence count, and I/Q data
+// pointed to in place in the DMA buffer
+// if a 12 or 8 bit sample size is requested, the samples are packed in place first
+// then send them, as many at a time as pacing allows
+// (the whole frame in one sendmmsg if unpaced)
+//
+static void SendWBFrame(struct WBFrame* Frame)
+{
+    uint32_t PacketCounter;
+    uint32_t StartAddress;                                      // data locations in wideband collected data
+    uint32_t PacketBytes;                                       // bytes in each outgoing packet
+    uint32_t SampleBytes;                                       // sample bytes in each outgoing packet
+    uint8_t* Samples;                                           // start of the frame's samples
+    uint32_t Packets;                                           // packets to send in one sendmmsg
+    int Sent;
+    int Flags = (Frame->ZeroCopy != NULL) ? MSG_ZEROCOPY : 0;
+    struct timespec LoopStart;                                  // time frame send started, for metrics
+
+    clock_gettime(CLOCK_MONOTONIC, &LoopStart);
+    if((WBSpectrumBins != 0) && SendWBSpectrum(Frame))
+    {
+        MetricsRecordLoopTime(eWBMetrics, &LoopStart);
+        return;
+    }
+    Samples = Frame->Buffer + VWBFRAMEINSET;                    // inset 4 words into recording
+    SampleBytes = Frame->SamplesPerPacket * Frame->SampleBits / 8;
+    if(Frame->SampleBits != 16)
+        PackWBSamples(Samples, (const int16_t*)Samples, Frame->SamplesPerPacket * Frame->PacketCount, Frame->SampleBits);
+    for(PacketCounter = 0; PacketCounter < Frame->PacketCount; PacketCounter++)
+    {
+        WBPacketHeader[PacketCounter] = htonl(PacketCounter);  // add sequence count; restart at 0 for each frame
+        StartAddress = PacketCounter * SampleBytes;             // byte address in the (packed) samples
+        WBPacketIovecs[PacketCounter][1].iov_base = Samples + StartAddress;
+        WBPacketIovecs[PacketCounter][1].iov_len = SampleBytes;                        // P2 data dependent
+        WBDatagrams[PacketCounter].msg_hdr.msg_name = Frame->DestAddr;                 // MAC addr & port to send to
+    }
+    PacketBytes = SampleBytes + 4;
+    for(PacketCounter = 0; PacketCounter < Frame->PacketCount; PacketCounter += Packets)
+    {
+        Packets = PaceWBPackets(PacketBytes, Frame->PacketCount - PacketCounter);
+        Sent = sendmmsg(Frame->Socketid, &WBDatagrams[PacketCounter], Packets, Flags);
+        if(Sent > 0)
+        {
+            Packets = Sent;                                     // resend any not sent
+            MetricsCountPackets(eWBMetrics, Sent);
+            if(Flags != 0)
+                Frame->ZeroCopy->NextId += Sent;
+        }
+        else
+        {
+            MetricsCountSendError(eWBMetrics);
+            break;                                              // socket error: drop rest of frame
+        }
+    }
+    MetricsRecordLoopTime(eWBMetrics, &LoopStart);
+}
+
+
+//
+// turn on MSG_ZEROCOPY sends for the sockets, if configured and the kernel supports it
+//
+static void InitialiseWBZeroCopy(struct ThreadSocketData* ThreadData)
+{
+    int ADC;
+    int One = 1;
+
+    for (ADC = 0; ADC < VNUMWBADC; ADC++)
+    {
+        WBZeroCopies[ADC].Socketid = (ThreadData+ADC)->Socketid;
+        WBZeroCopies[ADC].NextId = 0;
+        WBZeroCopies[ADC].Released = 0;
+        WBZeroCopies[ADC].Enabled = UseWBZeroCopy
+            && (setsockopt((ThreadData+ADC)->Socketid, SOL_SOCKET, SO_ZEROCOPY, &One, sizeof(One)) == 0);
+    }
+    if(UseWBZeroCopy)
+    {
+        if(WBZeroCopies[0].Enabled)
+            printf("wideband samples sent by MSG_ZEROCOPY from the DMA buffers\n");
+        else
+            perror("setsockopt SO_ZEROCOPY, wideband: samples copied");
+    }
+}
+
+
+//
+// read the zerocopy notifications waiting on a socket's error queue
+// each gives a range of ids released; the kernel may have copied them anyway
+// (eg on loopback, or if the device can't gather from user pages)
+//
+static void ReadWBZeroCopyReleases(struct WBZeroCopy* ZeroCopy)
+{
+    struct msghdr Message;
+    struct cmsghdr* Cmsg;
+    struct sock_extended_err* Error;
+    char Control[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in))];
+
+    while(true)
+    {
+        memset(&Message, 0, sizeof(Message));
+        Message.msg_control = Control;
+        Message.msg_controllen = sizeof(Control);
+        if(recvmsg(ZeroCopy->Socketid, &Message, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+            return;
+        for(Cmsg = CMSG_FIRSTHDR(&Message); Cmsg != NULL; Cmsg = CMSG_NXTHDR(&Message, Cmsg))
+        {
+            if((Cmsg->cmsg_level != SOL_IP) || (Cmsg->cmsg_type != IP_RECVERR))
+                continue;
+            Error = (struct sock_extended_err*)CMSG_DATA(Cmsg);
+            if((Error->ee_errno != 0) || (Error->ee_origin != SO_EE_ORIGIN_ZEROCOPY))
+                continue;
+            if(Error->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+                GWBZeroCopyCopied += Error->ee_data - Error->ee_info + 1;
+            if((int32_t)(Error->ee_data + 1 - ZeroCopy->Released) > 0)
+                ZeroCopy->Released = Error->ee_data + 1;
+        }
+    }
+}
+
+
+//
+// wait until the kernel has released a frame sent by MSG_ZEROCOPY, so its buffer
+// can be DMA'd into again. The header slots are shared by all frames, so frames
+// are released one at a time. If the release doesn't come, give the buffer back anyway.
+//
+static void WaitWBZeroCopyRelease(struct WBFrame* Frame)
+{
+    struct WBZeroCopy* ZeroCopy = Frame->ZeroCopy;
+    struct pollfd PollData;
+
+    GWBZeroCopyFrames++;
+    ReadWBZeroCopyReleases(ZeroCopy);
+    while((int32_t)(ZeroCopy->NextId - ZeroCopy->Released) > 0)
+    {
+        PollData.fd = ZeroCopy->Socketid;
+        PollData.events = 0;                                    // the error queue is reported as POLLERR
+        PollData.revents = 0;
+        if(poll(&PollData, 1, VWBZCTIMEOUT) <= 0)
+        {
+            GWBZeroCopyTimeouts++;
+            ZeroCopy->Released = ZeroCopy->NextId;
+            break;
+        }
+        ReadWBZeroCopyReleases(ZeroCopy);
+    }
+}
+
+
+//
+// wideband sender thread
+// sends frames from the DMA buffers in turn, as the wideband thread fills them
+//
+static void *WBSenderThread(void *arg)
+{
+    uint32_t PacketCounter;
+    uint32_t Buffer = 0;
+
+    (void)arg;
+    memset(WBPacketIovecs, 0, sizeof(WBPacketIovecs));
+    memset(WBDatagrams, 0, sizeof(WBDatagrams));
+    for (PacketCounter = 0; PacketCounter < VWBMAXPACKETS; PacketCounter++)
+    {
+        WBPacketIovecs[PacketCounter][0].iov_base = &WBPacketHeader[PacketCounter];
+        WBPacketIovecs[PacketCounter][0].iov_len = sizeof(uint32_t);
+        WBDatagrams[PacketCounter].msg_hdr.msg_iov = WBPacketIovecs[PacketCounter];
+        WBDatagrams[PacketCounter].msg_hdr.msg_iovlen = 2;
+        WBDatagrams[PacketCounter].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    }
+    memset(WBSpectrumDatagrams, 0, sizeof(WBSpectrumDatagrams));
+    for (PacketCounter = 0; PacketCounter < VWBSPECTRUMPKTS; PacketCounter++)
+    {
+        WBSpectrumIovecs[PacketCounter].iov_base = WBSpectrumPacket[PacketCounter];
+        WBSpectrumIovecs[PacketCounter].iov_len = sizeof(WBSpectrumPacket[PacketCounter]);
+        WBSpectrumDatagrams[PacketCounter].msg_hdr.msg_iov = &WBSpectrumIovecs[PacketCounter];
+        WBSpectrumDatagrams[PacketCounter].msg_hdr.msg_iovlen = 1;
+        WBSpectrumDatagrams[PacketCounter].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    }
+
+    while(true)
+    {
+        sem_wait(&WBFullBuffers);
+        if(WBSenderExit)
+            break;
+        SendWBFrame(&WBFrames[Buffer]);
+        if(WBFrames[Buffer].ZeroCopy != NULL)
+            WaitWBZeroCopyRelease(&WBFrames[Buffer]);
+        Buffer = (Buffer + 1) % VWBNUMBUFFERS;
+        sem_post(&WBFreeBuffers);                               // buffer can be DMA'd into again
+    }
+    return NULL;
+}
+
+
 //
 // strategy:
-// 1. We have one DMA buffer, big enough for the largest DMA from the wideband FIFO
+// 1. We have two DMA buffers, each big enough for the largest DMA from the wideband FIFO
 // 2. On startup: turn off the IP and clear the FIFO if any data in it. 
 // 3. when the wideband settings change: stop operation; clear FIFO; setup new settings & restart if still enabled
 // 4. wideband IP started; it periodically writes defined sample count to FIFO
 // 5. When write complete, a status flag is set; one for each ADC
-// 6. when a flag is set, DMA out the data for that ADC then write the bit to say "data transferred"
-// 7. break data into N outgoing packets and send to Thetis over UDP
-// 8. Need to check if both ADCs are enabled, because more data will follow if so
+// 6. when a flag is set, DMA out the data for that ADC into the next free buffer, then write the bit to say "data transferred"
+// 7. hand the buffer to the sender thread, which breaks the data into N outgoing packets and sends to Thetis over UDP
+//    while the next capture is made and DMA'd into the other buffer
+// 8. Need to check if both ADCs are enabled, because more data will follow if so.
+//    the IP records ADC1 straight after ADC0 is acknowledged, so wait for it in the same cycle
+//    and send it to its own port, rather than leave it till the next poll.
+//    if both captures are found in the FIFO together, split them at the capture length.
 // 9. when exiting: turn off the IP.
 //
 
 
 //
-// this runs as its own thread to send outgoing wideband data
+// this runs as its own thread to read wideband data
 // thread initiated after a "Start" command
 // will be instructed to stop & exit by main loop setting enable_thread to 0
 // this code signals thread terminated by setting active_thread = 0
@@ -187,26 +676,33 @@ void *OutgoingWidebandSamples(void *arg)
     bool InitError = false;                                     // becomes true if we get an initialisation error
     
     int ADC;                                                    // iterator
+    uint32_t StateCount;                                        // thread state changes seen
     uint32_t SampleWordCount;                                   // no of 64 bit words required
     bool ADC1, ADC2;                                            // true if data available
-    uint32_t PacketCounter;
-    uint32_t StartAddress;                                      // data locations in wideband collected data
     struct ThreadSocketData *ThreadData;                        // socket etc data for each thread.
                                                                 // points to 1st one
-//
-// variables for outgoing UDP frame
-//
-    struct sockaddr_in DestAddr[VNUMWBADC];                     // destination address for outgoing data
-    struct iovec iovecinst[VNUMWBADC];                          // instance of iovec
-    struct msghdr datagram[VNUMWBADC];
-    uint32_t SequenceCounter[VNUMWBADC];                        // UDP sequence count
+    pthread_t SenderThread;
+    bool SenderStarted = false;                                 // true if sender thread running
+    int Error;
+    uint32_t Poll;
+    int WBEvent_fd = -1;                                        // wideband data ready event device
+    bool WBEventsSeen = false;                                  // true once a data ready interrupt has been seen
+    struct RadioState State;                                    // snapshot of the radio state
+    uint32_t StateVersion = 0;
+    uint32_t AppliedWBVersion = 0;                              // wideband settings version the IP was set up with
+    uint8_t AppliedWBFactor = 1;                                // overload update period multiplier it was set up with
+    uint32_t UpdateRate;
+    struct RadioState* NewState;
     
 
 //
-// initialise. Create memory buffers and open DMA file devices
+// initialise. Memory buffers are created when wideband is first enabled
 // (strategy step 1)
 //
-    InitError = CreateWBDynamicMemory();
+    sem_init(&WBFreeBuffers, 0, VWBNUMBUFFERS);
+    sem_init(&WBFullBuffers, 0, 0);
+    WBSenderExit = false;
+    WBNextBuffer = 0;
     //
     // note we re-use the DMA device for MIC samples
     //
@@ -218,11 +714,48 @@ void *OutgoingWidebandSamples(void *arg)
     // set up per-ADC data structures
     //
     for (ADC = 0; ADC < VNUMWBADC; ADC++)
-    {
-        SequenceCounter[ADC] = 0;                           // clear UDP packet counter
         (ThreadData + ADC)->Active = true;                  // set outgoing socket active
+
+    //
+    // if requested, open the event device for the wideband data ready interrupt.
+    // until an interrupt has been seen, the wait times out at the poll period,
+    // so this behaves as before if the interrupt isn't wired in the FPGA.
+    //
+    if(UseFIFOInterrupts)
+    {
+        WBEvent_fd = OpenUserIRQWaiter(VIRQWIDEBAND);
+        if(WBEvent_fd < 0)
+            printf("XDMA event device %s not available, polling for wideband data\n", VWBEVENTDEVICE);
     }
 
+    //
+    // if configured, read each capture with one EOP terminated DMA from its own
+    // AXI-Stream C2H channel. Needs an FPGA build with the wideband FIFO on such a
+    // channel, ending each capture with TLAST; otherwise the memory mapped read is used
+    //
+    if(WBEOPDevice != NULL)
+    {
+        WBEOP_fd = OpenDMADevice(WBEOPDevice, O_RDONLY);
+        if((WBEOP_fd >= 0) && (SetDMAEOPRead(WBEOP_fd, true) != 0))
+        {
+            close(WBEOP_fd);
+            WBEOP_fd = -1;
+        }
+        if(WBEOP_fd >= 0)
+            printf("wideband captures read by EOP terminated DMA from %s\n", WBEOPDevice);
+        else
+            printf("wideband EOP device %s not available, reading captures by word count\n", WBEOPDevice);
+    }
+
+    InitialiseWBZeroCopy(ThreadData);
+    Error = pthread_create(&SenderThread, NULL, WBSenderThread, NULL);
+    if(Error != 0)
+    {
+        printf("pthread_create wideband sender: %s\n", strerror(Error));
+        InitError = true;
+    }
+    else
+        SenderStarted = true;
 
 
 //
@@ -232,16 +765,17 @@ void *OutgoingWidebandSamples(void *arg)
 // 
     SetWidebandEnable(false, false, false);                 // turn off data collection
     usleep(150);                                            // wait dfor any current write to end
-    ReadFIFOContent();                                      // then empty the FIFO
+    DiscardFIFOContent();                                   // then empty the FIFO
 
 //
 // thread loop. runs continuously until commanded by main loop to exit
 // initialise thread data structures;
 // then while there is wideband data, make outgoing packets;
 //
-    while(!InitError)
+    while(!InitError && !ThreadStopRequested())
     {
-        while(!SDRActive)
+        StateCount = GetThreadStateCount();
+        while(!__atomic_load_n(&SDRActive, __ATOMIC_ACQUIRE) && !ThreadStopRequested())
         {
             for (ADC=0; ADC < VNUMWBADC; ADC++)
                 if((ThreadData+ADC) -> Cmdid & VBITCHANGEPORT)
@@ -250,55 +784,66 @@ void *OutgoingWidebandSamples(void *arg)
                     MakeSocket((ThreadData + ADC), 0);                        // this binds to the new port.
                     (ThreadData + ADC) -> Cmdid &= ~VBITCHANGEPORT;           // clear command bit
                 }
-            usleep(100);
+            WaitThreadStateChange(&StateCount);                               // sleep until the state changes
         }
+        if(ThreadStopRequested())
+            break;
         printf("starting outgoing Wideband data\n");
         //
-        // initialise outgoing WB packet buffers - 1 per ADC
+        // initialise outgoing WB destination - 1 per ADC
         //
+        StateVersion = ReadRadioState(&State);
         for (ADC = 0; ADC < VNUMWBADC; ADC++)
-        {
-            SequenceCounter[ADC] = 0;
-            memcpy(&DestAddr[ADC], &reply_addr, sizeof(struct sockaddr_in));           // local copy of PC destination address (reply_addr is global)
-            memset(&iovecinst[ADC], 0, sizeof(struct iovec));
-            memset(&datagram[ADC], 0, sizeof(struct msghdr));
-            iovecinst[ADC].iov_base = WBUDPBuffer[ADC];
-            iovecinst[ADC].iov_len = VWBPACKETSIZE;
-            datagram[ADC].msg_iov = &iovecinst[ADC];
-            datagram[ADC].msg_iovlen = 1;
-            datagram[ADC].msg_name = &DestAddr[ADC];                   // MAC addr & port to send to
-            datagram[ADC].msg_namelen = sizeof(struct sockaddr_in);
-        }
+            memcpy(&WBDestAddr[ADC], &State.ReplyAddr, sizeof(struct sockaddr_in));      // local copy of PC destination address
       //
       // enable Saturn WB IP to transfer data
       // this is the main app loop
       // monitor changes to paramters, because this is the trigger to reconfigure operation
       //
+        InitialiseWBPacing(ThreadData);
         printf("outDDCIQ: enable data transfer\n");
-        while(!InitError && SDRActive)
+        while(!InitError)
         {
+            RefreshRadioState(&State, &StateVersion);                   // one consistent snapshot per pass
+            if(!State.SDRActive)
+                break;
 //
 // if parameters have changed, halt then re-load configuration (strategy step 3)
 // (this will also work from a cold start)
 //
-            if(WBParamsChanged)
+            if((State.WBParamsVersion != AppliedWBVersion)
+               || (__atomic_load_n(&GOverloadWBFactor, __ATOMIC_RELAXED) != AppliedWBFactor))
             {
+                AppliedWBFactor = __atomic_load_n(&GOverloadWBFactor, __ATOMIC_RELAXED);
+                StoredEnables = State.WBEnables;
+                StoredSamplePerPktCount = State.WBSamplesPerPacket;
+                StoredSampleSize = State.WBSampleSize;
+                StoredRate = State.WBRate;
+                StoredPacketCount = State.WBPacketCount;
+                if((StoredEnables != 0) && CreateWBDynamicMemory())
+                {
+                    InitError = true;
+                    break;
+                }
                 SetWidebandEnable(false, false, false);                 // turn off data collection
                 usleep(150);                                            // wait for any current write to end
-                ReadFIFOContent();                                      // then empty the FIFO discarding data
+                DiscardFIFOContent();                                   // then empty the FIFO discarding data
                 SampleWordCount = ((StoredSamplePerPktCount * StoredPacketCount) / 4) + 8;    // no. 64 bit words; over-read by 8 words
                 SetWidebandSampleCount(SampleWordCount);
-                SetWidebandUpdateRate(StoredRate);
+                WBCaptureWords = SampleWordCount;
+                UpdateRate = (uint32_t)StoredRate * AppliedWBFactor;   // overload shedding lengthens the period
+                SetWidebandUpdateRate((UpdateRate > 255) ? 255 : UpdateRate);
                 SetWidebandEnable((bool)(StoredEnables&1), (bool)(StoredEnables&2), false);
-                printf("Setting WB IP: WordCount = %d, Rate = %d, ADC1 = %d, ADC2=%d\n", SampleWordCount, StoredRate, (StoredEnables&1), (StoredEnables&2));
-                WBParamsChanged = false;
+                printf("Setting WB IP: WordCount = %d, Rate = %d, ADC1 = %d, ADC2=%d, sent as %d bit samples\n", SampleWordCount, StoredRate,
+                       (StoredEnables&1), (StoredEnables&2), GetWBSampleBits(StoredSampleSize, StoredSamplePerPktCount));
+                AppliedWBVersion = State.WBParamsVersion;
             }
 //
 // then if enabled:
 // using a while loop, wait for data to be available from the FPGA. 
-// When it is, read it and clear the IP "data available" flag
+// When it is, read it into the next free buffer and clear the IP "data available" flag
 // (strategy step 6)
-// then send out packets to SDR client
+// then hand the buffer to the sender thread to send out packets to SDR client
 // recheck if parameters have changed after a successful ready
 //
             if(StoredEnables != 0)                      // if active
@@ -306,37 +851,56 @@ void *OutgoingWidebandSamples(void *arg)
                 GetWidebandStatus(&ADC1, &ADC2);      // get flags for data available
                 if(ADC1 || ADC2)                                        // if data available for either
                 {
-                    SampleWordCount = ReadFIFOContent();                // then read FIFO till empty
-//                    printf("WB data available, ADC sample count = %d\n", SampleWordCount);
+                    if(ADC1 && ADC2)                                    // both captures in FIFO: ADC0 first
+                    {
+                        QueueWBFrame(ThreadData, 0, WBCaptureWords);
+                        QueueWBFrame(ThreadData, 1, 0);
+                    }
+                    else
+                        QueueWBFrame(ThreadData, ADC2 ? 1 : 0, 0);      // then read FIFO till empty
                     SetWidebandEnable((bool)(StoredEnables&1), (bool)(StoredEnables&2), true);  // re-enable record
                     //
-                    // now transfer data out on UDP packets
-                    // first select the buffer set yo use based on what data is available
+                    // if that was ADC0 and ADC1 is enabled too, its capture follows straight away
                     //
-                    if(ADC2)
-                        ADC=1;
-                    else
-                        ADC=0;
-                    SequenceCounter[ADC] = 0;                           // restart at 0 for each frame
-                    for(PacketCounter = 0; PacketCounter < StoredPacketCount; PacketCounter++)
+                    if(ADC1 && !ADC2 && (StoredEnables & 2))
                     {
-                        *(uint32_t*)WBUDPBuffer[ADC] = htonl(SequenceCounter[ADC]++);     // add sequence count
-                        //
-                        // now add I/Q data & send outgoing packet
-                        //
-                        StartAddress = (PacketCounter * StoredSamplePerPktCount * 2) + 32;   // byte address; inset 4 words into recording
-                        memcpy(WBUDPBuffer[ADC] + 4, WBDMAReadBuffer + StartAddress, StoredSamplePerPktCount * 2);
-                        iovecinst[ADC].iov_len = StoredSamplePerPktCount * 2 + 4;           // P2 data dependent
-
-                        sendmsg((ThreadData+ADC)->Socketid, &datagram[ADC], 0);
-                        usleep(200);                    // gap between outgoing messages
+                        for(Poll = 0; Poll < VWBADC1WAIT; Poll++)
+                        {
+                            usleep(VWBADC1POLL);
+                            GetWidebandStatus(&ADC1, &ADC2);
+                            if(ADC2)
+                            {
+                                QueueWBFrame(ThreadData, 1, 0);
+                                SetWidebandEnable((bool)(StoredEnables&1), (bool)(StoredEnables&2), true);  // re-enable record
+                                break;
+                            }
+                        }
                     }
                 }
             }
-            usleep(5000);
+            //
+            // wait for the next capture: sleep till the data ready interrupt if available
+            //
+            if(WBEvent_fd >= 0)
+            {
+                if(WaitFIFOMonitorEvent(WBEvent_fd, WBEventsSeen ? VWBEVENTTIMEOUT : VWBPOLLTIME))
+                    WBEventsSeen = true;
+            }
+            else
+                usleep(VWBPOLLTIME * 1000);
 
         }     // end of while(!InitError&& SDRActive) loop - typically when comm with SDR client stops
-        StoredEnables = false;                                          // force a re-config if comm continues later
+        //
+        // stop capturing and empty the FIFO now, so a capture left over from this session
+        // isn't sent when the next one starts
+        //
+        SetWidebandEnable(false, false, false);
+        usleep(150);                                                    // wait for any current write to end
+        DiscardFIFOContent();
+        NewState = BeginRadioStateUpdate();                             // force a re-config if comm continues later
+        NewState->WBEnables = 0;
+        EndRadioStateUpdate();
+        StoredEnables = 0;
     } //end of while(!InitError)
 
 //
@@ -345,8 +909,25 @@ void *OutgoingWidebandSamples(void *arg)
 //
     printf("shutting down Wideband outgoing thread\n");
     SetWidebandEnable(false, false, false);
+    if(SenderStarted)
+    {
+        WBSenderExit = true;
+        sem_post(&WBFullBuffers);
+        pthread_join(SenderThread, NULL);
+    }
+    if(GWBZeroCopyFrames != 0)
+        printf("wideband frames sent by MSG_ZEROCOPY = %llu, datagrams copied by the kernel = %llu, releases timed out = %llu\n",
+               (unsigned long long)GWBZeroCopyFrames, (unsigned long long)GWBZeroCopyCopied,
+               (unsigned long long)GWBZeroCopyTimeouts);
+    if(WBEvent_fd >= 0)
+        CloseUserIRQWaiter(WBEvent_fd);
+    if(WBEOP_fd >= 0)
+    {
+        close(WBEOP_fd);
+        WBEOP_fd = -1;
+    }
     close(ThreadData->Socketid); 
     ThreadData->Active = false;                   // signal closed
     FreeWBDynamicMemory();
     return NULL;
-}
\ No newline at end of file
+}
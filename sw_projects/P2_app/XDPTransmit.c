@@ -0,0 +1,423 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// licenced under GNU GPL3
+//
+// XDPTransmit.c:
+//
+// AF_XDP transmit of UDP packets, bypassing the kernel network stack.
+// the packets are built in place in a UMEM (memory registered with the socket)
+// with the ethernet, IP and UDP headers written by the application; the NIC
+// reads them directly from there if the driver supports zero copy.
+// a transmit only socket needs no XDP program, so no BPF library is needed:
+// this uses the AF_XDP kernel interface directly.
+//
+//////////////////////////////////////////////////////////////
+
+#include "XDPTransmit.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <linux/if_xdp.h>
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+
+//
+// map one of the socket rings
+//
+static bool MapXDPRing(struct XDPTransmit* Xdp, struct XDPRing* Ring, const struct xdp_ring_offset* Offsets,
+                       off_t PageOffset, size_t EntrySize, uint32_t Entries)
+{
+    Ring->MapSize = Offsets->desc + Entries * EntrySize;
+    Ring->Map = mmap(NULL, Ring->MapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Xdp->Socketid, PageOffset);
+    if(Ring->Map == MAP_FAILED)
+    {
+        Ring->Map = NULL;
+        perror("AF_XDP ring mmap");
+        return false;
+    }
+    Ring->Producer = (uint32_t*)((uint8_t*)Ring->Map + Offsets->producer);
+    Ring->Consumer = (uint32_t*)((uint8_t*)Ring->Map + Offsets->consumer);
+    Ring->Flags = (uint32_t*)((uint8_t*)Ring->Map + Offsets->flags);
+    Ring->Entries = (uint8_t*)Ring->Map + Offsets->desc;
+    Ring->Mask = Entries - 1;
+    Ring->Head = 0;
+    return true;
+}
+
+
+static void UnmapXDPRing(struct XDPRing* Ring)
+{
+    if(Ring->Map)
+        munmap(Ring->Map, Ring->MapSize);
+    Ring->Map = NULL;
+}
+
+
+//
+// bind to queue 0: zero copy if possible, else copy mode
+//
+static bool BindXDPSocket(struct XDPTransmit* Xdp)
+{
+    struct sockaddr_xdp Addr;
+
+    memset(&Addr, 0, sizeof(Addr));
+    Addr.sxdp_family = AF_XDP;
+    Addr.sxdp_ifindex = Xdp->Ifindex;
+    Addr.sxdp_queue_id = 0;
+    Addr.sxdp_flags = XDP_ZEROCOPY | XDP_USE_NEED_WAKEUP;
+    if(bind(Xdp->Socketid, (struct sockaddr*)&Addr, sizeof(Addr)) == 0)
+    {
+        Xdp->ZeroCopy = true;
+        return true;
+    }
+    Addr.sxdp_flags = XDP_COPY | XDP_USE_NEED_WAKEUP;
+    if(bind(Xdp->Socketid, (struct sockaddr*)&Addr, sizeof(Addr)) == 0)
+    {
+        Xdp->ZeroCopy = false;
+        return true;
+    }
+    perror("AF_XDP bind");
+    return false;
+}
+
+
+//
+// get the interface MAC and IPv4 addresses
+//
+static bool GetInterfaceAddresses(struct XDPTransmit* Xdp, const char* Interface)
+{
+    struct ifreq Request;
+    int fd;
+    bool Result = true;
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if(fd < 0)
+        return false;
+    memset(&Request, 0, sizeof(Request));
+    strncpy(Request.ifr_name, Interface, IFNAMSIZ - 1);
+    if(ioctl(fd, SIOCGIFHWADDR, &Request) < 0)
+        Result = false;
+    else
+        memcpy(Xdp->SourceMAC, Request.ifr_hwaddr.sa_data, 6);
+    if(ioctl(fd, SIOCGIFADDR, &Request) < 0)
+        Result = false;
+    else
+        Xdp->SourceIP = ((struct sockaddr_in*)&Request.ifr_addr)->sin_addr.s_addr;
+    close(fd);
+    return Result;
+}
+
+
+//
+// open an AF_XDP transmit socket
+//
+bool XDPTransmitOpen(struct XDPTransmit* Xdp, const char* Interface, uint32_t Frames)
+{
+    struct xdp_umem_reg UmemReg;
+    struct xdp_mmap_offsets Offsets;
+    socklen_t OptLength;
+    int RingSize = VXDPRINGSIZE;
+
+    memset(Xdp, 0, sizeof(*Xdp));
+    Xdp->Socketid = -1;
+    Xdp->Ifindex = if_nametoindex(Interface);
+    if(Xdp->Ifindex == 0)
+    {
+        printf("AF_XDP: no interface %s\n", Interface);
+        return false;
+    }
+    if(!GetInterfaceAddresses(Xdp, Interface))
+    {
+        printf("AF_XDP: can't get addresses of %s\n", Interface);
+        return false;
+    }
+    Xdp->UmemSize = (uint64_t)Frames * VXDPFRAMESIZE;
+    Xdp->Umem = mmap(NULL, Xdp->UmemSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if(Xdp->Umem == MAP_FAILED)
+    {
+        Xdp->Umem = NULL;
+        perror("AF_XDP UMEM mmap");
+        return false;
+    }
+    mlock(Xdp->Umem, Xdp->UmemSize);
+    Xdp->Socketid = socket(AF_XDP, SOCK_RAW, 0);
+    if(Xdp->Socketid < 0)
+    {
+        perror("AF_XDP socket");
+        XDPTransmitClose(Xdp);
+        return false;
+    }
+
+    memset(&UmemReg, 0, sizeof(UmemReg));
+    UmemReg.addr = (uint64_t)(uintptr_t)Xdp->Umem;
+    UmemReg.len = Xdp->UmemSize;
+    UmemReg.chunk_size = VXDPFRAMESIZE;
+    UmemReg.headroom = 0;
+    OptLength = sizeof(Offsets);
+    if((setsockopt(Xdp->Socketid, SOL_XDP, XDP_UMEM_REG, &UmemReg, sizeof(UmemReg)) < 0)
+       || (setsockopt(Xdp->Socketid, SOL_XDP, XDP_UMEM_FILL_RING, &RingSize, sizeof(RingSize)) < 0)
+       || (setsockopt(Xdp->Socketid, SOL_XDP, XDP_UMEM_COMPLETION_RING, &RingSize, sizeof(RingSize)) < 0)
+       || (setsockopt(Xdp->Socketid, SOL_XDP, XDP_TX_RING, &RingSize, sizeof(RingSize)) < 0)
+       || (getsockopt(Xdp->Socketid, SOL_XDP, XDP_MMAP_OFFSETS, &Offsets, &OptLength) < 0))
+    {
+        perror("AF_XDP socket setup");
+        XDPTransmitClose(Xdp);
+        return false;
+    }
+    if(!MapXDPRing(Xdp, &Xdp->Fill, &Offsets.fr, XDP_UMEM_PGOFF_FILL_RING, sizeof(uint64_t), VXDPRINGSIZE)
+       || !MapXDPRing(Xdp, &Xdp->Completion, &Offsets.cr, XDP_UMEM_PGOFF_COMPLETION_RING, sizeof(uint64_t), VXDPRINGSIZE)
+       || !MapXDPRing(Xdp, &Xdp->Tx, &Offsets.tx, XDP_PGOFF_TX_RING, sizeof(struct xdp_desc), VXDPRINGSIZE)
+       || !BindXDPSocket(Xdp))
+    {
+        XDPTransmitClose(Xdp);
+        return false;
+    }
+    printf("AF_XDP transmit on %s queue 0, %s mode\n", Interface, Xdp->ZeroCopy ? "zero copy" : "copy");
+    return true;
+}
+
+
+//
+// close the socket and free the UMEM
+//
+void XDPTransmitClose(struct XDPTransmit* Xdp)
+{
+    UnmapXDPRing(&Xdp->Tx);
+    UnmapXDPRing(&Xdp->Completion);
+    UnmapXDPRing(&Xdp->Fill);
+    if(Xdp->Socketid >= 0)
+        close(Xdp->Socketid);
+    Xdp->Socketid = -1;
+    if(Xdp->Umem)
+        munmap(Xdp->Umem, Xdp->UmemSize);
+    Xdp->Umem = NULL;
+}
+
+
+//
+// find a MAC address in the kernel neighbour table
+//
+static bool LookupNeighbour(in_addr_t IP, int Ifindex, uint8_t* MAC)
+{
+    FILE* fp;
+    char Line[256];
+    char IPText[64], HWText[64], Device[IF_NAMESIZE + 1];
+    unsigned int HWType, Flags;
+    unsigned int Bytes[6];
+    struct in_addr Addr;
+    bool Found = false;
+    int Cntr;
+
+    fp = fopen("/proc/net/arp", "r");
+    if(fp == NULL)
+        return false;
+    if(fgets(Line, sizeof(Line), fp) == NULL)                   // heading line
+    {
+        fclose(fp);
+        return false;
+    }
+    while(!Found && (fgets(Line, sizeof(Line), fp) != NULL))
+    {
+        if(sscanf(Line, "%63s 0x%x 0x%x %63s %*s %16s", IPText, &HWType, &Flags, HWText, Device) != 5)
+            continue;
+        if((inet_aton(IPText, &Addr) == 0) || (Addr.s_addr != IP) || !(Flags & 0x2)
+           || (if_nametoindex(Device) != (unsigned int)Ifindex))
+            continue;
+        if(sscanf(HWText, "%x:%x:%x:%x:%x:%x", &Bytes[0], &Bytes[1], &Bytes[2], &Bytes[3], &Bytes[4], &Bytes[5]) != 6)
+            continue;
+        for(Cntr = 0; Cntr < 6; Cntr++)
+            MAC[Cntr] = (uint8_t)Bytes[Cntr];
+        Found = true;
+    }
+    fclose(fp);
+    return Found;
+}
+
+
+//
+// find the default gateway for an interface
+//
+static bool LookupGateway(int Ifindex, in_addr_t* Gateway)
+{
+    FILE* fp;
+    char Line[256];
+    char Device[IF_NAMESIZE + 1];
+    unsigned int Destination, Gate, Flags;
+    bool Found = false;
+
+    fp = fopen("/proc/net/route", "r");
+    if(fp == NULL)
+        return false;
+    if(fgets(Line, sizeof(Line), fp) == NULL)                   // heading line
+    {
+        fclose(fp);
+        return false;
+    }
+    while(!Found && (fgets(Line, sizeof(Line), fp) != NULL))
+    {
+        if(sscanf(Line, "%16s %x %x %x", Device, &Destination, &Gate, &Flags) != 4)
+            continue;
+        if((Destination == 0) && (Flags & 0x2) && (if_nametoindex(Device) == (unsigned int)Ifindex))
+        {
+            *Gateway = (in_addr_t)Gate;                         // already in network byte order
+            Found = true;
+        }
+    }
+    fclose(fp);
+    return Found;
+}
+
+
+//
+// IPv4 header checksum
+//
+static uint16_t IPChecksum(const uint8_t* Header, uint32_t Length)
+{
+    uint32_t Sum = 0;
+    uint32_t Cntr;
+
+    for(Cntr = 0; Cntr < Length; Cntr += 2)
+        Sum += (Header[Cntr] << 8) | Header[Cntr + 1];
+    while(Sum >> 16)
+        Sum = (Sum & 0xFFFF) + (Sum >> 16);
+    return htons((uint16_t)~Sum);
+}
+
+
+//
+// build the ethernet + IPv4 + UDP header
+// every packet of a stream has the same length, and IP ID 0 with "don't fragment" set
+// (RFC 6864), so the whole header is constant and the checksum is calculated once.
+// the UDP checksum is 0 (none), which IPv4 allows.
+//
+bool XDPBuildHeader(struct XDPTransmit* Xdp, uint8_t* Header, const struct sockaddr_in* Dest,
+                    uint16_t SourcePort, uint32_t PayloadBytes)
+{
+    uint8_t DestMAC[6];
+    in_addr_t Gateway;
+    uint8_t* IP = Header + 14;
+    uint8_t* UDP = Header + 34;
+
+    if(!LookupNeighbour(Dest->sin_addr.s_addr, Xdp->Ifindex, DestMAC)
+       && !(LookupGateway(Xdp->Ifindex, &Gateway) && LookupNeighbour(Gateway, Xdp->Ifindex, DestMAC)))
+        return false;
+
+    memcpy(Header, DestMAC, 6);
+    memcpy(Header + 6, Xdp->SourceMAC, 6);
+    *(uint16_t*)(Header + 12) = htons(0x0800);                  // IPv4
+
+    memset(IP, 0, 20);
+    IP[0] = 0x45;                                               // version 4, 5 word header
+    *(uint16_t*)(IP + 2) = htons(20 + 8 + PayloadBytes);
+    *(uint16_t*)(IP + 6) = htons(0x4000);                       // don't fragment
+    IP[8] = 64;                                                 // TTL
+    IP[9] = IPPROTO_UDP;
+    memcpy(IP + 12, &Xdp->SourceIP, 4);
+    memcpy(IP + 16, &Dest->sin_addr.s_addr, 4);
+    *(uint16_t*)(IP + 10) = IPChecksum(IP, 20);
+
+    *(uint16_t*)(UDP + 0) = htons(SourcePort);
+    *(uint16_t*)(UDP + 2) = Dest->sin_port;
+    *(uint16_t*)(UDP + 4) = htons(8 + PayloadBytes);
+    *(uint16_t*)(UDP + 6) = 0;
+    return true;
+}
+
+
+//
+// free TX ring entries
+//
+uint32_t XDPTransmitSpace(struct XDPTransmit* Xdp)
+{
+    uint32_t Consumer;
+
+    Consumer = __atomic_load_n(Xdp->Tx.Consumer, __ATOMIC_ACQUIRE);
+    return (Xdp->Tx.Mask + 1) - (Xdp->Tx.Head - Consumer);
+}
+
+
+//
+// tell the kernel there is work: always needed in copy mode, and in zero copy mode
+// when the driver has asked to be woken
+//
+static void KickXDPTransmit(struct XDPTransmit* Xdp)
+{
+    if(!Xdp->ZeroCopy || (__atomic_load_n(Xdp->Tx.Flags, __ATOMIC_ACQUIRE) & XDP_RING_NEED_WAKEUP))
+        sendto(Xdp->Socketid, NULL, 0, MSG_DONTWAIT, NULL, 0);
+}
+
+
+//
+// queue packets for transmit
+//
+uint32_t XDPTransmitQueue(struct XDPTransmit* Xdp, const uint64_t* Addr, uint32_t Length, uint32_t Count)
+{
+    struct xdp_desc* Desc;
+    uint32_t Space;
+    uint32_t Cntr;
+
+    Space = XDPTransmitSpace(Xdp);
+    if(Count > Space)
+        Count = Space;
+    for(Cntr = 0; Cntr < Count; Cntr++)
+    {
+        Desc = (struct xdp_desc*)Xdp->Tx.Entries + ((Xdp->Tx.Head + Cntr) & Xdp->Tx.Mask);
+        Desc->addr = Addr[Cntr];
+        Desc->len = Length;
+        Desc->options = 0;
+    }
+    if(Count != 0)
+    {
+        Xdp->Tx.Head += Count;
+        __atomic_store_n(Xdp->Tx.Producer, Xdp->Tx.Head, __ATOMIC_RELEASE);
+        Xdp->InFlight += Count;
+        KickXDPTransmit(Xdp);
+    }
+    return Count;
+}
+
+
+//
+// collect completed packets
+//
+uint32_t XDPTransmitReap(struct XDPTransmit* Xdp, uint64_t* Addr, uint32_t Max)
+{
+    uint32_t Producer;
+    uint32_t Count;
+    uint32_t Cntr;
+
+    if(Xdp->InFlight == 0)
+        return 0;
+    Producer = __atomic_load_n(Xdp->Completion.Producer, __ATOMIC_ACQUIRE);
+    Count = Producer - Xdp->Completion.Head;
+    if(Count == 0)
+    {
+        KickXDPTransmit(Xdp);                                   // in case the driver is waiting to be woken
+        return 0;
+    }
+    if(Count > Max)
+        Count = Max;
+    for(Cntr = 0; Cntr < Count; Cntr++)
+        Addr[Cntr] = ((uint64_t*)Xdp->Completion.Entries)[(Xdp->Completion.Head + Cntr) & Xdp->Completion.Mask];
+    Xdp->Completion.Head += Count;
+    __atomic_store_n(Xdp->Completion.Consumer, Xdp->Completion.Head, __ATOMIC_RELEASE);
+    Xdp->InFlight -= Count;
+    return Count;
+}
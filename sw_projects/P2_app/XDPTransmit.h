@@ -0,0 +1,109 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// licenced under GNU GPL3
+//
+// XDPTransmit.h:
+//
+// header: AF_XDP transmit of UDP packets, bypassing the kernel network stack
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __XDPTransmit_h
+#define __XDPTransmit_h
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <netinet/in.h>
+
+
+#define VXDPFRAMESIZE 2048              // UMEM frame size: one packet per frame
+#define VXDPHEADROOM 64                 // offset of the UDP payload in a frame
+#define VXDPHEADERSIZE 42               // ethernet + IPv4 + UDP header, just below the payload
+#define VXDPRINGSIZE 512                // TX and completion ring entries (power of 2)
+
+
+//
+// one ring shared with the kernel
+//
+struct XDPRing
+{
+    uint32_t* Producer;
+    uint32_t* Consumer;
+    uint32_t* Flags;
+    void* Entries;
+    uint32_t Mask;
+    uint32_t Head;                                      // our local producer or consumer index
+    void* Map;
+    size_t MapSize;
+};
+
+
+//
+// an AF_XDP socket bound to one NIC queue, with its UMEM
+//
+struct XDPTransmit
+{
+    int Socketid;
+    int Ifindex;
+    uint8_t* Umem;                                      // packet frames, shared with the NIC
+    uint64_t UmemSize;
+    bool ZeroCopy;                                      // true if the NIC DMAs straight from UMEM
+    uint8_t SourceMAC[6];
+    in_addr_t SourceIP;
+    struct XDPRing Tx;
+    struct XDPRing Completion;
+    struct XDPRing Fill;                                // required by the kernel; not used for transmit
+    uint32_t InFlight;                                  // frames queued and not yet completed
+};
+
+
+//
+// open an AF_XDP transmit socket on queue 0 of an interface, with a UMEM of Frames frames
+// zero copy is used if the driver supports it, otherwise copy mode
+// returns false if AF_XDP can't be used (the caller should use UDP sockets)
+//
+bool XDPTransmitOpen(struct XDPTransmit* Xdp, const char* Interface, uint32_t Frames);
+
+
+//
+// close the socket and free the UMEM
+//
+void XDPTransmitClose(struct XDPTransmit* Xdp);
+
+
+//
+// build the ethernet + IPv4 + UDP header for packets of PayloadBytes to Dest, from SourcePort
+// the destination MAC is found from the kernel neighbour table (directly or via the gateway)
+// returns false if it isn't known
+//
+bool XDPBuildHeader(struct XDPTransmit* Xdp, uint8_t* Header, const struct sockaddr_in* Dest,
+                    uint16_t SourcePort, uint32_t PayloadBytes);
+
+
+//
+// free TX ring entries
+//
+uint32_t XDPTransmitSpace(struct XDPTransmit* Xdp);
+
+
+//
+// queue packets for transmit and start sending them
+// Addr = UMEM offsets of the headers; Length = header + payload bytes
+// returns the number queued (limited by XDPTransmitSpace())
+//
+uint32_t XDPTransmitQueue(struct XDPTransmit* Xdp, const uint64_t* Addr, uint32_t Length, uint32_t Count);
+
+
+//
+// collect completed packets: their UMEM offsets are written to Addr, up to Max
+// returns the number completed. Completed frames may be reused.
+//
+uint32_t XDPTransmitReap(struct XDPTransmit* Xdp, uint64_t* Addr, uint32_t Max);
+
+
+#endif
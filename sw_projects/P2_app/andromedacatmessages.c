@@ -29,6 +29,7 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <pthread.h>
+#include <time.h>
 
 #include "../common/saturnregisters.h"
 #include "../common/saturndrivers.h"
@@ -39,6 +40,15 @@
 
 
 
+uint32_t EncoderCoalesceTime = VDEFAULTENCODERWINDOW;     // encoder steps merged for this time, ms
+uint32_t VFOAcceleration = 0;                               // VFO acceleration, % per extra step in a window
+
+static pthread_mutex_t VFOStepMutex = PTHREAD_MUTEX_INITIALIZER;
+static int32_t PendingVFOSteps = 0;                         // encoder steps in the current window
+static int32_t CarriedVFOSteps = 0;                         // output steps still to send (above VMAXVFOSTEPS)
+static uint64_t VFOSendDue = 0;                             // ms time the window ends; 0 if none open
+
+
 //
 // make VFO encoder message
 //
@@ -51,6 +61,103 @@ void MakeVFOEncoderCAT(int8_t Steps)
 }
 
 
+//
+// helper: CLOCK_MONOTONIC time in ms
+//
+static uint64_t VFOTimeNow(void)
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (uint64_t)Now.tv_sec * 1000 + Now.tv_nsec / 1000000;
+}
+
+
+//
+// apply the acceleration curve to the steps in one window
+// each step after the first adds VFOAcceleration % to every step, so a slow turn is
+// unchanged and a fast spin tunes further
+//
+static int32_t AccelerateVFOSteps(int32_t Steps)
+{
+    int32_t Magnitude;
+
+    Magnitude = (Steps < 0) ? -Steps : Steps;
+    if((VFOAcceleration == 0) || (Magnitude <= 1))
+        return Steps;
+    return (int32_t)(((int64_t)Steps * (100 + (int64_t)VFOAcceleration * (Magnitude - 1))) / 100);
+}
+
+
+//
+// send the steps for a window that has ended: one ZZZU or ZZZD message
+// (call with VFOStepMutex held)
+//
+static void SendVFOWindow(uint64_t Now)
+{
+    int32_t Steps;
+
+    Steps = AccelerateVFOSteps(PendingVFOSteps) + CarriedVFOSteps;
+    PendingVFOSteps = 0;
+    CarriedVFOSteps = 0;
+    VFOSendDue = 0;
+    if(Steps > VMAXVFOSTEPS)
+    {
+        CarriedVFOSteps = Steps - VMAXVFOSTEPS;
+        Steps = VMAXVFOSTEPS;
+    }
+    else if(Steps < -VMAXVFOSTEPS)
+    {
+        CarriedVFOSteps = Steps + VMAXVFOSTEPS;
+        Steps = -VMAXVFOSTEPS;
+    }
+    MakeVFOEncoderCAT((int8_t)Steps);
+    if(CarriedVFOSteps != 0)
+        VFOSendDue = Now + EncoderCoalesceTime;             // send the rest in the next window
+}
+
+
+//
+// add VFO encoder steps. The first step opens a window of EncoderCoalesceTime;
+// the steps in it are sent as one message by SendCoalescedVFOSteps() when it ends.
+// if EncoderCoalesceTime = 0 they are sent straight away.
+//
+void QueueVFOEncoderSteps(int32_t Steps)
+{
+    uint64_t Now;
+
+    Now = VFOTimeNow();
+    pthread_mutex_lock(&VFOStepMutex);
+    PendingVFOSteps += Steps;
+    if(EncoderCoalesceTime == 0)
+        SendVFOWindow(Now);
+    else if(VFOSendDue == 0)
+        VFOSendDue = Now + EncoderCoalesceTime;
+    pthread_mutex_unlock(&VFOStepMutex);
+}
+
+
+//
+// send the VFO steps if the window has ended
+// returns the ms until it ends (so the caller can sleep until then),
+// or VNOVFOSTEPSDUE if no steps are waiting
+//
+uint32_t SendCoalescedVFOSteps(void)
+{
+    uint64_t Now;
+    uint32_t Result = VNOVFOSTEPSDUE;
+
+    Now = VFOTimeNow();
+    pthread_mutex_lock(&VFOStepMutex);
+    if((VFOSendDue != 0) && (Now >= VFOSendDue))
+        SendVFOWindow(Now);
+    if(VFOSendDue != 0)
+        Result = (uint32_t)(VFOSendDue - Now);
+    pthread_mutex_unlock(&VFOStepMutex);
+    return Result;
+}
+
+
 
 
 //
@@ -17,11 +17,35 @@
 #define __andromedacatmessages_h
 
 
+#include <stdint.h>
+
+
+#define VDEFAULTENCODERWINDOW 10        // default encoder step merge time, ms
+#define VMAXVFOSTEPS 99                 // most steps in one ZZZU/ZZZD message
+#define VNOVFOSTEPSDUE 0xFFFFFFFF       // SendCoalescedVFOSteps(): nothing waiting
+
+extern uint32_t EncoderCoalesceTime;    // encoder steps merged for this time, ms (0 = send each)
+extern uint32_t VFOAcceleration;        // VFO acceleration, % per extra step in a window (0 = none)
+
+
 //
 // make VFO encoder message
 //
 void MakeVFOEncoderCAT(int8_t Steps);
 
+//
+// add VFO encoder steps, to be sent as one message per EncoderCoalesceTime window
+// may be called from any thread
+//
+void QueueVFOEncoderSteps(int32_t Steps);
+
+//
+// send the VFO steps if their window has ended, with acceleration applied
+// returns the ms until the window ends, or VNOVFOSTEPSDUE if no steps are waiting.
+// the panel thread that queues steps must call this when that time is up.
+//
+uint32_t SendCoalescedVFOSteps(void);
+
 //
 // make ordinary encoder message
 //
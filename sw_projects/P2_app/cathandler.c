@@ -30,36 +30,56 @@
 #include <arpa/inet.h>
 #include <pthread.h>
 #include <syscall.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 
 #include "../common/saturnregisters.h"
 #include "../common/saturndrivers.h"
 #include "../common/hwaccess.h"
 #include "../common/debugaids.h"
+#include "../common/mpscring.h"
 #include "cathandler.h"
 #include "catmessages.h"
 #include "serialport.h"
+#include "threadmanager.h"
 
 
 
 bool CATPortAssigned = false;                // true if CAT set up and active
 int CATPort = 0;
 bool ThreadActive = false;                  // true while CAT thread running
-bool CATKeepaliveActive = false;            // true while keepalive thread running
 bool SignalThreadEnd = false;               // asserted to terminate thread
 pthread_t CATThread;                        // thread reads/writes CAT commands
-pthread_t CATKeepaliveThread;               // thread requests activity every 15s
 bool CATDebugPrint = false;                 // true if to print generated CAT messages
+int CATWake_fd = -1;                        // eventfd: wakes the CAT thread (message queued, or stop)
 
 
 
-#define VNUMOPSTRINGS 16                    // size of output queue
+#define VNUMOPSTRINGS 64                    // size of output queue (power of 2)
 #define VOPSTRSIZE 40                       // size of each string in queue
+#define VCATMAXBATCH 16                     // most messages sent in one writev() call
+#define VCATKEEPALIVE 15000                 // keepalive period, ms (Thetis drops the link after 30s idle)
+#define VCATCONNECTTIMEOUT 5000             // time allowed for a connect, ms
+#define VCATMINBACKOFF 1000                 // first reconnect delay, ms
+#define VCATMAXBACKOFF 30000                // longest reconnect delay, ms
+#define VCATSTARTWAITS 10                   // seconds to wait for SDR active at thread start
 //
-// CAT output buffer
+// CAT output queue. Messages are added by the panel, ATU, serial and CAT threads
+// and sent by the CAT thread, so it is a lock-free multiple producer queue.
 //
-char OutputStrings[VNUMOPSTRINGS] [VOPSTRSIZE];
-int CATWritePtr = 0;                        // pointer to next string to write
-int CATReadPtr = 0;                         // pointer to next string to read
+struct CATOutputMessage
+{
+  uint16_t Length;                          // characters in Text (not terminated)
+  char Text[VOPSTRSIZE];
+};
+
+struct CATOutputMessage OutputMessages[VNUMOPSTRINGS];
+atomic_uint OutputSequence[VNUMOPSTRINGS];  // slot sequence counts for the ring
+struct MPSCRing CATOutputRing;
+atomic_uint CATMessagesDropped;             // messages lost because the queue was full
+uint32_t CATHeadSent = 0;                   // characters of the oldest queued message already sent
 
 
 extern SCATCommands GCATCommands[];
@@ -94,9 +114,22 @@ long DivisorTable[] =
 
 
 
-// this array holds a 32 bit representation of the CAT command
-// to so a compare in a single test
-unsigned long GCATMatch[VNUMCATCMDS];
+//
+// CAT command lookup: a hash table of the 32 bit representation of each CAT command,
+// built from GCATCommands at initialise. Open addressing with linear probing;
+// the table is kept at most 1/3 full so a lookup is almost always a single compare.
+//
+#define VCATHASHSIZE 64                     // hash table entries (power of 2)
+#define VCATHASHSHIFT 26                    // 32 - log2(VCATHASHSIZE)
+#define VCATMAXPARAMSIZE 20                 // largest parameter string, including terminator
+
+typedef struct
+{
+  uint32_t MatchWord;                       // 32 bit version of the CAT command
+  ECATCommands Cmd;                         // eNoCommand if entry empty
+} SCATHashEntry;
+
+SCATHashEntry GCATHashTable[VCATHASHSIZE];
 
 
 //
@@ -130,9 +163,9 @@ bool isDigit(char ch)
 // Make32BitStr
 // simply a 4 char CAT command in a single 32 bit word for easy compare
 //
-unsigned long Make32BitStr(char* Input)
+uint32_t Make32BitStr(const char* Input)
 {
-  unsigned long Result;
+  uint32_t Result;
   byte CharCntr;
   char Ch;
   
@@ -142,12 +175,42 @@ unsigned long Make32BitStr(char* Input)
     Ch = Input[CharCntr];                                           // input character
     if (isLowerCase(Ch))                                             // force lower case to upper case
       Ch -= 0x20;
-    Result = (Result << 8) | Ch;
+    Result = (Result << 8) | (uint8_t)Ch;
   }
   return Result;
 }
 
 
+//
+// hash a 32 bit CAT command word to a hash table index
+// (multiplicative hash: uses the top bits of the product)
+//
+static inline uint32_t CATHash(uint32_t MatchWord)
+{
+  return (MatchWord * 2654435761U) >> VCATHASHSHIFT;
+}
+
+
+//
+// find the CAT command matching a 32 bit command word
+// returns eNoCommand if not recognised
+//
+ECATCommands LookupCATCommand(uint32_t MatchWord)
+{
+  uint32_t Index;
+  SCATHashEntry* Entry;
+
+  Index = CATHash(MatchWord);
+  while(true)
+  {
+    Entry = GCATHashTable + Index;
+    if((Entry->Cmd == eNoCommand) || (Entry->MatchWord == MatchWord))
+      return Entry->Cmd;
+    Index = (Index + 1) & (VCATHASHSIZE - 1);
+  }
+}
+
+
 
 //
 // helper: constrain the size of a number
@@ -173,16 +236,27 @@ int constrain(int Value, int Lower, int Upper)
 void InitCATHandler()
 {
   int CmdCntr;
-  unsigned long MatchWord;
+  uint32_t MatchWord;
+  uint32_t Index;
 
-// initialise the matching 32 bit words to hold a version of each CAT command
+// build the hash table from the 32 bit version of each CAT command
+  for(Index=0; Index < VCATHASHSIZE; Index++)
+    GCATHashTable[Index].Cmd = eNoCommand;
   for(CmdCntr=0; CmdCntr < VNUMCATCMDS; CmdCntr++)
   {
     MatchWord = Make32BitStr(GCATCommands[CmdCntr].CATString);
-    GCATMatch[CmdCntr] = MatchWord;
+    Index = CATHash(MatchWord);
+    while(GCATHashTable[Index].Cmd != eNoCommand)
+      Index = (Index + 1) & (VCATHASHSIZE - 1);
+    GCATHashTable[Index].MatchWord = MatchWord;
+    GCATHashTable[Index].Cmd = (ECATCommands)CmdCntr;
   }
   CATPort = 0;                        // set port not assigned
   CATPortAssigned = false;
+  MPSCInitialise(&CATOutputRing, OutputSequence, VNUMOPSTRINGS);
+  CATWake_fd = eventfd(0, EFD_NONBLOCK);
+  if(CATWake_fd < 0)
+    perror("CAT eventfd");
 }
 
 
@@ -205,165 +279,249 @@ bool isNumeric(char ch)
 }
 
 
+//
+// helper: parse a signed decimal number from a parameter that is not null terminated
+// (same result as atoi() on the parameter string)
+//
+static long ParseCATNumber(const char* Param, int Length)
+{
+  long Result = 0;
+  bool Negative = false;
+  int Cntr = 0;
+
+  if(Param[0] == '-')
+  {
+    Negative = true;
+    Cntr++;
+  }
+  else if(Param[0] == '+')
+    Cntr++;
+  for(; (Cntr < Length) && isDigit(Param[Cntr]); Cntr++)
+    Result = Result * 10 + (Param[Cntr] - '0');
+  if(Negative)
+    Result = -Result;
+  return Result;
+}
+
+
 //
 // ParseCATCmd()
-// Parse a single command in the local input buffer
+// Parse a single command in place in an input buffer
+// Length = number of characters including the terminating semicolon (no null terminator needed)
 // process it if it is a valid command
 //
-void ParseCATCmd(char* Buffer,  int Source)
+void ParseCATCmd(const char* Buffer, int Length, int Source)
 {
-  int CharCnt;                              // number of characters in the buffer (same as length of string)
-  unsigned long MatchWord;                  // 32 bit compressed input cmd
-  ECATCommands MatchedCAT = eNoCommand;     // CAT command we've matched this to
-  int CmdCntr;                              // counts CAT commands
+  int CharCnt;                              // number of characters in the command, excluding the semicolon
+  ECATCommands MatchedCAT;                  // CAT command we've matched this to
   SCATCommands* StructPtr;                  // pointer to structure with CAT data
   ERXParamType ParsedType;                  // type of parameter actually found
-  int ByteCntr;
-  char ch;
-  bool ValidResult = true;                  // true if we get a valid parse result
-  bool ParsedBool;                            // if a bool expected, it goes here
-  long ParsedInt;                             // if int expected, it goes here
-  char ParsedString[20];                      // if string expected, it goes here
+  const char* Param;                        // parameter characters, in the input buffer
+  int ParamCnt;                             // number of parameter characters
+  bool ParsedBool = false;                    // if a bool expected, it goes here
+  long ParsedInt = 0;                         // if int expected, it goes here
+  char ParsedString[VCATMAXPARAMSIZE] = "";   // if string expected, it goes here
 
   void (*HandlerPtr)(int SourceDevice, ERXParamType HasParam, bool BoolParam, int NumParam, char* StringParam); 
   
-  CharCnt = strlen(Buffer) - 1;
+  CharCnt = Length - 1;
 //
-// CharCnt holds the input string length excluding the terminating null and excluding the semicolon
-// test minimum length for a valid CAT command: ZZxx; plus terminating 0
+// test minimum length for a valid CAT command: ZZxx;
 //
   if (CharCnt < 4)
-    ValidResult = false;
-  else
-  {
-    MatchWord = Make32BitStr(Buffer);
-    for (CmdCntr=0; CmdCntr < VNUMCATCMDS; CmdCntr++)         // loop thro commands we recognise
-    {
-      if (GCATMatch[CmdCntr] == MatchWord)
-      {
-        MatchedCAT = (ECATCommands)CmdCntr;                           // if a match, exit loop
-        StructPtr = GCATCommands + (int)CmdCntr;
-        break;
-      }
-    }
-    if(MatchedCAT == eNoCommand)                                      // if no match was found
-      ValidResult = false;
-    else
-    {
+    return;
+  MatchedCAT = LookupCATCommand(Make32BitStr(Buffer));
+  if(MatchedCAT == eNoCommand)                                        // if no match was found
+    return;
+  StructPtr = GCATCommands + (int)MatchedCAT;
 //
 // we have recognised a 4 char ZZnn command that is terminated by a semicolon
 // now we need to process the parameter bytes (if any) in the middle
 // the CAT structs have the required information
 // any parameter starts at position 4 and ends at (charcnt-1)
+// numeric parameters are parsed from the input buffer; only a string parameter is copied
 //
-      if (CharCnt == 4)
-        ParsedType=eNone;
-      else
-      {
-//
-// strategy is: first copy just the param to a string
-// if required type is not a string, parse to a number
-// then if required type is bool, check the value
-//        
-        ParsedType = eStr;
-        for(ByteCntr = 0; ByteCntr < (CharCnt-4); ByteCntr++)
-          ParsedString[ByteCntr] = Buffer[ByteCntr+4];
-        ParsedString[CharCnt - 4] = 0;
-// now see if we want a non string type
-// for an integer - use atoi, but see if 1st character is numeric, + or -
-        if (StructPtr->RXType != eStr)
-        {
-          ch=ParsedString[0];
-          if (isNumeric(ch))
-          {
-            ParsedType = eNum;
-            ParsedInt = atoi(ParsedString);
-// finally see if we need a bool
-            if (StructPtr->RXType == eBool)
-            {
-              ParsedType = eBool;
-              if (ParsedInt == 1)
-                ParsedBool = true;
-              else
-                ParsedBool = false;
-            }
-          }
-          else
-          {
-            ParsedType = eNone;
-            ValidResult = false;            
-          }
-        }
-      }
-    }
-  }
-  if (ValidResult == true)
+  Param = Buffer + 4;
+  ParamCnt = CharCnt - 4;
+  if (ParamCnt == 0)
+    ParsedType = eNone;
+  else if (StructPtr->RXType == eStr)
   {
-    // debug: print the match found
-//    printf("match= %s ; parameter=", GCATCommands[MatchedCAT].CATString);
-//    switch(ParsedType)
-//    {
-//      case eStr: 
-//        printf("%s\n", ParsedString);
-//        break;
-//      case eNum:
-//        ParsedInt = constrain(ParsedInt, StructPtr->MinParamValue, StructPtr->MaxParamValue);
-//        printf("%ld\n", ParsedInt);
-//        break;
-//      case eBool:
-//        if(ParsedBool == true)
-//          printf("true\n");
-//        else
-//          printf("false\n");
-//        break;
-//      case eNone:
-//        printf("\n");
-//        break;
-//    }
-    HandlerPtr = GCATCommands[MatchedCAT].handler;
-    if(HandlerPtr != NULL)
-      (*HandlerPtr)(Source, ParsedType, ParsedBool, ParsedInt, ParsedString);
+    ParsedType = eStr;
+    if(ParamCnt >= VCATMAXPARAMSIZE)                                  // truncate if too long
+      ParamCnt = VCATMAXPARAMSIZE - 1;
+    memcpy(ParsedString, Param, ParamCnt);
+    ParsedString[ParamCnt] = 0;
   }
-  else
+  else if (isNumeric(Param[0]))
   {
-//    Serial.print("Parse Error - cmd= ");
-//    Serial.println(GCATInputBuffer);
+    ParsedType = eNum;
+    ParsedInt = ParseCATNumber(Param, ParamCnt);
+// finally see if we need a bool
+    if (StructPtr->RXType == eBool)
+    {
+      ParsedType = eBool;
+      ParsedBool = (ParsedInt == 1);
+    }
   }
+  else
+    return;                                                           // parse error: not a number
+
+  HandlerPtr = StructPtr->handler;
+  if(HandlerPtr != NULL)
+    (*HandlerPtr)(Source, ParsedType, ParsedBool, ParsedInt, ParsedString);
 }
 
+
 //
-// get CAT o/p buffer Used
+// ParseCATBuffer()
+// parse all the complete (semicolon terminated) commands in an input buffer, in place
+// returns the number of characters used; any remaining characters are the start of a
+// command not yet complete, which the caller keeps for the next read.
 //
-int GetCATOPBufferUsed(void)
+int ParseCATBuffer(const char* Buffer, int Length, int Source)
 {
-  int Used;                           // number of occupied locations
-  Used = CATWritePtr - CATReadPtr;
-  if(Used < 0)
-    Used += VNUMOPSTRINGS;
-  return Used;
+  const char* Start = Buffer;
+  const char* End = Buffer + Length;
+  const char* Semicolon;
+
+  while((Start < End) && ((Semicolon = memchr(Start, ';', End - Start)) != NULL))
+  {
+    ParseCATCmd(Start, (int)(Semicolon - Start) + 1, Source);
+    Start = Semicolon + 1;
+  }
+  return (int)(Start - Buffer);
 }
 
 
 //
 // send a CAT command
 // only attempt send if an active CAT port exists
+// may be called from any thread
 //
 void SendCATMessage(char* Msg)
 {
-  if(SDRActive == true)
+  SendCATMessageLength(Msg, (int)strnlen(Msg, VOPSTRSIZE));
+}
+
+
+//
+// send a CAT message of Length characters (it need not be null terminated)
+// may be called from any thread
+//
+void SendCATMessageLength(const char* Msg, int Length)
+{
+  struct CATOutputMessage* Entry;
+  int32_t Slot;
+
+  if(Length > VOPSTRSIZE)
+    Length = VOPSTRSIZE;
+
+  if(__atomic_load_n(&SDRActive, __ATOMIC_ACQUIRE) && (CATPortAssigned == true))
   {
-    if((GetCATOPBufferUsed() <= (VNUMOPSTRINGS - 1))&&(CATPortAssigned == true))
+    Slot = MPSCClaimWriteSlot(&CATOutputRing);
+    if(Slot < 0)
     {
-      strcpy(OutputStrings[CATWritePtr++], Msg);
-      if(CATWritePtr >= VNUMOPSTRINGS)
-        CATWritePtr = 0;
+      atomic_fetch_add(&CATMessagesDropped, 1);
       if (CATDebugPrint)
-        printf("Sent CAT msg %s\n", Msg);                       // debug
+        printf("CAT output queue full: msg %.*s dropped\n", Length, Msg);
+      return;
     }
+    Entry = &OutputMessages[Slot];
+    Entry->Length = (uint16_t)Length;
+    memcpy(Entry->Text, Msg, Length);
+    MPSCPublish(&CATOutputRing, Slot);
+    WakeCATHandler();
+    if (CATDebugPrint)
+      printf("Sent CAT msg %.*s\n", Length, Msg);             // debug
   }
 }
 
 
+//
+// wake the CAT thread, to send queued messages or to see a state change
+// may be called from any thread
+//
+void WakeCATHandler(void)
+{
+  uint64_t Value = 1;
+
+  if(CATWake_fd >= 0)
+    if(write(CATWake_fd, &Value, sizeof(Value)) < 0)
+      if(errno != EAGAIN)
+        perror("CAT wake write");
+}
+
+
+//
+// send the queued CAT messages to the non-blocking TCP socket, up to VCATMAXBATCH per writev() call
+// (Thetis splits the stream at the ";" terminators, so messages can share a TCP segment)
+// if the socket is full, Blocked is set and the rest are sent when it is writeable again;
+// CATHeadSent remembers how much of the oldest message has already gone.
+// returns false if the send failed
+//
+static bool SendQueuedCATMessages(int Socketid, bool* Blocked)
+{
+  struct iovec Vectors[VCATMAXBATCH];
+  uint32_t Count, Released;
+  int32_t Slot;
+  ssize_t Sent;
+
+  *Blocked = false;
+  while(true)
+  {
+    for(Count = 0; Count < VCATMAXBATCH; Count++)
+    {
+      Slot = MPSCGetReadSlot(&CATOutputRing, Count);
+      if(Slot < 0)
+        break;
+      Vectors[Count].iov_base = OutputMessages[Slot].Text;
+      Vectors[Count].iov_len = OutputMessages[Slot].Length;
+    }
+    if(Count == 0)
+      return true;
+    Vectors[0].iov_base = (char*)Vectors[0].iov_base + CATHeadSent;
+    Vectors[0].iov_len -= CATHeadSent;
+
+    Sent = writev(Socketid, Vectors, (int)Count);
+    if(Sent < 0)
+    {
+      if(errno == EINTR)
+        continue;
+      if((errno == EAGAIN) || (errno == EWOULDBLOCK))
+      {
+        *Blocked = true;
+        return true;
+      }
+      return false;
+    }
+    //
+    // release the messages sent completely; a stream socket might take only part of one
+    //
+    for(Released = 0; (Released < Count) && ((size_t)Sent >= Vectors[Released].iov_len); Released++)
+      Sent -= Vectors[Released].iov_len;
+    if(Released != 0)
+    {
+      MPSCRelease(&CATOutputRing, Released);
+      CATHeadSent = 0;
+    }
+    if(Released < Count)
+      CATHeadSent += (uint32_t)Sent;
+  }
+}
+
+
+//
+// discard any queued CAT messages (when the connection has closed)
+//
+static void DiscardQueuedCATMessages(void)
+{
+  while(MPSCGetReadSlot(&CATOutputRing, 0) >= 0)
+    MPSCRelease(&CATOutputRing, 1);
+  CATHeadSent = 0;
+}
+
+
 
 //
 // helper to append a string with a character
@@ -530,37 +688,209 @@ void MakeCATMessageString(int Device, ECATCommands Cmd, char* Param)
 
 
 
-// this runs as its own thread to create activity at least every 15s
-// otherwise Thetis drops connection after 30s
 //
-void* CATKeepaliveThreadFunction(__attribute__((unused)) void *arg)
-{ 
-    int Cntr = 0;
+// CAT link state, owned by the CAT thread
+//
+typedef enum
+{
+  eCATWaiting,                              // not connected: waiting for SDR active, or to retry
+  eCATConnecting,                           // non-blocking connect in progress
+  eCATConnected                             // connected
+} ECATLinkState;
+
+#define VCATEVENTWAKE 0                     // epoll event identifiers
+#define VCATEVENTSOCKET 1
+#define VCATEVENTKEEPALIVE 2
+#define VCATEVENTRETRY 3
+
+static ECATLinkState CATLinkState;
+static int CATSocketid = -1;                        // socket to access internet
+static int CATEpoll_fd = -1;
+static int CATKeepalive_fd = -1;                    // timerfd: periodic keepalive while connected
+static int CATRetry_fd = -1;                        // timerfd: reconnect backoff, or connect timeout
+static uint32_t CATBackoff;                         // next reconnect delay, ms
+static uint32_t CATSocketEvents;                    // epoll events currently requested for the socket
+
+
+//
+// helper: start a timerfd; Millisec = 0 stops it
+//
+static void ArmCATTimer(int Timer_fd, uint32_t Millisec, bool Periodic)
+{
+  struct itimerspec Time;
+
+  memset(&Time, 0, sizeof(Time));
+  Time.it_value.tv_sec = Millisec / 1000;
+  Time.it_value.tv_nsec = (Millisec % 1000) * 1000000L;
+  if(Periodic)
+    Time.it_interval = Time.it_value;
+  timerfd_settime(Timer_fd, 0, &Time, NULL);
+}
 
-    printf("spinning up CAT keepalive thread, pid=%ld\n", syscall(SYS_gettid));
 
 //
-// wait up to 10s for SDR active to become set
-// (there seems to be a race condition between general packet to SDR and high priority data packet
-// and we can get here without it set)
+// helper: read and discard an eventfd or timerfd count
 //
-    while((Cntr++ < 10 && !SDRActive))
-        sleep(1);
+static void ClearCATEvent(int Event_fd)
+{
+  uint64_t Count;
+
+  if(read(Event_fd, &Count, sizeof(Count)) < 0)
+    if(errno != EAGAIN)
+      perror("CAT event read");
+}
 
-    Cntr = 0;
-    CATKeepaliveActive = true;
-    while(SDRActive && !SignalThreadEnd)
+
+//
+// helper: set the epoll events wanted for the socket
+//
+static void SetCATSocketEvents(uint32_t Events)
+{
+  struct epoll_event Event;
+
+  if(Events != CATSocketEvents)
+  {
+    Event.events = Events;
+    Event.data.u32 = VCATEVENTSOCKET;
+    epoll_ctl(CATEpoll_fd, EPOLL_CTL_MOD, CATSocketid, &Event);
+    CATSocketEvents = Events;
+  }
+}
+
+
+//
+// close the CAT socket, and schedule a reconnect attempt after the backoff delay
+// the delay doubles after each failure, up to VCATMAXBACKOFF
+//
+static void CATLinkFailed(const char* Reason)
+{
+  if(CATSocketid >= 0)
+  {
+    close(CATSocketid);                             // (this also removes it from the epoll set)
+    CATSocketid = -1;
+  }
+  CATPortAssigned = false;
+  DiscardQueuedCATMessages();
+  ArmCATTimer(CATKeepalive_fd, 0, false);
+  CATLinkState = eCATWaiting;
+  printf("CAT %s; reconnecting in %ds\n", Reason, CATBackoff / 1000);
+  ArmCATTimer(CATRetry_fd, CATBackoff, false);
+  CATBackoff *= 2;
+  if(CATBackoff > VCATMAXBACKOFF)
+    CATBackoff = VCATMAXBACKOFF;
+}
+
+
+//
+// the connect has completed
+//
+static void CATLinkConnected(void)
+{
+  CATLinkState = eCATConnected;
+  CATBackoff = VCATMINBACKOFF;
+  ArmCATTimer(CATRetry_fd, 0, false);
+  ArmCATTimer(CATKeepalive_fd, VCATKEEPALIVE, true);
+  SetCATSocketEvents(EPOLLIN);
+  CATPortAssigned = true;
+  printf("connected to CAT\n");
+}
+
+
+//
+// create a non-blocking socket and start to connect it to the client's CAT port
+// the result is seen as an EPOLLOUT event, or as the connect timeout
+//
+static void StartCATConnect(int Port)
+{
+  struct sockaddr_in addr_cat;
+  struct epoll_event Event;
+  int yes = 1;
+
+  printf("Connecting CAT socket to port %d\n", Port);
+  CATSocketid = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if(CATSocketid < 0)
+  {
+    perror("CAT socket fail");
+    CATLinkFailed("socket fail");
+    return;
+  }
+  setsockopt(CATSocketid, SOL_SOCKET, SO_REUSEADDR, (void *)&yes , sizeof(yes));
+  addr_cat.sin_addr.s_addr = reply_addr.sin_addr.s_addr;
+  addr_cat.sin_family = AF_INET;
+  addr_cat.sin_port = htons(Port);
+
+  Event.events = EPOLLOUT;
+  Event.data.u32 = VCATEVENTSOCKET;
+  epoll_ctl(CATEpoll_fd, EPOLL_CTL_ADD, CATSocketid, &Event);
+  CATSocketEvents = EPOLLOUT;
+  if(connect(CATSocketid, (struct sockaddr *)&addr_cat, sizeof(struct sockaddr_in)) == 0)
+    CATLinkConnected();
+  else if(errno == EINPROGRESS)
+  {
+    CATLinkState = eCATConnecting;
+    ArmCATTimer(CATRetry_fd, VCATCONNECTTIMEOUT, false);
+  }
+  else
+  {
+    perror("CAT connect");
+    CATLinkFailed("connect failed");
+  }
+}
+
+
+//
+// a socket event while connecting: see if the connect succeeded
+//
+static void CompleteCATConnect(void)
+{
+  int Error = 0;
+  socklen_t Length = sizeof(Error);
+
+  if((getsockopt(CATSocketid, SOL_SOCKET, SO_ERROR, &Error, &Length) < 0) || (Error != 0))
+  {
+    printf("CAT connect: %s\n", strerror(Error));
+    CATLinkFailed("connect failed");
+  }
+  else
+    CATLinkConnected();
+}
+
+
+//
+// read all the data waiting on the socket and parse the commands in it
+// commands are parsed in place from the read buffer. A command split across
+// reads is moved to the start of the buffer to be completed by the next read.
+// if the buffer fills with no semicolon, it is discarded.
+// returns false if the connection has closed
+//
+static bool ReadCATSocket(char* ReadBuffer, int BufferSize, int* ReadCount)
+{
+  int ReadResult;
+  int Used;
+
+  while(true)
+  {
+    if(*ReadCount == BufferSize)
+      *ReadCount = 0;
+    ReadResult = recv(CATSocketid, ReadBuffer + *ReadCount, BufferSize - *ReadCount, 0);
+    if(ReadResult > 0)
     {
-        if(Cntr++ == 1500)
-        {
-            MakeCATMessageNoParam(DESTTCPCATPORT, eZZXV);
-            Cntr = 0;
-        }
-        usleep(10000);                                                  // 10ms * 1500 = 15 sec delay between keepalives
+      *ReadCount += ReadResult;
+      Used = ParseCATBuffer(ReadBuffer, *ReadCount, DESTTCPCATPORT);
+      *ReadCount -= Used;
+      if((*ReadCount != 0) && (Used != 0))
+        memmove(ReadBuffer, ReadBuffer + Used, *ReadCount);
     }
-    printf("closing CAT keepalive thread\n");
-    CATKeepaliveActive = false;
-    return NULL;
+    else if(ReadResult == 0)
+      return false;                                 // server closed connection
+    else if((errno == EAGAIN) || (errno == EWOULDBLOCK))
+      return true;
+    else if(errno != EINTR)
+    {
+      perror("CAT read");
+      return false;
+    }
+  }
 }
 
 
@@ -569,124 +899,147 @@ void* CATKeepaliveThreadFunction(__attribute__((unused)) void *arg)
 // thread initiated after a port number received
 // will be instructed to stop & exit by SDRActive becoming false
 // (connection to SDR client list so no port to make use of)
-// this is called when a connection port available; create socket on entry.
+//
+// the socket is non-blocking, and the thread sleeps in epoll_wait() until there is
+// something to do: data from the client, a queued message to send, the keepalive
+// timer or the reconnect timer. If the connection fails or the server drops it,
+// it reconnects with exponential backoff, for as long as the SDR stays active.
 //
 void* CATHandlerThread(__attribute__((unused)) void *arg)
 {
-    bool ThreadError = false;
-    int CATSocketid;                                 // socket to access internet
-    struct sockaddr_in addr_cat;
+    struct epoll_event Events[4];
+    struct epoll_event Event;
     int ActiveCATPort;
-    int ReadResult;
-    int Cntr = 0;
-    char ReadBuffer[1024] = {0};
-    char SendBuffer[1024] = {0};
-    unsigned int TXMessageLength;
-    int SendError = 0;
-
-//    bool DebugMessageSent = false;
-
-//
-// wait up to 10s for SDR active to become set
-// (there seems to be a race condition between general packet to SDR and high priority data packet
-// and we can get here without it set)
-//
-    while((Cntr++ < 10 && !SDRActive))
-      sleep(1);
+    char ReadBuffer[1024];
+    int ReadCount = 0;                               // characters held in ReadBuffer
+    int StartWaits = 0;
+    bool SeenActive = false;                         // true once SDR active has been seen
+    bool Blocked;
+    bool Done = false;
+    int Ready;
+    int Cntr;
+
+    ActiveCATPort = CATPort;
+    printf("Creating CAT handler for port %d, pid=%ld\n", ActiveCATPort, syscall(SYS_gettid));
+    CATEpoll_fd = epoll_create1(0);
+    CATKeepalive_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    CATRetry_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    if((CATEpoll_fd < 0) || (CATKeepalive_fd < 0) || (CATRetry_fd < 0) || (CATWake_fd < 0))
+    {
+      perror("CAT epoll setup");
+      Done = true;
+    }
+    else
+    {
+      Event.events = EPOLLIN;
+      Event.data.u32 = VCATEVENTWAKE;
+      epoll_ctl(CATEpoll_fd, EPOLL_CTL_ADD, CATWake_fd, &Event);
+      Event.data.u32 = VCATEVENTKEEPALIVE;
+      epoll_ctl(CATEpoll_fd, EPOLL_CTL_ADD, CATKeepalive_fd, &Event);
+      Event.data.u32 = VCATEVENTRETRY;
+      epoll_ctl(CATEpoll_fd, EPOLL_CTL_ADD, CATRetry_fd, &Event);
+    }
+    CATBackoff = VCATMINBACKOFF;
+    CATLinkState = eCATWaiting;
+    ArmCATTimer(CATRetry_fd, 1, false);              // first connect attempt straight away
 
     //
-    // loop, creating then using socket
-    // written this way so that if the port changes, we can exit the processing loop & re-connect
+    // now loop; process read, write and timer events
+    // exit loop if port number changes
     //
-    while(!ThreadError && SDRActive && !SignalThreadEnd)
+    while(!Done && !SignalThreadEnd && (ActiveCATPort == CATPort))    // thread main loop
     {
-      //
-      // create socket for TCP/IP connection
-      //
-      printf("Creating CAT socket on port %d, pid=%ld\n", CATPort, syscall(SYS_gettid));
-      struct timeval ReadTimeout;                                       // read timeout
-      int yes = 1;
-      if((CATSocketid = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+      Ready = epoll_wait(CATEpoll_fd, Events, 4, -1);
+      if(Ready < 0)
       {
-          perror("CAT socket fail");
-          return NULL;
-          CATPort = 0;
+        if(errno == EINTR)
+          continue;
+        perror("CAT epoll_wait");
+        break;
       }
-
-    //
-    // set 1ms timeout, and re-use any recently open ports
-    //
-      setsockopt(CATSocketid, SOL_SOCKET, SO_REUSEADDR, (void *)&yes , sizeof(yes));
-      ReadTimeout.tv_sec = 0;
-      ReadTimeout.tv_usec = 1000;
-      setsockopt(CATSocketid, SOL_SOCKET, SO_RCVTIMEO, (void *)&ReadTimeout , sizeof(ReadTimeout));
-
-    //
-    // connect to destination port
-    //
-      addr_cat.sin_addr.s_addr = reply_addr.sin_addr.s_addr;
-      addr_cat.sin_family = AF_INET;
-      addr_cat.sin_port = htons(CATPort);
-      ActiveCATPort = CATPort;
-      printf("Connecting CAT socket to port %d\n", CATPort);
-
-      if(connect(CATSocketid, (struct sockaddr *)&addr_cat, sizeof(struct sockaddr_in)) < 0)
+      for(Cntr = 0; Cntr < Ready; Cntr++)
       {
-          perror("CAT connect");
-          ActiveCATPort = 0;
-          return NULL;
+        switch(Events[Cntr].data.u32)
+        {
+          case VCATEVENTWAKE:
+            ClearCATEvent(CATWake_fd);
+            break;
+
+          case VCATEVENTKEEPALIVE:
+            ClearCATEvent(CATKeepalive_fd);
+            if(CATLinkState == eCATConnected)
+              MakeCATMessageNoParam(DESTTCPCATPORT, eZZXV);
+            break;
+
+          case VCATEVENTRETRY:
+            ClearCATEvent(CATRetry_fd);
+            if(CATLinkState == eCATConnecting)
+              CATLinkFailed("connect timed out");
+            else if(__atomic_load_n(&SDRActive, __ATOMIC_ACQUIRE) && (CATLinkState == eCATWaiting))
+              StartCATConnect(ActiveCATPort);
+            //
+            // wait up to 10s for SDR active to become set at thread start
+            // (there seems to be a race condition between general packet to SDR and high priority data packet
+            // and we can get here without it set)
+            //
+            else if(!SeenActive && (StartWaits++ < VCATSTARTWAITS))
+              ArmCATTimer(CATRetry_fd, 1000, false);
+            else
+              Done = true;
+            break;
+
+          case VCATEVENTSOCKET:
+            if(CATLinkState == eCATConnecting)
+              CompleteCATConnect();
+            else if(CATLinkState == eCATConnected)
+            {
+              if((Events[Cntr].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) &&
+                 !ReadCATSocket(ReadBuffer, sizeof(ReadBuffer), &ReadCount))
+              {
+                ReadCount = 0;
+                CATLinkFailed("server dropped connection");
+              }
+            }
+            break;
+        }
       }
-      ThreadActive = true;
-      CATPortAssigned = true;
-
-      printf("connected to CAT\n");
-
-
+      if(__atomic_load_n(&SDRActive, __ATOMIC_ACQUIRE))
+        SeenActive = true;
+      else if(SeenActive)
+        Done = true;                                // SDR no longer active: close the link
       //
-      // now loop; process read, write events
-      // exit loop if port number changes
+      // if there are CAT messages available, send them
+      // if the socket is full, ask for EPOLLOUT to send the rest later
       //
-      while(!ThreadError && SDRActive && !SignalThreadEnd && (ActiveCATPort == CATPort))    // thread main loop
+      if(!Done && (CATLinkState == eCATConnected))
       {
-  //        ReadResult = read(CATSocketid, ReadBuffer, 1023);
-          ReadResult = recv(CATSocketid, ReadBuffer, 1023, 0);
-          if(ReadResult > 0)
-          {
-              ParseCATCmd(ReadBuffer, DESTTCPCATPORT);
-              memset(ReadBuffer, 0, sizeof(ReadBuffer));
-          }
-          else if((ReadResult == -1) && (errno == 104))            // error 104 happens if server drops connection
-          {
-            printf("CAT server dropped connection\n");
-            ThreadError = true;
-          }
-
-          //
-          // if there are CAT messages available, send them
-          //
-          while((GetCATOPBufferUsed() != 0) && !SignalThreadEnd && !ThreadError)
-          {
-            TXMessageLength = strlen(OutputStrings[CATReadPtr]);
-            strcpy(SendBuffer, OutputStrings[CATReadPtr++]);
-            if(CATReadPtr >= VNUMOPSTRINGS)
-              CATReadPtr = 0;
-            SendError = send(CATSocketid, SendBuffer, TXMessageLength, 0);
-            if(SendError == -1)
-            {
-              perror("CAT send Error");
-              ThreadError = true; 
-              break;
-            }
-          }
-      }                                                       // end of thread main loop
+        if(!SendQueuedCATMessages(CATSocketid, &Blocked))
+        {
+          perror("CAT send Error");
+          ReadCount = 0;
+          CATLinkFailed("send failed");
+        }
+        else
+          SetCATSocketEvents(Blocked ? (EPOLLIN | EPOLLOUT) : EPOLLIN);
+      }
+    }                                                       // end of thread main loop
+    printf("Closing CAT Port & terminating thread\n");
+    CATPortAssigned = false;
+    if(CATSocketid >= 0)
       close(CATSocketid);
-      printf("Closing CAT Port & terminating thread\n");
-      ActiveCATPort = 0;
-      CATPort = 0;                                            // set port not assigned
-      CATPortAssigned = false;
-    }
+    CATSocketid = -1;
+    if(CATEpoll_fd >= 0)
+      close(CATEpoll_fd);
+    if(CATKeepalive_fd >= 0)
+      close(CATKeepalive_fd);
+    if(CATRetry_fd >= 0)
+      close(CATRetry_fd);
+    CATEpoll_fd = CATKeepalive_fd = CATRetry_fd = -1;
+    CATPort = 0;                                            // set port not assigned
+    DiscardQueuedCATMessages();
+    if(atomic_load(&CATMessagesDropped) != 0)
+      printf("CAT messages dropped (output queue full) = %u\n", atomic_exchange(&CATMessagesDropped, 0));
     ThreadActive = false;
-    ThreadError = false;
     return NULL;
 }
 
@@ -710,26 +1063,13 @@ void SetupCATPort(int Port)
         CATPort = Port;
         printf("CATPort initialised to %d\n", Port);
         SignalThreadEnd = false;
-        ThreadActive = false;
-
-        if((!ThreadActive) && (CATPort != 0))
+        ThreadActive = true;                        // (set here so a shutdown straight away waits for it)
+        if(!CreateManagedThread(&CATThread, "CAT", eHousekeepingThread, CATHandlerThread, NULL))
         {
-          if(pthread_create(&CATThread, NULL, CATHandlerThread, NULL) < 0)
-          {
-              perror("pthread_create CAT handler");
-              CATPort = 0;
-              return;
-          }
-          pthread_detach(CATThread);
-          
-          // and create the keepalive
-          if(pthread_create(&CATKeepaliveThread, NULL, CATKeepaliveThreadFunction, NULL) < 0)
-          {
-              perror("pthread_create CAT keepalive");
-              CATPort = 0;
-              return;
-          }
-          pthread_detach(CATKeepaliveThread);
+            perror("pthread_create CAT handler");
+            ThreadActive = false;
+            CATPort = 0;
+            return;
         }
     }  
 }
@@ -737,13 +1077,14 @@ void SetupCATPort(int Port)
 
 //
 // function to shut down CAT handler
-// only returns when shutdown of CAT handler and the keepalive is complete
+// only returns when shutdown of CAT handler is complete
 // signal thread to shut down, then wait
 //
 void ShutdownCATHandler(void)
 {
     SignalThreadEnd = true;
-    while(ThreadActive || CATKeepaliveActive)
+    WakeCATHandler();
+    while(ThreadActive)
         usleep(1000);
     SignalThreadEnd = false;
 }
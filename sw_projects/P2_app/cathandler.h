@@ -98,11 +98,30 @@ void ShutdownCATHandler(void);
 //
 void SendCATMessage(char* CatString);
 
+//
+// send a CAT message of Length characters to TCP/IP port (no null terminator needed)
+//
+void SendCATMessageLength(const char* Msg, int Length);
+
+//
+// wake the CAT thread (eg when the SDR active state changes)
+// may be called from any thread
+//
+void WakeCATHandler(void);
+
 //
 // parse a CAT command, and call appropriate handler
+// the command is parsed in place: Length = characters including the semicolon
 // message source provided so potentially different handlers can be used
 //
-void ParseCATCmd(char* CATString, int Source);
+void ParseCATCmd(const char* Buffer, int Length, int Source);
+
+
+//
+// parse all the complete CAT commands in a buffer, in place, calling the handlers
+// returns the number of characters used (the rest are an incomplete command)
+//
+int ParseCATBuffer(const char* Buffer, int Length, int Source);
 
 
 #endif  //#ifndef
\ No newline at end of file
@@ -0,0 +1,212 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// licenced under GNU GPL3
+//
+// configfile.c:
+//
+// INI style configuration file for the p2app performance settings
+//
+//////////////////////////////////////////////////////////////
+
+#include "configfile.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <limits.h>
+#include <unistd.h>
+
+
+static char ConfigPath[PATH_MAX];
+
+
+//
+// find the config file
+//
+const char* FindConfigFile(const char* Filename)
+{
+    char* Slash;
+    ssize_t Length;
+
+    if(Filename != NULL)
+        return Filename;
+    snprintf(ConfigPath, sizeof(ConfigPath), "/etc/%s", VCONFIGFILENAME);
+    if(access(ConfigPath, R_OK) == 0)
+        return ConfigPath;
+    //
+    // the directory holding the executable
+    //
+    Length = readlink("/proc/self/exe", ConfigPath, sizeof(ConfigPath) - 1);
+    if(Length <= 0)
+        return NULL;
+    ConfigPath[Length] = 0;
+    Slash = strrchr(ConfigPath, '/');
+    if((Slash == NULL) || ((size_t)(Slash + 1 - ConfigPath) + sizeof(VCONFIGFILENAME) > sizeof(ConfigPath)))
+        return NULL;
+    strcpy(Slash + 1, VCONFIGFILENAME);
+    if(access(ConfigPath, R_OK) == 0)
+        return ConfigPath;
+    return NULL;
+}
+
+
+//
+// remove leading and trailing white space, in place
+//
+static char* TrimConfigText(char* Text)
+{
+    char* End;
+
+    while(isspace((unsigned char)*Text))
+        Text++;
+    End = Text + strlen(Text);
+    while((End > Text) && isspace((unsigned char)End[-1]))
+        *--End = 0;
+    return Text;
+}
+
+
+//
+// parse a bool value. Returns false if not valid
+//
+static bool ParseConfigBool(const char* Text, bool* Value)
+{
+    if(!strcasecmp(Text, "true") || !strcasecmp(Text, "yes") || !strcasecmp(Text, "on") || !strcmp(Text, "1"))
+        *Value = true;
+    else if(!strcasecmp(Text, "false") || !strcasecmp(Text, "no") || !strcasecmp(Text, "off") || !strcmp(Text, "0"))
+        *Value = false;
+    else
+        return false;
+    return true;
+}
+
+
+//
+// apply one setting. Returns false if the value is not valid
+//
+static bool ApplyConfigSetting(const struct ConfigSetting* Setting, const char* Text, bool Reload)
+{
+    bool BoolValue;
+    char* End;
+    unsigned long Number;
+    uint32_t UintValue;
+    char** StringValue;
+
+    switch(Setting->Type)
+    {
+        case eConfigBool:
+            if(!ParseConfigBool(Text, &BoolValue))
+                return false;
+            if(Reload && (*(bool*)Setting->Value != BoolValue))
+                printf("config: %s.%s changed to %s\n", Setting->Section, Setting->Key, BoolValue ? "true" : "false");
+            *(bool*)Setting->Value = BoolValue;
+            break;
+
+        case eConfigUint:
+            Number = strtoul(Text, &End, 0);
+            if((End == Text) || (*End != 0) || (Number > UINT32_MAX))
+                return false;
+            UintValue = (uint32_t)Number;
+            if(UintValue < Setting->Min)
+                UintValue = Setting->Min;
+            if((Setting->Max != 0) && (UintValue > Setting->Max))
+                UintValue = Setting->Max;
+            if(Reload && (*(uint32_t*)Setting->Value != UintValue))
+                printf("config: %s.%s changed to %u\n", Setting->Section, Setting->Key, UintValue);
+            *(uint32_t*)Setting->Value = UintValue;
+            break;
+
+        case eConfigString:
+            StringValue = (char**)Setting->Value;
+            if(Reload && (*StringValue != NULL) && !strcmp(*StringValue, Text))
+                break;
+            *StringValue = strdup(Text);                // previous value may be argv: not freed
+            if(Reload)
+                printf("config: %s.%s changed to %s\n", Setting->Section, Setting->Key, Text);
+            break;
+
+        case eConfigHandler:
+            return Setting->Handler(Text);
+    }
+    return true;
+}
+
+
+//
+// read a config file and apply its settings
+//
+bool LoadConfigFile(const char* Filename, const struct ConfigSetting* Settings, uint32_t Count, bool Reload)
+{
+    FILE* File;
+    char Line[VCONFIGMAXLINE];
+    char Section[32] = "";
+    char* Text;
+    char* Value;
+    char* End;
+    uint32_t LineNumber = 0;
+    uint32_t Cntr;
+
+    File = fopen(Filename, "r");
+    if(File == NULL)
+    {
+        perror(Filename);
+        return false;
+    }
+    printf("%s config file %s\n", Reload ? "reloading" : "reading", Filename);
+    while(fgets(Line, sizeof(Line), File) != NULL)
+    {
+        LineNumber++;
+        End = strpbrk(Line, "#;");
+        if(End != NULL)
+            *End = 0;                                   // strip comment
+        Text = TrimConfigText(Line);
+        if(*Text == 0)
+            continue;
+        //
+        // section header
+        //
+        if(*Text == '[')
+        {
+            End = strchr(Text, ']');
+            if(End == NULL)
+            {
+                printf("config line %d: bad section header\n", LineNumber);
+                continue;
+            }
+            *End = 0;
+            strncpy(Section, TrimConfigText(Text + 1), sizeof(Section) - 1);
+            continue;
+        }
+        //
+        // key = value
+        //
+        Value = strchr(Text, '=');
+        if(Value == NULL)
+        {
+            printf("config line %d: expected key = value\n", LineNumber);
+            continue;
+        }
+        *Value++ = 0;
+        Text = TrimConfigText(Text);
+        Value = TrimConfigText(Value);
+        for(Cntr = 0; Cntr < Count; Cntr++)
+            if(!strcmp(Settings[Cntr].Section, Section) && !strcmp(Settings[Cntr].Key, Text))
+                break;
+        if(Cntr == Count)
+        {
+            printf("config line %d: unknown setting %s.%s\n", LineNumber, Section, Text);
+            continue;
+        }
+        if(Reload && !Settings[Cntr].Reloadable)
+            continue;                                   // needs a restart to change
+        if(!ApplyConfigSetting(&Settings[Cntr], Value, Reload))
+            printf("config line %d: bad value \"%s\" for %s.%s\n", LineNumber, Value, Section, Text);
+    }
+    fclose(File);
+    return true;
+}
@@ -0,0 +1,72 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// licenced under GNU GPL3
+//
+// configfile.h:
+//
+// header: INI style configuration file for the p2app performance settings
+//
+// the file has [section] headers and "key = value" lines; # or ; starts a comment.
+// each setting is described by a table entry, which points to the variable it sets.
+// settings marked reloadable are applied again when p2app receives SIGHUP;
+// the others are only read at startup.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __configfile_h
+#define __configfile_h
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#define VCONFIGFILENAME "p2app.conf"            // looked for in /etc, then the p2app directory
+#define VCONFIGMAXLINE 256                      // longest line in the file
+
+
+typedef enum
+{
+    eConfigBool,                                // bool: true/false, yes/no, on/off or 1/0
+    eConfigUint,                                // uint32_t, limited to Min..Max (Max = 0: no upper limit)
+    eConfigString,                              // char*: the string is copied
+    eConfigHandler                              // Handler is called with the value text
+} EConfigType;
+
+
+//
+// one setting in the file
+//
+struct ConfigSetting
+{
+    const char* Section;
+    const char* Key;
+    EConfigType Type;
+    void* Value;                                // variable to set (not used for eConfigHandler)
+    uint32_t Min;
+    uint32_t Max;
+    bool Reloadable;                            // true if it can be changed while running
+    bool (*Handler)(const char* Value);         // for eConfigHandler; returns false if value not valid
+};
+
+
+//
+// find the config file: Filename if not NULL, else /etc/p2app.conf, else p2app.conf
+// beside the executable. Returns NULL if there isn't one.
+//
+const char* FindConfigFile(const char* Filename);
+
+
+//
+// read a config file and apply its settings. Settings is an array of Count entries.
+// if Reload is true, only the reloadable settings are applied, and changes are reported.
+// returns false if the file can't be read
+//
+bool LoadConfigFile(const char* Filename, const struct ConfigSetting* Settings, uint32_t Count, bool Reload);
+
+
+#endif
@@ -0,0 +1,313 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// ddcretransmit.c:
+//
+// selective retransmission of DDC I/Q packets: a ring of the last packets sent
+// for each DDC, and the handler for NACKs from the client
+//
+//////////////////////////////////////////////////////////////
+
+#include "threaddata.h"
+#include <stdint.h>
+#include "../common/saturntypes.h"
+#include "ddcretransmit.h"
+#include "OutDDCIQ.h"
+#include "InboundDispatcher.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "../common/saturnregisters.h"
+
+
+//
+// one packet kept for resending
+//
+struct RetransmitSlot
+{
+    uint32_t Sequence;                          // protocol 2 sequence number
+    uint32_t Length;                            // bytes; 0 = empty
+    uint64_t SentTime;                          // ns, CLOCK_MONOTONIC
+    uint8_t Data[VDDCPACKETSIZE];
+};
+
+
+//
+// the ring for one DDC. Written by its sender, read by the NACK handler:
+// the mutex is taken once per batch, so it is only ever contended by a NACK
+//
+struct RetransmitRing
+{
+    pthread_mutex_t Mutex;
+    bool Enabled;                               // this session's packets are kept; read unlocked by the sender
+    int Socketid;                               // the DDC's socket: resends come from its port
+    struct sockaddr_in Dest;                    // client address
+    struct RetransmitSlot* Slots;               // RetransmitPackets slots
+};
+
+
+static uint32_t RetransmitPackets = 0;          // ring size per DDC; 0 = not enabled
+static bool RetransmitStarted = false;          // rings allocated and NACK port open
+static uint32_t RetransmitWindow = VRETXDEFAULTWINDOW;
+static struct RetransmitRing RetransmitRings[VNUMDDC];
+static struct ThreadSocketData RetransmitPort;  // NACK port, served by the inbound dispatcher
+
+//
+// statistics for the session
+//
+static uint64_t GDDCNacks = 0;                  // NACKs accepted
+static uint64_t GDDCRetransmitted = 0;          // packets resent
+static uint64_t GDDCRetransmitMissed = 0;       // asked for, but overwritten or too old to be useful
+static uint64_t GDDCNacksRejected = 0;          // badly formed, or not from the client
+
+
+static uint64_t GetMonotonicNs(void)
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (uint64_t)Now.tv_sec * 1000000000ULL + Now.tv_nsec;
+}
+
+
+//
+// enable retransmission, from a command line string
+// format: <packets>[:<window ms>[:<NACK port>]]
+// returns true if successful
+//
+bool SetDDCRetransmit(const char* Spec)
+{
+    uint32_t Packets, Window = VRETXDEFAULTWINDOW, Port = VRETXDEFAULTPORT;
+    int Fields;
+
+    Fields = sscanf(Spec, "%u:%u:%u", &Packets, &Window, &Port);
+    if((Fields < 1) || (Packets < VRETXMINPACKETS) || (Packets > VRETXMAXPACKETS) || (Packets & (Packets - 1))
+       || (Window == 0) || (Port == 0) || (Port > 65535))
+    {
+        printf("bad DDC retransmit setting %s: use <packets>[:<window ms>[:<NACK port>]], packets a power of 2 from %d to %d\n",
+               Spec, VRETXMINPACKETS, VRETXMAXPACKETS);
+        return false;
+    }
+    RetransmitPackets = Packets;
+    RetransmitWindow = Window;
+    RetransmitPort.Portid = (uint16_t)Port;
+    printf("DDC retransmit: last %u packets per DDC kept for %ums, NACKs on port %u\n", Packets, Window, Port);
+    return true;
+}
+
+
+//
+// handle one NACK: copy the packets still worth sending out of the ring, then send them
+// from the DDC's socket. Called by the inbound dispatcher thread only.
+//
+static void HandleDDCNack(uint8_t* Packet, int Size, struct msghdr* Header)
+{
+    static uint8_t ResendData[VRETXMAXRESEND][VDDCPACKETSIZE];
+    static struct iovec ResendIovec[VRETXMAXRESEND];
+    static struct mmsghdr ResendBatch[VRETXMAXRESEND];
+    struct sockaddr_in* From = (struct sockaddr_in*)Header->msg_name;
+    struct RetransmitRing* Ring;
+    struct RetransmitSlot* Slot;
+    uint32_t DDC, Ranges, Range;
+    uint32_t Sequence, Count, Cntr;
+    uint32_t Found = 0, Missed = 0;
+    uint64_t Oldest;
+    int Sent;
+
+    DDC = (Size >= VRETXNACKHEADER) ? Packet[4] : VNUMDDC;
+    Ranges = (Size >= VRETXNACKHEADER) ? Packet[5] : 0;
+    if((DDC >= VNUMDDC) || (Ranges == 0) || (Ranges > VRETXMAXRANGES) || (Size < (int)(VRETXNACKHEADER + 6 * Ranges)))
+    {
+        __atomic_add_fetch(&GDDCNacksRejected, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    NoteMessageReceived();
+    Ring = &RetransmitRings[DDC];
+    Oldest = GetMonotonicNs() - (uint64_t)RetransmitWindow * 1000000ULL;
+    pthread_mutex_lock(&Ring->Mutex);
+    if(!Ring->Enabled || (From->sin_addr.s_addr != Ring->Dest.sin_addr.s_addr))
+    {
+        pthread_mutex_unlock(&Ring->Mutex);
+        __atomic_add_fetch(&GDDCNacksRejected, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    for(Range = 0; Range < Ranges; Range++)
+    {
+        Sequence = ntohl(*(uint32_t*)(Packet + VRETXNACKHEADER + 6 * Range));
+        Count = ntohs(*(uint16_t*)(Packet + VRETXNACKHEADER + 6 * Range + 4));
+        for(Cntr = 0; Cntr < Count; Cntr++, Sequence++)
+        {
+            Slot = &Ring->Slots[Sequence & (RetransmitPackets - 1)];
+            if((Found >= VRETXMAXRESEND) || (Slot->Length == 0) || (Slot->Sequence != Sequence)
+               || ((int64_t)(Slot->SentTime - Oldest) < 0))
+            {
+                Missed++;
+                continue;
+            }
+            memcpy(ResendData[Found], Slot->Data, Slot->Length);
+            ResendIovec[Found].iov_base = ResendData[Found];
+            ResendIovec[Found].iov_len = Slot->Length;
+            memset(&ResendBatch[Found], 0, sizeof(struct mmsghdr));
+            ResendBatch[Found].msg_hdr.msg_iov = &ResendIovec[Found];
+            ResendBatch[Found].msg_hdr.msg_iovlen = 1;
+            ResendBatch[Found].msg_hdr.msg_name = &Ring->Dest;
+            ResendBatch[Found].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+            Found++;
+        }
+    }
+    pthread_mutex_unlock(&Ring->Mutex);
+    //
+    // the destination can't change while the dispatcher is here: sessions
+    // start and stop with the sender idle, and only the DDC thread writes it
+    //
+    Sent = 0;
+    if(Found != 0)
+        Sent = sendmmsg(Ring->Socketid, ResendBatch, Found, MSG_DONTWAIT);
+    if(Sent < 0)
+        Sent = 0;                               // queue full: the client will ask again, or give up
+    __atomic_add_fetch(&GDDCNacks, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&GDDCRetransmitted, Sent, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&GDDCRetransmitMissed, Missed + Found - Sent, __ATOMIC_RELAXED);
+}
+
+
+//
+// allocate the rings and open the NACK port
+//
+bool StartDDCRetransmit(void)
+{
+    struct sockaddr_in Addr;
+    uint32_t DDC;
+    int yes = 1;
+
+    if(RetransmitPackets == 0)
+        return true;
+    for(DDC = 0; DDC < VNUMDDC; DDC++)
+    {
+        pthread_mutex_init(&RetransmitRings[DDC].Mutex, NULL);
+        RetransmitRings[DDC].Slots = calloc(RetransmitPackets, sizeof(struct RetransmitSlot));
+        if(RetransmitRings[DDC].Slots == NULL)
+        {
+            printf("DDC retransmit: ring allocation failed\n");
+            return false;
+        }
+    }
+    RetransmitPort.Nameid = "DDC retransmit";
+    RetransmitPort.Socketid = socket(AF_INET, SOCK_DGRAM, 0);
+    if(RetransmitPort.Socketid < 0)
+    {
+        perror("socket, DDC retransmit");
+        return false;
+    }
+    setsockopt(RetransmitPort.Socketid, SOL_SOCKET, SO_REUSEADDR, (void *)&yes, sizeof(yes));
+    memset(&Addr, 0, sizeof(Addr));
+    Addr.sin_family = AF_INET;
+    Addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    Addr.sin_port = htons(RetransmitPort.Portid);
+    if(bind(RetransmitPort.Socketid, (struct sockaddr *)&Addr, sizeof(Addr)) < 0)
+    {
+        perror("bind, DDC retransmit");
+        return false;
+    }
+    memcpy(&RetransmitPort.addr_cmddata, &Addr, sizeof(Addr));
+    if(!AddInboundPort(&RetransmitPort, VRETXNACKSIZE, 0, HandleDDCNack))
+        return false;
+    RetransmitStarted = true;
+    return true;
+}
+
+
+//
+// session start for one DDC: empty the ring
+//
+void StartDDCRetransmitSession(uint32_t DDC, int Socketid, const struct sockaddr_in* Dest, bool Enable)
+{
+    struct RetransmitRing* Ring = &RetransmitRings[DDC];
+    uint32_t Cntr;
+
+    if(!RetransmitStarted)
+        return;
+    pthread_mutex_lock(&Ring->Mutex);
+    for(Cntr = 0; Cntr < RetransmitPackets; Cntr++)
+        Ring->Slots[Cntr].Length = 0;
+    Ring->Socketid = Socketid;
+    memcpy(&Ring->Dest, Dest, sizeof(struct sockaddr_in));
+    __atomic_store_n(&Ring->Enabled, Enable, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&Ring->Mutex);
+    if(DDC == 0)
+    {
+        GDDCNacks = 0;
+        GDDCRetransmitted = 0;
+        GDDCRetransmitMissed = 0;
+        GDDCNacksRejected = 0;
+        if(!Enable)
+            printf("DDC retransmit not available this session (VITA-49 or AF_XDP)\n");
+    }
+}
+
+
+//
+// session end: stop resending, and report
+//
+void StopDDCRetransmitSession(void)
+{
+    uint32_t DDC;
+
+    if(!RetransmitStarted)
+        return;
+    for(DDC = 0; DDC < VNUMDDC; DDC++)
+    {
+        pthread_mutex_lock(&RetransmitRings[DDC].Mutex);
+        __atomic_store_n(&RetransmitRings[DDC].Enabled, false, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&RetransmitRings[DDC].Mutex);
+    }
+    if(GDDCNacks != 0)
+        printf("DDC NACKs = %llu, packets resent = %llu, not available = %llu\n",
+               (unsigned long long)GDDCNacks, (unsigned long long)GDDCRetransmitted,
+               (unsigned long long)GDDCRetransmitMissed);
+    if(GDDCNacksRejected != 0)
+        printf("DDC NACKs rejected = %llu\n", (unsigned long long)GDDCNacksRejected);
+}
+
+
+//
+// copy a batch of packets just sent into the ring. Each packet starts with its
+// sequence number; a batch larger than the ring only leaves its last packets
+//
+void RecordDDCPackets(uint32_t DDC, const struct iovec* Packets, uint32_t Count)
+{
+    struct RetransmitRing* Ring = &RetransmitRings[DDC];
+    struct RetransmitSlot* Slot;
+    uint32_t Sequence;
+    uint64_t Now;
+    uint32_t Cntr;
+
+    if((Count == 0) || !__atomic_load_n(&Ring->Enabled, __ATOMIC_RELAXED))
+        return;
+    Now = GetMonotonicNs();
+    pthread_mutex_lock(&Ring->Mutex);
+    for(Cntr = 0; Cntr < Count; Cntr++)
+    {
+        if(Packets[Cntr].iov_len > VDDCPACKETSIZE)
+            continue;
+        Sequence = ntohl(*(uint32_t*)Packets[Cntr].iov_base);
+        Slot = &Ring->Slots[Sequence & (RetransmitPackets - 1)];
+        Slot->Sequence = Sequence;
+        Slot->Length = Packets[Cntr].iov_len;
+        Slot->SentTime = Now;
+        memcpy(Slot->Data, Packets[Cntr].iov_base, Packets[Cntr].iov_len);
+    }
+    pthread_mutex_unlock(&Ring->Mutex);
+}
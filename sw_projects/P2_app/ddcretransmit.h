@@ -0,0 +1,91 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// ddcretransmit.h:
+//
+// header: selective retransmission of DDC I/Q packets over lossy links
+// when enabled, the DDC sender copies each packet it sends to the client into
+// a ring per DDC that keeps the last N packets. A client that sees a gap in the
+// sequence numbers sends a NACK to the retransmit port; a packet is sent again,
+// from its DDC's port, if it is still in the ring and younger than the latency
+// window. A resent packet is identical to the original, so it reaches the client
+// as a late (reordered) packet.
+// only 24, 16 bit and float protocol 2 packets are kept: the VITA-49 sequence
+// count is 4 bits, and AF_XDP sessions don't use the socket send path.
+//
+// NACK message (all big endian):
+//   bytes 0-3     message sequence number (not checked)
+//   byte 4        DDC number
+//   byte 5        number of ranges, 1 to VRETXMAXRANGES
+//   6 on          for each range: 4 bytes 1st sequence number, 2 bytes packet count
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __ddcretransmit_h
+#define __ddcretransmit_h
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+
+
+#define VRETXDEFAULTPORT 1045                   // NACK port if not given (after the DDC ports)
+#define VRETXDEFAULTWINDOW 100                  // ms after sending that a packet can be resent
+#define VRETXMINPACKETS 16                      // ring size limits, per DDC (a power of 2)
+#define VRETXMAXPACKETS 4096
+#define VRETXMAXRANGES 16                       // ranges in one NACK
+#define VRETXNACKHEADER 6
+#define VRETXNACKSIZE (VRETXNACKHEADER + 6 * VRETXMAXRANGES)
+#define VRETXMAXRESEND 64                       // most packets resent for one NACK
+
+
+//
+// bool SetDDCRetransmit(const char* Spec)
+// enable retransmission, from a command line or config file string
+// format: <packets>[:<window ms>[:<NACK port>]]   eg 256:100:1045
+// returns true if successful
+//
+bool SetDDCRetransmit(const char* Spec);
+
+
+//
+// bool StartDDCRetransmit(void)
+// if enabled, allocate the rings and open the NACK port, and add it to the inbound
+// dispatcher. Call before the dispatcher thread starts.
+// returns false if enabled but it could not be started
+//
+bool StartDDCRetransmit(void);
+
+
+//
+// void StartDDCRetransmitSession(uint32_t DDC, int Socketid, const struct sockaddr_in* Dest, bool Enable)
+// DDC thread, at session start: empty the DDC's ring, and set where its packets are
+// resent from and to. Enable = false if this session's packets can't be resent
+//
+void StartDDCRetransmitSession(uint32_t DDC, int Socketid, const struct sockaddr_in* Dest, bool Enable);
+
+
+//
+// void StopDDCRetransmitSession(void)
+// DDC thread, at session end (sender threads idle): stop resending, and report
+//
+void StopDDCRetransmitSession(void);
+
+
+//
+// void RecordDDCPackets(uint32_t DDC, const struct iovec* Packets, uint32_t Count)
+// DDC sender: copy a batch of packets just sent to the client into the DDC's ring
+// returns at once if retransmission is not enabled for the DDC
+//
+void RecordDDCPackets(uint32_t DDC, const struct iovec* Packets, uint32_t Count);
+
+
+#endif
@@ -0,0 +1,205 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// ddcscan.c:
+//
+// on-device frequency scanning: retune a DDC through a frequency list
+// on a timerfd schedule
+//
+//////////////////////////////////////////////////////////////
+
+#include "threaddata.h"
+#include <stdint.h>
+#include "../common/saturntypes.h"
+#include "ddcscan.h"
+#include "threadmanager.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/timerfd.h>
+#include "../common/saturnregisters.h"
+
+
+#define VSCANSTOPPOLL 100                       // ms between checks for shutdown
+
+
+//
+// one scan: its DDC, dwell and frequency list
+//
+struct DDCScan
+{
+    uint32_t DDC;
+    uint32_t Dwell;                             // ms on each frequency
+    uint32_t StepCount;                         // frequencies in the list
+    uint32_t Frequencies[VMAXSCANSTEPS];        // Hz
+    pthread_t Thread;
+    uint64_t Steps;                             // retunes made
+    uint64_t Overruns;                          // dwell periods missed with the thread late
+};
+
+
+uint32_t GDDCScanMask = 0;                      // DDCs being scanned
+
+static struct DDCScan DDCScans[VMAXDDCSCANS];
+static uint32_t DDCScanCount = 0;
+static uint8_t DDCScanSteps[VNUMDDC];           // current step of each scanned DDC
+
+
+//
+// add a scan, from a command line string
+// format: <DDC>:<dwell ms>:<frequency Hz>,<frequency Hz>...
+// returns true if successful
+//
+bool AddDDCScan(const char* Spec)
+{
+    struct DDCScan* Scan;
+    uint32_t DDC, Dwell, Cntr;
+    int Offset = 0;
+    char* List;
+    char* FreqPtr;
+    char* SavePtr;
+
+    if(DDCScanCount >= VMAXDDCSCANS)
+    {
+        printf("too many DDC scans (max %d)\n", VMAXDDCSCANS);
+        return false;
+    }
+    if((sscanf(Spec, "%u:%u:%n", &DDC, &Dwell, &Offset) != 2) || (Offset == 0) || (DDC >= VNUMDDC)
+       || (Dwell < VMINSCANDWELL) || (Dwell > VMAXSCANDWELL))
+    {
+        printf("bad DDC scan %s: use <DDC>:<dwell %d-%dms>:<frequency Hz>,<frequency Hz>...\n",
+               Spec, VMINSCANDWELL, VMAXSCANDWELL);
+        return false;
+    }
+    for (Cntr = 0; Cntr < DDCScanCount; Cntr++)
+        if(DDCScans[Cntr].DDC == DDC)
+        {
+            printf("DDC %d is already scanned\n", DDC);
+            return false;
+        }
+    Scan = &DDCScans[DDCScanCount];
+    memset(Scan, 0, sizeof(*Scan));
+    Scan->DDC = DDC;
+    Scan->Dwell = Dwell;
+    List = strdup(Spec + Offset);
+    if(List == NULL)
+        return false;
+    FreqPtr = strtok_r(List, ",", &SavePtr);
+    while(FreqPtr != NULL)
+    {
+        if(Scan->StepCount >= VMAXSCANSTEPS)
+        {
+            printf("DDC scan: too many frequencies (max %d)\n", VMAXSCANSTEPS);
+            free(List);
+            return false;
+        }
+        Scan->Frequencies[Scan->StepCount++] = (uint32_t)strtoul(FreqPtr, NULL, 10);
+        FreqPtr = strtok_r(NULL, ",", &SavePtr);
+    }
+    free(List);
+    if(Scan->StepCount < 2)
+    {
+        printf("DDC scan %s: at least 2 frequencies needed\n", Spec);
+        return false;
+    }
+    DDCScanCount++;
+    printf("DDC %d scans %d frequencies, %dms each\n", DDC, Scan->StepCount, Dwell);
+    return true;
+}
+
+
+//
+// scan thread: retune at each timer tick while the SDR is active
+// each session starts at the 1st frequency. If the thread is late the missed
+// ticks are counted, not made up, so every dwell is at least the time set
+//
+static void* DDCScanThread(void* arg)
+{
+    struct DDCScan* Scan = (struct DDCScan*)arg;
+    struct itimerspec Time;
+    struct pollfd Poll;
+    uint64_t Expiries;
+    uint32_t Step = 0;
+    bool Running = false;
+    int Timer_fd;
+
+    Timer_fd = timerfd_create(CLOCK_MONOTONIC, 0);
+    if(Timer_fd < 0)
+    {
+        perror("timerfd_create, DDC scan");
+        return NULL;
+    }
+    Time.it_interval.tv_sec = Scan->Dwell / 1000;
+    Time.it_interval.tv_nsec = (Scan->Dwell % 1000) * 1000000L;
+    Time.it_value = Time.it_interval;
+    timerfd_settime(Timer_fd, 0, &Time, NULL);
+    Poll.fd = Timer_fd;
+    Poll.events = POLLIN;
+
+    while(!ThreadStopRequested())
+    {
+        if(poll(&Poll, 1, VSCANSTOPPOLL) <= 0)
+            continue;
+        if(read(Timer_fd, &Expiries, sizeof(Expiries)) != sizeof(Expiries))
+            continue;
+        if(!__atomic_load_n(&SDRActive, __ATOMIC_RELAXED))
+        {
+            Running = false;
+            continue;
+        }
+        if(!Running)                                // a new session: start from the 1st frequency
+        {
+            Step = 0;
+            Running = true;
+        }
+        else
+        {
+            Scan->Overruns += Expiries - 1;
+            Step = (Step + 1) % Scan->StepCount;
+        }
+        SetDDCFrequency(Scan->DDC, Scan->Frequencies[Step], false);
+        __atomic_store_n(&DDCScanSteps[Scan->DDC], (uint8_t)Step, __ATOMIC_RELEASE);
+        Scan->Steps++;
+    }
+    close(Timer_fd);
+    printf("DDC %d scan: %llu steps, %llu dwell periods missed\n", Scan->DDC,
+           (unsigned long long)Scan->Steps, (unsigned long long)Scan->Overruns);
+    return NULL;
+}
+
+
+//
+// start a thread for each scan added
+//
+bool StartDDCScans(void)
+{
+    uint32_t Cntr;
+
+    for (Cntr = 0; Cntr < DDCScanCount; Cntr++)
+    {
+        if(!CreateManagedThread(&DDCScans[Cntr].Thread, "DDC scan", eControlThread, DDCScanThread, &DDCScans[Cntr]))
+        {
+            perror("pthread_create DDC scan");
+            return false;
+        }
+        GDDCScanMask |= 1U << DDCScans[Cntr].DDC;
+    }
+    return true;
+}
+
+
+//
+// timestamp top byte for a scanned DDC
+//
+uint8_t GetDDCScanStep(uint32_t DDC)
+{
+    return VDDCTSSCANSTEP | __atomic_load_n(&DDCScanSteps[DDC], __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,77 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// ddcscan.h:
+//
+// header: on-device frequency scanning
+// a scan retunes one DDC through a list of frequencies, staying on each for
+// a dwell time, without the client sending a high priority packet per step.
+// each scan has its own control class thread, timed by a timerfd, and runs
+// while the SDR is active; it starts from the 1st frequency each session.
+//
+// the packets of a scanned DDC always carry a timestamp. Its top byte
+// (which sample counts never reach) holds the step:
+//   bit 7     VDDCTSSCANSTEP: set in every packet of a scanned DDC
+//   bit 6     VDDCTSSCANCHANGED: the step changed during this packet
+//   bits 0-5  step number, ie position of the frequency in the list
+// samples reach the decode up to a DMA latency after they were taken, so the
+// packet after the one marked changed can still hold samples from the
+// previous step; a client should ignore the start of each dwell.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __ddcscan_h
+#define __ddcscan_h
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../common/saturntypes.h"
+
+
+#define VMAXDDCSCANS 4                          // most scans; each has its own thread
+#define VMAXSCANSTEPS 64                        // most frequencies in a scan list
+#define VMINSCANDWELL 1                         // ms
+#define VMAXSCANDWELL 10000                     // ms
+#define VDDCTSSCANSTEP 0x80                     // scanned DDC packet timestamp, top byte: holds the step
+#define VDDCTSSCANCHANGED 0x40                  // scanned DDC packet timestamp, top byte: step changed in the packet
+
+
+//
+// DDCs being scanned, one bit per DDC. Set once at startup;
+// read by the DDC decode to decide whether to tag the packets
+//
+extern uint32_t GDDCScanMask;
+
+
+//
+// bool AddDDCScan(const char* Spec)
+// add a scan, from a command line or config file string
+// format: <DDC>:<dwell ms>:<frequency Hz>,<frequency Hz>...   eg 1:2:7000000,7050000,7100000
+// returns true if successful
+//
+bool AddDDCScan(const char* Spec);
+
+
+//
+// bool StartDDCScans(void)
+// start a thread for each scan added
+// returns false if any could not be started
+//
+bool StartDDCScans(void);
+
+
+//
+// uint8_t GetDDCScanStep(uint32_t DDC)
+// timestamp top byte for a scanned DDC: VDDCTSSCANSTEP | the current step
+//
+uint8_t GetDDCScanStep(uint32_t DDC);
+
+
+#endif
@@ -0,0 +1,224 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// ddcshm.c:
+//
+// shared memory export of DDC I/Q: a single writer, multi reader ring
+// per DDC in a memfd, handed to local clients over a unix socket
+//
+//////////////////////////////////////////////////////////////
+
+#include "ddcshm.h"
+#include "housekeeping.h"
+#include "../common/saturnregisters.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <linux/futex.h>
+
+
+uint32_t GDDCShmMask = 0;
+
+static uint8_t* DDCShmBase[VNUMDDC];                    // mapped ring for each exported DDC
+static int DDCShmfd[VNUMDDC];
+static int DDCShmListen_fd = -1;
+
+
+//
+// parse a list of DDC numbers
+//
+bool AddDDCShmExport(const char* Spec)
+{
+    const char* Ptr = Spec;
+    char* End;
+    unsigned long DDC;
+    uint32_t Mask = 0;
+
+    while(*Ptr != 0)
+    {
+        DDC = strtoul(Ptr, &End, 10);
+        if((End == Ptr) || (DDC >= VNUMDDC) || ((*End != ',') && (*End != 0)))
+        {
+            printf("bad DDC shared memory export %s: use <DDC>[,<DDC>...]\n", Spec);
+            return false;
+        }
+        Mask |= (1U << DDC);
+        Ptr = (*End == ',') ? End + 1 : End;
+    }
+    GDDCShmMask |= Mask;
+    return true;
+}
+
+
+//
+// housekeeping thread: a client has connected. Send it the memfds and close.
+//
+static void ServeDDCShmClient(int fd, __attribute__((unused)) void* Arg)
+{
+    struct DDCShmAttach Attach;
+    struct msghdr Message;
+    struct iovec Iov;
+    struct cmsghdr* Cmsg;
+    char Control[CMSG_SPACE(VNUMDDC * sizeof(int))];
+    int Fds[VNUMDDC];
+    int Client;
+    uint32_t DDC;
+
+    Client = accept4(fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+    if(Client < 0)
+        return;
+    memset(&Attach, 0, sizeof(Attach));
+    Attach.Magic = VDDCSHMMAGIC;
+    Attach.Version = VDDCSHMVERSION;
+    for(DDC = 0; DDC < VNUMDDC; DDC++)
+        if(DDCShmBase[DDC] != NULL)
+        {
+            Fds[Attach.Count] = DDCShmfd[DDC];
+            Attach.DDC[Attach.Count++] = DDC;
+        }
+    memset(&Message, 0, sizeof(Message));
+    memset(Control, 0, sizeof(Control));
+    Iov.iov_base = &Attach;
+    Iov.iov_len = sizeof(Attach);
+    Message.msg_iov = &Iov;
+    Message.msg_iovlen = 1;
+    Message.msg_control = Control;
+    Message.msg_controllen = CMSG_SPACE(Attach.Count * sizeof(int));
+    Cmsg = CMSG_FIRSTHDR(&Message);
+    Cmsg->cmsg_level = SOL_SOCKET;
+    Cmsg->cmsg_type = SCM_RIGHTS;
+    Cmsg->cmsg_len = CMSG_LEN(Attach.Count * sizeof(int));
+    memcpy(CMSG_DATA(Cmsg), Fds, Attach.Count * sizeof(int));
+    if(sendmsg(Client, &Message, MSG_NOSIGNAL) < 0)
+        perror("DDC shared memory: send to client");
+    close(Client);
+}
+
+
+//
+// create a ring: a sealed memfd of fixed size, mapped shared
+//
+static bool CreateDDCShmRing(uint32_t DDC)
+{
+    char Name[32];
+    struct DDCShmHeader* Header;
+    int fd;
+    uint8_t* Base;
+
+    snprintf(Name, sizeof(Name), "saturn-ddc%u", DDC);
+    fd = memfd_create(Name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if(fd < 0)
+    {
+        perror("DDC shared memory memfd_create");
+        return false;
+    }
+    if((ftruncate(fd, VDDCSHMMAPBYTES) < 0) || (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0))
+    {
+        perror("DDC shared memory size");
+        close(fd);
+        return false;
+    }
+    Base = mmap(NULL, VDDCSHMMAPBYTES, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    if(Base == MAP_FAILED)
+    {
+        perror("DDC shared memory mmap");
+        close(fd);
+        return false;
+    }
+    Header = (struct DDCShmHeader*)Base;
+    Header->Version = VDDCSHMVERSION;
+    Header->DDC = DDC;
+    Header->SlotCount = VDDCSHMSLOTS;
+    Header->SlotBytes = VDDCSHMSLOTBYTES;
+    Header->DataOffset = VDDCSHMDATAOFFSET;
+    __atomic_store_n(&Header->Magic, VDDCSHMMAGIC, __ATOMIC_RELEASE);
+    DDCShmBase[DDC] = Base;
+    DDCShmfd[DDC] = fd;
+    return true;
+}
+
+
+//
+// create the rings and the listening socket
+//
+bool StartDDCShmExport(void)
+{
+    struct sockaddr_un Addr;
+    uint32_t DDC;
+    uint32_t Exported = 0;
+
+    if(GDDCShmMask == 0)
+        return true;
+    for(DDC = 0; DDC < VNUMDDC; DDC++)
+        if((GDDCShmMask & (1U << DDC)) && CreateDDCShmRing(DDC))
+            Exported |= (1U << DDC);
+    if(Exported == 0)
+    {
+        GDDCShmMask = 0;
+        return false;
+    }
+    DDCShmListen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    memset(&Addr, 0, sizeof(Addr));
+    Addr.sun_family = AF_UNIX;
+    strncpy(Addr.sun_path, VDDCSHMSOCKET, sizeof(Addr.sun_path) - 1);
+    unlink(VDDCSHMSOCKET);                              // left by an earlier run
+    if((DDCShmListen_fd < 0) || (bind(DDCShmListen_fd, (struct sockaddr*)&Addr, sizeof(Addr)) < 0)
+       || (listen(DDCShmListen_fd, 4) < 0) || !AddHousekeepingFd(DDCShmListen_fd, ServeDDCShmClient, NULL))
+    {
+        perror("DDC shared memory socket " VDDCSHMSOCKET);
+        if(DDCShmListen_fd >= 0)
+            close(DDCShmListen_fd);
+        DDCShmListen_fd = -1;
+        GDDCShmMask = 0;                                // rings not used: no client can attach
+        return false;
+    }
+    GDDCShmMask = Exported;
+    printf("DDC shared memory export (DDC mask 0x%x) at %s\n", Exported, VDDCSHMSOCKET);
+    return true;
+}
+
+
+//
+// write one packet to a ring, seqlock style: the slot sequence is cleared,
+// the slot written, then the sequence and the published count set.
+// readers are only woken by a system call if one is waiting
+//
+void ExportDDCPacket(uint32_t DDC, const uint8_t* Samples, uint32_t SampleCount, uint64_t StreamIndex, uint32_t SampleRate)
+{
+    struct DDCShmHeader* Header = (struct DDCShmHeader*)DDCShmBase[DDC];
+    struct DDCShmSlot* Slot;
+    uint64_t Packet;
+
+    if(Header == NULL)
+        return;
+    if(SampleCount * 6 > VDDCSHMSAMPLEBYTES)
+        SampleCount = VDDCSHMSAMPLEBYTES / 6;
+    Packet = Header->Published;                         // only this thread writes it
+    Slot = (struct DDCShmSlot*)(DDCShmBase[DDC] + VDDCSHMDATAOFFSET + (Packet & (VDDCSHMSLOTS - 1)) * VDDCSHMSLOTBYTES);
+    __atomic_store_n(&Slot->Sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    Slot->StreamIndex = StreamIndex;
+    Slot->SampleRate = SampleRate;
+    Slot->SampleCount = SampleCount;
+    memcpy(Slot->Samples, Samples, SampleCount * 6);
+    __atomic_store_n(&Slot->Sequence, Packet + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&Header->Published, Packet + 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&Header->Futex, 1, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&Header->Waiters, __ATOMIC_SEQ_CST) != 0)
+        syscall(SYS_futex, &Header->Futex, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
@@ -0,0 +1,133 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// ddcshm.h:
+//
+// header: shared memory export of DDC I/Q for clients running on the Pi itself
+// (eg a local piHPSDR or skimmer), in place of the UDP loopback and its two
+// kernel copies per packet.
+// each exported DDC has a ring of packet slots in a memfd, written by the DDC
+// decode thread alone and read by any number of clients, without locks. The
+// writer never waits for a reader: a reader that falls a whole ring behind
+// is overrun, and sees it from the slot sequence numbers.
+// a client connects to the unix socket VDDCSHMSOCKET; it is sent a struct
+// DDCShmAttach listing the exported DDCs, with their memfds (SCM_RIGHTS),
+// and the socket is closed. It maps each memfd (VDDCSHMMAPBYTES, MAP_SHARED).
+//
+// reading slot N (the packet numbered N, from 0):
+//   wait until Header->Published > N. To sleep: increment Waiters, futex
+//     wait on Futex with the value read before checking Published, decrement Waiters.
+//   if Header->Published - N > SlotCount the slot has been overrun: skip ahead.
+//   Slot = mapped base + VDDCSHMDATAOFFSET + (N & (SlotCount-1)) * SlotBytes
+//   read Slot->Sequence (acquire); it is N+1 if the slot holds packet N.
+//   use the samples in place, then (acquire fence) read Slot->Sequence again:
+//     if it has changed the samples may be torn, and the reader has been overrun.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __ddcshm_h
+#define __ddcshm_h
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../common/saturntypes.h"
+
+
+#define VDDCSHMSOCKET "/tmp/saturn-ddc.sock"    // clients connect here for the memfds
+#define VDDCSHMMAGIC 0x43444453                 // "SDDC" little endian
+#define VDDCSHMVERSION 1
+#define VDDCSHMSLOTS 1024                       // packets per DDC ring (power of 2): 160ms at 1536KHz
+#define VDDCSHMSAMPLEBYTES (238 * 6)            // a protocol 2 packet of 24 bit I/Q samples
+#define VDDCSHMSLOTBYTES 1472                   // slot header and samples, a multiple of 64
+#define VDDCSHMDATAOFFSET 4096                  // slot 0, after the ring header page
+#define VDDCSHMMAPBYTES (VDDCSHMDATAOFFSET + VDDCSHMSLOTS * VDDCSHMSLOTBYTES)
+#define VDDCSHMMAXDDC 10                        // DDCs listed in struct DDCShmAttach (VNUMDDC)
+
+
+//
+// the ring header, at the start of each memfd
+//
+struct DDCShmHeader
+{
+    uint32_t Magic;                             // VDDCSHMMAGIC
+    uint32_t Version;                           // VDDCSHMVERSION
+    uint32_t DDC;
+    uint32_t SlotCount;
+    uint32_t SlotBytes;
+    uint32_t DataOffset;                        // byte offset of slot 0
+    uint32_t Futex;                             // incremented each packet: readers futex wait on it
+    uint32_t Waiters;                           // readers waiting; the writer only wakes if not 0
+    uint64_t Published;                         // packets written since the ring was created
+};
+
+
+//
+// one packet slot
+//
+struct DDCShmSlot
+{
+    uint64_t Sequence;                          // packet number + 1; 0 while being written
+    uint64_t StreamIndex;                       // samples the DDC produced this session before the 1st one
+    uint32_t SampleRate;                        // DDC sample rate, Hz
+    uint32_t SampleCount;                       // I/Q samples in the slot
+    uint8_t Spare[8];
+    uint8_t Samples[VDDCSHMSAMPLEBYTES];        // 24 bit big endian I then Q, as in a protocol 2 packet
+};
+
+
+//
+// message sent to a client that connects to VDDCSHMSOCKET; one memfd per DDC, in order
+//
+struct DDCShmAttach
+{
+    uint32_t Magic;                             // VDDCSHMMAGIC
+    uint32_t Version;                           // VDDCSHMVERSION
+    uint32_t Count;                             // DDCs exported
+    uint32_t DDC[VDDCSHMMAXDDC];
+};
+
+
+//
+// DDCs exported, one bit per DDC. Set once at startup;
+// read by the DDC decode to decide whether to call ExportDDCPacket()
+//
+extern uint32_t GDDCShmMask;
+
+
+//
+// bool AddDDCShmExport(const char* Spec)
+// add DDCs to export, from a command line or config file string
+// format: <DDC>[,<DDC>...]   eg 0,1
+// returns true if successful
+//
+bool AddDDCShmExport(const char* Spec);
+
+
+//
+// bool StartDDCShmExport(void)
+// create the rings and listen for clients (the connections are served by the
+// housekeeping thread, so start that first). Does nothing if no DDC is exported.
+// returns false if the export could not be started
+//
+bool StartDDCShmExport(void);
+
+
+//
+// void ExportDDCPacket(uint32_t DDC, const uint8_t* Samples, uint32_t SampleCount, uint64_t StreamIndex, uint32_t SampleRate)
+// DDC decode thread: write one packet of samples to the DDC's ring
+//   Samples:       24 bit big endian I then Q samples, as in a protocol 2 packet
+//   SampleCount:   I/Q samples (at most VDDCSHMSAMPLEBYTES / 6)
+//   StreamIndex:   count of samples the DDC has produced before the 1st one
+//   SampleRate:    DDC sample rate, Hz
+//
+void ExportDDCPacket(uint32_t DDC, const uint8_t* Samples, uint32_t SampleCount, uint64_t StreamIndex, uint32_t SampleRate);
+
+
+#endif
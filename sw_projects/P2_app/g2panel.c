@@ -43,6 +43,7 @@
 #include "i2cdriver.h"
 #include "cathandler.h"
 #include "andromedacatmessages.h"
+#include "threadmanager.h"
 
 
 //
@@ -77,10 +78,8 @@ char* gpio_device = NULL;
 char *consumer = "p2app";
 struct gpiod_line *VFO1;                            // declare GPIO for VFO
 struct gpiod_line *VFO2;
-pthread_t VFOEncoderThread;                         // thread looks for encoder edge events
-pthread_t G2PanelTickThread;                        // thread with periodic
-uint16_t GDeltaCount;                    // count stored since last retrieved
-struct timespec ts = {1, 0};
+struct gpiod_line *MCPInt;                          // MCP23017 INTA interrupt on change output
+pthread_t G2PanelEventThread;                       // thread waits for encoder and pushbutton edge events
 bool G2PanelActive = false;                         // true while panel active and threads should run
 bool EncodersInitialised = false;                   // true after 1st scan
 bool CATDetected = false;                           // true if panel ID message has been sent
@@ -96,33 +95,29 @@ bool CATDetected = false;                           // true if panel ID message
 uint32_t PBIOPins[VNUMGPIO] = {20, 26, 6, 5, 4, 21, 7, 9, 
                                16, 19, 10, 11, 25, 8, 12, 13,
                                22, 27, 23, 24};
+#define VMCPINTPIN 15                           // GPIO for MCP23017 INTA
 struct gpiod_line_bulk PBInLines;
-struct gpiod_line_request_config config = {"p2app", GPIOD_LINE_REQUEST_DIRECTION_INPUT, 0};
+struct gpiod_line_bulk EventLines;              // all the lines the event thread waits on
 int32_t IOPinValues[VNUMGPIO] = {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
 
 //
-// pushbutton inputs: each has a byte, with new tick added at LSB. Supports simple debounce.
-// initialised to 0xFF as buttons expected to be released (1 input) at startup
+// pushbutton debounce is by timestamp: an edge (or MCP23017 interrupt on change) starts
+// a settle time, restarted by each further edge. When it expires the input is stable,
+// and a press or release is declared if it differs from the debounced state.
+// buttons 0-15 are on the MCP23017; 16-19 are GPIO.
 //
-uint8_t PBPinShifts [VNUMBUTTONS] =    {0xFF, 0xFF, 0xFF, 0xFF,
-                                        0xFF, 0xFF, 0xFF, 0xFF, 
-                                        0xFF, 0xFF, 0xFF, 0xFF, 
-                                        0xFF, 0xFF, 0xFF, 0xFF,
-                                        0xFF, 0xFF, 0xFF, 0xFF};
-
-//
-// long count tick counter for each button. If it reaches zero, a long press has occurred.
-//
-uint8_t PBLongCount [VNUMBUTTONS] =    {0x0, 0x0, 0x0, 0x0,
-                                        0x0, 0x0, 0x0, 0x0, 
-                                        0x0, 0x0, 0x0, 0x0, 
-                                        0x0, 0x0, 0x0, 0x0,
-                                        0x0, 0x0, 0x0, 0x0};
+uint64_t PBSettleDue [VNUMBUTTONS];             // ms time the input will be stable; 0 if not changing
+uint64_t PBLongPressDue [VNUMBUTTONS];          // ms time a long press is declared; 0 if none due
+bool PBPressed [VNUMBUTTONS];                   // debounced state
+uint16_t MCPData;                               // most recent GPIOA, B read from MCP23017
 
 uint8_t EncoderStates[VNUMENCODERS];            // current and previous 2 bit state
 int8_t EncoderCounts[VNUMENCODERS];             // number of steps since last read
-#define VLONGPRESSCOUNT 100                     // 1s for long press
-#define VKEEPALIVECOUNT 1500                    // 15s period between keepalive requests
+uint64_t EncoderReportDue;                      // ms time for accumulated steps to be sent; 0 if none
+#define VDEBOUNCETIME 20                        // 20ms pushbutton settle time
+#define VLONGPRESSTIME 1000                     // 1s for long press
+#define VIDLEWAITTIME 1000                      // longest event wait: this often check for CAT
+#define VMAXEDGEEVENTS 16                       // most queued edge events read from a line at once
 
 //
 // lookup table from h/w encoder numbers to Andromeda-like encoder numbers
@@ -215,7 +210,7 @@ bool CheckG2PanelPresent(void)
     i2c_fd=open(pi_i2c_device, O_RDWR);
     if(i2c_fd < 0)
         printf("failed to open i2c device\n");
-    else if(ioctl(i2c_fd, I2C_SLAVE, G2MCP23017) >= 0)
+    else if(i2c_select_device(G2MCP23017) >= 0)
         // check for G2 front panel on i2c. Change device address then byte read
     {
         i2c_read_byte_data(0x0, &Error);              // trial read
@@ -229,54 +224,6 @@ bool CheckG2PanelPresent(void)
 
 
 
-#define VOPTENCODERDIVISOR 1                        // only declare every n-th event
-                                                    // (1 OK for optical high res)
-//
-// read the optical encoder. Return the number of steps turned since last called.
-// read back the count since last asked, then zero it for the next time
-// if Divisor is above 1: leave behind the residue
-//
-int8_t ReadOpticalEncoder(void)
-{
-  int8_t Result;
-
-  Result = GDeltaCount / VOPTENCODERDIVISOR;                         // get count value
-  GDeltaCount = GDeltaCount % VOPTENCODERDIVISOR;                    // remaining residue for next time
-  return Result;
-}
-
-
-
-
-//
-// VFO encoder pin interrupt handler
-// this executes as a thread; it waits for an event on a VFO encoder pin
-// for a high res encoder at just one interrupt per pulse - use int on one edge and use the sense of the other to set direction.
-//
-void* VFOEventHandler(__attribute__((unused)) void *arg)
-{
-    int returnval;
-    uint8_t DirectionBit;
-    struct gpiod_line_event Event;
-
-    printf("Started VFO event handler thread, pid=%ld\n", syscall(SYS_gettid));
-    while(G2PanelActive)
-    {
-        returnval = gpiod_line_event_wait(VFO1, &ts);
-        if(returnval > 0)
-        {
-            returnval = gpiod_line_event_read(VFO1, &Event);            // undocumented: this is needed to clear the event
-            DirectionBit = gpiod_line_get_value(VFO2);
-            if(DirectionBit)
-              GDeltaCount--;
-            else
-              GDeltaCount++;
-//            printf("delta count=%d\n", GDeltaCount);
-        }
-    }
-    return NULL;
-}
-
 int8_t EncoderStepTable[] =    {0,1,-1,2,
                                 -1,0,2, 1,
                                 1,2,0,-1,
@@ -294,10 +241,6 @@ void EncoderTick(uint32_t Enc, uint8_t Pin1, uint8_t Pin2)
 }
 
 
-uint32_t TickCounter;
-#define VFASTTICKSPERSLOWTICK 3
-
-
 //
 // read mechanical encoder
 // step count needs to be halved because they advance 2 steps per click position
@@ -312,96 +255,285 @@ int8_t GetEncoderCount(uint8_t Enc)
 }
 
 
+//
+// helper: CLOCK_MONOTONIC time in ms
+//
+static uint64_t G2PanelTimeNow(void)
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (uint64_t)Now.tv_sec * 1000 + Now.tv_nsec / 1000000;
+}
+
 
 //
-// periodic timestep
-// perform a "fast tick" and then "slow tick" every N
+// helper: note an input change on a pushbutton, to start or restart its settle time
 //
-void* G2PanelTick(__attribute__((unused)) void *arg)
+static void PushbuttonChanged(uint32_t Button, uint64_t Now)
 {
-    int8_t Steps;                               // encoder strp count
-    uint8_t ScanCode;
-    uint8_t PinCntr;                            // interates IO pins
-    uint32_t MCPData;
-    uint32_t Cntr;
-    bool I2Cerror;
+    PBSettleDue[Button] = Now + VDEBOUNCETIME;
+}
+
 
-    printf("Started G2 panel tick thread, pid=%ld\n", syscall(SYS_gettid));
-    while(G2PanelActive)
-    {
-        if(CATPortAssigned)                     // see if CAT has become available for the 1st time
-        {
-            if(CATDetected == false)
-            {
-                CATDetected = true;
-                MakeProductVersionCAT(PRODUCTID, HWVERSION, GetP2appVersion());
-            }
-        }
-        else
-            CATDetected = false;
-        TickCounter++;
-        gpiod_line_get_value_bulk(&PBInLines, IOPinValues);
 //
-// process encoders
+// read the MCP23017 pushbuttons (this also clears its interrupt)
+// start the settle time for any that have changed
 //
-        for(Cntr=0; Cntr < VNUMENCODERS; Cntr++)
-            EncoderTick(Cntr, IOPinValues[2*Cntr], IOPinValues[2*Cntr+1]);
-        EncodersInitialised = true;
+static void ReadMCPPushbuttons(uint64_t Now)
+{
+    uint8_t Data[2];
+    uint16_t NewData;
+    uint16_t Changed;
+    uint32_t Cntr;
+
+    if(i2c_read_block_data(0x12, Data, 2) < 0)                      // read GPIOA, B into bottom 16 bits
+        return;
+    NewData = Data[0] | (Data[1] << 8);
+    Changed = NewData ^ MCPData;
+    MCPData = NewData;
+    for(Cntr = 0; Cntr < VNUMMCPPUSHBUTTONS; Cntr++)
+        if(Changed & (1 << Cntr))
+            PushbuttonChanged(Cntr, Now);
+}
+
+
 //
-// execute slower code every 10ms
+// process the timed pushbutton and encoder events that are due
+// returns the time until the next one is due, in ms (up to VIDLEWAITTIME)
 //
-        if(TickCounter >= VFASTTICKSPERSLOWTICK)
-        {
-            TickCounter=0;
+static uint64_t ProcessG2PanelTimers(uint64_t Now)
+{
+    uint64_t Next = Now + VIDLEWAITTIME;
+    uint32_t VFOWait;
+    uint32_t Cntr;
+    uint8_t ScanCode;
+    int32_t Level;
+    int8_t Steps;
+
     //
-    // now read MCP I2C pushbuttons, and scan all pushbuttons
+    // settled pushbuttons: declare press or release (inputs are active low)
     //
-            MCPData = i2c_read_word_data(0x12, &I2Cerror);                  // read GPIOA, B into bottom 16 bits
-            for (Cntr = 16; Cntr < 20; Cntr++)
-                MCPData |= (IOPinValues[Cntr] << Cntr);                     // add in PB IO pin
-
-            for(PinCntr=0; PinCntr < VNUMBUTTONS; PinCntr++)
+    for(Cntr = 0; Cntr < VNUMBUTTONS; Cntr++)
+    {
+        ScanCode = LookupButtonCode[Cntr];
+        if(PBSettleDue[Cntr] != 0)
+        {
+            if(Now >= PBSettleDue[Cntr])
             {
-                PBPinShifts[PinCntr] = ((PBPinShifts[PinCntr] << 1) | (MCPData & 1)) & 0b00000111;           // most recent 3 samples
-                MCPData = MCPData >> 1;
-                ScanCode = LookupButtonCode[PinCntr];
-                if(PBPinShifts[PinCntr] == 0b00000100)                      // button press detected
+                PBSettleDue[Cntr] = 0;
+                if(Cntr < VNUMMCPPUSHBUTTONS)
+                    Level = (MCPData >> Cntr) & 1;
+                else
+                    Level = IOPinValues[2*VNUMENCODERS + Cntr - VNUMMCPPUSHBUTTONS];
+                if((Level == 0) && !PBPressed[Cntr])           // button press detected
                 {
+                    PBPressed[Cntr] = true;
                     MakePushbuttonCAT(ScanCode, 1);
-                    PBLongCount[PinCntr] = VLONGPRESSCOUNT;                 // set long press count
+                    PBLongPressDue[Cntr] = Now + VLONGPRESSTIME;
                 }
-                else if (PBPinShifts[PinCntr] == 0b00000011)                // button release detected
+                else if((Level != 0) && PBPressed[Cntr])       // button release detected
                 {
+                    PBPressed[Cntr] = false;
                     MakePushbuttonCAT(ScanCode, 0);
-                    PBLongCount[PinCntr] = 0;                               // clear long press count
-                }
-                else if(PBLongCount[PinCntr] != 0)                          // if button pressed, and long press not yet declared
-                {
-                    if(--PBLongCount[PinCntr] == 0)
-                    {
-                        MakePushbuttonCAT(ScanCode, 2);
-                    }
+                    PBLongPressDue[Cntr] = 0;
                 }
             }
-            //
-            // read mechanical encoders
-            //
+            else if(PBSettleDue[Cntr] < Next)
+                Next = PBSettleDue[Cntr];
+        }
+        if(PBLongPressDue[Cntr] != 0)                          // if button pressed, and long press not yet declared
+        {
+            if(Now >= PBLongPressDue[Cntr])
+            {
+                PBLongPressDue[Cntr] = 0;
+                MakePushbuttonCAT(ScanCode, 2);
+            }
+            else if(PBLongPressDue[Cntr] < Next)
+                Next = PBLongPressDue[Cntr];
+        }
+    }
+    //
+    // send the accumulated encoder steps
+    //
+    if(EncoderReportDue != 0)
+    {
+        if(Now >= EncoderReportDue)
+        {
+            EncoderReportDue = 0;
             for(Cntr=0; Cntr < VNUMENCODERS; Cntr++)
             {
                 ScanCode = LookupEncoderCode[Cntr];
                 Steps = GetEncoderCount(Cntr);
                 MakeEncoderCAT(Steps, ScanCode);
             }
+        }
+        else if(EncoderReportDue < Next)
+            Next = EncoderReportDue;
+    }
+    //
+    // and the optical VFO encoder steps, coalesced and accelerated
+    //
+    VFOWait = SendCoalescedVFOSteps();
+    if((VFOWait != VNOVFOSTEPSDUE) && ((Now + VFOWait) < Next))
+        Next = Now + VFOWait;
+    return Next - Now;
+}
+
+
+//
+// one GPIO edge event on an encoder or pushbutton input
+//
+typedef struct
+{
+    struct timespec Time;
+    uint32_t Pin;                               // index into PBIOPins
+    bool Rising;
+} SG2PanelEdge;
+
+
+//
+// read all the queued edge events from the fired encoder and pushbutton lines
+// and sort them into time order (a line's events are already in order, but
+// when the thread falls behind, edges on the 2 lines of an encoder must be
+// processed in the order they happened)
+// returns the number of edges
+//
+static uint32_t ReadG2PanelEdges(struct gpiod_line_bulk* Fired, SG2PanelEdge* Edges, uint32_t MaxEdges)
+{
+    struct gpiod_line_event Events[VMAXEDGEEVENTS];
+    struct gpiod_line* Line;
+    SG2PanelEdge Edge;
+    uint32_t Count = 0;
+    uint32_t LineCntr;
+    uint32_t Pin;
+    int Read;
+    int Cntr;
+    int Position;
+
+    for(LineCntr = 0; LineCntr < gpiod_line_bulk_num_lines(Fired); LineCntr++)
+    {
+        Line = gpiod_line_bulk_get_line(Fired, LineCntr);
+        for(Pin = 0; Pin < VNUMGPIO; Pin++)
+            if(gpiod_line_bulk_get_line(&PBInLines, Pin) == Line)
+                break;
+        if(Pin == VNUMGPIO)
+            continue;                                           // VFO or MCP interrupt
+        Read = gpiod_line_event_read_multiple(Line, Events, VMAXEDGEEVENTS);
+        for(Cntr = 0; (Cntr < Read) && (Count < MaxEdges); Cntr++)
+        {
+            Edge.Time = Events[Cntr].ts;
+            Edge.Pin = Pin;
+            Edge.Rising = (Events[Cntr].event_type == GPIOD_LINE_EVENT_RISING_EDGE);
             //
-            // read optical encoder
+            // insertion sort: normally only 1 or 2 edges
             //
-            Steps = ReadOpticalEncoder();
-            MakeVFOEncoderCAT(Steps);
+            for(Position = (int)Count; Position > 0; Position--)
+            {
+                if((Edges[Position-1].Time.tv_sec < Edge.Time.tv_sec) ||
+                   ((Edges[Position-1].Time.tv_sec == Edge.Time.tv_sec) && (Edges[Position-1].Time.tv_nsec <= Edge.Time.tv_nsec)))
+                    break;
+                Edges[Position] = Edges[Position-1];
+            }
+            Edges[Position] = Edge;
+            Count++;
+        }
+    }
+    return Count;
+}
+
 
+//
+// G2 panel event thread
+// sleeps until an edge on an encoder, pushbutton, VFO encoder or MCP23017 interrupt line,
+// or until the next debounce, long press or encoder report time.
+// the kernel queues the edges, so encoder steps are not lost if the thread is delayed.
+//
+void* G2PanelEventHandler(__attribute__((unused)) void *arg)
+{
+    SG2PanelEdge Edges[VNUMGPIO * VMAXEDGEEVENTS];
+    struct gpiod_line_bulk Fired;
+    struct gpiod_line_event Event;
+    struct timespec Timeout;
+    struct gpiod_line* Line;
+    uint64_t Now;
+    uint64_t Wait;
+    uint32_t EdgeCount;
+    uint32_t Cntr;
+    uint32_t Pin;
+    int Result;
+
+    printf("Started G2 panel event thread, pid=%ld\n", syscall(SYS_gettid));
+    Now = G2PanelTimeNow();
+    ReadMCPPushbuttons(Now);                                    // clears any pending interrupt
+    while(G2PanelActive)
+    {
+        if(CATPortAssigned)                     // see if CAT has become available for the 1st time
+        {
+            if(CATDetected == false)
+            {
+                CATDetected = true;
+                MakeProductVersionCAT(PRODUCTID, HWVERSION, GetP2appVersion());
+            }
         }
+        else
+            CATDetected = false;
 
+        Wait = ProcessG2PanelTimers(Now);
+        Timeout.tv_sec = Wait / 1000;
+        Timeout.tv_nsec = (Wait % 1000) * 1000000L;
+        Result = gpiod_line_event_wait_bulk(&EventLines, &Timeout, &Fired);
+        Now = G2PanelTimeNow();
+        if(Result < 0)
+        {
+            perror("G2 panel gpiod_line_event_wait_bulk");
+            break;
+        }
+        else if(Result == 0)
+        {
+            //
+            // idle: if the MCP interrupt is still asserted, a read was missed
+            //
+            if(gpiod_line_get_value(MCPInt) == 0)
+                ReadMCPPushbuttons(Now);
+            continue;
+        }
 
-        usleep(3333);                                                  // 3.3ms period
+        for(Cntr = 0; Cntr < gpiod_line_bulk_num_lines(&Fired); Cntr++)
+        {
+            Line = gpiod_line_bulk_get_line(&Fired, Cntr);
+            if(Line == VFO1)
+            {
+                //
+                // high res VFO encoder at just one interrupt per pulse: int on one edge
+                // and use the sense of the other to set direction.
+                //
+                gpiod_line_event_read(VFO1, &Event);            // undocumented: this is needed to clear the event
+                QueueVFOEncoderSteps(gpiod_line_get_value(VFO2) ? -1 : 1);
+            }
+            else if(Line == MCPInt)
+            {
+                gpiod_line_event_read(MCPInt, &Event);
+                ReadMCPPushbuttons(Now);
+            }
+        }
+        //
+        // mechanical encoder and GPIO pushbutton edges, in time order
+        //
+        EdgeCount = ReadG2PanelEdges(&Fired, Edges, VNUMGPIO * VMAXEDGEEVENTS);
+        for(Cntr = 0; Cntr < EdgeCount; Cntr++)
+        {
+            Pin = Edges[Cntr].Pin;
+            IOPinValues[Pin] = Edges[Cntr].Rising;
+            if(Pin < 2*VNUMENCODERS)
+            {
+                EncoderTick(Pin/2, IOPinValues[Pin & ~1], IOPinValues[Pin | 1]);
+                if(EncoderReportDue == 0)
+                    EncoderReportDue = Now + EncoderCoalesceTime;
+            }
+            else
+                PushbuttonChanged(Pin - 2*VNUMENCODERS + VNUMMCPPUSHBUTTONS, Now);
+        }
     }
     return NULL;
 }
@@ -414,6 +546,8 @@ void* G2PanelTick(__attribute__((unused)) void *arg)
 //
 void SetupG2PanelGPIO(void)
 {
+    uint32_t Cntr;
+
     chip = NULL;
 
     //
@@ -447,7 +581,28 @@ void SetupG2PanelGPIO(void)
 
         printf("assigning line inputs for pushbuttons & encoders\n");
         gpiod_chip_get_lines(chip, PBIOPins, VNUMGPIO, &PBInLines);
-        gpiod_line_request_bulk(&PBInLines, &config, IOPinValues);
+        gpiod_line_request_bulk_both_edges_events(&PBInLines, consumer);
+        gpiod_line_get_value_bulk(&PBInLines, IOPinValues);
+
+        printf("assigning line input for MCP23017 interrupt\n");
+        MCPInt = gpiod_chip_get_line(chip, VMCPINTPIN);
+        gpiod_line_request_falling_edge_events(MCPInt, "MCP INT");
+
+        //
+        // the event thread waits on all of these
+        //
+        gpiod_line_bulk_init(&EventLines);
+        for(Cntr = 0; Cntr < VNUMGPIO; Cntr++)
+            gpiod_line_bulk_add(&EventLines, gpiod_line_bulk_get_line(&PBInLines, Cntr));
+        gpiod_line_bulk_add(&EventLines, VFO1);
+        gpiod_line_bulk_add(&EventLines, MCPInt);
+
+        //
+        // initial encoder states
+        //
+        for(Cntr=0; Cntr < VNUMENCODERS; Cntr++)
+            EncoderTick(Cntr, IOPinValues[2*Cntr], IOPinValues[2*Cntr+1]);
+        EncodersInitialised = true;
     }
 }
 
@@ -456,40 +611,26 @@ void SetupG2PanelGPIO(void)
 
 //
 // set MCP23017 to required state
+// IOCON.BANK = 0 so the A, B registers are interleaved at successive addresses,
+// and the register address auto increments: so the set up is 2 block writes.
 //
 void SetupG2PanelI2C(void)
 {
-  // setup IOCONA, B
-  if (i2c_write_byte_data(0x0A, 0x00) < 0) { return; }
-  if (i2c_write_byte_data(0x0B, 0x00) < 0) { return; }
-
-  // GPINTENA, B: disable interrupt
-  if (i2c_write_byte_data(0x04, 0x00) < 0) { return; }
-  if (i2c_write_byte_data(0x05, 0x00) < 0) { return; }
-
-  // DEFVALA, B: clear defaults
-  if (i2c_write_byte_data(0x06, 0x00) < 0) { return; }
-  if (i2c_write_byte_data(0x07, 0x00) < 0) { return; }
-
-  // OLATA, B: no output data
-  if (i2c_write_byte_data(0x14, 0x00) < 0) { return; }
-  if (i2c_write_byte_data(0x15, 0x00) < 0) { return; }
-
-  // set GPIOA, B to have pullups
-  if (i2c_write_byte_data(0x0C, 0xFF) < 0) { return; }
-  if (i2c_write_byte_data(0x0D, 0xFF) < 0) { return; }
-
-  // IOPOLA, B: non inverted polarity polarity
-  if (i2c_write_byte_data(0x02, 0x00) < 0) { return; }
-  if (i2c_write_byte_data(0x03, 0x00) < 0) { return; }
-
-  // IODIRA, B: set GPIOA/B for input
-  if (i2c_write_byte_data(0x00, 0xFF) < 0) { return; }
-  if (i2c_write_byte_data(0x01, 0xFF) < 0) { return; }
-
-  // INTCONA, B
-  if (i2c_write_byte_data(0x08, 0x00) < 0) { return; }
-  if (i2c_write_byte_data(0x09, 0x00) < 0) { return; }
+  const uint8_t Config[] =
+  {
+    0xFF, 0xFF,                                 // IODIRA, B: set GPIOA/B for input
+    0x00, 0x00,                                 // IPOLA, B: non inverted polarity polarity
+    0xFF, 0xFF,                                 // GPINTENA, B: interrupt on change for every input
+    0x00, 0x00,                                 // DEFVALA, B: clear defaults
+    0x00, 0x00,                                 // INTCONA, B: interrupt compares against the previous pin value
+    0x40, 0x40,                                 // IOCONA, B: MIRROR set so INTA is asserted for a change on either port
+    0xFF, 0xFF                                  // GPPUA, B: set GPIOA, B to have pullups
+  };
+  const uint8_t Outputs[] = {0x00, 0x00};       // OLATA, B: no output data
+
+  if (i2c_write_block_data(0x00, Config, sizeof(Config)) < 0) { return; }
+  if (i2c_write_block_data(0x14, Outputs, sizeof(Outputs)) < 0) { return; }
+  MCPData = 0xFFFF;                             // buttons expected to be released (1 input) at startup
 }
 
 
@@ -509,13 +650,10 @@ void InitialiseG2PanelHandler(void)
     SetupG2PanelI2C();
 
     G2PanelActive = true;                                   // enable threads
-    if(pthread_create(&VFOEncoderThread, NULL, VFOEventHandler, NULL) < 0)
-        perror("pthread_create VFO encoder");
-    pthread_detach(VFOEncoderThread);
-
-    if(pthread_create(&G2PanelTickThread, NULL, G2PanelTick, NULL) < 0)
-        perror("pthread_create G2 panel tick");
-    pthread_detach(G2PanelTickThread);
+    if(chip == NULL)
+        return;
+    if(!CreateManagedThread(&G2PanelEventThread, "G2 panel events", eHousekeepingThread, G2PanelEventHandler, NULL))
+        perror("pthread_create G2 panel events");
 }
 
 
@@ -530,6 +668,7 @@ void ShutdownG2PanelHandler(void)
         sleep(2);                                       // wait 2s to allow threads to close
         gpiod_line_release(VFO1);
         gpiod_line_release(VFO2);
+        gpiod_line_release(MCPInt);
         gpiod_line_release_bulk(&PBInLines);
         gpiod_chip_close(chip);
     }
@@ -43,6 +43,7 @@
 #include "i2cdriver.h"
 #include "andromedacatmessages.h"
 #include "AriesATU.h"
+#include "housekeeping.h"
 
 
 bool G2V2PanelControlled = false;
@@ -54,17 +55,17 @@ bool GZZZIReceived = false;                         // true if a ZZZI message re
 
 extern int i2c_fd;                                  // file reference
 char* gpio_dev = NULL;
-pthread_t G2V2PanelTickThread;                      // thread with periodic tick
-pthread_t G2V2PanelSerialThread;                    // thread wfor serial read from panel
+int G2V2PanelTickTimer = -1;                        // housekeeping timer for the periodic tick
 pthread_t G2V1AdapterSerialThread;                    // thread wfor serial read from panel
 uint8_t G2V2PanelSWID;
 uint8_t G2V2PanelHWVersion;
 uint8_t G2V2PanelProductID;
-uint8_t CATPollCntr;                                // determines which message to poll for
 bool G2ToneState;                                   // true if 2 tone test in progress
 bool GVFOBSelected;                                 // true if VFO B selected
 uint32_t GCombinedVFOState;                         // reported VFO state bits
 uint16_t GLEDState;                                 // LED state settings
+pthread_mutex_t G2V2LEDMutex = PTHREAD_MUTEX_INITIALIZER;
+bool GZZXVHeard, GZZUTHeard, GZZYRHeard;            // true if state reported since the last poll
 TSerialThreadData G2V2Data;                         // data for G2V2 read thread
 bool ATURedLED = false;
 bool ATUGreenLED = false;                           // LED states
@@ -137,9 +138,8 @@ bool CheckG2V2PanelPresent(void)
         G2V2Data.RequestID = true;
         G2V2Data.Device = eG2V2Panel;
 
-        if(pthread_create(&G2V2PanelSerialThread, NULL, CATSerial, (void *)&G2V2Data) < 0)
-            perror("pthread_create G2V2 serial thread");
-        pthread_detach(G2V2PanelSerialThread);
+        if(!AddSerialCATDevice(&G2V2Data))
+            printf("G2V2 serial device not opened\n");
 
 
         sleep(2);
@@ -152,7 +152,7 @@ bool CheckG2V2PanelPresent(void)
             Result = true;
         }
         else
-            G2V2Data.DeviceActive = false;
+            RemoveSerialCATDevice(&G2V2Data);
     }
 
     return Result;
@@ -160,17 +160,76 @@ bool CheckG2V2PanelPresent(void)
 
 
 #define VNUMG2V2INDICATORS 9
+#define VG2V2TICK 250                               // tick period, ms
+#define VG2V2POLLTICKS 4                            // ticks between fallback state polls (1s)
+
+
+//
+// Set LEDs from values reported by CAT messages
+// called whenever a reported state changes: LEDs that differ from what we had before
+// are sent as ZZZI messages. ATU tune LEDs are internal to P2app, not Thetis.
+// only send to G2V2, not to G2V1 adapter because it has no LEDs
+//
+static void UpdateG2V2LEDs(void)
+{
+    uint32_t NewLEDStates = 0;
+    uint32_t Changed;
+    int Cntr;
+    int Param;
+
+    if(GZZZIReceived)                                   // client app is driving the indicators itself
+        return;
+    pthread_mutex_lock(&G2V2LEDMutex);
+    if((GCombinedVFOState & (1<<6)) != 0)
+        NewLEDStates |= 1;                          // MOX bit
+    if((GCombinedVFOState & (1<<7)) != 0)
+        NewLEDStates |= (1 << 1);                   // TUNE bit
+    if(G2ToneState)
+        NewLEDStates |= (1 << 2);                   // 2 tone bit
+    if(ATURedLED)
+        NewLEDStates |= (1 << 3);                   // red ATU bit
+    if(ATUGreenLED)
+        NewLEDStates |= (1 << 4);                   // green ATU bit
+    if((GCombinedVFOState & (1<<8)) != 0)
+        NewLEDStates |= (1 << 6);                   // XIT bit
+    if((GCombinedVFOState & (1<<0)) != 0)
+        NewLEDStates |= (1 << 5);                   // RIT bit
+    if(!GVFOBSelected)
+        NewLEDStates |= (1 << 7);                   // led lit if VFO A selected
+
+    if((((GCombinedVFOState & (1<<2)) != 0) && GVFOBSelected) ||
+    (((GCombinedVFOState & (1<<1)) != 0) && !GVFOBSelected))
+        NewLEDStates |= (1 << 8);                   // VFO Lock bit
+
+//
+// send a ZZZI message for each bit that has changed
+//
+    Changed = NewLEDStates ^ GLEDState;
+    GLEDState = NewLEDStates;
+    while(Changed != 0)
+    {
+        Cntr = __builtin_ctz(Changed);
+        Changed &= Changed - 1;                     // clear lowest changed bit
+        Param = ((Cntr +1)* 10) + ((NewLEDStates >> Cntr) & 1);
+        if(G2V2Data.IsOpen)
+            MakeCATMessageNumeric(G2V2Data.DeviceHandle, eZZZI, Param);
+    }
+    pthread_mutex_unlock(&G2V2LEDMutex);
+}
 
 
 
 //
 // periodic timestep
+// LEDs are updated as the CAT state messages arrive, so this only sends the panel ID
+// when CAT becomes available, and polls as a slow fallback for any state that the client
+// hasn't reported in the last second. Runs as a housekeeping timer.
 //
-void* G2V2PanelTick(__attribute__((unused)) void *arg)
+static void G2V2PanelTick(__attribute__((unused)) void *arg)
 {
-    uint32_t NewLEDStates = 0;
+    static uint32_t TickCount = 0;
 
-    while(G2V2PanelActive)
+    if(G2V2PanelActive)
     {
         if(CATPortAssigned)                     // see if CAT has become available for the 1st time
         {
@@ -185,83 +244,18 @@ void* G2V2PanelTick(__attribute__((unused)) void *arg)
 //
 // poll CAT, if we haven't been sent an indicator message
 //
-        if(GZZZIReceived == false)
-            switch(CATPollCntr++)
-            {
-                case 0:
-                    MakeCATMessageNoParam(DESTTCPCATPORT, eZZXV);
-                    break;
-
-                case 1:
-                    MakeCATMessageNoParam(DESTTCPCATPORT, eZZUT);
-                    break;
-
-                case 2:
-                    MakeCATMessageNoParam(DESTTCPCATPORT, eZZYR);
-                    break;
-
-                default:
-                    CATPollCntr = 0;
-                    break;
-            }
-//
-// Set LEDs from values reported by CAT messages
-// store into NewLEDStates; then set to I2C create ZZZI if different from what we had before
-// ATU tune LEDs are internal to P2app, not Thetis
-//
-        if(GZZZIReceived == false)
+        if((GZZZIReceived == false) && (++TickCount >= VG2V2POLLTICKS))
         {
-            NewLEDStates = 0;
-            if((GCombinedVFOState & (1<<6)) != 0)
-                NewLEDStates |= 1;                          // MOX bit
-            if((GCombinedVFOState & (1<<7)) != 0)
-                NewLEDStates |= (1 << 1);                   // TUNE bit
-            if(G2ToneState)
-                NewLEDStates |= (1 << 2);                   // 2 tone bit
-            if(ATURedLED)
-                NewLEDStates |= (1 << 3);                   // red ATU bit
-            if(ATUGreenLED)
-                NewLEDStates |= (1 << 4);                   // green ATU bit
-            if((GCombinedVFOState & (1<<8)) != 0)
-                NewLEDStates |= (1 << 6);                   // XIT bit
-            if((GCombinedVFOState & (1<<0)) != 0)
-                NewLEDStates |= (1 << 5);                   // RIT bit
-            if(!GVFOBSelected)
-                NewLEDStates |= (1 << 7);                   // led lit if VFO A selected
-
-            if((((GCombinedVFOState & (1<<2)) != 0) && GVFOBSelected) ||
-            (((GCombinedVFOState & (1<<1)) != 0) && !GVFOBSelected))
-                NewLEDStates |= (1 << 8);                   // VFO Lock bit
-
-//
-// now loop through to find differences
-// do bitwise compares; if differences found, send a ZZZI message
-// only send to G2V2, not to G2V1 adapter because it has no LEDs
-//
-            int Cntr;
-            int Mask = 1;
-            int NewState;
-            int Param;
-
-            for(Cntr=0; Cntr < VNUMG2V2INDICATORS; Cntr++)
-            {
-                if((NewLEDStates & Mask) != (GLEDState & Mask))
-                {
-                    NewState = (NewLEDStates & Mask) >> Cntr;
-                    Param = ((Cntr +1)* 10) + NewState;
-                    if(G2V2Data.IsOpen)
-                        MakeCATMessageNumeric(G2V2Data.DeviceHandle, eZZZI, Param);
-
-                }
-                Mask = Mask << 1;                               // bitmask for next bit
-            }
-            GLEDState = NewLEDStates;
+            TickCount = 0;
+            if(!GZZXVHeard)
+                MakeCATMessageNoParam(DESTTCPCATPORT, eZZXV);
+            if(!GZZUTHeard)
+                MakeCATMessageNoParam(DESTTCPCATPORT, eZZUT);
+            if(!GZZYRHeard)
+                MakeCATMessageNoParam(DESTTCPCATPORT, eZZYR);
+            GZZXVHeard = GZZUTHeard = GZZYRHeard = false;
         }
-
-        usleep(100000);                                                  // 100ms period
-
     }
-    return NULL;
 }
 
 
@@ -269,28 +263,29 @@ void* G2V2PanelTick(__attribute__((unused)) void *arg)
 //
 // function to initialise a connection to the G2 V2 front panel; call if selected as a command line option
 // this is called *after* the G2V2 panel has been discovered.
-// create threads for tick
+// add a housekeeping timer for the tick
 //
 void InitialiseG2V2PanelHandler(void)
 {
     G2V2PanelControlled = true;
     printf("Initialising G2V2 panel handler\n");
     G2V2PanelActive = true;
+    UpdateG2V2LEDs();                                   // initial LED states
 
-    if(pthread_create(&G2V2PanelTickThread, NULL, G2V2PanelTick, NULL) < 0)
-        perror("pthread_create G2 panel tick");
-    pthread_detach(G2V2PanelTickThread);
+    G2V2PanelTickTimer = AddHousekeepingTimer("G2V2 panel tick", VG2V2TICK, G2V2PanelTick, NULL);
 }
 
 
 //
 // function to shutdown a connection to the G2 front panel; call if selected as a command line option
-// serial files closed by setting DeviceActive to false; the thread then closes the file. 
+// serial files closed by RemoveSerialCATDevice(); the serial I/O thread then closes the file. 
 //
 void ShutdownG2V2PanelHandler(void)
 {
     G2V2PanelActive = false;
-    G2V2Data.DeviceActive = false;
+    RemoveHousekeepingTimer(G2V2PanelTickTimer);
+    G2V2PanelTickTimer = -1;
+    RemoveSerialCATDevice(&G2V2Data);
     sleep(1);
 }
 
@@ -300,7 +295,12 @@ void ShutdownG2V2PanelHandler(void)
 //
 void SetG2V2ZZUTState(bool NewState)
 {
-    G2ToneState = NewState;
+    GZZUTHeard = true;
+    if(G2ToneState != NewState)
+    {
+        G2ToneState = NewState;
+        UpdateG2V2LEDs();
+    }
 }
 
 
@@ -309,7 +309,12 @@ void SetG2V2ZZUTState(bool NewState)
 //
 void SetG2V2ZZYRState(bool NewState)
 {
-    GVFOBSelected = NewState;
+    GZZYRHeard = true;
+    if(GVFOBSelected != NewState)
+    {
+        GVFOBSelected = NewState;
+        UpdateG2V2LEDs();
+    }
 }
 
 
@@ -319,7 +324,12 @@ void SetG2V2ZZYRState(bool NewState)
 //
 void SetG2V2ZZXVState(uint32_t NewState)
 {
-    GCombinedVFOState = NewState;
+    GZZXVHeard = true;
+    if(GCombinedVFOState != NewState)
+    {
+        GCombinedVFOState = NewState;
+        UpdateG2V2LEDs();
+    }
 }
 
 
@@ -399,8 +409,12 @@ bool IsFrontPanelSerial(int32_t Handle)
 //
 void SetATULEDs(bool GreenLED, bool RedLED)
 {
-    ATURedLED = RedLED;
-    ATUGreenLED = GreenLED;
+    if((ATURedLED != RedLED) || (ATUGreenLED != GreenLED))
+    {
+        ATURedLED = RedLED;
+        ATUGreenLED = GreenLED;
+        UpdateG2V2LEDs();
+    }
 }
 
 
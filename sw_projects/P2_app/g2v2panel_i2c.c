@@ -43,6 +43,7 @@
 #include "i2cdriver.h"
 #include "gpiod.h"
 #include "andromedacatmessages.h"
+#include "threadmanager.h"
 
 
 bool G2V2PanelControlled = false;
@@ -189,7 +190,8 @@ void G2V2PanelInterrupt(__attribute__((unused)) void *arg)
     uint8_t EventData;
     int8_t Steps;
     bool Error;
-    struct timespec ts = {1, 0};                                    // timeout time = 1s
+    struct timespec ts;
+    uint32_t Wait;
     struct gpiod_line_event intevent;
     uint8_t Encoder;
     bool ThetisPBShift;
@@ -202,6 +204,14 @@ void G2V2PanelInterrupt(__attribute__((unused)) void *arg)
 //
     while(G2V2PanelActive)
     {
+        //
+        // timeout 1s, or sooner if coalesced VFO steps are due to be sent
+        //
+        Wait = SendCoalescedVFOSteps();
+        if(Wait > 1000)
+            Wait = 1000;
+        ts.tv_sec = Wait / 1000;
+        ts.tv_nsec = (Wait % 1000) * 1000000L;
         Retval = gpiod_line_event_wait(intline, &ts);                   // wait for interrupt from Arduino
         if(Retval > 0)                                                  // if event occurred ie not timeout
         {
@@ -228,7 +238,7 @@ void G2V2PanelInterrupt(__attribute__((unused)) void *arg)
                         case VVFOSTEP:
                             Steps = (int8_t)(EventData);
                             Steps |= ((Steps & 0x40) << 1);         // sign extend
-                            MakeVFOEncoderCAT(Steps);
+                            QueueVFOEncoderSteps(Steps);
                             break;
 
                         case VENCODERSTEP:
@@ -385,13 +395,11 @@ void InitialiseG2V2PanelHandler(void)
     SetupG2V2PanelI2C();
     G2V2PanelActive = true;
 
-    if(pthread_create(&G2V2PanelTickThread, NULL, G2V2PanelTick, NULL) < 0)
+    if(!CreateManagedThread(&G2V2PanelTickThread, "G2V2 panel tick", eHousekeepingThread, G2V2PanelTick, NULL))
         perror("pthread_create G2 panel tick");
-    pthread_detach(G2V2PanelTickThread);
 
-    if(pthread_create(&G2V2PanelInterruptThread, NULL, G2V2PanelInterrupt, NULL) < 0)
+    if(!CreateManagedThread(&G2V2PanelInterruptThread, "G2V2 panel int", eHousekeepingThread, G2V2PanelInterrupt, NULL))
         perror("pthread_create G2 panel tick");
-    pthread_detach(G2V2PanelInterruptThread);
 }
 
 
@@ -20,6 +20,8 @@
 #include "generalpacket.h"
 #include "../common/saturnregisters.h"
 #include "Outwideband.h"
+#include "OutDDCIQ.h"
+#include "OutMicAudio.h"
 
 
 bool HW_Timer_Enable = true;
@@ -94,9 +96,18 @@ int HandleGeneralPacket(uint8_t *PacketBuffer)
   EnableTimeStamp((bool)(Byte&1));
   EnableVITA49((bool)(Byte&2));
   SetFreqPhaseWord((bool)(Byte&8));
+  SetAlignmentTimestamps((bool)(Byte&0x10));         // mic/DDC alignment timestamps (Saturn extension)
 
   Byte = *(uint8_t*)(PacketBuffer+38);                // enable timeout
   HW_Timer_Enable = ((bool)(Byte&1));
+
+  Byte = *(uint8_t*)(PacketBuffer+39);                // DDC packet format (Saturn extension; 0 = 24 bit)
+  SetDDCPacketFormat(Byte);
+
+  Byte = *(uint8_t*)(PacketBuffer+40);                // mic samples per packet / 64 (Saturn extension; 0 = 64)
+  SetMicFrameSize(Byte);
+
+  SetDDCPacketSamples(ntohs(*(uint16_t*)(PacketBuffer+41)));  // DDC samples per packet (Saturn extension; 0 = 238)
   
   Byte = *(uint8_t*)(PacketBuffer+58);                // flag bits
   SetPAEnabled((bool)(Byte&1));
@@ -0,0 +1,426 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// housekeeping.c:
+//
+// one housekeeping thread: periodic callbacks on a timer wheel, and watched fds
+//
+// the wheel has a list of timers for each slot: a timer due at tick T is in
+// slot T % VHKWHEELSLOTS, so a slot can also hold timers due a revolution or
+// more later. Each pass, the slots for the ticks since the last pass are walked,
+// and the timers that are due are moved on by their period. The timerfd is then
+// set for the 1st tick that has a timer due.
+//
+//////////////////////////////////////////////////////////////
+
+#include "housekeeping.h"
+#include "threadmanager.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <syscall.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+
+#define VHKEVENTTIMER 0xFFFFFFFE                // epoll identifiers; fds use their table entry
+#define VHKEVENTWAKE 0xFFFFFFFF
+
+
+struct HousekeepingTimer
+{
+    const char* Name;
+    THousekeepingTimer Callback;
+    void* Arg;
+    uint32_t Period;                            // ticks
+    uint64_t Expiry;                            // tick when next due
+    int Next;                                   // next timer in the same slot; -1 = end of list
+    bool InUse;
+};
+
+struct HousekeepingFd
+{
+    int fd;
+    THousekeepingFdHandler Handler;
+    void* Arg;
+    bool InUse;
+};
+
+struct DueTimer
+{
+    THousekeepingTimer Callback;
+    void* Arg;
+};
+
+
+static struct HousekeepingTimer Timers[VHKMAXTIMERS];
+static int WheelSlots[VHKWHEELSLOTS];           // 1st timer in each slot; -1 = empty
+static uint64_t WheelTick;                      // last tick processed
+static struct HousekeepingFd Fds[VHKMAXFDS];
+static pthread_mutex_t HousekeepingMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t HousekeepingOnce = PTHREAD_ONCE_INIT;
+static struct timespec StartTime;               // tick 0
+static int Epoll_fd = -1;
+static int Timer_fd = -1;
+static int Wake_fd = -1;
+
+
+//
+// ticks since StartTime
+//
+static uint64_t HousekeepingTickNow(void)
+{
+    struct timespec Now;
+    uint64_t Ms;
+
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    Ms = (uint64_t)(Now.tv_sec - StartTime.tv_sec) * 1000 + (Now.tv_nsec - StartTime.tv_nsec) / 1000000;
+    return Ms / VHKTICKMS;
+}
+
+
+//
+// create the epoll set, timerfd and wake event. Runs once, from whichever call is first.
+//
+static void InitialiseHousekeeping(void)
+{
+    struct epoll_event Event;
+    uint32_t Cntr;
+
+    clock_gettime(CLOCK_MONOTONIC, &StartTime);
+    WheelTick = 0;
+    for(Cntr = 0; Cntr < VHKWHEELSLOTS; Cntr++)
+        WheelSlots[Cntr] = -1;
+    Epoll_fd = epoll_create1(0);
+    Timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    Wake_fd = eventfd(0, EFD_NONBLOCK);
+    if((Epoll_fd < 0) || (Timer_fd < 0) || (Wake_fd < 0))
+    {
+        perror("housekeeping epoll setup");
+        return;
+    }
+    memset(&Event, 0, sizeof(Event));
+    Event.events = EPOLLIN;
+    Event.data.u32 = VHKEVENTTIMER;
+    epoll_ctl(Epoll_fd, EPOLL_CTL_ADD, Timer_fd, &Event);
+    Event.data.u32 = VHKEVENTWAKE;
+    epoll_ctl(Epoll_fd, EPOLL_CTL_ADD, Wake_fd, &Event);
+}
+
+
+//
+// wake the thread to set the timerfd again
+//
+static void WakeHousekeeping(void)
+{
+    uint64_t One = 1;
+
+    if(Wake_fd >= 0)
+        if(write(Wake_fd, &One, sizeof(One)) < 0)
+            perror("housekeeping wake");
+}
+
+
+//
+// add a timer to, or take it from, its slot's list. Called with the mutex held
+//
+static void LinkTimer(int Timer)
+{
+    uint32_t Slot = Timers[Timer].Expiry & (VHKWHEELSLOTS - 1);
+
+    Timers[Timer].Next = WheelSlots[Slot];
+    WheelSlots[Slot] = Timer;
+}
+
+
+static void UnlinkTimer(int Timer)
+{
+    int* Link = &WheelSlots[Timers[Timer].Expiry & (VHKWHEELSLOTS - 1)];
+
+    while(*Link != -1)
+    {
+        if(*Link == Timer)
+        {
+            *Link = Timers[Timer].Next;
+            break;
+        }
+        Link = &Timers[*Link].Next;
+    }
+}
+
+
+//
+// walk the slots for the ticks since the last pass, and move each timer that is due
+// on by its period (ticks missed while the thread was busy are skipped).
+// the due callbacks are copied to Due, to be called without the mutex held.
+// returns the number due. Called with the mutex held
+//
+static uint32_t CollectDueTimers(uint64_t Now, struct DueTimer* Due)
+{
+    uint32_t Count = 0;
+    uint64_t Tick;
+    int Timer, Next;
+
+    Tick = WheelTick + 1;
+    if(Now - WheelTick > VHKWHEELSLOTS)
+        Tick = Now - VHKWHEELSLOTS + 1;                     // every slot is walked once at most
+    for(; Tick <= Now; Tick++)
+    {
+        for(Timer = WheelSlots[Tick & (VHKWHEELSLOTS - 1)]; Timer != -1; Timer = Next)
+        {
+            Next = Timers[Timer].Next;
+            if(Timers[Timer].Expiry > Now)                  // a later revolution
+                continue;
+            UnlinkTimer(Timer);
+            Due[Count].Callback = Timers[Timer].Callback;
+            Due[Count].Arg = Timers[Timer].Arg;
+            Count++;
+            Timers[Timer].Expiry += Timers[Timer].Period;
+            if(Timers[Timer].Expiry <= Now)
+                Timers[Timer].Expiry = Now + Timers[Timer].Period;
+            LinkTimer(Timer);
+        }
+    }
+    WheelTick = Now;
+    return Count;
+}
+
+
+//
+// find the next tick with a timer due: the 1st slot with one, looking a revolution
+// ahead; else (only long periods) the earliest of all. Returns 0 if there are no timers.
+// Called with the mutex held
+//
+static uint64_t NextTimerTick(uint64_t Now)
+{
+    uint64_t Tick;
+    uint64_t Earliest = 0;
+    int Timer;
+
+    for(Tick = Now + 1; Tick <= Now + VHKWHEELSLOTS; Tick++)
+        for(Timer = WheelSlots[Tick & (VHKWHEELSLOTS - 1)]; Timer != -1; Timer = Timers[Timer].Next)
+            if(Timers[Timer].Expiry == Tick)
+                return Tick;
+    for(Timer = 0; Timer < VHKMAXTIMERS; Timer++)
+        if(Timers[Timer].InUse && ((Earliest == 0) || (Timers[Timer].Expiry < Earliest)))
+            Earliest = Timers[Timer].Expiry;
+    return Earliest;
+}
+
+
+//
+// set the timerfd for a tick (0 = stop it)
+//
+static void SetHousekeepingTimerfd(uint64_t Tick)
+{
+    struct itimerspec Time;
+    uint64_t Ms;
+
+    memset(&Time, 0, sizeof(Time));
+    if(Tick != 0)
+    {
+        Ms = Tick * VHKTICKMS;
+        Time.it_value.tv_sec = StartTime.tv_sec + Ms / 1000;
+        Time.it_value.tv_nsec = StartTime.tv_nsec + (Ms % 1000) * 1000000L;
+        if(Time.it_value.tv_nsec >= 1000000000L)
+        {
+            Time.it_value.tv_sec++;
+            Time.it_value.tv_nsec -= 1000000000L;
+        }
+    }
+    timerfd_settime(Timer_fd, TFD_TIMER_ABSTIME, &Time, NULL);
+}
+
+
+//
+// the housekeeping thread
+// each pass: run the timers due, set the timerfd for the next, then wait for it,
+// a wake (a timer added) or a watched fd
+//
+static void* HousekeepingThread(__attribute__((unused)) void *arg)
+{
+    struct DueTimer Due[VHKMAXTIMERS];
+    struct epoll_event Events[VHKMAXFDS + 2];
+    struct HousekeepingFd Entry;
+    uint64_t Now;
+    uint64_t Discard;
+    uint32_t Count;
+    uint32_t Cntr;
+    int Ready;
+    int Event;
+
+    printf("spinning up housekeeping thread, pid=%ld\n", syscall(SYS_gettid));
+    while(true)
+    {
+        pthread_mutex_lock(&HousekeepingMutex);
+        Now = HousekeepingTickNow();
+        Count = CollectDueTimers(Now, Due);
+        SetHousekeepingTimerfd(NextTimerTick(Now));
+        pthread_mutex_unlock(&HousekeepingMutex);
+        for(Cntr = 0; Cntr < Count; Cntr++)
+            Due[Cntr].Callback(Due[Cntr].Arg);
+
+        Ready = epoll_wait(Epoll_fd, Events, VHKMAXFDS + 2, -1);
+        if(Ready < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            perror("housekeeping epoll_wait");
+            break;
+        }
+        for(Event = 0; Event < Ready; Event++)
+        {
+            if(Events[Event].data.u32 == VHKEVENTTIMER)
+            {
+                if(read(Timer_fd, &Discard, sizeof(Discard)) < 0 && (errno != EAGAIN))
+                    perror("housekeeping timerfd read");
+            }
+            else if(Events[Event].data.u32 == VHKEVENTWAKE)
+            {
+                if(read(Wake_fd, &Discard, sizeof(Discard)) < 0 && (errno != EAGAIN))
+                    perror("housekeeping wake read");
+            }
+            else if(Events[Event].data.u32 < VHKMAXFDS)
+            {
+                pthread_mutex_lock(&HousekeepingMutex);
+                Entry = Fds[Events[Event].data.u32];
+                pthread_mutex_unlock(&HousekeepingMutex);
+                if(Entry.InUse)
+                    Entry.Handler(Entry.fd, Entry.Arg);
+            }
+        }
+    }
+    return NULL;
+}
+
+
+//
+// bool StartHousekeeping(void)
+// start the housekeeping thread
+//
+bool StartHousekeeping(void)
+{
+    pthread_once(&HousekeepingOnce, InitialiseHousekeeping);
+    if(Epoll_fd < 0)
+        return false;
+    return CreateManagedThread(NULL, "housekeeping", eHousekeepingThread, HousekeepingThread, NULL);
+}
+
+
+//
+// int AddHousekeepingTimer(const char* Name, uint32_t PeriodMs, THousekeepingTimer Callback, void* Arg)
+// add a periodic timer. returns its number, or -1 if none free
+//
+int AddHousekeepingTimer(const char* Name, uint32_t PeriodMs, THousekeepingTimer Callback, void* Arg)
+{
+    int Timer;
+
+    pthread_once(&HousekeepingOnce, InitialiseHousekeeping);
+    pthread_mutex_lock(&HousekeepingMutex);
+    for(Timer = 0; Timer < VHKMAXTIMERS; Timer++)
+        if(!Timers[Timer].InUse)
+            break;
+    if(Timer == VHKMAXTIMERS)
+    {
+        pthread_mutex_unlock(&HousekeepingMutex);
+        printf("no free housekeeping timer for %s\n", Name);
+        return -1;
+    }
+    Timers[Timer].Name = Name;
+    Timers[Timer].Callback = Callback;
+    Timers[Timer].Arg = Arg;
+    Timers[Timer].Period = (PeriodMs + VHKTICKMS - 1) / VHKTICKMS;
+    if(Timers[Timer].Period == 0)
+        Timers[Timer].Period = 1;
+    Timers[Timer].Expiry = HousekeepingTickNow() + Timers[Timer].Period;
+    if(Timers[Timer].Expiry <= WheelTick)                   // (the thread hasn't caught up yet)
+        Timers[Timer].Expiry = WheelTick + 1;
+    Timers[Timer].InUse = true;
+    LinkTimer(Timer);
+    pthread_mutex_unlock(&HousekeepingMutex);
+    WakeHousekeeping();
+    return Timer;
+}
+
+
+//
+// void RemoveHousekeepingTimer(int Timer)
+// stop a timer
+//
+void RemoveHousekeepingTimer(int Timer)
+{
+    if((Timer < 0) || (Timer >= VHKMAXTIMERS))
+        return;
+    pthread_mutex_lock(&HousekeepingMutex);
+    if(Timers[Timer].InUse)
+    {
+        UnlinkTimer(Timer);
+        Timers[Timer].InUse = false;
+    }
+    pthread_mutex_unlock(&HousekeepingMutex);
+}
+
+
+//
+// bool AddHousekeepingFd(int fd, THousekeepingFdHandler Handler, void* Arg)
+// watch a file descriptor
+//
+bool AddHousekeepingFd(int fd, THousekeepingFdHandler Handler, void* Arg)
+{
+    struct epoll_event Event;
+    uint32_t Entry;
+    bool Result = false;
+
+    pthread_once(&HousekeepingOnce, InitialiseHousekeeping);
+    if(Epoll_fd < 0)
+        return false;
+    pthread_mutex_lock(&HousekeepingMutex);
+    for(Entry = 0; Entry < VHKMAXFDS; Entry++)
+        if(!Fds[Entry].InUse)
+            break;
+    if(Entry != VHKMAXFDS)
+    {
+        memset(&Event, 0, sizeof(Event));
+        Event.events = EPOLLIN;
+        Event.data.u32 = Entry;
+        if(epoll_ctl(Epoll_fd, EPOLL_CTL_ADD, fd, &Event) == 0)
+        {
+            Fds[Entry].fd = fd;
+            Fds[Entry].Handler = Handler;
+            Fds[Entry].Arg = Arg;
+            Fds[Entry].InUse = true;
+            Result = true;
+        }
+    }
+    pthread_mutex_unlock(&HousekeepingMutex);
+    return Result;
+}
+
+
+//
+// void RemoveHousekeepingFd(int fd)
+// stop watching a file descriptor
+//
+void RemoveHousekeepingFd(int fd)
+{
+    uint32_t Entry;
+
+    pthread_mutex_lock(&HousekeepingMutex);
+    for(Entry = 0; Entry < VHKMAXFDS; Entry++)
+        if(Fds[Entry].InUse && (Fds[Entry].fd == fd))
+        {
+            epoll_ctl(Epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+            Fds[Entry].InUse = false;
+        }
+    pthread_mutex_unlock(&HousekeepingMutex);
+}
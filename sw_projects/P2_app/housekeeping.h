@@ -0,0 +1,82 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// housekeeping.h:
+//
+// header: one housekeeping thread for the low priority periodic work
+// (activity check, exit command, Aries ATU and G2V2 panel ticks) in place
+// of a thread each sleeping in a loop.
+// periodic callbacks are kept on a timer wheel with VHKTICKMS resolution, and
+// the thread sleeps on one timerfd set for the next timer due, so there is
+// one wakeup for all the timers due at a time, and none while nothing is due.
+// file descriptors (eg stdin) can be watched by the same thread.
+// callbacks run on the housekeeping thread, one at a time, and must not block
+// for long: every other timer waits for them.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __housekeeping_h
+#define __housekeeping_h
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#define VHKTICKMS 10                            // timer wheel resolution
+#define VHKWHEELSLOTS 256                       // wheel slots (2.56s); a power of 2
+#define VHKMAXTIMERS 16
+#define VHKMAXFDS 4
+
+
+typedef void (*THousekeepingTimer)(void* Arg);
+typedef void (*THousekeepingFdHandler)(int fd, void* Arg);
+
+
+//
+// bool StartHousekeeping(void)
+// start the housekeeping thread. Timers and fds can be added before or after this.
+// returns false if the thread could not be started
+//
+bool StartHousekeeping(void);
+
+
+//
+// int AddHousekeepingTimer(const char* Name, uint32_t PeriodMs, THousekeepingTimer Callback, void* Arg)
+// call Callback(Arg) every PeriodMs (rounded up to the wheel tick), the 1st time
+// PeriodMs from now. Name is used in messages.
+// returns a timer number for RemoveHousekeepingTimer(), or -1 if there are no free timers
+//
+int AddHousekeepingTimer(const char* Name, uint32_t PeriodMs, THousekeepingTimer Callback, void* Arg);
+
+
+//
+// void RemoveHousekeepingTimer(int Timer)
+// stop a timer. A callback can remove its own timer. If removed from another
+// thread, the callback may already have been started, and run once more.
+//
+void RemoveHousekeepingTimer(int Timer);
+
+
+//
+// bool AddHousekeepingFd(int fd, THousekeepingFdHandler Handler, void* Arg)
+// call Handler(fd, Arg) when fd is readable (or at end of file, or error).
+// returns false if the fd can't be watched (eg a regular file)
+//
+bool AddHousekeepingFd(int fd, THousekeepingFdHandler Handler, void* Arg);
+
+
+//
+// void RemoveHousekeepingFd(int fd)
+// stop watching fd. The caller closes it.
+//
+void RemoveHousekeepingFd(int fd);
+
+
+#endif
@@ -21,6 +21,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <linux/i2c-dev.h>
+#include <linux/i2c.h>
 #include <i2c/smbus.h>
 #include <sys/ioctl.h>
 #include <fcntl.h>
@@ -28,6 +29,20 @@
 
 #include "i2cdriver.h"
 extern int i2c_fd;                                  // file reference
+static uint16_t i2c_address = 0;                    // slave address, for I2C_RDWR transfers
+
+
+//
+// select the slave device for the i2c transfers that follow
+//
+int i2c_select_device(uint16_t address)
+{
+  int rc;
+
+  if ((rc = ioctl(i2c_fd, I2C_SLAVE, address)) >= 0)
+    i2c_address = address;
+  return rc;
+}
 
 
 //
@@ -98,3 +113,64 @@ uint16_t i2c_read_word_data(uint8_t reg, bool *error)
   }
   return (uint16_t) (data & 0xFFFF);
 }
+
+
+
+//
+// combined transfer: all the message segments in one I2C_RDWR ioctl,
+// with repeated starts between them and one stop at the end
+//
+int i2c_transfer(struct i2c_msg* msgs, uint32_t count)
+{
+  struct i2c_rdwr_ioctl_data transfer;
+  int rc;
+
+  transfer.msgs = msgs;
+  transfer.nmsgs = count;
+  if ((rc = ioctl(i2c_fd, I2C_RDWR, &transfer)) < 0)
+  {
+    printf("%s: i2c transfer failed: slave=%02X, errno=%d\n", __FUNCTION__, i2c_address, errno);
+  }
+  return rc;
+}
+
+
+//
+// block write: register address then length bytes, to successive registers
+// (for devices that auto increment the register address, eg MCP23017)
+//
+int i2c_write_block_data(uint8_t reg, const uint8_t* data, uint16_t length)
+{
+  uint8_t buffer[VI2CMAXBLOCK + 1];
+  struct i2c_msg msg;
+
+  if (length > VI2CMAXBLOCK)
+    return -1;
+  buffer[0] = reg;
+  memcpy(buffer + 1, data, length);
+  msg.addr = i2c_address;
+  msg.flags = 0;
+  msg.len = length + 1;
+  msg.buf = buffer;
+  return i2c_transfer(&msg, 1);
+}
+
+
+//
+// block read: write register address, then read length bytes from successive registers
+// in a single transfer
+//
+int i2c_read_block_data(uint8_t reg, uint8_t* data, uint16_t length)
+{
+  struct i2c_msg msgs[2];
+
+  msgs[0].addr = i2c_address;
+  msgs[0].flags = 0;
+  msgs[0].len = 1;
+  msgs[0].buf = &reg;
+  msgs[1].addr = i2c_address;
+  msgs[1].flags = I2C_M_RD;
+  msgs[1].len = length;
+  msgs[1].buf = data;
+  return i2c_transfer(msgs, 2);
+}
@@ -45,5 +45,33 @@ uint8_t i2c_read_byte_data(uint8_t reg, bool *error);
 uint16_t i2c_read_word_data(uint8_t reg, bool *error); 
 
 
+//
+// batched transfers, each in a single I2C_RDWR ioctl
+//
+#define VI2CMAXBLOCK 32                 // most bytes in one block write
+
+struct i2c_msg;
+
+//
+// select the slave device for the transfers that follow
+//
+int i2c_select_device(uint16_t address);
+
+//
+// combined transfer of several message segments (repeated start between them)
+//
+int i2c_transfer(struct i2c_msg* msgs, uint32_t count);
+
+//
+// write length bytes to successive registers, starting at reg
+//
+int i2c_write_block_data(uint8_t reg, const uint8_t* data, uint16_t length);
+
+//
+// read length bytes from successive registers, starting at reg
+//
+int i2c_read_block_data(uint8_t reg, uint8_t* data, uint16_t length);
+
+
 
 #endif  //#ifndef
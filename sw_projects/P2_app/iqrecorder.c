@@ -0,0 +1,700 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// iqrecorder.c:
+// local recorder of DDC I/Q samples to SigMF files
+//
+//////////////////////////////////////////////////////////////
+
+#include "iqrecorder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+#include <syscall.h>
+#include <linux/aio_abi.h>
+#include "../common/saturnregisters.h"
+#include "../common/spscring.h"
+#include "threadmanager.h"
+
+
+#define VIQRECORDNAMESIZE 256                   // longest file path
+#define VIQRECORDDIRSIZE 192                    // longest directory name
+#define VIQRECORDIDLESLEEP 10000                // us writer sleep when not recording
+#define VIQRECORDPOLLTIME 2000                  // us writer wait for completions if no packets waiting
+#define VIQRECORDWRITEWAIT 1000000              // us wait for a write to complete when a buffer is needed
+#define VIQRECORDBYTESIN 6                      // bytes per I/Q sample in a packet: 24 bit I, 24 bit Q
+#define VIQRECORDBYTESOUT 8                     // bytes per I/Q sample in the file: ci32_be
+#define VIQRECORDMAXINFLIGHT (VNUMDDC * VIQRECORDBUFFERS)
+
+
+//
+// one packet of samples passed from the DDC decode to the writer
+//
+struct IQRecordPacket
+{
+    uint64_t StreamIndex;                       // DDC sample count before the 1st sample
+    uint32_t SampleRate;                        // Hz
+    uint32_t SampleCount;                       // I/Q samples in Data
+    uint8_t Data[VIQRECORDMAXSAMPLES * VIQRECORDBYTESIN];
+};
+
+
+//
+// one aligned file write buffer
+//
+struct IQRecordBuffer
+{
+    uint8_t* Data;                              // VIQRECORDBUFFERSIZE bytes, VIQRECORDALIGN aligned
+    struct iocb Request;
+    struct IQRecordDDC* Owner;
+    uint32_t Length;                            // bytes being written
+    bool Busy;                                  // write in flight
+};
+
+
+//
+// one SigMF capture segment
+//
+struct IQRecordCapture
+{
+    uint64_t SampleStart;                       // sample index in the file
+    uint64_t GlobalIndex;                       // DDC sample count of that sample
+    uint32_t Frequency;                         // DDC frequency, Hz
+};
+
+
+//
+// the recording of one DDC. The writer thread owns everything but the
+// packet ring producer side and the Dropped count.
+//
+struct IQRecordDDC
+{
+    uint32_t DDC;
+    int fd;                                     // -1 if no file open
+    bool Direct;                                // file opened with O_DIRECT
+    bool Failed;                                // write error: samples are discarded
+    char BaseName[VIQRECORDNAMESIZE];           // path of the current files, without extension
+    uint32_t Segment;                           // files opened so far
+    struct SPSCRing Index;                      // packet ring, decode -> writer
+    struct IQRecordPacket* Packets;
+    struct IQRecordBuffer Buffers[VIQRECORDBUFFERS];
+    uint32_t Current;                           // buffer being filled
+    uint32_t Fill;                              // bytes in it
+    uint64_t FileOffset;                        // file bytes submitted
+    uint64_t Samples;                           // samples in the current file
+    uint64_t TotalSamples;                      // samples in all files
+    uint32_t SampleRate;                        // of the current file; 0 until its 1st packet
+    uint32_t Frequency;                         // of the current capture
+    uint64_t NextStreamIndex;                   // stream index expected for the next packet
+    struct IQRecordCapture Captures[VIQRECORDMAXCAPTURES];
+    uint32_t CaptureCount;
+    char DateTime[64];                          // ISO 8601 time of the 1st sample of the file
+    uint64_t Dropped;                           // packets dropped with the ring full (decode thread)
+    uint64_t FileDropped;                       // value of Dropped when the file was opened
+    uint64_t Gaps;                              // capture segments started for lost samples
+};
+
+
+uint32_t GIQRecordMask = 0;                     // DDCs recorded; read by the decode
+
+static struct IQRecordDDC* Recordings[VNUMDDC]; // NULL if a DDC is not recorded
+static char RecordDirectory[VIQRECORDDIRSIZE];
+static char RecordStartTime[24];                // UTC, for file names
+static aio_context_t RecordContext = 0;
+static uint32_t RecordInFlight = 0;             // writes in flight (writer thread)
+static bool RecorderActive = false;             // set by start, cleared by the writer once stopped
+static bool RecorderStopRequest = false;
+static bool RecorderInUse = false;              // decode is copying a packet
+static bool RecorderThreadRunning = false;
+static pthread_t RecorderThread;
+static pthread_mutex_t RecorderMutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+//
+// wait for file writes to complete, and release their buffers
+//   MinEvents: 0 to reap only what has completed within TimeoutUs
+//
+static void ReapIQWrites(uint32_t MinEvents, uint32_t TimeoutUs)
+{
+    struct io_event Events[VIQRECORDMAXINFLIGHT];
+    struct timespec Timeout;
+    struct IQRecordBuffer* Buffer;
+    long Count, Cntr;
+
+    if (RecordInFlight == 0)
+    {
+        if (TimeoutUs != 0)
+            usleep(TimeoutUs);
+        return;
+    }
+    Timeout.tv_sec = TimeoutUs / 1000000;
+    Timeout.tv_nsec = (TimeoutUs % 1000000) * 1000;
+    Count = syscall(SYS_io_getevents, RecordContext, MinEvents, VIQRECORDMAXINFLIGHT, Events, &Timeout);
+    if (Count < 0)
+    {
+        if (errno != EINTR)
+            perror("io_getevents, I/Q recorder");
+        return;
+    }
+    for (Cntr = 0; Cntr < Count; Cntr++)
+    {
+        Buffer = (struct IQRecordBuffer*)(uintptr_t)Events[Cntr].data;
+        if ((Events[Cntr].res < 0) || ((uint64_t)Events[Cntr].res != Buffer->Length))
+        {
+            if (!Buffer->Owner->Failed)
+                printf("I/Q recorder: DDC%u write failed (%lld), recording stopped\n",
+                       Buffer->Owner->DDC, (long long)Events[Cntr].res);
+            Buffer->Owner->Failed = true;
+        }
+        Buffer->Busy = false;
+        RecordInFlight--;
+    }
+}
+
+
+//
+// write the buffer being filled to the file, and move on to the next one
+// the last write of a file may be short: with O_DIRECT it is padded to
+// the alignment, and the file is truncated when it is closed
+//
+static void SubmitIQBuffer(struct IQRecordDDC* Rec)
+{
+    struct IQRecordBuffer* Buffer;
+    struct iocb* List[1];
+    uint32_t Length;
+
+    Buffer = &Rec->Buffers[Rec->Current];
+    Length = Rec->Fill;
+    if (Rec->Direct && ((Length % VIQRECORDALIGN) != 0))
+    {
+        memset(Buffer->Data + Length, 0, VIQRECORDALIGN - (Length % VIQRECORDALIGN));
+        Length += VIQRECORDALIGN - (Length % VIQRECORDALIGN);
+    }
+    Rec->Fill = 0;
+    if (Rec->Failed || (Length == 0))
+        return;
+    memset(&Buffer->Request, 0, sizeof(Buffer->Request));
+    Buffer->Request.aio_data = (uintptr_t)Buffer;
+    Buffer->Request.aio_lio_opcode = IOCB_CMD_PWRITE;
+    Buffer->Request.aio_fildes = Rec->fd;
+    Buffer->Request.aio_buf = (uintptr_t)Buffer->Data;
+    Buffer->Request.aio_nbytes = Length;
+    Buffer->Request.aio_offset = Rec->FileOffset;
+    Buffer->Length = Length;
+    List[0] = &Buffer->Request;
+    if (syscall(SYS_io_submit, RecordContext, 1, List) != 1)
+    {
+        perror("io_submit, I/Q recorder");
+        Rec->Failed = true;
+        return;
+    }
+    Buffer->Busy = true;
+    RecordInFlight++;
+    Rec->FileOffset += Length;
+    Rec->Current = (Rec->Current + 1) % VIQRECORDBUFFERS;
+    while (Rec->Buffers[Rec->Current].Busy)
+        ReapIQWrites(1, VIQRECORDWRITEWAIT);
+}
+
+
+//
+// write the SigMF metadata for the current file
+//
+static void WriteIQMeta(struct IQRecordDDC* Rec)
+{
+    char Name[VIQRECORDNAMESIZE + 16];
+    FILE* File;
+    uint32_t Cntr;
+
+    snprintf(Name, sizeof(Name), "%s.sigmf-meta", Rec->BaseName);
+    File = fopen(Name, "w");
+    if (File == NULL)
+    {
+        perror("fopen, I/Q recorder metadata");
+        return;
+    }
+    fprintf(File, "{\n  \"global\": {\n"
+                  "    \"core:datatype\": \"ci32_be\",\n"
+                  "    \"core:sample_rate\": %u,\n"
+                  "    \"core:version\": \"1.0.0\",\n"
+                  "    \"core:hw\": \"Saturn DDC%u\",\n"
+                  "    \"core:recorder\": \"p2app\",\n"
+                  "    \"core:description\": \"24 bit samples in the top 3 bytes; %llu packets dropped by the recorder\"\n"
+                  "  },\n  \"captures\": [\n",
+            Rec->SampleRate, Rec->DDC,
+            (unsigned long long)(__atomic_load_n(&Rec->Dropped, __ATOMIC_RELAXED) - Rec->FileDropped));
+    for (Cntr = 0; Cntr < Rec->CaptureCount; Cntr++)
+    {
+        fprintf(File, "    {\"core:sample_start\": %llu, \"core:global_index\": %llu, \"core:frequency\": %u",
+                (unsigned long long)Rec->Captures[Cntr].SampleStart,
+                (unsigned long long)Rec->Captures[Cntr].GlobalIndex, Rec->Captures[Cntr].Frequency);
+        if (Cntr == 0)
+            fprintf(File, ", \"core:datetime\": \"%s\"", Rec->DateTime);
+        fprintf(File, "}%s\n", (Cntr + 1 < Rec->CaptureCount) ? "," : "");
+    }
+    fprintf(File, "  ],\n  \"annotations\": []\n}\n");
+    fclose(File);
+}
+
+
+//
+// create the data file for the next segment of a DDC recording
+// O_DIRECT is not supported by every filesystem (eg tmpfs): then the
+// file is written through the page cache instead
+//
+static bool OpenIQFile(struct IQRecordDDC* Rec)
+{
+    char Name[VIQRECORDNAMESIZE + 16];
+
+    if (Rec->Segment == 0)
+        snprintf(Rec->BaseName, sizeof(Rec->BaseName), "%s/saturn-%s-ddc%u", RecordDirectory, RecordStartTime, Rec->DDC);
+    else
+        snprintf(Rec->BaseName, sizeof(Rec->BaseName), "%s/saturn-%s-ddc%u-%u", RecordDirectory, RecordStartTime, Rec->DDC, Rec->Segment);
+    snprintf(Name, sizeof(Name), "%s.sigmf-data", Rec->BaseName);
+    Rec->Direct = true;
+    Rec->fd = open(Name, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    if ((Rec->fd < 0) && (errno == EINVAL))
+    {
+        Rec->Direct = false;
+        Rec->fd = open(Name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if (Rec->fd < 0)
+    {
+        perror("open, I/Q recorder");
+        Rec->Failed = true;
+        return false;
+    }
+    Rec->Segment++;
+    Rec->Current = 0;
+    Rec->Fill = 0;
+    Rec->FileOffset = 0;
+    Rec->Samples = 0;
+    Rec->SampleRate = 0;
+    Rec->CaptureCount = 0;
+    Rec->FileDropped = __atomic_load_n(&Rec->Dropped, __ATOMIC_RELAXED);
+    return true;
+}
+
+
+//
+// write out the last samples of a file, wait for its writes, and close it
+//
+static void CloseIQFile(struct IQRecordDDC* Rec)
+{
+    uint32_t Cntr;
+
+    if (Rec->fd < 0)
+        return;
+    SubmitIQBuffer(Rec);
+    for (Cntr = 0; Cntr < VIQRECORDBUFFERS; Cntr++)
+        while (Rec->Buffers[Cntr].Busy)
+            ReapIQWrites(1, VIQRECORDWRITEWAIT);
+    if (ftruncate(Rec->fd, (off_t)(Rec->Samples * VIQRECORDBYTESOUT)) != 0)
+        perror("ftruncate, I/Q recorder");
+    close(Rec->fd);
+    Rec->fd = -1;
+    if (Rec->SampleRate != 0)
+        WriteIQMeta(Rec);
+}
+
+
+//
+// start a new capture segment at the next sample written
+//
+static void AddIQCapture(struct IQRecordDDC* Rec, uint64_t StreamIndex, uint32_t Frequency)
+{
+    struct IQRecordCapture* Capture;
+
+    Rec->Frequency = Frequency;
+    if ((Rec->CaptureCount != 0) && (Rec->Captures[Rec->CaptureCount - 1].SampleStart == Rec->Samples))
+        Capture = &Rec->Captures[Rec->CaptureCount - 1];        // no samples in the last one: replace it
+    else if (Rec->CaptureCount < VIQRECORDMAXCAPTURES)
+        Capture = &Rec->Captures[Rec->CaptureCount++];
+    else
+        return;
+    Capture->SampleStart = Rec->Samples;
+    Capture->GlobalIndex = StreamIndex;
+    Capture->Frequency = Frequency;
+}
+
+
+//
+// convert samples to ci32_be in the file buffers
+//
+static void AddIQSamples(struct IQRecordDDC* Rec, const uint8_t* Src, uint32_t Count)
+{
+    uint8_t* Dest;
+    uint32_t Space;
+    uint32_t Cntr;
+
+    while (Count != 0)
+    {
+        Dest = Rec->Buffers[Rec->Current].Data + Rec->Fill;
+        Space = (VIQRECORDBUFFERSIZE - Rec->Fill) / VIQRECORDBYTESOUT;
+        if (Space > Count)
+            Space = Count;
+        for (Cntr = 0; Cntr < Space; Cntr++)
+        {
+            Dest[0] = Src[0];
+            Dest[1] = Src[1];
+            Dest[2] = Src[2];
+            Dest[3] = 0;
+            Dest[4] = Src[3];
+            Dest[5] = Src[4];
+            Dest[6] = Src[5];
+            Dest[7] = 0;
+            Dest += VIQRECORDBYTESOUT;
+            Src += VIQRECORDBYTESIN;
+        }
+        Rec->Fill += Space * VIQRECORDBYTESOUT;
+        Rec->Samples += Space;
+        Rec->TotalSamples += Space;
+        Count -= Space;
+        if (Rec->Fill == VIQRECORDBUFFERSIZE)
+            SubmitIQBuffer(Rec);
+    }
+}
+
+
+//
+// add one packet to a DDC recording
+//
+static void WriteIQPacket(struct IQRecordDDC* Rec, struct IQRecordPacket* Packet)
+{
+    struct timespec Now;
+    struct tm Time;
+    uint32_t Frequency;
+
+    if ((Rec->SampleRate != 0) && (Packet->SampleRate != Rec->SampleRate))
+    {
+        CloseIQFile(Rec);                                           // new sample rate: new files
+        OpenIQFile(Rec);
+    }
+    if (Rec->Failed)
+        return;
+    Frequency = GetDDCFrequency(Rec->DDC);
+    if (Rec->SampleRate == 0)
+    {
+        Rec->SampleRate = Packet->SampleRate;
+        clock_gettime(CLOCK_REALTIME, &Now);
+        gmtime_r(&Now.tv_sec, &Time);
+        snprintf(Rec->DateTime, sizeof(Rec->DateTime), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",
+                 Time.tm_year + 1900, Time.tm_mon + 1, Time.tm_mday, Time.tm_hour, Time.tm_min, Time.tm_sec,
+                 (int)(Now.tv_nsec / 1000000));
+        AddIQCapture(Rec, Packet->StreamIndex, Frequency);
+        WriteIQMeta(Rec);                                           // so a file cut short can still be read
+    }
+    else if (Packet->StreamIndex != Rec->NextStreamIndex)
+    {
+        Rec->Gaps++;
+        AddIQCapture(Rec, Packet->StreamIndex, Frequency);
+    }
+    else if (Frequency != Rec->Frequency)
+        AddIQCapture(Rec, Packet->StreamIndex, Frequency);
+    Rec->NextStreamIndex = Packet->StreamIndex + Packet->SampleCount;
+    AddIQSamples(Rec, Packet->Data, Packet->SampleCount);
+}
+
+
+//
+// write every waiting packet of a DDC
+// returns true if there were any
+//
+static bool DrainIQRing(struct IQRecordDDC* Rec)
+{
+    int32_t Slot;
+    bool Found = false;
+
+    while ((Slot = SPSCGetReadSlot(&Rec->Index)) >= 0)
+    {
+        if (!Rec->Failed)
+            WriteIQPacket(Rec, &Rec->Packets[Slot]);
+        SPSCRelease(&Rec->Index);
+        Found = true;
+    }
+    return Found;
+}
+
+
+//
+// stop the decode passing packets, and wait until it is not in RecordIQPacket()
+//
+static void DetachIQRecorder(void)
+{
+    __atomic_store_n(&GIQRecordMask, 0, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&RecorderInUse, __ATOMIC_SEQ_CST))
+        sched_yield();
+}
+
+
+//
+// write out and close every file of the recording
+//
+static void FinishIQRecording(void)
+{
+    uint32_t DDC;
+
+    DetachIQRecorder();
+    for (DDC = 0; DDC < VNUMDDC; DDC++)
+        if (Recordings[DDC] != NULL)
+        {
+            DrainIQRing(Recordings[DDC]);
+            CloseIQFile(Recordings[DDC]);
+            printf("I/Q recorder: DDC%u %llu samples, %llu packets dropped, %llu gaps\n", DDC,
+                   (unsigned long long)Recordings[DDC]->TotalSamples,
+                   (unsigned long long)__atomic_load_n(&Recordings[DDC]->Dropped, __ATOMIC_RELAXED),
+                   (unsigned long long)Recordings[DDC]->Gaps);
+        }
+    syscall(SYS_io_destroy, RecordContext);
+    RecordContext = 0;
+}
+
+
+//
+// writer thread: runs for the life of the program, idle when not recording
+//
+static void* IQRecorderThread(void* arg)
+{
+    uint32_t DDC;
+    bool Found;
+
+    (void)arg;
+    printf("spinning up I/Q recorder thread, pid=%ld\n", syscall(SYS_gettid));
+    while (!ThreadStopRequested())
+    {
+        if (!__atomic_load_n(&RecorderActive, __ATOMIC_ACQUIRE))
+        {
+            usleep(VIQRECORDIDLESLEEP);
+            continue;
+        }
+        Found = false;
+        for (DDC = 0; DDC < VNUMDDC; DDC++)
+            if (Recordings[DDC] != NULL)
+                Found |= DrainIQRing(Recordings[DDC]);
+        if (__atomic_load_n(&RecorderStopRequest, __ATOMIC_ACQUIRE))
+        {
+            FinishIQRecording();
+            __atomic_store_n(&RecorderActive, false, __ATOMIC_RELEASE);
+        }
+        else if (!Found)
+            ReapIQWrites(0, VIQRECORDPOLLTIME);
+    }
+    if (__atomic_load_n(&RecorderActive, __ATOMIC_ACQUIRE))
+        FinishIQRecording();
+    return NULL;
+}
+
+
+//
+// free the memory of a recording. The writer must not be using it.
+//
+static void FreeIQRecording(void)
+{
+    uint32_t DDC, Cntr;
+
+    for (DDC = 0; DDC < VNUMDDC; DDC++)
+        if (Recordings[DDC] != NULL)
+        {
+            if (Recordings[DDC]->fd >= 0)
+                close(Recordings[DDC]->fd);
+            for (Cntr = 0; Cntr < VIQRECORDBUFFERS; Cntr++)
+                free(Recordings[DDC]->Buffers[Cntr].Data);
+            free(Recordings[DDC]->Packets);
+            free(Recordings[DDC]);
+            Recordings[DDC] = NULL;
+        }
+    if (RecordContext != 0)
+        syscall(SYS_io_destroy, RecordContext);
+    RecordContext = 0;
+}
+
+
+//
+// bool StartIQRecording(uint32_t DDCMask, const char* Directory)
+// start recording the DDCs in DDCMask
+//
+bool StartIQRecording(uint32_t DDCMask, const char* Directory)
+{
+    struct IQRecordDDC* Rec;
+    struct timespec Now;
+    struct tm Time;
+    uint32_t DDC, Cntr;
+    bool Error = false;
+
+    DDCMask &= (1 << VNUMDDC) - 1;
+    if (DDCMask == 0)
+        return false;
+    pthread_mutex_lock(&RecorderMutex);
+    if (__atomic_load_n(&RecorderActive, __ATOMIC_ACQUIRE))
+    {
+        pthread_mutex_unlock(&RecorderMutex);
+        return false;
+    }
+    if (!RecorderThreadRunning)
+    {
+        if (!CreateManagedThread(&RecorderThread, "iqrecorder", eHousekeepingThread, IQRecorderThread, NULL))
+        {
+            perror("pthread_create I/Q recorder");
+            pthread_mutex_unlock(&RecorderMutex);
+            return false;
+        }
+        RecorderThreadRunning = true;
+    }
+    snprintf(RecordDirectory, sizeof(RecordDirectory), "%s", (Directory != NULL) ? Directory : VIQRECORDDIR);
+    clock_gettime(CLOCK_REALTIME, &Now);
+    gmtime_r(&Now.tv_sec, &Time);
+    strftime(RecordStartTime, sizeof(RecordStartTime), "%Y%m%dT%H%M%SZ", &Time);
+    if (syscall(SYS_io_setup, VIQRECORDMAXINFLIGHT, &RecordContext) < 0)
+    {
+        perror("io_setup, I/Q recorder");
+        RecordContext = 0;
+        pthread_mutex_unlock(&RecorderMutex);
+        return false;
+    }
+    RecordInFlight = 0;
+
+    for (DDC = 0; (DDC < VNUMDDC) && !Error; DDC++)
+    {
+        if ((DDCMask & (1 << DDC)) == 0)
+            continue;
+        Rec = calloc(1, sizeof(struct IQRecordDDC));
+        if (Rec == NULL)
+        {
+            Error = true;
+            break;
+        }
+        Recordings[DDC] = Rec;
+        Rec->DDC = DDC;
+        Rec->fd = -1;
+        SPSCInitialise(&Rec->Index, VIQRECORDRINGSLOTS);
+        Rec->Packets = malloc(VIQRECORDRINGSLOTS * sizeof(struct IQRecordPacket));
+        Error = (Rec->Packets == NULL);
+        for (Cntr = 0; Cntr < VIQRECORDBUFFERS; Cntr++)
+        {
+            Rec->Buffers[Cntr].Owner = Rec;
+            if (posix_memalign((void**)&Rec->Buffers[Cntr].Data, VIQRECORDALIGN, VIQRECORDBUFFERSIZE) != 0)
+            {
+                Rec->Buffers[Cntr].Data = NULL;
+                Error = true;
+            }
+        }
+        if (!Error)
+            Error = !OpenIQFile(Rec);
+    }
+    if (Error)
+    {
+        printf("I/Q recorder: could not start recording to %s\n", RecordDirectory);
+        FreeIQRecording();
+        pthread_mutex_unlock(&RecorderMutex);
+        return false;
+    }
+    __atomic_store_n(&RecorderStopRequest, false, __ATOMIC_RELAXED);
+    __atomic_store_n(&RecorderActive, true, __ATOMIC_RELEASE);
+    __atomic_store_n(&GIQRecordMask, DDCMask, __ATOMIC_RELEASE);
+    printf("I/Q recorder: recording DDC mask 0x%03x to %s\n", DDCMask, RecordDirectory);
+    pthread_mutex_unlock(&RecorderMutex);
+    return true;
+}
+
+
+//
+// void StopIQRecording(void)
+// stop recording, and wait for the writer to close the files
+//
+void StopIQRecording(void)
+{
+    pthread_mutex_lock(&RecorderMutex);
+    if (__atomic_load_n(&RecorderActive, __ATOMIC_ACQUIRE))
+    {
+        DetachIQRecorder();
+        __atomic_store_n(&RecorderStopRequest, true, __ATOMIC_RELEASE);
+        while (__atomic_load_n(&RecorderActive, __ATOMIC_ACQUIRE) && !ThreadStopRequested())
+            usleep(VIQRECORDIDLESLEEP);
+        if (!__atomic_load_n(&RecorderActive, __ATOMIC_ACQUIRE))
+            FreeIQRecording();
+    }
+    pthread_mutex_unlock(&RecorderMutex);
+}
+
+
+//
+// void RecordIQPacket(uint32_t DDC, const uint8_t* Samples, uint32_t SampleCount, uint64_t StreamIndex, uint32_t SampleRate)
+// DDC decode thread: copy a packet into the DDC's ring for the writer
+// RecorderInUse and the mask re-read are paired with DetachIQRecorder(),
+// so the ring is not freed while a copy is being made
+//
+void RecordIQPacket(uint32_t DDC, const uint8_t* Samples, uint32_t SampleCount, uint64_t StreamIndex, uint32_t SampleRate)
+{
+    struct IQRecordDDC* Rec;
+    struct IQRecordPacket* Packet;
+    int32_t Slot;
+
+    __atomic_store_n(&RecorderInUse, true, __ATOMIC_SEQ_CST);
+    if ((DDC < VNUMDDC) && (__atomic_load_n(&GIQRecordMask, __ATOMIC_SEQ_CST) & (1 << DDC)))
+    {
+        Rec = Recordings[DDC];
+        Slot = SPSCGetWriteSlot(&Rec->Index);
+        if (Slot < 0)
+            __atomic_fetch_add(&Rec->Dropped, 1, __ATOMIC_RELAXED);
+        else
+        {
+            if (SampleCount > VIQRECORDMAXSAMPLES)
+                SampleCount = VIQRECORDMAXSAMPLES;
+            Packet = &Rec->Packets[Slot];
+            Packet->StreamIndex = StreamIndex;
+            Packet->SampleRate = SampleRate;
+            Packet->SampleCount = SampleCount;
+            memcpy(Packet->Data, Samples, SampleCount * VIQRECORDBYTESIN);
+            SPSCPublish(&Rec->Index);
+        }
+    }
+    __atomic_store_n(&RecorderInUse, false, __ATOMIC_RELEASE);
+}
+
+
+//
+// uint32_t GetIQRecordingStatus(char* Text, uint32_t Length)
+// text status of the recorder. The counts are read while the writer may be updating them.
+//
+uint32_t GetIQRecordingStatus(char* Text, uint32_t Length)
+{
+    uint32_t Used = 0;
+    uint32_t DDC;
+    int Result;
+
+    if (Length == 0)
+        return 0;
+    Text[0] = 0;
+    pthread_mutex_lock(&RecorderMutex);
+    if (!__atomic_load_n(&RecorderActive, __ATOMIC_ACQUIRE))
+        Result = snprintf(Text, Length, "not recording\n");
+    else
+        Result = snprintf(Text, Length, "recording to %s\n", RecordDirectory);
+    if (Result > 0)
+        Used = ((uint32_t)Result < Length) ? (uint32_t)Result : Length - 1;
+    for (DDC = 0; (DDC < VNUMDDC) && __atomic_load_n(&RecorderActive, __ATOMIC_ACQUIRE); DDC++)
+        if (Recordings[DDC] != NULL)
+        {
+            Result = snprintf(Text + Used, Length - Used, "DDC%u: %llu samples, %llu packets dropped, %llu gaps%s\n", DDC,
+                              (unsigned long long)Recordings[DDC]->TotalSamples,
+                              (unsigned long long)__atomic_load_n(&Recordings[DDC]->Dropped, __ATOMIC_RELAXED),
+                              (unsigned long long)Recordings[DDC]->Gaps,
+                              Recordings[DDC]->Failed ? ", failed" : "");
+            if (Result > 0)
+                Used += ((uint32_t)Result < Length - Used) ? (uint32_t)Result : Length - Used - 1;
+        }
+    pthread_mutex_unlock(&RecorderMutex);
+    return Used;
+}
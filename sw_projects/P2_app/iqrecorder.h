@@ -0,0 +1,89 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// iqrecorder.h:
+// header file. local recorder of DDC I/Q samples to SigMF files
+//
+// the DDC decode copies each finished packet of samples for a recorded DDC
+// into a ring; a writer thread converts them to ci32_be (the 24 bit sample
+// in the top 3 bytes) and writes them to a <name>.sigmf-data file with
+// O_DIRECT and Linux AIO, several large aligned buffers in flight, so the
+// page cache and the write latency stay out of the DDC stream. The matching
+// <name>.sigmf-meta file is written when the file is opened and again when
+// it is closed.
+// a new SigMF capture segment starts if samples are lost or the DDC
+// frequency changes; a sample rate change starts a new pair of files.
+// recording is started and stopped through the metrics server:
+//   GET /record/start?ddc=0,1&dir=/mnt/ssd
+//   GET /record/stop
+//   GET /record                    (status)
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __iqrecorder_h
+#define __iqrecorder_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../common/saturntypes.h"
+
+
+#define VIQRECORDDIR "/tmp"                     // directory for recordings if not given
+#define VIQRECORDMAXSAMPLES 238                 // most I/Q samples in one recorded packet
+#define VIQRECORDRINGSLOTS 512                  // packets buffered per DDC for the writer (power of 2)
+#define VIQRECORDBUFFERSIZE (512*1024)          // bytes per file write (multiple of VIQRECORDALIGN)
+#define VIQRECORDBUFFERS 4                      // file writes in flight per DDC
+#define VIQRECORDALIGN 4096                     // O_DIRECT buffer, offset and length alignment
+#define VIQRECORDMAXCAPTURES 64                 // most SigMF capture segments in one file
+
+
+//
+// DDCs being recorded, one bit per DDC. Read by the DDC decode to decide
+// whether to call RecordIQPacket(); 0 when not recording.
+//
+extern uint32_t GIQRecordMask;
+
+
+//
+// bool StartIQRecording(uint32_t DDCMask, const char* Directory)
+// start recording the DDCs in DDCMask (bit n = DDC n) to files in Directory
+// (VIQRECORDDIR if NULL). Files are named saturn-<UTC time>-ddc<n>.
+// returns false if already recording, or no file could be created
+//
+bool StartIQRecording(uint32_t DDCMask, const char* Directory);
+
+
+//
+// void StopIQRecording(void)
+// stop recording; returns once every file has been written and closed
+//
+void StopIQRecording(void);
+
+
+//
+// void RecordIQPacket(uint32_t DDC, const uint8_t* Samples, uint32_t SampleCount, uint64_t StreamIndex, uint32_t SampleRate)
+// DDC decode thread: add one packet of samples for DDC to its recording
+//   Samples:       24 bit big endian I then Q samples, as in a protocol 2 packet
+//   SampleCount:   I/Q samples (at most VIQRECORDMAXSAMPLES)
+//   StreamIndex:   count of samples the DDC has produced before the 1st one
+//   SampleRate:    DDC sample rate, Hz
+// the packet is dropped (and counted) if the writer has fallen behind
+//
+void RecordIQPacket(uint32_t DDC, const uint8_t* Samples, uint32_t SampleCount, uint64_t StreamIndex, uint32_t SampleRate);
+
+
+//
+// uint32_t GetIQRecordingStatus(char* Text, uint32_t Length)
+// write a text status of the recorder: one line per DDC recorded
+// returns the number of characters written
+//
+uint32_t GetIQRecordingStatus(char* Text, uint32_t Length);
+
+
+#endif
@@ -0,0 +1,200 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// loopwatchdog.c:
+//
+// deadline watchdog for the stream thread loops
+//
+//////////////////////////////////////////////////////////////
+
+#include "loopwatchdog.h"
+#include "threaddata.h"
+#include "threadmanager.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <execinfo.h>
+
+
+//
+// one stream's watch. Written by the stream thread at each loop; the report thread
+// reads it, and takes the stack once reported (Pending back to 0)
+//
+struct LoopWatch
+{
+    uint32_t Budget;                            // us; 0 = not watched
+    uint64_t Loops;                             // loops measured
+    uint64_t Misses;                            // loops over budget
+    uint64_t ReportedMisses;                    // misses already reported (report thread only)
+    uint32_t Worst;                             // longest loop since the last report, us
+    uint32_t Pending;                           // duration of the miss whose stack is held; 0 = none
+    int StackDepth;
+    void* Stack[VWATCHSTACKDEPTH];
+} __attribute__((aligned(VCACHELINESIZE)));
+
+
+static struct LoopWatch LoopWatches[VNUMMETRICSTREAMS];
+static const char* LoopWatchNames[VNUMMETRICSTREAMS] = {"ddc", "duc", "mic", "speaker", "wideband", "highpriority"};
+static bool LoopWatchdogUsed = false;
+
+
+//
+// set one budget, or all of them if Name is NULL
+//
+static bool SetLoopBudget(const char* Name, uint32_t Budget)
+{
+    uint32_t Stream;
+    bool Found = false;
+
+    for (Stream = 0; Stream < VNUMMETRICSTREAMS; Stream++)
+        if ((Stream != eHPMetrics) && ((Name == NULL) || (strcmp(Name, LoopWatchNames[Stream]) == 0)))
+        {
+            LoopWatches[Stream].Budget = Budget;
+            Found = true;
+        }
+    if (Budget != 0)
+        LoopWatchdogUsed = true;
+    return Found;
+}
+
+
+//
+// set the loop budgets from a string
+// format: <us>, or <stream>=<us>,<stream>=<us>...
+//
+bool SetLoopDeadlines(const char* Spec)
+{
+    char* List;
+    char* Entry;
+    char* SavePtr;
+    char* Equals;
+    bool Result = true;
+
+    if (strchr(Spec, '=') == NULL)
+    {
+        SetLoopBudget(NULL, (uint32_t)atoi(Spec));
+        printf("stream loop deadline = %dus\n", atoi(Spec));
+        return true;
+    }
+    List = strdup(Spec);
+    if (List == NULL)
+        return false;
+    Entry = strtok_r(List, ",", &SavePtr);
+    while (Entry != NULL)
+    {
+        Equals = strchr(Entry, '=');
+        if (Equals == NULL)
+            Result = false;
+        else
+        {
+            *Equals = 0;
+            if (SetLoopBudget(Entry, (uint32_t)atoi(Equals + 1)))
+                printf("%s loop deadline = %dus\n", Entry, atoi(Equals + 1));
+            else
+                Result = false;
+        }
+        Entry = strtok_r(NULL, ",", &SavePtr);
+    }
+    free(List);
+    if (!Result)
+        printf("bad loop deadlines %s: use <us> or <stream>=<us>,... (streams ddc, duc, mic, speaker, wideband)\n", Spec);
+    return Result;
+}
+
+
+//
+// one loop measured: count it, and if over budget hold its stack for the report
+// the stack is only taken for the 1st miss each report period, so a run of misses costs little
+//
+void LoopWatchdogBeat(EMetricsStream Stream, uint32_t Duration)
+{
+    struct LoopWatch* Watch = &LoopWatches[Stream];
+
+    if (Watch->Budget == 0)
+        return;
+    __atomic_add_fetch(&Watch->Loops, 1, __ATOMIC_RELAXED);
+    if (Duration <= Watch->Budget)
+        return;
+    __atomic_add_fetch(&Watch->Misses, 1, __ATOMIC_RELAXED);
+    if (Duration > __atomic_load_n(&Watch->Worst, __ATOMIC_RELAXED))
+        __atomic_store_n(&Watch->Worst, Duration, __ATOMIC_RELAXED);
+    if (__atomic_load_n(&Watch->Pending, __ATOMIC_ACQUIRE) == 0)
+    {
+        Watch->StackDepth = backtrace(Watch->Stack, VWATCHSTACKDEPTH);
+        __atomic_store_n(&Watch->Pending, Duration, __ATOMIC_RELEASE);
+    }
+}
+
+
+uint64_t GetLoopDeadlineMisses(EMetricsStream Stream)
+{
+    return __atomic_load_n(&LoopWatches[Stream].Misses, __ATOMIC_RELAXED);
+}
+
+
+//
+// report thread: once a period, print the streams that have missed deadlines
+// frames 0 and 1 are this file and MetricsRecordLoopTime(), so are not printed
+//
+static void* LoopWatchdogThread(void* arg)
+{
+    struct LoopWatch* Watch;
+    uint32_t Stream, Frame, Pending, Worst;
+    uint64_t Misses;
+    char** Symbols;
+    char Summary[512];
+    size_t Length;
+
+    (void)arg;
+    while (true)
+    {
+        usleep(VWATCHREPORTPERIOD * 1000);
+        for (Stream = 0; Stream < VNUMMETRICSTREAMS; Stream++)
+        {
+            Watch = &LoopWatches[Stream];
+            Pending = __atomic_load_n(&Watch->Pending, __ATOMIC_ACQUIRE);
+            if (Pending == 0)
+                continue;
+            Misses = __atomic_load_n(&Watch->Misses, __ATOMIC_RELAXED);
+            Worst = __atomic_exchange_n(&Watch->Worst, 0, __ATOMIC_RELAXED);
+            Summary[0] = 0;
+            Length = 0;
+            Symbols = backtrace_symbols(Watch->Stack, Watch->StackDepth);
+            if (Symbols != NULL)
+            {
+                for (Frame = 2; (Frame < (uint32_t)Watch->StackDepth) && (Length < sizeof(Summary)); Frame++)
+                    Length += snprintf(Summary + Length, sizeof(Summary) - Length, "%s%s",
+                                       (Frame == 2) ? "" : " < ", Symbols[Frame]);
+                free(Symbols);
+            }
+            printf("deadline watchdog: %s loop took %dus (budget %dus), %llu over budget in %dms, worst %dus; at %s\n",
+                   LoopWatchNames[Stream], Pending, Watch->Budget,
+                   (unsigned long long)(Misses - Watch->ReportedMisses), VWATCHREPORTPERIOD, Worst, Summary);
+            Watch->ReportedMisses = Misses;
+            __atomic_store_n(&Watch->Pending, 0, __ATOMIC_RELEASE);
+        }
+    }
+    return NULL;
+}
+
+
+//
+// start the report thread if any budget is set
+// backtrace() loads its unwinder on the 1st call: make that call now, not in a stream thread
+//
+bool StartLoopWatchdog(void)
+{
+    void* Stack[VWATCHSTACKDEPTH];
+
+    if (!LoopWatchdogUsed)
+        return true;
+    backtrace(Stack, VWATCHSTACKDEPTH);
+    return CreateManagedThread(NULL, "loop watchdog", eHousekeepingThread, LoopWatchdogThread, NULL);
+}
@@ -0,0 +1,70 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// loopwatchdog.h:
+//
+// header: deadline watchdog for the stream thread loops
+// each stream loop already measures its own processing time for the metrics
+// (MetricsRecordLoopTime()); that measurement is also the loop's heartbeat.
+// a loop that takes longer than its budget is counted, and the 1st such loop
+// since the last report has its call stack taken. A housekeeping thread
+// reports the misses once a second, with that short stack summary, so a
+// loop that is getting slow shows up before the FIFO over or under runs.
+// budgets are set per stream in us; a sensible budget is about half the time
+// the stream's FIFO takes to fill (or empty) at its data rate.
+// stack addresses are printed as p2app(+offset): use addr2line -f -e p2app.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __loopwatchdog_h
+#define __loopwatchdog_h
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "metrics.h"
+
+
+#define VWATCHSTACKDEPTH 6                      // stack frames taken at a miss (the 1st two are the watchdog)
+#define VWATCHREPORTPERIOD 1000                 // ms between reports
+
+
+//
+// bool SetLoopDeadlines(const char* Spec)
+// set the loop budgets, from a command line or config file string
+// format: <us> for every stream, or <stream>=<us>,<stream>=<us>... with
+// stream names as the metrics: ddc, duc, mic, speaker, wideband
+// returns true if successful
+//
+bool SetLoopDeadlines(const char* Spec);
+
+
+//
+// bool StartLoopWatchdog(void)
+// start the report thread, if any budget is set. Call before the stream threads start.
+// returns false if the thread could not be started
+//
+bool StartLoopWatchdog(void);
+
+
+//
+// void LoopWatchdogBeat(EMetricsStream Stream, uint32_t Duration)
+// one loop of the stream took Duration us. Called by MetricsRecordLoopTime()
+//
+void LoopWatchdogBeat(EMetricsStream Stream, uint32_t Duration);
+
+
+//
+// uint64_t GetLoopDeadlineMisses(EMetricsStream Stream)
+// loops over budget since startup
+//
+uint64_t GetLoopDeadlineMisses(EMetricsStream Stream);
+
+
+#endif
@@ -0,0 +1,965 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2 
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// metrics.c:
+//
+// runtime stream health metrics, and a minimal HTTP server returning
+// them in Prometheus text format, or as JSON for the web dashboard
+//
+//////////////////////////////////////////////////////////////
+
+#include "metrics.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <syscall.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "../common/saturndrivers.h"
+#include "../common/saturnregisters.h"
+#include "threadmanager.h"
+#include "iqrecorder.h"
+#include "loopwatchdog.h"
+#include "powergovernor.h"
+#include "threadstats.h"
+#include "standby.h"
+
+
+#define VMETRICSBUFFERSIZE 131072               // largest metrics response (per thread stats included)
+
+
+//
+// the metrics for one stream
+//
+struct StreamMetrics
+{
+  uint64_t Packets;
+  uint64_t DMATransfers;
+  uint64_t DMABytes;
+  uint64_t OverThreshold;
+  uint64_t Underflows;
+  uint64_t SendErrors;
+  uint64_t SequenceGaps;                        // received packets missing
+  uint64_t SequenceErrors;                      // received packets out of order or repeated
+  uint64_t Reordered;                           // packets put back in order by the reorder buffer
+  uint64_t Lost;                                // missing packets concealed by the reorder buffer
+  uint64_t Late;                                // packets discarded as too late by the reorder buffer
+  int64_t BufferBytes;                          // buffer memory the stream holds now
+  uint32_t NextSequence;                        // sequence number expected next (receiving thread only)
+  bool SequenceValid;
+  struct MetricsHistogram DMASize;              // bytes per DMA
+  struct MetricsHistogram FIFODepth;            // FIFO occupied locations at DMA time
+  struct MetricsHistogram LoopTime;             // loop processing time, us
+};
+
+static struct StreamMetrics Metrics[VNUMMETRICSTREAMS];
+static const char* MetricsStreamNames[VNUMMETRICSTREAMS] = {"ddc", "duc", "mic", "speaker", "wideband", "highpriority"};
+
+//
+// sampled occupancy of one stream FIFO. Written by the sampler thread only.
+//
+struct FIFOSampleHistogram
+{
+  uint32_t Depth;                               // FIFO locations
+  uint32_t BucketWidth;                         // locations per bucket
+  uint64_t Buckets[VFIFOSAMPLEBUCKETS];
+  uint64_t Sum;
+  uint64_t Count;
+  uint32_t Min;
+  uint32_t Max;
+};
+
+static struct FIFOSampleHistogram FIFOSamples[VNUMDMAFIFO];
+static uint32_t SamplerRate = 0;                // 0 if the sampler is not running
+static pthread_t FIFOSamplerThread;
+
+static int MetricsSocketid;
+static pthread_t MetricsThread;
+static char MetricsText[VMETRICSBUFFERSIZE];    // response being built (metrics thread only)
+static uint32_t MetricsTextLength;
+
+
+//
+// void MetricsHistogramRecord(struct MetricsHistogram* Histogram, uint32_t Value)
+// add one value to a histogram: bucket N holds values up to 2^N
+//
+void MetricsHistogramRecord(struct MetricsHistogram* Histogram, uint32_t Value)
+{
+  uint32_t Bucket = 0;
+
+  if(Value > 1)
+    Bucket = 32 - __builtin_clz(Value - 1);                 // smallest N with 2^N >= Value
+  if(Bucket > VMETRICBUCKETS)
+    Bucket = VMETRICBUCKETS;
+  __atomic_add_fetch(&Histogram->Buckets[Bucket], 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&Histogram->Sum, Value, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&Histogram->Count, 1, __ATOMIC_RELAXED);
+}
+
+
+void MetricsCountPackets(EMetricsStream Stream, uint32_t Packets)
+{
+  __atomic_add_fetch(&Metrics[Stream].Packets, Packets, __ATOMIC_RELAXED);
+}
+
+
+void MetricsRecordDMA(EMetricsStream Stream, uint32_t Bytes, uint32_t FIFODepth)
+{
+  __atomic_add_fetch(&Metrics[Stream].DMATransfers, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&Metrics[Stream].DMABytes, Bytes, __ATOMIC_RELAXED);
+  MetricsHistogramRecord(&Metrics[Stream].DMASize, Bytes);
+  MetricsHistogramRecord(&Metrics[Stream].FIFODepth, FIFODepth);
+}
+
+
+void MetricsCountOverThreshold(EMetricsStream Stream)
+{
+  __atomic_add_fetch(&Metrics[Stream].OverThreshold, 1, __ATOMIC_RELAXED);
+}
+
+
+void MetricsCountUnderflow(EMetricsStream Stream)
+{
+  __atomic_add_fetch(&Metrics[Stream].Underflows, 1, __ATOMIC_RELAXED);
+}
+
+
+void MetricsCountSendError(EMetricsStream Stream)
+{
+  __atomic_add_fetch(&Metrics[Stream].SendErrors, 1, __ATOMIC_RELAXED);
+}
+
+
+void MetricsAddBufferBytes(EMetricsStream Stream, int64_t Bytes)
+{
+  __atomic_add_fetch(&Metrics[Stream].BufferBytes, Bytes, __ATOMIC_RELAXED);
+}
+
+
+void MetricsCountReordered(EMetricsStream Stream)
+{
+  __atomic_add_fetch(&Metrics[Stream].Reordered, 1, __ATOMIC_RELAXED);
+}
+
+
+void MetricsCountLost(EMetricsStream Stream)
+{
+  __atomic_add_fetch(&Metrics[Stream].Lost, 1, __ATOMIC_RELAXED);
+}
+
+
+void MetricsCountLate(EMetricsStream Stream)
+{
+  __atomic_add_fetch(&Metrics[Stream].Late, 1, __ATOMIC_RELAXED);
+}
+
+
+void MetricsRecordLoopTime(EMetricsStream Stream, struct timespec* Start)
+{
+  struct timespec Now;
+  int64_t Elapsed;
+
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  Elapsed = (int64_t)(Now.tv_sec - Start->tv_sec) * 1000000 + (Now.tv_nsec - Start->tv_nsec) / 1000;
+  if(Elapsed < 0)
+    Elapsed = 0;
+  if(Elapsed > 0xFFFFFFFF)
+    Elapsed = 0xFFFFFFFF;
+  MetricsHistogramRecord(&Metrics[Stream].LoopTime, (uint32_t)Elapsed);
+  LoopWatchdogBeat(Stream, (uint32_t)Elapsed);
+  *Start = Now;
+}
+
+
+void MetricsCheckSequence(EMetricsStream Stream, uint32_t Sequence)
+{
+  struct StreamMetrics* Entry = &Metrics[Stream];
+  int32_t Gap;
+
+  if(Entry->SequenceValid && (Sequence != 0))
+  {
+    Gap = (int32_t)(Sequence - Entry->NextSequence);
+    if(Gap > 0)
+      __atomic_add_fetch(&Entry->SequenceGaps, (uint32_t)Gap, __ATOMIC_RELAXED);
+    else if(Gap < 0)
+    {
+      __atomic_add_fetch(&Entry->SequenceErrors, 1, __ATOMIC_RELAXED);
+      return;                                   // late packet: keep waiting for the one expected
+    }
+  }
+  Entry->NextSequence = Sequence + 1;
+  Entry->SequenceValid = true;
+}
+
+
+//
+// append text to the response being built
+//
+static void AppendMetricsText(const char* Format, ...)
+{
+  va_list Args;
+  int Length;
+
+  if(MetricsTextLength >= VMETRICSBUFFERSIZE)
+    return;
+  va_start(Args, Format);
+  Length = vsnprintf(MetricsText + MetricsTextLength, VMETRICSBUFFERSIZE - MetricsTextLength, Format, Args);
+  va_end(Args);
+  if(Length > 0)
+    MetricsTextLength += Length;
+  if(MetricsTextLength > VMETRICSBUFFERSIZE)
+    MetricsTextLength = VMETRICSBUFFERSIZE;
+}
+
+
+//
+// append one counter for every stream
+// Offset is the byte offset of the counter in struct StreamMetrics
+//
+static void AppendStreamCounter(const char* Name, const char* Help, size_t Offset)
+{
+  uint32_t Stream;
+  uint64_t Value;
+
+  AppendMetricsText("# HELP p2app_%s %s\n# TYPE p2app_%s counter\n", Name, Help, Name);
+  for(Stream = 0; Stream < VNUMMETRICSTREAMS; Stream++)
+  {
+    Value = __atomic_load_n((uint64_t*)((uint8_t*)&Metrics[Stream] + Offset), __ATOMIC_RELAXED);
+    AppendMetricsText("p2app_%s{stream=\"%s\"} %llu\n", Name, MetricsStreamNames[Stream], (unsigned long long)Value);
+  }
+}
+
+
+//
+// append one histogram, with Prometheus cumulative buckets
+//
+static void AppendHistogram(const char* Name, const char* Labels, struct MetricsHistogram* Histogram)
+{
+  uint32_t Bucket;
+  uint64_t Cumulative = 0;
+
+  for(Bucket = 0; Bucket < VMETRICBUCKETS; Bucket++)
+  {
+    Cumulative += __atomic_load_n(&Histogram->Buckets[Bucket], __ATOMIC_RELAXED);
+    AppendMetricsText("p2app_%s_bucket{%s,le=\"%u\"} %llu\n", Name, Labels, 1U << Bucket, (unsigned long long)Cumulative);
+  }
+  Cumulative += __atomic_load_n(&Histogram->Buckets[VMETRICBUCKETS], __ATOMIC_RELAXED);
+  AppendMetricsText("p2app_%s_bucket{%s,le=\"+Inf\"} %llu\n", Name, Labels, (unsigned long long)Cumulative);
+  AppendMetricsText("p2app_%s_sum{%s} %llu\n", Name, Labels,
+                    (unsigned long long)__atomic_load_n(&Histogram->Sum, __ATOMIC_RELAXED));
+  AppendMetricsText("p2app_%s_count{%s} %llu\n", Name, Labels, (unsigned long long)Cumulative);
+}
+
+
+//
+// append one histogram for every stream
+//
+static void AppendStreamHistogram(const char* Name, const char* Help, size_t Offset)
+{
+  uint32_t Stream;
+  char Labels[32];
+
+  AppendMetricsText("# HELP p2app_%s %s\n# TYPE p2app_%s histogram\n", Name, Help, Name);
+  for(Stream = 0; Stream < VNUMMETRICSTREAMS; Stream++)
+  {
+    snprintf(Labels, sizeof(Labels), "stream=\"%s\"", MetricsStreamNames[Stream]);
+    AppendHistogram(Name, Labels, (struct MetricsHistogram*)((uint8_t*)&Metrics[Stream] + Offset));
+  }
+}
+
+
+//
+// percentile of a sampled FIFO occupancy: the top of the bucket holding that fraction of samples
+//
+static uint32_t FIFOSamplePercentile(struct FIFOSampleHistogram* Histogram, uint64_t Count, double Fraction)
+{
+  uint32_t Bucket;
+  uint64_t Rank, Cumulative = 0;
+  uint32_t Value;
+
+  Rank = (uint64_t)(Fraction * (double)Count + 0.999999);
+  if(Rank == 0)
+    Rank = 1;
+  for(Bucket = 0; Bucket < VFIFOSAMPLEBUCKETS - 1; Bucket++)
+  {
+    Cumulative += __atomic_load_n(&Histogram->Buckets[Bucket], __ATOMIC_RELAXED);
+    if(Cumulative >= Rank)
+      break;
+  }
+  Value = (Bucket + 1) * Histogram->BucketWidth - 1;
+  if(Value > Histogram->Max)
+    Value = Histogram->Max;
+  return Value;
+}
+
+
+//
+// append the sampled FIFO occupancy, if the sampler is running
+// FIFO channels are in the same order as the first 4 metrics streams
+//
+static void AppendFIFOSamples(void)
+{
+  static const double Quantiles[] = {0.5, 0.9, 0.99, 0.999};
+  uint32_t Channel, Cntr;
+  uint64_t Count;
+  struct FIFOSampleHistogram* Histogram;
+
+  if(SamplerRate == 0)
+    return;
+  AppendMetricsText("# HELP p2app_fifo_occupancy FIFO occupied locations, sampled %u times per second\n"
+                    "# TYPE p2app_fifo_occupancy summary\n", SamplerRate);
+  for(Channel = 0; Channel < VNUMDMAFIFO; Channel++)
+  {
+    Histogram = &FIFOSamples[Channel];
+    Count = __atomic_load_n(&Histogram->Count, __ATOMIC_ACQUIRE);
+    if(Count == 0)
+      continue;
+    for(Cntr = 0; Cntr < sizeof(Quantiles) / sizeof(Quantiles[0]); Cntr++)
+      AppendMetricsText("p2app_fifo_occupancy{fifo=\"%s\",quantile=\"%g\"} %u\n", MetricsStreamNames[Channel],
+                        Quantiles[Cntr], FIFOSamplePercentile(Histogram, Count, Quantiles[Cntr]));
+    AppendMetricsText("p2app_fifo_occupancy_sum{fifo=\"%s\"} %llu\n", MetricsStreamNames[Channel],
+                      (unsigned long long)__atomic_load_n(&Histogram->Sum, __ATOMIC_RELAXED));
+    AppendMetricsText("p2app_fifo_occupancy_count{fifo=\"%s\"} %llu\n", MetricsStreamNames[Channel], (unsigned long long)Count);
+  }
+  AppendMetricsText("# HELP p2app_fifo_occupancy_min lowest sampled FIFO occupied locations\n# TYPE p2app_fifo_occupancy_min gauge\n");
+  for(Channel = 0; Channel < VNUMDMAFIFO; Channel++)
+    if(__atomic_load_n(&FIFOSamples[Channel].Count, __ATOMIC_ACQUIRE) != 0)
+      AppendMetricsText("p2app_fifo_occupancy_min{fifo=\"%s\"} %u\n", MetricsStreamNames[Channel],
+                        __atomic_load_n(&FIFOSamples[Channel].Min, __ATOMIC_RELAXED));
+  AppendMetricsText("# HELP p2app_fifo_occupancy_max highest sampled FIFO occupied locations\n# TYPE p2app_fifo_occupancy_max gauge\n");
+  for(Channel = 0; Channel < VNUMDMAFIFO; Channel++)
+    if(__atomic_load_n(&FIFOSamples[Channel].Count, __ATOMIC_ACQUIRE) != 0)
+      AppendMetricsText("p2app_fifo_occupancy_max{fifo=\"%s\"} %u\n", MetricsStreamNames[Channel],
+                        __atomic_load_n(&FIFOSamples[Channel].Max, __ATOMIC_RELAXED));
+  AppendMetricsText("# HELP p2app_fifo_size_locations FIFO depth, 64 bit locations\n# TYPE p2app_fifo_size_locations gauge\n");
+  for(Channel = 0; Channel < VNUMDMAFIFO; Channel++)
+    AppendMetricsText("p2app_fifo_size_locations{fifo=\"%s\"} %u\n", MetricsStreamNames[Channel], FIFOSamples[Channel].Depth);
+}
+
+
+//
+// loops over the deadline watchdog budget
+//
+static void AppendDeadlineMisses(void)
+{
+  uint32_t Stream;
+
+  AppendMetricsText("# HELP p2app_deadline_misses_total stream loops longer than the watchdog budget\n"
+                    "# TYPE p2app_deadline_misses_total counter\n");
+  for(Stream = 0; Stream < VNUMMETRICSTREAMS; Stream++)
+    AppendMetricsText("p2app_deadline_misses_total{stream=\"%s\"} %llu\n", MetricsStreamNames[Stream],
+                      (unsigned long long)GetLoopDeadlineMisses((EMetricsStream)Stream));
+}
+
+
+//
+// memory: the buffers each stream holds, and the process resident set from /proc
+//
+static void AppendMemory(void)
+{
+  uint32_t Stream;
+  unsigned long long Pages, Resident;
+  FILE* Statm;
+
+  AppendMetricsText("# HELP p2app_buffer_bytes stream buffer memory allocated\n# TYPE p2app_buffer_bytes gauge\n");
+  for(Stream = 0; Stream < VNUMMETRICSTREAMS; Stream++)
+    AppendMetricsText("p2app_buffer_bytes{stream=\"%s\"} %lld\n", MetricsStreamNames[Stream],
+                      (long long)__atomic_load_n(&Metrics[Stream].BufferBytes, __ATOMIC_RELAXED));
+  Statm = fopen("/proc/self/statm", "r");
+  if(Statm == NULL)
+    return;
+  if(fscanf(Statm, "%llu %llu", &Pages, &Resident) == 2)
+    AppendMetricsText("# HELP p2app_resident_bytes process resident memory\n# TYPE p2app_resident_bytes gauge\n"
+                      "p2app_resident_bytes %llu\n", Resident * (unsigned long long)sysconf(_SC_PAGESIZE));
+  fclose(Statm);
+}
+
+
+//
+// temperatures and CPU governor state, as last read by the governor thread
+//
+static void AppendGovernorStatus(void)
+{
+  struct GovernorStatus Status;
+
+  GetGovernorStatus(&Status);
+  if(!Status.Valid)
+    return;
+  AppendMetricsText("# HELP p2app_fpga_temperature_celsius FPGA die temperature\n# TYPE p2app_fpga_temperature_celsius gauge\n"
+                    "p2app_fpga_temperature_celsius %.1f\n", Status.FPGATemperature / 1000.0);
+  AppendMetricsText("# HELP p2app_cpu_temperature_celsius CPU temperature\n# TYPE p2app_cpu_temperature_celsius gauge\n"
+                    "p2app_cpu_temperature_celsius %.1f\n", Status.CPUTemperature / 1000.0);
+  AppendMetricsText("# HELP p2app_cpu_performance_mode 1 while the performance governor settings are applied\n"
+                    "# TYPE p2app_cpu_performance_mode gauge\np2app_cpu_performance_mode %d\n", Status.Performance ? 1 : 0);
+}
+
+
+//
+// standby state, and the time from the run bit to the 1st DDC packet (see standby.h)
+//
+static void AppendAttachStatus(void)
+{
+  struct AttachStatus Status;
+
+  GetAttachStatus(&Status);
+  AppendMetricsText("# HELP p2app_standby_ready 1 while idle with the DDC stream ready to start\n"
+                    "# TYPE p2app_standby_ready gauge\np2app_standby_ready %d\n", Status.Ready ? 1 : 0);
+  AppendMetricsText("# HELP p2app_attach_total sessions started by a run bit\n"
+                    "# TYPE p2app_attach_total counter\np2app_attach_total %llu\n", (unsigned long long)Status.Attaches);
+  AppendMetricsText("# HELP p2app_attach_on_time_total sessions whose 1st DDC packet went within one packet interval\n"
+                    "# TYPE p2app_attach_on_time_total counter\np2app_attach_on_time_total %llu\n",
+                    (unsigned long long)Status.OnTime);
+  AppendMetricsText("# HELP p2app_attach_latency_microseconds run bit arrival to 1st DDC packet sent, last session\n"
+                    "# TYPE p2app_attach_latency_microseconds gauge\np2app_attach_latency_microseconds %u\n",
+                    Status.LastLatency_us);
+  AppendMetricsText("# HELP p2app_attach_latency_max_microseconds longest run bit arrival to 1st DDC packet sent\n"
+                    "# TYPE p2app_attach_latency_max_microseconds gauge\np2app_attach_latency_max_microseconds %u\n",
+                    Status.MaxLatency_us);
+  AppendMetricsText("# HELP p2app_attach_packet_interval_microseconds DDC packet interval at the fastest rate, last session\n"
+                    "# TYPE p2app_attach_packet_interval_microseconds gauge\np2app_attach_packet_interval_microseconds %u\n",
+                    Status.LastInterval_us);
+}
+
+
+//
+// the latest telemetry snapshot from the high priority thread: no register reads here
+//
+static void AppendTelemetry(void)
+{
+  static const char* AnalogueNames[VNUMANALOGUEIN] = {"forward_power", "reverse_power", "user_analog1",
+                                                      "user_analog2", "exciter_power", "supply_voltage"};
+  struct TelemetrySnapshot Telemetry;
+  uint32_t Cntr;
+
+  GetTelemetrySnapshot(&Telemetry);
+  if(Telemetry.Count == 0)
+    return;
+  AppendMetricsText("# HELP p2app_analogue_input RF board analogue inputs, raw ADC counts\n# TYPE p2app_analogue_input gauge\n");
+  for(Cntr = 0; Cntr < VNUMANALOGUEIN; Cntr++)
+    AppendMetricsText("p2app_analogue_input{input=\"%s\"} %u\n", AnalogueNames[Cntr], Telemetry.Analogue[Cntr]);
+  AppendMetricsText("# HELP p2app_status_register FPGA status register\n# TYPE p2app_status_register gauge\n"
+                    "p2app_status_register %u\n", Telemetry.Status);
+}
+
+
+//
+// per thread CPU, context switches and system calls, from the thread stats sampler
+//
+static void AppendThreadStats(void)
+{
+  static struct ThreadStats Stats[VMAXSTATSTHREADS];    // metrics thread only
+  uint32_t Count, Cntr;
+  struct ThreadStats* Entry;
+  double TicksPerSecond = (double)sysconf(_SC_CLK_TCK);
+
+  Count = GetThreadStats(Stats, VMAXSTATSTHREADS);
+  if(Count == 0)
+    return;
+  AppendMetricsText("# HELP p2app_thread_cpu_seconds_total user and system CPU time of each thread\n"
+                    "# TYPE p2app_thread_cpu_seconds_total counter\n");
+  for(Cntr = 0, Entry = Stats; Cntr < Count; Cntr++, Entry++)
+    AppendMetricsText("p2app_thread_cpu_seconds_total{tid=\"%d\",thread=\"%s\"} %.2f\n", Entry->TID, Entry->Name,
+                      Entry->CPUTicks / TicksPerSecond);
+  AppendMetricsText("# HELP p2app_thread_cpu_percent CPU use of each thread over the last second, percent of one CPU\n"
+                    "# TYPE p2app_thread_cpu_percent gauge\n");
+  for(Cntr = 0, Entry = Stats; Cntr < Count; Cntr++, Entry++)
+    AppendMetricsText("p2app_thread_cpu_percent{tid=\"%d\",thread=\"%s\"} %.1f\n", Entry->TID, Entry->Name, Entry->CPUPercent);
+  AppendMetricsText("# HELP p2app_thread_context_switches_total context switches of each thread\n"
+                    "# TYPE p2app_thread_context_switches_total counter\n");
+  for(Cntr = 0, Entry = Stats; Cntr < Count; Cntr++, Entry++)
+    AppendMetricsText("p2app_thread_context_switches_total{tid=\"%d\",thread=\"%s\",type=\"voluntary\"} %llu\n"
+                      "p2app_thread_context_switches_total{tid=\"%d\",thread=\"%s\",type=\"involuntary\"} %llu\n",
+                      Entry->TID, Entry->Name, (unsigned long long)Entry->VoluntarySwitches,
+                      Entry->TID, Entry->Name, (unsigned long long)Entry->InvoluntarySwitches);
+  AppendMetricsText("# HELP p2app_thread_context_switches_per_second context switches of each thread over the last second\n"
+                    "# TYPE p2app_thread_context_switches_per_second gauge\n");
+  for(Cntr = 0, Entry = Stats; Cntr < Count; Cntr++, Entry++)
+    AppendMetricsText("p2app_thread_context_switches_per_second{tid=\"%d\",thread=\"%s\"} %.1f\n", Entry->TID, Entry->Name,
+                      Entry->SwitchesPerSecond);
+  AppendMetricsText("# HELP p2app_thread_io_calls_total read and write type system calls of each thread\n"
+                    "# TYPE p2app_thread_io_calls_total counter\n");
+  for(Cntr = 0, Entry = Stats; Cntr < Count; Cntr++, Entry++)
+    AppendMetricsText("p2app_thread_io_calls_total{tid=\"%d\",thread=\"%s\"} %llu\n", Entry->TID, Entry->Name,
+                      (unsigned long long)Entry->IOCalls);
+  //
+  // perf counters, if they could be opened
+  //
+  if(Stats[0].HasSyscalls)
+  {
+    AppendMetricsText("# HELP p2app_thread_syscalls_total system calls of each thread\n"
+                      "# TYPE p2app_thread_syscalls_total counter\n");
+    for(Cntr = 0, Entry = Stats; Cntr < Count; Cntr++, Entry++)
+      if(Entry->HasSyscalls)
+        AppendMetricsText("p2app_thread_syscalls_total{tid=\"%d\",thread=\"%s\"} %llu\n", Entry->TID, Entry->Name,
+                          (unsigned long long)Entry->Syscalls);
+    AppendMetricsText("# HELP p2app_thread_syscalls_per_second system calls of each thread over the last second\n"
+                      "# TYPE p2app_thread_syscalls_per_second gauge\n");
+    for(Cntr = 0, Entry = Stats; Cntr < Count; Cntr++, Entry++)
+      if(Entry->HasSyscalls)
+        AppendMetricsText("p2app_thread_syscalls_per_second{tid=\"%d\",thread=\"%s\"} %.1f\n", Entry->TID, Entry->Name,
+                          Entry->SyscallsPerSecond);
+  }
+  if(Stats[0].HasCycles && Stats[0].HasInstructions)
+  {
+    AppendMetricsText("# HELP p2app_thread_cycles_total CPU cycles of each thread\n# TYPE p2app_thread_cycles_total counter\n");
+    for(Cntr = 0, Entry = Stats; Cntr < Count; Cntr++, Entry++)
+      if(Entry->HasCycles)
+        AppendMetricsText("p2app_thread_cycles_total{tid=\"%d\",thread=\"%s\"} %llu\n", Entry->TID, Entry->Name,
+                          (unsigned long long)Entry->Cycles);
+    AppendMetricsText("# HELP p2app_thread_instructions_total instructions executed by each thread\n"
+                      "# TYPE p2app_thread_instructions_total counter\n");
+    for(Cntr = 0, Entry = Stats; Cntr < Count; Cntr++, Entry++)
+      if(Entry->HasInstructions)
+        AppendMetricsText("p2app_thread_instructions_total{tid=\"%d\",thread=\"%s\"} %llu\n", Entry->TID, Entry->Name,
+                          (unsigned long long)Entry->Instructions);
+  }
+}
+
+
+//
+// build the complete metrics text
+//
+static void BuildMetricsText(void)
+{
+  MetricsTextLength = 0;
+  AppendStreamCounter("packets_total", "UDP packets sent or received", offsetof(struct StreamMetrics, Packets));
+  AppendStreamCounter("dma_transfers_total", "DMA transfers", offsetof(struct StreamMetrics, DMATransfers));
+  AppendStreamCounter("dma_bytes_total", "bytes transferred by DMA", offsetof(struct StreamMetrics, DMABytes));
+  AppendStreamCounter("fifo_over_threshold_total", "FIFO over threshold events", offsetof(struct StreamMetrics, OverThreshold));
+  AppendStreamCounter("fifo_underflow_total", "FIFO underflow events", offsetof(struct StreamMetrics, Underflows));
+  AppendStreamCounter("send_errors_total", "failed UDP sends", offsetof(struct StreamMetrics, SendErrors));
+  AppendStreamCounter("sequence_gaps_total", "received packets missing from the sequence", offsetof(struct StreamMetrics, SequenceGaps));
+  AppendStreamCounter("sequence_errors_total", "received packets out of order or repeated", offsetof(struct StreamMetrics, SequenceErrors));
+  AppendStreamCounter("reorder_reordered_total", "packets put back in sequence by the reorder buffer", offsetof(struct StreamMetrics, Reordered));
+  AppendStreamCounter("reorder_lost_total", "missing packets concealed by the reorder buffer", offsetof(struct StreamMetrics, Lost));
+  AppendStreamCounter("reorder_late_total", "packets too late for the reorder buffer", offsetof(struct StreamMetrics, Late));
+  AppendStreamHistogram("dma_size_bytes", "bytes per DMA transfer", offsetof(struct StreamMetrics, DMASize));
+  AppendStreamHistogram("fifo_depth_words", "FIFO depth at DMA time, 64 bit words", offsetof(struct StreamMetrics, FIFODepth));
+  AppendStreamHistogram("loop_time_microseconds", "time to process one loop, not including the wait for data", offsetof(struct StreamMetrics, LoopTime));
+  AppendDeadlineMisses();
+  AppendFIFOSamples();
+  AppendMemory();
+  AppendGovernorStatus();
+  AppendAttachStatus();
+  AppendTelemetry();
+  AppendThreadStats();
+}
+
+
+//
+// JSON: one histogram as an array of bucket counts (not cumulative)
+//
+static void AppendJSONHistogram(const char* Name, struct MetricsHistogram* Histogram)
+{
+  uint32_t Bucket;
+
+  AppendMetricsText("\"%s\":{\"sum\":%llu,\"count\":%llu,\"buckets\":[", Name,
+                    (unsigned long long)__atomic_load_n(&Histogram->Sum, __ATOMIC_RELAXED),
+                    (unsigned long long)__atomic_load_n(&Histogram->Count, __ATOMIC_RELAXED));
+  for(Bucket = 0; Bucket <= VMETRICBUCKETS; Bucket++)
+    AppendMetricsText("%s%llu", (Bucket == 0) ? "" : ",",
+                      (unsigned long long)__atomic_load_n(&Histogram->Buckets[Bucket], __ATOMIC_RELAXED));
+  AppendMetricsText("]}");
+}
+
+
+//
+// JSON: CPU time of every p2app thread, from /proc; the names are those set by the thread manager
+// with the thread stats sampler running, its rates over the last second are added
+//
+static void AppendJSONThreads(void)
+{
+  static struct ThreadStats Stats[VMAXSTATSTHREADS];    // metrics thread only
+  struct ThreadStats* Entry;
+  uint32_t Count, Cntr;
+  int TID;
+  DIR* Tasks;
+  struct dirent* Task;
+  FILE* Stat;
+  char Path[288];                               // /proc/self/task/<up to 255 characters>/stat
+  char Line[512];
+  char Name[32];
+  char* NameEnd;
+  unsigned long long UserTime, SystemTime;
+  int Processor;
+  bool First = true;
+
+  Count = GetThreadStats(Stats, VMAXSTATSTHREADS);
+  AppendMetricsText(",\"ticks_per_second\":%ld,\"threads\":[", sysconf(_SC_CLK_TCK));
+  Tasks = opendir("/proc/self/task");
+  while((Tasks != NULL) && ((Task = readdir(Tasks)) != NULL))
+  {
+    if(Task->d_name[0] == '.')
+      continue;
+    snprintf(Path, sizeof(Path), "/proc/self/task/%s/stat", Task->d_name);
+    Stat = fopen(Path, "r");
+    if(Stat == NULL)
+      continue;
+    if((fgets(Line, sizeof(Line), Stat) != NULL) && ((NameEnd = strrchr(Line, ')')) != NULL)
+       && (sscanf(Line, "%*d (%31[^)]", Name) == 1)
+       //  state ppid pgrp session tty tpgid flags minflt cminflt majflt cmajflt utime stime, ... processor is field 39
+       && (sscanf(NameEnd + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu %*d %*d %*d %*d %*d %*d %*u %*u %*d "
+                  "%*u %*u %*u %*u %*u %*u %*u %*u %*u %*u %*u %*u %*u %*d %d", &UserTime, &SystemTime, &Processor) == 3))
+    {
+      AppendMetricsText("%s{\"tid\":%s,\"name\":\"%s\",\"cpu_ticks\":%llu,\"processor\":%d", First ? "" : ",",
+                        Task->d_name, Name, UserTime + SystemTime, Processor);
+      TID = atoi(Task->d_name);
+      for(Cntr = 0, Entry = Stats; Cntr < Count; Cntr++, Entry++)
+        if(Entry->TID == TID)
+        {
+          AppendMetricsText(",\"cpu_percent\":%.1f,\"context_switches_per_second\":%.1f,\"io_calls_per_second\":%.1f",
+                            Entry->CPUPercent, Entry->SwitchesPerSecond, Entry->IOCallsPerSecond);
+          if(Entry->HasSyscalls)
+            AppendMetricsText(",\"syscalls_per_second\":%.1f", Entry->SyscallsPerSecond);
+          if(Entry->HasCycles && Entry->HasInstructions)
+            AppendMetricsText(",\"instructions_per_cycle\":%.2f", Entry->InstructionsPerCycle);
+          break;
+        }
+      AppendMetricsText("}");
+      First = false;
+    }
+    fclose(Stat);
+  }
+  if(Tasks != NULL)
+    closedir(Tasks);
+  AppendMetricsText("]");
+}
+
+
+//
+// build the metrics as JSON, for the web dashboard (GET /metrics.json)
+// counters are totals: the dashboard works out rates from successive readings
+//
+static void BuildMetricsJSON(void)
+{
+  struct GovernorStatus Status;
+  struct AttachStatus Attach;
+  struct FIFOSampleHistogram* Histogram;
+  struct StreamMetrics* Entry;
+  struct timespec Now;
+  uint32_t Stream, Bucket;
+  uint64_t Count;
+
+  MetricsTextLength = 0;
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  AppendMetricsText("{\"time\":%.3f,\"streams\":{", Now.tv_sec + Now.tv_nsec / 1.0E9);
+  for(Stream = 0; Stream < VNUMMETRICSTREAMS; Stream++)
+  {
+    Entry = &Metrics[Stream];
+    AppendMetricsText("%s\"%s\":{\"packets\":%llu,\"dma_transfers\":%llu,\"dma_bytes\":%llu,"
+                      "\"over_threshold\":%llu,\"underflows\":%llu,\"send_errors\":%llu,\"sequence_gaps\":%llu,"
+                      "\"reordered\":%llu,\"lost\":%llu,\"late\":%llu,"
+                      "\"deadline_misses\":%llu,\"buffer_bytes\":%lld,",
+                      (Stream == 0) ? "" : ",", MetricsStreamNames[Stream],
+                      (unsigned long long)__atomic_load_n(&Entry->Packets, __ATOMIC_RELAXED),
+                      (unsigned long long)__atomic_load_n(&Entry->DMATransfers, __ATOMIC_RELAXED),
+                      (unsigned long long)__atomic_load_n(&Entry->DMABytes, __ATOMIC_RELAXED),
+                      (unsigned long long)__atomic_load_n(&Entry->OverThreshold, __ATOMIC_RELAXED),
+                      (unsigned long long)__atomic_load_n(&Entry->Underflows, __ATOMIC_RELAXED),
+                      (unsigned long long)__atomic_load_n(&Entry->SendErrors, __ATOMIC_RELAXED),
+                      (unsigned long long)__atomic_load_n(&Entry->SequenceGaps, __ATOMIC_RELAXED),
+                      (unsigned long long)__atomic_load_n(&Entry->Reordered, __ATOMIC_RELAXED),
+                      (unsigned long long)__atomic_load_n(&Entry->Lost, __ATOMIC_RELAXED),
+                      (unsigned long long)__atomic_load_n(&Entry->Late, __ATOMIC_RELAXED),
+                      (unsigned long long)GetLoopDeadlineMisses((EMetricsStream)Stream),
+                      (long long)__atomic_load_n(&Entry->BufferBytes, __ATOMIC_RELAXED));
+    AppendJSONHistogram("dma_size_bytes", &Entry->DMASize);
+    AppendMetricsText(",");
+    AppendJSONHistogram("fifo_depth_words", &Entry->FIFODepth);
+    AppendMetricsText(",");
+    AppendJSONHistogram("loop_time_us", &Entry->LoopTime);
+    AppendMetricsText("}");
+  }
+  //
+  // sampled FIFO occupancy, if the sampler is running: VFIFOSAMPLEBUCKETS equal buckets of the FIFO depth
+  //
+  AppendMetricsText("},\"fifo_sample_rate\":%u,\"fifo\":{", SamplerRate);
+  for(Stream = 0; (SamplerRate != 0) && (Stream < VNUMDMAFIFO); Stream++)
+  {
+    Histogram = &FIFOSamples[Stream];
+    Count = __atomic_load_n(&Histogram->Count, __ATOMIC_ACQUIRE);
+    AppendMetricsText("%s\"%s\":{\"depth\":%u,\"count\":%llu,\"min\":%u,\"max\":%u,\"sum\":%llu,\"buckets\":[",
+                      (Stream == 0) ? "" : ",", MetricsStreamNames[Stream], Histogram->Depth, (unsigned long long)Count,
+                      (Count != 0) ? __atomic_load_n(&Histogram->Min, __ATOMIC_RELAXED) : 0,
+                      __atomic_load_n(&Histogram->Max, __ATOMIC_RELAXED),
+                      (unsigned long long)__atomic_load_n(&Histogram->Sum, __ATOMIC_RELAXED));
+    for(Bucket = 0; Bucket < VFIFOSAMPLEBUCKETS; Bucket++)
+      AppendMetricsText("%s%llu", (Bucket == 0) ? "" : ",",
+                        (unsigned long long)__atomic_load_n(&Histogram->Buckets[Bucket], __ATOMIC_RELAXED));
+    AppendMetricsText("]}");
+  }
+  AppendMetricsText("}");
+  GetGovernorStatus(&Status);
+  if(Status.Valid)
+    AppendMetricsText(",\"temperature\":{\"fpga\":%.1f,\"cpu\":%.1f},\"performance_mode\":%s",
+                      Status.FPGATemperature / 1000.0, Status.CPUTemperature / 1000.0, Status.Performance ? "true" : "false");
+  GetAttachStatus(&Attach);
+  AppendMetricsText(",\"attach\":{\"standby_ready\":%s,\"count\":%llu,\"on_time\":%llu,\"latency_us\":%u,"
+                    "\"max_latency_us\":%u,\"packet_interval_us\":%u}",
+                    Attach.Ready ? "true" : "false", (unsigned long long)Attach.Attaches, (unsigned long long)Attach.OnTime,
+                    Attach.LastLatency_us, Attach.MaxLatency_us, Attach.LastInterval_us);
+  AppendJSONThreads();
+  AppendMetricsText("}\n");
+}
+
+
+//
+// find a query parameter in a request target, eg "ddc" in /record/start?ddc=0,1&dir=/mnt
+// copies its value (not URL decoded) to Value; returns false if not present
+//
+static bool GetRecordParameter(const char* Target, const char* Name, char* Value, size_t Length)
+{
+  const char* Ptr;
+  size_t NameLength = strlen(Name);
+  size_t Cntr = 0;
+
+  Ptr = strchr(Target, '?');
+  while(Ptr != NULL)
+  {
+    Ptr++;
+    if((strncmp(Ptr, Name, NameLength) == 0) && (Ptr[NameLength] == '='))
+    {
+      Ptr += NameLength + 1;
+      while((Cntr < Length - 1) && (Ptr[Cntr] != 0) && (Ptr[Cntr] != '&') && (Ptr[Cntr] != ' '))
+      {
+        Value[Cntr] = Ptr[Cntr];
+        Cntr++;
+      }
+      Value[Cntr] = 0;
+      return true;
+    }
+    Ptr = strchr(Ptr, '&');
+  }
+  return false;
+}
+
+
+//
+// answer a /record request: start, stop or report the I/Q recorder
+//   /record/start?ddc=0,1&dir=/mnt/ssd    (dir is optional)
+//   /record/stop
+//   /record
+//
+static void BuildRecordText(const char* Target)
+{
+  char Value[256];
+  char* Ptr;
+  uint32_t Mask = 0;
+  long DDC;
+
+  MetricsTextLength = 0;
+  if(strncmp(Target, "/record/start", 13) == 0)
+  {
+    if(GetRecordParameter(Target, "ddc", Value, sizeof(Value)))
+    {
+      Ptr = Value;
+      while(*Ptr != 0)
+      {
+        DDC = strtol(Ptr, &Ptr, 10);
+        if((DDC >= 0) && (DDC < VNUMDDC))
+          Mask |= 1 << DDC;
+        if(*Ptr != 0)
+          Ptr++;
+      }
+    }
+    if(Mask == 0)
+      AppendMetricsText("no DDCs given: use /record/start?ddc=0,1\n");
+    else if(!StartIQRecording(Mask, GetRecordParameter(Target, "dir", Value, sizeof(Value)) ? Value : NULL))
+      AppendMetricsText("recording not started\n");
+  }
+  else if(strncmp(Target, "/record/stop", 12) == 0)
+    StopIQRecording();
+  if(MetricsTextLength < VMETRICSBUFFERSIZE)
+    MetricsTextLength += GetIQRecordingStatus(MetricsText + MetricsTextLength, VMETRICSBUFFERSIZE - MetricsTextLength);
+}
+
+
+//
+// metrics server thread
+// answers every connection with the current metrics, then closes it
+//
+static void* MetricsServer(void* arg)
+{
+  int Connection;
+  char Request[512];
+  char Header[128];
+  struct timeval ReadTimeout;
+  int HeaderLength;
+  ssize_t RequestLength;
+  const char* ContentType;
+
+  (void)arg;
+  printf("spinning up metrics server thread, pid=%ld\n", syscall(SYS_gettid));
+  while(true)
+  {
+    Connection = accept(MetricsSocketid, NULL, NULL);
+    if(Connection < 0)
+    {
+      perror("accept, metrics");
+      usleep(100000);
+      continue;
+    }
+    ReadTimeout.tv_sec = 0;
+    ReadTimeout.tv_usec = 100000;
+    setsockopt(Connection, SOL_SOCKET, SO_RCVTIMEO, (void *)&ReadTimeout, sizeof(ReadTimeout));
+    RequestLength = recv(Connection, Request, sizeof(Request) - 1, 0);
+    Request[(RequestLength > 0) ? RequestLength : 0] = 0;
+    ContentType = "text/plain; version=0.0.4";
+    if(strncmp(Request, "GET /record", 11) == 0)            // I/Q recorder control
+      BuildRecordText(Request + 4);
+    else if(strncmp(Request, "GET /metrics.json", 17) == 0) // web dashboard feed
+    {
+      BuildMetricsJSON();
+      ContentType = "application/json";
+    }
+    else
+      BuildMetricsText();                                   // anything else gets the metrics
+    HeaderLength = snprintf(Header, sizeof(Header),
+                            "HTTP/1.0 200 OK\r\nContent-Type: %s\r\nContent-Length: %u\r\n\r\n",
+                            ContentType, MetricsTextLength);
+    send(Connection, Header, HeaderLength, MSG_NOSIGNAL);
+    send(Connection, MetricsText, MetricsTextLength, MSG_NOSIGNAL);
+    close(Connection);
+  }
+  return NULL;
+}
+
+
+//
+// bool InitialiseMetricsServer(uint16_t Port)
+// open the metrics TCP port and start the server thread
+//
+bool InitialiseMetricsServer(uint16_t Port)
+{
+  struct sockaddr_in Addr;
+  int yes = 1;
+
+  MetricsSocketid = socket(AF_INET, SOCK_STREAM, 0);
+  if(MetricsSocketid < 0)
+  {
+    perror("socket, metrics");
+    return false;
+  }
+  setsockopt(MetricsSocketid, SOL_SOCKET, SO_REUSEADDR, (void *)&yes, sizeof(yes));
+  memset(&Addr, 0, sizeof(Addr));
+  Addr.sin_family = AF_INET;
+  Addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  Addr.sin_port = htons(Port);
+  if((bind(MetricsSocketid, (struct sockaddr *)&Addr, sizeof(Addr)) < 0) || (listen(MetricsSocketid, 4) < 0))
+  {
+    perror("bind, metrics");
+    close(MetricsSocketid);
+    return false;
+  }
+  if(!CreateManagedThread(&MetricsThread, "metrics", eHousekeepingThread, MetricsServer, NULL))
+  {
+    perror("pthread_create metrics server");
+    close(MetricsSocketid);
+    return false;
+  }
+  printf("metrics available on TCP port %d\n", Port);
+  return true;
+}
+
+
+
+//
+// add one FIFO occupancy sample
+//
+static void RecordFIFOSample(struct FIFOSampleHistogram* Histogram, uint32_t Value)
+{
+  uint32_t Bucket;
+
+  Bucket = Value / Histogram->BucketWidth;
+  if(Bucket >= VFIFOSAMPLEBUCKETS)
+    Bucket = VFIFOSAMPLEBUCKETS - 1;
+  if(Value < Histogram->Min)
+    __atomic_store_n(&Histogram->Min, Value, __ATOMIC_RELAXED);
+  if(Value > Histogram->Max)
+    __atomic_store_n(&Histogram->Max, Value, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&Histogram->Buckets[Bucket], 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&Histogram->Sum, Value, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&Histogram->Count, 1, __ATOMIC_RELEASE);
+}
+
+
+//
+// FIFO sampler thread
+// reads every FIFO monitor channel at the sample rate, on an absolute timebase
+//
+static void* FIFOSampler(void* arg)
+{
+  struct timespec Next, Now;
+  uint32_t Channel;
+  long Period;
+
+  (void)arg;
+  printf("spinning up FIFO sampler thread, pid=%ld\n", syscall(SYS_gettid));
+  Period = 1000000000L / SamplerRate;
+  clock_gettime(CLOCK_MONOTONIC, &Next);
+  while(true)
+  {
+    for(Channel = 0; Channel < VNUMDMAFIFO; Channel++)
+      RecordFIFOSample(&FIFOSamples[Channel], SampleFIFOMonitorChannel((EDMAStreamSelect)Channel));
+    Next.tv_nsec += Period;
+    if(Next.tv_nsec >= 1000000000L)
+    {
+      Next.tv_nsec -= 1000000000L;
+      Next.tv_sec++;
+    }
+    //
+    // if we have fallen more than a period behind, restart the timebase rather than catch up
+    //
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    if((Now.tv_sec > Next.tv_sec) || ((Now.tv_sec == Next.tv_sec) && (Now.tv_nsec > Next.tv_nsec)))
+      Next = Now;
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &Next, NULL);
+  }
+  return NULL;
+}
+
+
+//
+// bool InitialiseFIFOSampler(uint32_t Rate)
+// set up the FIFO histograms and start the sampler thread
+//
+bool InitialiseFIFOSampler(uint32_t Rate)
+{
+  uint32_t Channel;
+
+  if((Rate == 0) || (Rate > VMAXFIFOSAMPLERATE))
+  {
+    printf("FIFO sample rate must be 1 to %d per second\n", VMAXFIFOSAMPLERATE);
+    return false;
+  }
+  for(Channel = 0; Channel < VNUMDMAFIFO; Channel++)
+  {
+    memset(&FIFOSamples[Channel], 0, sizeof(struct FIFOSampleHistogram));
+    FIFOSamples[Channel].Depth = GetFIFOMonitorDepth((EDMAStreamSelect)Channel);
+    FIFOSamples[Channel].BucketWidth = (FIFOSamples[Channel].Depth + VFIFOSAMPLEBUCKETS - 1) / VFIFOSAMPLEBUCKETS;
+    if(FIFOSamples[Channel].BucketWidth == 0)
+      FIFOSamples[Channel].BucketWidth = 1;
+    FIFOSamples[Channel].Min = 0xFFFFFFFF;
+  }
+  SamplerRate = Rate;
+  if(!CreateManagedThread(&FIFOSamplerThread, "FIFO sampler", eHousekeepingThread, FIFOSampler, NULL))
+  {
+    perror("pthread_create FIFO sampler");
+    SamplerRate = 0;
+    return false;
+  }
+  printf("sampling FIFO occupancy %d times per second\n", Rate);
+  return true;
+}
@@ -0,0 +1,115 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2 
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// metrics.h:
+//
+// header: runtime stream health metrics
+// counters and histograms for each stream, updated with relaxed atomic adds
+// by the stream threads. An optional TCP server returns them as
+// Prometheus format text to an HTTP GET, so they can be scraped.
+// GET /record... on the same port controls the I/Q recorder (see iqrecorder.h)
+// GET /metrics.json returns the same counters and histograms as JSON, with the
+// FIFO sample histograms, temperatures, client attach times (standby.h) and CPU time
+// per thread, for the web dashboard
+// per thread CPU, context switches and system calls come from threadstats.h
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __metrics_h
+#define __metrics_h
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "../common/saturntypes.h"
+
+
+#define VMETRICBUCKETS 20                       // histogram buckets: <= 1, 2, 4 ... 2^19, then +Inf
+#define VFIFOSAMPLEBUCKETS 128                  // FIFO sampler histogram buckets, each 1/128 of the FIFO depth
+#define VMAXFIFOSAMPLERATE 10000                // highest FIFO sample rate, Hz
+
+
+//
+// streams metrics are kept for
+//
+typedef enum
+{
+  eDDCMetrics,                  // RX DDC I/Q
+  eDUCMetrics,                  // TX DUC I/Q
+  eMicMetrics,                  // codec mic audio
+  eSpkMetrics,                  // codec speaker audio
+  eWBMetrics,                   // wideband
+  eHPMetrics                    // high priority from client (sequence checks only)
+} EMetricsStream;
+
+#define VNUMMETRICSTREAMS 6
+
+
+//
+// power of 2 bucket histogram
+//
+struct MetricsHistogram
+{
+  uint64_t Buckets[VMETRICBUCKETS + 1];         // count of values in each bucket (not cumulative)
+  uint64_t Sum;                                 // sum of all values recorded
+  uint64_t Count;                               // number of values recorded
+};
+
+
+//
+// void MetricsHistogramRecord(struct MetricsHistogram* Histogram, uint32_t Value)
+// add one value to a histogram. Can be called from any thread.
+//
+void MetricsHistogramRecord(struct MetricsHistogram* Histogram, uint32_t Value);
+
+
+//
+// stream metrics updates. Can be called from any thread.
+//   MetricsCountPackets:       UDP packets sent or received
+//   MetricsRecordDMA:          one DMA transfer of Bytes, with the FIFO occupied locations when it was made
+//   MetricsCountOverThreshold, MetricsCountUnderflow: FIFO monitor events
+//   MetricsCountSendError:     failed sendmsg/sendmmsg calls
+//   MetricsRecordLoopTime:     processing time of one stream loop since *Start; *Start is set to now
+//   MetricsCheckSequence:      check the sequence number of a received packet, counting packets
+//                              lost or out of order. Sequence 0 restarts the count. One thread per stream.
+//   MetricsAddBufferBytes:     note a stream buffer allocated (Bytes > 0) or released (Bytes < 0)
+//   MetricsCountReordered, MetricsCountLost, MetricsCountLate: reorder buffer (packetreorder.h) events
+//
+void MetricsCountPackets(EMetricsStream Stream, uint32_t Packets);
+void MetricsRecordDMA(EMetricsStream Stream, uint32_t Bytes, uint32_t FIFODepth);
+void MetricsCountOverThreshold(EMetricsStream Stream);
+void MetricsCountUnderflow(EMetricsStream Stream);
+void MetricsCountSendError(EMetricsStream Stream);
+void MetricsRecordLoopTime(EMetricsStream Stream, struct timespec* Start);
+void MetricsCheckSequence(EMetricsStream Stream, uint32_t Sequence);
+void MetricsAddBufferBytes(EMetricsStream Stream, int64_t Bytes);
+void MetricsCountReordered(EMetricsStream Stream);
+void MetricsCountLost(EMetricsStream Stream);
+void MetricsCountLate(EMetricsStream Stream);
+
+
+//
+// bool InitialiseMetricsServer(uint16_t Port)
+// start a thread serving the metrics as Prometheus text on a TCP port
+// returns false if the port could not be opened
+//
+bool InitialiseMetricsServer(uint16_t Port);
+
+
+//
+// bool InitialiseFIFOSampler(uint32_t Rate)
+// start a thread reading the occupancy of all 4 stream FIFOs Rate times per second.
+// min, max and percentiles of each are added to the metrics.
+// returns false if the rate is out of range or the thread could not start
+//
+bool InitialiseFIFOSampler(uint32_t Rate);
+
+
+#endif
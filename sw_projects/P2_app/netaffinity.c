@@ -0,0 +1,326 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// netaffinity.c:
+//
+// line up the ethernet interrupt and packet steering with the thread CPU sets
+//
+//////////////////////////////////////////////////////////////
+
+#include "netaffinity.h"
+#include "threaddata.h"
+#include "threadmanager.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sched.h>
+
+
+#define VNETCLASSPATH "/sys/class/net/%s"
+#define VIRQAFFINITYPATH "/proc/irq/%d/smp_affinity"
+#define VMAXNICIRQS 8                           // NIC interrupts looked for
+#define VMAXNETQUEUES 16                        // rx or tx queues looked for
+
+
+//
+// a setting changed, with the value it had
+//
+struct SavedNetSetting
+{
+    char Path[128];
+    char Value[VNETAFFINITYVALUESIZE];
+};
+
+static struct SavedNetSetting SavedSettings[VMAXNETAFFINITYFILES];
+static uint32_t SavedSettingCount = 0;
+static uint32_t FailedWrites = 0;               // settings that could not be written
+
+
+//
+// read or write one line of a sysfs or procfs file; return true if successful
+//
+static bool ReadSysfsLine(const char* Path, char* Line, size_t Length)
+{
+    FILE* File;
+    bool Result;
+
+    File = fopen(Path, "r");
+    if (File == NULL)
+        return false;
+    Result = (fgets(Line, Length, File) != NULL);
+    fclose(File);
+    if (Result)
+        Line[strcspn(Line, "\n")] = 0;
+    return Result;
+}
+
+
+static bool WriteSysfsLine(const char* Path, const char* Line)
+{
+    FILE* File;
+    bool Result;
+
+    File = fopen(Path, "w");
+    if (File == NULL)
+        return false;
+    Result = (fputs(Line, File) >= 0);
+    if (fclose(File) != 0)
+        Result = false;
+    return Result;
+}
+
+
+//
+// write a setting, saving the value it had so it can be put back
+//
+static void ChangeNetSetting(const char* Path, const char* Value)
+{
+    struct SavedNetSetting* Saved;
+
+    if (SavedSettingCount >= VMAXNETAFFINITYFILES)
+        return;
+    Saved = &SavedSettings[SavedSettingCount];
+    if (!ReadSysfsLine(Path, Saved->Value, sizeof(Saved->Value)) || !WriteSysfsLine(Path, Value))
+    {
+        FailedWrites++;
+        return;
+    }
+    strncpy(Saved->Path, Path, sizeof(Saved->Path) - 1);
+    Saved->Path[sizeof(Saved->Path) - 1] = 0;
+    SavedSettingCount++;
+}
+
+
+//
+// a CPU set as a kernel CPU mask: hex, in comma separated 32 bit groups, eg "00000001,0000000c"
+//
+static void FormatCPUMask(const cpu_set_t* Set, char* Text, size_t Length)
+{
+    int CPUCount = (int)sysconf(_SC_NPROCESSORS_CONF);
+    int Group, CPU;
+    uint32_t Word;
+    size_t Used = 0;
+
+    if (CPUCount < 1)
+        CPUCount = 1;
+    Text[0] = 0;
+    for (Group = (CPUCount - 1) / 32; Group >= 0; Group--)
+    {
+        Word = 0;
+        for (CPU = 0; CPU < 32; CPU++)
+            if (CPU_ISSET(Group * 32 + CPU, Set))
+                Word |= (1U << CPU);
+        Used += snprintf(Text + Used, (Used < Length) ? Length - Used : 0,
+                         (Used == 0) ? "%x" : ",%08x", Word);
+    }
+}
+
+
+//
+// a CPU set as a list for the report, eg "0,2-3"
+//
+static void FormatCPUList(const cpu_set_t* Set, char* Text, size_t Length)
+{
+    int CPU, Last;
+    size_t Used = 0;
+
+    Text[0] = 0;
+    for (CPU = 0; CPU < CPU_SETSIZE; CPU++)
+    {
+        if (!CPU_ISSET(CPU, Set))
+            continue;
+        for (Last = CPU; (Last + 1 < CPU_SETSIZE) && CPU_ISSET(Last + 1, Set); Last++)
+            ;
+        if (Last == CPU)
+            Used += snprintf(Text + Used, (Used < Length) ? Length - Used : 0, "%s%d", (Used == 0) ? "" : ",", CPU);
+        else
+            Used += snprintf(Text + Used, (Used < Length) ? Length - Used : 0, "%s%d-%d", (Used == 0) ? "" : ",", CPU, Last);
+        CPU = Last;
+    }
+}
+
+
+//
+// find the NIC's interrupts: its MSI vectors if it is a PCIe device, else the
+// /proc/interrupts lines named after the interface (eg "eth0", "eth0-rx-0")
+// returns the number found
+//
+static uint32_t FindNICIRQs(const char* Interface, int* IRQs)
+{
+    char Path[128];
+    char Line[512];
+    char* Name;
+    size_t NameLength = strlen(Interface);
+    uint32_t Count = 0;
+    struct dirent* Entry;
+    DIR* Dir;
+    FILE* File;
+
+    snprintf(Path, sizeof(Path), VNETCLASSPATH "/device/msi_irqs", Interface);
+    Dir = opendir(Path);
+    if (Dir != NULL)
+    {
+        while (((Entry = readdir(Dir)) != NULL) && (Count < VMAXNICIRQS))
+            if (Entry->d_name[0] != '.')
+                IRQs[Count++] = atoi(Entry->d_name);
+        closedir(Dir);
+        if (Count != 0)
+            return Count;
+    }
+    File = fopen("/proc/interrupts", "r");
+    if (File == NULL)
+        return 0;
+    while ((fgets(Line, sizeof(Line), File) != NULL) && (Count < VMAXNICIRQS))
+    {
+        Line[strcspn(Line, "\n")] = 0;
+        Name = strrchr(Line, ' ');
+        if ((Name == NULL) || (strncmp(Name + 1, Interface, NameLength) != 0))
+            continue;
+        if ((Name[NameLength + 1] != 0) && (Name[NameLength + 1] != '-') && (Name[NameLength + 1] != ':'))
+            continue;                                   // eg eth1 when looking for eth
+        IRQs[Count++] = atoi(Line);
+    }
+    fclose(File);
+    return Count;
+}
+
+
+//
+// number of rx-N or tx-N queues of an interface
+//
+static uint32_t CountNetQueues(const char* Interface, const char* Kind)
+{
+    char Path[160];
+    uint32_t Count;
+
+    for (Count = 0; Count < VMAXNETQUEUES; Count++)
+    {
+        snprintf(Path, sizeof(Path), VNETCLASSPATH "/queues/%s-%d", Interface, Kind, Count);
+        if (access(Path, F_OK) != 0)
+            break;
+    }
+    return Count;
+}
+
+
+//
+// set the NIC IRQ, RPS and XPS CPUs of an interface from the thread CPU sets
+//
+void ApplyNetAffinity(const char* Interface)
+{
+    cpu_set_t StreamCPUs, ControlCPUs, HousekeepingCPUs;
+    cpu_set_t NICCPUs, SenderCPUs, QueueCPUs;
+    bool HasStream, HasControl, HasHousekeeping;
+    char Path[160];
+    char Mask[VNETAFFINITYVALUESIZE];
+    char List[VNETAFFINITYVALUESIZE];
+    char Report[256];
+    int IRQs[VMAXNICIRQS];
+    int CPUCount = (int)sysconf(_SC_NPROCESSORS_CONF);
+    int CPU;
+    uint32_t IRQCount, RxQueues, TxQueues, Queue, Sender, Cntr;
+    size_t Used;
+
+    HasStream = GetThreadClassCPUs(eStreamThread, &StreamCPUs);
+    HasControl = GetThreadClassCPUs(eControlThread, &ControlCPUs);
+    HasHousekeeping = GetThreadClassCPUs(eHousekeepingThread, &HousekeepingCPUs);
+    if (!HasStream)
+        CPU_ZERO(&StreamCPUs);
+    for (Cntr = 0; Cntr < DDCSenderCoreCount; Cntr++)
+        CPU_SET(DDCSenderCores[Cntr], &StreamCPUs);
+    if (!HasStream && !HasControl && !HasHousekeeping && (DDCSenderCoreCount == 0))
+    {
+        printf("network affinity: no thread CPU sets (-A) to line up with; %s not changed\n", Interface);
+        return;
+    }
+
+    //
+    // the CPUs for NIC interrupts and receive steering: away from the streams
+    //
+    if (HasControl)
+        NICCPUs = ControlCPUs;
+    else if (HasHousekeeping)
+        NICCPUs = HousekeepingCPUs;
+    else
+    {
+        CPU_ZERO(&NICCPUs);
+        for (CPU = 0; CPU < CPUCount; CPU++)
+            if (!CPU_ISSET(CPU, &StreamCPUs))
+                CPU_SET(CPU, &NICCPUs);
+    }
+    if (CPU_COUNT(&NICCPUs) == 0)
+    {
+        printf("network affinity: every CPU runs stream threads; %s not changed\n", Interface);
+        return;
+    }
+    FormatCPUMask(&NICCPUs, Mask, sizeof(Mask));
+    FormatCPUList(&NICCPUs, List, sizeof(List));
+
+    IRQCount = FindNICIRQs(Interface, IRQs);
+    Used = snprintf(Report, sizeof(Report), "network affinity %s: IRQs", Interface);
+    for (Cntr = 0; Cntr < IRQCount; Cntr++)
+    {
+        snprintf(Path, sizeof(Path), VIRQAFFINITYPATH, IRQs[Cntr]);
+        ChangeNetSetting(Path, Mask);
+        Used += snprintf(Report + Used, (Used < sizeof(Report)) ? sizeof(Report) - Used : 0, " %d", IRQs[Cntr]);
+    }
+    printf("%s%s -> CPUs %s\n", Report, (IRQCount == 0) ? " (none found)" : "", List);
+
+    RxQueues = CountNetQueues(Interface, "rx");
+    for (Queue = 0; Queue < RxQueues; Queue++)
+    {
+        snprintf(Path, sizeof(Path), VNETCLASSPATH "/queues/rx-%d/rps_cpus", Interface, Queue);
+        ChangeNetSetting(Path, Mask);
+    }
+    printf("network affinity %s: RPS %d rx queues -> CPUs %s\n", Interface, RxQueues, List);
+
+    //
+    // transmit steering: sending CPUs shared round robin between the tx queues
+    //
+    SenderCPUs = StreamCPUs;
+    if (HasControl)
+        CPU_OR(&SenderCPUs, &SenderCPUs, &ControlCPUs);
+    TxQueues = CountNetQueues(Interface, "tx");
+    if ((TxQueues < 2) || (CPU_COUNT(&SenderCPUs) == 0))
+        printf("network affinity %s: %d tx queues, XPS not set\n", Interface, TxQueues);
+    else
+        for (Queue = 0; Queue < TxQueues; Queue++)
+        {
+            CPU_ZERO(&QueueCPUs);
+            Sender = 0;
+            for (CPU = 0; CPU < CPU_SETSIZE; CPU++)
+                if (CPU_ISSET(CPU, &SenderCPUs))
+                    if ((Sender++ % TxQueues) == Queue)
+                        CPU_SET(CPU, &QueueCPUs);
+            if (CPU_COUNT(&QueueCPUs) == 0)
+                continue;                               // more queues than sending CPUs
+            FormatCPUMask(&QueueCPUs, Mask, sizeof(Mask));
+            FormatCPUList(&QueueCPUs, List, sizeof(List));
+            snprintf(Path, sizeof(Path), VNETCLASSPATH "/queues/tx-%d/xps_cpus", Interface, Queue);
+            ChangeNetSetting(Path, Mask);
+            printf("network affinity %s: XPS tx-%d -> CPUs %s\n", Interface, Queue, List);
+        }
+    if (FailedWrites != 0)
+        printf("network affinity %s: %d settings could not be changed (needs root)\n", Interface, FailedWrites);
+}
+
+
+//
+// put the settings back, newest first
+//
+void RestoreNetAffinity(void)
+{
+    while (SavedSettingCount != 0)
+    {
+        SavedSettingCount--;
+        WriteSysfsLine(SavedSettings[SavedSettingCount].Path, SavedSettings[SavedSettingCount].Value);
+    }
+}
@@ -0,0 +1,53 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// netaffinity.h:
+//
+// header: line up the ethernet interrupt and packet steering with the thread
+// CPU sets (-A), so NIC interrupts and softirq work don't land on the stream
+// threads' CPUs:
+//   NIC IRQs and RPS (receive packet steering): the control thread CPUs, which
+//     take the inbound command ports; else the housekeeping CPUs; else every
+//     CPU not used by stream threads or DDC senders
+//   XPS (transmit packet steering): the sending CPUs (stream, control and DDC
+//     sender cores) shared round robin between the transmit queues, so each
+//     sender keeps to one queue and its completions stay local
+// the values found are saved, and put back at shutdown. Needs root; without
+// it the layout is reported, and nothing is changed.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __netaffinity_h
+#define __netaffinity_h
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#define VMAXNETAFFINITYFILES 32                 // IRQ and queue settings saved
+#define VNETAFFINITYVALUESIZE 64                // longest setting saved
+
+
+//
+// void ApplyNetAffinity(const char* Interface)
+// set the NIC IRQ, RPS and XPS CPUs of an interface (eg "eth0") from the thread CPU sets
+// call after InitialiseThreadManager(). Does nothing if no thread CPU sets were given.
+//
+void ApplyNetAffinity(const char* Interface);
+
+
+//
+// void RestoreNetAffinity(void)
+// put the settings back to how they were found. Call at shutdown.
+//
+void RestoreNetAffinity(void);
+
+
+#endif
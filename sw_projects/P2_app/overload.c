@@ -0,0 +1,183 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// overload.c:
+//
+// overload controller: shed wideband, then low priority DDCs, so the
+// priority DDCs don't lose samples to a DDC FIFO overflow
+//
+//////////////////////////////////////////////////////////////
+
+#include "overload.h"
+#include "OutDDCIQ.h"
+#include "housekeeping.h"
+#include "radiostate.h"
+#include "../common/saturntypes.h"
+#include "../common/saturnregisters.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+
+uint32_t GOverloadDDCShedMask = 0;
+uint8_t GOverloadWBFactor = 1;
+
+static bool OverloadUsed = false;
+static uint32_t OverloadPriorityMask = 0;       // DDCs never shed
+static uint32_t OverloadLevel = 0;              // steps shed: wideband (if enabled), then 1 DDC per step
+static uint32_t OverloadedPeriods = 0;          // consecutive periods overloaded
+static uint32_t ClearPeriods = 0;               // consecutive periods not overloaded
+static uint64_t PrevBackoffs = 0;
+static uint64_t PrevDrops = 0;
+static uint64_t PrevRingStalls = 0;
+
+
+//
+// set the priority DDCs from a string
+// format: <DDC>[,<DDC>...] or none
+//
+bool SetOverloadPriority(const char* Spec)
+{
+    const char* Ptr = Spec;
+    char* End;
+    unsigned long DDC;
+    uint32_t Mask = 0;
+
+    if(strcmp(Spec, "none") != 0)
+        while(*Ptr != 0)
+        {
+            DDC = strtoul(Ptr, &End, 10);
+            if((End == Ptr) || (DDC >= VNUMDDC) || ((*End != ',') && (*End != 0)))
+            {
+                printf("bad overload priority DDCs %s: use <DDC>[,<DDC>...] or none\n", Spec);
+                return false;
+            }
+            Mask |= (1U << DDC);
+            Ptr = (*End == ',') ? End + 1 : End;
+        }
+    OverloadPriorityMask |= Mask;
+    OverloadUsed = true;
+    return true;
+}
+
+
+//
+// increase in a back pressure count since the last period
+// the counts are cleared at each DDC session start: a count below the last one is all new
+//
+static uint64_t CountIncrease(uint64_t Count, uint64_t* Prev)
+{
+    uint64_t Increase = (Count >= *Prev) ? Count - *Prev : Count;
+
+    *Prev = Count;
+    return Increase;
+}
+
+
+//
+// set the outputs for the current level
+// the DDCs shed are the highest numbered active ones that are not priority DDCs
+//
+static void ApplyOverloadLevel(bool WidebandOn, uint32_t Candidates)
+{
+    uint32_t DDCSteps = OverloadLevel;
+    uint32_t Mask = 0;
+    uint8_t Factor = 1;
+    int DDC;
+
+    if(WidebandOn && (OverloadLevel != 0))
+    {
+        Factor = VOVERLOADWBFACTOR;
+        DDCSteps--;
+    }
+    for(DDC = VNUMDDC - 1; (DDC >= 0) && (DDCSteps != 0); DDC--)
+        if(Candidates & (1U << DDC))
+        {
+            Mask |= (1U << DDC);
+            DDCSteps--;
+        }
+    if((Mask != GOverloadDDCShedMask) || (Factor != GOverloadWBFactor))
+        printf("overload: level %d, wideband period x%d, DDCs shed = %04x\n", OverloadLevel, Factor, Mask);
+    __atomic_store_n(&GOverloadWBFactor, Factor, __ATOMIC_RELAXED);
+    __atomic_store_n(&GOverloadDDCShedMask, Mask, __ATOMIC_RELAXED);
+}
+
+
+//
+// housekeeping timer: check for overload, and shed or restore one step when due
+//
+static void OverloadTick(__attribute__((unused)) void* Arg)
+{
+    struct RadioState State;
+    uint32_t Candidates, MaxLevel, FIFOSize;
+    bool WidebandOn;
+    bool Overloaded;
+
+    ReadRadioState(&State);
+    FIFOSize = DMAFIFODepths[eRXDDCDMA];
+    Overloaded = (FIFOSize != 0) && ((uint64_t)GDDCFIFODepth * 100 > (uint64_t)FIFOSize * VOVERLOADFIFOPERCENT);
+    Overloaded |= (CountIncrease(__atomic_load_n(&GDDCSendBackoffs, __ATOMIC_RELAXED), &PrevBackoffs) != 0);
+    Overloaded |= (CountIncrease(__atomic_load_n(&GDDCSendDrops, __ATOMIC_RELAXED), &PrevDrops) != 0);
+    Overloaded |= (CountIncrease(__atomic_load_n(&GDDCRingFullStalls, __ATOMIC_RELAXED), &PrevRingStalls) != 0);
+    if(!State.SDRActive)
+    {
+        Overloaded = false;
+        OverloadLevel = 0;
+    }
+    WidebandOn = (State.WBEnables != 0);
+    Candidates = GetDDCSheddableMask() & ~OverloadPriorityMask;
+    MaxLevel = (WidebandOn ? 1 : 0) + (uint32_t)__builtin_popcount(Candidates);
+    if(Overloaded)
+    {
+        ClearPeriods = 0;
+        if(++OverloadedPeriods >= VOVERLOADESCALATE)
+        {
+            OverloadedPeriods = 0;
+            if(OverloadLevel < MaxLevel)
+                OverloadLevel++;
+        }
+    }
+    else
+    {
+        OverloadedPeriods = 0;
+        if((OverloadLevel != 0) && (++ClearPeriods >= VOVERLOADRECOVER))
+        {
+            ClearPeriods = 0;
+            OverloadLevel--;
+        }
+    }
+    if(OverloadLevel > MaxLevel)
+        OverloadLevel = MaxLevel;
+    ApplyOverloadLevel(WidebandOn, Candidates);
+}
+
+
+bool StartOverloadControl(void)
+{
+    uint32_t DDC;
+
+    if(!OverloadUsed)
+        return true;
+    printf("overload control: priority DDCs");
+    for(DDC = 0; DDC < VNUMDDC; DDC++)
+        if(OverloadPriorityMask & (1U << DDC))
+            printf(" %d", DDC);
+    printf((OverloadPriorityMask == 0) ? " none\n" : "\n");
+    return AddHousekeepingTimer("overload", VOVERLOADPERIOD, OverloadTick, NULL) >= 0;
+}
+
+
+void GetOverloadStatus(uint8_t* Flags, uint16_t* ShedMask)
+{
+    uint32_t Mask = __atomic_load_n(&GOverloadDDCShedMask, __ATOMIC_RELAXED);
+
+    *Flags = ((__atomic_load_n(&GOverloadWBFactor, __ATOMIC_RELAXED) > 1) ? VOVERLOADWIDEBAND : 0)
+             | ((Mask != 0) ? VOVERLOADDDC : 0);
+    *ShedMask = (uint16_t)Mask;
+}
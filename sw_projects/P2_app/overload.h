@@ -0,0 +1,82 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// overload.h:
+//
+// header: overload controller. When the Pi can't keep up with the outgoing
+// data, the shared DDC FIFO fills and every DDC loses samples. Instead, load
+// is shed in a fixed order so the DDCs that matter stay sample perfect:
+//   1. the wideband update period is lengthened (VOVERLOADWBFACTOR)
+//   2. then the packets of the lowest priority DDCs are dropped, one more DDC
+//      at a time: the highest numbered DDCs first, never a priority DDC, and
+//      never a PureSignal pair.
+// a housekeeping timer checks every VOVERLOADPERIOD: the host is overloaded if
+// the DDC FIFO is over VOVERLOADFIFOPERCENT full, or the DDC DMA or senders
+// had to wait for the host. Each VOVERLOADESCALATE periods overloaded sheds
+// one more step; each VOVERLOADRECOVER periods clear restores one step.
+// dropped DDC packets are still decoded (recording, shared memory export and
+// channelizers carry on); they are not sent, and the client sees a sequence
+// gap. The high priority status packet reports the state (Saturn extension):
+//   byte 39:       bit 0 = wideband rate reduced, bit 1 = DDC packets dropped
+//   bytes 40-41:   DDCs whose packets are dropped, bit per DDC (big endian)
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __overload_h
+#define __overload_h
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#define VOVERLOADPERIOD 100                     // ms between checks
+#define VOVERLOADFIFOPERCENT 50                 // DDC FIFO fill that counts as overloaded
+#define VOVERLOADESCALATE 3                     // periods overloaded before shedding one more step
+#define VOVERLOADRECOVER 50                     // periods clear before restoring one step
+#define VOVERLOADWBFACTOR 4                     // wideband update period multiplier when shed
+#define VOVERLOADWIDEBAND 0x01                  // status byte 39 bits
+#define VOVERLOADDDC 0x02
+
+
+//
+// the controller's outputs. Read by the DDC decode (DDC packets to drop) and
+// the wideband thread (update period multiplier, 1 = normal)
+//
+extern uint32_t GOverloadDDCShedMask;
+extern uint8_t GOverloadWBFactor;
+
+
+//
+// bool SetOverloadPriority(const char* Spec)
+// turn the overload controller on, with the DDCs that are never shed,
+// from a command line or config file string
+// format: <DDC>[,<DDC>...]   eg 0,1; "none" to protect no DDC
+// returns true if successful
+//
+bool SetOverloadPriority(const char* Spec);
+
+
+//
+// bool StartOverloadControl(void)
+// start the controller's housekeeping timer; does nothing if it was not turned on
+// returns false if the timer could not be added
+//
+bool StartOverloadControl(void);
+
+
+//
+// void GetOverloadStatus(uint8_t* Flags, uint16_t* ShedMask)
+// the state for the high priority status packet: VOVERLOADWIDEBAND / VOVERLOADDDC bits,
+// and the DDCs whose packets are dropped
+//
+void GetOverloadStatus(uint8_t* Flags, uint16_t* ShedMask);
+
+
+#endif
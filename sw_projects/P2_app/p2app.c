@@ -31,6 +31,7 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <netinet/udp.h>
 #include <net/if.h>
 #include <semaphore.h>
 #include <signal.h>
@@ -46,14 +47,20 @@
 #include "../common/hwaccess.h"                     // access to PCIe read & write
 #include "../common/saturnregisters.h"              // register I/O for Saturn
 #include "../common/codecwrite.h"                   // codec register I/O for Saturn
+#include "../common/saturndrivers.h"                // FIFO monitor watermarks
 #include "../common/version.h"                      // version I/O for Saturn
 #include "../common/auxadc.h"                       // version I/O for Saturn
+#include "../common/dmapool.h"                      // locked memory for DMA buffers
+#include "../common/sampleunpack.h"                 // DDC unpack and DUC I/Q swap kernels
+#include "../common/wbspectrum.h"                   // wideband power spectrum
+#include "../common/ringlog.h"                     // logging from real time threads
 
 #include "threaddata.h"
 #include "generalpacket.h"
 #include "IncomingDDCSpecific.h"
 #include "IncomingDUCSpecific.h"
 #include "InHighPriority.h"
+#include "InboundDispatcher.h"
 #include "InDUCIQ.h"
 #include "InSpkrAudio.h"
 #include "OutMicAudio.h"
@@ -64,6 +71,24 @@
 #include "LDGATU.h"
 #include "AriesATU.h"
 #include "frontpanelhandler.h"
+#include "andromedacatmessages.h"
+#include "metrics.h"
+#include "OutChannelizer.h"
+#include "ddcshm.h"
+#include "overload.h"
+#include "ddcscan.h"
+#include "ddcretransmit.h"
+#include "loopwatchdog.h"
+#include "powergovernor.h"
+#include "netaffinity.h"
+#include "housekeeping.h"
+#include "threadstats.h"
+#include "radiostate.h"
+#include "threadmanager.h"
+#include "configfile.h"
+#include "soaktest.h"
+#include "packetreorder.h"
+#include "../common/fpgareconfig.h"
 
 #define P2APPVERSION 40
 #define FWREQUIREDMAJORVERSION 1                  // major version that is required. Only altered if programming interface changes. 
@@ -119,26 +144,68 @@
 
 
 
-extern sem_t DDCInSelMutex;                 // protect access to shared DDC input select register
-extern sem_t DDCResetFIFOMutex;             // protect access to FIFO reset register
-extern sem_t RFGPIOMutex;                   // protect access to RF GPIO register
-extern sem_t CodecRegMutex;                 // protect writes to codec
 sem_t MicWBDMAMutex;                        // protect one DMA read channel shared by mic and WB read
 
 struct sockaddr_in reply_addr;              // destination address for outgoing data
 
-bool IsTXMode;                              // true if in TX
-bool SDRActive;                             // true if this SDR is running at the moment
-bool ReplyAddressSet = false;               // true when reply address has been set
+//
+// flags written by one thread and read by others in their loops: each has its own
+// cache line, so a write doesn't evict the read-mostly settings that follow.
+// accessed with __atomic builtins
+//
+bool IsTXMode __attribute__((aligned(VCACHELINESIZE)));                     // true if in TX
+bool SDRActive __attribute__((aligned(VCACHELINESIZE)));                    // true if this SDR is running at the moment
+bool NewMessageReceived __attribute__((aligned(VCACHELINESIZE))) = false;   // set whenever a message is received
+
+//
+// read-mostly: set at startup or at session changes
+//
+bool ReplyAddressSet __attribute__((aligned(VCACHELINESIZE))) = false;      // true when reply address has been set
 bool StartBitReceived = false;              // true when "run" bit has been set
-bool NewMessageReceived = false;            // set whenever a message is received
 bool ExitRequested = false;                 // true if "exit checking" thread requests shutdown
 bool SkipExitCheck = false;                 // true to skip "exit checking", if running as a service
 bool ThreadError = false;                   // true if a thread reports an error
 bool UseDebug = false;                      // true if to enable debugging
+bool UseStandby = false;                    // true if the idle DDC stream is kept ready to start
+bool UseFIFOInterrupts = false;             // true if FIFO monitor interrupts wake stream threads
+bool UseDriverDMABuffer = false;            // true if the DDC DMA ring is the driver's contiguous DMA buffer
+bool UseStatusInterrupt = false;            // true if status change interrupt wakes the high priority thread
+bool UseUDPGSO = false;                     // true if UDP segmentation offload to be used for DDC data
+bool UseWallClockTimestamps = false;        // true if DDC timestamps are wall clock times, ns since 1970
+uint32_t DDCSenderThreads = 0;              // number of DDC sender threads; 0 = send from DDC thread
+int DDCSenderCores[VNUMDDC];                // CPU cores for DDC sender threads
+uint32_t DDCSenderCoreCount = 0;            // number of cores in list; 0 = no CPU affinity set
+bool UseRealtimeDMA = false;                // true if DDC DMA thread to run SCHED_FIFO
+bool UseRealtimeThreads = false;            // true if stream and control threads to run SCHED_FIFO, memory locked
+bool UsePowerGovernor = false;              // true if CPU governor and C-state latency set while SDR active
+char* ThreadCPUSets = NULL;                 // if not NULL, CPU lists for stream/control/housekeeping threads
+bool UseNetAffinity = false;                // true if NIC IRQ, RPS and XPS CPUs lined up with the thread CPU sets
+uint32_t DDCTargetLatency = VDDCDEFAULTLATENCY; // target DDC FIFO latency (us) used to size DMA transfers
+uint32_t DDCAsyncDMADepth = 0;              // if not 0, DDC DMAs kept in flight using asynchronous DMA
+uint32_t DMAPollWindow = 0;                 // if not 0, mic & speaker DMA completion busy-poll window (us)
+bool UseDUCBatching = false;                // true if DUC I/Q packets received and written in batches
+uint32_t DUCJitterLatency = 0;              // TX jitter buffer target latency (ms); 0 = no jitter buffer
+uint32_t SpkCoalesceTime = 0;               // speaker audio gathered per DMA (ms); 0 = one packet per DMA
+uint32_t SpkResampleLatency = 0;            // speaker FIFO level held by the resampler (ms); 0 = no resampler
+bool UseWBPacing = false;                   // true if wideband packets paced to WBPacingRate; else fixed gap
+uint32_t WBPacingRate = 0;                  // wideband packet pacing rate (Mbit/s); 0 = unpaced
+uint32_t WBSpectrumBins = 0;                // if not 0, send wideband data as a power spectrum of this many bins
+uint32_t WBZoomCentre = 0;                  // wideband zoom spectrum centre frequency, Hz
+uint32_t WBZoomDecimation = 0;              // if not 0, the spectrum is of a sub-band 122.88MHz / this wide
+char* DDCCaptureFilename = NULL;            // if not NULL, file to capture DDC DMA blocks to
+char* XDPInterface = NULL;                  // if not NULL, send DDC data by AF_XDP on this interface
+char* WBEOPDevice = NULL;                   // if not NULL, AXI-Stream device for EOP terminated wideband reads
+bool UseWBZeroCopy = false;                 // true if wideband samples sent by MSG_ZEROCOPY
+uint32_t SocketBufferSize = 0;              // if not 0, data port socket buffer size (kbytes)
+uint32_t SocketBusyPoll = 0;                // if not 0, receive data port busy poll time (us)
+bool UseDSCPMarking = false;                // true if latency sensitive outgoing ports marked DSCP EF
+uint16_t MetricsPort = 0;                   // if not 0, serve stream metrics on this TCP port
+uint32_t FIFOSampleRate = 0;                // if not 0, FIFO occupancy samples per second for the metrics
+bool UseThreadPerfCounters = false;         // per thread perf counters (syscalls, cycles, instructions) in the metrics
 bool UseControlPanel = false;               // true if to use a control panel
 bool UseLDGATU = false;                     // true if to use an LDG ATU via CAT
 bool UseAriesATU = false;                   // true if to use an Aries ATU
+const char* ConfigFile = NULL;              // config file in use, if any
 
 
 #define SDRBOARDID 1                        // Hermes
@@ -176,6 +243,28 @@ struct ThreadSocketData SocketData[VPORTTABLESIZE] =
 };
 
 
+//
+// per port socket tuning: which settings apply to each port
+// buffer size for the high rate data ports; busy poll for ports that receive data;
+// DSCP and priority marking for the latency sensitive outgoing ports
+//
+#define VSOCKETBUFFER 1                       // set send and receive buffer sizes
+#define VSOCKETBUSYPOLL 2                     // set busy poll
+#define VSOCKETDSCP 4                         // mark DSCP EF and high priority
+#define VDSCPEF 0xB8                          // IP TOS byte for DSCP 46 (expedited forwarding)
+#define VSOCKETPRIORITY 6                     // SO_PRIORITY for marked ports
+
+static const uint8_t SocketTuning[VPORTTABLESIZE] =
+{
+  0, 0, 0, VSOCKETBUSYPOLL,                                     // command, DDC & DUC specific, high priority in
+  VSOCKETBUFFER | VSOCKETBUSYPOLL, VSOCKETBUFFER | VSOCKETBUSYPOLL,      // speaker audio, DUC I/Q
+  VSOCKETDSCP, VSOCKETDSCP,                                     // high priority out, mic audio
+  VSOCKETBUFFER, VSOCKETBUFFER, VSOCKETBUFFER, VSOCKETBUFFER, VSOCKETBUFFER,     // DDC I/Q 0-4
+  VSOCKETBUFFER, VSOCKETBUFFER, VSOCKETBUFFER, VSOCKETBUFFER, VSOCKETBUFFER,     // DDC I/Q 5-9
+  VSOCKETBUFFER, VSOCKETBUFFER                                  // wideband 0, 1
+};
+
+
 //
 // default port numbers, used if incoming port number = 0
 //
@@ -188,9 +277,7 @@ uint16_t DefaultPorts[VPORTTABLESIZE] =
 };
 
 
-pthread_t DDCSpecificThread;
-pthread_t DUCSpecificThread;
-pthread_t HighPriorityToSDRThread;
+pthread_t InboundDispatcherThread;           // receives DDC specific, DUC specific and high priority
 pthread_t SpkrAudioThread;
 pthread_t DUCIQThread;
 pthread_t DDCIQThread[VNUMDDC];               // array, but not sure how many
@@ -198,8 +285,9 @@ pthread_t MicThread;
 pthread_t HighPriorityFromSDRThread;
 pthread_t WidebandDataThread;
 
-pthread_t CheckForExitThread;                 // thread looks for types "exit" command
-pthread_t CheckForNoActivityThread;           // thread looks for inactvity
+pthread_t CodecInitThread;                    // startup: codec initialisation
+pthread_t CWRampInitThread;                   // startup: CW ramp upload
+pthread_t DeferredInitThread;                 // startup: front panel and ATU probes
 
 
 //
@@ -217,28 +305,185 @@ void sig_handler(int signo)
     ExitRequested = true;
 }
 
+
 //
-// function to check if any threads are still active
-// loop through the table; report if any are true.
-// parameter is to allow the "command" socket to stay open
+// settings that need more than storing a value
+// they are used by both the command line options and the config file
 //
-bool CheckActiveThreads(int StartingPoint)
+bool SetDDCSenderCores(const char* Value)
 {
-  struct ThreadSocketData* Ptr = SocketData+StartingPoint;
-  bool Result = false;
+  char List[64];
+  char* CorePtr;
+
+  strncpy(List, Value, sizeof(List) - 1);
+  List[sizeof(List) - 1] = 0;
+  DDCSenderCoreCount = 0;
+  CorePtr = strtok(List, ",");
+  while((CorePtr != NULL) && (DDCSenderCoreCount < VNUMDDC))
+  {
+    DDCSenderCores[DDCSenderCoreCount++] = atoi(CorePtr);
+    CorePtr = strtok(NULL, ",");
+  }
+  printf ("DDC sender threads pinned to %d CPU cores\n", DDCSenderCoreCount);
+  return true;
+}
+
+
+bool SetWBPacingRate(const char* Value)
+{
+  UseWBPacing = true;
+  WBPacingRate = atoi(Value);
+  if(WBPacingRate == 0)
+    printf ("wideband packets unpaced\n");
+  else
+    printf ("wideband packets paced to %dMbit/s\n", WBPacingRate);
+  return true;
+}
+
 
-  for (int i = StartingPoint; i < VPORTTABLESIZE; i++)          // loop through the socket table
+bool SetWBSpectrumBins(const char* Value)
+{
+  WBSpectrumBins = atoi(Value);
+  if((WBSpectrumBins != 0) && (WBSpectrumBins != VWBMINBINS) && (WBSpectrumBins != VWBMAXBINS))
   {
-    if(Ptr->Active)                                 // check this thread
-      Result = true;
-    Ptr++;
+    printf ("wideband spectrum must be %d or %d bins; sending raw samples\n", VWBMINBINS, VWBMAXBINS);
+    WBSpectrumBins = 0;
   }
-    if(Result)
-      printf("found an active thread\n");
-    return Result;
+  else if(WBSpectrumBins != 0)
+    printf ("wideband data sent as %d bin power spectrum\n", WBSpectrumBins);
+  return true;
 }
 
 
+//
+// zoom spectrum setting: <centre Hz>:<decimation>, or 0 for the full band
+//
+bool SetWBZoom(const char* Value)
+{
+  uint32_t Centre = 0, Decimation = 0;
+
+  if((sscanf(Value, "%u:%u", &Centre, &Decimation) != 2) || (Decimation < VWBMINZOOM) || (Decimation > VWBMAXZOOM)
+     || ((Decimation & (Decimation - 1)) != 0) || (Centre > VWBADCSAMPLERATE / 2))
+  {
+    if(strcmp(Value, "0") != 0)
+      printf ("bad wideband zoom %s: use <centre Hz>:<decimation %d-%d, power of 2>; full band spectrum\n",
+              Value, VWBMINZOOM, VWBMAXZOOM);
+    WBZoomCentre = 0;
+    WBZoomDecimation = 0;
+    return true;
+  }
+  WBZoomCentre = Centre;
+  WBZoomDecimation = Decimation;
+  printf ("wideband spectrum zoomed to %dHz +/- %dHz\n", Centre, VWBADCSAMPLERATE / Decimation / 2);
+  return true;
+}
+
+
+//
+// FIFO monitor watermarks: <fifo>=<high>:<low>,... in 64 bit words; 0 = automatic
+// fifos ddc, duc, mic, speaker. The low watermark applies to duc and speaker only
+//
+bool SetFIFOWatermarks(const char* Value)
+{
+  static const char* FIFONames[VNUMDMAFIFO] = {"ddc", "duc", "mic", "speaker"};  // EDMAStreamSelect order
+  char Name[16];
+  uint32_t High, Low, Channel;
+  const char* Entry = Value;
+  bool Result = true;
+  int Length;
+
+  while(*Entry != 0)
+  {
+    Low = 0;
+    if(sscanf(Entry, "%15[a-z]=%u%n", Name, &High, &Length) != 2)
+    {
+      Result = false;
+      break;
+    }
+    Entry += Length;
+    if((*Entry == ':') && (sscanf(Entry, ":%u%n", &Low, &Length) == 1))
+      Entry += Length;
+    for(Channel = 0; Channel < VNUMDMAFIFO; Channel++)
+      if(strcmp(Name, FIFONames[Channel]) == 0)
+        break;
+    if((Channel == VNUMDMAFIFO) || (High > GetFIFOMonitorDepth((EDMAStreamSelect)Channel))
+       || (Low >= GetFIFOMonitorDepth((EDMAStreamSelect)Channel)))
+    {
+      Result = false;
+      break;
+    }
+    SetFIFOMonitorWatermarks((EDMAStreamSelect)Channel, High, Low);
+    printf ("%s FIFO watermarks: high %u, low %u (0 = automatic)\n", Name, High, Low);
+    if(*Entry == ',')
+      Entry++;
+    else if(*Entry != 0)
+    {
+      Result = false;
+      break;
+    }
+  }
+  if(!Result)
+    printf ("bad FIFO watermarks %s: use <fifo>=<high>[:<low>],... (fifos ddc, duc, mic, speaker)\n", Value);
+  return Result;
+}
+
+
+//
+// config file settings. The file is read before the command line, so options override it.
+// reloadable settings are read by the threads each session (or continuously), so are
+// safe to change on SIGHUP; the others set up threads, sockets or buffers at startup.
+// compile time sizes (DMA buffers, packet sizes) stay as #defines.
+//
+const struct ConfigSetting P2Settings[] =
+{
+  { "ddc",       "sender-threads",   eConfigUint,    &DDCSenderThreads,  0, VNUMDDC, false, NULL },
+  { "ddc",       "sender-cores",     eConfigHandler, NULL,               0, 0,       false, SetDDCSenderCores },
+  { "ddc",       "realtime-dma",     eConfigBool,    &UseRealtimeDMA,    0, 0,       false, NULL },
+  { "ddc",       "target-latency",   eConfigUint,    &DDCTargetLatency,  VDDCMINLATENCY, 0, true, NULL },
+  { "ddc",       "async-dma-depth",  eConfigUint,    &DDCAsyncDMADepth,  0, 0,       false, NULL },
+  { "ddc",       "gso",              eConfigBool,    &UseUDPGSO,         0, 0,       true,  NULL },
+  { "ddc",       "xdp-interface",    eConfigString,  &XDPInterface,      0, 0,       false, NULL },
+  { "ddc",       "fanout",           eConfigHandler, NULL,               0, 0,       false, AddDDCFanout },
+  { "ddc",       "wallclock-timestamps", eConfigBool, &UseWallClockTimestamps, 0, 0,   false, NULL },
+  { "ddc",       "channelizer",      eConfigHandler, NULL,               0, 0,       false, AddChannelizer },
+  { "ddc",       "decimation",       eConfigHandler, NULL,               0, 0,       false, AddDDCDecimation },
+  { "ddc",       "scan",             eConfigHandler, NULL,               0, 0,       false, AddDDCScan },
+  { "ddc",       "retransmit",       eConfigHandler, NULL,               0, 0,       false, SetDDCRetransmit },
+  { "ddc",       "shm-export",       eConfigHandler, NULL,               0, 0,       false, AddDDCShmExport },
+  { "ddc",       "overload-priority", eConfigHandler, NULL,              0, 0,       false, SetOverloadPriority },
+  { "duc",       "batching",         eConfigBool,    &UseDUCBatching,    0, 0,       false, NULL },
+  { "duc",       "jitter-latency",   eConfigUint,    &DUCJitterLatency,  0, 0,       false, NULL },
+  { "duc",       "eer-delay",        eConfigHandler, NULL,               0, 0,       false, SetDUCEERDelay },
+  { "duc",       "reorder",          eConfigHandler, NULL,               0, 0,       false, SetDUCReorder },
+  { "speaker",   "coalesce-time",    eConfigUint,    &SpkCoalesceTime,   0, 0,       false, NULL },
+  { "speaker",   "resample-latency", eConfigUint,    &SpkResampleLatency, 0, 100,    false, NULL },
+  { "speaker",   "reorder",          eConfigHandler, NULL,               0, 0,       false, SetSpkReorder },
+  { "wideband",  "pacing-rate",      eConfigHandler, NULL,               0, 0,       true,  SetWBPacingRate },
+  { "wideband",  "spectrum-bins",    eConfigHandler, NULL,               0, 0,       true,  SetWBSpectrumBins },
+  { "wideband",  "zoom",             eConfigHandler, NULL,               0, 0,       true,  SetWBZoom },
+  { "wideband",  "eop-device",       eConfigString,  &WBEOPDevice,       0, 0,       false, NULL },
+  { "wideband",  "zerocopy",         eConfigBool,    &UseWBZeroCopy,     0, 0,       false, NULL },
+  { "dma",       "fifo-interrupts",  eConfigBool,    &UseFIFOInterrupts, 0, 0,       false, NULL },
+  { "dma",       "poll-window",      eConfigUint,    &DMAPollWindow,     0, 0,       false, NULL },
+  { "dma",       "driver-buffer",    eConfigBool,    &UseDriverDMABuffer, 0, 0,      false, NULL },
+  { "dma",       "status-interrupt", eConfigBool,    &UseStatusInterrupt, 0, 0,      false, NULL },
+  { "dma",       "fifo-watermarks",  eConfigHandler, NULL,               0, 0,       false, SetFIFOWatermarks },
+  { "sockets",   "buffer-size",      eConfigUint,    &SocketBufferSize,  0, 0,       false, NULL },
+  { "sockets",   "busy-poll",        eConfigUint,    &SocketBusyPoll,    0, 0,       false, NULL },
+  { "sockets",   "dscp-marking",     eConfigBool,    &UseDSCPMarking,    0, 0,       false, NULL },
+  { "panel",     "encoder-window",   eConfigUint,    &EncoderCoalesceTime, 0, 100,   true,  NULL },
+  { "panel",     "vfo-acceleration", eConfigUint,    &VFOAcceleration,   0, 1000,    true,  NULL },
+  { "threads",   "realtime",         eConfigBool,    &UseRealtimeThreads, 0, 0,      false, NULL },
+  { "threads",   "cpu-sets",         eConfigString,  &ThreadCPUSets,     0, 0,       false, NULL },
+  { "threads",   "net-affinity",     eConfigBool,    &UseNetAffinity,    0, 0,       false, NULL },
+  { "threads",   "performance-governor", eConfigBool, &UsePowerGovernor, 0, 0,      false, NULL },
+  { "threads",   "deadline",         eConfigHandler, NULL,               0, 0,       false, SetLoopDeadlines },
+  { "threads",   "perf-counters",    eConfigBool,    &UseThreadPerfCounters, 0, 0,   false, NULL },
+  { "general",   "debug",            eConfigBool,    &UseDebug,          0, 0,       true,  NULL },
+  { "general",   "standby",          eConfigBool,    &UseStandby,        0, 0,       false, NULL }
+};
+
+#define VNUMP2SETTINGS (sizeof(P2Settings) / sizeof(P2Settings[0]))
 
 //
 // set the port for a given thread. If 0, set the default according to HPSDR spec.
@@ -255,7 +500,121 @@ void SetPort(uint32_t ThreadNum, uint16_t PortNum)
     SocketData[ThreadNum].Portid = PortNum;
 
   if (SocketData[ThreadNum].Portid != CurrentPort)
+  {
     SocketData[ThreadNum].Cmdid |= VBITCHANGEPORT;
+    SignalThreadStateChange();
+  }
+}
+
+
+//
+// thread control channel: a count of state changes, and a condition variable to wait on it
+//
+static pthread_mutex_t ThreadStateMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ThreadStateChanged = PTHREAD_COND_INITIALIZER;
+static uint32_t ThreadStateCount = 0;
+
+
+//
+// wake all threads waiting for a state change
+//
+void SignalThreadStateChange(void)
+{
+  pthread_mutex_lock(&ThreadStateMutex);
+  ThreadStateCount++;
+  pthread_cond_broadcast(&ThreadStateChanged);
+  pthread_mutex_unlock(&ThreadStateMutex);
+}
+
+
+//
+// set the SDR active state, and wake the waiting threads if it has changed
+//
+void SetSDRActive(bool Active)
+{
+  struct RadioState* State;
+
+  if(__atomic_load_n(&SDRActive, __ATOMIC_RELAXED) != Active)
+  {
+    State = BeginRadioStateUpdate();
+    State->SDRActive = Active;
+    EndRadioStateUpdate();
+    __atomic_store_n(&SDRActive, Active, __ATOMIC_RELEASE);   // reply address etc visible to a thread that sees it set
+    SignalThreadStateChange();
+    WakeCATHandler();
+  }
+}
+
+
+//
+// set the TX state, and publish it if it has changed
+//
+void SetTXModeState(bool TXMode)
+{
+  struct RadioState* State;
+
+  if(__atomic_load_n(&IsTXMode, __ATOMIC_RELAXED) != TXMode)
+  {
+    State = BeginRadioStateUpdate();
+    State->TXMode = TXMode;
+    EndRadioStateUpdate();
+    __atomic_store_n(&IsTXMode, TXMode, __ATOMIC_RELAXED);
+  }
+}
+
+
+//
+// get the state change count, before testing the state
+//
+uint32_t GetThreadStateCount(void)
+{
+  uint32_t Count;
+
+  pthread_mutex_lock(&ThreadStateMutex);
+  Count = ThreadStateCount;
+  pthread_mutex_unlock(&ThreadStateMutex);
+  return Count;
+}
+
+
+//
+// wait until the state has changed since *StateCount was read; then update it
+//
+void WaitThreadStateChange(uint32_t* StateCount)
+{
+  pthread_mutex_lock(&ThreadStateMutex);
+  while(ThreadStateCount == *StateCount)
+    pthread_cond_wait(&ThreadStateChanged, &ThreadStateMutex);
+  *StateCount = ThreadStateCount;
+  pthread_mutex_unlock(&ThreadStateMutex);
+}
+
+
+//
+// as WaitThreadStateChange(), but give up after Ms milliseconds
+// returns true if the state changed
+//
+bool WaitThreadStateChangeTimed(uint32_t* StateCount, uint32_t Ms)
+{
+  struct timespec Deadline;
+  bool Changed;
+
+  clock_gettime(CLOCK_REALTIME, &Deadline);
+  Deadline.tv_sec += Ms / 1000;
+  Deadline.tv_nsec += (Ms % 1000) * 1000000L;
+  if(Deadline.tv_nsec >= 1000000000L)
+  {
+    Deadline.tv_sec++;
+    Deadline.tv_nsec -= 1000000000L;
+  }
+  pthread_mutex_lock(&ThreadStateMutex);
+  while(ThreadStateCount == *StateCount)
+    if(pthread_cond_timedwait(&ThreadStateChanged, &ThreadStateMutex, &Deadline) != 0)
+      break;
+  Changed = (ThreadStateCount != *StateCount);
+  *StateCount = ThreadStateCount;
+  pthread_mutex_unlock(&ThreadStateMutex);
+  return Changed;
 }
 
 
@@ -285,6 +644,7 @@ int MakeSocket(struct ThreadSocketData* Ptr, int DDCid)
   ReadTimeout.tv_sec = 0;
   ReadTimeout.tv_usec = 1000;
   setsockopt(Ptr->Socketid, SOL_SOCKET, SO_RCVTIMEO, (void *)&ReadTimeout , sizeof(ReadTimeout));
+  TuneSocket(Ptr);
 
   //
   // bind application to the specified port
@@ -311,54 +671,284 @@ int MakeSocket(struct ThreadSocketData* Ptr, int DDCid)
 
 
 //
-// this runs as its own thread to monitor command line activity. A string "exist" exits the application. 
-// thread initiated at the start.
+// set a socket buffer size; use the FORCE option (for root) so net.core.wmem_max doesn't limit it
 //
-void* CheckForExitCommand(__attribute__((unused)) void *arg)
+static void SetSocketBuffer(struct ThreadSocketData* Ptr, int Option, int ForceOption, int Bytes)
 {
-  char ch;
-  printf("spinning up Check For Exit thread, pid=%ld\n", syscall(SYS_gettid));
-  
-  while (1)
+  if((setsockopt(Ptr->Socketid, SOL_SOCKET, ForceOption, (void *)&Bytes, sizeof(Bytes)) < 0)
+     && (setsockopt(Ptr->Socketid, SOL_SOCKET, Option, (void *)&Bytes, sizeof(Bytes)) < 0))
+    printf("socket buffer size not set for %s, errno=%d\n", Ptr->Nameid, errno);
+}
+
+
+//
+// apply the command line socket tuning that is relevant to a port
+// Ptr must point into the SocketData table
+//
+void TuneSocket(struct ThreadSocketData* Ptr)
+{
+  uint8_t Tuning;
+  int Value;
+
+  Tuning = SocketTuning[Ptr - SocketData];
+  if((Tuning & VSOCKETBUFFER) && (SocketBufferSize != 0))
   {
-    usleep(10000);
-    ch = getchar();
-    if((ch == 'x') || (ch == 'X'))
+    SetSocketBuffer(Ptr, SO_SNDBUF, SO_SNDBUFFORCE, SocketBufferSize * 1024);
+    SetSocketBuffer(Ptr, SO_RCVBUF, SO_RCVBUFFORCE, SocketBufferSize * 1024);
+  }
+  if((Tuning & VSOCKETBUSYPOLL) && (SocketBusyPoll != 0))
+  {
+    Value = SocketBusyPoll;
+    if(setsockopt(Ptr->Socketid, SOL_SOCKET, SO_BUSY_POLL, (void *)&Value, sizeof(Value)) < 0)
+      printf("busy poll not set for %s, errno=%d\n", Ptr->Nameid, errno);
+  }
+  if((Tuning & VSOCKETDSCP) && UseDSCPMarking)
+  {
+    Value = VDSCPEF;
+    if(setsockopt(Ptr->Socketid, IPPROTO_IP, IP_TOS, (void *)&Value, sizeof(Value)) < 0)
+      printf("DSCP not set for %s, errno=%d\n", Ptr->Nameid, errno);
+    Value = VSOCKETPRIORITY;
+    if(setsockopt(Ptr->Socketid, SOL_SOCKET, SO_PRIORITY, (void *)&Value, sizeof(Value)) < 0)
+      printf("socket priority not set for %s, errno=%d\n", Ptr->Nameid, errno);
+  }
+}
+
+
+//
+// true if a send failed only because the socket or device queue is full (back-pressure):
+// the caller should back off and retry, or drop packets, rather than treat it as an error
+//
+bool IsSendBackpressure(int Error)
+{
+  return (Error == ENOBUFS) || (Error == EAGAIN) || (Error == EWOULDBLOCK);
+}
+
+
+//
+// function to set UDP generic segmentation offload (GSO) on an outgoing socket
+// a send of several packets concatenated is then split by the kernel into SegmentSize datagrams
+// SegmentSize = 0 turns GSO off again
+// returns true if the kernel accepted the setting
+//
+bool SetSocketGSO(struct ThreadSocketData* Ptr, uint16_t SegmentSize)
+{
+  int GSOSize = SegmentSize;
+  bool Result = true;
+
+  if(setsockopt(Ptr->Socketid, SOL_UDP, UDP_SEGMENT, (void *)&GSOSize, sizeof(GSOSize)) < 0)
+  {
+    if(SegmentSize != 0)
+      printf("UDP GSO not supported on socket for %s, errno=%d\n", Ptr->Nameid, errno);
+    Result = false;
+  }
+  return Result;
+}
+
+
+//
+// housekeeping handler for the command line: typing "x" exits the application.
+// called when stdin is readable; at end of file stdin is no longer watched.
+//
+void CheckForExitCommand(int fd, __attribute__((unused)) void *arg)
+{
+  char Text[64];
+  ssize_t Length;
+  ssize_t Cntr;
+
+  Length = read(fd, Text, sizeof(Text));
+  if(Length <= 0)
+  {
+    RemoveHousekeepingFd(fd);
+    return;
+  }
+  for(Cntr = 0; Cntr < Length; Cntr++)
+    if((Text[Cntr] == 'x') || (Text[Cntr] == 'X'))
     {
       ExitRequested = true;
+      SignalThreadStateChange();
+      RemoveHousekeepingFd(fd);
       break;
     }
-  }
-  return NULL;
 }
 
 
 //
-// this runs as its own thread to see if messages have stopped being received.
+// housekeeping timer, once a second, to see if messages have stopped being received.
 // if nomessages in a second, goes back to "inactive" state.
 //
-void* CheckForActivity(__attribute__((unused)) void *arg)
+void CheckForActivity(__attribute__((unused)) void *arg)
 {
   bool PreviouslyActiveState;               
-  printf("Started check for activity thread, pid=%ld\n", syscall(SYS_gettid));
-  while(1)
+
+  PreviouslyActiveState = __atomic_load_n(&SDRActive, __ATOMIC_RELAXED);   // see if active on entry
+  if (!__atomic_load_n(&NewMessageReceived, __ATOMIC_RELAXED) && HW_Timer_Enable) // if no messages received,
   {
-    sleep(1);                                   // wait for 1 second
-    PreviouslyActiveState = SDRActive;          // see if active on entry
-    if (!NewMessageReceived && HW_Timer_Enable) // if no messages received,
-    {
-      SDRActive = false;                        // set back to inactive
-      IsTXMode = false;
-      SetMOX(false);
-      SetTXEnable(false);
-      EnableCW(false, false);
-      ReplyAddressSet = false;
-      StartBitReceived = false;
-      if(PreviouslyActiveState)
-        printf("Reverted to Inactive State after no activity\n");
-    }
-    NewMessageReceived = false;
+    SetSDRActive(false);                      // set back to inactive
+    SetTXModeState(false);
+    SetMOX(false);
+    SetTXEnable(false);
+    EnableCW(false, false);
+    ReplyAddressSet = false;
+    BeginRadioStateUpdate()->ReplyAddressSet = false;
+    EndRadioStateUpdate();
+    StartBitReceived = false;
+    if(PreviouslyActiveState)
+      printf("Reverted to Inactive State after no activity\n");
+  }
+  __atomic_store_n(&NewMessageReceived, false, __ATOMIC_RELAXED);
+}
+
+
+
+
+//
+// startup sequence
+// only what the discovery reply needs is done before the command port is served.
+// the slow hardware initialisation runs in parallel worker threads, and the
+// front panel and ATU probes are deferred until the main loop is running:
+//   stage 1 (main):      XDMA driver, firmware version, register defaults
+//   stage 2 (parallel):  codec initialisation | CW ramp upload
+//   stage 3 (main):      options, DMA pool, sockets and stream threads; then discovery is answered
+//   stage 4 (deferred):  front panel, LDG ATU and Aries ATU probes
+// a general packet waits for stage 2, so that the client's settings follow the defaults.
+// each stage records its time since program start for the startup timing report.
+//
+#define VSTARTUPMARKS 16                    // most stages recorded in the startup report
+
+struct StartupMark
+{
+  const char* Stage;
+  uint32_t Microseconds;                    // time since program start
+};
+static struct StartupMark StartupMarks[VSTARTUPMARKS];
+static uint32_t StartupMarkCount = 0;
+static struct timespec StartupTime;
+static pthread_mutex_t StartupMutex = PTHREAD_MUTEX_INITIALIZER;
+static bool CodecInitStarted = false;       // true if the worker threads were created
+static bool CWRampInitStarted = false;
+static bool DeferredInitStarted = false;
+static bool HardwareInitDone = false;       // true when stage 2 has been joined
+static pthread_mutex_t HardwareInitMutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+//
+// record the time a startup stage completed
+//
+void MarkStartup(const char* Stage)
+{
+  struct timespec Now;
+
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  pthread_mutex_lock(&StartupMutex);
+  if(StartupMarkCount < VSTARTUPMARKS)
+  {
+    StartupMarks[StartupMarkCount].Stage = Stage;
+    StartupMarks[StartupMarkCount].Microseconds = (uint32_t)((Now.tv_sec - StartupTime.tv_sec) * 1000000L
+                                                             + (Now.tv_nsec - StartupTime.tv_nsec) / 1000L);
+    StartupMarkCount++;
   }
+  pthread_mutex_unlock(&StartupMutex);
+}
+
+
+//
+// print the startup timing report
+//
+void PrintStartupReport(void)
+{
+  uint32_t Cntr;
+
+  pthread_mutex_lock(&StartupMutex);
+  printf("startup timing:\n");
+  for(Cntr = 0; Cntr < StartupMarkCount; Cntr++)
+    printf("  %7.1fms  %s\n", StartupMarks[Cntr].Microseconds / 1000.0, StartupMarks[Cntr].Stage);
+  pthread_mutex_unlock(&StartupMutex);
+}
+
+
+//
+// stage 2 workers. The DAC atten ROMs and the default CW ramp are generated at
+// build time (precomputedtables.h). The codec writes and the CW ramp upload go through the
+// register queue, so they can run alongside each other and the main thread.
+//
+void* CodecInitWorker(__attribute__((unused)) void *arg)
+{
+  CodecInitialise();
+  MarkStartup("codec initialised");
+  return NULL;
+}
+
+
+void* CWRampInitWorker(__attribute__((unused)) void *arg)
+{
+//  InitialiseCWKeyerRamp(true, 5000);                                // create initial default 5 ms ramp, P2
+  InitialiseCWKeyerRamp(true, 9000);                                // create initial default 9ms DL1YCF amp, P2
+  SetCWSidetoneEnabled(true);
+  MarkStartup("CW ramp loaded");
+  return NULL;
+}
+
+
+//
+// start the stage 2 workers. If a thread can't be created, do its work here
+//
+void StartHardwareInit(void)
+{
+  CodecInitStarted = (pthread_create(&CodecInitThread, NULL, CodecInitWorker, NULL) == 0);
+  if(!CodecInitStarted)
+    CodecInitWorker(NULL);
+  CWRampInitStarted = (pthread_create(&CWRampInitThread, NULL, CWRampInitWorker, NULL) == 0);
+  if(!CWRampInitStarted)
+    CWRampInitWorker(NULL);
+}
+
+
+//
+// wait for stage 2 to complete. Called by the main loop and the deferred worker;
+// the mutex makes sure the workers are joined once.
+//
+void WaitHardwareInit(void)
+{
+  pthread_mutex_lock(&HardwareInitMutex);
+  if(!HardwareInitDone)
+  {
+    if(CodecInitStarted)
+      pthread_join(CodecInitThread, NULL);
+    if(CWRampInitStarted)
+      pthread_join(CWRampInitThread, NULL);
+    HardwareInitDone = true;
+  }
+  pthread_mutex_unlock(&HardwareInitMutex);
+}
+
+
+//
+// stage 4: probe for the front panel and ATUs, then print the startup report
+//
+void* DeferredInitWorker(__attribute__((unused)) void *arg)
+{
+//
+// startup ATU handler if needed
+//
+  if(UseLDGATU)
+    InitialiseLDGHandler();
+
+//
+// startup ATU handler if needed
+//
+  if(UseAriesATU)
+    InitialiseAriesHandler();
+
+//
+// startup G2 front panel handler if needed
+//
+  if(UseControlPanel)
+    InitialiseFrontPanelHandler();
+
+  MarkStartup("deferred panel and ATU probes done");
+  WaitHardwareInit();                                 // so the report includes stage 2
+  PrintStartupReport();
+  return NULL;
 }
 
 
@@ -370,6 +960,14 @@ void* CheckForActivity(__attribute__((unused)) void *arg)
 //
 void Shutdown()
 {
+  RequestThreadStop();                                    // stream and control threads leave their loops
+  SetSDRActive(false);                                    // (this also wakes the idle ones)
+  StopInboundDispatcher();
+  JoinManagedThreads();
+  StopPowerGovernor();                                    // CPU governors as they were found
+  RestoreNetAffinity();                                   // NIC IRQ and steering CPUs as they were found
+  if(DeferredInitStarted)
+    pthread_join(DeferredInitThread, NULL);               // the probes must finish before their handlers close
   ShutdownCATHandler();                                   // close CAT connection socket
   if(UseControlPanel)
     ShutdownFrontPanelHandler();
@@ -377,11 +975,7 @@ void Shutdown()
     ShutdownAriesHandler();
 
   close(SocketData[0].Socketid);                          // close incoming data socket
-  sem_destroy(&DDCInSelMutex);
-  sem_destroy(&DDCResetFIFOMutex);
-  sem_destroy(&RFGPIOMutex);
-  sem_destroy(&CodecRegMutex);
-  sem_destroy(&DDCResetFIFOMutex);                        // for DMA
+  sem_destroy(&MicWBDMAMutex);                            // for DMA
   SetMOX(false);
   SetTXEnable(false);
   EnableCW(false, false);
@@ -424,45 +1018,87 @@ int main(int argc, char *argv[])
   uint8_t CmdByte;                                                  // command word from PC app
   struct ifreq hwaddr;                                              // holds this device MAC address
   struct sockaddr_in addr_from;                                     // holds MAC address of source of incoming messages
+  struct RadioState* State;                                         // published radio state, when the reply address is set
   uint8_t UDPInBuffer[VDDCPACKETSIZE];                              // outgoing buffer
   struct iovec iovecinst;                                           // iovcnt buffer - 1 for each outgoing buffer
   struct msghdr datagram;                                           // multiple incoming message header
 
-  uint32_t TestFrequency;                                           // test source DDS freq
+  uint32_t TestFrequency = 0;                                       // test source DDS freq
+  const char* SoakMix = NULL;                                       // DDC mix if soak test requested
   int CmdOption;                                                    // command line option
   char BuildDate[]=GIT_DATE;
 	ESoftwareID ID;
 	unsigned int Version = 0;
   unsigned int MajorVersion = 0;
   bool IncompatibleFirmware = false;                                // becomes set if firmware is not compatible with this version
+  sigset_t ReloadSignals;                                           // SIGHUP: reload the config file
+  struct timespec NoWait = {0, 0};
+  bool Reconfigure = false;                                         // -H: reload the FPGA before starting
+  uint32_t ReconfigAddress = 0;                                     // flash address of the image to load
 
 
   //
-  // initialise register access semaphores
+  // initialise DMA channel semaphore. Shared registers are updated through the
+  // lock-free register queue, so need no semaphores.
   //
-  sem_init(&DDCInSelMutex, 0, 1);                                   // for DDC input select register
-  sem_init(&DDCResetFIFOMutex, 0, 1);                               // for FIFO reset register
-  sem_init(&RFGPIOMutex, 0, 1);                                     // for RF GPIO register
-  sem_init(&CodecRegMutex, 0, 1);                                   // for codec accesss
+  clock_gettime(CLOCK_MONOTONIC, &StartupTime);
   sem_init(&MicWBDMAMutex, 0, 1);                                   // for mic and WB DMA
+
+//
+// block SIGHUP in every thread (the mask is inherited): the main loop collects it
+// with sigtimedwait(), so it never interrupts a stream thread's socket receive
+//
+  sigemptyset(&ReloadSignals);
+  sigaddset(&ReloadSignals, SIGHUP);
+  pthread_sigmask(SIG_BLOCK, &ReloadSignals, NULL);
     
 //
 // setup Saturn hardware
 //
   printf("SATURN Protocol 2 App. press 'x <enter>' in console to close\n");
 
-  OpenXDMADriver(false);
+//
+// the board must be chosen before the driver is opened, so look for -B <card> first,
+// and -H <image> for a reload of the FPGA before anything uses it
+//
+  while((CmdOption = getopt(argc, argv, ":a:i:f:m:t:c:l:j:k:L:w:v:n:o:y:q:u:x:z:X:F:A:B:C:S:P:D:G:W:Z:H:N:K:Q:U:I:sdpegrbRTEOMJh")) != -1)
+  {
+    if((CmdOption == 'B') && !SelectXDMACard((uint32_t)atoi(optarg)))
+      printf("Saturn board %s not valid: using board 0\n", optarg);
+    else if(CmdOption == 'H')
+    {
+      Reconfigure = ParseReconfigTarget(optarg, &ReconfigAddress);
+      if(!Reconfigure)
+      {
+        printf("FPGA image %s not valid: use primary, reload or a flash address\n", optarg);
+        return EXIT_FAILURE;
+      }
+    }
+  }
+  optind = 1;
+  if(GetXDMACard() != 0)
+    printf("using Saturn board %d (/dev/xdma%d_*)\n", GetXDMACard(), GetXDMACard());
+  OpenXDMADriverMapped(false, true);
   PrintVersionInfo();
+//
+// warm reconfiguration, before any DMA device is opened
+//
+  if(Reconfigure)
+  {
+    if(!WarmReconfigureFPGA(ReconfigAddress, VRECONFIGDEFAULTTIMEOUT))
+    {
+      printf("FPGA reconfiguration failed: not starting\n");
+      return EXIT_FAILURE;
+    }
+    PrintVersionInfo();
+  }
   printf("p2app client app software Version:%d Build Date:%s\n", P2APPVERSION, BuildDate);
   PrintAuxADCInfo();
   if (IsFallbackConfig())
       printf("FPGA load is a fallback - you should re-flash the primary FPGA image!\n");
-  
-  CodecInitialise();
-  InitialiseDACAttenROMs();
-//  InitialiseCWKeyerRamp(true, 5000);                                // create initial default 5 ms ramp, P2
-  InitialiseCWKeyerRamp(true, 9000);                                // create initial default 9ms DL1YCF amp, P2
-  SetCWSidetoneEnabled(true);
+  MarkStartup("XDMA driver open, versions read");
+
+  StartHardwareInit();                                              // codec & CW ramp in parallel
   SetTXProtocol(true);                                              // set to protocol 2
   SetTXModulationSource(eIQData);                                   // disable debug options
   HandlerSetEERMode(false);                                         // no EER
@@ -498,25 +1134,37 @@ int main(int argc, char *argv[])
   EnableAlexManualFilterSelect(true);
   SetBalancedMicInput(false);
   InitCATHandler();
+  MarkStartup("register defaults set");
 
   if (signal(SIGINT, sig_handler) == SIG_ERR)
     printf("\ncan't catch SIGINT\n");
 
 //
-// start up thread to check for no longer getting messages, to set back to inactive
+// allocate the locked DMA buffer pool before any stream thread starts
+// if it fails, the threads allocate their own buffers
 //
-  if(pthread_create(&CheckForNoActivityThread, NULL, CheckForActivity, NULL) < 0)
-  {
-    perror("pthread_create check for exit");
-    return EXIT_FAILURE;
-  }
-  pthread_detach(CheckForNoActivityThread);
+  InitialiseDMAPool(VDMAPOOLSIZE);
+  ReportDMAPool();
+  InitialiseSampleUnpack();                     // select DDC unpack and DUC I/Q swap kernels
+  MarkStartup("DMA pool allocated");
+
+//
+// read the config file first, so the command line can override it
+// (a first pass over the options just looks for -C <file>)
+//
+  while((CmdOption = getopt(argc, argv, ":a:i:f:m:t:c:l:j:k:L:w:v:n:o:y:q:u:x:z:X:F:A:B:C:S:P:D:G:W:Z:H:N:K:Q:U:I:sdpegrbRTEOMJh")) != -1)
+    if(CmdOption == 'C')
+      ConfigFile = optarg;
+  ConfigFile = FindConfigFile(ConfigFile);
+  if((ConfigFile != NULL) && !LoadConfigFile(ConfigFile, P2Settings, VNUMP2SETTINGS, false))
+    ConfigFile = NULL;
+  optind = 1;
 
 //
 // option string needs a colon after each option letter that has a parameter after it
 // and it has a leading colon to suppress error messages
 //
-  while((CmdOption = getopt(argc, argv, ":a:i:f:m:sdph")) != -1)
+  while((CmdOption = getopt(argc, argv, ":a:i:f:m:t:c:l:j:k:L:w:v:n:o:y:q:u:x:z:X:F:A:B:C:S:P:D:G:W:Z:H:N:K:Q:U:I:sdpegrbRTEOMJh")) != -1)
   {
     switch(CmdOption)
     {
@@ -533,6 +1181,50 @@ int main(int argc, char *argv[])
         printf("-s            skip checking for exit keys, run as service\n");
         printf("-d            print additional debug\n");
         printf("-p            drive G2 control panel\n");
+        printf("-e            use FPGA FIFO and wideband interrupts to wake stream threads (falls back to polling)\n");
+        printf("-E            use the FPGA status change interrupt to send PTT, key and overflow changes (falls back to polling)\n");
+        printf("-g            use UDP segmentation offload (GSO) for DDC data (falls back to sendmmsg)\n");
+        printf("-t <threads>  send DDC data from this number of sender threads (default 0: DDC thread sends)\n");
+        printf("-c <core,core...> pin DDC sender threads to these CPU cores, eg -c 2,3\n");
+        printf("-r            run DDC DMA thread with SCHED_FIFO real time priority\n");
+        printf("-R            run stream and control threads SCHED_FIFO, above housekeeping; lock all memory\n");
+        printf("-O            while the SDR is active, CPU governor at performance and no deep C-states\n");
+        printf("-A <cpus/cpus/cpus> CPUs for stream/control/housekeeping threads, eg -A 2-3/1/0\n");
+        printf("-W <us> | <stream>=<us>,.. report stream loops longer than this, with a stack summary, eg -W ddc=1000,duc=2000\n");
+        printf("-B <board>    use this Saturn board (XDMA card) if the host has several (default 0)\n");
+        printf("-H <image>    first reload the FPGA from flash without a reboot: primary, reload (power up sequence) or a flash address (needs root, and firmware with the reconfiguration core)\n");
+        printf("-C <file>     read settings from this config file (default /etc/%s, then p2app directory)\n", VCONFIGFILENAME);
+        printf("-l <us>       target DDC FIFO latency used to size DMA transfers (default %dus)\n", VDDCDEFAULTLATENCY);
+        printf("-q <count>    keep up to this many DDC DMAs in flight, using asynchronous DMA (2-4)\n");
+        printf("-M            DDC DMA into the driver's contiguous DMA buffer: one descriptor per DMA (not with -q)\n");
+        printf("-u <us>       driver polls this long for mic and speaker DMAs to complete before sleeping\n");
+        printf("-b            receive DUC I/Q packets with recvmmsg and write them to the FPGA in batches\n");
+        printf("-j <ms>       use a TX jitter buffer for DUC I/Q data with this target latency\n");
+        printf("-K <samples>  EER mode: delay the envelope by this many samples (negative: delay the phase)\n");
+        printf("-k <ms>       gather this much speaker audio into each codec DMA (eg -k 10)\n");
+        printf("-L <ms>       resample speaker audio to hold this much in the codec FIFO (eg -L 20; up to 100)\n");
+        printf("-Q <n>[:zero|repeat]  reorder DUC I/Q and speaker packets up to n deep; a lost packet is zeros or a repeat\n");
+        printf("-w <Mbit/s>   pace wideband packets to this rate (default: fixed 200us gap; 0: unpaced)\n");
+        printf("-v <bins>     send wideband data as an averaged log power spectrum of 512 or 1024 bins\n");
+        printf("-Z <Hz>:<dec> with -v, the spectrum is of a sub-band 122.88MHz/dec wide around this frequency\n");
+        printf("-n <port>     serve stream metrics in Prometheus text format on this TCP port\n");
+        printf("              (GET /record/start?ddc=0,1&dir=<dir> and /record/stop there record DDC I/Q to SigMF files)\n");
+        printf("-o <rate>     with -n, sample all FIFO occupancies this many times per second (1-10000)\n");
+        printf("-y <file>     capture the raw DDC DMA blocks of each session to a file (replay with p2app-sim)\n");
+        printf("-x <kbytes>   socket send and receive buffer size for the DDC, wideband, DUC I/Q and speaker ports\n");
+        printf("-z <us>       busy poll the DUC I/Q, speaker and high priority sockets for this long\n");
+        printf("-T            mark outgoing high priority and mic packets DSCP EF, high socket priority\n");
+        printf("-X <interface> send DDC data by AF_XDP on this interface, eg -X eth0 (falls back to UDP sockets)\n");
+        printf("-F <addr>[:port][@ddc,ddc..] also send DDC data to this address or multicast group; repeat for more\n");
+        printf("-J            DDC timestamps are wall clock sample times (ns since 1970), to align several radios\n");
+        printf("-P <ddc>:<channels>[:<port>] split a DDC into 2-64 channels, each sent from its own port (default base %d); repeat for more\n", VCHANDEFAULTBASEPORT);
+        printf("-D <ddc>:<target>:<factor> decimate a DDC by 2-32 in software, sent as the target DDC while that is off; repeat for more\n");
+        printf("-G <ddc>:<ms>:<Hz>,<Hz>.. scan a DDC through a frequency list, this long on each; repeat for more DDCs\n");
+        printf("-N <packets>[:<ms>[:<port>]] keep the last packets of each DDC, resent on a NACK to this port within ms (default %dms, port %d)\n",
+               VRETXDEFAULTWINDOW, VRETXDEFAULTPORT);
+        printf("-U <ddc>[,<ddc>..] also export these DDCs to local clients in shared memory (connect to %s)\n", VDDCSHMSOCKET);
+        printf("-I <ddc>[,<ddc>..] on overload, slow wideband then drop packets of DDCs not listed, highest first (none = all may be shed)\n");
+        printf("-S <count>x<KHz>[,...] run a DDC soak test from the test source instead of protocol 2, eg -S 4x48,4x192,2x384\n");
         return EXIT_SUCCESS;
         break;
 
@@ -617,41 +1309,258 @@ int main(int argc, char *argv[])
       case 'p':
         printf ("Control panel enabled\n");                  
         UseControlPanel = true;
+        break;
+
+      case 'e':
+        printf ("FIFO interrupt driven stream threads enabled\n");                  
+        UseFIFOInterrupts = true;
+        break;
+
+      case 'E':
+        printf ("status change interrupt wakes high priority thread\n");
+        UseStatusInterrupt = true;
+        break;
+
+      case 'g':
+        printf ("UDP GSO requested for DDC data\n");                  
+        UseUDPGSO = true;
+        break;
+
+      case 't':
+        DDCSenderThreads = atoi(optarg);
+        if(DDCSenderThreads > VNUMDDC)
+          DDCSenderThreads = VNUMDDC;
+        printf ("DDC sender threads = %d\n", DDCSenderThreads);                  
+        break;
+
+      case 'c':
+        SetDDCSenderCores(optarg);
+        break;
+
+      case 'r':
+        printf ("SCHED_FIFO requested for DDC DMA thread\n");                  
+        UseRealtimeDMA = true;
+        break;
+
+      case 'l':
+        DDCTargetLatency = atoi(optarg);
+        if(DDCTargetLatency < VDDCMINLATENCY)
+          DDCTargetLatency = VDDCMINLATENCY;
+        printf ("DDC target FIFO latency = %dus\n", DDCTargetLatency);                  
+        break;
+
+      case 'q':
+        DDCAsyncDMADepth = atoi(optarg);
+        printf ("DDC asynchronous DMAs in flight = %d\n", DDCAsyncDMADepth);                  
+        break;
+
+      case 'u':
+        DMAPollWindow = atoi(optarg);
+        printf ("mic & speaker DMA busy-poll window = %dus\n", DMAPollWindow);                  
+        break;
+
+      case 'b':
+        printf ("batched DUC I/Q receive and DMA enabled\n");                  
+        UseDUCBatching = true;
+        break;
+
+      case 'j':
+        DUCJitterLatency = atoi(optarg);
+        printf ("TX jitter buffer target latency = %dms\n", DUCJitterLatency);                  
+        break;
+
+      case 'K':
+        if(SetDUCEERDelay(optarg))
+          printf ("EER envelope delay = %s samples\n", optarg);
+        break;
+
+      case 'Q':
+        SetReorder(optarg);
+        break;
+
+      case 'U':
+        AddDDCShmExport(optarg);
+        break;
+
+      case 'I':
+        SetOverloadPriority(optarg);
+        break;
+
+      case 'k':
+        SpkCoalesceTime = atoi(optarg);
+        printf ("speaker audio coalesced to %dms per DMA\n", SpkCoalesceTime);                  
+        break;
+
+      case 'L':
+        SpkResampleLatency = atoi(optarg);
+        printf ("speaker audio resampled to a %dms codec FIFO level\n", SpkResampleLatency);
+        break;
+
+      case 'w':
+        SetWBPacingRate(optarg);
+        break;
+
+      case 'v':
+        SetWBSpectrumBins(optarg);
+        break;
+
+      case 'Z':
+        SetWBZoom(optarg);
+        break;
+
+      case 'n':
+        MetricsPort = atoi(optarg);
+        break;
+
+      case 'o':
+        FIFOSampleRate = atoi(optarg);
+        break;
+
+      case 'y':
+        DDCCaptureFilename = optarg;
+        break;
+
+      case 'x':
+        SocketBufferSize = atoi(optarg);
+        printf ("data socket buffers = %dkbytes\n", SocketBufferSize);
+        break;
+
+      case 'z':
+        SocketBusyPoll = atoi(optarg);
+        printf ("receive socket busy poll = %dus\n", SocketBusyPoll);
+        break;
+
+      case 'X':
+        XDPInterface = optarg;
+        printf ("DDC data sent by AF_XDP on %s if available\n", XDPInterface);
+        break;
+
+      case 'F':
+        if(AddDDCFanout(optarg))
+          printf ("DDC data also sent to %s\n", optarg);
+        break;
+
+      case 'P':
+        AddChannelizer(optarg);
+        break;
+
+      case 'D':
+        AddDDCDecimation(optarg);
+        break;
+
+      case 'G':
+        AddDDCScan(optarg);
+        break;
+
+      case 'N':
+        SetDDCRetransmit(optarg);
+        break;
+
+      case 'W':
+        SetLoopDeadlines(optarg);
+        break;
+
+      case 'T':
+        UseDSCPMarking = true;
+        printf ("high priority and mic packets marked DSCP EF\n");
+        break;
+
+      case 'R':
+        UseRealtimeThreads = true;
+        printf ("SCHED_FIFO requested for stream and control threads\n");
+        break;
+
+      case 'M':
+        UseDriverDMABuffer = true;
+        printf ("DDC DMA ring in the driver DMA buffer\n");
+        break;
+
+      case 'J':
+        UseWallClockTimestamps = true;
+        printf ("DDC timestamps are wall clock sample times\n");
+        break;
+
+      case 'O':
+        UsePowerGovernor = true;
+        printf ("CPU performance governor while SDR active\n");
+        break;
+
+      case 'A':
+        ThreadCPUSets = optarg;
+        break;
+
+      case 'B':                                       // board: already selected
+        break;
+
+      case 'H':                                       // FPGA reconfiguration: already done
+        break;
+
+      case 'C':                                       // config file: already read
+        break;
+
+      case 'S':
+        if(!SetSoakDDCMix(optarg))
+          return EXIT_FAILURE;
+        SoakMix = optarg;
+        break;
     }
   }
   printf("\n");
 
+//
+// soak test: runs until ctrl-C, in place of the protocol 2 threads
+//
+  if(SoakMix != NULL)
+    return RunSoakTest(TestFrequency, &ExitRequested);
+  InitialiseThreadManager(UseRealtimeThreads, ThreadCPUSets);
 
 //
-// startup ATU handler if needed
+// start up the housekeeping thread, with the check for no longer getting messages, to set back to inactive
 //
-  if(UseLDGATU)
-    InitialiseLDGHandler();
+  if(!StartHousekeeping() || (AddHousekeepingTimer("activity check", 1000, CheckForActivity, NULL) < 0))
+  {
+    perror("pthread_create housekeeping");
+    return EXIT_FAILURE;
+  }
 
 //
-// startup ATU handler if needed
+// start the log output thread: real time threads log through it rather than printf
 //
-  if(UseAriesATU)
-    InitialiseAriesHandler();
+  InitialiseRingLog(VLOGMAXPERSECOND);
 
 //
-// startup G2 front panel handler if needed
+// start the metrics server if requested
 //
-  if(UseControlPanel)
-    InitialiseFrontPanelHandler();
+  if(MetricsPort != 0)
+  {
+    InitialiseMetricsServer(MetricsPort);
+    if(FIFOSampleRate != 0)
+      InitialiseFIFOSampler(FIFOSampleRate);
+    if(!StartThreadStats(UseThreadPerfCounters))
+      perror("pthread_create thread stats");
+  }
+
+//
+// start the stream loop deadline watchdog if requested
+//
+  if(!StartLoopWatchdog())
+    perror("pthread_create loop watchdog");
+
+//
+// start the CPU governor; with metrics, it reads the temperatures even if not controlling
+//
+  if(UsePowerGovernor || (MetricsPort != 0))
+    if(!StartPowerGovernor(UsePowerGovernor))
+      perror("pthread_create power governor");
 
 //
-// start up thread for exit command checking
+// watch the command line for the exit command
 //
   if (SkipExitCheck == false)
   {
-    if(pthread_create(&CheckForExitThread, NULL, CheckForExitCommand, NULL) < 0)
-    {
-      perror("pthread_create check for exit");
-      return EXIT_FAILURE;
-    }
+    if(!AddHousekeepingFd(STDIN_FILENO, CheckForExitCommand, NULL))
+      printf("stdin can't be watched: exit command not available\n");
   }
-  pthread_detach(CheckForExitThread);
 
   //
   // create socket for incoming data on the command port
@@ -705,51 +1614,49 @@ int main(int argc, char *argv[])
     strncpy(hwaddr.ifr_name, ep->d_name, IFNAMSIZ - 1); 
     ioctl(SocketData[VPORTCOMMAND].Socketid, SIOCGIFHWADDR, &hwaddr);
     for(i = 0; i < 6; ++i) DiscoveryReply[i + 5] = hwaddr.ifr_addr.sa_data[i];         // copy MAC to reply message
+    if(UseNetAffinity)
+      ApplyNetAffinity(hwaddr.ifr_name);
 #endif
   DiscoveryReply[13] = (uint8_t)Version;
   DiscoveryReply[23] = (uint8_t)P2APPVERSION;
   
 
 
+//
+// the DDC specific, DUC specific and high priority ports are low rate:
+// one dispatcher thread waits on all three, and uses no CPU while they are idle
+// (with the DDC retransmit NACK port too, if enabled)
+//
   MakeSocket(SocketData+VPORTDDCSPECIFIC, 0);            // create and bind a socket
-  if(pthread_create(&DDCSpecificThread, NULL, IncomingDDCSpecific, (void*)&SocketData[VPORTDDCSPECIFIC]) < 0)
-  {
-    perror("pthread_create DDC specific");
-    return EXIT_FAILURE;
-  }
-  pthread_detach(DDCSpecificThread);
-
   MakeSocket(SocketData+VPORTDUCSPECIFIC, 0);            // create and bind a socket
-  if(pthread_create(&DUCSpecificThread, NULL, IncomingDUCSpecific, (void*)&SocketData[VPORTDUCSPECIFIC]) < 0)
-  {
-    perror("pthread_create DUC specific");
-    return EXIT_FAILURE;
-  }
-  pthread_detach(DUCSpecificThread);
-
   MakeSocket(SocketData+VPORTHIGHPRIORITYTOSDR, 0);            // create and bind a socket
-  if(pthread_create(&HighPriorityToSDRThread, NULL, IncomingHighPriority, (void*)&SocketData[VPORTHIGHPRIORITYTOSDR]) < 0)
+  InitialiseHighPriority(&SocketData[VPORTHIGHPRIORITYTOSDR]);
+  if(!AddInboundPort(&SocketData[VPORTDDCSPECIFIC], VDDCSPECIFICSIZE, 0, HandleDDCSpecificPacket)
+     || !AddInboundPort(&SocketData[VPORTDUCSPECIFIC], VDUCSPECIFICSIZE, 0, HandleDUCSpecificPacket)
+     || !AddInboundPort(&SocketData[VPORTHIGHPRIORITYTOSDR], VHIGHPRIOTIYTOSDRSIZE, VHIGHPRIORITYCONTROLSIZE,
+                        HandleHighPriorityPacket))
+    return EXIT_FAILURE;
+  if(!StartDDCRetransmit())
+    printf("DDC retransmit not started\n");
+  if(!CreateManagedThread(&InboundDispatcherThread, "inbound", eControlThread, InboundDispatcher, NULL))
   {
-    perror("pthread_create High priority to SDR");
+    perror("pthread_create inbound dispatcher");
     return EXIT_FAILURE;
   }
-  pthread_detach(HighPriorityToSDRThread);
 
   MakeSocket(SocketData+VPORTSPKRAUDIO, 0);            // create and bind a socket
-  if(pthread_create(&SpkrAudioThread, NULL, IncomingSpkrAudio, (void*)&SocketData[VPORTSPKRAUDIO]) < 0)
+  if(!CreateManagedThread(&SpkrAudioThread, "speaker", eStreamThread, IncomingSpkrAudio, (void*)&SocketData[VPORTSPKRAUDIO]))
   {
     perror("pthread_create speaker audio");
     return EXIT_FAILURE;
   }
-  pthread_detach(SpkrAudioThread);
 
   MakeSocket(SocketData+VPORTDUCIQ, 0);            // create and bind a socket
-  if(pthread_create(&DUCIQThread, NULL, IncomingDUCIQ, (void*)&SocketData[VPORTDUCIQ]) < 0)
+  if(!CreateManagedThread(&DUCIQThread, "DUC I/Q", eStreamThread, IncomingDUCIQ, (void*)&SocketData[VPORTDUCIQ]))
   {
     perror("pthread_create DUC I/Q");
     return EXIT_FAILURE;
   }
-  pthread_detach(DUCIQThread);
 
 //
 // create outgoing mic data thread
@@ -758,12 +1665,12 @@ int main(int argc, char *argv[])
 //
   SocketData[VPORTMICAUDIO].Socketid = SocketData[VPORTDUCSPECIFIC].Socketid;
   memcpy(&SocketData[VPORTMICAUDIO].addr_cmddata, &SocketData[VPORTDUCSPECIFIC].addr_cmddata, sizeof(struct sockaddr_in));
-  if(pthread_create(&MicThread, NULL, OutgoingMicSamples, (void*)&SocketData[VPORTMICAUDIO]) < 0)
+  TuneSocket(&SocketData[VPORTMICAUDIO]);
+  if(!CreateManagedThread(&MicThread, "mic", eStreamThread, OutgoingMicSamples, (void*)&SocketData[VPORTMICAUDIO]))
   {
     perror("pthread_create Mic");
     return EXIT_FAILURE;
   }
-  pthread_detach(MicThread);
 
 
 //
@@ -773,12 +1680,12 @@ int main(int argc, char *argv[])
 //
   SocketData[VPORTHIGHPRIORITYFROMSDR].Socketid = SocketData[VPORTDDCSPECIFIC].Socketid;
   memcpy(&SocketData[VPORTHIGHPRIORITYFROMSDR].addr_cmddata, &SocketData[VPORTDDCSPECIFIC].addr_cmddata, sizeof(struct sockaddr_in));
-  if(pthread_create(&HighPriorityFromSDRThread, NULL, OutgoingHighPriority, (void*)&SocketData[VPORTHIGHPRIORITYFROMSDR]) < 0)
+  TuneSocket(&SocketData[VPORTHIGHPRIORITYFROMSDR]);
+  if(!CreateManagedThread(&HighPriorityFromSDRThread, "high priority", eControlThread, OutgoingHighPriority, (void*)&SocketData[VPORTHIGHPRIORITYFROMSDR]))
   {
     perror("pthread_create outgoing hi priority");
     return EXIT_FAILURE;
   }
-  pthread_detach(HighPriorityFromSDRThread);
 
 
 //
@@ -795,14 +1702,21 @@ int main(int argc, char *argv[])
   MakeSocket(SocketData + VPORTDDCIQ7, 0);
   MakeSocket(SocketData + VPORTDDCIQ8, 0);
   MakeSocket(SocketData + VPORTDDCIQ9, 0);
-  if(pthread_create(&DDCIQThread[0], NULL, OutgoingDDCIQ, (void*)&SocketData[VPORTDDCIQ0]) < 0)
+  if(!StartChannelizers())
+    printf("channelizer not started\n");
+  if(!StartDDCShmExport())
+    printf("DDC shared memory export not started\n");
+  if(!StartOverloadControl())
+    printf("overload control not started\n");
+  if(!StartDDCScans())
+    printf("DDC scan not started\n");
+  if(!CreateManagedThread(&DDCIQThread[0], "DDC I/Q", eStreamThread, OutgoingDDCIQ, (void*)&SocketData[VPORTDDCIQ0]))
   {
     perror("pthread_create DUC I/Q");
     return EXIT_FAILURE;
   }
-  pthread_detach(DDCIQThread[0]);
 
-  if(Version >= 18)
+  if(GetFPGACapabilities()->HasWideband)
   {
 //
 // create outgoing wideband data thread which services bothe wideband0 and wideband1
@@ -814,13 +1728,22 @@ int main(int argc, char *argv[])
     SocketData[VPORTWIDEBAND1].Socketid = SocketData[VPORTSPKRAUDIO].Socketid;
     memcpy(&SocketData[VPORTWIDEBAND0].addr_cmddata, &SocketData[VPORTHIGHPRIORITYTOSDR].addr_cmddata, sizeof(struct sockaddr_in));
     memcpy(&SocketData[VPORTWIDEBAND1].addr_cmddata, &SocketData[VPORTSPKRAUDIO].addr_cmddata, sizeof(struct sockaddr_in));
-    if(pthread_create(&WidebandDataThread, NULL, OutgoingWidebandSamples, (void*)&SocketData[VPORTWIDEBAND0]) < 0)
+    TuneSocket(&SocketData[VPORTWIDEBAND0]);
+    TuneSocket(&SocketData[VPORTWIDEBAND1]);
+    if(!CreateManagedThread(&WidebandDataThread, "wideband", eStreamThread, OutgoingWidebandSamples, (void*)&SocketData[VPORTWIDEBAND0]))
     {
       perror("pthread_create outgoing wideband data");
       return EXIT_FAILURE;
     }
-    pthread_detach(WidebandDataThread);
   }
+  MarkStartup("sockets and stream threads started: discovery answered");
+
+//
+// now the panel and ATU probes, which can take seconds
+//
+  DeferredInitStarted = (pthread_create(&DeferredInitThread, NULL, DeferredInitWorker, NULL) == 0);
+  if(!DeferredInitStarted)
+    DeferredInitWorker(NULL);
 
 
 
@@ -855,6 +1778,13 @@ int main(int argc, char *argv[])
       break;
     if(ThreadError)
       break;
+    if(sigtimedwait(&ReloadSignals, NULL, &NoWait) == SIGHUP)
+    {
+      if(ConfigFile != NULL)
+        LoadConfigFile(ConfigFile, P2Settings, VNUMP2SETTINGS, true);
+      else
+        printf("SIGHUP: no config file to reload\n");
+    }
 
 
 //
@@ -864,7 +1794,7 @@ int main(int argc, char *argv[])
     CmdByte = UDPInBuffer[4];
     if(size==VDISCOVERYSIZE)  
     {
-      NewMessageReceived = true;
+      NoteMessageReceived();
       switch(CmdByte)
       {
         //
@@ -879,11 +1809,16 @@ int main(int argc, char *argv[])
           reply_addr.sin_family = AF_INET;
           reply_addr.sin_addr.s_addr = addr_from.sin_addr.s_addr;
           reply_addr.sin_port = addr_from.sin_port;                       // (but each outgoing thread needs to set its own sin_port)
+          WaitHardwareInit();                                             // defaults must be in place first
           HandleGeneralPacket(UDPInBuffer);
           ReplyAddressSet = true;
+          State = BeginRadioStateUpdate();
+          State->ReplyAddr = reply_addr;
+          State->ReplyAddressSet = true;
+          EndRadioStateUpdate();
           if(ReplyAddressSet && StartBitReceived)
           {
-            SDRActive = true;                                       // only set active if we have start bit too
+            SetSDRActive(true);                                     // only set active if we have start bit too
             SetTXEnable(true);
           }
           break;
@@ -893,7 +1828,7 @@ int main(int argc, char *argv[])
         //
         case 2:
           printf("P2 Discovery packet\n");
-          if(SDRActive || IncompatibleFirmware)
+          if(__atomic_load_n(&SDRActive, __ATOMIC_RELAXED) || IncompatibleFirmware)
             DiscoveryReply[4] = 3;                             // response 2 if not active, 3 if running
           else
             DiscoveryReply[4] = 2;                             // response 2 if not active, 3 if running
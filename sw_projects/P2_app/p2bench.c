@@ -0,0 +1,889 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// p2bench.c:
+//
+// microbenchmarks of the p2app hot kernels, run in isolation on synthetic data:
+// DDC sample unpack, DDC rate word analysis and frame decode, DDC sample size conversion, DUC I/Q swap and widen,
+// the speaker audio resampler, the wideband spectrum, zoom spectrum and sample packing, CAT command parsing,
+// and reads of a flag sharing a cache line with one another thread writes.
+// each kernel is timed in CPU cycles from the PMU cycle counter (perf_event_open)
+// if the kernel allows it, and in ns from CLOCK_MONOTONIC_RAW.
+//
+// build with "make bench"; links the simulated hardware (simhwaccess.c) so it runs anywhere.
+//
+// ./p2bench                      run and print results
+// ./p2bench -w baseline.txt      also save the results as a baseline
+// ./p2bench -c baseline.txt      compare with a baseline; exit status 1 if any kernel
+//           [-t percent]         is more than percent (default 10) slower
+// ./p2bench -k unpack            run only the kernels whose name contains a string
+//
+//////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "../common/saturntypes.h"
+#include "../common/saturnregisters.h"
+#include "../common/saturndrivers.h"
+#include "../common/hwaccess.h"
+#include "../common/sampleunpack.h"
+#include "../common/wbspectrum.h"
+#include "../common/wbpack.h"
+#include "../common/channelizer.h"
+#include "../common/decimator.h"
+#include "../common/ddcconvert.h"
+#include "../common/audioresample.h"
+#include "threaddata.h"
+#include "cathandler.h"
+#include "AriesATU.h"
+#include "g2v2panel.h"
+#include "serialport.h"
+
+
+#define VBENCHREPEATS 15                        // timed runs of each kernel; the fastest is reported
+#define VBENCHMAXKERNELS 32
+#define VBENCHDEFAULTLIMIT 10.0                 // regression limit, percent
+#define VBENCHSTREAMBYTES 65536                 // synthetic DDC DMA block
+#define VBENCHIQSAMPLESPERFRAME 238             // DDC packet (as OutDDCIQ.c)
+#define VBENCHDUCSAMPLES 240                    // DUC packet (as InDUCIQ.c)
+#define VBENCHWBSAMPLES 16384                   // wideband capture
+#define VBENCHCHANNELS 32                       // channelizer channels
+#define VBENCHCHANBLOCKS 64                     // channelizer input blocks per pass
+#define VBENCHDECIMATION 8                      // software DDC decimation factor
+#define VBENCHFLAGREADS 1048576                 // flag reads per pass
+#define VBENCHCATSOURCE 99                      // CAT source handle: not the TCP port or a serial device
+
+
+//
+// stubs for the front panel, ATU and p2app code the CAT handlers call
+//
+struct sockaddr_in reply_addr;
+bool SDRActive = false;
+
+void HandlerSetEERMode(__attribute__((unused)) bool EEREnabled) {}
+void SendStringToSerial(__attribute__((unused)) int Device, __attribute__((unused)) char* Message) {}
+bool IsAriesSerial(__attribute__((unused)) int Handle) { return false; }
+bool IsFrontPanelSerial(__attribute__((unused)) int32_t Handle) { return false; }
+void SetAriesZZZSState(__attribute__((unused)) uint8_t ProductID, __attribute__((unused)) uint8_t HWVersion,
+                       __attribute__((unused)) uint8_t SWID) {}
+void SetAriesTuneState(__attribute__((unused)) bool Param) {}
+void HandleAriesZZZPMessage(__attribute__((unused)) uint32_t Param) {}
+void HandleAriesZZOXMessage(__attribute__((unused)) bool Param) {}
+void HandleAriesZZOZMessage(__attribute__((unused)) bool Param) {}
+void SetG2V2ZZUTState(__attribute__((unused)) bool NewState) {}
+void SetG2V2ZZYRState(__attribute__((unused)) bool NewState) {}
+void SetG2V2ZZXVState(__attribute__((unused)) uint32_t NewState) {}
+void SetG2V2ZZZSState(__attribute__((unused)) uint8_t ProductID, __attribute__((unused)) uint8_t HWVersion,
+                      __attribute__((unused)) uint8_t SWID) {}
+void SetG2V2ZZZIState(__attribute__((unused)) uint32_t Param) {}
+void HandleG2V2ZZZPMessage(__attribute__((unused)) uint32_t Param) {}
+
+
+//
+// one benchmark
+// Run() makes one pass over the synthetic data; Items is the work it does (samples, frames, commands)
+// so results are per item and comparable between builds
+//
+struct BenchKernel
+{
+    const char* Name;
+    const char* Unit;                           // what an item is
+    void (*Setup)(void);
+    void (*Run)(void);
+    uint32_t Items;                             // items processed per Run()
+    uint32_t Passes;                            // Run() calls per timed run
+};
+
+
+//
+// one result
+//
+struct BenchResult
+{
+    const char* Name;
+    double NsPerItem;
+    double CyclesPerItem;                       // < 0 if the PMU isn't available
+};
+
+
+//
+// synthetic data, shared by the kernels
+//
+static uint8_t* DDCStream;                      // DDC DMA data: frames of a rate word then samples
+static uint32_t DDCStreamBytes;                 // bytes of whole frames in DDCStream
+static uint32_t DDCStreamFrames;
+static uint32_t DDCRateWord;
+static uint8_t* DDCPackets;                     // one packet of I/Q per DDC
+static uint32_t DDCFillBytes[VNUMDDC];
+static uint8_t* DUCIn;
+static uint8_t* DUCOut;
+static int16_t* WBSamples;
+static int16_t WBPower[VWBMAXBINS];
+static uint8_t WBPacked[VBENCHWBSAMPLES * 2];
+static const struct WBSpectrumPlan* WBPlan;
+static const struct WBZoomPlan* WBZoom;
+static struct Channelizer BenchChannelizer;
+static float ChanInput[2 * VBENCHCHANNELS * VBENCHCHANBLOCKS];
+static float ChanOutput[2 * VBENCHCHANNELS];
+static struct Decimator BenchDecimator;
+static uint8_t DecInput[6 * VBENCHIQSAMPLESPERFRAME];
+static uint8_t DecOutput[6 * VBENCHIQSAMPLESPERFRAME];
+static uint8_t ConvertOutput[8 * VBENCHIQSAMPLESPERFRAME];
+static uint32_t Sink;                           // results are accumulated here so the work isn't optimised away
+
+//
+// shared flags: a flag read in a loop, and a flag another thread writes, either
+// in the same cache line or each in its own (as threaddata.h now lays them out)
+//
+struct BenchSharedFlags
+{
+    bool Read;
+    bool Written;
+};
+struct BenchPaddedFlags
+{
+    bool Read __attribute__((aligned(VCACHELINESIZE)));
+    bool Written __attribute__((aligned(VCACHELINESIZE)));
+};
+static struct BenchSharedFlags SharedFlags __attribute__((aligned(VCACHELINESIZE)));
+static struct BenchPaddedFlags PaddedFlags;
+static bool* BenchReadFlag;
+static bool* BenchWrittenFlag;
+static bool BenchWriterStop;
+
+static int CycleCounter_fd = -1;                // PMU cycle counter, or -1
+
+
+//
+// CAT commands: a mix of frequency, state, button and unknown commands as a panel sends
+//
+static const char* const CATCommands[] =
+{
+    "ZZFA00014074000;", "ZZXV0123;", "ZZTU1;", "ZZZD01;", "ZZZU02;", "ZZZE105;",
+    "ZZZP101;", "ZZOA1;", "ZZYR0;", "ZZQQ;", "ZZUT0;", "ZZFT00007074000;"
+};
+#define VNUMBENCHCAT (sizeof(CATCommands) / sizeof(CATCommands[0]))
+static int CATLengths[VNUMBENCHCAT];
+static char CATBuffer[512];                     // all the commands, one after the other
+static int CATBufferLength;
+
+
+//
+// build a DDC rate word with every DDC at the same rate
+//
+static uint32_t MakeRateWord(uint32_t NumDDC, ESampleRate Rate)
+{
+    uint32_t Word = 0;
+    uint32_t DDC;
+
+    for (DDC = 0; DDC < NumDDC; DDC++)
+        Word |= (uint32_t)Rate << (DDC * 3);
+    return Word;
+}
+
+
+//
+// fill the DDC stream with whole frames for a rate word
+// samples are a counting pattern in the 48 bits the FPGA uses
+//
+static void MakeDDCStream(uint32_t RateWord)
+{
+    uint32_t Counts[VNUMDDC];
+    uint32_t FrameWords;
+    uint32_t Word, Frame;
+    uint8_t* Ptr;
+
+    DDCRateWord = RateWord;
+    FrameWords = AnalyseDDCHeader(RateWord, Counts) + 1;
+    DDCStreamFrames = VBENCHSTREAMBYTES / (FrameWords * 8);
+    DDCStreamBytes = DDCStreamFrames * FrameWords * 8;
+    Ptr = DDCStream;
+    for (Frame = 0; Frame < DDCStreamFrames; Frame++)
+    {
+        *(uint32_t*)Ptr = RateWord;
+        *(uint32_t*)(Ptr + 4) = 0x80000000;
+        Ptr += 8;
+        for (Word = 1; Word < FrameWords; Word++)
+        {
+            *(uint64_t*)Ptr = ((uint64_t)(Frame * FrameWords + Word) * 0x10203ULL) & 0xFFFFFFFFFFFFULL;
+            Ptr += 8;
+        }
+    }
+}
+
+
+static void SetupDDC10x192(void)
+{
+    MakeDDCStream(MakeRateWord(10, e192KHz));
+}
+
+
+static void SetupDDC2x1536(void)
+{
+    MakeDDCStream(MakeRateWord(2, e1536KHz));
+}
+
+
+static void SetupDDC4x48(void)
+{
+    MakeDDCStream(MakeRateWord(4, e48KHz));
+}
+
+
+//
+// DDC unpack: the whole DMA block's sample words as one run
+//
+static void RunUnpack(void)
+{
+    UnpackDDCSamples(DDCPackets, DDCStream, VBENCHSTREAMBYTES / 8);
+    Sink += DDCPackets[7];
+}
+
+
+static void RunUnpackScalar(void)
+{
+    UnpackDDCSamplesScalar(DDCPackets, DDCStream, VBENCHSTREAMBYTES / 8);
+    Sink += DDCPackets[7];
+}
+
+
+//
+// rate word analysis: once per frame, as it was done before frame plans
+//
+static void RunAnalyseHeader(void)
+{
+    uint32_t Counts[VNUMDDC];
+    uint32_t Frame;
+
+    for (Frame = 0; Frame < 1024; Frame++)
+        Sink += AnalyseDDCHeader(DDCRateWord ^ (Frame & 1), Counts);
+}
+
+
+//
+// frame decode as OutDDCIQ.c DecodeDDCFrames(): check each rate word, look up the
+// frame plan, then unpack each active DDC's samples into its packet, starting a new
+// packet when one fills
+//
+static void RunFrameDecode(void)
+{
+    const struct DDCFramePlan* Plan;
+    uint8_t* FramePtr = DDCStream;
+    uint8_t* SrcPtr;
+    uint8_t* DestPtr;
+    uint32_t Frame, Entry, DDC, Samples, SlotSamples;
+
+    for (Frame = 0; Frame < DDCStreamFrames; Frame++)
+    {
+        if (*(FramePtr + 7) != 0x80)
+            break;
+        Plan = GetDDCFramePlan(*(uint32_t*)FramePtr);
+        if (Plan == NULL)
+            break;
+        for (Entry = 0; Entry < Plan->ActiveDDCs; Entry++)
+        {
+            DDC = Plan->DDC[Entry];
+            SrcPtr = FramePtr + 8 + Plan->Offset[Entry];
+            Samples = Plan->Count[Entry];
+            while (Samples != 0)
+            {
+                SlotSamples = VBENCHIQSAMPLESPERFRAME - DDCFillBytes[DDC] / 6;
+                if (SlotSamples > Samples)
+                    SlotSamples = Samples;
+                DestPtr = DDCPackets + DDC * 6 * VBENCHIQSAMPLESPERFRAME + DDCFillBytes[DDC];
+                if (SlotSamples == 1)
+                    memcpy(DestPtr, SrcPtr, 6);
+                else
+                    UnpackDDCSamples(DestPtr, SrcPtr, SlotSamples);
+                SrcPtr += 8 * SlotSamples;
+                DDCFillBytes[DDC] += 6 * SlotSamples;
+                Samples -= SlotSamples;
+                if (DDCFillBytes[DDC] == 6 * VBENCHIQSAMPLESPERFRAME)
+                    DDCFillBytes[DDC] = 0;
+            }
+        }
+        FramePtr += (Plan->FrameLength + 1) * 8;
+    }
+    Sink += DDCPackets[5];
+}
+
+
+//
+// DUC I/Q swap: one packet's samples
+//
+static void SetupDUC(void)
+{
+    uint32_t Cntr;
+
+    for (Cntr = 0; Cntr < 6 * VBENCHDUCSAMPLES; Cntr++)
+        DUCIn[Cntr] = (uint8_t)(Cntr * 7);
+}
+
+
+static void RunSwap(void)
+{
+    SwapIQSamples(DUCOut, DUCIn, VBENCHDUCSAMPLES);
+    Sink += DUCOut[3];
+}
+
+
+static void RunSwapScalar(void)
+{
+    SwapIQSamplesScalar(DUCOut, DUCIn, VBENCHDUCSAMPLES);
+    Sink += DUCOut[3];
+}
+
+
+static void RunWidenSwap16(void)
+{
+    WidenSwapIQSamples16(DUCOut, DUCIn, VBENCHDUCSAMPLES);
+    Sink += DUCOut[3];
+}
+
+
+static void RunWidenSwap16Scalar(void)
+{
+    WidenSwapIQSamples16Scalar(DUCOut, DUCIn, VBENCHDUCSAMPLES);
+    Sink += DUCOut[3];
+}
+
+
+//
+// DUC EER swap and envelope, with the envelope delayed (so no phase copy)
+//
+static struct EERDelayState BenchEERState;
+
+static void SetupEER(void)
+{
+    SetupDUC();
+    InitialiseEERDelay(&BenchEERState, 4);
+}
+
+
+static void RunEERSwap(void)
+{
+    EERSwapIQSamples(DUCOut, DUCIn, VBENCHDUCSAMPLES, &BenchEERState);
+    Sink += DUCOut[7];
+}
+
+
+static void RunEERSwapScalar(void)
+{
+    EERSwapIQSamplesScalar(DUCOut, DUCIn, VBENCHDUCSAMPLES, &BenchEERState);
+    Sink += DUCOut[7];
+}
+
+
+//
+// speaker resampler: one packet's samples (as InSpkrAudio.c), 300ppm from 1:1
+//
+#define VBENCHSPKSAMPLES 64
+
+static struct AudioResampler SpkResampler;
+
+static void SetupResample(void)
+{
+    SetupDUC();
+    InitialiseAudioResampler(&SpkResampler);
+    SpkResampler.Step = 1.0003;
+}
+
+
+static void RunResample(void)
+{
+    Sink += ResampleAudio(&SpkResampler, DUCOut, DUCIn, VBENCHSPKSAMPLES);
+}
+
+
+static void RunResampleScalar(void)
+{
+    Sink += ResampleAudioScalar(&SpkResampler, DUCOut, DUCIn, VBENCHSPKSAMPLES);
+}
+
+
+//
+// wideband spectrum of one capture
+//
+static void SetupWB(void)
+{
+    uint32_t Cntr;
+
+    for (Cntr = 0; Cntr < VBENCHWBSAMPLES; Cntr++)
+        WBSamples[Cntr] = (int16_t)((Cntr * 2654435761U) >> 20) - 2048;
+    WBPlan = GetWBSpectrumPlan(VBENCHWBSAMPLES, VWBMAXBINS);
+}
+
+
+static void RunWBSpectrum(void)
+{
+    if (WBPlan != NULL)
+        ComputeWBSpectrum(WBPlan, WBSamples, WBPower);
+    Sink += (uint32_t)WBPower[1];
+}
+
+
+//
+// zoom spectrum of one capture: 512 bins of a 7.68MHz sub-band
+//
+static void SetupWBZoom(void)
+{
+    SetupWB();
+    WBZoom = GetWBZoomPlan(VBENCHWBSAMPLES, VWBMINBINS, 7100000, 16);
+}
+
+
+static void RunWBZoom(void)
+{
+    if (WBZoom != NULL)
+        ComputeWBZoomSpectrum(WBZoom, WBSamples, WBPower);
+    Sink += (uint32_t)WBPower[1];
+}
+
+
+//
+// wideband sample packing of one capture: 12 bit and 8 bit mu-law
+//
+static void RunWBPack12(void)
+{
+    Sink += PackWBSamples(WBPacked, WBSamples, VBENCHWBSAMPLES, 12);
+    Sink += WBPacked[1];
+}
+
+
+static void RunWBPack8(void)
+{
+    Sink += PackWBSamples(WBPacked, WBSamples, VBENCHWBSAMPLES, 8);
+    Sink += WBPacked[1];
+}
+
+
+//
+// channelizer: one 1536KHz packet's worth of input blocks, split 32 ways
+//
+static void SetupChannelizer(void)
+{
+    uint32_t Cntr;
+
+    InitialiseChannelizer(&BenchChannelizer, VBENCHCHANNELS);
+    for (Cntr = 0; Cntr < 2 * VBENCHCHANNELS * VBENCHCHANBLOCKS; Cntr++)
+        ChanInput[Cntr] = (float)((int32_t)((Cntr * 2654435761U) >> 8) - 0x800000);
+}
+
+
+static void RunChannelizerBlocks(void)
+{
+    uint32_t Block;
+
+    for (Block = 0; Block < VBENCHCHANBLOCKS; Block++)
+        RunChannelizer(&BenchChannelizer, ChanInput + 2 * VBENCHCHANNELS * Block, ChanOutput);
+    Sink += (uint32_t)ChanOutput[0];
+}
+
+
+//
+// software decimation: one DDC packet of input, decimated by 8
+//
+static void SetupDecimator(void)
+{
+    uint32_t Cntr;
+
+    InitialiseDecimator(&BenchDecimator, VBENCHDECIMATION);
+    for (Cntr = 0; Cntr < sizeof(DecInput); Cntr++)
+        DecInput[Cntr] = (uint8_t)((Cntr * 2654435761U) >> 24);
+}
+
+
+static void RunDecimatorPacket(void)
+{
+    Sink += RunDecimator(&BenchDecimator, DecInput, VBENCHIQSAMPLESPERFRAME, DecOutput);
+    Sink += DecOutput[0];
+}
+
+
+//
+// DDC sample size conversion: one packet's samples to 16 bit and to float (decimator input data)
+//
+static void RunConvert16(void)
+{
+    ConvertDDCSamples16(ConvertOutput, DecInput, VBENCHIQSAMPLESPERFRAME);
+    Sink += ConvertOutput[5];
+}
+
+
+static void RunConvert16Scalar(void)
+{
+    ConvertDDCSamples16Scalar(ConvertOutput, DecInput, VBENCHIQSAMPLESPERFRAME);
+    Sink += ConvertOutput[5];
+}
+
+
+static void RunConvertFloat(void)
+{
+    ConvertDDCSamplesFloat(ConvertOutput, DecInput, VBENCHIQSAMPLESPERFRAME);
+    Sink += ConvertOutput[5];
+}
+
+
+static void RunConvertFloatScalar(void)
+{
+    ConvertDDCSamplesFloatScalar(ConvertOutput, DecInput, VBENCHIQSAMPLESPERFRAME);
+    Sink += ConvertOutput[5];
+}
+
+
+//
+// flag reads while another thread writes a neighbouring flag, as the receive
+// threads did to NewMessageReceived each packet. (needs 2 CPUs to show the effect)
+//
+static void SetupSharedFlags(void)
+{
+    BenchReadFlag = &SharedFlags.Read;
+    BenchWrittenFlag = &SharedFlags.Written;
+}
+
+
+static void SetupPaddedFlags(void)
+{
+    BenchReadFlag = &PaddedFlags.Read;
+    BenchWrittenFlag = &PaddedFlags.Written;
+}
+
+
+static void* BenchFlagWriter(__attribute__((unused)) void* arg)
+{
+    bool Value = false;
+
+    while (!__atomic_load_n(&BenchWriterStop, __ATOMIC_RELAXED))
+    {
+        Value = !Value;
+        __atomic_store_n(BenchWrittenFlag, Value, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+
+static void RunFlagReads(void)
+{
+    pthread_t Writer;
+    uint32_t Cntr;
+    uint32_t Count = 0;
+
+    __atomic_store_n(&BenchWriterStop, false, __ATOMIC_RELAXED);
+    if (pthread_create(&Writer, NULL, BenchFlagWriter, NULL) != 0)
+        return;
+    for (Cntr = 0; Cntr < VBENCHFLAGREADS; Cntr++)
+        Count += __atomic_load_n(BenchReadFlag, __ATOMIC_RELAXED);
+    __atomic_store_n(&BenchWriterStop, true, __ATOMIC_RELAXED);
+    pthread_join(Writer, NULL);
+    Sink += Count;
+}
+
+
+//
+// CAT parse: each command on its own, then the whole buffer as serial input arrives
+//
+static void SetupCAT(void)
+{
+    uint32_t Cntr;
+
+    CATBufferLength = 0;
+    for (Cntr = 0; Cntr < VNUMBENCHCAT; Cntr++)
+    {
+        CATLengths[Cntr] = (int)strlen(CATCommands[Cntr]);
+        memcpy(CATBuffer + CATBufferLength, CATCommands[Cntr], CATLengths[Cntr]);
+        CATBufferLength += CATLengths[Cntr];
+    }
+}
+
+
+static void RunCATCmd(void)
+{
+    uint32_t Cntr;
+
+    for (Cntr = 0; Cntr < VNUMBENCHCAT; Cntr++)
+        ParseCATCmd(CATCommands[Cntr], CATLengths[Cntr], VBENCHCATSOURCE);
+}
+
+
+static void RunCATBuffer(void)
+{
+    Sink += (uint32_t)ParseCATBuffer(CATBuffer, CATBufferLength, VBENCHCATSOURCE);
+}
+
+
+//
+// the kernels. Items for the DDC stream kernels are filled in after the stream is made.
+//
+static struct BenchKernel Kernels[] =
+{
+    {"ddc_unpack", "sample", SetupDDC10x192, RunUnpack, VBENCHSTREAMBYTES / 8, 20},
+    {"ddc_unpack_scalar", "sample", SetupDDC10x192, RunUnpackScalar, VBENCHSTREAMBYTES / 8, 20},
+    {"ddc_header_analyse", "frame", SetupDDC10x192, RunAnalyseHeader, 1024, 20},
+    {"ddc_decode_10x192k", "sample", SetupDDC10x192, RunFrameDecode, 0, 20},
+    {"ddc_decode_2x1536k", "sample", SetupDDC2x1536, RunFrameDecode, 0, 20},
+    {"ddc_decode_4x48k", "sample", SetupDDC4x48, RunFrameDecode, 0, 20},
+    {"duc_swap", "sample", SetupDUC, RunSwap, VBENCHDUCSAMPLES, 2000},
+    {"duc_swap_scalar", "sample", SetupDUC, RunSwapScalar, VBENCHDUCSAMPLES, 2000},
+    {"duc_swap_16", "sample", SetupDUC, RunWidenSwap16, VBENCHDUCSAMPLES, 2000},
+    {"duc_swap_16_scalar", "sample", SetupDUC, RunWidenSwap16Scalar, VBENCHDUCSAMPLES, 2000},
+    {"duc_eer", "sample", SetupEER, RunEERSwap, VBENCHDUCSAMPLES, 2000},
+    {"duc_eer_scalar", "sample", SetupEER, RunEERSwapScalar, VBENCHDUCSAMPLES, 2000},
+    {"spk_resample", "sample", SetupResample, RunResample, VBENCHSPKSAMPLES, 2000},
+    {"spk_resample_scalar", "sample", SetupResample, RunResampleScalar, VBENCHSPKSAMPLES, 2000},
+    {"wb_spectrum_1024", "capture", SetupWB, RunWBSpectrum, 1, 4},
+    {"wb_zoom_512_d16", "capture", SetupWBZoom, RunWBZoom, 1, 4},
+    {"wb_pack_12", "sample", SetupWB, RunWBPack12, VBENCHWBSAMPLES, 20},
+    {"wb_pack_mulaw", "sample", SetupWB, RunWBPack8, VBENCHWBSAMPLES, 20},
+    {"channelizer_32", "sample", SetupChannelizer, RunChannelizerBlocks, VBENCHCHANNELS * VBENCHCHANBLOCKS, 200},
+    {"ddc_decimate_8", "sample", SetupDecimator, RunDecimatorPacket, VBENCHIQSAMPLESPERFRAME, 2000},
+    {"ddc_convert_16", "sample", SetupDecimator, RunConvert16, VBENCHIQSAMPLESPERFRAME, 2000},
+    {"ddc_convert_16_scalar", "sample", SetupDecimator, RunConvert16Scalar, VBENCHIQSAMPLESPERFRAME, 2000},
+    {"ddc_convert_float", "sample", SetupDecimator, RunConvertFloat, VBENCHIQSAMPLESPERFRAME, 2000},
+    {"ddc_convert_float_scalar", "sample", SetupDecimator, RunConvertFloatScalar, VBENCHIQSAMPLESPERFRAME, 2000},
+    {"flag_shared_line", "read", SetupSharedFlags, RunFlagReads, VBENCHFLAGREADS, 4},
+    {"flag_own_line", "read", SetupPaddedFlags, RunFlagReads, VBENCHFLAGREADS, 4},
+    {"cat_parse_cmd", "command", SetupCAT, RunCATCmd, VNUMBENCHCAT, 2000},
+    {"cat_parse_buffer", "command", SetupCAT, RunCATBuffer, VNUMBENCHCAT, 2000}
+};
+#define VNUMKERNELS (sizeof(Kernels) / sizeof(Kernels[0]))
+
+
+//
+// open the PMU cycle counter for this thread, user space only
+// returns -1 if not available (no PMU access, or perf_event_paranoid too high)
+//
+static int OpenCycleCounter(void)
+{
+    struct perf_event_attr Attr;
+
+    memset(&Attr, 0, sizeof(Attr));
+    Attr.type = PERF_TYPE_HARDWARE;
+    Attr.size = sizeof(Attr);
+    Attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    Attr.exclude_kernel = 1;
+    Attr.exclude_hv = 1;
+    return (int)syscall(__NR_perf_event_open, &Attr, 0, -1, -1, 0);
+}
+
+
+static uint64_t ReadCycleCounter(void)
+{
+    uint64_t Count = 0;
+
+    if (read(CycleCounter_fd, &Count, sizeof(Count)) != sizeof(Count))
+        Count = 0;
+    return Count;
+}
+
+
+static uint64_t GetTimeNs(void)
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &Now);
+    return (uint64_t)Now.tv_sec * 1000000000ULL + (uint64_t)Now.tv_nsec;
+}
+
+
+static int CompareDouble(const void* A, const void* B)
+{
+    double DblA = *(const double*)A;
+    double DblB = *(const double*)B;
+
+    return (DblA > DblB) - (DblA < DblB);
+}
+
+
+//
+// time one kernel: a warm up pass, then VBENCHREPEATS timed runs
+// reports the fastest run: interrupts and other processes only ever add time,
+// so the fastest is the most repeatable between runs
+//
+static void RunKernel(struct BenchKernel* Kernel, struct BenchResult* Result)
+{
+    double Ns[VBENCHREPEATS];
+    double Cycles[VBENCHREPEATS];
+    uint64_t StartNs, StartCycles = 0;
+    uint32_t Repeat, Pass;
+    double Items;
+
+    Kernel->Setup();
+    if (Kernel->Items == 0)
+        Kernel->Items = DDCStreamBytes / 8 - DDCStreamFrames;        // sample words in the stream
+    memset(DDCFillBytes, 0, sizeof(DDCFillBytes));
+    Kernel->Run();
+    Items = (double)Kernel->Items * (double)Kernel->Passes;
+    for (Repeat = 0; Repeat < VBENCHREPEATS; Repeat++)
+    {
+        if (CycleCounter_fd >= 0)
+            StartCycles = ReadCycleCounter();
+        StartNs = GetTimeNs();
+        for (Pass = 0; Pass < Kernel->Passes; Pass++)
+            Kernel->Run();
+        Ns[Repeat] = (double)(GetTimeNs() - StartNs) / Items;
+        if (CycleCounter_fd >= 0)
+            Cycles[Repeat] = (double)(ReadCycleCounter() - StartCycles) / Items;
+    }
+    qsort(Ns, VBENCHREPEATS, sizeof(double), CompareDouble);
+    Result->Name = Kernel->Name;
+    Result->NsPerItem = Ns[0];
+    Result->CyclesPerItem = -1.0;
+    if (CycleCounter_fd >= 0)
+    {
+        qsort(Cycles, VBENCHREPEATS, sizeof(double), CompareDouble);
+        Result->CyclesPerItem = Cycles[0];
+    }
+}
+
+
+//
+// compare results with a baseline file written by -w
+// cycles are compared if both have them (they don't depend on the clock frequency), else ns
+// returns the number of kernels slower than the limit
+//
+static uint32_t CompareBaseline(const char* Filename, struct BenchResult* Results, uint32_t Count, double Limit)
+{
+    FILE* File;
+    char Name[64];
+    double BaseNs, BaseCycles, Base, Now, Change;
+    uint32_t Cntr;
+    uint32_t Regressions = 0;
+
+    File = fopen(Filename, "r");
+    if (File == NULL)
+    {
+        perror(Filename);
+        return 1;
+    }
+    printf("\ncompared with %s (limit +%.1f%%):\n", Filename, Limit);
+    while (fscanf(File, "%63s %lf %lf", Name, &BaseNs, &BaseCycles) == 3)
+    {
+        for (Cntr = 0; Cntr < Count; Cntr++)
+            if (strcmp(Name, Results[Cntr].Name) == 0)
+                break;
+        if (Cntr == Count)
+            continue;
+        if ((BaseCycles > 0.0) && (Results[Cntr].CyclesPerItem > 0.0))
+        {
+            Base = BaseCycles;
+            Now = Results[Cntr].CyclesPerItem;
+        }
+        else
+        {
+            Base = BaseNs;
+            Now = Results[Cntr].NsPerItem;
+        }
+        Change = (Base > 0.0) ? 100.0 * (Now - Base) / Base : 0.0;
+        printf("  %-20s %+7.1f%%%s\n", Name, Change, (Change > Limit) ? "  REGRESSION" : "");
+        if (Change > Limit)
+            Regressions++;
+    }
+    fclose(File);
+    return Regressions;
+}
+
+
+int main(int argc, char *argv[])
+{
+    struct BenchResult Results[VBENCHMAXKERNELS];
+    const char* BaselineOut = NULL;
+    const char* BaselineIn = NULL;
+    const char* Filter = NULL;
+    double Limit = VBENCHDEFAULTLIMIT;
+    uint32_t NumResults = 0;
+    uint32_t Cntr;
+    FILE* File;
+    int Option;
+
+    while ((Option = getopt(argc, argv, "w:c:t:k:")) != -1)
+    {
+        switch (Option)
+        {
+        case 'w':
+            BaselineOut = optarg;
+            break;
+        case 'c':
+            BaselineIn = optarg;
+            break;
+        case 't':
+            Limit = atof(optarg);
+            break;
+        case 'k':
+            Filter = optarg;
+            break;
+        default:
+            printf("usage: p2bench [-w baseline] [-c baseline [-t percent]] [-k kernel]\n");
+            return 1;
+        }
+    }
+
+    OpenXDMADriver(true);                                   // simulated: the CAT handlers write registers
+    InitialiseSampleUnpack();
+    InitCATHandler();                                       // builds the CAT command hash table
+    DDCStream = aligned_alloc(64, VBENCHSTREAMBYTES);
+    DDCPackets = aligned_alloc(64, VBENCHSTREAMBYTES);
+    DUCIn = aligned_alloc(64, 6 * VBENCHDUCSAMPLES);
+    DUCOut = aligned_alloc(64, 12 * VBENCHDUCSAMPLES);         // EER output is 12 bytes per sample
+    WBSamples = aligned_alloc(64, VBENCHWBSAMPLES * sizeof(int16_t));
+    if (!DDCStream || !DDCPackets || !DUCIn || !DUCOut || !WBSamples)
+    {
+        printf("p2bench: buffer allocation failed\n");
+        return 1;
+    }
+    CycleCounter_fd = OpenCycleCounter();
+    printf("p2bench: %s unpack kernels; timing from %s\n", SampleUnpackUsesNEON() ? "NEON" : "scalar",
+           (CycleCounter_fd >= 0) ? "PMU cycle counter and CLOCK_MONOTONIC_RAW" : "CLOCK_MONOTONIC_RAW (no PMU access)");
+    printf("%-20s %10s %12s  per\n", "kernel", "ns", "cycles");
+
+    for (Cntr = 0; (Cntr < VNUMKERNELS) && (NumResults < VBENCHMAXKERNELS); Cntr++)
+    {
+        if ((Filter != NULL) && (strstr(Kernels[Cntr].Name, Filter) == NULL))
+            continue;
+        RunKernel(&Kernels[Cntr], &Results[NumResults]);
+        if (Results[NumResults].CyclesPerItem >= 0.0)
+            printf("%-20s %10.2f %12.2f  %s\n", Results[NumResults].Name, Results[NumResults].NsPerItem,
+                   Results[NumResults].CyclesPerItem, Kernels[Cntr].Unit);
+        else
+            printf("%-20s %10.2f %12s  %s\n", Results[NumResults].Name, Results[NumResults].NsPerItem,
+                   "-", Kernels[Cntr].Unit);
+        NumResults++;
+    }
+
+    if (BaselineOut != NULL)
+    {
+        File = fopen(BaselineOut, "w");
+        if (File == NULL)
+        {
+            perror(BaselineOut);
+            return 1;
+        }
+        for (Cntr = 0; Cntr < NumResults; Cntr++)
+            fprintf(File, "%s %.4f %.4f\n", Results[Cntr].Name, Results[Cntr].NsPerItem, Results[Cntr].CyclesPerItem);
+        fclose(File);
+    }
+    if (CycleCounter_fd >= 0)
+        close(CycleCounter_fd);
+    if ((BaselineIn != NULL) && (CompareBaseline(BaselineIn, Results, NumResults, Limit) != 0))
+    {
+        printf("FAIL\n");
+        return 1;
+    }
+    return (Sink == 0xFFFFFFFF) ? 2 : 0;                    // uses Sink, so the kernels' work is kept
+}
@@ -0,0 +1,456 @@
+//-----------------------------------------------------------------------------
+// Name: p2client.hpp
+// Description: header only C++ receiver for protocol 2 DDC I/Q packets, for
+// capture servers and other client side tools.
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// the packet layout is the one OutDDCIQ.c sends (OutDDCIQ.h):
+//   bytes 0-3     sequence number, big endian
+//   bytes 4-11    timestamp, big endian
+//   bytes 12-13   bits per sample (24; or 16 or 32 if the client asked for them)
+//   bytes 14-15   samples per frame (238; 119 for 32 bit)
+//   16 on         I then Q for each sample, 24 bit big endian two's complement
+//                 (16 bit: big endian two's complement; 32 bit: little endian float,
+//                 see ddcconvert.h)
+//
+// usage:
+//   p2client::DDCReceiver Receiver(1035);           // DDC0 default port
+//   std::vector<std::complex<float>> IQ(VIQSAMPLESPERFRAME);
+//   while (...)
+//      for (size_t Cntr = 0, Count = Receiver.Receive(100); Cntr < Count; Cntr++)
+//         p2client::ConvertSamples(IQ.data(), Receiver[Cntr]);
+//
+// packets are received by recvmmsg() straight into the receiver's own buffers:
+// the views Receive() hands out point into them, and are valid until the next Receive()
+//
+// if p2app keeps packets for retransmission (-N), EnableRetransmitRequests() makes
+// each Receive() send one NACK (ddcretransmit.h) for the gaps it found. Resent
+// packets arrive late, so they are handed out, and counted, as reordered.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <arpa/inet.h>
+#include <endian.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <complex>
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+#include <system_error>
+#include <vector>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+extern "C"
+{
+#include "OutDDCIQ.h"
+#include "ddcretransmit.h"
+}
+
+namespace p2client
+{
+
+constexpr size_t DefaultBatch = 32;                 // most packets taken by one recvmmsg()
+constexpr int DefaultSocketBuffer = 4 * 1024 * 1024;
+
+//-------------------------------------------------------------------------------------//
+// one received DDC packet. Samples points into the receiver's buffer
+//-------------------------------------------------------------------------------------//
+struct DDCPacket
+{
+   uint32_t Sequence;
+   uint64_t TimeStamp;
+   uint32_t SampleCount;                            // VIQSAMPLESPERFRAME, or half that for float
+   uint32_t BitsPerSample;                          // 24, 16 or 32 (float)
+   const uint8_t* Samples;                          // SampleCount I, Q pairs of BitsPerSample each
+};
+
+//-------------------------------------------------------------------------------------//
+// receive statistics, since the receiver was made or ResetStatistics()
+//-------------------------------------------------------------------------------------//
+struct DDCStatistics
+{
+   uint64_t Received = 0;                           // good packets handed out
+   uint64_t Lost = 0;                               // packets missing from the sequence (less any that came late)
+   uint64_t Reordered = 0;                          // packets with a sequence number before the last
+   uint64_t Invalid = 0;                            // wrong size, or not a sample size listed above
+   uint64_t ReceiveCalls = 0;                       // recvmmsg() calls that returned packets
+   uint64_t Nacks = 0;                              // NACKs sent, if retransmit requests are enabled
+   uint64_t NackedPackets = 0;                      // packets asked for in them
+};
+
+
+/**
+ * @brief convert 24 bit big endian I/Q samples to floats in [-1, 1) with scalar code
+ *
+ * @param Dest: destination, 2 floats (I then Q) written per sample
+ * @param Src: source samples, 6 bytes per sample
+ * @param Count: number of samples
+ */
+inline void ConvertSamplesScalar(float* Dest, const uint8_t* Src, size_t Count)
+{
+   for (size_t Cntr = 0; Cntr < 2 * Count; Cntr++, Src += 3)
+   {
+      int32_t Value = (int32_t)(((uint32_t)Src[0] << 24) | ((uint32_t)Src[1] << 16) | ((uint32_t)Src[2] << 8));
+      Dest[Cntr] = (float)Value * (1.0f / 2147483648.0f);
+   }
+}
+
+
+#if defined(__ARM_NEON)
+//
+// 4 values from the 3 byte planes: (B0 << 24 | B1 << 16 | B2 << 8) as Q31
+//
+inline float32x4_t ConvertQ31NEON(uint16x4_t High, uint16x4_t Low)
+{
+   uint32x4_t Value = vorrq_u32(vshll_n_u16(High, 16), vmovl_u16(Low));
+   return vcvtq_n_f32_s32(vreinterpretq_s32_u32(Value), 31);
+}
+
+/**
+ * @brief convert 24 bit big endian I/Q samples to floats in [-1, 1) with NEON:
+ * 8 samples (16 values) per iteration, then scalar code for any remainder
+ *
+ * @param Dest: destination, 2 floats (I then Q) written per sample
+ * @param Src: source samples, 6 bytes per sample
+ * @param Count: number of samples
+ */
+inline void ConvertSamplesNEON(float* Dest, const uint8_t* Src, size_t Count)
+{
+   for (; Count >= 8; Count -= 8, Src += 48, Dest += 16)
+   {
+      uint8x16x3_t Bytes = vld3q_u8(Src);          // byte 0, 1 and 2 of 16 values
+      uint16x8_t HighLo = vorrq_u16(vshll_n_u8(vget_low_u8(Bytes.val[0]), 8), vmovl_u8(vget_low_u8(Bytes.val[1])));
+      uint16x8_t HighHi = vorrq_u16(vshll_n_u8(vget_high_u8(Bytes.val[0]), 8), vmovl_u8(vget_high_u8(Bytes.val[1])));
+      uint16x8_t LowLo = vshll_n_u8(vget_low_u8(Bytes.val[2]), 8);
+      uint16x8_t LowHi = vshll_n_u8(vget_high_u8(Bytes.val[2]), 8);
+      vst1q_f32(Dest, ConvertQ31NEON(vget_low_u16(HighLo), vget_low_u16(LowLo)));
+      vst1q_f32(Dest + 4, ConvertQ31NEON(vget_high_u16(HighLo), vget_high_u16(LowLo)));
+      vst1q_f32(Dest + 8, ConvertQ31NEON(vget_low_u16(HighHi), vget_low_u16(LowHi)));
+      vst1q_f32(Dest + 12, ConvertQ31NEON(vget_high_u16(HighHi), vget_high_u16(LowHi)));
+   }
+   ConvertSamplesScalar(Dest, Src, Count);
+}
+#endif
+
+
+/**
+ * @brief convert 24 bit big endian I/Q samples to floats in [-1, 1), with NEON if
+ * compiled for a processor that has it
+ *
+ * @param Dest: destination, 2 floats (I then Q) written per sample
+ * @param Src: source samples, 6 bytes per sample
+ * @param Count: number of samples
+ */
+inline void ConvertSamples(float* Dest, const uint8_t* Src, size_t Count)
+{
+#if defined(__ARM_NEON)
+   ConvertSamplesNEON(Dest, Src, Count);
+#else
+   ConvertSamplesScalar(Dest, Src, Count);
+#endif
+}
+
+/**
+ * @brief convert 16 bit big endian I/Q samples to floats in [-1, 1)
+ *
+ * @param Dest: destination, 2 floats (I then Q) written per sample
+ * @param Src: source samples, 4 bytes per sample
+ * @param Count: number of samples
+ */
+inline void ConvertSamples16(float* Dest, const uint8_t* Src, size_t Count)
+{
+   for (size_t Cntr = 0; Cntr < 2 * Count; Cntr++, Src += 2)
+      Dest[Cntr] = (float)(int16_t)(((uint16_t)Src[0] << 8) | Src[1]) * (1.0f / 32768.0f);
+}
+
+/**
+ * @brief copy little endian float I/Q samples
+ *
+ * @param Dest: destination, 2 floats (I then Q) written per sample
+ * @param Src: source samples, 8 bytes per sample
+ * @param Count: number of samples
+ */
+inline void ConvertSamplesFloat(float* Dest, const uint8_t* Src, size_t Count)
+{
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+   std::memcpy(Dest, Src, 8 * Count);
+#else
+   for (size_t Cntr = 0; Cntr < 2 * Count; Cntr++, Src += 4)
+   {
+      uint32_t Bits;
+      std::memcpy(&Bits, Src, sizeof(Bits));
+      Bits = le32toh(Bits);
+      std::memcpy(&Dest[Cntr], &Bits, sizeof(Bits));
+   }
+#endif
+}
+
+/**
+ * @brief convert the samples of one packet to complex floats in [-1, 1)
+ *
+ * @param Dest: destination, room for Packet.SampleCount samples
+ * @param Packet: a packet from DDCReceiver::Receive()
+ */
+inline void ConvertSamples(std::complex<float>* Dest, const DDCPacket& Packet)
+{
+   float* Values = reinterpret_cast<float*>(Dest);
+
+   if (Packet.BitsPerSample == 16)
+      ConvertSamples16(Values, Packet.Samples, Packet.SampleCount);
+   else if (Packet.BitsPerSample == 32)
+      ConvertSamplesFloat(Values, Packet.Samples, Packet.SampleCount);
+   else
+      ConvertSamples(Values, Packet.Samples, Packet.SampleCount);
+}
+
+
+class DDCReceiver
+{
+
+public:
+
+/**
+ * @brief open a UDP socket for one DDC stream
+ *
+ * @param Port: UDP port the DDC is sent to
+ * @param BindAddress: local address to bind to, or nullptr for any
+ * @param Batch: most packets received by one Receive()
+ * @param SocketBuffer: socket receive buffer size requested, bytes
+ * @throws std::system_error if the socket can't be opened
+ */
+   explicit DDCReceiver(uint16_t Port, const char* BindAddress = nullptr, size_t Batch = DefaultBatch,
+                        int SocketBuffer = DefaultSocketBuffer)
+      : Buffers(Batch * VDDCPACKETSIZE), Messages(Batch), Vectors(Batch), Packets(Batch)
+   {
+      struct sockaddr_in Addr;
+      int Enable = 1;
+
+      Socket = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+      if (Socket < 0)
+         throw std::system_error(errno, std::system_category(), "DDC socket");
+      setsockopt(Socket, SOL_SOCKET, SO_REUSEADDR, &Enable, sizeof(Enable));
+      setsockopt(Socket, SOL_SOCKET, SO_RCVBUF, &SocketBuffer, sizeof(SocketBuffer));
+      std::memset(&Addr, 0, sizeof(Addr));
+      Addr.sin_family = AF_INET;
+      Addr.sin_port = htons(Port);
+      Addr.sin_addr.s_addr = htonl(INADDR_ANY);
+      if ((BindAddress != nullptr) && (inet_pton(AF_INET, BindAddress, &Addr.sin_addr) != 1))
+      {
+         close(Socket);
+         throw std::system_error(EINVAL, std::system_category(), "DDC bind address");
+      }
+      if (bind(Socket, (struct sockaddr*)&Addr, sizeof(Addr)) < 0)
+      {
+         int Error = errno;
+         close(Socket);
+         throw std::system_error(Error, std::system_category(), "DDC socket bind");
+      }
+      for (size_t Cntr = 0; Cntr < Batch; Cntr++)
+      {
+         Vectors[Cntr].iov_base = &Buffers[Cntr * VDDCPACKETSIZE];
+         Vectors[Cntr].iov_len = VDDCPACKETSIZE;
+      }
+   }
+
+   ~DDCReceiver()
+   {
+      if (Socket >= 0)
+         close(Socket);
+   }
+
+   DDCReceiver(const DDCReceiver&) = delete;
+   DDCReceiver& operator=(const DDCReceiver&) = delete;
+
+/**
+ * @brief receive the packets waiting, up to the batch size, with one recvmmsg()
+ *
+ * @param TimeoutMs: longest wait for the 1st packet; 0 = don't wait, -1 = wait for ever
+ * @return the number of good packets, accessed by operator[]; 0 on timeout
+ * (packets from the last call are no longer valid)
+ * @throws std::system_error if the socket fails
+ */
+   size_t Receive(int TimeoutMs)
+   {
+      struct pollfd Poll = { Socket, POLLIN, 0 };
+      int Count;
+
+      PacketCount = 0;
+      if (TimeoutMs != 0)
+      {
+         Count = poll(&Poll, 1, TimeoutMs);
+         if (Count == 0)
+            return 0;
+         if ((Count < 0) && (errno != EINTR))
+            throw std::system_error(errno, std::system_category(), "DDC poll");
+      }
+      for (size_t Cntr = 0; Cntr < Messages.size(); Cntr++)
+      {
+         std::memset(&Messages[Cntr], 0, sizeof(Messages[Cntr]));
+         Messages[Cntr].msg_hdr.msg_iov = &Vectors[Cntr];
+         Messages[Cntr].msg_hdr.msg_iovlen = 1;
+      }
+      Count = recvmmsg(Socket, Messages.data(), (unsigned int)Messages.size(), MSG_DONTWAIT, nullptr);
+      if (Count < 0)
+      {
+         if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+            return 0;
+         throw std::system_error(errno, std::system_category(), "DDC recvmmsg");
+      }
+      Statistics.ReceiveCalls++;
+      NackRanges = 0;
+      for (int Cntr = 0; Cntr < Count; Cntr++)
+         Decode(&Buffers[Cntr * VDDCPACKETSIZE], Messages[Cntr].msg_len);
+      if (NackRanges != 0)
+         SendNack();
+      return PacketCount;
+   }
+
+/**
+ * @brief ask p2app to resend lost packets of this DDC
+ *
+ * @param SDRAddress: IPv4 address of the SDR
+ * @param DDC: the DDC this receiver's port carries
+ * @param NackPort: the SDR's retransmit port
+ * @throws std::system_error if the address is not valid
+ */
+   void EnableRetransmitRequests(const char* SDRAddress, uint8_t DDC, uint16_t NackPort = VRETXDEFAULTPORT)
+   {
+      std::memset(&NackAddr, 0, sizeof(NackAddr));
+      NackAddr.sin_family = AF_INET;
+      NackAddr.sin_port = htons(NackPort);
+      if (inet_pton(AF_INET, SDRAddress, &NackAddr.sin_addr) != 1)
+         throw std::system_error(EINVAL, std::system_category(), "SDR address");
+      NackDDC = DDC;
+      UseNacks = true;
+   }
+
+/**
+ * @brief a packet from the last Receive()
+ */
+   const DDCPacket& operator[](size_t Index) const { return Packets[Index]; }
+   size_t size() const { return PacketCount; }
+   const DDCPacket* begin() const { return Packets.data(); }
+   const DDCPacket* end() const { return Packets.data() + PacketCount; }
+
+   const DDCStatistics& GetStatistics() const { return Statistics; }
+   void ResetStatistics() { Statistics = DDCStatistics(); }
+
+/**
+ * @brief the socket, eg to add to a caller's own poll() set
+ */
+   int GetSocket() const { return Socket; }
+
+private:
+
+//
+// check one packet, and add it to the list handed out. The sequence check allows
+// for wrap; a number before the last one expected is counted as reordered, not lost
+//
+   void Decode(const uint8_t* Data, unsigned int Length)
+   {
+      DDCPacket& Packet = Packets[PacketCount];
+      uint32_t Sequence;
+      uint64_t TimeStamp;
+      uint32_t Bits, Count;
+
+      if (Length < VDDCHEADERSIZE)
+      {
+         Statistics.Invalid++;
+         return;
+      }
+      Bits = (Data[12] << 8) | Data[13];
+      Count = (Data[14] << 8) | Data[15];
+      if (((Bits != 16) && (Bits != 24) && (Bits != 32)) || (Count != ((Bits == 32) ? VIQSAMPLESPERFRAME / 2 : VIQSAMPLESPERFRAME))
+          || (Length != VDDCHEADERSIZE + Count * Bits / 4))
+      {
+         Statistics.Invalid++;                      // (including 16 bit block floating point packets)
+         return;
+      }
+      std::memcpy(&Sequence, Data, sizeof(Sequence));
+      std::memcpy(&TimeStamp, Data + 4, sizeof(TimeStamp));
+      Packet.Sequence = ntohl(Sequence);
+      Packet.TimeStamp = be64toh(TimeStamp);
+      Packet.SampleCount = Count;
+      Packet.BitsPerSample = Bits;
+      Packet.Samples = Data + VDDCHEADERSIZE;
+      if (Statistics.Received != 0)
+      {
+         int32_t Gap = (int32_t)(Packet.Sequence - NextSequence);
+         if (Gap > 0)
+         {
+            Statistics.Lost += (uint32_t)Gap;
+            if (UseNacks && (Gap <= VRETXMAXPACKETS))
+               AddNackRange(NextSequence, (uint32_t)Gap);
+         }
+         else if (Gap < 0)
+         {
+            Statistics.Reordered++;
+            if (Statistics.Lost != 0)
+               Statistics.Lost--;                   // it was counted lost when the gap was seen
+         }
+      }
+      if ((Statistics.Received == 0) || ((int32_t)(Packet.Sequence - NextSequence) >= 0))
+         NextSequence = Packet.Sequence + 1;
+      Statistics.Received++;
+      PacketCount++;
+   }
+
+//
+// add a gap to the NACK being built; sent at the end of Receive()
+//
+   void AddNackRange(uint32_t First, uint32_t Count)
+   {
+      uint8_t* Range = &Nack[VRETXNACKHEADER + 6 * NackRanges];
+      uint32_t Sequence = htonl(First);
+      uint16_t Packets = htons((uint16_t)std::min<uint32_t>(Count, VRETXMAXRESEND));
+
+      if (NackRanges >= VRETXMAXRANGES)
+         return;
+      std::memcpy(Range, &Sequence, sizeof(Sequence));
+      std::memcpy(Range + 4, &Packets, sizeof(Packets));
+      NackRanges++;
+      Statistics.NackedPackets += ntohs(Packets);
+   }
+
+//
+// send the NACK from the DDC socket; a lost NACK is not sent again
+//
+   void SendNack()
+   {
+      uint32_t Sequence = htonl(NackSequence++);
+
+      std::memcpy(Nack, &Sequence, sizeof(Sequence));
+      Nack[4] = NackDDC;
+      Nack[5] = (uint8_t)NackRanges;
+      if (sendto(Socket, Nack, VRETXNACKHEADER + 6 * NackRanges, MSG_DONTWAIT,
+                 (struct sockaddr*)&NackAddr, sizeof(NackAddr)) > 0)
+         Statistics.Nacks++;
+   }
+
+   int Socket = -1;
+   std::vector<uint8_t> Buffers;
+   std::vector<struct mmsghdr> Messages;
+   std::vector<struct iovec> Vectors;
+   std::vector<DDCPacket> Packets;
+   size_t PacketCount = 0;
+   uint32_t NextSequence = 0;
+   DDCStatistics Statistics;
+   bool UseNacks = false;
+   struct sockaddr_in NackAddr;
+   uint8_t NackDDC = 0;
+   uint8_t Nack[VRETXNACKSIZE];
+   uint32_t NackRanges = 0;                         // ranges in the NACK being built
+   uint32_t NackSequence = 0;
+};
+
+} // namespace p2client
@@ -0,0 +1,365 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// p2decode.c:
+//
+// harness for the protocol 2 control packet decoders: the general packet,
+// high priority, DDC specific and DUC specific handlers. They are linked
+// with the register code on the simulated hardware (simhwaccess.c), and
+// the other p2app code they call is stubbed here.
+//
+// "make decodebench" builds p2decode: it times each decoder, in ns per
+// packet, on packets like a client sends. The high priority decoder is
+// timed with nothing changed, one DDC frequency changed (a VFO step), and
+// every field changed, to show what differential decode saves.
+//   ./p2decode                 run and print results
+//   ./p2decode -k hp           run only the cases whose name contains a string
+//
+// "make fuzz" builds p2fuzz with clang's libFuzzer and address sanitiser.
+// The first byte of each input selects the decoder, the rest is the
+// packet, in a full sized receive buffer as the dispatcher passes it.
+//   ./p2fuzz -max_len=1445 -max_total_time=600 corpus/
+//
+//////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <getopt.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "../common/saturntypes.h"
+#include "../common/saturnregisters.h"
+#include "../common/hwaccess.h"
+#include "threaddata.h"
+#include "generalpacket.h"
+#include "InHighPriority.h"
+#include "IncomingDDCSpecific.h"
+#include "IncomingDUCSpecific.h"
+#include "OutDDCIQ.h"
+#include "Outwideband.h"
+#include "AriesATU.h"
+#include "metrics.h"
+#include "standby.h"
+#include "../common/ringlog.h"
+
+
+#define VDECODEREPEATS 15                       // timed runs of each case; the fastest is reported
+#define VDECODEPASSES 2000                      // packets decoded per timed run
+#define VDECODEBUFSIZE 1500                     // receive buffer, as the inbound dispatcher's
+#define VGENERALPACKETSIZE 60
+
+
+//
+// stubs for the p2app code the decoders call
+//
+bool IsTXMode = false;
+bool SDRActive = false;
+bool NewMessageReceived = false;
+bool ReplyAddressSet = false;
+bool StartBitReceived = false;
+bool UseDebug = false;
+bool AriesATUActive = false;
+struct sockaddr_in reply_addr;
+void SetPort(__attribute__((unused)) uint32_t ThreadNum, __attribute__((unused)) uint16_t PortNum) {}
+void SetSDRActive(bool Active) { SDRActive = Active; }
+void SetTXModeState(bool TXMode) { IsTXMode = TXMode; }
+void SetWidebandParams(__attribute__((unused)) uint8_t Enables, __attribute__((unused)) uint16_t SampleCount,
+                       __attribute__((unused)) uint8_t SampleSize, __attribute__((unused)) uint8_t Rate,
+                       __attribute__((unused)) uint8_t PacketCount) {}
+bool RequestDDCRateChange(__attribute__((unused)) uint32_t RateWord) { return true; }
+void HandlerCheckDDCSettings(void) {}
+void SetDDCPacketFormat(__attribute__((unused)) uint8_t Format) {}
+void SetAlignmentTimestamps(__attribute__((unused)) bool Enabled) {}
+void SetMicFrameSize(__attribute__((unused)) uint8_t Multiple) {}
+void SetDDCPacketSamples(__attribute__((unused)) uint16_t Samples) {}
+void SetAriesTXFrequency(__attribute__((unused)) uint32_t NewFreq) {}
+void SetAriesAlexTXWord(__attribute__((unused)) uint16_t Word) {}
+void SetAriesAlexRXWord(__attribute__((unused)) uint16_t Word) {}
+void SetupCATPort(__attribute__((unused)) int Port) {}          // no CAT server: the port is only decoded
+void ShutdownCATHandler(void) {}
+void HandlerSetEERMode(__attribute__((unused)) bool EEREnabled) {}
+void MetricsCountPackets(__attribute__((unused)) EMetricsStream Stream, __attribute__((unused)) uint32_t Packets) {}
+void MetricsCheckSequence(__attribute__((unused)) EMetricsStream Stream, __attribute__((unused)) uint32_t Sequence) {}
+void NoteAttachRequest(__attribute__((unused)) const struct timespec* Arrival) {}
+void RingLogWrite(__attribute__((unused)) const char* Format, __attribute__((unused)) uint32_t Arg1,
+                  __attribute__((unused)) uint32_t Arg2, __attribute__((unused)) uint32_t Arg3, ...) {}
+
+
+//
+// packets, in receive buffers of the dispatcher's size
+//
+static uint8_t GeneralPacket[VDECODEBUFSIZE];
+static uint8_t HPPackets[2][VDECODEBUFSIZE];            // high priority: two that differ in every field
+static uint8_t DDCPacket[VDECODEBUFSIZE];
+static uint8_t DUCPacket[VDECODEBUFSIZE];
+static struct msghdr Header;                            // no control messages: arrival time is "now"
+static uint32_t HPSequence = 0;
+static uint32_t HPFrequency = 7100000;
+
+
+//
+// build the packets a client sends at startup, and two different high priority packets
+//
+static void BuildPackets(void)
+{
+    uint32_t Cntr, Packet;
+
+    *(uint16_t*)(GeneralPacket + 5) = htons(1025);      // ports: DDC specific, DUC specific, high priority...
+    *(uint16_t*)(GeneralPacket + 7) = htons(1026);
+    *(uint16_t*)(GeneralPacket + 9) = htons(1027);
+    *(uint16_t*)(GeneralPacket + 17) = htons(1035);     // DDC0
+    *(uint16_t*)(GeneralPacket + 24) = htons(512);      // wideband samples per packet
+    GeneralPacket[26] = 16;
+    GeneralPacket[27] = 70;
+    GeneralPacket[28] = 32;
+    GeneralPacket[37] = 0x08;                           // frequency, not phase word
+    GeneralPacket[59] = 1;                              // Alex enabled
+
+    DDCPacket[4] = 2;                                   // 2 ADCs
+    *(uint16_t*)(DDCPacket + 7) = 0x0003;               // DDC0 & 1 enabled
+    for (Cntr = 0; Cntr < VNUMDDC; Cntr++)
+    {
+        DDCPacket[Cntr * 6 + 17] = 0;                   // ADC1
+        *(uint16_t*)(DDCPacket + Cntr * 6 + 18) = htons(192);
+        DDCPacket[Cntr * 6 + 22] = 24;
+    }
+
+    DUCPacket[5] = 0x12;                                // CW enabled, sidetone
+    DUCPacket[6] = 64;
+    *(uint16_t*)(DUCPacket + 7) = htons(600);
+    DUCPacket[9] = 20;
+    DUCPacket[10] = 50;
+    DUCPacket[17] = 5;
+
+    for (Packet = 0; Packet < 2; Packet++)
+    {
+        HPPackets[Packet][4] = 1;                       // run
+        for (Cntr = 0; Cntr < VNUMDDC; Cntr++)
+            *(uint32_t*)(HPPackets[Packet] + Cntr * 4 + 9) = htonl(HPFrequency + Cntr * 1000 + Packet * 500);
+        *(uint32_t*)(HPPackets[Packet] + 329) = htonl(HPFrequency + Packet * 500);
+        HPPackets[Packet][345] = (uint8_t)(100 + Packet);
+        HPPackets[Packet][1400] = (uint8_t)Packet;
+        HPPackets[Packet][1401] = (uint8_t)(Packet << 1);
+        HPPackets[Packet][1402] = (uint8_t)Packet;
+        *(uint16_t*)(HPPackets[Packet] + 1430) = htons(0x0001 << Packet);
+        *(uint16_t*)(HPPackets[Packet] + 1434) = htons(0x0002 << Packet);
+        HPPackets[Packet][1442] = (uint8_t)(Packet * 10);
+        HPPackets[Packet][1443] = (uint8_t)(Packet * 10);
+        HPPackets[Packet][5] = (uint8_t)Packet;        // CWX
+    }
+}
+
+
+//
+// the benchmark cases
+//
+static void RunGeneral(void)
+{
+    HandleGeneralPacket(GeneralPacket);
+}
+
+
+static void RunDDCSpecific(void)
+{
+    HandleDDCSpecificPacket(DDCPacket, VDDCSPECIFICSIZE, &Header);
+}
+
+
+static void RunDUCSpecific(void)
+{
+    HandleDUCSpecificPacket(DUCPacket, VDUCSPECIFICSIZE, &Header);
+}
+
+
+//
+// high priority packet as usually received: only the sequence number changes
+//
+static void RunHPUnchanged(void)
+{
+    *(uint32_t*)HPPackets[0] = htonl(HPSequence++);
+    HandleHighPriorityPacket(HPPackets[0], VHIGHPRIOTIYTOSDRSIZE, &Header);
+}
+
+
+//
+// high priority packet while tuning: DDC0 frequency changes each packet
+//
+static void RunHPVFOStep(void)
+{
+    *(uint32_t*)HPPackets[0] = htonl(HPSequence++);
+    *(uint32_t*)(HPPackets[0] + 9) = htonl(HPFrequency + (HPSequence & 0xFF) * 10);
+    HandleHighPriorityPacket(HPPackets[0], VHIGHPRIOTIYTOSDRSIZE, &Header);
+}
+
+
+//
+// high priority packets alternating between two that differ in every field
+//
+static void RunHPAllChanged(void)
+{
+    uint8_t* Packet = HPPackets[HPSequence & 1];
+
+    *(uint32_t*)Packet = htonl(HPSequence++);
+    HandleHighPriorityPacket(Packet, VHIGHPRIOTIYTOSDRSIZE, &Header);
+}
+
+
+struct DecodeCase
+{
+    const char* Name;
+    void (*Run)(void);
+};
+
+static const struct DecodeCase Cases[] =
+{
+    {"general", RunGeneral},
+    {"hp_unchanged", RunHPUnchanged},
+    {"hp_vfo_step", RunHPVFOStep},
+    {"hp_all_changed", RunHPAllChanged},
+    {"ddc_specific", RunDDCSpecific},
+    {"duc_specific", RunDUCSpecific}
+};
+#define VNUMCASES (sizeof(Cases) / sizeof(Cases[0]))
+
+
+static uint64_t GetTimeNs(void)
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &Now);
+    return (uint64_t)Now.tv_sec * 1000000000ULL + (uint64_t)Now.tv_nsec;
+}
+
+
+//
+// time one case: a warm up run, then the fastest of VDECODEREPEATS runs
+//
+static double TimeCase(const struct DecodeCase* Case)
+{
+    uint32_t Repeat, Pass;
+    uint64_t Start, Time;
+    uint64_t Fastest = UINT64_MAX;
+
+    for (Pass = 0; Pass < VDECODEPASSES; Pass++)
+        Case->Run();
+    for (Repeat = 0; Repeat < VDECODEREPEATS; Repeat++)
+    {
+        Start = GetTimeNs();
+        for (Pass = 0; Pass < VDECODEPASSES; Pass++)
+            Case->Run();
+        Time = GetTimeNs() - Start;
+        if (Time < Fastest)
+            Fastest = Time;
+    }
+    return (double)Fastest / VDECODEPASSES;
+}
+
+
+//
+// initialise the register code on the simulated hardware, once
+//
+static void InitialiseDecoders(void)
+{
+    static bool Initialised = false;
+
+    if (Initialised)
+        return;
+    Initialised = true;
+    OpenXDMADriver(true);
+    BuildPackets();
+}
+
+
+#if defined(P2FUZZ)
+//
+// libFuzzer entry: byte 0 selects the decoder; the rest is the packet, at the size received
+// size checks are the decoders' own: a packet of the wrong size must be ignored safely
+//
+int LLVMFuzzerTestOneInput(const uint8_t* Data, size_t Size)
+{
+    static uint8_t FuzzBuffer[VDECODEBUFSIZE];
+    size_t Length;
+
+    InitialiseDecoders();
+    if (Size < 1)
+        return 0;
+    Length = Size - 1;
+    if (Length > VDECODEBUFSIZE)
+        Length = VDECODEBUFSIZE;
+    memset(FuzzBuffer, 0, sizeof(FuzzBuffer));
+    memcpy(FuzzBuffer, Data + 1, Length);
+    switch (Data[0] & 3)
+    {
+    case 0:
+        if (Length >= VGENERALPACKETSIZE)               // as the dispatcher, which takes any size
+            HandleGeneralPacket(FuzzBuffer);
+        break;
+    case 1:
+        HandleHighPriorityPacket(FuzzBuffer, (int)Length, &Header);
+        break;
+    case 2:
+        HandleDDCSpecificPacket(FuzzBuffer, (int)Length, &Header);
+        break;
+    default:
+        HandleDUCSpecificPacket(FuzzBuffer, (int)Length, &Header);
+        break;
+    }
+    return 0;
+}
+
+#else
+int main(int argc, char* argv[])
+{
+    const char* Filter = NULL;
+    double Results[VNUMCASES];
+    uint32_t Cntr;
+    int Option, Stdout_fd;
+
+    while ((Option = getopt(argc, argv, "k:h")) != -1)
+    {
+        switch (Option)
+        {
+        case 'k':
+            Filter = optarg;
+            break;
+        default:
+            printf("usage: p2decode [-k <case name substring>]\n");
+            return EXIT_SUCCESS;
+        }
+    }
+    //
+    // the decoders print as they go: send that to /dev/null while timing
+    //
+    fflush(stdout);
+    Stdout_fd = dup(STDOUT_FILENO);
+    if (freopen("/dev/null", "w", stdout) == NULL)
+        return EXIT_FAILURE;
+    InitialiseDecoders();
+    for (Cntr = 0; Cntr < VNUMCASES; Cntr++)
+    {
+        Results[Cntr] = -1.0;
+        if ((Filter == NULL) || (strstr(Cases[Cntr].Name, Filter) != NULL))
+            Results[Cntr] = TimeCase(&Cases[Cntr]);
+    }
+    fflush(stdout);
+    dup2(Stdout_fd, STDOUT_FILENO);
+    close(Stdout_fd);
+
+    printf("p2decode: control packet decode, ns per packet (fastest of %d runs of %d)\n", VDECODEREPEATS, VDECODEPASSES);
+    for (Cntr = 0; Cntr < VNUMCASES; Cntr++)
+        if (Results[Cntr] >= 0.0)
+            printf("%-20s %10.1f\n", Cases[Cntr].Name, Results[Cntr]);
+    return EXIT_SUCCESS;
+}
+#endif
@@ -0,0 +1,161 @@
+//-----------------------------------------------------------------------------
+// Name: p2recv.cpp
+// Description: DDC receive test client, using p2client.hpp. Receives one DDC
+// stream from p2app, converts every packet to floats, and prints the packet
+// rate, throughput and sequence errors once a second.
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// build with "make client"
+//
+// ./p2recv                       DDC0 on the default port (1035)
+// ./p2recv -p 1036 -t 10         DDC1, for 10 seconds
+// ./p2recv -a 192.168.1.20       bind to one local address
+// ./p2recv -b 64                 recvmmsg() batch size
+// ./p2recv -n                    don't convert the samples (receive only)
+// ./p2recv -r 192.168.1.100      send NACKs for lost packets to the SDR (p2app -N)
+// ./p2recv -p 1036 -r 192.168.1.100 -d 1    the same for DDC1
+//-----------------------------------------------------------------------------
+
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+
+#include "p2client.hpp"
+
+static volatile bool Running = true;
+
+static void HandleSignal(int)
+{
+   Running = false;
+}
+
+static double GetTime()
+{
+   struct timespec Now;
+
+   clock_gettime(CLOCK_MONOTONIC, &Now);
+   return Now.tv_sec + Now.tv_nsec * 1e-9;
+}
+
+static void PrintUsage()
+{
+   printf("usage: p2recv [-p port] [-a bind address] [-b batch] [-t seconds] [-n] [-r SDR address [-d ddc] [-q NACK port]]\n");
+   printf("    -p port      UDP port to receive DDC data on (default 1035, DDC0)\n");
+   printf("    -a address   local address to bind to (default any)\n");
+   printf("    -b batch     most packets per recvmmsg() (default %zu)\n", p2client::DefaultBatch);
+   printf("    -t seconds   stop after this long (default: run until Ctrl-C)\n");
+   printf("    -n           don't convert samples to float\n");
+   printf("    -r address   ask the SDR at this address to resend lost packets (p2app -N)\n");
+   printf("    -d ddc       the DDC the port carries, for -r (default: port - 1035)\n");
+   printf("    -q port      the SDR's NACK port, for -r (default %d)\n", VRETXDEFAULTPORT);
+}
+
+int main(int argc, char* argv[])
+{
+   uint16_t Port = 1035;
+   const char* BindAddress = nullptr;
+   size_t Batch = p2client::DefaultBatch;
+   double RunTime = 0.0;
+   bool Convert = true;
+   const char* SDRAddress = nullptr;
+   int DDC = -1;
+   uint16_t NackPort = VRETXDEFAULTPORT;
+   int Option;
+
+   while ((Option = getopt(argc, argv, "p:a:b:t:nr:d:q:h")) != -1)
+   {
+      switch (Option)
+      {
+      case 'p': Port = (uint16_t)atoi(optarg); break;
+      case 'a': BindAddress = optarg; break;
+      case 'b': Batch = (size_t)atoi(optarg); break;
+      case 't': RunTime = atof(optarg); break;
+      case 'n': Convert = false; break;
+      case 'r': SDRAddress = optarg; break;
+      case 'd': DDC = atoi(optarg); break;
+      case 'q': NackPort = (uint16_t)atoi(optarg); break;
+      default:
+         PrintUsage();
+         return (Option == 'h') ? 0 : 1;
+      }
+   }
+   if (DDC < 0)
+      DDC = Port - 1035;
+   if ((Batch == 0) || ((SDRAddress != nullptr) && ((DDC < 0) || (DDC > UINT8_MAX))))
+   {
+      PrintUsage();
+      return 1;
+   }
+   signal(SIGINT, HandleSignal);
+
+   try
+   {
+      p2client::DDCReceiver Receiver(Port, BindAddress, Batch);
+      if (SDRAddress != nullptr)
+         Receiver.EnableRetransmitRequests(SDRAddress, (uint8_t)DDC, NackPort);
+      std::vector<std::complex<float>> IQ(VIQSAMPLESPERFRAME);
+      double Start = GetTime();
+      double ReportTime = Start;
+      uint64_t LastReceived = 0;
+      uint64_t Samples = 0;                           // since the last report
+      uint64_t Bytes = 0;
+      double Sum = 0.0;
+
+      printf("receiving DDC data on port %u, %s\n", Port,
+#if defined(__ARM_NEON)
+             "NEON conversion");
+#else
+             "scalar conversion");
+#endif
+      while (Running && ((RunTime == 0.0) || (GetTime() - Start < RunTime)))
+      {
+         size_t Count = Receiver.Receive(100);
+         for (size_t Cntr = 0; Cntr < Count; Cntr++)
+         {
+            const p2client::DDCPacket& Packet = Receiver[Cntr];
+            Samples += Packet.SampleCount;
+            Bytes += VDDCHEADERSIZE + Packet.SampleCount * Packet.BitsPerSample / 4;
+            if (Convert)
+            {
+               p2client::ConvertSamples(IQ.data(), Packet);
+               Sum += IQ[0].real();                  // so the conversion isn't optimised away
+            }
+         }
+         double Now = GetTime();
+         if (Now - ReportTime >= 1.0)
+         {
+            const p2client::DDCStatistics& Stats = Receiver.GetStatistics();
+            double Interval = Now - ReportTime;
+            printf("%.0f packets/s, %.1f Mbit/s, %.0f samples/s; lost %llu reordered %llu invalid %llu; %.1f packets per call",
+                   (Stats.Received - LastReceived) / Interval, Bytes * 8e-6 / Interval, Samples / Interval,
+                   (unsigned long long)Stats.Lost, (unsigned long long)Stats.Reordered,
+                   (unsigned long long)Stats.Invalid,
+                   Stats.ReceiveCalls ? (double)Stats.Received / Stats.ReceiveCalls : 0.0);
+            if (SDRAddress != nullptr)
+               printf("; NACKs %llu for %llu packets", (unsigned long long)Stats.Nacks,
+                      (unsigned long long)Stats.NackedPackets);
+            printf("\n");
+            LastReceived = Stats.Received;
+            Samples = 0;
+            Bytes = 0;
+            ReportTime = Now;
+         }
+      }
+      const p2client::DDCStatistics& Stats = Receiver.GetStatistics();
+      printf("received %llu packets; lost %llu reordered %llu invalid %llu (%g)\n",
+             (unsigned long long)Stats.Received, (unsigned long long)Stats.Lost,
+             (unsigned long long)Stats.Reordered, (unsigned long long)Stats.Invalid, Sum);
+   }
+   catch (const std::exception& ex)
+   {
+      fprintf(stderr, "p2recv: %s\n", ex.what());
+      return 1;
+   }
+   return 0;
+}
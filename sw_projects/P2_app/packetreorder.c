@@ -0,0 +1,261 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// packetreorder.c:
+//
+// sequence number reorder buffer and loss concealment for incoming packets
+//
+//////////////////////////////////////////////////////////////
+
+#include "packetreorder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+struct ReorderSettings DUCReorderSettings = { 0, eReorderZeroFill };
+struct ReorderSettings SpkReorderSettings = { 0, eReorderZeroFill };
+
+
+//
+// parse <depth>[:zero|repeat] into Settings
+//
+static bool ParseReorderSpec(const char* Spec, struct ReorderSettings* Settings, const char* Name)
+{
+    uint32_t Depth;
+    char Policy[16] = "zero";
+    int Fields;
+
+    Fields = sscanf(Spec, "%u:%15s", &Depth, Policy);
+    if((Fields < 1) || (Depth > VREORDERMAXDEPTH) || (strcmp(Policy, "zero") && strcmp(Policy, "repeat")))
+    {
+        printf("bad %s reorder setting %s: use <depth>[:zero|repeat], depth 0 to %d\n", Name, Spec, VREORDERMAXDEPTH);
+        return false;
+    }
+    Settings->Depth = Depth;
+    Settings->Policy = strcmp(Policy, "repeat") ? eReorderZeroFill : eReorderRepeatLast;
+    if(Depth != 0)
+        printf("%s reorder buffer: %u packets, missing packets %s\n", Name, Depth,
+               (Settings->Policy == eReorderZeroFill) ? "zero filled" : "repeat the last");
+    return true;
+}
+
+
+bool SetDUCReorder(const char* Spec)
+{
+    return ParseReorderSpec(Spec, &DUCReorderSettings, "DUC I/Q");
+}
+
+
+bool SetSpkReorder(const char* Spec)
+{
+    return ParseReorderSpec(Spec, &SpkReorderSettings, "speaker");
+}
+
+
+bool SetReorder(const char* Spec)
+{
+    return SetDUCReorder(Spec) && SetSpkReorder(Spec);
+}
+
+
+//
+// bool InitialiseReorder(...)
+// allocate the slots, and start with no sequence
+//
+bool InitialiseReorder(struct PacketReorder* Reorder, const struct ReorderSettings* Settings,
+                       uint32_t PayloadBytes, uint32_t PacketPeriod, EMetricsStream Stream,
+                       TReorderRelease Release, void* Context)
+{
+    memset(Reorder, 0, sizeof(struct PacketReorder));
+    if(Settings->Depth == 0)
+        return false;
+    Reorder->Slots = calloc(Settings->Depth, PayloadBytes);
+    Reorder->SlotSequence = calloc(Settings->Depth, sizeof(uint32_t));
+    Reorder->SlotFull = calloc(Settings->Depth, sizeof(bool));
+    Reorder->Concealment = calloc(1, PayloadBytes);
+    if(!Reorder->Slots || !Reorder->SlotSequence || !Reorder->SlotFull || !Reorder->Concealment)
+    {
+        printf("reorder buffer allocation failed: not used\n");
+        free(Reorder->Slots);
+        free(Reorder->SlotSequence);
+        free(Reorder->SlotFull);
+        free(Reorder->Concealment);
+        memset(Reorder, 0, sizeof(struct PacketReorder));
+        return false;
+    }
+    MetricsAddBufferBytes(Stream, (int64_t)(Settings->Depth + 1) * PayloadBytes);
+    Reorder->Depth = Settings->Depth;
+    Reorder->Policy = Settings->Policy;
+    Reorder->PayloadBytes = PayloadBytes;
+    Reorder->MaxWait = Settings->Depth * PacketPeriod;
+    Reorder->Stream = Stream;
+    Reorder->Release = Release;
+    Reorder->Context = Context;
+    return true;
+}
+
+
+//
+// pass a payload on; for repeat-last, keep a copy to repeat
+//
+static void ReleasePayload(struct PacketReorder* Reorder, const uint8_t* Payload)
+{
+    Reorder->Release(Payload, Reorder->Context);
+    if((Reorder->Policy == eReorderRepeatLast) && (Payload != Reorder->Concealment))
+        memcpy(Reorder->Concealment, Payload, Reorder->PayloadBytes);
+}
+
+
+//
+// release the next packet in sequence: held, or concealed if missing
+//
+static void AdvanceReorder(struct PacketReorder* Reorder)
+{
+    uint32_t Slot = Reorder->NextSequence % Reorder->Depth;
+
+    if(Reorder->SlotFull[Slot] && (Reorder->SlotSequence[Slot] == Reorder->NextSequence))
+    {
+        Reorder->SlotFull[Slot] = false;
+        Reorder->Held--;
+        ReleasePayload(Reorder, Reorder->Slots + Slot * Reorder->PayloadBytes);
+    }
+    else
+    {
+        MetricsCountLost(Reorder->Stream);
+        ReleasePayload(Reorder, Reorder->Concealment);
+    }
+    Reorder->NextSequence++;
+}
+
+
+//
+// release held packets that are now in sequence.
+// if any are still held after a gap, they wait from now.
+//
+static void DrainReorder(struct PacketReorder* Reorder)
+{
+    uint32_t Slot;
+    bool Released = false;
+
+    while(Reorder->Held != 0)
+    {
+        Slot = Reorder->NextSequence % Reorder->Depth;
+        if(!Reorder->SlotFull[Slot] || (Reorder->SlotSequence[Slot] != Reorder->NextSequence))
+            break;
+        AdvanceReorder(Reorder);
+        Released = true;
+    }
+    if(Released && (Reorder->Held != 0))
+        clock_gettime(CLOCK_MONOTONIC, &Reorder->HeldSince);
+}
+
+
+//
+// restart the sequence at Sequence: held packets are released in order, with no concealment
+//
+static void ResyncReorder(struct PacketReorder* Reorder, uint32_t Sequence)
+{
+    uint32_t Slot;
+
+    while(Reorder->Held != 0)
+    {
+        Slot = Reorder->NextSequence % Reorder->Depth;
+        if(Reorder->SlotFull[Slot] && (Reorder->SlotSequence[Slot] == Reorder->NextSequence))
+        {
+            Reorder->SlotFull[Slot] = false;
+            Reorder->Held--;
+            ReleasePayload(Reorder, Reorder->Slots + Slot * Reorder->PayloadBytes);
+        }
+        Reorder->NextSequence++;
+    }
+    Reorder->NextSequence = Sequence;
+    Reorder->SequenceValid = true;
+}
+
+
+//
+// void ReorderPacket(struct PacketReorder* Reorder, uint32_t Sequence, const uint8_t* Payload)
+// add a received packet
+//
+void ReorderPacket(struct PacketReorder* Reorder, uint32_t Sequence, const uint8_t* Payload)
+{
+    int32_t Offset;
+    uint32_t Slot;
+
+    Offset = (int32_t)(Sequence - Reorder->NextSequence);
+    if(!Reorder->SequenceValid || (Sequence == 0)
+       || (Offset < -VREORDERRESYNC) || (Offset > (int32_t)Reorder->Depth + VREORDERRESYNC))
+    {
+        ResyncReorder(Reorder, Sequence);
+        Offset = 0;
+    }
+    //
+    // ahead of a missing packet, and beyond the buffer: conceal (and release any held
+    // packets that come into sequence) until it fits
+    //
+    while(Offset > (int32_t)Reorder->Depth)
+    {
+        AdvanceReorder(Reorder);
+        DrainReorder(Reorder);
+        Offset = (int32_t)(Sequence - Reorder->NextSequence);
+    }
+    if(Offset < 0)
+    {
+        MetricsCountLate(Reorder->Stream);                  // already concealed, or a repeat
+        return;
+    }
+    if(Offset == 0)
+    {
+        if(Reorder->Held != 0)
+            MetricsCountReordered(Reorder->Stream);         // the missing packet, arrived late
+        ReleasePayload(Reorder, Payload);
+        Reorder->NextSequence++;
+        DrainReorder(Reorder);
+        return;
+    }
+    //
+    // ahead of a missing packet: hold it
+    //
+    Slot = Sequence % Reorder->Depth;
+    if(Reorder->SlotFull[Slot])
+    {
+        MetricsCountLate(Reorder->Stream);                  // a repeat of one already held
+        return;
+    }
+    memcpy(Reorder->Slots + Slot * Reorder->PayloadBytes, Payload, Reorder->PayloadBytes);
+    Reorder->SlotSequence[Slot] = Sequence;
+    Reorder->SlotFull[Slot] = true;
+    if(Reorder->Held++ == 0)
+        clock_gettime(CLOCK_MONOTONIC, &Reorder->HeldSince);
+    DrainReorder(Reorder);
+}
+
+
+//
+// void ServiceReorder(struct PacketReorder* Reorder)
+// release held packets that have waited too long, concealing the missing ones
+//
+void ServiceReorder(struct PacketReorder* Reorder)
+{
+    struct timespec Now;
+    int64_t Waited;
+
+    if(Reorder->Held == 0)
+        return;
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    Waited = (int64_t)(Now.tv_sec - Reorder->HeldSince.tv_sec) * 1000000 + (Now.tv_nsec - Reorder->HeldSince.tv_nsec) / 1000;
+    if(Waited < Reorder->MaxWait)
+        return;
+    while(Reorder->Held != 0)
+    {
+        AdvanceReorder(Reorder);
+        DrainReorder(Reorder);
+    }
+}
@@ -0,0 +1,126 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// packetreorder.h:
+//
+// header: sequence number reorder buffer for incoming packets (DUC I/Q, speaker audio)
+// packets in sequence are passed straight on, without a copy. A packet that
+// arrives ahead of a missing one is copied into the buffer, and released when
+// the missing packet arrives. If it doesn't arrive before the buffer is full, or
+// within Depth packet periods, it is concealed: a packet of zeros, or a repeat
+// of the last packet, is released in its place. A packet that arrives after it
+// has been concealed is discarded as late.
+// counts of reordered, lost (concealed) and late packets are in the metrics.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __packetreorder_h
+#define __packetreorder_h
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "metrics.h"
+
+
+#define VREORDERMAXDEPTH 16                     // most packets held waiting for a missing one
+#define VREORDERRESYNC 64                       // a sequence jump bigger than this restarts the sequence
+
+
+typedef enum
+{
+    eReorderZeroFill,                           // a missing packet is replaced by zeros
+    eReorderRepeatLast                          // a missing packet is replaced by the one before
+} EReorderPolicy;
+
+
+//
+// settings for a stream: Depth = 0 if the reorder buffer is not used
+//
+struct ReorderSettings
+{
+    uint32_t Depth;
+    EReorderPolicy Policy;
+};
+
+extern struct ReorderSettings DUCReorderSettings;
+extern struct ReorderSettings SpkReorderSettings;
+
+
+//
+// called for each packet payload released, in sequence order
+//
+typedef void (*TReorderRelease)(const uint8_t* Payload, void* Context);
+
+
+//
+// the reorder buffer for one stream. Used by the stream's receiving thread only.
+//
+struct PacketReorder
+{
+    uint32_t Depth;                             // 0 = not in use
+    EReorderPolicy Policy;
+    uint32_t PayloadBytes;
+    uint32_t MaxWait;                           // us a packet is held waiting for a missing one
+    EMetricsStream Stream;
+    TReorderRelease Release;
+    void* Context;
+    uint8_t* Slots;                             // Depth payloads, indexed by sequence % Depth
+    uint32_t* SlotSequence;
+    bool* SlotFull;
+    uint8_t* Concealment;                       // payload released for a missing packet
+    uint32_t NextSequence;                      // sequence number to release next
+    bool SequenceValid;
+    uint32_t Held;                              // packets in the slots
+    struct timespec HeldSince;                  // time the oldest held packet started waiting
+};
+
+
+//
+// bool SetDUCReorder(const char* Spec), SetSpkReorder(const char* Spec), SetReorder(const char* Spec)
+// set the DUC I/Q, speaker, or both reorder buffers from a command line or config file string
+// format: <depth>[:zero|repeat]   eg 4:repeat. Depth 0 turns it off.
+// returns true if successful
+//
+bool SetDUCReorder(const char* Spec);
+bool SetSpkReorder(const char* Spec);
+bool SetReorder(const char* Spec);
+
+
+//
+// bool InitialiseReorder(struct PacketReorder* Reorder, const struct ReorderSettings* Settings,
+//                        uint32_t PayloadBytes, uint32_t PacketPeriod, EMetricsStream Stream,
+//                        TReorderRelease Release, void* Context)
+// set up a reorder buffer. PacketPeriod is the stream's packet interval in us.
+// returns false if it is not used (Depth = 0), or can't be allocated; Reorder->Depth is then 0
+//
+bool InitialiseReorder(struct PacketReorder* Reorder, const struct ReorderSettings* Settings,
+                       uint32_t PayloadBytes, uint32_t PacketPeriod, EMetricsStream Stream,
+                       TReorderRelease Release, void* Context);
+
+
+//
+// void ReorderPacket(struct PacketReorder* Reorder, uint32_t Sequence, const uint8_t* Payload)
+// add a received packet. Release() is called for it, and any packets it lets go, before returning;
+// Payload itself is only used during the call.
+// sequence 0, or a big jump, restarts the sequence
+//
+void ReorderPacket(struct PacketReorder* Reorder, uint32_t Sequence, const uint8_t* Payload);
+
+
+//
+// void ServiceReorder(struct PacketReorder* Reorder)
+// call each time round the receive loop (including read timeouts): if packets have
+// been held for too long, conceal the missing ones and release them
+//
+void ServiceReorder(struct PacketReorder* Reorder);
+
+
+#endif
@@ -0,0 +1,84 @@
+#!/bin/bash
+#
+# profile guided optimisation workloads for p2app, run by "make pgo"
+#   ./pgo.sh baseline   time the default build: p2bench, and the simulator soak CPU per DDC sample
+#   ./pgo.sh train      run the instrumented build on the training workloads
+#   ./pgo.sh report     time the optimised build the same way, and write pgo-report.txt
+#
+# the training workloads are:
+#   the p2bench hot kernels
+#   DDC soak tests of several DDC mixes, on the simulated hardware
+#   a DDC capture replayed as fast as it can be read, if PGOCAPTURE names one (from p2app -y)
+#   synthetic client traffic from p2trafficgen: high priority, DUC I/Q and speaker audio
+# PGOTIME sets the seconds each runs for (default 20).
+#
+PGOTIME=${PGOTIME:-20}
+TRAFFICGEN=../../sw_tools/p2trafficgen
+SOAKMIXES="10x192 2x1536 4x48,4x192,2x384"
+
+#
+# soak test the simulator with one DDC mix; prints its throughput reports
+#
+soak()
+{
+    timeout -s INT $(($1 + 2)) ./p2app-sim -s -S $2 2>/dev/null | grep "^simulator:"
+}
+
+#
+# time a build: p2bench, and the simulator CPU time per DDC sample for 10x192KHz
+#
+timebuild()
+{
+    echo "p2bench:"
+    ./p2bench $1
+    echo
+    echo "simulator, DDC soak test 10x192KHz:"
+    soak 30 10x192
+}
+
+case "$1" in
+baseline)
+    timebuild "-w pgo-baseline.txt" > pgo-default.txt
+    ;;
+
+train)
+    ./p2bench > /dev/null
+    for MIX in $SOAKMIXES
+    do
+        echo "training: DDC soak test $MIX"
+        soak $PGOTIME $MIX > /dev/null
+    done
+    if [ -n "$PGOCAPTURE" ]; then
+        echo "training: replaying DDC capture $PGOCAPTURE"
+        SATURNSIM_DDCFILE=$PGOCAPTURE SATURNSIM_REPLAY=max timeout -s INT $PGOTIME ./p2app-sim -s > /dev/null 2>&1
+    fi
+    make -s -C $TRAFFICGEN
+    echo "training: synthetic client traffic"
+    ./p2app-sim -s -n 9100 > /dev/null 2>&1 &
+    SIMPID=$!
+    sleep 2
+    $TRAFFICGEN/p2trafficgen -a 127.0.0.1 -t $PGOTIME -m 9100 > /dev/null
+    kill -INT $SIMPID
+    wait $SIMPID
+    ;;
+
+report)
+    timebuild "-c pgo-baseline.txt -t 1000" > pgo-optimised.txt
+    {
+        echo "p2app PGO + LTO build report, $(date)"
+        echo "optimised flags: $2"
+        echo
+        echo "=== default build ==="
+        cat pgo-default.txt
+        echo
+        echo "=== optimised build (p2bench compared with the default build) ==="
+        cat pgo-optimised.txt
+    } > pgo-report.txt
+    cat pgo-report.txt
+    ;;
+
+*)
+    echo "usage: $0 baseline|train|report"
+    exit 1
+    ;;
+esac
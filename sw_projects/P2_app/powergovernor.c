@@ -0,0 +1,194 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// powergovernor.c:
+//
+// CPU performance governor tied to SDRActive, and temperature monitor
+//
+//////////////////////////////////////////////////////////////
+
+#include "powergovernor.h"
+#include "threaddata.h"
+#include "threadmanager.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "../common/auxadc.h"
+
+
+#define VCPUFREQPATH "/sys/devices/system/cpu/cpufreq/policy%d/scaling_governor"
+#define VCPUTHERMALPATH "/sys/class/thermal/thermal_zone0/temp"
+#define VCPUDMALATENCY "/dev/cpu_dma_latency"
+
+
+static char SavedGovernors[VMAXCPUPOLICIES][VGOVERNORNAMESIZE];  // as found; empty if no policy
+static int LatencyRequest_fd = -1;              // open while the latency request is held
+static bool GovernorApplied = false;
+static bool GovernorStopped = false;
+static pthread_mutex_t GovernorMutex = PTHREAD_MUTEX_INITIALIZER;
+static struct GovernorStatus Status;            // written under GovernorMutex
+
+
+//
+// read or write one line of a sysfs file; return true if successful
+//
+static bool ReadSysfsLine(const char* Path, char* Line, size_t Length)
+{
+    FILE* File;
+    bool Result;
+
+    File = fopen(Path, "r");
+    if (File == NULL)
+        return false;
+    Result = (fgets(Line, Length, File) != NULL);
+    fclose(File);
+    if (Result)
+        Line[strcspn(Line, "\n")] = 0;
+    return Result;
+}
+
+
+static bool WriteSysfsLine(const char* Path, const char* Line)
+{
+    FILE* File;
+    bool Result;
+
+    File = fopen(Path, "w");
+    if (File == NULL)
+        return false;
+    Result = (fputs(Line, File) >= 0);
+    if (fclose(File) != 0)
+        Result = false;
+    return Result;
+}
+
+
+//
+// performance settings on or off (GovernorMutex held)
+// the governors found are saved, so the ones set back are the user's, not a default
+//
+static void ApplyPerformance(bool Performance)
+{
+    char Path[128];
+    int32_t Latency = 0;
+    uint32_t Policy;
+    uint32_t Changed = 0;
+
+    if (Performance == GovernorApplied)
+        return;
+    for (Policy = 0; Policy < VMAXCPUPOLICIES; Policy++)
+    {
+        snprintf(Path, sizeof(Path), VCPUFREQPATH, Policy);
+        if (Performance)
+        {
+            SavedGovernors[Policy][0] = 0;
+            if (!ReadSysfsLine(Path, SavedGovernors[Policy], VGOVERNORNAMESIZE))
+                continue;
+            if (WriteSysfsLine(Path, "performance"))
+                Changed++;
+        }
+        else if ((SavedGovernors[Policy][0] != 0) && WriteSysfsLine(Path, SavedGovernors[Policy]))
+            Changed++;
+    }
+    if (Performance)
+    {
+        LatencyRequest_fd = open(VCPUDMALATENCY, O_WRONLY);
+        if ((LatencyRequest_fd >= 0) && (write(LatencyRequest_fd, &Latency, sizeof(Latency)) != sizeof(Latency)))
+        {
+            close(LatencyRequest_fd);
+            LatencyRequest_fd = -1;
+        }
+    }
+    else if (LatencyRequest_fd >= 0)
+    {
+        close(LatencyRequest_fd);                   // closing ends the request
+        LatencyRequest_fd = -1;
+    }
+    printf("CPU governor: %s, %d cpufreq policies changed, C-state latency request %s\n",
+           Performance ? "performance" : "restored", Changed,
+           (LatencyRequest_fd >= 0) ? "held" : "not held");
+    GovernorApplied = Performance;
+    Status.Performance = Performance;
+}
+
+
+//
+// read the temperatures
+//
+static void ReadTemperatures(void)
+{
+    char Line[32];
+    int32_t CPUTemperature = 0;
+    int32_t FPGATemperature;
+
+    FPGATemperature = (int32_t)(ReadFPGATemperature() * 1000.0f);
+    if (ReadSysfsLine(VCPUTHERMALPATH, Line, sizeof(Line)))
+        sscanf(Line, "%d", &CPUTemperature);
+    pthread_mutex_lock(&GovernorMutex);
+    Status.FPGATemperature = FPGATemperature;
+    Status.CPUTemperature = CPUTemperature;
+    Status.Valid = true;
+    pthread_mutex_unlock(&GovernorMutex);
+    if (UseDebug)
+        printf("temperature: FPGA %.1fC, CPU %.1fC\n", FPGATemperature / 1000.0, CPUTemperature / 1000.0);
+}
+
+
+//
+// governor thread: follow SDRActive, woken by the thread control channel;
+// read the temperatures every period
+//
+static void* PowerGovernorThread(void* arg)
+{
+    bool Control = (bool)(intptr_t)arg;
+    uint32_t StateCount;
+    bool Active;
+
+    StateCount = GetThreadStateCount();
+    while (true)
+    {
+        Active = __atomic_load_n(&SDRActive, __ATOMIC_ACQUIRE);
+        if (Control)
+        {
+            pthread_mutex_lock(&GovernorMutex);
+            if (!GovernorStopped)
+                ApplyPerformance(Active);
+            pthread_mutex_unlock(&GovernorMutex);
+        }
+        if (!WaitThreadStateChangeTimed(&StateCount, VGOVERNORPERIOD))
+            ReadTemperatures();
+    }
+    return NULL;
+}
+
+
+bool StartPowerGovernor(bool Control)
+{
+    ReadTemperatures();
+    return CreateManagedThread(NULL, "power governor", eHousekeepingThread, PowerGovernorThread, (void*)(intptr_t)Control);
+}
+
+
+void StopPowerGovernor(void)
+{
+    pthread_mutex_lock(&GovernorMutex);
+    GovernorStopped = true;
+    ApplyPerformance(false);
+    pthread_mutex_unlock(&GovernorMutex);
+}
+
+
+void GetGovernorStatus(struct GovernorStatus* Snapshot)
+{
+    pthread_mutex_lock(&GovernorMutex);
+    *Snapshot = Status;
+    pthread_mutex_unlock(&GovernorMutex);
+}
@@ -0,0 +1,70 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// powergovernor.h:
+//
+// header: CPU performance governor tied to SDRActive, and temperature monitor
+// while the SDR is active the cpufreq governor of every CPU policy is set to
+// "performance", and a 0us latency request is held open on /dev/cpu_dma_latency
+// so idle CPUs don't drop into deep C-states; when the SDR goes idle the
+// governors go back to what they were, and the request is closed. Both need
+// root; without it the governor only monitors.
+// the FPGA die and CPU temperatures are read every VGOVERNORPERIOD, for the
+// metrics endpoint, and printed with debug on.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __powergovernor_h
+#define __powergovernor_h
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#define VGOVERNORPERIOD 5000                    // ms between temperature readings
+#define VMAXCPUPOLICIES 8                       // cpufreq policies looked for
+#define VGOVERNORNAMESIZE 32                    // longest governor name kept
+
+
+//
+// temperatures in millidegrees C, and whether the performance settings are applied
+//
+struct GovernorStatus
+{
+    bool Valid;                                 // false until the 1st reading
+    bool Performance;                           // performance settings applied
+    int32_t FPGATemperature;                    // FPGA die (XADC)
+    int32_t CPUTemperature;                     // CPU thermal zone 0
+};
+
+
+//
+// bool StartPowerGovernor(bool Control)
+// start the governor thread. If Control is false the thread only reads the temperatures.
+// returns false if the thread could not be started
+//
+bool StartPowerGovernor(bool Control);
+
+
+//
+// void StopPowerGovernor(void)
+// put the CPU settings back to how they were found. Call at shutdown.
+//
+void StopPowerGovernor(void);
+
+
+//
+// void GetGovernorStatus(struct GovernorStatus* Status)
+// the latest temperatures and state
+//
+void GetGovernorStatus(struct GovernorStatus* Status);
+
+
+#endif
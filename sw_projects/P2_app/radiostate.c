@@ -0,0 +1,80 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// radiostate.c:
+//
+// seqlock published radio state snapshot
+// the sequence count is odd while an update is in progress. A reader copies
+// the state between two reads of the count, and tries again if the count was
+// odd or has moved: so it never sees a half updated state, and never waits
+// for more than the time of one update.
+//
+//////////////////////////////////////////////////////////////
+
+#include "radiostate.h"
+#include "threaddata.h"
+#include <string.h>
+#include <pthread.h>
+
+
+static struct RadioState LiveRadioState;
+static uint32_t RadioStateSequence __attribute__((aligned(VCACHELINESIZE))) = 2;   // even: no update in progress
+static pthread_mutex_t RadioStateMutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+//
+// get the state to change: the sequence count goes odd before any field changes
+//
+struct RadioState* BeginRadioStateUpdate(void)
+{
+    pthread_mutex_lock(&RadioStateMutex);
+    __atomic_store_n(&RadioStateSequence, RadioStateSequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);                // count seen odd before any changed field
+    return &LiveRadioState;
+}
+
+
+//
+// publish the changes: the sequence count goes even again after all have been made
+//
+void EndRadioStateUpdate(void)
+{
+    __atomic_store_n(&RadioStateSequence, RadioStateSequence + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&RadioStateMutex);
+}
+
+
+//
+// take a consistent copy of the state
+//
+uint32_t ReadRadioState(struct RadioState* Snapshot)
+{
+    uint32_t Before, After;
+
+    do
+    {
+        Before = __atomic_load_n(&RadioStateSequence, __ATOMIC_ACQUIRE);
+        memcpy(Snapshot, &LiveRadioState, sizeof(*Snapshot));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);            // copy complete before the count is read again
+        After = __atomic_load_n(&RadioStateSequence, __ATOMIC_RELAXED);
+    } while ((Before & 1) || (Before != After));
+    return Before;
+}
+
+
+//
+// copy the state only if it has been updated since the last copy
+//
+bool RefreshRadioState(struct RadioState* Snapshot, uint32_t* Version)
+{
+    if (__atomic_load_n(&RadioStateSequence, __ATOMIC_RELAXED) == *Version)
+        return false;
+    *Version = ReadRadioState(Snapshot);
+    return true;
+}
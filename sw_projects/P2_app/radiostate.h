@@ -0,0 +1,71 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// radiostate.h:
+//
+// header: radio state snapshot for the data plane threads
+// the settings control packets change, that the stream threads act on, are
+// kept in one struct published with a seqlock. The control threads change
+// it between BeginRadioStateUpdate() and EndRadioStateUpdate() (one writer
+// at a time); a data thread takes a consistent copy, without a lock, with
+// ReadRadioState() - or RefreshRadioState() once per loop pass, which only
+// copies if there has been an update since its last copy.
+// the separate globals (SDRActive, IsTXMode, reply_addr, ReplyAddressSet)
+// are still set too.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __radiostate_h
+#define __radiostate_h
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <netinet/in.h>
+
+
+struct RadioState
+{
+    bool SDRActive;                             // as SDRActive
+    bool TXMode;                                // as IsTXMode
+    bool ReplyAddressSet;                       // as ReplyAddressSet: ReplyAddr is valid
+    struct sockaddr_in ReplyAddr;               // client address for outgoing data (each thread sets its own port)
+    uint8_t WBEnables;                          // wideband: enable bits for ADC1 (bit0) & 2 (bit1)
+    uint16_t WBSamplesPerPacket;                // wideband: samples per packet
+    uint8_t WBSampleSize;                       // wideband: sample resolution in bits (typ 16)
+    uint8_t WBRate;                             // wideband: update rate in ms
+    uint8_t WBPacketCount;                      // wideband: packets per frame
+    uint32_t WBParamsVersion;                   // incremented when any wideband setting changes
+};
+
+
+//
+// control threads: get the state to change, then publish the changes
+// writers are serialised; no other lock may be taken in between
+//
+struct RadioState* BeginRadioStateUpdate(void);
+void EndRadioStateUpdate(void);
+
+
+//
+// uint32_t ReadRadioState(struct RadioState* Snapshot)
+// take a consistent copy of the state; returns its version
+//
+uint32_t ReadRadioState(struct RadioState* Snapshot);
+
+
+//
+// bool RefreshRadioState(struct RadioState* Snapshot, uint32_t* Version)
+// copy the state if it has changed since Version; start with Version = 0
+// returns true if a new copy was taken
+//
+bool RefreshRadioState(struct RadioState* Snapshot, uint32_t* Version);
+
+
+#endif
@@ -12,7 +12,7 @@
 //
 // handle simple CAT access to serial port
 // CAT messages are forwarded to CAT handler
-// port is opened and read performed by creating a thread
+// ports are opened, then read by a single I/O thread for all devices
 //
 //////////////////////////////////////////////////////////////
 
@@ -25,10 +25,15 @@
 #include <stdio.h>
 #include <pthread.h>
 #include <syscall.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 
 
 #include "serialport.h"
 #include "cathandler.h"
+#include "threadmanager.h"
 
 
 //
@@ -51,7 +56,7 @@ int OpenSerialPort(char* DeviceName, unsigned int Baud)
     int Device;
     struct termios Ser;
 
-    Device = open(DeviceName, O_RDWR);
+    Device = open(DeviceName, O_RDWR | O_NONBLOCK | O_NOCTTY);
     if(Device == -1)
     {
         printf("serial open failed on device %s\n", DeviceName);
@@ -63,8 +68,8 @@ int OpenSerialPort(char* DeviceName, unsigned int Baud)
         Ser.c_cflag = CS8 | CREAD | HUPCL | CLOCAL;
         cfsetospeed(&Ser, Baud);
         cfsetispeed(&Ser, Baud);
-        Ser.c_cc[VTIME] = 5;                // 0.5s timeout on read
-        Ser.c_cc[VMIN] = 0;                 // read can return wioth no characters
+        Ser.c_cc[VTIME] = 0;                // no read timeout: the I/O thread waits in epoll
+        Ser.c_cc[VMIN] = 1;                 // readable as soon as a character arrives
 
         if (tcsetattr(Device, TCSANOW, &Ser) < 0) 
         {
@@ -92,84 +97,266 @@ void SendStringToSerial(int Device, char* Message)
 
 
 
-#define VESERINSIZE 120                 // large enough to hold a whole CAT message
 //
-// serial read thread
-// the paramter passed is a pointer to a struct with the required settings
+// all the serial CAT devices are served by one I/O thread. It sleeps in epoll_wait()
+// until characters arrive on any device, reads them in bulk straight into that
+// device's message buffer, and splits off each complete (semicolon terminated) message.
 //
-void* CATSerial(void *arg)
+#define VMAXSERIALDEVICES 4             // most serial CAT devices served
+#define VSERIALIDDELAY 1000             // ms after open before sending ZZZS (particularly for USB)
+#define VSEREVENTWAKE 0xFFFFFFFF        // epoll identifier for the wake event
+#define VSEREVENTTIMER 0x80000000       // set in the epoll identifier of a device's ID timer
+
+static TSerialThreadData* SerialDevices[VMAXSERIALDEVICES];
+static uint32_t SerialDeviceCount = 0;
+static int SerialEpoll_fd = -1;
+static int SerialWake_fd = -1;                  // eventfd: written when a device is removed
+static pthread_t SerialIOThread;
+static pthread_mutex_t SerialDeviceMutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+//
+// close a device and remove it from the epoll set
+//
+static void CloseSerialCATDevice(TSerialThreadData* DeviceData)
 {
-    char SerialInputBuffer[VESERINSIZE];
-    char CATMessageBuffer[VESERINSIZE];
-    int ReadCnt;
-    int Cntr;
-    int CATWritePtr = 0;
-    char ch;                                    // individual read character
-    int MatchPositionZZZS;
-    int MatchPositionZZZP;
+    printf("Closing CAT Serial handler for device %s\n", DeviceNames[(int)DeviceData->Device]);
+    DeviceData -> DeviceActive = false;
+    DeviceData -> IsOpen = false;
+    epoll_ctl(SerialEpoll_fd, EPOLL_CTL_DEL, DeviceData -> DeviceHandle, NULL);
+    close(DeviceData -> DeviceHandle);
+    if(DeviceData -> Timer_fd >= 0)
+        close(DeviceData -> Timer_fd);
+    DeviceData -> Timer_fd = -1;
+}
 
-    TSerialThreadData *DeviceData;
 
-    DeviceData = (TSerialThreadData *) arg;
-    DeviceData -> DeviceHandle = OpenSerialPort(DeviceData -> PathName, DeviceData -> Baud);
-    if(DeviceData -> DeviceHandle != -1)
+//
+// process one complete CAT message from a serial device
+// Length includes the terminating semicolon
+//
+static void ProcessSerialCATMessage(TSerialThreadData* DeviceData, char* Message, int Length)
+{
+    bool IsLocal;
+
+    if((DeviceData -> Device == eG2V2Panel) ||(DeviceData -> Device == eG2V1PanelAdapter))
     {
-        printf("Setting up CAT Serial read handler thread for device %s, pid=%ld\n", DeviceNames[(int)DeviceData->Device], syscall(SYS_gettid));
-        DeviceData -> IsOpen = true;
-        DeviceData -> DeviceActive = true;
-        sleep(1);                                   // allow serial to start (particularly for USB)
+    //
+    // if ZZZS or ZZZP, send to local handler; else send to SDR client app
+    //
+        IsLocal = (Length > 4) && ((memcmp(Message, "ZZZS", 4) == 0) || (memcmp(Message, "ZZZP", 4) == 0));
+        if(IsLocal)
+            ParseCATCmd(Message, Length, DeviceData -> DeviceHandle);
+        else
+            SendCATMessageLength(Message, Length);      // send unprocessed to SDR client app via TCP/IP
+    }
+    else
+    {
+    //
+    // for non front panel devices, process CAT commands locally
+    //
+        ParseCATCmd(Message, Length, DeviceData -> DeviceHandle);
+    }
+}
 
-        if(DeviceData -> RequestID)
-            write(DeviceData ->DeviceHandle, "ZZZS;", 5);
 
+//
+// read all the characters waiting on a device and process the complete messages
+// returns false if the device has failed
+//
+static bool ReadSerialCATDevice(TSerialThreadData* DeviceData)
+{
+    int ReadCnt;
+    char* Start;
+    char* End;
+    char* Semicolon;
+
+    while(true)
+    {
+        if(DeviceData -> MessageLength == VESERINSIZE)  // full with no semicolon: discard
+            DeviceData -> MessageLength = 0;
+        ReadCnt = read(DeviceData -> DeviceHandle, DeviceData -> MessageBuffer + DeviceData -> MessageLength,
+                       VESERINSIZE - DeviceData -> MessageLength);
+        if(ReadCnt < 0)
+        {
+            if((errno == EAGAIN) || (errno == EWOULDBLOCK))
+                return true;
+            if(errno == EINTR)
+                continue;
+            perror("serial read");
+            return false;
+        }
+        if(ReadCnt == 0)
+            return true;
     //
-    // now loop waiting for characters, then form them into CAT messages terminated by semicolon
-    // read() will return after timoeut with no characters, so do check the count!
+    // split off each complete message; keep any incomplete one for the next read
     //
-        while(DeviceData -> DeviceActive)
+        Start = DeviceData -> MessageBuffer;
+        End = Start + DeviceData -> MessageLength + ReadCnt;
+        while((Start < End) && ((Semicolon = memchr(Start, ';', End - Start)) != NULL))
         {
-            ReadCnt = read(DeviceData -> DeviceHandle, &SerialInputBuffer, VESERINSIZE);
-            if (ReadCnt > 0)
+            ProcessSerialCATMessage(DeviceData, Start, (int)(Semicolon - Start) + 1);
+            Start = Semicolon + 1;
+        }
+        DeviceData -> MessageLength = (int)(End - Start);
+        if((DeviceData -> MessageLength != 0) && (Start != DeviceData -> MessageBuffer))
+            memmove(DeviceData -> MessageBuffer, Start, DeviceData -> MessageLength);
+    }
+}
+
+
+//
+// serial I/O thread
+// serves all the devices added by AddSerialCATDevice()
+//
+static void* SerialCATThread(__attribute__((unused)) void *arg)
+{
+    struct epoll_event Events[VMAXSERIALDEVICES + 1];
+    TSerialThreadData* DeviceData;
+    uint64_t Count;
+    uint32_t Id;
+    int Ready;
+    int Cntr;
+
+    printf("spinning up serial CAT I/O thread, pid=%ld\n", syscall(SYS_gettid));
+    while(!ThreadStopRequested())
+    {
+        Ready = epoll_wait(SerialEpoll_fd, Events, VMAXSERIALDEVICES + 1, -1);
+        if(Ready < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            perror("serial epoll_wait");
+            break;
+        }
+        pthread_mutex_lock(&SerialDeviceMutex);
+        for(Cntr = 0; Cntr < Ready; Cntr++)
+        {
+            Id = Events[Cntr].data.u32;
+            if(Id == VSEREVENTWAKE)
             {
-    //
-    // we have input data available, so read it one char at a time and write to buffer
-    // if we find a terminating semicolon, process the command
-    // if we get a control character, abandon the line so far and start again
-    //
-                for(Cntr=0; Cntr < ReadCnt; Cntr++)
-                {
-                    ch=SerialInputBuffer[Cntr];
-                    CATMessageBuffer[CATWritePtr++] = ch;
-                    if (ch == ';')                                      // found end of a complete CAT message
-                    {
-                        CATMessageBuffer[CATWritePtr++] = 0;            // terminate the string
-                        MatchPositionZZZS = (int)(strstr(CATMessageBuffer, "ZZZS") - CATMessageBuffer);
-                        MatchPositionZZZP = (int)(strstr(CATMessageBuffer, "ZZZP") - CATMessageBuffer);
-                        if((DeviceData -> Device == eG2V2Panel) ||(DeviceData -> Device == eG2V1PanelAdapter))
-                        {
-                        //
-                        // if ZZZS or ZZZP, send to local handler; else send to SDR client app
-                        //
-                            if((MatchPositionZZZS == 0) || (MatchPositionZZZP == 0))
-                                ParseCATCmd(CATMessageBuffer, DeviceData -> DeviceHandle);              // if ZZZS, process locally; else send to TCPIP CAT port
-                            else
-                                SendCATMessage(CATMessageBuffer);           // send unprocessed to SDR client app via TCP/IP
-                        }
-                        else
-                        {
-                        //
-                        // for non front panel devices, process CAT commands locally
-                        //
-                            ParseCATCmd(CATMessageBuffer, DeviceData -> DeviceHandle);
-                        }
-                        CATWritePtr = 0;                                // reset for next CAT message
-                    }
-                }
+                if(read(SerialWake_fd, &Count, sizeof(Count)) < 0)
+                    perror("serial wake read");
+                continue;
             }
+            DeviceData = SerialDevices[Id & ~VSEREVENTTIMER];
+            if(!DeviceData -> IsOpen)
+                continue;
+            if(Id & VSEREVENTTIMER)
+            {
+                // ID request timer: send ZZZS once the device has had time to start
+                if(read(DeviceData -> Timer_fd, &Count, sizeof(Count)) > 0)
+                    SendStringToSerial(DeviceData -> DeviceHandle, "ZZZS;");
+            }
+            else if(!ReadSerialCATDevice(DeviceData) || (Events[Cntr].events & (EPOLLERR | EPOLLHUP)))
+                CloseSerialCATDevice(DeviceData);
         }
-        printf("Closing CAT Serial read handler thread for device %s\n", DeviceNames[(int)DeviceData->Device]);
-        close(DeviceData -> DeviceHandle);
-        DeviceData -> IsOpen = false;
+    //
+    // close any devices that have been made inactive
+    //
+        for(Cntr = 0; Cntr < (int)SerialDeviceCount; Cntr++)
+            if(SerialDevices[Cntr] -> IsOpen && !SerialDevices[Cntr] -> DeviceActive)
+                CloseSerialCATDevice(SerialDevices[Cntr]);
+        pthread_mutex_unlock(&SerialDeviceMutex);
     }
     return NULL;
 }
+
+
+//
+// open a serial CAT device and add it to the I/O thread
+// (the thread is created when the first device is added)
+// returns true if successful
+//
+bool AddSerialCATDevice(TSerialThreadData* DeviceData)
+{
+    struct epoll_event Event;
+    struct itimerspec Time;
+    bool Result = false;
+    uint32_t Id;
+
+    pthread_mutex_lock(&SerialDeviceMutex);
+    if(SerialEpoll_fd < 0)
+    {
+        SerialEpoll_fd = epoll_create1(0);
+        SerialWake_fd = eventfd(0, EFD_NONBLOCK);
+        if((SerialEpoll_fd < 0) || (SerialWake_fd < 0))
+        {
+            perror("serial epoll setup");
+            goto done;
+        }
+        Event.events = EPOLLIN;
+        Event.data.u32 = VSEREVENTWAKE;
+        epoll_ctl(SerialEpoll_fd, EPOLL_CTL_ADD, SerialWake_fd, &Event);
+        if(!CreateManagedThread(&SerialIOThread, "serial CAT", eHousekeepingThread, SerialCATThread, NULL))
+        {
+            perror("pthread_create serial CAT thread");
+            goto done;
+        }
+    }
+    //
+    // find the device in the table (it may be re-added), else add it
+    //
+    for(Id = 0; Id < SerialDeviceCount; Id++)
+        if(SerialDevices[Id] == DeviceData)
+            break;
+    if(Id == SerialDeviceCount)
+    {
+        if(SerialDeviceCount >= VMAXSERIALDEVICES)
+        {
+            printf("too many serial CAT devices\n");
+            goto done;
+        }
+        SerialDevices[SerialDeviceCount++] = DeviceData;
+    }
+
+    DeviceData -> Timer_fd = -1;
+    DeviceData -> MessageLength = 0;
+    DeviceData -> DeviceHandle = OpenSerialPort(DeviceData -> PathName, DeviceData -> Baud);
+    if(DeviceData -> DeviceHandle == -1)
+        goto done;
+    printf("Setting up CAT Serial handler for device %s\n", DeviceNames[(int)DeviceData->Device]);
+    if(DeviceData -> RequestID)
+    {
+        DeviceData -> Timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+        if(DeviceData -> Timer_fd >= 0)
+        {
+            memset(&Time, 0, sizeof(Time));
+            Time.it_value.tv_sec = VSERIALIDDELAY / 1000;
+            Time.it_value.tv_nsec = (VSERIALIDDELAY % 1000) * 1000000L;
+            timerfd_settime(DeviceData -> Timer_fd, 0, &Time, NULL);
+            Event.events = EPOLLIN;
+            Event.data.u32 = Id | VSEREVENTTIMER;
+            epoll_ctl(SerialEpoll_fd, EPOLL_CTL_ADD, DeviceData -> Timer_fd, &Event);
+        }
+    }
+    DeviceData -> IsOpen = true;
+    DeviceData -> DeviceActive = true;
+    Event.events = EPOLLIN;
+    Event.data.u32 = Id;
+    if(epoll_ctl(SerialEpoll_fd, EPOLL_CTL_ADD, DeviceData -> DeviceHandle, &Event) < 0)
+    {
+        perror("serial epoll_ctl");
+        CloseSerialCATDevice(DeviceData);
+        goto done;
+    }
+    Result = true;
+
+done:
+    pthread_mutex_unlock(&SerialDeviceMutex);
+    return Result;
+}
+
+
+//
+// stop using a serial CAT device: the I/O thread closes it
+//
+void RemoveSerialCATDevice(TSerialThreadData* DeviceData)
+{
+    uint64_t Value = 1;
+
+    DeviceData -> DeviceActive = false;
+    if(SerialWake_fd >= 0)
+        if(write(SerialWake_fd, &Value, sizeof(Value)) < 0)
+            perror("serial wake write");
+}
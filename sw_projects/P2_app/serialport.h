@@ -10,7 +10,7 @@
 // serialport.h:
 //
 // handle simple access to serial port
-// port is opened and read performed by creating a thread
+// ports are opened, then read by a single I/O thread for all devices
 //
 //////////////////////////////////////////////////////////////
 
@@ -49,8 +49,11 @@ typedef enum
 void SendStringToSerial(int Device, char* Message);
 
 
+#define VESERINSIZE 120                 // large enough to hold a whole CAT message
+
+
 //
-// struct with settings for a serial reader thread
+// struct with settings for a serial CAT device
 //
 typedef struct
 {
@@ -58,15 +61,27 @@ typedef struct
   int DeviceHandle;                 // file device, returned from OS
   ESerialDeviceType Device;         // expected device type
   bool DeviceActive;                // true if device is active
-  bool RequestID;                   // true if thread should request device ID using ZZZS;
+  bool RequestID;                   // true if device ID should be requested using ZZZS;
   bool IsOpen;                      // true if file device is open
   unsigned int Baud;
+  int Timer_fd;                     // timer for the ZZZS request after open
+  char MessageBuffer[VESERINSIZE];  // CAT message being received
+  int MessageLength;                // characters in MessageBuffer
 } TSerialThreadData;
 
+
+//
+// open a serial CAT device and add it to the serial I/O thread
+// received CAT messages are processed locally, or forwarded to the CAT port
+// returns true if successful
+//
+bool AddSerialCATDevice(TSerialThreadData* DeviceData);
+
+
 //
-// serial read thread
+// stop using a serial CAT device. The I/O thread closes the file.
 //
-void* CATSerial(void *arg);
+void RemoveSerialCATDevice(TSerialThreadData* DeviceData);
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,401 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// soaktest.c:
+// DDC soak test: checks DDC sample continuity against the test DDS
+// the DDC stream is read with the common stream code (streamcore.c)
+// and decoded with the same frame plans and unpack kernels as OutDDCIQ.c
+//
+//////////////////////////////////////////////////////////////
+
+#include "soaktest.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include <time.h>
+#include "../common/saturnregisters.h"
+#include "../common/saturndrivers.h"
+#include "../common/hwaccess.h"
+#include "../common/sampleunpack.h"
+#include "../common/streamcore.h"
+
+
+#define VSOAKRINGSIZE 131072                    // DDC DMA ring
+#define VSOAKDMAWORDS 512                       // smallest DMA: 4K bytes
+#define VSOAKMAXDMAWORDS 4096                   // largest DMA: 32K bytes
+#define VSOAKFRAMERATE 48000                    // DDC frames per second
+#define VSOAKOFFSETDIVISOR 32                   // DDCs tuned Fs/32 from the DDS: 32 samples per cycle
+#define VSOAKLEARNSAMPLES 256                   // samples used to measure the phase step
+#define VSOAKTOLERANCE 0.25                     // allowed phase error, as a fraction of a step
+#define VSOAKMINLEVEL 4096.0                    // smaller |I|+|Q| is "no signal" (full scale 2^23)
+
+
+//
+// sample counts for one DDC
+//
+struct SoakCounts
+{
+    uint64_t Samples;
+    uint64_t Dropped;
+    uint64_t Duplicated;
+    uint64_t Glitches;
+    uint64_t LowLevel;
+};
+
+
+//
+// state for one DDC
+//
+struct SoakDDC
+{
+    bool Enabled;
+    uint32_t RateKHz;
+    bool HavePhase;                             // PrevPhase valid
+    double PrevPhase;
+    double Step;                                // phase step per sample (radians); 0 until learned
+    double LearnSum;
+    uint32_t LearnCount;
+    struct SoakCounts Interval;
+    struct SoakCounts Total;
+};
+
+
+static struct SoakDDC SoakDDCs[VNUMDDC];
+static uint32_t SoakNumDDC = 0;                 // DDCs in the mix
+
+
+//
+// set the DDC mix: groups of <count>x<rate KHz>, from DDC0 up
+//
+bool SetSoakDDCMix(const char* Mix)
+{
+    char List[64];
+    char* Group;
+    char* Save;
+    char* Ptr;
+    uint32_t Count, Rate, Cntr;
+    uint32_t DDC = 0;
+
+    strncpy(List, Mix, sizeof(List) - 1);
+    List[sizeof(List) - 1] = 0;
+    memset(SoakDDCs, 0, sizeof(SoakDDCs));
+    for (Group = strtok_r(List, ",", &Save); Group != NULL; Group = strtok_r(NULL, ",", &Save))
+    {
+        Count = strtoul(Group, &Ptr, 10);
+        if ((*Ptr != 'x') || (Count == 0))
+            break;
+        Rate = strtoul(Ptr + 1, NULL, 10);
+        if ((Rate != 48) && (Rate != 96) && (Rate != 192) && (Rate != 384) && (Rate != 768) && (Rate != 1536))
+            break;
+        if (DDC + Count > VNUMDDC)
+            break;
+        for (Cntr = 0; Cntr < Count; Cntr++)
+        {
+            SoakDDCs[DDC].Enabled = true;
+            SoakDDCs[DDC].RateKHz = Rate;
+            DDC++;
+        }
+    }
+    if ((Group != NULL) || (DDC == 0))
+    {
+        printf("soak test DDC mix %s not valid: use <count>x<rate KHz>,... eg 4x48,4x192,2x384\n", Mix);
+        SoakNumDDC = 0;
+        return false;
+    }
+    SoakNumDDC = DDC;
+    return true;
+}
+
+
+//
+// check one unpacked sample: 24 bit I then Q, big endian
+//
+static void CheckSoakSample(struct SoakDDC* State, const uint8_t* Sample)
+{
+    int32_t ISample, QSample;
+    double Phase, Delta, Steps;
+    long Whole;
+
+    ISample = (int32_t)(((uint32_t)Sample[0] << 24) | ((uint32_t)Sample[1] << 16) | ((uint32_t)Sample[2] << 8)) >> 8;
+    QSample = (int32_t)(((uint32_t)Sample[3] << 24) | ((uint32_t)Sample[4] << 16) | ((uint32_t)Sample[5] << 8)) >> 8;
+    State->Interval.Samples++;
+    if ((fabs((double)ISample) + fabs((double)QSample)) < VSOAKMINLEVEL)
+    {
+        State->Interval.LowLevel++;
+        State->HavePhase = false;
+        return;
+    }
+    Phase = atan2((double)QSample, (double)ISample);
+    if (!State->HavePhase)
+    {
+        State->PrevPhase = Phase;
+        State->HavePhase = true;
+        return;
+    }
+    Delta = Phase - State->PrevPhase;
+    State->PrevPhase = Phase;
+    if (Delta > M_PI)
+        Delta -= 2.0 * M_PI;
+    else if (Delta <= -M_PI)
+        Delta += 2.0 * M_PI;
+
+    //
+    // learn the step from the first samples: its sign depends on the mixer
+    //
+    if (State->LearnCount < VSOAKLEARNSAMPLES)
+    {
+        State->LearnSum += Delta;
+        if (++State->LearnCount == VSOAKLEARNSAMPLES)
+            State->Step = State->LearnSum / VSOAKLEARNSAMPLES;
+        return;
+    }
+    Steps = Delta / State->Step;
+    Whole = lround(Steps);
+    if (fabs(Steps - (double)Whole) > VSOAKTOLERANCE)
+        State->Interval.Glitches++;
+    else if (Whole == 0)
+        State->Interval.Duplicated++;
+    else if (Whole > 1)
+        State->Interval.Dropped += Whole - 1;
+    else if (Whole < 0)
+        State->Interval.Glitches++;
+}
+
+
+static inline bool IsDDCHeader(uint8_t* Ptr)
+{
+    return (*(Ptr + 7) == 0x80);
+}
+
+
+//
+// write a summary line to the console and the log
+// the interval counts are added to the totals, then cleared
+//
+static void WriteSoakSummary(time_t StartTime, uint32_t FIFOOverflows, uint32_t Resyncs, uint32_t ADCOverflows, bool Final)
+{
+    struct SoakCounts Sum = {0, 0, 0, 0, 0};
+    struct SoakCounts* Total;
+    char TimeString[32];
+    time_t Now;
+    FILE* Log;
+    uint32_t DDC;
+    int Pass;
+
+    Now = time(NULL);
+    strftime(TimeString, sizeof(TimeString), "%Y-%m-%d %H:%M:%S", localtime(&Now));
+    for (DDC = 0; DDC < SoakNumDDC; DDC++)
+    {
+        Total = &SoakDDCs[DDC].Total;
+        Total->Samples += SoakDDCs[DDC].Interval.Samples;
+        Total->Dropped += SoakDDCs[DDC].Interval.Dropped;
+        Total->Duplicated += SoakDDCs[DDC].Interval.Duplicated;
+        Total->Glitches += SoakDDCs[DDC].Interval.Glitches;
+        Total->LowLevel += SoakDDCs[DDC].Interval.LowLevel;
+        memset(&SoakDDCs[DDC].Interval, 0, sizeof(struct SoakCounts));
+        Sum.Samples += Total->Samples;
+        Sum.Dropped += Total->Dropped;
+        Sum.Duplicated += Total->Duplicated;
+        Sum.Glitches += Total->Glitches;
+        Sum.LowLevel += Total->LowLevel;
+    }
+
+    //
+    // pass 0 to the console, pass 1 to the log
+    //
+    Log = fopen(VSOAKLOGFILE, "a");
+    for (Pass = 0; Pass < 2; Pass++)
+    {
+        FILE* Out = (Pass == 0) ? stdout : Log;
+
+        if (Out == NULL)
+            continue;
+        fprintf(Out, "%s soak %s %.2fh: %llu samples, %llu dropped, %llu duplicated, %llu glitches, %llu no signal; "
+                "FIFO overflows %u, resyncs %u, ADC overflows %u\n",
+                TimeString, Final ? "end" : "at", difftime(Now, StartTime) / 3600.0,
+                (unsigned long long)Sum.Samples, (unsigned long long)Sum.Dropped,
+                (unsigned long long)Sum.Duplicated, (unsigned long long)Sum.Glitches,
+                (unsigned long long)Sum.LowLevel, FIFOOverflows, Resyncs, ADCOverflows);
+        for (DDC = 0; DDC < SoakNumDDC; DDC++)
+        {
+            Total = &SoakDDCs[DDC].Total;
+            if (Final || (Total->Dropped + Total->Duplicated + Total->Glitches + Total->LowLevel) != 0)
+                fprintf(Out, "    DDC%u %uKHz: %llu samples, %llu dropped, %llu duplicated, %llu glitches, %llu no signal\n",
+                        DDC, SoakDDCs[DDC].RateKHz, (unsigned long long)Total->Samples,
+                        (unsigned long long)Total->Dropped, (unsigned long long)Total->Duplicated,
+                        (unsigned long long)Total->Glitches, (unsigned long long)Total->LowLevel);
+        }
+    }
+    if (Log != NULL)
+        fclose(Log);
+}
+
+
+//
+// run the soak test
+//
+int RunSoakTest(uint32_t TestFrequency, volatile bool* Stop)
+{
+    struct StreamRing DDCRing;
+    struct StreamSource DDCSource;
+    const struct DDCFramePlan* FramePlan = NULL;
+    uint8_t Unpacked[6 * VSOAKMAXDMAWORDS];
+    uint8_t* IQReadPtr;
+    uint8_t* SamplePtr;
+    uint32_t PrevRateWord = 0;
+    uint32_t RateWord;
+    uint32_t FrameBytes;
+    uint32_t WordRate = 0;
+    uint32_t Entry, DDC, Sample, Count;
+    uint32_t Resyncs = 0;
+    uint32_t ADCOverflows = 0;
+    uint64_t Lost = 0;
+    int DMAReadfile_fd;
+    int DDCEvent_fd;
+    volatile int Run = 1;
+    time_t StartTime, LastReport, LastADCCheck, Now;
+    FILE* Log;
+
+    if (SoakNumDDC == 0)
+        return EXIT_FAILURE;
+    if (TestFrequency == 0)
+        TestFrequency = VSOAKDEFAULTFREQUENCY;
+    if (!StreamRingCreate(&DDCRing, VSOAKRINGSIZE, "soak DDC"))
+        return EXIT_FAILURE;
+    DMAReadfile_fd = OpenDMADevice(VDDCDMADEVICE, O_RDONLY);
+    if (DMAReadfile_fd < 0)
+    {
+        printf("XDMA read device open failed for DDC data\n");
+        StreamRingDestroy(&DDCRing);
+        return EXIT_FAILURE;
+    }
+
+//
+// stop the DDC stream. Drive every DDC from the test DDS, each tuned Fs/32 from it
+//
+    SetRXDDCEnabled(false);
+    usleep(1000);                                   // give FIFO time to stop recording
+    SetTestDDSFrequency(TestFrequency, false);
+    UseTestDDSSource();
+    for (DDC = 0; DDC < VNUMDDC; DDC++)
+    {
+        SetP2SampleRate(DDC, SoakDDCs[DDC].Enabled, SoakDDCs[DDC].RateKHz, false);
+        if (SoakDDCs[DDC].Enabled)
+            SetDDCFrequency(DDC, TestFrequency + SoakDDCs[DDC].RateKHz * 1000 / VSOAKOFFSETDIVISOR, false);
+    }
+    WriteP2DDCRateRegister();
+    DDCEvent_fd = OpenFIFOMonitorEvents(eRXDDCDMA);
+    if (DDCEvent_fd >= 0)
+        SetupFIFOMonitorThreshold(eRXDDCDMA, VSOAKDMAWORDS, true);
+    else
+        SetupFIFOMonitorChannel(eRXDDCDMA, false);
+    ResetDMAStreamFIFO(eRXDDCDMA);
+    StreamSourceInitialise(&DDCSource, DMAReadfile_fd, eRXDDCDMA, VADDRDDCSTREAMREAD,
+                           VSOAKDMAWORDS * 8, VSOAKMAXDMAWORDS * 8, DDCEvent_fd);
+    GetADCOverflow();                               // clear any old overflow
+
+    StartTime = time(NULL);
+    LastReport = StartTime;
+    LastADCCheck = StartTime;
+    Log = fopen(VSOAKLOGFILE, "a");
+    if (Log != NULL)
+    {
+        fprintf(Log, "soak test started: %u DDCs (", SoakNumDDC);
+        for (DDC = 0; DDC < SoakNumDDC; DDC++)
+            fprintf(Log, "%s%u", (DDC == 0) ? "" : ",", SoakDDCs[DDC].RateKHz);
+        fprintf(Log, " KHz), test source %uHz\n", TestFrequency);
+        fclose(Log);
+    }
+    printf("soak test: %u DDCs, test source %uHz; summaries every %ds to %s\n",
+           SoakNumDDC, TestFrequency, VSOAKREPORTINTERVAL, VSOAKLOGFILE);
+    SetRXDDCEnabled(true);
+
+    while (!*Stop)
+    {
+        StreamSourceWait(&DDCSource, VSOAKDMAWORDS, WordRate, &Run);
+        StreamSourceRead(&DDCSource, &DDCRing);
+
+        //
+        // decode whole frames, and check every sample of every DDC in the mix
+        //
+        while (StreamRingUsed(&DDCRing) >= 16)
+        {
+            IQReadPtr = StreamRingReadPtr(&DDCRing);
+            if (!IsDDCHeader(IQReadPtr))
+            {
+                Resyncs++;
+                while ((StreamRingUsed(&DDCRing) >= 8) && !IsDDCHeader(StreamRingReadPtr(&DDCRing)))
+                    StreamRingConsume(&DDCRing, 8);
+                for (DDC = 0; DDC < SoakNumDDC; DDC++)
+                    SoakDDCs[DDC].HavePhase = false;
+                continue;
+            }
+            RateWord = *(uint32_t*)IQReadPtr;
+            if ((RateWord != PrevRateWord) || (FramePlan == NULL))
+            {
+                FramePlan = GetDDCFramePlan(RateWord);
+                if (FramePlan == NULL)                          // not a valid rate word: a sample, not a header
+                {
+                    Resyncs++;
+                    StreamRingConsume(&DDCRing, 8);
+                    continue;
+                }
+                PrevRateWord = RateWord;
+                WordRate = (FramePlan->FrameLength + 1) * VSOAKFRAMERATE;
+            }
+            FrameBytes = (FramePlan->FrameLength + 1) * 8;
+            if (StreamRingUsed(&DDCRing) < FrameBytes)
+                break;
+            SamplePtr = IQReadPtr + 8;
+            for (Entry = 0; Entry < FramePlan->ActiveDDCs; Entry++)
+            {
+                DDC = FramePlan->DDC[Entry];
+                Count = FramePlan->Count[Entry];
+                if ((DDC >= SoakNumDDC) || (Count > VSOAKMAXDMAWORDS))
+                    continue;
+                UnpackDDCSamples(Unpacked, SamplePtr + FramePlan->Offset[Entry], Count);
+                for (Sample = 0; Sample < Count; Sample++)
+                    CheckSoakSample(&SoakDDCs[DDC], Unpacked + 6 * Sample);
+            }
+            StreamRingConsume(&DDCRing, FrameBytes);
+        }
+
+        //
+        // once a second count ADC overflows; every report interval write a summary
+        //
+        Now = time(NULL);
+        if (Now != LastADCCheck)
+        {
+            LastADCCheck = Now;
+            if (GetADCOverflow() != 0)
+                ADCOverflows++;
+        }
+        if (difftime(Now, LastReport) >= VSOAKREPORTINTERVAL)
+        {
+            LastReport = Now;
+            WriteSoakSummary(StartTime, DDCSource.Overflows, Resyncs, ADCOverflows, false);
+        }
+    }
+
+//
+// stop, and write the final summary
+//
+    SetRXDDCEnabled(false);
+    WriteSoakSummary(StartTime, DDCSource.Overflows, Resyncs, ADCOverflows, true);
+    for (DDC = 0; DDC < SoakNumDDC; DDC++)
+        Lost += SoakDDCs[DDC].Total.Dropped + SoakDDCs[DDC].Total.Duplicated + SoakDDCs[DDC].Total.Glitches;
+    if (DDCEvent_fd >= 0)
+        CloseUserIRQWaiter(DDCEvent_fd);
+    close(DMAReadfile_fd);
+    StreamRingDestroy(&DDCRing);
+    return ((Lost == 0) && (DDCSource.Overflows == 0)) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,56 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// soaktest.h:
+// header file. DDC soak test for unit qualification
+//
+// the test DDS drives every DDC, each tuned Fs/32 away from it, so each DDC
+// outputs a tone whose phase advances by a fixed step per sample. The phase
+// of every sample is checked against the previous one: a step of 0 is a
+// duplicated sample, a step of k steps is k-1 dropped samples; anything
+// else is counted as a glitch. Up to 15 consecutive dropped samples are
+// counted exactly; longer gaps alias.
+// FIFO overflows, resyncs and ADC overflows are counted too, and a summary
+// is appended to the log every hour and when the test stops.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __soaktest_h
+#define __soaktest_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../common/saturntypes.h"
+
+
+#define VSOAKLOGFILE "/tmp/p2app-soak.log"      // summaries are appended here
+#define VSOAKREPORTINTERVAL 3600                // seconds between summaries
+#define VSOAKDEFAULTFREQUENCY 10000000          // test DDS frequency if not set by -f (Hz)
+
+
+//
+// bool SetSoakDDCMix(const char* Mix)
+// set the DDCs to enable, from DDC0 up, as <count>x<rate KHz> groups
+// eg "10x192" or "2x1536" or "4x48,4x192,2x384"
+// returns false if the mix is not valid
+//
+bool SetSoakDDCMix(const char* Mix);
+
+
+//
+// int RunSoakTest(uint32_t TestFrequency, volatile bool* Stop)
+// run the soak test until *Stop becomes true. Call once the hardware is
+// initialised, instead of starting the protocol 2 threads.
+//   TestFrequency: test DDS frequency (Hz), or 0 for VSOAKDEFAULTFREQUENCY
+// returns a process exit status: 0 if no samples were lost
+//
+int RunSoakTest(uint32_t TestFrequency, volatile bool* Stop);
+
+
+#endif
@@ -0,0 +1,78 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// standby.c:
+//
+// standby state, and client attach time
+//
+//////////////////////////////////////////////////////////////
+
+#include "standby.h"
+#include <stdio.h>
+#include <pthread.h>
+
+
+static pthread_mutex_t AttachMutex = PTHREAD_MUTEX_INITIALIZER;
+static struct AttachStatus Status;              // written under AttachMutex
+static struct timespec AttachArrival;           // run bit arrival of this session
+static bool AttachPending = false;              // run bit seen, 1st packet not yet sent
+
+
+void NoteAttachRequest(const struct timespec* Arrival)
+{
+    pthread_mutex_lock(&AttachMutex);
+    AttachArrival = *Arrival;
+    AttachPending = true;
+    pthread_mutex_unlock(&AttachMutex);
+}
+
+
+void NoteAttachStreaming(uint32_t PacketInterval_us)
+{
+    struct timespec Now;
+    int64_t Latency;                            // us
+
+    clock_gettime(CLOCK_REALTIME, &Now);
+    pthread_mutex_lock(&AttachMutex);
+    if (!AttachPending)
+    {
+        pthread_mutex_unlock(&AttachMutex);
+        return;                                 // not started by a run bit
+    }
+    AttachPending = false;
+    Latency = (int64_t)(Now.tv_sec - AttachArrival.tv_sec) * 1000000 + (Now.tv_nsec - AttachArrival.tv_nsec) / 1000;
+    if (Latency < 0)
+        Latency = 0;
+    Status.Attaches++;
+    Status.LastLatency_us = (uint32_t)Latency;
+    Status.LastInterval_us = PacketInterval_us;
+    if (Status.LastLatency_us > Status.MaxLatency_us)
+        Status.MaxLatency_us = Status.LastLatency_us;
+    if ((PacketInterval_us != 0) && (Latency <= 2 * (int64_t)PacketInterval_us))
+        Status.OnTime++;
+    pthread_mutex_unlock(&AttachMutex);
+    printf("client attach: 1st DDC packet sent %.2fms after the run bit arrived (packet interval %.2fms)\n",
+           Latency / 1000.0, PacketInterval_us / 1000.0);
+}
+
+
+void SetStandbyReady(bool Ready)
+{
+    pthread_mutex_lock(&AttachMutex);
+    Status.Ready = Ready;
+    pthread_mutex_unlock(&AttachMutex);
+}
+
+
+void GetAttachStatus(struct AttachStatus* Snapshot)
+{
+    pthread_mutex_lock(&AttachMutex);
+    *Snapshot = Status;
+    pthread_mutex_unlock(&AttachMutex);
+}
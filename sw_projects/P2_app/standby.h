@@ -0,0 +1,79 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// standby.h:
+//
+// header: standby state, and client attach time
+// the hardware (codec, CW ramp, FIFO monitors), sockets and stream threads are
+// set up once at startup; between sessions the threads wait on the thread state
+// channel. With standby on (config file "standby"), the DDC stream also stays
+// ready while idle: its FIFO is reset as soon as it has stopped, rather than when
+// the next session starts, and the packet rings of every DDC are allocated and
+// locked, and kept. The first run bit then only has to enable the DDC.
+// the attach time, from the arrival of the high priority packet with the run bit
+// set to the first DDC packet sent, is measured for every session, standby or
+// not. The first packet can't go before its samples have been collected, which
+// takes one packet interval at the fastest DDC rate; the attach is on time if the
+// packet goes within one more interval.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __standby_h
+#define __standby_h
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+
+//
+// attach times, for the metrics endpoint
+//
+struct AttachStatus
+{
+    bool Ready;                                 // idle, with the DDC stream ready to start
+    uint64_t Attaches;                          // sessions started
+    uint64_t OnTime;                            // sessions whose 1st packet went within one packet interval
+    uint32_t LastLatency_us;                    // run bit arrival to 1st DDC packet sent
+    uint32_t MaxLatency_us;
+    uint32_t LastInterval_us;                   // DDC packet interval of that session
+};
+
+
+//
+// void NoteAttachRequest(const struct timespec* Arrival)
+// a packet with the run bit set, arriving at Arrival (CLOCK_REALTIME), has made the SDR active
+//
+void NoteAttachRequest(const struct timespec* Arrival);
+
+
+//
+// void NoteAttachStreaming(uint32_t PacketInterval_us)
+// the 1st DDC packet of the session has been sent; PacketInterval_us is the packet
+// interval at the fastest DDC rate, or 0 if not known
+//
+void NoteAttachStreaming(uint32_t PacketInterval_us);
+
+
+//
+// void SetStandbyReady(bool Ready)
+// the DDC stream is (or is no longer) idle and ready to start
+//
+void SetStandbyReady(bool Ready);
+
+
+//
+// void GetAttachStatus(struct AttachStatus* Status)
+// the standby state and attach times
+//
+void GetAttachStatus(struct AttachStatus* Status);
+
+
+#endif
@@ -52,11 +52,15 @@
 #define VPORTWIDEBAND0 18
 #define VPORTWIDEBAND1 19
 
+#define VCACHELINESIZE 64                       // CPU cache line (Cortex-A72, and most x86)
+
 
 //
 // a type to hold data for each incoming or outgoing data thread
+// each entry is aligned to a cache line, so a thread updating its own entry
+// doesn't evict the entries of threads running on other cores
 //
-struct ThreadSocketData
+struct __attribute__((aligned(VCACHELINESIZE))) ThreadSocketData
 {
   uint32_t DDCid;                               // only relevant to DDC threads
   int Socketid;                                 // socket to access internet
@@ -71,14 +75,47 @@ struct ThreadSocketData
 
 extern struct ThreadSocketData SocketData[];        // data for each thread
 extern struct sockaddr_in reply_addr;               // destination address for outgoing data
+//
+// written by one thread and read in the loops of others: use __atomic builtins
+// (IsTXMode, SDRActive and NewMessageReceived each have a cache line to themselves)
+//
 extern bool IsTXMode;                               // true if in TX
-extern bool SDRActive;                              // true if this SDR is running at the moment
+extern bool SDRActive;                              // true if this SDR is running at the moment; stored with release
+extern bool NewMessageReceived;                     // set whenever a message is received; see NoteMessageReceived()
+extern uint8_t GlobalFIFOOverflows;                 // FIFO overflow bits: set with __atomic_fetch_or
+//
+// read-mostly
+//
 extern bool ReplyAddressSet;                        // true when reply address has been set
 extern bool StartBitReceived;                       // true when "run" bit has been set
-extern bool NewMessageReceived;                     // set whenever a message is received
 extern bool ThreadError;                            // set true if a thread reports an error
 extern bool UseDebug;                               // true if debugging enabled
-extern uint8_t GlobalFIFOOverflows;                 // FIFO overflow words
+extern bool UseStandby;                             // true if the idle DDC stream is kept ready to start
+extern bool UseFIFOInterrupts;                      // true if FIFO monitor interrupts wake stream threads
+extern bool UseDriverDMABuffer;                     // true if the DDC DMA ring is the driver's contiguous DMA buffer
+extern bool UseStatusInterrupt;                     // true if status change interrupt wakes the high priority thread
+extern bool UseUDPGSO;                              // true if UDP segmentation offload to be used for DDC data
+extern bool UseWallClockTimestamps;                 // true if DDC timestamps are wall clock times, ns since 1970
+extern uint32_t DDCSenderThreads;                   // number of DDC sender threads; 0 = send from DDC thread
+extern int DDCSenderCores[];                        // CPU cores for DDC sender threads
+extern uint32_t DDCSenderCoreCount;                 // number of cores in list; 0 = no CPU affinity set
+extern bool UseRealtimeDMA;                         // true if DDC DMA thread to run SCHED_FIFO
+extern uint32_t DDCTargetLatency;                   // target DDC FIFO latency (us) used to size DMA transfers
+extern uint32_t DDCAsyncDMADepth;                   // if not 0, DDC DMAs kept in flight using asynchronous DMA
+extern uint32_t DMAPollWindow;                      // if not 0, mic & speaker DMA completion busy-poll window (us)
+extern bool UseDUCBatching;                         // true if DUC I/Q packets received and written in batches
+extern uint32_t DUCJitterLatency;                   // TX jitter buffer target latency (ms); 0 = no jitter buffer
+extern uint32_t SpkCoalesceTime;                    // speaker audio gathered per DMA (ms); 0 = one packet per DMA
+extern uint32_t SpkResampleLatency;                 // speaker FIFO level held by the resampler (ms); 0 = no resampler
+extern bool UseWBPacing;                            // true if wideband packets paced to WBPacingRate; else fixed gap
+extern uint32_t WBPacingRate;                       // wideband packet pacing rate (Mbit/s); 0 = unpaced
+extern char* DDCCaptureFilename;                    // if not NULL, file to capture DDC DMA blocks to
+extern char* WBEOPDevice;                           // if not NULL, AXI-Stream device for EOP terminated wideband reads
+extern bool UseWBZeroCopy;                          // true if wideband samples sent by MSG_ZEROCOPY
+extern char* XDPInterface;                          // if not NULL, send DDC data by AF_XDP on this interface
+extern uint32_t WBSpectrumBins;                     // if not 0, send wideband data as a power spectrum of this many bins
+extern uint32_t WBZoomCentre;                       // wideband zoom spectrum centre frequency, Hz
+extern uint32_t WBZoomDecimation;                   // if not 0, the spectrum is of a sub-band 122.88MHz / this wide
 extern sem_t MicWBDMAMutex;                         // protect one DMA read channel shared by mic and WB read
 
 
@@ -101,12 +138,61 @@ extern uint16_t DefaultPorts[];
 void SetPort(uint32_t ThreadNum, uint16_t PortNum);
 
 
+//
+// thread control channel. Outgoing threads wait here, without polling, while the SDR is inactive.
+// it is signalled when SDRActive changes, when a port change is requested, and on exit.
+// usage: read the count with GetThreadStateCount() before testing the state, then
+// WaitThreadStateChange() returns as soon as the count has moved on (and updates it).
+// WaitThreadStateChangeTimed() returns after Ms milliseconds anyway; true if the count moved.
+//
+void SetSDRActive(bool Active);
+void SetTXModeState(bool TXMode);
+
+void SignalThreadStateChange(void);
+uint32_t GetThreadStateCount(void);
+void WaitThreadStateChange(uint32_t* StateCount);
+bool WaitThreadStateChangeTimed(uint32_t* StateCount, uint32_t Ms);
+
+
+//
+// note a message has been received, for the activity check
+// called for every packet by several receive threads: the flag is only written
+// if it isn't already set, so its cache line isn't taken from the other cores
+//
+static inline void NoteMessageReceived(void)
+{
+  if(!__atomic_load_n(&NewMessageReceived, __ATOMIC_RELAXED))
+    __atomic_store_n(&NewMessageReceived, true, __ATOMIC_RELAXED);
+}
+
+
 //
 // function to make an incoming or outgoing socket, bound to the specified port in the structure
 // 1st parameter is a link into the socket data table
 //
 int MakeSocket(struct ThreadSocketData* Ptr, int DDCid);
 
+
+//
+// apply the command line socket tuning for the port: buffer sizes, busy poll, DSCP marking
+// (called by MakeSocket; call it again for a socket shared with another port)
+//
+void TuneSocket(struct ThreadSocketData* Ptr);
+
+
+//
+// true if a send failed only for lack of socket or device queue space (ENOBUFS, EAGAIN)
+//
+bool IsSendBackpressure(int Error);
+
+
+//
+// function to set UDP generic segmentation offload (GSO) on an outgoing socket
+// SegmentSize = 0 turns GSO off again
+// returns true if the kernel accepted the setting
+//
+bool SetSocketGSO(struct ThreadSocketData* Ptr, uint16_t SegmentSize);
+
 //
 // function ot get program version
 //
@@ -0,0 +1,301 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// licenced under GNU GPL3
+//
+// threadmanager.c:
+//
+// creation, scheduling and orderly shutdown of the p2app threads
+//
+//////////////////////////////////////////////////////////////
+
+#include "threadmanager.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <syscall.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+
+//
+// settings for each class
+// control threads are above the streams: their work is short, and PTT and CW
+// key changes arrive there. The DDC DMA thread's own -r priority is above both.
+//
+struct ThreadClassSettings
+{
+    const char* Name;
+    int Priority;                                       // SCHED_FIFO priority, if real time
+    int Nice;                                           // nice level, if not real time
+    size_t StackSize;
+    bool Joinable;                                      // joined at shutdown
+};
+
+static const struct ThreadClassSettings ThreadClasses[VNUMTHREADCLASSES] =
+{
+    { "stream",       40, -5, 512 * 1024, true },      // eStreamThread
+    { "control",      45, -5, 256 * 1024, true },      // eControlThread
+    { "housekeeping",  0, 10, 256 * 1024, false }       // eHousekeepingThread
+};
+
+
+//
+// record of each thread created
+//
+struct ManagedThread
+{
+    pthread_t Thread;
+    char Name[16];
+    EThreadClass Class;
+    void *(*Function)(void *);
+    void *Arg;
+    volatile bool Running;
+};
+
+static struct ManagedThread ManagedThreads[VMAXMANAGEDTHREADS];
+static uint32_t ManagedThreadCount = 0;
+static pthread_mutex_t ManagedThreadMutex = PTHREAD_MUTEX_INITIALIZER;
+static cpu_set_t ClassCPUs[VNUMTHREADCLASSES];
+static bool ClassHasCPUs[VNUMTHREADCLASSES];
+static bool UseRealtimeClasses = false;
+static volatile bool StopRequested = false;
+
+
+//
+// parse a CPU list such as "0,2-3" into a CPU set
+// returns true if any CPUs were found
+//
+static bool ParseCPUList(const char* List, cpu_set_t* Set)
+{
+    char Text[64];
+    char* Token;
+    char* Dash;
+    int First, Last, CPU;
+    bool Found = false;
+
+    CPU_ZERO(Set);
+    strncpy(Text, List, sizeof(Text) - 1);
+    Text[sizeof(Text) - 1] = 0;
+    Token = strtok(Text, ",");
+    while(Token != NULL)
+    {
+        First = atoi(Token);
+        Last = First;
+        Dash = strchr(Token, '-');
+        if(Dash != NULL)
+            Last = atoi(Dash + 1);
+        for(CPU = First; (CPU <= Last) && (CPU < CPU_SETSIZE); CPU++)
+        {
+            CPU_SET(CPU, Set);
+            Found = true;
+        }
+        Token = strtok(NULL, ",");
+    }
+    return Found;
+}
+
+
+//
+// set up the thread classes
+//
+void InitialiseThreadManager(bool UseRealtime, const char* CPUSets)
+{
+    char Text[128];
+    char* Lists[VNUMTHREADCLASSES] = { NULL, NULL, NULL };
+    char* Ptr;
+    uint32_t Class;
+
+    UseRealtimeClasses = UseRealtime;
+    if(CPUSets != NULL)
+    {
+        strncpy(Text, CPUSets, sizeof(Text) - 1);
+        Text[sizeof(Text) - 1] = 0;
+        Ptr = Text;
+        for(Class = 0; (Class < VNUMTHREADCLASSES) && (Ptr != NULL); Class++)
+        {
+            Lists[Class] = Ptr;
+            Ptr = strchr(Ptr, '/');
+            if(Ptr != NULL)
+                *Ptr++ = 0;
+        }
+    }
+    for(Class = 0; Class < VNUMTHREADCLASSES; Class++)
+    {
+        ClassHasCPUs[Class] = (Lists[Class] != NULL) && ParseCPUList(Lists[Class], &ClassCPUs[Class]);
+        if(ClassHasCPUs[Class])
+            printf("%s threads on CPUs %s\n", ThreadClasses[Class].Name, Lists[Class]);
+    }
+    //
+    // lock all memory, so a page fault can't stall a real time thread.
+    // thread stacks are sized per class, so this doesn't lock 8MB per thread.
+    //
+    if(UseRealtimeClasses)
+    {
+        if(mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+            perror("mlockall");
+        else
+            printf("p2app memory locked\n");
+    }
+}
+
+
+//
+// the CPU set of a class
+//
+bool GetThreadClassCPUs(EThreadClass Class, cpu_set_t* Set)
+{
+    if(!ClassHasCPUs[Class])
+        return false;
+    *Set = ClassCPUs[Class];
+    return true;
+}
+
+
+//
+// runs in each new thread: apply the nice level (which is per thread in linux,
+// and can only be set once the thread has a thread ID) then the thread function
+//
+static void* ManagedThreadStart(void *arg)
+{
+    struct ManagedThread* Entry = (struct ManagedThread*)arg;
+    void* Result;
+
+    if(!UseRealtimeClasses || !ThreadClasses[Entry->Class].Joinable)
+        if(setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), ThreadClasses[Entry->Class].Nice) != 0)
+            if(ThreadClasses[Entry->Class].Nice > 0)
+                perror("setpriority");                  // raising priority needs privilege; lowering doesn't
+    Result = Entry->Function(Entry->Arg);
+    Entry->Running = false;
+    return Result;
+}
+
+
+//
+// create a thread in a class
+//
+bool CreateManagedThread(pthread_t* Thread, const char* Name, EThreadClass Class,
+                         void *(*Function)(void *), void *Arg)
+{
+    const struct ThreadClassSettings* Settings = &ThreadClasses[Class];
+    struct ManagedThread* Entry;
+    struct sched_param SchedParam;
+    pthread_attr_t Attributes;
+    bool Realtime;
+    int Error;
+
+    pthread_mutex_lock(&ManagedThreadMutex);
+    if(ManagedThreadCount >= VMAXMANAGEDTHREADS)
+    {
+        pthread_mutex_unlock(&ManagedThreadMutex);
+        printf("too many threads to create %s\n", Name);
+        return false;
+    }
+    Entry = &ManagedThreads[ManagedThreadCount];
+    memset(Entry, 0, sizeof(*Entry));
+    strncpy(Entry->Name, Name, sizeof(Entry->Name) - 1);
+    Entry->Class = Class;
+    Entry->Function = Function;
+    Entry->Arg = Arg;
+    Entry->Running = true;
+
+    Realtime = UseRealtimeClasses && (Settings->Priority != 0);
+    do
+    {
+        pthread_attr_init(&Attributes);
+        pthread_attr_setstacksize(&Attributes, Settings->StackSize);
+        pthread_attr_setdetachstate(&Attributes, Settings->Joinable ? PTHREAD_CREATE_JOINABLE : PTHREAD_CREATE_DETACHED);
+        if(ClassHasCPUs[Class])
+            pthread_attr_setaffinity_np(&Attributes, sizeof(cpu_set_t), &ClassCPUs[Class]);
+        if(Realtime)
+        {
+            SchedParam.sched_priority = Settings->Priority;
+            pthread_attr_setinheritsched(&Attributes, PTHREAD_EXPLICIT_SCHED);
+            pthread_attr_setschedpolicy(&Attributes, SCHED_FIFO);
+            pthread_attr_setschedparam(&Attributes, &SchedParam);
+        }
+        Error = pthread_create(&Entry->Thread, &Attributes, ManagedThreadStart, Entry);
+        pthread_attr_destroy(&Attributes);
+        if((Error == EPERM) && Realtime)
+        {
+            printf("%s: SCHED_FIFO not permitted; using normal scheduling\n", Name);
+            Realtime = false;
+            continue;                                   // try again without real time scheduling
+        }
+        break;
+    } while(true);
+
+    if(Error != 0)
+    {
+        pthread_mutex_unlock(&ManagedThreadMutex);
+        errno = Error;
+        return false;
+    }
+    pthread_setname_np(Entry->Thread, Entry->Name);
+    ManagedThreadCount++;
+    pthread_mutex_unlock(&ManagedThreadMutex);
+    if(Thread != NULL)
+        *Thread = Entry->Thread;
+    return true;
+}
+
+
+//
+// true once shutdown has started
+//
+bool ThreadStopRequested(void)
+{
+    return StopRequested;
+}
+
+
+//
+// start shutdown
+//
+void RequestThreadStop(void)
+{
+    StopRequested = true;
+}
+
+
+//
+// join all the joinable threads, with one deadline for them all
+//
+bool JoinManagedThreads(void)
+{
+    struct timespec Deadline;
+    uint32_t Cntr;
+    uint32_t Count;
+    bool AllStopped = true;
+
+    clock_gettime(CLOCK_REALTIME, &Deadline);
+    Deadline.tv_sec += VTHREADSTOPTIMEOUT / 1000;
+    Deadline.tv_nsec += (VTHREADSTOPTIMEOUT % 1000) * 1000000L;
+    if(Deadline.tv_nsec >= 1000000000L)
+    {
+        Deadline.tv_sec++;
+        Deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&ManagedThreadMutex);
+    Count = ManagedThreadCount;
+    pthread_mutex_unlock(&ManagedThreadMutex);
+    for(Cntr = 0; Cntr < Count; Cntr++)
+    {
+        if(!ThreadClasses[ManagedThreads[Cntr].Class].Joinable)
+            continue;
+        if(pthread_timedjoin_np(ManagedThreads[Cntr].Thread, NULL, &Deadline) != 0)
+        {
+            printf("thread %s (%s) did not stop\n", ManagedThreads[Cntr].Name,
+                   ThreadClasses[ManagedThreads[Cntr].Class].Name);
+            AllStopped = false;
+        }
+    }
+    return AllStopped;
+}
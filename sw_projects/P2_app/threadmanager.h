@@ -0,0 +1,95 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// licenced under GNU GPL3
+//
+// threadmanager.h:
+//
+// header: creation, scheduling and orderly shutdown of the p2app threads
+//
+// each thread belongs to a class, which sets its scheduling, CPU set and stack size:
+//   eStreamThread:        data plane: DDC, DUC, mic, speaker and wideband streams
+//   eControlThread:       protocol control: inbound command ports, high priority status
+//   eHousekeepingThread:  CAT, front panel, ATU, metrics, activity and exit checks
+// with real time scheduling (-R) stream and control threads run SCHED_FIFO, so no
+// housekeeping thread can preempt them; otherwise they run at a higher nice level.
+// stream and control threads are joinable, and are joined at shutdown; they
+// must leave their loops when ThreadStopRequested() returns true.
+// housekeeping threads are detached, and end with the program.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __threadmanager_h
+#define __threadmanager_h
+
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
+
+
+#define VMAXMANAGEDTHREADS 48           // most threads the manager records
+#define VTHREADSTOPTIMEOUT 1000         // ms allowed for all joinable threads to stop
+
+
+typedef enum
+{
+    eStreamThread,                      // data plane stream
+    eControlThread,                     // protocol control
+    eHousekeepingThread                 // everything else
+} EThreadClass;
+
+#define VNUMTHREADCLASSES 3
+
+
+//
+// set up the thread classes. Call before any thread is created.
+//   UseRealtime:         if true, SCHED_FIFO for stream and control threads, and lock all memory
+//   CPUSets:             NULL, or CPU lists for stream/control/housekeeping, eg "2-3/1/0"
+//                        (an empty list leaves that class free to use any CPU)
+//
+void InitialiseThreadManager(bool UseRealtime, const char* CPUSets);
+
+
+//
+// the CPU set of a class, for code that lays out other work around the threads
+// returns false if the class is free to use any CPU
+//
+bool GetThreadClassCPUs(EThreadClass Class, cpu_set_t* Set);
+
+
+//
+// create a thread in a class. Thread may be NULL if the caller doesn't need the handle.
+// Name is shown by "top -H" and in the shutdown report (15 characters at most are used)
+// returns true if successful
+//
+bool CreateManagedThread(pthread_t* Thread, const char* Name, EThreadClass Class,
+                         void *(*Function)(void *), void *Arg);
+
+
+//
+// true once shutdown has started: joinable threads should tidy up and return
+//
+bool ThreadStopRequested(void);
+
+
+//
+// start shutdown: after this ThreadStopRequested() returns true
+//
+void RequestThreadStop(void);
+
+
+//
+// join all the stream and control threads, waiting up to VTHREADSTOPTIMEOUT in total
+// reports any thread that has not stopped. Call after RequestThreadStop(), and after
+// waking any thread that blocks without a timeout.
+// returns true if all stopped
+//
+bool JoinManagedThreads(void);
+
+
+#endif
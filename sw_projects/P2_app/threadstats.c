@@ -0,0 +1,354 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// threadstats.c:
+//
+// per thread CPU, context switch and system call accounting
+//
+//////////////////////////////////////////////////////////////
+
+#include "threadstats.h"
+#include "threadmanager.h"
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <syscall.h>
+#include <linux/perf_event.h>
+
+
+#define VSYSCALLTRACEPOINT "events/raw_syscalls/sys_enter/id"
+#define VNUMPERFCOUNTERS 3
+
+
+//
+// perf counters opened for each thread
+//
+typedef enum
+{
+    ePerfSyscalls,
+    ePerfCycles,
+    ePerfInstructions
+} EPerfCounter;
+
+
+//
+// one thread as seen by the sampler: its latest sample, and its perf counters
+//
+struct SampledThread
+{
+    struct ThreadStats Stats;
+    int PerfFd[VNUMPERFCOUNTERS];               // -1 if not open
+    bool Seen;                                  // found in this pass
+};
+
+static struct SampledThread Sampled[VMAXSTATSTHREADS];         // sampler thread only
+static uint32_t SampledCount = 0;
+static struct ThreadStats Published[VMAXSTATSTHREADS];         // written under StatsMutex
+static uint32_t PublishedCount = 0;
+static pthread_mutex_t StatsMutex = PTHREAD_MUTEX_INITIALIZER;
+static bool UsePerf = false;
+static bool PerfAvailable[VNUMPERFCOUNTERS];    // cleared if a counter can't be opened
+static uint64_t SyscallTracepointId = 0;
+static long TicksPerSecond;
+
+
+//
+// find the raw_syscalls:sys_enter tracepoint id; return false if tracefs isn't there
+//
+static bool FindSyscallTracepoint(void)
+{
+    static const char* TraceDirs[] = {"/sys/kernel/tracing/", "/sys/kernel/debug/tracing/"};
+    char Path[128];
+    unsigned long long Id;
+    uint32_t Cntr;
+    FILE* File;
+    bool Found = false;
+
+    for (Cntr = 0; (Cntr < sizeof(TraceDirs) / sizeof(TraceDirs[0])) && !Found; Cntr++)
+    {
+        snprintf(Path, sizeof(Path), "%s%s", TraceDirs[Cntr], VSYSCALLTRACEPOINT);
+        File = fopen(Path, "r");
+        if (File == NULL)
+            continue;
+        if (fscanf(File, "%llu", &Id) == 1)
+        {
+            SyscallTracepointId = Id;
+            Found = true;
+        }
+        fclose(File);
+    }
+    return Found;
+}
+
+
+//
+// open one perf counter on a thread. A counter that fails to open for the
+// first thread is given up on for all of them, and reported once
+//
+static int OpenPerfCounter(int32_t TID, EPerfCounter Counter)
+{
+    static const char* CounterNames[VNUMPERFCOUNTERS] = {"system calls", "cycles", "instructions"};
+    struct perf_event_attr Attr;
+    int Fd;
+
+    if (!PerfAvailable[Counter])
+        return -1;
+    memset(&Attr, 0, sizeof(Attr));
+    Attr.size = sizeof(Attr);
+    Attr.exclude_hv = 1;
+    switch (Counter)
+    {
+    case ePerfSyscalls:
+        Attr.type = PERF_TYPE_TRACEPOINT;
+        Attr.config = SyscallTracepointId;
+        break;
+    case ePerfCycles:
+        Attr.type = PERF_TYPE_HARDWARE;
+        Attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    case ePerfInstructions:
+        Attr.type = PERF_TYPE_HARDWARE;
+        Attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+    }
+    Fd = (int)syscall(SYS_perf_event_open, &Attr, TID, -1, -1, 0);
+    if ((Fd < 0) && (SampledCount == 0))
+    {
+        printf("thread stats: no perf counter of %s: %s\n", CounterNames[Counter], strerror(errno));
+        PerfAvailable[Counter] = false;
+    }
+    return Fd;
+}
+
+
+static bool ReadPerfCounter(int Fd, uint64_t* Value)
+{
+    return (Fd >= 0) && (read(Fd, Value, sizeof(*Value)) == sizeof(*Value));
+}
+
+
+//
+// read /proc/self/task/<tid>/stat, status and io into a sample
+// returns false if the thread has gone
+//
+static bool ReadTaskFiles(const char* TaskName, struct ThreadStats* Stats)
+{
+    char Path[288];                             // /proc/self/task/<up to 255 characters>/status
+    char Line[512];
+    char* NameEnd;
+    unsigned long long UserTime, SystemTime, Value;
+    bool Found = false;
+    FILE* File;
+
+    snprintf(Path, sizeof(Path), "/proc/self/task/%s/stat", TaskName);
+    File = fopen(Path, "r");
+    if (File == NULL)
+        return false;
+    if ((fgets(Line, sizeof(Line), File) != NULL) && ((NameEnd = strrchr(Line, ')')) != NULL)
+       && (sscanf(Line, "%*d (%15[^)]", Stats->Name) == 1)
+       //  state ppid pgrp session tty tpgid flags minflt cminflt majflt cmajflt utime stime, ... processor is field 39
+       && (sscanf(NameEnd + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu %*d %*d %*d %*d %*d %*d %*u %*u %*d "
+                  "%*u %*u %*u %*u %*u %*u %*u %*u %*u %*u %*u %*u %*u %*d %d", &UserTime, &SystemTime, &Stats->Processor) == 3))
+    {
+        Stats->CPUTicks = UserTime + SystemTime;
+        Found = true;
+    }
+    fclose(File);
+    if (!Found)
+        return false;
+
+    snprintf(Path, sizeof(Path), "/proc/self/task/%s/status", TaskName);
+    File = fopen(Path, "r");
+    if (File != NULL)
+    {
+        while (fgets(Line, sizeof(Line), File) != NULL)
+            if (sscanf(Line, "voluntary_ctxt_switches: %llu", &Value) == 1)
+                Stats->VoluntarySwitches = Value;
+            else if (sscanf(Line, "nonvoluntary_ctxt_switches: %llu", &Value) == 1)
+                Stats->InvoluntarySwitches = Value;
+        fclose(File);
+    }
+
+    snprintf(Path, sizeof(Path), "/proc/self/task/%s/io", TaskName);
+    File = fopen(Path, "r");
+    if (File != NULL)                           // needs CONFIG_TASK_IO_ACCOUNTING
+    {
+        Stats->IOCalls = 0;
+        while (fgets(Line, sizeof(Line), File) != NULL)
+            if ((sscanf(Line, "syscr: %llu", &Value) == 1) || (sscanf(Line, "syscw: %llu", &Value) == 1))
+                Stats->IOCalls += Value;
+        fclose(File);
+    }
+    return true;
+}
+
+
+//
+// find or add the sampler's entry for a thread; New is set if added
+//
+static struct SampledThread* FindSampledThread(int32_t TID, bool* New)
+{
+    struct SampledThread* Entry;
+    uint32_t Cntr;
+
+    *New = false;
+    for (Cntr = 0; Cntr < SampledCount; Cntr++)
+        if (Sampled[Cntr].Stats.TID == TID)
+            return &Sampled[Cntr];
+    if (SampledCount == VMAXSTATSTHREADS)
+        return NULL;
+    Entry = &Sampled[SampledCount];
+    memset(Entry, 0, sizeof(*Entry));
+    Entry->Stats.TID = TID;
+    for (Cntr = 0; Cntr < VNUMPERFCOUNTERS; Cntr++)
+        Entry->PerfFd[Cntr] = UsePerf ? OpenPerfCounter(TID, (EPerfCounter)Cntr) : -1;
+    SampledCount++;
+    *New = true;
+    return Entry;
+}
+
+
+//
+// sample one thread, and work out its rates over Interval seconds
+//
+static void SampleThread(struct SampledThread* Entry, const char* TaskName, double Interval, bool New)
+{
+    struct ThreadStats Previous = Entry->Stats;
+    struct ThreadStats* Stats = &Entry->Stats;
+    uint64_t Cycles, Instructions;
+
+    Entry->Seen = ReadTaskFiles(TaskName, Stats);
+    if (!Entry->Seen)
+        return;
+    Stats->HasSyscalls = ReadPerfCounter(Entry->PerfFd[ePerfSyscalls], &Stats->Syscalls);
+    Stats->HasCycles = ReadPerfCounter(Entry->PerfFd[ePerfCycles], &Stats->Cycles);
+    Stats->HasInstructions = ReadPerfCounter(Entry->PerfFd[ePerfInstructions], &Stats->Instructions);
+    if (New || (Interval <= 0.0))
+        return;                                 // rates from the next sample
+    Stats->CPUPercent = 100.0 * (Stats->CPUTicks - Previous.CPUTicks) / TicksPerSecond / Interval;
+    Stats->SwitchesPerSecond = (Stats->VoluntarySwitches + Stats->InvoluntarySwitches
+                                - Previous.VoluntarySwitches - Previous.InvoluntarySwitches) / Interval;
+    Stats->IOCallsPerSecond = (Stats->IOCalls - Previous.IOCalls) / Interval;
+    if (Stats->HasSyscalls)
+        Stats->SyscallsPerSecond = (Stats->Syscalls - Previous.Syscalls) / Interval;
+    if (Stats->HasCycles && Stats->HasInstructions)
+    {
+        Cycles = Stats->Cycles - Previous.Cycles;
+        Instructions = Stats->Instructions - Previous.Instructions;
+        Stats->InstructionsPerCycle = (Cycles != 0) ? (double)Instructions / Cycles : 0.0;
+    }
+}
+
+
+//
+// one pass over /proc/self/task: sample every thread, drop those that have ended,
+// then publish the samples
+//
+static void SampleAllThreads(double Interval)
+{
+    struct SampledThread* Entry;
+    struct dirent* Task;
+    DIR* Tasks;
+    uint32_t Cntr, Kept, Counter;
+    int32_t TID;
+    bool New;
+
+    for (Cntr = 0; Cntr < SampledCount; Cntr++)
+        Sampled[Cntr].Seen = false;
+    Tasks = opendir("/proc/self/task");
+    while ((Tasks != NULL) && ((Task = readdir(Tasks)) != NULL))
+    {
+        if (Task->d_name[0] == '.')
+            continue;
+        TID = atoi(Task->d_name);
+        Entry = FindSampledThread(TID, &New);
+        if (Entry != NULL)
+            SampleThread(Entry, Task->d_name, Interval, New);
+    }
+    if (Tasks != NULL)
+        closedir(Tasks);
+
+    Kept = 0;
+    for (Cntr = 0; Cntr < SampledCount; Cntr++)
+    {
+        if (!Sampled[Cntr].Seen)
+        {
+            for (Counter = 0; Counter < VNUMPERFCOUNTERS; Counter++)
+                if (Sampled[Cntr].PerfFd[Counter] >= 0)
+                    close(Sampled[Cntr].PerfFd[Counter]);
+            continue;
+        }
+        if (Kept != Cntr)
+            Sampled[Kept] = Sampled[Cntr];
+        Kept++;
+    }
+    SampledCount = Kept;
+
+    pthread_mutex_lock(&StatsMutex);
+    for (Cntr = 0; Cntr < SampledCount; Cntr++)
+        Published[Cntr] = Sampled[Cntr].Stats;
+    PublishedCount = SampledCount;
+    pthread_mutex_unlock(&StatsMutex);
+}
+
+
+//
+// sampler thread: a pass every VTHREADSTATSPERIOD
+//
+static void* ThreadStatsThread(void* arg)
+{
+    struct timespec Previous, Now;
+    double Interval = 0.0;
+
+    (void)arg;
+    clock_gettime(CLOCK_MONOTONIC, &Previous);
+    while (true)
+    {
+        SampleAllThreads(Interval);
+        usleep(VTHREADSTATSPERIOD * 1000);
+        clock_gettime(CLOCK_MONOTONIC, &Now);
+        Interval = (Now.tv_sec - Previous.tv_sec) + (Now.tv_nsec - Previous.tv_nsec) * 1.0E-9;
+        Previous = Now;
+    }
+    return NULL;
+}
+
+
+bool StartThreadStats(bool UsePerfCounters)
+{
+    uint32_t Cntr;
+
+    TicksPerSecond = sysconf(_SC_CLK_TCK);
+    UsePerf = UsePerfCounters;
+    for (Cntr = 0; Cntr < VNUMPERFCOUNTERS; Cntr++)
+        PerfAvailable[Cntr] = UsePerf;
+    if (UsePerf && !FindSyscallTracepoint())
+    {
+        printf("thread stats: raw_syscalls tracepoint not found; only read/write calls counted\n");
+        PerfAvailable[ePerfSyscalls] = false;
+    }
+    return CreateManagedThread(NULL, "thread stats", eHousekeepingThread, ThreadStatsThread, NULL);
+}
+
+
+uint32_t GetThreadStats(struct ThreadStats* Stats, uint32_t MaxThreads)
+{
+    uint32_t Count;
+
+    pthread_mutex_lock(&StatsMutex);
+    Count = (PublishedCount < MaxThreads) ? PublishedCount : MaxThreads;
+    memcpy(Stats, Published, Count * sizeof(struct ThreadStats));
+    pthread_mutex_unlock(&StatsMutex);
+    return Count;
+}
@@ -0,0 +1,79 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// threadstats.h:
+//
+// header: per thread resource accounting, for the metrics endpoint
+// every VTHREADSTATSPERIOD each p2app thread's CPU time, context switches and
+// read/write type system calls are read from /proc/self/task, and rates over
+// the period worked out. With perf counters enabled, each thread also gets
+// perf_event_open counters of all system calls (the raw_syscalls sys_enter
+// tracepoint), cycles and instructions; these mostly need root, and cycles
+// and instructions need a CPU PMU, so any that can't be opened are left out.
+// RUSAGE_THREAD only reports the calling thread, so it can't be used to sample
+// the others: /proc gives the same utime, stime and context switch counts.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __threadstats_h
+#define __threadstats_h
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#define VTHREADSTATSPERIOD 1000                 // ms between samples
+#define VMAXSTATSTHREADS 64                     // threads accounted
+
+
+//
+// one thread's latest sample: totals since the thread started (perf counts
+// since it was first sampled), and rates over the last period
+//
+struct ThreadStats
+{
+    int32_t TID;
+    char Name[16];                              // as set by the thread manager
+    int32_t Processor;                          // CPU last run on
+    uint64_t CPUTicks;                          // user + system time, clock ticks
+    uint64_t VoluntarySwitches;                 // context switches: blocked or slept
+    uint64_t InvoluntarySwitches;               // context switches: preempted
+    uint64_t IOCalls;                           // read and write type system calls (syscr + syscw)
+    uint64_t Syscalls;                          // all system calls, if HasSyscalls
+    uint64_t Cycles;                            // if HasCycles
+    uint64_t Instructions;                      // if HasInstructions
+    bool HasSyscalls;
+    bool HasCycles;
+    bool HasInstructions;
+    double CPUPercent;                          // of one CPU
+    double SwitchesPerSecond;                   // voluntary + involuntary
+    double IOCallsPerSecond;
+    double SyscallsPerSecond;                   // if HasSyscalls
+    double InstructionsPerCycle;                // if HasCycles and HasInstructions
+};
+
+
+//
+// bool StartThreadStats(bool UsePerfCounters)
+// start the sampling thread. If UsePerfCounters, open perf counters for each thread.
+// returns false if the thread could not be started
+//
+bool StartThreadStats(bool UsePerfCounters);
+
+
+//
+// uint32_t GetThreadStats(struct ThreadStats* Stats, uint32_t MaxThreads)
+// copy the latest sample of up to MaxThreads threads; returns the number copied
+// (0 if sampling is not running)
+//
+uint32_t GetThreadStats(struct ThreadStats* Stats, uint32_t MaxThreads);
+
+
+#endif
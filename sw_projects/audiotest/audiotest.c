@@ -8,12 +8,14 @@
  * Key features:
  * - GUI for controlling microphone and speaker tests.
  * - Threaded operation for non-blocking DMA transfers and PTT monitoring.
- * - Thread-safe access to shared resources using mutexes.
+ * - Lock-free sharing with the GUI: atomic flags and volume, and an SPSC ring of per-DMA peak levels.
  * - Comprehensive error handling and resource cleanup.
  * - Optimized audio data processing and DMA operations.
  * - Overload indicator (latches for 0.5s with dBFS value) and near-peak indicator (6dB/10dB from peak with dBFS value).
  * - Separate line and mic gain controls with persistent settings saved to ~/.audiotestrc.
- * - Dynamic mic level bar using a circular buffer for peak detection over 250ms.
+ * - Dynamic mic level bar using a circular buffer for peak detection over 250ms, refreshed by a GTK timer.
+ * - Streaming mode without the GUI (-r/-p): records the mic to, or plays the speaker from, a WAV file
+ *   through a small double buffer and a file thread, so tests can run for minutes in constant memory.
  *
  * NOTE
  * audiotest will not run correctly if there is an instance of p2app or piHPSDR
@@ -47,6 +49,11 @@
 #include <sys/poll.h>
 #include <math.h>   // For M_PI
 #include <time.h>
+#include <signal.h>
+#include <stdatomic.h>
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 // Fallback declaration for waitpid if unistd.h fails
 pid_t waitpid(pid_t pid, int *status, int options);
@@ -58,6 +65,7 @@ pid_t waitpid(pid_t pid, int *status, int options);
 #include "../common/codecwrite.h"
 #include "../common/version.h"
 #include "../common/debugaids.h"
+#include "../common/spscring.h"
 
 // Configuration constants
 #define ALIGNMENT 4096                    // Memory alignment for DMA buffers
@@ -71,23 +79,40 @@ pid_t waitpid(pid_t pid, int *status, int options);
 #define SAMPLE_WORDS_PER_DMA 256          // Number of 16-bit samples per DMA
 #define DMA_WORDS_PER_DMA 128             // Number of 8-byte words per DMA
 #define DMA_TRANSFERS (TOTAL_SAMPLES * 4) / DMA_TRANSFER_SIZE // Total DMA transfers
-#define DMA_DISP_UPDATE 12                // Number of DMAs before UI update
 #define AXI_BASE_ADDRESS 0x40000L         // Base address of StreamRead/Writer IP
 #define AXI_FNAME "/dev/xdma0_user"       // PCIe device driver path for AXI-lite access
 #define MIC_STATUS_IDLE "Idle"            // Status label for idle state
 #define MIC_STATUS_RECORDING "Speak Now"  // Status label for recording
 #define MIC_STATUS_PLAYING "Playing"      // Status label for playback
-#define MIN_UPDATE_INTERVAL 100000000     // Minimum 100ms between UI updates (in ns)
+#define METER_REFRESH_MS 30               // Mic level bar refresh interval (in ms)
 #define OVERLOAD_LATCH_NS 500000000       // 0.5s latch for overload indicator (in ns)
+#define OVERLOAD_LEVEL 32604              // |sample| above 99.5% of full scale is an overload
 #define CIRCULAR_BUFFER_SIZE 24           // Buffer for 250ms of DMA peak levels (~10.67ms per DMA)
+#define METER_RING_SIZE 64                // Peak levels in flight from DMA thread to GUI (power of 2)
+#define STREAM_BLOCK_SIZE 65536           // Each half of the streaming record/playback buffer
+#define STREAM_DEFAULT_SECONDS 60         // Default streaming record duration
 
-// Circular buffer for peak levels
+// Peak level of one DMA, passed from the DMA thread to the GTK meter timer
+typedef struct
+{
+    uint32_t Peak;                   // Largest |sample| (0 to 32768)
+    uint32_t Overloads;              // Samples above OVERLOAD_LEVEL
+    float Progress;                  // Test progress (0.0 to 1.0)
+    bool First;                      // First DMA of a test: clear the peak window
+    bool Last;                       // Last DMA of a test: idle the meter
+} MeterBlock;
+
+// SPSC ring of peak levels: the mic DMA thread produces, the GTK meter timer consumes
+static MeterBlock meter_blocks[METER_RING_SIZE];
+static struct SPSCRing meter_ring;
+static atomic_uint meter_dropped;     // Peak levels discarded because the GUI fell behind
+
+// Circular buffer for peak levels (GTK main thread only)
 static float peak_buffer[CIRCULAR_BUFFER_SIZE];
 static int peak_buffer_index = 0;
 
 // Global volume variable to store the slider value
-static volatile double global_volume = 0.1;
-static pthread_mutex_t volume_mutex = PTHREAD_MUTEX_INITIALIZER;
+static _Atomic double global_volume = 0.1;
 
 // Application context for GUI elements
 typedef struct
@@ -123,19 +148,16 @@ typedef struct
     int dma_write_fd;                // File descriptor for DMA write device
     int dma_read_fd;                 // File descriptor for DMA read device
     uint32_t buffer_size;            // Size of DMA buffers
-    bool mic_test_initiated;         // Flag to start microphone test
-    bool speaker_test_initiated;     // Flag to start speaker test
-    bool speaker_test_is_left_channel; // True for left channel speaker test
-    pthread_mutex_t mic_test_mutex;  // Mutex for mic_test_initiated
-    pthread_mutex_t speaker_test_mutex; // Mutex for speaker_test_mutex
+    atomic_bool mic_test_initiated;  // Flag to start microphone test
+    atomic_uint speaker_test_state;  // SPEAKER_TEST_START and SPEAKER_TEST_LEFT flags
     AppContext *AppPtr;              // Pointer to app context for event handlers
 } AudioContext;
 
+// Speaker test flags: set together so the test thread never sees half an update
+#define SPEAKER_TEST_START 1             // Speaker test requested
+#define SPEAKER_TEST_LEFT 2              // Left channel speaker test
+
 // Global synchronization primitives
-extern sem_t DDCInSelMutex;                 // Protects DDC input select register
-extern sem_t DDCResetFIFOMutex;             // Protects FIFO reset register
-extern sem_t RFGPIOMutex;                   // Protects RF GPIO register
-extern sem_t CodecRegMutex;                 // Protects codec register writes
 volatile bool keep_running = true;           // Flag to control thread termination
 static bool hardware_available = true;       // Flag to indicate hardware availability
 
@@ -241,10 +263,8 @@ static void on_mic_gain_changed(GtkRange *range, AudioContext *audio)
 static void on_volume_changed(GtkRange *range, gpointer user_data)
 {
     double new_volume = gtk_range_get_value(range) / 100.0; // Normalize to 0.0-1.0, scaled to 0.0-2.0 for testing
-    pthread_mutex_lock(&volume_mutex);
-    global_volume = new_volume * 2.0; // Increase range to test hardware response
-    pthread_mutex_unlock(&volume_mutex);
-    printf("Volume set to: %.2f (scaled to %.2f)\n", new_volume, global_volume);
+    atomic_store(&global_volume, new_volume * 2.0); // Increase range to test hardware response
+    printf("Volume set to: %.2f (scaled to %.2f)\n", new_volume, new_volume * 2.0);
 }
 
 // Callback for the Close button
@@ -322,13 +342,6 @@ void cleanup(AppContext *app, AudioContext *audio)
     if (audio->read_buffer) free(audio->read_buffer);
     if (audio->dma_write_fd >= 0) close(audio->dma_write_fd);
     if (audio->dma_read_fd >= 0) close(audio->dma_read_fd);
-    sem_destroy(&DDCInSelMutex);
-    sem_destroy(&DDCResetFIFOMutex);
-    sem_destroy(&RFGPIOMutex);
-    sem_destroy(&CodecRegMutex);
-    pthread_mutex_destroy(&audio->mic_test_mutex);
-    pthread_mutex_destroy(&audio->speaker_test_mutex);
-    pthread_mutex_destroy(&volume_mutex);
 }
 
 /*
@@ -338,9 +351,7 @@ void cleanup(AppContext *app, AudioContext *audio)
  */
 void set_mic_test_initiated(AudioContext *audio, bool value)
 {
-    pthread_mutex_lock(&audio->mic_test_mutex);
-    audio->mic_test_initiated = value;
-    pthread_mutex_unlock(&audio->mic_test_mutex);
+    atomic_store(&audio->mic_test_initiated, value);
 }
 
 /*
@@ -350,11 +361,7 @@ void set_mic_test_initiated(AudioContext *audio, bool value)
  */
 bool get_mic_test_initiated(AudioContext *audio)
 {
-    bool value;
-    pthread_mutex_lock(&audio->mic_test_mutex);
-    value = audio->mic_test_initiated;
-    pthread_mutex_unlock(&audio->mic_test_mutex);
-    return value;
+    return atomic_load(&audio->mic_test_initiated);
 }
 
 /*
@@ -365,10 +372,7 @@ bool get_mic_test_initiated(AudioContext *audio)
  */
 void set_speaker_test_initiated(AudioContext *audio, bool value, bool is_left)
 {
-    pthread_mutex_lock(&audio->speaker_test_mutex);
-    audio->speaker_test_initiated = value;
-    audio->speaker_test_is_left_channel = is_left;
-    pthread_mutex_unlock(&audio->speaker_test_mutex);
+    atomic_store(&audio->speaker_test_state, (value ? SPEAKER_TEST_START : 0) | (is_left ? SPEAKER_TEST_LEFT : 0));
 }
 
 /*
@@ -379,16 +383,14 @@ void set_speaker_test_initiated(AudioContext *audio, bool value, bool is_left)
  */
 void get_speaker_test_initiated(AudioContext *audio, bool *value, bool *is_left)
 {
-    pthread_mutex_lock(&audio->speaker_test_mutex);
-    *value = audio->speaker_test_initiated;
-    *is_left = audio->speaker_test_is_left_channel;
-    pthread_mutex_unlock(&audio->speaker_test_mutex);
+    unsigned int state = atomic_load(&audio->speaker_test_state);
+    *value = (state & SPEAKER_TEST_START) != 0;
+    *is_left = (state & SPEAKER_TEST_LEFT) != 0;
 }
 
 /*
- * update_progress_bars: Updates progress, level bars, and indicators in the GTK main thread.
- * @param user_data: Pointer to ProgressUpdateData.
- * @return: G_SOURCE_REMOVE to remove the idle callback.
+ * update_progress_bars: Updates progress, level bars, and indicators. GTK main thread only.
+ * @param data: Pointer to ProgressUpdateData.
  */
 typedef struct
 {
@@ -403,9 +405,8 @@ typedef struct
     float near_peak_dbfs;         // dBFS value for near-peak (or 0 if inactive)
 } ProgressUpdateData;
 
-static gboolean update_progress_bars(gpointer user_data)
+static void update_progress_bars(ProgressUpdateData *data)
 {
-    ProgressUpdateData *data = (ProgressUpdateData *)user_data;
     if (data->progress_bar) 
         gtk_progress_bar_set_fraction(data->progress_bar, data->progress_fraction);
     if (data->level_bar)
@@ -416,8 +417,6 @@ static gboolean update_progress_bars(gpointer user_data)
     {
         if (data->overload)
         { // Near or above 0 dBFS
-            char label_text[32];
-//            snprintf(label_text, sizeof(label_text), "Overload: %.1f dBFS", data->overload_dbfs);
             gtk_label_set_text(data->overload_label, "!! Overload !!");
             gtk_widget_set_name((GtkWidget *)data->overload_label, "overload-on");
         }
@@ -444,65 +443,150 @@ static gboolean update_progress_bars(gpointer user_data)
             gtk_widget_set_name((GtkWidget *)data->near_peak_label, "near-peak-off");
         }
     }
-
-    g_free(data);
-    return G_SOURCE_REMOVE;
 }
 
 /*
- * reset_overload_latch: Resets the overload indicator after 0.5s.
+ * meter_timer: Drains the peak levels published by the mic DMA thread and updates
+ * the progress bar, level bar and indicators. Runs every METER_REFRESH_MS in the GTK main thread,
+ * so the DMA thread never waits for the GUI.
  * @param user_data: Pointer to AppContext.
- * @return: G_SOURCE_REMOVE to remove the timeout callback.
+ * @return: G_SOURCE_CONTINUE to keep the timer running.
  */
-static gboolean reset_overload_latch(gpointer user_data)
+static gboolean meter_timer(gpointer user_data)
 {
     AppContext *app = (AppContext *)user_data;
-    ProgressUpdateData *data = g_new(ProgressUpdateData, 1);
-    data->progress_bar = app->mic_progress_bar;
-    data->level_bar = app->mic_level_bar;
-    data->overload_label = app->overload_label;
-    data->near_peak_label = app->near_peak_label;
-    data->progress_fraction = app->mic_progress_bar ? gtk_progress_bar_get_fraction(app->mic_progress_bar) : 0.0;
-    data->level_fraction = app->mic_level_bar ? gtk_progress_bar_get_fraction(app->mic_level_bar) : 0.0;
-    data->overload_dbfs = 0.0; // Reset to inactive
-    data->near_peak_dbfs = app->near_peak_label && gtk_label_get_text(app->near_peak_label)[11] == ':' ? 0.0 : atof(gtk_label_get_text(app->near_peak_label) + 12); // Preserve near-peak if active
-    g_idle_add(update_progress_bars, data);
-    return G_SOURCE_REMOVE;
+    static ProgressUpdateData display = {0};
+    static gint64 overload_until = 0;            // End of overload latch (monotonic us)
+    const float NEAR_PEAK_10DB = 100.0 * pow(10.0, -10.0 / 20.0); // ~31.62%
+    bool Changed = false;
+    bool Idle = false;
+    int32_t Slot;
+    gint64 now = g_get_monotonic_time();
+
+    while ((Slot = SPSCGetReadSlot(&meter_ring)) >= 0)
+    {
+        MeterBlock *Block = &meter_blocks[Slot];
+        if (Block->First)
+        {
+            memset(peak_buffer, 0, sizeof(peak_buffer));
+            peak_buffer_index = 0;
+        }
+        peak_buffer[peak_buffer_index] = (float)Block->Peak / 32768.0 * 100.0;   // 0 to 100
+        peak_buffer_index = (peak_buffer_index + 1) % CIRCULAR_BUFFER_SIZE;
+        if (Block->Overloads != 0)
+        {
+            printf("Overload detected: %u samples\n", Block->Overloads);
+            overload_until = now + OVERLOAD_LATCH_NS / 1000;
+            display.overload = true;
+        }
+        display.progress_fraction = Block->Progress;
+        Idle = Block->Last;
+        SPSCRelease(&meter_ring);
+        Changed = true;
+    }
+
+    if (Changed)
+    {
+        // Find max peak level in circular buffer
+        float MaxPeakLevel = 0.0;
+        for (int i = 0; i < CIRCULAR_BUFFER_SIZE; i++) 
+        {
+            if (peak_buffer[i] > MaxPeakLevel) 
+                MaxPeakLevel = peak_buffer[i];
+        }
+        float dBFS = 20.0 * log10(MaxPeakLevel / 100.0 + 1e-6);
+        dBFS = (dBFS > 0.0) ? 0.0 : (dBFS < -60.0) ? -60.0 : dBFS;   // min = -60dBFS
+        display.level_fraction = Idle ? 0.0 : 1.0 + (dBFS / 60.0);   // Normalize to 0-1
+        display.near_peak_dbfs = (!Idle && MaxPeakLevel >= NEAR_PEAK_10DB) ? dBFS : 0.0;
+        display.overload_dbfs = display.overload ? dBFS : 0.0;
+    }
+    if (display.overload && now >= overload_until)
+    {
+        display.overload = false;
+        display.overload_dbfs = 0.0;
+        Changed = true;
+    }
+    if (Changed && hardware_available)
+    {
+        display.progress_bar = app->mic_progress_bar;
+        display.level_bar = app->mic_level_bar;
+        display.overload_label = app->overload_label;
+        display.near_peak_label = app->near_peak_label;
+        update_progress_bars(&display);
+    }
+    return G_SOURCE_CONTINUE;
 }
 
 /*
- * MyStatusCallback: Updates progress bars and indicators for test progress and input level.
- * @param app: Pointer to application context.
- * @param ProgressPercent: Percentage of test completion (0 to 100).
- * @param LevelPercent: Input signal level percentage (0 to 100).
- * @param dBFS: Peak signal level in dBFS.
- * @param Overload: True if signal exceeds 0 dBFS.
- * @param NearPeak: True if signal is within -6 dB or -10 dB of peak.
+ * MeasurePeak: Finds the peak level, sum of squares and overload count of a block of mic samples.
+ * @param Samples: Pointer to 16-bit mic samples.
+ * @param Count: Number of samples (a multiple of 8).
+ * @param SumSquares: Sum of sample^2 is added to this.
+ * @param Overloads: Number of samples above OVERLOAD_LEVEL is returned here.
+ * @return: Largest |sample| (0 to 32768).
  */
-static void MyStatusCallback(AppContext *app, float ProgressPercent, float LevelPercent, float dBFS, bool Overload, bool NearPeak)
+static uint32_t MeasurePeak(const int16_t *Samples, uint32_t Count, uint64_t *SumSquares, uint32_t *Overloads)
 {
-    if (!hardware_available) return; // Skip if hardware is unavailable
-    ProgressUpdateData *data = g_new(ProgressUpdateData, 1);
-    data->progress_bar = app->mic_progress_bar;
-    data->level_bar = app->mic_level_bar;
-    data->overload_label = app->overload_label;
-    data->near_peak_label = app->near_peak_label;
-    data->progress_fraction = ProgressPercent / 100.0;
-
-    // Convert LevelPercent to dBFS and scale to 0-1 for level bar
-    LevelPercent = (LevelPercent < 0.0) ? 0.0 : (LevelPercent > 100.0) ? 100.0 : LevelPercent;
-    dBFS = (dBFS > 0.0) ? 0.0 : (dBFS < -60.0) ? -60.0 : dBFS;
-    data->level_fraction = 1.0 + (dBFS / 60.0); // Normalize to 0-1
-    data->overload = Overload;
-    data->overload_dbfs = Overload ? dBFS : 0.0;
-    data->near_peak_dbfs = NearPeak ? dBFS : 0.0;
-
-    g_idle_add(update_progress_bars, data);
-
-    // Set 0.5s latch for overload
-    if (Overload) {
-        g_timeout_add(500, reset_overload_latch, app);
+#if defined(__ARM_NEON) && defined(__aarch64__)
+    uint16x8_t Peak = vdupq_n_u16(0);
+    uint16x8_t OverloadCount = vdupq_n_u16(0);
+    uint64x2_t Squares = vdupq_n_u64(0);
+    const uint16x8_t Threshold = vdupq_n_u16(OVERLOAD_LEVEL + 1);
+
+    for (uint32_t Cntr = 0; Cntr < Count; Cntr += 8)
+    {
+        int16x8_t Sample = vld1q_s16(Samples + Cntr);
+        uint16x8_t Magnitude = vreinterpretq_u16_s16(vabsq_s16(Sample));    // -32768 becomes 32768
+        int32x4_t SquaresLow = vmull_s16(vget_low_s16(Sample), vget_low_s16(Sample));
+        int32x4_t SquaresHigh = vmull_s16(vget_high_s16(Sample), vget_high_s16(Sample));
+
+        Peak = vmaxq_u16(Peak, Magnitude);
+        OverloadCount = vsubq_u16(OverloadCount, vcgeq_u16(Magnitude, Threshold));   // mask is -1
+        Squares = vpadalq_u32(Squares, vreinterpretq_u32_s32(SquaresLow));
+        Squares = vpadalq_u32(Squares, vreinterpretq_u32_s32(SquaresHigh));
+    }
+    *SumSquares += vgetq_lane_u64(Squares, 0) + vgetq_lane_u64(Squares, 1);
+    *Overloads = vaddvq_u16(OverloadCount);
+    return vmaxvq_u16(Peak);
+#else
+    uint32_t Peak = 0;
+    uint32_t OverloadCount = 0;
+    uint64_t Squares = 0;
+
+    for (uint32_t Cntr = 0; Cntr < Count; Cntr++)
+    {
+        int32_t Sample = Samples[Cntr];
+        uint32_t Magnitude = (Sample < 0) ? -Sample : Sample;
+        if (Magnitude > Peak)
+            Peak = Magnitude;
+        if (Magnitude > OVERLOAD_LEVEL)
+            OverloadCount++;
+        Squares += (uint64_t)(Sample * Sample);
+    }
+    *SumSquares += Squares;
+    *Overloads = OverloadCount;
+    return Peak;
+#endif
+}
+
+/*
+ * PublishPeak: Passes one DMA's peak level to the GTK meter timer. Never blocks:
+ * if the GUI has fallen behind, the level is discarded.
+ */
+static void PublishPeak(uint32_t Peak, uint32_t Overloads, float Progress, bool First, bool Last)
+{
+    int32_t Slot = SPSCGetWriteSlot(&meter_ring);
+    if (Slot < 0)
+    {
+        atomic_fetch_add(&meter_dropped, 1);
+        return;
     }
+    meter_blocks[Slot].Peak = Peak;
+    meter_blocks[Slot].Overloads = Overloads;
+    meter_blocks[Slot].Progress = Progress;
+    meter_blocks[Slot].First = First;
+    meter_blocks[Slot].Last = Last;
+    SPSCPublish(&meter_ring);
 }
 
 /*
@@ -531,33 +615,65 @@ void CreateSpkTestData(char *MemPtr, uint32_t Samples, float StartFreq, float Fr
 }
 
 /*
- * DMAWriteToCodec: Writes data to codec via DMA.
+ * WriteCodecTransfer: Writes one DMA_TRANSFER_SIZE block to the codec, once the speaker FIFO has space.
+ * @param DMACount: Transfer number, for error messages.
  */
-void DMAWriteToCodec(AudioContext *audio, char *MemPtr, uint32_t Length)
+static void WriteCodecTransfer(AudioContext *audio, char *MemPtr, uint32_t DMACount)
 {
-    if (!hardware_available) return; // Skip if hardware is unavailable
     uint32_t Depth = 0, Spare;
     bool FIFOOverflow, OverThreshold, Underflow;
-    uint32_t DMACount, TotalDMACount = Length / DMA_TRANSFER_SIZE;
     struct pollfd pfd = { .fd = audio->dma_write_fd, .events = POLLOUT };
 
-    printf("DMAWriteToCodec: Starting %u transfers\n", TotalDMACount);
-    for (DMACount = 0; DMACount < TotalDMACount; DMACount++)
+    Depth = ReadFIFOMonitorChannel(eSpkCodecDMA, &FIFOOverflow, &OverThreshold, &Underflow, &Spare);
+    while (Depth < DMA_WORDS_PER_DMA)
     {
+        if (poll(&pfd, 1, 1000) < 0)
+        {
+            fprintf(stderr, "Poll error on DMA write: %s\n", strerror(errno));
+            break;
+        }
         Depth = ReadFIFOMonitorChannel(eSpkCodecDMA, &FIFOOverflow, &OverThreshold, &Underflow, &Spare);
-        while (Depth < DMA_WORDS_PER_DMA)
+    }
+    if (DMAWriteToFPGA(audio->dma_write_fd, (unsigned char *)MemPtr, DMA_TRANSFER_SIZE, AXI_BASE_ADDRESS) < 0)
+        fprintf(stderr, "DMAWriteToFPGA failed at transfer %u\n", DMACount);
+}
+
+/*
+ * ReadCodecTransfer: Reads one DMA_TRANSFER_SIZE block from the codec, once the mic FIFO holds it.
+ * @param DMACount: Transfer number, for error messages.
+ */
+static void ReadCodecTransfer(AudioContext *audio, char *MemPtr, uint32_t DMACount)
+{
+    uint32_t Depth = 0, Spare;
+    bool FIFOOverflow, OverThreshold, Underflow;
+    struct pollfd pfd = { .fd = audio->dma_read_fd, .events = POLLIN };
+
+    Depth = ReadFIFOMonitorChannel(eMicCodecDMA, &FIFOOverflow, &OverThreshold, &Underflow, &Spare);
+    while (Depth < DMA_WORDS_PER_DMA)
+    {
+        if (poll(&pfd, 1, 1000) < 0)
         {
-            if (poll(&pfd, 1, 1000) < 0)
-            {
-                fprintf(stderr, "Poll error on DMA write: %s\n", strerror(errno));
-                break;
-            }
-            Depth = ReadFIFOMonitorChannel(eSpkCodecDMA, &FIFOOverflow, &OverThreshold, &Underflow, &Spare);
+            fprintf(stderr, "Poll error on DMA read: %s\n", strerror(errno));
+            break;
         }
-        if (DMAWriteToFPGA(audio->dma_write_fd, (unsigned char *)MemPtr, DMA_TRANSFER_SIZE, AXI_BASE_ADDRESS) < 0)
-            fprintf(stderr, "DMAWriteToFPGA failed at transfer %u\n", DMACount);
-//        else
-//            printf("DMAWriteToCodec: Completed transfer %u\n", DMACount);
+        Depth = ReadFIFOMonitorChannel(eMicCodecDMA, &FIFOOverflow, &OverThreshold, &Underflow, &Spare);
+    }
+    if (DMAReadFromFPGA(audio->dma_read_fd, (unsigned char *)MemPtr, DMA_TRANSFER_SIZE, AXI_BASE_ADDRESS) < 0)
+        fprintf(stderr, "DMAReadFromFPGA failed at transfer %u\n", DMACount);
+}
+
+/*
+ * DMAWriteToCodec: Writes data to codec via DMA.
+ */
+void DMAWriteToCodec(AudioContext *audio, char *MemPtr, uint32_t Length)
+{
+    if (!hardware_available) return; // Skip if hardware is unavailable
+    uint32_t DMACount, TotalDMACount = Length / DMA_TRANSFER_SIZE;
+
+    printf("DMAWriteToCodec: Starting %u transfers\n", TotalDMACount);
+    for (DMACount = 0; DMACount < TotalDMACount; DMACount++)
+    {
+        WriteCodecTransfer(audio, MemPtr, DMACount);
         MemPtr += DMA_TRANSFER_SIZE;
     }
     printf("DMAWriteToCodec: Finished %u transfers\n", TotalDMACount);
@@ -588,83 +704,366 @@ void CopyMicToSpeaker(char *Read, char *Write, uint32_t Length)
 void DMAReadFromCodec(AppContext *app, AudioContext *audio, char *MemPtr, uint32_t Length)
 {
     if (!hardware_available) return; // Skip if hardware is unavailable
-    uint32_t Depth = 0, Spare;
-    bool FIFOOverflow, OverThreshold, Underflow;
     uint32_t DMACount, TotalDMACount = Length / DMA_TRANSFER_SIZE;
-    int16_t *MicReadPtr = (int16_t *)MemPtr;
-    float PeakLevel = 0.0;
-    float PeakdBFS = -60.0;
-    bool Overload = false;
-    bool NearPeak = false;
-    const float NEAR_PEAK_10DB = 100.0 * pow(10.0, -10.0 / 20.0); // ~31.62%
-    struct pollfd pfd = { .fd = audio->dma_read_fd, .events = POLLIN };
-    struct timespec last_update = {0, 0};
+    uint32_t PeakLevel, Overloads;
+    uint32_t MaxPeakLevel = 0;
+    uint64_t SumSquares = 0;
 
     printf("DMAReadFromCodec: Starting %u transfers\n", TotalDMACount);
+    atomic_store(&meter_dropped, 0);
     for (DMACount = 0; DMACount < TotalDMACount; DMACount++)
     {
-        Depth = ReadFIFOMonitorChannel(eMicCodecDMA, &FIFOOverflow, &OverThreshold, &Underflow, &Spare);
-        while (Depth < DMA_WORDS_PER_DMA)
+        ReadCodecTransfer(audio, MemPtr, DMACount);
+
+        // measure the samples in place in the record buffer, and pass the peak to the GUI
+        PeakLevel = MeasurePeak((const int16_t *)MemPtr, DMA_TRANSFER_SIZE / 2, &SumSquares, &Overloads);
+        if (PeakLevel > MaxPeakLevel)
+            MaxPeakLevel = PeakLevel;
+        PublishPeak(PeakLevel, Overloads, (float)DMACount / TotalDMACount, DMACount == 0, false);
+        MemPtr += DMA_TRANSFER_SIZE;
+    }
+    PublishPeak(0, 0, 1.0, false, true);
+    printf("DMAReadFromCodec: Finished %u transfers; peak %.1f dBFS, RMS %.1f dBFS\n", TotalDMACount,
+           20.0 * log10((double)MaxPeakLevel / 32768.0 + 1e-6),
+           10.0 * log10((double)SumSquares / ((double)TotalDMACount * DMA_TRANSFER_SIZE / 2) / (32768.0 * 32768.0) + 1e-12));
+    if (atomic_load(&meter_dropped) != 0)
+        printf("DMAReadFromCodec: %u peak levels not displayed\n", atomic_load(&meter_dropped));
+}
+
+/*
+ * Streaming record and playback.
+ * Two STREAM_BLOCK_SIZE halves are passed between the DMA loop and a file thread:
+ * the DMA loop fills (or empties) one half while the file thread writes (or reads)
+ * the other, so memory use stays constant however long the test runs.
+ */
+typedef struct
+{
+    char *Half[2];                   // The two halves of the stream buffer
+    uint32_t Length[2];              // Bytes of data in each half; 0 marks the end of the stream
+    sem_t Free[2];                   // Posted when a half may be filled
+    sem_t Full[2];                   // Posted when a half holds data
+    FILE *File;                      // Recording or playback file
+    uint32_t Channels;               // Playback file channels (1 or 2)
+    uint32_t Stalls;                 // Times the DMA loop waited for the file thread
+    volatile bool Stop;              // Playback: reader thread ends the stream early
+    bool Failed;                     // File thread hit an I/O error
+} StreamBuffer;
+
+/*
+ * StreamCreate: Allocates and initialises a stream buffer.
+ * @return: false if the buffers can't be allocated.
+ */
+static bool StreamCreate(StreamBuffer *Stream, FILE *File)
+{
+    memset(Stream, 0, sizeof(StreamBuffer));
+    Stream->File = File;
+    for (int i = 0; i < 2; i++)
+    {
+        if (posix_memalign((void **)&Stream->Half[i], ALIGNMENT, STREAM_BLOCK_SIZE) != 0)
         {
-            if (poll(&pfd, 1, 1000) < 0)
-            {
-                fprintf(stderr, "Poll error on DMA read: %s\n", strerror(errno));
-                break;
-            }
-            Depth = ReadFIFOMonitorChannel(eMicCodecDMA, &FIFOOverflow, &OverThreshold, &Underflow, &Spare);
+            Stream->Half[i] = NULL;
+            return false;
         }
-        if (DMAReadFromFPGA(audio->dma_read_fd, (unsigned char *)MemPtr, DMA_TRANSFER_SIZE, AXI_BASE_ADDRESS) < 0)
-            fprintf(stderr, "DMAReadFromFPGA failed at transfer %u\n", DMACount);
-//        else
-//            printf("DMAReadFromCodec: Completed transfer %u\n", DMACount);
-
-        // find max sample level in the recent DMA transfer
-        PeakLevel = 0.0;
-        for (uint32_t SampleCntr = 0; SampleCntr < DMA_TRANSFER_SIZE / 2; SampleCntr++)
+        sem_init(&Stream->Free[i], 0, 1);
+        sem_init(&Stream->Full[i], 0, 0);
+    }
+    return true;
+}
+
+/*
+ * StreamDestroy: Frees a stream buffer.
+ */
+static void StreamDestroy(StreamBuffer *Stream)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        if (Stream->Half[i] == NULL)
+            continue;
+        free(Stream->Half[i]);
+        sem_destroy(&Stream->Free[i]);
+        sem_destroy(&Stream->Full[i]);
+    }
+}
+
+/*
+ * StreamGetHalf: DMA loop side: waits for a half to become available, counting a stall if it wasn't.
+ */
+static void StreamGetHalf(StreamBuffer *Stream, sem_t *Sem)
+{
+    if (sem_trywait(Sem) == 0)
+        return;
+    Stream->Stalls++;
+    while (sem_wait(Sem) != 0)
+        ;
+}
+
+/*
+ * PutLE16, PutLE32, GetLE16, GetLE32: WAV header fields (little endian, unaligned)
+ */
+static void PutLE16(uint8_t *Ptr, uint16_t Value) { Ptr[0] = Value; Ptr[1] = Value >> 8; }
+static void PutLE32(uint8_t *Ptr, uint32_t Value) { PutLE16(Ptr, Value); PutLE16(Ptr + 2, Value >> 16); }
+static uint16_t GetLE16(const uint8_t *Ptr) { return Ptr[0] | (Ptr[1] << 8); }
+static uint32_t GetLE32(const uint8_t *Ptr) { return GetLE16(Ptr) | ((uint32_t)GetLE16(Ptr + 2) << 16); }
+
+/*
+ * WriteWavHeader: Writes a 44 byte header for 16 bit PCM at SAMPLE_RATE.
+ * @param DataBytes: Size of the sample data following the header.
+ */
+static void WriteWavHeader(FILE *File, uint32_t Channels, uint32_t DataBytes)
+{
+    uint8_t Header[44];
+    uint32_t ByteRate = SAMPLE_RATE * Channels * 2;
+
+    memcpy(Header, "RIFF", 4);
+    PutLE32(Header + 4, DataBytes + 36);
+    memcpy(Header + 8, "WAVEfmt ", 8);
+    PutLE32(Header + 16, 16);                              // fmt chunk size
+    PutLE16(Header + 20, 1);                               // PCM
+    PutLE16(Header + 22, Channels);
+    PutLE32(Header + 24, SAMPLE_RATE);
+    PutLE32(Header + 28, ByteRate);
+    PutLE16(Header + 32, Channels * 2);                    // bytes per frame
+    PutLE16(Header + 34, 16);                              // bits per sample
+    memcpy(Header + 36, "data", 4);
+    PutLE32(Header + 40, DataBytes);
+    fwrite(Header, 1, sizeof(Header), File);
+}
+
+/*
+ * ReadWavHeader: Checks a WAV file is 16 bit PCM at SAMPLE_RATE, and leaves the file at its sample data.
+ * @return: Number of channels (1 or 2), or 0 if the file can't be played.
+ */
+static uint32_t ReadWavHeader(FILE *File)
+{
+    uint8_t Chunk[8];
+    uint8_t Format[16];
+    uint32_t Channels = 0;
+
+    if (fread(Chunk, 1, 8, File) != 8 || memcmp(Chunk, "RIFF", 4) != 0 ||
+        fread(Chunk, 1, 4, File) != 4 || memcmp(Chunk, "WAVE", 4) != 0)
+        return 0;
+    while (fread(Chunk, 1, 8, File) == 8)
+    {
+        uint32_t Size = GetLE32(Chunk + 4);
+        if (memcmp(Chunk, "fmt ", 4) == 0 && Size >= sizeof(Format))
         {
-            int MicSample = *MicReadPtr++;
-//            float SampleLevel = (float)abs(MicSample) / 32767.0 * 100.0;
-            float SampleLevel = fabs((float)MicSample) / 32768.0 * 100.0;   // 0 to 100. (mic sample can be -32768 to +32767)
-            if (SampleLevel > PeakLevel) 
-            {
-                PeakLevel = SampleLevel;
-            }
-            if (SampleLevel > 99.5) 
-            {
-                Overload = true;
-                printf("Overload detected: SampleLevel=%.2f%%\n", SampleLevel);
-            }
-            if (SampleLevel >= NEAR_PEAK_10DB && SampleLevel < 99.5) NearPeak = true;
+            if (fread(Format, 1, sizeof(Format), File) != sizeof(Format))
+                return 0;
+            Channels = GetLE16(Format + 2);
+            if (GetLE16(Format) != 1 || GetLE32(Format + 4) != SAMPLE_RATE ||
+                GetLE16(Format + 14) != 16 || (Channels != 1 && Channels != 2))
+                return 0;
+            Size -= sizeof(Format);
         }
-        peak_buffer[peak_buffer_index] = PeakLevel;
-        peak_buffer_index = (peak_buffer_index + 1) % CIRCULAR_BUFFER_SIZE;
-        MemPtr += DMA_TRANSFER_SIZE;
+        else if (memcmp(Chunk, "data", 4) == 0)
+            return Channels;
+        if (fseek(File, Size + (Size & 1), SEEK_CUR) != 0)
+            return 0;
+    }
+    return 0;
+}
 
-        if (DMACount % DMA_DISP_UPDATE == 0)
+/*
+ * StreamWriterThread: Writes each filled half of the stream buffer to the recording file.
+ */
+static void *StreamWriterThread(void *arg)
+{
+    StreamBuffer *Stream = (StreamBuffer *)arg;
+
+    for (int Half = 0; ; Half ^= 1)
+    {
+        while (sem_wait(&Stream->Full[Half]) != 0)
+            ;
+        uint32_t Length = Stream->Length[Half];
+        if (Length != 0 && fwrite(Stream->Half[Half], 1, Length, Stream->File) != Length)
+            Stream->Failed = true;
+        sem_post(&Stream->Free[Half]);
+        if (Length == 0)
+            break;
+    }
+    return NULL;
+}
+
+/*
+ * StreamReaderThread: Fills each free half of the stream buffer from the playback file,
+ * converted to speaker DMA format: 32 bit words, L in the low 16 bits. Mono is sent to both channels.
+ */
+static void *StreamReaderThread(void *arg)
+{
+    StreamBuffer *Stream = (StreamBuffer *)arg;
+    uint32_t Frames = STREAM_BLOCK_SIZE / 4;
+    uint32_t Length;
+
+    for (int Half = 0; ; Half ^= 1)
+    {
+        while (sem_wait(&Stream->Free[Half]) != 0)
+            ;
+        uint32_t *Words = (uint32_t *)Stream->Half[Half];
+        if (Stream->Stop)
+            Length = 0;
+        else if (Stream->Channels == 2)
+            Length = fread(Words, 4, Frames, Stream->File) * 4;
+        else
         {
-            struct timespec now;
-            clock_gettime(CLOCK_MONOTONIC, &now);
-            long long elapsed_ns = (now.tv_sec - last_update.tv_sec) * 1000000000LL + (now.tv_nsec - last_update.tv_nsec);
-            if (elapsed_ns >= MIN_UPDATE_INTERVAL || DMACount == TotalDMACount - 1)
-            {
-                // Find max peak level in circular buffer
-                float MaxPeakLevel = 0.0;
-                for (int i = 0; i < CIRCULAR_BUFFER_SIZE; i++) 
-                {
-                    if (peak_buffer[i] > MaxPeakLevel) 
-                        MaxPeakLevel = peak_buffer[i];
-                }
-                PeakdBFS = 20.0 * log10(MaxPeakLevel / 100.0 + 1e-6);   // min = -60dBFS
-                float ProgressFraction = 100.0 * (float)DMACount / TotalDMACount;
-                MyStatusCallback(app, ProgressFraction, MaxPeakLevel, PeakdBFS, Overload, NearPeak);
-                last_update = now;
-                Overload = false; // Reset after update (latch handled by timer)
-                NearPeak = MaxPeakLevel >= NEAR_PEAK_10DB; // Persist near-peak based on max peak
-            }
+            // read mono into the top half of the buffer, then expand upwards in place
+            uint16_t *Samples = (uint16_t *)(Stream->Half[Half] + STREAM_BLOCK_SIZE / 2);
+            uint32_t Count = fread(Samples, 2, Frames, Stream->File);
+            for (uint32_t Cntr = 0; Cntr < Count; Cntr++)
+                Words[Cntr] = ((uint32_t)Samples[Cntr] << 16) | Samples[Cntr];
+            Length = Count * 4;
         }
+        if (Length == 0 && ferror(Stream->File))
+            Stream->Failed = true;
+        Stream->Length[Half] = Length;
+        sem_post(&Stream->Full[Half]);
+        if (Length == 0)
+            break;
     }
-    printf("DMAReadFromCodec: Finished %u transfers\n", TotalDMACount);
-    MyStatusCallback(app, 100.0, 0.0, -60.0, false, false);
+    return NULL;
+}
+
+/*
+ * StreamRecordToFile: Records the mic to a mono WAV file for a given time, through the stream buffer.
+ * @param Seconds: Recording duration.
+ * @return: true if the whole recording was written.
+ */
+static bool StreamRecordToFile(AudioContext *audio, const char *Filename, uint32_t Seconds)
+{
+    StreamBuffer Stream;
+    pthread_t Writer;
+    uint64_t TotalDMACount = ((uint64_t)Seconds * SAMPLE_RATE * 2 + DMA_TRANSFER_SIZE - 1) / DMA_TRANSFER_SIZE;
+    uint64_t DMACount = 0;
+    uint64_t SumSquares = 0;
+    uint32_t PeakLevel, MaxPeakLevel = 0, Overloads, TotalOverloads = 0;
+    bool Result;
+    FILE *File = fopen(Filename, "wb");
+
+    if (File == NULL)
+    {
+        fprintf(stderr, "Can't create %s: %s\n", Filename, strerror(errno));
+        return false;
+    }
+    WriteWavHeader(File, 1, 0);                             // sizes filled in at the end
+    if (!StreamCreate(&Stream, File) || pthread_create(&Writer, NULL, StreamWriterThread, &Stream) != 0)
+    {
+        fprintf(stderr, "Can't allocate the stream buffer\n");
+        StreamDestroy(&Stream);
+        fclose(File);
+        return false;
+    }
+
+    printf("Recording %us of mic audio to %s\n", Seconds, Filename);
+    ResetDMAStreamFIFO(eMicCodecDMA);
+    int Half = 0;
+    while (DMACount < TotalDMACount)
+    {
+        StreamGetHalf(&Stream, &Stream.Free[Half]);
+        char *MemPtr = Stream.Half[Half];
+        uint32_t Length = 0;
+        while (Length < STREAM_BLOCK_SIZE && DMACount < TotalDMACount)
+        {
+            ReadCodecTransfer(audio, MemPtr, (uint32_t)DMACount);
+            PeakLevel = MeasurePeak((const int16_t *)MemPtr, DMA_TRANSFER_SIZE / 2, &SumSquares, &Overloads);
+            if (PeakLevel > MaxPeakLevel)
+                MaxPeakLevel = PeakLevel;
+            TotalOverloads += Overloads;
+            MemPtr += DMA_TRANSFER_SIZE;
+            Length += DMA_TRANSFER_SIZE;
+            DMACount++;
+        }
+        Stream.Length[Half] = Length;
+        sem_post(&Stream.Full[Half]);
+        Half ^= 1;
+        if (!keep_running)
+            break;
+    }
+
+    // send an empty half to end the writer thread
+    StreamGetHalf(&Stream, &Stream.Free[Half]);
+    Stream.Length[Half] = 0;
+    sem_post(&Stream.Full[Half]);
+    pthread_join(Writer, NULL);
+
+    uint64_t DataBytes = DMACount * DMA_TRANSFER_SIZE;
+    rewind(File);
+    WriteWavHeader(File, 1, (uint32_t)DataBytes);
+    Result = !Stream.Failed && (fclose(File) == 0);
+    printf("Recorded %.1fs: peak %.1f dBFS, RMS %.1f dBFS, %u overloaded samples, %u writer stalls%s\n",
+           (double)DataBytes / (SAMPLE_RATE * 2),
+           20.0 * log10((double)MaxPeakLevel / 32768.0 + 1e-6),
+           10.0 * log10((double)SumSquares / ((double)DataBytes / 2 + 1) / (32768.0 * 32768.0) + 1e-12),
+           TotalOverloads, Stream.Stalls, Result ? "" : "; FILE WRITE FAILED");
+    StreamDestroy(&Stream);
+    return Result;
+}
+
+/*
+ * StreamPlayFromFile: Plays a 16 bit, SAMPLE_RATE, mono or stereo WAV file to the speaker, through the stream buffer.
+ * @return: true if the whole file was played.
+ */
+static bool StreamPlayFromFile(AudioContext *audio, const char *Filename)
+{
+    StreamBuffer Stream;
+    pthread_t Reader;
+    uint32_t DMACount = 0;
+    uint32_t Channels;
+    bool Result;
+    FILE *File = fopen(Filename, "rb");
+
+    if (File == NULL)
+    {
+        fprintf(stderr, "Can't open %s: %s\n", Filename, strerror(errno));
+        return false;
+    }
+    Channels = ReadWavHeader(File);
+    if (Channels == 0)
+    {
+        fprintf(stderr, "%s is not a 16 bit %dHz PCM WAV file\n", Filename, SAMPLE_RATE);
+        fclose(File);
+        return false;
+    }
+    if (!StreamCreate(&Stream, File))
+    {
+        fprintf(stderr, "Can't allocate the stream buffer\n");
+        StreamDestroy(&Stream);
+        fclose(File);
+        return false;
+    }
+    Stream.Channels = Channels;
+    if (pthread_create(&Reader, NULL, StreamReaderThread, &Stream) != 0)
+    {
+        fprintf(stderr, "Can't start the file reader thread\n");
+        StreamDestroy(&Stream);
+        fclose(File);
+        return false;
+    }
+
+    printf("Playing %s (%s) to the speaker\n", Filename, Channels == 1 ? "mono" : "stereo");
+    ResetDMAStreamFIFO(eSpkCodecDMA);
+    for (int Half = 0; ; Half ^= 1)
+    {
+        StreamGetHalf(&Stream, &Stream.Full[Half]);
+        uint32_t Length = Stream.Length[Half];
+        if (Length == 0)
+            break;
+        if (Length % DMA_TRANSFER_SIZE != 0)                // pad the last transfer with silence
+        {
+            memset(Stream.Half[Half] + Length, 0, DMA_TRANSFER_SIZE - Length % DMA_TRANSFER_SIZE);
+            Length += DMA_TRANSFER_SIZE - Length % DMA_TRANSFER_SIZE;
+        }
+        for (uint32_t Offset = 0; Offset < Length; Offset += DMA_TRANSFER_SIZE)
+            WriteCodecTransfer(audio, Stream.Half[Half] + Offset, DMACount++);
+        sem_post(&Stream.Free[Half]);
+        if (!keep_running)
+            Stream.Stop = true;                             // reader ends the stream after its current half
+    }
+    pthread_join(Reader, NULL);
+    Result = !Stream.Failed;
+    printf("Played %.1fs, %u reader stalls%s\n", (double)DMACount * DMA_TRANSFER_SIZE / (SAMPLE_RATE * 4),
+           Stream.Stalls, Result ? "" : "; FILE READ FAILED");
+    StreamDestroy(&Stream);
+    fclose(File);
+    return Result;
 }
 
 /*
@@ -800,24 +1199,6 @@ void *MicTest(void *arg)
                 set_mic_test_initiated(audio, false);
                 continue;
             }
-            // Reset circular buffer
-            for (int i = 0; i < CIRCULAR_BUFFER_SIZE; i++) 
-            {
-                peak_buffer[i] = 0.0;
-            }
-            peak_buffer_index = 0;
-
-            ProgressUpdateData *data = g_new(ProgressUpdateData, 1);
-            data->progress_bar = app->mic_progress_bar;
-            data->level_bar = app->mic_level_bar;
-            data->overload_label = app->overload_label;
-            data->near_peak_label = app->near_peak_label;
-            data->progress_fraction = 0.0;
-            data->level_fraction = 0.0;
-            data->overload_dbfs = 0.0;
-            data->near_peak_dbfs = 0.0;
-            g_idle_add(update_progress_bars, data);
-
             double Gain = app->line_check ? 
                           (app->gain_spin ? gtk_spin_button_get_value(app->gain_spin) : 0.0) : 
                           (app->mic_gain_scale ? gtk_range_get_value((GtkRange *)app->mic_gain_scale) : 0.0);
@@ -877,10 +1258,7 @@ void *SpeakerTest(void *arg)
                 set_speaker_test_initiated(audio, false, is_left);
                 continue;
             }
-            double Ampl;
-            pthread_mutex_lock(&volume_mutex);
-            Ampl = global_volume; // Read current volume
-            pthread_mutex_unlock(&volume_mutex);
+            double Ampl = atomic_load(&global_volume); // Read current volume
             printf("SpeakerTest using volume: %.2f\n", Ampl); // Debug output
             float Freq = is_left ? 400.0 : 1000.0;
             float FreqRamp = 0.0;
@@ -935,8 +1313,60 @@ void *CheckForPttPressed(void *arg)
     return NULL;
 }
 
+/*
+ * stream_sig_handler: Ends a streaming record or playback early on ctrl-C.
+ */
+static void stream_sig_handler(int signo)
+{
+    keep_running = false;
+}
+
+/*
+ * RunStreaming: Streaming record and/or playback without the GUI, for tests longer than MEM_BUFFER_SIZE.
+ * @param RecordFile: WAV file to record the mic to, or NULL.
+ * @param PlayFile: WAV file to play to the speaker (after any recording), or NULL.
+ * @param Seconds: Recording duration.
+ * @param Gain: Mic/line input gain in dB.
+ * @return: Process exit status.
+ */
+static int RunStreaming(const char *RecordFile, const char *PlayFile, uint32_t Seconds, double Gain)
+{
+    AudioContext audio = {0};
+    bool Result = true;
+
+    check_background_apps(NULL);
+    if (!OpenXDMADriver(true))
+    {
+        fprintf(stderr, "Failed to open XDMA driver\n");
+        return EXIT_FAILURE;
+    }
+    PrintVersionInfo();
+    CodecInitialise();
+    SetByteSwapping(false);
+    SetSpkrMute(false);
+    SetCodecLineInGain((uint32_t)((Gain + 34.5) / 1.5));
+    audio.dma_write_fd = open("/dev/xdma0_h2c_0", O_WRONLY | O_CLOEXEC);
+    audio.dma_read_fd = open("/dev/xdma0_c2h_0", O_RDONLY | O_CLOEXEC);
+    if (audio.dma_write_fd < 0 || audio.dma_read_fd < 0)
+    {
+        fprintf(stderr, "Failed to open DMA devices\n");
+        cleanup(NULL, &audio);
+        return EXIT_FAILURE;
+    }
+    signal(SIGINT, stream_sig_handler);
+
+    if (RecordFile)
+        Result = StreamRecordToFile(&audio, RecordFile, Seconds);
+    keep_running = true;
+    if (PlayFile && Result)
+        Result = StreamPlayFromFile(&audio, PlayFile);
+    cleanup(NULL, &audio);
+    return Result ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 /*
  * main: Initializes the application and runs the GTK main loop.
+ * With -r or -p it streams to or from a file instead, without the GUI.
  */
 int main(int argc, char *argv[])
 {
@@ -945,12 +1375,47 @@ int main(int argc, char *argv[])
     audio.buffer_size = MEM_BUFFER_SIZE;
     pthread_t ptt_thread, mic_test_thread, speaker_test_thread;
     void *thread_args[2] = {&app, &audio};
+    const char *RecordFile = NULL;
+    const char *PlayFile = NULL;
+    uint32_t StreamSeconds = STREAM_DEFAULT_SECONDS;
+    double StreamGain = 0.0;
+    int Option;
+
+    while ((Option = getopt(argc, argv, "r:p:t:g:h")) != -1)
+    {
+        switch (Option)
+        {
+            case 'r':
+                RecordFile = optarg;
+                break;
+            case 'p':
+                PlayFile = optarg;
+                break;
+            case 't':
+                StreamSeconds = atoi(optarg);
+                break;
+            case 'g':
+                StreamGain = atof(optarg);
+                break;
+            default:
+                printf("usage: audiotest                  run the GUI\n");
+                printf("       audiotest -r <file.wav> [-t <seconds>] [-g <dB>] [-p <file.wav>]\n");
+                printf("-r <file.wav>  record the mic to a mono WAV file (default %ds), streamed to disk\n", STREAM_DEFAULT_SECONDS);
+                printf("-t <seconds>   recording duration\n");
+                printf("-g <dB>        mic/line input gain (-34.5 to 12dB, default 0)\n");
+                printf("-p <file.wav>  play a 16 bit 48KHz mono or stereo WAV file to the speaker, after any recording\n");
+                return (Option == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (RecordFile || PlayFile)
+        return RunStreaming(RecordFile, PlayFile, StreamSeconds, StreamGain);
 
-    // Initialize circular buffer
+    // Initialize circular buffer and the peak level ring
     for (int i = 0; i < CIRCULAR_BUFFER_SIZE; i++) 
     {
         peak_buffer[i] = 0.0;
     }
+    SPSCInitialise(&meter_ring, METER_RING_SIZE);
 
     gtk_init(&argc, &argv);
 
@@ -1111,75 +1576,6 @@ int main(int argc, char *argv[])
         gtk_label_set_text(app.ptt_label, "No PTT");
     }
 
-    // Initialize CodecRegMutex since CodecWriteInit is not available
-    if (sem_init(&CodecRegMutex, 0, 1) != 0) 
-    {
-        fprintf(stderr, "Failed to init CodecRegMutex: %s\n", strerror(errno));
-        hardware_available = false;
-        cleanup(&app, &audio);
-        return EXIT_FAILURE;
-    }
-    else
-    {
-        printf("CodecRegMutex initialized\n");
-    }
-
-    printf("Initializing synchronization primitives...\n");
-    if (sem_init(&DDCInSelMutex, 0, 1) != 0) 
-    {
-        fprintf(stderr, "Failed to init DDCInSelMutex: %s\n", strerror(errno));
-        hardware_available = false;
-        cleanup(&app, &audio);
-        return EXIT_FAILURE;
-    }
-    else
-    {
-        printf("DDCInSelMutex initialized\n");
-    }
-    if (sem_init(&DDCResetFIFOMutex, 0, 1) != 0) 
-    {
-        fprintf(stderr, "Failed to init DDCResetFIFOMutex: %s\n", strerror(errno));
-        hardware_available = false;
-        cleanup(&app, &audio);
-        return EXIT_FAILURE;
-    }
-    else
-    {
-        printf("DDCResetFIFOMutex initialized\n");
-    }
-    if (sem_init(&RFGPIOMutex, 0, 1) != 0) 
-    {
-        fprintf(stderr, "Failed to init RFGPIOMutex: %s\n", strerror(errno));
-        hardware_available = false;
-        cleanup(&app, &audio);
-        return EXIT_FAILURE;
-    }else
-    {
-        printf("RFGPIOMutex initialized\n");
-    }
-    if (pthread_mutex_init(&audio.mic_test_mutex, NULL) != 0)
-    {
-        fprintf(stderr, "Failed to init mic_test_mutex: %s\n", strerror(errno));
-        hardware_available = false;
-        cleanup(&app, &audio);
-        return EXIT_FAILURE;
-    }
-    else
-    {
-        printf("mic_test_mutex initialized\n");
-    }
-    if (pthread_mutex_init(&audio.speaker_test_mutex, NULL) != 0)
-    {
-        fprintf(stderr, "Failed to init speaker_test_mutex: %s\n", strerror(errno));
-        hardware_available = false;
-        cleanup(&app, &audio);
-        return EXIT_FAILURE;
-    }
-    else
-    {
-        printf("speaker_test_mutex initialized\n");
-    }
-
     printf("Checking hardware availability...\n");
     if (!OpenXDMADriver(true)) 
     {
@@ -1320,6 +1716,7 @@ int main(int argc, char *argv[])
         printf("Speaker test thread created\n");
     }
 
+    g_timeout_add(METER_REFRESH_MS, meter_timer, &app);
     printf("Entering gtk_main()...\n");
     gtk_main();
 
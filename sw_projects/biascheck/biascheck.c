@@ -15,6 +15,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
@@ -25,6 +26,7 @@
 #include <math.h>
 #include <semaphore.h>
 #include <pthread.h>
+#include <time.h>
 
 
 #include "../common/saturntypes.h"
@@ -46,6 +48,8 @@ GtkStatusbar      *StatusBar;
 GtkToggleButton *TXCheck;
 GtkEntry *DriverCurrentText;
 GtkEntry *PACurrentText;
+GtkLabel *DriverRangeText;
+GtkLabel *PARangeText;
 //
 // mem read/write variables:
 //
@@ -56,13 +60,29 @@ gboolean GPTTPressed;               // true if in TX
 #define VALIGNMENT 4096
 
 
+//
+// current sampling: the sampling thread reads both currents every VSAMPLEPERIOD,
+// and at the end of each window of VWINDOWSAMPLES readings publishes their mean, min and max.
+// the GUI timer copies the latest published window; neither ever waits for the other.
+// the copy is guarded by a sequence count, as for the telemetry snapshot.
+//
+#define VSAMPLEPERIOD 1000000                           // 1ms (in ns): 1KHz sampling
+#define VWINDOWSAMPLES 100                              // 100ms window
+#define VDISPLAYPERIOD 100                              // GUI update interval (ms)
+
+struct CurrentWindow
+{
+    float DriverMean, DriverMin, DriverMax;             // driver current (A)
+    float PAMean, PAMin, PAMax;                         // PA current (A)
+    uint32_t Count;                                     // windows published; 0 if none yet
+};
+
+struct CurrentWindow GLatestWindow;                     // most recent window
+uint32_t GWindowSequence;                               // odd while GLatestWindow is being written
+
 
 
 
-extern sem_t DDCInSelMutex;                 // protect access to shared DDC input select register
-extern sem_t DDCResetFIFOMutex;             // protect access to FIFO reset register
-extern sem_t RFGPIOMutex;                   // protect access to RF GPIO register
-extern sem_t CodecRegMutex;                 // protect writes to codec
 
 
 
@@ -103,10 +123,6 @@ void on_TXButton_toggled()
 void on_window_main_destroy()
 {
     gtk_main_quit();
-	sem_destroy(&DDCInSelMutex);
-	sem_destroy(&DDCResetFIFOMutex);
-	sem_destroy(&RFGPIOMutex);
-	sem_destroy(&CodecRegMutex);
 	SetMOX(false);
 	SetTXEnable(false);
 }
@@ -124,35 +140,126 @@ void on_close_button_clicked()
 
 
 
-// this runs as its own thread to read PA and bias currents periodically
+//
+// publish a window of readings. Called only by the sampling thread.
+//
+void PublishWindow(struct CurrentWindow* Window)
+{
+    uint32_t Sequence;
+
+    Sequence = __atomic_load_n(&GWindowSequence, __ATOMIC_RELAXED);
+    __atomic_store_n(&GWindowSequence, Sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&GLatestWindow, Window, sizeof(GLatestWindow));
+    __atomic_store_n(&GWindowSequence, Sequence + 2, __ATOMIC_RELEASE);
+}
+
+
+//
+// copy the most recently published window
+//
+void GetLatestWindow(struct CurrentWindow* Window)
+{
+    uint32_t Before, After;
+
+    do
+    {
+        Before = __atomic_load_n(&GWindowSequence, __ATOMIC_ACQUIRE);
+        memcpy(Window, &GLatestWindow, sizeof(*Window));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        After = __atomic_load_n(&GWindowSequence, __ATOMIC_RELAXED);
+    } while((Before != After) || (Before & 1));
+}
+
+
+
+// this runs as its own thread to sample PA and bias currents
 // thread initiated at the start.
-// done in a thread so GUI event handlers not hung
+// done in a thread so GUI event handlers not hung, and so sampling never waits for the GUI
+// the PA current comes from a telemetry snapshot; the driver current is the 7th analogue
+// register, beyond the snapshot, so it takes one more read.
 //
 void* CurrentRead(void *arg)
 {
-	gint Duration;					// record and replay duration in seconds
-	uint32_t PAReading, DriverReading;
+    struct TelemetrySnapshot Snapshot;
+    struct CurrentWindow Window = {0};
+    struct timespec Next;
+	uint32_t DriverReading;
     float PACurrent, DriverCurrent;
-    char DisplayedValue [100];
+    float DriverSum = 0.0F, PASum = 0.0F;
+    uint32_t Samples = 0;
 
+    clock_gettime(CLOCK_MONOTONIC, &Next);
 	while (1)
 	{
-		usleep(100000);												// 100ms wait
-		if(GPTTPressed)
+        Next.tv_nsec += VSAMPLEPERIOD;
+        if(Next.tv_nsec >= 1000000000)
+        {
+            Next.tv_nsec -= 1000000000;
+            Next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &Next, NULL);
+		if(!GPTTPressed)
 		{
-            DriverReading = GetAnalogueIn(6);               // current = ADC reading /1638.4
-            PAReading = GetAnalogueIn(3);                   // current = ADC reading * 0.01387
-            DriverCurrent = (float)DriverReading / 1638.4F;
-            PACurrent = (float)PAReading * PACURRENTSCALE;
-            sprintf(DisplayedValue, "%6.3f", DriverCurrent);
-            gtk_entry_set_text(DriverCurrentText, DisplayedValue);
-            sprintf(DisplayedValue, "%6.2f", PACurrent);
-            gtk_entry_set_text(PACurrentText, DisplayedValue);
-		}
+            Samples = 0;                                // start a new window at the next TX
+            clock_gettime(CLOCK_MONOTONIC, &Next);
+            continue;
+        }
+        ReadTelemetrySnapshot(&Snapshot, true);
+        DriverReading = GetAnalogueIn(6);               // current = ADC reading /1638.4
+        DriverCurrent = (float)DriverReading / 1638.4F;
+        PACurrent = (float)Snapshot.Analogue[3] * PACURRENTSCALE;
+        if(Samples == 0)
+        {
+            DriverSum = 0.0F;
+            PASum = 0.0F;
+            Window.DriverMin = Window.DriverMax = DriverCurrent;
+            Window.PAMin = Window.PAMax = PACurrent;
+        }
+        DriverSum += DriverCurrent;
+        PASum += PACurrent;
+        Window.DriverMin = fminf(Window.DriverMin, DriverCurrent);
+        Window.DriverMax = fmaxf(Window.DriverMax, DriverCurrent);
+        Window.PAMin = fminf(Window.PAMin, PACurrent);
+        Window.PAMax = fmaxf(Window.PAMax, PACurrent);
+        if(++Samples == VWINDOWSAMPLES)
+        {
+            Window.DriverMean = DriverSum / VWINDOWSAMPLES;
+            Window.PAMean = PASum / VWINDOWSAMPLES;
+            Window.Count++;
+            PublishWindow(&Window);
+            Samples = 0;
+        }
 	}
 }
 
 
+//
+// GUI timer: display the latest window of current readings
+//
+gboolean DisplayCurrents(gpointer Data)
+{
+    static uint32_t DisplayedCount = 0;
+    struct CurrentWindow Window;
+    char DisplayedValue [100];
+
+    GetLatestWindow(&Window);
+    if(GPTTPressed && (Window.Count != DisplayedCount))
+    {
+        DisplayedCount = Window.Count;
+        sprintf(DisplayedValue, "%6.3f", Window.DriverMean);
+        gtk_entry_set_text(DriverCurrentText, DisplayedValue);
+        sprintf(DisplayedValue, "%6.2f", Window.PAMean);
+        gtk_entry_set_text(PACurrentText, DisplayedValue);
+        sprintf(DisplayedValue, "min %6.3f  max %6.3f", Window.DriverMin, Window.DriverMax);
+        gtk_label_set_text(DriverRangeText, DisplayedValue);
+        sprintf(DisplayedValue, "min %6.2f  max %6.2f", Window.PAMin, Window.PAMax);
+        gtk_label_set_text(PARangeText, DisplayedValue);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+
 
 //
 // "main" essentially creates the window and attaches event handlers
@@ -172,6 +279,8 @@ int main(int argc, char *argv[])
     TXCheck = GTK_TOGGLE_BUTTON(gtk_builder_get_object(Builder, "TXButton"));
 	DriverCurrentText = GTK_ENTRY(gtk_builder_get_object(Builder, "DriverCurrentBox"));
 	PACurrentText = GTK_ENTRY(gtk_builder_get_object(Builder, "PACurrentBox"));
+	DriverRangeText = GTK_LABEL(gtk_builder_get_object(Builder, "DriverRange"));
+	PARangeText = GTK_LABEL(gtk_builder_get_object(Builder, "PARange"));
 
     gtk_builder_add_callback_symbol (Builder, "on_TXButton_Toggled", G_CALLBACK (on_TXButton_toggled));
     gtk_builder_add_callback_symbol (Builder, "on_window_main_destroy", G_CALLBACK (on_window_main_destroy));
@@ -182,14 +291,6 @@ int main(int argc, char *argv[])
     g_object_unref(Builder);
     gtk_widget_show(Window);                
     Context = gtk_statusbar_get_context_id(StatusBar, "context");
-  //
-  // initialise register access semaphores
-  //
-  	sem_init(&DDCInSelMutex, 0, 1);                                   // for DDC input select register
-  	sem_init(&DDCResetFIFOMutex, 0, 1);                               // for FIFO reset register
-  	sem_init(&RFGPIOMutex, 0, 1);                                     // for RF GPIO register
-  	sem_init(&CodecRegMutex, 0, 1);                                   // for codec writes
-
 	OpenXDMADriver(true);
 	PrintVersionInfo();
 	CodecInitialise();
@@ -212,6 +313,7 @@ int main(int argc, char *argv[])
 
     gtk_entry_set_text(DriverCurrentText, "0.0");
     gtk_entry_set_text(PACurrentText, "0.0");
+    g_timeout_add(VDISPLAYPERIOD, DisplayCurrents, NULL);
 
 
 
@@ -4,6 +4,8 @@
 //
 // ./codectest <frequency in Hz>
 // so for 400 Hz test: command line ./codectest 400
+// ./codectest -latency
+// measures the codec loopback latency, with line out looped to line in
 //
 
 #define _DEFAULT_SOURCE
@@ -44,11 +46,6 @@
 #include "../common/version.h"                      // version I/O for Saturn
 #include "../common/debugaids.h"
 
-extern sem_t DDCInSelMutex;                 // protect access to shared DDC input select register
-extern sem_t DDCResetFIFOMutex;             // protect access to FIFO reset register
-extern sem_t RFGPIOMutex;                   // protect access to RF GPIO register
-extern sem_t CodecRegMutex;                 // protect writes to codec
-
 
 
 #define VALIGNMENT 4096
@@ -238,6 +235,234 @@ void DMAReadFromCodec(unsigned char* MemPtr, uint32_t Length)
 	}
 }
 
+//
+// loopback latency measurement
+// a chirp is played through the speaker DMA while the mic DMA captures, with
+// line out looped to line in. The capture is cross correlated with the chirp to
+// find where it arrived. Two figures are reported:
+// path latency: codec and FIFO delay, in stream samples, corrected for the gap
+//   between starting the two streams;
+// application round trip: from the speaker DMA holding the chirp start being
+//   written to the mic DMA holding it being read, as seen by software.
+//
+#define VLATENCYRUNS 3								// measurements made
+#define VCHIRPSTART 4800							// chirp starts after 100ms silence
+#define VCHIRPLENGTH 4096							// chirp samples
+#define VCHIRPF0 200.0								// chirp start frequency, Hz
+#define VCHIRPF1 8000.0								// chirp end frequency, Hz
+#define VCHIRPAMPLITUDE 0.5F
+#define VLATENCYSPKDMAS 188							// 1s of speaker data (256 samples per DMA)
+#define VLATENCYMICDMAS 94							// 1s of mic data (512 samples per DMA)
+#define VLATENCYMICSAMPLES (VLATENCYMICDMAS * VDMATRANSFERSIZE / 2)
+#define VMINCORRELATION 0.3							// normalised correlation needed to trust a result
+
+int SpkDMA_fd = -1;											// speaker DMA device for latency test
+int MicDMA_fd = -1;											// mic DMA device for latency test
+float Chirp[VCHIRPLENGTH];									// reference chirp, full scale = 1
+struct timespec SpkDMATime[VLATENCYSPKDMAS];				// time each speaker DMA completed
+struct timespec MicDMATime[VLATENCYMICDMAS];				// time each mic DMA completed
+
+
+//
+// time difference in seconds
+//
+double TimeDiff(struct timespec* Later, struct timespec* Earlier)
+{
+	return (double)(Later->tv_sec - Earlier->tv_sec) + (double)(Later->tv_nsec - Earlier->tv_nsec) * 1.0E-9;
+}
+
+
+//
+// create the latency test data: silence, a linear chirp, then silence
+// the chirp is also kept in Chirp[] as the correlation reference
+//
+void CreateChirpData(char* MemPtr, uint32_t Samples)
+{
+	uint32_t* Data;
+	uint32_t Cntr;
+	uint16_t Word;
+	double t, Phase;
+	double Duration = (double)VCHIRPLENGTH / (double)VSAMPLERATE;
+
+	Data = (uint32_t *) MemPtr;
+	for(Cntr=0; Cntr < Samples; Cntr++)
+	{
+		Word = 0;
+		if((Cntr >= VCHIRPSTART) && (Cntr < VCHIRPSTART + VCHIRPLENGTH))
+		{
+			t = (double)(Cntr - VCHIRPSTART) / (double)VSAMPLERATE;
+			Phase = 2.0*M_PI*(VCHIRPF0*t + 0.5*(VCHIRPF1 - VCHIRPF0)*t*t/Duration);
+			Chirp[Cntr - VCHIRPSTART] = sin(Phase);
+			Word = (uint16_t)(int16_t)(32767.0 * VCHIRPAMPLITUDE * sin(Phase));
+		}
+		*Data++ = ((uint32_t)Word << 16) | Word;
+	}
+}
+
+
+//
+// speaker thread for the latency test: write the test data, timestamping each DMA
+//
+void* LatencySpeakerThread(void *arg)
+{
+	char* MemPtr = (char *)arg;
+	uint32_t Depth;
+	bool FIFOOverflow, FIFOOverThreshold, FIFOUnderflowed;
+	uint32_t CurrentCount;
+	uint32_t DMACount;
+
+	for(DMACount = 0; DMACount < VLATENCYSPKDMAS; DMACount++)
+	{
+		Depth = ReadFIFOMonitorChannel(eSpkCodecDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflowed, &CurrentCount);
+		while (Depth < VDMAWORDSPERDMA)				// loop till space available
+		{
+			usleep(250);
+			Depth = ReadFIFOMonitorChannel(eSpkCodecDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflowed, &CurrentCount);
+		}
+		DMAWriteToFPGA(SpkDMA_fd, (unsigned char *)MemPtr, VDMATRANSFERSIZE, VADDRSPKRSTREAMWRITE);
+		clock_gettime(CLOCK_MONOTONIC, &SpkDMATime[DMACount]);
+		MemPtr += VDMATRANSFERSIZE;
+	}
+	return NULL;
+}
+
+
+//
+// find the chirp in the captured mic data by cross correlation
+// returns the sample position of the chirp start (with parabolic interpolation),
+// and the normalised correlation at that point in *Correlation
+//
+double FindChirp(int16_t* Capture, uint32_t Samples, double* Correlation)
+{
+	uint32_t Lag, Cntr, BestLag = 0;
+	uint32_t Lags = Samples - VCHIRPLENGTH + 1;
+	double Sum, Best = 0.0, Energy = 0.0, BestEnergy = 1.0, ChirpEnergy = 0.0;
+	double Prev = 0.0, Next = 0.0, Current, Offset = 0.0;
+	double* Corr;
+
+	Corr = malloc(Lags * sizeof(double));
+	if(Corr == NULL)
+	{
+		*Correlation = 0.0;
+		return 0.0;
+	}
+	for(Cntr = 0; Cntr < VCHIRPLENGTH; Cntr++)
+	{
+		ChirpEnergy += Chirp[Cntr] * Chirp[Cntr];
+		Energy += (double)Capture[Cntr] * (double)Capture[Cntr];
+	}
+	for(Lag = 0; Lag < Lags; Lag++)
+	{
+		Sum = 0.0;
+		for(Cntr = 0; Cntr < VCHIRPLENGTH; Cntr++)
+			Sum += Chirp[Cntr] * (float)Capture[Lag + Cntr];
+		Corr[Lag] = fabs(Sum);
+		if(Corr[Lag] > Best)
+		{
+			Best = Corr[Lag];
+			BestLag = Lag;
+			BestEnergy = Energy;
+		}
+		if(Lag + 1 < Lags)									// slide the capture energy window on
+			Energy += (double)Capture[Lag + VCHIRPLENGTH] * (double)Capture[Lag + VCHIRPLENGTH]
+			        - (double)Capture[Lag] * (double)Capture[Lag];
+	}
+	if((BestLag > 0) && (BestLag + 1 < Lags))
+	{
+		Prev = Corr[BestLag - 1];
+		Current = Corr[BestLag];
+		Next = Corr[BestLag + 1];
+		if((Prev - 2.0*Current + Next) != 0.0)
+			Offset = 0.5 * (Prev - Next) / (Prev - 2.0*Current + Next);
+	}
+	*Correlation = (BestEnergy > 0.0) ? Best / sqrt(ChirpEnergy * BestEnergy) : 0.0;
+	free(Corr);
+	return (double)BestLag + Offset;
+}
+
+
+//
+// run the latency measurement: line out must be looped to line in
+//
+void MeasureLatency(char* WriteBuffer, unsigned char* ReadBuffer)
+{
+	pthread_t SpeakerThread;
+	struct timespec MicStart;
+	uint32_t Depth;
+	bool FIFOOverflow, FIFOOverThreshold, FIFOUnderflowed;
+	uint32_t CurrentCount;
+	uint32_t DMACount;
+	uint32_t Run;
+	uint32_t Good = 0;
+	double Position, Correlation, StartGap;
+	double PathLatency, AppLatency;
+	double PathSum = 0.0, AppSum = 0.0;
+
+	SpkDMA_fd = open(VSPKDMADEVICE, O_WRONLY);
+	MicDMA_fd = open(VMICDMADEVICE, O_RDONLY);
+	if((SpkDMA_fd < 0) || (MicDMA_fd < 0))
+	{
+		printf("XDMA speaker or mic device open failed\n");
+		return;
+	}
+	SetMicLineInput(true);
+	CreateChirpData(WriteBuffer, VLATENCYSPKDMAS * VSAMPLEWORDSPERDMA);
+	printf("Latency test: line out must be looped to line in\n");
+
+	for(Run = 0; Run < VLATENCYRUNS; Run++)
+	{
+	//
+	// start both streams together: the mic stream starts at its FIFO reset,
+	// the speaker stream when its first DMA is written
+	//
+		ResetDMAStreamFIFO(eSpkCodecDMA);
+		ResetDMAStreamFIFO(eMicCodecDMA);
+		clock_gettime(CLOCK_MONOTONIC, &MicStart);
+		if(pthread_create(&SpeakerThread, NULL, LatencySpeakerThread, WriteBuffer) != 0)
+		{
+			printf("speaker thread create failed\n");
+			break;
+		}
+		for(DMACount = 0; DMACount < VLATENCYMICDMAS; DMACount++)
+		{
+			Depth = ReadFIFOMonitorChannel(eMicCodecDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflowed, &CurrentCount);
+			while (Depth < VDMAWORDSPERDMA)				// loop till enough data available
+			{
+				usleep(250);
+				Depth = ReadFIFOMonitorChannel(eMicCodecDMA, &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflowed, &CurrentCount);
+			}
+			DMAReadFromFPGA(MicDMA_fd, ReadBuffer + DMACount*VDMATRANSFERSIZE, VDMATRANSFERSIZE, VADDRMICSTREAMREAD);
+			clock_gettime(CLOCK_MONOTONIC, &MicDMATime[DMACount]);
+		}
+		pthread_join(SpeakerThread, NULL);
+
+	//
+	// find the chirp, and work out the two latencies
+	//
+		Position = FindChirp((int16_t *)ReadBuffer, VLATENCYMICSAMPLES, &Correlation);
+		StartGap = TimeDiff(&SpkDMATime[0], &MicStart) * VSAMPLERATE;		// speaker stream start, in mic samples
+		PathLatency = Position - VCHIRPSTART - StartGap;
+		AppLatency = TimeDiff(&MicDMATime[(uint32_t)Position / (VDMATRANSFERSIZE/2)],
+		                      &SpkDMATime[VCHIRPSTART / VSAMPLEWORDSPERDMA]);
+		if(Correlation < VMINCORRELATION)
+		{
+			printf("run %d: chirp not found (correlation %4.2f) - check the loopback and levels\n", Run + 1, Correlation);
+			continue;
+		}
+		printf("run %d: path latency %7.1f samples = %6.2fms; application round trip %6.2fms (correlation %4.2f)\n",
+		       Run + 1, PathLatency, 1000.0 * PathLatency / VSAMPLERATE, 1000.0 * AppLatency, Correlation);
+		PathSum += PathLatency;
+		AppSum += AppLatency;
+		Good++;
+	}
+	if(Good != 0)
+		printf("mean of %d: path latency %7.1f samples = %6.2fms; application round trip %6.2fms\n",
+		       Good, PathSum / Good, 1000.0 * PathSum / Good / VSAMPLERATE, 1000.0 * AppSum / Good);
+	close(SpkDMA_fd);
+	close(MicDMA_fd);
+}
+
+
 
 
 //
@@ -256,10 +481,12 @@ int main(int argc, char *argv[])
 	bool IsXLR = false;
 	int32_t Cntr;
 	float PercentLevel;
+	bool Latency = false;
 
 	if (argc < 2)
 	{
 		printf("Usage: ./codectest <Freq in Hz>\n");
+		printf("       ./codectest -latency   measure loopback latency (line out looped to line in)\n");
 		printf("Optional arguments: \n");
 		printf("-boost: increase mic input gain by 20dB\n");
 		printf("-bias: turn on mic bias\n");
@@ -270,6 +497,11 @@ int main(int argc, char *argv[])
 	else
 	{
 		Frequency = (atoi(argv[1]));
+		if(strcmp(argv[1], "-latency") == 0)
+		{
+			Latency = true;
+			Frequency = 1;
+		}
 		if(argc > 2)
 			for(Cntr = 2; Cntr < argc; Cntr++)
 			{
@@ -302,14 +534,6 @@ int main(int argc, char *argv[])
 	}
 	if(Frequency > 0)
 	{
-  //
-  // initialise register access semaphores
-  //
-  		sem_init(&DDCInSelMutex, 0, 1);                                   // for DDC input select register
-  		sem_init(&DDCResetFIFOMutex, 0, 1);                               // for FIFO reset register
-  		sem_init(&RFGPIOMutex, 0, 1);                                     // for RF GPIO register
-  		sem_init(&CodecRegMutex, 0, 1);                                   // for codec writes
-
 		OpenXDMADriver(false);
 		PrintVersionInfo();
 		CodecInitialise();
@@ -350,6 +574,11 @@ int main(int argc, char *argv[])
 		SetOrionMicOptions(MicRing, EnableBias, true);
 		SetMicBoost(EnableBoost);
 		SetBalancedMicInput(IsXLR);
+		if(Latency)
+		{
+			MeasureLatency(WriteBuffer, ReadBuffer);
+			goto out;
+		}
 
 		printf("resetting FIFO..\n");
 		ResetDMAStreamFIFO(eSpkCodecDMA);
@@ -385,10 +614,6 @@ out:
 		close(DMAWritefile_fd);
 		close(DMAReadfile_fd);
 		free(WriteBuffer);
-  		sem_destroy(&DDCInSelMutex);
-  		sem_destroy(&DDCResetFIFOMutex);
-  		sem_destroy(&RFGPIOMutex);
-  		sem_destroy(&CodecRegMutex);
 	}
 }
 
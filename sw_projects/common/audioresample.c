@@ -0,0 +1,228 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// licenced under GNU GPL3
+//
+// audioresample.c:
+// adaptive fractional resampler for the speaker audio
+//
+//////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <math.h>
+#include "../common/audioresample.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+
+#define VRESAMPLECUTOFF 0.45                    // filter cutoff, fraction of the sample rate
+#define VRESAMPLESMOOTHTIME 0.2                 // FIFO level smoothing time constant, s
+#define VRESAMPLEKP 1.0e-5                      // ratio change per sample of level error
+#define VRESAMPLEKI 2.0e-6                      // ratio change per sample second of level error
+
+//
+// filter table: one row per fractional position. Row k delays by k/VRESAMPLEPHASES of a sample
+//
+static float ResampleCoeffs[VRESAMPLEPHASES][VRESAMPLETAPS] __attribute__((aligned(16)));
+static bool ResampleCoeffsBuilt = false;
+
+
+//
+// windowed sinc rows, Blackman window, each normalised to unity gain at DC
+//
+static void BuildResampleCoeffs(void)
+{
+    uint32_t Phase, Tap;
+    double T, Value, Sum;
+    double Row[VRESAMPLETAPS];
+
+    for (Phase = 0; Phase < VRESAMPLEPHASES; Phase++)
+    {
+        Sum = 0.0;
+        for (Tap = 0; Tap < VRESAMPLETAPS; Tap++)
+        {
+            T = (double)Tap - (VRESAMPLETAPS / 2 - 1) - (double)Phase / VRESAMPLEPHASES;
+            Value = (T == 0.0) ? 1.0 : sin(2.0 * M_PI * VRESAMPLECUTOFF * T) / (2.0 * M_PI * VRESAMPLECUTOFF * T);
+            Value *= 0.42 + 0.5 * cos(2.0 * M_PI * T / VRESAMPLETAPS) + 0.08 * cos(4.0 * M_PI * T / VRESAMPLETAPS);
+            Row[Tap] = Value;
+            Sum += Value;
+        }
+        for (Tap = 0; Tap < VRESAMPLETAPS; Tap++)
+            ResampleCoeffs[Phase][Tap] = (float)(Row[Tap] / Sum);
+    }
+    ResampleCoeffsBuilt = true;
+}
+
+
+void InitialiseAudioResampler(struct AudioResampler* Resampler)
+{
+    if (!ResampleCoeffsBuilt)
+        BuildResampleCoeffs();
+    memset(Resampler, 0, sizeof(struct AudioResampler));
+    Resampler->Fill = VRESAMPLETAPS;            // start with a history of silence
+    Resampler->Step = 1.0;
+}
+
+
+//
+// dot products of one filter row with VRESAMPLETAPS samples
+//
+static inline float DotProductScalar(const float* Samples, const float* Coeffs)
+{
+    float Sum = 0.0f;
+    uint32_t Tap;
+
+    for (Tap = 0; Tap < VRESAMPLETAPS; Tap++)
+        Sum += Samples[Tap] * Coeffs[Tap];
+    return Sum;
+}
+
+
+#if defined(__ARM_NEON)
+static inline float DotProductNEON(const float* Samples, const float* Coeffs)
+{
+    float32x4_t Sum = vdupq_n_f32(0.0f);
+    uint32_t Tap;
+
+    for (Tap = 0; Tap < VRESAMPLETAPS; Tap += 4)
+        Sum = vmlaq_f32(Sum, vld1q_f32(Samples + Tap), vld1q_f32(Coeffs + Tap));
+    return vgetq_lane_f32(Sum, 0) + vgetq_lane_f32(Sum, 1) + vgetq_lane_f32(Sum, 2) + vgetq_lane_f32(Sum, 3);
+}
+#endif
+
+
+//
+// one output value: the two nearest phases, linearly interpolated.
+// the phase after the last is phase 0 one sample on
+//
+static inline float InterpolateSample(const float* Samples, uint32_t Phase, float Frac,
+                                      float (*DotProduct)(const float*, const float*))
+{
+    float First, Second;
+
+    First = DotProduct(Samples, ResampleCoeffs[Phase]);
+    if (Phase + 1 < VRESAMPLEPHASES)
+        Second = DotProduct(Samples, ResampleCoeffs[Phase + 1]);
+    else
+        Second = DotProduct(Samples + 1, ResampleCoeffs[0]);
+    return First + (Second - First) * Frac;
+}
+
+
+//
+// float to 16 bit big endian, rounded and saturated
+//
+static inline void StoreSample(uint8_t* Dest, float Value)
+{
+    int32_t Result;
+
+    Result = (int32_t)lrintf(Value * 32768.0f);
+    if (Result > 32767)
+        Result = 32767;
+    else if (Result < -32768)
+        Result = -32768;
+    Dest[0] = (uint8_t)(Result >> 8);
+    Dest[1] = (uint8_t)Result;
+}
+
+
+static inline uint32_t Resample(struct AudioResampler* Resampler, uint8_t* Dest, const uint8_t* Src, uint32_t Samples,
+                                float (*DotProduct)(const float*, const float*))
+{
+    uint32_t Cntr;
+    uint32_t Index, Phase;
+    uint32_t Written = 0;
+    double Position, Fine;
+    float* Left = Resampler->Left;
+    float* Right = Resampler->Right;
+
+    if (Samples > VRESAMPLEMAXIN)
+        Samples = VRESAMPLEMAXIN;
+    //
+    // add the new samples to the history
+    //
+    for (Cntr = 0; Cntr < Samples; Cntr++, Src += 4)
+    {
+        Left[Resampler->Fill + Cntr] = (float)(int16_t)((Src[0] << 8) | Src[1]) * (1.0f / 32768.0f);
+        Right[Resampler->Fill + Cntr] = (float)(int16_t)((Src[2] << 8) | Src[3]) * (1.0f / 32768.0f);
+    }
+    Resampler->Fill += Samples;
+    //
+    // make output samples while there are enough input samples for both phases
+    //
+    Position = Resampler->Position;
+    while ((uint32_t)Position + VRESAMPLETAPS + 1 <= Resampler->Fill)
+    {
+        Index = (uint32_t)Position;
+        Fine = (Position - Index) * VRESAMPLEPHASES;
+        Phase = (uint32_t)Fine;
+        StoreSample(Dest, InterpolateSample(Left + Index, Phase, (float)(Fine - Phase), DotProduct));
+        StoreSample(Dest + 2, InterpolateSample(Right + Index, Phase, (float)(Fine - Phase), DotProduct));
+        Dest += 4;
+        Written++;
+        Position += Resampler->Step;
+    }
+    //
+    // drop the input samples no longer needed
+    //
+    Index = (uint32_t)Position;
+    memmove(Left, Left + Index, (Resampler->Fill - Index) * sizeof(float));
+    memmove(Right, Right + Index, (Resampler->Fill - Index) * sizeof(float));
+    Resampler->Fill -= Index;
+    Resampler->Position = Position - Index;
+    return Written;
+}
+
+
+uint32_t ResampleAudioScalar(struct AudioResampler* Resampler, uint8_t* Dest, const uint8_t* Src, uint32_t Samples)
+{
+    return Resample(Resampler, Dest, Src, Samples, DotProductScalar);
+}
+
+
+uint32_t ResampleAudio(struct AudioResampler* Resampler, uint8_t* Dest, const uint8_t* Src, uint32_t Samples)
+{
+#if defined(__ARM_NEON)
+    return Resample(Resampler, Dest, Src, Samples, DotProductNEON);
+#else
+    return Resample(Resampler, Dest, Src, Samples, DotProductScalar);
+#endif
+}
+
+
+void SteerAudioResampler(struct AudioResampler* Resampler, double Level, double Target, double Interval)
+{
+    double Error, Correction;
+    double Limit = VRESAMPLEMAXPPM * 1.0e-6;
+
+    if (!Resampler->LevelValid)
+    {
+        Resampler->Level = Level;
+        Resampler->LevelValid = true;
+    }
+    else
+        Resampler->Level += (Level - Resampler->Level) * (Interval / (Interval + VRESAMPLESMOOTHTIME));
+    Error = Resampler->Level - Target;
+    Resampler->Integral += Error * Interval;
+    if (Resampler->Integral * VRESAMPLEKI > Limit)                // don't wind up past the limit
+        Resampler->Integral = Limit / VRESAMPLEKI;
+    else if (Resampler->Integral * VRESAMPLEKI < -Limit)
+        Resampler->Integral = -Limit / VRESAMPLEKI;
+    Correction = VRESAMPLEKP * Error + VRESAMPLEKI * Resampler->Integral;
+    if (Correction > Limit)
+        Correction = Limit;
+    else if (Correction < -Limit)
+        Correction = -Limit;
+    Resampler->Step = 1.0 + Correction;
+}
+
+
+double GetAudioResampleRatioPPM(const struct AudioResampler* Resampler)
+{
+    return (Resampler->Step - 1.0) * 1.0e6;
+}
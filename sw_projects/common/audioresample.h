@@ -0,0 +1,90 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// licenced under GNU GPL3
+//
+// audioresample.h:
+// header file. Adaptive fractional resampler for the speaker audio.
+// the client's audio clock and the codec's 48KHz clock are never quite
+// the same, so a constant speaker FIFO depth needs the audio very slightly
+// resampled: by up to +/-VRESAMPLEMAXPPM parts per million.
+//
+// the resampler is a polyphase windowed sinc interpolator: VRESAMPLEPHASES
+// filters of VRESAMPLETAPS taps, one per fractional sample position, with
+// linear interpolation between adjacent phases. It is steered by the
+// measured FIFO level (SteerAudioResampler()), with a PI controller.
+//
+// samples are the speaker packet format: 16 bit big endian L then R.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __audioresample_h
+#define __audioresample_h
+
+#include <stdint.h>
+#include "../common/saturntypes.h"
+
+
+#define VRESAMPLETAPS 16                        // filter taps per phase (multiple of 4)
+#define VRESAMPLEPHASES 64                      // fractional positions
+#define VRESAMPLEMAXIN 128                      // most input samples per ResampleAudio() call
+#define VRESAMPLEMAXPPM 2000                    // largest rate correction
+
+
+struct AudioResampler
+{
+    float Left[VRESAMPLETAPS + 1 + VRESAMPLEMAXIN];       // input history and new samples
+    float Right[VRESAMPLETAPS + 1 + VRESAMPLEMAXIN];
+    uint32_t Fill;                              // samples held
+    double Position;                            // next output position, in input samples from [0]
+    double Step;                                // input samples per output sample
+    double Level;                               // smoothed FIFO level (samples)
+    double Integral;                            // integral of the level error (sample seconds)
+    bool LevelValid;                            // true once Level has been set
+};
+
+
+//
+// void InitialiseAudioResampler(struct AudioResampler* Resampler)
+// clear the history and set the ratio to 1. Builds the filter table on first use.
+//
+void InitialiseAudioResampler(struct AudioResampler* Resampler);
+
+
+//
+// uint32_t ResampleAudio(struct AudioResampler* Resampler, uint8_t* Dest, const uint8_t* Src, uint32_t Samples)
+// resample a block of stereo samples at the current ratio
+//   Dest:      output samples, 4 bytes each. Room needed for Samples + 2 samples
+//   Src:       input samples, 4 bytes each (not overlapping Dest)
+//   Samples:   input samples, up to VRESAMPLEMAXIN
+// returns the number of samples written: Samples / Step, give or take one
+// NEON: 4 taps per instruction; else scalar code
+//
+uint32_t ResampleAudio(struct AudioResampler* Resampler, uint8_t* Dest, const uint8_t* Src, uint32_t Samples);
+uint32_t ResampleAudioScalar(struct AudioResampler* Resampler, uint8_t* Dest, const uint8_t* Src, uint32_t Samples);
+
+
+//
+// void SteerAudioResampler(struct AudioResampler* Resampler, double Level, double Target, double Interval)
+// adjust the ratio from a measured FIFO level
+//   Level:     samples held in the FIFO (and about to be)
+//   Target:    the FIFO level to hold, samples
+//   Interval:  seconds since the previous call (0 for the first)
+// the level is smoothed, then a PI controller sets the ratio; a level above
+// target makes fewer output samples, so the FIFO drains.
+//
+void SteerAudioResampler(struct AudioResampler* Resampler, double Level, double Target, double Interval);
+
+
+//
+// double GetAudioResampleRatioPPM(const struct AudioResampler* Resampler)
+// the current rate correction, parts per million. Positive if the client's
+// clock is fast (input samples are being dropped)
+//
+double GetAudioResampleRatioPPM(const struct AudioResampler* Resampler);
+
+
+#endif
@@ -41,10 +41,10 @@
 
 
 //
-// prints temperature information
+// read the FPGA die temperature
 // temperature conversion according to UG480 page 23
 //
-void PrintAuxADCInfo(void)
+float ReadFPGATemperature(void)
 {
     uint32_t RegisterValue;
     float Temp;
@@ -53,8 +53,16 @@ void PrintAuxADCInfo(void)
     Temp = (float)RegisterValue * 503.975;
     Temp = Temp / 65536.0;
     Temp -= 273.15;
+    return Temp;
+}
 
-    printf("Die Temp = %4.1fC\n", Temp);
+
+//
+// prints temperature information
+//
+void PrintAuxADCInfo(void)
+{
+    printf("Die Temp = %4.1fC\n", ReadFPGATemperature());
 }
 
 
@@ -25,4 +25,10 @@
 void PrintAuxADCInfo(void);
 
 
+//
+// read the FPGA die temperature, in degrees C
+//
+float ReadFPGATemperature(void);
+
+
 #endif
\ No newline at end of file
@@ -0,0 +1,206 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// channelizer.c:
+// Polyphase filter bank channelizer
+//
+// channel k of the bank is the input mixed down by k/M cycles per sample,
+// low pass filtered by h[] and decimated by M:
+//   y_k[m] = sum_n h[n] x[mM - n] exp(+j 2 pi k n / M)
+// with n = qM + p this is an M point inverse DFT over p of the branch outputs
+//   v_p[m] = sum_q h[qM + p] x[(m - q)M - p]
+// so each block costs M FIR filters of VCHANTAPSPERBRANCH taps, and one FFT.
+//
+//////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <math.h>
+#include "../common/channelizer.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+
+//
+// bool InitialiseChannelizer(struct Channelizer* Chan, uint32_t Channels)
+// build the filter and tables for a channel count, and clear the delay lines
+//
+bool InitialiseChannelizer(struct Channelizer* Chan, uint32_t Channels)
+{
+    uint32_t Cntr, Bit, Reversed, Bits;
+    uint32_t Length;
+    double Centre, Arg, Window;
+    double Sum = 0.0;
+    double Filter[VCHANTAPSPERBRANCH * VCHANMAXCHANNELS];
+
+    if ((Channels < VCHANMINCHANNELS) || (Channels > VCHANMAXCHANNELS) || ((Channels & (Channels - 1)) != 0))
+        return false;
+    memset(Chan, 0, sizeof(*Chan));
+    Chan->Channels = Channels;
+
+    //
+    // prototype low pass: cutoff half the channel spacing, 1/(2M) cycles per sample
+    // normalised to unity gain at DC
+    //
+    Length = Channels * VCHANTAPSPERBRANCH;
+    Centre = (Length - 1) / 2.0;
+    for (Cntr = 0; Cntr < Length; Cntr++)
+    {
+        Arg = (Cntr - Centre) / Channels;
+        Window = 0.42 - 0.5 * cos(2.0 * M_PI * Cntr / (Length - 1)) + 0.08 * cos(4.0 * M_PI * Cntr / (Length - 1));
+        Filter[Cntr] = Window * ((Arg == 0.0) ? 1.0 : sin(M_PI * Arg) / (M_PI * Arg));
+        Sum += Filter[Cntr];
+    }
+    for (Cntr = 0; Cntr < Length; Cntr++)
+        Chan->Coeffs[Cntr / Channels][Cntr % Channels] = (float)(Filter[Cntr] / Sum);
+
+    for (Cntr = 0; Cntr < Channels / 2; Cntr++)
+    {
+        Chan->CosTable[Cntr] = (float)cos(2.0 * M_PI * Cntr / Channels);
+        Chan->SinTable[Cntr] = (float)sin(2.0 * M_PI * Cntr / Channels);
+    }
+    Bits = 0;
+    while ((1U << Bits) < Channels)
+        Bits++;
+    for (Cntr = 0; Cntr < Channels; Cntr++)
+    {
+        Reversed = 0;
+        for (Bit = 0; Bit < Bits; Bit++)
+            if (Cntr & (1U << Bit))
+                Reversed |= 1U << (Bits - 1 - Bit);
+        Chan->BitReverse[Cntr] = (uint16_t)Reversed;
+    }
+    return true;
+}
+
+
+//
+// void ResetChannelizer(struct Channelizer* Chan)
+// clear the delay lines
+//
+void ResetChannelizer(struct Channelizer* Chan)
+{
+    memset(Chan->HistoryRe, 0, sizeof(Chan->HistoryRe));
+    memset(Chan->HistoryIm, 0, sizeof(Chan->HistoryIm));
+    Chan->HistoryPos = 0;
+}
+
+
+//
+// branch filters: BranchRe/Im[p] = sum over q of Coeffs[q][p] * History[Pos + q][p]
+// the branches are adjacent in memory, so NEON works on 4 branches at once
+//
+static void FilterBranches(const struct Channelizer* Chan, float* BranchRe, float* BranchIm)
+{
+    uint32_t Branch = 0;
+    uint32_t Tap;
+    uint32_t Pos = Chan->HistoryPos;
+    float SumRe, SumIm;
+
+#if defined(__ARM_NEON)
+    for (; Branch + 4 <= Chan->Channels; Branch += 4)
+    {
+        float32x4_t AccRe = vdupq_n_f32(0.0f);
+        float32x4_t AccIm = vdupq_n_f32(0.0f);
+        for (Tap = 0; Tap < VCHANTAPSPERBRANCH; Tap++)
+        {
+            float32x4_t Coeff = vld1q_f32(&Chan->Coeffs[Tap][Branch]);
+            AccRe = vmlaq_f32(AccRe, Coeff, vld1q_f32(&Chan->HistoryRe[Pos + Tap][Branch]));
+            AccIm = vmlaq_f32(AccIm, Coeff, vld1q_f32(&Chan->HistoryIm[Pos + Tap][Branch]));
+        }
+        vst1q_f32(BranchRe + Branch, AccRe);
+        vst1q_f32(BranchIm + Branch, AccIm);
+    }
+#endif
+    for (; Branch < Chan->Channels; Branch++)
+    {
+        SumRe = 0.0f;
+        SumIm = 0.0f;
+        for (Tap = 0; Tap < VCHANTAPSPERBRANCH; Tap++)
+        {
+            SumRe += Chan->Coeffs[Tap][Branch] * Chan->HistoryRe[Pos + Tap][Branch];
+            SumIm += Chan->Coeffs[Tap][Branch] * Chan->HistoryIm[Pos + Tap][Branch];
+        }
+        BranchRe[Branch] = SumRe;
+        BranchIm[Branch] = SumIm;
+    }
+}
+
+
+//
+// void RunChannelizer(struct Channelizer* Chan, const float* Input, float* Output)
+// process one block of M input samples
+//
+void RunChannelizer(struct Channelizer* Chan, const float* Input, float* Output)
+{
+    uint32_t M = Chan->Channels;
+    uint32_t Cntr, Len, Half, TwiddleStep, Start, K, I, J;
+    uint32_t Pos;
+    float BranchRe[VCHANMAXCHANNELS];
+    float BranchIm[VCHANMAXCHANNELS];
+    float FFTRe[VCHANMAXCHANNELS];
+    float FFTIm[VCHANMAXCHANNELS];
+    float C, S, TRe, TIm;
+
+    //
+    // commutator: branch p takes x[mM - p], ie the newest input goes to branch 0
+    //
+    Pos = (Chan->HistoryPos == 0) ? VCHANTAPSPERBRANCH - 1 : Chan->HistoryPos - 1;
+    Chan->HistoryPos = Pos;
+    for (Cntr = 0; Cntr < M; Cntr++)
+    {
+        Chan->HistoryRe[Pos][Cntr] = Input[2 * (M - 1 - Cntr)];
+        Chan->HistoryIm[Pos][Cntr] = Input[2 * (M - 1 - Cntr) + 1];
+        Chan->HistoryRe[Pos + VCHANTAPSPERBRANCH][Cntr] = Chan->HistoryRe[Pos][Cntr];
+        Chan->HistoryIm[Pos + VCHANTAPSPERBRANCH][Cntr] = Chan->HistoryIm[Pos][Cntr];
+    }
+    FilterBranches(Chan, BranchRe, BranchIm);
+
+    //
+    // radix 2 decimation in time inverse FFT (no 1/M: the filter has unity gain)
+    //
+    for (Cntr = 0; Cntr < M; Cntr++)
+    {
+        FFTRe[Chan->BitReverse[Cntr]] = BranchRe[Cntr];
+        FFTIm[Chan->BitReverse[Cntr]] = BranchIm[Cntr];
+    }
+    for (Len = 2; Len <= M; Len <<= 1)
+    {
+        Half = Len / 2;
+        TwiddleStep = M / Len;
+        for (Start = 0; Start < M; Start += Len)
+        {
+            for (K = 0; K < Half; K++)
+            {
+                C = Chan->CosTable[K * TwiddleStep];        // multiply by exp(+j 2 pi K / Len)
+                S = Chan->SinTable[K * TwiddleStep];
+                I = Start + K;
+                J = I + Half;
+                TRe = FFTRe[J] * C - FFTIm[J] * S;
+                TIm = FFTIm[J] * C + FFTRe[J] * S;
+                FFTRe[J] = FFTRe[I] - TRe;
+                FFTIm[J] = FFTIm[I] - TIm;
+                FFTRe[I] += TRe;
+                FFTIm[I] += TIm;
+            }
+        }
+    }
+
+    //
+    // bin k is centred k/M cycles per sample; bins above M/2 are negative frequencies
+    // channel c is bin c + M/2, so channel 0 is the lowest frequency
+    //
+    for (Cntr = 0; Cntr < M; Cntr++)
+    {
+        K = (Cntr + M / 2) & (M - 1);
+        Output[2 * Cntr] = FFTRe[K];
+        Output[2 * Cntr + 1] = FFTIm[K];
+    }
+}
@@ -0,0 +1,82 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// channelizer.h:
+// header file. Polyphase filter bank channelizer, to split one high
+// rate I/Q stream into many narrow channels on the Pi.
+//
+// critically sampled: each block of M input samples gives one output
+// sample for each of the M channels, so every channel runs at Fs/M and
+// the channels are spaced Fs/M apart. The prototype low pass filter
+// (Blackman windowed sinc, VCHANTAPSPERBRANCH taps per branch) is 6dB
+// down at the channel edges, so adjacent channels overlap with no gap;
+// signals within the transition band of a channel edge alias into that
+// channel. Channel c is centred (c - M/2) * Fs/M from the input centre:
+// channel 0 is the lowest frequency.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __channelizer_h
+#define __channelizer_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../common/saturntypes.h"
+
+
+#define VCHANMINCHANNELS 2                      // channel counts supported: powers of 2 from 2 to 64
+#define VCHANMAXCHANNELS 64
+#define VCHANTAPSPERBRANCH 16                   // prototype filter taps per polyphase branch
+
+
+//
+// channelizer state: filter, delay lines and FFT tables. No memory is allocated.
+// the delay lines are stored twice over, one after the other, so each
+// branch's taps can be read in one run whatever the current position.
+//
+struct Channelizer
+{
+    uint32_t Channels;                          // M: channels, and input samples per output
+    uint32_t HistoryPos;                        // delay line row holding the newest input
+    float Coeffs[VCHANTAPSPERBRANCH][VCHANMAXCHANNELS];        // [q][p] = h[q*M + p]
+    float HistoryRe[2 * VCHANTAPSPERBRANCH][VCHANMAXCHANNELS]; // [q][p] = branch p input, q blocks ago
+    float HistoryIm[2 * VCHANTAPSPERBRANCH][VCHANMAXCHANNELS];
+    float CosTable[VCHANMAXCHANNELS / 2];       // FFT twiddle factors
+    float SinTable[VCHANMAXCHANNELS / 2];
+    uint16_t BitReverse[VCHANMAXCHANNELS];      // FFT input reorder
+};
+
+
+//
+// bool InitialiseChannelizer(struct Channelizer* Chan, uint32_t Channels)
+// build the filter and tables for a channel count, and clear the delay lines
+//   Channels:  M, a power of 2 from VCHANMINCHANNELS to VCHANMAXCHANNELS
+// returns false if the channel count is not supported
+//
+bool InitialiseChannelizer(struct Channelizer* Chan, uint32_t Channels);
+
+
+//
+// void ResetChannelizer(struct Channelizer* Chan)
+// clear the delay lines, eg after a gap in the input
+//
+void ResetChannelizer(struct Channelizer* Chan);
+
+
+//
+// void RunChannelizer(struct Channelizer* Chan, const float* Input, float* Output)
+// process one block of input
+//   Input:     M complex input samples, I then Q, oldest first
+//   Output:    one complex sample, I then Q, for each of the M channels, channel 0 first
+// a tone at the centre of a channel comes out at the amplitude it went in
+//
+void RunChannelizer(struct Channelizer* Chan, const float* Input, float* Output);
+
+
+#endif
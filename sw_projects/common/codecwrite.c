@@ -17,13 +17,24 @@
 #define _XOPEN_SOURCE 500
 #include "../common/hwaccess.h"
 #include "../common/saturnregisters.h"
+#include "../common/codecwrite.h"
 #include "stdio.h"
-#include <semaphore.h>
+#include <string.h>
+#include <pthread.h>
+
+
+#define VCODECNUMREGS 16								// codec register addresses
+#define VCODECBATCH 16									// most transfers queued in one go
+#define VCODECSPISTATUSREG (VADDRCODECSPIREG + 8)		// SPI writer status: bit 0 = busy
+#define VCODECWAITLOOPS 1000							// most status reads waiting for the last transfer
 
 //
-// semaphores to protect registers that are accessed from several threads
+// last value written to each codec register, so unchanged settings can be skipped.
+// the mutex keeps the copies and the queued transfers in the same order.
 //
-sem_t CodecRegMutex;
+static uint32_t CodecRegisters[VCODECNUMREGS];
+static bool CodecRegistersValid[VCODECNUMREGS];
+static pthread_mutex_t CodecRegisterMutex = PTHREAD_MUTEX_INITIALIZER;
 
 //
 // 8 bit Codec register write over the AXILite bus via SPI
@@ -32,12 +43,59 @@ sem_t CodecRegMutex;
 //
 void CodecRegisterWrite(uint32_t Address, uint32_t Data)
 {
-	uint32_t WriteData;
+	struct CodecRegisterSetting Setting;
 
-	WriteData = (Address << 9) | (Data & 0x01FFUL);
-    sem_wait(&CodecRegMutex);                       // get protected access
-//	printf("writing data %04x to codec register %04x\n", Data, Address);
-	RegisterWrite(VADDRCODECSPIREG, WriteData);  	// and write to it
-    sem_post(&CodecRegMutex);                       // clear protected access
+	Setting.Address = Address;
+	Setting.Data = Data;
+	CodecRegisterWriteTable(&Setting, 1, false);
 }
 
+
+//
+// write a table of codec register settings, skipping unchanged ones.
+// the SPI writer IP holds off a bus write until it has shifted out the
+// previous one, so the transfers can be queued back to back.
+//
+uint32_t CodecRegisterWriteTable(const struct CodecRegisterSetting* Table, uint32_t Count, bool WaitComplete)
+{
+	uint32_t WriteData[VCODECBATCH];
+	uint32_t Queued = 0;
+	uint32_t Written = 0;
+	uint32_t Address;
+	uint32_t Data;
+	uint32_t Cntr;
+
+	pthread_mutex_lock(&CodecRegisterMutex);
+	for (Cntr = 0; Cntr < Count; Cntr++)
+	{
+		Address = Table[Cntr].Address & 0x7F;
+		Data = Table[Cntr].Data & 0x01FFUL;
+		if (Address == VCODECRESETREG)
+			memset(CodecRegistersValid, 0, sizeof(CodecRegistersValid));		// reset: all registers back to defaults
+		else if (Address < VCODECNUMREGS)
+		{
+			if (CodecRegistersValid[Address] && (CodecRegisters[Address] == Data))
+				continue;														// unchanged
+			CodecRegisters[Address] = Data;
+			CodecRegistersValid[Address] = true;
+		}
+//		printf("writing data %04x to codec register %04x\n", Data, Address);
+		WriteData[Queued++] = (Address << 9) | Data;
+		if (Queued == VCODECBATCH)
+		{
+			QueueRegisterWrites(eCodecSPIQueuedReg, WriteData, Queued);			// and write to it
+			Written += Queued;
+			Queued = 0;
+		}
+	}
+	if (Queued != 0)
+		QueueRegisterWrites(eCodecSPIQueuedReg, WriteData, Queued);
+	Written += Queued;
+	pthread_mutex_unlock(&CodecRegisterMutex);
+
+	if (WaitComplete && (Written != 0))
+		for (Cntr = 0; Cntr < VCODECWAITLOOPS; Cntr++)
+			if ((RegisterRead(VCODECSPISTATUSREG) & 1) == 0)
+				break;
+	return Written;
+}
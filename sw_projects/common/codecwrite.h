@@ -15,6 +15,34 @@
 #ifndef __codecwrite_h
 #define __codecwrite_h
 
+#include <stdint.h>
+#include <stdbool.h>
+
+
+//
+// define Codec registers
+//
+#define VCODECLLINEVOLREG 0                         // left line input volume
+#define VCODECRLINEVOLREG 1                         // right line input volume
+#define VCODECLHEADPHONEVOLREG 2                    // left headphone volume
+#define VCODECRHEADPHONEVOLREG 3                    // right headphone volume
+#define VCODECANALOGUEPATHREG 4                     // analogue path control
+#define VCODECDIGITALPATHREG 5                      // digital path control
+#define VCODECPOWERDOWNREG 6                        // power down control
+#define VCODECDIGITALFORMATREG 7                    // digital audio interface format register
+#define VCODECSAMPLERATEREG 8                       // sample rate control
+#define VCODECACTIVATIONREG 9                       // digital interface activation register
+#define VCODECRESETREG 15                           // reset register
+
+
+//
+// one codec register setting, for CodecRegisterWriteTable()
+//
+struct CodecRegisterSetting
+{
+	uint32_t Address;					// 7 bit register address
+	uint32_t Data;						// 9 bit data
+};
 
 
 //
@@ -25,4 +53,14 @@
 void CodecRegisterWrite(uint32_t Address, uint32_t Data);
 
 
-#endif
\ No newline at end of file
+//
+// write a table of codec register settings in order, in one call.
+// settings equal to the value last written are skipped (a reset register write is
+// always sent, and forgets the values written). 
+// if WaitComplete, wait until the SPI writer has shifted out the last transfer.
+// returns the number of register writes made.
+//
+uint32_t CodecRegisterWriteTable(const struct CodecRegisterSetting* Table, uint32_t Count, bool WaitComplete);
+
+
+#endif
@@ -0,0 +1,177 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// ddccapture.c:
+// write and read capture files of the raw DDC DMA blocks
+// only one capture can be written at a time.
+//
+//////////////////////////////////////////////////////////////
+
+#include "../common/ddccapture.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+#define VCAPTUREBUFFERSIZE (1024*1024)          // stdio buffer, so most blocks cost a memcpy not a write
+
+
+static FILE* CaptureFile = NULL;
+static struct DDCCaptureHeader CaptureHeader;
+static uint64_t CaptureBytes;                   // file size so far
+static uint64_t CaptureStartMonotonic;          // CLOCK_MONOTONIC ns at StartTime
+static bool CaptureFull;
+
+
+//
+// bool OpenDDCCapture(const char* Filename, uint32_t RateWord, uint32_t FirmwareVersion)
+// create a capture file and write its header
+//
+bool OpenDDCCapture(const char* Filename, uint32_t RateWord, uint32_t FirmwareVersion)
+{
+    struct timespec Now;
+
+    if (CaptureFile != NULL)
+        CloseDDCCapture();
+    CaptureFile = fopen(Filename, "wb");
+    if (CaptureFile == NULL)
+    {
+        perror("open DDC capture file");
+        return false;
+    }
+    setvbuf(CaptureFile, NULL, _IOFBF, VCAPTUREBUFFERSIZE);
+    memset(&CaptureHeader, 0, sizeof(CaptureHeader));
+    memcpy(CaptureHeader.Magic, VDDCCAPTUREMAGIC, sizeof(CaptureHeader.Magic));
+    CaptureHeader.Version = VDDCCAPTUREVERSION;
+    CaptureHeader.HeaderSize = sizeof(CaptureHeader);
+    CaptureHeader.RateWord = RateWord;
+    CaptureHeader.FirmwareVersion = FirmwareVersion;
+    clock_gettime(CLOCK_REALTIME, &Now);
+    CaptureHeader.StartTime = (uint64_t)Now.tv_sec * 1000000000ULL + Now.tv_nsec;
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    CaptureStartMonotonic = (uint64_t)Now.tv_sec * 1000000000ULL + Now.tv_nsec;
+    fwrite(&CaptureHeader, sizeof(CaptureHeader), 1, CaptureFile);
+    CaptureBytes = sizeof(CaptureHeader);
+    CaptureFull = false;
+    printf("capturing DDC DMA blocks to %s\n", Filename);
+    return true;
+}
+
+
+//
+// void WriteDDCCaptureBlock(const uint8_t* Data, uint32_t Length, uint32_t FIFODepth, const struct timespec* DMATime)
+// add one DMA block to the capture
+//
+void WriteDDCCaptureBlock(const uint8_t* Data, uint32_t Length, uint32_t FIFODepth, const struct timespec* DMATime)
+{
+    static const uint8_t Padding[8] = {0};
+    struct DDCCaptureBlock Block;
+    uint32_t PadBytes;
+    uint64_t Time;
+
+    if ((CaptureFile == NULL) || CaptureFull)
+        return;
+    PadBytes = (8 - (Length & 7)) & 7;
+    if ((CaptureBytes + sizeof(Block) + Length + PadBytes) > VDDCCAPTUREMAXBYTES)
+    {
+        printf("DDC capture file full: capture stopped\n");
+        CaptureFull = true;
+        return;
+    }
+    Time = (uint64_t)DMATime->tv_sec * 1000000000ULL + DMATime->tv_nsec;
+    Block.Time = (Time > CaptureStartMonotonic) ? Time - CaptureStartMonotonic : 0;
+    Block.Length = Length;
+    Block.FIFODepth = FIFODepth;
+    fwrite(&Block, sizeof(Block), 1, CaptureFile);
+    fwrite(Data, 1, Length, CaptureFile);
+    if (PadBytes != 0)
+        fwrite(Padding, 1, PadBytes, CaptureFile);
+    CaptureBytes += sizeof(Block) + Length + PadBytes;
+    CaptureHeader.Blocks++;
+    CaptureHeader.DataBytes += Length;
+}
+
+
+//
+// void CloseDDCCapture(void)
+// rewrite the header with the totals, and close
+//
+void CloseDDCCapture(void)
+{
+    if (CaptureFile == NULL)
+        return;
+    fseek(CaptureFile, 0, SEEK_SET);
+    fwrite(&CaptureHeader, sizeof(CaptureHeader), 1, CaptureFile);
+    fclose(CaptureFile);
+    CaptureFile = NULL;
+    printf("DDC capture closed: %llu blocks, %llu bytes\n",
+           (unsigned long long)CaptureHeader.Blocks, (unsigned long long)CaptureHeader.DataBytes);
+}
+
+
+//
+// const struct DDCCaptureHeader* MapDDCCapture(const char* Filename, size_t* Size)
+// memory map a capture file read only, and check its header
+//
+const struct DDCCaptureHeader* MapDDCCapture(const char* Filename, size_t* Size)
+{
+    int Fd;
+    struct stat Stat;
+    void* Map;
+    const struct DDCCaptureHeader* Header;
+
+    Fd = open(Filename, O_RDONLY);
+    if (Fd < 0)
+        return NULL;
+    if ((fstat(Fd, &Stat) < 0) || (Stat.st_size < (off_t)sizeof(struct DDCCaptureHeader)))
+    {
+        close(Fd);
+        return NULL;
+    }
+    Map = mmap(NULL, Stat.st_size, PROT_READ, MAP_PRIVATE, Fd, 0);
+    close(Fd);
+    if (Map == MAP_FAILED)
+        return NULL;
+    Header = (const struct DDCCaptureHeader*)Map;
+    if ((memcmp(Header->Magic, VDDCCAPTUREMAGIC, sizeof(Header->Magic)) != 0) || (Header->Version != VDDCCAPTUREVERSION)
+        || (Header->HeaderSize < sizeof(struct DDCCaptureHeader)) || (Header->HeaderSize > (uint64_t)Stat.st_size))
+    {
+        munmap(Map, Stat.st_size);
+        return NULL;
+    }
+    *Size = Stat.st_size;
+    return Header;
+}
+
+
+//
+// const struct DDCCaptureBlock* NextDDCCaptureBlock(const struct DDCCaptureHeader* Header, size_t Size,
+//                                                   const struct DDCCaptureBlock* Block)
+// step to the next block in a mapped capture; a truncated last block is ignored
+//
+const struct DDCCaptureBlock* NextDDCCaptureBlock(const struct DDCCaptureHeader* Header, size_t Size,
+                                                  const struct DDCCaptureBlock* Block)
+{
+    size_t Offset;
+
+    if (Block == NULL)
+        Offset = Header->HeaderSize;
+    else
+        Offset = ((const uint8_t*)Block - (const uint8_t*)Header) + sizeof(struct DDCCaptureBlock)
+                 + ((Block->Length + 7) & ~7U);
+    if ((Offset + sizeof(struct DDCCaptureBlock)) > Size)
+        return NULL;
+    Block = (const struct DDCCaptureBlock*)((const uint8_t*)Header + Offset);
+    if ((Offset + sizeof(struct DDCCaptureBlock) + Block->Length) > Size)
+        return NULL;
+    return Block;
+}
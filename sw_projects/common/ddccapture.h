@@ -0,0 +1,107 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// ddccapture.h:
+// header file. capture file of the raw DDC DMA blocks
+//
+// the file is a fixed header, then one record per DMA block: a block
+// header then the block data exactly as read from the DDC FIFO. All
+// fields are little endian and 8 byte aligned, so a capture can be
+// memory mapped and walked in place. It is replayed by p2app-sim
+// (see simhwaccess.c).
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __ddccapture_h
+#define __ddccapture_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include "../common/saturntypes.h"
+
+
+#define VDDCCAPTUREMAGIC "SATDDCCP"            // 8 characters, no terminator in the file
+#define VDDCCAPTUREVERSION 1
+#define VDDCCAPTUREMAXBYTES (1024ULL*1024ULL*1024ULL)   // capture stops at this file size
+
+
+//
+// file header
+//
+struct DDCCaptureHeader
+{
+    char Magic[8];                              // VDDCCAPTUREMAGIC
+    uint32_t Version;                           // VDDCCAPTUREVERSION
+    uint32_t HeaderSize;                        // bytes in this header; first block follows
+    uint32_t RateWord;                          // DDC rate register when the capture started
+    uint32_t FirmwareVersion;                   // FPGA firmware version
+    uint64_t StartTime;                         // capture start, CLOCK_REALTIME ns
+    uint64_t Blocks;                            // blocks in file; 0 if the capture was not closed
+    uint64_t DataBytes;                         // DMA data bytes in file (not counting block headers)
+    uint64_t Reserved[2];
+};
+
+
+//
+// header before each block. The data follows, padded to a multiple of 8 bytes
+//
+struct DDCCaptureBlock
+{
+    uint64_t Time;                              // DMA time, ns after StartTime
+    uint32_t Length;                            // DMA data bytes
+    uint32_t FIFODepth;                         // FIFO locations occupied when the DMA was sized
+};
+
+
+//
+// bool OpenDDCCapture(const char* Filename, uint32_t RateWord, uint32_t FirmwareVersion)
+// create a capture file, replacing any existing one, and write its header
+// returns false if the file could not be created
+//
+bool OpenDDCCapture(const char* Filename, uint32_t RateWord, uint32_t FirmwareVersion);
+
+
+//
+// void WriteDDCCaptureBlock(const uint8_t* Data, uint32_t Length, uint32_t FIFODepth, const struct timespec* DMATime)
+// add one DMA block to an open capture
+//   DMATime:   CLOCK_MONOTONIC time of the DMA
+// blocks are dropped once the file reaches VDDCCAPTUREMAXBYTES
+//
+void WriteDDCCaptureBlock(const uint8_t* Data, uint32_t Length, uint32_t FIFODepth, const struct timespec* DMATime);
+
+
+//
+// void CloseDDCCapture(void)
+// complete the header with the block count, and close the file
+//
+void CloseDDCCapture(void);
+
+
+//
+// const struct DDCCaptureHeader* MapDDCCapture(const char* Filename, size_t* Size)
+// memory map a capture file read only
+// returns NULL if the file can't be opened or is not a capture
+// blocks start at (uint8_t*)Header + Header->HeaderSize
+//
+const struct DDCCaptureHeader* MapDDCCapture(const char* Filename, size_t* Size);
+
+
+//
+// const struct DDCCaptureBlock* NextDDCCaptureBlock(const struct DDCCaptureHeader* Header, size_t Size,
+//                                                   const struct DDCCaptureBlock* Block)
+// step through a mapped capture: pass NULL for the first block
+// returns NULL after the last complete block
+//
+const struct DDCCaptureBlock* NextDDCCaptureBlock(const struct DDCCaptureHeader* Header, size_t Size,
+                                                  const struct DDCCaptureBlock* Block);
+
+
+#endif
@@ -0,0 +1,153 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// licenced under GNU GPL3
+//
+// ddccompress.c:
+// 16 bit block floating point coding of DDC I/Q samples
+//
+//////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include "../common/ddccompress.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+
+//
+// bytes needed to code a number of I/Q samples
+//
+uint32_t DDCBFPBytes(uint32_t Samples)
+{
+    return (Samples + VDDCBFPBLOCK - 1) / VDDCBFPBLOCK + Samples * 4;
+}
+
+
+//
+// read 2*Samples 24 bit big endian values, sign extended to 32 bits
+//
+static void ReadDDCBlock(int32_t* Values, const uint8_t* Src, uint32_t Count)
+{
+    uint32_t Cntr;
+
+    for (Cntr = 0; Cntr < Count; Cntr++, Src += 3)
+        Values[Cntr] = (int32_t)(((uint32_t)Src[0] << 24) | ((uint32_t)Src[1] << 16) | ((uint32_t)Src[2] << 8)) >> 8;
+}
+
+
+//
+// largest magnitude of Count values
+//
+static uint32_t FindDDCBlockPeak(const int32_t* Values, uint32_t Count)
+{
+    uint32_t Cntr = 0;
+    int32_t Peak = 0;
+    int32_t Value;
+
+#if defined(__ARM_NEON)
+    int32x4_t Peaks = vdupq_n_s32(0);
+    for (; Cntr + 4 <= Count; Cntr += 4)
+        Peaks = vmaxq_s32(Peaks, vabsq_s32(vld1q_s32(Values + Cntr)));
+    Peak = vgetq_lane_s32(Peaks, 0);
+    if (vgetq_lane_s32(Peaks, 1) > Peak) Peak = vgetq_lane_s32(Peaks, 1);
+    if (vgetq_lane_s32(Peaks, 2) > Peak) Peak = vgetq_lane_s32(Peaks, 2);
+    if (vgetq_lane_s32(Peaks, 3) > Peak) Peak = vgetq_lane_s32(Peaks, 3);
+#endif
+    for (; Cntr < Count; Cntr++)
+    {
+        Value = (Values[Cntr] < 0) ? -Values[Cntr] : Values[Cntr];
+        if (Value > Peak)
+            Peak = Value;
+    }
+    return (uint32_t)Peak;
+}
+
+
+//
+// shift Count values right with rounding, saturate to 16 bits and write big endian
+//
+static void WriteDDCBlock(uint8_t* Dest, const int32_t* Values, uint32_t Count, uint32_t Shift)
+{
+    uint32_t Cntr = 0;
+    int32_t Value;
+
+#if defined(__ARM_NEON)
+    int32x4_t ShiftVector = vdupq_n_s32(-(int32_t)Shift);
+    for (; Cntr + 4 <= Count; Cntr += 4, Dest += 8)
+    {
+        int16x4_t Coded = vqmovn_s32(vrshlq_s32(vld1q_s32(Values + Cntr), ShiftVector));
+        vst1_u8(Dest, vrev16_u8(vreinterpret_u8_s16(Coded)));
+    }
+#endif
+    for (; Cntr < Count; Cntr++, Dest += 2)
+    {
+        Value = Values[Cntr];
+        if (Shift != 0)
+            Value = (Value + (1 << (Shift - 1))) >> Shift;
+        if (Value > 32767)
+            Value = 32767;
+        else if (Value < -32768)
+            Value = -32768;
+        Dest[0] = (uint8_t)(Value >> 8);
+        Dest[1] = (uint8_t)Value;
+    }
+}
+
+
+//
+// code samples as 16 bit block floating point
+// each block is read before its coded data is written, and coded data is never
+// written beyond the start of the next block's source, so Dest may equal Src
+//
+uint32_t CompressDDCSamplesBFP(uint8_t* Dest, const uint8_t* Src, uint32_t Samples)
+{
+    int32_t Values[2 * VDDCBFPBLOCK];
+    uint32_t Blocks = (Samples + VDDCBFPBLOCK - 1) / VDDCBFPBLOCK;
+    uint8_t* CodedPtr = Dest + Blocks;
+    uint32_t Block;
+    uint32_t BlockSamples;
+    uint32_t Peak;
+    uint32_t Shift;
+
+    for (Block = 0; Block < Blocks; Block++)
+    {
+        BlockSamples = Samples - Block * VDDCBFPBLOCK;
+        if (BlockSamples > VDDCBFPBLOCK)
+            BlockSamples = VDDCBFPBLOCK;
+        ReadDDCBlock(Values, Src + Block * VDDCBFPBLOCK * 6, 2 * BlockSamples);
+        Peak = FindDDCBlockPeak(Values, 2 * BlockSamples);
+        Shift = 0;
+        while ((Peak >> Shift) > 32767)
+            Shift++;
+        Dest[Block] = (uint8_t)Shift;
+        WriteDDCBlock(CodedPtr, Values, 2 * BlockSamples, Shift);
+        CodedPtr += 4 * BlockSamples;
+    }
+    return (uint32_t)(CodedPtr - Dest);
+}
+
+
+//
+// reference decode
+//
+void DecompressDDCSamplesBFP(uint8_t* Dest, const uint8_t* Src, uint32_t Samples)
+{
+    uint32_t Blocks = (Samples + VDDCBFPBLOCK - 1) / VDDCBFPBLOCK;
+    const uint8_t* CodedPtr = Src + Blocks;
+    uint32_t Cntr;
+    int32_t Value;
+
+    for (Cntr = 0; Cntr < 2 * Samples; Cntr++, CodedPtr += 2, Dest += 3)
+    {
+        Value = (int32_t)(int16_t)(((uint16_t)CodedPtr[0] << 8) | CodedPtr[1]);
+        Value = (int32_t)((uint32_t)Value << Src[Cntr / (2 * VDDCBFPBLOCK)]);
+        Dest[0] = (uint8_t)(Value >> 16);
+        Dest[1] = (uint8_t)(Value >> 8);
+        Dest[2] = (uint8_t)Value;
+    }
+}
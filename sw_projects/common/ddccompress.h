@@ -0,0 +1,64 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// licenced under GNU GPL3
+//
+// ddccompress.h:
+// header file. 16 bit block floating point coding of DDC I/Q samples,
+// to roughly 2/3 the size of the 24 bit packets for limited links.
+//
+// the samples are coded in blocks of VDDCBFPBLOCK I/Q samples. Each block
+// has a shift (0-8): every 24 bit I and Q value in the block is shifted right
+// by it, with rounding, to a 16 bit value. The shift is the smallest that
+// fits the largest value in the block, so a block of weak signal loses nothing.
+// coded layout, for N samples in B = ceil(N/VDDCBFPBLOCK) blocks:
+//   B bytes:     shift for each block
+//   N*4 bytes:   16 bit big endian I then Q for each sample
+// decoded value = coded value << shift
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __ddccompress_h
+#define __ddccompress_h
+
+#include <stdint.h>
+#include "../common/saturntypes.h"
+
+
+#define VDDCBFPBLOCK 17                         // I/Q samples sharing one shift
+#define VDDCBFPBITS 16                          // coded bits per I or Q value
+
+
+//
+// uint32_t DDCBFPBytes(uint32_t Samples)
+// bytes needed to code a number of I/Q samples
+//
+uint32_t DDCBFPBytes(uint32_t Samples);
+
+
+//
+// uint32_t CompressDDCSamplesBFP(uint8_t* Dest, const uint8_t* Src, uint32_t Samples)
+// code samples as 16 bit block floating point
+//   Dest:      coded data, DDCBFPBytes(Samples) bytes written
+//   Src:       24 bit big endian I then Q, 6 bytes per sample
+//   Samples:   number of I/Q samples
+// Dest may be the same as Src: it can code a packet in place.
+// returns the number of bytes written
+//
+uint32_t CompressDDCSamplesBFP(uint8_t* Dest, const uint8_t* Src, uint32_t Samples);
+
+
+//
+// void DecompressDDCSamplesBFP(uint8_t* Dest, const uint8_t* Src, uint32_t Samples)
+// reverse of CompressDDCSamplesBFP(): the reference decode for clients
+//   Dest:      24 bit big endian I then Q, 6 bytes per sample
+//   Src:       coded data
+//   Samples:   number of I/Q samples
+//
+void DecompressDDCSamplesBFP(uint8_t* Dest, const uint8_t* Src, uint32_t Samples);
+
+
+#endif
@@ -0,0 +1,139 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// licenced under GNU GPL3
+//
+// ddcconvert.c:
+// DDC I/Q sample size conversion: 24 bit to 16 bit or float
+//
+//////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <endian.h>
+#include "../common/ddcconvert.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+
+//
+// 24 bit to 16 bit, one value at a time
+// rounding can only overflow for the largest positive values: saturate them
+//
+void ConvertDDCSamples16Scalar(uint8_t* Dest, const uint8_t* Src, uint32_t Samples)
+{
+    uint32_t Cntr;
+    int32_t Value;
+
+    for (Cntr = 0; Cntr < 2 * Samples; Cntr++, Src += 3, Dest += 2)
+    {
+        Value = (int32_t)(((uint32_t)Src[0] << 24) | ((uint32_t)Src[1] << 16) | ((uint32_t)Src[2] << 8)) >> 8;
+        Value = (Value + 128) >> 8;
+        if (Value > 32767)
+            Value = 32767;
+        Dest[0] = (uint8_t)(Value >> 8);
+        Dest[1] = (uint8_t)Value;
+    }
+}
+
+
+//
+// 24 bit to float, one value at a time: the value as Q31, so no sign extension is needed
+//
+void ConvertDDCSamplesFloatScalar(uint8_t* Dest, const uint8_t* Src, uint32_t Samples)
+{
+    uint32_t Cntr;
+    int32_t Value;
+    float Result;
+    uint32_t Bits;
+
+    for (Cntr = 0; Cntr < 2 * Samples; Cntr++, Src += 3, Dest += 4)
+    {
+        Value = (int32_t)(((uint32_t)Src[0] << 24) | ((uint32_t)Src[1] << 16) | ((uint32_t)Src[2] << 8));
+        Result = (float)Value * (1.0f / 2147483648.0f);
+        memcpy(&Bits, &Result, sizeof(Bits));
+        Bits = htole32(Bits);
+        memcpy(Dest, &Bits, sizeof(Bits));
+    }
+}
+
+
+#if defined(__ARM_NEON)
+//
+// 16 bit: the top 2 bytes of each value, plus 1 if the 3rd byte's top bit is set, saturating.
+// 16 values (8 samples) are read as 3 byte planes; 32 bytes are written after 48 are read,
+// so converting in place never overwrites samples not yet read
+//
+void ConvertDDCSamples16(uint8_t* Dest, const uint8_t* Src, uint32_t Samples)
+{
+    uint8x16x3_t Bytes;
+    uint8x16x2_t Coded;
+    int16x8_t Low, High;
+
+    for (; Samples >= 8; Samples -= 8, Src += 48, Dest += 32)
+    {
+        Bytes = vld3q_u8(Src);
+        Low = vreinterpretq_s16_u16(vorrq_u16(vshll_n_u8(vget_low_u8(Bytes.val[0]), 8),
+                                              vmovl_u8(vget_low_u8(Bytes.val[1]))));
+        High = vreinterpretq_s16_u16(vorrq_u16(vshll_n_u8(vget_high_u8(Bytes.val[0]), 8),
+                                               vmovl_u8(vget_high_u8(Bytes.val[1]))));
+        Low = vqaddq_s16(Low, vreinterpretq_s16_u16(vmovl_u8(vshr_n_u8(vget_low_u8(Bytes.val[2]), 7))));
+        High = vqaddq_s16(High, vreinterpretq_s16_u16(vmovl_u8(vshr_n_u8(vget_high_u8(Bytes.val[2]), 7))));
+        Coded.val[0] = vcombine_u8(vshrn_n_u16(vreinterpretq_u16_s16(Low), 8), vshrn_n_u16(vreinterpretq_u16_s16(High), 8));
+        Coded.val[1] = vcombine_u8(vmovn_u16(vreinterpretq_u16_s16(Low)), vmovn_u16(vreinterpretq_u16_s16(High)));
+        vst2q_u8(Dest, Coded);
+    }
+    ConvertDDCSamples16Scalar(Dest, Src, Samples);
+}
+
+
+//
+// float: 4 values as Q31 from the 3 byte planes
+//
+static inline float32x4_t ConvertQ31(uint16x4_t High, uint16x4_t Low)
+{
+    uint32x4_t Value = vorrq_u32(vshll_n_u16(High, 16), vmovl_u16(Low));
+    return vcvtq_n_f32_s32(vreinterpretq_s32_u32(Value), 31);
+}
+
+
+void ConvertDDCSamplesFloat(uint8_t* Dest, const uint8_t* Src, uint32_t Samples)
+{
+    uint8x16x3_t Bytes;
+    uint16x8_t HighLo, HighHi, LowLo, LowHi;
+    float* Out;
+
+    for (; Samples >= 8; Samples -= 8, Src += 48, Dest += 64)
+    {
+        Bytes = vld3q_u8(Src);
+        HighLo = vorrq_u16(vshll_n_u8(vget_low_u8(Bytes.val[0]), 8), vmovl_u8(vget_low_u8(Bytes.val[1])));
+        HighHi = vorrq_u16(vshll_n_u8(vget_high_u8(Bytes.val[0]), 8), vmovl_u8(vget_high_u8(Bytes.val[1])));
+        LowLo = vshll_n_u8(vget_low_u8(Bytes.val[2]), 8);
+        LowHi = vshll_n_u8(vget_high_u8(Bytes.val[2]), 8);
+        Out = (float*)Dest;
+        vst1q_f32(Out, ConvertQ31(vget_low_u16(HighLo), vget_low_u16(LowLo)));
+        vst1q_f32(Out + 4, ConvertQ31(vget_high_u16(HighLo), vget_high_u16(LowLo)));
+        vst1q_f32(Out + 8, ConvertQ31(vget_low_u16(HighHi), vget_low_u16(LowHi)));
+        vst1q_f32(Out + 12, ConvertQ31(vget_high_u16(HighHi), vget_high_u16(LowHi)));
+    }
+    ConvertDDCSamplesFloatScalar(Dest, Src, Samples);
+}
+
+#else
+
+void ConvertDDCSamples16(uint8_t* Dest, const uint8_t* Src, uint32_t Samples)
+{
+    ConvertDDCSamples16Scalar(Dest, Src, Samples);
+}
+
+
+void ConvertDDCSamplesFloat(uint8_t* Dest, const uint8_t* Src, uint32_t Samples)
+{
+    ConvertDDCSamplesFloatScalar(Dest, Src, Samples);
+}
+
+#endif
@@ -0,0 +1,58 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// licenced under GNU GPL3
+//
+// ddcconvert.h:
+// header file. DDC I/Q sample size conversion, from the 24 bit packet
+// format to the smaller or larger sample sizes a client can ask for:
+//   16 bit:  I then Q, big endian two's complement; the 24 bit value
+//            rounded to its top 16 bits, saturating. 4 bytes per sample
+//   float:   I then Q, 32 bit IEEE float, little endian (the byte order of
+//            the client processors, so they can use it as it is), scaled to
+//            [-1, 1). 8 bytes per sample
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __ddcconvert_h
+#define __ddcconvert_h
+
+#include <stdint.h>
+#include "../common/saturntypes.h"
+
+
+//
+// void ConvertDDCSamples16(uint8_t* Dest, const uint8_t* Src, uint32_t Samples)
+// convert 24 bit samples to 16 bit
+//   Dest:      16 bit big endian I then Q, 4 bytes written per sample
+//   Src:       24 bit big endian I then Q, 6 bytes per sample
+//   Samples:   number of I/Q samples
+// Dest may be the same as Src: it can convert a packet in place.
+// NEON: 8 samples per iteration, then scalar code for any remainder
+//
+void ConvertDDCSamples16(uint8_t* Dest, const uint8_t* Src, uint32_t Samples);
+
+
+//
+// void ConvertDDCSamplesFloat(uint8_t* Dest, const uint8_t* Src, uint32_t Samples)
+// convert 24 bit samples to float
+//   Dest:      little endian float I then Q, 8 bytes written per sample
+//              (not overlapping Src)
+//   Src:       24 bit big endian I then Q, 6 bytes per sample
+//   Samples:   number of I/Q samples
+// NEON: 8 samples per iteration, then scalar code for any remainder
+//
+void ConvertDDCSamplesFloat(uint8_t* Dest, const uint8_t* Src, uint32_t Samples);
+
+
+//
+// scalar versions. Always available.
+//
+void ConvertDDCSamples16Scalar(uint8_t* Dest, const uint8_t* Src, uint32_t Samples);
+void ConvertDDCSamplesFloatScalar(uint8_t* Dest, const uint8_t* Src, uint32_t Samples);
+
+
+#endif
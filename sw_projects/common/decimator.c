@@ -0,0 +1,207 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// decimator.c:
+// CIC and compensating FIR decimation of DDC I/Q samples
+//
+//////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <math.h>
+#include "../common/decimator.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+
+#define VDECCUTOFF 0.225                        // FIR cutoff, cycles per sample at the FIR input
+#define VDECDESIGNSTEPS 1024                    // integration steps for the FIR design
+#define VDECFULLSCALE 8388607.0f                // largest 24 bit sample
+
+
+//
+// bool InitialiseDecimator(struct Decimator* Dec, uint32_t Factor)
+// build the FIR for a decimation factor, and clear the filter state
+// the FIR is a Blackman windowed ideal low pass whose passband is the
+// inverse of the CIC response, found by integrating its spectrum:
+//   h[n] = w[n] * 2 * integral(0 to fc) D(f) cos(2 pi f (n - c)) df
+//   D(f) = (R sin(pi f / R) / sin(pi f)) ^ order, R = CIC decimation
+//
+bool InitialiseDecimator(struct Decimator* Dec, uint32_t Factor)
+{
+    uint32_t Tap, Step, Stage;
+    double Centre, Freq, Droop, Window;
+    double Sum = 0.0;
+    double Taps[VDECFIRTAPS];
+    double Gain = 1.0;
+
+    if ((Factor < VDECMINFACTOR) || (Factor > VDECMAXFACTOR) || ((Factor & (Factor - 1)) != 0))
+        return false;
+    memset(Dec, 0, sizeof(*Dec));
+    Dec->Factor = Factor;
+    Dec->CICFactor = Factor / 2;
+    for (Stage = 0; Stage < VDECCICORDER; Stage++)
+        Gain *= Dec->CICFactor;
+    Dec->CICScale = (float)(1.0 / Gain);
+
+    Centre = (VDECFIRTAPS - 1) / 2.0;
+    for (Tap = 0; Tap < VDECFIRTAPS; Tap++)
+    {
+        Taps[Tap] = 0.0;
+        for (Step = 0; Step < VDECDESIGNSTEPS; Step++)
+        {
+            Freq = VDECCUTOFF * (Step + 0.5) / VDECDESIGNSTEPS;
+            Droop = 1.0;
+            if (Dec->CICFactor > 1)
+                Droop = pow(Dec->CICFactor * sin(M_PI * Freq / Dec->CICFactor) / sin(M_PI * Freq), VDECCICORDER);
+            Taps[Tap] += Droop * cos(2.0 * M_PI * Freq * (Tap - Centre));
+        }
+        Window = 0.42 - 0.5 * cos(2.0 * M_PI * Tap / (VDECFIRTAPS - 1)) + 0.08 * cos(4.0 * M_PI * Tap / (VDECFIRTAPS - 1));
+        Taps[Tap] *= Window;
+        Sum += Taps[Tap];
+    }
+    for (Tap = 0; Tap < VDECFIRTAPS; Tap++)
+        Dec->Coeffs[Tap] = (float)(Taps[Tap] / Sum);
+    return true;
+}
+
+
+//
+// void ResetDecimator(struct Decimator* Dec)
+// clear the filter state
+//
+void ResetDecimator(struct Decimator* Dec)
+{
+    memset(Dec->Integrators, 0, sizeof(Dec->Integrators));
+    memset(Dec->Combs, 0, sizeof(Dec->Combs));
+    memset(Dec->HistoryI, 0, sizeof(Dec->HistoryI));
+    memset(Dec->HistoryQ, 0, sizeof(Dec->HistoryQ));
+    Dec->CICCount = 0;
+    Dec->HistoryPos = 0;
+    Dec->FIRPhase = false;
+}
+
+
+//
+// FIR dot products of the delay lines with the taps
+//
+static void RunDecimatorFIR(const struct Decimator* Dec, float* OutI, float* OutQ)
+{
+    const float* HistI = Dec->HistoryI + Dec->HistoryPos;
+    const float* HistQ = Dec->HistoryQ + Dec->HistoryPos;
+    uint32_t Tap = 0;
+    float SumI = 0.0f;
+    float SumQ = 0.0f;
+
+#if defined(__ARM_NEON)
+    float32x4_t AccI = vdupq_n_f32(0.0f);
+    float32x4_t AccQ = vdupq_n_f32(0.0f);
+    for (; Tap < VDECFIRTAPS; Tap += 4)
+    {
+        float32x4_t Coeff = vld1q_f32(Dec->Coeffs + Tap);
+        AccI = vmlaq_f32(AccI, Coeff, vld1q_f32(HistI + Tap));
+        AccQ = vmlaq_f32(AccQ, Coeff, vld1q_f32(HistQ + Tap));
+    }
+    float32x2_t PairI = vadd_f32(vget_low_f32(AccI), vget_high_f32(AccI));    // (vaddvq is 64 bit only)
+    float32x2_t PairQ = vadd_f32(vget_low_f32(AccQ), vget_high_f32(AccQ));
+    SumI = vget_lane_f32(vpadd_f32(PairI, PairI), 0);
+    SumQ = vget_lane_f32(vpadd_f32(PairQ, PairQ), 0);
+#else
+    for (; Tap < VDECFIRTAPS; Tap++)
+    {
+        SumI += Dec->Coeffs[Tap] * HistI[Tap];
+        SumQ += Dec->Coeffs[Tap] * HistQ[Tap];
+    }
+#endif
+    *OutI = SumI;
+    *OutQ = SumQ;
+}
+
+
+//
+// write one float sample as 24 bit big endian, rounded and limited
+//
+static inline void WriteDecimatorSample(uint8_t* Dest, float Value)
+{
+    int32_t Sample;
+
+    if (Value > VDECFULLSCALE)
+        Value = VDECFULLSCALE;
+    else if (Value < -VDECFULLSCALE)
+        Value = -VDECFULLSCALE;
+    Sample = (int32_t)(Value + ((Value >= 0.0f) ? 0.5f : -0.5f));
+    Dest[0] = (uint8_t)(Sample >> 16);
+    Dest[1] = (uint8_t)(Sample >> 8);
+    Dest[2] = (uint8_t)Sample;
+}
+
+
+//
+// uint32_t RunDecimator(struct Decimator* Dec, const uint8_t* Input, uint32_t Count, uint8_t* Output)
+// decimate a run of samples; returns the number of output samples
+//
+uint32_t RunDecimator(struct Decimator* Dec, const uint8_t* Input, uint32_t Count, uint8_t* Output)
+{
+    uint32_t Cntr, Stage, Channel;
+    uint32_t Produced = 0;
+    int64_t Sample[2];
+    uint64_t Value, Previous;
+    float OutI, OutQ;
+
+    for (Cntr = 0; Cntr < Count; Cntr++, Input += 6)
+    {
+        Sample[0] = (int32_t)((Input[0] << 24) | (Input[1] << 16) | (Input[2] << 8)) >> 8;
+        Sample[1] = (int32_t)((Input[3] << 24) | (Input[4] << 16) | (Input[5] << 8)) >> 8;
+        //
+        // CIC: integrators at the input rate, combs at the CIC output rate
+        //
+        if (Dec->CICFactor > 1)
+        {
+            for (Channel = 0; Channel < 2; Channel++)
+            {
+                Value = (uint64_t)Sample[Channel];
+                for (Stage = 0; Stage < VDECCICORDER; Stage++)
+                {
+                    Dec->Integrators[Channel][Stage] += Value;
+                    Value = Dec->Integrators[Channel][Stage];
+                }
+            }
+            if (++Dec->CICCount < Dec->CICFactor)
+                continue;
+            Dec->CICCount = 0;
+            for (Channel = 0; Channel < 2; Channel++)
+            {
+                Value = Dec->Integrators[Channel][VDECCICORDER - 1];
+                for (Stage = 0; Stage < VDECCICORDER; Stage++)
+                {
+                    Previous = Dec->Combs[Channel][Stage];
+                    Dec->Combs[Channel][Stage] = Value;
+                    Value -= Previous;
+                }
+                Sample[Channel] = (int64_t)Value;
+            }
+        }
+        //
+        // FIR: every input goes into the delay line; every 2nd gives an output
+        //
+        Dec->HistoryPos = (Dec->HistoryPos == 0) ? VDECFIRTAPS - 1 : Dec->HistoryPos - 1;
+        Dec->HistoryI[Dec->HistoryPos] = Dec->HistoryI[Dec->HistoryPos + VDECFIRTAPS] = (float)Sample[0] * Dec->CICScale;
+        Dec->HistoryQ[Dec->HistoryPos] = Dec->HistoryQ[Dec->HistoryPos + VDECFIRTAPS] = (float)Sample[1] * Dec->CICScale;
+        Dec->FIRPhase = !Dec->FIRPhase;
+        if (Dec->FIRPhase)
+            continue;
+        RunDecimatorFIR(Dec, &OutI, &OutQ);
+        WriteDecimatorSample(Output, OutI);
+        WriteDecimatorSample(Output + 3, OutQ);
+        Output += 6;
+        Produced++;
+    }
+    return Produced;
+}
@@ -0,0 +1,83 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// decimator.h:
+// header file. Software decimation of a DDC I/Q stream by a power of 2,
+// so one hardware DDC can also feed a lower rate stream.
+//
+// a CIC filter (VDECCICORDER stages) decimates by Factor/2, then a
+// compensating FIR (VDECFIRTAPS taps) corrects the CIC droop and
+// decimates by 2. The FIR passes 80% of the output band (to 0.4 * the
+// output rate either side of centre) and is 6dB down at 0.45; for a
+// decimation by 2 there is no CIC stage. Gain is unity at DC.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __decimator_h
+#define __decimator_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../common/saturntypes.h"
+
+
+#define VDECMINFACTOR 2                         // decimations supported: powers of 2 from 2 to 32
+#define VDECMAXFACTOR 32
+#define VDECCICORDER 4                          // CIC integrator and comb stages
+#define VDECFIRTAPS 128                         // compensating FIR taps (a multiple of 4)
+
+
+//
+// decimator state. No memory is allocated.
+// the FIR delay lines are stored twice over, one after the other, so the
+// taps can be read in one run whatever the current position.
+//
+struct Decimator
+{
+    uint32_t Factor;                            // overall decimation
+    uint32_t CICFactor;                         // CIC decimation: Factor / 2
+    uint32_t CICCount;                          // input samples since the last CIC output
+    float CICScale;                             // 1 / CIC gain
+    uint64_t Integrators[2][VDECCICORDER];      // [I/Q][stage]; modulo 2^64 arithmetic
+    uint64_t Combs[2][VDECCICORDER];            // previous comb inputs
+    float Coeffs[VDECFIRTAPS];                  // FIR taps, newest sample first
+    float HistoryI[2 * VDECFIRTAPS];            // FIR delay lines, newest at HistoryPos
+    float HistoryQ[2 * VDECFIRTAPS];
+    uint32_t HistoryPos;
+    bool FIRPhase;                              // true if the next FIR input gives an output
+};
+
+
+//
+// bool InitialiseDecimator(struct Decimator* Dec, uint32_t Factor)
+// build the FIR for a decimation factor, and clear the filter state
+//   Factor:    a power of 2 from VDECMINFACTOR to VDECMAXFACTOR
+// returns false if the factor is not supported
+//
+bool InitialiseDecimator(struct Decimator* Dec, uint32_t Factor);
+
+
+//
+// void ResetDecimator(struct Decimator* Dec)
+// clear the filter state, eg at a gap in the input
+//
+void ResetDecimator(struct Decimator* Dec);
+
+
+//
+// uint32_t RunDecimator(struct Decimator* Dec, const uint8_t* Input, uint32_t Count, uint8_t* Output)
+// decimate a run of samples
+//   Input:     Count samples, 24 bit big endian I then Q as in a protocol 2 packet
+//   Output:    decimated samples in the same format; room for Count / Factor + 1
+// returns the number of output samples
+//
+uint32_t RunDecimator(struct Decimator* Dec, const uint8_t* Input, uint32_t Count, uint8_t* Output);
+
+
+#endif
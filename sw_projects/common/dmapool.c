@@ -0,0 +1,154 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 1 
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// dmapool.c:
+// pool of locked memory for DMA buffers
+//
+// a simple "bump" allocator: buffers are handed out from the bottom of the
+// pool upwards and never returned, because each stream thread allocates
+// its buffers once when it starts.
+//
+//////////////////////////////////////////////////////////////
+
+#include "../common/dmapool.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+
+uint8_t* DMAPoolBase = NULL;                    // start of pool; NULL if not allocated
+size_t DMAPoolSize = 0;                         // size of pool in bytes
+size_t DMAPoolUsed = 0;                         // bytes handed out so far
+bool DMAPoolHugePages = false;                  // true if backed by explicit huge pages
+bool DMAPoolLocked = false;                     // true if mlock() succeeded
+pthread_mutex_t DMAPoolMutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+//
+// bool InitialiseDMAPool(size_t Size)
+// allocate and lock the pool
+//
+bool InitialiseDMAPool(size_t Size)
+{
+    void* Pool;
+
+    if(DMAPoolBase != NULL)
+        return false;
+    //
+    // explicit huge pages need them reserved (vm.nr_hugepages); if not, use normal pages
+    // and ask for transparent huge pages. MAP_POPULATE faults the pages in now.
+    //
+    Pool = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+    if(Pool != MAP_FAILED)
+        DMAPoolHugePages = true;
+    else
+    {
+        Pool = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if(Pool == MAP_FAILED)
+        {
+            printf("DMA buffer pool allocation failed\n");
+            return true;
+        }
+        madvise(Pool, Size, MADV_HUGEPAGE);
+    }
+    if(mlock(Pool, Size) == 0)
+        DMAPoolLocked = true;
+    else
+        printf("DMA buffer pool could not be locked in memory (needs root or CAP_IPC_LOCK)\n");
+    memset(Pool, 0, Size);
+    DMAPoolBase = (uint8_t*)Pool;
+    DMAPoolSize = Size;
+    DMAPoolUsed = 0;
+    return false;
+}
+
+
+//
+// uint8_t* AllocateDMABuffer(size_t Size, const char* Name)
+// take a buffer from the pool, or fall back to the heap
+//
+uint8_t* AllocateDMABuffer(size_t Size, const char* Name)
+{
+    uint8_t* Buffer = NULL;
+    size_t Rounded;
+
+    Rounded = (Size + VDMAPOOLALIGN - 1) & ~((size_t)VDMAPOOLALIGN - 1);
+    pthread_mutex_lock(&DMAPoolMutex);
+    if((DMAPoolBase != NULL) && (DMAPoolUsed + Rounded <= DMAPoolSize))
+    {
+        Buffer = DMAPoolBase + DMAPoolUsed;
+        DMAPoolUsed += Rounded;
+    }
+    pthread_mutex_unlock(&DMAPoolMutex);
+    if(Buffer != NULL)
+        return Buffer;                          // pool memory is already zeroed
+
+    if(DMAPoolBase != NULL)
+        printf("DMA buffer pool full: %s buffer from heap\n", Name);
+    if(posix_memalign((void**)&Buffer, VDMAPOOLALIGN, Rounded) != 0)
+        return NULL;
+    memset(Buffer, 0, Rounded);
+    mlock(Buffer, Rounded);
+    return Buffer;
+}
+
+
+//
+// void FreeDMABuffer(uint8_t* Buffer)
+// only heap buffers are actually freed
+//
+void FreeDMABuffer(uint8_t* Buffer)
+{
+    if(Buffer == NULL)
+        return;
+    if((DMAPoolBase != NULL) && (Buffer >= DMAPoolBase) && (Buffer < DMAPoolBase + DMAPoolSize))
+        return;
+    free(Buffer);
+}
+
+
+//
+// uint8_t* AllocateLockedBuffer(size_t Size)
+// anonymous mapping: zeroed, and unmapped again on release so the memory goes back
+//
+uint8_t* AllocateLockedBuffer(size_t Size)
+{
+    void* Buffer;
+
+    Buffer = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if(Buffer == MAP_FAILED)
+        return NULL;
+    mlock(Buffer, Size);
+    return (uint8_t*)Buffer;
+}
+
+
+//
+// void ReleaseLockedBuffer(uint8_t* Buffer, size_t Size)
+//
+void ReleaseLockedBuffer(uint8_t* Buffer, size_t Size)
+{
+    if(Buffer != NULL)
+        munmap(Buffer, Size);
+}
+
+
+//
+// void ReportDMAPool(void)
+//
+void ReportDMAPool(void)
+{
+    if(DMAPoolBase == NULL)
+        printf("DMA buffer pool not in use\n");
+    else
+        printf("DMA buffer pool: %zu of %zu bytes used, %s pages, %s\n", DMAPoolUsed, DMAPoolSize,
+               DMAPoolHugePages ? "huge" : "normal", DMAPoolLocked ? "locked" : "not locked");
+}
@@ -0,0 +1,82 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 1 
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// dmapool.h:
+// header file. pool of locked memory for DMA buffers
+//
+// the pool is allocated once at startup, hugepage backed if the kernel
+// has huge pages available, and locked into memory so the stream threads
+// don't take page faults when they start. Each stream thread takes its
+// aligned buffers from the pool.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __dmapool_h
+#define __dmapool_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../common/saturntypes.h"
+
+
+#define VDMAPOOLSIZE 0x200000                   // 2MB: one huge page holds all the stream buffers
+#define VDMAPOOLALIGN 4096                      // every buffer from the pool is 4K aligned
+
+
+//
+// bool InitialiseDMAPool(size_t Size)
+// allocate and lock the pool. Call once, before the stream threads start.
+// tries for huge pages first, then normal pages with a transparent huge page hint.
+// returns true if the pool could not be allocated; AllocateDMABuffer() then falls back.
+//
+bool InitialiseDMAPool(size_t Size);
+
+
+//
+// uint8_t* AllocateDMABuffer(size_t Size, const char* Name)
+// get a zeroed, 4K aligned buffer from the pool. Thread safe.
+// if the pool isn't initialised or is used up, the buffer is allocated
+// with posix_memalign and locked instead, with a message.
+// Name is used in messages only. Returns NULL if no memory at all.
+//
+uint8_t* AllocateDMABuffer(size_t Size, const char* Name);
+
+
+//
+// void FreeDMABuffer(uint8_t* Buffer)
+// free a buffer from AllocateDMABuffer().
+// buffers in the pool are not reused: the pool lasts for the life of the program.
+//
+void FreeDMABuffer(uint8_t* Buffer);
+
+
+//
+// uint8_t* AllocateLockedBuffer(size_t Size)
+// get a zeroed, page aligned buffer of its own, outside the pool, faulted in
+// and locked, for a buffer that is given back while the program runs.
+// returns NULL if no memory.
+//
+uint8_t* AllocateLockedBuffer(size_t Size);
+
+
+//
+// void ReleaseLockedBuffer(uint8_t* Buffer, size_t Size)
+// give a buffer from AllocateLockedBuffer() back to the system. Size as allocated.
+//
+void ReleaseLockedBuffer(uint8_t* Buffer, size_t Size);
+
+
+//
+// void ReportDMAPool(void)
+// print the pool type and how much of it has been used
+//
+void ReportDMAPool(void);
+
+
+#endif
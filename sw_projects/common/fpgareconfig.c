@@ -0,0 +1,189 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// licenced under GNU GPL3
+//
+// fpgareconfig.c:
+// warm reconfiguration of the FPGA from flash: ICAP IPROG, then PCIe device
+// remove, bus rescan and XDMA driver rebind
+//
+//////////////////////////////////////////////////////////////
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "../common/fpgareconfig.h"
+#include "../common/hwaccess.h"
+#include "../common/saturnregisters.h"
+#include "../common/version.h"
+
+
+#define VICAPKEY 0x1CA9                         // arms the FPGA reconfiguration core
+#define VICAPDELAYMS 250                        // IPROG this long after arming: time to remove the device
+#define VRECONFIGPOLLMS 250                     // rescan and device node check interval
+#define VXDMADRIVERBIND "/sys/bus/pci/drivers/xdma/bind"
+#define VPCIRESCAN "/sys/bus/pci/rescan"
+
+
+//
+// write a string to a sysfs file; returns false and reports if it fails
+//
+static bool WriteSysfs(const char* Path, const char* Value)
+{
+	FILE* File;
+	bool Result;
+
+	File = fopen(Path, "w");
+	if (File == NULL)
+	{
+		printf("reconfigure: can't open %s: %s\n", Path, strerror(errno));
+		return false;
+	}
+	Result = (fputs(Value, File) >= 0);
+	Result = (fclose(File) == 0) && Result;
+	if (!Result)
+		printf("reconfigure: write to %s failed: %s\n", Path, strerror(errno));
+	return Result;
+}
+
+
+static uint64_t ReconfigNowMs(void)
+{
+	struct timespec Now;
+
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	return (uint64_t)Now.tv_sec * 1000 + (uint64_t)Now.tv_nsec / 1000000;
+}
+
+
+//
+// read a reconfiguration target: "primary", "reload" or a flash address
+//
+bool ParseReconfigTarget(const char* Text, uint32_t* FlashAddress)
+{
+	char* End;
+	unsigned long Address;
+
+	if (strcasecmp(Text, "primary") == 0)
+		*FlashAddress = VRECONFIGPRIMARYADDR;
+	else if (strcasecmp(Text, "reload") == 0)
+		*FlashAddress = VRECONFIGRELOADADDR;
+	else
+	{
+		Address = strtoul(Text, &End, 0);
+		if ((End == Text) || (*End != 0) || (Address > 0xFFFFFFFFUL) || (Address & 0xFF))
+			return false;
+		*FlashAddress = (uint32_t)Address;
+	}
+	return true;
+}
+
+
+//
+// reload the FPGA from flash, and reopen the register device
+// the sequence is: find the PCI device; arm the ICAP core; close the register
+// device; remove the PCI device (unbinding the driver); wait for IPROG and
+// configuration; rescan until the device returns; bind the driver if the
+// rescan didn't; wait for the device node; reopen and probe the firmware.
+//
+bool WarmReconfigureFPGA(uint32_t FlashAddress, uint32_t TimeoutMs)
+{
+	char Name[32];
+	char Path[PATH_MAX + 16];
+	char DevicePath[PATH_MAX];
+	char BDF[64];
+	const char* Slash;
+	struct stat Stat;
+	uint32_t Status;
+	uint64_t Start, Deadline;
+
+	if (!GetFPGACapabilities()->HasICAPReconfig)
+	{
+		printf("reconfigure: FPGA firmware V%u has no reconfiguration core (no released bitfile has it yet)\n",
+			   GetFPGACapabilities()->Version);
+		return false;
+	}
+//
+// the PCI device: /sys/class/xdma/xdma<card>_user/device is a link to it
+//
+	snprintf(Path, sizeof(Path), "/sys/class/xdma/xdma%u_user/device", GetXDMACard());
+	if (realpath(Path, DevicePath) == NULL)
+	{
+		printf("reconfigure: can't find the PCI device from %s: %s\n", Path, strerror(errno));
+		return false;
+	}
+	Slash = strrchr(DevicePath, '/');
+	snprintf(BDF, sizeof(BDF), "%.63s", (Slash != NULL) ? Slash + 1 : DevicePath);
+	snprintf(Path, sizeof(Path), "%s/remove", DevicePath);
+	if (access(Path, W_OK) != 0)
+	{
+		printf("reconfigure: can't remove PCI device %s (run as root)\n", BDF);
+		return false;
+	}
+//
+// arm the reconfiguration, and check it took
+//
+	RegisterWrite(VADDRICAPADDRREG, FlashAddress);
+	RegisterWrite(VADDRICAPCONTROLREG, (VICAPKEY << 16) | VICAPDELAYMS);
+	Status = RegisterRead(VADDRICAPCONTROLREG);
+	if (((Status >> 16) != VICAPKEY) || ((Status & 0x8000) == 0))
+	{
+		printf("reconfigure: reconfiguration core did not arm (status %08x)\n", Status);
+		RegisterWrite(VADDRICAPCONTROLREG, 0);
+		return false;
+	}
+	Start = ReconfigNowMs();
+	printf("reconfigure: loading FPGA image at flash address 0x%08x (PCI device %s)\n", FlashAddress, BDF);
+//
+// let the driver go before the link drops
+//
+	CloseXDMADriver();
+	if (!WriteSysfs(Path, "1"))
+		printf("reconfigure: continuing; the driver may report errors as the link drops\n");
+//
+// configuration takes of the order of a second. Rescan until the device is back
+//
+	Deadline = Start + VICAPDELAYMS + TimeoutMs;
+	usleep(2 * VICAPDELAYMS * 1000);                    // well past IPROG, so the old image can't be found
+	while (stat(DevicePath, &Stat) != 0)
+	{
+		if (ReconfigNowMs() > Deadline)
+		{
+			printf("reconfigure: PCI device %s did not return in %ums\n", BDF, TimeoutMs);
+			return false;
+		}
+		usleep(VRECONFIGPOLLMS * 1000);
+		WriteSysfs(VPCIRESCAN, "1");
+	}
+	snprintf(Path, sizeof(Path), "%s/driver", DevicePath);
+	if (stat(Path, &Stat) != 0)
+		WriteSysfs(VXDMADRIVERBIND, BDF);
+//
+// wait for udev to make the device node, then reopen
+//
+	GetXDMADeviceName(VXDMADEVICEPREFIX "user", Name, sizeof(Name));
+	while (access(Name, R_OK | W_OK) != 0)
+	{
+		if (ReconfigNowMs() > Deadline)
+		{
+			printf("reconfigure: %s did not appear in %ums\n", Name, TimeoutMs);
+			return false;
+		}
+		usleep(VRECONFIGPOLLMS * 1000);
+	}
+	if (!OpenXDMADriverMapped(false, true))
+		return false;
+	printf("reconfigure: FPGA reloaded in %.1fs\n", (double)(ReconfigNowMs() - Start) / 1000.0);
+	return true;
+}
@@ -0,0 +1,53 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// licenced under GNU GPL3
+//
+// fpgareconfig.h:
+// header file. warm reconfiguration of the FPGA from flash, without a power
+// cycle or host reboot
+//
+// the FPGA ICAP reconfiguration core (not yet in a released bitfile) is armed with the flash
+// address of the image to load and a short delay. Then the PCIe device is
+// removed so the XDMA driver lets go of it cleanly, the FPGA sends IPROG to
+// its configuration logic and reloads, and the PCIe bus is rescanned until
+// the device is back, bound to the driver and its device nodes made.
+// this needs root, to write to the PCI sysfs files.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __fpgareconfig_h
+#define __fpgareconfig_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#define VRECONFIGPRIMARYADDR 0x00980000         // primary image in the multiboot flash layout
+#define VRECONFIGRELOADADDR 0x00000000          // golden image: the power up multiboot sequence
+#define VRECONFIGDEFAULTTIMEOUT 10000           // ms allowed for the device to return
+
+
+//
+// bool ParseReconfigTarget(const char* Text, uint32_t* FlashAddress)
+// read a reconfiguration target: "primary", "reload" or a flash address
+// returns false if not recognised
+//
+bool ParseReconfigTarget(const char* Text, uint32_t* FlashAddress);
+
+
+//
+// bool WarmReconfigureFPGA(uint32_t FlashAddress, uint32_t TimeoutMs)
+// reload the FPGA from the image at FlashAddress, then reopen the register
+// device and read the new firmware's capabilities.
+// the DMA devices must be closed first: the driver is unbound while it runs.
+// returns false if the firmware can't do it, or the device didn't come back
+// within TimeoutMs (the register device is then closed)
+//
+bool WarmReconfigureFPGA(uint32_t FlashAddress, uint32_t TimeoutMs);
+
+
+#endif
@@ -0,0 +1,99 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+//
+// licenced under GNU GPL3
+//
+// gentables.c:
+// build time generator for precomputedtables.h: evaluates the formulas in
+// tableformulas.h and writes the constant tables as C source to stdout.
+// run by "make tables" in P2_app:
+//     gcc -o gentables ../common/gentables.c -lm && ./gentables > ../common/precomputedtables.h
+//
+//////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include "../common/tableformulas.h"
+
+
+//
+// CW ramps used at startup: protocol 1 and protocol 2 defaults
+//
+static const struct
+{
+    uint32_t Length_us;
+    bool IsP2;
+} CWRampsToGenerate[] =
+{
+    { 5000, false },                                    // p1app default
+    { 9000, true },                                     // p2app default (DL1YCF)
+};
+#define VNUMGENRAMPS (sizeof(CWRampsToGenerate) / sizeof(CWRampsToGenerate[0]))
+
+
+//
+// write an array of values, 8 per line
+//
+static void WriteTable(const char* Declaration, const uint32_t* Values, uint32_t Count)
+{
+    uint32_t Cntr;
+
+    printf("%s =\n{", Declaration);
+    for (Cntr = 0; Cntr < Count; Cntr++)
+        printf("%s%s%u", (Cntr == 0) ? "" : ",", (Cntr % 8 == 0) ? "\n    " : " ", Values[Cntr]);
+    printf("\n};\n\n");
+}
+
+
+int main(void)
+{
+    uint32_t Current[VDACROMSIZE];
+    uint32_t Step[VDACROMSIZE];
+    uint32_t Ramp[VRAMPSIZE];
+    unsigned int DACDrive, StepValue;
+    uint32_t Cntr;
+    uint32_t RampLength;
+    char Name[128];
+
+    printf("//////////////////////////////////////////////////////////////\n");
+    printf("//\n");
+    printf("// precomputedtables.h:\n");
+    printf("// GENERATED by gentables.c from the formulas in tableformulas.h - do not edit.\n");
+    printf("// constant hardware tables, evaluated at build time. Included by saturnregisters.c only.\n");
+    printf("//\n");
+    printf("//////////////////////////////////////////////////////////////\n\n");
+    printf("#ifndef __precomputedtables_h\n#define __precomputedtables_h\n\n");
+    printf("#include \"../common/tableformulas.h\"\n\n\n");
+
+    for (Cntr = 0; Cntr < VDACROMSIZE; Cntr++)
+    {
+        CalculateDACAttenEntry(Cntr, &DACDrive, &StepValue);
+        Current[Cntr] = DACDrive;
+        Step[Cntr] = StepValue;
+    }
+    printf("//\n// ROMs for DAC Current Setting and 0.5dB step digital attenuator\n//\n");
+    WriteTable("const unsigned int DACCurrentROM[VDACROMSIZE]", Current, VDACROMSIZE);
+    WriteTable("const unsigned int DACStepAttenROM[VDACROMSIZE]", Step, VDACROMSIZE);
+
+    printf("\n//\n// CW ramps for the startup ramp lengths\n//\n");
+    for (Cntr = 0; Cntr < VNUMGENRAMPS; Cntr++)
+    {
+        RampLength = CalculateCWRampLength(CWRampsToGenerate[Cntr].IsP2, CWRampsToGenerate[Cntr].Length_us);
+        CalculateCWRamp(Ramp, RampLength);
+        snprintf(Name, sizeof(Name), "static const uint32_t CWRamp%s_%u[%u]",
+                 CWRampsToGenerate[Cntr].IsP2 ? "P2" : "P1", CWRampsToGenerate[Cntr].Length_us, RampLength);
+        WriteTable(Name, Ramp, RampLength);
+    }
+    printf("#define VNUMPRECOMPUTEDRAMPS %u\n\n", (unsigned int)VNUMGENRAMPS);
+    printf("static const struct PrecomputedCWRamp PrecomputedCWRamps[VNUMPRECOMPUTEDRAMPS] =\n{\n");
+    for (Cntr = 0; Cntr < VNUMGENRAMPS; Cntr++)
+    {
+        RampLength = CalculateCWRampLength(CWRampsToGenerate[Cntr].IsP2, CWRampsToGenerate[Cntr].Length_us);
+        printf("    { %u, %s, %u, CWRamp%s_%u },\n", CWRampsToGenerate[Cntr].Length_us,
+               CWRampsToGenerate[Cntr].IsP2 ? "true" : "false", RampLength,
+               CWRampsToGenerate[Cntr].IsP2 ? "P2" : "P1", CWRampsToGenerate[Cntr].Length_us);
+    }
+    printf("};\n\n\n#endif\n");
+    return 0;
+}
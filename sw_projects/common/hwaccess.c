@@ -25,20 +25,113 @@
 
 #include <sys/types.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <stdbool.h>
 
 #define VMEMBUFFERSIZE 32768										// memory buffer to reserve
 #define AXIBaseAddress 0x10000									// address of StreamRead/Writer IP
+#define VREGISTERMAPSIZE 0x20000								// AXI-Lite space mapped: all registers + keyer RAM
+#define VXDMAPOLLSET _IOW('q', 13, int)							// IOCTL_XDMA_POLL_SET in the driver's cdev_sgdma.h
+#define VXDMAPOLLIRQSET _IOW('q', 16, int)						// IOCTL_XDMA_POLL_IRQ_SET in the driver's cdev_sgdma.h
+#define VXDMAEOPSET _IOW('q', 18, int)							// IOCTL_XDMA_EOP_SET in the driver's cdev_sgdma.h
+#define VXDMATIMINGGET _IOR('q', 19, struct DMATimestamps *)		// IOCTL_XDMA_TIMING_GET in the driver's cdev_sgdma.h
+#define VXDMAMMAPWC 0x40000000L									// XDMA_MMAP_WC_OFFSET in the driver's cdev_ctrl.h
+#define VFLUSHREADADDR 0x4004									// FPGA date code: a register read with no side effects
 
 #include "../common/hwaccess.h"
+#include "../common/version.h"
+#include "../common/regtrace.h"
+
+//
+// IOCTL_XDMA_VEC_XFER and its structures, as in the driver's cdev_sgdma.h
+//
+struct XDMAVecEntry
+{
+	uint64_t ep_addr;
+	uint64_t buf;
+	uint64_t length;
+};
+
+struct XDMAVecIoctl
+{
+	uint64_t entries;
+	uint32_t count;
+	uint32_t reserved;
+};
+#define VXDMAVECXFER _IOW('q', 15, struct XDMAVecIoctl *)
+
+//
+// driver DMA buffer ioctls and their structures, as in the driver's cdev_sgdma.h
+//
+struct XDMABufferIoctl
+{
+	uint64_t size;
+};
+
+struct XDMABufferXferIoctl
+{
+	uint64_t offset;
+	uint64_t length;
+	uint64_t ep_addr;
+};
+#define VXDMABUFFERFREE _IO('q', 8)
+#define VXDMABUFFERXFER _IOW('q', 9, struct XDMABufferXferIoctl *)
+#define VXDMABUFFERALLOCCACHED _IOW('q', 17, struct XDMABufferIoctl *)
+
+
+//
+// mem read/write variables: a device context for each card, and the selected one
+//
+struct XDMADevice XDMADevices[VMAXXDMACARDS] =
+{
+	{0, -1, NULL, NULL}, {1, -1, NULL, NULL}, {2, -1, NULL, NULL}, {3, -1, NULL, NULL},
+	{4, -1, NULL, NULL}, {5, -1, NULL, NULL}, {6, -1, NULL, NULL}, {7, -1, NULL, NULL}
+};
+struct XDMADevice* XDMA = &XDMADevices[0];		// selected card
+
+
+
+//
+// select the card used for register access and DMA device opens
+// the capability descriptor is for one card, so probe again if it changes
+//
+bool SelectXDMACard(uint32_t Card)
+{
+	if (Card >= VMAXXDMACARDS)
+		return false;
+	if (XDMA != &XDMADevices[Card])
+	{
+		XDMA = &XDMADevices[Card];
+		GFPGACapabilities.Valid = false;
+		if (XDMA->RegisterFd != -1)
+			ProbeFPGACapabilities();
+	}
+	return true;
+}
+
+
+uint32_t GetXDMACard(void)
+{
+	return XDMA->Card;
+}
 
 
 //
-// mem read/write variables:
+// substitute the selected card number into a card 0 device name
 //
-	int register_fd;                             // device identifier
+const char* GetXDMADeviceName(const char* Device, char* Name, uint32_t Length)
+{
+	uint32_t PrefixLength = strlen(VXDMADEVICEPREFIX) - 2;		// "/dev/xdma"
+
+	if (strncmp(Device, VXDMADEVICEPREFIX, PrefixLength + 2) == 0)
+		snprintf(Name, Length, "%.*s%u%s", (int)PrefixLength, Device, XDMA->Card, Device + PrefixLength + 1);
+	else
+		snprintf(Name, Length, "%s", Device);
+	return Name;
+}
 
 
 
@@ -47,18 +140,56 @@
 // open connection to the XDMA device driver for register and DMA access
 //
 int OpenXDMADriver(bool Silent)
+{
+	return OpenXDMADriverMapped(Silent, false);
+}
+
+
+//
+// open connection to the XDMA device driver for register and DMA access
+// if UseMmap, map the register space so each register access is a load or store
+// without a system call; if the map fails, pread/pwrite are used as before.
+//
+int OpenXDMADriverMapped(bool Silent, bool UseMmap)
 {
     int Result = 0;
-	if ((register_fd = open("/dev/xdma0_user", O_RDWR)) == -1)
+	void* Map;
+	char Name[32];
+
+	XDMA->RegisterBase = NULL;
+	XDMA->RegisterBaseWC = NULL;
+	GetXDMADeviceName(VXDMADEVICEPREFIX "user", Name, sizeof(Name));
+	if ((XDMA->RegisterFd = open(Name, O_RDWR | O_SYNC)) == -1)
     {
 		if(!Silent)
-			printf("register R/W address space not available\n");
+			printf("register R/W address space %s not available\n", Name);
     }
     else
     {
-		if(!Silent)
-			printf("register access connected to /dev/xdma0_user\n");
         Result = 1;
+		if(UseMmap)
+		{
+			Map = mmap(NULL, VREGISTERMAPSIZE, PROT_READ | PROT_WRITE, MAP_SHARED, XDMA->RegisterFd, 0);
+			if (Map != MAP_FAILED)
+				XDMA->RegisterBase = (volatile uint8_t*)Map;
+			else if(!Silent)
+				perror("register space mmap; using pread/pwrite");
+			// second, write-combined view for block uploads; optional (older drivers refuse it)
+			if(XDMA->RegisterBase)
+			{
+				Map = mmap(NULL, VREGISTERMAPSIZE, PROT_READ | PROT_WRITE, MAP_SHARED, XDMA->RegisterFd, VXDMAMMAPWC);
+				if (Map != MAP_FAILED)
+					XDMA->RegisterBaseWC = (volatile uint8_t*)Map;
+			}
+		}
+		if(!Silent)
+		{
+			if(XDMA->RegisterBase)
+				printf("register access connected to %s (memory mapped)\n", Name);
+			else
+				printf("register access connected to %s\n", Name);
+		}
+		ProbeFPGACapabilities();               // read the firmware version & features once
     }
     return Result;
 }
@@ -69,7 +200,77 @@ int OpenXDMADriver(bool Silent)
 //
 void CloseXDMADriver(void)
 {
-    close(register_fd);
+	if (XDMA->RegisterBaseWC)
+		munmap((void*)XDMA->RegisterBaseWC, VREGISTERMAPSIZE);
+	XDMA->RegisterBaseWC = NULL;
+	if (XDMA->RegisterBase)
+		munmap((void*)XDMA->RegisterBase, VREGISTERMAPSIZE);
+	XDMA->RegisterBase = NULL;
+	if (XDMA->RegisterFd != -1)
+		close(XDMA->RegisterFd);
+	XDMA->RegisterFd = -1;
+}
+
+
+//
+// open a DMA stream or event device
+//
+int OpenDMADevice(const char* Device, int Flags)
+{
+	char Name[32];
+
+	return open(GetXDMADeviceName(Device, Name, sizeof(Name)), Flags);
+}
+
+
+//
+// set the driver's busy-poll window for DMA completions on a stream device
+//
+int SetDMAPollWindow(int fd, uint32_t Microseconds)
+{
+	int Window = (int)Microseconds;
+
+	if (ioctl(fd, VXDMAPOLLSET, &Window) < 0)
+	{
+		perror("set DMA poll window");
+		return -errno;
+	}
+	return 0;
+}
+
+
+//
+// map a user interrupt to poll() readiness of a C2H stream device
+//
+int SetDMAReadyInterrupt(int fd, int UserIRQ)
+{
+	if (ioctl(fd, VXDMAPOLLIRQSET, &UserIRQ) < 0)
+		return -errno;
+	return 0;
+}
+
+
+//
+// select end of packet terminated reads on an AXI-Stream C2H device
+//
+int SetDMAEOPRead(int fd, bool Enable)
+{
+	int Arg = Enable ? 1 : 0;
+
+	if (ioctl(fd, VXDMAEOPSET, &Arg) < 0)
+		return -errno;
+	return 0;
+}
+
+
+//
+// read the driver timestamps of the last DMA completed on a device
+//
+int GetDMATimestamps(int fd, struct DMATimestamps* Times)
+{
+	if (ioctl(fd, VXDMATIMINGGET, Times) < 0)
+		return -errno;
+	return 0;
 }
 
 
@@ -125,28 +326,340 @@ int DMAReadFromFPGA(int fd, unsigned char*DestData, uint32_t Length, uint32_t AX
 	return 0;
 }
 
+//
+// read one packet from an AXI-Stream C2H device in end of packet mode
+// returns the number of bytes in the packet, else a negative error code
+//
+int32_t DMAReadPacketFromFPGA(int fd, unsigned char*DestData, uint32_t MaxLength)
+{
+	ssize_t rc;									// response code
+
+	rc = read(fd, DestData, MaxLength);
+	if (rc < 0)
+	{
+		printf("packet read 0x%x failed %ld.\n", MaxLength, rc);
+		perror("DMA read");
+		return -EIO;
+	}
+	return (int32_t)rc;
+}
+
+//
+// read several blocks from different FPGA addresses as one chained DMA
+// returns 0 if success, else an error code
+//
+int DMAReadVectorFromFPGA(int fd, struct DMAVector* Vector, uint32_t Count)
+{
+	struct XDMAVecEntry Entries[VMAXDMAVECTOR];
+	struct XDMAVecIoctl Vec;
+	uint32_t Cntr;
+	int Result;
+
+	if ((Count == 0) || (Count > VMAXDMAVECTOR))
+		return -EINVAL;
+	for (Cntr = 0; Cntr < Count; Cntr++)
+	{
+		Entries[Cntr].ep_addr = Vector[Cntr].AXIAddr;
+		Entries[Cntr].buf = (uint64_t)(uintptr_t)Vector[Cntr].Data;
+		Entries[Cntr].length = Vector[Cntr].Length;
+	}
+	Vec.entries = (uint64_t)(uintptr_t)Entries;
+	Vec.count = Count;
+	Vec.reserved = 0;
+
+	if (ioctl(fd, VXDMAVECXFER, &Vec) >= 0)
+		return 0;
+	if ((errno != EINVAL) && (errno != ENOTTY))
+	{
+		perror("DMA vector read");
+		return -EIO;
+	}
+
+	// older driver: one read per block
+	for (Cntr = 0; Cntr < Count; Cntr++)
+	{
+		Result = DMAReadFromFPGA(fd, Vector[Cntr].Data, Vector[Cntr].Length, Vector[Cntr].AXIAddr);
+		if (Result != 0)
+			return Result;
+	}
+	return 0;
+}
+
+
+//
+// driver DMA buffer: allocate, free, and read into
+//
+int AllocateDriverDMABuffer(int fd, uint32_t Size)
+{
+	struct XDMABufferIoctl Buffer;
+
+	Buffer.size = Size;
+	if (ioctl(fd, VXDMABUFFERALLOCCACHED, &Buffer) < 0)
+		return -errno;
+	return 0;
+}
+
+
+void FreeDriverDMABuffer(int fd)
+{
+	ioctl(fd, VXDMABUFFERFREE);
+}
+
+
+int DMABufferReadFromFPGA(int fd, uint32_t Offset, uint32_t Length, uint32_t AXIAddr)
+{
+	struct XDMABufferXferIoctl Xfer;
+
+	Xfer.offset = Offset;
+	Xfer.length = Length;
+	Xfer.ep_addr = AXIAddr;
+	if (ioctl(fd, VXDMABUFFERXFER, &Xfer) < 0)
+	{
+		printf("buffer read 0x%x @ 0x%x failed.\n", Length, AXIAddr);
+		perror("DMA read");
+		return -EIO;
+	}
+	return 0;
+}
+
+
+//
+// asynchronous DMA, through Linux AIO system calls (no library needed)
+//
+bool OpenAsyncDMA(struct AsyncDMAQueue* Queue, int fd, uint32_t Depth)
+{
+	memset(Queue, 0, sizeof(*Queue));
+	if ((Depth == 0) || (Depth > VMAXASYNCDMA))
+		return true;
+	Queue->fd = fd;
+	Queue->Depth = Depth;
+	if (syscall(SYS_io_setup, Depth, &Queue->Context) < 0)
+	{
+		perror("io_setup");
+		Queue->Context = 0;
+		return true;
+	}
+	return false;
+}
+
+
+static int SubmitAsyncDMA(struct AsyncDMAQueue* Queue, uint16_t Opcode, unsigned char* Data, uint32_t Length, uint32_t AXIAddr, void* Tag)
+{
+	struct iocb* Request;
+	struct iocb* List[1];
+	uint32_t Index;
+
+	if (Queue->InFlight >= Queue->Depth)
+		return -EBUSY;
+	for (Index = 0; Queue->RequestBusy[Index]; Index++)
+		;
+	Request = &Queue->Requests[Index];
+	memset(Request, 0, sizeof(*Request));
+	Request->aio_data = Index;
+	Request->aio_lio_opcode = Opcode;
+	Request->aio_fildes = Queue->fd;
+	Request->aio_buf = (uintptr_t)Data;
+	Request->aio_nbytes = Length;
+	Request->aio_offset = AXIAddr;
+	List[0] = Request;
+	if (syscall(SYS_io_submit, Queue->Context, 1, List) != 1)
+	{
+		printf("async DMA 0x%x @ 0x%x submit failed.\n", Length, AXIAddr);
+		perror("io_submit");
+		return -EIO;
+	}
+	Queue->Tags[Index] = Tag;
+	Queue->RequestBusy[Index] = true;
+	Queue->InFlight++;
+	return 0;
+}
+
+
+int SubmitAsyncDMARead(struct AsyncDMAQueue* Queue, unsigned char* DestData, uint32_t Length, uint32_t AXIAddr, void* Tag)
+{
+	return SubmitAsyncDMA(Queue, IOCB_CMD_PREAD, DestData, Length, AXIAddr, Tag);
+}
+
+
+int SubmitAsyncDMAWrite(struct AsyncDMAQueue* Queue, unsigned char* SrcData, uint32_t Length, uint32_t AXIAddr, void* Tag)
+{
+	return SubmitAsyncDMA(Queue, IOCB_CMD_PWRITE, SrcData, Length, AXIAddr, Tag);
+}
+
+
+uint32_t PollAsyncDMA(struct AsyncDMAQueue* Queue, struct AsyncDMACompletion* Done, uint32_t Max, uint32_t TimeoutUs)
+{
+	struct io_event Events[VMAXASYNCDMA];
+	struct timespec Timeout;
+	long Count, Cntr;
+	uint32_t Index;
+
+	if (Queue->InFlight == 0)
+		return 0;
+	if (Max > VMAXASYNCDMA)
+		Max = VMAXASYNCDMA;
+	Timeout.tv_sec = TimeoutUs / 1000000;
+	Timeout.tv_nsec = (TimeoutUs % 1000000) * 1000;
+	Count = syscall(SYS_io_getevents, Queue->Context, (TimeoutUs != 0) ? 1 : 0, Max, Events, &Timeout);
+	if (Count < 0)
+	{
+		if (errno != EINTR)
+			perror("io_getevents");
+		return 0;
+	}
+	for (Cntr = 0; Cntr < Count; Cntr++)
+	{
+		Index = (uint32_t)Events[Cntr].data;
+		Done[Cntr].Tag = Queue->Tags[Index];
+		Done[Cntr].Result = Events[Cntr].res;
+		Queue->RequestBusy[Index] = false;
+		Queue->InFlight--;
+	}
+	return (uint32_t)Count;
+}
+
+
+void CloseAsyncDMA(struct AsyncDMAQueue* Queue)
+{
+	struct AsyncDMACompletion Done[VMAXASYNCDMA];
+
+	if (Queue->Context == 0)
+		return;
+	while (Queue->InFlight != 0)
+		if (PollAsyncDMA(Queue, Done, VMAXASYNCDMA, 100000) == 0)
+			break;
+	syscall(SYS_io_destroy, Queue->Context);
+	Queue->Context = 0;
+}
+
 //
 // 32 bit register read over the AXILite bus
 //
 uint32_t RegisterRead(uint32_t Address)
 {
 	uint32_t result = 0;
+	REGTRACE_START(TraceStart);
 
-    ssize_t nread = pread(register_fd, &result, sizeof(result), (off_t) Address);
-    if (nread != sizeof(result))
-        printf("ERROR: register read: addr=0x%08X   error=%s\n",Address, strerror(errno));
-	
+	if (XDMA->RegisterBase && (Address < VREGISTERMAPSIZE))
+		result = *(volatile uint32_t*)(XDMA->RegisterBase + Address);
+	else
+	{
+		ssize_t nread = pread(XDMA->RegisterFd, &result, sizeof(result), (off_t) Address);
+		if (nread != sizeof(result))
+			printf("ERROR: register read: addr=0x%08X   error=%s\n",Address, strerror(errno));
+	}
+	REGTRACE_END(TraceStart, 'R', Address, result, 1);
     return result;
 }
 
+//
+// block of 32 bit register reads from consecutive addresses over the AXILite bus
+// memory mapped: a load per word. Else one pread for the block;
+// older drivers read one word per call, so keep going till all read.
+//
+void RegisterReadBlock(uint32_t Address, uint32_t* Data, uint32_t Count)
+{
+	uint32_t Cntr;
+	uint32_t Done = 0;
+	ssize_t nread;
+	REGTRACE_START(TraceStart);
+
+	if (XDMA->RegisterBase && ((Address + 4 * Count) <= VREGISTERMAPSIZE))
+	{
+		for (Cntr = 0; Cntr < Count; Cntr++)
+			Data[Cntr] = *(volatile uint32_t*)(XDMA->RegisterBase + Address + 4 * Cntr);
+		REGTRACE_END(TraceStart, 'R', Address, Count ? Data[0] : 0, Count);
+		return;
+	}
+	while (Done < Count)
+	{
+		nread = pread(XDMA->RegisterFd, Data + Done, (Count - Done) * sizeof(uint32_t), (off_t)(Address + 4 * Done));
+		if ((nread <= 0) || (nread & 3))
+		{
+			printf("ERROR: block read: addr=0x%08X   error=%s\n", Address + 4 * Done, strerror(errno));
+			break;
+		}
+		Done += nread / sizeof(uint32_t);
+	}
+	REGTRACE_END(TraceStart, 'R', Address, Count ? Data[0] : 0, Count);
+}
+
+//
+// make sure write-combined register writes have reached the FPGA
+// a store barrier empties the CPU write-combining buffers, and an uncached
+// register read then can't complete until the posted writes ahead of it have.
+//
+void RegisterWriteFence(void)
+{
+#if defined(__aarch64__)
+	__asm__ volatile("dsb st" ::: "memory");
+#elif defined(__x86_64__) || defined(__i386__)
+	__asm__ volatile("sfence" ::: "memory");
+#else
+	__sync_synchronize();
+#endif
+	if (XDMA->RegisterBase)
+		(void)*(volatile uint32_t*)(XDMA->RegisterBase + VFLUSHREADADDR);
+}
+
+
+//
+// block of 32 bit register writes to consecutive addresses over the AXILite bus
+// memory mapped: a store per word, to the write-combined view if there is one,
+// then fenced. Else one pwrite for the block;
+// older drivers write one word per call, so keep going till all written.
+//
+void RegisterWriteBlock(uint32_t Address, const uint32_t* Data, uint32_t Count)
+{
+	uint32_t Cntr;
+	uint32_t Done = 0;
+	ssize_t nsent;
+	REGTRACE_START(TraceStart);
+
+	if (XDMA->RegisterBaseWC && ((Address + 4 * Count) <= VREGISTERMAPSIZE))
+	{
+		for (Cntr = 0; Cntr < Count; Cntr++)
+			*(volatile uint32_t*)(XDMA->RegisterBaseWC + Address + 4 * Cntr) = Data[Cntr];
+		RegisterWriteFence();
+		REGTRACE_END(TraceStart, 'W', Address, Count ? Data[0] : 0, Count);
+		return;
+	}
+	if (XDMA->RegisterBase && ((Address + 4 * Count) <= VREGISTERMAPSIZE))
+	{
+		for (Cntr = 0; Cntr < Count; Cntr++)
+			*(volatile uint32_t*)(XDMA->RegisterBase + Address + 4 * Cntr) = Data[Cntr];
+		REGTRACE_END(TraceStart, 'W', Address, Count ? Data[0] : 0, Count);
+		return;
+	}
+	while (Done < Count)
+	{
+		nsent = pwrite(XDMA->RegisterFd, Data + Done, (Count - Done) * sizeof(uint32_t), (off_t)(Address + 4 * Done));
+		if ((nsent <= 0) || (nsent & 3))
+		{
+			printf("ERROR: block write: addr=0x%08X   error=%s\n", Address + 4 * Done, strerror(errno));
+			break;
+		}
+		Done += nsent / sizeof(uint32_t);
+	}	REGTRACE_END(TraceStart, 'W', Address, Count ? Data[0] : 0, Count);
+}
+
+
 //
 // 32 bit register write over the AXILite bus
 //
 void RegisterWrite(uint32_t Address, uint32_t Data)
 {
-    ssize_t nsent = pwrite(register_fd, &Data, sizeof(Data), (off_t) Address); 
-    if (nsent != sizeof(Data))
-        printf("ERROR: Write: addr=0x%08X   error=%s\n",Address, strerror(errno));
+	REGTRACE_START(TraceStart);
+
+	if (XDMA->RegisterBase && (Address < VREGISTERMAPSIZE))
+		*(volatile uint32_t*)(XDMA->RegisterBase + Address) = Data;
+	else
+	{
+		ssize_t nsent = pwrite(XDMA->RegisterFd, &Data, sizeof(Data), (off_t) Address); 
+		if (nsent != sizeof(Data))
+			printf("ERROR: Write: addr=0x%08X   error=%s\n",Address, strerror(errno));
+	}
+	REGTRACE_END(TraceStart, 'W', Address, Data, 1);
 }
 
 
@@ -17,19 +17,125 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <linux/aio_abi.h>
+
+#define VMAXASYNCDMA 8                          // max DMAs in flight on one queue
+#define VMAXXDMACARDS 8                         // most Saturn boards (XDMA cards) in one host
+#define VXDMADEVICEPREFIX "/dev/xdma0_"         // device names are given for card 0, eg VDDCDMADEVICE
+
+
+//
+// one Saturn board: the XDMA driver's register device for card N is /dev/xdma<N>_user,
+// and its DMA and event devices /dev/xdma<N>_c2h_0 etc.
+// register accesses go to the selected card; its DMA devices are opened by OpenDMADevice()
+//
+struct XDMADevice
+{
+    uint32_t Card;                              // XDMA card number
+    int RegisterFd;                             // register device, or -1 if not open
+    volatile uint8_t* RegisterBase;             // mmap of register space; NULL if pread/pwrite used
+    volatile uint8_t* RegisterBaseWC;           // write-combined mmap of register space, for block writes
+};
+
+//
+// asynchronous DMA queue: several DMAs in flight on one stream device.
+// uses Linux AIO, which the XDMA driver services through its aio read/write path.
+//
+struct AsyncDMAQueue
+{
+    int fd;                                     // stream device
+    aio_context_t Context;                      // kernel AIO context
+    uint32_t Depth;                             // max DMAs in flight
+    uint32_t InFlight;                          // DMAs submitted, not yet reaped
+    struct iocb Requests[VMAXASYNCDMA];
+    bool RequestBusy[VMAXASYNCDMA];
+    void* Tags[VMAXASYNCDMA];                   // caller's tag for each request
+    int64_t Results[VMAXASYNCDMA];              // result, if completed at submit (simulator)
+};
+
+//
+// one completed asynchronous DMA
+//
+struct AsyncDMACompletion
+{
+    void* Tag;                                  // tag given at submit
+    int64_t Result;                             // bytes transferred, or -errno
+};
+
+
+//
+// select the Saturn board (XDMA card) used from now on by this process
+// call before OpenXDMADriver() to use a board other than card 0. Several boards
+// can be open at once; selecting one directs the register accesses to it.
+// returns false if the card number is out of range
+//
+bool SelectXDMACard(uint32_t Card);
+
+
+//
+// get the selected XDMA card number
+//
+uint32_t GetXDMACard(void);
+
+
+//
+// get the name of a device on the selected card, from its card 0 name
+// eg VDDCDMADEVICE becomes /dev/xdma1_c2h_0 if card 1 is selected.
+// returns Name; names not starting with VXDMADEVICEPREFIX are copied unchanged
+//
+const char* GetXDMADeviceName(const char* Device, char* Name, uint32_t Length);
 
 
 //
 // open connection to the XDMA device driver for register and DMA access
+// (for the selected card)
 //
 int OpenXDMADriver(bool Silent);
 
+
+//
+// open connection to the XDMA device driver for register and DMA access
+// if UseMmap, registers are accessed through a memory map of the AXI-Lite space
+// (falls back to pread/pwrite if the map can't be made)
+//
+int OpenXDMADriverMapped(bool Silent, bool UseMmap);
+
 //
 // close connection
 //
 void CloseXDMADriver(void);
 
 
+//
+// open a DMA stream or event device of the selected card, eg VDDCDMADEVICE
+// returns a file descriptor, or -1 if not available (as open())
+//
+int OpenDMADevice(const char* Device, int Flags);
+
+
+//
+// set the busy-poll window for DMA completions on a stream device, in us (0 = sleep at once)
+// the driver polls this long for a DMA to complete before waiting for its interrupt
+// returns 0 if success, else an error code (eg an older driver without the ioctl)
+//
+int SetDMAPollWindow(int fd, uint32_t Microseconds);
+
+
+//
+// make poll()/epoll on a C2H stream device report POLLIN when an XDMA user interrupt
+// (eg the FIFO monitor threshold interrupt of the stream) has fired since the last read
+// UserIRQ: 0-15, as the xdma0_events_<n> devices, or -1 to unmap
+// returns 0 if success, else an error code (eg an older driver without the ioctl)
+//
+int SetDMAReadyInterrupt(int fd, int UserIRQ);
+
+
+//
+// select end of packet terminated reads on an AXI-Stream C2H device:
+// each read then returns at the stream's TLAST, with the packet's length
+// returns 0 if success, else an error code (-EINVAL if not an AXI-Stream engine)
+//
+int SetDMAEOPRead(int fd, bool Enable);
 //
 // initiate a DMA to the FPGA with specified parameters
 // returns 1 if success, else 0
@@ -53,16 +159,128 @@ int DMAWriteToFPGA(int fd, unsigned char*SrcData, uint32_t Length, uint32_t AXIA
 int DMAReadFromFPGA(int fd, unsigned char*DestData, uint32_t Length, uint32_t AXIAddr);
 
 
+//
+// driver timestamps of the last DMA completed on a device, as the driver's
+// struct xdma_timing_ioctl: ns of CLOCK_MONOTONIC_RAW (as stagetrace.h)
+//
+struct DMATimestamps
+{
+    uint64_t Submit;                                    // request entered the driver
+    uint64_t Start;                                     // engine started; 0 = chained behind another transfer
+    uint64_t Complete;                                  // completion serviced
+    uint64_t Bytes;
+    uint64_t Sequence;                                  // DMAs timed on the engine
+};
+
+
+//
+// read the driver timestamps of the last DMA completed on a DMA device
+// returns 0 if success, else an error code (eg an older driver without the ioctl)
+//
+int GetDMATimestamps(int fd, struct DMATimestamps* Times);
+
+
+//
+// read one packet from an AXI-Stream C2H device set by SetDMAEOPRead()
+// returns the number of bytes received (at most MaxLength), else a negative error code
+//
+int32_t DMAReadPacketFromFPGA(int fd, unsigned char*DestData, uint32_t MaxLength);
+
+
+//
+// one entry of a vectored DMA: a memory block and the FPGA address it is read from
+//
+#define VMAXDMAVECTOR 8                                 // XDMA_VEC_MAX in the driver
+
+struct DMAVector
+{
+    unsigned char* Data;
+    uint32_t Length;
+    uint32_t AXIAddr;
+};
+
+//
+// read several blocks from different FPGA addresses on one device as a single DMA
+// returns 0 if success, else an error code
+// fd: file device (an open file)
+// Vector: list of blocks; Count: entries in the list (up to VMAXDMAVECTOR)
+// falls back to one read per block if the driver has no vectored DMA
+//
+int DMAReadVectorFromFPGA(int fd, struct DMAVector* Vector, uint32_t Count);
+
+
+//
+// driver DMA buffer: one physically contiguous, cacheable buffer per stream device,
+// allocated by the driver and mmap()ed from the device. A transfer into it is a single
+// descriptor however long, rather than one per 4KB page of a user buffer.
+// AllocateDriverDMABuffer(): allocate Size bytes (a multiple of the page size, up to 4MB)
+// returns 0 if success, else an error code (eg an older driver without the ioctl)
+// FreeDriverDMABuffer(): free it once unmapped
+// DMABufferReadFromFPGA(): DMA into the buffer at Offset. The region may run past the end
+// of the buffer and wrap to its start (for a buffer mapped twice as a mirrored ring)
+// returns 0 if success, else an error code
+//
+int AllocateDriverDMABuffer(int fd, uint32_t Size);
+void FreeDriverDMABuffer(int fd);
+int DMABufferReadFromFPGA(int fd, uint32_t Offset, uint32_t Length, uint32_t AXIAddr);
+
+
+//
+// open an asynchronous DMA queue on a stream device, for up to Depth DMAs in flight
+// returns true if error
+//
+bool OpenAsyncDMA(struct AsyncDMAQueue* Queue, int fd, uint32_t Depth);
+//
+// submit a DMA from the FPGA; completes later, reaped by PollAsyncDMA()
+// the buffer must not be used until then. Parameters as DMAReadFromFPGA; Tag is returned on completion
+// returns 0 if submitted, else negative (queue full or submit failed)
+//
+int SubmitAsyncDMARead(struct AsyncDMAQueue* Queue, unsigned char* DestData, uint32_t Length, uint32_t AXIAddr, void* Tag);
+//
+// submit a DMA to the FPGA; as SubmitAsyncDMARead
+//
+int SubmitAsyncDMAWrite(struct AsyncDMAQueue* Queue, unsigned char* SrcData, uint32_t Length, uint32_t AXIAddr, void* Tag);
+//
+// reap completed DMAs into Done (up to Max)
+// if TimeoutUs is not 0 and DMAs are in flight, wait up to that long for at least one
+// returns the number reaped
+//
+uint32_t PollAsyncDMA(struct AsyncDMAQueue* Queue, struct AsyncDMACompletion* Done, uint32_t Max, uint32_t TimeoutUs);
+//
+// wait for all DMAs in flight to complete, and close the queue
+//
+void CloseAsyncDMA(struct AsyncDMAQueue* Queue);
 //
 // single 32 bit register read, from AXI-Lite bus
 //
 uint32_t RegisterRead(uint32_t Address);
 
 
+//
+// block of 32 bit register reads, from consecutive AXI-Lite addresses
+// one system call for the block if the registers aren't memory mapped
+//
+void RegisterReadBlock(uint32_t Address, uint32_t* Data, uint32_t Count);
+
+
 //
 // single 32 bit register write, to AXI-Lite bus
 //
 void RegisterWrite(uint32_t Address, uint32_t Data);
 
 
+//
+// block of 32 bit register writes, to consecutive AXI-Lite addresses
+// for table uploads eg CW keyer ramp RAM
+// uses the write-combined register mapping if available, then fences
+//
+void RegisterWriteBlock(uint32_t Address, const uint32_t* Data, uint32_t Count);
+
+
+//
+// wait until write-combined register writes have reached the FPGA
+//
+void RegisterWriteFence(void);
+
+
 #endif
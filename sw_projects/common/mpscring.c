@@ -0,0 +1,114 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// licenced under GNU GPL3
+//
+// mpscring.c:
+// lock-free multiple producer, single consumer ring index
+//
+// each slot has a sequence count. For the slot at free running index I:
+//   Sequence == I:           free, for the producer that claims index I
+//   Sequence == I + 1:       published, for the consumer
+//   Sequence == I + Size:    released, free for index I + Size
+// producers claim an index with compare and exchange on WriteIndex, so
+// no two can own the same slot. The indexes wrap at 2^32.
+//
+//////////////////////////////////////////////////////////////
+
+#include "../common/mpscring.h"
+
+
+//
+// void MPSCInitialise(struct MPSCRing* Ring, atomic_uint* Sequence, uint32_t Size)
+// initialise a ring to empty
+//
+void MPSCInitialise(struct MPSCRing* Ring, atomic_uint* Sequence, uint32_t Size)
+{
+    uint32_t Slot;
+
+    Ring->Sequence = Sequence;
+    Ring->Size = Size;
+    for (Slot = 0; Slot < Size; Slot++)
+        atomic_store(&Sequence[Slot], Slot);
+    atomic_store(&Ring->WriteIndex, 0);
+    atomic_store(&Ring->ReadIndex, 0);
+}
+
+
+//
+// int32_t MPSCClaimWriteSlot(struct MPSCRing* Ring)
+// producer: claim a free slot, or -1 if full
+//
+int32_t MPSCClaimWriteSlot(struct MPSCRing* Ring)
+{
+    uint32_t Write, Sequence;
+    int32_t Difference;
+
+    Write = atomic_load_explicit(&Ring->WriteIndex, memory_order_relaxed);
+    while (1)
+    {
+        Sequence = atomic_load_explicit(&Ring->Sequence[Write & (Ring->Size - 1)], memory_order_acquire);
+        Difference = (int32_t)(Sequence - Write);
+        if (Difference < 0)
+            return -1;                                  // slot not yet released by the consumer: full
+        if (Difference == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&Ring->WriteIndex, &Write, Write + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                return (int32_t)(Write & (Ring->Size - 1));
+            // Write now holds the latest index: try again
+        }
+        else
+            Write = atomic_load_explicit(&Ring->WriteIndex, memory_order_relaxed);    // another producer got there first
+    }
+}
+
+
+//
+// void MPSCPublish(struct MPSCRing* Ring, int32_t Slot)
+// producer: pass a filled slot to the consumer
+// the slot's sequence equals its claimed index, so the next pass value is one more
+//
+void MPSCPublish(struct MPSCRing* Ring, int32_t Slot)
+{
+    uint32_t Sequence;
+
+    Sequence = atomic_load_explicit(&Ring->Sequence[Slot], memory_order_relaxed);
+    atomic_store_explicit(&Ring->Sequence[Slot], Sequence + 1, memory_order_release);
+}
+
+
+//
+// int32_t MPSCGetReadSlot(struct MPSCRing* Ring, uint32_t Ahead)
+// consumer: get a published slot, or -1 if not yet published
+//
+int32_t MPSCGetReadSlot(struct MPSCRing* Ring, uint32_t Ahead)
+{
+    uint32_t Read, Slot;
+
+    Read = atomic_load_explicit(&Ring->ReadIndex, memory_order_relaxed) + Ahead;
+    Slot = Read & (Ring->Size - 1);
+    if (atomic_load_explicit(&Ring->Sequence[Slot], memory_order_acquire) != Read + 1)
+        return -1;
+    return (int32_t)Slot;
+}
+
+
+//
+// void MPSCRelease(struct MPSCRing* Ring, uint32_t Count)
+// consumer: return the oldest Count slots to the producers
+//
+void MPSCRelease(struct MPSCRing* Ring, uint32_t Count)
+{
+    uint32_t Read;
+    uint32_t Cntr;
+
+    Read = atomic_load_explicit(&Ring->ReadIndex, memory_order_relaxed);
+    for (Cntr = 0; Cntr < Count; Cntr++)
+        atomic_store_explicit(&Ring->Sequence[(Read + Cntr) & (Ring->Size - 1)], Read + Cntr + Ring->Size,
+                              memory_order_release);
+    atomic_store_explicit(&Ring->ReadIndex, Read + Count, memory_order_relaxed);
+}
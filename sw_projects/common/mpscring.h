@@ -0,0 +1,79 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// licenced under GNU GPL3
+//
+// mpscring.h:
+// header file. lock-free multiple producer, single consumer ring index
+//
+// as SPSCRing, the ring holds only the indexes; the caller owns the data
+// array (one entry per slot) and the array of slot sequence counts.
+// any number of threads may call the producer functions; one thread
+// only may call the consumer functions.
+// a producer claims a slot, fills it, then publishes it. The consumer
+// sees slots in claim order; a claimed slot not yet published holds back
+// the slots after it until it is published.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __mpscring_h
+#define __mpscring_h
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "../common/saturntypes.h"
+
+
+struct MPSCRing
+{
+    atomic_uint WriteIndex;                     // free running count of slots claimed (producers)
+    atomic_uint ReadIndex;                      // free running count of slots released (consumer only)
+    atomic_uint* Sequence;                      // per slot: which pass of the ring the slot is ready for
+    uint32_t Size;                              // number of slots. Must be a power of 2
+};
+
+
+//
+// void MPSCInitialise(struct MPSCRing* Ring, atomic_uint* Sequence, uint32_t Size)
+// initialise a ring to empty. Must not be called while any thread is using it.
+//   Sequence: array of Size counts, owned by the caller
+//   Size:     number of slots; must be a power of 2
+//
+void MPSCInitialise(struct MPSCRing* Ring, atomic_uint* Sequence, uint32_t Size);
+
+
+//
+// int32_t MPSCClaimWriteSlot(struct MPSCRing* Ring)
+// producer: claim the next free slot to fill
+// returns the slot number, or -1 if the ring is full
+//
+int32_t MPSCClaimWriteSlot(struct MPSCRing* Ring);
+
+
+//
+// void MPSCPublish(struct MPSCRing* Ring, int32_t Slot)
+// producer: pass a filled slot from MPSCClaimWriteSlot() to the consumer
+//
+void MPSCPublish(struct MPSCRing* Ring, int32_t Slot);
+
+
+//
+// int32_t MPSCGetReadSlot(struct MPSCRing* Ring, uint32_t Ahead)
+// consumer: get the published slot Ahead beyond the oldest (0 = the oldest)
+// so several can be read at once, then released together
+// returns the slot number, or -1 if that slot isn't published yet
+//
+int32_t MPSCGetReadSlot(struct MPSCRing* Ring, uint32_t Ahead);
+
+
+//
+// void MPSCRelease(struct MPSCRing* Ring, uint32_t Count)
+// consumer: return the oldest Count slots to the producers
+//
+void MPSCRelease(struct MPSCRing* Ring, uint32_t Count);
+
+
+#endif
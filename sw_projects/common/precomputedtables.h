@@ -0,0 +1,359 @@
+//////////////////////////////////////////////////////////////
+//
+// precomputedtables.h:
+// GENERATED by gentables.c from the formulas in tableformulas.h - do not edit.
+// constant hardware tables, evaluated at build time. Included by saturnregisters.c only.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __precomputedtables_h
+#define __precomputedtables_h
+
+#include "../common/tableformulas.h"
+
+
+//
+// ROMs for DAC Current Setting and 0.5dB step digital attenuator
+//
+const unsigned int DACCurrentROM[VDACROMSIZE] =
+{
+    0, 37, 75, 112, 150, 187, 225, 248,
+    252, 253, 251, 246, 253, 244, 248, 251,
+    253, 254, 254, 253, 251, 249, 246, 243,
+    254, 250, 245, 254, 249, 244, 252, 246,
+    254, 247, 254, 247, 254, 247, 253, 246,
+    252, 244, 250, 241, 247, 253, 244, 249,
+    254, 245, 250, 241, 246, 250, 241, 245,
+    250, 254, 244, 248, 253, 242, 246, 250,
+    254, 244, 248, 251, 241, 244, 248, 251,
+    241, 244, 247, 251, 254, 243, 246, 249,
+    252, 241, 244, 247, 250, 253, 242, 245,
+    248, 250, 253, 242, 244, 247, 250, 252,
+    241, 243, 246, 248, 251, 253, 241, 244,
+    246, 248, 251, 253, 241, 244, 246, 248,
+    250, 252, 240, 243, 245, 247, 249, 251,
+    253, 241, 243, 245, 247, 249, 251, 253,
+    241, 242, 244, 246, 248, 250, 252, 254,
+    241, 243, 245, 247, 248, 250, 252, 254,
+    241, 243, 245, 246, 248, 250, 251, 253,
+    240, 242, 244, 245, 247, 248, 250, 251,
+    253, 240, 242, 243, 245, 246, 248, 249,
+    251, 252, 254, 241, 242, 244, 245, 247,
+    248, 250, 251, 252, 254, 241, 242, 244,
+    245, 246, 248, 249, 250, 252, 253, 254,
+    241, 242, 244, 245, 246, 248, 249, 250,
+    251, 253, 254, 241, 242, 243, 244, 246,
+    247, 248, 249, 250, 251, 253, 254, 241,
+    242, 243, 244, 245, 246, 247, 249, 250,
+    251, 252, 253, 254, 241, 242, 243, 244,
+    245, 246, 247, 248, 249, 251, 252, 253,
+    254, 241, 242, 243, 243, 245, 246, 246,
+    247, 248, 250, 251, 252, 253, 254, 255
+};
+
+const unsigned int DACStepAttenROM[VDACROMSIZE] =
+{
+    63, 63, 63, 63, 63, 63, 63, 62,
+    60, 58, 56, 54, 53, 51, 50, 49,
+    48, 47, 46, 45, 44, 43, 42, 41,
+    41, 40, 39, 39, 38, 37, 37, 36,
+    36, 35, 35, 34, 34, 33, 33, 32,
+    32, 31, 31, 30, 30, 30, 29, 29,
+    29, 28, 28, 27, 27, 27, 26, 26,
+    26, 26, 25, 25, 25, 24, 24, 24,
+    24, 23, 23, 23, 22, 22, 22, 22,
+    21, 21, 21, 21, 21, 20, 20, 20,
+    20, 19, 19, 19, 19, 19, 18, 18,
+    18, 18, 18, 17, 17, 17, 17, 17,
+    16, 16, 16, 16, 16, 16, 15, 15,
+    15, 15, 15, 15, 14, 14, 14, 14,
+    14, 14, 13, 13, 13, 13, 13, 13,
+    13, 12, 12, 12, 12, 12, 12, 12,
+    11, 11, 11, 11, 11, 11, 11, 11,
+    10, 10, 10, 10, 10, 10, 10, 10,
+    9, 9, 9, 9, 9, 9, 9, 9,
+    8, 8, 8, 8, 8, 8, 8, 8,
+    8, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 6, 6, 6, 6, 6,
+    6, 6, 6, 6, 6, 5, 5, 5,
+    5, 5, 5, 5, 5, 5, 5, 5,
+    4, 4, 4, 4, 4, 4, 4, 4,
+    4, 4, 4, 3, 3, 3, 3, 3,
+    3, 3, 3, 3, 3, 3, 3, 2,
+    2, 2, 2, 2, 2, 2, 2, 2,
+    2, 2, 2, 2, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1,
+    1, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0
+};
+
+
+//
+// CW ramps for the startup ramp lengths
+//
+static const uint32_t CWRampP1_5000[241] =
+{
+    0, 351, 731, 1170, 1696, 2339, 3128, 4094,
+    5265, 6673, 8348, 10320, 12621, 15281, 18333, 21807,
+    25735, 30149, 35080, 40559, 46619, 53288, 60598, 68578,
+    77257, 86663, 96822, 107761, 119503, 132073, 145491, 159777,
+    174949, 191023, 208013, 225932, 244788, 264590, 285344, 307051,
+    329713, 353329, 377894, 403402, 429846, 457214, 485495, 514673,
+    544733, 575657, 607424, 640015, 673406, 707574, 742494, 778141,
+    814488, 851510, 889178, 927465, 966345, 1005789, 1045770, 1086263,
+    1127240, 1168676, 1210545, 1252825, 1295490, 1338518, 1381889, 1425581,
+    1469575, 1513853, 1558398, 1603192, 1648222, 1693473, 1738932, 1784586,
+    1830426, 1876440, 1922620, 1968956, 2015441, 2062069, 2108832, 2155724,
+    2202740, 2249876, 2297126, 2344486, 2391953, 2439522, 2487191, 2534955,
+    2582811, 2630756, 2678787, 2726901, 2775094, 2823363, 2871705, 2920118,
+    2968596, 3017138, 3065739, 3114397, 3163107, 3211865, 3260670, 3309515,
+    3358398, 3407315, 3456262, 3505235, 3554230, 3603243, 3652270, 3701307,
+    3750350, 3799395, 3848438, 3897475, 3946502, 3995515, 4044510, 4093483,
+    4142430, 4191347, 4240230, 4289075, 4337880, 4386638, 4435348, 4484006,
+    4532607, 4581149, 4629627, 4678040, 4726382, 4774651, 4822844, 4870958,
+    4918989, 4966934, 5014790, 5062554, 5110223, 5157792, 5205259, 5252619,
+    5299869, 5347005, 5394021, 5440913, 5487676, 5534304, 5580789, 5627125,
+    5673305, 5719319, 5765159, 5810813, 5856272, 5901523, 5946553, 5991347,
+    6035892, 6080170, 6124164, 6167856, 6211227, 6254255, 6296920, 6339200,
+    6381069, 6422505, 6463482, 6503975, 6543956, 6583400, 6622280, 6660567,
+    6698235, 6735257, 6771604, 6807251, 6842171, 6876339, 6909730, 6942321,
+    6974088, 7005012, 7035072, 7064250, 7092531, 7119899, 7146343, 7171851,
+    7196416, 7220032, 7242694, 7264401, 7285155, 7304957, 7323813, 7341732,
+    7358722, 7374796, 7389968, 7404254, 7417672, 7430242, 7441984, 7452923,
+    7463082, 7472488, 7481167, 7489147, 7496457, 7503126, 7509186, 7514665,
+    7519596, 7524010, 7527938, 7531412, 7534464, 7537124, 7539425, 7541397,
+    7543072, 7544480, 7545651, 7546617, 7547406, 7548049, 7548575, 7549014,
+    7549394
+};
+
+static const uint32_t CWRampP2_9000[1729] =
+{
+    0, 48, 96, 145, 193, 243, 292, 342,
+    393, 444, 496, 548, 602, 656, 712, 768,
+    826, 885, 945, 1007, 1070, 1135, 1202, 1270,
+    1340, 1412, 1486, 1562, 1640, 1720, 1803, 1888,
+    1976, 2066, 2158, 2254, 2352, 2453, 2556, 2663,
+    2773, 2886, 3003, 3123, 3246, 3372, 3503, 3637,
+    3774, 3916, 4061, 4211, 4364, 4522, 4683, 4849,
+    5020, 5195, 5375, 5559, 5748, 5941, 6140, 6344,
+    6552, 6766, 6985, 7209, 7439, 7674, 7915, 8161,
+    8413, 8671, 8935, 9205, 9480, 9762, 10050, 10345,
+    10646, 10953, 11267, 11587, 11914, 12248, 12589, 12937,
+    13292, 13654, 14024, 14400, 14784, 15176, 15575, 15982,
+    16396, 16819, 17249, 17687, 18134, 18588, 19051, 19522,
+    20002, 20490, 20987, 21492, 22006, 22529, 23061, 23602,
+    24152, 24711, 25280, 25858, 26445, 27042, 27649, 28265,
+    28891, 29527, 30173, 30829, 31495, 32171, 32858, 33555,
+    34263, 34981, 35709, 36449, 37199, 37960, 38732, 39516,
+    40310, 41115, 41932, 42761, 43601, 44452, 45315, 46190,
+    47076, 47975, 48885, 49808, 50742, 51689, 52648, 53620,
+    54604, 55601, 56610, 57632, 58667, 59714, 60775, 61849,
+    62935, 64035, 65149, 66275, 67415, 68569, 69736, 70916,
+    72111, 73319, 74541, 75777, 77027, 78292, 79570, 80863,
+    82170, 83491, 84827, 86177, 87542, 88922, 90317, 91726,
+    93150, 94589, 96044, 97513, 98997, 100497, 102012, 103543,
+    105089, 106650, 108227, 109820, 111428, 113052, 114692, 116348,
+    118020, 119707, 121411, 123131, 124867, 126620, 128389, 130174,
+    131975, 133793, 135628, 137479, 139347, 141231, 143133, 145051,
+    146986, 148937, 150906, 152892, 154895, 156915, 158952, 161006,
+    163078, 165167, 167273, 169396, 171537, 173696, 175872, 178065,
+    180276, 182505, 184751, 187016, 189297, 191597, 193914, 196250,
+    198603, 200974, 203363, 205770, 208195, 210638, 213099, 215578,
+    218076, 220591, 223125, 225677, 228247, 230835, 233442, 236066,
+    238710, 241371, 244051, 246749, 249466, 252201, 254955, 257727,
+    260517, 263326, 266153, 268999, 271863, 274746, 277647, 280567,
+    283506, 286462, 289438, 292432, 295444, 298476, 301525, 304593,
+    307680, 310786, 313909, 317052, 320213, 323392, 326590, 329807,
+    333042, 336296, 339568, 342858, 346168, 349495, 352841, 356206,
+    359589, 362990, 366410, 369848, 373305, 376780, 380273, 383784,
+    387314, 390863, 394429, 398014, 401616, 405237, 408877, 412534,
+    416209, 419903, 423615, 427344, 431092, 434857, 438641, 442442,
+    446261, 450098, 453953, 457826, 461716, 465624, 469550, 473493,
+    477454, 481432, 485428, 489441, 493472, 497520, 501586, 505668,
+    509768, 513885, 518020, 522171, 526339, 530525, 534727, 538946,
+    543182, 547435, 551705, 555991, 560294, 564613, 568950, 573302,
+    577671, 582057, 586458, 590876, 595310, 599761, 604227, 608709,
+    613208, 617722, 622252, 626798, 631360, 635937, 640530, 645139,
+    649763, 654402, 659057, 663727, 668412, 673113, 677828, 682559,
+    687305, 692065, 696840, 701631, 706435, 711255, 716089, 720937,
+    725800, 730677, 735569, 740475, 745395, 750329, 755277, 760238,
+    765214, 770204, 775207, 780224, 785255, 790299, 795356, 800427,
+    805511, 810609, 815719, 820843, 825980, 831129, 836292, 841467,
+    846655, 851855, 857068, 862294, 867532, 872782, 878045, 883320,
+    888606, 893905, 899216, 904539, 909874, 915220, 920578, 925948,
+    931329, 936722, 942126, 947541, 952967, 958405, 963854, 969314,
+    974784, 980266, 985758, 991261, 996775, 1002299, 1007834, 1013379,
+    1018934, 1024500, 1030076, 1035662, 1041258, 1046865, 1052481, 1058106,
+    1063742, 1069387, 1075042, 1080707, 1086381, 1092064, 1097757, 1103459,
+    1109170, 1114891, 1120620, 1126358, 1132106, 1137862, 1143627, 1149400,
+    1155183, 1160974, 1166773, 1172581, 1178397, 1184222, 1190054, 1195895,
+    1201745, 1207602, 1213467, 1219340, 1225221, 1231110, 1237006, 1242910,
+    1248822, 1254741, 1260668, 1266602, 1272544, 1278492, 1284448, 1290412,
+    1296382, 1302359, 1308344, 1314335, 1320333, 1326338, 1332350, 1338368,
+    1344393, 1350425, 1356463, 1362508, 1368559, 1374617, 1380680, 1386750,
+    1392827, 1398909, 1404998, 1411092, 1417193, 1423299, 1429412, 1435530,
+    1441654, 1447783, 1453919, 1460060, 1466206, 1472359, 1478516, 1484679,
+    1490848, 1497022, 1503201, 1509385, 1515575, 1521769, 1527969, 1534174,
+    1540384, 1546599, 1552819, 1559044, 1565273, 1571508, 1577747, 1583991,
+    1590240, 1596493, 1602751, 1609013, 1615280, 1621552, 1627828, 1634108,
+    1640393, 1646682, 1652975, 1659273, 1665575, 1671881, 1678191, 1684505,
+    1690824, 1697146, 1703473, 1709803, 1716138, 1722476, 1728818, 1735164,
+    1741514, 1747868, 1754225, 1760587, 1766952, 1773320, 1779692, 1786068,
+    1792448, 1798831, 1805217, 1811607, 1818001, 1824397, 1830798, 1837202,
+    1843609, 1850019, 1856433, 1862850, 1869270, 1875694, 1882120, 1888550,
+    1894983, 1901420, 1907859, 1914301, 1920747, 1927196, 1933647, 1940102,
+    1946559, 1953020, 1959483, 1965950, 1972419, 1978891, 1985367, 1991845,
+    1998325, 2004809, 2011295, 2017784, 2024276, 2030771, 2037268, 2043768,
+    2050271, 2056776, 2063284, 2069795, 2076308, 2082824, 2089342, 2095863,
+    2102387, 2108913, 2115441, 2121972, 2128506, 2135042, 2141581, 2148121,
+    2154665, 2161211, 2167759, 2174309, 2180862, 2187417, 2193975, 2200535,
+    2207097, 2213662, 2220229, 2226798, 2233369, 2239943, 2246519, 2253097,
+    2259677, 2266260, 2272845, 2279432, 2286021, 2292612, 2299206, 2305801,
+    2312399, 2318999, 2325601, 2332205, 2338811, 2345419, 2352029, 2358641,
+    2365256, 2371872, 2378491, 2385111, 2391733, 2398358, 2404984, 2411612,
+    2418243, 2424875, 2431509, 2438145, 2444784, 2451424, 2458065, 2464709,
+    2471355, 2478002, 2484652, 2491303, 2497956, 2504611, 2511268, 2517927,
+    2524587, 2531250, 2537914, 2544579, 2551247, 2557916, 2564588, 2571261,
+    2577935, 2584612, 2591290, 2597970, 2604651, 2611334, 2618019, 2624706,
+    2631394, 2638084, 2644776, 2651469, 2658164, 2664861, 2671559, 2678259,
+    2684960, 2691663, 2698368, 2705074, 2711782, 2718491, 2725202, 2731914,
+    2738628, 2745344, 2752060, 2758779, 2765499, 2772221, 2778943, 2785668,
+    2792394, 2799121, 2805850, 2812580, 2819312, 2826045, 2832780, 2839516,
+    2846253, 2852992, 2859732, 2866474, 2873216, 2879961, 2886706, 2893453,
+    2900201, 2906951, 2913702, 2920454, 2927207, 2933962, 2940718, 2947475,
+    2954234, 2960994, 2967755, 2974517, 2981280, 2988045, 2994811, 3001578,
+    3008346, 3015115, 3021886, 3028658, 3035430, 3042204, 3048980, 3055756,
+    3062533, 3069311, 3076091, 3082872, 3089653, 3096436, 3103220, 3110004,
+    3116790, 3123577, 3130365, 3137154, 3143943, 3150734, 3157526, 3164319,
+    3171112, 3177907, 3184703, 3191499, 3198296, 3205095, 3211894, 3218694,
+    3225495, 3232296, 3239099, 3245902, 3252707, 3259512, 3266318, 3273124,
+    3279932, 3286740, 3293549, 3300359, 3307169, 3313981, 3320792, 3327605,
+    3334419, 3341233, 3348047, 3354863, 3361679, 3368496, 3375313, 3382131,
+    3388950, 3395769, 3402589, 3409409, 3416230, 3423052, 3429874, 3436697,
+    3443520, 3450344, 3457168, 3463993, 3470818, 3477644, 3484470, 3491297,
+    3498124, 3504951, 3511779, 3518608, 3525437, 3532266, 3539095, 3545925,
+    3552756, 3559586, 3566418, 3573249, 3580081, 3586913, 3593745, 3600577,
+    3607410, 3614244, 3621077, 3627911, 3634744, 3641579, 3648413, 3655247,
+    3662082, 3668917, 3675752, 3682587, 3689423, 3696258, 3703094, 3709929,
+    3716765, 3723601, 3730437, 3737273, 3744109, 3750946, 3757782, 3764618,
+    3771454, 3778291, 3785127, 3791963, 3798799, 3805636, 3812472, 3819308,
+    3826144, 3832980, 3839816, 3846651, 3853487, 3860322, 3867158, 3873993,
+    3880828, 3887663, 3894498, 3901332, 3908166, 3915001, 3921834, 3928668,
+    3935501, 3942335, 3949168, 3956000, 3962832, 3969664, 3976496, 3983327,
+    3990159, 3996989, 4003820, 4010650, 4017479, 4024308, 4031137, 4037966,
+    4044794, 4051621, 4058448, 4065275, 4072101, 4078927, 4085752, 4092577,
+    4099401, 4106225, 4113048, 4119871, 4126693, 4133515, 4140336, 4147156,
+    4153976, 4160795, 4167614, 4174432, 4181249, 4188066, 4194882, 4201698,
+    4208512, 4215326, 4222140, 4228953, 4235764, 4242576, 4249386, 4256196,
+    4263005, 4269813, 4276621, 4283427, 4290233, 4297038, 4303843, 4310646,
+    4317449, 4324250, 4331051, 4337851, 4344650, 4351449, 4358246, 4365042,
+    4371838, 4378633, 4385426, 4392219, 4399011, 4405802, 4412591, 4419380,
+    4426168, 4432955, 4439741, 4446525, 4453309, 4460092, 4466873, 4473654,
+    4480434, 4487212, 4493989, 4500765, 4507541, 4514315, 4521087, 4527859,
+    4534630, 4541399, 4548167, 4554934, 4561700, 4568465, 4575228, 4581990,
+    4588751, 4595511, 4602270, 4609027, 4615783, 4622538, 4629291, 4636043,
+    4642794, 4649544, 4656292, 4663039, 4669784, 4676529, 4683271, 4690013,
+    4696753, 4703492, 4710229, 4716965, 4723700, 4730433, 4737165, 4743895,
+    4750624, 4757351, 4764077, 4770802, 4777524, 4784246, 4790966, 4797685,
+    4804401, 4811117, 4817831, 4824543, 4831254, 4837963, 4844671, 4851377,
+    4858082, 4864785, 4871486, 4878186, 4884884, 4891581, 4898276, 4904969,
+    4911661, 4918351, 4925039, 4931726, 4938411, 4945094, 4951775, 4958455,
+    4965133, 4971810, 4978484, 4985157, 4991829, 4998498, 5005166, 5011831,
+    5018495, 5025158, 5031818, 5038477, 5045134, 5051789, 5058442, 5065093,
+    5071743, 5078390, 5085036, 5091680, 5098321, 5104961, 5111600, 5118236,
+    5124870, 5131502, 5138133, 5144761, 5151387, 5158012, 5164634, 5171254,
+    5177873, 5184489, 5191104, 5197716, 5204326, 5210934, 5217540, 5224144,
+    5230746, 5237346, 5243944, 5250539, 5257133, 5263724, 5270313, 5276900,
+    5283485, 5290068, 5296648, 5303226, 5309802, 5316376, 5322947, 5329516,
+    5336083, 5342648, 5349210, 5355770, 5362328, 5368883, 5375436, 5381986,
+    5388534, 5395080, 5401624, 5408164, 5414703, 5421239, 5427773, 5434304,
+    5440832, 5447358, 5453882, 5460403, 5466921, 5473437, 5479950, 5486461,
+    5492969, 5499474, 5505977, 5512477, 5518974, 5525469, 5531961, 5538450,
+    5544936, 5551420, 5557900, 5564378, 5570854, 5577326, 5583795, 5590262,
+    5596725, 5603186, 5609643, 5616098, 5622549, 5628998, 5635444, 5641886,
+    5648325, 5654762, 5661195, 5667625, 5674051, 5680475, 5686895, 5693312,
+    5699726, 5706136, 5712543, 5718947, 5725348, 5731744, 5738138, 5744528,
+    5750914, 5757297, 5763677, 5770053, 5776425, 5782793, 5789158, 5795520,
+    5801877, 5808231, 5814581, 5820927, 5827269, 5833607, 5839942, 5846272,
+    5852599, 5858921, 5865240, 5871554, 5877864, 5884170, 5890472, 5896770,
+    5903063, 5909352, 5915637, 5921917, 5928193, 5934465, 5940732, 5946994,
+    5953252, 5959505, 5965754, 5971998, 5978237, 5984472, 5990701, 5996926,
+    6003146, 6009361, 6015571, 6021776, 6027976, 6034170, 6040360, 6046544,
+    6052723, 6058897, 6065066, 6071229, 6077386, 6083539, 6089685, 6095826,
+    6101962, 6108091, 6114215, 6120333, 6126446, 6132552, 6138653, 6144747,
+    6150836, 6156918, 6162995, 6169065, 6175128, 6181186, 6187237, 6193282,
+    6199320, 6205352, 6211377, 6217395, 6223407, 6229412, 6235410, 6241401,
+    6247386, 6253363, 6259333, 6265297, 6271253, 6277201, 6283143, 6289077,
+    6295004, 6300923, 6306835, 6312739, 6318635, 6324524, 6330405, 6336278,
+    6342143, 6348000, 6353850, 6359691, 6365523, 6371348, 6377164, 6382972,
+    6388771, 6394562, 6400345, 6406118, 6411883, 6417639, 6423387, 6429125,
+    6434854, 6440575, 6446286, 6451988, 6457681, 6463364, 6469038, 6474703,
+    6480358, 6486003, 6491639, 6497264, 6502880, 6508487, 6514083, 6519669,
+    6525245, 6530811, 6536366, 6541911, 6547446, 6552970, 6558484, 6563987,
+    6569479, 6574961, 6580431, 6585891, 6591340, 6596778, 6602204, 6607619,
+    6613023, 6618416, 6623797, 6629167, 6634525, 6639871, 6645206, 6650529,
+    6655840, 6661139, 6666425, 6671700, 6676963, 6682213, 6687451, 6692677,
+    6697890, 6703090, 6708278, 6713453, 6718616, 6723765, 6728902, 6734026,
+    6739136, 6744234, 6749318, 6754389, 6759446, 6764490, 6769521, 6774538,
+    6779541, 6784531, 6789507, 6794468, 6799416, 6804350, 6809270, 6814176,
+    6819068, 6823945, 6828808, 6833656, 6838490, 6843310, 6848114, 6852905,
+    6857680, 6862440, 6867186, 6871917, 6876632, 6881333, 6886018, 6890688,
+    6895343, 6899982, 6904606, 6909215, 6913808, 6918385, 6922947, 6927493,
+    6932023, 6936537, 6941036, 6945518, 6949984, 6954435, 6958869, 6963287,
+    6967688, 6972074, 6976443, 6980795, 6985132, 6989451, 6993754, 6998040,
+    7002310, 7006563, 7010799, 7015018, 7019220, 7023406, 7027574, 7031725,
+    7035860, 7039977, 7044077, 7048159, 7052225, 7056273, 7060304, 7064317,
+    7068313, 7072291, 7076252, 7080195, 7084121, 7088029, 7091919, 7095792,
+    7099647, 7103484, 7107303, 7111104, 7114888, 7118653, 7122401, 7126130,
+    7129842, 7133536, 7137211, 7140868, 7144508, 7148129, 7151731, 7155316,
+    7158882, 7162431, 7165961, 7169472, 7172965, 7176440, 7179897, 7183335,
+    7186755, 7190156, 7193539, 7196904, 7200250, 7203577, 7206887, 7210177,
+    7213449, 7216703, 7219938, 7223155, 7226353, 7229532, 7232693, 7235836,
+    7238959, 7242065, 7245152, 7248220, 7251269, 7254301, 7257313, 7260307,
+    7263283, 7266239, 7269178, 7272098, 7274999, 7277882, 7280746, 7283592,
+    7286419, 7289228, 7292018, 7294790, 7297544, 7300279, 7302996, 7305694,
+    7308374, 7311035, 7313679, 7316303, 7318910, 7321498, 7324068, 7326620,
+    7329154, 7331669, 7334167, 7336646, 7339107, 7341550, 7343975, 7346382,
+    7348771, 7351142, 7353495, 7355831, 7358148, 7360448, 7362729, 7364994,
+    7367240, 7369469, 7371680, 7373873, 7376049, 7378208, 7380349, 7382472,
+    7384578, 7386667, 7388739, 7390793, 7392830, 7394850, 7396853, 7398839,
+    7400808, 7402759, 7404694, 7406612, 7408514, 7410398, 7412266, 7414117,
+    7415952, 7417770, 7419571, 7421356, 7423125, 7424878, 7426614, 7428334,
+    7430038, 7431725, 7433397, 7435053, 7436693, 7438317, 7439925, 7441518,
+    7443095, 7444656, 7446202, 7447733, 7449248, 7450748, 7452232, 7453701,
+    7455156, 7456595, 7458019, 7459428, 7460823, 7462203, 7463568, 7464918,
+    7466254, 7467575, 7468882, 7470175, 7471453, 7472718, 7473968, 7475204,
+    7476426, 7477634, 7478829, 7480009, 7481176, 7482330, 7483470, 7484596,
+    7485710, 7486810, 7487896, 7488970, 7490031, 7491078, 7492113, 7493135,
+    7494144, 7495141, 7496125, 7497097, 7498056, 7499003, 7499937, 7500860,
+    7501770, 7502669, 7503555, 7504430, 7505293, 7506144, 7506984, 7507813,
+    7508630, 7509435, 7510229, 7511013, 7511785, 7512546, 7513296, 7514036,
+    7514764, 7515482, 7516190, 7516887, 7517574, 7518250, 7518916, 7519572,
+    7520218, 7520854, 7521480, 7522096, 7522703, 7523300, 7523887, 7524465,
+    7525034, 7525593, 7526143, 7526684, 7527216, 7527739, 7528253, 7528758,
+    7529255, 7529743, 7530223, 7530694, 7531157, 7531611, 7532058, 7532496,
+    7532926, 7533349, 7533763, 7534170, 7534569, 7534961, 7535345, 7535721,
+    7536091, 7536453, 7536808, 7537156, 7537497, 7537831, 7538158, 7538478,
+    7538792, 7539099, 7539400, 7539695, 7539983, 7540265, 7540540, 7540810,
+    7541074, 7541332, 7541584, 7541830, 7542071, 7542306, 7542536, 7542760,
+    7542979, 7543193, 7543401, 7543605, 7543804, 7543997, 7544186, 7544370,
+    7544550, 7544725, 7544896, 7545062, 7545223, 7545381, 7545534, 7545684,
+    7545829, 7545971, 7546108, 7546242, 7546373, 7546499, 7546622, 7546742,
+    7546859, 7546972, 7547082, 7547189, 7547292, 7547393, 7547491, 7547587,
+    7547679, 7547769, 7547857, 7547942, 7548025, 7548105, 7548183, 7548259,
+    7548333, 7548405, 7548475, 7548543, 7548610, 7548675, 7548738, 7548800,
+    7548860, 7548919, 7548977, 7549033, 7549089, 7549143, 7549197, 7549249,
+    7549301, 7549352, 7549403, 7549453, 7549502, 7549552, 7549600, 7549649,
+    7549697
+};
+
+#define VNUMPRECOMPUTEDRAMPS 2
+
+static const struct PrecomputedCWRamp PrecomputedCWRamps[VNUMPRECOMPUTEDRAMPS] =
+{
+    { 5000, false, 241, CWRampP1_5000 },
+    { 9000, true, 1729, CWRampP2_9000 },
+};
+
+
+#endif
@@ -0,0 +1,63 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 1
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// regmap.c:
+// register copies for the declarative register map, and their flush
+//
+//////////////////////////////////////////////////////////////
+
+#include "../common/regmap.h"
+#include <pthread.h>
+
+
+//
+// the register copies, from the map
+//
+#define VREGMAPENTRY(Name, RegAddress) { .Address = (RegAddress) },
+struct MappedRegister MappedRegisters[VNUMMAPPEDREGS] =
+{
+    VREGMAPREGISTERS(VREGMAPENTRY)
+};
+#undef VREGMAPENTRY
+
+//
+// held while a register is flushed, so an older copy can't be written after a newer one
+//
+static pthread_mutex_t MappedRegisterMutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+//
+// write one register if it is dirty. The dirty flag is cleared before the copy
+// is read, so a field set meanwhile is either in this write or marks it dirty again
+//
+void FlushMappedRegister(EMappedRegister Reg)
+{
+    struct MappedRegister* Map = &MappedRegisters[Reg];
+
+    pthread_mutex_lock(&MappedRegisterMutex);
+    if (__atomic_exchange_n(&Map->Dirty, false, __ATOMIC_ACQ_REL))
+    {
+        ShadowRegisterWrite(Map->Address, __atomic_load_n(&Map->Value, __ATOMIC_ACQUIRE));
+        __atomic_store_n(&Map->Written, true, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&MappedRegisterMutex);
+}
+
+
+//
+// write every dirty register
+//
+void FlushMappedRegisters(void)
+{
+    uint32_t Reg;
+
+    for (Reg = 0; Reg < VNUMMAPPEDREGS; Reg++)
+        if (__atomic_load_n(&MappedRegisters[Reg].Dirty, __ATOMIC_ACQUIRE))
+            FlushMappedRegister((EMappedRegister)Reg);
+}
@@ -0,0 +1,156 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 1
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// regmap.h:
+// declarative map of the FPGA configuration registers and their fields.
+//
+// each register listed in VREGMAPREGISTERS has a software copy here, in place of
+// a separate global per register. Each field in VREGMAPFIELDS gets inline accessors,
+// with its shift and mask as constants, so they compile to the same code as the
+// hand written shift and mask:
+//   RegSet_<Reg>_<Field>(Value)     update the field in the copy; the register is marked
+//                                   dirty if the copy changed (or has never been written)
+//   RegWrite_<Reg>_<Field>(Value)   the same, then flush the register
+//   RegGet_<Reg>_<Field>()          read the field from the copy
+// FlushMappedRegister() writes one dirty register, through ShadowRegisterWrite(), so
+// writes are still held between BeginRegisterUpdates() and FlushRegisterUpdates();
+// FlushMappedRegisters() writes all of them, and is called by FlushRegisterUpdates().
+// so several fields set with RegSet_ make one bus write at the next flush.
+//
+// field updates are atomic, so two threads can set fields of one register. Only
+// registers where an unchanged write has no effect belong here (not reset or strobe bits).
+//
+// to add a register: add it to VREGMAPREGISTERS, and its fields to VREGMAPFIELDS.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __regmap_h
+#define __regmap_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../common/saturnregisters.h"
+
+
+//
+// the map: X(register name, address) and X(register name, field name, shift, width)
+//
+#define VREGMAPREGISTERS(X) \
+    X(TXConfig,     VADDRTXCONFIGREG) \
+    X(KeyerConfig,  VADDRKEYERCONFIGREG)
+
+#define VREGMAPFIELDS(X) \
+    X(TXConfig,     ModSource,      0,  2)      /* ETXModulationSource */ \
+    X(TXConfig,     OutputGate,     2,  1)      /* 1 = samples always enabled, not gated by TX strobe */ \
+    X(TXConfig,     ProtocolP2,     3,  1)      /* 1 = protocol 2 (192KHz) */ \
+    X(TXConfig,     Scale,          4,  18)     /* TX amplitude scale factor */ \
+    X(TXConfig,     IQDeinterleave, 30, 1)      /* 1 = EER: odd samples to EER */ \
+    X(TXConfig,     MuxEnable,      31, 1)      /* 1 = DUC multiplexer takes samples from the FIFO */ \
+    X(KeyerConfig,  PTTDelay,       0,  8)      /* ms from key to RF */ \
+    X(KeyerConfig,  HangTime,       8,  10)     /* ms from key release to TX off */ \
+    X(KeyerConfig,  RampLength,     18, 13)     /* ramp end address: word (V14+) or byte */ \
+    X(KeyerConfig,  Enable,         31, 1)      /* keyer enabled */
+
+
+//
+// register names: eReg<Name>
+//
+#define VREGMAPENUM(Name, Address) eReg##Name,
+typedef enum
+{
+    VREGMAPREGISTERS(VREGMAPENUM)
+    VNUMMAPPEDREGS
+} EMappedRegister;
+#undef VREGMAPENUM
+
+
+//
+// the software copy of a mapped register
+//
+struct MappedRegister
+{
+    uint32_t Address;
+    uint32_t Value;                             // register copy
+    bool Dirty;                                 // true if Value not yet written
+    bool Written;                               // true once Value has been written
+};
+extern struct MappedRegister MappedRegisters[VNUMMAPPEDREGS];
+
+
+//
+// bool UpdateMappedRegister(EMappedRegister Reg, uint32_t Mask, uint32_t Bits)
+// replace the Mask bits of the register copy with Bits, and mark it dirty
+// if that changed it. Returns true if the register is dirty.
+//
+static inline bool UpdateMappedRegister(EMappedRegister Reg, uint32_t Mask, uint32_t Bits)
+{
+    struct MappedRegister* Map = &MappedRegisters[Reg];
+    uint32_t Old, New;
+
+    Old = __atomic_load_n(&Map->Value, __ATOMIC_RELAXED);
+    do
+        New = (Old & ~Mask) | (Bits & Mask);
+    while (!__atomic_compare_exchange_n(&Map->Value, &Old, New, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    if ((New != Old) || !__atomic_load_n(&Map->Written, __ATOMIC_RELAXED))
+        __atomic_store_n(&Map->Dirty, true, __ATOMIC_RELEASE);
+    return __atomic_load_n(&Map->Dirty, __ATOMIC_ACQUIRE);
+}
+
+
+//
+// void FlushMappedRegister(EMappedRegister Reg)
+// write the register if it is dirty
+//
+void FlushMappedRegister(EMappedRegister Reg);
+
+
+//
+// void FlushMappedRegisters(void)
+// write every dirty register
+//
+void FlushMappedRegisters(void);
+
+
+//
+// field accessors: RegSet_<Reg>_<Field>, RegWrite_<Reg>_<Field>, RegGet_<Reg>_<Field>
+// and the field position VREG_<Reg>_<Field>_SHIFT
+//
+#define VREGMAPMASK(Shift, Width) ((uint32_t)((((uint64_t)1 << (Width)) - 1) << (Shift)))
+#define VREGMAPACCESSORS(Reg, Field, Shift, Width) \
+    enum { VREG_##Reg##_##Field##_SHIFT = (Shift) }; \
+    _Static_assert(((Shift) + (Width)) <= 32, #Reg "." #Field " is outside the register"); \
+    static inline void RegSet_##Reg##_##Field(uint32_t Value) \
+    { \
+        UpdateMappedRegister(eReg##Reg, VREGMAPMASK(Shift, Width), Value << (Shift)); \
+    } \
+    static inline void RegWrite_##Reg##_##Field(uint32_t Value) \
+    { \
+        if (UpdateMappedRegister(eReg##Reg, VREGMAPMASK(Shift, Width), Value << (Shift))) \
+            FlushMappedRegister(eReg##Reg); \
+    } \
+    static inline uint32_t RegGet_##Reg##_##Field(void) \
+    { \
+        return (__atomic_load_n(&MappedRegisters[eReg##Reg].Value, __ATOMIC_RELAXED) \
+                & VREGMAPMASK(Shift, Width)) >> (Shift); \
+    }
+VREGMAPFIELDS(VREGMAPACCESSORS)
+#undef VREGMAPACCESSORS
+
+
+//
+// uint32_t GetMappedRegister(EMappedRegister Reg)
+// the whole register copy, eg to write it with a bit pulsed
+//
+static inline uint32_t GetMappedRegister(EMappedRegister Reg)
+{
+    return __atomic_load_n(&MappedRegisters[Reg].Value, __ATOMIC_RELAXED);
+}
+
+
+#endif
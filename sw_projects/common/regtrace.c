@@ -0,0 +1,171 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// licenced under GNU GPL3
+//
+// regtrace.c:
+// optional register access tracing; compiled only if REGTRACE is defined
+// each thread writes its own ring, so no lock is taken to record an access.
+//
+//////////////////////////////////////////////////////////////
+
+#include "../common/regtrace.h"
+
+#ifdef REGTRACE
+
+#include <stdio.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <link.h>
+#include <syscall.h>
+
+
+struct RegTraceEvent
+{
+    uint64_t Start;                             // ns
+    void* Caller;                               // code address the access was made from
+    uint32_t Address;
+    uint32_t Value;
+    uint32_t Duration;                          // ns
+    uint16_t Count;                             // words
+    char Op;                                    // 'R' or 'W'
+};
+
+struct RegTraceRing
+{
+    struct RegTraceEvent Events[VREGTRACERINGSIZE];
+    uint32_t Written;                           // accesses written since the last dump; wraps to overwrite the oldest
+    long ThreadId;
+};
+
+static struct RegTraceRing RegTraceRings[VREGTRACEMAXTHREADS];
+static atomic_uint RegTraceRingsClaimed = 0;    // rings handed out to threads
+static __thread struct RegTraceRing* ThreadRegTraceRing = NULL;
+static __thread void* ThreadRegTraceCaller = NULL;     // caller set by REGTRACE_SETCALLER, or NULL
+
+
+//
+// uint64_t RegTraceNow(void)
+// return CLOCK_MONOTONIC_RAW time in ns
+//
+uint64_t RegTraceNow(void)
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &Now);
+    return (uint64_t)Now.tv_sec * 1000000000ULL + (uint64_t)Now.tv_nsec;
+}
+
+
+//
+// record an access into the calling thread's ring, claiming one on first use
+//
+void RegTraceRecord(uint64_t Start, char Op, uint32_t Address, uint32_t Value, uint32_t Count, void* Caller)
+{
+    struct RegTraceRing* Ring;
+    struct RegTraceEvent* Event;
+    uint64_t Duration;
+    uint32_t RingNum;
+
+    Duration = RegTraceNow() - Start;
+    if (ThreadRegTraceRing == NULL)
+    {
+        RingNum = atomic_fetch_add(&RegTraceRingsClaimed, 1);
+        if (RingNum >= VREGTRACEMAXTHREADS)
+            return;
+        ThreadRegTraceRing = &RegTraceRings[RingNum];
+        ThreadRegTraceRing->ThreadId = syscall(SYS_gettid);
+    }
+    Ring = ThreadRegTraceRing;
+    Event = &Ring->Events[Ring->Written & (VREGTRACERINGSIZE - 1)];
+    Event->Start = Start;
+    Event->Caller = (ThreadRegTraceCaller != NULL) ? ThreadRegTraceCaller : Caller;
+    Event->Address = Address;
+    Event->Value = Value;
+    Event->Duration = (Duration > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)Duration;
+    Event->Count = (Count > 0xFFFF) ? 0xFFFF : (uint16_t)Count;
+    Event->Op = Op;
+    Ring->Written++;
+}
+
+
+bool RegTraceSetCaller(void* Caller)
+{
+    if (ThreadRegTraceCaller != NULL)
+        return false;
+    ThreadRegTraceCaller = Caller;
+    return true;
+}
+
+
+void RegTraceClearCaller(bool Set)
+{
+    if (Set)
+        ThreadRegTraceCaller = NULL;
+}
+
+
+//
+// void RegTraceDump(const char* Filename)
+// write every thread's accesses as text. Callers of a position independent
+// executable are written as offsets into it, so "addr2line -f -e" can name them
+//
+void RegTraceDump(const char* Filename)
+{
+    FILE* File;
+    uint32_t RingNum, Claimed, Count, Cntr, First;
+    struct RegTraceRing* Ring;
+    struct RegTraceEvent* Event;
+    Dl_info Info;
+    uintptr_t Base = 0;
+    const char* Executable = "unknown";
+    uint64_t Events = 0;
+
+    File = fopen(Filename, "w");
+    if (File == NULL)
+    {
+        perror("open register trace file");
+        return;
+    }
+    if (dladdr((void*)RegTraceDump, &Info) != 0)
+    {
+        if (((ElfW(Ehdr)*)Info.dli_fbase)->e_type == ET_DYN)
+            Base = (uintptr_t)Info.dli_fbase; // position independent: addr2line wants the offset
+        if (Info.dli_fname != NULL)
+            Executable = Info.dli_fname;
+    }
+    Claimed = atomic_load(&RegTraceRingsClaimed);
+    if (Claimed > VREGTRACEMAXTHREADS)
+        Claimed = VREGTRACEMAXTHREADS;
+    fprintf(File, "# register trace: time(ns) thread op address value count duration(ns) caller\n");
+    fprintf(File, "# executable %s\n", Executable);
+    for (RingNum = 0; RingNum < Claimed; RingNum++)
+    {
+        Ring = &RegTraceRings[RingNum];
+        Count = Ring->Written;
+        First = 0;
+        if (Count > VREGTRACERINGSIZE)
+        {
+            First = Count - VREGTRACERINGSIZE;
+            Count = VREGTRACERINGSIZE;
+        }
+        for (Cntr = 0; Cntr < Count; Cntr++)
+        {
+            Event = &Ring->Events[(First + Cntr) & (VREGTRACERINGSIZE - 1)];
+            fprintf(File, "%llu %ld %c 0x%04x 0x%08x %u %u 0x%lx\n", (unsigned long long)Event->Start,
+                    Ring->ThreadId, Event->Op, Event->Address, Event->Value, Event->Count, Event->Duration,
+                    (unsigned long)((uintptr_t)Event->Caller - Base));
+        }
+        Events += Count;
+        Ring->Written = 0;
+    }
+    fclose(File);
+    printf("register trace of %llu accesses written to %s\n", (unsigned long long)Events, Filename);
+}
+
+#endif
@@ -0,0 +1,102 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// licenced under GNU GPL3
+//
+// regtrace.h:
+// header file. optional register access tracing, for performance analysis
+//
+// each register read or write made through hwaccess.c records its time,
+// address, value, word count, duration and caller into a ring owned by the
+// calling thread; the most recent accesses are kept. RegTraceDump() writes
+// them all as text, one access per line, to be summarised by the regtrace
+// tool in sw_tools/regtrace (by address and VADDR name, thread and caller).
+//
+// the caller is the code address the access was made from. The shadow
+// register and register queue functions in saturnregisters.c set it to
+// their own caller, so their accesses are charged to the setter that made
+// them rather than to the shared write code.
+//
+// tracing is only compiled in if REGTRACE is defined (make REGTRACE=1).
+// otherwise the macros expand to nothing, and no code or data remains.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __regtrace_h
+#define __regtrace_h
+
+#include <stdint.h>
+#include "../common/saturntypes.h"
+
+
+#define VREGTRACERINGSIZE 32768                 // accesses kept per thread (power of 2)
+#define VREGTRACEMAXTHREADS 32                  // threads that can trace
+#define VREGTRACEFILE "/tmp/p2app-regtrace.txt" // trace dump file
+
+
+#ifdef REGTRACE
+
+//
+// REGTRACE_START(Start): declare a variable Start holding the access start time
+// REGTRACE_END(Start, Op, Address, Value, Count): record an access that began at Start
+//   Op:    'R' or 'W'
+//   Value: the (first) value read or written
+//   Count: words transferred (1 for a single register)
+// REGTRACE_SETCALLER(Set): charge this thread's accesses to the caller of the current
+//   function, unless already set further up; Set is declared to say if it was set here
+// REGTRACE_CLEARCALLER(Set): undo REGTRACE_SETCALLER
+// REGTRACE_DUMP(): write all threads' accesses to VREGTRACEFILE, and empty the rings
+//
+#define REGTRACE_START(Start) uint64_t Start = RegTraceNow()
+#define REGTRACE_END(Start, Op, Address, Value, Count) \
+        RegTraceRecord(Start, Op, Address, Value, Count, __builtin_return_address(0))
+#define REGTRACE_SETCALLER(Set) bool Set = RegTraceSetCaller(__builtin_return_address(0))
+#define REGTRACE_CLEARCALLER(Set) RegTraceClearCaller(Set)
+#define REGTRACE_DUMP() RegTraceDump(VREGTRACEFILE)
+
+
+//
+// uint64_t RegTraceNow(void)
+// return CLOCK_MONOTONIC_RAW time in ns
+//
+uint64_t RegTraceNow(void);
+
+
+//
+// void RegTraceRecord(uint64_t Start, char Op, uint32_t Address, uint32_t Value, uint32_t Count, void* Caller)
+// record an access from Start to now into the calling thread's ring
+//
+void RegTraceRecord(uint64_t Start, char Op, uint32_t Address, uint32_t Value, uint32_t Count, void* Caller);
+
+
+//
+// bool RegTraceSetCaller(void* Caller)
+// void RegTraceClearCaller(bool Set)
+// set and clear the caller the thread's accesses are charged to
+//
+bool RegTraceSetCaller(void* Caller);
+void RegTraceClearCaller(bool Set);
+
+
+//
+// void RegTraceDump(const char* Filename)
+// write the accesses from every thread as text.
+// rings are read without locking, so an access being recorded as the dump
+// is made may be written part updated.
+//
+void RegTraceDump(const char* Filename);
+
+#else
+
+#define REGTRACE_START(Start)
+#define REGTRACE_END(Start, Op, Address, Value, Count)
+#define REGTRACE_SETCALLER(Set)
+#define REGTRACE_CLEARCALLER(Set)
+#define REGTRACE_DUMP()
+
+#endif
+
+#endif
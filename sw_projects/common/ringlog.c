@@ -0,0 +1,200 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 1 
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// ringlog.c:
+// low cost logging from real time threads
+// each logging thread has a single producer, single consumer ring;
+// the consumer for all of them is the log output thread.
+//
+//////////////////////////////////////////////////////////////
+
+#include "../common/ringlog.h"
+#include "../common/spscring.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+
+
+#define VLOGDRAINPERIOD 10000                   // log thread wakeup period, us
+
+
+struct LogEntry
+{
+    uint32_t Sequence;                          // global order the message was logged in
+    const char* Format;
+    uint32_t Args[3];
+};
+
+struct LogRing
+{
+    struct SPSCRing Ring;
+    struct LogEntry Entries[VLOGRINGSIZE];
+    atomic_uint Dropped;                        // messages lost because the ring was full
+};
+
+static struct LogRing LogRings[VLOGMAXTHREADS];
+static atomic_uint LogRingsClaimed = 0;         // rings handed out to threads
+static atomic_uint LogSequence = 0;             // next message sequence number
+static __thread struct LogRing* ThreadLogRing = NULL;
+static bool RingLogRunning = false;
+static uint32_t LogMaxPerSecond;
+static pthread_t RingLogThread;
+
+
+//
+// get the calling thread's ring, claiming one on first use
+// returns NULL if all are in use
+//
+static struct LogRing* GetThreadLogRing(void)
+{
+    uint32_t Ring;
+
+    if (ThreadLogRing == NULL)
+    {
+        Ring = atomic_fetch_add(&LogRingsClaimed, 1);
+        if (Ring < VLOGMAXTHREADS)
+            ThreadLogRing = &LogRings[Ring];
+    }
+    return ThreadLogRing;
+}
+
+
+//
+// void RingLogWrite(const char* Format, uint32_t Arg1, uint32_t Arg2, uint32_t Arg3, ...)
+// log a message from the calling thread
+//
+void RingLogWrite(const char* Format, uint32_t Arg1, uint32_t Arg2, uint32_t Arg3, ...)
+{
+    struct LogRing* Ring;
+    struct LogEntry* Entry;
+    int32_t Slot;
+
+    if (!RingLogRunning)
+    {
+        printf(Format, Arg1, Arg2, Arg3);
+        return;
+    }
+    Ring = GetThreadLogRing();
+    if (Ring == NULL)
+        return;
+    Slot = SPSCGetWriteSlot(&Ring->Ring);
+    if (Slot < 0)
+    {
+        atomic_fetch_add_explicit(&Ring->Dropped, 1, memory_order_relaxed);
+        return;
+    }
+    Entry = &Ring->Entries[Slot];
+    Entry->Sequence = atomic_fetch_add_explicit(&LogSequence, 1, memory_order_relaxed);
+    Entry->Format = Format;
+    Entry->Args[0] = Arg1;
+    Entry->Args[1] = Arg2;
+    Entry->Args[2] = Arg3;
+    SPSCPublish(&Ring->Ring);
+}
+
+
+//
+// log output thread
+// repeatedly print the oldest message from any ring, while the rate limit allows
+//
+static void* RingLogOutput(void* arg)
+{
+    uint32_t Ring, Claimed, Oldest;
+    int32_t Slot, OldestSlot;
+    struct LogEntry* Entry;
+    struct timespec Now;
+    time_t Second = 0;
+    uint32_t PrintedThisSecond = 0;
+    uint32_t Suppressed = 0;
+    uint32_t Dropped;
+
+    (void)arg;
+    while (true)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &Now);
+        if (Now.tv_sec != Second)                       // new second: report, and restart the limit
+        {
+            if (Suppressed != 0)
+                printf("log: %d messages suppressed\n", Suppressed);
+            Second = Now.tv_sec;
+            PrintedThisSecond = 0;
+            Suppressed = 0;
+        }
+        Claimed = atomic_load(&LogRingsClaimed);
+        if (Claimed > VLOGMAXTHREADS)
+            Claimed = VLOGMAXTHREADS;
+        while (true)
+        {
+            Oldest = VLOGMAXTHREADS;
+            OldestSlot = -1;
+            for (Ring = 0; Ring < Claimed; Ring++)
+            {
+                Slot = SPSCGetReadSlot(&LogRings[Ring].Ring);
+                if (Slot < 0)
+                    continue;
+                // sequence numbers wrap, so compare by difference
+                if ((OldestSlot < 0) || ((int32_t)(LogRings[Ring].Entries[Slot].Sequence
+                                         - LogRings[Oldest].Entries[OldestSlot].Sequence) < 0))
+                {
+                    Oldest = Ring;
+                    OldestSlot = Slot;
+                }
+            }
+            if (OldestSlot < 0)
+                break;
+            Entry = &LogRings[Oldest].Entries[OldestSlot];
+            if (PrintedThisSecond < LogMaxPerSecond)
+            {
+                printf(Entry->Format, Entry->Args[0], Entry->Args[1], Entry->Args[2]);
+                PrintedThisSecond++;
+            }
+            else
+                Suppressed++;
+            SPSCRelease(&LogRings[Oldest].Ring);
+        }
+        for (Ring = 0; Ring < Claimed; Ring++)
+        {
+            Dropped = atomic_exchange_explicit(&LogRings[Ring].Dropped, 0, memory_order_relaxed);
+            if (Dropped != 0)
+                printf("log: %d messages lost, thread log full\n", Dropped);
+        }
+        fflush(stdout);
+        usleep(VLOGDRAINPERIOD);
+    }
+    return NULL;
+}
+
+
+//
+// void InitialiseRingLog(uint32_t MaxPerSecond)
+// start the log output thread
+//
+void InitialiseRingLog(uint32_t MaxPerSecond)
+{
+    uint32_t Ring;
+    int Error;
+
+    for (Ring = 0; Ring < VLOGMAXTHREADS; Ring++)
+    {
+        SPSCInitialise(&LogRings[Ring].Ring, VLOGRINGSIZE);
+        atomic_store(&LogRings[Ring].Dropped, 0);
+    }
+    LogMaxPerSecond = MaxPerSecond;
+    Error = pthread_create(&RingLogThread, NULL, RingLogOutput, NULL);
+    if (Error != 0)
+    {
+        printf("pthread_create log thread: %s\n", strerror(Error));
+        return;
+    }
+    pthread_detach(RingLogThread);
+    RingLogRunning = true;
+}
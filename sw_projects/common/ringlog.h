@@ -0,0 +1,59 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 1 
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// ringlog.h:
+// header file. low cost logging from real time threads
+//
+// a thread logging a message stores only the format string pointer and up
+// to 3 integer arguments into its own lock-free ring; nothing is formatted
+// and no lock is taken. A background thread drains all the rings, in the
+// order the messages were logged, and prints them with printf. Output is
+// limited to a set number of messages per second; any more are counted
+// and reported as suppressed. If a ring is full the message is dropped.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __ringlog_h
+#define __ringlog_h
+
+#include <stdint.h>
+#include "../common/saturntypes.h"
+
+
+#define VLOGRINGSIZE 64                         // messages per thread ring (power of 2)
+#define VLOGMAXTHREADS 32                       // threads that can log
+#define VLOGMAXPERSECOND 50                     // default output rate limit
+
+
+//
+// RINGLOG(Format, ...)
+// log a message with 0 to 3 integer (32 bit) arguments, eg RINGLOG("depth = %d\n", Depth);
+// the format string must be a literal, or otherwise outlive the message.
+//
+#define RINGLOG(...) RingLogWrite(__VA_ARGS__, 0, 0, 0)
+
+
+//
+// void InitialiseRingLog(uint32_t MaxPerSecond)
+// start the log output thread.
+//   MaxPerSecond: messages printed per second before further messages are suppressed
+// until this is called, messages are printed directly.
+//
+void InitialiseRingLog(uint32_t MaxPerSecond);
+
+
+//
+// void RingLogWrite(const char* Format, uint32_t Arg1, uint32_t Arg2, uint32_t Arg3, ...)
+// log a message from the calling thread. Use RINGLOG() rather than calling this.
+// any further arguments (the padding added by RINGLOG) are ignored.
+//
+void RingLogWrite(const char* Format, uint32_t Arg1, uint32_t Arg2, uint32_t Arg3, ...);
+
+
+#endif
@@ -0,0 +1,509 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 1 
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// sampleunpack.c:
+// DDC sample unpack from the FPGA stream format
+// and DUC sample I/Q swap
+//
+//////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <sys/auxv.h>
+#include "../common/sampleunpack.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#include <asm/hwcap.h>
+#endif
+
+
+//
+// current selected kernels. Scalar until InitialiseSampleUnpack() called.
+//
+void (*UnpackDDCSamples)(uint8_t* Dest, const uint8_t* Src, uint32_t Count) = UnpackDDCSamplesScalar;
+void (*SwapIQSamples)(uint8_t* Dest, const uint8_t* Src, uint32_t Count) = SwapIQSamplesScalar;
+void (*WidenSwapIQSamples16)(uint8_t* Dest, const uint8_t* Src, uint32_t Count) = WidenSwapIQSamples16Scalar;
+void (*EERSwapIQSamples)(uint8_t* Dest, const uint8_t* Src, uint32_t Count, struct EERDelayState* State) = EERSwapIQSamplesScalar;
+void (*EERWidenSwapIQSamples16)(uint8_t* Dest, const uint8_t* Src, uint32_t Count, struct EERDelayState* State) = EERWidenSwapIQSamples16Scalar;
+bool GUnpackUsesNEON = false;
+
+
+
+//
+// scalar unpack kernel
+// move 48 bits of sample data, in 16 bit chunks, then skip 16 bits where there's no data
+//
+void UnpackDDCSamplesScalar(uint8_t* Dest, const uint8_t* Src, uint32_t Count)
+{
+    uint16_t* DestWordPtr = (uint16_t*)Dest;
+    const uint16_t* SrcWordPtr = (const uint16_t*)Src;
+    uint32_t Cntr;
+
+    for (Cntr = 0; Cntr < Count; Cntr++)
+    {
+        *DestWordPtr++ = *SrcWordPtr++;                     // move 48 bits of sample data
+        *DestWordPtr++ = *SrcWordPtr++;
+        *DestWordPtr++ = *SrcWordPtr++;
+        SrcWordPtr++;                                       // and skip 16 bits where theres no data
+    }
+}
+
+
+//
+// scalar I/Q swap kernel
+// the client sends Q then I; the FPGA needs I then Q
+//
+void SwapIQSamplesScalar(uint8_t* Dest, const uint8_t* Src, uint32_t Count)
+{
+    uint32_t Cntr;
+
+    for (Cntr = 0; Cntr < Count; Cntr++)
+    {
+        *Dest++ = *(Src+3);                                 // get I sample (3 bytes)
+        *Dest++ = *(Src+4);
+        *Dest++ = *(Src+5);
+        *Dest++ = *(Src+0);                                 // get Q sample (3 bytes)
+        *Dest++ = *(Src+1);
+        *Dest++ = *(Src+2);
+        Src += 6;                                           // point at next source sample
+    }
+}
+
+
+//
+// scalar 16 bit I/Q swap and widen kernel
+// the client sends 16 bit Q then I; the FPGA needs 24 bit I then Q
+// each value becomes the top 2 bytes of the 24 bit value, with a zero low byte
+//
+void WidenSwapIQSamples16Scalar(uint8_t* Dest, const uint8_t* Src, uint32_t Count)
+{
+    uint32_t Cntr;
+
+    for (Cntr = 0; Cntr < Count; Cntr++)
+    {
+        *Dest++ = *(Src+2);                                 // get I sample (2 bytes)
+        *Dest++ = *(Src+3);
+        *Dest++ = 0;
+        *Dest++ = *(Src+0);                                 // get Q sample (2 bytes)
+        *Dest++ = *(Src+1);
+        *Dest++ = 0;
+        Src += 4;                                           // point at next source sample
+    }
+}
+
+
+//
+// EER delay line
+// each call writes the envelope of its samples to Envelope[EnvelopeDelay + n], and the
+// output envelope for sample n is Envelope[n]; the phase delay line works the same way.
+// after the call the newest samples are moved to the start, ready for the next.
+//
+void InitialiseEERDelay(struct EERDelayState* State, int32_t Delay)
+{
+    if (Delay > VEERMAXDELAY)
+        Delay = VEERMAXDELAY;
+    else if (Delay < -VEERMAXDELAY)
+        Delay = -VEERMAXDELAY;
+    memset(State, 0, sizeof(struct EERDelayState));
+    State->Delay = Delay;
+}
+
+
+static inline uint32_t EEREnvelopeDelay(const struct EERDelayState* State)
+{
+    return (State->Delay > 0) ? (uint32_t)State->Delay : 0;
+}
+
+
+static inline uint32_t EERPhaseDelay(const struct EERDelayState* State)
+{
+    return (State->Delay < 0) ? (uint32_t)-State->Delay : 0;
+}
+
+
+static void ShiftEERDelay(struct EERDelayState* State, uint32_t Count)
+{
+    uint32_t Held;
+
+    Held = EEREnvelopeDelay(State);
+    if (Held != 0)
+        memmove(State->Envelope, State->Envelope + Count, Held * sizeof(uint32_t));
+    Held = EERPhaseDelay(State);
+    if (Held != 0)
+        memmove(State->Phase, State->Phase + Count * 6, Held * 6);
+}
+
+
+//
+// scalar EER kernel, for samples First to Count-1 of a call
+// Wide16 = true if the source has 16 bit samples.
+// the envelope is computed in single precision float, as the NEON kernel does
+//
+static void EERSwapRangeScalar(uint8_t* Dest, const uint8_t* Src, uint32_t First, uint32_t Count,
+                               struct EERDelayState* State, bool Wide16)
+{
+    uint8_t Swapped[6];                                     // I/Q sample in FPGA order
+    const uint8_t* Phase;
+    uint32_t EnvelopeDelay, PhaseDelay;
+    uint32_t Cntr;
+    int32_t I, Q;
+    float Magnitude;
+    uint32_t Envelope;
+
+    EnvelopeDelay = EEREnvelopeDelay(State);
+    PhaseDelay = EERPhaseDelay(State);
+    for (Cntr = First; Cntr < Count; Cntr++)
+    {
+        if (Wide16)
+        {
+            Swapped[0] = Src[Cntr*4 + 2];                   // I sample (2 bytes)
+            Swapped[1] = Src[Cntr*4 + 3];
+            Swapped[2] = 0;
+            Swapped[3] = Src[Cntr*4 + 0];                   // Q sample (2 bytes)
+            Swapped[4] = Src[Cntr*4 + 1];
+            Swapped[5] = 0;
+        }
+        else
+        {
+            Swapped[0] = Src[Cntr*6 + 3];                   // I sample (3 bytes)
+            Swapped[1] = Src[Cntr*6 + 4];
+            Swapped[2] = Src[Cntr*6 + 5];
+            Swapped[3] = Src[Cntr*6 + 0];                   // Q sample (3 bytes)
+            Swapped[4] = Src[Cntr*6 + 1];
+            Swapped[5] = Src[Cntr*6 + 2];
+        }
+        I = (int32_t)((uint32_t)Swapped[0] << 24 | (uint32_t)Swapped[1] << 16 | (uint32_t)Swapped[2] << 8) >> 8;
+        Q = (int32_t)((uint32_t)Swapped[3] << 24 | (uint32_t)Swapped[4] << 16 | (uint32_t)Swapped[5] << 8) >> 8;
+        Magnitude = sqrtf((float)I * (float)I + (float)Q * (float)Q);
+        if (Magnitude > (float)VEERMAXENVELOPE)
+            Magnitude = (float)VEERMAXENVELOPE;
+        State->Envelope[EnvelopeDelay + Cntr] = (uint32_t)Magnitude;
+
+        Phase = Swapped;
+        if (PhaseDelay != 0)
+        {
+            memcpy(State->Phase + (PhaseDelay + Cntr) * 6, Swapped, 6);
+            Phase = State->Phase + Cntr * 6;
+        }
+        Envelope = State->Envelope[Cntr];
+        memcpy(Dest + Cntr*12, Phase, 6);                   // phase sample
+        Dest[Cntr*12 + 6] = (uint8_t)(Envelope >> 16);      // envelope sample
+        Dest[Cntr*12 + 7] = (uint8_t)(Envelope >> 8);
+        Dest[Cntr*12 + 8] = (uint8_t)Envelope;
+        Dest[Cntr*12 + 9] = 0;
+        Dest[Cntr*12 + 10] = 0;
+        Dest[Cntr*12 + 11] = 0;
+    }
+}
+
+
+//
+// scalar EER kernels
+//
+void EERSwapIQSamplesScalar(uint8_t* Dest, const uint8_t* Src, uint32_t Count, struct EERDelayState* State)
+{
+    EERSwapRangeScalar(Dest, Src, 0, Count, State, false);
+    ShiftEERDelay(State, Count);
+}
+
+
+void EERWidenSwapIQSamples16Scalar(uint8_t* Dest, const uint8_t* Src, uint32_t Count, struct EERDelayState* State)
+{
+    EERSwapRangeScalar(Dest, Src, 0, Count, State, true);
+    ShiftEERDelay(State, Count);
+}
+
+
+#if defined(__ARM_NEON)
+//
+// NEON unpack kernel
+// vld4 de-interleaves 8 samples into 4 vectors of 16 bit words: word 0, 1, 2 and the unused word 3.
+// vst3 then re-interleaves words 0-2 only, giving 48 packed bytes.
+//
+void UnpackDDCSamplesNEON(uint8_t* Dest, const uint8_t* Src, uint32_t Count)
+{
+    uint16x8x4_t InWords;
+    uint16x8x3_t OutWords;
+
+    while (Count >= 8)
+    {
+        InWords = vld4q_u16((const uint16_t*)Src);
+        OutWords.val[0] = InWords.val[0];
+        OutWords.val[1] = InWords.val[1];
+        OutWords.val[2] = InWords.val[2];
+        vst3q_u16((uint16_t*)Dest, OutWords);
+        Src += 64;
+        Dest += 48;
+        Count -= 8;
+    }
+    if (Count != 0)
+        UnpackDDCSamplesScalar(Dest, Src, Count);
+}
+
+
+//
+// NEON I/Q swap kernel
+// vld3 de-interleaves 8 samples (16 x 3 byte values, alternately Q and I) into 3 vectors:
+// byte 0, 1 and 2 of each value. In each vector the Q and I bytes of a sample are adjacent,
+// so swapping each pair of bytes (vrev16) swaps I & Q. vst3 re-interleaves them.
+//
+void SwapIQSamplesNEON(uint8_t* Dest, const uint8_t* Src, uint32_t Count)
+{
+    uint8x16x3_t Bytes;
+
+    while (Count >= 8)
+    {
+        Bytes = vld3q_u8(Src);
+        Bytes.val[0] = vrev16q_u8(Bytes.val[0]);
+        Bytes.val[1] = vrev16q_u8(Bytes.val[1]);
+        Bytes.val[2] = vrev16q_u8(Bytes.val[2]);
+        vst3q_u8(Dest, Bytes);
+        Src += 48;
+        Dest += 48;
+        Count -= 8;
+    }
+    if (Count != 0)
+        SwapIQSamplesScalar(Dest, Src, Count);
+}
+
+
+//
+// NEON 16 bit I/Q swap and widen kernel
+// vld2 de-interleaves 8 samples into a vector of Q words and a vector of I words.
+// each 6 byte output sample is 3 16 bit words: the I word as it is, then (0, Q high byte)
+// and (Q low byte, 0). As the words are little endian, those are Q << 8 and Q >> 8.
+// vst3 re-interleaves the 3 words.
+//
+void WidenSwapIQSamples16NEON(uint8_t* Dest, const uint8_t* Src, uint32_t Count)
+{
+    uint16x8x2_t InWords;
+    uint16x8x3_t OutWords;
+
+    while (Count >= 8)
+    {
+        InWords = vld2q_u16((const uint16_t*)Src);
+        OutWords.val[0] = InWords.val[1];
+        OutWords.val[1] = vshlq_n_u16(InWords.val[0], 8);
+        OutWords.val[2] = vshrq_n_u16(InWords.val[0], 8);
+        vst3q_u16((uint16_t*)Dest, OutWords);
+        Src += 32;
+        Dest += 48;
+        Count -= 8;
+    }
+    if (Count != 0)
+        WidenSwapIQSamples16Scalar(Dest, Src, Count);
+}
+
+
+//
+// NEON EER envelope: the magnitude of 4 I/Q samples, limited to VEERMAXENVELOPE.
+// with no vector square root on 32 bit ARM, that uses the reciprocal square root
+// estimate with 2 Newton-Raphson steps (zero input gives zero)
+//
+static inline uint32x4_t EERMagnitudeNEON(int32x4_t I, int32x4_t Q)
+{
+    float32x4_t FI, FQ, Squared, Magnitude;
+
+    FI = vcvtq_f32_s32(I);
+    FQ = vcvtq_f32_s32(Q);
+    Squared = vmlaq_f32(vmulq_f32(FI, FI), FQ, FQ);
+#if defined(__aarch64__)
+    Magnitude = vsqrtq_f32(Squared);
+#else
+    {
+        float32x4_t Estimate;
+        uint32x4_t NonZero;
+
+        Estimate = vrsqrteq_f32(Squared);
+        Estimate = vmulq_f32(Estimate, vrsqrtsq_f32(vmulq_f32(Squared, Estimate), Estimate));
+        Estimate = vmulq_f32(Estimate, vrsqrtsq_f32(vmulq_f32(Squared, Estimate), Estimate));
+        NonZero = vcgtq_f32(Squared, vdupq_n_f32(0.0f));
+        Magnitude = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(vmulq_f32(Squared, Estimate)), NonZero));
+    }
+#endif
+    Magnitude = vminq_f32(Magnitude, vdupq_n_f32((float)VEERMAXENVELOPE));
+    return vcvtq_u32_f32(Magnitude);
+}
+
+
+//
+// NEON EER output for 8 samples at sample Index, given their swapped I/Q in 3 vectors of
+// byte 0, 1 and 2 of each value (as SwapIQSamplesNEON has them) and their envelope.
+// the envelope is put in the delay line and the delayed one taken out.
+// each output byte vector is widened to 16 bit (I, Q) pairs, and vzip interleaves those
+// with (envelope, 0) pairs; vst3 then writes I, Q, envelope, 0 for each sample.
+//
+static inline void EERStoreNEON(uint8_t* Dest, uint8x16x3_t Phase, uint32x4_t EnvelopeLow, uint32x4_t EnvelopeHigh,
+                                uint32_t Index, struct EERDelayState* State)
+{
+    uint32_t EnvelopeDelay, PhaseDelay;
+    uint16x8_t EnvelopeBytes[3];
+    uint16x8x2_t Zipped[3];
+    uint8x16x3_t Out;
+    uint16x8_t ByteMask;
+    uint32_t Cntr;
+
+    EnvelopeDelay = EEREnvelopeDelay(State);
+    PhaseDelay = EERPhaseDelay(State);
+    vst1q_u32(State->Envelope + EnvelopeDelay + Index, EnvelopeLow);
+    vst1q_u32(State->Envelope + EnvelopeDelay + Index + 4, EnvelopeHigh);
+    EnvelopeLow = vld1q_u32(State->Envelope + Index);
+    EnvelopeHigh = vld1q_u32(State->Envelope + Index + 4);
+    if (PhaseDelay != 0)
+    {
+        vst3q_u8(State->Phase + (PhaseDelay + Index) * 6, Phase);
+        Phase = vld3q_u8(State->Phase + Index * 6);
+    }
+
+    ByteMask = vdupq_n_u16(0xFF);
+    EnvelopeBytes[0] = vcombine_u16(vmovn_u32(vshrq_n_u32(EnvelopeLow, 16)), vmovn_u32(vshrq_n_u32(EnvelopeHigh, 16)));
+    EnvelopeBytes[1] = vandq_u16(vcombine_u16(vmovn_u32(vshrq_n_u32(EnvelopeLow, 8)), vmovn_u32(vshrq_n_u32(EnvelopeHigh, 8))), ByteMask);
+    EnvelopeBytes[2] = vandq_u16(vcombine_u16(vmovn_u32(EnvelopeLow), vmovn_u32(EnvelopeHigh)), ByteMask);
+    for (Cntr = 0; Cntr < 3; Cntr++)
+        Zipped[Cntr] = vzipq_u16(vreinterpretq_u16_u8(Phase.val[Cntr]), EnvelopeBytes[Cntr]);
+    for (Cntr = 0; Cntr < 2; Cntr++)
+    {
+        Out.val[0] = vreinterpretq_u8_u16(Zipped[0].val[Cntr]);
+        Out.val[1] = vreinterpretq_u8_u16(Zipped[1].val[Cntr]);
+        Out.val[2] = vreinterpretq_u8_u16(Zipped[2].val[Cntr]);
+        vst3q_u8(Dest + Cntr * 48, Out);
+    }
+}
+
+
+//
+// NEON 24 bit EER kernel
+// the swap is as SwapIQSamplesNEON. For the envelope, vuzp separates the Q and I bytes
+// of each byte vector, and they are assembled into signed 32 bit values.
+//
+static inline int32x4_t EERAssemble24(int16x4_t Top, uint16x4_t Low)
+{
+    return vorrq_s32(vshlq_n_s32(vmovl_s16(Top), 16), vreinterpretq_s32_u32(vmovl_u16(Low)));
+}
+
+
+void EERSwapIQSamplesNEON(uint8_t* Dest, const uint8_t* Src, uint32_t Count, struct EERDelayState* State)
+{
+    uint8x16x3_t Bytes;
+    uint8x16x2_t Byte0, Byte1, Byte2;                       // val[0] = Q bytes, val[1] = I bytes
+    int16x8_t QTop, ITop;                                   // sign extended byte 0
+    uint16x8_t QLow, ILow;                                  // bytes 1 & 2
+    uint32_t Index = 0;
+
+    while ((Count - Index) >= 8)
+    {
+        Bytes = vld3q_u8(Src);
+        Byte0 = vuzpq_u8(Bytes.val[0], Bytes.val[0]);
+        Byte1 = vuzpq_u8(Bytes.val[1], Bytes.val[1]);
+        Byte2 = vuzpq_u8(Bytes.val[2], Bytes.val[2]);
+        QTop = vmovl_s8(vreinterpret_s8_u8(vget_low_u8(Byte0.val[0])));
+        ITop = vmovl_s8(vreinterpret_s8_u8(vget_low_u8(Byte0.val[1])));
+        QLow = vorrq_u16(vshll_n_u8(vget_low_u8(Byte1.val[0]), 8), vmovl_u8(vget_low_u8(Byte2.val[0])));
+        ILow = vorrq_u16(vshll_n_u8(vget_low_u8(Byte1.val[1]), 8), vmovl_u8(vget_low_u8(Byte2.val[1])));
+
+        Bytes.val[0] = vrev16q_u8(Bytes.val[0]);
+        Bytes.val[1] = vrev16q_u8(Bytes.val[1]);
+        Bytes.val[2] = vrev16q_u8(Bytes.val[2]);
+        EERStoreNEON(Dest, Bytes,
+                     EERMagnitudeNEON(EERAssemble24(vget_low_s16(ITop), vget_low_u16(ILow)),
+                                      EERAssemble24(vget_low_s16(QTop), vget_low_u16(QLow))),
+                     EERMagnitudeNEON(EERAssemble24(vget_high_s16(ITop), vget_high_u16(ILow)),
+                                      EERAssemble24(vget_high_s16(QTop), vget_high_u16(QLow))),
+                     Index, State);
+        Src += 48;
+        Dest += 96;
+        Index += 8;
+    }
+    if (Index != Count)
+        EERSwapRangeScalar(Dest - Index * 12, Src - Index * 6, Index, Count, State, false);
+    ShiftEERDelay(State, Count);
+}
+
+
+//
+// NEON 16 bit EER kernel
+// vld2 de-interleaves 8 samples into Q words and I words (byte swapped, as they are big endian).
+// the output byte vectors hold (I, Q) byte pairs: vsli and vsri make byte 0 and byte 1 pairs
+// from the words; byte 2 is zero. vrev16 gives the values for the envelope, scaled to 24 bits.
+//
+void EERWidenSwapIQSamples16NEON(uint8_t* Dest, const uint8_t* Src, uint32_t Count, struct EERDelayState* State)
+{
+    uint16x8x2_t InWords;                                   // val[0] = Q, val[1] = I
+    uint8x16x3_t Bytes;
+    int16x8_t QValue, IValue;
+    uint32_t Index = 0;
+
+    while ((Count - Index) >= 8)
+    {
+        InWords = vld2q_u16((const uint16_t*)Src);
+        Bytes.val[0] = vreinterpretq_u8_u16(vsliq_n_u16(InWords.val[1], InWords.val[0], 8));
+        Bytes.val[1] = vreinterpretq_u8_u16(vsriq_n_u16(InWords.val[0], InWords.val[1], 8));
+        Bytes.val[2] = vdupq_n_u8(0);
+        QValue = vreinterpretq_s16_u8(vrev16q_u8(vreinterpretq_u8_u16(InWords.val[0])));
+        IValue = vreinterpretq_s16_u8(vrev16q_u8(vreinterpretq_u8_u16(InWords.val[1])));
+        EERStoreNEON(Dest, Bytes,
+                     EERMagnitudeNEON(vshll_n_s16(vget_low_s16(IValue), 8), vshll_n_s16(vget_low_s16(QValue), 8)),
+                     EERMagnitudeNEON(vshll_n_s16(vget_high_s16(IValue), 8), vshll_n_s16(vget_high_s16(QValue), 8)),
+                     Index, State);
+        Src += 32;
+        Dest += 96;
+        Index += 8;
+    }
+    if (Index != Count)
+        EERSwapRangeScalar(Dest - Index * 12, Src - Index * 4, Index, Count, State, true);
+    ShiftEERDelay(State, Count);
+}
+#endif
+
+
+
+//
+// void InitialiseSampleUnpack(void)
+// select the fastest unpack and swap kernels supported by this processor
+//
+void InitialiseSampleUnpack(void)
+{
+    UnpackDDCSamples = UnpackDDCSamplesScalar;
+    SwapIQSamples = SwapIQSamplesScalar;
+    WidenSwapIQSamples16 = WidenSwapIQSamples16Scalar;
+    EERSwapIQSamples = EERSwapIQSamplesScalar;
+    EERWidenSwapIQSamples16 = EERWidenSwapIQSamples16Scalar;
+    GUnpackUsesNEON = false;
+#if defined(__ARM_NEON)
+#if defined(__aarch64__)
+    if (getauxval(AT_HWCAP) & HWCAP_ASIMD)
+#else
+    if (getauxval(AT_HWCAP) & HWCAP_NEON)
+#endif
+    {
+        UnpackDDCSamples = UnpackDDCSamplesNEON;
+        SwapIQSamples = SwapIQSamplesNEON;
+        WidenSwapIQSamples16 = WidenSwapIQSamples16NEON;
+        EERSwapIQSamples = EERSwapIQSamplesNEON;
+        EERWidenSwapIQSamples16 = EERWidenSwapIQSamples16NEON;
+        GUnpackUsesNEON = true;
+    }
+#endif
+    if (GUnpackUsesNEON)
+        printf("DDC sample unpack and DUC I/Q swap: using NEON\n");
+    else
+        printf("DDC sample unpack and DUC I/Q swap: using scalar code\n");
+}
+
+
+//
+// bool SampleUnpackUsesNEON(void)
+// returns true if the NEON kernels have been selected
+//
+bool SampleUnpackUsesNEON(void)
+{
+    return GUnpackUsesNEON;
+}
@@ -0,0 +1,152 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 1 
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// sampleunpack.h:
+// header file. DDC sample unpack from the FPGA stream format
+// and DUC sample I/Q swap to the FPGA stream format
+//
+// the DDC DMA stream has one 48 bit I/Q sample in each 64 bit word.
+// the unpack code copies the 48 bits of each sample to a packed
+// byte stream ready for a protocol 1 or protocol 2 packet.
+// the byte order is not changed.
+//
+// the DUC samples from the client have Q then I (3 bytes each), the
+// FPGA needs I then Q. The swap code exchanges the two 3 byte halves
+// of each 6 byte sample. In 16 bit DUC mode the client sends 2 byte
+// values, and the swap also widens them to 3 bytes.
+//
+// in EER mode the swap also computes the envelope sqrt(I^2+Q^2) of each
+// sample, and writes 2 samples to the FPGA for each one from the client:
+// the I/Q (phase) sample, then the envelope as a 24 bit I value with Q = 0.
+// the FPGA, with the TX I/Q deinterleaved, sends the even samples to the
+// DUC and the odd samples to the EER output. Either path can be delayed by
+// a few samples to match the delays in the external amplifier.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __sampleunpack_h
+#define __sampleunpack_h
+
+#include <stdint.h>
+#include "../common/saturntypes.h"
+
+
+#define VEERMAXSAMPLES 240                      // most samples in one EER kernel call (one DUC packet)
+#define VEERMAXDELAY 64                         // most samples the envelope or the phase can be delayed
+#define VEERMAXENVELOPE 0x7FFFFF                // envelope is limited to the largest 24 bit value
+
+
+//
+// EER delay line, carried from one packet to the next
+//
+struct EERDelayState
+{
+    int32_t Delay;                                          // samples envelope is delayed; negative: phase delayed
+    uint32_t Envelope[VEERMAXDELAY + VEERMAXSAMPLES];       // envelope values, oldest first
+    uint8_t Phase[(VEERMAXDELAY + VEERMAXSAMPLES) * 6];     // swapped I/Q samples, if the phase is delayed
+};
+
+
+//
+// void UnpackDDCSamples(uint8_t* Dest, const uint8_t* Src, uint32_t Count)
+// unpack samples using the kernel selected by InitialiseSampleUnpack()
+//   Dest:    destination; 6 bytes written per sample
+//   Src:     source in FPGA stream format; 8 bytes read per sample
+//   Count:   number of samples
+//
+extern void (*UnpackDDCSamples)(uint8_t* Dest, const uint8_t* Src, uint32_t Count);
+
+
+//
+// void SwapIQSamples(uint8_t* Dest, const uint8_t* Src, uint32_t Count)
+// swap I & Q using the kernel selected by InitialiseSampleUnpack()
+//   Dest:    destination; 6 bytes written per sample
+//   Src:     source, 6 bytes per sample
+//   Count:   number of samples
+//
+extern void (*SwapIQSamples)(uint8_t* Dest, const uint8_t* Src, uint32_t Count);
+
+
+//
+// void WidenSwapIQSamples16(uint8_t* Dest, const uint8_t* Src, uint32_t Count)
+// swap I & Q and widen from 16 to 24 bits, using the kernel selected by InitialiseSampleUnpack()
+//   Dest:    destination; 6 bytes written per sample
+//   Src:     source, 4 bytes per sample (16 bit Q then I)
+//   Count:   number of samples
+//
+extern void (*WidenSwapIQSamples16)(uint8_t* Dest, const uint8_t* Src, uint32_t Count);
+
+
+//
+// void EERSwapIQSamples(uint8_t* Dest, const uint8_t* Src, uint32_t Count, struct EERDelayState* State)
+// swap I & Q and add the envelope, using the kernel selected by InitialiseSampleUnpack()
+//   Dest:    destination; 12 bytes written per sample (I/Q sample then envelope sample)
+//   Src:     source, 6 bytes per sample
+//   Count:   number of samples, up to VEERMAXSAMPLES
+//   State:   delay line for the stream
+// a phase delay costs a copy of the I/Q samples through the delay line; an envelope delay doesn't.
+//
+extern void (*EERSwapIQSamples)(uint8_t* Dest, const uint8_t* Src, uint32_t Count, struct EERDelayState* State);
+
+
+//
+// void EERWidenSwapIQSamples16(uint8_t* Dest, const uint8_t* Src, uint32_t Count, struct EERDelayState* State)
+// the same for 16 bit samples: swap I & Q, widen to 24 bits and add the envelope
+//   Src:     source, 4 bytes per sample (16 bit Q then I)
+//
+extern void (*EERWidenSwapIQSamples16)(uint8_t* Dest, const uint8_t* Src, uint32_t Count, struct EERDelayState* State);
+
+
+//
+// void InitialiseEERDelay(struct EERDelayState* State, int32_t Delay)
+// empty the delay line, and set the delay (limited to +/- VEERMAXDELAY samples)
+//
+void InitialiseEERDelay(struct EERDelayState* State, int32_t Delay);
+
+
+//
+// void InitialiseSampleUnpack(void)
+// select the fastest unpack and swap kernels supported by this processor
+// NEON if available, else the scalar code
+//
+void InitialiseSampleUnpack(void);
+
+
+//
+// scalar unpack kernel. Always available.
+//
+void UnpackDDCSamplesScalar(uint8_t* Dest, const uint8_t* Src, uint32_t Count);
+void SwapIQSamplesScalar(uint8_t* Dest, const uint8_t* Src, uint32_t Count);
+void WidenSwapIQSamples16Scalar(uint8_t* Dest, const uint8_t* Src, uint32_t Count);
+void EERSwapIQSamplesScalar(uint8_t* Dest, const uint8_t* Src, uint32_t Count, struct EERDelayState* State);
+void EERWidenSwapIQSamples16Scalar(uint8_t* Dest, const uint8_t* Src, uint32_t Count, struct EERDelayState* State);
+
+
+//
+// NEON unpack and swap kernels: 8 samples per iteration, then scalar for any remainder.
+// only available if compiled for a processor with NEON
+//
+#if defined(__ARM_NEON)
+#define VNEONUNPACKAVAILABLE
+void UnpackDDCSamplesNEON(uint8_t* Dest, const uint8_t* Src, uint32_t Count);
+void SwapIQSamplesNEON(uint8_t* Dest, const uint8_t* Src, uint32_t Count);
+void WidenSwapIQSamples16NEON(uint8_t* Dest, const uint8_t* Src, uint32_t Count);
+void EERSwapIQSamplesNEON(uint8_t* Dest, const uint8_t* Src, uint32_t Count, struct EERDelayState* State);
+void EERWidenSwapIQSamples16NEON(uint8_t* Dest, const uint8_t* Src, uint32_t Count, struct EERDelayState* State);
+#endif
+
+
+//
+// bool SampleUnpackUsesNEON(void)
+// returns true if the NEON kernels have been selected
+//
+bool SampleUnpackUsesNEON(void);
+
+
+#endif
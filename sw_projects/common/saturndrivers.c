@@ -13,17 +13,106 @@
 //////////////////////////////////////////////////////////////
 
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE                     // ppoll() and pthread_setname_np(), whatever the Makefile sets
+#endif
 #include <stdlib.h>                     // for function min()
 #include <math.h>
 #include "../common/saturndrivers.h"
 #include "../common/saturnregisters.h"
 #include "../common/hwaccess.h"                   // low level access
-#include <semaphore.h>
-
-sem_t DDCResetFIFOMutex;
+#include "../common/version.h"
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 bool GFIFOSizesInitialised = false;
 
+//
+// status flags seen by SampleFIFOMonitorChannel(). Reading the status register clears them,
+// so they are held here and returned by the next ReadFIFOMonitorChannel() instead.
+//
+static uint32_t FIFOMonitorPendingFlags[VNUMDMAFIFO];
+
+//
+// watermarks set by SetFIFOMonitorWatermarks() (0 = automatic), and the control
+// register value last written to each channel, so unchanged values aren't rewritten
+//
+static uint32_t FIFOHighWatermarks[VNUMDMAFIFO];
+static uint32_t FIFOLowWatermarks[VNUMDMAFIFO];
+static uint32_t FIFOMonitorControl[VNUMDMAFIFO];
+static bool FIFOMonitorControlValid[VNUMDMAFIFO];
+
+
+//
+// true for the FIFOs the processor writes and the FPGA reads
+//
+static inline bool IsWriteFIFO(EDMAStreamSelect Channel)
+{
+	return (Channel == eTXDUCDMA) || (Channel == eSpkCodecDMA);
+}
+
+
+//
+// write a FIFO monitor control register: high watermark, low watermark and interrupt enable.
+// the low watermark is only written if the firmware has it; the register write is skipped
+// if the value is unchanged
+//
+static void WriteFIFOMonitorControl(EDMAStreamSelect Channel, uint32_t High, uint32_t Low, bool EnableInterrupt)
+{
+	uint32_t Data;
+
+	if (!GFIFOSizesInitialised)
+	{
+			InitialiseFIFOSizes();				// load FIFO size table, if not already done
+			GFIFOSizesInitialised = true;
+	}
+	if (High > DMAFIFODepths[(int)Channel])
+		High = DMAFIFODepths[(int)Channel];
+	if (Low >= DMAFIFODepths[(int)Channel])
+		Low = DMAFIFODepths[(int)Channel] - 1;
+	if (!GetFPGACapabilities()->HasFIFOWatermarks)
+		Low = 0;
+	Data = (High & 0xFFFF) | ((Low & 0x7FFF) << 16);			// 16 bit threshold, 15 bit low watermark
+	if (EnableInterrupt)
+		Data += 0x80000000;						// bit 31
+	if (FIFOMonitorControlValid[Channel] && (FIFOMonitorControl[Channel] == Data))
+		return;
+	RegisterWrite(VADDRFIFOMONBASE + 4 * Channel + 0x10, Data);	// config register address
+	FIFOMonitorControl[Channel] = Data;
+	FIFOMonitorControlValid[Channel] = true;
+}
+
+
+//
+// void SetFIFOMonitorWatermarks(EDMAStreamSelect Channel, uint32_t High, uint32_t Low);
+//
+// set the watermarks the FIFO monitor setup calls use for a channel; 0 = automatic
+//
+void SetFIFOMonitorWatermarks(EDMAStreamSelect Channel, uint32_t High, uint32_t Low)
+{
+	FIFOHighWatermarks[Channel] = High;
+	FIFOLowWatermarks[Channel] = IsWriteFIFO(Channel) ? Low : 0;
+}
+
+
+//
+// void GetFIFOMonitorWatermarks(EDMAStreamSelect Channel, uint32_t* High, uint32_t* Low);
+//
+// return the watermarks last written to a channel's control register
+//
+void GetFIFOMonitorWatermarks(EDMAStreamSelect Channel, uint32_t* High, uint32_t* Low)
+{
+	*High = FIFOMonitorControl[Channel] & 0xFFFF;
+	*Low = (FIFOMonitorControl[Channel] >> 16) & 0x7FFF;
+}
+
 
 
 //
@@ -36,19 +125,406 @@ bool GFIFOSizesInitialised = false;
 //
 void SetupFIFOMonitorChannel(EDMAStreamSelect Channel, bool EnableInterrupt)
 {
-	uint32_t Address;							// register address
-	uint32_t Data;								// register content
+	uint32_t High;
 
-	if (!GFIFOSizesInitialised)
+	High = FIFOHighWatermarks[Channel];
+	if (High == 0)
+		High = GetFIFOMonitorDepth(Channel);	// memory depth
+	FIFOMonitorControlValid[Channel] = false;	// always written: the FIFO has been set up afresh
+	WriteFIFOMonitorControl(Channel, High, FIFOLowWatermarks[Channel], EnableInterrupt);
+}
+
+
+
+//
+// void SetupFIFOMonitorThreshold(EDMAStreamSelect Channel, uint32_t Threshold, bool EnableInterrupt);
+//
+// Setup a single FIFO monitor channel with a specified threshold.
+// used to generate a "data available" interrupt for a read FIFO
+//   Channel:			IP channel number (enum)
+//   Threshold:			number of 64 bit locations at which "over threshold" is declared
+//   EnableInterrupt:	true if interrupt generation enabled
+//
+void SetupFIFOMonitorThreshold(EDMAStreamSelect Channel, uint32_t Threshold, bool EnableInterrupt)
+{
+	if (FIFOHighWatermarks[Channel] != 0)
+		Threshold = FIFOHighWatermarks[Channel];	// set in the config file
+	WriteFIFOMonitorControl(Channel, Threshold, FIFOLowWatermarks[Channel], EnableInterrupt);
+}
+
+
+
+//
+// XDMA user interrupt dispatcher
+// the driver's events device gives each interrupt to whichever one reader wakes first,
+// so 2 threads waiting on the same user interrupt would race for it. The dispatcher
+// thread is the only reader of the events devices: it waits on all of them in one epoll
+// set, and wakes every waiter registered for the source by writing to its eventfd.
+// an events device, once opened, stays open: the dispatcher thread reads it without
+// the lock, and it is only read when epoll has seen an event, so the read never blocks.
+//
+struct UserIRQSource
+{
+	int Device_fd;								// events device; -1 = not open
+	int Waiters[VMAXIRQWAITERS];				// waiter eventfds; -1 = free
+	uint64_t Interrupts;						// interrupts dispatched
+	uint64_t DispatchNs;						// CLOCK_MONOTONIC time of the last dispatch
+	uint64_t Wakeups;							// waits ended by an interrupt
+	uint64_t LatencyTotalNs;					// dispatch to waiter awake
+	uint64_t LatencyMaxNs;
+	uint64_t WakeFailures;						// eventfd writes that failed
+};
+
+static const char* UserIRQDevices[VNUMUSERIRQ] =
+{
+	VDDCEVENTDEVICE,
+	VDUCEVENTDEVICE,
+	VMICEVENTDEVICE,
+	VSPKEVENTDEVICE,
+	VWBEVENTDEVICE,
+	VSTATUSEVENTDEVICE
+};
+
+static struct UserIRQSource UserIRQSources[VNUMUSERIRQ];
+static pthread_mutex_t UserIRQLock = PTHREAD_MUTEX_INITIALIZER;
+static int UserIRQEpoll_fd = -1;				// -1 until the dispatcher thread starts
+
+
+static uint64_t UserIRQTimeNs(void)
+{
+	struct timespec Now;
+
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	return (uint64_t)Now.tv_sec * 1000000000ULL + (uint64_t)Now.tv_nsec;
+}
+
+
+//
+// dispatcher thread: take each interrupt from its events device, and wake its waiters
+//
+static void* UserIRQDispatcher(__attribute__((unused)) void* Arg)
+{
+	struct epoll_event Events[VNUMUSERIRQ];
+	struct UserIRQSource* IRQ;
+	uint32_t Bits;
+	uint64_t One = 1;
+	int Count, Cntr, Waiter;
+
+	while (1)
 	{
-			InitialiseFIFOSizes();				// load FIFO size table, if not already done
-			GFIFOSizesInitialised = true;
+		Count = epoll_wait(UserIRQEpoll_fd, Events, VNUMUSERIRQ, -1);
+		if (Count < 0)
+		{
+			if (errno != EINTR)
+				perror("user IRQ epoll_wait");
+			continue;
+		}
+		for (Cntr = 0; Cntr < Count; Cntr++)
+		{
+			IRQ = &UserIRQSources[Events[Cntr].data.u32];
+			if ((read(IRQ->Device_fd, &Bits, sizeof(Bits)) != sizeof(Bits)) || (Bits == 0))
+				continue;
+			pthread_mutex_lock(&UserIRQLock);
+			IRQ->Interrupts++;
+			__atomic_store_n(&IRQ->DispatchNs, UserIRQTimeNs(), __ATOMIC_RELAXED);
+			for (Waiter = 0; Waiter < VMAXIRQWAITERS; Waiter++)
+				if ((IRQ->Waiters[Waiter] >= 0) && (write(IRQ->Waiters[Waiter], &One, sizeof(One)) < 0))
+					IRQ->WakeFailures++;
+			pthread_mutex_unlock(&UserIRQLock);
+		}
 	}
-	Address = VADDRFIFOMONBASE + 4 * Channel + 0x10;			// config register address
-	Data = DMAFIFODepths[(int)Channel];							// memory depth
-	if (EnableInterrupt)
-		Data += 0x80000000;						// bit 31
-	RegisterWrite(Address, Data);
+	return NULL;
+}
+
+
+//
+// start the dispatcher thread, 1st time any waiter is opened. Called with the lock held
+//
+static bool StartUserIRQDispatcher(void)
+{
+	pthread_t Thread;
+	uint32_t Source;
+	int Waiter;
+
+	if (UserIRQEpoll_fd >= 0)
+		return true;
+	for (Source = 0; Source < VNUMUSERIRQ; Source++)
+	{
+		UserIRQSources[Source].Device_fd = -1;
+		for (Waiter = 0; Waiter < VMAXIRQWAITERS; Waiter++)
+			UserIRQSources[Source].Waiters[Waiter] = -1;
+	}
+	UserIRQEpoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (UserIRQEpoll_fd < 0)
+		return false;
+	if (pthread_create(&Thread, NULL, UserIRQDispatcher, NULL) != 0)
+	{
+		perror("pthread_create user IRQ dispatcher");
+		close(UserIRQEpoll_fd);
+		UserIRQEpoll_fd = -1;
+		return false;
+	}
+	pthread_detach(Thread);
+	pthread_setname_np(Thread, "user IRQ");
+	return true;
+}
+
+
+//
+// int OpenUserIRQWaiter(uint32_t Source);
+//
+// register a waiter for a user interrupt; opens the events device if not yet open
+//
+int OpenUserIRQWaiter(uint32_t Source)
+{
+	struct UserIRQSource* IRQ;
+	struct epoll_event Event;
+	int EventFd = -1;
+	int Waiter;
+
+	if (Source >= VNUMUSERIRQ)
+		return -1;
+	IRQ = &UserIRQSources[Source];
+	pthread_mutex_lock(&UserIRQLock);
+	if (!StartUserIRQDispatcher())
+		goto done;
+	if (IRQ->Device_fd < 0)
+	{
+		IRQ->Device_fd = OpenDMADevice(UserIRQDevices[Source], O_RDONLY | O_CLOEXEC);
+		if (IRQ->Device_fd < 0)
+			goto done;
+		Event.events = EPOLLIN;
+		Event.data.u32 = Source;
+		if (epoll_ctl(UserIRQEpoll_fd, EPOLL_CTL_ADD, IRQ->Device_fd, &Event) < 0)
+		{
+			close(IRQ->Device_fd);
+			IRQ->Device_fd = -1;
+			goto done;
+		}
+	}
+	for (Waiter = 0; Waiter < VMAXIRQWAITERS; Waiter++)
+		if (IRQ->Waiters[Waiter] < 0)
+		{
+			EventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+			IRQ->Waiters[Waiter] = EventFd;
+			break;
+		}
+	if (Waiter == VMAXIRQWAITERS)
+		printf("user IRQ %s: more than %d waiters\n", UserIRQDevices[Source], VMAXIRQWAITERS);
+done:
+	pthread_mutex_unlock(&UserIRQLock);
+	return EventFd;
+}
+
+
+//
+// void CloseUserIRQWaiter(int EventFd);
+//
+// remove a waiter, and close its eventfd
+//
+void CloseUserIRQWaiter(int EventFd)
+{
+	uint32_t Source;
+	int Waiter;
+
+	if (EventFd < 0)
+		return;
+	pthread_mutex_lock(&UserIRQLock);
+	for (Source = 0; Source < VNUMUSERIRQ; Source++)
+		for (Waiter = 0; Waiter < VMAXIRQWAITERS; Waiter++)
+			if (UserIRQSources[Source].Waiters[Waiter] == EventFd)
+				UserIRQSources[Source].Waiters[Waiter] = -1;
+	pthread_mutex_unlock(&UserIRQLock);
+	close(EventFd);
+}
+
+
+//
+// a waiter's eventfd has been read: count the wakeup and its latency from the dispatch
+// only waiters read their own eventfd, so the table can be searched without the lock
+//
+static void NoteUserIRQWakeup(int EventFd)
+{
+	struct UserIRQSource* IRQ;
+	uint32_t Source;
+	uint64_t Latency;
+	int Waiter;
+
+	for (Source = 0; Source < VNUMUSERIRQ; Source++)
+	{
+		IRQ = &UserIRQSources[Source];
+		for (Waiter = 0; Waiter < VMAXIRQWAITERS; Waiter++)
+			if (IRQ->Waiters[Waiter] == EventFd)
+			{
+				Latency = UserIRQTimeNs() - __atomic_load_n(&IRQ->DispatchNs, __ATOMIC_RELAXED);
+				__atomic_add_fetch(&IRQ->Wakeups, 1, __ATOMIC_RELAXED);
+				__atomic_add_fetch(&IRQ->LatencyTotalNs, Latency, __ATOMIC_RELAXED);
+				if (Latency > __atomic_load_n(&IRQ->LatencyMaxNs, __ATOMIC_RELAXED))
+					__atomic_store_n(&IRQ->LatencyMaxNs, Latency, __ATOMIC_RELAXED);
+				return;
+			}
+	}
+}
+
+
+//
+// void ReportUserIRQStats(void);
+//
+// print the interrupt and wakeup counts and latency for each source in use
+//
+void ReportUserIRQStats(void)
+{
+	struct UserIRQSource* IRQ;
+	uint32_t Source;
+	uint64_t Wakeups;
+
+	if (UserIRQEpoll_fd < 0)
+		return;
+	for (Source = 0; Source < VNUMUSERIRQ; Source++)
+	{
+		IRQ = &UserIRQSources[Source];
+		if (IRQ->Device_fd < 0)
+			continue;
+		Wakeups = __atomic_load_n(&IRQ->Wakeups, __ATOMIC_RELAXED);
+		printf("user IRQ %s: interrupts = %llu, waiter wakeups = %llu, mean latency = %.1fus, max = %.1fus\n",
+		       UserIRQDevices[Source], (unsigned long long)__atomic_load_n(&IRQ->Interrupts, __ATOMIC_RELAXED),
+		       (unsigned long long)Wakeups,
+		       (Wakeups != 0) ? (double)__atomic_load_n(&IRQ->LatencyTotalNs, __ATOMIC_RELAXED) / (double)Wakeups / 1000.0 : 0.0,
+		       (double)__atomic_load_n(&IRQ->LatencyMaxNs, __ATOMIC_RELAXED) / 1000.0);
+		if (IRQ->WakeFailures != 0)
+			printf("user IRQ %s: waiter wakeups failed = %llu\n", UserIRQDevices[Source], (unsigned long long)IRQ->WakeFailures);
+	}
+}
+
+
+//
+// int OpenFIFOMonitorEvents(EDMAStreamSelect Channel);
+//
+// open a waiter on the user interrupt for a FIFO monitor channel
+// returns a file descriptor, or -1 if not available
+//
+int OpenFIFOMonitorEvents(EDMAStreamSelect Channel)
+{
+	int EventFd;
+
+	EventFd = OpenUserIRQWaiter((uint32_t)Channel);
+	if (EventFd < 0)
+		printf("XDMA event device %s not available, using polled FIFO access\n", UserIRQDevices[(int)Channel]);
+	return EventFd;
+}
+
+
+//
+// read a waiter's eventfd after poll: true if an interrupt was dispatched to it
+//
+static bool ReadUserIRQWaiter(int EventFd)
+{
+	uint64_t Events;
+
+	if (read(EventFd, &Events, sizeof(Events)) != sizeof(Events))
+		return false;
+	NoteUserIRQWakeup(EventFd);
+	return true;
+}
+
+
+//
+// bool WaitFIFOMonitorEvent(int EventFd, int Timeout);
+//
+// wait for a user interrupt, or timeout.
+// the eventfd read returns the count of interrupts dispatched since the last, and clears it.
+//   EventFd:			file descriptor from OpenFIFOMonitorEvents() or OpenUserIRQWaiter()
+//   Timeout:			timeout in ms
+// returns true if an interrupt occurred; false if timed out or error
+//
+bool WaitFIFOMonitorEvent(int EventFd, int Timeout)
+{
+	struct pollfd PollData;
+	bool Result = false;
+
+	PollData.fd = EventFd;
+	PollData.events = POLLIN;
+	PollData.revents = 0;
+	if (poll(&PollData, 1, Timeout) > 0)
+	{
+		if (PollData.revents & POLLIN)
+			Result = ReadUserIRQWaiter(EventFd);
+	}
+	return Result;
+}
+
+
+#define VFIFOSPACEMAXWAIT 2000000				// ns: longest wait before re-reading the FIFO anyway
+#define VFIFOSPACEMINWAIT 20000					// ns: shortest wait worth making
+
+//
+// uint32_t WaitFIFOMonitorSpace(EDMAStreamSelect Channel, int EventFd, uint32_t MinFree, uint32_t DrainRate,
+//                               bool* Overflowed, bool* OverThreshold, bool* Underflowed, unsigned int* Current);
+//
+// wait until a write FIFO has at least MinFree free locations
+// each wait is capped, so if the FIFO isn't draining (eg the FPGA isn't reading it)
+// this reverts to polling at the cap interval.
+//
+uint32_t WaitFIFOMonitorSpace(EDMAStreamSelect Channel, int EventFd, uint32_t MinFree, uint32_t DrainRate,
+                              bool* Overflowed, bool* OverThreshold, bool* Underflowed, unsigned int* Current)
+{
+	uint32_t Free;
+	uint64_t WaitNs;
+	bool Overflow, OverThresh, Underflow;
+	struct timespec WaitTime;
+	struct pollfd PollData;
+	bool Exact;
+
+	*Overflowed = false;
+	*OverThreshold = false;
+	*Underflowed = false;
+	//
+	// with interrupts and a firmware low watermark, have the FPGA interrupt
+	// as soon as MinFree locations are free, unless a watermark has been set
+	//
+	Exact = false;
+	if ((EventFd >= 0) && FIFOMonitorControlValid[Channel] && (FIFOMonitorControl[Channel] & 0x80000000)
+	    && GetFPGACapabilities()->HasFIFOWatermarks)
+	{
+		if ((FIFOLowWatermarks[Channel] == 0) && (MinFree < DMAFIFODepths[Channel]))
+		{
+			WriteFIFOMonitorControl(Channel, FIFOMonitorControl[Channel] & 0xFFFF, DMAFIFODepths[Channel] - MinFree, true);
+			Exact = true;
+		}
+	}
+	while (1)
+	{
+		Free = ReadFIFOMonitorChannel(Channel, &Overflow, &OverThresh, &Underflow, Current);
+		*Overflowed |= Overflow;
+		*OverThreshold |= OverThresh;
+		*Underflowed |= Underflow;
+		if (Free >= MinFree)
+			break;
+		//
+		// time for the FPGA to read enough locations to make the space needed
+		//
+		WaitNs = VFIFOSPACEMAXWAIT;
+		if ((DrainRate != 0) && !Exact)			// the interrupt comes when the space is there
+			WaitNs = ((uint64_t)(MinFree - Free) * 1000000000ULL) / DrainRate;
+		if (WaitNs > VFIFOSPACEMAXWAIT)
+			WaitNs = VFIFOSPACEMAXWAIT;
+		else if (WaitNs < VFIFOSPACEMINWAIT)
+			WaitNs = VFIFOSPACEMINWAIT;
+		WaitTime.tv_sec = 0;
+		WaitTime.tv_nsec = (long)WaitNs;
+		if (EventFd >= 0)
+		{
+			PollData.fd = EventFd;
+			PollData.events = POLLIN;
+			PollData.revents = 0;
+			if ((ppoll(&PollData, 1, &WaitTime, NULL) > 0) && (PollData.revents & POLLIN))
+				if (!ReadUserIRQWaiter(EventFd))
+					nanosleep(&WaitTime, NULL);			// events device failed: fall back to timed wait
+		}
+		else
+			nanosleep(&WaitTime, NULL);
+	}
+	return Free;
 }
 
 
@@ -75,6 +551,7 @@ uint32_t ReadFIFOMonitorChannel(EDMAStreamSelect Channel, bool* Overflowed, bool
 
 	Address = VADDRFIFOMONBASE + 4 * (uint32_t)Channel;			// status register address
 	Data = RegisterRead(Address);
+	Data |= __atomic_exchange_n(&FIFOMonitorPendingFlags[Channel], 0, __ATOMIC_RELAXED);	// flags seen by the sampler
 	if (Data & 0x80000000)										// if top bit set, declare overflow
 		Overflow = true;
 	if (Data & 0x40000000)										// if bit 30 set, declare over threshold
@@ -92,6 +569,39 @@ uint32_t ReadFIFOMonitorChannel(EDMAStreamSelect Channel, bool* Overflowed, bool
 }
 
 
+//
+// uint32_t SampleFIFOMonitorChannel(EDMAStreamSelect Channel)
+//
+// read the number of occupied locations, without losing status flags
+// any flags read are kept for the next ReadFIFOMonitorChannel()
+//
+uint32_t SampleFIFOMonitorChannel(EDMAStreamSelect Channel)
+{
+	uint32_t Data;
+
+	Data = RegisterRead(VADDRFIFOMONBASE + 4 * (uint32_t)Channel);
+	if (Data & 0xF0000000)
+		__atomic_or_fetch(&FIFOMonitorPendingFlags[Channel], Data & 0xF0000000, __ATOMIC_RELAXED);
+	return Data & 0xFFFF;
+}
+
+
+//
+// uint32_t GetFIFOMonitorDepth(EDMAStreamSelect Channel)
+//
+// return the number of locations in a stream FIFO
+//
+uint32_t GetFIFOMonitorDepth(EDMAStreamSelect Channel)
+{
+	if (!GFIFOSizesInitialised)
+	{
+			InitialiseFIFOSizes();				// load FIFO size table, if not already done
+			GFIFOSizesInitialised = true;
+	}
+	return DMAFIFODepths[(int)Channel];
+}
+
+
 
 
 
@@ -100,7 +610,6 @@ uint32_t ReadFIFOMonitorChannel(EDMAStreamSelect Channel, bool* Overflowed, bool
 //
 void ResetDMAStreamFIFO(EDMAStreamSelect DDCNum)
 {
-	uint32_t Data;										// DDC register content
 	uint32_t DataBit;
 
 	switch (DDCNum)
@@ -122,13 +631,8 @@ void ResetDMAStreamFIFO(EDMAStreamSelect DDCNum)
 			break;
 	}
 
-	sem_wait(&DDCResetFIFOMutex);                       // get protected access
-	Data = RegisterRead(VADDRFIFORESET);				// read current content
-	Data = Data & ~DataBit;
-	RegisterWrite(VADDRFIFORESET, Data);				// set reset bit to zero
-	Data = Data | DataBit;
-	RegisterWrite(VADDRFIFORESET, Data);				// set reset bit to 1
-	sem_post(&DDCResetFIFOMutex);                       // release protected access
+	QueueRegisterUpdate(eFIFOResetQueuedReg, DataBit, 0, false);		// set reset bit to zero
+	QueueRegisterUpdate(eFIFOResetQueuedReg, 0, DataBit, false);		// set reset bit to 1
 }
 
 
@@ -169,6 +673,7 @@ const uint32_t DDCSampleCounts[] =
 // a pointer to an array [DDC count] of ints
 // the array of ints is populated with the number of samples to read for each DDC
 // returns the number of words per frame, which helps set the DMA transfer size
+// or VDDCHEADERINVALID if it can't be a rate word (then no count is written past the array)
 //
 uint32_t AnalyseDDCHeader(uint32_t Header, uint32_t* DDCCounts)
 {
@@ -187,8 +692,12 @@ uint32_t AnalyseDDCHeader(uint32_t Header, uint32_t* DDCCounts)
 		}
 		else									// interleaved
 		{
+			if (DDC == VNUMDDC - 1)
+				return VDDCHEADERINVALID;		// no next DDC to take the rate from
 			Header = Header >> 3;
 			Rate = Header & 7;					// next 3 bits
+			if (Rate == 7)
+				return VDDCHEADERINVALID;		// interleaved with an interleaved DDC
 			Count = 2*DDCSampleCounts[Rate];
 			DDCCounts[DDC] = Count;
 			Total += Count;
@@ -199,3 +708,67 @@ uint32_t AnalyseDDCHeader(uint32_t Header, uint32_t* DDCCounts)
 	}
 	return Total;
 }
+
+
+//
+// cache of DDC frame plans
+// initialised with an illegal rate word (a set top bit) so no entry matches until built
+//
+struct DDCFramePlan DDCFramePlans[VNUMFRAMEPLANS] =
+{
+	{ .RateWord = 0xFFFFFFFF }, { .RateWord = 0xFFFFFFFF },
+	{ .RateWord = 0xFFFFFFFF }, { .RateWord = 0xFFFFFFFF }
+};
+uint32_t FramePlanUseCount = 0;
+
+
+//
+// const struct DDCFramePlan* GetDDCFramePlan(uint32_t Header)
+// look up the plan for a rate word; if not found, build it in the least recently used entry
+//
+const struct DDCFramePlan* GetDDCFramePlan(uint32_t Header)
+{
+	uint32_t Entry;
+	uint32_t Oldest = 0;
+	uint32_t DDC;
+	uint32_t Offset = 0;
+	uint32_t FrameLength;
+	uint32_t DDCCounts[VNUMDDC];
+	struct DDCFramePlan* Plan;
+
+	FramePlanUseCount++;
+	for (Entry = 0; Entry < VNUMFRAMEPLANS; Entry++)
+	{
+		if ((DDCFramePlans[Entry].RateWord == Header) && (Header != 0xFFFFFFFF))     // not an unbuilt entry
+		{
+			DDCFramePlans[Entry].LastUsed = FramePlanUseCount;
+			return &DDCFramePlans[Entry];
+		}
+		if (DDCFramePlans[Entry].LastUsed < DDCFramePlans[Oldest].LastUsed)
+			Oldest = Entry;
+	}
+	//
+	// not found: build a new plan with the active DDCs in frame order
+	// a rate word that isn't valid gets no plan, and doesn't displace one
+	//
+	FrameLength = AnalyseDDCHeader(Header, DDCCounts);
+	if (FrameLength == VDDCHEADERINVALID)
+		return NULL;
+	Plan = &DDCFramePlans[Oldest];
+	Plan->RateWord = Header;
+	Plan->FrameLength = FrameLength;
+	Plan->ActiveDDCs = 0;
+	for (DDC = 0; DDC < VNUMDDC; DDC++)
+	{
+		if (DDCCounts[DDC] != 0)
+		{
+			Plan->DDC[Plan->ActiveDDCs] = DDC;
+			Plan->Offset[Plan->ActiveDDCs] = Offset;
+			Plan->Count[Plan->ActiveDDCs] = DDCCounts[DDC];
+			Plan->ActiveDDCs++;
+			Offset += 8 * DDCCounts[DDC];				// 8 bytes per sample word
+		}
+	}
+	Plan->LastUsed = FramePlanUseCount;
+	return Plan;
+}
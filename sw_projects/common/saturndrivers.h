@@ -22,16 +22,133 @@
 #include "../P2_app/InDUCIQ.h"
 
 
+//
+// void SetFIFOMonitorWatermarks(EDMAStreamSelect Channel, uint32_t High, uint32_t Low);
+//
+// set the watermarks used when a channel is next set up; 0 = automatic. In 64 bit locations.
+//   High:				"over threshold" is declared at or above this depth. For a read FIFO it is
+//						the data available interrupt level (automatic: set by the stream thread);
+//						for a write FIFO it is the overflow headroom warning (automatic: full)
+//   Low:				write FIFOs only: the FPGA interrupts at or below this depth, so a thread
+//						waiting in WaitFIFOMonitorSpace() wakes when there is space
+//						(automatic: exactly the space it waits for). Needs the FIFO_Monitor
+//						revision 3 firmware; ignored (0) until a bitfile with it is released
+//
+void SetFIFOMonitorWatermarks(EDMAStreamSelect Channel, uint32_t High, uint32_t Low);
+
+
+//
+// void GetFIFOMonitorWatermarks(EDMAStreamSelect Channel, uint32_t* High, uint32_t* Low);
+//
+// return the watermarks last written to a channel (Low is 0 if off, or not supported)
+//
+void GetFIFOMonitorWatermarks(EDMAStreamSelect Channel, uint32_t* High, uint32_t* Low);
+
+
 //
 // void SetupFIFOMonitorChannel(EDMAStreamSelect Channel, bool EnableInterrupt);
 //
 // Setup a single FIFO monitor channel.
 //   Channel:			IP channel number (enum)
 //   EnableInterrupt:	true if interrupt generation enabled for overflows
+// the high watermark is the FIFO depth, unless set by SetFIFOMonitorWatermarks()
 //
 void SetupFIFOMonitorChannel(EDMAStreamSelect Channel, bool EnableInterrupt);
 
 
+//
+// void SetupFIFOMonitorThreshold(EDMAStreamSelect Channel, uint32_t Threshold, bool EnableInterrupt);
+//
+// Setup a single FIFO monitor channel with a specified threshold.
+// used to generate a "data available" interrupt for a read FIFO
+//   Channel:			IP channel number (enum)
+//   Threshold:			number of 64 bit locations at which "over threshold" is declared
+//   EnableInterrupt:	true if interrupt generation enabled
+// a high watermark set by SetFIFOMonitorWatermarks() replaces Threshold
+//
+void SetupFIFOMonitorThreshold(EDMAStreamSelect Channel, uint32_t Threshold, bool EnableInterrupt);
+
+
+//
+// user interrupt dispatcher
+// one thread reads all the XDMA user interrupt events devices, and wakes every thread
+// waiting for the interrupt: so several subsystems can wait for the same interrupt.
+// each waiter has its own eventfd to poll; WaitFIFOMonitorEvent() and
+// WaitFIFOMonitorSpace() wait on it. The thread starts when the 1st waiter is opened.
+// sources 0-3 are the FIFO monitor channels (EDMAStreamSelect)
+//
+#define VNUMUSERIRQ 6							// user interrupt sources: /dev/xdma0_events_0 to 5
+#define VIRQWIDEBAND 4							// wideband data ready
+#define VIRQSTATUS 5							// status change: PTT, key or ADC overflow
+#define VMAXIRQWAITERS 4						// waiters for one source
+
+
+//
+// int OpenUserIRQWaiter(uint32_t Source);
+//
+// register a waiter for a user interrupt source
+// returns an eventfd to wait on, or -1 if the events device is not available
+//
+int OpenUserIRQWaiter(uint32_t Source);
+
+
+//
+// void CloseUserIRQWaiter(int EventFd);
+//
+// remove a waiter from OpenUserIRQWaiter() or OpenFIFOMonitorEvents(), and close its eventfd
+//
+void CloseUserIRQWaiter(int EventFd);
+
+
+//
+// void ReportUserIRQStats(void);
+//
+// print interrupts dispatched, waiter wakeups and dispatch to wakeup latency per source
+//
+void ReportUserIRQStats(void);
+
+
+//
+// int OpenFIFOMonitorEvents(EDMAStreamSelect Channel);
+//
+// open a user interrupt waiter for a FIFO monitor channel
+// returns a file descriptor, or -1 if not available; close with CloseUserIRQWaiter()
+//
+int OpenFIFOMonitorEvents(EDMAStreamSelect Channel);
+
+
+//
+// bool WaitFIFOMonitorEvent(int EventFd, int Timeout);
+//
+// wait for a user interrupt, or timeout.
+//   EventFd:			file descriptor from OpenFIFOMonitorEvents() or OpenUserIRQWaiter()
+//   Timeout:			timeout in ms
+// returns true if an interrupt occurred; false if timed out or error
+//
+bool WaitFIFOMonitorEvent(int EventFd, int Timeout);
+
+
+//
+// uint32_t WaitFIFOMonitorSpace(EDMAStreamSelect Channel, int EventFd, uint32_t MinFree, uint32_t DrainRate,
+//                               bool* Overflowed, bool* OverThreshold, bool* Underflowed, unsigned int* Current);
+//
+// wait until a write FIFO has at least MinFree free locations.
+// with an events device open (and the channel set up by SetupFIFOMonitorChannel(Channel, true))
+// and firmware V26 or later, the low watermark is set to leave MinFree free, so the FPGA
+// interrupts when the space is there. Otherwise (or if a low watermark has been set)
+// the wait is calculated from the shortfall and the rate the FPGA drains the FIFO, and an
+// underflow, overflow or low watermark interrupt ends the wait at once.
+//   Channel:			IP core channel number (enum); must be a write channel
+//   EventFd:			file descriptor from OpenFIFOMonitorEvents(), or -1 to use timed waits only
+//   MinFree:			number of free 64 bit locations needed
+//   DrainRate:			64 bit locations per second the FPGA reads from the FIFO
+//   other parameters as ReadFIFOMonitorChannel(); the flags are set if seen in any read while waiting
+// returns the number of free locations
+//
+uint32_t WaitFIFOMonitorSpace(EDMAStreamSelect Channel, int EventFd, uint32_t MinFree, uint32_t DrainRate,
+                              bool* Overflowed, bool* OverThreshold, bool* Underflowed, unsigned int* Current);
+
+
 
 //
 // uint32_t ReadFIFOMonitorChannel(EDMAStreamSelect Channel, bool* Overflowed, bool* OverThreshold, bool* Underflowed,  unsigned int* Current);
@@ -48,6 +165,26 @@ void SetupFIFOMonitorChannel(EDMAStreamSelect Channel, bool EnableInterrupt);
 uint32_t ReadFIFOMonitorChannel(EDMAStreamSelect Channel, bool* Overflowed, bool* OverThreshold, bool* Underflowed, unsigned int* Current);
 
 
+//
+// uint32_t SampleFIFOMonitorChannel(EDMAStreamSelect Channel)
+//
+// Read number of occupied locations in a FIFO, for monitoring.
+// the status flags are not lost: they are returned by the next ReadFIFOMonitorChannel() call,
+// so this can be called from another thread without hiding events from the stream thread.
+//   Channel:			IP core channel number (enum)
+//
+uint32_t SampleFIFOMonitorChannel(EDMAStreamSelect Channel);
+
+
+//
+// uint32_t GetFIFOMonitorDepth(EDMAStreamSelect Channel)
+//
+// return the depth of a stream FIFO, in 64 bit locations
+//   Channel:			IP core channel number (enum)
+//
+uint32_t GetFIFOMonitorDepth(EDMAStreamSelect Channel);
+
+
 //
 // reset a stream FIFO
 // clears the FIFOs directly read ori written by the FPGA
@@ -69,8 +206,42 @@ void SetTXAmplitudeEER(bool EEREnabled);
 // a pointer to an array [DDC count] of ints
 // the array of ints is populated with the number of samples to read for each DDC
 // returns the number of words per frame, which helps set the DMA transfer size
+// returns VDDCHEADERINVALID if the header can't be a rate word: interleave (rate code 7)
+// on the last DDC, or interleaved with a DDC that is itself interleaved. A sample word
+// taken for a header during a resync can be either; the counts are then not valid.
 //
+#define VDDCHEADERINVALID 0xFFFFFFFFU
+
 uint32_t AnalyseDDCHeader(uint32_t Header, uint32_t* DDCCounts);
 
 
+//
+// DDC frame plan: a precompiled description of the DDC frame for one rate word.
+// lists only the DDCs that have samples in the frame, so the decode loop skips disabled DDCs.
+// Offset is the byte offset of the DDC's first sample from the first word after the rate word.
+//
+#define VNUMFRAMEPLANS 4                    // frame plans cached (least recently used is replaced)
+
+struct DDCFramePlan
+{
+	uint32_t RateWord;						// rate word the plan was built for
+	uint32_t FrameLength;					// words per frame, not including the rate word
+	uint32_t ActiveDDCs;					// number of entries in the lists below
+	uint32_t DDC[VNUMDDC];					// DDC number
+	uint32_t Offset[VNUMDDC];				// byte offset of 1st sample
+	uint32_t Count[VNUMDDC];				// number of samples in frame
+	uint32_t LastUsed;						// for LRU replacement
+};
+
+
+//
+// const struct DDCFramePlan* GetDDCFramePlan(uint32_t Header)
+// returns the frame plan for a DDC rate word, building it with AnalyseDDCHeader() the
+// first time a rate word is seen. Plans are cached, so a client switching between a few
+// rate settings doesn't rebuild them. Not thread safe: call from the DDC thread only.
+// returns NULL if AnalyseDDCHeader() finds the rate word not valid: treat it as no header.
+//
+const struct DDCFramePlan* GetDDCFramePlan(uint32_t Header);
+
+
 #endif
@@ -20,43 +20,36 @@
 #include <stdlib.h>                     // for function min()
 #include <math.h>
 #include <unistd.h>
-#include <semaphore.h>
+#include <pthread.h>
+#include <sched.h>
 #include "version.h"
 #include <stdio.h>
-
-//
-// semaphores to protect registers that are accessed from several threads
-//
-sem_t DDCInSelMutex;
-sem_t RFGPIOMutex;
-
-
-//
-// ROMs for DAC Current Setting and 0.5dB step digital attenuator
-//
-unsigned int DACCurrentROM[256];                    // used for residual attenuation
-unsigned int DACStepAttenROM[256];                  // provides most atten setting
+#include <string.h>
+#include <time.h>
+#include "../common/tableformulas.h"
+#include "../common/precomputedtables.h"           // DAC atten ROMs and startup CW ramps, generated at build time
+#include "../common/regtrace.h"
+#include "../common/regmap.h"                   // TX config and keyer config register fields
 
 
 //
 // local copies of values written to registers
 //
-#define VMAXP1DDCS 7                                // max number of DDCs used for P1
 #define VSAMPLERATE 122880000                       // sample rate in Hz
 
 uint32_t DDCDeltaPhase[VNUMDDC];                    // DDC frequency settings
 uint32_t DUCDeltaPhase;                             // DUC frequency setting
 uint32_t TestSourceDeltaPhase;                      // test source DDS delta phase
 uint32_t GStatusRegister;                           // most recent status register setting
-uint32_t GPIORegValue;                              // value stored into GPIO
-uint32_t TXConfigRegValue;                          // value written into TX config register
-uint32_t DDCInSelReg;                               // value written into DDC config register
+struct TelemetrySnapshot GTelemetry;                // most recent telemetry snapshot
+uint32_t GTelemetrySequence;                        // odd while GTelemetry is being written
 uint32_t DDCRateReg;                                // value written into DDC rate register
 bool GADCOverride;                                  // true if ADCs are to be overridden & use test source instead
 bool GByteSwapEnabled;                              // true if byte swapping enabled for sample readout 
 bool GPTTEnabled;                                   // true if PTT is enabled
 bool MOXAsserted;                                   // true if MOX as asserted
 bool GPureSignalEnabled;                            // true if PureSignal is enabled
+EADCSelect GDDCInputs[VNUMDDC];                     // ADC for each DDC, as selected by the client
 ESampleRate P1SampleRate;                           // rate for all DDC
 uint32_t P2SampleRates[VNUMDDC];                    // numerical sample rates for each DDC
 uint32_t GDDCEnabled;                               // 1 bit per DDC
@@ -83,7 +76,6 @@ unsigned int GCWKeyerWeight;                        // Keyer Weight. Not yet use
 bool GCWKeyerSpacing;                               // Keyer spacing
 bool GCWIambicKeyerEnabled;                         // true if iambic keyer is enabled
 uint32_t GIambicConfigReg;                          // copy of iambic comfig register
-uint32_t GCWKeyerSetup;                             // keyer control register
 uint32_t GClassEPWMMin;                             // min class E PWM. NOT USED at present.
 uint32_t GClassEPWMMax;                             // max class E PWM. NOT USED at present.
 uint32_t GCodecConfigReg;                           // codec configuration
@@ -98,7 +90,7 @@ unsigned int GAlexEnabledBits;                      // P2. True if Alex1-8 enabl
 bool GPAEnabled;                                    // P2. True if PA enabled. NOT USED YET.
 unsigned int GTXDACCount;                           // P2. #TX DACs. NOT USED YET.
 ESampleRate GDUCSampleRate;                         // P2. TX sample rate. NOT USED YET.
-unsigned int GDUCSampleSize;                        // P2. DUC # sample bits. NOT USED YET
+unsigned int GDUCSampleSize = 24;                   // P2. DUC # sample bits: 16 or 24
 unsigned int GDUCPhaseShift;                        // P2. DUC phase shift. NOT USED YET.
 bool GSpeakerMuted;                                 // P2. True if speaker muted.
 bool GCWXMode;                                      // True if in computer generated CWX mode
@@ -117,13 +109,12 @@ bool GEEREnabled;                                   // P2. true if EER is enable
 ETXModulationSource GTXModulationSource;            // values added to register
 bool GTXProtocolP2;                                 // true if P2
 uint32_t TXModulationTestReg;                       // modulation test DDS
-bool GEnableTimeStamping;                           // true if timestamps to be added to data. NOT IMPLEMENTED YET
-bool GEnableVITA49;                                 // true if to enable VITA49 formatting. NOT SUPPORTED YET
+bool GEnableTimeStamping;                           // true if timestamps to be added to DDC data
+bool GEnableVITA49;                                 // true if to enable VITA49 formatting of DDC data
+uint8_t GDDCSampleSize[VNUMDDC];                    // P2. DDC sample bits asked for: 16, 24 or 32 (float)
 unsigned int GCWKeyerRampms = 0;                    // ramp length for keyer, in ms
 bool GCWKeyerRamp_IsP2 = false;                     // true if ramp initialised for protocol 2
 
-unsigned int DACCurrentROM[256];                    // used for residual attenuation
-unsigned int DACStepAttenROM[256];                  // provides most atten setting
 unsigned int GNumADCs;                              // count of ADCs available
 
 
@@ -144,26 +135,6 @@ unsigned int GCodecAnaloguePath;                    // value written in Codec an
 #define VDATAENDIAN 26                              // GPIO bit definition
 
 
-//
-// define Codec registers
-//
-#define VCODECLLINEVOLREG 0                         // left line input volume
-#define VCODECRLINEVOLREG 1                         // right line input volume
-#define VCODECLHEADPHONEVOLREG 2                    // left headphone volume
-#define VCODECRHEADPHONEVOLREG 3                    // right headphone volume
-#define VCODECANALOGUEPATHREG 4                     // analogue path control
-#define VCODECDIGITALPATHREG 5                      // digital path control
-#define VCODECPOWERDOWNREG 6                        // power down control
-#define VCODECDIGITALFORMATREG 7                    // digital audio interface format register
-#define VCODECSAMPLERATEREG 8                       // sample rate control
-#define VCODECACTIVATIONREG 9                       // digital interface activation register
-#define VCODECRESETREG 15                           // reset register
-
-
-
-
-
-
 //
 // DMA FIFO depths
 // this is the number of 64 bit FIFO locations
@@ -249,11 +220,7 @@ uint32_t DDCRegisters[VNUMDDC] =
 //
 // Keyer setup register defines
 //
-#define VCWKEYERENABLE 31                               // enable bit
-#define VCWKEYERDELAY 0                                 // delay bits 7:0
-#define VCWKEYERHANG 8                                  // hang time is 17:8
-#define VCWKEYERRAMP 18                                 // ramp time
-#define VRAMPSIZE 4096                                  // max ramp length in words
+// (keyer config register fields are in regmap.h)
 
 
 //
@@ -275,99 +242,427 @@ uint32_t DDCRegisters[VNUMDDC] =
 
 //
 // TX config register defines
+// (the other fields are in regmap.h; the mux reset is a pulse, so it is written directly)
 //
-
-#define VTXCONFIGDATASOURCEBIT 0
-#define VTXCONFIGSAMPLEGATINGBIT 2
-#define VTXCONFIGPROTOCOLBIT 3
-#define VTXCONFIGSCALEBIT 4
 #define VTXCONFIGMUXRESETBIT 29
-#define VTXCONFIGIQDEINTERLEAVEBIT 30
-#define VTXCONFIGIQSTREAMENABLED 31
 
 
 
 //
-// InitialiseFIFOSizes(void)
-// initialise the FIFO size table, which is FPGA version dependent
+// shadow register table
+// an entry is claimed for each register address the first time it is written.
+// one mutex protects the table, so a held value can't be written out after a newer one.
 //
-void InitialiseFIFOSizes(void)
+#define VNUMSHADOWREGS 32                               // registers that can be shadowed
+
+struct ShadowRegister
+{
+    uint32_t Address;                                   // register address
+    uint32_t Value;                                     // last value written (or held)
+    bool Valid;                                         // true if entry in use
+    bool Pending;                                       // true if value held, not yet written
+};
+struct ShadowRegister ShadowRegisters[VNUMSHADOWREGS];
+pthread_mutex_t ShadowRegisterMutex = PTHREAD_MUTEX_INITIALIZER;
+static __thread bool DeferRegisterWrites = false;      // true if this thread's writes are held
+uint64_t GRegisterWritesIssued = 0;                     // shadowed register bus writes made
+uint64_t GRegisterWritesSaved = 0;                      // shadowed register writes suppressed or merged
+uint64_t GDDCRetunes = 0;                               // grouped retunes of more than one DDC
+uint32_t GDDCRetuneLastNs = 0;                          // register write time of the last grouped retune
+uint32_t GDDCRetuneMaxNs = 0;                           // and the longest
+
+
+//
+// find the shadow entry for a register, claiming a free one if it has none
+// returns NULL if the table is full. Called with ShadowRegisterMutex held.
+//
+static struct ShadowRegister* FindShadowRegister(uint32_t Address, uint32_t Data)
 {
-	ESoftwareID ID;
-	unsigned int Version = 0;
-    Version = GetFirmwareVersion(&ID);
-    if((Version >= 10) && (Version <= 12))
+    uint32_t Entry;
+    struct ShadowRegister* Reg = NULL;
+
+    for (Entry = 0; Entry < VNUMSHADOWREGS; Entry++)
     {
-        printf("loading new FIFO sizes for updated firmware <= 12\n");
-        DMAFIFODepths[0] = 16384;       //  eRXDDCDMA,		selects RX
-        DMAFIFODepths[1] = 2048;        //  eTXDUCDMA,		selects TX
-        DMAFIFODepths[2] = 256;         //  eMicCodecDMA,	selects mic samples
-        DMAFIFODepths[3] = 1024;        //  eSpkCodecDMA	selects speaker samples
+        if (ShadowRegisters[Entry].Valid && (ShadowRegisters[Entry].Address == Address))
+        {
+            Reg = &ShadowRegisters[Entry];
+            break;
+        }
+        if (!ShadowRegisters[Entry].Valid)             // not found: claim the first free entry
+        {
+            Reg = &ShadowRegisters[Entry];
+            Reg->Address = Address;
+            Reg->Valid = true;
+            Reg->Pending = false;
+            Reg->Value = ~Data;                         // force the first write
+            break;
+        }
     }
-    else if(Version >= 13)
+    return Reg;
+}
+
+
+//
+// ShadowRegisterWrite(uint32_t Address, uint32_t Data)
+// write a register only if the value has changed; hold it if updates deferred
+//
+void ShadowRegisterWrite(uint32_t Address, uint32_t Data)
+{
+    struct ShadowRegister* Reg;
+    REGTRACE_SETCALLER(TraceCaller);                    // charge the write to the setter
+
+    pthread_mutex_lock(&ShadowRegisterMutex);
+    Reg = FindShadowRegister(Address, Data);
+    if (Reg == NULL)                                    // table full: just write it
     {
-        printf("loading new FIFO sizes for updated firmware V13+\n");
-        DMAFIFODepths[0] = 16384;       //  eRXDDCDMA,		selects RX
-        DMAFIFODepths[1] = 4096;        //  eTXDUCDMA,		selects TX
-        DMAFIFODepths[2] = 256;         //  eMicCodecDMA,	selects mic samples
-        DMAFIFODepths[3] = 1024;        //  eSpkCodecDMA	selects speaker samples
+        RegisterWrite(Address, Data);
+        GRegisterWritesIssued++;
+    }
+    else if (DeferRegisterWrites)
+    {
+        if (Reg->Pending || (Reg->Value == Data))
+            GRegisterWritesSaved++;                     // merged with a held write, or unchanged
+        if (Reg->Value != Data)
+            Reg->Pending = true;
+        Reg->Value = Data;
     }
+    else if ((Reg->Value != Data) || Reg->Pending)
+    {
+        Reg->Value = Data;
+        Reg->Pending = false;
+        RegisterWrite(Address, Data);
+        GRegisterWritesIssued++;
+    }
+    else
+        GRegisterWritesSaved++;
+    pthread_mutex_unlock(&ShadowRegisterMutex);
+    REGTRACE_CLEARCALLER(TraceCaller);
 }
 
 
+//
+// register queue
+// read-modify-write updates to registers shared between threads are posted to a
+// bounded lock-free queue (after D. Vyukov) as "clear bits, set bits" operations.
+// each slot has a turn count: 2*lap when free for that lap, 2*lap+1 when it holds an
+// operation. Whichever thread finds the queue writer free drains the queue, applying
+// operations in order to the register copies and writing them; a thread that finds it
+// busy leaves its operation for that thread, then waits until the writer has passed
+// its slot, so the register has been written when the call returns. No lock is held:
+// a caller waits only for operations posted before its own.
+//
+#define VREGQUEUESIZE 64                                // queued operations (power of 2)
+
+struct QueuedRegister
+{
+    uint32_t Address;                                   // register address
+    bool ReadFirst;                                     // true if copy initialised by reading the register
+    bool MergeWrites;                                   // true if several operations can make one write
+    bool Deferrable;                                    // true if held between Begin/FlushRegisterUpdates()
+    uint32_t Value;                                     // register copy
+    uint32_t Written;                                   // value last written
+    bool Loaded;                                        // true if Written is valid
+    bool Dirty;                                         // true if Value not yet written
+};
+
+// (must be in EQueuedRegister order)
+static struct QueuedRegister QueuedRegisters[VNUMQUEUEDREGS] =
+{
+    {VADDRRFGPIOREG, false, true, true, 0, 0, false, false},        // eGPIOQueuedReg
+    {VADDRDDCINSEL, false, true, false, 0, 0, false, false},        // eDDCInSelQueuedReg
+    {VADDRFIFORESET, true, false, false, 0, 0, false, false},       // eFIFOResetQueuedReg: each write is a reset edge
+    {VADDRCODECSPIREG, false, false, false, 0, 0, false, false}     // eCodecSPIQueuedReg: each write is a codec transfer
+};
+
+struct RegisterOp
+{
+    uint64_t Turn;                                      // 2*lap = free, 2*lap+1 = holds an operation
+    EQueuedRegister Reg;
+    uint32_t ClearBits;
+    uint32_t SetBits;
+    bool StoreOnly;
+};
+
+static struct RegisterOp RegisterQueue[VREGQUEUESIZE];
+static uint64_t RegisterQueueHead = 0;                  // next position to post to
+static uint64_t RegisterQueueTail = 0;                  // next position to drain (changed by queue writer only)
+static uint64_t RegisterQueueDone = 0;                  // operations before this position have been written
+static bool RegisterQueueBusy = false;                  // true while a thread is draining the queue
+uint64_t GQueuedRegisterOps = 0;                        // queued register operations applied
+uint64_t GQueuedRegisterWrites = 0;                     // queued register bus writes made
+
 
 //
-// initialise the DAC Atten ROMs
-// these set the step attenuator and DAC drive level
-// for "attenuation intent" values from 0 to 255
+// post an operation to the queue. Returns false if the queue is full.
+// Posted is set to the operation's queue position.
 //
-void InitialiseDACAttenROMs(void)
+static bool PostRegisterOp(EQueuedRegister Reg, uint32_t ClearBits, uint32_t SetBits, bool StoreOnly, uint64_t* Posted)
 {
-    unsigned int Level;                         // input demand value
-    double DesiredAtten;                        // desired attenuation in dB
-    unsigned int StepValue;                     // integer step atten drive value
-    double ResidualAtten;                       // atten to go in the current setting DAC
-    unsigned int DACDrive;                      // int value to go to DAC ROM
+    uint64_t Pos, Lap, Turn;
+    struct RegisterOp* Op;
+
+    Pos = __atomic_load_n(&RegisterQueueHead, __ATOMIC_RELAXED);
+    while (true)
+    {
+        Op = &RegisterQueue[Pos % VREGQUEUESIZE];
+        Lap = Pos / VREGQUEUESIZE;
+        Turn = __atomic_load_n(&Op->Turn, __ATOMIC_ACQUIRE);
+        if (Turn == 2 * Lap)                            // slot free: try to claim it
+        {
+            if (__atomic_compare_exchange_n(&RegisterQueueHead, &Pos, Pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;                                  // claimed (if not, Pos has been reloaded)
+        }
+        else if (Turn < 2 * Lap)                        // slot still holds last lap's operation
+            return false;
+        else                                            // another thread took this slot
+            Pos = __atomic_load_n(&RegisterQueueHead, __ATOMIC_RELAXED);
+    }
+    Op->Reg = Reg;
+    Op->ClearBits = ClearBits;
+    Op->SetBits = SetBits;
+    Op->StoreOnly = StoreOnly;
+    __atomic_store_n(&Op->Turn, 2 * Lap + 1, __ATOMIC_SEQ_CST);
+    *Posted = Pos;
+    return true;
+}
+
 
 //
-// do the max atten values separately; then calculate point by point
+// true if the next slot to drain holds an operation
 //
-    DACCurrentROM[0] = 0;                       // min level
-    DACStepAttenROM[0] = 63;                    // max atten
+static bool RegisterQueueHasWork(void)
+{
+    uint64_t Tail;
+
+    Tail = __atomic_load_n(&RegisterQueueTail, __ATOMIC_SEQ_CST);
+    return __atomic_load_n(&RegisterQueue[Tail % VREGQUEUESIZE].Turn, __ATOMIC_SEQ_CST)
+           == 2 * (Tail / VREGQUEUESIZE) + 1;
+}
+
 
-    for (Level = 1; Level < 256; Level++)
+//
+// write a register copy out, unless it is unchanged and writes can be merged
+// called by the queue writer only
+//
+static void WriteQueuedRegister(struct QueuedRegister* Reg)
+{
+    if (!Reg->MergeWrites || !Reg->Loaded || (Reg->Written != Reg->Value))
     {
-        DesiredAtten = 20.0*log10(255.0/(double)Level);     // this is the atten value we want after the high speed DAC
-        StepValue = (int)(2.0*DesiredAtten);                // 6 bit step atten should be set to
-        if(StepValue > 63)                                  // clip to 6 bits
-            StepValue = 63;
-        ResidualAtten = DesiredAtten - ((double)StepValue * 0.5);        // this needs to be achieved through the current setting drive
-        DACDrive = (unsigned int)(255.0/pow(10.0,(ResidualAtten/20.0)));
-        DACCurrentROM[Level] = DACDrive;
-        DACStepAttenROM[Level] = StepValue;
+        RegisterWrite(Reg->Address, Reg->Value);
+        Reg->Written = Reg->Value;
+        Reg->Loaded = true;
+        GQueuedRegisterWrites++;
     }
+    Reg->Dirty = false;
 }
 
 
+//
+// DrainRegisterQueue(void)
+// if no other thread is draining the queue, apply and write all queued operations.
+// the flag is checked again after release, in case an operation was posted
+// while this thread was finishing.
+//
+static void DrainRegisterQueue(void)
+{
+    struct RegisterOp* Op;
+    struct QueuedRegister* Reg;
+    uint64_t Lap;
+    uint32_t Cntr;
+
+    do
+    {
+        if (__atomic_exchange_n(&RegisterQueueBusy, true, __ATOMIC_SEQ_CST))
+            return;                                     // another thread will write our operation
+        while (true)
+        {
+            Op = &RegisterQueue[RegisterQueueTail % VREGQUEUESIZE];
+            Lap = RegisterQueueTail / VREGQUEUESIZE;
+            if (__atomic_load_n(&Op->Turn, __ATOMIC_ACQUIRE) != 2 * Lap + 1)
+                break;                                  // queue empty
+            Reg = &QueuedRegisters[Op->Reg];
+            if (Reg->ReadFirst && !Reg->Loaded)
+            {
+                Reg->Value = RegisterRead(Reg->Address);
+                Reg->Written = Reg->Value;
+                Reg->Loaded = true;
+            }
+            Reg->Value = (Reg->Value & ~Op->ClearBits) | Op->SetBits;
+            if (!Op->StoreOnly)
+                Reg->Dirty = true;
+            __atomic_store_n(&Op->Turn, 2 * Lap + 2, __ATOMIC_RELEASE);     // free the slot
+            __atomic_store_n(&RegisterQueueTail, RegisterQueueTail + 1, __ATOMIC_RELEASE);
+            GQueuedRegisterOps++;
+            if (Reg->Dirty && !Reg->MergeWrites)
+                WriteQueuedRegister(Reg);               // write now, in order
+        }
+        for (Cntr = 0; Cntr < VNUMQUEUEDREGS; Cntr++)
+            if (QueuedRegisters[Cntr].Dirty)
+                WriteQueuedRegister(&QueuedRegisters[Cntr]);
+        __atomic_store_n(&RegisterQueueDone, RegisterQueueTail, __ATOMIC_RELEASE);
+        __atomic_store_n(&RegisterQueueBusy, false, __ATOMIC_SEQ_CST);
+    } while (RegisterQueueHasWork());
+}
+
+
+//
+// WaitForRegisterOp(uint64_t Pos)
+// drain the queue, or wait for the thread draining it, until the operation
+// at position Pos has been written.
+//
+static void WaitForRegisterOp(uint64_t Pos)
+{
+    while (true)
+    {
+        DrainRegisterQueue();
+        if (__atomic_load_n(&RegisterQueueDone, __ATOMIC_ACQUIRE) > Pos)
+            break;
+        sched_yield();                                  // another thread is writing it
+    }
+}
+
+
+//
+// QueueRegisterUpdate(EQueuedRegister Reg, uint32_t ClearBits, uint32_t SetBits, bool StoreOnly)
+// read-modify-write of a shared register through the register queue
+//
+void QueueRegisterUpdate(EQueuedRegister Reg, uint32_t ClearBits, uint32_t SetBits, bool StoreOnly)
+{
+    uint64_t Pos;
+    REGTRACE_SETCALLER(TraceCaller);                    // charge the writes to the setter
+
+    while (!PostRegisterOp(Reg, ClearBits, SetBits, StoreOnly, &Pos))
+    {
+        DrainRegisterQueue();                           // queue full: help empty it
+        sched_yield();
+    }
+    if (!DeferRegisterWrites || !QueuedRegisters[Reg].Deferrable)
+        WaitForRegisterOp(Pos);
+    REGTRACE_CLEARCALLER(TraceCaller);
+}
+
+
+//
+// QueueRegisterWrites(EQueuedRegister Reg, const uint32_t* Values, uint32_t Count)
+// write a sequence of whole values to a queued register, draining the queue once
+//
+void QueueRegisterWrites(EQueuedRegister Reg, const uint32_t* Values, uint32_t Count)
+{
+    uint32_t Cntr;
+    uint64_t Pos;
+
+    if (Count == 0)
+        return;
+    REGTRACE_SETCALLER(TraceCaller);                    // charge the writes to the setter
+    for (Cntr = 0; Cntr < Count; Cntr++)
+    {
+        while (!PostRegisterOp(Reg, 0xFFFFFFFF, Values[Cntr], false, &Pos))
+        {
+            DrainRegisterQueue();                       // queue full: help empty it
+            sched_yield();
+        }
+    }
+    if (!DeferRegisterWrites || !QueuedRegisters[Reg].Deferrable)
+        WaitForRegisterOp(Pos);                         // the last value, so all of them
+    REGTRACE_CLEARCALLER(TraceCaller);
+}
+
+
+//
+// BeginRegisterUpdates(void)
+// hold this thread's shadowed register writes until flushed
+//
+void BeginRegisterUpdates(void)
+{
+    DeferRegisterWrites = true;
+}
+
+
+//
+// FlushRegisterUpdates(void)
+// write out any held register values
+//
+void FlushRegisterUpdates(void)
+{
+    uint32_t Entry;
+    REGTRACE_SETCALLER(TraceCaller);                    // charge the held writes to the flush
+
+    FlushMappedRegisters();                             // (held in the shadow table if deferred)
+    DrainRegisterQueue();
+    pthread_mutex_lock(&ShadowRegisterMutex);
+    for (Entry = 0; Entry < VNUMSHADOWREGS; Entry++)
+    {
+        if (ShadowRegisters[Entry].Valid && ShadowRegisters[Entry].Pending)
+        {
+            ShadowRegisters[Entry].Pending = false;
+            RegisterWrite(ShadowRegisters[Entry].Address, ShadowRegisters[Entry].Value);
+            GRegisterWritesIssued++;
+        }
+    }
+    pthread_mutex_unlock(&ShadowRegisterMutex);    REGTRACE_CLEARCALLER(TraceCaller);
+}
+
+
+//
+// EndRegisterUpdates(void)
+// write out any held register values, and stop holding writes
+//
+void EndRegisterUpdates(void)
+{
+    FlushRegisterUpdates();
+    DeferRegisterWrites = false;
+}
+
+
+//
+// ReportRegisterWriteStats(void)
+// print the shadowed register writes made and saved
+//
+void ReportRegisterWriteStats(void)
+{
+    printf("shadowed register writes: %llu made, %llu saved\n",
+           (unsigned long long)GRegisterWritesIssued, (unsigned long long)GRegisterWritesSaved);
+    printf("queued register updates: %llu applied, %llu writes made\n",
+           (unsigned long long)GQueuedRegisterOps, (unsigned long long)GQueuedRegisterWrites);
+    if (GDDCRetunes != 0)
+        printf("grouped DDC retunes: %llu, last took %uns, longest %uns\n",
+               (unsigned long long)GDDCRetunes, GDDCRetuneLastNs, GDDCRetuneMaxNs);
+}
+
+
+//
+// InitialiseFIFOSizes(void)
+// initialise the FIFO size table, which is FPGA version dependent
+//
+void InitialiseFIFOSizes(void)
+{
+    const struct FPGACapabilities* Caps = GetFPGACapabilities();
+    unsigned int Cntr;
+
+    if((Caps->Version >= 10) && (Caps->Version <= 12))
+        printf("loading new FIFO sizes for updated firmware <= 12\n");
+    else if(Caps->Version >= 13)
+        printf("loading new FIFO sizes for updated firmware V13+\n");
+    for(Cntr = 0; Cntr < VNUMCAPFIFO; Cntr++)
+        DMAFIFODepths[Cntr] = Caps->FIFODepths[Cntr];     // sizes from the capability descriptor
+}
+
+
+
 //
 // SetByteSwapping(bool)
 // set whether byte swapping is enabled. True if yes, to get data in network byte order.
 //
 void SetByteSwapping(bool IsSwapped)
 {
-    uint32_t Register;
+    uint32_t Register = 0;
 
-    sem_wait(&RFGPIOMutex);                         // get protected access
-    Register = GPIORegValue;                        // get current settings
     GByteSwapEnabled = IsSwapped;
     if(IsSwapped)
         Register |= (1<<VDATAENDIAN);               // set bit for swapped to network order
-    else
-        Register &= ~(1<<VDATAENDIAN);              // clear bit for raspberry pi local order
-
-    GPIORegValue = Register;                        // store it back
-    RegisterWrite(VADDRRFGPIOREG, Register);        // and write to it
-    sem_post(&RFGPIOMutex);                         // clear protection
+                                                    // (else clear bit for raspberry pi local order)
+    QueueRegisterUpdate(eGPIOQueuedReg, (1<<VDATAENDIAN), Register, false);
 }
 
 
@@ -377,22 +672,26 @@ void SetByteSwapping(bool IsSwapped)
 //
 void ActivateCWKeyer(bool Keyer)
 {
-    uint32_t Register;
-    Register = GCWKeyerSetup;                           // get current settings
-    if(Keyer)
-        Register |= (1<<VCWKEYERENABLE);
-    else
-        Register &= ~(1<<VCWKEYERENABLE);
-    if(Register != GCWKeyerSetup)                       // write back if different
-    {
-        GCWKeyerSetup = Register;                       // store it back
-        RegisterWrite(VADDRKEYERCONFIGREG, Register);   // and write to it
-    }
-
+    RegWrite_KeyerConfig_Enable(Keyer);                 // written if changed
 }
 
 
 
+//
+// TX/RX turnaround
+// the RX attenuation on TX and the Alex TX and RX words are in separate FPGA registers,
+// which the FPGA selects from the MOX bit. So a turnaround only writes the MOX bit and
+// the keyer enable. Both values come from the software register copies, and are written
+// in a defined order as one unheld burst, timed from start to the last write:
+//   RX to TX: MOX bit, then keyer enable (so the keyer can't key before MOX)
+//   TX to RX: keyer disable, then MOX bit (so the keyer stops before the T/R switch)
+//
+uint64_t GTurnaroundCount[2] = {0, 0};                  // turnarounds [0] = TX to RX, [1] = RX to TX
+uint32_t GTurnaroundLastNs[2] = {0, 0};                 // time of the last one
+uint32_t GTurnaroundMaxNs[2] = {0, 0};                  // and the longest
+static uint64_t TurnaroundTotalNs[2] = {0, 0};          // for the average
+
+
 //
 // SetMOX(bool Mox)
 // sets or clears TX state
@@ -401,26 +700,63 @@ void ActivateCWKeyer(bool Keyer)
 //
 void SetMOX(bool Mox)
 {
-    uint32_t Register;
+    struct timespec Start, End;
+    uint32_t Register = 0;
+    uint32_t Elapsed;
+    bool WasMox;
+    bool Deferred;
+    bool Keyer;
 
-    sem_wait(&RFGPIOMutex);                         // get protected access
-    Register = GPIORegValue;                        // get current settings
+    clock_gettime(CLOCK_MONOTONIC, &Start);
+    WasMox = MOXAsserted;
     MOXAsserted = Mox;                              // set variable
     if (Mox)
+    {
         Register |= (1 << VMOXBIT);
+        Keyer = GCWEnabled;                         // keyer enabled if CW
+    }
     else
-        Register &= ~(1 << VMOXBIT);
-    GPIORegValue = Register;                        // store it back
-    RegisterWrite(VADDRRFGPIOREG, Register);        // and write to it
-//
-// now set CW keyer if required
-//
+        Keyer = GCWEnabled && GBreakinEnabled;      // disable keyer unless CW & breakin
+    Deferred = DeferRegisterWrites;                 // the turnaround is never held
+    DeferRegisterWrites = false;
     if (Mox)
-        ActivateCWKeyer(GCWEnabled);
-    else            // disable keyer unless CW & breakin
-        ActivateCWKeyer(GCWEnabled && GBreakinEnabled);
+    {
+        QueueRegisterUpdate(eGPIOQueuedReg, (1 << VMOXBIT), Register, false);
+        ActivateCWKeyer(Keyer);
+    }
+    else
+    {
+        ActivateCWKeyer(Keyer);
+        QueueRegisterUpdate(eGPIOQueuedReg, (1 << VMOXBIT), Register, false);
+    }
+    DeferRegisterWrites = Deferred;
+    if (Mox != WasMox)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &End);
+        Elapsed = (uint32_t)((End.tv_sec - Start.tv_sec) * 1000000000L + (End.tv_nsec - Start.tv_nsec));
+        GTurnaroundCount[Mox]++;
+        GTurnaroundLastNs[Mox] = Elapsed;
+        TurnaroundTotalNs[Mox] += Elapsed;
+        if (Elapsed > GTurnaroundMaxNs[Mox])
+            GTurnaroundMaxNs[Mox] = Elapsed;
+    }
+}
+
 
-    sem_post(&RFGPIOMutex);                         // clear protected access
+//
+// ReportTurnaroundTimes(void)
+// print the measured RX to TX and TX to RX register switch times
+//
+void ReportTurnaroundTimes(void)
+{
+    if (GTurnaroundCount[1] != 0)
+        printf("RX to TX turnarounds: %llu, last took %uns, average %lluns, longest %uns\n",
+               (unsigned long long)GTurnaroundCount[1], GTurnaroundLastNs[1],
+               (unsigned long long)(TurnaroundTotalNs[1] / GTurnaroundCount[1]), GTurnaroundMaxNs[1]);
+    if (GTurnaroundCount[0] != 0)
+        printf("TX to RX turnarounds: %llu, last took %uns, average %lluns, longest %uns\n",
+               (unsigned long long)GTurnaroundCount[0], GTurnaroundLastNs[0],
+               (unsigned long long)(TurnaroundTotalNs[0] / GTurnaroundCount[0]), GTurnaroundMaxNs[0]);
 }
 
 
@@ -431,17 +767,11 @@ void SetMOX(bool Mox)
 //
 void SetTXEnable(bool Enabled)
 {
-    uint32_t Register;
+    uint32_t Register = 0;
 
-    sem_wait(&RFGPIOMutex);                         // get protected access
-    Register = GPIORegValue;                        // get current settings
     if (Enabled)
         Register |= (1 << VTXENABLEBIT);
-    else
-        Register &= ~(1 << VTXENABLEBIT);
-    GPIORegValue = Register;                        // store it back
-    RegisterWrite(VADDRRFGPIOREG, Register);        // and write to it
-    sem_post(&RFGPIOMutex);                         // clear protected access
+    QueueRegisterUpdate(eGPIOQueuedReg, (1 << VTXENABLEBIT), Register, false);
 }
 
 
@@ -452,17 +782,11 @@ void SetTXEnable(bool Enabled)
 //
 void SetATUTune(bool TuneEnabled)
 {
-    uint32_t Register;
+    uint32_t Register = 0;
 
-    sem_wait(&RFGPIOMutex);                         // get protected access
-    Register = GPIORegValue;                        // get current settings
     if (TuneEnabled)
         Register |= (1 << VATUTUNEBIT);
-    else
-        Register &= ~(1 << VATUTUNEBIT);
-    GPIORegValue = Register;                        // store it back
-    RegisterWrite(VADDRRFGPIOREG, Register);        // and write to it
-    sem_post(&RFGPIOMutex);                         // clear protected access
+    QueueRegisterUpdate(eGPIOQueuedReg, (1 << VATUTUNEBIT), Register, false);
 }
 
 
@@ -470,9 +794,10 @@ void SetATUTune(bool TuneEnabled)
 // SetP1SampleRate(ESampleRate Rate, unsigned int Count)
 // sets the sample rate for all DDC used in protocol 1. 
 // allowed rates are 48KHz to 384KHz.
-// also sets the number of enabled DDCs, 1-8. Count = #DDC reqd
+// also sets the number of enabled DDCs, 1-VMAXP1DDCS. Count = #DDC reqd
 // DDCs are enabled by setting a rate; if rate bits=000, DDC is not enabled
 // and for P1, no DDCs are interleaved
+// the register is written to hardware if it has changed
 //
 void SetP1SampleRate(ESampleRate Rate, unsigned int DDCCount)
 {
@@ -482,11 +807,14 @@ void SetP1SampleRate(ESampleRate Rate, unsigned int DDCCount)
 
     if (DDCCount > VMAXP1DDCS)                             // limit the number of DDC to max allowed
         DDCCount = VMAXP1DDCS;
+    if (DDCCount == 0)
+        DDCCount = 1;
     RateBits = (uint32_t)Rate;                          // bits to go in DDC word
     P1SampleRate = Rate;                                // rate for all DDC
+    GDDCEnabled = (1 << DDCCount) - 1;
 //
     // set all DDC up to max to rate; rest to 0
-    for (Cntr = 0; Cntr < (DDCCount + 1); Cntr++)
+    for (Cntr = 0; Cntr < DDCCount; Cntr++)
     {
         RegisterValue |= RateBits;                      // add in rate bits for this DDC
         RateBits = RateBits << 3;                       // get ready for next DDC
@@ -494,7 +822,7 @@ void SetP1SampleRate(ESampleRate Rate, unsigned int DDCCount)
     if (RegisterValue != DDCRateReg)                     // write back if changed
     {
         DDCRateReg = RegisterValue;                     // write back
-//        RegisterWrite(VADDRDDCRATES, RegisterValue);        // and write to h/w register
+        RegisterWrite(VADDRDDCRATES, RegisterValue);    // and write to h/w register
     }
 }
 
@@ -571,6 +899,16 @@ bool WriteP2DDCRateRegister(void)
 }
 
 
+//
+// uint32_t GetP2DDCRateWord(void)
+// get the DDC rate register value, for the DDC stream thread to write
+//
+uint32_t GetP2DDCRateWord(void)
+{
+    return DDCRateReg;
+}
+
+
 
 //
 // uint32_t GetDDCEnables(void)
@@ -604,14 +942,9 @@ void SetOpenCollectorOutputs(unsigned int bits)
     uint32_t Register;                              // FPGA register content
     uint32_t BitMask;                               // bitmask for 7 OC bits
 
-    sem_wait(&RFGPIOMutex);                         // get protected access
-    Register = GPIORegValue;                        // get current settings
     BitMask = (0b1111111) << VOPENCOLLECTORBITS;
-    Register = Register & ~BitMask;                 // strip old bits, add new
-    Register |= (bits << VOPENCOLLECTORBITS);       // OC bits are in bits (6:0)
-    GPIORegValue = Register;                        // store it back
-    RegisterWrite(VADDRRFGPIOREG, Register);        // and write to it
-    sem_post(&RFGPIOMutex);                         // clear protected access
+    Register = (bits << VOPENCOLLECTORBITS) & BitMask;  // OC bits are in bits (6:0)
+    QueueRegisterUpdate(eGPIOQueuedReg, BitMask, Register, false);   // strip old bits, add new
 }
 
 
@@ -643,12 +976,7 @@ void SetADCOptions(EADCSelect ADC, bool PGA, bool Dither, bool Random)
         PGABit += 3;
         DitherBit += 3;
     }
-    sem_wait(&RFGPIOMutex);                         // get protected access
-    Register = GPIORegValue;                        // get current settings
-    Register &= ~(1 << RandBit);                    // strip old bits
-    Register &= ~(1 << PGABit);
-    Register &= ~(1 << DitherBit);
-
+    Register = 0;
     if(PGA)                                         // add new bits where set
         Register |= (1 << PGABit);
     if(Dither)
@@ -656,9 +984,7 @@ void SetADCOptions(EADCSelect ADC, bool PGA, bool Dither, bool Random)
     if(Random)
         Register |= (1 << RandBit);
 
-    GPIORegValue = Register;                    // store it back
-    RegisterWrite(VADDRRFGPIOREG, Register);  // and write to it
-    sem_post(&RFGPIOMutex);                         // clear protected access
+    QueueRegisterUpdate(eGPIOQueuedReg, (1 << RandBit) | (1 << PGABit) | (1 << DitherBit), Register, false);
 }
 
 #define VTWOEXP32 4294967296.0              // 2^32
@@ -692,11 +1018,104 @@ void SetDDCFrequency(uint32_t DDC, uint32_t Value, bool IsDeltaPhase)
     {
         DDCDeltaPhase[DDC] = DeltaPhase;        // store this delta phase
         RegAddress =DDCRegisters[DDC];          // get DDC reg address, 
-        RegisterWrite(RegAddress, DeltaPhase);  // and write to it
+        ShadowRegisterWrite(RegAddress, DeltaPhase);  // and write to it
     }
 }
 
 
+//
+// SetDDCFrequencies(const uint32_t* Values, uint32_t Mask, bool IsDeltaPhase)
+// sets the frequencies of several DDCs together, eg for a coordinated retune
+// the changed registers are written with one block write per run of consecutive
+// register addresses (DDC0-7, DDC8-9) spanning the changed DDCs, instead of a
+// separate write per DDC; unchanged DDCs inside a run are rewritten with their
+// current value. The writes aren't held by BeginRegisterUpdates().
+// returns the time taken for the register writes, in ns (0 if nothing changed)
+//
+uint32_t SetDDCFrequencies(const uint32_t* Values, uint32_t Mask, bool IsDeltaPhase)
+{
+    uint32_t DDC, First, Last, Next, Cntr;
+    uint32_t Changed = 0;                       // DDCs whose delta phase has changed
+    uint32_t DeltaPhase;
+    uint32_t Elapsed;
+    struct timespec Start, End;
+    struct ShadowRegister* Reg;
+
+    for (DDC = 0; DDC < VNUMDDC; DDC++)
+    {
+        if ((Mask & (1U << DDC)) == 0)
+            continue;
+        if (!IsDeltaPhase)
+            DeltaPhase = (uint32_t)(VTWOEXP32 * (double)Values[DDC] / (double) VSAMPLERATE);
+        else
+            DeltaPhase = Values[DDC];
+        if (DDCDeltaPhase[DDC] != DeltaPhase)
+        {
+            DDCDeltaPhase[DDC] = DeltaPhase;
+            Changed |= (1U << DDC);
+        }
+    }
+    if (Changed == 0)
+        return 0;
+
+    pthread_mutex_lock(&ShadowRegisterMutex);
+    clock_gettime(CLOCK_MONOTONIC, &Start);
+    DDC = 0;
+    while (DDC < VNUMDDC)
+    {
+        if ((Changed & (1U << DDC)) == 0)
+        {
+            DDC++;
+            continue;
+        }
+        First = DDC;                            // find the last changed DDC in this run of registers
+        Last = DDC;
+        for (Next = DDC + 1; (Next < VNUMDDC) && (DDCRegisters[Next] == DDCRegisters[Next - 1] + 4); Next++)
+            if (Changed & (1U << Next))
+                Last = Next;
+        RegisterWriteBlock(DDCRegisters[First], DDCDeltaPhase + First, Last - First + 1);
+        GRegisterWritesIssued++;
+        DDC = Last + 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &End);
+    for (Cntr = 0; Cntr < VNUMDDC; Cntr++)      // shadow copies now match the registers
+    {
+        if ((Changed & (1U << Cntr)) == 0)
+            continue;
+        Reg = FindShadowRegister(DDCRegisters[Cntr], DDCDeltaPhase[Cntr]);
+        if (Reg != NULL)
+        {
+            Reg->Value = DDCDeltaPhase[Cntr];
+            Reg->Pending = false;
+        }
+    }
+    pthread_mutex_unlock(&ShadowRegisterMutex);
+
+    Elapsed = (uint32_t)((End.tv_sec - Start.tv_sec) * 1000000000L + (End.tv_nsec - Start.tv_nsec));
+    if ((Changed & (Changed - 1)) != 0)         // more than one DDC: a grouped retune
+    {
+        GDDCRetunes++;
+        GDDCRetuneLastNs = Elapsed;
+        if (Elapsed > GDDCRetuneMaxNs)
+            GDDCRetuneMaxNs = Elapsed;
+    }
+    return Elapsed;
+}
+
+
+//
+// uint32_t GetDDCFrequency(uint32_t DDC)
+// get a DDC frequency in Hz, from the delta phase last set
+// F = Fs * Delta/2^32
+//
+uint32_t GetDDCFrequency(uint32_t DDC)
+{
+    if(DDC >= VNUMDDC)
+        DDC = VNUMDDC-1;
+    return (uint32_t)(((uint64_t)DDCDeltaPhase[DDC] * VSAMPLERATE) >> 32);
+}
+
+
 //
 // SetTestDDSFrequency(uint32_t Value, bool IsDeltaPhase)
 // sets a test source frequency.
@@ -721,7 +1140,7 @@ void SetTestDDSFrequency(uint32_t Value, bool IsDeltaPhase)
     if(TestSourceDeltaPhase != DeltaPhase)    // write back if changed
     {
         TestSourceDeltaPhase = DeltaPhase;        // store this delta phase
-        RegisterWrite(VADDRRXTESTDDSREG, DeltaPhase);  // and write to it
+        ShadowRegisterWrite(VADDRRXTESTDDSREG, DeltaPhase);  // and write to it
     }
 }
 
@@ -746,7 +1165,7 @@ void SetDUCFrequency(unsigned int Value, bool IsDeltaPhase)		// only accepts DUC
         DeltaPhase = (uint32_t)Value;
 
     DUCDeltaPhase = DeltaPhase;             // store this delta phase
-    RegisterWrite(VADDRTXDUCREG, DeltaPhase);  // and write to it
+    ShadowRegisterWrite(VADDRTXDUCREG, DeltaPhase);  // and write to it
 }
 
 
@@ -1139,7 +1558,7 @@ void SetTXDriveLevel(unsigned int Level)
     RegisterValue |= (AttenDrive << 16);            // set step atten when RX
     RegisterValue |= (AttenDrive << 24);            // set step atten when TX
     GTXDACCtrl = RegisterValue;
-    RegisterWrite(VADDRDACCTRLREG, RegisterValue);  // and write to it
+    ShadowRegisterWrite(VADDRDACCTRLREG, RegisterValue);  // and write to it
 }
 
 
@@ -1198,13 +1617,7 @@ void SetOrionMicOptions(bool MicRing, bool EnableBias, bool EnablePTT)
 {
     uint32_t Register;                              // FPGA register content
 
-    sem_wait(&RFGPIOMutex);                         // get protected access
-    Register = GPIORegValue;                        // get current settings
-    Register &= ~(1 << VMICBIASENABLEBIT);          // strip old bits
-    Register &= ~(1 << VMICPTTSELECTBIT);           // strip old bits
-    Register &= ~(1 << VMICSIGNALSELECTBIT);
-    Register &= ~(1 << VMICBIASSELECTBIT);
-
+    Register = 0;
     if(!MicRing)                                      // add new bits where set
     {
         Register &= ~(1 << VMICSIGNALSELECTBIT);    // mic on tip
@@ -1221,9 +1634,8 @@ void SetOrionMicOptions(bool MicRing, bool EnableBias, bool EnablePTT)
         Register |= (1 << VMICBIASENABLEBIT);
     GPTTEnabled = !EnablePTT;                       // used when PTT read back - just store opposite state
 
-    GPIORegValue = Register;                        // store it back
-    RegisterWrite(VADDRRFGPIOREG, Register);      // and write to it
-    sem_post(&RFGPIOMutex);                         // clear protected access
+    QueueRegisterUpdate(eGPIOQueuedReg, (1 << VMICBIASENABLEBIT) | (1 << VMICPTTSELECTBIT)
+                        | (1 << VMICSIGNALSELECTBIT) | (1 << VMICBIASSELECTBIT), Register, false);
 }
 
 
@@ -1236,15 +1648,10 @@ void SetBalancedMicInput(bool Balanced)
 {
     uint32_t Register;                              // FPGA register content
 
-    sem_wait(&RFGPIOMutex);                         // get protected access
-    Register = GPIORegValue;                        // get current settings
-    Register &= ~(1 << VBALANCEDMICSELECT);         // strip old bit
+    Register = 0;
     if(Balanced)
         Register |= (1 << VBALANCEDMICSELECT);      // set new bit
-    
-    GPIORegValue = Register;                        // store it back
-    RegisterWrite(VADDRRFGPIOREG, Register);      // and write to it
-    sem_post(&RFGPIOMutex);                         // clear protected access
+    QueueRegisterUpdate(eGPIOQueuedReg, (1 << VBALANCEDMICSELECT), Register, false);
 }
 
 
@@ -1325,7 +1732,7 @@ void SetADCAttenuator(EADCSelect ADC, unsigned int Atten, bool RXAtten, bool TXA
         }
     }
         GRXADCCtrl = Register; 
-        RegisterWrite(VADDRADCCTRLREG, Register);      // and write to it
+        ShadowRegisterWrite(VADDRADCCTRLREG, Register);      // and write to it
 }
 
 
@@ -1403,6 +1810,16 @@ void SetCWXBits(bool CWXEnabled, bool CWXDash, bool CWXDot)
 
 
 
+//
+// GetDDCADC(int DDC)
+// gets the ADC the client selected for a DDC (before any test source override)
+//
+EADCSelect GetDDCADC(int DDC)
+{
+    return GDDCInputs[DDC];
+}
+
+
 //
 // SetDDCADC(int DDC, EADCSelect ADC)
 // sets the ADC to be used for each DDC
@@ -1411,24 +1828,17 @@ void SetCWXBits(bool CWXEnabled, bool CWXDash, bool CWXDot)
 //
 void SetDDCADC(int DDC, EADCSelect ADC)
 {
-    uint32_t RegisterValue;
     uint32_t ADCSetting;
     uint32_t Mask;
 
+    GDDCInputs[DDC] = ADC;
     if(GADCOverride)
         ADC = eTestSource;                          // override setting
 
     ADCSetting = ((uint32_t)ADC & 0x3) << (DDC*2);  // 2 bits with ADC setting
     Mask = 0x3 << (DDC*2);                         // 0,2,4,6,8,10,12,14,16,18bit positions
 
-    sem_wait(&DDCInSelMutex);                       // get protected access
-    RegisterValue = DDCInSelReg;                    // get current register setting
-    RegisterValue &= ~Mask;                         // strip ADC bits
-    RegisterValue |= ADCSetting;
-
-    DDCInSelReg = RegisterValue;                    // write back
-    RegisterWrite(VADDRDDCINSEL, RegisterValue);    // and write to it
-    sem_post(&DDCInSelMutex);
+    QueueRegisterUpdate(eDDCInSelQueuedReg, Mask, ADCSetting, false);     // strip ADC bits, add new
 }
 
 
@@ -1439,28 +1849,85 @@ void SetDDCADC(int DDC, EADCSelect ADC)
 //
 void SetRXDDCEnabled(bool IsEnabled)
 {
-    uint32_t Address;									// register address
-    uint32_t Data;										// register content
-
-    Address = VADDRDDCINSEL;							// DDC config register address
+    uint32_t Data = 0;									// register content
 
-    sem_wait(&DDCInSelMutex);                           // get protected access
-    Data = DDCInSelReg;                                 // get current register setting
     if (IsEnabled)
         Data |= (1 << 30);								// set new bit
-    else
-        Data &= ~(1 << 30);								// clear new bit
-
-    DDCInSelReg = Data;          // write back
-    RegisterWrite(Address, Data);					// write back
-    sem_post(&DDCInSelMutex);
+    QueueRegisterUpdate(eDDCInSelQueuedReg, (1 << 30), Data, false);
 }
 
 
 #define VMINCWRAMPDURATION 3000                     // 3ms min
 #define VMAXCWRAMPDURATION 10000                    // 10ms max
 #define VMAXCWRAMPDURATIONV14PLUS 20000             // 20ms max
-#define VCWAMPLITUDE 7549746.0F                     // 0.9*max amplitude to match Tune etc
+
+#define VNUMCWRAMPS 4                               // CW ramp tables cached
+
+
+//
+// cache of calculated CW ramp tables, keyed by length and protocol
+// clients switch between a few ramp settings; a switch back to one used
+// already then only needs the table upload.
+//
+struct CWRampEntry
+{
+    uint32_t Length_us;                             // ramp length; 0 = unused entry
+    bool IsP2;                                      // true if for protocol 2 sample rate
+    uint32_t RampLength;                            // ramp length in samples (words)
+    uint32_t LastUsed;                              // use count when last used (for least recently used replacement)
+    uint32_t Table[VRAMPSIZE];                      // ramp RAM content, uploaded as one block
+};
+struct CWRampEntry CWRampCache[VNUMCWRAMPS];
+uint32_t CWRampUseCount = 0;
+
+
+//
+// GetCWRamp(bool Protocol2, uint32_t Length_us)
+// find the cached ramp table for a length and protocol. If not found, fill the
+// least recently used entry: from the precomputed ramps if it is one of the
+// startup lengths, else calculate it.
+//
+static struct CWRampEntry* GetCWRamp(bool Protocol2, uint32_t Length_us)
+{
+    uint32_t Entry;
+    uint32_t Oldest = 0;
+    uint32_t Cntr;
+    struct CWRampEntry* Ramp;
+    const struct PrecomputedCWRamp* Precomputed = NULL;
+
+    CWRampUseCount++;
+    for (Entry = 0; Entry < VNUMCWRAMPS; Entry++)
+    {
+        if ((CWRampCache[Entry].Length_us == Length_us) && (CWRampCache[Entry].IsP2 == Protocol2))
+        {
+            CWRampCache[Entry].LastUsed = CWRampUseCount;
+            return &CWRampCache[Entry];
+        }
+        if (CWRampCache[Entry].LastUsed < CWRampCache[Oldest].LastUsed)
+            Oldest = Entry;
+    }
+    Ramp = &CWRampCache[Oldest];
+    for (Entry = 0; Entry < VNUMPRECOMPUTEDRAMPS; Entry++)
+        if ((PrecomputedCWRamps[Entry].Length_us == Length_us) && (PrecomputedCWRamps[Entry].IsP2 == Protocol2))
+            Precomputed = &PrecomputedCWRamps[Entry];
+    if (Precomputed != NULL)
+    {
+        Ramp->RampLength = Precomputed->RampLength;
+        memcpy(Ramp->Table, Precomputed->Table, Ramp->RampLength * sizeof(uint32_t));
+    }
+    else
+    {
+        printf("calculating new CW ramp, length = %d us\n", Length_us);
+        Ramp->RampLength = CalculateCWRampLength(Protocol2, Length_us);
+        CalculateCWRamp(Ramp->Table, Ramp->RampLength);
+    }
+    for(Cntr = Ramp->RampLength; Cntr < VRAMPSIZE; Cntr++)                 // fill remainder of RAM
+        Ramp->Table[Cntr] = (uint32_t)VCWAMPLITUDE;
+    Ramp->Length_us = Length_us;
+    Ramp->IsP2 = Protocol2;
+    Ramp->LastUsed = CWRampUseCount;
+    return Ramp;
+}
 
 
 //
@@ -1469,35 +1936,17 @@ void SetRXDDCEnabled(bool IsEnabled)
 // needs to be called before keyer enabled!
 // parameter is length in microseconds; typically 5000-10000
 // setup ramp memory and ramp length fields
-// only calculate if paramters have changed!
+// only load if paramters have changed! Ramps are cached, so only calculated once
 //
 void InitialiseCWKeyerRamp(bool Protocol2, uint32_t Length_us)
 {
-    const double c1 = -0.12182865361171612;
-    const double c2 = -0.018557469249199286;
-    const double c3 = -0.0009378783245428506;
-    const double c4 = 0.0008567571519403228;
-    const double c5 = 0.00018706912431472442;
-
-
-    const double twopi = 6.28318530717959;
-    const double fourpi = 12.56637061435920;
-    const double sixpi = 18.84955592153880;
-    const double eightpi = 25.13274122871830;
-    const double tenpi = 31.41592653589790;
-
-    double SamplePeriod;                    // sample period in us
     uint32_t RampLength;                    // integer length in WORDS not bytes!
-    uint32_t Cntr;
-    uint32_t Sample;                        // ramp sample value
-    uint32_t Register;
-	ESoftwareID ID;
-	unsigned int FPGAVersion = 0;
+	bool LongRamp;                          // true if V14+ firmware
     unsigned int MaxDuration;               // max ramp duration in microseconds
-    double x, x2, x4, x6, x8, x10, rampsample;
+    struct CWRampEntry* Ramp;
 
-    FPGAVersion = GetFirmwareVersion(&ID);
-    if(FPGAVersion >= 14)
+    LongRamp = GetFPGACapabilities()->HasLongCWRamp;
+    if(LongRamp)
         MaxDuration = VMAXCWRAMPDURATIONV14PLUS;        // get version dependent max length
     else
         MaxDuration = VMAXCWRAMPDURATION;
@@ -1513,52 +1962,23 @@ void InitialiseCWKeyerRamp(bool Protocol2, uint32_t Length_us)
     {
         GCWKeyerRampms = Length_us;
         GCWKeyerRamp_IsP2 = Protocol2;
-        printf("calculating new CW ramp, length = %d us\n", Length_us);
-    // work out required length in samples
-        if(Protocol2)
-            SamplePeriod = 1000.0/192.0;
-        else
-            SamplePeriod = 1000.0/48.0;
-        RampLength = (uint32_t)(((double)Length_us / SamplePeriod) + 1);
-
-//
-// DL1YCF ramp code:
-//
-//
-        for (Cntr = 0; Cntr < RampLength; Cntr++)
-        {
-            x = (double) Cntr / (double) RampLength;           // between 0 and 1
-            x2 = x * twopi;         // 2 Pi x
-            x4 = x * fourpi;        // 4 Pi x
-            x6 = x * sixpi;         // 6 Pi x
-            x8 = x * eightpi;       // 8 Pi x
-            x10 = x * tenpi;        // 10 Pi x
-            rampsample = x + c1 * sin(x2) + c2 * sin(x4) + c3 * sin(x6) + c4 * sin(x8) + c5 * sin(x10);
-            Sample = (uint32_t) (rampsample * VCWAMPLITUDE);
-            RegisterWrite(VADDRCWKEYERRAM + 4*Cntr, Sample);
-        }
-        for(Cntr = RampLength; Cntr < VRAMPSIZE; Cntr++)                        // fill remainder of RAM
-            RegisterWrite(VADDRCWKEYERRAM + 4*Cntr, (unsigned long)VCWAMPLITUDE);
+        Ramp = GetCWRamp(Protocol2, Length_us);
+        RampLength = Ramp->RampLength;
+        RegisterWriteBlock(VADDRCWKEYERRAM, Ramp->Table, VRAMPSIZE);
 
     //
     // finally write the ramp length
     // in FPGA V14 onwards this is a word address
-        Register = GCWKeyerSetup;                    // get current settings
-        Register &= 0x8003FFFF;                      // strip out ramp bits
-        if(FPGAVersion >= 14)
-            Register |= (RampLength << VCWKEYERRAMP);        // word end address
+        if(LongRamp)
+            RegWrite_KeyerConfig_RampLength(RampLength);         // word end address
         else
-            Register |= ((RampLength << 2) << VCWKEYERRAMP);        // byte end address
-
-        GCWKeyerSetup = Register;                    // store it back
-        RegisterWrite(VADDRKEYERCONFIGREG, Register);  // and write to it
+            RegWrite_KeyerConfig_RampLength(RampLength << 2);    // byte end address
     }
 }
 
 
 
 
-
 //
 // EnableCW (bool Enabled, bool Breakin)
 // enables or disables CW mode; selects CW as modulation source.
@@ -1630,16 +2050,7 @@ void SetCWSidetoneVol(uint8_t Volume)
 //
 void SetCWPTTDelay(unsigned int Delay)
 {
-    uint32_t Register;
-
-    Register = GCWKeyerSetup;                           // get current settings
-    Register &= 0xFFFFFF00;                             // remove old bits
-    Register |= (Delay &0xFF);                          // add back new bits
-    if(Register != GCWKeyerSetup)                       // write back if different
-    {
-        GCWKeyerSetup = Register;                       // store it back
-        RegisterWrite(VADDRKEYERCONFIGREG, Register);   // and write to it
-    }
+    RegWrite_KeyerConfig_PTTDelay(Delay);               // written if changed
 }
 
 
@@ -1650,16 +2061,7 @@ void SetCWPTTDelay(unsigned int Delay)
 //
 void SetCWHangTime(unsigned int HangTime)
 {
-    uint32_t Register;
-
-    Register = GCWKeyerSetup;                           // get current settings
-    Register &= 0xFFFC00FF;                             // remove old bits
-    Register |= (HangTime &0x3FF) << VCWKEYERHANG;      // add back new bits
-    if(Register != GCWKeyerSetup)                       // write back if different
-    {
-        GCWKeyerSetup = Register;                       // store it back
-        RegisterWrite(VADDRKEYERCONFIGREG, Register);   // and write to it
-    }
+    RegWrite_KeyerConfig_HangTime(HangTime);            // written if changed
 }
 
 #define VCODECSAMPLERATE 48000                      // I2S rate
@@ -1716,16 +2118,11 @@ void SetMaxPWMWidth(unsigned int Width)
 //
 void SetXvtrEnable(bool Enabled)
 {
-    uint32_t Register;
+    uint32_t Register = 0;
 
-    sem_wait(&RFGPIOMutex);                         // get protected access
-    Register = GPIORegValue;                        // get current settings
     if(Enabled)
         Register |= (1<<VXVTRENABLEBIT);
-    else
-    Register &= ~(1<<VXVTRENABLEBIT);
-    GPIORegValue = Register;                    // store it back
-    sem_post(&RFGPIOMutex);                         // clear protected access
+    QueueRegisterUpdate(eGPIOQueuedReg, (1<<VXVTRENABLEBIT), Register, true);    // store it; written with next update
 }
 
 
@@ -1818,7 +2215,7 @@ uint32_t GetWidebandStatus(bool *ADC0Data, bool *ADC1Data)
 //
 void EnableTimeStamp(bool Enabled)
 {
-    GEnableTimeStamping = Enabled;                          // P2. true if enabled. NOT SUPPORTED YET
+    GEnableTimeStamping = Enabled;                          // P2. true if enabled. DDC packets carry a sample count
 }
 
 
@@ -1828,7 +2225,7 @@ void EnableTimeStamp(bool Enabled)
 //
 void EnableVITA49(bool Enabled)
 {
-    GEnableVITA49 = Enabled;                                // P2. true if enabled. NOT SUPPORTED YET
+    GEnableVITA49 = Enabled;                                // P2. true if enabled. applied when the DDC stream starts
 }
 
 
@@ -1851,15 +2248,10 @@ void SetPAEnabled(bool Enabled)
     uint32_t Register;
 
     GPAEnabled = Enabled;                           // just save for now
-    sem_wait(&RFGPIOMutex);                         // get protected access
-    Register = GPIORegValue;                        // get current settings
+    Register = 0;
     if(!Enabled)
         Register |= (1<<VTXRELAYDISABLEBIT);
-    else
-        Register &= ~(1<<VTXRELAYDISABLEBIT);
-    GPIORegValue = Register;                    // store it back
-    RegisterWrite(VADDRRFGPIOREG, Register);  // and write to it
-    sem_post(&RFGPIOMutex);                         // clear protected access
+    QueueRegisterUpdate(eGPIOQueuedReg, (1<<VTXRELAYDISABLEBIT), Register, false);
 }
 
 
@@ -1886,12 +2278,15 @@ void SetDUCSampleRate(ESampleRate Rate)
 
 //
 // SetDUCSampleSize(unsigned int Bits)
-// sets the number of bits per sample.
-// currently unimplemented, and protocol 2 always uses 24 bits per sample.
+// sets the number of bits per sample in DUC I/Q packets from the client: 16 or 24.
+// the FPGA always takes 24 bit samples: 16 bit samples are widened as they are
+// I/Q swapped. Any other size is 24 bits.
 //
 void SetDUCSampleSize(unsigned int Bits)
 {
-    GDUCSampleSize = Bits;                                  // just save for now
+    if (Bits != 16)
+        Bits = 24;
+    __atomic_store_n(&GDUCSampleSize, Bits, __ATOMIC_RELAXED);      // read by the DUC I/Q thread
 }
 
 
@@ -1916,15 +2311,10 @@ void SetSpkrMute(bool IsMuted)
 
     GSpeakerMuted = IsMuted;                        // just save for now.
 
-    sem_wait(&RFGPIOMutex);                         // get protected access
-    Register = GPIORegValue;                        // get current settings
+    Register = 0;
     if(IsMuted)
         Register |= (1<<VSPKRMUTEBIT);
-    else
-        Register &= ~(1<<VSPKRMUTEBIT);
-    GPIORegValue = Register;                        // store it back
-    RegisterWrite(VADDRRFGPIOREG, Register);        // and write to it
-    sem_post(&RFGPIOMutex);                         // clear protected access
+    QueueRegisterUpdate(eGPIOQueuedReg, (1<<VSPKRMUTEBIT), Register, false);
 }
 
 
@@ -2093,6 +2483,66 @@ unsigned int GetAnalogueIn(unsigned int AnalogueSelect)
 }
 
 
+//
+// void GetAnalogueInputs(unsigned int* Values)
+// return all the RF board analogue values, with one block register read
+//
+void GetAnalogueInputs(unsigned int* Values)
+{
+    uint32_t Registers[VNUMANALOGUEIN];
+    unsigned int Cntr;
+
+    RegisterReadBlock(VADDRALEXADCBASE, Registers, VNUMANALOGUEIN);
+    for(Cntr = 0; Cntr < VNUMANALOGUEIN; Cntr++)
+        Values[Cntr] = Registers[Cntr];
+}
+
+
+//
+// void ReadTelemetrySnapshot(struct TelemetrySnapshot* Snapshot, bool WithAnalogue)
+// read the telemetry registers, and publish them.
+// the published copy is guarded by a sequence count, so readers never wait for this thread:
+// the count is odd while the copy is written, and a reader retries if it changed during its copy.
+//
+void ReadTelemetrySnapshot(struct TelemetrySnapshot* Snapshot, bool WithAnalogue)
+{
+    uint32_t Sequence;
+
+    Snapshot->Status = RegisterRead(VADDRSTATUSREG);
+    GStatusRegister = Snapshot->Status;
+    Snapshot->ADCOverflow = RegisterRead(VADDRADCOVERFLOWBASE) & 0x3;
+    if(WithAnalogue)
+        RegisterReadBlock(VADDRALEXADCBASE, Snapshot->Analogue, VNUMANALOGUEIN);
+    else
+        memcpy(Snapshot->Analogue, GTelemetry.Analogue, sizeof(Snapshot->Analogue));   // only this thread writes it
+    Snapshot->Count = GTelemetry.Count + 1;
+
+    Sequence = __atomic_load_n(&GTelemetrySequence, __ATOMIC_RELAXED);
+    __atomic_store_n(&GTelemetrySequence, Sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&GTelemetry, Snapshot, sizeof(GTelemetry));
+    __atomic_store_n(&GTelemetrySequence, Sequence + 2, __ATOMIC_RELEASE);
+}
+
+
+//
+// void GetTelemetrySnapshot(struct TelemetrySnapshot* Snapshot)
+// copy the most recently published snapshot
+//
+void GetTelemetrySnapshot(struct TelemetrySnapshot* Snapshot)
+{
+    uint32_t Before, After;
+
+    do
+    {
+        Before = __atomic_load_n(&GTelemetrySequence, __ATOMIC_ACQUIRE);
+        memcpy(Snapshot, &GTelemetry, sizeof(*Snapshot));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        After = __atomic_load_n(&GTelemetrySequence, __ATOMIC_RELAXED);
+    } while((Before != After) || (Before & 1));
+}
+
+
 //////////////////////////////////////////////////////////////////////////////////
 // internal App register settings
 // these are things not accessible from external SDR applications, including debug
@@ -2110,24 +2560,23 @@ void CodecInitialise(void)
 {
     GCodecLineGain = 0;                                     // Codec left line in gain register
     GCodecAnaloguePath = 0x14;                              // Codec analogue path register (mic input, no boost)
-    CodecRegisterWrite(VCODECRESETREG, 0x0);          // reset register: reset deveice
-    usleep(100);
-    CodecRegisterWrite(VCODECACTIVATIONREG, 0x1);     // digital activation set to ACTIVE
-    usleep(100);
-    CodecRegisterWrite(VCODECANALOGUEPATHREG, GCodecAnaloguePath);        // mic input, no boost
-    usleep(100);
-    CodecRegisterWrite(VCODECPOWERDOWNREG, 0x0);      // all elements powered on
-    usleep(100);
-    CodecRegisterWrite(VCODECDIGITALFORMATREG, 0x2);  // slave; no swap; right when LRC high; 16 bit, I2S
-    usleep(100);
-    CodecRegisterWrite(VCODECSAMPLERATEREG, 0x0);     // no clock divide; rate ctrl=0; normal mode, oversample 256Fs
-    usleep(100);
-    CodecRegisterWrite(VCODECDIGITALPATHREG, 0x0);    // no soft mute; no deemphasis; ADC high pss filter enabled
-    usleep(100);
-    CodecRegisterWrite(VCODECLLINEVOLREG, GCodecLineGain);        // line in gain=0
-    CodecRegisterWrite(VCODECRLINEVOLREG, GCodecLineGain);        // line in gain=0
-    usleep(100);
 
+    struct CodecRegisterSetting Settings[] =
+    {
+        {VCODECRESETREG, 0x0},                              // reset register: reset deveice
+        {VCODECACTIVATIONREG, 0x1},                         // digital activation set to ACTIVE
+        {VCODECANALOGUEPATHREG, GCodecAnaloguePath},        // mic input, no boost
+        {VCODECPOWERDOWNREG, 0x0},                          // all elements powered on
+        {VCODECDIGITALFORMATREG, 0x2},                      // slave; no swap; right when LRC high; 16 bit, I2S
+        {VCODECSAMPLERATEREG, 0x0},                         // no clock divide; rate ctrl=0; normal mode, oversample 256Fs
+        {VCODECDIGITALPATHREG, 0x0},                        // no soft mute; no deemphasis; ADC high pss filter enabled
+        {VCODECLLINEVOLREG, GCodecLineGain},                // line in gain=0
+        {VCODECRLINEVOLREG, GCodecLineGain}                 // line in gain=0
+    };
+
+    // the SPI writer holds off each bus write until the previous transfer has
+    // been shifted out, so the table needs no delays; wait for the last one only
+    CodecRegisterWriteTable(Settings, sizeof(Settings) / sizeof(Settings[0]), true);
 }
 
 
@@ -2137,14 +2586,8 @@ void CodecInitialise(void)
 // 
 void SetTXAmplitudeScaling (unsigned int Amplitude)
 {
-    uint32_t Register;
-
     GTXAmplScaleFactor = Amplitude;                             // save value
-    Register = TXConfigRegValue;                                // get current settings
-    Register &= 0xFFC0000F;                                     // remove old bits
-    Register |= ((Amplitude & 0x3FFFF) << VTXCONFIGSCALEBIT);   // add new bits
-    TXConfigRegValue = Register;                                // store it back
-    RegisterWrite(VADDRTXCONFIGREG, Register);                  // and write to it
+    RegWrite_TXConfig_Scale(Amplitude);
 }
 
 
@@ -2155,14 +2598,8 @@ void SetTXAmplitudeScaling (unsigned int Amplitude)
 // true for P2
 void SetTXProtocol (bool Protocol)
 {
-    uint32_t Register;
-
     GTXProtocolP2 = Protocol;                           // save value
-    Register = TXConfigRegValue;                        // get current settings
-    Register &= 0xFFFFFF7;                              // remove old bit
-    Register |= ((((unsigned int)Protocol)&1) << VTXCONFIGPROTOCOLBIT);            // add new bit
-    TXConfigRegValue = Register;                    // store it back
-    RegisterWrite(VADDRTXCONFIGREG, Register);  // and write to it
+    RegWrite_TXConfig_ProtocolP2(Protocol);
 }
 
 
@@ -2176,8 +2613,8 @@ void ResetDUCMux(void)
     uint32_t Register;
     uint32_t BitMask;
 
-    BitMask = (1 << 29);
-    Register = TXConfigRegValue;                        // get current settings
+    BitMask = (1 << VTXCONFIGMUXRESETBIT);
+    Register = GetMappedRegister(eRegTXConfig);         // get current settings
     Register |= BitMask;                                // set reset bit
     RegisterWrite(VADDRTXCONFIGREG, Register);          // and write to it
     Register &= ~BitMask;                               // remove old bit
@@ -2193,18 +2630,8 @@ void ResetDUCMux(void)
 //
 void SetTXOutputGate(bool AlwaysOn)
 {
-    uint32_t Register;
-    uint32_t BitMask;
-
     GTXAlwaysEnabled = AlwaysOn;
-    BitMask = (1 << 2);
-    Register = TXConfigRegValue;                        // get current settings
-    if (AlwaysOn)
-        Register |= BitMask;                            // set bit if true
-        else
-        Register &= ~BitMask;                           // clear bit if false
-    TXConfigRegValue = Register;                    // store it back
-    RegisterWrite(VADDRTXCONFIGREG, Register);  // and write to it
+    RegWrite_TXConfig_OutputGate(AlwaysOn);
 }
 
 
@@ -2218,18 +2645,8 @@ void SetTXOutputGate(bool AlwaysOn)
 //
 void SetTXIQDeinterleaved(bool Interleaved)
 {
-    uint32_t Register;
-    uint32_t BitMask;
-
     GTXIQInterleaved = Interleaved;
-    BitMask = (1 << 30);
-    Register = TXConfigRegValue;                        // get current settings
-    if (Interleaved)
-        Register |= BitMask;                            // set bit if true
-    else
-        Register &= ~BitMask;                           // clear bit if false
-    TXConfigRegValue = Register;                    // store it back
-    RegisterWrite(VADDRTXCONFIGREG, Register);    // and write to it
+    RegWrite_TXConfig_IQDeinterleave(Interleaved);
 }
 
 
@@ -2240,18 +2657,8 @@ void SetTXIQDeinterleaved(bool Interleaved)
 //
 void EnableDUCMux(bool Enabled)
 {
-    uint32_t Register;
-    uint32_t BitMask;
-
     GTXDUCMuxActive = Enabled;
-    BitMask = (1 << 31);
-    Register = TXConfigRegValue;                        // get current settings
-    if (Enabled)
-        Register |= BitMask;                            // set bit if true
-    else
-        Register &= ~BitMask;                           // clear bit if false
-    TXConfigRegValue = Register;                    // store it back
-    RegisterWrite(VADDRTXCONFIGREG, Register);    // and write to it
+    RegWrite_TXConfig_MuxEnable(Enabled);
 }
 
 
@@ -2269,7 +2676,7 @@ void SetTXModulationTestSourceFrequency (unsigned int Freq)
     if(Register != TXModulationTestReg)                    // write back if different
     {
         TXModulationTestReg = Register;                    // store it back
-        RegisterWrite(VADDRTXMODTESTREG, Register);  // and write to it
+        ShadowRegisterWrite(VADDRTXMODTESTREG, Register);  // and write to it
     }
 }
 
@@ -2281,14 +2688,8 @@ void SetTXModulationTestSourceFrequency (unsigned int Freq)
 //
 void SetTXModulationSource(ETXModulationSource Source)
 {
-    uint32_t Register;
-
     GTXModulationSource = Source;                       // save value
-    Register = TXConfigRegValue;                        // get current settings
-    Register &= 0xFFFFFFFC;                             // remove old bits
-    Register |= ((unsigned int)Source);                 // add new bits
-    TXConfigRegValue = Register;                    // store it back
-    RegisterWrite(VADDRTXCONFIGREG, Register);  // and write to it
+    RegWrite_TXConfig_ModSource((uint32_t)Source);
 }
 
 
@@ -2328,11 +2729,17 @@ void SetFreqPhaseWord(__attribute__((unused)) bool IsPhase)
 
 
 // SetDDCSampleSize(unsigned int DDC, unsgned int Size)
-// set sample resolution for DDC (only 24 bits supported, so ignore)
+// set sample resolution for DDC. The FPGA always makes 24 bit samples: p2app
+// converts them to 16 bit or float as the packets are sent. Any other size is 24 bits.
+// applied when the DDC stream next starts
 //
-void SetDDCSampleSize(__attribute__((unused)) unsigned int DDC, __attribute__((unused)) unsigned int Size)
+void SetDDCSampleSize(unsigned int DDC, unsigned int Size)
 {
-
+    if (DDC >= VNUMDDC)
+        return;
+    if ((Size != 16) && (Size != 32))
+        Size = 24;
+    GDDCSampleSize[DDC] = (uint8_t)Size;
 }
 
 
@@ -2342,9 +2749,7 @@ void SetDDCSampleSize(__attribute__((unused)) unsigned int DDC, __attribute__((u
 //
 void UseTestDDSSource(void)
 {
-    sem_wait(&DDCInSelMutex);                           // get protected access
     GADCOverride = true;
-    DDCInSelReg = (DDCInSelReg & 0x40000000) | 0x000AAAAA;      // set all to test
-    sem_post(&DDCInSelMutex);
+    QueueRegisterUpdate(eDDCInSelQueuedReg, ~0x40000000, 0x000AAAAA, true);   // set all to test
 
 }
\ No newline at end of file
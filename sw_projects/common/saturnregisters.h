@@ -20,6 +20,7 @@
 #include <stdint.h>
 
 #define VNUMDDC 10                                  // downconverters available
+#define VMAXP1DDCS 7                                // max number of DDCs used for P1
 
 //
 // enum type for sample rate. only 48-384KHz allowed for protocol 1
@@ -82,6 +83,19 @@ typedef enum
 #define VDUCDMADEVICE "/dev/xdma0_h2c_0"
 
 
+//
+// XDMA user interrupt event devices
+// FIFO monitor channel N interrupt is routed to XDMA usr_irq_req[N]
+// reading the device blocks until an interrupt; poll() is supported
+//
+#define VDDCEVENTDEVICE "/dev/xdma0_events_0"
+#define VDUCEVENTDEVICE "/dev/xdma0_events_1"
+#define VMICEVENTDEVICE "/dev/xdma0_events_2"
+#define VSPKEVENTDEVICE "/dev/xdma0_events_3"
+#define VWBEVENTDEVICE "/dev/xdma0_events_4"                // wideband "data ready" (usr_irq_req[4])
+#define VSTATUSEVENTDEVICE "/dev/xdma0_events_5"            // status change: PTT, key or ADC overflow (usr_irq_req[5])
+
+
 //
 // FPGA register map
 //
@@ -118,6 +132,8 @@ typedef enum
 #define VADDRALEXSPIREG 0x0B000
 #define VADDRBOARDID1 0xC000
 #define VADDRBOARDID2 0xC004
+#define VADDRICAPADDRREG 0xE000                 // warm reconfiguration: flash address of the image
+#define VADDRICAPCONTROLREG 0xE004              // warm reconfiguration: arm, and status
 #define VADDRCONFIGSPIREG 0x10000
 #define VADDRCODECSPIREG 0x14000
 #define VADDRXADCREG 0x18000                    // on-chip XADC (temp, VCC...)
@@ -165,6 +181,10 @@ extern uint32_t DDCConfigRegs[VNUMDDC];
 extern uint32_t DMAFIFODepths[VNUMDMAFIFO];
 
 extern bool GEEREnabled;                                   // P2. true if EER is enabled
+extern bool GEnableTimeStamping;                           // P2. true if timestamps to be added to RX data
+extern bool GEnableVITA49;                                 // P2. true if DDC data to be sent as VITA-49 packets
+extern uint8_t GDDCSampleSize[VNUMDDC];                    // P2. DDC sample bits asked for: 16, 24 or 32 (float)
+extern unsigned int GDUCSampleSize;                        // P2. DUC sample bits from the client: 16 or 24
 
 
 
@@ -179,12 +199,6 @@ void InitialiseCWKeyerRamp(bool Protocol2, uint32_t Length_us);
 
 
 
-//
-// initialise the DAC Atten ROMs
-// these set the step attenuator and DAC drive level
-// for "attenuation intent" values from 0 to 255
-//
-void InitialiseDACAttenROMs(void);
 
 //
 // InitialiseFIFOSizes(void)
@@ -193,6 +207,72 @@ void InitialiseDACAttenROMs(void);
 void InitialiseFIFOSizes(void);
 
 
+//
+// shadowed register writes
+// ShadowRegisterWrite() keeps the last value written to a register, and skips the
+// bus write if the value hasn't changed. Between BeginRegisterUpdates() and
+// EndRegisterUpdates() a thread's writes are held and merged, so several field
+// updates to one register make one bus write (eg one per high priority packet).
+// FlushRegisterUpdates() writes out held values without ending the update.
+// not for registers where a write has an effect even if the value is unchanged.
+//
+void ShadowRegisterWrite(uint32_t Address, uint32_t Data);
+void BeginRegisterUpdates(void);
+void FlushRegisterUpdates(void);
+void EndRegisterUpdates(void);
+
+
+//
+// ReportRegisterWriteStats(void)
+// print the shadowed register writes made and saved
+//
+void ReportRegisterWriteStats(void);
+extern uint64_t GRegisterWritesIssued;              // shadowed register bus writes made
+extern uint64_t GRegisterWritesSaved;               // shadowed register writes suppressed or merged
+extern uint64_t GDDCRetunes;                        // grouped retunes of more than one DDC (SetDDCFrequencies)
+extern uint32_t GDDCRetuneLastNs;                   // register write time of the last grouped retune
+extern uint32_t GDDCRetuneMaxNs;                    // and the longest
+
+
+//
+// registers updated through the register queue
+//
+typedef enum
+{
+  eGPIOQueuedReg,               // RF GPIO register
+  eDDCInSelQueuedReg,           // DDC input select register
+  eFIFOResetQueuedReg,          // DMA FIFO reset register
+  eCodecSPIQueuedReg            // codec SPI writer register
+} EQueuedRegister;
+
+#define VNUMQUEUEDREGS 4
+
+
+//
+// QueueRegisterUpdate(EQueuedRegister Reg, uint32_t ClearBits, uint32_t SetBits, bool StoreOnly)
+// read-modify-write of a register shared between threads, without a lock.
+// the operation (clear bits, then set bits) is posted to a lock-free queue. Operations
+// are applied in order to the register copy and written by whichever thread is draining
+// the queue. The call returns once the register has been written: if another thread
+// is draining, the caller waits for it to pass its operation.
+//   StoreOnly: true to update the register copy but not write it (it is written with the next update)
+// GPIO register updates are held between BeginRegisterUpdates() and FlushRegisterUpdates().
+//
+void QueueRegisterUpdate(EQueuedRegister Reg, uint32_t ClearBits, uint32_t SetBits, bool StoreOnly);
+
+
+//
+// QueueRegisterWrites(EQueuedRegister Reg, const uint32_t* Values, uint32_t Count)
+// write a sequence of whole values to a queued register, in order.
+// all the values are posted before the queue is drained once, so a
+// sequence costs one drain rather than one per value. Returns once the last value
+// has been written.
+//
+void QueueRegisterWrites(EQueuedRegister Reg, const uint32_t* Values, uint32_t Count);
+extern uint64_t GQueuedRegisterOps;                 // queued register operations applied
+extern uint64_t GQueuedRegisterWrites;              // queued register bus writes made
+
+
 
 
 
@@ -206,10 +286,22 @@ void SetByteSwapping(bool IsSwapped);
 //
 // SetMOX(bool Mox)
 // sets or clears TX state
+// the MOX bit and keyer enable are written at once, never held by BeginRegisterUpdates(),
+// in the order that is safe for the direction; each RX to TX and TX to RX switch is timed
 //
 void SetMOX(bool Mox);
 
 
+//
+// ReportTurnaroundTimes(void)
+// print the measured RX to TX and TX to RX register switch times
+//
+void ReportTurnaroundTimes(void);
+extern uint64_t GTurnaroundCount[2];                // turnarounds [0] = TX to RX, [1] = RX to TX
+extern uint32_t GTurnaroundLastNs[2];               // time of the last one
+extern uint32_t GTurnaroundMaxNs[2];                // and the longest
+
+
 //
 // SetTXEnable(bool Enabled)
 // sets or clears TX enable bit
@@ -227,7 +319,8 @@ void SetATUTune(bool TuneEnabled);
 // SetP1SampleRate(ESampleRate Rate, unsigned int Count)
 // sets the sample rate for all DDC used in protocol 1. 
 // allowed rates are 48KHz to 384KHz.
-// also sets the number of enabled DDCs, 1-8. Count = #DDC reqd
+// also sets the number of enabled DDCs, 1-VMAXP1DDCS. Count = #DDC reqd
+// writes the DDC rate register if the setting has changed
 //
 void SetP1SampleRate(ESampleRate Rate, unsigned int Count);
 
@@ -252,6 +345,13 @@ void SetP2SampleRate(unsigned int DDC, bool Enabled, unsigned int SampleRate, bo
 bool WriteP2DDCRateRegister(void);
 
 
+//
+// uint32_t GetP2DDCRateWord(void)
+// get the DDC rate register value set by SetP2SampleRate(), without writing it
+//
+uint32_t GetP2DDCRateWord(void);
+
+
 //
 // uint32_t GetDDCEnables(void)
 // get enable bits for each DDC; 1 bit per DDC
@@ -300,6 +400,23 @@ void SetADCOptions(EADCSelect ADC, bool PGA, bool Dither, bool Random);
 void SetDDCFrequency(uint32_t DDC, uint32_t Value, bool IsDeltaPhase);
 
 
+//
+// SetDDCFrequencies(const uint32_t* Values, uint32_t Mask, bool IsDeltaPhase)
+// sets several DDC frequencies together, with burst register writes
+// Values: phase or frequency word for each DDC (VNUMDDC entries)
+// Mask: bit N set = set DDC N
+// returns the time taken for the register writes, in ns
+//
+uint32_t SetDDCFrequencies(const uint32_t* Values, uint32_t Mask, bool IsDeltaPhase);
+
+
+//
+// uint32_t GetDDCFrequency(uint32_t DDC)
+// get a DDC frequency in Hz, from the delta phase last set
+//
+uint32_t GetDDCFrequency(uint32_t DDC);
+
+
 //
 // SetTestDDSFrequency(uint32_t Value, bool IsDeltaPhase)
 // sets a test source frequency.
@@ -523,6 +640,13 @@ void SetCWXBits(bool CWXEnabled, bool CWXDash, bool CWXDot);
 void SetDDCADC(int DDC, EADCSelect ADC);
 
 
+//
+// EADCSelect GetDDCADC(int DDC)
+// gets the ADC selected for a DDC by the client (eTXSamples for a PureSignal feedback DDC)
+//
+EADCSelect GetDDCADC(int DDC);
+
+
 //
 // void SetDDCInterleaved(uint32_t DDCNum, bool Interleaved)
 //
@@ -652,7 +776,7 @@ void EnableTimeStamp(bool Enabled);
 
 //
 // EnableVITA49(bool Enabled)
-// enables VITA49 mode
+// enables VITA49 mode: DDC data sent as VITA-49 IF data packets from the next DDC stream start
 //
 void EnableVITA49(bool Enabled);
 
@@ -689,8 +813,9 @@ void SetDUCSampleRate(ESampleRate Rate);
 
 //
 // SetDUCSampleSize(unsigned int Bits)
-// sets the number of bits per sample.
-// currently unimplemented, and protocol 2 always uses 24 bits per sample.
+// sets the number of bits per sample in DUC I/Q packets from the client: 16 or 24.
+// the FPGA always takes 24 bit samples: 16 bit samples are widened as they are
+// I/Q swapped. Any other size is 24 bits.
 //
 void SetDUCSampleSize(unsigned int Bits);
 
@@ -793,6 +918,46 @@ unsigned int GetUserIOBits(void);
 unsigned int GetAnalogueIn(unsigned int AnalogueSelect);
 
 
+//
+// void GetAnalogueInputs(unsigned int* Values)
+// return all VNUMANALOGUEIN RF board analogue values, with one block register read
+// Values[n] is the same as GetAnalogueIn(n)
+//
+#define VNUMANALOGUEIN 6
+void GetAnalogueInputs(unsigned int* Values);
+
+
+//
+// telemetry snapshot: the status, ADC overflow and RF board analogue registers, read together.
+// one thread reads the hardware with ReadTelemetrySnapshot() (in p2app, the high priority thread);
+// any other thread gets the most recent copy with GetTelemetrySnapshot(), with no register access.
+//
+struct TelemetrySnapshot
+{
+    uint32_t Status;                                // status register
+    uint32_t ADCOverflow;                           // bit0: ADC1, bit1: ADC2 overflow since the previous read
+    uint32_t Analogue[VNUMANALOGUEIN];              // RF board analogue inputs, in GetAnalogueIn() order
+    uint32_t Count;                                 // snapshots taken; 0 if none yet
+};
+
+
+//
+// void ReadTelemetrySnapshot(struct TelemetrySnapshot* Snapshot, bool WithAnalogue)
+// read the registers into Snapshot, and publish it for GetTelemetrySnapshot().
+// status and ADC overflow each take one read; the analogue inputs one block read, if WithAnalogue
+// (else the previous analogue values are kept). The status is also kept for GetP2PTTKeyInputs() etc,
+// as if ReadStatusRegister() had been called. Must only be called from one thread.
+//
+void ReadTelemetrySnapshot(struct TelemetrySnapshot* Snapshot, bool WithAnalogue);
+
+
+//
+// void GetTelemetrySnapshot(struct TelemetrySnapshot* Snapshot)
+// copy the most recently published snapshot. Does not access the FPGA.
+//
+void GetTelemetrySnapshot(struct TelemetrySnapshot* Snapshot);
+
+
 //////////////////////////////////////////////////////////////////////////////////
 // internal App register settings
 // these are things not accessible from external SDR applications, including debug
@@ -894,7 +1059,8 @@ void SetFreqPhaseWord(bool IsPhase);
 
 //
 // SetDDCSampleSize(unsigned int DDC, unsgned int Size)
-// set sample resolution for DDC (only 24 bits supported)
+// set sample resolution for DDC: 16, 24 or 32 (float); any other value is 24.
+// the FPGA makes 24 bit samples, converted as the packets are sent
 //
 void SetDDCSampleSize(unsigned int DDC, unsigned int Size);
 
@@ -0,0 +1,752 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 1
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// simhwaccess.c:
+// simulated hardware access, a replacement for hwaccess.c (make sim)
+// so the stream code can be run and benchmarked without a Saturn board.
+//
+// registers are held in memory. The 4 stream FIFOs are modelled: each
+// fills (DDC, mic) or drains (DUC, speaker) at its nominal rate, and the
+// FIFO monitor registers return their occupancy. DDC DMA reads are served
+// with frames built for the rate word in the DDC rate register, each with
+// a valid 0x80 header. If SATURNSIM_DDCFILE names a capture file (from
+// p2app -y, see ddccapture.h) its blocks are replayed in a loop instead, at
+// the captured data rate, or as fast as they are read if SATURNSIM_REPLAY=max.
+// a file that isn't a capture is taken as raw DDC DMA data (up to 64KB).
+// Every VSIMREPORTPERIOD seconds
+// the throughput of each stream and the CPU time per DDC sample are printed.
+// the wideband capture is not simulated.
+//
+//////////////////////////////////////////////////////////////
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 500
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <stdbool.h>
+
+#include "../common/hwaccess.h"
+#include "../common/saturnregisters.h"
+#include "../common/saturndrivers.h"
+#include "../common/ddccapture.h"
+#include "../common/version.h"
+
+
+#define VSIMREGISTERSPACE 0x20000                   // simulated AXI-Lite space
+#define VSIMREPORTPERIOD 10                         // seconds between throughput reports
+#define VSIMPATTERNSIZE 65536                       // generated DDC data buffer; holds whole frames only
+#define VSIMSWVERSION ((1U << 25) | (4U << 20) | (19U << 4) | 0xFU)    // major 1, full function, FW V19, all clocks
+#define VSIMPRODVERSION ((1U << 16) | 1U)           // Saturn, product version 1
+#define VSIMSTATUSIDLE ((1U << 7) | (1U << 10))     // user IO 8 high, PLL locked; PTT and keys released
+#define VSIMDDCFRAMERATE 48000                      // DDC frames per second
+#define VSIMMICRATE 12000                           // 64 bit FIFO words per second: 48KHz 16 bit mic samples
+#define VSIMDUCRATE 144000                          // 192KHz 48 bit I/Q samples
+#define VSIMSPKRATE 24000                           // 48KHz 16 bit stereo samples
+
+
+//
+// a simulated stream FIFO
+//
+struct SimFIFO
+{
+    double Occupancy;                               // 64 bit locations occupied
+    double Rate;                                    // locations per second filled (read FIFO) or drained (write FIFO)
+    bool WriteFIFO;                                 // true if written by DMA and read out by the "FPGA"
+    uint32_t Flags;                                 // overflow/over threshold/underflow status bits, cleared by read
+    struct timespec Updated;                        // time occupancy last brought up to date
+    uint64_t Bytes;                                 // bytes moved by DMA
+};
+
+static uint32_t SimRegisters[VSIMREGISTERSPACE / 4];
+static struct SimFIFO SimFIFOs[VNUMDMAFIFO];
+static pthread_mutex_t SimMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t SimReportThread;
+static bool SimRunning = false;
+
+static uint8_t DDCPattern[VSIMPATTERNSIZE];         // DDC data served by DMA reads
+static uint32_t DDCPatternLength = 0;               // bytes valid in DDCPattern; 0 if none
+static uint32_t DDCPatternOffset = 0;               // next byte to serve
+static uint32_t DDCPatternRateWord = 0;             // rate word the pattern was built for
+static uint32_t DDCFrameWords = 0;                  // 64 bit words per frame including header
+static bool DDCFromFile = false;                    // true if serving a recorded file
+static uint64_t DDCSamples = 0;                     // DDC sample words served
+
+static const struct DDCCaptureHeader* Capture = NULL;   // capture being replayed; NULL if none
+static size_t CaptureSize;
+static const struct DDCCaptureBlock* CaptureBlock;  // block being served
+static uint32_t CaptureBlockOffset;                 // next byte to serve in it
+
+
+//
+// bring a FIFO's occupancy up to date, and set its status bits
+// a read FIFO saturates at its depth (overflow); a write FIFO empties (underflow)
+//
+static void UpdateSimFIFO(uint32_t Channel)
+{
+    struct SimFIFO* FIFO = &SimFIFOs[Channel];
+    struct timespec Now;
+    double Elapsed;
+
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    Elapsed = (Now.tv_sec - FIFO->Updated.tv_sec) + (Now.tv_nsec - FIFO->Updated.tv_nsec) * 1.0E-9;
+    FIFO->Updated = Now;
+    if (FIFO->WriteFIFO)
+    {
+        FIFO->Occupancy -= FIFO->Rate * Elapsed;
+        if (FIFO->Occupancy < 0.0)
+        {
+            FIFO->Occupancy = 0.0;
+            FIFO->Flags |= 0x20000000;
+        }
+    }
+    else if (FIFO->Rate != 0.0)
+    {
+        FIFO->Occupancy += FIFO->Rate * Elapsed;
+        if (FIFO->Occupancy > DMAFIFODepths[Channel])
+        {
+            FIFO->Occupancy = DMAFIFODepths[Channel];
+            FIFO->Flags |= 0x80000000;
+        }
+    }
+}
+
+
+//
+// build the generated DDC data for a rate word: as many whole frames as fit the buffer
+// samples are a simple ramp, so the data changes but costs little to make
+//
+static void BuildDDCPattern(uint32_t RateWord)
+{
+    uint32_t Counts[VNUMDDC];
+    uint32_t Frames, Frame, Word;
+    uint64_t* Ptr = (uint64_t*)DDCPattern;
+    uint64_t Sample = 0;
+
+    DDCPatternRateWord = RateWord;
+    DDCFrameWords = AnalyseDDCHeader(RateWord, Counts);
+    DDCFrameWords = (DDCFrameWords == VDDCHEADERINVALID) ? 1 : DDCFrameWords + 1;  // not valid: headers only
+    Frames = VSIMPATTERNSIZE / (8 * DDCFrameWords);
+    for (Frame = 0; Frame < Frames; Frame++)
+    {
+        *Ptr++ = (0x80ULL << 56) | RateWord;
+        for (Word = 1; Word < DDCFrameWords; Word++)
+        {
+            *Ptr++ = (Sample & 0xFFFFFF) | ((~Sample & 0xFFFFFF) << 24);
+            Sample += 0x1111;
+        }
+    }
+    DDCPatternLength = Frames * 8 * DDCFrameWords;
+    DDCPatternOffset = 0;
+    SimFIFOs[eRXDDCDMA].Rate = 0.0;                         // no DDC enabled: no data
+    if (DDCFrameWords > 1)
+        SimFIFOs[eRXDDCDMA].Rate = (double)DDCFrameWords * VSIMDDCFRAMERATE;
+}
+
+
+//
+// set up replay of a capture file
+// returns false if it isn't a capture, or holds no blocks
+//
+static bool LoadDDCCapture(const char* Filename)
+{
+    const struct DDCCaptureBlock* Block;
+    const char* Replay;
+    uint64_t Bytes = 0;
+    uint64_t FirstTime = 0, LastTime = 0;
+    uint32_t Blocks = 0;
+
+    Capture = MapDDCCapture(Filename, &CaptureSize);
+    if (Capture == NULL)
+        return false;
+    for (Block = NextDDCCaptureBlock(Capture, CaptureSize, NULL); Block != NULL;
+         Block = NextDDCCaptureBlock(Capture, CaptureSize, Block))
+    {
+        if (Blocks++ == 0)
+            FirstTime = Block->Time;
+        LastTime = Block->Time;
+        Bytes += Block->Length;
+    }
+    if (Bytes == 0)
+    {
+        Capture = NULL;
+        return false;
+    }
+    CaptureBlock = NextDDCCaptureBlock(Capture, CaptureSize, NULL);
+    CaptureBlockOffset = 0;
+    DDCFromFile = true;
+    DDCFrameWords = 0;
+    Replay = getenv("SATURNSIM_REPLAY");
+    if (((Replay != NULL) && (strcmp(Replay, "max") == 0)) || (LastTime <= FirstTime))
+        SimFIFOs[eRXDDCDMA].Rate = (double)DMAFIFODepths[eRXDDCDMA] * 100.0;   // as fast as this reads it
+    else
+        SimFIFOs[eRXDDCDMA].Rate = (Bytes / 8.0) * 1.0E9 / (LastTime - FirstTime);
+    printf("simulator: replaying %d blocks, %llu bytes from DDC capture %s, rate word %08x, firmware V%d\n",
+           Blocks, (unsigned long long)Bytes, Filename, Capture->RateWord, Capture->FirmwareVersion);
+    return true;
+}
+
+
+//
+// serve DDC data from the capture: the blocks' data, end to end, in a loop
+//
+static void ServeDDCCapture(unsigned char* DestData, uint32_t Length)
+{
+    uint32_t Chunk;
+
+    while (Length != 0)
+    {
+        Chunk = CaptureBlock->Length - CaptureBlockOffset;
+        if (Chunk > Length)
+            Chunk = Length;
+        memcpy(DestData, (const uint8_t*)(CaptureBlock + 1) + CaptureBlockOffset, Chunk);
+        DestData += Chunk;
+        Length -= Chunk;
+        CaptureBlockOffset += Chunk;
+        DDCSamples += Chunk / 8;
+        if (CaptureBlockOffset >= CaptureBlock->Length)
+        {
+            CaptureBlockOffset = 0;
+            CaptureBlock = NextDDCCaptureBlock(Capture, CaptureSize, CaptureBlock);
+            if (CaptureBlock == NULL)
+                CaptureBlock = NextDDCCaptureBlock(Capture, CaptureSize, NULL);
+        }
+    }
+}
+
+
+//
+// load a recorded DDC file: a capture, or else raw DMA data served from the start, in a loop
+//
+static void LoadDDCFile(const char* Filename)
+{
+    FILE* File;
+    size_t Length;
+
+    if (LoadDDCCapture(Filename))
+        return;
+    File = fopen(Filename, "rb");
+    if (File == NULL)
+    {
+        perror("simulator: open DDC file; using generated data");
+        return;
+    }
+    Length = fread(DDCPattern, 1, VSIMPATTERNSIZE, File);
+    fclose(File);
+    Length &= ~7UL;
+    if (Length == 0)
+        return;
+    DDCPatternLength = (uint32_t)Length;
+    DDCPatternOffset = 0;
+    DDCFromFile = true;
+    DDCFrameWords = 0;
+    SimFIFOs[eRXDDCDMA].Rate = (double)DMAFIFODepths[eRXDDCDMA] * 100.0;     // rate unknown: as fast as this reads it
+    printf("simulator: serving %u bytes of DDC data from %s\n", DDCPatternLength, Filename);
+}
+
+
+//
+// copy DDC data to a DMA destination, from the pattern or file
+//
+static void ServeDDCData(unsigned char* DestData, uint32_t Length)
+{
+    uint32_t Chunk;
+
+    if (Capture != NULL)
+    {
+        ServeDDCCapture(DestData, Length);
+        return;
+    }
+    if (DDCPatternLength == 0)
+    {
+        memset(DestData, 0, Length);
+        return;
+    }
+    while (Length != 0)
+    {
+        Chunk = DDCPatternLength - DDCPatternOffset;
+        if (Chunk > Length)
+            Chunk = Length;
+        memcpy(DestData, DDCPattern + DDCPatternOffset, Chunk);
+        DestData += Chunk;
+        Length -= Chunk;
+        DDCPatternOffset += Chunk;
+        if (DDCPatternOffset >= DDCPatternLength)
+            DDCPatternOffset = 0;
+        if (DDCFrameWords > 1)
+            DDCSamples += (Chunk / 8) * (DDCFrameWords - 1) / DDCFrameWords;
+        else if (DDCFromFile)
+            DDCSamples += Chunk / 8;
+    }
+}
+
+
+//
+// throughput report thread
+//
+static void* SimReport(void* arg)
+{
+    static const char* Names[VNUMDMAFIFO] = {"DDC", "DUC", "mic", "speaker"};
+    uint64_t PrevBytes[VNUMDMAFIFO] = {0};
+    uint64_t PrevSamples = 0, Samples;
+    double PrevCPU = 0.0, CPU;
+    struct rusage Usage;
+    uint32_t Channel;
+    uint64_t Bytes;
+
+    (void)arg;
+    while (true)
+    {
+        sleep(VSIMREPORTPERIOD);
+        getrusage(RUSAGE_SELF, &Usage);
+        CPU = Usage.ru_utime.tv_sec + Usage.ru_stime.tv_sec + (Usage.ru_utime.tv_usec + Usage.ru_stime.tv_usec) * 1.0E-6;
+        pthread_mutex_lock(&SimMutex);
+        Samples = DDCSamples;
+        printf("simulator:");
+        for (Channel = 0; Channel < VNUMDMAFIFO; Channel++)
+        {
+            Bytes = SimFIFOs[Channel].Bytes;
+            printf(" %s %.3fMB/s", Names[Channel], (Bytes - PrevBytes[Channel]) / (VSIMREPORTPERIOD * 1.0E6));
+            PrevBytes[Channel] = Bytes;
+        }
+        pthread_mutex_unlock(&SimMutex);
+        printf("; CPU %.1f%%", 100.0 * (CPU - PrevCPU) / VSIMREPORTPERIOD);
+        if (Samples != PrevSamples)
+            printf(", %.3f Msamples/s, %.1fns CPU per DDC sample", (Samples - PrevSamples) / (VSIMREPORTPERIOD * 1.0E6),
+                   1.0E9 * (CPU - PrevCPU) / (Samples - PrevSamples));
+        printf("\n");
+        PrevSamples = Samples;
+        PrevCPU = CPU;
+    }
+    return NULL;
+}
+
+
+//
+// there is one simulated board; the card number is recorded but all cards are the same
+//
+static uint32_t SimCard = 0;
+
+bool SelectXDMACard(uint32_t Card)
+{
+    if (Card >= VMAXXDMACARDS)
+        return false;
+    SimCard = Card;
+    return true;
+}
+
+
+uint32_t GetXDMACard(void)
+{
+    return SimCard;
+}
+
+
+const char* GetXDMADeviceName(const char* Device, char* Name, uint32_t Length)
+{
+    uint32_t PrefixLength = strlen(VXDMADEVICEPREFIX) - 2;
+
+    if (strncmp(Device, VXDMADEVICEPREFIX, PrefixLength + 2) == 0)
+        snprintf(Name, Length, "%.*s%u%s", (int)PrefixLength, Device, SimCard, Device + PrefixLength + 1);
+    else
+        snprintf(Name, Length, "%s", Device);
+    return Name;
+}
+
+
+//
+// open connection to the simulated hardware
+//
+int OpenXDMADriver(bool Silent)
+{
+	return OpenXDMADriverMapped(Silent, false);
+}
+
+
+//
+// open the simulated hardware: set up the registers that identify the board, and the FIFOs
+// both access modes are the same here
+//
+int OpenXDMADriverMapped(bool Silent, bool UseMmap)
+{
+    uint32_t Channel;
+    const char* Filename;
+    int Error;
+
+    (void)UseMmap;
+    if (SimRunning)
+        return 1;
+    SimRegisters[0xC000 / 4] = VSIMSWVERSION;
+    SimRegisters[0xC004 / 4] = VSIMPRODVERSION;
+    ProbeFPGACapabilities();
+    SimRegisters[VADDRSTATUSREG / 4] = VSIMSTATUSIDLE;
+    SimRegisters[VADDRFIFORESET / 4] = 0xFFFFFFFF;          // no FIFO held in reset
+    for (Channel = 0; Channel < VNUMDMAFIFO; Channel++)
+        clock_gettime(CLOCK_MONOTONIC, &SimFIFOs[Channel].Updated);
+    SimFIFOs[eTXDUCDMA].WriteFIFO = true;
+    SimFIFOs[eSpkCodecDMA].WriteFIFO = true;
+    SimFIFOs[eMicCodecDMA].Rate = VSIMMICRATE;
+    SimFIFOs[eTXDUCDMA].Rate = VSIMDUCRATE;
+    SimFIFOs[eSpkCodecDMA].Rate = VSIMSPKRATE;
+    Filename = getenv("SATURNSIM_DDCFILE");
+    if (Filename != NULL)
+        LoadDDCFile(Filename);
+    Error = pthread_create(&SimReportThread, NULL, SimReport, NULL);
+    if (Error != 0)
+        printf("pthread_create simulator report: %s\n", strerror(Error));
+    else
+        pthread_detach(SimReportThread);
+    SimRunning = true;
+    if (!Silent)
+        printf("register access connected to simulated Saturn hardware\n");
+    return 1;
+}
+
+
+//
+// close connection
+//
+void CloseXDMADriver(void)
+{
+}
+
+
+//
+// open a DMA or event device. Simulated streams ignore the file descriptor,
+// so the DMA devices are opened as /dev/null; event devices are not simulated
+//
+int OpenDMADevice(const char* Device, int Flags)
+{
+    if (strstr(Device, "events") != NULL)
+    {
+        errno = ENODEV;
+        return -1;
+    }
+    return open("/dev/null", Flags);
+}
+
+
+//
+// no driver to poll in the simulator
+//
+int SetDMAPollWindow(int fd, uint32_t Microseconds)
+{
+    (void)fd;
+    (void)Microseconds;
+    return 0;
+}
+
+
+//
+// DMA to the simulated FPGA: adds to the DUC or speaker FIFO
+//
+int DMAWriteToFPGA(int fd, unsigned char*SrcData, uint32_t Length, uint32_t AXIAddr)
+{
+    uint32_t Channel;
+
+    (void)fd;
+    (void)SrcData;
+    Channel = (AXIAddr == VADDRSPKRSTREAMWRITE) ? eSpkCodecDMA : eTXDUCDMA;
+    pthread_mutex_lock(&SimMutex);
+    UpdateSimFIFO(Channel);
+    SimFIFOs[Channel].Occupancy += Length / 8;
+    if (SimFIFOs[Channel].Occupancy > DMAFIFODepths[Channel])
+    {
+        SimFIFOs[Channel].Occupancy = DMAFIFODepths[Channel];
+        SimFIFOs[Channel].Flags |= 0x80000000;
+    }
+    SimFIFOs[Channel].Bytes += Length;
+    pthread_mutex_unlock(&SimMutex);
+    return 0;
+}
+
+
+//
+// DMA from the simulated FPGA: DDC or mic data, taken from the FIFO
+//
+int DMAReadFromFPGA(int fd, unsigned char*DestData, uint32_t Length, uint32_t AXIAddr)
+{
+    uint32_t Channel;
+
+    (void)fd;
+    if (AXIAddr == VADDRWIDEBANDREAD)
+    {
+        memset(DestData, 0, Length);
+        return 0;
+    }
+    Channel = (AXIAddr == VADDRMICSTREAMREAD) ? eMicCodecDMA : eRXDDCDMA;
+    pthread_mutex_lock(&SimMutex);
+    UpdateSimFIFO(Channel);
+    SimFIFOs[Channel].Occupancy -= Length / 8;
+    if (SimFIFOs[Channel].Occupancy < 0.0)
+    {
+        SimFIFOs[Channel].Occupancy = 0.0;
+        SimFIFOs[Channel].Flags |= 0x20000000;
+    }
+    SimFIFOs[Channel].Bytes += Length;
+    if (Channel == eRXDDCDMA)
+        ServeDDCData(DestData, Length);
+    else
+        memset(DestData, 0, Length);
+    pthread_mutex_unlock(&SimMutex);
+    return 0;
+}
+
+
+//
+// vectored DMA from the simulated FPGA: one read per block
+//
+int DMAReadVectorFromFPGA(int fd, struct DMAVector* Vector, uint32_t Count)
+{
+    uint32_t Cntr;
+
+    if ((Count == 0) || (Count > VMAXDMAVECTOR))
+        return -EINVAL;
+    for (Cntr = 0; Cntr < Count; Cntr++)
+        DMAReadFromFPGA(fd, Vector[Cntr].Data, Vector[Cntr].Length, Vector[Cntr].AXIAddr);
+    return 0;
+}
+
+
+//
+// no AXI-Stream channels in the simulator: EOP reads are not available
+//
+int SetDMAEOPRead(int fd, bool Enable)
+{
+    (void)fd;
+    (void)Enable;
+    return -EINVAL;
+}
+
+
+int GetDMATimestamps(int fd, struct DMATimestamps* Times)
+{
+    (void)fd;
+    (void)Times;
+    return -ENOTTY;
+}
+
+
+int32_t DMAReadPacketFromFPGA(int fd, unsigned char*DestData, uint32_t MaxLength)
+{
+    (void)fd;
+    (void)DestData;
+    (void)MaxLength;
+    return -EINVAL;
+}
+
+
+//
+// no driver DMA buffer in the simulator: reported as an older driver,
+// so streams use a user memory ring
+//
+int AllocateDriverDMABuffer(int fd, uint32_t Size)
+{
+    (void)fd;
+    (void)Size;
+    return -ENOTTY;
+}
+
+
+void FreeDriverDMABuffer(int fd)
+{
+    (void)fd;
+}
+
+
+int DMABufferReadFromFPGA(int fd, uint32_t Offset, uint32_t Length, uint32_t AXIAddr)
+{
+    (void)fd;
+    (void)Offset;
+    (void)Length;
+    (void)AXIAddr;
+    return -ENOTTY;
+}
+
+
+//
+// simulated asynchronous DMA: each DMA is done at submit, and reaped later
+//
+bool OpenAsyncDMA(struct AsyncDMAQueue* Queue, int fd, uint32_t Depth)
+{
+    memset(Queue, 0, sizeof(*Queue));
+    if ((Depth == 0) || (Depth > VMAXASYNCDMA))
+        return true;
+    Queue->fd = fd;
+    Queue->Depth = Depth;
+    Queue->Context = 1;
+    return false;
+}
+
+
+static int SubmitAsyncDMA(struct AsyncDMAQueue* Queue, bool Write, unsigned char* Data, uint32_t Length, uint32_t AXIAddr, void* Tag)
+{
+    uint32_t Index;
+    int Result;
+
+    if (Queue->InFlight >= Queue->Depth)
+        return -EBUSY;
+    for (Index = 0; Queue->RequestBusy[Index]; Index++)
+        ;
+    if (Write)
+        Result = DMAWriteToFPGA(Queue->fd, Data, Length, AXIAddr);
+    else
+        Result = DMAReadFromFPGA(Queue->fd, Data, Length, AXIAddr);
+    Queue->Results[Index] = (Result < 0) ? Result : (int64_t)Length;
+    Queue->Requests[Index].aio_data = Queue->InFlight;             // submit order
+    Queue->Tags[Index] = Tag;
+    Queue->RequestBusy[Index] = true;
+    Queue->InFlight++;
+    return 0;
+}
+
+
+int SubmitAsyncDMARead(struct AsyncDMAQueue* Queue, unsigned char* DestData, uint32_t Length, uint32_t AXIAddr, void* Tag)
+{
+    return SubmitAsyncDMA(Queue, false, DestData, Length, AXIAddr, Tag);
+}
+
+
+int SubmitAsyncDMAWrite(struct AsyncDMAQueue* Queue, unsigned char* SrcData, uint32_t Length, uint32_t AXIAddr, void* Tag)
+{
+    return SubmitAsyncDMA(Queue, true, SrcData, Length, AXIAddr, Tag);
+}
+
+
+//
+// reaps in submit order, as the hardware completes them
+//
+uint32_t PollAsyncDMA(struct AsyncDMAQueue* Queue, struct AsyncDMACompletion* Done, uint32_t Max, uint32_t TimeoutUs)
+{
+    uint32_t Count = 0;
+    uint32_t Index;
+
+    (void)TimeoutUs;
+    while ((Count < Max) && (Queue->InFlight != 0))
+    {
+        for (Index = 0; Index < VMAXASYNCDMA; Index++)
+            if (Queue->RequestBusy[Index] && (Queue->Requests[Index].aio_data == 0))
+                break;
+        Done[Count].Tag = Queue->Tags[Index];
+        Done[Count].Result = Queue->Results[Index];
+        Queue->RequestBusy[Index] = false;
+        Queue->InFlight--;
+        Count++;
+        for (Index = 0; Index < VMAXASYNCDMA; Index++)
+            if (Queue->RequestBusy[Index])
+                Queue->Requests[Index].aio_data--;
+    }
+    return Count;
+}
+
+
+void CloseAsyncDMA(struct AsyncDMAQueue* Queue)
+{
+    memset(Queue, 0, sizeof(*Queue));
+}
+
+
+//
+// simulated register read
+// the FIFO monitor status registers return the modelled occupancy
+//
+uint32_t RegisterRead(uint32_t Address)
+{
+    uint32_t Result = 0;
+    uint32_t Channel;
+
+    if ((Address >= VADDRFIFOMONBASE) && (Address < VADDRFIFOMONBASE + 4 * VNUMDMAFIFO))
+    {
+        Channel = (Address - VADDRFIFOMONBASE) / 4;
+        pthread_mutex_lock(&SimMutex);
+        UpdateSimFIFO(Channel);
+        Result = ((uint32_t)SimFIFOs[Channel].Occupancy & 0xFFFF) | SimFIFOs[Channel].Flags;
+        SimFIFOs[Channel].Flags = 0;
+        pthread_mutex_unlock(&SimMutex);
+    }
+    else if (Address < VSIMREGISTERSPACE)
+        Result = __atomic_load_n(&SimRegisters[Address / 4], __ATOMIC_RELAXED);
+    return Result;
+}
+
+
+//
+// simulated block of register reads
+//
+void RegisterReadBlock(uint32_t Address, uint32_t* Data, uint32_t Count)
+{
+	uint32_t Cntr;
+
+	for (Cntr = 0; Cntr < Count; Cntr++)
+		Data[Cntr] = RegisterRead(Address + 4 * Cntr);
+}
+
+
+//
+// simulated register writes are never buffered
+//
+void RegisterWriteFence(void)
+{
+}
+
+
+//
+// simulated block of register writes
+//
+void RegisterWriteBlock(uint32_t Address, const uint32_t* Data, uint32_t Count)
+{
+	uint32_t Cntr;
+
+	for (Cntr = 0; Cntr < Count; Cntr++)
+		RegisterWrite(Address + 4 * Cntr, Data[Cntr]);
+}
+
+
+//
+// simulated register write
+// a FIFO reset bit written low empties that FIFO; a new DDC rate word changes the DDC data
+//
+void RegisterWrite(uint32_t Address, uint32_t Data)
+{
+    static const uint32_t ResetBits[VNUMDMAFIFO] =
+        {VBITDDCFIFORESET, VBITDUCFIFORESET, VBITCODECMICFIFORESET, VBITCODECSPKFIFORESET};
+    uint32_t Channel;
+
+    if ((Address >= VADDRFIFOMONBASE) && (Address < VADDRFIFOMONBASE + 4 * VNUMDMAFIFO))
+        return;                                                 // status registers are read only
+    if (Address == VADDRFIFORESET)
+    {
+        pthread_mutex_lock(&SimMutex);
+        for (Channel = 0; Channel < VNUMDMAFIFO; Channel++)
+            if ((Data & (1U << ResetBits[Channel])) == 0)
+            {
+                UpdateSimFIFO(Channel);
+                SimFIFOs[Channel].Occupancy = 0.0;
+                SimFIFOs[Channel].Flags = 0;
+                if (Channel == eRXDDCDMA)
+                    DDCPatternOffset = 0;                       // restart on a frame boundary
+            }
+        pthread_mutex_unlock(&SimMutex);
+    }
+    else if ((Address == VADDRDDCRATES) && !DDCFromFile && (Data != DDCPatternRateWord))
+    {
+        pthread_mutex_lock(&SimMutex);
+        UpdateSimFIFO(eRXDDCDMA);
+        BuildDDCPattern(Data);
+        pthread_mutex_unlock(&SimMutex);
+    }
+    if (Address < VSIMREGISTERSPACE)
+        __atomic_store_n(&SimRegisters[Address / 4], Data, __ATOMIC_RELAXED);
+}
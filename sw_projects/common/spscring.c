@@ -0,0 +1,117 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 1 
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// spscring.c:
+// lock-free single producer, single consumer ring index
+//
+// the indexes are free running and wrap at 2^32; the slot number is
+// the index modulo the ring size. Release/acquire ordering makes sure
+// the slot data written by one thread is visible to the other before
+// the index change is.
+//
+//////////////////////////////////////////////////////////////
+
+#include "../common/spscring.h"
+
+
+//
+// void SPSCInitialise(struct SPSCRing* Ring, uint32_t Size)
+// initialise a ring to empty
+//
+void SPSCInitialise(struct SPSCRing* Ring, uint32_t Size)
+{
+    atomic_store(&Ring->WriteIndex, 0);
+    atomic_store(&Ring->ReadIndex, 0);
+    Ring->Size = Size;
+}
+
+
+//
+// int32_t SPSCGetWriteSlot(struct SPSCRing* Ring)
+// producer: get the next slot to fill, or -1 if full
+//
+int32_t SPSCGetWriteSlot(struct SPSCRing* Ring)
+{
+    uint32_t Write, Read;
+
+    Write = atomic_load_explicit(&Ring->WriteIndex, memory_order_relaxed);
+    Read = atomic_load_explicit(&Ring->ReadIndex, memory_order_acquire);
+    if ((Write - Read) >= Ring->Size)
+        return -1;
+    return (int32_t)(Write & (Ring->Size - 1));
+}
+
+
+//
+// int32_t SPSCGetWriteSlotAhead(struct SPSCRing* Ring, uint32_t Ahead)
+// producer: get the free slot Ahead beyond the next to fill, or -1 if not free
+//
+int32_t SPSCGetWriteSlotAhead(struct SPSCRing* Ring, uint32_t Ahead)
+{
+    uint32_t Write, Read;
+
+    Write = atomic_load_explicit(&Ring->WriteIndex, memory_order_relaxed);
+    Read = atomic_load_explicit(&Ring->ReadIndex, memory_order_acquire);
+    if ((Write + Ahead - Read) >= Ring->Size)
+        return -1;
+    return (int32_t)((Write + Ahead) & (Ring->Size - 1));
+}
+
+
+//
+// void SPSCPublish(struct SPSCRing* Ring)
+// producer: pass the slot to the consumer
+//
+void SPSCPublish(struct SPSCRing* Ring)
+{
+    uint32_t Write;
+
+    Write = atomic_load_explicit(&Ring->WriteIndex, memory_order_relaxed);
+    atomic_store_explicit(&Ring->WriteIndex, Write + 1, memory_order_release);
+}
+
+
+//
+// int32_t SPSCGetReadSlot(struct SPSCRing* Ring)
+// consumer: get the oldest published slot, or -1 if empty
+//
+int32_t SPSCGetReadSlot(struct SPSCRing* Ring)
+{
+    uint32_t Write, Read;
+
+    Read = atomic_load_explicit(&Ring->ReadIndex, memory_order_relaxed);
+    Write = atomic_load_explicit(&Ring->WriteIndex, memory_order_acquire);
+    if (Write == Read)
+        return -1;
+    return (int32_t)(Read & (Ring->Size - 1));
+}
+
+
+//
+// void SPSCRelease(struct SPSCRing* Ring)
+// consumer: return the slot to the producer
+//
+void SPSCRelease(struct SPSCRing* Ring)
+{
+    uint32_t Read;
+
+    Read = atomic_load_explicit(&Ring->ReadIndex, memory_order_relaxed);
+    atomic_store_explicit(&Ring->ReadIndex, Read + 1, memory_order_release);
+}
+
+
+//
+// uint32_t SPSCOccupancy(struct SPSCRing* Ring)
+// number of published slots not yet released
+//
+uint32_t SPSCOccupancy(struct SPSCRing* Ring)
+{
+    return atomic_load_explicit(&Ring->WriteIndex, memory_order_acquire)
+         - atomic_load_explicit(&Ring->ReadIndex, memory_order_acquire);
+}
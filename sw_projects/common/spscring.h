@@ -0,0 +1,88 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 1 
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// spscring.h:
+// header file. lock-free single producer, single consumer ring index
+//
+// the ring holds only the read and write indexes; the caller owns the
+// data array (one entry per slot) and uses the slot numbers returned here.
+// one thread only may call the producer functions, and one thread only
+// may call the consumer functions.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __spscring_h
+#define __spscring_h
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "../common/saturntypes.h"
+
+
+struct SPSCRing
+{
+    atomic_uint WriteIndex;                     // free running count of slots published (producer only)
+    atomic_uint ReadIndex;                      // free running count of slots released (consumer only)
+    uint32_t Size;                              // number of slots. Must be a power of 2
+};
+
+
+//
+// void SPSCInitialise(struct SPSCRing* Ring, uint32_t Size)
+// initialise a ring to empty. Must not be called while either thread is using it.
+//   Size:   number of slots; must be a power of 2
+//
+void SPSCInitialise(struct SPSCRing* Ring, uint32_t Size);
+
+
+//
+// int32_t SPSCGetWriteSlot(struct SPSCRing* Ring)
+// producer: get the next slot to fill
+// returns the slot number, or -1 if the ring is full
+//
+int32_t SPSCGetWriteSlot(struct SPSCRing* Ring);
+
+
+//
+// int32_t SPSCGetWriteSlotAhead(struct SPSCRing* Ring, uint32_t Ahead)
+// producer: get a free slot Ahead slots beyond the next one to fill (0 = as SPSCGetWriteSlot)
+// so several can be filled at once, then published in order
+// returns the slot number, or -1 if the ring hasn't that many free slots
+//
+int32_t SPSCGetWriteSlotAhead(struct SPSCRing* Ring, uint32_t Ahead);
+//
+// void SPSCPublish(struct SPSCRing* Ring)
+// producer: pass the slot from SPSCGetWriteSlot() to the consumer
+//
+void SPSCPublish(struct SPSCRing* Ring);
+
+
+//
+// int32_t SPSCGetReadSlot(struct SPSCRing* Ring)
+// consumer: get the oldest published slot
+// returns the slot number, or -1 if the ring is empty
+//
+int32_t SPSCGetReadSlot(struct SPSCRing* Ring);
+
+
+//
+// void SPSCRelease(struct SPSCRing* Ring)
+// consumer: return the slot from SPSCGetReadSlot() to the producer
+//
+void SPSCRelease(struct SPSCRing* Ring);
+
+
+//
+// uint32_t SPSCOccupancy(struct SPSCRing* Ring)
+// number of published slots not yet released. Can be called from either thread.
+//
+uint32_t SPSCOccupancy(struct SPSCRing* Ring);
+
+
+#endif
@@ -0,0 +1,165 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 1 
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// stagetrace.c:
+// optional per stage latency tracing; compiled only if STAGETRACE is defined
+// each thread writes its own ring, so no lock is taken to record an event.
+//
+//////////////////////////////////////////////////////////////
+
+#include "../common/stagetrace.h"
+#include "../common/hwaccess.h"
+
+#ifdef STAGETRACE
+
+#include <stdio.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <time.h>
+#include <syscall.h>
+
+
+struct TraceEvent
+{
+    const char* Name;
+    uint64_t Start;                             // ns
+    uint32_t Duration;                          // ns
+    uint32_t Arg;
+};
+
+struct TraceRing
+{
+    struct TraceEvent Events[VTRACERINGSIZE];
+    uint32_t Written;                           // events written since the last dump; wraps to overwrite the oldest
+    long ThreadId;
+};
+
+static struct TraceRing TraceRings[VTRACEMAXTHREADS];
+static atomic_uint TraceRingsClaimed = 0;       // rings handed out to threads
+static __thread struct TraceRing* ThreadTraceRing = NULL;
+
+
+//
+// uint64_t StageTraceNow(void)
+// return CLOCK_MONOTONIC_RAW time in ns
+//
+uint64_t StageTraceNow(void)
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &Now);
+    return (uint64_t)Now.tv_sec * 1000000000ULL + (uint64_t)Now.tv_nsec;
+}
+
+
+//
+// record a stage into the calling thread's ring, claiming one on first use
+//
+static void StageTraceAdd(const char* Name, uint64_t Start, uint64_t Duration, uint32_t Arg)
+{
+    struct TraceRing* Ring;
+    struct TraceEvent* Event;
+    uint32_t RingNum;
+
+    if (ThreadTraceRing == NULL)
+    {
+        RingNum = atomic_fetch_add(&TraceRingsClaimed, 1);
+        if (RingNum >= VTRACEMAXTHREADS)
+            return;
+        ThreadTraceRing = &TraceRings[RingNum];
+        ThreadTraceRing->ThreadId = syscall(SYS_gettid);
+    }
+    Ring = ThreadTraceRing;
+    Event = &Ring->Events[Ring->Written & (VTRACERINGSIZE - 1)];
+    Event->Name = Name;
+    Event->Start = Start;
+    Event->Duration = (Duration > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)Duration;
+    Event->Arg = Arg;
+    Ring->Written++;
+}
+
+
+//
+// void StageTraceRecord(const char* Name, uint64_t Start, uint32_t Arg)
+// record a stage from Start to now
+//
+void StageTraceRecord(const char* Name, uint64_t Start, uint32_t Arg)
+{
+    StageTraceAdd(Name, Start, StageTraceNow() - Start, Arg);
+}
+
+
+//
+// void StageTraceDMA(int fd)
+// the driver timestamps are CLOCK_MONOTONIC_RAW, as StageTraceNow()
+//
+void StageTraceDMA(int fd)
+{
+    struct DMATimestamps Times;
+    uint64_t Now = StageTraceNow();
+    uint64_t Started;
+
+    if ((GetDMATimestamps(fd, &Times) != 0) || (Times.Complete == 0) || (Times.Complete > Now))
+        return;
+    Started = (Times.Start != 0) ? Times.Start : Times.Submit;
+    if (Started > Times.Submit)
+        StageTraceAdd("dma queued", Times.Submit, Started - Times.Submit, (uint32_t)Times.Bytes);
+    StageTraceAdd("dma engine", Started, Times.Complete - Started, (uint32_t)Times.Bytes);
+    StageTraceAdd("dma wakeup", Times.Complete, Now - Times.Complete, (uint32_t)Times.Sequence);
+}
+
+
+//
+// void StageTraceDump(const char* Filename)
+// write every thread's events as Chrome trace event JSON ("complete" events, times in us)
+//
+void StageTraceDump(const char* Filename)
+{
+    FILE* File;
+    uint32_t RingNum, Claimed, Count, Cntr, First;
+    struct TraceRing* Ring;
+    struct TraceEvent* Event;
+    bool FirstEvent = true;
+
+    File = fopen(Filename, "w");
+    if (File == NULL)
+    {
+        perror("open trace file");
+        return;
+    }
+    Claimed = atomic_load(&TraceRingsClaimed);
+    if (Claimed > VTRACEMAXTHREADS)
+        Claimed = VTRACEMAXTHREADS;
+    fprintf(File, "{\"traceEvents\":[\n");
+    for (RingNum = 0; RingNum < Claimed; RingNum++)
+    {
+        Ring = &TraceRings[RingNum];
+        Count = Ring->Written;
+        First = 0;
+        if (Count > VTRACERINGSIZE)
+        {
+            First = Count - VTRACERINGSIZE;
+            Count = VTRACERINGSIZE;
+        }
+        for (Cntr = 0; Cntr < Count; Cntr++)
+        {
+            Event = &Ring->Events[(First + Cntr) & (VTRACERINGSIZE - 1)];
+            fprintf(File, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%ld,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"n\":%u}}",
+                    FirstEvent ? "" : ",\n", Event->Name, (int)getpid(), Ring->ThreadId,
+                    Event->Start / 1000.0, Event->Duration / 1000.0, Event->Arg);
+            FirstEvent = false;
+        }
+        Ring->Written = 0;
+    }
+    fprintf(File, "\n]}\n");
+    fclose(File);
+    printf("stage trace written to %s\n", Filename);
+}
+
+#endif
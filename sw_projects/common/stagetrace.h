@@ -0,0 +1,91 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 1 
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// stagetrace.h:
+// header file. optional per stage latency tracing for the stream threads
+//
+// each traced stage records its start time and duration, read from
+// CLOCK_MONOTONIC_RAW, into a ring owned by the calling thread; the
+// most recent events are kept. StageTraceDump() writes them all in
+// Chrome trace event JSON, to be loaded into chrome://tracing or Perfetto.
+//
+// tracing is only compiled in if STAGETRACE is defined (make TRACE=1).
+// otherwise the macros expand to nothing, and no code or data remains.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __stagetrace_h
+#define __stagetrace_h
+
+#include <stdint.h>
+#include "../common/saturntypes.h"
+
+
+#define VTRACERINGSIZE 16384                    // events kept per thread (power of 2)
+#define VTRACEMAXTHREADS 16                     // threads that can trace
+#define VTRACEFILE "/tmp/p2app-trace.json"      // trace dump file
+
+
+#ifdef STAGETRACE
+
+//
+// STAGETRACE_START(Start): declare a variable Start holding the stage start time
+// STAGETRACE_END(Start, Name, Arg): record a stage that began at Start
+//   Name:  stage name; must be a literal, or otherwise outlive the trace
+//   Arg:   one value saved with the event (eg a byte or packet count)
+// STAGETRACE_DMA(fd): record the driver's timing of the last DMA on the device
+//   (queued in the driver, on the engine, and wakeup); call before the DMA stage ends
+// STAGETRACE_DUMP(): write all threads' events to VTRACEFILE, and empty the rings
+//
+#define STAGETRACE_START(Start) uint64_t Start = StageTraceNow()
+#define STAGETRACE_END(Start, Name, Arg) StageTraceRecord(Name, Start, Arg)
+#define STAGETRACE_DMA(fd) StageTraceDMA(fd)
+#define STAGETRACE_DUMP() StageTraceDump(VTRACEFILE)
+
+
+//
+// uint64_t StageTraceNow(void)
+// return CLOCK_MONOTONIC_RAW time in ns
+//
+uint64_t StageTraceNow(void);
+
+
+//
+// void StageTraceRecord(const char* Name, uint64_t Start, uint32_t Arg)
+// record a stage from Start to now into the calling thread's ring
+//
+void StageTraceRecord(const char* Name, uint64_t Start, uint32_t Arg);
+
+
+//
+// void StageTraceDMA(int fd)
+// record the last DMA on a device as 3 stages from the driver timestamps:
+// "dma queued" (submit to engine start), "dma engine" (start to completion)
+// and "dma wakeup" (completion to now). Nothing is recorded without driver support.
+//
+void StageTraceDMA(int fd);
+
+
+//
+// void StageTraceDump(const char* Filename)
+// write the events from every thread as Chrome trace event JSON.
+// the traced threads should be idle: their rings are read without locking.
+//
+void StageTraceDump(const char* Filename);
+
+#else
+
+#define STAGETRACE_START(Start)
+#define STAGETRACE_END(Start, Name, Arg)
+#define STAGETRACE_DMA(fd)
+#define STAGETRACE_DUMP()
+
+#endif
+
+#endif
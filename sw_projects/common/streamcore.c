@@ -0,0 +1,390 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 1 
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// streamcore.c:
+// streaming core shared by the protocol 1 and protocol 2 apps:
+// mirrored ring buffers, FPGA DMA sources and sinks, and a UDP packetiser
+//
+//////////////////////////////////////////////////////////////
+
+#include "../common/streamcore.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <endian.h>
+#include <sys/mman.h>
+#include "../common/saturndrivers.h"
+#include "../common/hwaccess.h"
+
+
+//
+// create a mirrored ring
+// a memfd holds the ring memory. An address range twice the ring size is reserved,
+// then the memfd is mapped into both halves of it.
+//
+bool StreamRingCreate(struct StreamRing* Ring, uint32_t Size, const char* Name)
+{
+    uint32_t PageSize;
+    uint32_t RingSize;
+    int fd;
+    uint8_t* Addr;
+
+    memset(Ring, 0, sizeof(*Ring));
+    PageSize = (uint32_t)sysconf(_SC_PAGESIZE);
+    RingSize = PageSize;
+    while(RingSize < Size)
+        RingSize <<= 1;
+
+    fd = memfd_create(Name, MFD_CLOEXEC);
+    if(fd < 0)
+    {
+        perror("memfd_create");
+        printf("%s ring buffer could not be created\n", Name);
+        return false;
+    }
+    if(ftruncate(fd, RingSize) != 0)
+    {
+        perror("ftruncate");
+        close(fd);
+        return false;
+    }
+    Addr = mmap(NULL, 2 * (size_t)RingSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(Addr == MAP_FAILED)
+    {
+        perror("mmap");
+        close(fd);
+        return false;
+    }
+    if((mmap(Addr, RingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+       || (mmap(Addr + RingSize, RingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED))
+    {
+        perror("mmap");
+        printf("%s ring buffer could not be mapped\n", Name);
+        munmap(Addr, 2 * (size_t)RingSize);
+        close(fd);
+        return false;
+    }
+    close(fd);                                      // the mappings keep the memory
+    memset(Addr, 0, RingSize);
+    mlock(Addr, 2 * (size_t)RingSize);              // best effort: DMA target
+    Ring->Base = Addr;
+    Ring->Size = RingSize;
+    Ring->DMAfd = -1;
+    return true;
+}
+
+
+//
+// create a mirrored ring in the driver DMA buffer of a device
+// as StreamRingCreate(), but the device is mapped into both halves
+//
+bool StreamRingCreateDMA(struct StreamRing* Ring, uint32_t Size, int DMAfd, const char* Name)
+{
+    uint32_t PageSize;
+    uint32_t RingSize;
+    uint8_t* Addr;
+
+    memset(Ring, 0, sizeof(*Ring));
+    Ring->DMAfd = -1;
+    PageSize = (uint32_t)sysconf(_SC_PAGESIZE);
+    RingSize = PageSize;
+    while(RingSize < Size)
+        RingSize <<= 1;
+
+    if(AllocateDriverDMABuffer(DMAfd, RingSize) != 0)
+        return false;
+    Addr = mmap(NULL, 2 * (size_t)RingSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(Addr == MAP_FAILED)
+    {
+        FreeDriverDMABuffer(DMAfd);
+        return false;
+    }
+    if((mmap(Addr, RingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, DMAfd, 0) == MAP_FAILED)
+       || (mmap(Addr + RingSize, RingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, DMAfd, 0) == MAP_FAILED))
+    {
+        perror("mmap");
+        printf("%s driver DMA buffer could not be mapped\n", Name);
+        munmap(Addr, 2 * (size_t)RingSize);
+        FreeDriverDMABuffer(DMAfd);
+        return false;
+    }
+    memset(Addr, 0, RingSize);
+    Ring->Base = Addr;
+    Ring->Size = RingSize;
+    Ring->DMAfd = DMAfd;
+    return true;
+}
+
+
+//
+// unmap the ring memory
+//
+void StreamRingDestroy(struct StreamRing* Ring)
+{
+    if(Ring->Base)
+    {
+        munmap(Ring->Base, 2 * (size_t)Ring->Size);
+        if(Ring->DMAfd >= 0)
+            FreeDriverDMABuffer(Ring->DMAfd);   // (freed once unmapped)
+    }
+    Ring->Base = NULL;
+    Ring->DMAfd = -1;
+}
+
+
+//
+// discard the ring contents
+//
+void StreamRingReset(struct StreamRing* Ring)
+{
+    Ring->ReadCount = 0;
+    Ring->WriteCount = 0;
+}
+
+
+//
+// set up a DMA source descriptor
+//
+void StreamSourceInitialise(struct StreamSource* Source, int DMAfd, EDMAStreamSelect Channel,
+                            uint32_t AXIAddr, uint32_t Granule, uint32_t MaxBytes, int Eventfd)
+{
+    memset(Source, 0, sizeof(*Source));
+    Source->DMAfd = DMAfd;
+    Source->Eventfd = Eventfd;
+    Source->Channel = Channel;
+    Source->AXIAddr = AXIAddr;
+    Source->Granule = Granule;
+    Source->MaxBytes = MaxBytes;
+}
+
+
+//
+// read the FIFO depth and flags
+//
+uint32_t StreamSourceDepth(struct StreamSource* Source)
+{
+    unsigned int Current;
+
+    Source->Depth = ReadFIFOMonitorChannel(Source->Channel, &Source->Overflow, &Source->OverThreshold,
+                                           &Source->Underflow, &Current);
+    if(Source->Overflow)
+        Source->Overflows++;
+    return Source->Depth;
+}
+
+
+//
+// wait until the FIFO holds at least MinWords
+//
+uint32_t StreamSourceWait(struct StreamSource* Source, uint32_t MinWords, uint32_t WordRate, volatile int* Run)
+{
+    uint32_t Depth;
+    uint32_t Wait_us;
+
+    Depth = StreamSourceDepth(Source);
+    while((Depth < MinWords) && *Run)
+    {
+        if(Source->Eventfd >= 0)
+            WaitFIFOMonitorEvent(Source->Eventfd, 10);
+        else
+        {
+            Wait_us = 500;
+            if(WordRate != 0)
+                Wait_us = (uint32_t)(((uint64_t)(MinWords - Depth) * 1000000U) / WordRate);
+            if(Wait_us < 100)
+                Wait_us = 100;
+            else if(Wait_us > 5000)
+                Wait_us = 5000;
+            usleep(Wait_us);
+        }
+        Depth = StreamSourceDepth(Source);
+    }
+    return Depth;
+}
+
+
+//
+// DMA into a ring: straight into the driver buffer if the ring is the device's
+//
+int StreamRingDMARead(struct StreamRing* Ring, int DMAfd, uint8_t* Dest, uint32_t Length, uint32_t AXIAddr)
+{
+    if((Ring->DMAfd >= 0) && (Ring->DMAfd == DMAfd))
+        return DMABufferReadFromFPGA(DMAfd, (uint32_t)(Dest - Ring->Base) & (Ring->Size - 1), Length, AXIAddr);
+    return DMAReadFromFPGA(DMAfd, Dest, Length, AXIAddr);
+}
+
+
+//
+// DMA as much as possible from the FIFO into the ring, in whole granules
+//
+uint32_t StreamSourceRead(struct StreamSource* Source, struct StreamRing* Ring)
+{
+    uint32_t Bytes;
+    uint32_t Space;
+
+    Bytes = Source->Depth * 8;
+    if(Bytes > Source->MaxBytes)
+        Bytes = Source->MaxBytes;
+    Space = StreamRingSpace(Ring);
+    if(Bytes > Space)
+        Bytes = Space;
+    Bytes -= Bytes % Source->Granule;
+    if(Bytes == 0)
+        return 0;
+    StreamRingDMARead(Ring, Source->DMAfd, StreamRingWritePtr(Ring), Bytes, Source->AXIAddr);
+    StreamRingCommit(Ring, Bytes);
+    Source->Depth -= Bytes / 8;
+    return Bytes;
+}
+
+
+//
+// set up a DMA sink descriptor
+//
+void StreamSinkInitialise(struct StreamSink* Sink, int DMAfd, EDMAStreamSelect Channel,
+                          uint32_t AXIAddr, uint32_t Granule, uint32_t DrainRate)
+{
+    memset(Sink, 0, sizeof(*Sink));
+    Sink->DMAfd = DMAfd;
+    Sink->Channel = Channel;
+    Sink->AXIAddr = AXIAddr;
+    Sink->Granule = Granule;
+    Sink->DrainRate = DrainRate;
+}
+
+
+//
+// DMA as many whole granules from the ring as the FIFO has space for
+//
+uint32_t StreamSinkWrite(struct StreamSink* Sink, struct StreamRing* Ring, uint32_t MaxBytes)
+{
+    uint32_t Bytes;
+    uint32_t Free;
+    bool FIFOOverflow, FIFOUnderflow, FIFOOverThreshold;
+    unsigned int Current;
+
+    Bytes = StreamRingUsed(Ring);
+    if((MaxBytes != 0) && (Bytes > MaxBytes))
+        Bytes = MaxBytes;
+    if(Bytes < Sink->Granule)
+        return 0;
+    Free = WaitFIFOMonitorSpace(Sink->Channel, -1, 0, Sink->DrainRate,
+                                &FIFOOverflow, &FIFOOverThreshold, &FIFOUnderflow, &Current);
+    if(Bytes > Free * 8)
+        Bytes = Free * 8;
+    Bytes -= Bytes % Sink->Granule;
+    if(Bytes == 0)
+        return 0;
+    DMAWriteToFPGA(Sink->DMAfd, StreamRingReadPtr(Ring), Bytes, Sink->AXIAddr);
+    StreamRingConsume(Ring, Bytes);
+    return Bytes;
+}
+
+
+//
+// set up a packetiser and allocate its packet buffers
+//
+bool StreamPacketiserCreate(struct StreamPacketiser* Packetiser, int Socketid,
+                            struct sockaddr_in* DestAddr, uint32_t PayloadBytes)
+{
+    uint32_t Cntr;
+
+    memset(Packetiser, 0, sizeof(*Packetiser));
+    Packetiser->Socketid = Socketid;
+    Packetiser->DestAddr = DestAddr;
+    Packetiser->PayloadBytes = PayloadBytes;
+    Packetiser->HeaderBytes = 4;
+    Packetiser->Buffers = malloc(VSTREAMMAXBATCH * (PayloadBytes + VSTREAMMAXHEADER));
+    if(!Packetiser->Buffers)
+    {
+        printf("packetiser buffer allocation failed\n");
+        return false;
+    }
+    for(Cntr = 0; Cntr < VSTREAMMAXBATCH; Cntr++)
+    {
+        Packetiser->iovecinst[Cntr].iov_base = Packetiser->Buffers + Cntr * (PayloadBytes + VSTREAMMAXHEADER);
+        Packetiser->iovecinst[Cntr].iov_len = PayloadBytes + 4;
+        Packetiser->datagrams[Cntr].msg_hdr.msg_iov = &Packetiser->iovecinst[Cntr];
+        Packetiser->datagrams[Cntr].msg_hdr.msg_iovlen = 1;
+        Packetiser->datagrams[Cntr].msg_hdr.msg_name = DestAddr;
+        Packetiser->datagrams[Cntr].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    }
+    return true;
+}
+
+
+//
+// free the packet buffers
+//
+void StreamPacketiserDestroy(struct StreamPacketiser* Packetiser)
+{
+    free(Packetiser->Buffers);
+    Packetiser->Buffers = NULL;
+}
+
+
+//
+// add or remove the packet timestamp
+//
+void StreamPacketiserSetTimeStamp(struct StreamPacketiser* Packetiser, bool Enabled,
+                                  uint32_t SampleRate, uint32_t SamplesPerPacket)
+{
+    uint32_t Cntr;
+
+    Packetiser->TimeStamped = Enabled;
+    Packetiser->HeaderBytes = Enabled ? 12 : 4;
+    Packetiser->TimeAnchor = 0;
+    Packetiser->TimeSampleRate = SampleRate;
+    Packetiser->TimeSamplesPerPacket = SamplesPerPacket;
+    Packetiser->TimeSampleCount = 0;
+    for(Cntr = 0; Cntr < VSTREAMMAXBATCH; Cntr++)
+        Packetiser->iovecinst[Cntr].iov_len = Packetiser->PayloadBytes + Packetiser->HeaderBytes;
+}
+
+
+//
+// send whole payloads from the ring in one sendmmsg()
+// the payloads are consumed even if the send fails
+//
+int StreamPacketiserSend(struct StreamPacketiser* Packetiser, struct StreamRing* Ring, uint32_t MaxPackets)
+{
+    uint32_t Packets;
+    uint32_t Cntr;
+    uint8_t* Buffer;
+    uint64_t TimeStamp;
+
+    Packets = StreamRingUsed(Ring) / Packetiser->PayloadBytes;
+    if(Packets > MaxPackets)
+        Packets = MaxPackets;
+    if(Packets > VSTREAMMAXBATCH)
+        Packets = VSTREAMMAXBATCH;
+    if(Packets == 0)
+        return 0;
+    for(Cntr = 0; Cntr < Packets; Cntr++)
+    {
+        Buffer = Packetiser->Buffers + Cntr * (Packetiser->PayloadBytes + VSTREAMMAXHEADER);
+        *(uint32_t*)Buffer = htonl(Packetiser->SequenceCounter++);              // add sequence count
+        if(Packetiser->TimeStamped)
+        {
+            TimeStamp = 0;
+            if(Packetiser->TimeAnchor != 0)
+                TimeStamp = Packetiser->TimeAnchor
+                          + (Packetiser->TimeSampleCount / Packetiser->TimeSampleRate) * 1000000000ULL
+                          + ((Packetiser->TimeSampleCount % Packetiser->TimeSampleRate) * 1000000000ULL) / Packetiser->TimeSampleRate;
+            TimeStamp = htobe64(TimeStamp);
+            memcpy(Buffer + 4, &TimeStamp, sizeof(TimeStamp));
+            Packetiser->TimeSampleCount += Packetiser->TimeSamplesPerPacket;
+        }
+        memcpy(Buffer + Packetiser->HeaderBytes, StreamRingReadPtr(Ring), Packetiser->PayloadBytes);
+        StreamRingConsume(Ring, Packetiser->PayloadBytes);
+    }
+    return sendmmsg(Packetiser->Socketid, Packetiser->datagrams, Packets, 0);
+}
@@ -0,0 +1,277 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 1 
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// streamcore.h:
+// header file. streaming core shared by the protocol 1 and protocol 2 apps
+//
+// StreamRing: a byte ring buffer whose memory is mapped twice, end to end.
+// any run of up to Size bytes from the read or write pointer is contiguous,
+// even when it crosses the end of the ring: so DMA transfers, frame decode
+// and packet copies never need to split a block or move a residue.
+//
+// StreamSource: DMA reads from a FPGA stream FIFO into a ring.
+// StreamSink: DMA writes from a ring to a FPGA stream FIFO.
+// StreamPacketiser: sends fixed size payloads from a ring as UDP packets,
+// each with a 32 bit sequence number (and optionally a 64 bit timestamp),
+// batched with sendmmsg().
+//
+// a ring has one producer and one consumer; if these are different threads
+// the caller must provide the synchronisation.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __streamcore_h
+#define __streamcore_h
+
+#include <stdint.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "../common/saturntypes.h"
+#include "../common/saturnregisters.h"
+
+
+struct StreamRing
+{
+    uint8_t* Base;                              // start of the 1st mapping
+    uint32_t Size;                              // ring size in bytes; a power of 2 multiple of the page size
+    uint32_t ReadCount;                         // free running count of bytes consumed
+    uint32_t WriteCount;                        // free running count of bytes added
+    int DMAfd;                                  // device whose driver DMA buffer is the ring memory, or -1
+};
+
+
+//
+// bool StreamRingCreate(struct StreamRing* Ring, uint32_t Size, const char* Name)
+// create a mirrored ring of at least Size bytes (rounded up to a power of 2 pages)
+// the memory is locked if possible, as it is the target of DMA transfers.
+//   Name:   used for the memfd, and in error messages
+// returns false if it could not be created
+//
+bool StreamRingCreate(struct StreamRing* Ring, uint32_t Size, const char* Name);
+
+
+//
+// bool StreamRingCreateDMA(struct StreamRing* Ring, uint32_t Size, int DMAfd, const char* Name)
+// create a mirrored ring whose memory is the driver DMA buffer of a stream device,
+// so a DMA into it is a single descriptor. Only one per device.
+// returns false if it could not be created (eg an older driver): use StreamRingCreate()
+//
+bool StreamRingCreateDMA(struct StreamRing* Ring, uint32_t Size, int DMAfd, const char* Name);
+
+
+//
+// void StreamRingDestroy(struct StreamRing* Ring)
+// unmap the ring memory
+//
+void StreamRingDestroy(struct StreamRing* Ring);
+
+
+//
+// void StreamRingReset(struct StreamRing* Ring)
+// discard the ring contents
+//
+void StreamRingReset(struct StreamRing* Ring);
+
+
+//
+// int StreamRingDMARead(struct StreamRing* Ring, int DMAfd, uint8_t* Dest, uint32_t Length, uint32_t AXIAddr)
+// DMA from the FPGA to Dest in the ring, as DMAReadFromFPGA(). If the ring is the
+// driver DMA buffer of DMAfd, the DMA goes straight into that.
+// returns 0 if success, else an error code
+//
+int StreamRingDMARead(struct StreamRing* Ring, int DMAfd, uint8_t* Dest, uint32_t Length, uint32_t AXIAddr);
+
+
+//
+// inline ring access
+// Used: bytes waiting to be consumed; Space: bytes that can be added
+// ReadPtr: 1st byte to consume; WritePtr: 1st free byte. Both valid for Size bytes.
+//
+static inline uint32_t StreamRingUsed(const struct StreamRing* Ring)
+{
+    return Ring->WriteCount - Ring->ReadCount;
+}
+
+static inline uint32_t StreamRingSpace(const struct StreamRing* Ring)
+{
+    return Ring->Size - (Ring->WriteCount - Ring->ReadCount);
+}
+
+static inline uint8_t* StreamRingReadPtr(const struct StreamRing* Ring)
+{
+    return Ring->Base + (Ring->ReadCount & (Ring->Size - 1));
+}
+
+static inline uint8_t* StreamRingWritePtr(const struct StreamRing* Ring)
+{
+    return Ring->Base + (Ring->WriteCount & (Ring->Size - 1));
+}
+
+static inline void StreamRingCommit(struct StreamRing* Ring, uint32_t Bytes)
+{
+    Ring->WriteCount += Bytes;
+}
+
+static inline void StreamRingConsume(struct StreamRing* Ring, uint32_t Bytes)
+{
+    Ring->ReadCount += Bytes;
+}
+
+
+//
+// DMA source: a FPGA stream (read) FIFO
+// the FIFO status flags from the last depth read are kept for the caller to report
+//
+struct StreamSource
+{
+    int DMAfd;                                  // XDMA c2h device
+    int Eventfd;                                // FIFO monitor events device, or -1 for timed waits
+    uint32_t AXIAddr;                           // stream reader address
+    EDMAStreamSelect Channel;                   // FIFO monitor channel
+    uint32_t Granule;                           // transfers are a multiple of this (bytes; multiple of 8)
+    uint32_t MaxBytes;                          // largest single transfer
+    uint32_t Depth;                             // FIFO depth (64 bit words) at the last read
+    bool Overflow;                              // FIFO flags at the last read
+    bool OverThreshold;
+    bool Underflow;
+    uint32_t Overflows;                         // count of depth reads that saw an overflow
+};
+
+
+//
+// void StreamSourceInitialise(struct StreamSource* Source, int DMAfd, EDMAStreamSelect Channel,
+//                             uint32_t AXIAddr, uint32_t Granule, uint32_t MaxBytes, int Eventfd)
+// set up a source descriptor. The DMA (and event) devices must already be open.
+//
+void StreamSourceInitialise(struct StreamSource* Source, int DMAfd, EDMAStreamSelect Channel,
+                            uint32_t AXIAddr, uint32_t Granule, uint32_t MaxBytes, int Eventfd);
+
+
+//
+// uint32_t StreamSourceDepth(struct StreamSource* Source)
+// read the FIFO depth and flags
+// returns the number of 64 bit words in the FIFO
+//
+uint32_t StreamSourceDepth(struct StreamSource* Source);
+
+
+//
+// uint32_t StreamSourceWait(struct StreamSource* Source, uint32_t MinWords, uint32_t WordRate, volatile int* Run)
+// wait until the FIFO holds at least MinWords. Blocks on the events device if open, else
+// sleeps for about the time the FIFO takes to fill at WordRate (words/s; 0 if not known).
+// returns early if *Run becomes 0
+// returns the FIFO depth
+//
+uint32_t StreamSourceWait(struct StreamSource* Source, uint32_t MinWords, uint32_t WordRate, volatile int* Run);
+
+
+//
+// uint32_t StreamSourceRead(struct StreamSource* Source, struct StreamRing* Ring)
+// DMA as much as possible from the FIFO into the ring, using the depth from the last
+// depth read, in whole granules and up to MaxBytes and the ring space.
+// does not wait. returns the number of bytes read
+//
+uint32_t StreamSourceRead(struct StreamSource* Source, struct StreamRing* Ring);
+
+
+//
+// DMA sink: a FPGA stream (write) FIFO
+//
+struct StreamSink
+{
+    int DMAfd;                                  // XDMA h2c device
+    uint32_t AXIAddr;                           // stream writer address
+    EDMAStreamSelect Channel;                   // FIFO monitor channel
+    uint32_t Granule;                           // transfers are a multiple of this (bytes; multiple of 8)
+    uint32_t DrainRate;                         // 64 bit words/s the FPGA reads from the FIFO
+};
+
+
+//
+// void StreamSinkInitialise(struct StreamSink* Sink, int DMAfd, EDMAStreamSelect Channel,
+//                           uint32_t AXIAddr, uint32_t Granule, uint32_t DrainRate)
+// set up a sink descriptor. The DMA device must already be open.
+//
+void StreamSinkInitialise(struct StreamSink* Sink, int DMAfd, EDMAStreamSelect Channel,
+                          uint32_t AXIAddr, uint32_t Granule, uint32_t DrainRate);
+
+
+//
+// uint32_t StreamSinkWrite(struct StreamSink* Sink, struct StreamRing* Ring, uint32_t MaxBytes)
+// DMA as many whole granules from the ring as the FIFO has space for, up to MaxBytes
+// (0 = no limit), and consume them from the ring. Does not wait.
+// returns the number of bytes written
+//
+uint32_t StreamSinkWrite(struct StreamSink* Sink, struct StreamRing* Ring, uint32_t MaxBytes);
+
+
+//
+// UDP packetiser: each packet is a 32 bit big endian sequence number then one payload.
+// if timestamped, a 64 bit big endian timestamp follows the sequence number: the time of
+// the packet's 1st sample, ns, from TimeAnchor (the time of sample 0) and the sample count.
+// it follows the sample count, not the time each packet is sent, so it doesn't jitter.
+//
+#define VSTREAMMAXBATCH 16                      // most packets sent by one sendmmsg()
+#define VSTREAMMAXHEADER 12                     // sequence number and timestamp
+
+struct StreamPacketiser
+{
+    int Socketid;                               // socket to send from
+    struct sockaddr_in* DestAddr;               // where to send
+    uint32_t PayloadBytes;                      // bytes from the ring per packet
+    uint32_t SequenceCounter;                   // next sequence number
+    uint32_t HeaderBytes;                       // bytes before the payload: 4, or 12 if timestamped
+    bool TimeStamped;
+    uint64_t TimeAnchor;                        // ns: time of sample 0; timestamps are 0 until set
+    uint32_t TimeSampleRate;                    // samples per second
+    uint32_t TimeSamplesPerPacket;
+    uint64_t TimeSampleCount;                   // samples before the next packet
+    uint8_t* Buffers;                           // VSTREAMMAXBATCH packet buffers
+    struct iovec iovecinst[VSTREAMMAXBATCH];
+    struct mmsghdr datagrams[VSTREAMMAXBATCH];
+};
+
+
+//
+// bool StreamPacketiserCreate(struct StreamPacketiser* Packetiser, int Socketid,
+//                             struct sockaddr_in* DestAddr, uint32_t PayloadBytes)
+// set up a packetiser and allocate its packet buffers. The sequence number starts at 0.
+// returns false if the buffers could not be allocated
+//
+bool StreamPacketiserCreate(struct StreamPacketiser* Packetiser, int Socketid,
+                            struct sockaddr_in* DestAddr, uint32_t PayloadBytes);
+
+
+//
+// void StreamPacketiserDestroy(struct StreamPacketiser* Packetiser)
+// free the packet buffers
+//
+void StreamPacketiserDestroy(struct StreamPacketiser* Packetiser);
+
+
+//
+// void StreamPacketiserSetTimeStamp(struct StreamPacketiser* Packetiser, bool Enabled,
+//                                   uint32_t SampleRate, uint32_t SamplesPerPacket)
+// add (or remove) the timestamp after the sequence number. The anchor and sample count
+// are cleared: set TimeAnchor when the time of the 1st sample is known.
+//
+void StreamPacketiserSetTimeStamp(struct StreamPacketiser* Packetiser, bool Enabled,
+                                  uint32_t SampleRate, uint32_t SamplesPerPacket);
+
+
+//
+// int StreamPacketiserSend(struct StreamPacketiser* Packetiser, struct StreamRing* Ring, uint32_t MaxPackets)
+// send up to MaxPackets (at most VSTREAMMAXBATCH) whole payloads from the ring in one sendmmsg()
+// and consume them.
+// returns the number of packets sent, or -1 if sendmmsg() failed
+//
+int StreamPacketiserSend(struct StreamPacketiser* Packetiser, struct StreamRing* Ring, uint32_t MaxPackets);
+
+
+#endif
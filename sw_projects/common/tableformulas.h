@@ -0,0 +1,123 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+//
+// licenced under GNU GPL3
+//
+// tableformulas.h:
+// the formulas for the constant hardware tables. These are shared by
+// gentables.c, which evaluates them at build time to generate
+// precomputedtables.h, and by saturnregisters.c for values that are
+// only known at run time (eg a client's choice of CW ramp length).
+// change a formula here, then regenerate the tables: "make tables" in P2_app.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __tableformulas_h
+#define __tableformulas_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+
+#define VDACROMSIZE 256                                 // DAC atten ROM entries: attenuation intent 0-255
+#define VRAMPSIZE 4096                                  // max CW ramp length in words
+#define VCWAMPLITUDE 7549746.0F                         // 0.9*max amplitude to match Tune etc
+
+
+//
+// a CW ramp precomputed at build time, for a length used at startup
+//
+struct PrecomputedCWRamp
+{
+    uint32_t Length_us;
+    bool IsP2;                                          // true if for protocol 2 sample rate
+    uint32_t RampLength;                                // ramp length in samples (words)
+    const uint32_t* Table;                              // RampLength values; full amplitude after that
+};
+
+
+//
+// DAC atten ROM entry for one "attenuation intent" level:
+// most of the attenuation from the 0.5dB step attenuator, the rest from the DAC current setting
+//
+static inline void CalculateDACAttenEntry(unsigned int Level, unsigned int* DACDrive, unsigned int* StepValue)
+{
+    double DesiredAtten;                        // desired attenuation in dB
+    double ResidualAtten;                       // atten to go in the current setting DAC
+
+    if (Level == 0)                             // do the max atten value separately
+    {
+        *DACDrive = 0;                          // min level
+        *StepValue = 63;                        // max atten
+        return;
+    }
+    DesiredAtten = 20.0*log10(255.0/(double)Level);     // this is the atten value we want after the high speed DAC
+    *StepValue = (int)(2.0*DesiredAtten);               // 6 bit step atten should be set to
+    if(*StepValue > 63)                                 // clip to 6 bits
+        *StepValue = 63;
+    ResidualAtten = DesiredAtten - ((double)*StepValue * 0.5);       // this needs to be achieved through the current setting drive
+    *DACDrive = (unsigned int)(255.0/pow(10.0,(ResidualAtten/20.0)));
+}
+
+
+//
+// CW ramp length in samples (words) for a ramp duration
+//
+static inline uint32_t CalculateCWRampLength(bool Protocol2, uint32_t Length_us)
+{
+    double SamplePeriod;                        // sample period in us
+
+    if(Protocol2)
+        SamplePeriod = 1000.0/192.0;
+    else
+        SamplePeriod = 1000.0/48.0;
+    return (uint32_t)(((double)Length_us / SamplePeriod) + 1);
+}
+
+
+//
+// CalculateCWRamp(uint32_t* Table, uint32_t RampLength)
+// DL1YCF ramp code:
+// ramp = x + c1 sin(2 Pi x) + c2 sin(4 Pi x) + c3 sin(6 Pi x) + c4 sin(8 Pi x) + c5 sin(10 Pi x)
+// sin and cos of 2 Pi x are stepped by rotation, and the harmonics found from the
+// recurrence sin((n+1)a) = 2 cos(a) sin(na) - sin((n-1)a), so no sin() per sample.
+// only the RampLength ramp values are written
+//
+static inline void CalculateCWRamp(uint32_t* Table, uint32_t RampLength)
+{
+    const double c1 = -0.12182865361171612;
+    const double c2 = -0.018557469249199286;
+    const double c3 = -0.0009378783245428506;
+    const double c4 = 0.0008567571519403228;
+    const double c5 = 0.00018706912431472442;
+    const double twopi = 6.28318530717959;
+
+    uint32_t Cntr;
+    double x, rampsample;
+    double StepCos, StepSin;                // rotation by 2 Pi / RampLength
+    double C = 1.0, S = 0.0;                // cos, sin of 2 Pi x
+    double TwoC, S2, S3, S4, S5, NewC;
+
+    StepCos = cos(twopi / (double)RampLength);
+    StepSin = sin(twopi / (double)RampLength);
+    for (Cntr = 0; Cntr < RampLength; Cntr++)
+    {
+        x = (double) Cntr / (double) RampLength;           // between 0 and 1
+        TwoC = 2.0 * C;
+        S2 = TwoC * S;                      // sin(4 Pi x)
+        S3 = TwoC * S2 - S;                 // sin(6 Pi x)
+        S4 = TwoC * S3 - S2;                // sin(8 Pi x)
+        S5 = TwoC * S4 - S3;                // sin(10 Pi x)
+        rampsample = x + c1 * S + c2 * S2 + c3 * S3 + c4 * S4 + c5 * S5;
+        Table[Cntr] = (uint32_t) (rampsample * VCWAMPLITUDE);
+        NewC = C * StepCos - S * StepSin;   // step to next x
+        S = S * StepCos + C * StepSin;
+        C = NewC;
+    }
+}
+
+
+#endif
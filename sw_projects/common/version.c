@@ -78,41 +78,62 @@ const char* ClockStrings[] =
 
 
 
+struct FPGACapabilities GFPGACapabilities;         // read once by ProbeFPGACapabilities()
+
+
 //
-// Check for a fallback configuration
-// returns true if FPGA is a fallback load
+// read the version registers and work out the capabilities
+// the FIFO depths are firmware version dependent; earlier firmware has the power on defaults
 //
-bool IsFallbackConfig(void)
+void ProbeFPGACapabilities(void)
 {
-	bool Result = false;
+	struct FPGACapabilities* Caps = &GFPGACapabilities;
 	uint32_t SoftwareInformation;			// swid & version
 	uint32_t ProductInformation;			// product id & version
-//	uint32_t DateCode;						// date code from user register in FPGA
-
-//	uint32_t SWVer;							// s/w version
-	uint32_t SWID;							// s/w id
-//	uint32_t ProdVer;						// product version
-	uint32_t ProdID;						// product id
-//	uint32_t ClockInfo;						// clock status
 
-	//
-	// read the raw data from registers
-	//
 	SoftwareInformation = RegisterRead(VADDRSWVERSIONREG);
 	ProductInformation = RegisterRead(VADDRPRODVERSIONREG);
-//	DateCode = RegisterRead(VADDRUSERVERSIONREG);
-
-//	ClockInfo = (SoftwareInformation & 0xF);				// 4 clock bits
-//	SWVer = (SoftwareInformation >> 4) & 0xFFFF;			// 16 bit sw version
-	SWID = SoftwareInformation >> 20;						// 12 bit software ID
-
-//	ProdVer = ProductInformation & 0xFFFF;					// 16 bit product version
-	ProdID = ProductInformation >> 16;						// 16 bit product ID
+	Caps->DateCode = RegisterRead(VADDRUSERVERSIONREG);
+
+	Caps->ClockInfo = (SoftwareInformation & 0xF);				// 4 clock bits
+	Caps->Version = (SoftwareInformation >> 4) & 0xFFFF;		// 16 bit sw version
+	Caps->SoftwareID = (ESoftwareID)((SoftwareInformation >> 20) & 0x1F);	// 5 bit software ID
+	Caps->MajorVersion = (SoftwareInformation >> 25) & 0x7F;	// 7 bit major fw version
+	Caps->ProductVersion = ProductInformation & 0xFFFF;			// 16 bit product version
+	Caps->ProductID = ProductInformation >> 16;					// 16 bit product ID
+	Caps->IsFallback = (Caps->ProductID == SATURNPRODUCTID) && ((SoftwareInformation >> 20) == SATURNGOLDENCONFIGID);
+
+	Caps->FIFODepths[eRXDDCDMA] = 8192;
+	Caps->FIFODepths[eTXDUCDMA] = 1024;
+	Caps->FIFODepths[eMicCodecDMA] = 256;
+	Caps->FIFODepths[eSpkCodecDMA] = 256;
+	if (Caps->Version >= 10)
+	{
+		Caps->FIFODepths[eRXDDCDMA] = 16384;
+		Caps->FIFODepths[eTXDUCDMA] = (Caps->Version >= 13) ? 4096 : 2048;
+		Caps->FIFODepths[eSpkCodecDMA] = 1024;
+	}
+	Caps->HasAlexTXRegister = (Caps->Version >= 12);
+	Caps->HasLongCWRamp = (Caps->Version >= 14);
+	Caps->HasWideband = (Caps->Version >= 18);
+	//
+	// the FIFO monitor low watermark (FIFO_Monitor.v revision 3) is in no released
+	// bitfile yet, so no firmware version can be said to have it: off until a
+	// bitfile with it is built and committed, and given a version here.
+	//
+	Caps->HasFIFOWatermarks = false;
+	Caps->HasICAPReconfig = false;				// likewise axil_icap_reconfig.v
+	Caps->Valid = true;
+}
 
-	if ((ProdID == SATURNPRODUCTID) && (SWID == SATURNGOLDENCONFIGID))
-		Result = true;
 
-	return Result;
+//
+// Check for a fallback configuration
+// returns true if FPGA is a fallback load
+//
+bool IsFallbackConfig(void)
+{
+	return GetFPGACapabilities()->IsFallback;
 }
 
 //
@@ -120,9 +141,7 @@ bool IsFallbackConfig(void)
 //
 void PrintVersionInfo(void)
 {
-	uint32_t SoftwareInformation;			// swid & version
-	uint32_t ProductInformation;			// product id & version
-	uint32_t DateCode;						// date code from user register in FPGA
+	const struct FPGACapabilities* Caps;
 
 	uint32_t SWVer, SWID;					// s/w version and id
 	uint32_t ProdVer, ProdID;				// product version and id
@@ -134,20 +153,17 @@ void PrintVersionInfo(void)
 	const char* SWString;
 
 	//
-	// read the raw data from registers
+	// the raw data was read from the registers by ProbeFPGACapabilities()
 	//
-	SoftwareInformation = RegisterRead(VADDRSWVERSIONREG);
-	ProductInformation = RegisterRead(VADDRPRODVERSIONREG);
-	DateCode = RegisterRead(VADDRUSERVERSIONREG);
-	printf("FPGA BIT file data code = %08x\n", DateCode);
-
-	ClockInfo = (SoftwareInformation & 0xF);				// 4 clock bits
-	SWVer = (SoftwareInformation >> 4) & 0xFFFF;			// 16 bit sw version
-	SWID = (SoftwareInformation >> 20) & 0x1F;				// 5 bit software ID
-	MajorVersion = SoftwareInformation >> 25;				// 7 bit major version
+	Caps = GetFPGACapabilities();
+	printf("FPGA BIT file data code = %08x\n", Caps->DateCode);
 
-	ProdVer = ProductInformation & 0xFFFF;					// 16 bit product version
-	ProdID = ProductInformation >> 16;						// 16 bit product ID
+	ClockInfo = Caps->ClockInfo;
+	SWVer = Caps->Version;
+	SWID = Caps->SoftwareID;
+	MajorVersion = Caps->MajorVersion;
+	ProdVer = Caps->ProductVersion;
+	ProdID = Caps->ProductID;
 
 	//
 	// now chack if IDs are valid and print strings
@@ -187,13 +203,10 @@ void PrintVersionInfo(void)
 //
 unsigned int GetFirmwareVersion(ESoftwareID* ID)
 {
-	unsigned int Version = 0;
-	uint32_t SoftwareInformation;			// swid & version
+	const struct FPGACapabilities* Caps = GetFPGACapabilities();
 
-	SoftwareInformation = RegisterRead(VADDRSWVERSIONREG);
-	Version = (SoftwareInformation >> 4) & 0xFFFF;			// 16 bit sw version
-	*ID = (ESoftwareID)((SoftwareInformation >> 20) & 0x1F);						// 5 bit software ID
-	return Version;
+	*ID = Caps->SoftwareID;
+	return Caps->Version;
 }
 
 
@@ -203,10 +216,5 @@ unsigned int GetFirmwareVersion(ESoftwareID* ID)
 //
 unsigned int GetFirmwareMajorVersion(void)
 {
-	unsigned int MajorVersion = 0;
-	uint32_t SoftwareInformation;			// swid & version
-
-	SoftwareInformation = RegisterRead(VADDRSWVERSIONREG);
-	MajorVersion = (SoftwareInformation >> 25) & 0x7F;			// 7 bit major fw version
-	return MajorVersion;
-}
\ No newline at end of file
+	return GetFPGACapabilities()->MajorVersion;
+}
@@ -16,6 +16,7 @@
 #define __version_h
 
 #include <stdint.h>
+#include <stdbool.h>
 
 
 
@@ -44,14 +45,65 @@ typedef enum
 } ESoftwareID;
 
 
+//
+// FPGA capability descriptor
+// read from the version registers once, when the XDMA driver is opened, so code can
+// test firmware features without a register access.
+//
+#define VNUMCAPFIFO 4                           // DMA FIFOs, in EDMAStreamSelect order
+
+struct FPGACapabilities
+{
+    bool Valid;                                 // true once probed
+    ESoftwareID SoftwareID;                     // 5 bit software ID
+    unsigned int Version;                       // 16 bit firmware version
+    unsigned int MajorVersion;                  // 7 bit major firmware version
+    uint32_t ProductID;                         // 16 bit product ID
+    uint32_t ProductVersion;                    // 16 bit product version
+    uint32_t ClockInfo;                         // 4 clock present bits
+    uint32_t DateCode;                          // BIT file date code
+    bool IsFallback;                            // FPGA is the fallback ("golden") load
+    uint32_t FIFODepths[VNUMCAPFIFO];           // DMA FIFO depths, in 64 bit words
+    bool HasAlexTXRegister;                     // V12+: separate Alex TX antenna/filter register
+    bool HasLongCWRamp;                         // V14+: longer CW ramp RAM
+    bool HasWideband;                           // V18+: wideband ADC data
+    bool HasFIFOWatermarks;                     // FIFO monitor low watermark (no bitfile has it yet)
+    bool HasICAPReconfig;                       // ICAP warm reconfiguration core (no bitfile has it yet)
+};
+
+extern struct FPGACapabilities GFPGACapabilities;
+
+
+//
+// void ProbeFPGACapabilities(void)
+// read the version registers and fill in the capability descriptor.
+// called by OpenXDMADriver(); call again only if the FPGA is reloaded.
+//
+void ProbeFPGACapabilities(void);
+
+
+//
+// const struct FPGACapabilities* GetFPGACapabilities(void)
+// return the capability descriptor; probes the FPGA the first time if the driver open didn't
+//
+static inline const struct FPGACapabilities* GetFPGACapabilities(void)
+{
+    if (!GFPGACapabilities.Valid)
+        ProbeFPGACapabilities();
+    return &GFPGACapabilities;
+}
+
+
 //
 // function call to get firmware ID and version
+// (from the capability descriptor)
 //
 unsigned int GetFirmwareVersion(ESoftwareID* ID);
 
 
 //
 // function call to get firmware major version
+// (from the capability descriptor)
 //
 unsigned int GetFirmwareMajorVersion(void);
 
@@ -64,6 +116,7 @@ void PrintVersionInfo(void);
 //
 // Check for a fallback configuration
 // returns true if FPGA is a fallback load
+// (from the capability descriptor)
 //
 bool IsFallbackConfig(void);
 
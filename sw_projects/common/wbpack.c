@@ -0,0 +1,182 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// wbpack.c:
+// wideband sample packing to 12 bits, or 8 bit mu-law
+//
+//////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include "../common/wbpack.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+
+#define VMULAWBIAS 132                          // G.711 mu-law bias, 16 bit scale
+#define VMULAWCLIP 32635                        // largest magnitude before the bias is added
+
+
+//
+// the sample size that will be sent for a client request
+//
+uint32_t GetWBSampleBits(uint32_t Requested, uint32_t SamplesPerPacket)
+{
+    if ((Requested == 12) && ((SamplesPerPacket & 1) == 0))
+        return 12;
+    if (Requested == 8)
+        return 8;
+    return 16;
+}
+
+
+//
+// G.711 mu-law encode of one 16 bit sample
+// exponent = position of the top bit of the biased magnitude, less 7;
+// mantissa = the 4 bits below it. The code is sent inverted.
+//
+static inline uint8_t MuLawEncode(int16_t Sample)
+{
+    uint32_t Magnitude, Exponent, Mantissa;
+    uint8_t Sign = 0;
+
+    Magnitude = (uint32_t)Sample;
+    if (Sample < 0)
+    {
+        Sign = 0x80;
+        Magnitude = (uint32_t)(-(int32_t)Sample);
+    }
+    if (Magnitude > VMULAWCLIP)
+        Magnitude = VMULAWCLIP;
+    Magnitude += VMULAWBIAS;
+    Exponent = 24 - __builtin_clz(Magnitude);           // top bit 7-14 gives 0-7
+    Mantissa = (Magnitude >> (Exponent + 3)) & 0x0F;
+    return (uint8_t)~(Sign | (Exponent << 4) | Mantissa);
+}
+
+
+//
+// scalar packing kernels
+//
+static void Pack12Scalar(uint8_t* Dest, const int16_t* Src, uint32_t Count)
+{
+    uint16_t Sample0, Sample1;
+    uint32_t Cntr;
+
+    for (Cntr = 0; Cntr < Count; Cntr += 2)
+    {
+        Sample0 = (uint16_t)*Src++ >> 4;
+        Sample1 = (uint16_t)*Src++ >> 4;
+        *Dest++ = (uint8_t)(Sample0 >> 4);
+        *Dest++ = (uint8_t)((Sample0 << 4) | (Sample1 >> 8));
+        *Dest++ = (uint8_t)Sample1;
+    }
+}
+
+
+static void Pack8Scalar(uint8_t* Dest, const int16_t* Src, uint32_t Count)
+{
+    uint32_t Cntr;
+
+    for (Cntr = 0; Cntr < Count; Cntr++)
+        *Dest++ = MuLawEncode(*Src++);
+}
+
+
+#if defined(__ARM_NEON)
+//
+// NEON 12 bit kernel
+// vld2 de-interleaves 16 samples into the even and odd samples of each pair;
+// the 3 bytes of each pair are formed in 16 bit lanes, narrowed, and vst3 interleaves them
+// each 32 byte load is complete before its 24 byte store, so packing in place is safe
+//
+static void Pack12NEON(uint8_t* Dest, const int16_t* Src, uint32_t Count)
+{
+    uint16x8x2_t In;
+    uint16x8_t Sample0, Sample1;
+    uint8x8x3_t Out;
+
+    while (Count >= 16)
+    {
+        In = vld2q_u16((const uint16_t*)Src);
+        Sample0 = vshrq_n_u16(In.val[0], 4);
+        Sample1 = vshrq_n_u16(In.val[1], 4);
+        Out.val[0] = vmovn_u16(vshrq_n_u16(Sample0, 4));
+        Out.val[1] = vmovn_u16(vorrq_u16(vshlq_n_u16(Sample0, 4), vshrq_n_u16(Sample1, 8)));
+        Out.val[2] = vmovn_u16(Sample1);
+        vst3_u8(Dest, Out);
+        Src += 16;
+        Dest += 24;
+        Count -= 16;
+    }
+    if (Count != 0)
+        Pack12Scalar(Dest, Src, Count);
+}
+
+
+//
+// NEON 8 bit mu-law kernel, 8 samples at a time
+// the exponent comes from a count of leading zeros, and the mantissa shift
+// is a variable (negative, so right) shift per lane
+//
+static void Pack8NEON(uint8_t* Dest, const int16_t* Src, uint32_t Count)
+{
+    int16x8_t In;
+    uint16x8_t Sign, Magnitude, Exponent, Mantissa, Code;
+
+    while (Count >= 8)
+    {
+        In = vld1q_s16(Src);
+        Sign = vandq_u16(vcltq_s16(In, vdupq_n_s16(0)), vdupq_n_u16(0x80));
+        Magnitude = vreinterpretq_u16_s16(vqabsq_s16(In));
+        Magnitude = vaddq_u16(vminq_u16(Magnitude, vdupq_n_u16(VMULAWCLIP)), vdupq_n_u16(VMULAWBIAS));
+        Exponent = vsubq_u16(vdupq_n_u16(8), vclzq_u16(Magnitude));
+        Mantissa = vshlq_u16(Magnitude, vnegq_s16(vreinterpretq_s16_u16(vaddq_u16(Exponent, vdupq_n_u16(3)))));
+        Code = vorrq_u16(vorrq_u16(Sign, vshlq_n_u16(Exponent, 4)), vandq_u16(Mantissa, vdupq_n_u16(0x0F)));
+        vst1_u8(Dest, vmvn_u8(vmovn_u16(Code)));
+        Src += 8;
+        Dest += 8;
+        Count -= 8;
+    }
+    if (Count != 0)
+        Pack8Scalar(Dest, Src, Count);
+}
+#endif
+
+
+//
+// pack wideband samples to the sample size requested
+//
+uint32_t PackWBSamples(uint8_t* Dest, const int16_t* Src, uint32_t Count, uint32_t Bits)
+{
+    switch (Bits)
+    {
+    case 12:
+#if defined(__ARM_NEON)
+        Pack12NEON(Dest, Src, Count);
+#else
+        Pack12Scalar(Dest, Src, Count);
+#endif
+        return Count * 3 / 2;
+
+    case 8:
+#if defined(__ARM_NEON)
+        Pack8NEON(Dest, Src, Count);
+#else
+        Pack8Scalar(Dest, Src, Count);
+#endif
+        return Count;
+
+    default:
+        if ((const void*)Dest != (const void*)Src)
+            memmove(Dest, Src, Count * 2);
+        return Count * 2;
+    }
+}
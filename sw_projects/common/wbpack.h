@@ -0,0 +1,47 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// wbpack.h:
+// header file. Wideband sample packing, for the sample size the client
+// asks for in the general packet (byte 26):
+//   16: the ADC samples as captured, 2 bytes each (the default)
+//   12: top 12 bits of each sample; 2 samples in 3 bytes, big endian:
+//       byte 0 = s0 bits 11-4; byte 1 = s0 bits 3-0, s1 bits 11-8; byte 2 = s1 bits 7-0
+//    8: G.711 mu-law companded, 1 byte each
+// any other size is sent as 16 bits. 12 bit packing needs an even number
+// of samples in each packet; if not, 16 bits are sent.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __wbpack_h
+#define __wbpack_h
+
+#include <stdint.h>
+#include "../common/saturntypes.h"
+
+
+//
+// uint32_t GetWBSampleBits(uint32_t Requested, uint32_t SamplesPerPacket)
+// the sample size that will be sent for a client request: 16, 12 or 8
+//
+uint32_t GetWBSampleBits(uint32_t Requested, uint32_t SamplesPerPacket);
+
+
+//
+// uint32_t PackWBSamples(uint8_t* Dest, const int16_t* Src, uint32_t Count, uint32_t Bits)
+// pack wideband samples to the sample size from GetWBSampleBits()
+//   Dest:    destination; may be the same as Src, to pack in place, as the output is never longer
+//   Src:     16 bit ADC samples
+//   Count:   number of samples (even, if 12 bits)
+// returns the number of bytes written
+//
+uint32_t PackWBSamples(uint8_t* Dest, const int16_t* Src, uint32_t Count, uint32_t Bits);
+
+
+#endif
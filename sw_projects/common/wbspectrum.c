@@ -0,0 +1,445 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// wbspectrum.c:
+// Wideband power spectrum: windowed, averaged FFT of a wideband capture,
+// or of a mixed down, decimated sub-band of it (zoom)
+//
+//////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "../common/wbspectrum.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+
+//
+// plan cache, and work buffers for one spectrum computation
+//
+static struct WBSpectrumPlan SpectrumPlans[VNUMSPECTRUMPLANS];
+static uint32_t SpectrumPlanUseCount = 0;
+
+static float WindowedSamples[VWBMAXFFTSIZE];            // windowed segment, in sample order
+static float FFTRe[VWBMAXFFTSIZE];                      // FFT work buffer, in bit reversed order
+static float FFTIm[VWBMAXFFTSIZE];
+static float PowerSum[VWBMAXBINS];                      // power summed over segments
+
+static struct WBZoomPlan ZoomPlans[VNUMZOOMPLANS];
+static uint32_t ZoomPlanUseCount = 0;
+static float ZoomRe[VWBZOOMMAXOUTPUTS];                 // decimated, mixed down sub-band
+static float ZoomIm[VWBZOOMMAXOUTPUTS];
+
+
+
+//
+// FFT tables: Hann window, twiddle factors and bit reverse order for an FFT of Size points
+// returns the sum of the window
+//
+static double BuildFFTTables(uint32_t Size, float* Window, float* CosTable, float* SinTable, uint16_t* BitReverse)
+{
+    uint32_t Cntr, Bit, Reversed, Bits;
+    double WindowSum = 0.0;
+
+    for (Cntr = 0; Cntr < Size; Cntr++)
+    {
+        Window[Cntr] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * Cntr / Size));
+        WindowSum += Window[Cntr];
+    }
+    for (Cntr = 0; Cntr < Size / 2; Cntr++)
+    {
+        CosTable[Cntr] = (float)cos(2.0 * M_PI * Cntr / Size);
+        SinTable[Cntr] = (float)sin(2.0 * M_PI * Cntr / Size);
+    }
+    Bits = 0;
+    while ((1U << Bits) < Size)
+        Bits++;
+    for (Cntr = 0; Cntr < Size; Cntr++)
+    {
+        Reversed = 0;
+        for (Bit = 0; Bit < Bits; Bit++)
+            if (Cntr & (1U << Bit))
+                Reversed |= 1U << (Bits - 1 - Bit);
+        BitReverse[Cntr] = (uint16_t)Reversed;
+    }
+    return WindowSum;
+}
+
+
+//
+// build the tables for a plan
+//
+static void BuildWBSpectrumPlan(struct WBSpectrumPlan* Plan, uint32_t Samples, uint32_t Bins)
+{
+    double WindowSum;
+
+    Plan->Samples = Samples;
+    Plan->Bins = Bins;
+    Plan->FFTSize = 2 * Bins;
+    Plan->Step = Plan->FFTSize / 2;                     // 50% overlap
+    Plan->Segments = (Samples - Plan->FFTSize) / Plan->Step + 1;
+    WindowSum = BuildFFTTables(Plan->FFTSize, Plan->Window, Plan->CosTable, Plan->SinTable, Plan->BitReverse);
+    //
+    // a full scale sine (amplitude 32768) gives a peak bin magnitude of 32768 * WindowSum / 2
+    //
+    Plan->Scale = (float)(4.0 / (32768.0 * 32768.0 * WindowSum * WindowSum * Plan->Segments));
+}
+
+
+//
+// const struct WBSpectrumPlan* GetWBSpectrumPlan(uint32_t Samples, uint32_t Bins)
+// look up the plan for a capture length and bin count; if not found, build it
+// in the least recently used cache entry.
+//
+const struct WBSpectrumPlan* GetWBSpectrumPlan(uint32_t Samples, uint32_t Bins)
+{
+    uint32_t Entry;
+    uint32_t Oldest = 0;
+    struct WBSpectrumPlan* Plan;
+
+    if ((Bins != VWBMINBINS) && (Bins != VWBMAXBINS))
+        return NULL;
+    if (Samples < 2 * Bins)
+        return NULL;
+
+    SpectrumPlanUseCount++;
+    for (Entry = 0; Entry < VNUMSPECTRUMPLANS; Entry++)
+    {
+        if ((SpectrumPlans[Entry].Samples == Samples) && (SpectrumPlans[Entry].Bins == Bins))
+        {
+            SpectrumPlans[Entry].LastUsed = SpectrumPlanUseCount;
+            return &SpectrumPlans[Entry];
+        }
+        if (SpectrumPlans[Entry].LastUsed < SpectrumPlans[Oldest].LastUsed)
+            Oldest = Entry;
+    }
+    Plan = &SpectrumPlans[Oldest];
+    BuildWBSpectrumPlan(Plan, Samples, Bins);
+    Plan->LastUsed = SpectrumPlanUseCount;
+    printf("wideband spectrum plan: %d samples, %d bins, %d segments\n", Samples, Bins, Plan->Segments);
+    return Plan;
+}
+
+
+//
+// window one segment: WindowedSamples = Samples * Window
+//
+static void WindowSegment(const struct WBSpectrumPlan* Plan, const int16_t* Samples)
+{
+    uint32_t Cntr = 0;
+
+#if defined(__ARM_NEON)
+    for (; Cntr + 4 <= Plan->FFTSize; Cntr += 4)
+    {
+        float32x4_t Sample = vcvtq_f32_s32(vmovl_s16(vld1_s16(Samples + Cntr)));
+        vst1q_f32(WindowedSamples + Cntr, vmulq_f32(Sample, vld1q_f32(Plan->Window + Cntr)));
+    }
+#endif
+    for (; Cntr < Plan->FFTSize; Cntr++)
+        WindowedSamples[Cntr] = (float)Samples[Cntr] * Plan->Window[Cntr];
+}
+
+
+//
+// radix 2 decimation in time FFT, in place in FFTRe, FFTIm
+// input already in bit reversed order; result in natural order
+//
+static void RunFFT(uint32_t Size, const float* CosTable, const float* SinTable)
+{
+    uint32_t Len, Half, TwiddleStep, Start, K, I, J;
+    float C, S, TRe, TIm;
+
+    for (Len = 2; Len <= Size; Len <<= 1)
+    {
+        Half = Len / 2;
+        TwiddleStep = Size / Len;
+        for (Start = 0; Start < Size; Start += Len)
+        {
+            for (K = 0; K < Half; K++)
+            {
+                C = CosTable[K * TwiddleStep];              // multiply by exp(-j 2 pi K / Len)
+                S = SinTable[K * TwiddleStep];
+                I = Start + K;
+                J = I + Half;
+                TRe = FFTRe[J] * C + FFTIm[J] * S;
+                TIm = FFTIm[J] * C - FFTRe[J] * S;
+                FFTRe[J] = FFTRe[I] - TRe;
+                FFTIm[J] = FFTIm[I] - TIm;
+                FFTRe[I] += TRe;
+                FFTIm[I] += TIm;
+            }
+        }
+    }
+}
+
+
+//
+// FFT of the windowed segment
+// input is real; result in FFTRe, FFTIm in natural order
+//
+static void TransformSegment(const struct WBSpectrumPlan* Plan)
+{
+    uint32_t Cntr;
+
+    for (Cntr = 0; Cntr < Plan->FFTSize; Cntr++)
+    {
+        FFTRe[Plan->BitReverse[Cntr]] = WindowedSamples[Cntr];
+        FFTIm[Cntr] = 0.0f;
+    }
+    RunFFT(Plan->FFTSize, Plan->CosTable, Plan->SinTable);
+}
+
+
+//
+// add the power in each positive frequency bin to PowerSum
+//
+static void AccumulatePower(const struct WBSpectrumPlan* Plan)
+{
+    uint32_t Cntr = 0;
+
+#if defined(__ARM_NEON)
+    for (; Cntr + 4 <= Plan->Bins; Cntr += 4)
+    {
+        float32x4_t Re = vld1q_f32(FFTRe + Cntr);
+        float32x4_t Im = vld1q_f32(FFTIm + Cntr);
+        float32x4_t Sum = vld1q_f32(PowerSum + Cntr);
+        Sum = vmlaq_f32(Sum, Re, Re);
+        Sum = vmlaq_f32(Sum, Im, Im);
+        vst1q_f32(PowerSum + Cntr, Sum);
+    }
+#endif
+    for (; Cntr < Plan->Bins; Cntr++)
+        PowerSum[Cntr] += FFTRe[Cntr] * FFTRe[Cntr] + FFTIm[Cntr] * FFTIm[Cntr];
+}
+
+
+//
+// convert PowerSum to 0.01dBFS units
+// bins are taken from PowerSum starting at First, wrapping at Bins
+//
+static void ConvertLogPower(uint32_t Bins, uint32_t First, float Scale, int16_t* LogPower)
+{
+    uint32_t Bin;
+    float Power;
+    int32_t Value;
+
+    for (Bin = 0; Bin < Bins; Bin++)
+    {
+        Power = PowerSum[(First + Bin) & (Bins - 1)] * Scale;
+        Value = VWBSPECTRUMFLOOR;
+        if (Power > 0.0f)
+            Value = (int32_t)lrintf(1000.0f * log10f(Power));   // 10log10, in 0.01dB
+        if (Value < VWBSPECTRUMFLOOR)
+            Value = VWBSPECTRUMFLOOR;
+        else if (Value > 32767)
+            Value = 32767;
+        LogPower[Bin] = (int16_t)Value;
+    }
+}
+
+
+//
+// void ComputeWBSpectrum(const struct WBSpectrumPlan* Plan, const int16_t* Samples, int16_t* LogPower)
+// compute the averaged power spectrum of a wideband capture, in 0.01dBFS units
+//
+void ComputeWBSpectrum(const struct WBSpectrumPlan* Plan, const int16_t* Samples, int16_t* LogPower)
+{
+    uint32_t Segment;
+
+    memset(PowerSum, 0, Plan->Bins * sizeof(float));
+    for (Segment = 0; Segment < Plan->Segments; Segment++)
+    {
+        WindowSegment(Plan, Samples + Segment * Plan->Step);
+        TransformSegment(Plan);
+        AccumulatePower(Plan);
+    }
+    ConvertLogPower(Plan->Bins, 0, Plan->Scale, LogPower);
+}
+
+
+//
+// build the tables for a zoom plan
+// the FIR is a Blackman windowed sinc low pass, cutoff half the decimated rate,
+// with unity gain at DC; shifted up to the centre frequency it is the band pass:
+//   tap[k] = h[k] exp(+j w k), w = 2 pi Centre / Fs
+// so that sum(x[n-k] tap[k]) exp(-j w n) is the mixed down, filtered sample at n.
+// the taps are stored reversed, to be used in input sample order.
+//
+static void BuildWBZoomPlan(struct WBZoomPlan* Plan, uint32_t Samples, uint32_t Bins, uint32_t Centre, uint32_t Decimation)
+{
+    uint32_t Tap;
+    double Omega, Cutoff, Position, Sinc, Window, Sum, WindowSum;
+    double Lowpass[VWBZOOMMAXTAPS];
+
+    Plan->Samples = Samples;
+    Plan->Bins = Bins;
+    Plan->Centre = Centre;
+    Plan->Decimation = Decimation;
+    Plan->Taps = VWBZOOMTAPSPERDEC * Decimation;
+    Plan->Outputs = (Samples - Plan->Taps) / Decimation + 1;
+    if (Plan->Outputs > VWBZOOMMAXOUTPUTS)
+        Plan->Outputs = VWBZOOMMAXOUTPUTS;
+    Plan->Step = Bins / 2;                              // 50% overlap
+    Plan->Segments = (Plan->Outputs - Bins) / Plan->Step + 1;
+
+    Omega = 2.0 * M_PI * Centre / VWBADCSAMPLERATE;
+    Cutoff = 0.5 / Decimation;                          // cycles per input sample
+    Sum = 0.0;
+    for (Tap = 0; Tap < Plan->Taps; Tap++)
+    {
+        Position = Tap - (Plan->Taps - 1) / 2.0;
+        Sinc = (Position == 0.0) ? 2.0 * Cutoff : sin(2.0 * M_PI * Cutoff * Position) / (M_PI * Position);
+        Window = 0.42 - 0.5 * cos(2.0 * M_PI * Tap / (Plan->Taps - 1)) + 0.08 * cos(4.0 * M_PI * Tap / (Plan->Taps - 1));
+        Lowpass[Tap] = Sinc * Window;
+        Sum += Lowpass[Tap];
+    }
+    for (Tap = 0; Tap < Plan->Taps; Tap++)
+    {
+        Plan->TapsRe[Plan->Taps - 1 - Tap] = (float)(Lowpass[Tap] / Sum * cos(Omega * Tap));
+        Plan->TapsIm[Plan->Taps - 1 - Tap] = (float)(Lowpass[Tap] / Sum * sin(Omega * Tap));
+    }
+    Plan->MixerStepRe = cos(Omega * Decimation);        // exp(-j w D) per decimated sample
+    Plan->MixerStepIm = -sin(Omega * Decimation);
+
+    WindowSum = BuildFFTTables(Bins, Plan->Window, Plan->CosTable, Plan->SinTable, Plan->BitReverse);
+    //
+    // a full scale sine (amplitude 32768) mixes down to a complex tone of amplitude 16384,
+    // which gives a peak bin magnitude of 16384 * WindowSum
+    //
+    Plan->Scale = (float)(1.0 / (16384.0 * 16384.0 * WindowSum * WindowSum * Plan->Segments));
+}
+
+
+//
+// look up the zoom plan; if not found, build it in the least recently used cache entry
+//
+const struct WBZoomPlan* GetWBZoomPlan(uint32_t Samples, uint32_t Bins, uint32_t Centre, uint32_t Decimation)
+{
+    uint32_t Entry;
+    uint32_t Oldest = 0;
+    struct WBZoomPlan* Plan;
+
+    if ((Bins != VWBMINBINS) && (Bins != VWBMAXBINS))
+        return NULL;
+    if ((Decimation < VWBMINZOOM) || (Decimation > VWBMAXZOOM) || ((Decimation & (Decimation - 1)) != 0))
+        return NULL;
+    if (Centre > VWBADCSAMPLERATE / 2)
+        return NULL;
+    if ((Samples < VWBZOOMTAPSPERDEC * Decimation) || ((Samples - VWBZOOMTAPSPERDEC * Decimation) / Decimation + 1 < Bins))
+        return NULL;
+
+    ZoomPlanUseCount++;
+    for (Entry = 0; Entry < VNUMZOOMPLANS; Entry++)
+    {
+        if ((ZoomPlans[Entry].Samples == Samples) && (ZoomPlans[Entry].Bins == Bins)
+            && (ZoomPlans[Entry].Centre == Centre) && (ZoomPlans[Entry].Decimation == Decimation))
+        {
+            ZoomPlans[Entry].LastUsed = ZoomPlanUseCount;
+            return &ZoomPlans[Entry];
+        }
+        if (ZoomPlans[Entry].LastUsed < ZoomPlans[Oldest].LastUsed)
+            Oldest = Entry;
+    }
+    Plan = &ZoomPlans[Oldest];
+    BuildWBZoomPlan(Plan, Samples, Bins, Centre, Decimation);
+    Plan->LastUsed = ZoomPlanUseCount;
+    printf("wideband zoom plan: %d samples, %d bins, %dHz +/- %dHz, %d taps, %d segments\n", Samples, Bins,
+           Centre, VWBADCSAMPLERATE / Decimation / 2, Plan->Taps, Plan->Segments);
+    return Plan;
+}
+
+
+//
+// band pass FIR at one decimated output point: complex dot product of Taps real samples
+//
+static inline void ZoomFIR(const struct WBZoomPlan* Plan, const int16_t* Samples, float* Re, float* Im)
+{
+    uint32_t Tap = 0;
+    float SumRe = 0.0f;
+    float SumIm = 0.0f;
+
+#if defined(__ARM_NEON)
+    float32x4_t AccRe = vdupq_n_f32(0.0f);
+    float32x4_t AccIm = vdupq_n_f32(0.0f);
+    for (; Tap < Plan->Taps; Tap += 4)                  // Taps is a multiple of 16
+    {
+        float32x4_t Sample = vcvtq_f32_s32(vmovl_s16(vld1_s16(Samples + Tap)));
+        AccRe = vmlaq_f32(AccRe, Sample, vld1q_f32(Plan->TapsRe + Tap));
+        AccIm = vmlaq_f32(AccIm, Sample, vld1q_f32(Plan->TapsIm + Tap));
+    }
+    float32x2_t PairRe = vadd_f32(vget_low_f32(AccRe), vget_high_f32(AccRe));
+    float32x2_t PairIm = vadd_f32(vget_low_f32(AccIm), vget_high_f32(AccIm));
+    SumRe = vget_lane_f32(vpadd_f32(PairRe, PairRe), 0);
+    SumIm = vget_lane_f32(vpadd_f32(PairIm, PairIm), 0);
+#else
+    for (; Tap < Plan->Taps; Tap++)
+    {
+        SumRe += Plan->TapsRe[Tap] * Samples[Tap];
+        SumIm += Plan->TapsIm[Tap] * Samples[Tap];
+    }
+#endif
+    *Re = SumRe;
+    *Im = SumIm;
+}
+
+
+//
+// filter and mix down the capture to the decimated sub-band in ZoomRe, ZoomIm
+// the mixer phase is advanced by complex multiply, in double so it stays on the unit circle
+//
+static void DecimateZoom(const struct WBZoomPlan* Plan, const int16_t* Samples)
+{
+    uint32_t Output;
+    double MixRe = 1.0;
+    double MixIm = 0.0;
+    double NewRe;
+    float Re, Im;
+
+    for (Output = 0; Output < Plan->Outputs; Output++)
+    {
+        ZoomFIR(Plan, Samples + Output * Plan->Decimation, &Re, &Im);
+        ZoomRe[Output] = (float)(Re * MixRe - Im * MixIm);
+        ZoomIm[Output] = (float)(Re * MixIm + Im * MixRe);
+        NewRe = MixRe * Plan->MixerStepRe - MixIm * Plan->MixerStepIm;
+        MixIm = MixRe * Plan->MixerStepIm + MixIm * Plan->MixerStepRe;
+        MixRe = NewRe;
+    }
+}
+
+
+//
+// void ComputeWBZoomSpectrum(const struct WBZoomPlan* Plan, const int16_t* Samples, int16_t* LogPower)
+// compute the averaged power spectrum of the sub-band, in 0.01dBFS units
+// the FFT puts the centre in bin 0; the result is rotated so the lowest frequency is first
+//
+void ComputeWBZoomSpectrum(const struct WBZoomPlan* Plan, const int16_t* Samples, int16_t* LogPower)
+{
+    uint32_t Segment, Cntr, Start;
+    float Window;
+
+    DecimateZoom(Plan, Samples);
+    memset(PowerSum, 0, Plan->Bins * sizeof(float));
+    for (Segment = 0; Segment < Plan->Segments; Segment++)
+    {
+        Start = Segment * Plan->Step;
+        for (Cntr = 0; Cntr < Plan->Bins; Cntr++)
+        {
+            Window = Plan->Window[Cntr];
+            FFTRe[Plan->BitReverse[Cntr]] = ZoomRe[Start + Cntr] * Window;
+            FFTIm[Plan->BitReverse[Cntr]] = ZoomIm[Start + Cntr] * Window;
+        }
+        RunFFT(Plan->Bins, Plan->CosTable, Plan->SinTable);
+        for (Cntr = 0; Cntr < Plan->Bins; Cntr++)
+            PowerSum[Cntr] += FFTRe[Cntr] * FFTRe[Cntr] + FFTIm[Cntr] * FFTIm[Cntr];
+    }
+    ConvertLogPower(Plan->Bins, Plan->Bins / 2, Plan->Scale, LogPower);
+}
@@ -0,0 +1,138 @@
+//////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// wbspectrum.h:
+// header file. Wideband power spectrum, computed on the Pi
+// so that only the log power spectrum need be sent to the client.
+//
+// the wideband capture (real 16 bit ADC samples) is split into 50%
+// overlapped segments of 2*Bins samples. Each is Hann windowed and
+// transformed by a radix 2 FFT; the power in each of the Bins positive
+// frequency bins is averaged over all segments, then converted to dBFS.
+//
+// zoom spectrum: a sub-band of the capture, Fs/Decimation wide around a
+// centre frequency. The capture is mixed down to the centre and low pass
+// filtered by one complex band pass FIR, evaluated only at the decimated
+// output points. The complex result is split into 50% overlapped segments
+// of Bins samples, Hann windowed and transformed; bin 0 is the lowest
+// frequency, Centre - Fs/(2*Decimation), and bin Bins/2 is the centre.
+// the outer bins at each end lie in the filter's roll off.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __wbspectrum_h
+#define __wbspectrum_h
+
+#include <stdint.h>
+#include "../common/saturntypes.h"
+
+
+#define VWBMINBINS 512                          // spectrum bin counts supported: 512 or 1024
+#define VWBMAXBINS 1024
+#define VWBMAXFFTSIZE (2*VWBMAXBINS)            // real samples per FFT segment
+#define VNUMSPECTRUMPLANS 4                     // spectrum plans cached
+#define VWBSPECTRUMFLOOR -20000                 // lowest value returned (-200dBFS)
+#define VWBADCSAMPLERATE 122880000              // wideband capture sample rate, Hz
+#define VWBMINZOOM 2                            // zoom decimation factors supported: powers of 2
+#define VWBMAXZOOM 64
+#define VWBZOOMTAPSPERDEC 16                    // zoom FIR taps per unit of decimation
+#define VWBZOOMMAXTAPS (VWBZOOMTAPSPERDEC * VWBMAXZOOM)
+#define VWBZOOMMAXOUTPUTS 16384                 // decimated samples used from one capture
+#define VNUMZOOMPLANS 2                         // zoom plans cached
+
+
+//
+// a cached spectrum plan: the tables needed for one capture length and bin count.
+// plans are built once into a fixed cache, so no memory is allocated per frame.
+//
+struct WBSpectrumPlan
+{
+    uint32_t Samples;                           // capture length the plan is for (0 = unused entry)
+    uint32_t Bins;                              // output bins
+    uint32_t FFTSize;                           // real samples per segment (2 * Bins)
+    uint32_t Segments;                          // overlapped segments averaged
+    uint32_t Step;                              // samples between segment starts
+    float Scale;                                // converts averaged power to fraction of full scale power
+    float Window[VWBMAXFFTSIZE];                // Hann window
+    float CosTable[VWBMAXFFTSIZE/2];            // FFT twiddle factors
+    float SinTable[VWBMAXFFTSIZE/2];
+    uint16_t BitReverse[VWBMAXFFTSIZE];         // FFT input reorder
+    uint32_t LastUsed;                          // use count when last used (for least recently used replacement)
+};
+
+
+//
+// a cached zoom plan: band pass FIR, mixer step and FFT tables for one capture
+// length, bin count, centre frequency and decimation
+//
+struct WBZoomPlan
+{
+    uint32_t Samples;                           // capture length the plan is for (0 = unused entry)
+    uint32_t Bins;                              // output bins, = complex FFT size
+    uint32_t Centre;                            // centre frequency, Hz
+    uint32_t Decimation;
+    uint32_t Taps;                              // FIR length
+    uint32_t Outputs;                           // decimated samples computed
+    uint32_t Segments;                          // overlapped segments averaged
+    uint32_t Step;                              // decimated samples between segment starts
+    float Scale;                                // converts averaged power to fraction of full scale power
+    double MixerStepRe;                         // mixer phase change per decimated sample
+    double MixerStepIm;
+    float TapsRe[VWBZOOMMAXTAPS];               // complex FIR, in input sample order
+    float TapsIm[VWBZOOMMAXTAPS];
+    float Window[VWBMAXBINS];                   // Hann window
+    float CosTable[VWBMAXBINS/2];               // FFT twiddle factors
+    float SinTable[VWBMAXBINS/2];
+    uint16_t BitReverse[VWBMAXBINS];            // FFT input reorder
+    uint32_t LastUsed;                          // use count when last used (for least recently used replacement)
+};
+
+
+//
+// const struct WBSpectrumPlan* GetWBSpectrumPlan(uint32_t Samples, uint32_t Bins)
+// look up the plan for a capture length and bin count; if not found, build it
+// in the least recently used cache entry.
+//   Samples:   16 bit ADC samples in the capture
+//   Bins:      output bins: 512 or 1024
+// returns NULL if Bins not supported, or the capture is too short for one segment
+//
+const struct WBSpectrumPlan* GetWBSpectrumPlan(uint32_t Samples, uint32_t Bins);
+
+
+//
+// void ComputeWBSpectrum(const struct WBSpectrumPlan* Plan, const int16_t* Samples, int16_t* LogPower)
+// compute the averaged power spectrum of a wideband capture
+//   Plan:      plan from GetWBSpectrumPlan()
+//   Samples:   Plan->Samples ADC samples
+//   LogPower:  Plan->Bins results, in units of 0.01dBFS; bin 0 = DC
+// not reentrant: uses static work buffers. Call from one thread.
+//
+void ComputeWBSpectrum(const struct WBSpectrumPlan* Plan, const int16_t* Samples, int16_t* LogPower);
+
+
+//
+// const struct WBZoomPlan* GetWBZoomPlan(uint32_t Samples, uint32_t Bins, uint32_t Centre, uint32_t Decimation)
+// look up or build the zoom plan for a capture length, bin count, centre frequency and decimation
+//   Centre:      centre of the sub-band, Hz (0 to VWBADCSAMPLERATE/2)
+//   Decimation:  power of 2, VWBMINZOOM to VWBMAXZOOM; the sub-band is VWBADCSAMPLERATE/Decimation wide
+// returns NULL if not supported, or the capture is too short for one segment
+//
+const struct WBZoomPlan* GetWBZoomPlan(uint32_t Samples, uint32_t Bins, uint32_t Centre, uint32_t Decimation);
+
+
+//
+// void ComputeWBZoomSpectrum(const struct WBZoomPlan* Plan, const int16_t* Samples, int16_t* LogPower)
+// compute the averaged power spectrum of the sub-band, in 0.01dBFS units
+//   LogPower:  Plan->Bins results; bin 0 = lowest frequency
+// not reentrant: uses static work buffers. Call from one thread.
+//
+void ComputeWBZoomSpectrum(const struct WBZoomPlan* Plan, const int16_t* Samples, int16_t* LogPower);
+
+
+#endif
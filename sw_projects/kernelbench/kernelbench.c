@@ -0,0 +1,261 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// kernelbench.c:
+// microbenchmark for the p2app sample processing kernels.
+// no hardware needed: runs on test data in memory.
+// each accelerated kernel is checked against the scalar code
+// bit for bit before it is timed.
+//
+// ./kernelbench <optional sample count> <optional iterations>
+//
+//////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "../common/saturntypes.h"
+#include "../common/sampleunpack.h"
+
+#define VDEFAULTSAMPLES 4096                    // samples per kernel call (same as largest DDC DMA)
+#define VDEFAULTITERATIONS 10000
+#define VCHECKSAMPLES 256                       // kernels checked for every sample count up to this
+
+
+//
+// get a time in ns from the monotonic clock
+//
+static uint64_t GetTimeNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+//
+// cache line aligned test buffer. posix_memalign, as aligned_alloc() needs a size
+// that is a multiple of the alignment. Exits if there is no memory.
+//
+static uint8_t* AllocateTestBuffer(size_t Size)
+{
+    void* Buffer;
+
+    if (posix_memalign(&Buffer, 64, Size) != 0)
+    {
+        printf("could not allocate %zu byte test buffer\n", Size);
+        exit(EXIT_FAILURE);
+    }
+    return (uint8_t*)Buffer;
+}
+
+
+//
+// create test data in DDC stream format: 6 random bytes then 2 "unused" bytes per 64 bit word
+// the unused bytes are set non zero so that a kernel copying them is detected
+//
+static void CreateDDCTestData(uint8_t* Buffer, uint32_t Samples)
+{
+    uint32_t Cntr;
+
+    for (Cntr = 0; Cntr < Samples*8; Cntr++)
+    {
+        if ((Cntr & 7) >= 6)
+            Buffer[Cntr] = 0xA5;
+        else
+            Buffer[Cntr] = (uint8_t)rand();
+    }
+}
+
+
+//
+// create test data in DUC format: 6 random bytes per sample
+//
+static void CreateDUCTestData(uint8_t* Buffer, uint32_t Samples)
+{
+    uint32_t Cntr;
+
+    for (Cntr = 0; Cntr < Samples*6; Cntr++)
+        Buffer[Cntr] = (uint8_t)rand();
+}
+
+
+//
+// time a sample kernel; returns ns per call
+//
+static double TimeKernel(void (*Kernel)(uint8_t*, const uint8_t*, uint32_t), uint8_t* Dest,
+                         const uint8_t* Src, uint32_t Samples, uint32_t Iterations)
+{
+    uint64_t Start, End;
+    uint32_t Cntr;
+
+    Start = GetTimeNs();
+    for (Cntr = 0; Cntr < Iterations; Cntr++)
+        Kernel(Dest, Src, Samples);
+    End = GetTimeNs();
+    return (double)(End - Start) / Iterations;
+}
+
+
+//
+// check a kernel against its scalar reference for every sample count up to Samples
+// so the vector loop and tail code are both exercised
+// both kernels write 6 bytes per sample. Bytes past the end are checked too.
+// returns true if identical
+//
+static bool CheckKernel(void (*Kernel)(uint8_t*, const uint8_t*, uint32_t),
+                        void (*Reference)(uint8_t*, const uint8_t*, uint32_t), const uint8_t* Src, uint32_t Samples)
+{
+    uint8_t* Ref;
+    uint8_t* Test;
+    uint32_t Count;
+    bool Result = true;
+
+    Ref = malloc(Samples*6 + 16);
+    Test = malloc(Samples*6 + 16);
+    for (Count = 0; (Count <= Samples) && Result; Count++)
+    {
+        memset(Ref, 0x5A, Samples*6 + 16);
+        memset(Test, 0x5A, Samples*6 + 16);
+        Reference(Ref, Src, Count);
+        Kernel(Test, Src, Count);
+        if (memcmp(Ref, Test, Samples*6 + 16) != 0)
+        {
+            printf("mismatch with %d samples\n", Count);
+            Result = false;
+        }
+    }
+    free(Ref);
+    free(Test);
+    return Result;
+}
+
+
+//
+// 64 bit to 48 bit DDC sample unpack
+//
+static bool BenchUnpack(uint32_t Samples, uint32_t Iterations)
+{
+    uint8_t* Src;
+    uint8_t* Dest;
+    uint32_t TestSamples;                       // test data must cover the correctness check too
+    double ScalarTime;
+    bool Result = true;
+
+    TestSamples = (Samples > VCHECKSAMPLES) ? Samples : VCHECKSAMPLES;
+    Src = AllocateTestBuffer(TestSamples*8);
+    Dest = AllocateTestBuffer(Samples*6 + 64);
+    CreateDDCTestData(Src, TestSamples);
+
+    printf("DDC sample unpack, %d samples per call:\n", Samples);
+    ScalarTime = TimeKernel(UnpackDDCSamplesScalar, Dest, Src, Samples, Iterations);
+    printf("  scalar: %10.1f ns/call %8.2f ns/sample\n", ScalarTime, ScalarTime/Samples);
+#if defined(VNEONUNPACKAVAILABLE)
+    double NEONTime;
+    if (!CheckKernel(UnpackDDCSamplesNEON, UnpackDDCSamplesScalar, Src, VCHECKSAMPLES))
+    {
+        printf("  NEON:   FAILED - output differs from scalar code\n");
+        Result = false;
+    }
+    else
+    {
+        NEONTime = TimeKernel(UnpackDDCSamplesNEON, Dest, Src, Samples, Iterations);
+        printf("  NEON:   %10.1f ns/call %8.2f ns/sample  (%.2fx) output matches scalar\n",
+               NEONTime, NEONTime/Samples, ScalarTime/NEONTime);
+    }
+#else
+    (void)CheckKernel;
+    printf("  NEON:   not available on this processor\n");
+#endif
+    free(Src);
+    free(Dest);
+    return Result;
+}
+
+
+//
+// DUC I/Q swap
+// the scalar code is checked first against a known sample, so the reference itself is tested
+//
+static bool BenchSwap(uint32_t Samples, uint32_t Iterations)
+{
+    const uint8_t KnownIn[6] = {1, 2, 3, 4, 5, 6};          // Q then I
+    const uint8_t KnownOut[6] = {4, 5, 6, 1, 2, 3};         // I then Q
+    uint8_t KnownTest[6];
+    uint8_t* Src;
+    uint8_t* Dest;
+    uint32_t TestSamples;                       // test data must cover the correctness check too
+    double ScalarTime;
+    bool Result = true;
+
+    SwapIQSamplesScalar(KnownTest, KnownIn, 1);
+    if (memcmp(KnownTest, KnownOut, 6) != 0)
+    {
+        printf("DUC I/Q swap: scalar code FAILED known sample check\n");
+        return false;
+    }
+    TestSamples = (Samples > VCHECKSAMPLES) ? Samples : VCHECKSAMPLES;
+    Src = AllocateTestBuffer(TestSamples*6 + 64);
+    Dest = AllocateTestBuffer(Samples*6 + 64);
+    CreateDUCTestData(Src, TestSamples);
+
+    printf("DUC I/Q swap, %d samples per call:\n", Samples);
+    ScalarTime = TimeKernel(SwapIQSamplesScalar, Dest, Src, Samples, Iterations);
+    printf("  scalar: %10.1f ns/call %8.2f ns/sample\n", ScalarTime, ScalarTime/Samples);
+#if defined(VNEONUNPACKAVAILABLE)
+    double NEONTime;
+    if (!CheckKernel(SwapIQSamplesNEON, SwapIQSamplesScalar, Src, VCHECKSAMPLES))
+    {
+        printf("  NEON:   FAILED - output differs from scalar code\n");
+        Result = false;
+    }
+    else
+    {
+        NEONTime = TimeKernel(SwapIQSamplesNEON, Dest, Src, Samples, Iterations);
+        printf("  NEON:   %10.1f ns/call %8.2f ns/sample  (%.2fx) output matches scalar\n",
+               NEONTime, NEONTime/Samples, ScalarTime/NEONTime);
+    }
+#else
+    printf("  NEON:   not available on this processor\n");
+#endif
+    free(Src);
+    free(Dest);
+    return Result;
+}
+
+
+int main(int argc, char *argv[])
+{
+    uint32_t Samples = VDEFAULTSAMPLES;
+    uint32_t Iterations = VDEFAULTITERATIONS;
+    bool Passed = true;
+
+    if (argc >= 2)
+        Samples = atoi(argv[1]);
+    if (argc >= 3)
+        Iterations = atoi(argv[2]);
+    if ((Samples == 0) || (Iterations == 0))
+    {
+        printf("usage: ./kernelbench <optional sample count> <optional iterations>\n");
+        return EXIT_FAILURE;
+    }
+
+    InitialiseSampleUnpack();
+    Passed &= BenchUnpack(Samples, Iterations);
+    Passed &= BenchSwap(Samples, Iterations);
+
+    if (!Passed)
+    {
+        printf("kernel check FAILED\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,517 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// libsaturn.c:
+//
+// in-process radio API: DDC receive and DUC transmit through the stream
+// engines (streamcore), with no protocol 2 network hop.
+// the receive thread decodes the DDC stream the same way as p1app: whole
+// frames from a DMA ring, laid out by the frame plan for the rate word.
+//
+//////////////////////////////////////////////////////////////
+
+#include "libsaturn.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "../common/saturntypes.h"
+#include "../common/hwaccess.h"
+#include "../common/saturnregisters.h"
+#include "../common/saturndrivers.h"
+#include "../common/version.h"
+#include "../common/sampleunpack.h"
+#include "../common/streamcore.h"
+
+
+#define VREQUIREDMAJORVERSION 1                     // FPGA firmware major version supported
+#define VTXAMPLSCALEFACTOR 0x0001FFFF               // TX scaling before FW V13: 1/2 of full scale
+#define VTXAMPLSCALEFACTOR_13 0x0002000             // FW V13+: 1/32 of full scale
+#define VDDCRINGSIZE 131072                         // DDC DMA ring
+#define VDDCDMAWORDS 512                            // smallest DDC DMA: 4K bytes
+#define VDDCMAXDMAWORDS 4096                        // largest DDC DMA: 32K bytes
+#define VDDCFRAMERATE 48000                         // DDC frames per second
+#define VMAXFRAMESAMPLES 32                         // most samples for one DDC in a frame (1536KHz)
+#define VRXBLOCKSAMPLES 4096                        // I/Q samples per DDC passed on in one go
+#define VTXRINGSIZE 65536                           // DUC ring: 24 bit I/Q, FPGA order
+#define VTXBLOCKSAMPLES 240                         // DUC samples swapped in one go
+#define VTXDRAINRATE (SATURNTXRATE * 6 / 8)         // 64 bit words/s the FPGA reads from the DUC FIFO
+
+
+static bool SaturnIsOpen = false;
+static uint32_t DDCRateKHz[SATURNMAXDDC];
+
+//
+// receive
+//
+static pthread_t RXThread;
+static volatile int RXRun = 0;                      // set to 0 to stop the receive thread
+static bool RXRunning = false;
+static TSaturnRXCallback RXCallback;
+static void* RXContext;
+static int DDCDMA_fd = -1;
+static int DDCEvent_fd = -1;
+static struct StreamRing DDCRing;
+static struct StreamSource DDCSource;
+static int32_t* RXBlock[SATURNMAXDDC];              // samples decoded from this DMA, per DDC
+static uint32_t RXBlockSamples[SATURNMAXDDC];
+
+//
+// buffered receive, for SaturnReadRX(): a ring of samples per DDC
+//
+static pthread_mutex_t RXBufferMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t RXBufferReady = PTHREAD_COND_INITIALIZER;
+static int32_t* RXBuffer[SATURNMAXDDC];
+static uint32_t RXBufferRead[SATURNMAXDDC];          // free running sample counts
+static uint32_t RXBufferWrite[SATURNMAXDDC];
+static uint64_t RXDropped[SATURNMAXDDC];
+
+//
+// transmit
+//
+static int DUCDMA_fd = -1;
+static struct StreamRing DUCRing;
+static struct StreamSink DUCSink;
+static bool TXReady = false;
+
+
+//
+// called by SetTXAmplitudeEER(): EER mode is not supported by the library
+//
+void HandlerSetEERMode(__attribute__((unused)) bool EEREnabled)
+{
+}
+
+
+uint32_t SaturnGetAPIVersion(void)
+{
+    return SATURNAPIVERSION;
+}
+
+
+//
+// open the board and set it up as p2app does at startup
+//
+bool SaturnOpen(uint32_t Card)
+{
+    ESoftwareID ID;
+    uint32_t Version;
+    uint32_t DDC;
+
+    if(SaturnIsOpen)
+        return true;
+    if(!SelectXDMACard(Card) || (OpenXDMADriverMapped(true, true) == 0))
+    {
+        printf("libsaturn: Saturn board %u not found\n", Card);
+        return false;
+    }
+    if(GetFirmwareMajorVersion() != VREQUIREDMAJORVERSION)
+    {
+        printf("libsaturn: FPGA firmware major version %u not supported (needs %d)\n",
+               GetFirmwareMajorVersion(), VREQUIREDMAJORVERSION);
+        CloseXDMADriver();
+        return false;
+    }
+    Version = GetFirmwareVersion(&ID);
+    CodecInitialise();
+    InitialiseCWKeyerRamp(true, 9000);
+    SetTXProtocol(true);                                            // protocol 2 sample format
+    SetTXModulationSource(eIQData);
+    SetByteSwapping(true);                                          // big endian samples
+    SetSpkrMute(false);
+    SetTXAmplitudeScaling((Version < 13) ? VTXAMPLSCALEFACTOR : VTXAMPLSCALEFACTOR_13);
+    EnableAlexManualFilterSelect(true);
+    InitialiseSampleUnpack();
+    SetRXDDCEnabled(false);
+    for(DDC = 0; DDC < SATURNMAXDDC; DDC++)
+    {
+        SetP2SampleRate(DDC, false, 48, false);
+        DDCRateKHz[DDC] = 0;
+    }
+    WriteP2DDCRateRegister();
+    //
+    // TX: the DUC FIFO and its ring
+    //
+    DUCDMA_fd = OpenDMADevice(VDUCDMADEVICE, O_WRONLY);
+    if((DUCDMA_fd >= 0) && StreamRingCreate(&DUCRing, VTXRINGSIZE, "libsaturn DUC"))
+    {
+        StreamSinkInitialise(&DUCSink, DUCDMA_fd, eTXDUCDMA, VADDRDUCSTREAMWRITE, 6 * 4, VTXDRAINRATE);
+        EnableDUCMux(false);
+        SetTXIQDeinterleaved(false);
+        ResetDUCMux();
+        ResetDMAStreamFIFO(eTXDUCDMA);
+        SetupFIFOMonitorChannel(eTXDUCDMA, false);
+        EnableDUCMux(true);
+        TXReady = true;
+    }
+    else
+        printf("libsaturn: TX DMA device not available; transmit disabled\n");
+    SaturnIsOpen = true;
+    return true;
+}
+
+
+void SaturnClose(void)
+{
+    if(!SaturnIsOpen)
+        return;
+    SaturnStopRX();
+    SaturnSetMOX(false);
+    if(TXReady)
+        StreamRingDestroy(&DUCRing);
+    TXReady = false;
+    if(DUCDMA_fd >= 0)
+        close(DUCDMA_fd);
+    DUCDMA_fd = -1;
+    CloseXDMADriver();
+    SaturnIsOpen = false;
+}
+
+
+bool SaturnSetDDC(uint32_t DDC, uint32_t RateKHz, uint32_t ADC, uint32_t FrequencyHz)
+{
+    if(!SaturnIsOpen || RXRunning || (DDC >= SATURNMAXDDC) || (ADC > 1))
+        return false;
+    if((RateKHz != 0) && (RateKHz != 48) && (RateKHz != 96) && (RateKHz != 192)
+       && (RateKHz != 384) && (RateKHz != 768) && (RateKHz != 1536))
+        return false;
+    SetDDCADC(DDC, (ADC == 0) ? eADC1 : eADC2);
+    SetP2SampleRate(DDC, (RateKHz != 0), RateKHz, false);
+    DDCRateKHz[DDC] = RateKHz;
+    WriteP2DDCRateRegister();
+    SetDDCFrequency(DDC, FrequencyHz, false);
+    return true;
+}
+
+
+bool SaturnSetDDCFrequency(uint32_t DDC, uint32_t FrequencyHz)
+{
+    if(!SaturnIsOpen || (DDC >= SATURNMAXDDC))
+        return false;
+    SetDDCFrequency(DDC, FrequencyHz, false);
+    return true;
+}
+
+
+//
+// 24 bit big endian I/Q to sign extended int32
+//
+static void WidenSamples(int32_t* Dest, const uint8_t* Src, uint32_t Samples)
+{
+    uint32_t Cntr;
+
+    for(Cntr = 0; Cntr < 2 * Samples; Cntr++)
+    {
+        Dest[Cntr] = (int32_t)(((uint32_t)Src[0] << 24) | ((uint32_t)Src[1] << 16) | ((uint32_t)Src[2] << 8)) >> 8;
+        Src += 3;
+    }
+}
+
+
+//
+// pass on the samples decoded for each DDC: to the callback, or the DDC's buffer
+//
+static void DeliverRXBlocks(void)
+{
+    uint32_t DDC;
+    uint32_t Cntr, Space;
+
+    if(RXCallback != NULL)
+    {
+        for(DDC = 0; DDC < SATURNMAXDDC; DDC++)
+            if(RXBlockSamples[DDC] != 0)
+                RXCallback(DDC, RXBlock[DDC], RXBlockSamples[DDC], RXContext);
+    }
+    else
+    {
+        pthread_mutex_lock(&RXBufferMutex);
+        for(DDC = 0; DDC < SATURNMAXDDC; DDC++)
+        {
+            Space = SATURNRXBUFFERSAMPLES - (RXBufferWrite[DDC] - RXBufferRead[DDC]);
+            if(RXBlockSamples[DDC] > Space)
+            {
+                RXDropped[DDC] += RXBlockSamples[DDC] - Space;
+                RXBlockSamples[DDC] = Space;
+            }
+            for(Cntr = 0; Cntr < RXBlockSamples[DDC]; Cntr++)
+            {
+                memcpy(RXBuffer[DDC] + 2 * (RXBufferWrite[DDC] % SATURNRXBUFFERSAMPLES), RXBlock[DDC] + 2 * Cntr, 2 * sizeof(int32_t));
+                RXBufferWrite[DDC]++;
+            }
+        }
+        pthread_cond_broadcast(&RXBufferReady);
+        pthread_mutex_unlock(&RXBufferMutex);
+    }
+    memset(RXBlockSamples, 0, sizeof(RXBlockSamples));
+}
+
+
+//
+// receive thread: read the DDC FIFO, decode whole frames and pass the samples on
+// if the rate word is not where expected, skip forward to the next one
+//
+static void* SaturnRXThread(__attribute__((unused)) void* arg)
+{
+    const struct DDCFramePlan* FramePlan = NULL;
+    uint32_t PrevRateWord = 0;
+    uint32_t RateWord;
+    uint32_t FrameBytes;
+    uint32_t WordRate = 0;
+    uint32_t Entry, DDC, Samples;
+    uint8_t* ReadPtr;
+    uint8_t Unpacked[VMAXFRAMESAMPLES * 6];
+
+    while(RXRun)
+    {
+        StreamSourceWait(&DDCSource, VDDCDMAWORDS, WordRate, &RXRun);
+        if(!RXRun)
+            break;
+        StreamSourceRead(&DDCSource, &DDCRing);
+        while(StreamRingUsed(&DDCRing) >= 16)
+        {
+            ReadPtr = StreamRingReadPtr(&DDCRing);
+            if(*(ReadPtr + 7) != 0x80)
+            {
+                while((StreamRingUsed(&DDCRing) >= 8) && (*(StreamRingReadPtr(&DDCRing) + 7) != 0x80))
+                    StreamRingConsume(&DDCRing, 8);
+                continue;
+            }
+            RateWord = *(uint32_t*)ReadPtr;
+            if((RateWord != PrevRateWord) || (FramePlan == NULL))
+            {
+                FramePlan = GetDDCFramePlan(RateWord);
+                if(FramePlan == NULL)                           // not a valid rate word: a sample, not a header
+                {
+                    StreamRingConsume(&DDCRing, 8);
+                    continue;
+                }
+                PrevRateWord = RateWord;
+                WordRate = (FramePlan->FrameLength + 1) * VDDCFRAMERATE;
+            }
+            FrameBytes = (FramePlan->FrameLength + 1) * 8;
+            if(StreamRingUsed(&DDCRing) < FrameBytes)
+                break;
+            for(Entry = 0; Entry < FramePlan->ActiveDDCs; Entry++)
+            {
+                DDC = FramePlan->DDC[Entry];
+                Samples = FramePlan->Count[Entry];
+                if((DDC >= SATURNMAXDDC) || (Samples > VMAXFRAMESAMPLES))
+                    continue;
+                if(RXBlockSamples[DDC] + Samples > VRXBLOCKSAMPLES)
+                    DeliverRXBlocks();
+                UnpackDDCSamples(Unpacked, ReadPtr + 8 + FramePlan->Offset[Entry], Samples);
+                WidenSamples(RXBlock[DDC] + 2 * RXBlockSamples[DDC], Unpacked, Samples);
+                RXBlockSamples[DDC] += Samples;
+            }
+            StreamRingConsume(&DDCRing, FrameBytes);
+        }
+        DeliverRXBlocks();
+    }
+    return NULL;
+}
+
+
+//
+// free the receive buffers and close the DMA devices
+//
+static void FreeRXResources(void)
+{
+    uint32_t DDC;
+
+    for(DDC = 0; DDC < SATURNMAXDDC; DDC++)
+    {
+        free(RXBlock[DDC]);
+        free(RXBuffer[DDC]);
+        RXBlock[DDC] = NULL;
+        RXBuffer[DDC] = NULL;
+    }
+    StreamRingDestroy(&DDCRing);
+    if(DDCEvent_fd >= 0)
+        CloseUserIRQWaiter(DDCEvent_fd);
+    if(DDCDMA_fd >= 0)
+        close(DDCDMA_fd);
+    DDCEvent_fd = -1;
+    DDCDMA_fd = -1;
+}
+
+
+bool SaturnStartRX(TSaturnRXCallback Callback, void* Context)
+{
+    uint32_t DDC;
+    bool Allocated = true;
+
+    if(!SaturnIsOpen || RXRunning)
+        return false;
+    memset(&DDCRing, 0, sizeof(DDCRing));
+    for(DDC = 0; DDC < SATURNMAXDDC; DDC++)
+    {
+        RXBlock[DDC] = malloc(VRXBLOCKSAMPLES * 2 * sizeof(int32_t));
+        if(Callback == NULL)
+            RXBuffer[DDC] = malloc(SATURNRXBUFFERSAMPLES * 2 * sizeof(int32_t));
+        if((RXBlock[DDC] == NULL) || ((Callback == NULL) && (RXBuffer[DDC] == NULL)))
+            Allocated = false;
+        RXBlockSamples[DDC] = 0;
+        RXBufferRead[DDC] = 0;
+        RXBufferWrite[DDC] = 0;
+        RXDropped[DDC] = 0;
+    }
+    DDCDMA_fd = OpenDMADevice(VDDCDMADEVICE, O_RDONLY);
+    if(!Allocated || (DDCDMA_fd < 0) || !StreamRingCreate(&DDCRing, VDDCRINGSIZE, "libsaturn DDC"))
+    {
+        printf("libsaturn: DDC stream could not be set up\n");
+        FreeRXResources();
+        return false;
+    }
+    RXCallback = Callback;
+    RXContext = Context;
+    //
+    // stop the DDC stream, reset the FIFO, then start it
+    // if the FIFO monitor events device is available, interrupt when a DMA is ready
+    //
+    SetRXDDCEnabled(false);
+    usleep(1000);                                   // give FIFO time to stop recording
+    DDCEvent_fd = OpenFIFOMonitorEvents(eRXDDCDMA);
+    if(DDCEvent_fd >= 0)
+        SetupFIFOMonitorThreshold(eRXDDCDMA, VDDCDMAWORDS, true);
+    else
+        SetupFIFOMonitorChannel(eRXDDCDMA, false);
+    ResetDMAStreamFIFO(eRXDDCDMA);
+    StreamSourceInitialise(&DDCSource, DDCDMA_fd, eRXDDCDMA, VADDRDDCSTREAMREAD,
+                           VDDCDMAWORDS * 8, VDDCMAXDMAWORDS * 8, DDCEvent_fd);
+    RXRun = 1;
+    SetRXDDCEnabled(true);
+    if(pthread_create(&RXThread, NULL, SaturnRXThread, NULL) != 0)
+    {
+        perror("libsaturn: receive thread");
+        RXRun = 0;
+        SetRXDDCEnabled(false);
+        FreeRXResources();
+        return false;
+    }
+    RXRunning = true;
+    return true;
+}
+
+
+uint32_t SaturnReadRX(uint32_t DDC, int32_t* IQ, uint32_t MaxSamples, uint32_t TimeoutMs)
+{
+    struct timespec Deadline;
+    uint32_t Samples = 0;
+
+    if((DDC >= SATURNMAXDDC) || !RXRunning || (RXCallback != NULL))
+        return 0;
+    clock_gettime(CLOCK_REALTIME, &Deadline);
+    Deadline.tv_sec += TimeoutMs / 1000;
+    Deadline.tv_nsec += (long)(TimeoutMs % 1000) * 1000000L;
+    if(Deadline.tv_nsec >= 1000000000L)
+    {
+        Deadline.tv_sec++;
+        Deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&RXBufferMutex);
+    while((RXBufferWrite[DDC] == RXBufferRead[DDC]) && RXRun)
+        if(pthread_cond_timedwait(&RXBufferReady, &RXBufferMutex, &Deadline) == ETIMEDOUT)
+            break;
+    while((Samples < MaxSamples) && (RXBufferRead[DDC] != RXBufferWrite[DDC]))
+    {
+        memcpy(IQ + 2 * Samples, RXBuffer[DDC] + 2 * (RXBufferRead[DDC] % SATURNRXBUFFERSAMPLES), 2 * sizeof(int32_t));
+        RXBufferRead[DDC]++;
+        Samples++;
+    }
+    pthread_mutex_unlock(&RXBufferMutex);
+    return Samples;
+}
+
+
+uint64_t SaturnGetRXDropped(uint32_t DDC)
+{
+    uint64_t Dropped;
+
+    if(DDC >= SATURNMAXDDC)
+        return 0;
+    pthread_mutex_lock(&RXBufferMutex);
+    Dropped = RXDropped[DDC];
+    pthread_mutex_unlock(&RXBufferMutex);
+    return Dropped;
+}
+
+
+void SaturnStopRX(void)
+{
+    if(!RXRunning)
+        return;
+    RXRun = 0;
+    pthread_mutex_lock(&RXBufferMutex);
+    pthread_cond_broadcast(&RXBufferReady);             // wake any SaturnReadRX()
+    pthread_mutex_unlock(&RXBufferMutex);
+    pthread_join(RXThread, NULL);
+    SetRXDDCEnabled(false);
+    RXRunning = false;
+    FreeRXResources();
+}
+
+
+bool SaturnSetTX(uint32_t FrequencyHz, uint32_t DriveLevel)
+{
+    if(!SaturnIsOpen || (DriveLevel > 255))
+        return false;
+    SetDUCFrequency(FrequencyHz, false);
+    SetTXDriveLevel(DriveLevel);
+    return true;
+}
+
+
+void SaturnSetMOX(bool MOX)
+{
+    if(!SaturnIsOpen)
+        return;
+    SetTXEnable(MOX);
+    SetMOX(MOX);
+}
+
+
+//
+// samples are packed to 24 bit big endian I then Q, as protocol 2 sends them,
+// then put in FPGA order by the same swap kernel as the protocol 2 DUC path
+//
+uint32_t SaturnWriteTX(const int32_t* IQ, uint32_t Samples)
+{
+    uint8_t Packed[VTXBLOCKSAMPLES * 6];
+    uint8_t* Ptr;
+    uint32_t Accepted = 0;
+    uint32_t Block, Cntr;
+
+    if(!TXReady)
+        return 0;
+    while(Accepted < Samples)
+    {
+        Block = Samples - Accepted;
+        if(Block > VTXBLOCKSAMPLES)
+            Block = VTXBLOCKSAMPLES;
+        if(StreamRingSpace(&DUCRing) < Block * 6)
+            Block = StreamRingSpace(&DUCRing) / 6;
+        if(Block == 0)
+            break;
+        Ptr = Packed;
+        for(Cntr = 0; Cntr < 2 * Block; Cntr++)
+        {
+            *Ptr++ = (uint8_t)(IQ[2 * Accepted + Cntr] >> 16);
+            *Ptr++ = (uint8_t)(IQ[2 * Accepted + Cntr] >> 8);
+            *Ptr++ = (uint8_t)IQ[2 * Accepted + Cntr];
+        }
+        SwapIQSamples(StreamRingWritePtr(&DUCRing), Packed, Block);
+        StreamRingCommit(&DUCRing, Block * 6);
+        Accepted += Block;
+    }
+    StreamSinkWrite(&DUCSink, &DUCRing, 0);
+    return Accepted;
+}
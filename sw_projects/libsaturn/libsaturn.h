@@ -0,0 +1,161 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// libsaturn.h:
+//
+// public header for libsaturn: drive the Saturn radio from an application
+// running on the Pi itself, without protocol 2 and its UDP sockets.
+// the library is built from the same register, driver and stream code as
+// p2app (sw_projects/common). It must not be used while p2app or p1app is
+// running: they use the same DMA devices and registers.
+//
+// this is the whole API: only the functions here are exported from
+// libsaturn.so, and they keep their meaning for a given SATURNAPIVERSION.
+// the functions are not thread safe unless stated: call them from one
+// application thread.
+//
+// receive: set up DDCs with SaturnSetDDC(), then SaturnStartRX(). Samples
+// are delivered from the library's receive thread, either to a callback or
+// into a buffer per DDC that SaturnReadRX() reads from.
+// transmit: SaturnSetTX(), SaturnSetMOX(true), then keep the DUC fed with
+// SaturnWriteTX() at 192KHz.
+// samples are I then Q, as int32_t holding the 24 bit values sign extended.
+//
+// build with make in sw_projects/libsaturn; "make sim" builds libsaturn-sim.so
+// with the simulated hardware, to develop without a Saturn board.
+//
+//////////////////////////////////////////////////////////////
+
+#ifndef __libsaturn_h
+#define __libsaturn_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#define SATURNAPIVERSION 1
+#define SATURNMAXDDC 10                         // DDC numbers are 0 to SATURNMAXDDC-1
+#define SATURNTXRATE 192000                     // DUC sample rate, Hz
+#define SATURNRXBUFFERSAMPLES 65536             // I/Q samples buffered per DDC for SaturnReadRX()
+
+#define SATURNAPI __attribute__((visibility("default")))
+
+
+//
+// receive callback: Samples I/Q samples (2*Samples int32_t values, I then Q) from DDC.
+// called on the receive thread, after each DMA for each DDC with samples; it should not block
+//
+typedef void (*TSaturnRXCallback)(uint32_t DDC, const int32_t* IQ, uint32_t Samples, void* Context);
+
+
+//
+// uint32_t SaturnGetAPIVersion(void)
+// returns SATURNAPIVERSION of the library, for a run time check against the header
+//
+SATURNAPI uint32_t SaturnGetAPIVersion(void);
+
+
+//
+// bool SaturnOpen(uint32_t Card)
+// open Saturn board Card (0 for /dev/xdma0_*) and set the registers up for use:
+// codec, TX for protocol 2 sample format, all DDCs off.
+// returns false if the board can't be opened or its firmware is not supported
+//
+SATURNAPI bool SaturnOpen(uint32_t Card);
+
+
+//
+// void SaturnClose(void)
+// stop receive and transmit, and close the board
+//
+SATURNAPI void SaturnClose(void);
+
+
+//
+// bool SaturnSetDDC(uint32_t DDC, uint32_t RateKHz, uint32_t ADC, uint32_t FrequencyHz)
+// set a DDC up: sample rate 48, 96, 192, 384, 768 or 1536KHz, or 0 to turn it off;
+// ADC 0 or 1; its frequency. Call before SaturnStartRX(): while receiving, only
+// the frequency can be changed (use SaturnSetDDCFrequency()).
+// returns false if a setting is not valid
+//
+SATURNAPI bool SaturnSetDDC(uint32_t DDC, uint32_t RateKHz, uint32_t ADC, uint32_t FrequencyHz);
+
+
+//
+// bool SaturnSetDDCFrequency(uint32_t DDC, uint32_t FrequencyHz)
+// retune a DDC; can be called at any time
+//
+SATURNAPI bool SaturnSetDDCFrequency(uint32_t DDC, uint32_t FrequencyHz);
+
+
+//
+// bool SaturnStartRX(TSaturnRXCallback Callback, void* Context)
+// start the DDC stream and the receive thread.
+// with a Callback, all samples are passed to it. With Callback NULL, they are kept
+// in a buffer per DDC (the newest are dropped if it is full) for SaturnReadRX().
+// returns false if already receiving, or the stream can't be started
+//
+SATURNAPI bool SaturnStartRX(TSaturnRXCallback Callback, void* Context);
+
+
+//
+// uint32_t SaturnReadRX(uint32_t DDC, int32_t* IQ, uint32_t MaxSamples, uint32_t TimeoutMs)
+// buffered receive (SaturnStartRX() with no callback): copy up to MaxSamples I/Q samples
+// from a DDC to IQ (2 int32_t per sample), waiting up to TimeoutMs for the 1st one.
+// can be called from any thread.
+// returns the number of samples copied
+//
+SATURNAPI uint32_t SaturnReadRX(uint32_t DDC, int32_t* IQ, uint32_t MaxSamples, uint32_t TimeoutMs);
+
+
+//
+// uint64_t SaturnGetRXDropped(uint32_t DDC)
+// returns the samples dropped because the SaturnReadRX() buffer of a DDC was full
+//
+SATURNAPI uint64_t SaturnGetRXDropped(uint32_t DDC);
+
+
+//
+// void SaturnStopRX(void)
+// stop the receive thread and the DDC stream
+//
+SATURNAPI void SaturnStopRX(void);
+
+
+//
+// bool SaturnSetTX(uint32_t FrequencyHz, uint32_t DriveLevel)
+// set the DUC frequency and the drive level (0-255)
+//
+SATURNAPI bool SaturnSetTX(uint32_t FrequencyHz, uint32_t DriveLevel);
+
+
+//
+// void SaturnSetMOX(bool MOX)
+// switch between receive and transmit
+//
+SATURNAPI void SaturnSetMOX(bool MOX);
+
+
+//
+// uint32_t SaturnWriteTX(const int32_t* IQ, uint32_t Samples)
+// queue I/Q samples (2 int32_t per sample, 24 bit values) for the DUC, and write as many
+// as the DUC FIFO has space for. Does not wait: call it at least every few ms in TX.
+// returns the number of samples accepted (fewer if the TX buffer is full)
+//
+SATURNAPI uint32_t SaturnWriteTX(const int32_t* IQ, uint32_t Samples);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
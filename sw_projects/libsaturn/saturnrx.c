@@ -0,0 +1,99 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// saturnrx.c:
+//
+// libsaturn example client: receive from one DDC for a few seconds with
+// SaturnReadRX(), and report the sample rate seen and the signal level.
+//   saturnrx [-d ddc] [-r KHz] [-f Hz] [-s seconds]
+//
+//////////////////////////////////////////////////////////////
+
+#include "libsaturn.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+
+
+#define VREADSAMPLES 4096                       // I/Q samples read at a time
+
+
+static double ElapsedSeconds(const struct timespec* Start)
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (double)(Now.tv_sec - Start->tv_sec) + (double)(Now.tv_nsec - Start->tv_nsec) / 1e9;
+}
+
+
+int main(int argc, char* argv[])
+{
+    static int32_t IQ[2 * VREADSAMPLES];
+    uint32_t DDC = 0, RateKHz = 192, FrequencyHz = 7100000, Seconds = 5;
+    uint32_t Samples, Cntr;
+    uint64_t Total = 0;
+    double Power = 0.0, Value;
+    struct timespec Start;
+    int CmdOption;
+
+    while((CmdOption = getopt(argc, argv, "d:r:f:s:h")) != -1)
+    {
+        switch(CmdOption)
+        {
+            case 'd':
+                DDC = (uint32_t)atoi(optarg);
+                break;
+            case 'r':
+                RateKHz = (uint32_t)atoi(optarg);
+                break;
+            case 'f':
+                FrequencyHz = (uint32_t)atoi(optarg);
+                break;
+            case 's':
+                Seconds = (uint32_t)atoi(optarg);
+                break;
+            default:
+                printf("usage: saturnrx [-d ddc] [-r KHz] [-f Hz] [-s seconds]\n");
+                return EXIT_SUCCESS;
+        }
+    }
+    if(SaturnGetAPIVersion() != SATURNAPIVERSION)
+    {
+        printf("libsaturn API version %u, built for %d\n", SaturnGetAPIVersion(), SATURNAPIVERSION);
+        return EXIT_FAILURE;
+    }
+    if(!SaturnOpen(0))
+        return EXIT_FAILURE;
+    if(!SaturnSetDDC(DDC, RateKHz, 0, FrequencyHz) || !SaturnStartRX(NULL, NULL))
+    {
+        printf("DDC%u at %uKHz could not be started\n", DDC, RateKHz);
+        SaturnClose();
+        return EXIT_FAILURE;
+    }
+    printf("DDC%u: %uKHz at %uHz for %us\n", DDC, RateKHz, FrequencyHz, Seconds);
+    clock_gettime(CLOCK_MONOTONIC, &Start);
+    while(ElapsedSeconds(&Start) < Seconds)
+    {
+        Samples = SaturnReadRX(DDC, IQ, VREADSAMPLES, 100);
+        for(Cntr = 0; Cntr < 2 * Samples; Cntr++)
+        {
+            Value = (double)IQ[Cntr] / 8388608.0;
+            Power += Value * Value;
+        }
+        Total += Samples;
+    }
+    printf("%llu samples (%.1fKHz), level %.1fdBFS, %llu dropped\n",
+           (unsigned long long)Total, (double)Total / ElapsedSeconds(&Start) / 1000.0,
+           (Total != 0) ? 10.0 * log10(Power / (double)Total + 1e-20) : -200.0,
+           (unsigned long long)SaturnGetRXDropped(DDC));
+    SaturnClose();
+    return EXIT_SUCCESS;
+}
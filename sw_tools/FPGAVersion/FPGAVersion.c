@@ -33,6 +33,7 @@
 //------------------------------------------------------------------------------------------
 // VERSION History
 // V1, 1/3/2025:   initial release
+// V2:            optional board (XDMA card) number for hosts with several Saturn boards
 
 
 
@@ -41,15 +42,19 @@
 
 //
 // main program. Ijust get version information and display
+// usage: ./FPGAVersion [board]
 //
-int main()
+int main(int argc, char *argv[])
 {
   int FWVersion;
   ESoftwareID FWID;
 
+  if((argc > 1) && !SelectXDMACard((uint32_t)atoi(argv[1])))
+  {
+    printf("Saturn board %s not valid\n", argv[1]);
+    return EXIT_FAILURE;
+  }
   OpenXDMADriver(true);
   FWVersion = GetFirmwareVersion(&FWID);
   printf("FPGA Firmware version = %d\n", FWVersion);
 }
-
-
@@ -15,6 +15,16 @@
 //		prototype for thread - open buffer, read many blocks and write CSV file
 // 		(Jan 2022, current code)
 //
+// Plan D
+//		benchmark mode (-b): run the FIFO monitor, DMA and DDC unpack pipeline
+//		from the common stream code for a set time at a given DDC rate setting,
+//		and report the sustained sample rate, DMA sizes, time in each stage
+//		and the peak FIFO occupancy. Used to qualify a unit for 10 DDC operation.
+//
+// ./iqdmatest                            write sine.csv as before
+// ./iqdmatest -b 10 -n 10 -r 384         benchmark 10 DDCs at 384KHz for 10s
+//             [-w words]                 FIFO depth to wait for before each DMA
+//
 
 #define _DEFAULT_SOURCE
 #define _XOPEN_SOURCE 500
@@ -28,6 +38,8 @@
 #include <unistd.h>
 #include <errno.h>
 #include <time.h>
+#include <signal.h>
+#include <stdbool.h>
 
 #include <sys/mman.h>
 #include <sys/stat.h>
@@ -35,16 +47,17 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "../../sw_projects/common/saturntypes.h"
+#include "../../sw_projects/common/hwaccess.h"
+#include "../../sw_projects/common/saturnregisters.h"
+#include "../../sw_projects/common/saturndrivers.h"
+#include "../../sw_projects/common/sampleunpack.h"
+#include "../../sw_projects/common/streamcore.h"
+
 #define VTRANSFERSIZE 4096										// size in bytes to DMA transfer
 #define VMEMBUFFERSIZE 32768									// memory buffer to reserve
 #define AXIBaseAddress 0x18000									// address of StreamRead/Writer IP
 
-//
-// mem read/write variables:
-//
-	int register_fd;                             // device identifier
-
-
 //
 // dump a memory buffer to terminal in hex
 // should be a multiple of 16 bytes long!
@@ -68,63 +81,6 @@ void DumpMemoryBuffer(char* MemPtr, uint32_t Length)
 
 
 
-//
-// initiate a DMA from the FPGA with specified parameters
-// returns 1 if success, else 0
-// fd: file device (an open file)
-// DestData: pointer to memory block to transfer
-// Length: number of bytes to copy
-// AXIAddr: offset address in the FPGA window 
-//
-int DMAReadFromFPGA(int fd, char*DestData, uint32_t Length, uint32_t AXIAddr)
-{
-	ssize_t rc;									// response code
-	off_t OffsetAddr;
-
-	OffsetAddr = AXIAddr;
-	rc = lseek(fd, OffsetAddr, SEEK_SET);
-	if (rc != OffsetAddr)
-	{
-		printf("seek off 0x%lx != 0x%lx.\n", rc, OffsetAddr);
-		perror("seek file");
-		return -EIO;
-	}
-
-	// write data to FPGA from memory buffer
-	rc = read(fd, DestData, Length);
-	if (rc < 0)
-	{
-		printf("read 0x%lx @ 0x%lx failed %ld.\n", Length, OffsetAddr, rc);
-		perror("DMA read");
-		return -EIO;
-	}
-	return 0;
-}
-
-
-
-uint32_t RegisterRead(uint32_t Address)
-{
-	uint32_t result = 0;
-
-    ssize_t nread = pread(register_fd, &result, sizeof(result), (off_t) Address);
-    if (nread != sizeof(result))
-        printf("ERROR: register read: addr=0x%08X   error=%s\n",Address, strerror(errno));
-	return result;
-}
-
-
-//
-// 32 bit register write over the AXILite bus
-//
-void RegisterWrite(uint32_t Address, uint32_t Data)
-{
-    ssize_t nsent = pwrite(register_fd, &Data, sizeof(Data), (off_t) Address); 
-    if (nsent != sizeof(Data))
-        printf("ERROR: Write: addr=0x%08X   error=%s\n",Address, strerror(errno));
-}
-
-
 #define VCSVCOUNT 83					// 83 I/Q pairs similar to one USB frame
 #define VPACKETSIZE VCSVCOUNT*6			// number of bytes needed for one CSV record
 //
@@ -154,6 +110,261 @@ unsigned char * CSVWrite(FILE* fd, unsigned char* Ptr, uint32_t* Counter)
 
 
 
+//
+// benchmark mode
+// runs the DDC stream through the common FIFO monitor, DMA and unpack code
+// (streamcore.c, saturndrivers.c, sampleunpack.c) as the protocol apps do
+//
+#define VBENCHRINGSIZE 131072							// DDC ring buffer
+#define VBENCHDMAWORDS 512								// default FIFO depth to DMA at: 4K bytes
+#define VBENCHMAXDMAWORDS 4096							// largest DMA: 32K bytes
+#define VBENCHGRANULE 4096								// DMA size histogram bin width (bytes)
+#define VBENCHBINS (VBENCHMAXDMAWORDS * 8 / VBENCHGRANULE)
+#define VDDCFRAMERATE 48000								// DDC frames per second
+#define VBENCHMINPASS 0.99								// fraction of the nominal rate to pass
+
+static volatile int BenchRun = 1;
+
+
+//
+// callback from saturn register code
+// not needed here
+//
+void HandlerSetEERMode(__attribute__((unused)) bool EEREnabled)
+{
+
+}
+
+
+static void BenchSignalHandler(int Signal)
+{
+	(void)Signal;
+	BenchRun = 0;
+}
+
+
+//
+// time in ns between two times
+//
+static uint64_t BenchElapsedNs(struct timespec* Then, struct timespec* Now)
+{
+	return (uint64_t)(Now->tv_sec - Then->tv_sec) * 1000000000ULL + Now->tv_nsec - Then->tv_nsec;
+}
+
+
+static inline bool IsDDCHeader(uint8_t* Ptr)
+{
+	return (*(Ptr + 7) == 0x80);
+}
+
+
+//
+// run the benchmark
+// Seconds: run time; NumDDC: DDCs enabled, from DDC0; RateKHz: rate for each DDC
+// MinWords: FIFO depth to wait for before each DMA
+// returns 0 if the sustained rate was within VBENCHMINPASS of nominal and the FIFO didn't overflow
+//
+static int RunBenchmark(uint32_t Seconds, uint32_t NumDDC, uint32_t RateKHz, uint32_t MinWords)
+{
+	struct StreamRing DDCRing;
+	struct StreamSource DDCSource;
+	int DMAReadfile_fd = -1;
+	int DDCEvent_fd = -1;
+	uint8_t* UnpackBuffer = NULL;
+	const struct DDCFramePlan* FramePlan = NULL;
+	uint32_t PrevRateWord = 0;
+	uint32_t RateWord;
+	uint32_t FrameBytes;
+	uint32_t WordRate = 0;
+	uint32_t Entry;
+	uint32_t DDC;
+	uint32_t Bytes;
+	uint32_t Bin;
+	uint8_t* IQReadPtr;
+	uint8_t* SamplePtr;
+	struct timespec Start, End, StageStart, StageEnd;
+	uint64_t RunNs;
+	uint64_t RunLimitNs = (uint64_t)Seconds * 1000000000ULL;
+	uint64_t WaitNs = 0, DMANs = 0, UnpackNs = 0;
+	uint64_t Samples = 0;
+	uint64_t DMABytes = 0;
+	uint32_t DMACount = 0;
+	uint32_t DMAMin = 0xFFFFFFFF;
+	uint32_t DMAMax = 0;
+	uint32_t DMABins[VBENCHBINS];
+	uint32_t PeakDepth = 0;
+	uint32_t Resyncs = 0;
+	double Nominal, Sustained;
+	int Result = 1;
+
+	if((NumDDC == 0) || (NumDDC > VNUMDDC))
+	{
+		printf("DDC count must be 1 to %d\n", VNUMDDC);
+		return 1;
+	}
+	if((MinWords < (VBENCHGRANULE / 8)) || (MinWords > VBENCHMAXDMAWORDS))
+	{
+		printf("DMA depth must be %d to %d words\n", VBENCHGRANULE / 8, VBENCHMAXDMAWORDS);
+		return 1;
+	}
+	memset(DMABins, 0, sizeof(DMABins));
+	if(OpenXDMADriver(false) == 0)
+		return 1;
+	InitialiseSampleUnpack();
+	if(!StreamRingCreate(&DDCRing, VBENCHRINGSIZE, "benchmark DDC"))
+		goto out;
+	UnpackBuffer = malloc(VBENCHMAXDMAWORDS * 6);
+	DMAReadfile_fd = OpenDMADevice(VDDCDMADEVICE, O_RDONLY);
+	if((UnpackBuffer == NULL) || (DMAReadfile_fd < 0))
+	{
+		printf("XDMA read device open failed for DDC data\n");
+		goto destroy;
+	}
+
+//
+// stop the DDC stream, set the DDC rates, then reset the FIFO and restart
+//
+	SetRXDDCEnabled(false);
+	usleep(1000);										// give FIFO time to stop recording
+	for(DDC = 0; DDC < VNUMDDC; DDC++)
+		SetP2SampleRate(DDC, DDC < NumDDC, RateKHz, false);
+	WriteP2DDCRateRegister();
+	DDCEvent_fd = OpenFIFOMonitorEvents(eRXDDCDMA);
+	if(DDCEvent_fd >= 0)
+		SetupFIFOMonitorThreshold(eRXDDCDMA, MinWords, true);
+	else
+		SetupFIFOMonitorChannel(eRXDDCDMA, false);
+	ResetDMAStreamFIFO(eRXDDCDMA);
+	StreamSourceInitialise(&DDCSource, DMAReadfile_fd, eRXDDCDMA, VADDRDDCSTREAMREAD,
+						   VBENCHGRANULE, VBENCHMAXDMAWORDS * 8, DDCEvent_fd);
+	signal(SIGINT, BenchSignalHandler);
+	printf("benchmark: %u DDCs at %uKHz for %us, DMA at %u words, %s, %s unpack\n", NumDDC, RateKHz, Seconds,
+		   MinWords, (DDCEvent_fd >= 0) ? "FIFO events" : "timed waits", SampleUnpackUsesNEON() ? "NEON" : "scalar");
+	SetRXDDCEnabled(true);
+	clock_gettime(CLOCK_MONOTONIC, &Start);
+
+	RunNs = 0;
+	while(BenchRun && (RunNs < RunLimitNs))
+	{
+		//
+		// wait for data: includes the FIFO monitor depth reads
+		//
+		clock_gettime(CLOCK_MONOTONIC, &StageStart);
+		StreamSourceWait(&DDCSource, MinWords, WordRate, &BenchRun);
+		clock_gettime(CLOCK_MONOTONIC, &StageEnd);
+		WaitNs += BenchElapsedNs(&StageStart, &StageEnd);
+		if(!BenchRun)
+			break;
+		if(DDCSource.Depth > PeakDepth)
+			PeakDepth = DDCSource.Depth;
+
+		//
+		// DMA as much as is available
+		//
+		StageStart = StageEnd;
+		Bytes = StreamSourceRead(&DDCSource, &DDCRing);
+		clock_gettime(CLOCK_MONOTONIC, &StageEnd);
+		DMANs += BenchElapsedNs(&StageStart, &StageEnd);
+		if(Bytes != 0)
+		{
+			DMACount++;
+			DMABytes += Bytes;
+			if(Bytes < DMAMin)
+				DMAMin = Bytes;
+			if(Bytes > DMAMax)
+				DMAMax = Bytes;
+			Bin = (Bytes - 1) / VBENCHGRANULE;
+			if(Bin >= VBENCHBINS)
+				Bin = VBENCHBINS - 1;
+			DMABins[Bin]++;
+		}
+
+		//
+		// decode whole DDC frames and unpack the samples
+		//
+		StageStart = StageEnd;
+		while(StreamRingUsed(&DDCRing) >= 16)
+		{
+			IQReadPtr = StreamRingReadPtr(&DDCRing);
+			if(!IsDDCHeader(IQReadPtr))
+			{
+				Resyncs++;
+				while((StreamRingUsed(&DDCRing) >= 8) && !IsDDCHeader(StreamRingReadPtr(&DDCRing)))
+					StreamRingConsume(&DDCRing, 8);
+				continue;
+			}
+			RateWord = *(uint32_t*)IQReadPtr;
+			if((RateWord != PrevRateWord) || (FramePlan == NULL))
+			{
+				FramePlan = GetDDCFramePlan(RateWord);
+				PrevRateWord = RateWord;
+				WordRate = (FramePlan->FrameLength + 1) * VDDCFRAMERATE;
+			}
+			FrameBytes = (FramePlan->FrameLength + 1) * 8;
+			if(StreamRingUsed(&DDCRing) < FrameBytes)
+				break;
+			SamplePtr = IQReadPtr + 8;
+			for(Entry = 0; Entry < FramePlan->ActiveDDCs; Entry++)
+			{
+				UnpackDDCSamples(UnpackBuffer + (FramePlan->Offset[Entry] / 8) * 6,
+								 SamplePtr + FramePlan->Offset[Entry], FramePlan->Count[Entry]);
+				Samples += FramePlan->Count[Entry];
+			}
+			StreamRingConsume(&DDCRing, FrameBytes);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &StageEnd);
+		UnpackNs += BenchElapsedNs(&StageStart, &StageEnd);
+		RunNs = BenchElapsedNs(&Start, &StageEnd);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &End);
+	SetRXDDCEnabled(false);
+	RunNs = BenchElapsedNs(&Start, &End);
+
+//
+// report
+//
+	Nominal = (double)NumDDC * (double)RateKHz / 1000.0;
+	Sustained = (double)Samples / ((double)RunNs / 1000.0);
+	printf("ran for %.3fs: %llu samples\n", (double)RunNs / 1.0E9, (unsigned long long)Samples);
+	printf("sustained %.3f MS/s (nominal %.3f MS/s, %.1f%%)\n", Sustained, Nominal, 100.0 * Sustained / Nominal);
+	if(DMACount != 0)
+	{
+		printf("DMA: %u transfers; min %u, mean %llu, max %u bytes\n", DMACount, DMAMin,
+			   (unsigned long long)(DMABytes / DMACount), DMAMax);
+		for(Bin = 0; Bin < VBENCHBINS; Bin++)
+			if(DMABins[Bin] != 0)
+				printf("    up to %2uK bytes: %u\n", (Bin + 1) * VBENCHGRANULE / 1024, DMABins[Bin]);
+	}
+	else
+		printf("DMA: no transfers\n");
+	printf("time: wait %.3fs (%.1f%%), DMA %.3fs (%.1f%%), decode/unpack %.3fs (%.1f%%)\n",
+		   (double)WaitNs / 1.0E9, 100.0 * (double)WaitNs / (double)RunNs,
+		   (double)DMANs / 1.0E9, 100.0 * (double)DMANs / (double)RunNs,
+		   (double)UnpackNs / 1.0E9, 100.0 * (double)UnpackNs / (double)RunNs);
+	printf("FIFO: peak occupancy %u words (%u bytes); %u overflows; %u resyncs\n",
+		   PeakDepth, PeakDepth * 8, DDCSource.Overflows, Resyncs);
+	if((Sustained >= VBENCHMINPASS * Nominal) && (DDCSource.Overflows == 0))
+	{
+		printf("PASS\n");
+		Result = 0;
+	}
+	else
+		printf("FAIL\n");
+
+destroy:
+	if(DDCEvent_fd >= 0)
+		close(DDCEvent_fd);
+	if(DMAReadfile_fd >= 0)
+		close(DMAReadfile_fd);
+	free(UnpackBuffer);
+	StreamRingDestroy(&DDCRing);
+out:
+	CloseXDMADriver();
+	return Result;
+}
+
+
+
 #define VALIGNMENT 4096
 #define VBASE 0x1000									// DMA start at 4K into buffer
 
@@ -177,6 +388,37 @@ int main(int argc, char *argv[])
 	unsigned char* HeadPtr;									// ptr to 1st free location
 	unsigned char* BasePtr;									// ptr to DMA location
 	uint32_t ResidueBytes;
+
+	uint32_t BenchSeconds = 0;									// benchmark mode if not 0
+	uint32_t BenchDDCs = 1;
+	uint32_t BenchRate = 48;
+	uint32_t BenchWords = VBENCHDMAWORDS;
+	int Option;
+
+	while ((Option = getopt(argc, argv, "b:n:r:w:")) != -1)
+	{
+		switch (Option)
+		{
+		case 'b':
+			BenchSeconds = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			BenchDDCs = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			BenchRate = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			BenchWords = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			printf("usage: iqdmatest [-b seconds [-n DDCs] [-r rateKHz] [-w words]]\n");
+			return 1;
+		}
+	}
+	if (BenchSeconds != 0)
+		return RunBenchmark(BenchSeconds, BenchDDCs, BenchRate, BenchWords);
+
 //
 // initialise. Create memory buffers and open DMA file devices
 //
@@ -193,13 +435,8 @@ int main(int argc, char *argv[])
 //
 // try to open memory device, then DMA device
 //
-	if ((register_fd = open("/dev/xdma0_user", O_RDWR)) == -1)
-    {
-		printf("register R/W address space not available\n");
+	if (OpenXDMADriver(false) == 0)
 		goto out;
-    }
-    else
-		printf("register access connected to /dev/xdma0_user\n");
 
 
 	printf("Initialising XDMA read\n");
@@ -301,7 +538,7 @@ int main(int argc, char *argv[])
 //
 out:
 	close(DMAReadfile_fd);
-	close(register_fd);
+	CloseXDMADriver();
 
 	free(ReadBuffer);
 }
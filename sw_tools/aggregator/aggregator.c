@@ -0,0 +1,667 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+//
+// licenced under GNU GPL3
+//
+// aggregator.c:
+//
+// merges the DDC streams of several Saturn radios into time aligned frames,
+// eg for diversity reception or direction finding. Each radio runs p2app with
+// wall clock DDC timestamps (-J), and sends a DDC to this host with a fan-out
+// destination, each radio to its own port:
+//   p2app -J -F 192.168.1.10:5001@0          (radio 1)
+//   p2app -J -F 192.168.1.10:5002@0          (radio 2)
+//   ./aggregator -s 192000 -o 127.0.0.1:6000 -r 5001 -r 5002
+//
+// one receive thread per radio takes its packets with recvmmsg() straight into
+// that radio's lock-free ring (../../sw_projects/common/spscring.c), tagging each
+// with the sample index of its 1st sample: the timestamp as a count of samples
+// at the DDC rate, plus a calibration offset for the radio. The merge thread
+// lines the rings up by sample index and sends combined frames, with sendmmsg():
+//   0   sequence number (32 bit big endian)
+//   4   timestamp of the 1st sample, ns since 1970 (64 bit big endian)
+//   12  number of radios (16 bit)
+//   14  samples per radio in the frame (16 bit)
+//   16  samples: for each sample time, the I then Q sample of each radio in turn,
+//       24 bit big endian, as in a protocol 2 DDC packet
+// samples a radio didn't deliver (lost packets, or a radio more than the latency
+// limit behind the others) are sent as 0, and counted.
+// the radios' timestamps agree only as well as their clocks, so the hosts should
+// be PTP synchronised, and the radios share a 10MHz reference so their sample
+// clocks don't drift apart. A remaining fixed offset can be trimmed with -r <port>:<samples>.
+//
+// ./aggregator -s <rate> [-o <addr>:<port>] [-f file] [-n samples] [-l ms] [-c core,core..] [-v]
+//              -r <port>[:<offset>] -r <port>[:<offset>] ...
+//
+//////////////////////////////////////////////////////////////
+
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <getopt.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sched.h>
+#include <endian.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "spscring.h"
+
+//------------------------------------------------------------------------------------------
+// VERSION History
+// V1:   initial release
+
+
+#define VMAXRADIOS 16
+#define VRINGSLOTS 8192                         // packets buffered per radio (power of 2)
+#define VRECVBATCH 32                           // most packets taken by one recvmmsg()
+#define VSENDBATCH 16                           // most frames sent by one sendmmsg()
+#define VDDCPACKETSIZE 1444                     // protocol 2 DDC packet
+#define VDDCHEADERSIZE 16
+#define VSAMPLESPERPACKET 238
+#define VBYTESPERSAMPLE 6                       // 24 bit I and Q
+#define VFRAMEHEADERSIZE 16
+#define VMAXFRAMESIZE 1472                      // combined frame fits a 1500 byte MTU
+#define VDEFAULTLATENCY 50                      // ms a frame waits for a late radio
+#define VSTARTTIMEOUT 2000                      // ms to wait for every radio's 1st packet
+#define VSOCKETBUFFER (4 * 1024 * 1024)
+#define VRECVTIMEOUT 100000                     // us: receive threads check for exit this often
+
+
+//
+// one received packet in a radio's ring
+//
+struct RadioPacket
+{
+    uint8_t Data[VDDCPACKETSIZE];
+    uint64_t Index;                             // sample index of the 1st sample
+    bool Valid;                                 // false if not a usable 24 bit DDC packet
+};
+
+
+//
+// one radio: its socket and receive thread, its ring, and the merge thread's place in it
+//
+struct Radio
+{
+    uint16_t Port;
+    int64_t Offset;                             // calibration, samples added to the index
+    int Socket;
+    int Core;                                   // CPU for the receive thread, -1 = any
+    pthread_t Thread;
+    struct SPSCRing Ring;
+    struct RadioPacket* Packets;
+    //
+    // statistics, counted by the receive thread (__atomic: read by the merge thread)
+    //
+    uint64_t Received;
+    uint64_t Dropped;                           // ring full
+    uint64_t Invalid;                           // wrong size or format, or no timestamp
+    uint64_t SequenceErrors;
+    uint32_t LastSequence;
+    uint64_t BaseTime;                          // timestamp of the 1st packet, and its sample index
+    uint64_t BaseIndex;
+    //
+    // merge thread
+    //
+    uint64_t ZeroFilled;                        // samples sent as 0
+    uint32_t Filled;                            // samples of the current frame filled
+};
+
+
+//
+// settings
+//
+static struct Radio Radios[VMAXRADIOS];
+static uint32_t NumRadios = 0;
+static uint32_t SampleRate = 0;
+static struct sockaddr_in OutputAddr;
+static bool UseOutputAddr = false;
+static const char* OutputFilename = NULL;
+static uint32_t FrameSamples = 0;               // 0: as many as fit VMAXFRAMESIZE
+static uint32_t LatencyLimit = VDEFAULTLATENCY;
+static bool Verbose = false;
+static volatile bool Running = true;
+
+
+//
+// output batch
+//
+static uint8_t Frames[VSENDBATCH][VMAXFRAMESIZE];
+static struct mmsghdr FrameMessages[VSENDBATCH];
+static struct iovec FrameVectors[VSENDBATCH];
+static uint32_t FramesQueued = 0;
+static uint32_t FrameBytes;
+static int Output_fd = -1;
+static FILE* OutputFile = NULL;
+static uint64_t FramesSent = 0;
+
+
+static void PrintUsage(void)
+{
+    printf("usage: aggregator -s <rate> [-o <addr>:<port>] [-f file] [-n samples] [-l ms] [-c core,core..] [-v]\n");
+    printf("                  -r <port>[:<offset>] -r <port>[:<offset>] ...\n");
+    printf("   -s rate      DDC sample rate of the radios, Hz\n");
+    printf("   -r port      receive a radio's DDC packets on this port; offset (samples) trims its alignment\n");
+    printf("   -o addr:port send the combined frames to this address\n");
+    printf("   -f file      write the combined frames to this file (- for stdout)\n");
+    printf("   -n samples   samples per radio in each frame (default: as many as fit %d bytes)\n", VMAXFRAMESIZE);
+    printf("   -l ms        longest a frame waits for a radio before its samples are sent as 0 (default %d)\n", VDEFAULTLATENCY);
+    printf("   -c cores     CPU cores for the receive threads, one per radio in turn\n");
+    printf("   -v           print statistics every second\n");
+}
+
+
+static uint64_t GetTimeMs(void)
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (uint64_t)Now.tv_sec * 1000ULL + (uint64_t)Now.tv_nsec / 1000000ULL;
+}
+
+
+//
+// timestamp (ns since 1970) to sample index at SampleRate, and back
+// split at whole seconds so neither overflows 64 bits.
+// a radio's packets are indexed from its 1st one: p2app truncates each timestamp to the ns,
+// so rounding each of them separately could put consecutive packets a sample out
+//
+static uint64_t TimeToIndex(uint64_t Ns)
+{
+    return (Ns / 1000000000ULL) * SampleRate + ((Ns % 1000000000ULL) * SampleRate + 500000000ULL) / 1000000000ULL;
+}
+
+
+static uint64_t IndexToTime(uint64_t Index)
+{
+    return (Index / SampleRate) * 1000000000ULL + ((Index % SampleRate) * 1000000000ULL) / SampleRate;
+}
+
+
+static void HandleSignal(__attribute__((unused)) int Signal)
+{
+    Running = false;
+}
+
+
+//
+// receive thread: take packets with recvmmsg() into free ring slots, tag and publish them
+// if the ring is full, packets are read into a scratch buffer and dropped
+//
+static void* ReceiveThread(void* arg)
+{
+    struct Radio* Radio = (struct Radio*)arg;
+    struct mmsghdr Messages[VRECVBATCH];
+    struct iovec Vectors[VRECVBATCH];
+    int32_t Slots[VRECVBATCH];
+    static __thread uint8_t Scratch[VDDCPACKETSIZE];
+    struct RadioPacket* Packet;
+    uint32_t Free, Cntr, Sequence;
+    uint64_t TimeStamp;
+    int Received;
+    cpu_set_t CPUs;
+
+    if (Radio->Core >= 0)
+    {
+        CPU_ZERO(&CPUs);
+        CPU_SET(Radio->Core, &CPUs);
+        pthread_setaffinity_np(pthread_self(), sizeof(CPUs), &CPUs);
+    }
+    while (Running)
+    {
+        for (Free = 0; Free < VRECVBATCH; Free++)
+        {
+            Slots[Free] = SPSCGetWriteSlotAhead(&Radio->Ring, Free);
+            if (Slots[Free] < 0)
+                break;
+        }
+        memset(Messages, 0, sizeof(Messages));
+        for (Cntr = 0; Cntr < ((Free == 0) ? 1 : Free); Cntr++)
+        {
+            Vectors[Cntr].iov_base = (Free == 0) ? Scratch : Radio->Packets[Slots[Cntr]].Data;
+            Vectors[Cntr].iov_len = VDDCPACKETSIZE;
+            Messages[Cntr].msg_hdr.msg_iov = &Vectors[Cntr];
+            Messages[Cntr].msg_hdr.msg_iovlen = 1;
+        }
+        Received = recvmmsg(Radio->Socket, Messages, (Free == 0) ? 1 : Free, MSG_WAITFORONE, NULL);
+        if (Received <= 0)
+            continue;                                   // timeout: check for exit
+        if (Free == 0)
+        {
+            __atomic_fetch_add(&Radio->Dropped, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        for (Cntr = 0; Cntr < (uint32_t)Received; Cntr++)
+        {
+            Packet = &Radio->Packets[Slots[Cntr]];
+            memcpy(&TimeStamp, Packet->Data + 4, sizeof(TimeStamp));
+            TimeStamp = be64toh(TimeStamp);
+            Packet->Valid = (Messages[Cntr].msg_len == VDDCPACKETSIZE) && (TimeStamp != 0)
+                         && (Packet->Data[12] == 0) && (Packet->Data[13] == 24)
+                         && (((Packet->Data[14] << 8) | Packet->Data[15]) == VSAMPLESPERPACKET);
+            if (!Packet->Valid)
+            {
+                __atomic_fetch_add(&Radio->Invalid, 1, __ATOMIC_RELAXED);
+                SPSCPublish(&Radio->Ring);              // the merge thread skips it
+                continue;
+            }
+            if (Radio->Received == 0)
+            {
+                Radio->BaseTime = TimeStamp;
+                Radio->BaseIndex = TimeToIndex(TimeStamp) + (uint64_t)Radio->Offset;
+            }
+            if (TimeStamp >= Radio->BaseTime)
+                Packet->Index = Radio->BaseIndex + TimeToIndex(TimeStamp - Radio->BaseTime);
+            else
+                Packet->Index = Radio->BaseIndex - TimeToIndex(Radio->BaseTime - TimeStamp);   // reordered
+            Sequence = ((uint32_t)Packet->Data[0] << 24) | ((uint32_t)Packet->Data[1] << 16)
+                     | ((uint32_t)Packet->Data[2] << 8) | Packet->Data[3];
+            if ((Radio->Received != 0) && (Sequence != Radio->LastSequence + 1))
+                __atomic_fetch_add(&Radio->SequenceErrors, 1, __ATOMIC_RELAXED);
+            Radio->LastSequence = Sequence;
+            __atomic_fetch_add(&Radio->Received, 1, __ATOMIC_RELAXED);
+            SPSCPublish(&Radio->Ring);
+        }
+    }
+    return NULL;
+}
+
+
+//
+// oldest usable packet of a radio, or NULL if its ring is empty (invalid packets are released)
+//
+static struct RadioPacket* PeekPacket(struct Radio* Radio)
+{
+    int32_t Slot;
+
+    for (;;)
+    {
+        Slot = SPSCGetReadSlot(&Radio->Ring);
+        if (Slot < 0)
+            return NULL;
+        if (Radio->Packets[Slot].Valid)
+            return &Radio->Packets[Slot];
+        SPSCRelease(&Radio->Ring);
+    }
+}
+
+
+//
+// fill a radio's column of the frame at Frame for samples Start.. Start+FrameSamples, from where
+// it got to (Radio->Filled). Samples in gaps between its packets are 0.
+// returns true when the column is complete; false if it needs more packets
+//
+static bool FillColumn(struct Radio* Radio, uint32_t Column, uint8_t* Frame, uint64_t Start)
+{
+    struct RadioPacket* Packet;
+    uint64_t Position, End;
+    uint32_t Sample, Count, Cntr;
+    uint8_t* Dest;
+
+    while (Radio->Filled < FrameSamples)
+    {
+        Position = Start + Radio->Filled;
+        Packet = PeekPacket(Radio);
+        if (Packet == NULL)
+            return false;
+        if (Packet->Index + VSAMPLESPERPACKET <= Position)
+        {
+            SPSCRelease(&Radio->Ring);                  // all before this frame
+            continue;
+        }
+        Dest = Frame + VFRAMEHEADERSIZE + (Radio->Filled * NumRadios + Column) * VBYTESPERSAMPLE;
+        if (Packet->Index > Position)
+        {
+            //
+            // gap before this packet: zero fill to it, or to the end of the frame
+            //
+            End = Start + FrameSamples;
+            Count = (uint32_t)(((Packet->Index < End) ? Packet->Index : End) - Position);
+            for (Cntr = 0; Cntr < Count; Cntr++)
+                memset(Dest + Cntr * NumRadios * VBYTESPERSAMPLE, 0, VBYTESPERSAMPLE);
+            Radio->ZeroFilled += Count;
+            Radio->Filled += Count;
+            continue;
+        }
+        Sample = (uint32_t)(Position - Packet->Index);
+        Count = VSAMPLESPERPACKET - Sample;
+        if (Count > FrameSamples - Radio->Filled)
+            Count = FrameSamples - Radio->Filled;
+        for (Cntr = 0; Cntr < Count; Cntr++)
+            memcpy(Dest + Cntr * NumRadios * VBYTESPERSAMPLE,
+                   Packet->Data + VDDCHEADERSIZE + (Sample + Cntr) * VBYTESPERSAMPLE, VBYTESPERSAMPLE);
+        Radio->Filled += Count;
+        if (Sample + Count == VSAMPLESPERPACKET)
+            SPSCRelease(&Radio->Ring);
+    }
+    return true;
+}
+
+
+//
+// zero fill the rest of a radio's column: it is too late
+//
+static void ZeroColumn(struct Radio* Radio, uint32_t Column, uint8_t* Frame)
+{
+    Radio->ZeroFilled += FrameSamples - Radio->Filled;
+    for (; Radio->Filled < FrameSamples; Radio->Filled++)
+        memset(Frame + VFRAMEHEADERSIZE + (Radio->Filled * NumRadios + Column) * VBYTESPERSAMPLE, 0, VBYTESPERSAMPLE);
+}
+
+
+//
+// send or write the frames queued
+//
+static void FlushFrames(void)
+{
+    uint32_t Cntr;
+
+    if (FramesQueued == 0)
+        return;
+    if (UseOutputAddr)
+    {
+        for (Cntr = 0; Cntr < FramesQueued; Cntr++)
+        {
+            FrameVectors[Cntr].iov_base = Frames[Cntr];
+            FrameVectors[Cntr].iov_len = FrameBytes;
+            memset(&FrameMessages[Cntr], 0, sizeof(FrameMessages[Cntr]));
+            FrameMessages[Cntr].msg_hdr.msg_name = &OutputAddr;
+            FrameMessages[Cntr].msg_hdr.msg_namelen = sizeof(OutputAddr);
+            FrameMessages[Cntr].msg_hdr.msg_iov = &FrameVectors[Cntr];
+            FrameMessages[Cntr].msg_hdr.msg_iovlen = 1;
+        }
+        if (sendmmsg(Output_fd, FrameMessages, FramesQueued, 0) < 0)
+            perror("sendmmsg");
+    }
+    if (OutputFile != NULL)
+        for (Cntr = 0; Cntr < FramesQueued; Cntr++)
+            fwrite(Frames[Cntr], FrameBytes, 1, OutputFile);
+    FramesSent += FramesQueued;
+    FramesQueued = 0;
+}
+
+
+static void PrintStatistics(uint64_t Next)
+{
+    struct Radio* Radio;
+    uint32_t Cntr;
+
+    fprintf(stderr, "frames %llu;", (unsigned long long)FramesSent);
+    for (Cntr = 0; Cntr < NumRadios; Cntr++)
+    {
+        Radio = &Radios[Cntr];
+        fprintf(stderr, " [%u] rx %llu drop %llu bad %llu seq %llu zero %llu buffered %u;", Radio->Port,
+                (unsigned long long)__atomic_load_n(&Radio->Received, __ATOMIC_RELAXED),
+                (unsigned long long)__atomic_load_n(&Radio->Dropped, __ATOMIC_RELAXED),
+                (unsigned long long)__atomic_load_n(&Radio->Invalid, __ATOMIC_RELAXED),
+                (unsigned long long)__atomic_load_n(&Radio->SequenceErrors, __ATOMIC_RELAXED),
+                (unsigned long long)Radio->ZeroFilled, SPSCOccupancy(&Radio->Ring));
+    }
+    fprintf(stderr, " at %llu\n", (unsigned long long)Next);
+}
+
+
+//
+// merge: wait for every radio's 1st packet, start at the latest of them, then build frames
+//
+static void Merge(void)
+{
+    struct RadioPacket* Packet;
+    uint64_t Next = 0;
+    uint64_t WaitStart = 0;
+    uint64_t StatsTime, Now;
+    uint32_t Sequence = 0;
+    uint32_t Cntr, Complete;
+    uint8_t* Frame;
+    uint64_t TimeStamp;
+
+    //
+    // start: the latest 1st sample of the radios that have started
+    //
+    StatsTime = GetTimeMs();
+    while (Running)
+    {
+        Complete = 0;
+        for (Cntr = 0; Cntr < NumRadios; Cntr++)
+        {
+            Packet = PeekPacket(&Radios[Cntr]);
+            if (Packet != NULL)
+            {
+                Complete++;
+                if (Packet->Index > Next)
+                    Next = Packet->Index;
+            }
+        }
+        if ((Complete == NumRadios) || ((Complete != 0) && (GetTimeMs() - StatsTime > VSTARTTIMEOUT)))
+            break;
+        usleep(1000);
+    }
+    fprintf(stderr, "merging from sample %llu\n", (unsigned long long)Next);
+
+    StatsTime = GetTimeMs();
+    while (Running)
+    {
+        Frame = Frames[FramesQueued];
+        Complete = 0;
+        for (Cntr = 0; Cntr < NumRadios; Cntr++)
+            if (FillColumn(&Radios[Cntr], Cntr, Frame, Next))
+                Complete++;
+        Now = GetTimeMs();
+        if (Complete < NumRadios)
+        {
+            //
+            // a radio is late: send what's done, then wait for it, up to the latency limit
+            // (the part filled frame moves to the start of the batch)
+            //
+            if (FramesQueued != 0)
+            {
+                FlushFrames();
+                memcpy(Frames[0], Frame, FrameBytes);
+            }
+            if (WaitStart == 0)
+                WaitStart = Now;
+            if (Now - WaitStart < LatencyLimit)
+            {
+                usleep(200);
+                continue;
+            }
+            for (Cntr = 0; Cntr < NumRadios; Cntr++)
+                if (Radios[Cntr].Filled < FrameSamples)
+                    ZeroColumn(&Radios[Cntr], Cntr, Frame);
+        }
+        WaitStart = 0;
+
+        *(uint32_t*)Frame = htonl(Sequence++);
+        TimeStamp = htobe64(IndexToTime(Next));
+        memcpy(Frame + 4, &TimeStamp, sizeof(TimeStamp));
+        *(uint16_t*)(Frame + 12) = htons((uint16_t)NumRadios);
+        *(uint16_t*)(Frame + 14) = htons((uint16_t)FrameSamples);
+        for (Cntr = 0; Cntr < NumRadios; Cntr++)
+            Radios[Cntr].Filled = 0;
+        Next += FrameSamples;
+        if (++FramesQueued == VSENDBATCH)
+            FlushFrames();
+
+        if (Verbose && (Now - StatsTime >= 1000))
+        {
+            StatsTime = Now;
+            PrintStatistics(Next);
+        }
+    }
+    FlushFrames();
+    PrintStatistics(Next);
+}
+
+
+//
+// open a radio's receive socket, with a timeout so its thread can see Running cleared
+//
+static bool OpenRadioSocket(struct Radio* Radio)
+{
+    struct sockaddr_in Address;
+    struct timeval Timeout = {0, VRECVTIMEOUT};
+    int BufferSize = VSOCKETBUFFER;
+
+    Radio->Socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (Radio->Socket < 0)
+    {
+        perror("socket");
+        return false;
+    }
+    setsockopt(Radio->Socket, SOL_SOCKET, SO_RCVBUF, &BufferSize, sizeof(BufferSize));
+    setsockopt(Radio->Socket, SOL_SOCKET, SO_RCVTIMEO, &Timeout, sizeof(Timeout));
+    memset(&Address, 0, sizeof(Address));
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_ANY);
+    Address.sin_port = htons(Radio->Port);
+    if (bind(Radio->Socket, (struct sockaddr*)&Address, sizeof(Address)) < 0)
+    {
+        perror("bind");
+        return false;
+    }
+    return true;
+}
+
+
+int main(int argc, char* argv[])
+{
+    int Cores[VMAXRADIOS];
+    uint32_t NumCores = 0;
+    uint32_t Cntr;
+    char* Text;
+    char* Colon;
+    int Option;
+
+    while ((Option = getopt(argc, argv, "s:r:o:f:n:l:c:vh")) != -1)
+    {
+        switch (Option)
+        {
+        case 's':
+            SampleRate = strtoul(optarg, NULL, 0);
+            break;
+        case 'r':
+            if (NumRadios == VMAXRADIOS)
+            {
+                fprintf(stderr, "at most %d radios\n", VMAXRADIOS);
+                return 1;
+            }
+            Radios[NumRadios].Port = (uint16_t)strtoul(optarg, &Text, 0);
+            Radios[NumRadios].Offset = (*Text == ':') ? strtoll(Text + 1, NULL, 0) : 0;
+            NumRadios++;
+            break;
+        case 'o':
+            Colon = strchr(optarg, ':');
+            if (Colon == NULL)
+            {
+                PrintUsage();
+                return 1;
+            }
+            *Colon = 0;
+            memset(&OutputAddr, 0, sizeof(OutputAddr));
+            OutputAddr.sin_family = AF_INET;
+            OutputAddr.sin_port = htons((uint16_t)atoi(Colon + 1));
+            if (inet_pton(AF_INET, optarg, &OutputAddr.sin_addr) != 1)
+            {
+                fprintf(stderr, "bad output address %s\n", optarg);
+                return 1;
+            }
+            UseOutputAddr = true;
+            break;
+        case 'f':
+            OutputFilename = optarg;
+            break;
+        case 'n':
+            FrameSamples = strtoul(optarg, NULL, 0);
+            break;
+        case 'l':
+            LatencyLimit = strtoul(optarg, NULL, 0);
+            break;
+        case 'c':
+            for (Text = strtok(optarg, ","); (Text != NULL) && (NumCores < VMAXRADIOS); Text = strtok(NULL, ","))
+                Cores[NumCores++] = atoi(Text);
+            break;
+        case 'v':
+            Verbose = true;
+            break;
+        default:
+            PrintUsage();
+            return 1;
+        }
+    }
+    if ((SampleRate == 0) || (NumRadios == 0) || (!UseOutputAddr && (OutputFilename == NULL)))
+    {
+        PrintUsage();
+        return 1;
+    }
+    if (FrameSamples == 0)
+        FrameSamples = (VMAXFRAMESIZE - VFRAMEHEADERSIZE) / (NumRadios * VBYTESPERSAMPLE);
+    FrameBytes = VFRAMEHEADERSIZE + FrameSamples * NumRadios * VBYTESPERSAMPLE;
+    if ((FrameSamples == 0) || (FrameBytes > VMAXFRAMESIZE))
+    {
+        fprintf(stderr, "%u radios of %u samples don't fit a %d byte frame\n", NumRadios, FrameSamples, VMAXFRAMESIZE);
+        return 1;
+    }
+
+    if (UseOutputAddr)
+    {
+        Output_fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (Output_fd < 0)
+        {
+            perror("socket");
+            return 1;
+        }
+    }
+    if (OutputFilename != NULL)
+    {
+        OutputFile = (strcmp(OutputFilename, "-") == 0) ? stdout : fopen(OutputFilename, "wb");
+        if (OutputFile == NULL)
+        {
+            perror(OutputFilename);
+            return 1;
+        }
+    }
+    signal(SIGINT, HandleSignal);
+    signal(SIGTERM, HandleSignal);
+
+    for (Cntr = 0; Cntr < NumRadios; Cntr++)
+    {
+        Radios[Cntr].Core = (NumCores != 0) ? Cores[Cntr % NumCores] : -1;
+        Radios[Cntr].Packets = calloc(VRINGSLOTS, sizeof(struct RadioPacket));
+        if (Radios[Cntr].Packets == NULL)
+        {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        SPSCInitialise(&Radios[Cntr].Ring, VRINGSLOTS);
+        if (!OpenRadioSocket(&Radios[Cntr]))
+            return 1;
+        if (pthread_create(&Radios[Cntr].Thread, NULL, ReceiveThread, &Radios[Cntr]) != 0)
+        {
+            perror("pthread_create");
+            return 1;
+        }
+    }
+    fprintf(stderr, "aggregating %u radios at %u Hz, %u samples per frame\n", NumRadios, SampleRate, FrameSamples);
+
+    Merge();
+
+    for (Cntr = 0; Cntr < NumRadios; Cntr++)
+    {
+        pthread_join(Radios[Cntr].Thread, NULL);
+        close(Radios[Cntr].Socket);
+    }
+    if ((OutputFile != NULL) && (OutputFile != stdout))
+        fclose(OutputFile);
+    return 0;
+}
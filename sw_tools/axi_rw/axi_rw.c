@@ -0,0 +1,511 @@
+#include <gtk/gtk.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/mman.h>
+
+#define ADDRWINDOWSIZE 0x20000L                     // size of mapped window for AXI-lite bus
+//
+// global variables:
+//
+    GtkBuilder      *Builder; 
+    GtkWidget       *Window;
+    GtkTextBuffer   *Textbuffer;
+    GtkEntry       *Addrentry;
+    GtkEntry       *Dataentry;
+    GtkStatusbar      *Statusbar;
+    GtkScrolledWindow *Scrollwin;
+
+//
+// mem read/write variables:
+//
+	int fd;                             // device identifier
+    gboolean DriverPresent;
+
+
+
+// called when write button is clicked
+void on_write_button_clicked()
+{
+    const gchar* AddrStr;
+    const gchar* DataStr;
+    uint32_t Address;
+    uint32_t Data;
+    gchar NumString[20];
+    gchar ResultString[60];
+
+    AddrStr = gtk_entry_get_text(Addrentry);
+    Address = strtoul(AddrStr, 0, 16);
+    DataStr = gtk_entry_get_text(Dataentry);
+    Data = strtoul(DataStr, 0, 16);
+//
+// check address is in window, and write if it is
+//
+    if(DriverPresent == TRUE)
+    {
+        if (Address <= (ADDRWINDOWSIZE-4))
+        {
+            ssize_t nsent = pwrite(fd, &Data, sizeof(Data), (off_t) Address); 
+            if (nsent != sizeof(Data))
+            {
+                sprintf(ResultString, "ERROR: Write: addr=0x%08X   error=%s\n",Address, strerror(errno));
+                gtk_text_buffer_insert_at_cursor(Textbuffer, ResultString, -1);
+            }
+            else
+            {
+                sprintf(NumString, "%08x",Data);
+                gtk_entry_set_text(Dataentry, NumString);
+                sprintf(ResultString, "Write: addr=0x%08X   data=0x%08X\n",Address, Data);
+                gtk_text_buffer_insert_at_cursor(Textbuffer, ResultString, -1);
+            }
+        }
+        else
+        {
+                sprintf(ResultString, "ERROR: Write: addr=0x%08X is outside memory window\n",Address);
+                gtk_text_buffer_insert_at_cursor(Textbuffer, ResultString, -1);
+        }
+    }
+}
+  
+// called when read button is clicked
+void on_read_button_clicked()
+{
+    const gchar* AddrStr;
+    const gchar* DataStr;
+    uint32_t Address;
+    uint32_t Data;
+    gchar NumString[20];
+    gchar ResultString[60];
+
+    AddrStr = gtk_entry_get_text(Addrentry);
+    Address = strtoul(AddrStr, 0, 16);
+//
+// check address is in window
+//
+    if(DriverPresent == TRUE)
+    {
+        if (Address <= (ADDRWINDOWSIZE-4))
+        {
+            ssize_t nread = pread(fd, &Data, sizeof(Data), (off_t) Address);
+            if (nread != sizeof(Data))
+            {
+                sprintf(ResultString, "ERROR: Read: addr=0x%08X   error=%s\n",Address, strerror(errno));
+                gtk_text_buffer_insert_at_cursor(Textbuffer, ResultString, -1);
+            }
+            else
+            {
+                sprintf(NumString, "%08x",Data);
+                gtk_entry_set_text(Dataentry, NumString);
+                sprintf(ResultString, "Read: addr=0x%08X   data=0x%08X\n",Address, Data);
+                gtk_text_buffer_insert_at_cursor(Textbuffer, ResultString, -1);
+            }
+        }
+        else
+        {
+                sprintf(ResultString, "ERROR: Read: addr=0x%08X is outside memory window\n",Address);
+                gtk_text_buffer_insert_at_cursor(Textbuffer, ResultString, -1);
+        }
+    }
+}
+
+
+// called when window is closed
+void on_window_main_destroy()
+{
+	close(fd);
+    gtk_main_quit();
+}
+
+
+// called when window is closed
+void on_close_button_clicked()
+{
+   	close(fd);
+    gtk_main_quit();
+} 
+
+
+//
+// command line modes, run instead of the GUI:
+// axi_rw -b [count]    benchmark register access latency, pread/pwrite against mmap
+// axi_rw -s file       apply a file of register writes in one batch
+//
+#define VBENCHDEFAULTCOUNT 10000                    // accesses timed per register and method
+#define VMAXSCRIPTWRITES 4096                       // most writes in one register file
+#define VSTATUSREG 0x4000                           // read after a batch so posted writes have completed
+
+
+//
+// registers to benchmark: a spread across the AXI-lite map
+// only the debug LED register is written (with the value read back from it)
+//
+struct BenchRegister
+{
+    const char* Name;
+    uint32_t Address;
+    gboolean Write;
+};
+
+static const struct BenchRegister BenchRegisters[] =
+{
+    {"DDC0 config", 0x0000, FALSE},
+    {"DDC rates", 0x100C, FALSE},
+    {"debug LED", 0x3000, TRUE},
+    {"status", 0x4000, FALSE},
+    {"date code", 0x4004, FALSE},
+    {"FIFO overflow", 0x6000, FALSE},
+    {"FIFO monitor 0", 0x9000, FALSE},
+    {"FIFO monitor 1", 0x9004, FALSE},
+    {"XADC temp", 0x18200, FALSE}
+};
+#define VNUMBENCHREGISTERS (sizeof(BenchRegisters) / sizeof(BenchRegisters[0]))
+
+static volatile uint8_t* RegisterMap = NULL;        // mmap of the AXI-lite window, or NULL
+
+
+//
+// open the register device and try to map it
+// returns FALSE if the device isn't present
+//
+static gboolean OpenRegisters(void)
+{
+    void* Map;
+
+    if ((fd = open("/dev/xdma0_user", O_RDWR | O_SYNC)) == -1)
+    {
+        printf("register R/W address space not available\n");
+        return FALSE;
+    }
+    Map = mmap(NULL, ADDRWINDOWSIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (Map != MAP_FAILED)
+        RegisterMap = (volatile uint8_t*)Map;
+    return TRUE;
+}
+
+
+static void CloseRegisters(void)
+{
+    if (RegisterMap != NULL)
+        munmap((void*)RegisterMap, ADDRWINDOWSIZE);
+    RegisterMap = NULL;
+    close(fd);
+}
+
+
+//
+// time now in ns
+//
+static uint64_t TimeNs(void)
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (uint64_t)Now.tv_sec * 1000000000ULL + (uint64_t)Now.tv_nsec;
+}
+
+
+static int CompareTimes(const void* A, const void* B)
+{
+    uint64_t TimeA = *(const uint64_t*)A;
+    uint64_t TimeB = *(const uint64_t*)B;
+
+    return (TimeA > TimeB) - (TimeA < TimeB);
+}
+
+
+//
+// sort a set of access times, and print them with the timer overhead taken off
+//
+static void PrintTimes(const char* Name, const char* Method, uint64_t* Times, uint32_t Count, uint64_t Overhead)
+{
+    uint64_t Total = 0;
+    uint32_t Cntr;
+
+    qsort(Times, Count, sizeof(uint64_t), CompareTimes);
+    for (Cntr = 0; Cntr < Count; Cntr++)
+    {
+        Times[Cntr] = (Times[Cntr] > Overhead) ? Times[Cntr] - Overhead : 0;
+        Total += Times[Cntr];
+    }
+    printf("%-16s %-12s %8llu %8llu %8llu %8llu %8llu\n", Name, Method,
+           (unsigned long long)Times[0], (unsigned long long)(Total / Count),
+           (unsigned long long)Times[Count / 2], (unsigned long long)Times[(uint32_t)((uint64_t)Count * 99 / 100)],
+           (unsigned long long)Times[Count - 1]);
+}
+
+
+//
+// benchmark each register in the table: Count reads (and writes if allowed)
+// with pread/pwrite, then the same with the memory map if available
+//
+static int RunBenchmark(uint32_t Count)
+{
+    uint64_t* Times;
+    uint64_t Start;
+    uint64_t Overhead;
+    uint32_t Reg, Cntr;
+    uint32_t Address, Data = 0;
+    ssize_t Result;
+
+    if (Count == 0)
+        Count = VBENCHDEFAULTCOUNT;
+    if (!OpenRegisters())
+        return 1;
+    Times = malloc(Count * sizeof(uint64_t));
+    if (Times == NULL)
+    {
+        CloseRegisters();
+        return 1;
+    }
+
+    //
+    // the timer overhead: the smallest time between two reads of the clock
+    //
+    for (Cntr = 0; Cntr < Count; Cntr++)
+    {
+        Start = TimeNs();
+        Times[Cntr] = TimeNs() - Start;
+    }
+    qsort(Times, Count, sizeof(uint64_t), CompareTimes);
+    Overhead = Times[0];
+    printf("register access latency, %u accesses per test, ns (timer overhead %llu ns removed)\n",
+           Count, (unsigned long long)Overhead);
+    if (RegisterMap == NULL)
+        printf("register space can't be memory mapped: pread/pwrite only\n");
+    printf("%-16s %-12s %8s %8s %8s %8s %8s\n", "register", "method", "min", "mean", "p50", "p99", "max");
+
+    for (Reg = 0; Reg < VNUMBENCHREGISTERS; Reg++)
+    {
+        Address = BenchRegisters[Reg].Address;
+        for (Cntr = 0; Cntr < Count; Cntr++)
+        {
+            Start = TimeNs();
+            Result = pread(fd, &Data, sizeof(Data), (off_t)Address);
+            Times[Cntr] = TimeNs() - Start;
+            if (Result != sizeof(Data))
+            {
+                printf("ERROR: Read: addr=0x%08X   error=%s\n", Address, strerror(errno));
+                break;
+            }
+        }
+        if (Cntr == Count)
+            PrintTimes(BenchRegisters[Reg].Name, "pread", Times, Count, Overhead);
+        if (RegisterMap != NULL)
+        {
+            for (Cntr = 0; Cntr < Count; Cntr++)
+            {
+                Start = TimeNs();
+                Data = *(volatile uint32_t*)(RegisterMap + Address);
+                Times[Cntr] = TimeNs() - Start;
+            }
+            PrintTimes(BenchRegisters[Reg].Name, "mmap read", Times, Count, Overhead);
+        }
+        if (!BenchRegisters[Reg].Write)
+            continue;
+
+        //
+        // writes put back the value just read. A mapped write is posted, so each one
+        // is followed by a read of the same register to time it reaching the FPGA
+        //
+        for (Cntr = 0; Cntr < Count; Cntr++)
+        {
+            Start = TimeNs();
+            Result = pwrite(fd, &Data, sizeof(Data), (off_t)Address);
+            Times[Cntr] = TimeNs() - Start;
+            if (Result != sizeof(Data))
+            {
+                printf("ERROR: Write: addr=0x%08X   error=%s\n", Address, strerror(errno));
+                break;
+            }
+        }
+        if (Cntr == Count)
+            PrintTimes(BenchRegisters[Reg].Name, "pwrite", Times, Count, Overhead);
+        if (RegisterMap != NULL)
+        {
+            for (Cntr = 0; Cntr < Count; Cntr++)
+            {
+                Start = TimeNs();
+                *(volatile uint32_t*)(RegisterMap + Address) = Data;
+                Times[Cntr] = TimeNs() - Start;
+            }
+            PrintTimes(BenchRegisters[Reg].Name, "mmap posted", Times, Count, Overhead);
+            for (Cntr = 0; Cntr < Count; Cntr++)
+            {
+                Start = TimeNs();
+                *(volatile uint32_t*)(RegisterMap + Address) = Data;
+                Data = *(volatile uint32_t*)(RegisterMap + Address);
+                Times[Cntr] = TimeNs() - Start;
+            }
+            PrintTimes(BenchRegisters[Reg].Name, "mmap w+r", Times, Count, Overhead);
+        }
+    }
+    free(Times);
+    CloseRegisters();
+    return 0;
+}
+
+
+//
+// apply a register file: one write per line, "address data" in hex
+// blank lines and anything after a # are ignored.
+// the whole file is checked before any register is written.
+//
+static int RunScript(const char* Filename)
+{
+    static uint32_t Addresses[VMAXSCRIPTWRITES];
+    static uint32_t Values[VMAXSCRIPTWRITES];
+    uint32_t Count = 0;
+    uint32_t LineNum = 0;
+    uint32_t Cntr;
+    uint32_t Data;
+    char Line[256];
+    char* Comment;
+    char* Ptr;
+    char* End;
+    FILE* File;
+    uint64_t Start, Elapsed;
+    int Result = 0;
+
+    File = fopen(Filename, "r");
+    if (File == NULL)
+    {
+        printf("can't open register file %s: %s\n", Filename, strerror(errno));
+        return 1;
+    }
+    while (fgets(Line, sizeof(Line), File) != NULL)
+    {
+        LineNum++;
+        Comment = strchr(Line, '#');
+        if (Comment != NULL)
+            *Comment = 0;
+        Ptr = Line;
+        while ((*Ptr == ' ') || (*Ptr == '\t'))
+            Ptr++;
+        if ((*Ptr == 0) || (*Ptr == '\n') || (*Ptr == '\r'))
+            continue;
+        if (Count == VMAXSCRIPTWRITES)
+        {
+            printf("%s line %u: more than %d writes\n", Filename, LineNum, VMAXSCRIPTWRITES);
+            Result = 1;
+            break;
+        }
+        Addresses[Count] = strtoul(Ptr, &End, 16);
+        if ((End == Ptr) || (Addresses[Count] > (ADDRWINDOWSIZE - 4)) || (Addresses[Count] & 3))
+        {
+            printf("%s line %u: bad address\n", Filename, LineNum);
+            Result = 1;
+            break;
+        }
+        Ptr = End;
+        Values[Count] = strtoul(Ptr, &End, 16);
+        if (End == Ptr)
+        {
+            printf("%s line %u: missing data\n", Filename, LineNum);
+            Result = 1;
+            break;
+        }
+        Count++;
+    }
+    fclose(File);
+    if ((Result != 0) || !OpenRegisters())
+        return 1;
+
+    //
+    // apply the writes. Mapped writes are posted: the status read at the end
+    // returns once they have all reached the FPGA
+    //
+    Start = TimeNs();
+    if (RegisterMap != NULL)
+    {
+        for (Cntr = 0; Cntr < Count; Cntr++)
+            *(volatile uint32_t*)(RegisterMap + Addresses[Cntr]) = Values[Cntr];
+        Data = *(volatile uint32_t*)(RegisterMap + VSTATUSREG);
+    }
+    else
+        for (Cntr = 0; Cntr < Count; Cntr++)
+            if (pwrite(fd, &Values[Cntr], sizeof(uint32_t), (off_t)Addresses[Cntr]) != sizeof(uint32_t))
+            {
+                printf("ERROR: Write: addr=0x%08X   error=%s\n", Addresses[Cntr], strerror(errno));
+                Result = 1;
+                break;
+            }
+    Elapsed = TimeNs() - Start;
+    (void)Data;
+    printf("%u register writes from %s in %.1f us (%s)\n", Cntr, Filename, (double)Elapsed / 1000.0,
+           (RegisterMap != NULL) ? "mmap" : "pwrite");
+    CloseRegisters();
+    return Result;
+}
+
+
+
+//
+// "main" essentially creates the window and attaches event handlers
+//
+int main(int argc, char *argv[])
+{
+    guint Context;                                  // status bar context
+    int Option;
+
+//
+// command line modes don't start the GUI
+//
+    while ((Option = getopt(argc, argv, "b::s:")) != -1)
+    {
+        switch (Option)
+        {
+        case 'b':
+            return RunBenchmark((optarg != NULL) ? strtoul(optarg, NULL, 0) : VBENCHDEFAULTCOUNT);
+        case 's':
+            return RunScript(optarg);
+        default:
+            printf("usage: axi_rw [-b[count]] [-s registerfile]\n");
+            return 1;
+        }
+    }
+
+    gtk_init(&argc, &argv);
+
+    // Update October 2019: The line below replaces the 2 lines above
+    Builder = gtk_builder_new_from_file("axi_rw.ui");
+
+    Window = GTK_WIDGET(gtk_builder_get_object(Builder, "window_main"));
+    Addrentry = GTK_ENTRY(gtk_builder_get_object(Builder, "txt_addr"));
+    Dataentry = GTK_ENTRY(gtk_builder_get_object(Builder, "txt_data"));
+    Statusbar = GTK_STATUSBAR(gtk_builder_get_object(Builder, "statusbar_main"));
+    Scrollwin = GTK_SCROLLED_WINDOW(gtk_builder_get_object(Builder, "win_scroll"));
+    Textbuffer = GTK_TEXT_BUFFER(gtk_builder_get_object(Builder, "textbuffer_main"));
+    gtk_builder_add_callback_symbol (Builder, "on_write_button_clicked", G_CALLBACK (on_write_button_clicked));
+    gtk_builder_add_callback_symbol (Builder, "on_read_button_clicked", G_CALLBACK (on_read_button_clicked));
+    gtk_builder_add_callback_symbol (Builder, "on_window_main_destroy", G_CALLBACK (on_window_main_destroy));
+    gtk_builder_add_callback_symbol (Builder, "on_close_button_clicked", G_CALLBACK (on_close_button_clicked));
+    gtk_builder_connect_signals(Builder, NULL);
+
+    g_object_unref(Builder);
+    gtk_widget_show(Window);                
+    Context = gtk_statusbar_get_context_id(Statusbar, "context");
+//
+// try to open device
+//
+	if ((fd = open("/dev/xdma0_user", O_RDWR)) == -1)
+    {
+        gtk_statusbar_push(Statusbar, Context, "No PCIe Driver");
+        DriverPresent = FALSE;
+    }
+    else
+    {
+        gtk_statusbar_push(Statusbar, Context, "Connected to /dev/xdma0_user");    
+        DriverPresent = TRUE;
+    }
+
+    gtk_main();
+
+    return 0;
+}
+
@@ -633,6 +633,23 @@ uint32_t WriteCodecRegister(uint16_t CodecData)
 
 
 
+//
+// codec register words sent when no register is given: (register << 9) | data, in order
+//
+static const uint16_t CodecInitTable[] =
+{
+	0x1E00,						// reset
+	0x1201,						// digital activation set to ACTIVE
+	0x0814,						// mic input, no boost
+	0x0C00,						// all elements powered on
+	0x0E02,						// slave; no swap; right when LRC high; 16 bit, I2S
+	0x1000,						// no clock divide; normal mode, oversample 256Fs
+	0x0A00,						// no soft mute; no deemphasis
+	0x0000						// left line in gain=0
+};
+
+
+
 /////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // main program
@@ -646,6 +663,7 @@ int main(int argc, char *argv[])
 	uint32_t RegisterValue;
 	uint32_t ByteCount;
 	uint16_t CodecReg;
+	uint32_t Cntr;
 
 	//
 	// try to open memory device
@@ -677,29 +695,11 @@ int main(int argc, char *argv[])
 	}
 	else
 	{
-		ByteCount = WriteCodecRegister(0x1E00);
-		printf("send 0x1E00; transferred %d bytes\n", ByteCount);
-
-		ByteCount = WriteCodecRegister(0x1201);
-		printf("send 0x1201; transferred %d bytes\n", ByteCount);
-
-		ByteCount = WriteCodecRegister(0x0814);
-		printf("send 0x0814; transferred %d bytes\n", ByteCount);
-
-		ByteCount = WriteCodecRegister(0x0C00);
-		printf("send 0x0C00; transferred %d bytes\n", ByteCount);
-
-		ByteCount = WriteCodecRegister(0x0E02);
-		printf("send 0x0E02; transferred %d bytes\n", ByteCount);
-
-		ByteCount = WriteCodecRegister(0x1000);
-		printf("send 0x1000; transferred %d bytes\n", ByteCount);
-
-		ByteCount = WriteCodecRegister(0x0A00);
-		printf("send 0x0A00; transferred %d bytes\n", ByteCount);
-
-		ByteCount = WriteCodecRegister(0x0000);
-		printf("send 0x0000; transferred %d bytes\n", ByteCount);
+		for (Cntr = 0; Cntr < sizeof(CodecInitTable) / sizeof(CodecInitTable[0]); Cntr++)
+		{
+			ByteCount = WriteCodecRegister(CodecInitTable[Cntr]);
+			printf("send 0x%04X; transferred %d bytes\n", CodecInitTable[Cntr], ByteCount);
+		}
 	}
 
 
@@ -0,0 +1,524 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+//
+// licenced under GNU GPL3
+//
+// dmabench.c:
+//
+// XDMA throughput and latency benchmark. Sweeps transfer size, queue depth
+// and channel (h2c_0/1, c2h_0/1), one channel at a time or all together,
+// and records the latency of every transfer. Each point is reported as one
+// CSV row or JSON line with throughput and latency percentiles, tagged with
+// the kernel release and an optional label so runs on different kernels,
+// driver builds or CM4 clock settings can be compared.
+//
+// queue depth is the number of threads issuing transfers on a channel at once,
+// each on its own file handle; the driver queues them on the channel's engine.
+// the FPGA design must source (c2h) and sink (h2c) data at the AXI address used.
+//
+// ./dmabench [-d device] [-c channels] [-s minsize] [-S maxsize] [-q depths]
+//            [-n transfers] [-a axiaddress] [-m] [-f csv|json] [-l label]
+//
+//////////////////////////////////////////////////////////////
+
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/utsname.h>
+
+//------------------------------------------------------------------------------------------
+// VERSION History
+// V1:   initial release
+
+
+#define VNUMCHANNELS 4                          // h2c_0, h2c_1, c2h_0, c2h_1
+#define VMAXDEPTHS 8                            // most queue depths in one sweep
+#define VMAXDEPTH 64                            // deepest queue (threads per channel)
+#define VALIGNMENT 4096
+#define VDEFAULTMINSIZE 128
+#define VDEFAULTMAXSIZE (1024 * 1024)
+#define VDEFAULTTRANSFERS 1000
+
+
+//
+// one DMA channel
+//
+struct DMAChannel
+{
+    const char* Name;                           // device name suffix, and name in the results
+    bool ToFPGA;                                // true for h2c
+    bool Selected;
+};
+
+static struct DMAChannel Channels[VNUMCHANNELS] =
+{
+    {"h2c_0", true, true},
+    {"h2c_1", true, false},
+    {"c2h_0", false, true},
+    {"c2h_1", false, false}
+};
+
+
+//
+// one thread issuing transfers
+//
+struct BenchWorker
+{
+    pthread_t Thread;
+    struct DMAChannel* Channel;
+    int fd;
+    char* Buffer;
+    uint32_t Size;
+    uint32_t Transfers;                         // transfers to make
+    uint64_t* Latencies;                        // ns, one per transfer
+    uint32_t Errors;
+};
+
+
+//
+// settings
+//
+static const char* DevicePrefix = "/dev/xdma0";
+static uint32_t MinSize = VDEFAULTMINSIZE;
+static uint32_t MaxSize = VDEFAULTMAXSIZE;
+static uint32_t Depths[VMAXDEPTHS] = {1};
+static uint32_t NumDepths = 1;
+static uint32_t TransfersPerPoint = VDEFAULTTRANSFERS;
+static uint32_t AXIAddress = 0;
+static bool Concurrent = false;
+static bool JSONOutput = false;
+static const char* Label = "";
+static struct utsname Uname;
+
+//
+// start gate: releases all the workers of a test together once they have all been
+// created, or tells those that were created to give up if one could not be
+//
+typedef enum
+{
+    eStartWait,
+    eStartGo,
+    eStartAbort
+} EStartState;
+
+static pthread_mutex_t StartMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t StartCond = PTHREAD_COND_INITIALIZER;
+static EStartState StartState = eStartWait;
+
+
+//
+// time now in ns
+//
+static uint64_t GetTimeNs(void)
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (uint64_t)Now.tv_sec * 1000000000ULL + (uint64_t)Now.tv_nsec;
+}
+
+
+//
+// set the start gate and wake the workers waiting at it
+//
+static void SetStartState(EStartState State)
+{
+    pthread_mutex_lock(&StartMutex);
+    StartState = State;
+    pthread_cond_broadcast(&StartCond);
+    pthread_mutex_unlock(&StartMutex);
+}
+
+
+//
+// wait at the start gate; returns true to run, false to give up
+//
+static bool WaitForStart(void)
+{
+    EStartState State;
+
+    pthread_mutex_lock(&StartMutex);
+    while (StartState == eStartWait)
+        pthread_cond_wait(&StartCond, &StartMutex);
+    State = StartState;
+    pthread_mutex_unlock(&StartMutex);
+    return (State == eStartGo);
+}
+
+
+//
+// worker thread: make its transfers, timing each one
+//
+static void* BenchWorkerThread(void* arg)
+{
+    struct BenchWorker* Worker = (struct BenchWorker*)arg;
+    uint64_t Start;
+    ssize_t rc;
+    uint32_t Cntr;
+
+    if (!WaitForStart())
+        return NULL;
+    for (Cntr = 0; Cntr < Worker->Transfers; Cntr++)
+    {
+        Start = GetTimeNs();
+        if (Worker->Channel->ToFPGA)
+            rc = pwrite(Worker->fd, Worker->Buffer, Worker->Size, (off_t)AXIAddress);
+        else
+            rc = pread(Worker->fd, Worker->Buffer, Worker->Size, (off_t)AXIAddress);
+        Worker->Latencies[Cntr] = GetTimeNs() - Start;
+        if (rc != (ssize_t)Worker->Size)
+            Worker->Errors++;
+    }
+    return NULL;
+}
+
+
+static int CompareLatency(const void* A, const void* B)
+{
+    uint64_t LatA = *(const uint64_t*)A;
+    uint64_t LatB = *(const uint64_t*)B;
+
+    return (LatA > LatB) - (LatA < LatB);
+}
+
+
+//
+// latency at a percentile of a sorted set, in us
+//
+static double Percentile(const uint64_t* Sorted, uint32_t Count, double Percent)
+{
+    uint32_t Index;
+
+    Index = (uint32_t)((Percent / 100.0) * (double)(Count - 1) + 0.5);
+    return (double)Sorted[Index] / 1000.0;
+}
+
+
+//
+// report one channel's results for a test point
+//
+static void ReportPoint(struct DMAChannel* Channel, uint32_t Size, uint32_t Depth, uint32_t NumConcurrent,
+                        uint64_t* Latencies, uint32_t Count, uint32_t Errors, uint64_t Elapsed)
+{
+    double Seconds;
+    double Rate;
+    double Mean = 0.0;
+    uint32_t Cntr;
+
+    qsort(Latencies, Count, sizeof(uint64_t), CompareLatency);
+    for (Cntr = 0; Cntr < Count; Cntr++)
+        Mean += (double)Latencies[Cntr];
+    Mean = Mean / (double)Count / 1000.0;
+    Seconds = (double)Elapsed / 1.0E9;
+    Rate = (double)Size * (double)Count / Seconds / 1.0E6;
+
+    if (JSONOutput)
+        printf("{\"label\":\"%s\",\"kernel\":\"%s\",\"channel\":\"%s\",\"size\":%u,\"depth\":%u,\"concurrent\":%u,"
+               "\"transfers\":%u,\"errors\":%u,\"seconds\":%.6f,\"MBps\":%.2f,\"min_us\":%.1f,\"mean_us\":%.1f,"
+               "\"p50_us\":%.1f,\"p99_us\":%.1f,\"p999_us\":%.1f,\"max_us\":%.1f}\n",
+               Label, Uname.release, Channel->Name, Size, Depth, NumConcurrent, Count, Errors, Seconds, Rate,
+               (double)Latencies[0] / 1000.0, Mean, Percentile(Latencies, Count, 50.0), Percentile(Latencies, Count, 99.0),
+               Percentile(Latencies, Count, 99.9), (double)Latencies[Count - 1] / 1000.0);
+    else
+        printf("%s,%s,%s,%u,%u,%u,%u,%u,%.6f,%.2f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+               Label, Uname.release, Channel->Name, Size, Depth, NumConcurrent, Count, Errors, Seconds, Rate,
+               (double)Latencies[0] / 1000.0, Mean, Percentile(Latencies, Count, 50.0), Percentile(Latencies, Count, 99.0),
+               Percentile(Latencies, Count, 99.9), (double)Latencies[Count - 1] / 1000.0);
+    fflush(stdout);
+}
+
+
+//
+// run one test point on a set of channels at once
+// each channel gets Depth workers sharing TransfersPerPoint transfers
+// returns false if a device could not be opened or a worker could not be started
+//
+static bool RunPoint(struct DMAChannel** TestChannels, uint32_t NumTest, uint32_t Size, uint32_t Depth,
+                     char** Buffers, uint64_t* Latencies)
+{
+    struct BenchWorker Workers[VNUMCHANNELS * VMAXDEPTH];
+    char DeviceName[64];
+    uint32_t NumWorkers = 0;
+    uint32_t Started = 0;                       // worker threads created
+    uint32_t Chan, Cntr, Errors, Count;
+    int Error;
+    uint64_t Start, Elapsed;
+    uint64_t* Next = Latencies;
+    bool Result = true;
+
+    for (Chan = 0; Chan < NumTest; Chan++)
+        for (Cntr = 0; Cntr < Depth; Cntr++)
+        {
+            struct BenchWorker* Worker = &Workers[NumWorkers];
+
+            snprintf(DeviceName, sizeof(DeviceName), "%s_%s", DevicePrefix, TestChannels[Chan]->Name);
+            Worker->fd = open(DeviceName, TestChannels[Chan]->ToFPGA ? O_WRONLY : O_RDONLY);
+            if (Worker->fd < 0)
+            {
+                fprintf(stderr, "%s: %s\n", DeviceName, strerror(errno));
+                Result = false;
+                break;
+            }
+            Worker->Channel = TestChannels[Chan];
+            Worker->Buffer = Buffers[NumWorkers];
+            Worker->Size = Size;
+            // share the transfers out between the channel's workers
+            Worker->Transfers = TransfersPerPoint / Depth + ((Cntr < (TransfersPerPoint % Depth)) ? 1 : 0);
+            Worker->Latencies = Next;
+            Worker->Errors = 0;
+            Next += Worker->Transfers;
+            NumWorkers++;
+        }
+
+    if (Result)
+    {
+        StartState = eStartWait;                // (no workers running yet)
+        for (Started = 0; Started < NumWorkers; Started++)
+        {
+            Error = pthread_create(&Workers[Started].Thread, NULL, BenchWorkerThread, &Workers[Started]);
+            if (Error != 0)
+            {
+                fprintf(stderr, "pthread_create DMA worker: %s\n", strerror(Error));
+                Result = false;
+                break;
+            }
+        }
+        SetStartState(Result ? eStartGo : eStartAbort);
+        Start = GetTimeNs();
+        for (Cntr = 0; Cntr < Started; Cntr++)
+            pthread_join(Workers[Cntr].Thread, NULL);
+        Elapsed = GetTimeNs() - Start;
+    }
+
+    if (Result)
+    {
+
+        // one result per channel: its workers' latencies are contiguous
+        Cntr = 0;
+        for (Chan = 0; Chan < NumTest; Chan++)
+        {
+            uint64_t* ChannelLatencies = Workers[Cntr].Latencies;
+
+            Errors = 0;
+            Count = 0;
+            for (; (Cntr < NumWorkers) && (Workers[Cntr].Channel == TestChannels[Chan]); Cntr++)
+            {
+                Errors += Workers[Cntr].Errors;
+                Count += Workers[Cntr].Transfers;
+            }
+            if (Count != 0)
+                ReportPoint(TestChannels[Chan], Size, Depth, NumTest, ChannelLatencies, Count, Errors, Elapsed);
+        }
+    }
+    for (Cntr = 0; Cntr < NumWorkers; Cntr++)
+        close(Workers[Cntr].fd);
+    return Result;
+}
+
+
+//
+// parse a comma separated list of channel names
+//
+static bool ParseChannels(char* List)
+{
+    char* Name;
+    uint32_t Cntr;
+    bool Found;
+
+    for (Cntr = 0; Cntr < VNUMCHANNELS; Cntr++)
+        Channels[Cntr].Selected = false;
+    for (Name = strtok(List, ","); Name != NULL; Name = strtok(NULL, ","))
+    {
+        Found = false;
+        for (Cntr = 0; Cntr < VNUMCHANNELS; Cntr++)
+            if (strcmp(Name, Channels[Cntr].Name) == 0)
+            {
+                Channels[Cntr].Selected = true;
+                Found = true;
+            }
+        if (!Found)
+        {
+            fprintf(stderr, "unknown channel %s\n", Name);
+            return false;
+        }
+    }
+    return true;
+}
+
+
+//
+// parse a comma separated list of queue depths
+//
+static bool ParseDepths(char* List)
+{
+    char* Entry;
+
+    NumDepths = 0;
+    for (Entry = strtok(List, ","); Entry != NULL; Entry = strtok(NULL, ","))
+    {
+        if (NumDepths == VMAXDEPTHS)
+        {
+            fprintf(stderr, "at most %d queue depths\n", VMAXDEPTHS);
+            return false;
+        }
+        Depths[NumDepths] = strtoul(Entry, NULL, 0);
+        if ((Depths[NumDepths] == 0) || (Depths[NumDepths] > VMAXDEPTH))
+        {
+            fprintf(stderr, "queue depth must be 1 to %d\n", VMAXDEPTH);
+            return false;
+        }
+        NumDepths++;
+    }
+    return NumDepths != 0;
+}
+
+
+static void PrintUsage(void)
+{
+    fprintf(stderr, "usage: dmabench [-d device] [-c channels] [-s minsize] [-S maxsize] [-q depths]\n"
+                    "                [-n transfers] [-a axiaddress] [-m] [-f csv|json] [-l label]\n"
+                    "  -d: device prefix (default /dev/xdma0)\n"
+                    "  -c: channels, from h2c_0,h2c_1,c2h_0,c2h_1 (default h2c_0,c2h_0)\n"
+                    "  -s, -S: smallest and largest transfer size in bytes, doubling (default 128 to 1M)\n"
+                    "  -q: queue depths to test, eg 1,2,4 (default 1)\n"
+                    "  -n: transfers per test point (default %d)\n"
+                    "  -a: AXI address for the transfers (default 0)\n"
+                    "  -m: run the channels concurrently rather than in turn\n"
+                    "  -f: output format (default csv)\n"
+                    "  -l: label added to every result, eg driver build or clock setting\n",
+                    VDEFAULTTRANSFERS);
+}
+
+
+//
+// main program
+//
+int main(int argc, char *argv[])
+{
+    struct DMAChannel* TestChannels[VNUMCHANNELS];
+    uint32_t NumSelected = 0;
+    char* Buffers[VNUMCHANNELS * VMAXDEPTH];
+    uint32_t MaxDepth = 0;
+    uint64_t* Latencies;
+    uint32_t Size, Depth, Chan, Cntr;
+    int Option;
+    int Result = 0;
+
+    while ((Option = getopt(argc, argv, "d:c:s:S:q:n:a:mf:l:")) != -1)
+    {
+        switch (Option)
+        {
+        case 'd':
+            DevicePrefix = optarg;
+            break;
+        case 'c':
+            if (!ParseChannels(optarg))
+                return 1;
+            break;
+        case 's':
+            MinSize = strtoul(optarg, NULL, 0);
+            break;
+        case 'S':
+            MaxSize = strtoul(optarg, NULL, 0);
+            break;
+        case 'q':
+            if (!ParseDepths(optarg))
+                return 1;
+            break;
+        case 'n':
+            TransfersPerPoint = strtoul(optarg, NULL, 0);
+            break;
+        case 'a':
+            AXIAddress = strtoul(optarg, NULL, 0);
+            break;
+        case 'm':
+            Concurrent = true;
+            break;
+        case 'f':
+            JSONOutput = (strcmp(optarg, "json") == 0);
+            break;
+        case 'l':
+            Label = optarg;
+            break;
+        default:
+            PrintUsage();
+            return 1;
+        }
+    }
+    if ((MinSize == 0) || (MaxSize < MinSize) || (TransfersPerPoint == 0))
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    uname(&Uname);
+    for (Chan = 0; Chan < VNUMCHANNELS; Chan++)
+        if (Channels[Chan].Selected)
+            TestChannels[NumSelected++] = &Channels[Chan];
+    for (Cntr = 0; Cntr < NumDepths; Cntr++)
+        if (Depths[Cntr] > MaxDepth)
+            MaxDepth = Depths[Cntr];
+
+    //
+    // one buffer per worker, and a latency slot per transfer of every channel
+    //
+    memset(Buffers, 0, sizeof(Buffers));
+    for (Cntr = 0; Cntr < NumSelected * MaxDepth; Cntr++)
+        if (posix_memalign((void**)&Buffers[Cntr], VALIGNMENT, MaxSize) != 0)
+        {
+            fprintf(stderr, "buffer allocation failed\n");
+            Result = 1;
+            goto out;
+        }
+        else
+            memset(Buffers[Cntr], 0x5A, MaxSize);
+    Latencies = malloc((size_t)TransfersPerPoint * NumSelected * sizeof(uint64_t));
+    if (Latencies == NULL)
+    {
+        fprintf(stderr, "latency buffer allocation failed\n");
+        Result = 1;
+        goto out;
+    }
+
+    if (!JSONOutput)
+        printf("label,kernel,channel,size,depth,concurrent,transfers,errors,seconds,MBps,"
+               "min_us,mean_us,p50_us,p99_us,p999_us,max_us\n");
+    for (Size = MinSize; Size <= MaxSize; Size *= 2)
+    {
+        for (Cntr = 0; Cntr < NumDepths; Cntr++)
+        {
+            Depth = Depths[Cntr];
+            if (Concurrent)
+            {
+                if (!RunPoint(TestChannels, NumSelected, Size, Depth, Buffers, Latencies))
+                    Result = 1;
+            }
+            else
+                for (Chan = 0; Chan < NumSelected; Chan++)
+                    if (!RunPoint(&TestChannels[Chan], 1, Size, Depth, Buffers, Latencies))
+                        Result = 1;
+            if (Result != 0)
+                goto done;
+        }
+        if (Size > (UINT32_MAX / 2))
+            break;
+    }
+
+done:
+    free(Latencies);
+out:
+    for (Cntr = 0; Cntr < VNUMCHANNELS * VMAXDEPTH; Cntr++)
+        free(Buffers[Cntr]);
+    return Result;
+}
@@ -0,0 +1,748 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+//
+// licenced under GNU GPL3
+//
+// fftanalyse.c:
+//
+// offline spectral analysis of DDC and DUC captures, in place of the Octave
+// scripts in FPGA/octave (ddcFFTScript.m, ducFFTScript_*.m). Reads:
+//   text, 2 columns:   I, Q per line, as ddcdata.txt (complex; two sided spectrum)
+//   text, 1 column:    one real sample per line, as ducdata.txt (one sided spectrum)
+//   SigMF:             ci32_be recordings from the p2app I/Q recorder (<name>.sigmf-data,
+//                      sample rate from <name>.sigmf-meta)
+// the file is memory mapped. A long capture is cut into FFT segments, with 50%
+// overlap, shared between threads on every core; each thread windows and
+// transforms its segments and sums their power, and the sums are averaged.
+// windows are those of the scripts: Blackman-Harris (the default), Hanning,
+// Nuttall, Blackman, or none.
+//
+// reports the largest tone (frequency and dBFS), SFDR (largest other bin, dBc),
+// SINAD, and the noise floor (median bin, in dBFS per bin and dBFS/Hz). With
+// -m the exit status is 1 if SFDR is below a limit, for scripted qualification.
+//
+// ./fftanalyse [-w window] [-n fftsize] [-r rate] [-b bits] [-e bins] [-t threads]
+//              [-s spectrum.csv] [-m minsfdr] [-d] [-j] <capture file>
+//
+//////////////////////////////////////////////////////////////
+
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//------------------------------------------------------------------------------------------
+// VERSION History
+// V1:   initial release
+
+
+#define VDEFAULTFFTSIZE 65536                   // FFT size for captures longer than this
+#define VMINFFTSIZE 64
+#define VMAXFFTSIZE (1 << 24)
+#define VMAXTHREADS 64
+#define VDDCTEXTRATE 1536000.0                  // as ddcFFTScript.m
+#define VDUCTEXTRATE 122880000.0                // as ducFFTScript.m
+#define VDDCTEXTBITS 24                         // DDC testbench output
+#define VDUCTEXTBITS 32                         // DUC testbench output
+#define VSIGMFBITS 32                           // ci32: 24 bit sample in the top 3 bytes
+
+
+//
+// capture formats
+//
+enum ECaptureFormat
+{
+    eTextComplex,                               // I, Q per line
+    eTextReal,                                  // one sample per line
+    eSigMF                                      // ci32_be
+};
+
+
+//
+// windows, as in the Octave scripts
+// HalfWidth: main lobe half width in bins, excluded around the tone when finding spurs
+//
+struct WindowType
+{
+    const char* Name;
+    double A[4];                                // cosine series coefficients (none: 1, 0...)
+    uint32_t HalfWidth;
+    bool Hanning;                               // Octave's hanning(): N+1 denominator, no zero end points
+};
+
+static const struct WindowType Windows[] =
+{
+    {"blackmanharris", {0.35875, 0.48829, 0.14128, 0.01168}, 4, false},
+    {"nuttall", {0.3635819, 0.4891775, 0.1365995, 0.0106411}, 4, false},
+    {"blackman", {0.42, 0.5, 0.08, 0.0}, 3, false},
+    {"hanning", {0.5, 0.5, 0.0, 0.0}, 2, true},
+    {"none", {1.0, 0.0, 0.0, 0.0}, 1, false}
+};
+#define VNUMWINDOWS (sizeof(Windows) / sizeof(Windows[0]))
+
+
+//
+// settings
+//
+static const struct WindowType* Window = &Windows[0];
+static uint32_t FFTSize = 0;                    // 0: VDEFAULTFFTSIZE, or less for a short capture
+static double SampleRate = 0.0;                 // 0: the format's default
+static uint32_t Bits = 0;                       // 0: the format's default
+static uint32_t ExcludeBins = 0;                // 0: the window's main lobe half width
+static uint32_t NumThreads = 0;                 // 0: one per core
+static const char* SpectrumFilename = NULL;
+static double MinSFDR = 0.0;                    // 0: no limit
+static bool ExcludeDC = false;
+static bool JSONOutput = false;
+
+
+//
+// the capture: either parsed text samples, or the mapped SigMF data
+//
+static enum ECaptureFormat Format;
+static double* TextSamples = NULL;              // complex: I, Q interleaved
+static const uint8_t* SigMFData = NULL;
+static uint64_t NumSamples = 0;                 // samples (complex samples for complex data)
+static bool IsComplex;
+
+
+//
+// FFT tables, shared by the threads
+//
+static double* WindowTable;
+static double* Twiddles;                        // N/2 complex: cos, -sin
+static uint32_t* BitReverse;
+static uint32_t Log2Size;
+
+
+//
+// one analysis thread: its segments are Start, Start + Step...
+//
+struct AnalysisThread
+{
+    pthread_t Thread;
+    uint32_t First;                             // first segment
+    uint32_t Step;                              // segment stride (the thread count)
+    uint32_t NumSegments;                       // total segments
+    double* Data;                               // N complex
+    double* PowerSum;                           // N bins
+};
+
+
+static void PrintUsage(void)
+{
+    uint32_t Cntr;
+
+    printf("usage: fftanalyse [-w window] [-n fftsize] [-r rate] [-b bits] [-e bins] [-t threads]\n");
+    printf("                  [-s spectrum.csv] [-m minsfdr] [-d] [-j] <capture file>\n");
+    printf("   -w window    ");
+    for (Cntr = 0; Cntr < VNUMWINDOWS; Cntr++)
+        printf("%s%s", Windows[Cntr].Name, (Cntr == 0) ? " (default)" : "");
+    printf("\n");
+    printf("   -n fftsize   FFT size, a power of 2 (default %d, or the capture if shorter)\n", VDEFAULTFFTSIZE);
+    printf("   -r rate      sample rate, Hz (default %.0f DDC text, %.0f DUC text, SigMF metadata)\n", VDDCTEXTRATE, VDUCTEXTRATE);
+    printf("   -b bits      full scale sample bits (default %d DDC text, %d DUC text, %d SigMF)\n", VDDCTEXTBITS, VDUCTEXTBITS, VSIGMFBITS);
+    printf("   -e bins      bins either side of the tone excluded from the spur search (default the window's main lobe)\n");
+    printf("   -t threads   analysis threads (default one per core)\n");
+    printf("   -s file      write the averaged spectrum as CSV: frequency (Hz), dBFS\n");
+    printf("   -m dBc       exit status 1 if SFDR is below this\n");
+    printf("   -d           exclude DC from the spur search\n");
+    printf("   -j           report as one JSON line\n");
+}
+
+
+//
+// parse one number from Ptr, not reading beyond End: [-+]digits[.digits][e[-+]digits]
+// (the mapped file isn't 0 terminated, so strtod() can't be used)
+// returns false if there is no number at Ptr
+//
+static bool ParseNumber(const char** Ptr, const char* End, double* Value)
+{
+    const char* Cursor = *Ptr;
+    double Result = 0.0;
+    double Scale;
+    bool Negative = false;
+    bool Digits = false;
+    int Exponent = 0;
+    int ExponentSign = 1;
+
+    if ((Cursor < End) && ((*Cursor == '-') || (*Cursor == '+')))
+        Negative = (*Cursor++ == '-');
+    while ((Cursor < End) && (*Cursor >= '0') && (*Cursor <= '9'))
+    {
+        Result = Result * 10.0 + (*Cursor++ - '0');
+        Digits = true;
+    }
+    if ((Cursor < End) && (*Cursor == '.'))
+    {
+        Cursor++;
+        for (Scale = 0.1; (Cursor < End) && (*Cursor >= '0') && (*Cursor <= '9'); Scale *= 0.1)
+        {
+            Result += (*Cursor++ - '0') * Scale;
+            Digits = true;
+        }
+    }
+    if (!Digits)
+        return false;
+    if ((Cursor < End) && ((*Cursor == 'e') || (*Cursor == 'E')))
+    {
+        Cursor++;
+        if ((Cursor < End) && ((*Cursor == '-') || (*Cursor == '+')))
+            ExponentSign = (*Cursor++ == '-') ? -1 : 1;
+        while ((Cursor < End) && (*Cursor >= '0') && (*Cursor <= '9'))
+            Exponent = Exponent * 10 + (*Cursor++ - '0');
+        Result *= pow(10.0, ExponentSign * Exponent);
+    }
+    *Value = Negative ? -Result : Result;
+    *Ptr = Cursor;
+    return true;
+}
+
+
+//
+// parse the text capture into TextSamples
+// returns false if the file has no samples
+//
+static bool ParseText(const char* Text, size_t Length)
+{
+    const char* Ptr = Text;
+    const char* End = Text + Length;
+    const char* LineEnd;
+    uint64_t Allocated = 0;
+    uint32_t Columns = 0;
+    uint32_t PerLine;
+
+    //
+    // count the columns of the first line
+    //
+    LineEnd = memchr(Ptr, '\n', Length);
+    if (LineEnd == NULL)
+        LineEnd = End;
+    while (Ptr < LineEnd)
+    {
+        while ((Ptr < LineEnd) && ((*Ptr == ' ') || (*Ptr == '\t') || (*Ptr == ',') || (*Ptr == '\r')))
+            Ptr++;
+        if (Ptr == LineEnd)
+            break;
+        Columns++;
+        while ((Ptr < LineEnd) && (*Ptr != ' ') && (*Ptr != '\t') && (*Ptr != ',') && (*Ptr != '\r'))
+            Ptr++;
+    }
+    if ((Columns < 1) || (Columns > 2))
+    {
+        fprintf(stderr, "text capture should have 1 (real) or 2 (I, Q) columns, not %u\n", Columns);
+        return false;
+    }
+    IsComplex = (Columns == 2);
+    Format = IsComplex ? eTextComplex : eTextReal;
+    PerLine = Columns;
+
+    //
+    // samples
+    //
+    Ptr = Text;
+    while (Ptr < End)
+    {
+        double Value;
+
+        while ((Ptr < End) && ((*Ptr == ' ') || (*Ptr == '\t') || (*Ptr == ',') || (*Ptr == '\r') || (*Ptr == '\n')))
+            Ptr++;
+        if (Ptr >= End)
+            break;
+        if (!ParseNumber(&Ptr, End, &Value))
+        {
+            fprintf(stderr, "bad sample at offset %zu\n", (size_t)(Ptr - Text));
+            return false;
+        }
+        if (NumSamples * PerLine + PerLine > Allocated)
+        {
+            Allocated = (Allocated == 0) ? 1048576 : Allocated * 2;
+            TextSamples = realloc(TextSamples, Allocated * sizeof(double));
+            if (TextSamples == NULL)
+            {
+                fprintf(stderr, "out of memory\n");
+                return false;
+            }
+        }
+        TextSamples[NumSamples * PerLine + (Columns++ % PerLine)] = Value;
+        if ((Columns % PerLine) == 0)
+            NumSamples++;
+    }
+    return NumSamples > 0;
+}
+
+
+//
+// read the sample rate from the .sigmf-meta file beside a .sigmf-data file
+// returns false if the metadata can't be read or the data type isn't ci32_be
+//
+static bool ReadSigMFMeta(const char* DataFilename)
+{
+    char MetaFilename[4096];
+    char Meta[65536];
+    const char* Ptr;
+    size_t Length;
+    FILE* File;
+
+    Length = strlen(DataFilename);
+    if ((Length < 5) || (Length > sizeof(MetaFilename) - 1))
+        return false;
+    snprintf(MetaFilename, sizeof(MetaFilename), "%.*s-meta", (int)(Length - 5), DataFilename);
+    File = fopen(MetaFilename, "r");
+    if (File == NULL)
+    {
+        perror(MetaFilename);
+        return false;
+    }
+    Length = fread(Meta, 1, sizeof(Meta) - 1, File);
+    fclose(File);
+    Meta[Length] = 0;
+
+    Ptr = strstr(Meta, "\"core:datatype\"");
+    if ((Ptr == NULL) || (strstr(Ptr, "ci32_be") == NULL))
+    {
+        fprintf(stderr, "%s: only ci32_be recordings are supported\n", MetaFilename);
+        return false;
+    }
+    Ptr = strstr(Meta, "\"core:sample_rate\"");
+    if ((Ptr != NULL) && (SampleRate == 0.0))
+    {
+        Ptr = strchr(Ptr + strlen("\"core:sample_rate\""), ':');
+        if (Ptr != NULL)
+            SampleRate = strtod(Ptr + 1, NULL);
+    }
+    return true;
+}
+
+
+//
+// get sample n of the capture: real, or I and Q
+// SigMF samples are converted as they're read, so the mapped file isn't copied
+//
+static inline void GetSample(uint64_t Sample, double* I, double* Q)
+{
+    const uint8_t* Ptr;
+
+    switch (Format)
+    {
+    case eTextComplex:
+        *I = TextSamples[2 * Sample];
+        *Q = TextSamples[2 * Sample + 1];
+        break;
+    case eTextReal:
+        *I = TextSamples[Sample];
+        *Q = 0.0;
+        break;
+    default:
+        Ptr = SigMFData + 8 * Sample;
+        *I = (double)(int32_t)(((uint32_t)Ptr[0] << 24) | ((uint32_t)Ptr[1] << 16) | ((uint32_t)Ptr[2] << 8) | Ptr[3]);
+        *Q = (double)(int32_t)(((uint32_t)Ptr[4] << 24) | ((uint32_t)Ptr[5] << 16) | ((uint32_t)Ptr[6] << 8) | Ptr[7]);
+        break;
+    }
+}
+
+
+//
+// build the window, twiddle and bit reverse tables for FFTSize
+// the window is symmetric, as Octave's; hanning() as Octave's has no zero end points
+//
+static bool BuildTables(void)
+{
+    uint32_t N = FFTSize;
+    uint32_t Cntr, Bit, Reversed;
+    double Phase, Denominator;
+
+    WindowTable = malloc(N * sizeof(double));
+    Twiddles = malloc(N * sizeof(double));
+    BitReverse = malloc(N * sizeof(uint32_t));
+    if ((WindowTable == NULL) || (Twiddles == NULL) || (BitReverse == NULL))
+        return false;
+
+    Denominator = Window->Hanning ? (double)(N + 1) : (double)(N - 1);
+    for (Cntr = 0; Cntr < N; Cntr++)
+    {
+        Phase = 2.0 * M_PI * (double)(Window->Hanning ? Cntr + 1 : Cntr) / Denominator;
+        WindowTable[Cntr] = Window->A[0] - Window->A[1] * cos(Phase) + Window->A[2] * cos(2.0 * Phase)
+                          - Window->A[3] * cos(3.0 * Phase);
+    }
+    for (Cntr = 0; Cntr < N / 2; Cntr++)
+    {
+        Twiddles[2 * Cntr] = cos(2.0 * M_PI * Cntr / N);
+        Twiddles[2 * Cntr + 1] = -sin(2.0 * M_PI * Cntr / N);
+    }
+    for (Log2Size = 0; (1U << Log2Size) < N; Log2Size++)
+        ;
+    for (Cntr = 0; Cntr < N; Cntr++)
+    {
+        Reversed = 0;
+        for (Bit = 0; Bit < Log2Size; Bit++)
+            if (Cntr & (1U << Bit))
+                Reversed |= 1U << (Log2Size - 1 - Bit);
+        BitReverse[Cntr] = Reversed;
+    }
+    return true;
+}
+
+
+//
+// in place radix 2 FFT of N complex values, in bit reversed order on entry
+//
+static void RunFFT(double* Data)
+{
+    uint32_t N = FFTSize;
+    uint32_t Size, Half, Stride, Start, Cntr;
+    double TR, TI, WR, WI;
+    double* A;
+    double* B;
+
+    for (Size = 2; Size <= N; Size *= 2)
+    {
+        Half = Size / 2;
+        Stride = N / Size;
+        for (Start = 0; Start < N; Start += Size)
+        {
+            for (Cntr = 0; Cntr < Half; Cntr++)
+            {
+                WR = Twiddles[2 * Cntr * Stride];
+                WI = Twiddles[2 * Cntr * Stride + 1];
+                A = Data + 2 * (Start + Cntr);
+                B = Data + 2 * (Start + Cntr + Half);
+                TR = B[0] * WR - B[1] * WI;
+                TI = B[0] * WI + B[1] * WR;
+                B[0] = A[0] - TR;
+                B[1] = A[1] - TI;
+                A[0] += TR;
+                A[1] += TI;
+            }
+        }
+    }
+}
+
+
+//
+// analysis thread: window, transform and sum the power of its segments (50% overlap)
+//
+static void* AnalysisThreadMain(void* arg)
+{
+    struct AnalysisThread* Thread = (struct AnalysisThread*)arg;
+    uint32_t N = FFTSize;
+    uint32_t Segment, Cntr;
+    uint64_t Offset;
+    double I, Q;
+
+    for (Segment = Thread->First; Segment < Thread->NumSegments; Segment += Thread->Step)
+    {
+        Offset = (uint64_t)Segment * (N / 2);
+        for (Cntr = 0; Cntr < N; Cntr++)
+        {
+            GetSample(Offset + Cntr, &I, &Q);
+            Thread->Data[2 * BitReverse[Cntr]] = I * WindowTable[Cntr];
+            Thread->Data[2 * BitReverse[Cntr] + 1] = Q * WindowTable[Cntr];
+        }
+        RunFFT(Thread->Data);
+        for (Cntr = 0; Cntr < N; Cntr++)
+            Thread->PowerSum[Cntr] += Thread->Data[2 * Cntr] * Thread->Data[2 * Cntr] + Thread->Data[2 * Cntr + 1] * Thread->Data[2 * Cntr + 1];
+    }
+    return NULL;
+}
+
+
+static int CompareDoubles(const void* A, const void* B)
+{
+    double X = *(const double*)A;
+    double Y = *(const double*)B;
+
+    return (X > Y) - (X < Y);
+}
+
+
+int main(int argc, char* argv[])
+{
+    struct AnalysisThread Threads[VMAXTHREADS];
+    const char* Filename;
+    struct stat Stat;
+    uint8_t* Mapping;
+    size_t MapLength;
+    double* Power;                              // averaged power of the displayed bins, low to high frequency
+    double* Sorted;
+    uint32_t N, NumSegments, NumBins, FirstBin;
+    uint32_t Cntr, Bin, PeakBin, SpurBin, Exclude;
+    double Reference, WindowSum, WindowSquares, ENBW, BinWidth;
+    double PeakPower, SpurPower, SignalPower, OtherPower, NoisePower;
+    double PeakFreq, PeakdBFS, SFDR, SINAD, NoisedBFS, NoisedBFSHz;
+    uint32_t NoiseCount;
+    int fd, Option;
+    int Result = 0;
+
+    while ((Option = getopt(argc, argv, "w:n:r:b:e:t:s:m:djh")) != -1)
+    {
+        switch (Option)
+        {
+        case 'w':
+            for (Cntr = 0; Cntr < VNUMWINDOWS; Cntr++)
+                if (strcmp(optarg, Windows[Cntr].Name) == 0)
+                    break;
+            if (Cntr == VNUMWINDOWS)
+            {
+                PrintUsage();
+                return 2;
+            }
+            Window = &Windows[Cntr];
+            break;
+        case 'n':
+            FFTSize = strtoul(optarg, NULL, 0);
+            break;
+        case 'r':
+            SampleRate = strtod(optarg, NULL);
+            break;
+        case 'b':
+            Bits = strtoul(optarg, NULL, 0);
+            break;
+        case 'e':
+            ExcludeBins = strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            NumThreads = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            SpectrumFilename = optarg;
+            break;
+        case 'm':
+            MinSFDR = strtod(optarg, NULL);
+            break;
+        case 'd':
+            ExcludeDC = true;
+            break;
+        case 'j':
+            JSONOutput = true;
+            break;
+        default:
+            PrintUsage();
+            return 2;
+        }
+    }
+    if ((optind != argc - 1) || ((FFTSize != 0) && ((FFTSize & (FFTSize - 1)) != 0 || FFTSize < VMINFFTSIZE || FFTSize > VMAXFFTSIZE))
+        || (Bits > 32))
+    {
+        PrintUsage();
+        return 2;
+    }
+    Filename = argv[optind];
+
+    //
+    // map the capture
+    //
+    fd = open(Filename, O_RDONLY);
+    if ((fd < 0) || (fstat(fd, &Stat) < 0) || (Stat.st_size == 0))
+    {
+        perror(Filename);
+        return 2;
+    }
+    MapLength = (size_t)Stat.st_size;
+    Mapping = mmap(NULL, MapLength, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (Mapping == MAP_FAILED)
+    {
+        perror("mmap");
+        return 2;
+    }
+    madvise(Mapping, MapLength, MADV_SEQUENTIAL);
+    if ((strlen(Filename) > 11) && (strcmp(Filename + strlen(Filename) - 11, ".sigmf-data") == 0))
+    {
+        if (!ReadSigMFMeta(Filename))
+            return 2;
+        Format = eSigMF;
+        IsComplex = true;
+        SigMFData = Mapping;
+        NumSamples = (uint64_t)Stat.st_size / 8;
+        if (Bits == 0)
+            Bits = VSIGMFBITS;
+    }
+    else if (!ParseText((const char*)Mapping, (size_t)Stat.st_size))
+        return 2;
+    if (SampleRate == 0.0)
+        SampleRate = IsComplex ? VDDCTEXTRATE : VDUCTEXTRATE;
+    if (Bits == 0)
+        Bits = IsComplex ? VDDCTEXTBITS : VDUCTEXTBITS;
+
+    //
+    // FFT size and segments
+    //
+    if (FFTSize == 0)
+        for (FFTSize = VDEFAULTFFTSIZE; (FFTSize > VMINFFTSIZE) && (FFTSize > NumSamples); FFTSize /= 2)
+            ;
+    N = FFTSize;
+    if (NumSamples < N)
+    {
+        fprintf(stderr, "capture of %llu samples is shorter than the %u point FFT\n", (unsigned long long)NumSamples, N);
+        return 2;
+    }
+    NumSegments = (uint32_t)((NumSamples - N) / (N / 2) + 1);
+    if (NumThreads == 0)
+        NumThreads = (uint32_t)sysconf(_SC_NPROCESSORS_ONLN);
+    if (NumThreads > VMAXTHREADS)
+        NumThreads = VMAXTHREADS;
+    if (NumThreads > NumSegments)
+        NumThreads = NumSegments;
+    if (!BuildTables())
+    {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+
+    //
+    // analyse in parallel, then sum the threads' power
+    //
+    for (Cntr = 0; Cntr < NumThreads; Cntr++)
+    {
+        Threads[Cntr].First = Cntr;
+        Threads[Cntr].Step = NumThreads;
+        Threads[Cntr].NumSegments = NumSegments;
+        Threads[Cntr].Data = malloc(2 * N * sizeof(double));
+        Threads[Cntr].PowerSum = calloc(N, sizeof(double));
+        if ((Threads[Cntr].Data == NULL) || (Threads[Cntr].PowerSum == NULL))
+        {
+            fprintf(stderr, "out of memory\n");
+            return 2;
+        }
+        if (pthread_create(&Threads[Cntr].Thread, NULL, AnalysisThreadMain, &Threads[Cntr]) != 0)
+        {
+            perror("pthread_create");
+            return 2;
+        }
+    }
+    for (Cntr = 0; Cntr < NumThreads; Cntr++)
+        pthread_join(Threads[Cntr].Thread, NULL);
+    for (Cntr = 1; Cntr < NumThreads; Cntr++)
+        for (Bin = 0; Bin < N; Bin++)
+            Threads[0].PowerSum[Bin] += Threads[Cntr].PowerSum[Bin];
+
+    //
+    // displayed bins: complex zero centred (as fftshift), real DC to fs/2
+    // reference: power of a full scale tone of the window's gain. A real tone's power is split
+    // between its positive and negative frequency bins, so its reference is 1/4
+    //
+    NumBins = IsComplex ? N : N / 2 + 1;
+    FirstBin = IsComplex ? N / 2 : 0;
+    Power = malloc(NumBins * sizeof(double));
+    Sorted = malloc(NumBins * sizeof(double));
+    if ((Power == NULL) || (Sorted == NULL))
+    {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+    for (Bin = 0; Bin < NumBins; Bin++)
+        Power[Bin] = Threads[0].PowerSum[(Bin + FirstBin) % N] / NumSegments;
+    WindowSum = 0.0;
+    WindowSquares = 0.0;
+    for (Cntr = 0; Cntr < N; Cntr++)
+    {
+        WindowSum += WindowTable[Cntr];
+        WindowSquares += WindowTable[Cntr] * WindowTable[Cntr];
+    }
+    Reference = pow(2.0, (double)(Bits - 1)) * WindowSum;
+    Reference = Reference * Reference * (IsComplex ? 1.0 : 0.25);
+    for (Bin = 0; Bin < NumBins; Bin++)
+        Power[Bin] = (Power[Bin] + 1e-300) / Reference;
+    BinWidth = SampleRate / N;
+    ENBW = N * WindowSquares / (WindowSum * WindowSum);
+
+    //
+    // tone, spur, SINAD and noise floor
+    //
+    Exclude = (ExcludeBins != 0) ? ExcludeBins : Window->HalfWidth;
+    PeakBin = 0;
+    for (Bin = 0; Bin < NumBins; Bin++)
+        if (Power[Bin] > Power[PeakBin])
+            PeakBin = Bin;
+    PeakPower = Power[PeakBin];
+    SpurBin = (PeakBin == 0) ? NumBins - 1 : 0;
+    SpurPower = 0.0;
+    SignalPower = 0.0;
+    OtherPower = 0.0;
+    NoiseCount = 0;
+    for (Bin = 0; Bin < NumBins; Bin++)
+    {
+        uint32_t Distance = (Bin > PeakBin) ? Bin - PeakBin : PeakBin - Bin;
+        uint32_t DCBin = IsComplex ? N / 2 : 0;
+        uint32_t DCDistance = (Bin > DCBin) ? Bin - DCBin : DCBin - Bin;
+
+        if (Distance <= Exclude)
+        {
+            SignalPower += Power[Bin];
+            continue;
+        }
+        OtherPower += Power[Bin];
+        if (ExcludeDC && (DCDistance <= Exclude))
+            continue;
+        Sorted[NoiseCount++] = Power[Bin];
+        if (Power[Bin] > SpurPower)
+        {
+            SpurPower = Power[Bin];
+            SpurBin = Bin;
+        }
+    }
+    qsort(Sorted, NoiseCount, sizeof(double), CompareDoubles);
+    NoisePower = (NoiseCount > 0) ? Sorted[NoiseCount / 2] : 1e-300;
+
+    PeakFreq = ((double)PeakBin - (IsComplex ? N / 2 : 0)) * BinWidth;
+    PeakdBFS = 10.0 * log10(PeakPower);
+    SFDR = 10.0 * log10(PeakPower / ((SpurPower > 0.0) ? SpurPower : 1e-300));
+    SINAD = 10.0 * log10(SignalPower / ((OtherPower > 0.0) ? OtherPower : 1e-300));
+    NoisedBFS = 10.0 * log10(NoisePower);
+    NoisedBFSHz = NoisedBFS - 10.0 * log10(ENBW * BinWidth);
+
+    if (JSONOutput)
+        printf("{\"file\":\"%s\",\"samples\":%llu,\"fft\":%u,\"segments\":%u,\"window\":\"%s\",\"rate\":%.1f,"
+               "\"tone_hz\":%.3f,\"tone_dbfs\":%.2f,\"spur_hz\":%.3f,\"sfdr_dbc\":%.2f,\"sinad_db\":%.2f,"
+               "\"noise_dbfs_bin\":%.2f,\"noise_dbfs_hz\":%.2f}\n",
+               Filename, (unsigned long long)NumSamples, N, NumSegments, Window->Name, SampleRate,
+               PeakFreq, PeakdBFS, ((double)SpurBin - (IsComplex ? N / 2 : 0)) * BinWidth, SFDR, SINAD,
+               NoisedBFS, NoisedBFSHz);
+    else
+    {
+        printf("file:         %s\n", Filename);
+        printf("samples:      %llu %s, %.1f Hz, %u bit full scale\n", (unsigned long long)NumSamples,
+               IsComplex ? "complex" : "real", SampleRate, Bits);
+        printf("analysis:     %u point %s FFT, %u segments, %u threads\n", N, Window->Name, NumSegments, NumThreads);
+        printf("tone:         %.3f Hz, %.2f dBFS\n", PeakFreq, PeakdBFS);
+        printf("largest spur: %.3f Hz\n", ((double)SpurBin - (IsComplex ? N / 2 : 0)) * BinWidth);
+        printf("SFDR:         %.2f dBc\n", SFDR);
+        printf("SINAD:        %.2f dB\n", SINAD);
+        printf("noise floor:  %.2f dBFS per bin, %.2f dBFS/Hz\n", NoisedBFS, NoisedBFSHz);
+    }
+
+    if (SpectrumFilename != NULL)
+    {
+        FILE* File = fopen(SpectrumFilename, "w");
+
+        if (File == NULL)
+            perror(SpectrumFilename);
+        else
+        {
+            for (Bin = 0; Bin < NumBins; Bin++)
+                fprintf(File, "%.3f,%.2f\n", ((double)Bin - (IsComplex ? N / 2 : 0)) * BinWidth, 10.0 * log10(Power[Bin]));
+            fclose(File);
+        }
+    }
+
+    if ((MinSFDR != 0.0) && (SFDR < MinSFDR))
+    {
+        fprintf(stderr, "SFDR %.2f dBc is below the %.2f dBc limit\n", SFDR, MinSFDR);
+        Result = 1;
+    }
+    munmap(Mapping, MapLength);
+    close(fd);
+    return Result;
+}
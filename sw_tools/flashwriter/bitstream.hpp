@@ -0,0 +1,537 @@
+//-----------------------------------------------------------------------------
+// Name: bitstream.hpp
+// Description: checks of 7 series configuration bitstreams against the Saturn
+// multiboot flash layout, and configuration clock (COR0) changes
+//
+// the layout is set by FPGA/multiboot_address_table:
+//   0x00000000 golden (fallback) image, which jumps (IPROG) to timer 1
+//   0x0097FC00 timer 1
+//   0x00980000 primary (multiboot) image
+//   0x01300000 timer 2
+// images may be compressed (BITSTREAM.GENERAL.COMPRESS): they are smaller, so
+// they erase, program and configure faster, but must still fit their region.
+//
+// the packets are walked as the FPGA configuration logic reads them (UG470),
+// and the CRC worked out the same way: CRC32C over each register write as a
+// 37 bit word (5 bit register address above the 32 bit data), reset by the
+// RCRC command. A CRC register write is checked against it.
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------------------------//
+// Saturn multiboot flash layout
+//-------------------------------------------------------------------------------------//
+
+static constexpr uint32_t FLASH_GOLDEN_ADDR = 0x00000000;
+static constexpr uint32_t FLASH_TIMER1_ADDR = 0x0097FC00;
+static constexpr uint32_t FLASH_PRIMARY_ADDR = 0x00980000;
+static constexpr uint32_t FLASH_TIMER2_ADDR = 0x01300000;
+static constexpr uint32_t FLASH_DEVICE_SIZE = 0x02000000;     // 32MByte
+static constexpr uint32_t FLASH_ERASE_BYTES = 64 * 1024;      // erase sector: an image erases to the next boundary
+
+static constexpr uint32_t BITSTREAM_IDCODE = 0x03636093;      // XC7A200T, any revision
+static constexpr uint32_t BITSTREAM_IDCODE_MASK = 0x0FFFFFFF;
+
+// configuration registers and commands used here
+static constexpr uint32_t CFG_REG_CRC = 0x00;
+static constexpr uint32_t CFG_REG_FDRI = 0x02;
+static constexpr uint32_t CFG_REG_CMD = 0x04;
+static constexpr uint32_t CFG_REG_COR0 = 0x09;
+static constexpr uint32_t CFG_REG_MFWR = 0x0A;
+static constexpr uint32_t CFG_REG_IDCODE = 0x0C;
+static constexpr uint32_t CFG_REG_WBSTAR = 0x10;
+static constexpr uint32_t CFG_REG_TIMER = 0x11;
+static constexpr uint32_t CFG_REG_BSPI = 0x1F;
+static constexpr uint32_t CFG_CMD_RCRC = 0x07;
+static constexpr uint32_t CFG_CMD_DESYNC = 0x0D;
+static constexpr uint32_t CFG_CMD_IPROG = 0x0F;
+
+static constexpr uint32_t COR0_ECLK_EN = 1u << 26;            // CCLK from the EMCCLK pin, not the internal oscillator
+static constexpr uint32_t COR0_OSCFSEL_SHIFT = 17;            // 6 bit CCLK rate select
+static constexpr uint32_t COR0_OSCFSEL_MASK = 0x3F;
+
+
+//-------------------------------------------------------------------------------------//
+// Typedefs
+//-------------------------------------------------------------------------------------//
+
+struct bitstream_info_s
+{
+   bool valid = false;              // sync word found and packets read
+   bool bitHeader = false;          // file starts with a Vivado .bit header
+   size_t syncOffset = 0;           // byte offset of the sync word
+   size_t length = 0;               // bytes up to the end of the last packet
+   bool hasIDCode = false;
+   uint32_t idcode = 0;
+   bool hasCOR0 = false;
+   uint32_t cor0 = 0;
+   size_t cor0Offset = 0;           // byte offset of the COR0 data word
+   bool hasBSPI = false;
+   uint32_t bspi = 0;               // SPI read command in bits 7:0
+   uint32_t wbstar = 0;             // warm boot start address, for IPROG
+   bool iprog = false;              // jumps to the image at WBSTAR
+   bool timer = false;              // writes the watchdog timer register
+   bool compressed = false;         // frames written by MFWR multiple frame writes
+   size_t frameWords = 0;           // words written to FDRI
+   unsigned crcChecks = 0;          // CRC register writes
+   bool crcOK = true;               // every CRC write matched
+};
+
+struct layout_check_s
+{
+   std::vector<std::string> notes;  // what was found
+   std::vector<std::string> errors; // reasons not to program it
+};
+
+
+//-------------------------------------------------------------------------------------//
+// Bitstream parsing
+//-------------------------------------------------------------------------------------//
+
+/**
+ * @brief Step the configuration CRC over one register write
+ * @param crc: CRC so far
+ * @param reg: register address
+ * @param data: the word written
+ * @return The new CRC
+ */
+static uint32_t BitstreamCRC(uint32_t crc, uint32_t reg, uint32_t data)
+{
+   static const std::array<uint32_t, 256> table = []()
+   {
+      std::array<uint32_t, 256> t;
+      for (uint32_t n = 0; n < 256; n++)
+      {
+         uint32_t c = n;
+         for (int bit = 0; bit < 8; bit++)
+         {
+            c = (c & 1) ? (c >> 1) ^ 0x82F63B78 : (c >> 1);
+         }
+         t[n] = c;
+      }
+      return t;
+   }();
+
+   // data bits first, LSB first, then the 5 address bits
+   for (int byte = 0; byte < 4; byte++)
+   {
+      crc = (crc >> 8) ^ table[(crc ^ data) & 0xFF];
+      data >>= 8;
+   }
+   for (int bit = 0; bit < 5; bit++)
+   {
+      crc = ((crc ^ reg) & 1) ? (crc >> 1) ^ 0x82F63B78 : (crc >> 1);
+      reg >>= 1;
+   }
+   return crc;
+}
+
+static inline uint32_t BitstreamWord(const uint8_t* p)
+{
+   return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16)
+        | (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+/**
+ * @brief Walk the configuration packets of a bitstream
+ * @param data: image to read
+ * @param len: image length in bytes
+ * @param fixup: if not NULL, the same image, and each CRC write in it is rewritten
+ *               with the CRC worked out here
+ * @return What was found
+ */
+static bitstream_info_s WalkBitstream(const uint8_t* data, size_t len, uint8_t* fixup)
+{
+   static constexpr size_t SYNC_SEARCH_BYTES = 4096;  // sync is at most a few hundred bytes in
+   bitstream_info_s info;
+
+   info.bitHeader = (len >= 4) && (BitstreamWord(data) == 0x00090FF0);
+
+   // find the sync word; it need not be word aligned
+   size_t inx;
+   const size_t search = std::min(len, SYNC_SEARCH_BYTES);
+   for (inx = 0; inx + 4 <= search; inx++)
+   {
+      if (BitstreamWord(data + inx) == 0xAA995566)
+         break;
+   }
+   if (inx + 4 > search)
+   {
+      return info;
+// << early exit
+   }
+   info.syncOffset = inx;
+   info.valid = true;
+   inx += 4;
+
+   // then the packets, to the DESYNC command or the first word that isn't a packet header
+   uint32_t crc = 0;
+   uint32_t reg = 0;
+   bool hasReg = false;
+   while (inx + 4 <= len)
+   {
+      const uint32_t header = BitstreamWord(data + inx);
+      const uint32_t type = header >> 29;
+      const uint32_t op = (header >> 27) & 3;
+      size_t count;
+      if (type == 1)
+      {
+         reg = (header >> 13) & 0x1F;
+         count = header & 0x7FF;
+         hasReg = true;
+      }
+      else if ((type == 2) && hasReg)
+      {
+         count = header & 0x07FFFFFF;
+      }
+      else
+      {
+         break;
+      }
+      inx += 4;
+      if (inx + count * 4 > len)
+      {
+         info.valid = false;           // truncated
+         break;
+      }
+
+      if (op == 2)
+      {
+         if ((reg == CFG_REG_FDRI) || (reg == CFG_REG_MFWR))
+         {
+            // frame data: only the CRC needs each word
+            for (size_t word = 0; word < count; word++)
+            {
+               crc = BitstreamCRC(crc, reg, BitstreamWord(data + inx + word * 4));
+            }
+            if (reg == CFG_REG_FDRI)
+               info.frameWords += count;
+            else
+               info.compressed = true;
+            inx += count * 4;
+            continue;
+         }
+
+         bool desync = false;
+         for (size_t word = 0; word < count; word++, inx += 4)
+         {
+            uint32_t value = BitstreamWord(data + inx);
+            switch (reg)
+            {
+            case CFG_REG_CRC:
+               info.crcChecks++;
+               if (fixup)
+               {
+                  value = crc;
+                  fixup[inx] = value >> 24;
+                  fixup[inx + 1] = value >> 16;
+                  fixup[inx + 2] = value >> 8;
+                  fixup[inx + 3] = value;
+               }
+               else if (value != crc)
+               {
+                  info.crcOK = false;
+               }
+               break;
+
+            case CFG_REG_CMD:
+               if (value == CFG_CMD_RCRC)
+                  crc = 0;
+               else if (value == CFG_CMD_IPROG)
+                  info.iprog = true;
+               else if (value == CFG_CMD_DESYNC)
+                  desync = true;
+               break;
+
+            case CFG_REG_COR0:
+               info.hasCOR0 = true;
+               info.cor0 = value;
+               info.cor0Offset = inx;
+               break;
+
+            case CFG_REG_IDCODE:
+               info.hasIDCode = true;
+               info.idcode = value;
+               break;
+
+            case CFG_REG_WBSTAR:
+               info.wbstar = value;
+               break;
+
+            case CFG_REG_TIMER:
+               info.timer = true;
+               break;
+
+            case CFG_REG_BSPI:
+               info.hasBSPI = true;
+               info.bspi = value;
+               break;
+
+            default:
+               break;
+            }
+            if (!((reg == CFG_REG_CMD) && (value == CFG_CMD_RCRC)))
+               crc = BitstreamCRC(crc, reg, value);
+         }
+         if (desync)
+         {
+            break;
+         }
+      }
+      else
+      {
+         inx += count * 4;
+      }
+   }
+   info.length = std::min(inx, len);
+
+   return info;
+}
+
+/**
+ * @brief Read the configuration packets of a bitstream and check its CRC
+ * @param data: image to read
+ * @param len: image length in bytes
+ * @return What was found. valid is false if it is not a bitstream
+ */
+static bitstream_info_s ParseBitstream(const uint8_t* data, size_t len)
+{
+   return WalkBitstream(data, len, NULL);
+}
+
+/**
+ * @brief Set the configuration option register COR0, which selects the CCLK source
+ * and rate, then rewrite the CRC to match
+ * @param image: bitstream to change
+ * @param cor0: new COR0 value
+ * @return Error message, or empty if it was changed
+ */
+static std::string SetBitstreamCOR0(std::vector<uint8_t>& image, uint32_t cor0)
+{
+   const bitstream_info_s info = ParseBitstream(image.data(), image.size());
+   if (!info.valid || !info.hasCOR0)
+   {
+      return "the image has no COR0 register write to change";
+   }
+   if (info.crcChecks == 0)
+   {
+      return "the image has no CRC check, so the new COR0 couldn't be checked at configuration";
+   }
+   if (!info.crcOK)
+   {
+      return "the image CRC doesn't match its contents, so it was not changed";
+   }
+
+   image[info.cor0Offset] = cor0 >> 24;
+   image[info.cor0Offset + 1] = cor0 >> 16;
+   image[info.cor0Offset + 2] = cor0 >> 8;
+   image[info.cor0Offset + 3] = cor0;
+   WalkBitstream(image.data(), image.size(), image.data());
+   return "";
+}
+
+
+//-------------------------------------------------------------------------------------//
+// Flash layout checks
+//-------------------------------------------------------------------------------------//
+
+/**
+ * @brief Describe a bitstream in one line
+ */
+static std::string DescribeBitstream(const bitstream_info_s& info)
+{
+   char msg[256];
+   const char* width = "";
+   switch (info.bspi & 0xFF)
+   {
+   case 0x0B: case 0x0C: case 0x03: case 0x13:
+      width = ", SPI x1";
+      break;
+   case 0x3B: case 0x3C:
+      width = ", SPI x2";
+      break;
+   case 0x6B: case 0x6C:
+      width = ", SPI x4";
+      break;
+   }
+
+   int n = snprintf(msg, sizeof(msg), "bitstream of %zu bytes, %s", info.length - info.syncOffset,
+                    info.compressed ? "compressed" : "uncompressed");
+   if (info.hasCOR0)
+   {
+      n += snprintf(msg + n, sizeof(msg) - n, ", CCLK %s OSCFSEL %u (COR0 0x%08X)",
+                    (info.cor0 & COR0_ECLK_EN) ? "from EMCCLK" : "internal",
+                    (info.cor0 >> COR0_OSCFSEL_SHIFT) & COR0_OSCFSEL_MASK, info.cor0);
+   }
+   if (info.hasBSPI)
+   {
+      n += snprintf(msg + n, sizeof(msg) - n, ", read command 0x%02X%s", info.bspi & 0xFF, width);
+   }
+   if (info.iprog)
+   {
+      n += snprintf(msg + n, sizeof(msg) - n, ", jumps to 0x%08X", info.wbstar << 8);
+   }
+   snprintf(msg + n, sizeof(msg) - n, ", %u CRC check%s", info.crcChecks, (info.crcChecks == 1) ? "" : "s");
+   return msg;
+}
+
+/**
+ * @brief Check one region of the layout: a golden or primary image, or a timer
+ * @param check: notes and errors added to
+ * @param name: region name for messages
+ * @param addr: flash address the image is written to
+ * @param data: image
+ * @param len: image length
+ * @param limit: first flash address after the region
+ */
+static void CheckFlashRegion(layout_check_s& check, const char* name, uint32_t addr,
+                             const uint8_t* data, size_t len, uint32_t limit)
+{
+   char msg[256];
+   const bitstream_info_s info = ParseBitstream(data, len);
+   const bool isTimer = (addr == FLASH_TIMER1_ADDR) || (addr == FLASH_TIMER2_ADDR);
+
+   if (info.bitHeader)
+   {
+      snprintf(msg, sizeof(msg), "%s: this is a .bit file; make a .bin or .mcs file with write_cfgmem", name);
+      check.errors.push_back(msg);
+      return;
+// << early exit
+   }
+   if (!info.valid)
+   {
+      snprintf(msg, sizeof(msg), "%s: no configuration sync word found: not a bitstream", name);
+      check.errors.push_back(msg);
+      return;
+// << early exit
+   }
+   if (isTimer)
+   {
+      snprintf(msg, sizeof(msg), "%s at 0x%08X: %s", name, addr, info.timer ? "watchdog timer setting" : "no timer setting");
+      if (info.timer)
+         check.notes.push_back(msg);
+      else
+         check.errors.push_back(msg);
+      return;
+// << early exit
+   }
+
+   snprintf(msg, sizeof(msg), "%s at 0x%08X: %s", name, addr, DescribeBitstream(info).c_str());
+   check.notes.push_back(msg);
+   if (!info.hasIDCode || ((info.idcode & BITSTREAM_IDCODE_MASK) != BITSTREAM_IDCODE))
+   {
+      snprintf(msg, sizeof(msg), "%s: IDCODE 0x%08X is not an XC7A200T", name, info.idcode);
+      check.errors.push_back(msg);
+   }
+   if ((info.frameWords == 0) && !info.compressed)
+   {
+      snprintf(msg, sizeof(msg), "%s: no frame data", name);
+      check.errors.push_back(msg);
+   }
+   if (info.crcChecks && !info.crcOK)
+   {
+      snprintf(msg, sizeof(msg), "%s: CRC doesn't match: the file is damaged", name);
+      check.errors.push_back(msg);
+   }
+   if (addr + info.length > limit)
+   {
+      snprintf(msg, sizeof(msg), "%s: ends at 0x%08zX, beyond its region which ends at 0x%08X", name, addr + info.length, limit);
+      check.errors.push_back(msg);
+   }
+   if (addr == FLASH_GOLDEN_ADDR)
+   {
+      if (!info.iprog || ((info.wbstar << 8) != FLASH_TIMER1_ADDR))
+      {
+         snprintf(msg, sizeof(msg), "%s: doesn't jump to timer 1 at 0x%08X; build it with NEXT_CONFIG_ADDR 0x%08X",
+                  name, FLASH_TIMER1_ADDR, FLASH_TIMER1_ADDR);
+         check.errors.push_back(msg);
+      }
+   }
+   else if (info.iprog)
+   {
+      snprintf(msg, sizeof(msg), "%s: jumps to 0x%08X; only the golden image should set NEXT_CONFIG_ADDR",
+               name, info.wbstar << 8);
+      check.errors.push_back(msg);
+   }
+}
+
+/**
+ * @brief Check that an image written at a flash address keeps the multiboot layout bootable
+ * @param addr: flash address of the first byte
+ * @param data: image
+ * @param len: image length
+ * @return Notes of what was found, and errors if it should not be programmed
+ */
+static layout_check_s CheckFlashLayout(uint32_t addr, const uint8_t* data, size_t len)
+{
+   struct region_s
+   {
+      const char* name;
+      uint32_t start;
+      uint32_t limit;                  // first address after the region
+   };
+   static const region_s regions[] =
+   {
+      { "golden image", FLASH_GOLDEN_ADDR, FLASH_TIMER1_ADDR },
+      { "timer 1", FLASH_TIMER1_ADDR, FLASH_PRIMARY_ADDR },
+      { "primary image", FLASH_PRIMARY_ADDR, FLASH_TIMER2_ADDR },
+      { "timer 2", FLASH_TIMER2_ADDR, FLASH_TIMER2_ADDR + FLASH_ERASE_BYTES }
+   };
+
+   layout_check_s check;
+   char msg[256];
+   const uint64_t end = static_cast<uint64_t>(addr) + len;
+   const uint64_t eraseEnd = (end + FLASH_ERASE_BYTES - 1) & ~static_cast<uint64_t>(FLASH_ERASE_BYTES - 1);
+
+   if (end > FLASH_DEVICE_SIZE)
+   {
+      snprintf(msg, sizeof(msg), "image ends at 0x%08llX, beyond the end of flash", static_cast<unsigned long long>(end));
+      check.errors.push_back(msg);
+      return check;
+// << early exit
+   }
+
+   // whole flash image: check each region it holds
+   if ((addr == FLASH_GOLDEN_ADDR) && (len > FLASH_PRIMARY_ADDR))
+   {
+      for (const auto& region : regions)
+      {
+         if (region.start < len)
+         {
+            CheckFlashRegion(check, region.name, region.start, data + region.start,
+                             std::min<size_t>(len, region.limit) - region.start, region.limit);
+         }
+      }
+      return check;
+// << early exit
+   }
+
+   // one image: it must start a region, and erasing it must not reach the next
+   for (const auto& region : regions)
+   {
+      if (addr == region.start)
+      {
+         CheckFlashRegion(check, region.name, addr, data, len, region.limit);
+      }
+      else if ((addr < region.limit) && (eraseEnd > region.start))
+      {
+         snprintf(msg, sizeof(msg), "writing 0x%08X to 0x%08llX would erase the %s at 0x%08X",
+                  addr, static_cast<unsigned long long>(eraseEnd), region.name, region.start);
+         check.errors.push_back(msg);
+      }
+   }
+   if (check.notes.empty() && check.errors.empty())
+   {
+      snprintf(msg, sizeof(msg), "0x%08X is clear of the multiboot images", addr);
+      check.notes.push_back(msg);
+   }
+
+   return check;
+}
@@ -0,0 +1,673 @@
+//-----------------------------------------------------------------------------
+// Name: spi-s25fl.hpp
+// Description: Header file for module to implement spansion S25FL flash routines
+//-----------------------------------------------------------------------------
+
+#include "spi-s25fl.hpp"
+
+SPI_S25FL_c::~SPI_S25FL_c()
+{
+   // Clean up
+   XSpi_Stop(&mSPI);
+   XSpi_Reset(&mSPI);
+}
+
+/**
+ * @brief Initialize this object with hardware-specific settings
+ * 
+ * @param cfg: The configuration structure that describes the hardware 
+ */
+void SPI_S25FL_c::Init(const XSpi_Config& cfg)
+{
+   std::lock_guard<decltype(mMutex)> lock(mMutex);
+
+   // Store settings
+   mCfg = cfg;
+
+   int Status = XSpi_CfgInitialize(&mSPI, &mCfg, mCfg.BaseAddress);
+   if (Status != XST_SUCCESS)
+   {
+      throw std::runtime_error("Failed initializing flash library");
+   }
+
+   /*
+    * Set the SPI device as a master and in manual slave select mode such
+    * that the slave select signal does not toggle for every byte of a
+    * transfer, this must be done before the slave select is set.
+    */
+   Status = XSpi_SetOptions(&mSPI, XSP_MASTER_OPTION | XSP_MANUAL_SSELECT_OPTION);
+   if (Status != XST_SUCCESS)
+   {
+      throw std::runtime_error("Failed configuring flash library");
+   }
+
+   // We only have one slave
+   Status = XSpi_SetSlaveSelect(&mSPI, 1);
+   if (Status != XST_SUCCESS)
+   {
+      throw std::runtime_error("Failed configuring flash library");
+   }
+
+   // Get up and running, then disable interrupts before calling any other functions
+   XSpi_Start(&mSPI);
+   XSpi_IntrGlobalDisable(&mSPI);
+
+   // Read on 4 lanes if both the core and the flash are set up for it
+   mQuadRead = (mCfg.SpiMode == XSP_QUAD_MODE) && ((GetConfigRegister() & CR_QUAD_MASK) != 0);
+   SayStatus(mQuadRead ? "Flash reads use quad output read" : "Flash reads use single lane read");
+}
+
+/**
+ * @brief Register a callback function for flash status updates 
+ * 
+ * @param cb: The callback function to register 
+ */
+void SPI_S25FL_c::RegisterStatusCallback(const status_callback_t& cb)
+{
+   mCallBacks.push_back(cb);
+}
+
+/**
+ * @brief Erase a section of the flash. 
+ *  
+ * @note: Flash naturally erases on sector boundaries; this function doesn't attempt to 
+ * preserve data in a sector that isn't fully covered by addr, len 
+ * 
+ * @param addr: The Address to start erasing (will erase the entire sector containing this address) 
+ * @param len: The desired number of bytes to erase. 
+ */
+void SPI_S25FL_c::EraseRange(uint32_t addr, size_t len)
+{
+   // We don't support erase/write if not on an even sector boundary
+   if (addr & (FLASH_ENFORCED_SECTOR_BYTES - 1))
+   {
+      throw std::runtime_error("Flash address must be on an even page of " + std::to_string(FLASH_ENFORCED_SECTOR_BYTES) + " bytes");
+   }
+
+   std::lock_guard<decltype(mMutex)> lock(mMutex);
+
+   // Clear error bits
+   ClearStatusRegister();
+   // For now, no range checking. Just erase
+   size_t num_sectors_erased = 0;
+   size_t erased_bytes = 0;
+   while (erased_bytes < len)
+   {
+      WriteEnable();
+      SectorErase(addr + erased_bytes);
+      erased_bytes += FLASH_SECTOR_BYTES;
+      SayStatus("Erased Sector", static_cast<double>(erased_bytes) / static_cast<double>(len));
+      num_sectors_erased++;
+   }
+
+   SayStatus("Erased " + std::to_string(num_sectors_erased) + " sectors", 1.0);
+
+
+   // For erase, because they take so long, we'll wait here to avoid skewing stats
+   WaitForFlashNotBusy(FLASH_ERASE_TIMEOUT_S);
+
+   // Check for errors
+   const auto stat = GetStatusRegister();
+   if (stat & SR_ANY_ERR_MASK)
+   {
+      SayStatus("Warning: Flash indicated an error while erasing");
+   }
+}
+
+/**
+ * @brief Write to flash 
+ * 
+ * @param flash_addr: First address to start writing to 
+ * @param src: Pointer to source data 
+ * @param len: Number of bytes to write 
+ */
+void SPI_S25FL_c::Write(uint32_t flash_addr, const uint8_t* src, const size_t len)
+{
+   size_t numwritten = 0;
+
+   std::lock_guard<decltype(mMutex)> lock(mMutex);
+
+   // ASSUME the proper locations have been erased
+
+   // Clear error bits
+   ClearStatusRegister();
+
+   // We can write a page at a time
+   while (numwritten < len)
+   {
+      // Write up to one page
+      const auto flash_page_bytes = FLASH_PAGE_BYTES;  // Needed to compile C++11/C++14. Fixed in C++17. See https://stackoverflow.com/questions/8016780/undefined-reference-to-static-constexpr-char
+      const size_t real_count = std::min(flash_page_bytes, len - numwritten);
+
+      ProgramPage(flash_addr, src + numwritten, real_count);
+
+      flash_addr += real_count;
+      numwritten += real_count;
+       // Report status
+      std::stringstream ss;
+      ss << "Wrote " << numwritten << " bytes";
+      SayStatus(ss.str(), static_cast<double>(numwritten) / static_cast<double>(len));
+   }
+
+   // Check for errors
+   const auto stat = GetStatusRegister();
+   if (stat & SR_ANY_ERR_MASK)
+   {
+      SayStatus("Warning: Flash indicated an error while writing");
+   }
+
+}
+
+
+/**
+ * @brief Write to flash, verifying each sector as it completes 
+ *  
+ * @note: Each sector is read back as soon as it is programmed; the comparison runs on 
+ * a worker thread while the next sector is programmed, so no separate verify pass is needed 
+ * 
+ * @param flash_addr: First address to start writing to 
+ * @param src: Pointer to source data 
+ * @param len: Number of bytes to write 
+ * @return true if every sector read back matched the source data 
+ */
+bool SPI_S25FL_c::WriteVerify(uint32_t flash_addr, const uint8_t* src, const size_t len)
+{
+   size_t numwritten = 0;
+   bool verified = true;
+
+   std::lock_guard<decltype(mMutex)> lock(mMutex);
+
+   // ASSUME the proper locations have been erased
+
+   // Clear error bits
+   ClearStatusRegister();
+
+   // Two read-back buffers: one being compared while the other is filled
+   const auto flash_sector_bytes = FLASH_SECTOR_BYTES;
+   std::vector<uint8_t> readback[2] = { std::vector<uint8_t>(flash_sector_bytes), std::vector<uint8_t>(flash_sector_bytes) };
+   std::future<bool> pending_compare;
+   uint32_t pending_addr = 0;
+   int bufinx = 0;
+
+   const auto start = std::chrono::steady_clock::now();
+   while (numwritten < len && verified)
+   {
+      const size_t sector_count = std::min(flash_sector_bytes, len - numwritten);
+      const uint8_t* sector_src = src + numwritten;
+
+      // Program the sector a page at a time
+      const auto flash_page_bytes = FLASH_PAGE_BYTES;
+      for (size_t pageinx = 0; pageinx < sector_count; pageinx += flash_page_bytes)
+      {
+         ProgramPage(flash_addr + pageinx, sector_src + pageinx, std::min(flash_page_bytes, sector_count - pageinx));
+      }
+
+      // Read it back. The first read waits for the last page program to complete
+      uint8_t* dst = readback[bufinx].data();
+      ReadSector(flash_addr, dst, sector_count);
+
+      // Collect the previous sector's result, then compare this one while the next is programmed
+      if (pending_compare.valid() && !pending_compare.get())
+      {
+         verified = false;
+         break;
+      }
+      pending_addr = flash_addr;
+      pending_compare = std::async(std::launch::async, [dst, sector_src, sector_count]()
+      {
+         return memcmp(dst, sector_src, sector_count) == 0;
+      });
+      bufinx ^= 1;
+
+      flash_addr += sector_count;
+      numwritten += sector_count;
+      // Report status
+      std::stringstream ss;
+      ss << "Wrote " << numwritten << " bytes";
+      SayStatus(ss.str(), static_cast<double>(numwritten) / static_cast<double>(len));
+   }
+
+   // Collect the last sector's result
+   if (pending_compare.valid() && !pending_compare.get())
+   {
+      verified = false;
+   }
+   const std::chrono::duration<double> dt = std::chrono::steady_clock::now() - start;
+
+   if (!verified)
+   {
+      std::stringstream ss;
+      ss << "Verify failed in sector at 0x" << std::hex << pending_addr;
+      SayStatus(ss.str());
+   }
+   else
+   {
+      std::stringstream ss;
+      ss.precision(3);
+      ss << "Wrote and verified " << len << " bytes at " << (static_cast<double>(len) / dt.count() / 1.0e6) << " MB/s";
+      SayStatus(ss.str(), 1.0);
+   }
+
+   // Check for errors
+   const auto stat = GetStatusRegister();
+   if (stat & SR_ANY_ERR_MASK)
+   {
+      SayStatus("Warning: Flash indicated an error while writing");
+   }
+
+   return verified;
+}
+
+
+/**
+ * @brief Update a section of flash, erasing and programming only the sectors that differ 
+ *  
+ * @note: The current contents are read back and compared with src one erase sector at a 
+ * time. A sector that differs is erased only if a bit must change from 0 to 1, and only its 
+ * changed pages are programmed; it is then read back to verify it. 
+ * 
+ * @param flash_addr: First address to update (must be on an even sector boundary, as for EraseRange) 
+ * @param src: Pointer to source data 
+ * @param len: Number of bytes to update 
+ * @return true if every changed sector read back matched the source data 
+ */
+bool SPI_S25FL_c::UpdateRange(uint32_t flash_addr, const uint8_t* src, const size_t len)
+{
+   // We don't support erase/write if not on an even sector boundary
+   if (flash_addr & (FLASH_ENFORCED_SECTOR_BYTES - 1))
+   {
+      throw std::runtime_error("Flash address must be on an even page of " + std::to_string(FLASH_ENFORCED_SECTOR_BYTES) + " bytes");
+   }
+
+   std::lock_guard<decltype(mMutex)> lock(mMutex);
+
+   // Clear error bits
+   ClearStatusRegister();
+
+   // Compare in units of the largest erase sector, so an erase never touches data judged unchanged
+   const auto flash_enforced_sector_bytes = FLASH_ENFORCED_SECTOR_BYTES;
+   const auto flash_page_bytes = FLASH_PAGE_BYTES;
+   std::vector<uint8_t> current(flash_enforced_sector_bytes);
+   size_t numchecked = 0;
+   size_t num_sectors = 0;
+   size_t num_sectors_changed = 0;
+   size_t num_sectors_erased = 0;
+   bool verified = true;
+
+   const auto start = std::chrono::steady_clock::now();
+   while ((numchecked < len) && verified)
+   {
+      const uint32_t addr = flash_addr + numchecked;
+      const uint8_t* sector_src = src + numchecked;
+      const size_t sector_count = std::min(flash_enforced_sector_bytes, len - numchecked);
+
+      ReadSector(addr, current.data(), sector_count);
+      if (memcmp(current.data(), sector_src, sector_count) != 0)
+      {
+         // Programming can only clear bits; erase if any bit must be set
+         bool needs_erase = false;
+         for (size_t xx = 0; xx < sector_count; xx++)
+         {
+            if ((current[xx] & sector_src[xx]) != sector_src[xx])
+            {
+               needs_erase = true;
+               break;
+            }
+         }
+         if (needs_erase)
+         {
+            for (size_t erased_bytes = 0; erased_bytes < flash_enforced_sector_bytes; erased_bytes += FLASH_SECTOR_BYTES)
+            {
+               WriteEnable();
+               SectorErase(addr + erased_bytes);
+            }
+            memset(current.data(), 0xFF, sector_count);
+            num_sectors_erased++;
+         }
+
+         // Program only the pages that differ
+         for (size_t pageinx = 0; pageinx < sector_count; pageinx += flash_page_bytes)
+         {
+            const size_t page_count = std::min(flash_page_bytes, sector_count - pageinx);
+            if (memcmp(current.data() + pageinx, sector_src + pageinx, page_count) != 0)
+            {
+               ProgramPage(addr + pageinx, sector_src + pageinx, page_count);
+            }
+         }
+
+         // Verify the reprogrammed sector
+         ReadSector(addr, current.data(), sector_count);
+         if (memcmp(current.data(), sector_src, sector_count) != 0)
+         {
+            std::stringstream ss;
+            ss << "Verify failed in sector at 0x" << std::hex << addr;
+            SayStatus(ss.str());
+            verified = false;
+         }
+         num_sectors_changed++;
+      }
+
+      numchecked += sector_count;
+      num_sectors++;
+      // Report status
+      std::stringstream ss;
+      ss << "Checked " << numchecked << " bytes, " << num_sectors_changed << " sectors changed";
+      SayStatus(ss.str(), static_cast<double>(numchecked) / static_cast<double>(len));
+   }
+   const std::chrono::duration<double> dt = std::chrono::steady_clock::now() - start;
+
+   if (verified)
+   {
+      std::stringstream ss;
+      ss.precision(3);
+      ss << "Updated " << num_sectors_changed << " of " << num_sectors << " sectors (" << num_sectors_erased 
+         << " erased) at " << (static_cast<double>(len) / dt.count() / 1.0e6) << " MB/s";
+      SayStatus(ss.str(), 1.0);
+   }
+
+   // Check for errors
+   const auto stat = GetStatusRegister();
+   if (stat & SR_ANY_ERR_MASK)
+   {
+      SayStatus("Warning: Flash indicated an error while updating");
+   }
+
+   return verified;
+}
+
+
+/**
+ * @brief Read data from flash into buffer
+ * 
+ * @param flash_addr: Flash address to read from 
+ * @param dst: Buffer to place data from flash into 
+ * @param len: Number of bytes to read 
+ */
+void SPI_S25FL_c::Read(uint32_t flash_addr, uint8_t* dst, const size_t len)
+{
+   size_t numread = 0;
+
+   while (numread < len)
+   {
+      // Read up to one chunk; a read command may cross page boundaries
+      const auto flash_read_chunk_bytes = FLASH_READ_CHUNK_BYTES;
+      const size_t real_count = std::min(flash_read_chunk_bytes, len - numread);
+      ReadChunk(flash_addr, dst + numread, real_count);
+
+      flash_addr += real_count;
+      numread += real_count;
+
+      // Report status
+      std::stringstream ss;
+      ss << "Read " << numread << " bytes";
+      SayStatus(ss.str(), static_cast<double>(numread) / static_cast<double>(len));
+   }
+}
+
+
+
+//-------------------------------------------------------------------------------------//
+// Private functions
+//-------------------------------------------------------------------------------------//
+
+
+//--------------------------------------------------------------------------------
+// GetStatusRegister
+// Reads status register and returns it
+//--------------------------------------------------------------------------------
+uint8_t SPI_S25FL_c::GetStatusRegister(void)
+{
+   // Special case- don't call execute
+   // Don't need to wait for flash to be un-busy before reading status register
+   uint8_t sendbuf[16];
+   uint8_t recvbuf[16];
+
+   sendbuf[0] = CMD_STATUSREG_READ;
+
+   // Execute
+   const int status = XSpi_Transfer(&mSPI, sendbuf, recvbuf, 2);
+   if (status != XST_SUCCESS)
+   {
+      throw std::runtime_error("SPI transaction failed getting status register code " + std::to_string((int)status));
+   }
+
+   return recvbuf[1];
+}
+
+
+//--------------------------------------------------------------------------------
+// GetConfigRegister
+// Reads configuration register 1 and returns it
+//--------------------------------------------------------------------------------
+uint8_t SPI_S25FL_c::GetConfigRegister(void)
+{
+   // Same as the status register: a 2 byte transfer, not through Execute
+   uint8_t sendbuf[16];
+   uint8_t recvbuf[16];
+
+   sendbuf[0] = CMD_CONFIGREG_READ;
+
+   const int status = XSpi_Transfer(&mSPI, sendbuf, recvbuf, 2);
+   if (status != XST_SUCCESS)
+   {
+      throw std::runtime_error("SPI transaction failed getting configuration register code " + std::to_string((int)status));
+   }
+
+   return recvbuf[1];
+}
+
+
+//--------------------------------------------------------------------------------
+// ClearStatusRegister
+// Clears volatile/error bits in the status register
+//--------------------------------------------------------------------------------
+void SPI_S25FL_c::ClearStatusRegister(void)
+{
+   StartCommand(CMD_STATUSREG_CLEAR);
+   Execute(0);
+}
+
+
+
+//--------------------------------------------------------------------------------
+// WaitForFlashNotBusy
+// Waits up to wait_s seconds for flash to indicate it is done with the previous operation
+//--------------------------------------------------------------------------------
+void SPI_S25FL_c::WaitForFlashNotBusy(double wait_s)
+{
+   // Get the current time
+   const auto start = std::chrono::steady_clock::now();
+   while (1)
+   {
+      if ((GetStatusRegister() & SR_IS_READY_MASK) == 0)
+      {
+         break;
+      }
+
+      // Get the elapsed time in s
+      const std::chrono::duration<double> dt = std::chrono::steady_clock::now() - start;
+      if (dt.count() > wait_s)
+      {
+         throw std::runtime_error("Timeout waiting for flash ready");
+      }
+   }
+}
+
+//--------------------------------------------------------------------------------
+// StartCommand
+// Initialize the system in prep for sending a flash command
+//--------------------------------------------------------------------------------
+void SPI_S25FL_c::StartCommand(uint8_t cmd)
+{
+   mCurrWriteBufInx = 0;
+   mWriteBuf[mCurrWriteBufInx++] = cmd;
+}
+
+void SPI_S25FL_c::AddAddr(uint32_t addr)
+{
+   mWriteBuf[mCurrWriteBufInx++] = (uint8_t)(addr >> 24);
+   mWriteBuf[mCurrWriteBufInx++] = (uint8_t)(addr >> 16);
+   mWriteBuf[mCurrWriteBufInx++] = (uint8_t)(addr >> 8);
+   mWriteBuf[mCurrWriteBufInx++] = (uint8_t)(addr);
+}
+
+
+//--------------------------------------------------------------------------------
+// AddFromBuffer
+// Add len bytes from buf into transmit buffer to send to flash
+//--------------------------------------------------------------------------------
+void SPI_S25FL_c::AddFromBuffer(const uint8_t* buf, size_t len)
+{
+   if ((len + mCurrWriteBufInx) > TOTAL_BUFFER_SIZE)
+   {
+      throw std::runtime_error("Attempt to write too many bytes");
+   }
+
+   memcpy(mWriteBuf + mCurrWriteBufInx, buf, len);
+   mCurrWriteBufInx += len;
+}
+
+// Executes the command. Returns a pointer to read data.
+uint8_t* SPI_S25FL_c::Execute(size_t num2read, double timeout_s)
+{
+   if (0 == mCurrWriteBufInx)
+   {
+      throw std::runtime_error("No command specified");
+   }
+
+   if (((mCurrWriteBufInx - 1) + num2read) >= TOTAL_BUFFER_SIZE)
+   {
+      throw std::runtime_error("Attempt to read/write too many bytes");
+   }
+
+   // Make sure flash isn't busy
+   WaitForFlashNotBusy(timeout_s);
+
+   // Execute
+   const int status = XSpi_Transfer(&mSPI, mWriteBuf, num2read ? mReadBuf : NULL, mCurrWriteBufInx + num2read);
+   if (status != XST_SUCCESS)
+   {
+      throw std::runtime_error("SPI transaction failed"
+                                 " code " + std::to_string((int)status) 
+                               + " cmd "  + std::to_string((int)mWriteBuf[0])
+                               );
+   }
+
+   // Get the return value before zeroing index
+   const auto rez = num2read ? (mReadBuf + mCurrWriteBufInx) : NULL; 
+   mCurrWriteBufInx = 0;
+
+   // Return a pointer to the first byte read (if any)
+   return rez;
+}
+
+
+//--------------------------------------------------------------------------------
+// WriteEnable
+// Spansion flash requires this to be sent before writing/erasing
+//--------------------------------------------------------------------------------
+void SPI_S25FL_c::WriteEnable(void)
+{
+   StartCommand(CMD_WRITE_ENABLE);
+   Execute(0);
+}
+
+
+//--------------------------------------------------------------------------------
+// SectorErase
+// Erases the sector that contans address addr
+//--------------------------------------------------------------------------------
+void SPI_S25FL_c::SectorErase(u32 addr)
+{
+   StartCommand(CMD_SECTOR_ERASE);
+   AddAddr(addr);
+   Execute(0);
+}
+
+
+//--------------------------------------------------------------------------------
+// ProgramPage
+// Programs up to one page at addr, skipping pages that are all 0xFF
+//--------------------------------------------------------------------------------
+void SPI_S25FL_c::ProgramPage(uint32_t addr, const uint8_t* src, size_t len)
+{
+   // Optimize- skip whole pages of 0xFF
+   bool skip = true;
+   for (size_t xx = 0; xx < len; xx++)
+   {
+      if (src[xx] != 0xFF)
+      {
+         skip = false;
+         break;
+      }
+   }
+
+   // Only execute the command if its not all FF
+   if (!skip)
+   {
+      WriteEnable();
+      StartCommand(CMD_PAGEPROGRAM_WRITE);
+      AddAddr(addr);
+      AddFromBuffer(src, len);
+      Execute(0);
+   }
+}
+
+
+//--------------------------------------------------------------------------------
+// ReadChunk
+// Reads up to FLASH_READ_CHUNK_BYTES at addr with a single read command (quad output if enabled)
+//--------------------------------------------------------------------------------
+void SPI_S25FL_c::ReadChunk(uint32_t addr, uint8_t* dst, size_t len)
+{
+   if (mQuadRead)
+   {
+      // Command and address on one lane; then dummy clocks, and the data on 4 lanes
+      StartCommand(CMD_QUAD_OUTPUT_READ);
+      AddAddr(addr);
+      for (size_t xx = 0; xx < FLASH_QUAD_DUMMY_BYTES; xx++)
+      {
+         mWriteBuf[mCurrWriteBufInx++] = 0xFF;
+      }
+   }
+   else
+   {
+      StartCommand(CMD_RANDOM_READ);
+      AddAddr(addr);
+   }
+   const auto* rezbuf = Execute(len);
+   memcpy(dst, rezbuf, len);
+}
+
+
+//--------------------------------------------------------------------------------
+// ReadSector
+// Reads len bytes (up to one sector) at addr, one chunk per read command
+//--------------------------------------------------------------------------------
+void SPI_S25FL_c::ReadSector(uint32_t addr, uint8_t* dst, size_t len)
+{
+   const auto flash_read_chunk_bytes = FLASH_READ_CHUNK_BYTES;
+   for (size_t readinx = 0; readinx < len; readinx += flash_read_chunk_bytes)
+   {
+      ReadChunk(addr + readinx, dst + readinx, std::min(flash_read_chunk_bytes, len - readinx));
+   }
+}
+
+
+//--------------------------------------------------------------------------------
+// SayStatus
+// Report status to any registered callback functions
+//--------------------------------------------------------------------------------
+void SPI_S25FL_c::SayStatus(const std::string& msg, double pcnt_cplt)
+{
+   // Build a status structure
+   pgm_status_s stat;
+   stat.msg = msg;
+   stat.pcnt_cmplt = pcnt_cplt;
+
+   // Call all callbacks.
+   for (auto& cb : mCallBacks)
+   {
+      cb(stat);
+   }
+}
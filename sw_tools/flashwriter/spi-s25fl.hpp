@@ -0,0 +1,280 @@
+//-----------------------------------------------------------------------------
+// Name: spi-s25fl.hpp
+// Description: Header file for module to implement spansion S25FL flash routines
+//-----------------------------------------------------------------------------
+#pragma once
+
+#include "xspi.h"
+
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+//-------------------------------------------------------------------------------------//
+// Typedefs- should be common to all flash parts
+//-------------------------------------------------------------------------------------//
+
+struct pgm_status_s
+{
+   std::string msg;
+   double pcnt_cmplt = std::numeric_limits<double>::quiet_NaN();
+};
+
+typedef std::function<void(const pgm_status_s& stat)> status_callback_t;
+
+class SPI_S25FL_c
+{
+
+public:
+
+   ~SPI_S25FL_c();
+
+/**
+ * @brief Initialize this object with hardware-specific settings
+ * 
+ * @param cfg: The configuration structure that describes the hardware 
+ */
+   void Init(const XSpi_Config& cfg);
+
+/**
+ * @brief Register a callback function for flash status updates 
+ * 
+ * @param cb: The callback function to register 
+ */
+   void RegisterStatusCallback(const status_callback_t& cb);
+
+
+/**
+ * @brief Erase a section of the flash. 
+ *  
+ * @note: Flash naturally erases on sector boundaries; this function doesn't attempt to 
+ * preserve data in a sector that isn't fully covered by addr, len 
+ * 
+ * @param addr: The Address to start erasing (will erase the entire sector containing this address) 
+ * @param len: The desired number of bytes to erase. 
+ */
+   void EraseRange(uint32_t addr, size_t len);
+
+/**
+ * @brief Write to flash 
+ * 
+ * @param flash_addr: First address to start writing to 
+ * @param src: Pointer to source data 
+ * @param len: Number of bytes to write 
+ */
+   void Write(uint32_t flash_addr, const uint8_t* src, const size_t len);
+
+/**
+ * @brief Write to flash, verifying each sector as it completes 
+ *  
+ * @note: Each sector is read back as soon as it is programmed; the comparison runs on 
+ * a worker thread while the next sector is programmed, so no separate verify pass is needed 
+ * 
+ * @param flash_addr: First address to start writing to 
+ * @param src: Pointer to source data 
+ * @param len: Number of bytes to write 
+ * @return true if every sector read back matched the source data 
+ */
+   bool WriteVerify(uint32_t flash_addr, const uint8_t* src, const size_t len);
+
+/**
+ * @brief Update a section of flash, erasing and programming only the sectors that differ 
+ *  
+ * @note: The current contents are read back and compared with src one erase sector at a 
+ * time. A sector that differs is erased only if a bit must change from 0 to 1, and only its 
+ * changed pages are programmed; it is then read back to verify it. 
+ * 
+ * @param flash_addr: First address to update (must be on an even sector boundary, as for EraseRange) 
+ * @param src: Pointer to source data 
+ * @param len: Number of bytes to update 
+ * @return true if every changed sector read back matched the source data 
+ */
+   bool UpdateRange(uint32_t flash_addr, const uint8_t* src, const size_t len);
+
+
+/**
+ * @brief Read data from flash into buffer
+ * 
+ * @param flash_addr: Flash address to read from 
+ * @param dst: Buffer to place data from flash into 
+ * @param len: Number of bytes to read 
+ */
+   void Read(uint32_t flash_addr, uint8_t* dst, const size_t len);
+
+/**
+ * @brief Report whether reads use quad output read
+ * 
+ * @note: Quad reads are used if the SPI core is in quad mode, and the flash has its 
+ * quad I/O pins enabled (configuration register QUAD bit). Otherwise reads use the 
+ * single lane read command. 
+ * 
+ * @return true if reads transfer data on 4 lanes 
+ */
+   bool QuadReadEnabled(void) const
+   {
+      return mQuadRead;
+   }
+
+
+
+private:
+
+   //-------------------------------------------------------------------------------------//
+   // Private functions
+   //-------------------------------------------------------------------------------------//
+
+
+//--------------------------------------------------------------------------------
+// GetStatusRegister
+// Reads status register and returns it
+//--------------------------------------------------------------------------------
+   uint8_t GetStatusRegister(void);
+
+
+//--------------------------------------------------------------------------------
+// GetConfigRegister
+// Reads configuration register 1 and returns it
+//--------------------------------------------------------------------------------
+   uint8_t GetConfigRegister(void);
+
+
+//--------------------------------------------------------------------------------
+// ClearStatusRegister
+// Clears volatile/error bits in the status register
+//--------------------------------------------------------------------------------
+   void ClearStatusRegister(void);
+
+
+
+//--------------------------------------------------------------------------------
+// WaitForFlashNotBusy
+// Waits up to wait_s seconds for flash to indicate it is done with the previous operation
+//--------------------------------------------------------------------------------
+   void WaitForFlashNotBusy(double wait_s);
+
+
+//--------------------------------------------------------------------------------
+// StartCommand
+// Initialize the system in prep for sending a flash command
+//--------------------------------------------------------------------------------
+   void StartCommand(uint8_t cmd);
+
+   void AddAddr(uint32_t addr);
+
+
+//--------------------------------------------------------------------------------
+// AddFromBuffer
+// Add len bytes from buf into transmit buffer to send to flash
+//--------------------------------------------------------------------------------
+   void AddFromBuffer(const uint8_t* buf, size_t len);
+
+   // Executes the command. Returns a pointer to read data.
+   uint8_t* Execute(size_t num2read, double timeout_s = FLASH_DEFAULT_CMD_TIMEOUT_S);
+
+
+//--------------------------------------------------------------------------------
+// WriteEnable
+// Spansion flash requires this to be sent before writing/erasing
+//--------------------------------------------------------------------------------
+   void WriteEnable(void);
+
+
+//--------------------------------------------------------------------------------
+// SectorErase
+// Erases the sector that contans address addr
+//--------------------------------------------------------------------------------
+   void SectorErase(u32 addr);
+
+//--------------------------------------------------------------------------------
+// ProgramPage
+// Programs up to one page at addr, skipping pages that are all 0xFF
+//--------------------------------------------------------------------------------
+   void ProgramPage(uint32_t addr, const uint8_t* src, size_t len);
+
+//--------------------------------------------------------------------------------
+// ReadChunk
+// Reads up to FLASH_READ_CHUNK_BYTES at addr with a single read command (quad output if enabled)
+//--------------------------------------------------------------------------------
+   void ReadChunk(uint32_t addr, uint8_t* dst, size_t len);
+
+//--------------------------------------------------------------------------------
+// ReadSector
+// Reads len bytes (up to one sector) at addr, one chunk per read command
+//--------------------------------------------------------------------------------
+   void ReadSector(uint32_t addr, uint8_t* dst, size_t len);
+
+
+//--------------------------------------------------------------------------------
+// SayStatus
+// Report status to any registered callback functions
+//--------------------------------------------------------------------------------
+   void SayStatus(const std::string& msg, double pcnt_cplt = std::numeric_limits<double>::quiet_NaN());
+
+   //-------------------------------------------------------------------------------------//
+   // Private data
+   //-------------------------------------------------------------------------------------//
+
+   //-------------------------------------------------------------------------------------//
+   // Details of this flash
+
+   // Settings
+   static constexpr double FLASH_ERASE_TIMEOUT_S = 10.0; 
+   static constexpr double FLASH_DEFAULT_CMD_TIMEOUT_S = 10.0;
+   static constexpr size_t FLASH_ENFORCED_SECTOR_BYTES = 256 * 1024; // Some parts have 256K pages. 
+                                                                     // Since we don't check the part type, we must enforce the largest size
+
+   // Sizes
+   static constexpr size_t FLASH_PAGE_BYTES = 256;
+   static constexpr size_t FLASH_MAX_CMD_BYTES = 6;               // Command, 4 address bytes, and a dummy byte for fast reads
+   static constexpr size_t FLASH_SECTOR_BYTES = 64 * 1024;        // Not true for S25FL128xxxxxx1 devices, which have 256K
+   static constexpr size_t FLASH_READ_CHUNK_BYTES = 16384;        // Bytes read per command; reads may cross page boundaries
+   static constexpr size_t FLASH_QUAD_DUMMY_BYTES = 1;            // 8 dummy clocks before quad output read data (latency code 0)
+
+   // Commands. Note: All commands must use 4 byte addressing
+   static constexpr uint8_t CMD_RANDOM_READ       = 0x13;
+   static constexpr uint8_t CMD_QUAD_OUTPUT_READ  = 0x6C;        // 4QOR: data on 4 lanes
+   static constexpr uint8_t CMD_PAGEPROGRAM_WRITE = 0x12;
+   static constexpr uint8_t CMD_WRITE_ENABLE	  = 0x06;
+   static constexpr uint8_t CMD_SECTOR_ERASE	  = 0xDC;
+   static constexpr uint8_t CMD_STATUSREG_READ    = 0x05;
+   static constexpr uint8_t CMD_STATUSREG_WRITE   = 0x01;
+   static constexpr uint8_t CMD_STATUSREG_CLEAR   = 0x30;
+   static constexpr uint8_t CMD_CONFIGREG_READ    = 0x35;
+
+   // Register defs
+   static constexpr uint8_t SR_IS_READY_MASK = 0x01; // D0 is 1 when busy
+   static constexpr uint8_t SR_E_ERR_MASK = 0x20;       // D5 is 1 if erase error
+   static constexpr uint8_t SR_P_ERR_MASK = 0x40;       // D6 is 1 if program error
+   static constexpr uint8_t SR_ANY_ERR_MASK = (SR_P_ERR_MASK | SR_E_ERR_MASK);  // Any error
+   static constexpr uint8_t CR_QUAD_MASK = 0x02;        // D1 is 1 if the quad I/O pins are enabled
+   //-------------------------------------------------------------------------------------//
+
+
+   // Mutex to make the API thread safe. Must be locked by any public functions
+   std::recursive_mutex mMutex;
+
+   // Registered callback functions
+   std::vector<status_callback_t> mCallBacks;
+
+   // Xilinx-like SPI access classes
+   XSpi_Config mCfg;
+   XSpi        mSPI;
+
+   // Buffers for interaction with Xilinx library
+   static constexpr size_t TOTAL_BUFFER_SIZE = FLASH_MAX_CMD_BYTES + FLASH_READ_CHUNK_BYTES;
+   uint8_t mWriteBuf[TOTAL_BUFFER_SIZE];
+   uint8_t mReadBuf[TOTAL_BUFFER_SIZE];
+   size_t mCurrWriteBufInx = 0;
+
+   // True if reads use the quad output read command
+   bool mQuadRead = false;
+
+};
+
+
+
+
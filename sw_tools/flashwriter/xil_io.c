@@ -0,0 +1,89 @@
+#include "xil_io.h"
+
+#include <unistd.h> // pread/pwrite
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+
+// Defined somewhere else
+extern const char* gAXI_FNAME;
+
+// AXI-Lite space mapped: covers the SPI IP at 0x10000
+#define VAXIMAPSIZE 0x20000
+
+// Static data
+static int sfAXI = -1;
+static int sComplained = 0;
+static volatile u8* sAXIMap = NULL;     // mmap of AXI space; NULL if pread/pwrite used
+
+// Static functions
+static int CheckAndOpen(void)
+{
+   if (sfAXI < 0)
+   {
+      sfAXI = open(gAXI_FNAME, O_RDWR);
+      if (sfAXI >= 0)
+      {
+         // Map the register space so each access is a load or store rather than
+         // a system call. If the driver refuses, fall back to pread/pwrite.
+         void* map = mmap(NULL, VAXIMAPSIZE, PROT_READ | PROT_WRITE, MAP_SHARED, sfAXI, 0);
+         if (map != MAP_FAILED)
+         {
+            sAXIMap = (volatile u8*)map;
+         }
+      }
+   }
+
+   if ((sfAXI < 0) && !sComplained)
+   {
+      printf("Error opening device %s:%s", gAXI_FNAME, strerror(errno));
+      sComplained = 1;
+   }
+
+   return (sfAXI >= 0);
+}
+
+//-------------------------------------------------------------------------------------------------
+// Xil_In32
+//-------------------------------------------------------------------------------------------------
+u32 Xil_In32(UINTPTR Addr)
+{
+   u32 rez = 0;
+   if(CheckAndOpen())
+   {
+      if (sAXIMap && ((Addr + sizeof(rez)) <= VAXIMAPSIZE))
+      {
+         return *(volatile u32*)(sAXIMap + Addr);
+      }
+      ssize_t nread = pread(sfAXI, &rez, sizeof(rez), (off_t) Addr);
+      if (nread != sizeof(rez))
+      {
+         printf("Error writing to device:%s", strerror(errno));
+      }
+   }
+   return rez;
+}
+
+//-------------------------------------------------------------------------------------------------
+// Xil_In32
+//-------------------------------------------------------------------------------------------------
+void Xil_Out32(UINTPTR Addr, u32 Value)
+{
+   if(CheckAndOpen())
+   {
+      if (sAXIMap && ((Addr + sizeof(Value)) <= VAXIMAPSIZE))
+      {
+         *(volatile u32*)(sAXIMap + Addr) = Value;
+         return;
+      }
+      ssize_t nsent = pwrite(sfAXI, &Value, sizeof(Value), (off_t) Addr); 
+      if (nsent != sizeof(Value))
+      {
+         printf("Error writing to device:%s", strerror(errno));
+      }
+   }
+}
+
@@ -0,0 +1,517 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// p2sink.c:
+//
+// protocol 2 receive side benchmark: acts as the client to measure what
+// p2app sends. It discovers the radio, sends the general packet, a DDC
+// specific packet and high priority packets with the run bit set, then
+// receives every outgoing stream (high priority, mic, wideband, DDC I/Q)
+// on one socket with recvmmsg(). Packets are sorted by their source port.
+// At the end it reports for each port the packet rate, sequence gaps,
+// goodput, and a histogram of packet inter-arrival times (from the kernel
+// receive timestamps).
+// run p2trafficgen -n alongside it to load the inbound streams as well.
+//
+//////////////////////////////////////////////////////////////
+
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../../sw_projects/P2_app/IncomingDDCSpecific.h"    // packet sizes
+#include "../../sw_projects/P2_app/InHighPriority.h"
+
+//------------------------------------------------------------------------------------------
+// VERSION History
+// V1:   initial release
+
+
+#define VCMDPORT 1024                           // p2app command port
+#define VDDCSPECIFICPORT 1025                   // p2app DDC specific port
+#define VHIGHPRIORITYPORT 1027                  // p2app high priority port
+#define VGENERALSIZE 60                         // general and discovery packet size
+#define VHPRATE 10                              // high priority packets per second sent, to keep p2app running
+#define VNUMDDC 10
+#define VMAXPACKETSIZE 9000                     // largest packet received (jumbo DDC packets)
+#define VSINKBATCH 64                           // most packets received by one recvmmsg()
+#define VCONTROLSIZE 64                         // control message space for the receive timestamp
+#define VSINKRCVBUF (8 * 1024 * 1024)
+
+//
+// p2app source ports for its outgoing streams
+//
+#define VHPFROMSDRPORT 1025
+#define VMICPORT 1026
+#define VWIDEBANDPORT 1027
+#define VDDCIQPORT 1035
+
+//
+// inter-arrival histogram bucket upper limits, us; the last bucket is everything above
+//
+static const uint32_t BucketLimits[] = {50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000};
+#define VNUMBUCKETS (sizeof(BucketLimits) / sizeof(BucketLimits[0]) + 1)
+
+
+//
+// one received stream, identified by its source port
+//
+struct SinkPort
+{
+    const char* Name;
+    uint16_t Port;
+    uint64_t Packets;
+    uint64_t Bytes;                             // UDP payload bytes
+    uint64_t Gaps;                              // packets missing from the sequence
+    uint64_t OutOfOrder;                        // packets behind the sequence (reordered or repeated)
+    uint32_t NextSequence;
+    bool SequenceValid;
+    uint64_t LastArrival;                       // ns
+    uint64_t FirstArrival;
+    double IntervalSum;                         // inter-arrival times, us
+    double IntervalSquares;
+    double IntervalMax;
+    uint64_t Histogram[VNUMBUCKETS];
+};
+
+#define VNUMSINKPORTS (2 + 2 + VNUMDDC + 1)
+struct SinkPort SinkPorts[VNUMSINKPORTS] =
+{
+    {.Name = "highpriority", .Port = VHPFROMSDRPORT},
+    {.Name = "mic",          .Port = VMICPORT},
+    {.Name = "wideband0",    .Port = VWIDEBANDPORT},
+    {.Name = "wideband1",    .Port = VWIDEBANDPORT + 1},
+    {.Name = "ddc0",         .Port = VDDCIQPORT},
+    {.Name = "ddc1",         .Port = VDDCIQPORT + 1},
+    {.Name = "ddc2",         .Port = VDDCIQPORT + 2},
+    {.Name = "ddc3",         .Port = VDDCIQPORT + 3},
+    {.Name = "ddc4",         .Port = VDDCIQPORT + 4},
+    {.Name = "ddc5",         .Port = VDDCIQPORT + 5},
+    {.Name = "ddc6",         .Port = VDDCIQPORT + 6},
+    {.Name = "ddc7",         .Port = VDDCIQPORT + 7},
+    {.Name = "ddc8",         .Port = VDDCIQPORT + 8},
+    {.Name = "ddc9",         .Port = VDDCIQPORT + 9},
+    {.Name = "other",        .Port = 0}
+};
+
+int UDPSocket;
+struct sockaddr_in RadioAddr;
+uint32_t HPSequence = 0;
+uint16_t DDCEnables = 1;                        // DDCs to enable: bit per DDC
+uint16_t DDCRate = 192;                         // DDC sample rate, kHz
+uint8_t DDCSampleBits = 24;
+uint8_t WidebandEnables = 0;                    // wideband ADCs to enable: bit per ADC
+uint16_t MicSamples = 64;                       // mic samples per packet
+uint16_t DDCSamples = 0;                        // DDC samples per packet; 0 = standard 238
+
+
+//
+// time now in ns
+//
+static uint64_t TimeNow(void)
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_REALTIME, &Now);                    // same clock as SO_TIMESTAMPNS
+    return (uint64_t)Now.tv_sec * 1000000000ULL + Now.tv_nsec;
+}
+
+
+//
+// send one UDP packet to a p2app port
+//
+static void SendPacket(uint8_t* Packet, uint32_t Size, uint16_t Port)
+{
+    RadioAddr.sin_port = htons(Port);
+    if (sendto(UDPSocket, Packet, Size, 0, (struct sockaddr*)&RadioAddr, sizeof(RadioAddr)) < 0)
+        perror("sendto");
+}
+
+
+//
+// find the radio: send a discovery packet (broadcast if no address given), and take the first reply
+//
+static bool Discover(bool AddressSet)
+{
+    uint8_t Packet[VGENERALSIZE];
+    uint8_t Reply[VMAXPACKETSIZE];
+    struct sockaddr_in From;
+    socklen_t FromLength;
+    struct timeval ReplyTimeout = {1, 0};
+    int yes = 1;
+    int Size;
+    uint32_t Tries;
+
+    if (!AddressSet)
+    {
+        setsockopt(UDPSocket, SOL_SOCKET, SO_BROADCAST, (void*)&yes, sizeof(yes));
+        RadioAddr.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+    }
+    memset(Packet, 0, sizeof(Packet));
+    Packet[4] = 2;                                          // discovery command
+    setsockopt(UDPSocket, SOL_SOCKET, SO_RCVTIMEO, (void*)&ReplyTimeout, sizeof(ReplyTimeout));
+    for (Tries = 0; Tries < 3; Tries++)
+    {
+        SendPacket(Packet, sizeof(Packet), VCMDPORT);
+        FromLength = sizeof(From);
+        while ((Size = recvfrom(UDPSocket, Reply, sizeof(Reply), 0, (struct sockaddr*)&From, &FromLength)) > 0)
+        {
+            if ((Size == VGENERALSIZE) && (ntohs(From.sin_port) == VCMDPORT) && ((Reply[4] == 2) || (Reply[4] == 3)))
+            {
+                RadioAddr.sin_addr = From.sin_addr;
+                printf("discovered %s: board %d, protocol %d.%d, firmware %d%s\n", inet_ntoa(From.sin_addr),
+                       Reply[11], Reply[12] / 10, Reply[12] % 10, Reply[13], (Reply[4] == 3) ? " (busy)" : "");
+                return true;
+            }
+            FromLength = sizeof(From);
+        }
+    }
+    printf("no discovery reply\n");
+    return false;
+}
+
+
+//
+// send the general packet: p2app's default ports, and the wideband and mic settings
+//
+static void SendGeneralPacket(void)
+{
+    uint8_t Packet[VGENERALSIZE];
+
+    memset(Packet, 0, sizeof(Packet));
+    Packet[4] = 0;                                          // general packet command
+    Packet[23] = WidebandEnables;
+    *(uint16_t*)(Packet + 24) = htons(512);                 // wideband samples per packet
+    Packet[26] = 16;                                        // wideband sample size
+    Packet[27] = 50;                                        // wideband update rate, ms
+    Packet[28] = 32;                                        // wideband packets per frame
+    Packet[40] = MicSamples / 64;                           // mic samples per packet / 64 (Saturn extension)
+    *(uint16_t*)(Packet + 41) = htons(DDCSamples);          // DDC samples per packet (Saturn extension)
+    SendPacket(Packet, sizeof(Packet), VCMDPORT);
+}
+
+
+//
+// send the DDC specific packet: enable the DDCs asked for, on ADC1
+//
+static void SendDDCSpecific(void)
+{
+    static uint8_t Packet[VDDCSPECIFICSIZE];
+    uint32_t DDC;
+
+    memset(Packet, 0, sizeof(Packet));
+    *(uint16_t*)(Packet + 7) = DDCEnables;                  // (p2app reads this low byte 1st)
+    for (DDC = 0; DDC < VNUMDDC; DDC++)
+    {
+        Packet[DDC * 6 + 17] = 0;                           // ADC1
+        *(uint16_t*)(Packet + DDC * 6 + 18) = htons(DDCRate);
+        Packet[DDC * 6 + 22] = DDCSampleBits;
+    }
+    SendPacket(Packet, sizeof(Packet), VDDCSPECIFICPORT);
+}
+
+
+//
+// send a high priority packet with the run bit set or clear
+//
+static void SendHighPriority(bool Run)
+{
+    static uint8_t Packet[VHIGHPRIOTIYTOSDRSIZE];
+
+    memset(Packet, 0, sizeof(Packet));
+    *(uint32_t*)Packet = htonl(HPSequence++);
+    Packet[4] = Run ? 1 : 0;
+    SendPacket(Packet, sizeof(Packet), VHIGHPRIORITYPORT);
+}
+
+
+//
+// find the stream a packet came from
+//
+static struct SinkPort* FindPort(uint16_t Port)
+{
+    uint32_t Cntr;
+
+    for (Cntr = 0; Cntr < VNUMSINKPORTS - 1; Cntr++)
+        if (SinkPorts[Cntr].Port == Port)
+            return &SinkPorts[Cntr];
+    return &SinkPorts[VNUMSINKPORTS - 1];
+}
+
+
+//
+// count one received packet: sequence check, and inter-arrival time
+//
+static void CountPacket(struct SinkPort* Port, const uint8_t* Packet, uint32_t Size, uint64_t Arrival)
+{
+    uint32_t Sequence;
+    int32_t Offset;
+    double Interval;
+    uint32_t Bucket;
+
+    Port->Packets++;
+    Port->Bytes += Size;
+    if (Size >= 4)
+    {
+        Sequence = ntohl(*(uint32_t*)Packet);
+        Offset = (int32_t)(Sequence - Port->NextSequence);
+        if (!Port->SequenceValid || (Sequence == 0))
+            Port->SequenceValid = true;                     // 1st packet, or the stream restarted
+        else if (Offset > 0)
+            Port->Gaps += Offset;
+        else if (Offset < 0)
+            Port->OutOfOrder++;
+        if (Offset >= 0 || (Sequence == 0))
+            Port->NextSequence = Sequence + 1;
+    }
+    if (Port->LastArrival == 0)
+        Port->FirstArrival = Arrival;
+    else
+    {
+        Interval = (Arrival - Port->LastArrival) / 1000.0;
+        Port->IntervalSum += Interval;
+        Port->IntervalSquares += Interval * Interval;
+        if (Interval > Port->IntervalMax)
+            Port->IntervalMax = Interval;
+        for (Bucket = 0; Bucket < VNUMBUCKETS - 1; Bucket++)
+            if (Interval < BucketLimits[Bucket])
+                break;
+        Port->Histogram[Bucket]++;
+    }
+    Port->LastArrival = Arrival;
+}
+
+
+//
+// print the results for each port that received packets
+//
+static void Report(void)
+{
+    struct SinkPort* Port;
+    uint32_t Cntr, Bucket;
+    uint64_t Intervals;
+    double Duration, Mean, Deviation;
+    char Label[16];
+
+    printf("%-12s %10s %10s %10s %8s %9s %9s %9s %9s\n", "port", "packets", "packets/s", "gaps", "order",
+           "Mbit/s", "mean us", "jitter us", "max us");
+    for (Cntr = 0; Cntr < VNUMSINKPORTS; Cntr++)
+    {
+        Port = &SinkPorts[Cntr];
+        if (Port->Packets == 0)
+            continue;
+        Intervals = Port->Packets - 1;
+        Duration = (Port->LastArrival - Port->FirstArrival) * 1e-9;
+        Mean = (Intervals != 0) ? Port->IntervalSum / Intervals : 0.0;
+        Deviation = (Intervals != 0) ? Port->IntervalSquares / Intervals - Mean * Mean : 0.0;
+        printf("%-12s %10llu %10.1f %10llu %8llu %9.2f %9.1f %9.1f %9.1f\n", Port->Name,
+               (unsigned long long)Port->Packets, (Duration > 0.0) ? Intervals / Duration : 0.0,
+               (unsigned long long)Port->Gaps, (unsigned long long)Port->OutOfOrder,
+               (Duration > 0.0) ? Port->Bytes * 8e-6 / Duration : 0.0, Mean,
+               (Deviation > 0.0) ? sqrt(Deviation) : 0.0, Port->IntervalMax);
+    }
+    printf("\ninter-arrival histogram (us):\n%-12s", "port");
+    for (Bucket = 0; Bucket < VNUMBUCKETS; Bucket++)
+    {
+        snprintf(Label, sizeof(Label), "%s%u", (Bucket < VNUMBUCKETS - 1) ? "<" : ">=",
+                 BucketLimits[(Bucket < VNUMBUCKETS - 1) ? Bucket : VNUMBUCKETS - 2]);
+        printf(" %12s", Label);
+    }
+    printf("\n");
+    for (Cntr = 0; Cntr < VNUMSINKPORTS; Cntr++)
+    {
+        Port = &SinkPorts[Cntr];
+        if (Port->Packets < 2)
+            continue;
+        printf("%-12s", Port->Name);
+        for (Bucket = 0; Bucket < VNUMBUCKETS; Bucket++)
+            printf(" %12llu", (unsigned long long)Port->Histogram[Bucket]);
+        printf("\n");
+    }
+}
+
+
+static void PrintUsage(void)
+{
+    printf("usage: p2sink [options]\n");
+    printf("-a <address>     p2app IP address (default: broadcast discovery)\n");
+    printf("-t <seconds>     test duration (default 10)\n");
+    printf("-d <mask>        DDCs to enable, bit per DDC (default 1; 0 = none)\n");
+    printf("-r <kHz>         DDC sample rate (default 192)\n");
+    printf("-b <bits>        DDC sample size (default 24)\n");
+    printf("-w <mask>        wideband ADCs to enable, bit per ADC (default 0)\n");
+    printf("-m <samples>     mic samples per packet: 64, 128 or 256 (default 64)\n");
+    printf("-j <samples>     DDC samples per packet, for jumbo frames: 238 to 1490 (default 238)\n");
+    printf("-p <port>        local UDP port (default: any)\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+    static uint8_t Buffers[VSINKBATCH][VMAXPACKETSIZE];
+    static uint8_t Controls[VSINKBATCH][VCONTROLSIZE];
+    struct sockaddr_in FromAddr[VSINKBATCH];
+    struct iovec iovecinst[VSINKBATCH];
+    struct mmsghdr datagrams[VSINKBATCH];
+    struct sockaddr_in LocalAddr;
+    struct timeval ReadTimeout = {0, 10000};                // 10ms, so high priority packets are sent on time
+    struct cmsghdr* Control;
+    struct timespec* Stamp;
+    int CmdOption;
+    int yes = 1;
+    int RcvBuf = VSINKRCVBUF;
+    int Received, Cntr;
+    uint32_t Duration = 10;
+    uint64_t Start, End, Now, NextHP, Arrival;
+    uint16_t LocalPort = 0;
+    bool AddressSet = false;
+
+    memset(&RadioAddr, 0, sizeof(RadioAddr));
+    RadioAddr.sin_family = AF_INET;
+    while ((CmdOption = getopt(argc, argv, ":a:t:d:r:b:w:m:j:p:")) != -1)
+    {
+        switch (CmdOption)
+        {
+        case 'a':
+            AddressSet = (inet_pton(AF_INET, optarg, &RadioAddr.sin_addr) == 1);
+            break;
+        case 't':
+            Duration = atoi(optarg);
+            break;
+        case 'd':
+            DDCEnables = strtoul(optarg, NULL, 0);
+            break;
+        case 'r':
+            DDCRate = atoi(optarg);
+            break;
+        case 'b':
+            DDCSampleBits = atoi(optarg);
+            break;
+        case 'w':
+            WidebandEnables = strtoul(optarg, NULL, 0);
+            break;
+        case 'm':
+            MicSamples = atoi(optarg);
+            break;
+        case 'j':
+            DDCSamples = atoi(optarg);
+            break;
+        case 'p':
+            LocalPort = atoi(optarg);
+            break;
+        default:
+            PrintUsage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    UDPSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (UDPSocket < 0)
+    {
+        perror("socket");
+        return EXIT_FAILURE;
+    }
+    memset(&LocalAddr, 0, sizeof(LocalAddr));
+    LocalAddr.sin_family = AF_INET;
+    LocalAddr.sin_addr.s_addr = htonl(INADDR_ANY);
+    LocalAddr.sin_port = htons(LocalPort);
+    if (bind(UDPSocket, (struct sockaddr*)&LocalAddr, sizeof(LocalAddr)) < 0)
+    {
+        perror("bind");
+        return EXIT_FAILURE;
+    }
+    setsockopt(UDPSocket, SOL_SOCKET, SO_RCVBUF, (void*)&RcvBuf, sizeof(RcvBuf));
+    setsockopt(UDPSocket, SOL_SOCKET, SO_TIMESTAMPNS, (void*)&yes, sizeof(yes));
+    if (!Discover(AddressSet))
+        return EXIT_FAILURE;
+    setsockopt(UDPSocket, SOL_SOCKET, SO_RCVTIMEO, (void*)&ReadTimeout, sizeof(ReadTimeout));
+
+    //
+    // start p2app: general packet, DDC settings, then a high priority packet with the run bit set
+    //
+    SendGeneralPacket();
+    usleep(100000);
+    SendDDCSpecific();
+    usleep(100000);
+    SendHighPriority(true);
+    printf("receiving for %ds: DDC enables 0x%03x at %dkHz, %d bit; wideband enables 0x%x; mic %d samples\n",
+           Duration, DDCEnables, DDCRate, DDCSampleBits, WidebandEnables, MicSamples);
+
+    memset(iovecinst, 0, sizeof(iovecinst));
+    memset(datagrams, 0, sizeof(datagrams));
+    for (Cntr = 0; Cntr < VSINKBATCH; Cntr++)
+    {
+        iovecinst[Cntr].iov_base = Buffers[Cntr];
+        iovecinst[Cntr].iov_len = VMAXPACKETSIZE;
+        datagrams[Cntr].msg_hdr.msg_iov = &iovecinst[Cntr];
+        datagrams[Cntr].msg_hdr.msg_iovlen = 1;
+        datagrams[Cntr].msg_hdr.msg_name = &FromAddr[Cntr];
+    }
+    Start = TimeNow();
+    End = Start + (uint64_t)Duration * 1000000000ULL;
+    NextHP = Start;
+    //
+    // receive everything waiting in one call; keep p2app running with high priority packets
+    //
+    while ((Now = TimeNow()) < End)
+    {
+        if (Now >= NextHP)
+        {
+            SendHighPriority(true);
+            NextHP += 1000000000ULL / VHPRATE;
+        }
+        for (Cntr = 0; Cntr < VSINKBATCH; Cntr++)
+        {
+            datagrams[Cntr].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+            datagrams[Cntr].msg_hdr.msg_control = Controls[Cntr];
+            datagrams[Cntr].msg_hdr.msg_controllen = VCONTROLSIZE;
+        }
+        Received = recvmmsg(UDPSocket, datagrams, VSINKBATCH, MSG_WAITFORONE, NULL);
+        if ((Received < 0) && (errno != EAGAIN) && (errno != EINTR))
+        {
+            perror("recvmmsg");
+            break;
+        }
+        for (Cntr = 0; Cntr < Received; Cntr++)
+        {
+            if (FromAddr[Cntr].sin_addr.s_addr != RadioAddr.sin_addr.s_addr)
+                continue;
+            Arrival = 0;
+            for (Control = CMSG_FIRSTHDR(&datagrams[Cntr].msg_hdr); Control != NULL;
+                 Control = CMSG_NXTHDR(&datagrams[Cntr].msg_hdr, Control))
+                if ((Control->cmsg_level == SOL_SOCKET) && (Control->cmsg_type == SCM_TIMESTAMPNS))
+                {
+                    Stamp = (struct timespec*)CMSG_DATA(Control);
+                    Arrival = (uint64_t)Stamp->tv_sec * 1000000000ULL + Stamp->tv_nsec;
+                }
+            if (Arrival == 0)
+                Arrival = TimeNow();                        // no kernel timestamp
+            CountPacket(FindPort(ntohs(FromAddr[Cntr].sin_port)), Buffers[Cntr], datagrams[Cntr].msg_len, Arrival);
+        }
+    }
+
+    //
+    // stop p2app, and report
+    //
+    SendHighPriority(false);
+    Report();
+    close(UDPSocket);
+    return EXIT_SUCCESS;
+}
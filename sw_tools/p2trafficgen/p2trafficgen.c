@@ -0,0 +1,499 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// copyright Laurence Barker November 2021
+// licenced under GNU GPL3
+//
+// p2trafficgen.c:
+//
+// synthetic protocol 2 client traffic generator, to load test the
+// p2app receive side without an SDR client program.
+// sends a general packet, then high priority, DUC I/Q and speaker
+// audio packets at set rates with optional jitter and loss. It can also
+// act as the client's CAT server and send CAT commands. At the end the
+// receive side counters are read from the p2app metrics port (p2app -n).
+// with -n it leaves the general packet to p2sink, so p2app keeps sending
+// its outgoing streams to p2sink, for a full duplex test.
+//
+//////////////////////////////////////////////////////////////
+
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../../sw_projects/P2_app/threaddata.h"             // port table indices
+#include "../../sw_projects/P2_app/InDUCIQ.h"                // packet sizes
+#include "../../sw_projects/P2_app/InSpkrAudio.h"
+#include "../../sw_projects/P2_app/InHighPriority.h"
+
+//------------------------------------------------------------------------------------------
+// VERSION History
+// V1:   initial release
+
+
+#define VCMDPORT 1024                           // p2app command port
+#define VGENERALSIZE 60                         // general packet size
+#define VDEFAULTHPRATE 100                      // packets per second
+#define VDEFAULTDUCRATE 800                     // 192KHz / 240 samples per packet
+#define VDEFAULTSPKRATE 750                     // 48KHz / 64 samples per packet
+#define VNUMGENSTREAMS 4
+
+//
+// default p2app ports for the inbound streams (used as the general packet leaves them 0)
+//
+#define VDEFAULTHPPORT 1027
+#define VDEFAULTSPKPORT 1028
+#define VDEFAULTDUCPORT 1029
+
+typedef enum
+{
+    eHPStream,
+    eDUCStream,
+    eSpkStream,
+    eCATStream
+} EGenStream;
+
+
+//
+// one generated stream
+//
+struct GenStream
+{
+    const char* Name;
+    uint32_t Rate;                              // packets (or CAT messages) per second; 0 = off
+    uint16_t Port;                              // destination port; not used for CAT
+    uint32_t Size;                              // packet bytes
+    uint32_t Sequence;
+    uint64_t Sent;
+    uint64_t Dropped;                           // deliberately not sent, to simulate loss
+    uint64_t NextNominal;                       // ns: unjittered time of the next packet
+    uint64_t NextDue;                           // ns: time the next packet is sent
+};
+
+struct GenStream GenStreams[VNUMGENSTREAMS] =
+{
+    {"highpriority", VDEFAULTHPRATE, VDEFAULTHPPORT, VHIGHPRIOTIYTOSDRSIZE, 0, 0, 0, 0, 0},
+    {"duc", VDEFAULTDUCRATE, VDEFAULTDUCPORT, VDUCIQSIZE, 0, 0, 0, 0, 0},
+    {"speaker", VDEFAULTSPKRATE, VDEFAULTSPKPORT, VSPEAKERAUDIOSIZE, 0, 0, 0, 0, 0},
+    {"cat", 0, 0, 0, 0, 0, 0, 0, 0}
+};
+
+const char* CATCommands[] =
+{
+    "ZZFA00007100000;",
+    "ZZFB00014200000;",
+    "ZZMD00;",
+    "ZZTX0;"
+};
+#define VNUMCATCOMMANDS (sizeof(CATCommands) / sizeof(CATCommands[0]))
+
+int UDPSocket;
+struct sockaddr_in DestAddr;
+uint32_t JitterUs = 0;                          // each packet delayed by a random 0 to JitterUs
+double LossPercent = 0.0;                       // percentage of packets not sent
+uint16_t CATPort = 0;                           // if not 0, act as CAT server on this port
+int CATListenSocket = -1;
+int CATConnection = -1;
+uint16_t MetricsPort = 0;
+bool SendGeneral = true;                        // false if p2sink sends the general packet
+
+
+//
+// time now in ns
+//
+static uint64_t TimeNow(void)
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (uint64_t)Now.tv_sec * 1000000000ULL + Now.tv_nsec;
+}
+
+
+//
+// wait until an absolute time in ns
+//
+static void WaitUntil(uint64_t Time)
+{
+    struct timespec Wake;
+
+    Wake.tv_sec = Time / 1000000000ULL;
+    Wake.tv_nsec = Time % 1000000000ULL;
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &Wake, NULL);
+}
+
+
+//
+// schedule the next packet of a stream: nominal period, plus random jitter
+//
+static void ScheduleNext(struct GenStream* Stream)
+{
+    Stream->NextNominal += 1000000000ULL / Stream->Rate;
+    Stream->NextDue = Stream->NextNominal;
+    if (JitterUs != 0)
+        Stream->NextDue += (uint64_t)(rand() % (JitterUs + 1)) * 1000ULL;
+}
+
+
+//
+// send one UDP packet to a p2app port
+//
+static void SendPacket(uint8_t* Packet, uint32_t Size, uint16_t Port)
+{
+    DestAddr.sin_port = htons(Port);
+    if (sendto(UDPSocket, Packet, Size, 0, (struct sockaddr*)&DestAddr, sizeof(DestAddr)) < 0)
+        perror("sendto");
+}
+
+
+//
+// send the general packet; all port numbers left 0 so p2app uses its defaults
+//
+static void SendGeneralPacket(void)
+{
+    uint8_t Packet[VGENERALSIZE];
+
+    memset(Packet, 0, sizeof(Packet));
+    Packet[4] = 0;                                          // general packet command
+    SendPacket(Packet, sizeof(Packet), VCMDPORT);
+}
+
+
+//
+// send a high priority packet with the run bit set or clear
+// if acting as CAT server, it carries the CAT port so p2app connects to us
+//
+static void SendHighPriority(bool Run)
+{
+    uint8_t Packet[VHIGHPRIOTIYTOSDRSIZE];
+    struct GenStream* Stream = &GenStreams[eHPStream];
+
+    memset(Packet, 0, sizeof(Packet));
+    *(uint32_t*)Packet = htonl(Stream->Sequence++);
+    Packet[4] = Run ? 1 : 0;
+    if (CATPort != 0)
+        *(uint16_t*)(Packet + 1398) = htons(CATPort);
+    SendPacket(Packet, sizeof(Packet), Stream->Port);
+    Stream->Sent++;
+}
+
+
+//
+// send the next packet of a data stream, or drop it to simulate loss
+// DUC I/Q and speaker samples are a low level ramp
+//
+static void SendStreamPacket(struct GenStream* Stream)
+{
+    static uint8_t Packet[VDUCIQSIZE];
+    static uint8_t Sample = 0;
+    uint32_t Cntr;
+
+    if ((LossPercent > 0.0) && ((rand() % 1000000) < (int)(LossPercent * 10000.0)))
+    {
+        Stream->Sequence++;
+        Stream->Dropped++;
+        return;
+    }
+    *(uint32_t*)Packet = htonl(Stream->Sequence++);
+    for (Cntr = 4; Cntr < Stream->Size; Cntr++)
+        Packet[Cntr] = (Cntr & 1) ? 0 : Sample++ & 0x0F;
+    SendPacket(Packet, Stream->Size, Stream->Port);
+    Stream->Sent++;
+}
+
+
+//
+// CAT server: accept p2app's connection, discard what it sends, send the next command
+//
+static void ServiceCAT(bool SendCommand)
+{
+    char Buffer[1024];
+    const char* Command;
+
+    if (CATConnection < 0)
+    {
+        CATConnection = accept(CATListenSocket, NULL, NULL);
+        if (CATConnection < 0)
+            return;
+        fcntl(CATConnection, F_SETFL, O_NONBLOCK);
+        printf("p2app connected to CAT port\n");
+    }
+    while (recv(CATConnection, Buffer, sizeof(Buffer), 0) > 0)
+        ;
+    if (SendCommand)
+    {
+        Command = CATCommands[GenStreams[eCATStream].Sequence++ % VNUMCATCOMMANDS];
+        if (send(CATConnection, Command, strlen(Command), MSG_NOSIGNAL) < 0)
+        {
+            printf("CAT connection closed\n");
+            close(CATConnection);
+            CATConnection = -1;
+        }
+        else
+            GenStreams[eCATStream].Sent++;
+    }
+}
+
+
+//
+// open the CAT server port
+//
+static bool OpenCATServer(void)
+{
+    struct sockaddr_in Addr;
+    int yes = 1;
+
+    CATListenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (CATListenSocket < 0)
+    {
+        perror("CAT socket");
+        return false;
+    }
+    setsockopt(CATListenSocket, SOL_SOCKET, SO_REUSEADDR, (void*)&yes, sizeof(yes));
+    memset(&Addr, 0, sizeof(Addr));
+    Addr.sin_family = AF_INET;
+    Addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    Addr.sin_port = htons(CATPort);
+    if ((bind(CATListenSocket, (struct sockaddr*)&Addr, sizeof(Addr)) < 0) || (listen(CATListenSocket, 1) < 0))
+    {
+        perror("CAT bind");
+        return false;
+    }
+    fcntl(CATListenSocket, F_SETFL, O_NONBLOCK);
+    return true;
+}
+
+
+//
+// read the p2app metrics and print its receive side counters for the generated streams
+//
+static void ReportReceiveCounters(void)
+{
+    static char Response[65536];
+    static const char* Counters[] =
+    {
+        "p2app_packets_total", "p2app_sequence_gaps_total", "p2app_sequence_errors_total",
+        "p2app_fifo_underflow_total", "p2app_fifo_over_threshold_total"
+    };
+    struct sockaddr_in Addr;
+    int Socket;
+    int Length = 0, Received;
+    char* Line;
+    char* Next;
+    uint32_t Stream, Cntr;
+    char Label[64];
+
+    Socket = socket(AF_INET, SOCK_STREAM, 0);
+    Addr = DestAddr;
+    Addr.sin_port = htons(MetricsPort);
+    if ((Socket < 0) || (connect(Socket, (struct sockaddr*)&Addr, sizeof(Addr)) < 0))
+    {
+        perror("connect to p2app metrics port");
+        return;
+    }
+    send(Socket, "GET /metrics HTTP/1.0\r\n\r\n", 25, 0);
+    while ((Received = recv(Socket, Response + Length, sizeof(Response) - 1 - Length, 0)) > 0)
+        Length += Received;
+    close(Socket);
+    Response[Length] = 0;
+    printf("p2app receive side counters:\n");
+    for (Line = Response; Line != NULL; Line = Next)
+    {
+        Next = strchr(Line, '\n');
+        if (Next != NULL)
+            *Next++ = 0;
+        for (Cntr = 0; Cntr < sizeof(Counters) / sizeof(Counters[0]); Cntr++)
+        {
+            if (strncmp(Line, Counters[Cntr], strlen(Counters[Cntr])) != 0)
+                continue;
+            for (Stream = eHPStream; Stream <= eSpkStream; Stream++)
+            {
+                snprintf(Label, sizeof(Label), "{stream=\"%s\"}", GenStreams[Stream].Name);
+                if (strncmp(Line + strlen(Counters[Cntr]), Label, strlen(Label)) == 0)
+                    printf("  %s\n", Line);
+            }
+        }
+    }
+}
+
+
+static void PrintUsage(void)
+{
+    printf("usage: p2trafficgen -a <p2app IP address> [options]\n");
+    printf("-t <seconds>     test duration (default 10)\n");
+    printf("-h <rate>        high priority packets per second (default %d)\n", VDEFAULTHPRATE);
+    printf("-d <rate>        DUC I/Q packets per second (default %d; 0 = off)\n", VDEFAULTDUCRATE);
+    printf("-s <rate>        speaker audio packets per second (default %d; 0 = off)\n", VDEFAULTSPKRATE);
+    printf("-j <us>          delay each packet by a random 0 to <us> microseconds\n");
+    printf("-l <percent>     drop this percentage of DUC and speaker packets\n");
+    printf("-c <port>        act as CAT server on this TCP port\n");
+    printf("-r <rate>        CAT commands per second (default 10, with -c)\n");
+    printf("-m <port>        p2app metrics port (p2app -n); report its receive counters at the end\n");
+    printf("-n               don't send the general packet: p2sink is the client receiving p2app's streams\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+    int CmdOption;
+    uint32_t Duration = 10;
+    uint64_t Start, End, Now, Earliest;
+    uint32_t Stream, Due;
+    bool AddressSet = false;
+
+    GenStreams[eCATStream].Rate = 10;
+    memset(&DestAddr, 0, sizeof(DestAddr));
+    DestAddr.sin_family = AF_INET;
+    while ((CmdOption = getopt(argc, argv, ":a:t:h:d:s:j:l:c:r:m:n")) != -1)
+    {
+        switch (CmdOption)
+        {
+        case 'a':
+            AddressSet = (inet_pton(AF_INET, optarg, &DestAddr.sin_addr) == 1);
+            break;
+        case 't':
+            Duration = atoi(optarg);
+            break;
+        case 'h':
+            GenStreams[eHPStream].Rate = atoi(optarg);
+            break;
+        case 'd':
+            GenStreams[eDUCStream].Rate = atoi(optarg);
+            break;
+        case 's':
+            GenStreams[eSpkStream].Rate = atoi(optarg);
+            break;
+        case 'j':
+            JitterUs = atoi(optarg);
+            break;
+        case 'l':
+            LossPercent = atof(optarg);
+            break;
+        case 'c':
+            CATPort = atoi(optarg);
+            break;
+        case 'r':
+            GenStreams[eCATStream].Rate = atoi(optarg);
+            break;
+        case 'm':
+            MetricsPort = atoi(optarg);
+            break;
+        case 'n':
+            SendGeneral = false;
+            break;
+        default:
+            PrintUsage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (!AddressSet)
+    {
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+    if (GenStreams[eHPStream].Rate == 0)
+        GenStreams[eHPStream].Rate = 1;                     // needed to keep p2app running
+    if (CATPort == 0)
+        GenStreams[eCATStream].Rate = 0;
+    else if (!OpenCATServer())
+        return EXIT_FAILURE;
+
+    UDPSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (UDPSocket < 0)
+    {
+        perror("socket");
+        return EXIT_FAILURE;
+    }
+    srand(time(NULL));
+
+    //
+    // start p2app: general packet, then a high priority packet with the run bit set
+    //
+    if (SendGeneral)
+    {
+        SendGeneralPacket();
+        usleep(100000);
+    }
+    SendHighPriority(true);
+    usleep(100000);
+    printf("sending for %ds: high priority %d/s, DUC %d/s, speaker %d/s, jitter %dus, loss %.2f%%\n",
+           Duration, GenStreams[eHPStream].Rate, GenStreams[eDUCStream].Rate, GenStreams[eSpkStream].Rate,
+           JitterUs, LossPercent);
+
+    Start = TimeNow();
+    End = Start + (uint64_t)Duration * 1000000000ULL;
+    for (Stream = 0; Stream < VNUMGENSTREAMS; Stream++)
+    {
+        GenStreams[Stream].NextNominal = Start;
+        GenStreams[Stream].NextDue = Start;
+    }
+    //
+    // send whichever stream is due next. Jitter is added to each packet's nominal time,
+    // so it doesn't accumulate, and packets in a stream stay in order
+    //
+    while ((Now = TimeNow()) < End)
+    {
+        Earliest = End;
+        Due = VNUMGENSTREAMS;
+        for (Stream = 0; Stream < VNUMGENSTREAMS; Stream++)
+            if ((GenStreams[Stream].Rate != 0) && (GenStreams[Stream].NextDue < Earliest))
+            {
+                Earliest = GenStreams[Stream].NextDue;
+                Due = Stream;
+            }
+        if (Due == VNUMGENSTREAMS)
+            break;
+        if (Earliest > Now)
+            WaitUntil(Earliest);
+        switch ((EGenStream)Due)
+        {
+        case eHPStream:
+            SendHighPriority(true);
+            break;
+        case eCATStream:
+            ServiceCAT(true);
+            break;
+        default:
+            SendStreamPacket(&GenStreams[Due]);
+            break;
+        }
+        ScheduleNext(&GenStreams[Due]);
+    }
+
+    //
+    // stop p2app, and report
+    //
+    SendHighPriority(false);
+    Now = TimeNow();
+    for (Stream = 0; Stream < VNUMGENSTREAMS; Stream++)
+        if (GenStreams[Stream].Rate != 0)
+            printf("%s: sent %llu, dropped %llu, %.1f per second\n", GenStreams[Stream].Name,
+                   (unsigned long long)GenStreams[Stream].Sent, (unsigned long long)GenStreams[Stream].Dropped,
+                   GenStreams[Stream].Sent * 1.0E9 / (Now - Start));
+    if (MetricsPort != 0)
+    {
+        usleep(200000);
+        ReportReceiveCounters();
+    }
+    if (CATConnection >= 0)
+        close(CATConnection);
+    if (CATListenSocket >= 0)
+        close(CATListenSocket);
+    close(UDPSocket);
+    return EXIT_SUCCESS;
+}
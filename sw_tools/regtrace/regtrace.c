@@ -0,0 +1,368 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+// this application uses C code to emulate HPSDR protocol 2
+//
+// licenced under GNU GPL3
+//
+// regtrace.c:
+//
+// summarise a register access trace written by p2app built with
+// "make REGTRACE=1" (see sw_projects/common/regtrace.h).
+// reports the access rate per thread, then per register address (named
+// from the VADDR definitions in saturnregisters.h) and per calling
+// function, with the average and worst access time. Callers are named
+// by running addr2line on the p2app executable.
+//
+// regtrace [-n saturnregisters.h] [-e p2app] [-c callers shown] tracefile
+//
+//////////////////////////////////////////////////////////////
+
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+//------------------------------------------------------------------------------------------
+// VERSION History
+// V1:   initial release
+
+
+#define VMAXNAMES 256                           // VADDR definitions read
+#define VMAXADDRESSES 1024                      // distinct addresses summarised
+#define VMAXTHREADS 64
+#define VMAXCALLERS 1024
+#define VDEFAULTCALLERS 30                      // callers listed
+#define VDEFAULTNAMES "../../sw_projects/common/saturnregisters.h"
+
+
+struct AccessStats
+{
+    uint64_t Key;                               // address, thread ID or caller offset
+    uint64_t Reads;
+    uint64_t Writes;
+    uint64_t Words;
+    uint64_t TotalNs;
+    uint32_t MaxNs;
+};
+
+struct RegisterName
+{
+    uint32_t Address;
+    char Name[64];
+};
+
+static struct AccessStats AddressStats[VMAXADDRESSES];
+static uint32_t NumAddresses = 0;
+static struct AccessStats ThreadStats[VMAXTHREADS];
+static uint32_t NumThreads = 0;
+static struct AccessStats CallerStats[VMAXCALLERS];
+static uint32_t NumCallers = 0;
+static struct RegisterName Names[VMAXNAMES];
+static uint32_t NumNames = 0;
+static uint64_t Dropped = 0;                    // accesses not summarised: a table was full
+
+
+//
+// find or add the entry for Key in a table
+//
+static struct AccessStats* FindStats(struct AccessStats* Table, uint32_t* Count, uint32_t Size, uint64_t Key)
+{
+    uint32_t Cntr;
+
+    for (Cntr = 0; Cntr < *Count; Cntr++)
+        if (Table[Cntr].Key == Key)
+            return &Table[Cntr];
+    if (*Count == Size)
+        return NULL;
+    memset(&Table[*Count], 0, sizeof(struct AccessStats));
+    Table[*Count].Key = Key;
+    return &Table[(*Count)++];
+}
+
+
+static void AddAccess(struct AccessStats* Table, uint32_t* Count, uint32_t Size, uint64_t Key,
+                      char Op, uint32_t Words, uint32_t Duration)
+{
+    struct AccessStats* Stats;
+
+    Stats = FindStats(Table, Count, Size, Key);
+    if (Stats == NULL)
+    {
+        Dropped++;
+        return;
+    }
+    if (Op == 'R')
+        Stats->Reads++;
+    else
+        Stats->Writes++;
+    Stats->Words += Words;
+    Stats->TotalNs += Duration;
+    if (Duration > Stats->MaxNs)
+        Stats->MaxNs = Duration;
+}
+
+
+//
+// read the "#define VADDRxxx 0x..." register addresses
+//
+static void ReadNames(const char* Filename)
+{
+    FILE* File;
+    char Line[256];
+    char Name[64];
+    unsigned int Address;
+
+    File = fopen(Filename, "r");
+    if (File == NULL)
+    {
+        printf("register names file %s not found; addresses shown in hex\n", Filename);
+        return;
+    }
+    while ((fgets(Line, sizeof(Line), File) != NULL) && (NumNames < VMAXNAMES))
+        if (sscanf(Line, "#define %63s %x", Name, &Address) == 2 && (strncmp(Name, "VADDR", 5) == 0))
+        {
+            Names[NumNames].Address = Address;
+            strcpy(Names[NumNames].Name, Name + 5);
+            NumNames++;
+        }
+    fclose(File);
+}
+
+
+//
+// name an address: the register at or below it, with the offset from it if not exact
+//
+static void NameAddress(uint32_t Address, char* Result, size_t Size)
+{
+    uint32_t Cntr;
+    struct RegisterName* Nearest = NULL;
+
+    for (Cntr = 0; Cntr < NumNames; Cntr++)
+        if ((Names[Cntr].Address <= Address) && ((Nearest == NULL) || (Names[Cntr].Address > Nearest->Address)))
+            Nearest = &Names[Cntr];
+    if (Nearest == NULL)
+        snprintf(Result, Size, "-");
+    else if (Nearest->Address == Address)
+        snprintf(Result, Size, "%s", Nearest->Name);
+    else
+        snprintf(Result, Size, "%s+0x%x", Nearest->Name, Address - Nearest->Address);
+}
+
+
+//
+// name a caller using addr2line. The recorded address is the return address,
+// so look up the byte before it to get the calling line
+//
+static void NameCaller(const char* Executable, uint64_t Caller, char* Result, size_t Size)
+{
+    char Command[512];
+    char Function[256] = "?";
+    char Location[256] = "?";
+    char* End;
+    FILE* Pipe;
+
+    snprintf(Result, Size, "0x%llx", (unsigned long long)Caller);
+    if ((Executable == NULL) || (Caller == 0))
+        return;
+    snprintf(Command, sizeof(Command), "addr2line -f -s -e '%s' 0x%llx", Executable, (unsigned long long)(Caller - 1));
+    Pipe = popen(Command, "r");
+    if (Pipe == NULL)
+        return;
+    if ((fgets(Function, sizeof(Function), Pipe) != NULL) && (fgets(Location, sizeof(Location), Pipe) != NULL))
+    {
+        if ((End = strchr(Function, '\n')) != NULL)
+            *End = 0;
+        if ((End = strchr(Location, '\n')) != NULL)
+            *End = 0;
+        snprintf(Result, Size, "%s (%s)", Function, Location);
+    }
+    pclose(Pipe);
+}
+
+
+//
+// sort busiest first: by total time
+//
+static int CompareTime(const void* A, const void* B)
+{
+    const struct AccessStats* First = A;
+    const struct AccessStats* Second = B;
+
+    if (First->TotalNs == Second->TotalNs)
+        return 0;
+    return (First->TotalNs < Second->TotalNs) ? 1 : -1;
+}
+
+
+static int CompareKey(const void* A, const void* B)
+{
+    const struct AccessStats* First = A;
+    const struct AccessStats* Second = B;
+
+    if (First->Key == Second->Key)
+        return 0;
+    return (First->Key > Second->Key) ? 1 : -1;
+}
+
+
+static void PrintStats(const struct AccessStats* Stats, double Seconds)
+{
+    uint64_t Accesses = Stats->Reads + Stats->Writes;
+
+    printf("%10llu %10llu %10.1f %10.1f %8.0f %8u",
+           (unsigned long long)Stats->Reads, (unsigned long long)Stats->Writes,
+           Stats->Reads / Seconds, Stats->Writes / Seconds,
+           Accesses ? (double)Stats->TotalNs / Accesses : 0.0, Stats->MaxNs);
+}
+
+
+static void PrintUsage(void)
+{
+    printf("usage: regtrace [options] <trace file>\n");
+    printf("-n <file>        register names header (default %s)\n", VDEFAULTNAMES);
+    printf("-e <file>        p2app executable, to name callers (default: the one in the trace)\n");
+    printf("-c <count>       callers listed (default %d)\n", VDEFAULTCALLERS);
+}
+
+
+int main(int argc, char *argv[])
+{
+    int CmdOption;
+    const char* NamesFile = VDEFAULTNAMES;
+    const char* Executable = NULL;
+    char TraceExecutable[256] = "";
+    uint32_t CallersShown = VDEFAULTCALLERS;
+    FILE* File;
+    char Line[256];
+    char Text[320];
+    unsigned long long Time, Caller;
+    long Thread;
+    char Op;
+    unsigned int Address, Value, Words, Duration;
+    uint64_t First = UINT64_MAX, Last = 0, Total = 0;
+    struct AccessStats All;
+    double Seconds;
+    uint32_t Cntr;
+
+    while ((CmdOption = getopt(argc, argv, ":n:e:c:h")) != -1)
+    {
+        switch (CmdOption)
+        {
+        case 'n':
+            NamesFile = optarg;
+            break;
+        case 'e':
+            Executable = optarg;
+            break;
+        case 'c':
+            CallersShown = atoi(optarg);
+            break;
+        default:
+            PrintUsage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind != argc - 1)
+    {
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+    File = fopen(argv[optind], "r");
+    if (File == NULL)
+    {
+        perror("open trace file");
+        return EXIT_FAILURE;
+    }
+    ReadNames(NamesFile);
+    memset(&All, 0, sizeof(All));
+
+    while (fgets(Line, sizeof(Line), File) != NULL)
+    {
+        if (Line[0] == '#')
+        {
+            sscanf(Line, "# executable %255s", TraceExecutable);
+            continue;
+        }
+        if (sscanf(Line, "%llu %ld %c %x %x %u %u %llx", &Time, &Thread, &Op, &Address, &Value,
+                   &Words, &Duration, &Caller) != 8)
+            continue;
+        Total++;
+        if (Time < First)
+            First = Time;
+        if (Time + Duration > Last)
+            Last = Time + Duration;
+        if (Op == 'R')
+            All.Reads++;
+        else
+            All.Writes++;
+        All.Words += Words;
+        All.TotalNs += Duration;
+        if (Duration > All.MaxNs)
+            All.MaxNs = Duration;
+        AddAccess(AddressStats, &NumAddresses, VMAXADDRESSES, Address, Op, Words, Duration);
+        AddAccess(ThreadStats, &NumThreads, VMAXTHREADS, (uint64_t)Thread, Op, Words, Duration);
+        AddAccess(CallerStats, &NumCallers, VMAXCALLERS, Caller, Op, Words, Duration);
+    }
+    fclose(File);
+    if (Total == 0)
+    {
+        printf("no accesses in %s\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+    if ((Executable == NULL) && (TraceExecutable[0] != 0) && (access(TraceExecutable, R_OK) == 0))
+        Executable = TraceExecutable;
+
+    //
+    // each thread's ring holds its most recent accesses, so a busy thread's trace
+    // may start later than a quiet one's; rates are over the whole span
+    //
+    Seconds = (Last - First) * 1.0e-9;
+    if (Seconds <= 0.0)
+        Seconds = 1.0e-9;
+    printf("%llu accesses over %.3f s; %llu words; %.3f ms in register access\n",
+           (unsigned long long)Total, Seconds, (unsigned long long)All.Words, All.TotalNs * 1.0e-6);
+    if (Dropped != 0)
+        printf("%llu table entries dropped: too many distinct addresses or callers\n", (unsigned long long)Dropped);
+
+    printf("\n%-24s %10s %10s %10s %10s %8s %8s\n", "thread", "reads", "writes", "reads/s", "writes/s", "avg ns", "max ns");
+    qsort(ThreadStats, NumThreads, sizeof(struct AccessStats), CompareKey);
+    for (Cntr = 0; Cntr < NumThreads; Cntr++)
+    {
+        printf("%-24llu ", (unsigned long long)ThreadStats[Cntr].Key);
+        PrintStats(&ThreadStats[Cntr], Seconds);
+        printf("\n");
+    }
+    printf("%-24s ", "all");
+    PrintStats(&All, Seconds);
+    printf("\n");
+
+    printf("\n%-8s %-24s %10s %10s %10s %10s %8s %8s\n", "address", "register", "reads", "writes", "reads/s",
+           "writes/s", "avg ns", "max ns");
+    qsort(AddressStats, NumAddresses, sizeof(struct AccessStats), CompareKey);
+    for (Cntr = 0; Cntr < NumAddresses; Cntr++)
+    {
+        NameAddress((uint32_t)AddressStats[Cntr].Key, Text, sizeof(Text));
+        printf("0x%04llx   %-24s ", (unsigned long long)AddressStats[Cntr].Key, Text);
+        PrintStats(&AddressStats[Cntr], Seconds);
+        printf("\n");
+    }
+
+    printf("\n%10s %10s %10s %10s %8s %8s  %s\n", "reads", "writes", "reads/s", "writes/s", "avg ns", "max ns",
+           "caller (busiest first)");
+    qsort(CallerStats, NumCallers, sizeof(struct AccessStats), CompareTime);
+    for (Cntr = 0; (Cntr < NumCallers) && (Cntr < CallersShown); Cntr++)
+    {
+        NameCaller(Executable, CallerStats[Cntr].Key, Text, sizeof(Text));
+        PrintStats(&CallerStats[Cntr], Seconds);
+        printf("  %s\n", Text);
+    }
+    if (Executable == NULL)
+        printf("(use -e <p2app executable> to name the callers)\n");
+    return EXIT_SUCCESS;
+}
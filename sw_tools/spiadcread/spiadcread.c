@@ -4,6 +4,16 @@
 //
 // ./spiadcread
 //
+// bulk sampling mode: read a set of channels repeatedly and stream timestamped samples
+// ./spiadcread -b [-c channelmask] [-r rate] [-n samples] [-o file]
+//   -c: bit mask of channels to read (default 0x03 = forward and reverse voltage)
+//   -r: sample set rate in Hz (default 0 = as fast as possible)
+//   -n: number of sample sets to take (default 0 = until interrupted)
+//   -o: output file (default "-" = stdout)
+// each sample set is written in binary, native byte order:
+//   uint64_t time in ns (CLOCK_MONOTONIC), then one uint32_t per selected channel, lowest channel first
+// the achieved sample set rate is reported on stderr.
+//
 
 #define _DEFAULT_SOURCE
 #define _XOPEN_SOURCE 500
@@ -16,6 +26,8 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
 #include <time.h>
 
 #include <sys/mman.h>
@@ -25,6 +37,10 @@
 #include <unistd.h>
 
 #define AXIBaseAddress 0x10000									// address of StreamRead/Writer IP
+#define VADCBASEADDRESS 0xA000									// first SPI ADC channel register
+#define VADCCHANNELS 8
+#define VREGISTERMAPSIZE 0x20000								// AXI-Lite space mapped
+#define VDEFAULTCHANNELS 0x03									// forward and reverse voltage
 
 char* ChannelNames[] =
 {
@@ -42,6 +58,8 @@ char* ChannelNames[] =
 // mem read/write variables:
 //
 int register_fd;                             // device identifier
+volatile uint8_t* RegisterBase = NULL;		// mmap of register space; NULL if pread/pwrite used
+volatile sig_atomic_t StopSampling = 0;		// set by SIGINT to end bulk sampling
 
 //
 // 32 bit register write over the AXILite bus
@@ -58,6 +76,8 @@ uint32_t RegisterRead(uint32_t Address)
 {
 	uint32_t result = 0;
 
+	if (RegisterBase && (Address < VREGISTERMAPSIZE))
+		return *(volatile uint32_t*)(RegisterBase + Address);
 	ssize_t nread = pread(register_fd, &result, sizeof(result), (off_t)Address);
 	if (nread != sizeof(result))
 		printf("ERROR: register read: addr=0x%08X   error=%s\n", Address, strerror(errno));
@@ -66,27 +86,171 @@ uint32_t RegisterRead(uint32_t Address)
 
 
 
+//
+// SIGINT handler: end bulk sampling cleanly so the rate is reported
+//
+static void StopHandler(int Signal)
+{
+	(void)Signal;
+	StopSampling = 1;
+}
+
+
+//
+// time now in ns
+//
+static uint64_t GetTimeNs(void)
+{
+	struct timespec Now;
+
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	return (uint64_t)Now.tv_sec * 1000000000ULL + (uint64_t)Now.tv_nsec;
+}
+
+
+//
+// bulk sampling: read the channels in ChannelMask at Rate sample sets per second (0 = as fast
+// as possible), and write timestamped samples to Output until Count sets (0 = until SIGINT)
+//
+static void BulkSample(uint32_t ChannelMask, double Rate, uint64_t Count, FILE* Output)
+{
+	uint32_t Addresses[VADCCHANNELS];
+	uint32_t Values[VADCCHANNELS];
+	uint32_t ChannelCount = 0;
+	uint32_t Cntr;
+	uint64_t Timestamp;
+	uint64_t Taken = 0;
+	uint64_t StartTime;
+	uint64_t Elapsed;
+	uint64_t Period = 0;
+	struct timespec NextTime;
+
+	for (Cntr = 0; Cntr < VADCCHANNELS; Cntr++)
+		if (ChannelMask & (1 << Cntr))
+			Addresses[ChannelCount++] = VADCBASEADDRESS + 4 * Cntr;
+	if (ChannelCount == 0)
+	{
+		fprintf(stderr, "no channels selected\n");
+		return;
+	}
+	if (Rate > 0.0)
+		Period = (uint64_t)(1.0e9 / Rate);
+
+	signal(SIGINT, StopHandler);
+	fprintf(stderr, "sampling %d channels (mask 0x%02x)%s\n", ChannelCount, ChannelMask,
+	        RegisterBase ? "" : " using pread; expect a low rate");
+	clock_gettime(CLOCK_MONOTONIC, &NextTime);
+	StartTime = GetTimeNs();
+	while (!StopSampling && ((Count == 0) || (Taken < Count)))
+	{
+		Timestamp = GetTimeNs();
+		for (Cntr = 0; Cntr < ChannelCount; Cntr++)
+			Values[Cntr] = RegisterRead(Addresses[Cntr]);
+		if ((fwrite(&Timestamp, sizeof(Timestamp), 1, Output) != 1)
+		    || (fwrite(Values, sizeof(uint32_t), ChannelCount, Output) != ChannelCount))
+		{
+			perror("bulk sample write");
+			break;
+		}
+		Taken++;
+
+		// pace to the requested rate against absolute times, so the rate doesn't drift
+		if (Period != 0)
+		{
+			NextTime.tv_nsec += Period % 1000000000ULL;
+			NextTime.tv_sec += Period / 1000000000ULL;
+			if (NextTime.tv_nsec >= 1000000000L)
+			{
+				NextTime.tv_nsec -= 1000000000L;
+				NextTime.tv_sec++;
+			}
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &NextTime, NULL);
+		}
+	}
+	fflush(Output);
+	Elapsed = GetTimeNs() - StartTime;
+	if (Elapsed != 0)
+		fprintf(stderr, "%llu sample sets in %.3fs: %.1f sets/s (%.1f samples/s)\n", (unsigned long long)Taken,
+		        (double)Elapsed / 1.0e9, (double)Taken * 1.0e9 / (double)Elapsed,
+		        (double)(Taken * ChannelCount) * 1.0e9 / (double)Elapsed);
+}
+
+
+
 //
 // main program
 //
-int main(void)
+int main(int argc, char* argv[])
 {
 	uint32_t RegisterValue;
 	uint32_t RegisterAddress;
 	uint32_t Cntr;
+	void* Map;
+	int Option;
+	bool Bulk = false;
+	uint32_t ChannelMask = VDEFAULTCHANNELS;
+	double Rate = 0.0;
+	uint64_t Count = 0;
+	const char* OutputName = "-";
+	FILE* Output = stdout;
+
+	while ((Option = getopt(argc, argv, "bc:r:n:o:")) != -1)
+	{
+		switch (Option)
+		{
+		case 'b':
+			Bulk = true;
+			break;
+		case 'c':
+			ChannelMask = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			Rate = atof(optarg);
+			break;
+		case 'n':
+			Count = strtoull(optarg, NULL, 0);
+			break;
+		case 'o':
+			OutputName = optarg;
+			break;
+		default:
+			fprintf(stderr, "usage: spiadcread [-b [-c channelmask] [-r rate] [-n samples] [-o file]]\n");
+			return 1;
+		}
+	}
 
 	//
 	// try to open memory device
 	//
 	if ((register_fd = open("/dev/xdma0_user", O_RDWR)) == -1)
 	{
-		printf("register R/W address space not available\n");
+		fprintf(stderr, "register R/W address space not available\n");
 		goto out;
 	}
 	else
 	{
-		printf("register access connected to /dev/xdma0_user\n");
+		// map the register space so each read is a load without a system call
+		Map = mmap(NULL, VREGISTERMAPSIZE, PROT_READ | PROT_WRITE, MAP_SHARED, register_fd, 0);
+		if (Map != MAP_FAILED)
+			RegisterBase = (volatile uint8_t*)Map;
+		fprintf(stderr, "register access connected to /dev/xdma0_user%s\n", RegisterBase ? " (memory mapped)" : "");
+	}
 
+	if (Bulk)
+	{
+		if (strcmp(OutputName, "-") != 0)
+		{
+			Output = fopen(OutputName, "wb");
+			if (Output == NULL)
+			{
+				perror("bulk sample output file");
+				goto out;
+			}
+		}
+		BulkSample(ChannelMask, Rate, Count, Output);
+		if (Output != stdout)
+			fclose(Output);
+		goto out;
 	}
 
 
@@ -99,8 +263,8 @@ int main(void)
 	//
 	// read registers
 	//
-	RegisterAddress = 0xA000;
-	for (Cntr = 0; Cntr < 8; Cntr++)
+	RegisterAddress = VADCBASEADDRESS;
+	for (Cntr = 0; Cntr < VADCCHANNELS; Cntr++)
 	{
 		RegisterValue = RegisterRead(RegisterAddress);
 		RegisterAddress += 4;
@@ -111,6 +275,8 @@ int main(void)
 	//
 	// close down. Deallocate memory and close files
 	//
-out:	close(register_fd);
+out:	if (RegisterBase)
+		munmap((void*)RegisterBase, VREGISTERMAPSIZE);
+	close(register_fd);
 }
 
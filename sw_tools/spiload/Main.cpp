@@ -4,9 +4,13 @@
 
 // Includes
 #include "spi-s25fl.hpp"
+#include "bitstream.hpp"
 
 #include <getopt.h>
+#include <chrono>
+#include <cmath>
 #include <cstdlib>
+#include <limits>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -15,6 +19,15 @@
 // gAXI_FNAME is a global.
 const char* gAXI_FNAME = "/dev/xdma/card0/user";
 
+// Report progress as JSON lines (-j) rather than text, for scripts
+static bool gJSONOutput = false;
+
+// Streaming (-s) chunk size: one erase sector of the largest size, so each chunk can be erased on its own
+static constexpr size_t STREAM_CHUNK_BYTES = 256 * 1024;
+
+// Minimum time between progress reports
+static constexpr double PROGRESS_INTERVAL_S = 0.25;
+
 
 /**
  * @brief Parse 2 character literal as hex byte
@@ -68,7 +81,10 @@ static std::vector<uint8_t> LoadMCS(const char *fname)
             int lba_hi = readHexByte(line + 9);
             int lba_lo = readHexByte(line + 11);
             lba = (lba_hi << 24) | (lba_lo << 16);
-            printf("Was %08x now %08x\n", address_high, lba);
+            if (!gJSONOutput)
+            {
+               printf("Was %08x now %08x\n", address_high, lba);
+            }
             address_high = lba;
          }
          if (recordType == 0)
@@ -81,7 +97,7 @@ static std::vector<uint8_t> LoadMCS(const char *fname)
                len++;
                skip++;
             }
-            if (skip > 0)
+            if ((skip > 0) && !gJSONOutput)
             {
                printf("Skipped %i bytes from %08x to %08x\n", skip, len - skip, len);
             }
@@ -158,6 +174,253 @@ static std::vector<uint8_t> LoadBin(const char* fname, long int aOffset, long in
 
 
 
+/**
+ * @brief Escape a string for use in a JSON string value
+ * @return The escaped string
+ */
+static std::string JSONEscape(const std::string& str)
+{
+   std::string rez;
+   for (const char c : str)
+   {
+      if ((c == '"') || (c == '\\'))
+      {
+         rez += '\\';
+         rez += c;
+      }
+      else if (static_cast<unsigned char>(c) < 0x20)
+      {
+         char esc[8];
+         snprintf(esc, sizeof(esc), "\\u%04x", c);
+         rez += esc;
+      }
+      else
+      {
+         rez += c;
+      }
+   }
+   return rez;
+}
+
+/**
+ * @brief Report a stage, result or error, as text or as one JSON line 
+ * 
+ * @param event: Kind of report ("start", "stage", "result", "status" or "error") 
+ * @param msg: The message 
+ * @param pcnt_cmplt: Fraction complete, if known 
+ */
+static void SayEvent(const char* event, const std::string& msg, double pcnt_cmplt = std::numeric_limits<double>::quiet_NaN())
+{
+   if (gJSONOutput)
+   {
+      printf("{\"event\":\"%s\",\"msg\":\"%s\"", event, JSONEscape(msg).c_str());
+      if (!std::isnan(pcnt_cmplt))
+      {
+         printf(",\"percent\":%.1f", pcnt_cmplt * 100.0);
+      }
+      printf("}\n");
+   }
+   else
+   {
+      printf("\n%s\n", msg.c_str());
+   }
+}
+
+/**
+ * @brief Report streaming progress, at most once per PROGRESS_INTERVAL_S unless final 
+ * 
+ * @param flash_addr: Next flash address to be programmed 
+ * @param numwritten: Bytes programmed so far 
+ * @param pcnt_cmplt: Fraction of the file consumed 
+ * @param final: T to report regardless of the interval 
+ */
+static void SayProgress(uint32_t flash_addr, size_t numwritten, double pcnt_cmplt, bool final)
+{
+   static std::chrono::steady_clock::time_point last_report;
+
+   const auto now = std::chrono::steady_clock::now();
+   const std::chrono::duration<double> dt = now - last_report;
+   if (!final && (dt.count() < PROGRESS_INTERVAL_S))
+   {
+      return;
+   }
+   last_report = now;
+
+   if (gJSONOutput)
+   {
+      printf("{\"event\":\"progress\",\"address\":%u,\"bytes\":%zu,\"percent\":%.1f}\n", flash_addr, numwritten, pcnt_cmplt * 100.0);
+   }
+   else
+   {
+      printf("\r(%.1f%%):Programmed %zu bytes%-40s", pcnt_cmplt * 100.0, numwritten, "");
+   }
+}
+
+/**
+ * @brief Reads a raw binary or MCS file a chunk at a time, so it can be 
+ * programmed as it is parsed without holding the whole image in memory 
+ */
+class ImageStream_c
+{
+public:
+
+   ~ImageStream_c()
+   {
+      if (mFile)
+      {
+         fclose(mFile);
+      }
+   }
+
+/**
+ * @brief Open a raw binary file 
+ * @param aOffset: offset into the file to start loading 
+ * @param aLen: Number of bytes to load (0=read all) 
+ */
+   void OpenBin(const char* fname, long int aOffset, long int aLen)
+   {
+      Open(fname);
+      if (aOffset >= mFileSize)
+      {
+         throw std::runtime_error("File offset index exceeds file size");
+      }
+      fseek(mFile, aOffset, SEEK_SET);
+      mRemaining = (0 == aLen) ? (mFileSize - aOffset) : aLen;
+      mMCS = false;
+   }
+
+/**
+ * @brief Open a MCS file 
+ */
+   void OpenMCS(const char* fname)
+   {
+      Open(fname);
+      mMCS = true;
+   }
+
+/**
+ * @brief Read the next part of the image 
+ * @param dst: Buffer for the image data 
+ * @param maxlen: Size of dst 
+ * @return Number of bytes placed in dst; less than maxlen only at the end of the image 
+ */
+   size_t Read(uint8_t* dst, size_t maxlen)
+   {
+      if (!mMCS)
+      {
+         const size_t count = std::min(maxlen, static_cast<size_t>(mRemaining));
+         const size_t num_read = fread(dst, 1, count, mFile);
+         mRemaining -= num_read;
+         return num_read;
+      }
+
+      size_t numread = 0;
+      while (numread < maxlen)
+      {
+         if (mRecordInx < mRecordLen)
+         {
+            // Gaps between records are filled with 0xFF, as for LoadMCS
+            const uint32_t record_addr = mRecordAddr + mRecordInx;
+            if (record_addr > mImageInx)
+            {
+               const size_t fill = std::min(static_cast<size_t>(record_addr - mImageInx), maxlen - numread);
+               memset(dst + numread, 0xFF, fill);
+               numread += fill;
+               mImageInx += fill;
+               continue;
+            }
+            const size_t count = std::min(mRecordLen - mRecordInx, maxlen - numread);
+            memcpy(dst + numread, mRecord + mRecordInx, count);
+            numread += count;
+            mRecordInx += count;
+            mImageInx += count;
+         }
+         else if (!NextRecord())
+         {
+            break;
+         }
+      }
+      return numread;
+   }
+
+/**
+ * @brief Fraction of the file consumed so far
+ */
+   double FractionRead(void)
+   {
+      return (mFileSize > 0) ? (static_cast<double>(ftell(mFile)) / static_cast<double>(mFileSize)) : 1.0;
+   }
+
+private:
+
+   void Open(const char* fname)
+   {
+      mFile = fopen(fname, "rb");
+      if (!mFile)
+      {
+         char msg[256];
+         snprintf(msg, sizeof(msg), "Failed to open %s:%s\n", fname, strerror(errno));
+         throw std::runtime_error(std::string(msg));
+      }
+      fseek(mFile, 0, SEEK_END);
+      mFileSize = ftell(mFile);
+      fseek(mFile, 0, SEEK_SET);
+   }
+
+   // Parse MCS lines up to the next data record. Returns F at the end of the file
+   bool NextRecord(void)
+   {
+      char lineBuf[1024];
+      char* line;
+      while ((line = fgets(lineBuf, sizeof(lineBuf), mFile)))
+      {
+         if (line[0] != ':')
+         {
+            continue;
+         }
+         const int length = readHexByte(line + 1);
+         const int off_hi = readHexByte(line + 3);
+         const int off_lo = readHexByte(line + 5);
+         const int recordType = readHexByte(line + 7);
+
+         if (recordType == 4)
+         {
+            // Gap in data - new lba
+            const int lba_hi = readHexByte(line + 9);
+            const int lba_lo = readHexByte(line + 11);
+            mLBA = (lba_hi << 24) | (lba_lo << 16);
+         }
+         else if (recordType == 0)
+         {
+            for (int i = 0; i < length; i++)
+            {
+               mRecord[i] = readHexByte(line + 9 + i * 2);
+            }
+            mRecordAddr = mLBA | ((off_hi << 8) | off_lo);
+            mRecordLen = length;
+            mRecordInx = 0;
+            return true;
+         }
+      }
+      return false;
+   }
+
+   FILE* mFile = NULL;
+   long int mFileSize = 0;
+   bool mMCS = false;
+
+   // Raw binary: bytes still to read
+   long int mRemaining = 0;
+
+   // MCS: the current data record, and the image offset of the next byte to return
+   uint8_t mRecord[256];
+   uint32_t mRecordAddr = 0;
+   size_t mRecordLen = 0;
+   size_t mRecordInx = 0;
+   uint32_t mLBA = 0;
+   uint32_t mImageInx = 0;
+};
+
 /**
  * @brief Verify the existance of a file 
  * 
@@ -180,7 +443,7 @@ static bool FileCheck(const char* fname, int perm = R_OK)
  */
 static void PrintUsage(void)
 {
-   printf("\nspi-loader V1.2 copyright 2019 RHS Research LLC"
+   printf("\nspi-loader V1.3 copyright 2019 RHS Research LLC"
 	      "\nUsage: spi-loader [-a flashaddr] [-b fileoffset] [-l len] [-d device] [-r deviceoffset] [-f binary file] [-m mcs file]"
           "\n Loads len bytes from file at fileoffset into flash at address flashaddr\n"
 
@@ -197,6 +460,15 @@ static void PrintUsage(void)
 
           "\n Other options"
           "\n   -v: Verify after programming"
+          "\n   -u: Update: only erase and program the sectors that differ from the flash (always verified)"
+          "\n   -s: Stream: program the file as it is read, one 256KB chunk at a time (low memory use)"
+          "\n   -j: Report progress as JSON lines, for scripts"
+
+          "\n Multiboot image options"
+          "\n   -i: Information: check the image against the multiboot flash layout, and report it; don't program"
+          "\n   -x: Program even if the image doesn't fit the multiboot flash layout"
+          "\n   -c: Set COR0 (configuration clock source and rate) in a primary image, and update its CRC"
+          "\n       Images are checked against the layout before programming, except when streaming"
 
           "\n Note: Numeric values default to decimal, unless prefixed with 0x\n"
           );
@@ -209,7 +481,133 @@ static void PrintUsage(void)
  */
 static void MyStatusCallback(const pgm_status_s& stat)
 {
-   printf("\r(%.1f%%):%-60s", stat.pcnt_cmplt * 100.0, stat.msg.c_str());
+   if (gJSONOutput)
+   {
+      SayEvent("status", stat.msg, stat.pcnt_cmplt);
+   }
+   else
+   {
+      printf("\r(%.1f%%):%-60s", stat.pcnt_cmplt * 100.0, stat.msg.c_str());
+   }
+}
+
+/**
+ * @brief Status callback for streaming mode. The library's own progress figures are per 
+ * chunk, so only its warnings (reported without a completion figure) are passed on 
+ * 
+ * @param stat: New status being reported by the library 
+ */
+static void StreamStatusCallback(const pgm_status_s& stat)
+{
+   if (std::isnan(stat.pcnt_cmplt))
+   {
+      SayEvent("status", stat.msg);
+   }
+}
+
+/**
+ * @brief Program a file a chunk at a time as it is parsed, holding only one chunk in memory 
+ * 
+ * @param cfg: SPI core configuration 
+ * @param dataFileMCS: MCS file to load (NULL if dataFileBIN is used) 
+ * @param dataFileBIN: Raw binary file to load (NULL if dataFileMCS is used) 
+ * @param srcInx: Byte index into a binary file to start reading 
+ * @param byteLen: Number of bytes of a binary file to write (0 = all) 
+ * @param dstInx: Address of first byte in flash to overwrite 
+ * @param verify: T to read back and check each chunk after programming 
+ * @param update: T to only erase and program the sectors that changed 
+ * @return Program exit code
+ */
+static int StreamProgram(const XSpi_Config& cfg, const char* dataFileMCS, const char* dataFileBIN,
+                         long int srcInx, long int byteLen, long int dstInx, bool verify, bool update)
+{
+   ImageStream_c image;
+   if (dataFileMCS)
+   {
+      image.OpenMCS(dataFileMCS);
+   }
+   else
+   {
+      image.OpenBin(dataFileBIN, srcInx, byteLen);
+   }
+
+   char msg[512];
+   snprintf(msg, sizeof(msg), "Streaming %s[%ld] to flash[%ld] using %s[%ld]"
+          , dataFileMCS ? dataFileMCS : dataFileBIN
+          , srcInx
+          , dstInx
+          , cfg.dev_fname
+          , cfg.BaseAddress
+         );
+   SayEvent("start", msg);
+
+   // Instantiate flash programming class
+   SPI_S25FL_c fifc;
+   fifc.RegisterStatusCallback(StreamStatusCallback);
+
+   // Init
+   SayEvent("stage", "Initializing...");
+   fifc.Init(cfg);
+
+   // Each chunk is a whole erase sector, so every chunk starts on a sector boundary
+   std::vector<uint8_t> chunk(STREAM_CHUNK_BYTES);
+   std::vector<uint8_t> readback(verify ? STREAM_CHUNK_BYTES : 0);
+   uint32_t flash_addr = dstInx;
+   size_t numwritten = 0;
+   size_t count;
+
+   const auto start = std::chrono::steady_clock::now();
+   SayEvent("stage", update ? "Updating changed sectors..." : "Programming...");
+   while ((count = image.Read(chunk.data(), chunk.size())) > 0)
+   {
+      if (update)
+      {
+         if (!fifc.UpdateRange(flash_addr, chunk.data(), count))
+         {
+            SayEvent("error", "Verify failed");
+            return 1;
+   // << early exit
+         }
+      }
+      else
+      {
+         fifc.EraseRange(flash_addr, count);
+         fifc.Write(flash_addr, chunk.data(), count);
+         if (verify)
+         {
+            fifc.Read(flash_addr, readback.data(), count);
+            if (memcmp(readback.data(), chunk.data(), count) != 0)
+            {
+               snprintf(msg, sizeof(msg), "Verify failed in chunk at 0x%08x", flash_addr);
+               SayEvent("error", msg);
+               return 1;
+   // << early exit
+            }
+         }
+      }
+
+      flash_addr += count;
+      numwritten += count;
+      SayProgress(flash_addr, numwritten, image.FractionRead(), false);
+   }
+   SayProgress(flash_addr, numwritten, 1.0, true);
+
+   // Make sure we wrote at least one byte
+   if (0 == numwritten)
+   {
+      SayEvent("error", "Data file empty- no data to write");
+      return 1;
+// << early exit
+   }
+
+   const std::chrono::duration<double> dt = std::chrono::steady_clock::now() - start;
+   snprintf(msg, sizeof(msg), "Streamed %zu bytes in %.3fs (%.0fKiB/s)", numwritten, dt.count(), ((static_cast<double>(numwritten) / dt.count())) / 1024.0);
+   SayEvent("result", msg);
+   if (verify || update)
+   {
+      SayEvent("result", "Verify OK");
+   }
+   return 0;
 }
 
 /** 
@@ -247,10 +645,16 @@ int main(int argc, char* argv[])
       long int srcInx = 0;
       long int dstInx = 0x680000;      // Default to safe area outside of bootloader area
       bool verify = false;
+      bool update = false;
+      bool stream = false;
+      bool info = false;
+      bool force = false;
+      bool setCOR0 = false;
+      uint32_t cor0 = 0;
 
       // Process command line args
       int option;
-      while ((option = getopt(argc, argv, "a:b:l:d:r:f:m:v")) != -1)
+      while ((option = getopt(argc, argv, "a:b:l:d:r:f:m:c:vusjix")) != -1)
       {
          switch (option)
          {
@@ -288,6 +692,31 @@ int main(int argc, char* argv[])
             verify = true;
             break;
 
+         case 'u':
+            update = true;
+            break;
+
+         case 's':
+            stream = true;
+            break;
+
+         case 'j':
+            gJSONOutput = true;
+            break;
+
+         case 'i':
+            info = true;
+            break;
+
+         case 'x':
+            force = true;
+            break;
+
+         case 'c':
+            setCOR0 = true;
+            cor0 = strtoul(optarg, NULL, 0);
+            break;
+
          default:
             break;
          }
@@ -318,14 +747,36 @@ int main(int argc, char* argv[])
       }
 
 
+      // The layout checks and COR0 change need the whole image in memory
+      if (stream && (info || setCOR0))
+      {
+         printf("Cannot check (-i) or change (-c) an image while streaming (-s)\n");
+         return 1;
+// << early exit
+      }
+
       // Make sure the device file to access the AXI-SPI block exists
-      if (!FileCheck(cfg.dev_fname, R_OK | W_OK))
+      if (!info && !FileCheck(cfg.dev_fname, R_OK | W_OK))
       {
          printf("Device file not found:%s. Is the XDMA driver installed and working?\n", cfg.dev_fname);
          return 1; 
 // << early exit
       }
 
+      // This is ugly, but a side effect of reusing Xilinx code
+      // We need another parameter to do I/O via XDMA, namely, the dev file to perform I/O on
+      // gAXI_FNAME is a global.
+      // Assign the user-specified device filename to the global
+      gAXI_FNAME = cfg.dev_fname;
+
+      // Streaming: program the file a chunk at a time as it is parsed
+      if (stream)
+      {
+         SayEvent("status", "Streaming: the image is not checked against the multiboot flash layout");
+         return StreamProgram(cfg, dataFileMCS, dataFileBIN, srcInx, byteLen, dstInx, verify, update);
+   // << early exit
+      }
+
       // Load file
       std::vector<uint8_t> data_to_write;
       if (dataFileMCS)
@@ -340,14 +791,60 @@ int main(int argc, char* argv[])
       // Make sure we have at least one byte to write
       if (data_to_write.empty())
       {
-         printf("Data file empty- no data to write\n");
+         SayEvent("error", "Data file empty- no data to write");
          return 1; 
 // << early exit
       }
 
+      // Set the configuration clock. Only in the primary image, so that the golden
+      // image it falls back to can always configure
+      if (setCOR0)
+      {
+         if (dstInx != FLASH_PRIMARY_ADDR)
+         {
+            SayEvent("error", "COR0 can only be changed in a primary image, written to 0x00980000");
+            return 1;
+   // << early exit
+         }
+         const std::string err = SetBitstreamCOR0(data_to_write, cor0);
+         if (!err.empty())
+         {
+            SayEvent("error", "COR0 not changed: " + err);
+            return 1;
+   // << early exit
+         }
+      }
+
+      // Check the image against the multiboot flash layout
+      const layout_check_s check = CheckFlashLayout(dstInx, data_to_write.data(), data_to_write.size());
+      for (const auto& note : check.notes)
+      {
+         SayEvent("status", note);
+      }
+      for (const auto& error : check.errors)
+      {
+         SayEvent("error", error);
+      }
+      if (info)
+      {
+         return check.errors.empty() ? 0 : 1;
+   // << early exit
+      }
+      if (!check.errors.empty())
+      {
+         if (!force)
+         {
+            SayEvent("error", "Not programmed: the flash would not boot. Use -x to program anyway");
+            return 1;
+   // << early exit
+         }
+         SayEvent("status", "Programming anyway (-x)");
+      }
+
       // At this point, we have a device and some data to write to it.
       // Reveal final plans to the user
-      printf("Loading %ld bytes from %s[%ld] to flash[%ld] using %s[%ld]\n"
+      char msg[512];
+      snprintf(msg, sizeof(msg), "Loading %ld bytes from %s[%ld] to flash[%ld] using %s[%ld]"
              , data_to_write.size()
              , dataFileMCS ? dataFileMCS : dataFileBIN
              , srcInx
@@ -355,46 +852,64 @@ int main(int argc, char* argv[])
              , cfg.dev_fname
              , cfg.BaseAddress
             );
-
-      // This is ugly, but a side effect of reusing Xilinx code
-      // We need another parameter to do I/O via XDMA, namely, the dev file to perform I/O on
-      // gAXI_FNAME is a global.
-      // Assign the user-specified device filename to the global
-      gAXI_FNAME = cfg.dev_fname;
+      SayEvent("start", msg);
 
       // Instantiate flash programming class
       SPI_S25FL_c fifc;
       fifc.RegisterStatusCallback(MyStatusCallback);
+      fifc.SetStatusInterval(PROGRESS_INTERVAL_S);
 
       // Init
-      printf("\nInitializing...\n");
+      SayEvent("stage", "Initializing...");
       fifc.Init(cfg);
 
       // Mark erase/program start
       const auto elap_start = std::chrono::steady_clock::now();
 
+      // Differential update: read back and compare, erase/program only the sectors that changed
+      if (update)
+      {
+         SayEvent("stage", "Updating changed sectors...");
+         const bool verified = fifc.UpdateRange(dstInx, data_to_write.data(), data_to_write.size());
+         const std::chrono::duration<double> dt = std::chrono::steady_clock::now() - elap_start;
+         snprintf(msg, sizeof(msg), "Update took %.3fs (%.0fKiB/s)", dt.count(), ((static_cast<double>(data_to_write.size()) / dt.count())) / 1024.0);
+         SayEvent("result", msg);
+         if (!verified)
+         {
+            SayEvent("error", "Verify failed");
+            return 1; 
+   // << early exit
+         }
+         SayEvent("result", "Verify OK");
+         return 0;
+   // << early exit
+      }
+
       // Erase
-      printf("\nErasing...\n");
+      SayEvent("stage", "Erasing...");
       auto start = std::chrono::steady_clock::now();
       fifc.EraseRange(dstInx, data_to_write.size());
       std::chrono::duration<double> dt = std::chrono::steady_clock::now() - start;
-      printf("\nErased in %.3fs...\n", dt.count());
+      snprintf(msg, sizeof(msg), "Erased in %.3fs...", dt.count());
+      SayEvent("stage", msg);
 
       // Program
-      printf("\nProgramming...\n");
+      SayEvent("stage", "Programming...");
       start = std::chrono::steady_clock::now();
       fifc.Write(dstInx, data_to_write.data(), data_to_write.size());
       dt = std::chrono::steady_clock::now() - start;
-      printf("\nProgrammed in %.3fs...\n", dt.count());
+      snprintf(msg, sizeof(msg), "Programmed in %.3fs...", dt.count());
+      SayEvent("stage", msg);
 
       // Report erase/program time
       dt = std::chrono::steady_clock::now() - elap_start;
-      printf("\nErase/Program took %.3fs (%.0fKiB/s)\n", dt.count(), ((static_cast<double>(data_to_write.size()) / dt.count())) / 1024.0);
+      snprintf(msg, sizeof(msg), "Erase/Program took %.3fs (%.0fKiB/s)", dt.count(), ((static_cast<double>(data_to_write.size()) / dt.count())) / 1024.0);
+      SayEvent("result", msg);
 
       // Verify
       if (verify)
       {
-         printf("\nVerifying...\n");
+         SayEvent("stage", "Verifying...");
          start = std::chrono::steady_clock::now();
 
          // Read section into vector
@@ -402,24 +917,25 @@ int main(int argc, char* argv[])
          fifc.Read(dstInx, tmp.data(), tmp.size());
 
          dt = std::chrono::steady_clock::now() - start;
-         printf("\nRead in %.3fs...\n", dt.count());
+         snprintf(msg, sizeof(msg), "Read in %.3fs...", dt.count());
+         SayEvent("stage", msg);
 
          // Check and report
          if (tmp != data_to_write)
          {
-            printf("\nVerify failed\n");
+            SayEvent("error", "Verify failed");
             return 1; 
    // << early exit
          }
          else
          {
-            printf("\nVerify OK\n");
+            SayEvent("result", "Verify OK");
          }
       }
    }
    catch (const std::exception& ex)
    {
-      printf("\nException occurred: %s\n", ex.what());
+      SayEvent("error", std::string("Exception occurred: ") + ex.what());
 
       return 1;
    }
@@ -6,6 +6,7 @@
 
 #include "xspi.h"
 
+#include <chrono>
 #include <cstring>
 #include <functional>
 #include <mutex>
@@ -75,6 +76,10 @@ public:
       // Get up and running, then disable interrupts before calling any other functions
       XSpi_Start(&mSPI);
       XSpi_IntrGlobalDisable(&mSPI);
+
+      // Read on 4 lanes if both the core and the flash are set up for it
+      mQuadRead = (mCfg.SpiMode == XSP_QUAD_MODE) && ((GetConfigRegister() & CR_QUAD_MASK) != 0);
+      SayStatus(mQuadRead ? "Flash reads use quad output read" : "Flash reads use single lane read");
    }
 
 /**
@@ -87,6 +92,17 @@ public:
       mCallBacks.push_back(cb);
    }
 
+/**
+ * @brief Limit how often progress is reported while erasing, writing or reading 
+ * 
+ * @param interval_s: Minimum time between progress reports (0 = report every page). 
+ * The final report of each operation is always made. 
+ */
+   void SetStatusInterval(double interval_s)
+   {
+      mStatusInterval = interval_s;
+   }
+
 /**
  * @brief Erase a section of the flash. 
  *  
@@ -117,7 +133,10 @@ public:
          WriteEnable();
          SectorErase(addr + erased_bytes);
          erased_bytes += FLASH_SECTOR_BYTES;
-         SayStatus("Erased Sector", static_cast<double>(erased_bytes) / static_cast<double>(len));
+         if (StatusDue(erased_bytes >= len))
+         {
+            SayStatus("Erased Sector", static_cast<double>(erased_bytes) / static_cast<double>(len));
+         }
          num_sectors_erased++;
       }
 
@@ -160,43 +179,147 @@ public:
          const auto flash_page_bytes = FLASH_PAGE_BYTES;  // Needed to compile C++11/C++14. Fixed in C++17. See https://stackoverflow.com/questions/8016780/undefined-reference-to-static-constexpr-char
          const size_t real_count = std::min(flash_page_bytes, len - numwritten);
 
-         // Optimize- skip whole pages of 0xFF
-         bool skip = true;
-         for (size_t xx = 0; xx < real_count; xx++)
+         ProgramPage(flash_addr, src + numwritten, real_count);
+
+         flash_addr += real_count;
+         numwritten += real_count;
+
+         // Report status
+         if (StatusDue(numwritten == len))
          {
-            if (src[numwritten + xx] != 0xFF)
+            std::stringstream ss;
+            ss << "Wrote " << numwritten << " bytes";
+            SayStatus(ss.str(), static_cast<double>(numwritten) / static_cast<double>(len));
+         }
+      }
+
+      // Check for errors
+      const auto stat = GetStatusRegister();
+      if (stat & SR_ANY_ERR_MASK)
+      {
+         SayStatus("Warning: Flash indicated an error while writing");
+      }
+
+   }
+
+
+/**
+ * @brief Update a section of flash, erasing and programming only the sectors that differ 
+ *  
+ * @note: The current contents are read back and compared with src one erase sector at a 
+ * time. A sector that differs is erased only if a bit must change from 0 to 1, and only its 
+ * changed pages are programmed; it is then read back to verify it. 
+ * 
+ * @param flash_addr: First address to update (must be on an even sector boundary, as for EraseRange) 
+ * @param src: Pointer to source data 
+ * @param len: Number of bytes to update 
+ * @return true if every changed sector read back matched the source data 
+ */
+   bool UpdateRange(uint32_t flash_addr, const uint8_t* src, const size_t len)
+   {
+      // We don't support erase/write if not on an even sector boundary
+      if (flash_addr & (FLASH_ENFORCED_SECTOR_BYTES - 1))
+      {
+         throw std::runtime_error("Flash address must be on an even page of " + std::to_string(FLASH_ENFORCED_SECTOR_BYTES) + " bytes");
+      }
+
+      std::lock_guard<decltype(mMutex)> lock(mMutex);
+
+      // Clear error bits
+      ClearStatusRegister();
+
+      // Compare in units of the largest erase sector, so an erase never touches data judged unchanged
+      const auto flash_enforced_sector_bytes = FLASH_ENFORCED_SECTOR_BYTES;
+      const auto flash_page_bytes = FLASH_PAGE_BYTES;
+      std::vector<uint8_t> current(flash_enforced_sector_bytes);
+      size_t numchecked = 0;
+      size_t num_sectors = 0;
+      size_t num_sectors_changed = 0;
+      size_t num_sectors_erased = 0;
+      bool verified = true;
+
+      const auto start = std::chrono::steady_clock::now();
+      while ((numchecked < len) && verified)
+      {
+         const uint32_t addr = flash_addr + numchecked;
+         const uint8_t* sector_src = src + numchecked;
+         const size_t sector_count = std::min(flash_enforced_sector_bytes, len - numchecked);
+
+         ReadSector(addr, current.data(), sector_count);
+         if (memcmp(current.data(), sector_src, sector_count) != 0)
+         {
+            // Programming can only clear bits; erase if any bit must be set
+            bool needs_erase = false;
+            for (size_t xx = 0; xx < sector_count; xx++)
+            {
+               if ((current[xx] & sector_src[xx]) != sector_src[xx])
+               {
+                  needs_erase = true;
+                  break;
+               }
+            }
+            if (needs_erase)
+            {
+               for (size_t erased_bytes = 0; erased_bytes < flash_enforced_sector_bytes; erased_bytes += FLASH_SECTOR_BYTES)
+               {
+                  WriteEnable();
+                  SectorErase(addr + erased_bytes);
+               }
+               memset(current.data(), 0xFF, sector_count);
+               num_sectors_erased++;
+            }
+
+            // Program only the pages that differ
+            for (size_t pageinx = 0; pageinx < sector_count; pageinx += flash_page_bytes)
             {
-               skip = false;
-               break;
+               const size_t page_count = std::min(flash_page_bytes, sector_count - pageinx);
+               if (memcmp(current.data() + pageinx, sector_src + pageinx, page_count) != 0)
+               {
+                  ProgramPage(addr + pageinx, sector_src + pageinx, page_count);
+               }
             }
+
+            // Verify the reprogrammed sector
+            ReadSector(addr, current.data(), sector_count);
+            if (memcmp(current.data(), sector_src, sector_count) != 0)
+            {
+               std::stringstream ss;
+               ss << "Verify failed in sector at 0x" << std::hex << addr;
+               SayStatus(ss.str());
+               verified = false;
+            }
+            num_sectors_changed++;
          }
 
-         // Only execute the command if its not all FF
-         if (!skip)
+         numchecked += sector_count;
+         num_sectors++;
+         // Report status
+         if (StatusDue(numchecked == len))
          {
-            WriteEnable();
-            StartCommand(CMD_PAGEPROGRAM_WRITE);
-            AddAddr(flash_addr);
-            AddFromBuffer(src + numwritten, real_count);
-            Execute(0);
+            std::stringstream ss;
+            ss << "Checked " << numchecked << " bytes, " << num_sectors_changed << " sectors changed";
+            SayStatus(ss.str(), static_cast<double>(numchecked) / static_cast<double>(len));
          }
+      }
+      const std::chrono::duration<double> dt = std::chrono::steady_clock::now() - start;
 
-         flash_addr += real_count;
-         numwritten += real_count;
-
-         // Report status
+      if (verified)
+      {
          std::stringstream ss;
-         ss << "Wrote " << numwritten << " bytes";
-         SayStatus(ss.str(), static_cast<double>(numwritten) / static_cast<double>(len));
+         ss.precision(3);
+         ss << "Updated " << num_sectors_changed << " of " << num_sectors << " sectors (" << num_sectors_erased 
+            << " erased) at " << (static_cast<double>(len) / dt.count() / 1.0e6) << " MB/s";
+         SayStatus(ss.str(), 1.0);
       }
 
       // Check for errors
       const auto stat = GetStatusRegister();
       if (stat & SR_ANY_ERR_MASK)
       {
-         SayStatus("Warning: Flash indicated an error while writing");
+         SayStatus("Warning: Flash indicated an error while updating");
       }
 
+      return verified;
    }
 
 
@@ -213,27 +336,38 @@ public:
 
       while (numread < len)
       {
-         // zzqq can read cross page boundary?
-         StartCommand(CMD_RANDOM_READ);
-         AddAddr(flash_addr);
-
-         // Read up to one page
-         const auto flash_page_bytes = FLASH_PAGE_BYTES;  // Needed to compile C++11/C++14. Fixed in C++17. See https://stackoverflow.com/questions/8016780/undefined-reference-to-static-constexpr-char
-         const size_t real_count = std::min(flash_page_bytes, len - numread);
-         const auto* rezbuf = Execute(real_count);
-
-         memcpy(dst + numread, rezbuf, real_count);
+         // Read up to one chunk; a read command may cross page boundaries
+         const auto flash_read_chunk_bytes = FLASH_READ_CHUNK_BYTES;
+         const size_t real_count = std::min(flash_read_chunk_bytes, len - numread);
+         ReadChunk(flash_addr, dst + numread, real_count);
 
          flash_addr += real_count;
          numread += real_count;
 
          // Report status
-         std::stringstream ss;
-         ss << "Read " << numread << " bytes";
-         SayStatus(ss.str(), static_cast<double>(numread) / static_cast<double>(len));
+         if (StatusDue(numread == len))
+         {
+            std::stringstream ss;
+            ss << "Read " << numread << " bytes";
+            SayStatus(ss.str(), static_cast<double>(numread) / static_cast<double>(len));
+         }
       }
    }
 
+/**
+ * @brief Report whether reads use quad output read
+ * 
+ * @note: Quad reads are used if the SPI core is in quad mode, and the flash has its 
+ * quad I/O pins enabled (configuration register QUAD bit). Otherwise reads use the 
+ * single lane read command. 
+ * 
+ * @return true if reads transfer data on 4 lanes 
+ */
+   bool QuadReadEnabled(void) const
+   {
+      return mQuadRead;
+   }
+
 
 
 private:
@@ -267,6 +401,28 @@ private:
    }
 
 
+//--------------------------------------------------------------------------------
+// GetConfigRegister
+// Reads configuration register 1 and returns it
+//--------------------------------------------------------------------------------
+   uint8_t GetConfigRegister(void)
+   {
+      // Same as the status register: a 2 byte transfer, not through Execute
+      uint8_t sendbuf[16];
+      uint8_t recvbuf[16];
+
+      sendbuf[0] = CMD_CONFIGREG_READ;
+
+      const int status = XSpi_Transfer(&mSPI, sendbuf, recvbuf, 2);
+      if (status != XST_SUCCESS)
+      {
+         throw std::runtime_error("SPI transaction failed getting configuration register code " + std::to_string((int)status));
+      }
+
+      return recvbuf[1];
+   }
+
+
 //--------------------------------------------------------------------------------
 // ClearStatusRegister
 // Clears volatile/error bits in the status register
@@ -396,6 +552,93 @@ private:
    }
 
 
+//--------------------------------------------------------------------------------
+// ProgramPage
+// Programs up to one page at addr, skipping pages that are all 0xFF
+//--------------------------------------------------------------------------------
+   void ProgramPage(uint32_t addr, const uint8_t* src, size_t len)
+   {
+      // Optimize- skip whole pages of 0xFF
+      bool skip = true;
+      for (size_t xx = 0; xx < len; xx++)
+      {
+         if (src[xx] != 0xFF)
+         {
+            skip = false;
+            break;
+         }
+      }
+
+      // Only execute the command if its not all FF
+      if (!skip)
+      {
+         WriteEnable();
+         StartCommand(CMD_PAGEPROGRAM_WRITE);
+         AddAddr(addr);
+         AddFromBuffer(src, len);
+         Execute(0);
+      }
+   }
+
+
+//--------------------------------------------------------------------------------
+// ReadChunk
+// Reads up to FLASH_READ_CHUNK_BYTES at addr with a single read command (quad output if enabled)
+//--------------------------------------------------------------------------------
+   void ReadChunk(uint32_t addr, uint8_t* dst, size_t len)
+   {
+      if (mQuadRead)
+      {
+         // Command and address on one lane; then dummy clocks, and the data on 4 lanes
+         StartCommand(CMD_QUAD_OUTPUT_READ);
+         AddAddr(addr);
+         for (size_t xx = 0; xx < FLASH_QUAD_DUMMY_BYTES; xx++)
+         {
+            mWriteBuf[mCurrWriteBufInx++] = 0xFF;
+         }
+      }
+      else
+      {
+         StartCommand(CMD_RANDOM_READ);
+         AddAddr(addr);
+      }
+      const auto* rezbuf = Execute(len);
+      memcpy(dst, rezbuf, len);
+   }
+
+
+//--------------------------------------------------------------------------------
+// ReadSector
+// Reads len bytes (up to one sector) at addr, one chunk per read command
+//--------------------------------------------------------------------------------
+   void ReadSector(uint32_t addr, uint8_t* dst, size_t len)
+   {
+      const auto flash_read_chunk_bytes = FLASH_READ_CHUNK_BYTES;
+      for (size_t readinx = 0; readinx < len; readinx += flash_read_chunk_bytes)
+      {
+         ReadChunk(addr + readinx, dst + readinx, std::min(flash_read_chunk_bytes, len - readinx));
+      }
+   }
+
+
+//--------------------------------------------------------------------------------
+// StatusDue
+// Returns true if a progress report should be made now: always if final, otherwise
+// once mStatusInterval has passed since the last report
+//--------------------------------------------------------------------------------
+   bool StatusDue(bool final)
+   {
+      const auto now = std::chrono::steady_clock::now();
+      const std::chrono::duration<double> dt = now - mLastStatus;
+      if (!final && (dt.count() < mStatusInterval))
+      {
+         return false;
+      }
+      mLastStatus = now;
+      return true;
+   }
+
+
 //--------------------------------------------------------------------------------
 // SayStatus
 // Report status to any registered callback functions
@@ -429,23 +672,28 @@ private:
 
    // Sizes
    static constexpr size_t FLASH_PAGE_BYTES = 256;
-   static constexpr size_t FLASH_MAX_CMD_BYTES = 5;
+   static constexpr size_t FLASH_MAX_CMD_BYTES = 6;               // Command, 4 address bytes, and a dummy byte for fast reads
    static constexpr size_t FLASH_SECTOR_BYTES = 64 * 1024;        // Not true for S25FL128xxxxxx1 devices, which have 256K
+   static constexpr size_t FLASH_READ_CHUNK_BYTES = 16384;        // Bytes read per command; reads may cross page boundaries
+   static constexpr size_t FLASH_QUAD_DUMMY_BYTES = 1;            // 8 dummy clocks before quad output read data (latency code 0)
 
    // Commands. Note: All commands must use 4 byte addressing
    static constexpr uint8_t CMD_RANDOM_READ       = 0x13;
+   static constexpr uint8_t CMD_QUAD_OUTPUT_READ  = 0x6C;        // 4QOR: data on 4 lanes
    static constexpr uint8_t CMD_PAGEPROGRAM_WRITE = 0x12;
    static constexpr uint8_t CMD_WRITE_ENABLE	  = 0x06;
    static constexpr uint8_t CMD_SECTOR_ERASE	  = 0xDC;
    static constexpr uint8_t CMD_STATUSREG_READ    = 0x05;
    static constexpr uint8_t CMD_STATUSREG_WRITE   = 0x01;
    static constexpr uint8_t CMD_STATUSREG_CLEAR   = 0x30;
+   static constexpr uint8_t CMD_CONFIGREG_READ    = 0x35;
 
    // Register defs
    static constexpr uint8_t SR_IS_READY_MASK = 0x01; // D0 is 1 when busy
    static constexpr uint8_t SR_E_ERR_MASK = 0x20;       // D5 is 1 if erase error
    static constexpr uint8_t SR_P_ERR_MASK = 0x40;       // D6 is 1 if program error
    static constexpr uint8_t SR_ANY_ERR_MASK = (SR_P_ERR_MASK | SR_E_ERR_MASK);  // Any error
+   static constexpr uint8_t CR_QUAD_MASK = 0x02;        // D1 is 1 if the quad I/O pins are enabled
    //-------------------------------------------------------------------------------------//
 
 
@@ -455,16 +703,23 @@ private:
    // Registered callback functions
    std::vector<status_callback_t> mCallBacks;
 
+   // Progress report throttling
+   double mStatusInterval = 0.0;
+   std::chrono::steady_clock::time_point mLastStatus;
+
    // Xilinx-like SPI access classes
    XSpi_Config mCfg;
    XSpi        mSPI;
 
    // Buffers for interaction with Xilinx library
-   static constexpr size_t TOTAL_BUFFER_SIZE = FLASH_MAX_CMD_BYTES + FLASH_PAGE_BYTES;
+   static constexpr size_t TOTAL_BUFFER_SIZE = FLASH_MAX_CMD_BYTES + FLASH_READ_CHUNK_BYTES;
    uint8_t mWriteBuf[TOTAL_BUFFER_SIZE];
    uint8_t mReadBuf[TOTAL_BUFFER_SIZE];
    size_t mCurrWriteBufInx = 0;
 
+   // True if reads use the quad output read command
+   bool mQuadRead = false;
+
 };
 
 
@@ -0,0 +1,468 @@
+/////////////////////////////////////////////////////////////
+//
+// Saturn project: Artix7 FPGA + Raspberry Pi4 Compute Module
+// PCI Express interface from linux on Raspberry pi
+//
+// licenced under GNU GPL3
+//
+// xvcserver.c:
+//
+// Xilinx Virtual Cable (XVC 1.0) server for the FPGA JTAG over PCIe, through
+// the XDMA driver's xvc device. Vivado's hardware manager connects to it
+// ("open_hw_target -xvc_url <pi address>:2542") for ILA captures, bitstream
+// readback and so on, without a JTAG cable.
+//
+// each XVC shift command is a round trip from the client, and was one ioctl.
+// Here every complete command already received is parsed before any is
+// shifted: all the shifts found are done with one XDMA_IOCXVC_BATCH ioctl,
+// and all their replies are sent in one write. A client that pipelines its
+// requests (as hw_server does for long scans) then costs one system call and
+// one TCP segment per batch, not per shift.
+// with an older driver, without the batch ioctl, each shift is its own ioctl.
+//
+// ./xvcserver [-d device] [-p port] [-s] [-l] [-n] [-v]
+//
+//////////////////////////////////////////////////////////////
+
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+//------------------------------------------------------------------------------------------
+// VERSION History
+// V1:   initial release
+
+
+#define VDEFAULTDEVICE "/dev/xdma0_xvc"
+#define VDEFAULTPORT 2542                       // the XVC port Vivado expects
+#define VMAXVECTORBYTES 32768                   // largest shift (each of TMS, TDI), reported by getinfo
+#define VMAXCOMMANDBYTES (10 + 2 * VMAXVECTORBYTES)     // "shift:" + length + TMS + TDI
+#define VRXBUFFERSIZE (4 * VMAXCOMMANDBYTES)   // received commands, parsed in place
+#define VTXBUFFERSIZE VRXBUFFERSIZE             // replies, sent together
+#define VMAXBATCH 1024                          // XVC_BATCH_MAX in the driver's cdev_xvc.h
+
+
+//
+// the driver's XVC ioctls, as cdev_xvc.h
+//
+#define VXVCMAGIC 0x58564344                    // "XVCD"
+#define VXVCOPSHIFT 0x01                        // shift on the JTAG chain
+#define VXVCOPLOOPBACK 0x02                     // BAR access test: TDO returned is TDI
+
+struct XVCIoctl
+{
+    unsigned int Opcode;
+    unsigned int Length;                        // bits
+    const uint8_t* TMS;
+    const uint8_t* TDI;
+    uint8_t* TDO;
+};
+
+struct XVCBatchIoctl
+{
+    unsigned int Count;
+    unsigned int Done;                          // set by the driver: vectors completed
+    const struct XVCIoctl* Ops;
+};
+
+#define VIOCXVC _IOWR(VXVCMAGIC, 1, struct XVCIoctl)
+#define VIOCXVCBATCH _IOWR(VXVCMAGIC, 2, struct XVCBatchIoctl)
+
+
+//
+// settings
+//
+static const char* DeviceName = VDEFAULTDEVICE;
+static uint16_t Port = VDEFAULTPORT;
+static bool UseBatch = true;                    // cleared by -s, or if the driver has no batch ioctl
+static bool NoDevice = false;                   // -n: no device; TDO is TDI, to time the network path
+static unsigned int Opcode = VXVCOPSHIFT;
+static bool Verbose = false;
+static int Device_fd = -1;
+
+
+//
+// statistics for one client connection
+//
+struct XVCStats
+{
+    uint64_t Shifts;
+    uint64_t Bits;
+    uint64_t Ioctls;
+    uint64_t Batches;                           // batches of more than one shift
+    uint64_t StartNs;
+};
+
+
+//
+// a batch of shifts waiting to be done: vectors point into the receive and transmit buffers
+//
+static struct XVCIoctl Batch[VMAXBATCH];
+static uint32_t BatchCount = 0;
+static uint8_t RxBuffer[VRXBUFFERSIZE];
+static uint8_t TxBuffer[VTXBUFFERSIZE];
+
+
+//
+// time now in ns
+//
+static uint64_t GetTimeNs(void)
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (uint64_t)Now.tv_sec * 1000000000ULL + (uint64_t)Now.tv_nsec;
+}
+
+
+static void PrintUsage(void)
+{
+    printf("usage: xvcserver [-d device] [-p port] [-s] [-l] [-n] [-v]\n");
+    printf("   -d device   XDMA XVC device (default %s)\n", VDEFAULTDEVICE);
+    printf("   -p port     TCP port (default %d)\n", VDEFAULTPORT);
+    printf("   -s          one ioctl per shift (no batching), for comparison\n");
+    printf("   -l          BAR loopback test: the driver returns TDI as TDO\n");
+    printf("   -n          no device: TDO is TDI, to time the network and server alone\n");
+    printf("   -v          print each batch\n");
+}
+
+
+//
+// do the shifts in the batch, and empty it
+// returns false if the device reported an error
+//
+static bool FlushBatch(struct XVCStats* Stats)
+{
+    struct XVCBatchIoctl BatchIoctl;
+    uint32_t Cntr;
+    bool Result = true;
+
+    if (BatchCount == 0)
+        return true;
+    if (Verbose)
+        printf("batch of %u shifts, %u bits first\n", BatchCount, Batch[0].Length);
+    if (BatchCount > 1)
+        Stats->Batches++;
+
+    if (NoDevice)
+    {
+        for (Cntr = 0; Cntr < BatchCount; Cntr++)
+            memcpy(Batch[Cntr].TDO, Batch[Cntr].TDI, (Batch[Cntr].Length + 7) / 8);
+    }
+    else if (UseBatch)
+    {
+        BatchIoctl.Count = BatchCount;
+        BatchIoctl.Done = 0;
+        BatchIoctl.Ops = Batch;
+        Stats->Ioctls++;
+        if (ioctl(Device_fd, VIOCXVCBATCH, &BatchIoctl) < 0)
+        {
+            if ((errno != ENOTTY) && (errno != EINVAL))
+            {
+                perror("XVC batch ioctl");
+                Result = false;
+            }
+            else
+            {
+                printf("driver has no XVC batch ioctl: one ioctl per shift\n");
+                UseBatch = false;
+            }
+        }
+    }
+    if (Result && !NoDevice && !UseBatch)
+    {
+        for (Cntr = 0; Cntr < BatchCount; Cntr++)
+        {
+            Stats->Ioctls++;
+            if (ioctl(Device_fd, VIOCXVC, &Batch[Cntr]) < 0)
+            {
+                perror("XVC ioctl");
+                Result = false;
+                break;
+            }
+        }
+    }
+    BatchCount = 0;
+    return Result;
+}
+
+
+//
+// send all of a buffer
+//
+static bool SendAll(int Socket, const uint8_t* Data, size_t Length)
+{
+    ssize_t Sent;
+
+    while (Length > 0)
+    {
+        Sent = send(Socket, Data, Length, MSG_NOSIGNAL);
+        if (Sent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("send");
+            return false;
+        }
+        Data += Sent;
+        Length -= (size_t)Sent;
+    }
+    return true;
+}
+
+
+//
+// serve one client until it disconnects
+// commands are parsed from RxBuffer[0..RxLength); replies are built in TxBuffer.
+// settck and getinfo replies are written in order with the TDO of the shifts around them
+// (TDO space is reserved in TxBuffer when the shift is parsed, and filled by the batch)
+//
+static void ServeClient(int Socket)
+{
+    struct XVCStats Stats;
+    size_t RxLength = 0;
+    size_t Parsed, TxLength, Bytes;
+    ssize_t Received;
+    uint32_t Bits, Period;
+    uint64_t Time;
+    bool Connected = true;
+    bool TxFull = false;                                // parsing stopped with commands left: don't wait
+    int Flags;
+
+    memset(&Stats, 0, sizeof(Stats));
+    Stats.StartNs = GetTimeNs();
+    while (Connected)
+    {
+        //
+        // wait for more data, then take whatever else has arrived without waiting
+        // (unless commands were left unparsed for lack of reply space)
+        //
+        Flags = 0;
+        for (;!TxFull;)
+        {
+            Received = recv(Socket, RxBuffer + RxLength, VRXBUFFERSIZE - RxLength, Flags);
+            if (Received > 0)
+            {
+                RxLength += (size_t)Received;
+                Flags = MSG_DONTWAIT;
+                if (RxLength == VRXBUFFERSIZE)
+                    break;
+                continue;
+            }
+            if ((Received < 0) && (errno == EINTR))
+                continue;
+            if ((Received < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+                break;
+            Connected = false;                          // closed, or error
+            break;
+        }
+
+        //
+        // parse every complete command
+        //
+        Parsed = 0;
+        TxLength = 0;
+        TxFull = false;
+        while (Connected)
+        {
+            uint8_t* Command = RxBuffer + Parsed;
+            size_t Available = RxLength - Parsed;
+
+            uint8_t* Colon;
+
+            if (TxLength + VMAXVECTORBYTES + 32 > VTXBUFFERSIZE)
+            {
+                TxFull = true;                                  // send these replies first
+                break;
+            }
+            Colon = memchr(Command, ':', (Available < 8) ? Available : 8);
+            if (Colon == NULL)
+            {
+                if (Available >= 8)
+                {
+                    fprintf(stderr, "unknown XVC command\n");
+                    Connected = false;
+                }
+                break;                                          // else incomplete command
+            }
+            if (((Colon - Command) == 7) && (memcmp(Command, "getinfo", 7) == 0))
+            {
+                TxLength += snprintf((char*)TxBuffer + TxLength, VTXBUFFERSIZE - TxLength,
+                                     "xvcServer_v1.0:%u\n", VMAXVECTORBYTES);
+                Parsed += 8;
+            }
+            else if (((Colon - Command) == 6) && (memcmp(Command, "settck", 6) == 0))
+            {
+                if (Available < 11)
+                    break;
+                memcpy(&Period, Command + 7, 4);                // the cable's TCK is fixed: echo the period
+                memcpy(TxBuffer + TxLength, &Period, 4);
+                TxLength += 4;
+                Parsed += 11;
+            }
+            else if (((Colon - Command) == 5) && (memcmp(Command, "shift", 5) == 0))
+            {
+                if (Available < 10)
+                    break;
+                memcpy(&Bits, Command + 6, 4);                  // little endian, as the client
+                Bytes = (Bits + 7) / 8;
+                if (Bytes > VMAXVECTORBYTES)
+                {
+                    fprintf(stderr, "shift of %u bits is longer than the %u bytes reported\n", Bits, VMAXVECTORBYTES);
+                    Connected = false;
+                    break;
+                }
+                if (Available < 10 + 2 * Bytes)
+                    break;                                      // rest of the vectors still to come
+                if (BatchCount == VMAXBATCH)
+                    if (!FlushBatch(&Stats))
+                    {
+                        Connected = false;
+                        break;
+                    }
+                Batch[BatchCount].Opcode = Opcode;
+                Batch[BatchCount].Length = Bits;
+                Batch[BatchCount].TMS = Command + 10;
+                Batch[BatchCount].TDI = Command + 10 + Bytes;
+                Batch[BatchCount].TDO = TxBuffer + TxLength;
+                BatchCount++;
+                TxLength += Bytes;
+                Stats.Shifts++;
+                Stats.Bits += Bits;
+                Parsed += 10 + 2 * Bytes;
+            }
+            else
+            {
+                fprintf(stderr, "unknown XVC command\n");
+                Connected = false;
+                break;
+            }
+            if (!UseBatch)
+            {
+                if (!FlushBatch(&Stats))
+                    Connected = false;
+            }
+        }
+
+        //
+        // shift the batch, send the replies, and keep any incomplete command
+        //
+        if (!FlushBatch(&Stats))
+            Connected = false;
+        if (Connected && (TxLength > 0))
+            Connected = SendAll(Socket, TxBuffer, TxLength);
+        memmove(RxBuffer, RxBuffer + Parsed, RxLength - Parsed);
+        RxLength -= Parsed;
+    }
+
+    Time = GetTimeNs() - Stats.StartNs;
+    printf("client disconnected: %llu shifts, %llu bits, %llu ioctls (%llu batches) in %.1fs; %.1f kbit/s\n",
+           (unsigned long long)Stats.Shifts, (unsigned long long)Stats.Bits,
+           (unsigned long long)Stats.Ioctls, (unsigned long long)Stats.Batches, (double)Time * 1e-9,
+           (Time > 0) ? (double)Stats.Bits * 1e6 / (double)Time : 0.0);
+}
+
+
+int main(int argc, char* argv[])
+{
+    struct sockaddr_in Address, Client;
+    socklen_t ClientLength;
+    int Listen_fd, Client_fd;
+    int Option;
+    int Enable = 1;
+
+    while ((Option = getopt(argc, argv, "d:p:slnv")) != -1)
+    {
+        switch (Option)
+        {
+        case 'd':
+            DeviceName = optarg;
+            break;
+        case 'p':
+            Port = (uint16_t)strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            UseBatch = false;
+            break;
+        case 'l':
+            Opcode = VXVCOPLOOPBACK;
+            break;
+        case 'n':
+            NoDevice = true;
+            break;
+        case 'v':
+            Verbose = true;
+            break;
+        default:
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    if (!NoDevice)
+    {
+        Device_fd = open(DeviceName, O_RDWR);
+        if (Device_fd < 0)
+        {
+            perror(DeviceName);
+            return 1;
+        }
+    }
+
+    Listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (Listen_fd < 0)
+    {
+        perror("socket");
+        return 1;
+    }
+    setsockopt(Listen_fd, SOL_SOCKET, SO_REUSEADDR, &Enable, sizeof(Enable));
+    memset(&Address, 0, sizeof(Address));
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_ANY);
+    Address.sin_port = htons(Port);
+    if ((bind(Listen_fd, (struct sockaddr*)&Address, sizeof(Address)) < 0) || (listen(Listen_fd, 1) < 0))
+    {
+        perror("bind");
+        return 1;
+    }
+    printf("XVC server on port %u, %s%s\n", Port, NoDevice ? "no device" : DeviceName,
+           UseBatch ? ", batched shifts" : ", one ioctl per shift");
+
+    //
+    // one client at a time, as the JTAG chain has one state
+    //
+    for (;;)
+    {
+        ClientLength = sizeof(Client);
+        Client_fd = accept(Listen_fd, (struct sockaddr*)&Client, &ClientLength);
+        if (Client_fd < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("accept");
+            break;
+        }
+        setsockopt(Client_fd, IPPROTO_TCP, TCP_NODELAY, &Enable, sizeof(Enable));
+        printf("client connected from %s\n", inet_ntoa(Client.sin_addr));
+        ServeClient(Client_fd);
+        close(Client_fd);
+    }
+
+    close(Listen_fd);
+    if (Device_fd >= 0)
+        close(Device_fd);
+    return 0;
+}